@@ -0,0 +1,16 @@
+#!/bin/bash
+
+cd benchTree
+gcc -O2 -fopenmp -I../../../instrument -c ../../../instrument/cody.c
+g++ -O2 -std=c++11 -fopenmp -I../../../instrument -o QuadTree QuadTree.cpp ../../QuadTree/QuadTree.cpp ../../QuadTree/LinearQuadTree.cpp ../../QuadTree/FieldData.cpp ../../QuadTree/Epoch.cpp cody.o -lm
+
+file='scalingTest.csv' #data output file
+minDepth=6 #smallest maximum level of the trees
+maxDepth=16 #largest maximum level of the trees
+fullDepth=10 #largest maximum level of the trees refined everywhere
+probability=${1:-0.5} #chance the random criteria refines a node (command line argument)
+
+./QuadTree -filename=$file -minDepth=$minDepth -maxDepth=$maxDepth -fullDepth=$fullDepth -probability=$probability
+
+cd ..
+python postProcess.py -b benchTree/$file scaling
@@ -0,0 +1,309 @@
+//
+//  QuadTree.cpp
+//
+//  The scaling benchmark of the C++ trees in AMR/QuadTree.  Trees are built
+//  with the Line, Interaction and random criteria at maximum levels from
+//  minDepth up to maxDepth, and for each the time to update the tree, to
+//  update it again after the line moves, to find the leaves, the neighbors
+//  of every leaf (twice, the second time from the cache of the cached tree)
+//  and the leaves of a batch of random points, and the memory the tree
+//  takes, are written to a csv file with a row per backend, criteria and
+//  level:
+//
+//  pointer  QuadTree, its nodes from the node pool
+//  cached   QuadTree with neighbor caching on
+//  linear   LinearQuadTree
+//  space    SpaceTree<2>
+//
+//  Times are in microseconds, as in the other models, and postProcess.py
+//  plots them with -b.
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <getopt.h>
+#include "../../QuadTree/QuadTree.h"
+#include "../../QuadTree/LinearQuadTree.h"
+#include "../../QuadTree/SpaceTree.h"
+
+using namespace std;
+
+/*
+ * Points in the batch given to findNodes
+ */
+#define FIND_POINTS 100000
+
+/*
+ * Refines a node with probability p, the same node always the same way so
+ * every backend builds the same tree, and never coarsens, so the tree grows
+ * from its initial cells.  The coordinates are rounded before they are
+ * hashed, as the trees work them out with different rounding
+ */
+class Random : public Application {
+public:
+
+    Random(double probability, uint64_t s){
+        p       = probability;
+        seed    = s;
+    }
+
+    bool refine(double x, double y, double w, double h){
+        uint64_t v  = seed;
+        v           = mix(v ^ (uint64_t) llround(ldexp(x, 20)));
+        v           = mix(v ^ (uint64_t) llround(ldexp(y, 20)));
+        v           = mix(v ^ (uint64_t) llround(ldexp(w, 20)));
+        return ldexp((double) (v >> 11), -53) < p;
+    }
+
+    bool coarsen(double x, double y, double w, double h){
+        return false;
+    }
+
+private:
+    //the splitmix64 finalizer
+    static uint64_t mix(uint64_t v){
+        v   = (v ^ (v >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        v   = (v ^ (v >> 27)) * 0x94d049bb133111ebULL;
+        return v ^ (v >> 31);
+    }
+
+    double p;
+    uint64_t seed;
+
+};
+
+/*
+ * The refinement of another criteria with coarsening off.  Interaction
+ * coarsens every node it is asked about, so an update would take the
+ * whole tree back to the root, and with coarsening off it refines every
+ * node to the maximum level instead
+ */
+class Refining : public Application {
+public:
+
+    Refining(Application * application){
+        app = application;
+    }
+
+    bool refine(double x, double y, double w, double h){
+        return app->refine(x,y,w,h);
+    }
+
+    bool coarsen(double x, double y, double w, double h){
+        return false;
+    }
+
+private:
+    Application * app;
+
+};
+
+/*
+ * The measurements of one tree
+ */
+struct Row{
+    long leaves;
+    double update;
+    double step;
+    double traversal;
+    double neighbors;
+    double cached;
+    double find;
+    long found; //sum of the levels of the leaves found
+    long storage;
+};
+
+/*
+ * Microseconds since start
+ */
+double elapsed(chrono::steady_clock::time_point start){
+    return chrono::duration<double, micro>(chrono::steady_clock::now() -
+                                           start).count();
+}
+
+/*
+ * Finds the leaves of the points, all at once where the tree can, and
+ * returns the sum of their levels so the search is not optimized away
+ */
+long findBatch(QuadTree& tree, const vector<double>& xs,
+               const vector<double>& ys){
+    vector<Node*> out(xs.size());
+    tree.findNodes(&xs[0], &ys[0], xs.size(), &out[0]);
+    long sum    = 0;
+    for(size_t k = 0; k < out.size(); k++)
+        sum     += out[k]->currentLevel;
+    return sum;
+}
+
+long findBatch(LinearQuadTree& tree, const vector<double>& xs,
+               const vector<double>& ys){
+    vector<LinearNode> out(xs.size());
+    tree.findNodes(&xs[0], &ys[0], xs.size(), &out[0]);
+    long sum    = 0;
+    for(size_t k = 0; k < out.size(); k++)
+        sum     += out[k].level;
+    return sum;
+}
+
+long findBatch(SpaceTree<2>& tree, const vector<double>& xs,
+               const vector<double>& ys){
+    long sum    = 0;
+    for(size_t k = 0; k < xs.size(); k++){
+        double p[2] = {xs[k], ys[k]};
+        sum     += tree.findNode(p).level;
+    }
+    return sum;
+}
+
+/*
+ * Times a tree of any backend, N its node type.  The segment, if there is
+ * one, is moved between the two updates and put back
+ */
+template<class Tree, class N>
+Row benchTree(Tree& tree, Segment * seg, const vector<double>& xs,
+              const vector<double>& ys){
+    Row row;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    tree.update();
+    row.update      = elapsed(start);
+
+    if(seg != NULL)
+        seg->translate(0.01,0.01);
+    start           = chrono::steady_clock::now();
+    tree.update();
+    row.step        = elapsed(start);
+    if(seg != NULL)
+        seg->translate(-0.01,-0.01);
+
+    vector<N> leaves;
+    start           = chrono::steady_clock::now();
+    tree.findLeaves(leaves);
+    row.traversal   = elapsed(start);
+
+    double * times[2] = {&row.neighbors, &row.cached};
+    for(int t = 0; t < 2; t++){
+        start       = chrono::steady_clock::now();
+        for(size_t k = 0; k < leaves.size(); k++){
+            vector<vector<N> > neighbors(4);
+            tree.getNeighbors(leaves[k], neighbors);
+        }
+        *times[t]   = elapsed(start);
+    }
+
+    start           = chrono::steady_clock::now();
+    row.found       = findBatch(tree, xs, ys);
+    row.find        = elapsed(start);
+    row.leaves      = leaves.size();
+    row.storage     = tree.storage();
+    return row;
+}
+
+/*
+ * Builds the tree of a backend, 0 pointer, 1 cached, 2 linear and 3 space,
+ * with the criteria and maximum level and times it
+ */
+Row benchBackend(int backend, Application * app, Segment * seg, int level,
+                 const vector<double>& xs, const vector<double>& ys){
+    if(backend < 2){
+        QuadTree tree(-4.0,-4.0,4.0,4.0,16,level,app);
+        tree.setCacheNeighbors(backend == 1);
+        return benchTree<QuadTree,Node*>(tree, seg, xs, ys);
+    }
+    else if(backend == 2){
+        LinearQuadTree tree(-4.0,-4.0,4.0,4.0,16,level,app);
+        return benchTree<LinearQuadTree,LinearNode>(tree, seg, xs, ys);
+    }
+    else {
+        double corner[2]    = {-4.0,-4.0};
+        double size[2]      = {4.0,4.0};
+        PlaneApplication plane(app);
+        SpaceTree<2> tree(corner,size,16,level,&plane);
+        return benchTree<SpaceTree<2>,SpaceNode<2> >(tree, seg, xs, ys);
+    }
+}
+
+/*
+ * Runs every backend with every criteria at the levels from minDepth up to
+ * maxDepth, the Interaction criteria, which refines every node, only up to
+ * fullDepth.  The results are outputted to a csv file, with the sum of the
+ * levels of the leaves found, the same for every backend
+ */
+void scalingTest(int minDepth, int maxDepth, int fullDepth,
+                 double probability, string filename){
+    ofstream file;
+    file.open(filename.c_str());
+    file <<"backend,criteria,max level,leaves,update,step,traversal,"
+    "neighbors,cached neighbors,find,found,storage\n";
+    const char * backends[4]    = {"pointer","cached","linear","space"};
+    const char * criteria[3]    = {"line","interaction","random"};
+
+    Segment seg(-4.0,0.0,-1.0,-7.0);
+    seg.translate(1.5,1.5);
+    Line line(&seg);
+    Interaction interaction;
+    Refining full(&interaction);
+    Random random(probability, 1);
+    Application * apps[3]       = {&line, &full, &random};
+
+    srand(1);
+    vector<double> xs(FIND_POINTS);
+    vector<double> ys(FIND_POINTS);
+    for(int k = 0; k < FIND_POINTS; k++){
+        xs[k]   = -4.0 + 4.0*rand()/RAND_MAX;
+        ys[k]   = -4.0 + 4.0*rand()/RAND_MAX;
+    }
+
+    for(int c = 0; c < 3; c++){
+        for(int level = minDepth; level <= maxDepth; level += 2){
+            if(c == 1 && level > fullDepth)
+                break;
+            for(int b = 0; b < 4; b++){
+                Row row = benchBackend(b, apps[c], c == 0 ? &seg : NULL,
+                                       level, xs, ys);
+                if(file.is_open())
+                    file <<backends[b]<<","<<criteria[c]<<","<<level<<","<<
+                    row.leaves<<","<<row.update<<","<<row.step<<","<<
+                    row.traversal<<","<<row.neighbors<<","<<row.cached<<
+                    ","<<row.find<<","<<row.found<<","<<row.storage<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+        }
+    }
+    file.close();
+}
+
+int main(int argc, char* argv[]){
+    string filename     = "scalingTest.csv";
+    int minDepth        = 6;
+    int maxDepth        = 16;
+    int fullDepth       = 10;
+    double probability  = 0.5;
+
+    //the command line arguments in the style of the other versions,
+    //-maxDepth=16 or --maxDepth=16
+    static struct option options[] = {
+        {"filename",    required_argument, 0, 0},
+        {"minDepth",    required_argument, 0, 0},
+        {"maxDepth",    required_argument, 0, 0},
+        {"fullDepth",   required_argument, 0, 0},
+        {"probability", required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+    int opt_i;
+    while(getopt_long_only(argc, argv, "", options, &opt_i) == 0){
+        switch(opt_i){
+            case 0: filename    = optarg; break;
+            case 1: minDepth    = atoi(optarg); break;
+            case 2: maxDepth    = atoi(optarg); break;
+            case 3: fullDepth   = atoi(optarg); break;
+            case 4: probability = atof(optarg); break;
+        }
+    }
+
+    scalingTest(minDepth, maxDepth, fullDepth, probability, filename);
+    return 0;
+}
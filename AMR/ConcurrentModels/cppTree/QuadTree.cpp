@@ -0,0 +1,160 @@
+//
+//  QuadTree.cpp
+//
+//  The C++ version of the dummy work test of the Go and D models, using the
+//  QuadTree in AMR/QuadTree and its LeafExecutor as the work queue.  Each
+//  leaf runs an empty loop of dumbyIter iterations, serially or on numCores
+//  threads, and the times are written to a csv file in the format of the Go
+//  and D versions, so postProcess.py and overhead.py read all three.
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <getopt.h>
+#include "../../QuadTree/QuadTree.h"
+#include "../../QuadTree/LeafExecutor.h"
+
+using namespace std;
+
+/*
+ * Leaves per chunk of the work queue
+ */
+#define CHUNK_SIZE 16
+
+/*
+ * The dumby work, an empty loop the compiler cannot remove
+ */
+void dumby(Node * node, void * arg){
+    int iter = *(int*) arg;
+    for(volatile int i = 0; i < iter; i++){
+        //dumby work
+    }
+}
+
+/*
+ * Microseconds since start
+ */
+double elapsed(chrono::steady_clock::time_point start){
+    return chrono::duration<double, micro>(chrono::steady_clock::now() -
+                                           start).count();
+}
+
+/*
+ * Applies the dumby work to every leaf serially, or with the executor if
+ * there is one
+ */
+void dumbyWork(QuadTree * tree, LeafExecutor * executor, int iter){
+    if(executor != NULL)
+        executor->run(tree, dumby, &iter);
+    else {
+        vector<Node*> leaves;
+        tree->findLeavesMorton(leaves);
+        for(size_t i = 0; i < leaves.size(); i++)
+            dumby(leaves[i], &iter);
+    }
+}
+
+/*
+ * This function conducts the dumby work on trees of different depths,
+ * serially if cores is 0
+ * The results are outputted to a csv file
+ */
+void depthTest(int level, int dumbyIter, int maxIter, string filename,
+               int cores){
+    ofstream file;
+    file.open(filename.c_str());
+    file <<"leaves,max depth,time,traversal,nodes\n";
+    Interaction app;
+    LeafExecutor * executor = NULL;
+    if(cores > 0)
+        executor = new LeafExecutor(cores, CHUNK_SIZE);
+
+    for(int i = 4; i < level; i = i+2){
+        //the complete tree with its leaves at depth i, the root at depth 1
+        QuadTree tree(-4.0,-4.0,4.0,4.0,1<<(2*(i-1)),i-1,&app);
+        vector<Node*> leaves;
+        tree.findLeaves(leaves);
+
+        //time traversal
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for(int k = 0; k < maxIter; k++)
+            dumbyWork(&tree, executor, 0);
+        double tTime = elapsed(start)/maxIter;
+
+        //time the dumby work
+        start = chrono::steady_clock::now();
+        for(int j = 0; j < maxIter; j++)
+            dumbyWork(&tree, executor, dumbyIter);
+        double time = elapsed(start)/maxIter;
+
+        //write the data to the file
+        if(file.is_open())
+            file <<leaves.size()<<","<<i<<","<<time<<","<<tTime<<","<<
+            tree.countNodes()<<"\n";
+        else
+            cout<<"FILE ERROR"<<endl;
+    }
+    file.close();
+    delete executor;
+}
+
+int main(int argc, char* argv[]){
+    int function    = 0;
+    string filename = "test";
+    int depth       = 0;
+    int maxIter     = 1;
+    int dumbyIter   = 1;
+    int numCores    = 1;
+
+    //the command line arguments of the Go version, -case=0 or --case=0
+    static struct option options[] = {
+        {"case",      required_argument, 0, 0},
+        {"filename",  required_argument, 0, 0},
+        {"depth",     required_argument, 0, 0},
+        {"maxIter",   required_argument, 0, 0},
+        {"dumbyIter", required_argument, 0, 0},
+        {"numCores",  required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+    int opt_i;
+    while(getopt_long_only(argc, argv, "", options, &opt_i) == 0){
+        switch(opt_i){
+            case 0: function  = atoi(optarg); break;
+            case 1: filename  = optarg; break;
+            case 2: depth     = atoi(optarg); break;
+            case 3: maxIter   = atoi(optarg); break;
+            case 4: dumbyIter = atoi(optarg); break;
+            case 5: numCores  = atoi(optarg); break;
+        }
+    }
+
+    //time dummy work
+    Interaction app;
+    QuadTree node(-4.0,-4.0,4.0,4.0,1,0,&app);
+    int w = dumbyIter;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for(int i = 0; i < maxIter; i++)
+        dumby(NULL, &w);
+    cout<<"Dummy Work: "<<elapsed(start)/maxIter<<" Iterations: "<<w<<endl;
+
+    switch(function){
+        case 0: //concurrent depth test
+            cout<<"Concurrent test"<<endl;
+            depthTest(depth, dumbyIter, maxIter, filename, numCores);
+            break;
+        case 1: //sequential depth test
+            cout<<"Serial test"<<endl;
+            depthTest(depth, dumbyIter, maxIter, filename, 0);
+            break;
+        case 2: //time work
+            start = chrono::steady_clock::now();
+            for(int i = 0; i < 100; i++)
+                dumby(NULL, &w);
+            cout<<"Dummy Work: "<<elapsed(start)/100.0<<" Iterations: "<<w<<endl;
+            break;
+    }
+    return 0;
+}
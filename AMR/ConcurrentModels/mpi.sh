@@ -0,0 +1,19 @@
+#!/bin/bash
+
+cd mpiTree
+mpicxx -O2 -std=c++11 -o QuadTree QuadTree.cpp ../../QuadTree/DistributedQuadTree.cpp
+
+testName='sweepTest' #data output file header
+end='.csv' #data output file extension
+depth=10 #maximum depth of the tree
+steps=100 #number of times the line is moved and the tree updated
+tolerance=$1 #leaf count drift before repartitioning (command line argument)
+
+COUNTER=1 #
+maxRanks=33 #one more than max ranks used, ranks increase by powers of two
+
+while [ $COUNTER -lt $maxRanks ]; do
+	file=$testName$COUNTER$end
+	mpirun -np $COUNTER ./QuadTree -filename=$file -depth=$depth -steps=$steps -tolerance=$tolerance
+	let COUNTER=COUNTER*2
+done
@@ -0,0 +1,127 @@
+//
+//  QuadTree.cpp
+//
+//  The MPI version, using the DistributedQuadTree in AMR/QuadTree.  A line
+//  is pushed through the space a step at a time and the tree, spread over
+//  the ranks along the Morton curve, is updated after each step.  Rank 0
+//  writes a csv file with a row per step: the leaves of all the ranks, the
+//  fewest and most on one rank, the ghosts, the leaves moved by
+//  repartitioning, and the slowest rank's update and partition times.
+//
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstdlib>
+#include <getopt.h>
+#include <mpi.h>
+#include "../../QuadTree/DistributedQuadTree.h"
+
+using namespace std;
+
+/*
+ * Sums, smallest and largest of a value over the ranks
+ */
+long sumRanks(long v){
+    long out;
+    MPI_Allreduce(&v, &out, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+    return out;
+}
+
+long minRanks(long v){
+    long out;
+    MPI_Allreduce(&v, &out, 1, MPI_LONG, MPI_MIN, MPI_COMM_WORLD);
+    return out;
+}
+
+long maxRanks(long v){
+    long out;
+    MPI_Allreduce(&v, &out, 1, MPI_LONG, MPI_MAX, MPI_COMM_WORLD);
+    return out;
+}
+
+double maxRanks(double v){
+    double out;
+    MPI_Allreduce(&v, &out, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    return out;
+}
+
+/*
+ * Moves the line numSteps times across a tree of maximum level depth,
+ * repartitioning when the leaf counts drift more than tolerance
+ * The results are outputted to a csv file
+ */
+void sweepTest(int depth, int numSteps, double tolerance, string filename){
+    int rank;
+    int size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+    ofstream file;
+    if(rank == 0){
+        file.open(filename.c_str());
+        file <<"step,ranks,leaves,min leaves,max leaves,ghosts,moved,update,"
+        "partition\n";
+    }
+
+    Segment seg(-4.0,0.0,-1.0,-7.0);
+    seg.translate(1.5,1.5);
+    Line app(&seg);
+    DistributedQuadTree tree(-4.0,-4.0,4.0,4.0,16,depth,&app,MPI_COMM_WORLD);
+    tree.setTolerance(tolerance);
+    tree.setTime(true);
+
+    for(int step = 0; step < numSteps; step++){
+        tree.update();
+        long leaves     = tree.countLeaves();
+        long total      = sumRanks(leaves);
+        long fewest     = minRanks(leaves);
+        long most       = maxRanks(leaves);
+        long ghosts     = sumRanks(tree.countGhosts());
+        long moved      = sumRanks(tree.getMoved());
+        double update   = maxRanks(tree.getStats().total);
+        double part     = maxRanks(tree.getStats().partition);
+
+        //write the data to the file
+        if(rank == 0){
+            if(file.is_open())
+                file <<step<<","<<size<<","<<total<<","<<fewest<<","<<most<<
+                ","<<ghosts<<","<<moved<<","<<update<<","<<part<<"\n";
+            else
+                cout<<"FILE ERROR"<<endl;
+        }
+        seg.translate(0.01,0.01);
+    }
+    if(rank == 0)
+        file.close();
+}
+
+int main(int argc, char* argv[]){
+    MPI_Init(&argc, &argv);
+    string filename     = "sweepTest.csv";
+    int depth           = 10;
+    int numSteps        = 100;
+    double tolerance    = PARTITION_TOLERANCE;
+
+    //the command line arguments in the style of the other versions,
+    //-depth=10 or --depth=10
+    static struct option options[] = {
+        {"filename",  required_argument, 0, 0},
+        {"depth",     required_argument, 0, 0},
+        {"steps",     required_argument, 0, 0},
+        {"tolerance", required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+    int opt_i;
+    while(getopt_long_only(argc, argv, "", options, &opt_i) == 0){
+        switch(opt_i){
+            case 0: filename  = optarg; break;
+            case 1: depth     = atoi(optarg); break;
+            case 2: numSteps  = atoi(optarg); break;
+            case 3: tolerance = atof(optarg); break;
+        }
+    }
+
+    sweepTest(depth, numSteps, tolerance, filename);
+    MPI_Finalize();
+    return 0;
+}
@@ -59,17 +59,64 @@ def outputFigure(dataDic,filename,xRange,yRange,title,xLabel,yLabel,loc,
 		plt.tight_layout()	
 	fig.savefig(filename)
 
+# Reads the scaling benchmark of benchTree into a dictionary keyed by
+# criteria, each a dictionary keyed by backend of the leaves and the
+# times in seconds of each measurement
+benchTimes=['update','step','traversal','neighbors','cached neighbors','find']
+
+def readBench(filename):
+	bench={}
+	f=open(filename,'rt')
+	reader=csv.DictReader(f)
+	for row in reader:
+		backends=bench.setdefault(row['criteria'],{})
+		if row['backend'] not in backends:
+			backends[row['backend']]=dict((m,[]) for m in
+					benchTimes+['leaves','storage'])
+		columns=backends[row['backend']]
+		columns['leaves'].append(float(row['leaves']))
+		columns['storage'].append(float(row['storage']))
+		for m in benchTimes:
+			columns[m].append(float(row[m])/1000000.0)
+	return bench
+
+# Outputs a figure per criteria, a plot per measurement with a line per
+# backend against the leaves, on log axes
+def outputBench(bench,prefix):
+	for criteria in bench.keys():
+		fig = plt.figure(figsize=(12,8))
+		fig.suptitle('Criteria: '+criteria)
+		local = 330
+		for m in benchTimes+['storage']:
+			local=local+1
+			pt = fig.add_subplot(local)
+			pt.set_xlabel('leaves')
+			pt.set_ylabel('bytes' if m=='storage' else 'seconds')
+			pt.set_title(m)
+			for backend in sorted(bench[criteria].keys()):
+				columns=bench[criteria][backend]
+				pt.loglog(columns['leaves'],columns[m],'s-',label=backend)
+			pt.legend(loc='upper left',fontsize='small')
+		plt.tight_layout()
+		fig.savefig(prefix+criteria+'.png')
+
 def main():
-	dirc = 2 #number of directories 
-	outFiles = dirc * 3 #number of different dummy work times
 	parser = argparse.ArgumentParser(description="command line args")
 	parser.add_argument('-d','--directories',help='directory name',
-			nargs=dirc,required=True)
-	parser.add_argument('-m','--maxCores',type=int,help='maximum # of cores',
-			required=True)
-	parser.add_argument('-o','--output',help='output file name',
-			nargs=outFiles,required=True)
+			nargs='+')
+	parser.add_argument('-m','--maxCores',type=int,help='maximum # of cores')
+	parser.add_argument('-o','--output',help='output file names, three per directory',
+			nargs='+')
+	parser.add_argument('-b','--bench',nargs=2,metavar=('CSV','PREFIX'),
+			help='plots the scaling benchmark instead, one figure per criteria')
 	args = parser.parse_args()
+	if args.bench:
+		outputBench(readBench(args.bench[0]),args.bench[1])
+		return
+	if not args.directories or not args.maxCores or not args.output:
+		parser.error('-d, -m and -o are required without -b')
+	if len(args.output) != 3*len(args.directories):
+		parser.error('need three output files per directory')
 	maxCores=args.maxCores
 	outputFiles=args.output
 	end='.csv'
@@ -8,7 +8,11 @@ sh d.sh 30000
 sleep 10
 echo "DONE WITH D"
 
-python postProcess.py -d goTree/ dTree/ -m 32 -o goSpeed1.png goScale1.png goData1.p dSpeed1.png dScale1.png dData1.p
+sh cpp.sh 30000
+sleep 10
+echo "DONE WITH C++"
+
+python postProcess.py -d goTree/ dTree/ cppTree/ -m 32 -o goSpeed1.png goScale1.png goData1.p dSpeed1.png dScale1.png dData1.p cppSpeed1.png cppScale1.png cppData1.p
 
 
 echo "DONE WITH ONE"
@@ -22,7 +26,11 @@ sh d.sh 60000
 sleep 10
 echo "DONE WITH D"
 
-python postProcess.py -d goTree/ dTree/ -m 32 -o goSpeed2.png goScale2.png goData2.p dSpeed2.png dScale2.png dData2.p
+sh cpp.sh 60000
+sleep 10
+echo "DONE WITH C++"
+
+python postProcess.py -d goTree/ dTree/ cppTree/ -m 32 -o goSpeed2.png goScale2.png goData2.p dSpeed2.png dScale2.png dData2.p cppSpeed2.png cppScale2.png cppData2.p
 
 echo "DONE WITH TWO"
 sleep 10
@@ -35,7 +43,11 @@ sh d.sh 120000
 sleep 10
 echo "DONE WITH D"
 
-python postProcess.py -d goTree/ dTree/ -m 32 -o goSpeed3.png goScale3.png goData3.p dSpeed3.png dScale3.png dData3.p
+sh cpp.sh 120000
+sleep 10
+echo "DONE WITH C++"
+
+python postProcess.py -d goTree/ dTree/ cppTree/ -m 32 -o goSpeed3.png goScale3.png goData3.p dSpeed3.png dScale3.png dData3.p cppSpeed3.png cppScale3.png cppData3.p
 
 echo "DONE WITH THREE"
 
@@ -49,12 +61,18 @@ sh d.sh 240000
 sleep 10
 echo "DONE WITH D"
 
-python postProcess.py -d goTree/ dTree/ -m 32 -o goSpeed4.png goScale4.png goData4.p dSpeed4.png dScale4.png dData4.p
+sh cpp.sh 240000
+sleep 10
+echo "DONE WITH C++"
+
+python postProcess.py -d goTree/ dTree/ cppTree/ -m 32 -o goSpeed4.png goScale4.png goData4.p dSpeed4.png dScale4.png dData4.p cppSpeed4.png cppScale4.png cppData4.p
 
 python overhead.py -i goData -o goOverhead
  
  python overhead.py -i dData -o dOverhead
 
+python overhead.py -i cppData -o cppOverhead
+
 
 
 
@@ -15,8 +15,10 @@
 
 #include <iostream>
 #include <memory>
-
-#endif
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <stdint.h>
 
 class Application {
 public:
@@ -26,6 +28,35 @@ public:
     virtual bool refine(double x, double y, double w, double h) = 0;
     virtual bool coarsen(double x, double y, double w, double h) = 0;
     
+    /*
+     * The criteria for n nodes at once, the node k being x[k], y[k], w[k],
+     * h[k] and its answer out[k], 1 or 0.  By default each node is passed
+     * to refine or coarsen, an application overrides these to evaluate the
+     * arrays in loops the compiler can vectorize
+     */
+    virtual void refineBatch(const double * x, const double * y,
+                             const double * w, const double * h, int n,
+                             uint8_t * out){
+        for(int k = 0; k < n; k++)
+            out[k] = refine(x[k],y[k],w[k],h[k]);
+    }
+    
+    virtual void coarsenBatch(const double * x, const double * y,
+                              const double * w, const double * h, int n,
+                              uint8_t * out){
+        for(int k = 0; k < n; k++)
+            out[k] = coarsen(x[k],y[k],w[k],h[k]);
+    }
+    
+    /*
+     * For an incremental update: appends to boxes, x, y, w, h each, the
+     * regions where the criteria may have changed since epoch, an epoch
+     * this set before, and sets epoch to the current one.  Returns false if
+     * it cannot tell, and the whole tree is checked, which is the default
+     */
+    virtual bool dirtyRegions(long& epoch, std::vector<double>& boxes){
+        return false;
+    }
 
 };
 
@@ -138,10 +169,19 @@ private:
  * line and the node intersect 
  */
 
+/*
+ * Moves of the segment a Line remembers for dirtyRegions, and the strips
+ * the x range of a move is cut into so that each strip's box stays thin
+ */
+#define LINE_MOVES  64
+#define LINE_PIECES 64
+
 class Line : public Application {
 public:
     Line(Segment * segment){
         seg     = segment;
+        seen    = false;
+        first   = 0;
     }
     
     ~Line(){
@@ -192,10 +232,140 @@ public:
         return !(refine(x,y,w,h)); //the segment does not intersect the node
     }
     
+    /*
+     * The intersection test without branches, the same answers as refine
+     */
+    void refineBatch(const double * x, const double * y, const double * w,
+                     const double * h, int n, uint8_t * out){
+        double x0       = seg->getx0();
+        double x1       = seg->getx1();
+        double dx       = x1 - x0;
+        //a segment running right to left misses every node
+        if(!(dx > 0)){
+            for(int k = 0; k < n; k++)
+                out[k] = 0;
+            return;
+        }
+        double a        = (seg->gety1()-seg->gety0())/dx;
+        double b        = seg->gety0() - a*x0;
+#pragma omp simd
+        for(int k = 0; k < n; k++){
+            double minX = x0 < x[k] ? x[k] : x0;
+            double maxX = x1 > x[k]+w[k] ? x[k]+w[k] : x1;
+            double ya   = a*minX + b;
+            double yb   = a*maxX + b;
+            double minY = ya < yb ? ya : yb;
+            double maxY = ya < yb ? yb : ya;
+            minY        = minY < y[k] ? y[k] : minY;
+            maxY        = maxY > y[k]+h[k] ? y[k]+h[k] : maxY;
+            out[k]      = (minX < maxX) & (minY < maxY);
+        }
+    }
+    
+    void coarsenBatch(const double * x, const double * y, const double * w,
+                      const double * h, int n, uint8_t * out){
+        refineBatch(x,y,w,h,n,out);
+        for(int k = 0; k < n; k++)
+            out[k] = !out[k];
+    }
+    
+    /*
+     * A node's answer changes only if the segment moved into or out of it,
+     * so the regions are boxes around the parts of the segment that moved,
+     * before and after each move
+     */
+    bool dirtyRegions(long& epoch, std::vector<double>& boxes){
+        record();
+        long since  = epoch;
+        epoch       = first + moves.size();
+        if(since < first)
+            return false;
+        for(size_t e = since - first; e < moves.size(); e++)
+            boxes.insert(boxes.end(), moves[e].begin(), moves[e].end());
+        return true;
+    }
+    
     Segment * getSegment(){
         return seg;
     }
     
 private:
+    /*
+     * Adds a move if the segment is not where it was last seen.  The x
+     * range of both segments is cut into LINE_PIECES strips and a strip is
+     * dirty if the two segments differ in it, so a segment that only grows
+     * or shrinks dirties the strips at its ends
+     */
+    void record(){
+        double now[4] = {seg->getx0(), seg->gety0(), seg->getx1(), seg->gety1()};
+        if(seen && now[0] == last[0] && now[1] == last[1] &&
+           now[2] == last[2] && now[3] == last[3])
+            return;
+        if(seen){
+            std::vector<double> boxes;
+            double lo   = std::min(std::min(last[0], last[2]), std::min(now[0], now[2]));
+            double hi   = std::max(std::max(last[0], last[2]), std::max(now[0], now[2]));
+            double dx   = (hi - lo)/LINE_PIECES;
+            for(int k = 0; k < LINE_PIECES; k++){
+                double a    = lo + k*dx;
+                double b    = k == LINE_PIECES-1 ? hi : a + dx;
+                double p[4], q[4];
+                bool inP    = clip(last, a, b, p);
+                bool inQ    = clip(now, a, b, q);
+                if(inP == inQ && (!inP || (p[0] == q[0] && p[1] == q[1] &&
+                                           p[2] == q[2] && p[3] == q[3])))
+                    continue;
+                double minX = a, maxX = b;
+                double minY = inP ? std::min(p[1], p[3]) : std::min(q[1], q[3]);
+                double maxY = inP ? std::max(p[1], p[3]) : std::max(q[1], q[3]);
+                if(inQ){
+                    minY    = std::min(minY, std::min(q[1], q[3]));
+                    maxY    = std::max(maxY, std::max(q[1], q[3]));
+                }
+                boxes.push_back(minX);
+                boxes.push_back(minY);
+                boxes.push_back(maxX-minX);
+                boxes.push_back(maxY-minY);
+            }
+            moves.push_back(boxes);
+            if(moves.size() > LINE_MOVES){
+                moves.pop_front();
+                first++;
+            }
+        }
+        for(int c = 0; c < 4; c++)
+            last[c] = now[c];
+        seen    = true;
+    }
+    
+    /*
+     * The part of the segment s, x0 y0 x1 y1, between x = a and x = b in
+     * out, false if there is none
+     */
+    static bool clip(const double * s, double a, double b, double * out){
+        double x0   = std::max(a, std::min(s[0], s[2]));
+        double x1   = std::min(b, std::max(s[0], s[2]));
+        if(x0 > x1)
+            return false;
+        double dx   = s[2] - s[0];
+        out[0]      = x0;
+        out[2]      = x1;
+        if(dx == 0.0){
+            out[1]  = std::min(s[1], s[3]);
+            out[3]  = std::max(s[1], s[3]);
+        }
+        else {
+            out[1]  = s[1] + (x0 - s[0])*(s[3] - s[1])/dx;
+            out[3]  = s[1] + (x1 - s[0])*(s[3] - s[1])/dx;
+        }
+        return true;
+    }
+    
     Segment * seg;
+    bool seen; //last holds where the segment was, x0 y0 x1 y1
+    double last[4];
+    std::deque<std::vector<double> > moves; //the boxes of each move
+    long first; //epoch before the first move kept
 };
+
+#endif
@@ -0,0 +1,477 @@
+//
+//  DistributedQuadTree.cpp
+//
+//  See DistributedQuadTree.h for more detailed comments
+//
+//
+
+#include "DistributedQuadTree.h"
+
+using namespace std;
+
+//cells of the finest grid along a side of a node at the level
+static uint64_t side(int level){
+    return 1ULL << (LINEAR_MAX_DEPTH - level);
+}
+
+//keys a node at the level covers
+static uint64_t span(int level){
+    return mortonSpan(level);
+}
+
+static bool keyLess(const LinearNode& node, uint64_t key){
+    return node.key < key;
+}
+
+static bool keyGreater(uint64_t key, const LinearNode& node){
+    return key < node.key;
+}
+
+//index of the node of a sorted list with the last key up to key, -1 if none
+static long locate(const vector<LinearNode>& list, uint64_t key){
+    return upper_bound(list.begin(), list.end(), key, keyGreater) -
+           list.begin() - 1;
+}
+
+/*
+ * Children of a node on each of its faces, north, south, east and west
+ */
+static const int faceChildren[4][2] = {{2,3},{0,1},{1,3},{0,2}};
+
+/*
+ * Constructor
+ */
+DistributedQuadTree::DistributedQuadTree(double x, double y, double width,
+                                         double height, int numCells, int max,
+                                         Application * application,
+                                         MPI_Comm communicator){
+    app             = application;
+    comm            = communicator;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    MPI_Type_contiguous(sizeof(LinearNode), MPI_BYTE, &nodeType);
+    MPI_Type_commit(&nodeType);
+    rootX           = x;
+    rootY           = y;
+    rootWidth       = width;
+    rootHeight      = height;
+    int numLevels   = 0; //stores the number of levels in the tree
+    int i           = numCells;
+    while(i>>=1)
+        ++numLevels;
+
+    //the initial decomposition is every node of its level, each rank taking
+    //an equal run of them in key order
+    int level       = numLevels/2;
+    uint64_t n      = 1ULL << (2*level);
+    uint64_t lo     = n*rank/size;
+    uint64_t hi     = n*(rank+1)/size;
+    leaves.reserve(hi - lo);
+    for(uint64_t k = lo; k < hi; k++)
+        leaves.push_back(LinearNode(k*span(level), level));
+
+    setMaxLevel(max);
+    tolerance       = PARTITION_TOLERANCE;
+    time            = false;
+    moved           = 0;
+    findStarts();
+    exchangeGhosts();
+}
+
+/*
+ * Destructor
+ */
+DistributedQuadTree::~DistributedQuadTree(){
+    MPI_Type_free(&nodeType);
+}
+
+/*
+ * Updates this rank's leaves using refinement and coarsening criteria, then
+ * balances the ranks if needed and rebuilds the ghosts
+ * Times the phases of the update if time is true
+ */
+void DistributedQuadTree::update(){
+    stats.reset();
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    vector<LinearNode> next;
+    next.reserve(leaves.size());
+    if(!leaves.empty())
+        checkCriteria(LinearNode(0,0), 0, leaves.size(), next);
+    leaves.swap(next);
+
+    std::chrono::steady_clock::time_point exchange;
+    if(time)
+        exchange = UpdateStats::now();
+    if(imbalance() > 1.0 + tolerance)
+        partition();
+    else {
+        moved = 0;
+        exchangeGhosts();
+    }
+    if(time){
+        stats.partition = UpdateStats::since(exchange);
+        stats.total     = UpdateStats::since(start);
+        stats.criteria  = stats.total - stats.allocation - stats.deletion -
+                          stats.partition;
+    }
+}
+
+/*
+ * Recursive helper method for updating the tree, which only goes down to
+ * the children holding some of this rank's leaves
+ */
+void DistributedQuadTree::checkCriteria(const LinearNode& node, size_t lo,
+                                        size_t hi, vector<LinearNode>& next){
+    bool local = isLocal(node);
+    if(local && hi - lo == 1 && leaves[lo].level == node.level){
+        if(refine(node)){
+            //the criteria of the new nodes are timed with their allocation
+            std::chrono::steady_clock::time_point start;
+            if(time)
+                start       = UpdateStats::now();
+            fullyRefine(node, next);
+            if(time)
+                stats.allocation += UpdateStats::since(start);
+        }
+        else
+            next.push_back(node);
+    }
+    else if(local && coarsen(node)){
+        //the leaves below are dropped by not copying them
+        next.push_back(node);
+        stats.destroyed += descendants(hi - lo);
+    }
+    else{
+        //split the run of leaves between the children
+        for(int c = 0; c < 4; c++){
+            LinearNode ch   = child(node, c);
+            size_t end      = hi;
+            if(c < 3)
+                end = lower_bound(leaves.begin()+lo, leaves.begin()+hi,
+                                  ch.key + span(ch.level), keyLess) -
+                      leaves.begin();
+            if(end > lo)
+                checkCriteria(ch, lo, end, next);
+            lo              = end;
+        }
+    }
+}
+
+/*
+ * Returns a boolean determining if the node should be coarsened
+ */
+bool DistributedQuadTree::coarsen(const LinearNode& node){
+    vector<double> b = getBounds(node);
+    return app->coarsen(b[0],b[1],b[2],b[3]);
+}
+
+/*
+ * Returns a boolean determining if the node should be refined
+ */
+bool DistributedQuadTree::refine(const LinearNode& node){
+    if(node.level >= maxLevel){
+        return false;
+    }
+
+    else {
+        vector<double> b = getBounds(node);
+        return app->refine(b[0],b[1],b[2],b[3]);
+    }
+
+}
+
+/*
+ * Refines the nodes as far as necessary:
+ *
+ * To the maximum level or
+ * The refinement criteria is no longer satisfied
+ */
+void DistributedQuadTree::fullyRefine(const LinearNode& node,
+                                      vector<LinearNode>& next){
+    stats.created += 4;
+    for(int c = 0; c < 4; c++){
+        LinearNode ch = child(node, c);
+        if(refine(ch))
+            fullyRefine(ch, next);
+        else
+            next.push_back(ch);
+    }
+}
+
+LinearNode DistributedQuadTree::child(const LinearNode& node, int type){
+    return LinearNode(node.key + type*span(node.level+1), node.level+1);
+}
+
+//every node above the leaves has four children, so a node with n leaves
+//below it has (4n-1)/3 nodes in its subtree
+long DistributedQuadTree::descendants(size_t n){
+    return (4*long(n)-1)/3 - 1;
+}
+
+bool DistributedQuadTree::isLocal(const LinearNode& node){
+    return node.key >= starts[rank] &&
+           node.key + span(node.level) <= starts[rank+1];
+}
+
+int DistributedQuadTree::owner(const LinearNode& node){
+    return upper_bound(starts.begin(), starts.begin()+size, node.key) -
+           starts.begin() - 1;
+}
+
+/************************* PARTITIONING **********************************/
+
+double DistributedQuadTree::imbalance(){
+    long n = leaves.size();
+    long total;
+    long most;
+    MPI_Allreduce(&n, &total, 1, MPI_LONG, MPI_SUM, comm);
+    MPI_Allreduce(&n, &most, 1, MPI_LONG, MPI_MAX, comm);
+    if(total == 0)
+        return 1.0;
+    return double(most)*size/total;
+}
+
+void DistributedQuadTree::partition(){
+    long n      = leaves.size();
+    long first  = 0; //global index of this rank's first leaf
+    long total;
+    MPI_Exscan(&n, &first, 1, MPI_LONG, MPI_SUM, comm);
+    if(rank == 0)
+        first   = 0;
+    MPI_Allreduce(&n, &total, 1, MPI_LONG, MPI_SUM, comm);
+
+    //rank r gets the leaves from total*r/size up to total*(r+1)/size
+    vector<int> sendCounts(size, 0);
+    vector<int> sendDispls(size, 0);
+    for(int r = 0; r < size; r++){
+        long lo = max(first, total*r/size);
+        long hi = min(first + n, total*(r+1)/size);
+        if(hi > lo){
+            sendCounts[r] = hi - lo;
+            sendDispls[r] = lo - first;
+        }
+    }
+    vector<int> recvCounts(size);
+    vector<int> recvDispls(size, 0);
+    MPI_Alltoall(&sendCounts[0], 1, MPI_INT, &recvCounts[0], 1, MPI_INT, comm);
+    for(int r = 1; r < size; r++)
+        recvDispls[r] = recvDispls[r-1] + recvCounts[r-1];
+
+    vector<LinearNode> next(recvDispls[size-1] + recvCounts[size-1]);
+    MPI_Alltoallv(leaves.empty() ? NULL : &leaves[0], &sendCounts[0],
+                  &sendDispls[0], nodeType, next.empty() ? NULL : &next[0],
+                  &recvCounts[0], &recvDispls[0], nodeType, comm);
+    moved       = n - sendCounts[rank];
+    leaves.swap(next);
+    findStarts();
+    exchangeGhosts();
+}
+
+void DistributedQuadTree::findStarts(){
+    //an empty rank starts where the next one does
+    uint64_t first  = leaves.empty() ? UINT64_MAX : leaves[0].key;
+    starts.resize(size+1);
+    MPI_Allgather(&first, 1, MPI_UINT64_T, &starts[0], 1, MPI_UINT64_T, comm);
+    starts[size]    = span(0);
+    for(int r = size-1; r >= 0; r--){
+        if(starts[r] == UINT64_MAX)
+            starts[r] = starts[r+1];
+    }
+}
+
+void DistributedQuadTree::exchangeGhosts(){
+    vector<vector<LinearNode> > out(size);
+    uint64_t n  = side(0);
+    for(vector<LinearNode>::iterator IT = leaves.begin(); IT!=leaves.end(); IT++){
+        uint64_t i  = mortonCompact(IT->key);
+        uint64_t j  = mortonCompact(IT->key >> 1);
+        uint64_t s  = side(IT->level);
+
+        //the node of the same size across each face, if inside the space
+        bool inside[4]  = {j+s < n, j >= s, i+s < n, i >= s};
+        uint64_t ni[4]  = {i, i, i+s, i-s};
+        uint64_t nj[4]  = {j+s, j-s, j, j};
+
+        for(int d = 0; d < 4; d++){
+            if(!inside[d])
+                continue;
+            LinearNode across(mortonEncode(ni[d],nj[d]), IT->level);
+            if(isLocal(across))
+                continue;
+            //every rank holding part of the node across has a leaf
+            //touching this one
+            uint64_t end = across.key + span(across.level);
+            for(int r = owner(across); r < size && starts[r] < end; r++){
+                if(r == rank || starts[r] == starts[r+1])
+                    continue;
+                if(out[r].empty() || !(out[r].back() == *IT))
+                    out[r].push_back(*IT);
+            }
+        }
+    }
+
+    vector<LinearNode> send;
+    vector<int> sendCounts(size);
+    vector<int> sendDispls(size);
+    for(int r = 0; r < size; r++){
+        sendDispls[r] = send.size();
+        sendCounts[r] = out[r].size();
+        send.insert(send.end(), out[r].begin(), out[r].end());
+    }
+    vector<int> recvCounts(size);
+    vector<int> recvDispls(size, 0);
+    MPI_Alltoall(&sendCounts[0], 1, MPI_INT, &recvCounts[0], 1, MPI_INT, comm);
+    for(int r = 1; r < size; r++)
+        recvDispls[r] = recvDispls[r-1] + recvCounts[r-1];
+
+    //the ranks' segments are in key order, so the ghosts arrive sorted
+    ghosts.assign(recvDispls[size-1] + recvCounts[size-1], LinearNode());
+    MPI_Alltoallv(send.empty() ? NULL : &send[0], &sendCounts[0],
+                  &sendDispls[0], nodeType, ghosts.empty() ? NULL : &ghosts[0],
+                  &recvCounts[0], &recvDispls[0], nodeType, comm);
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+int DistributedQuadTree::getMaxLevel(){
+    return maxLevel;
+}
+
+void DistributedQuadTree::setMaxLevel(int level){
+    //the keys have no room below LINEAR_MAX_DEPTH
+    maxLevel = level < LINEAR_MAX_DEPTH ? level : LINEAR_MAX_DEPTH;
+}
+
+double DistributedQuadTree::getTolerance(){
+    return tolerance;
+}
+
+void DistributedQuadTree::setTolerance(double t){
+    tolerance = t;
+}
+
+bool DistributedQuadTree::getTime(){
+    return time;
+}
+void DistributedQuadTree::setTime(bool t){
+    time = t;
+}
+
+const UpdateStats& DistributedQuadTree::getStats(){
+    return stats;
+}
+
+long DistributedQuadTree::getMoved(){
+    return moved;
+}
+
+int DistributedQuadTree::getRank(){
+    return rank;
+}
+
+int DistributedQuadTree::getSize(){
+    return size;
+}
+
+int DistributedQuadTree::countLeaves(){
+    return leaves.size();
+}
+
+int DistributedQuadTree::countGhosts(){
+    return ghosts.size();
+}
+
+long DistributedQuadTree::countGlobalLeaves(){
+    long n = leaves.size();
+    long total;
+    MPI_Allreduce(&n, &total, 1, MPI_LONG, MPI_SUM, comm);
+    return total;
+}
+
+//memory usage
+int DistributedQuadTree::storage(){
+    return (leaves.size() + ghosts.size())*sizeof(LinearNode);
+}
+
+void DistributedQuadTree::findLeaves(std::vector<LinearNode>& list){
+    list.insert(list.end(), leaves.begin(), leaves.end());
+}
+
+void DistributedQuadTree::findGhosts(std::vector<LinearNode>& list){
+    list.insert(list.end(), ghosts.begin(), ghosts.end());
+}
+
+std::vector<double> DistributedQuadTree::getBounds(const LinearNode& node){
+    vector<double> bounds;
+    bounds.push_back(rootX + ldexp(rootWidth*mortonCompact(node.key),
+                                   -LINEAR_MAX_DEPTH));
+    bounds.push_back(rootY + ldexp(rootHeight*mortonCompact(node.key >> 1),
+                                   -LINEAR_MAX_DEPTH));
+    bounds.push_back(ldexp(rootWidth, -node.level));
+    bounds.push_back(ldexp(rootHeight, -node.level));
+    return bounds;
+}
+
+std::vector<double> DistributedQuadTree::getDimensions(){
+    vector<double> dims;
+    dims.push_back(rootX);
+    dims.push_back(rootY);
+    dims.push_back(rootWidth);
+    dims.push_back(rootHeight);
+    return dims;
+}
+
+
+/************************* NEIGHBOR FINDING ******************************/
+
+const LinearNode * DistributedQuadTree::leafHolding(uint64_t key){
+    if(key >= starts[rank] && key < starts[rank+1])
+        return &leaves[locate(leaves, key)];
+    long g = locate(ghosts, key);
+    if(g < 0 || key >= ghosts[g].key + span(ghosts[g].level))
+        return NULL;
+    return &ghosts[g];
+}
+
+void DistributedQuadTree::getNeighbors(const LinearNode& node,
+                                       std::vector<std::vector<LinearNode> >& neighbors){
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    uint64_t i  = mortonCompact(node.key);
+    uint64_t j  = mortonCompact(node.key >> 1);
+    uint64_t s  = side(node.level);
+    uint64_t n  = side(0);
+
+    //the node of the same size across each face, if inside the space
+    bool inside[4]  = {j+s < n, j >= s, i+s < n, i >= s};
+    uint64_t ni[4]  = {i, i, i+s, i-s};
+    uint64_t nj[4]  = {j+s, j-s, j, j};
+
+    for(int d = 0; d < 4; d++){
+        if(!inside[d])
+            continue;
+        faceLeaves(LinearNode(mortonEncode(ni[d],nj[d]), node.level), d^1,
+                   neighbors[d]);
+    }
+    if(time)
+        stats.neighbors += UpdateStats::since(start);
+}
+
+/*
+ * A cell on another rank that no ghost holds is in a leaf that touches no
+ * leaf of this rank, so it is smaller than the node and the node's face
+ * children are searched instead
+ */
+void DistributedQuadTree::faceLeaves(const LinearNode& node, int face,
+                                     std::vector<LinearNode>& list){
+    const LinearNode * leaf = leafHolding(node.key);
+    if(leaf != NULL && leaf->level <= node.level)
+        list.push_back(*leaf);
+    else if(node.level < maxLevel){
+        faceLeaves(child(node, faceChildren[face][0]), face, list);
+        faceLeaves(child(node, faceChildren[face][1]), face, list);
+    }
+}
@@ -0,0 +1,256 @@
+//
+//  DistributedQuadTree.h
+//
+/*
+ * The linear quad tree of LinearQuadTree spread over the ranks of an MPI
+ * communicator.  The leaves, sorted by Morton key, are cut into one
+ * contiguous segment of the curve per rank: rank r holds the leaves with
+ * keys from start(r) up to start(r+1), and every rank knows the starts, so
+ * the owner of any node is found by a binary search without asking.  Every
+ * rank has its own copy of the Application, with the same criteria.
+ *
+ * update refines and coarsens each rank's leaves where they are.  A leaf
+ * refines on its own rank, and a node coarsens only if all of its keys are
+ * on one rank, so a family split between two ranks stays refined until a
+ * repartition brings it together.  The segments stay where they were, so
+ * the leaf counts drift apart as the tree changes; once the largest is more
+ * than the tolerance above the average, update repartitions: each rank
+ * works out from the prefix sum of the counts which ranks its leaves go to
+ * under an equal split, and the runs of leaves are moved with one
+ * MPI_Alltoallv, a rank's leaves staying contiguous along the curve.
+ *
+ * After every update the ghost layer is rebuilt: each rank sends every leaf
+ * with a face on another rank's segment to that rank, in one more
+ * MPI_Alltoallv, so the face neighbors of a rank's leaves are all among its
+ * leaves and ghosts and getNeighbors needs no communication.
+ *
+ * The constructor, update, partition, imbalance and countGlobalLeaves are
+ * collective, every rank must call them together.
+ */
+//
+
+#ifndef ____DistributedQuadTree__
+#define ____DistributedQuadTree__
+
+#include <iostream>
+#include <cstdio>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <mpi.h>
+#include "Application.h"
+#include "LinearQuadTree.h"
+#include "Morton.h"
+#include "UpdateStats.h"
+
+/*
+ * How far above the average leaf count the largest may drift before update
+ * repartitions, as a fraction of the average
+ */
+#define PARTITION_TOLERANCE 0.1
+
+class DistributedQuadTree {
+public:
+
+    /*
+     * Constructor that initializes the tree on the ranks of comm, takes in
+     * the lower left corner and size of the space, the number of cells in
+     * the initial decomposition (must be a power of 4), which are split
+     * evenly between the ranks, and the maximum level, which is at most
+     * LINEAR_MAX_DEPTH
+     */
+    DistributedQuadTree(double x,double y, double width, double height,
+                        int numCells,int max,Application * app,
+                        MPI_Comm comm);
+
+    /*
+     * Destructor
+     */
+    virtual ~DistributedQuadTree();
+
+    /*
+     * Refines and coarsens this rank's leaves until the desired refinement
+     * is reached, repartitions if the ranks' leaf counts have drifted and
+     * rebuilds the ghosts
+     */
+    void update();
+
+    /*
+     * Moves the leaves between the ranks so each holds an equal share of
+     * them, contiguous along the curve, and rebuilds the ghosts
+     */
+    void partition();
+
+    /*
+     * Returns the largest leaf count of the ranks over the average
+     */
+    double imbalance();
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(const LinearNode& node);
+    virtual bool coarsen(const LinearNode& node);
+
+    /*
+     * Returns the rank holding a node, the rank of its first key
+     */
+    int owner(const LinearNode& node);
+
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    /*
+     * Returns this rank's leaves and its ghosts, the other ranks' leaves
+     * across their faces, in Morton order
+     */
+    void findLeaves(std::vector<LinearNode>& list);
+    void findGhosts(std::vector<LinearNode>& list);
+
+    /*
+     * Method for getting the neighbors of one of this rank's leaves, in the
+     * same four vectors as QuadTree: north, south, east and west.  The
+     * neighbors on other ranks are ghosts
+     */
+    void getNeighbors(const LinearNode& node,
+                      std::vector<std::vector<LinearNode> >& neighbors);
+
+    /*
+     * Returns the lower left corner, width and height of a node
+     */
+    std::vector<double> getBounds(const LinearNode& node);
+
+    /*
+     * Method for getting dimensions of quad tree
+     */
+    std::vector<double> getDimensions();
+
+    /*
+     * Getter and setter for max level of the tree
+     */
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    /*
+     * Getter and setter for how far the leaf counts may drift before update
+     * repartitions
+     */
+    double getTolerance();
+    void setTolerance(double t);
+
+    /*
+     * Getter and setter to turn update timing on/off
+     */
+    bool getTime();
+    void setTime(bool t);
+
+    /*
+     * Returns where the time of this rank's last update went and the nodes
+     * it created and destroyed, with partition the time spent moving leaves
+     * and exchanging ghosts
+     */
+    const UpdateStats& getStats();
+
+    /*
+     * Returns the leaves this rank sent to others in the last partition
+     */
+    long getMoved();
+
+    /*
+     * Returns this rank and the number of ranks
+     */
+    int getRank();
+    int getSize();
+
+    /*
+     * Counts this rank's leaves and ghosts, and the leaves of all the ranks
+     */
+    int countLeaves();
+    int countGhosts();
+    long countGlobalLeaves();
+
+    /*
+     * Returns the memory this rank uses to store its leaves and ghosts
+     */
+    int storage();
+
+private:
+    /*
+     * Traverses this rank's part of the tree refining and coarsening the
+     * nodes, node holds this rank's leaves from lo up to hi and the leaves
+     * after updating are added to next
+     */
+    void checkCriteria(const LinearNode& node, size_t lo, size_t hi,
+                       std::vector<LinearNode>& next);
+
+    /*
+     * Refines the node as far as possible, adding the leaves to next
+     */
+    void fullyRefine(const LinearNode& node, std::vector<LinearNode>& next);
+
+    /*
+     * Sets the starts of the segments from each rank's first leaf
+     */
+    void findStarts();
+
+    /*
+     * Sends each leaf with a face on another rank's segment to that rank
+     */
+    void exchangeGhosts();
+
+    /*
+     * Returns the leaf or ghost that holds the cell with the given key on
+     * the finest grid, NULL if it is on another rank and no ghost
+     */
+    const LinearNode * leafHolding(uint64_t key);
+
+    /*
+     * Whether the keys of a node are all on this rank
+     */
+    bool isLocal(const LinearNode& node);
+
+    /*
+     * Nodes below a node with n leaves below it
+     */
+    long descendants(size_t n);
+
+    /*
+     * Adds the leaves and ghosts below node that touch one of its faces,
+     * 0 north, 1 south, 2 east and 3 west
+     */
+    void faceLeaves(const LinearNode& node, int face,
+                    std::vector<LinearNode>& list);
+
+    /*
+     * Returns a child of a node, 0 SW, 1 SE, 2 NW and 3 NE
+     */
+    LinearNode child(const LinearNode& node, int type);
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<LinearNode> leaves; //this rank's, sorted by key
+    std::vector<LinearNode> ghosts; //sorted by key
+    std::vector<uint64_t> starts; //first key of each rank, then the end
+    Application * app;
+
+    MPI_Comm comm;
+    MPI_Datatype nodeType; //a LinearNode as bytes
+    int rank;
+    int size;
+
+    double rootX;
+    double rootY;
+    double rootWidth;
+    double rootHeight;
+
+    int maxLevel;
+    double tolerance;
+    bool time;
+    UpdateStats stats;
+    long moved;
+
+};
+
+#endif /* defined(____DistributedQuadTree__) */
@@ -0,0 +1,75 @@
+//
+//  Epoch.cpp
+//
+//  See Epoch.h for more detailed comments
+//
+//
+
+#include <thread>
+#include "Epoch.h"
+
+using namespace std;
+
+#define EPOCH_IDLE UINT64_MAX
+
+/*
+ * Constructor
+ */
+EpochDomain::EpochDomain(){
+    global.store(0);
+    for(int s = 0; s < EPOCH_READERS; s++)
+        slots[s].epoch.store(EPOCH_IDLE);
+}
+
+int EpochDomain::enter(){
+    for(;;){
+        for(int s = 0; s < EPOCH_READERS; s++){
+            uint64_t idle = EPOCH_IDLE;
+            if(!slots[s].epoch.compare_exchange_strong(idle, global.load()))
+                continue;
+            //the writer may have advanced and looked at the slot before the
+            //epoch was in it, so it is announced until it stays current
+            uint64_t e;
+            while((e = global.load()) != slots[s].epoch.load())
+                slots[s].epoch.store(e);
+            return s;
+        }
+        this_thread::yield();
+    }
+}
+
+void EpochDomain::exit(int slot){
+    slots[slot].epoch.store(EPOCH_IDLE);
+}
+
+void EpochDomain::retire(void * p){
+    lock_guard<mutex> lock(limboLock);
+    limbo.push_back(make_pair(global.load(), p));
+}
+
+/*
+ * What was retired in epoch t was unlinked before the epoch passed t, so a
+ * reader that announced a later epoch started after it was unreachable
+ */
+void EpochDomain::advance(std::vector<void*>& freed){
+    uint64_t oldest = global.fetch_add(1) + 1;
+    for(int s = 0; s < EPOCH_READERS; s++){
+        uint64_t e  = slots[s].epoch.load();
+        if(e < oldest)
+            oldest  = e;
+    }
+    lock_guard<mutex> lock(limboLock);
+    size_t kept = 0;
+    for(size_t k = 0; k < limbo.size(); k++){
+        if(limbo[k].first < oldest)
+            freed.push_back(limbo[k].second);
+        else
+            limbo[kept++] = limbo[k];
+    }
+    limbo.resize(kept);
+}
+
+int EpochDomain::pending(){
+    lock_guard<mutex> lock(limboLock);
+    return limbo.size();
+}
@@ -0,0 +1,70 @@
+//
+//  Epoch.h
+//
+/*
+ * Epoch based reclamation, which lets threads read a tree while another
+ * thread changes it.  The writer unlinks what it removes and retires it
+ * here instead of freeing it, and a reader announces the epoch it started
+ * in while it reads.  When the writer advances the epoch, what was retired
+ * before the oldest epoch a reader announced cannot be reached by any
+ * reader, and is handed back for the writer to free or reuse.
+ *
+ * A reader takes one of EPOCH_READERS slots for the length of its read and
+ * waits for one if all are taken; reads do not nest.  There is one writer,
+ * but it may retire from several threads.
+ */
+//
+
+#ifndef ____Epoch__
+#define ____Epoch__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+
+#define EPOCH_READERS 64
+
+class EpochDomain {
+public:
+
+    EpochDomain();
+
+    /*
+     * Starts a read, returning the slot to pass to exit
+     */
+    int enter();
+    void exit(int slot);
+
+    /*
+     * Keeps p from being freed until no reader can reach it, the writer
+     * having already unlinked it
+     */
+    void retire(void * p);
+
+    /*
+     * Starts a new epoch and appends to freed what was retired before
+     * every reader's epoch
+     */
+    void advance(std::vector<void*>& freed);
+
+    /*
+     * Number of things retired but not yet freed
+     */
+    int pending();
+
+private:
+    //each slot on its own cache line, so readers do not share lines
+    struct Slot {
+        std::atomic<uint64_t> epoch; //EPOCH_IDLE if no reader holds it
+        char pad[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    Slot slots[EPOCH_READERS];
+    std::atomic<uint64_t> global;
+    std::mutex limboLock;
+    std::vector<std::pair<uint64_t,void*> > limbo; //epoch retired in, and what
+
+};
+
+#endif /* defined(____Epoch__) */
@@ -0,0 +1,60 @@
+//
+//  FieldData.cpp
+//
+//  See FieldData.h for more detailed comments
+//
+//
+
+#include "FieldData.h"
+
+using namespace std;
+
+/*
+ * Constructor
+ */
+FieldData::FieldData(int n){
+    numFields   = n;
+    inUse       = 0;
+    data.resize(n);
+}
+
+int FieldData::allocate(){
+    int id;
+    if(!freeIds.empty()){
+        id      = freeIds.back();
+        freeIds.pop_back();
+        for(int f = 0; f < numFields; f++)
+            data[f][id] = 0.0;
+    }
+    else {
+        id      = numFields > 0 ? data[0].size() : inUse;
+        for(int f = 0; f < numFields; f++)
+            data[f].push_back(0.0);
+    }
+    inUse++;
+    return id;
+}
+
+void FieldData::release(int id){
+    freeIds.push_back(id);
+    inUse--;
+}
+
+double * FieldData::field(int f){
+    return &data[f][0];
+}
+
+int FieldData::getNumFields(){
+    return numFields;
+}
+
+int FieldData::used(){
+    return inUse;
+}
+
+int FieldData::storage(){
+    int bytes = 0;
+    for(int f = 0; f < numFields; f++)
+        bytes += data[f].capacity()*sizeof(double);
+    return bytes;
+}
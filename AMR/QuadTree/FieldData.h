@@ -0,0 +1,57 @@
+//
+//  FieldData.h
+//
+/*
+ * The solution data of the leaves of a tree, kept apart from the tree in
+ * one array per field (structure of arrays) so a kernel sweeps each field
+ * contiguously.  Each leaf holds an id, its slot in every array; the slots
+ * of leaves that are refined or coarsened away are reused by new leaves.
+ *
+ * The arrays hold cell averages, so a QuadTree with fields attached copies
+ * a leaf's values to its children when refining and averages the leaves
+ * below a node by area when coarsening, which conserves the integral of
+ * every field.
+ */
+//
+
+#ifndef ____FieldData__
+#define ____FieldData__
+
+#include <vector>
+
+class FieldData {
+public:
+    
+    /*
+     * Constructor for numFields fields
+     */
+    FieldData(int numFields);
+    
+    /*
+     * Returns a free slot, its values 0, and takes one back
+     */
+    int allocate();
+    void release(int id);
+    
+    /*
+     * Returns the array of a field, indexed by leaf id, valid until the
+     * next allocate
+     */
+    double * field(int f);
+    
+    /*
+     * Number of fields, slots in use, and bytes the arrays take
+     */
+    int getNumFields();
+    int used();
+    int storage();
+    
+private:
+    std::vector<std::vector<double> > data;
+    std::vector<int> freeIds;
+    int numFields;
+    int inUse;
+    
+};
+
+#endif /* defined(____FieldData__) */
@@ -0,0 +1,87 @@
+//
+//  HeatSolver.cpp
+//
+//  See HeatSolver.h for more detailed comments
+//
+//
+
+#include "HeatSolver.h"
+
+using namespace std;
+
+/*
+ * Constructor
+ */
+HeatSolver::HeatSolver(QuadTree * t, int f, double diffusivity){
+    tree    = t;
+    field   = f;
+    k       = diffusivity;
+    tree->setCacheNeighbors(true);
+}
+
+void HeatSolver::setValues(double (*f)(double x, double y)){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    double * u = tree->getFields()->field(field);
+    for(vector<Node*>::iterator IT = leaves.begin(); IT!=leaves.end(); IT++)
+        u[(*IT)->id] = f(tree->getX(*IT) + tree->getWidth(*IT)/2.0,
+                         tree->getY(*IT) + tree->getHeight(*IT)/2.0);
+}
+
+void HeatSolver::step(double dt){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    int n = leaves.size();
+    change.assign(n, 0.0);
+    
+    //finding a leaf's lists changes the cache, so it is filled serially
+    for(int i = 0; i < n; i++)
+        tree->neighborLists(leaves[i]);
+    
+    double * u = tree->getFields()->field(field);
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < n; i++){
+        Node * a        = leaves[i];
+        vector<Node*> * lists = a->neighbors;
+        double aw       = tree->getWidth(a);
+        double ah       = tree->getHeight(a);
+        double flux     = 0.0;
+        for(int d = 0; d < 4; d++){
+            for(vector<Node*>::iterator IT = lists[d].begin();
+                IT!=lists[d].end(); IT++){
+                Node * b    = *IT;
+                double bw   = tree->getWidth(b);
+                double bh   = tree->getHeight(b);
+                //north and south faces run along x, east and west along y
+                double face = d < 2 ? min(aw, bw) : min(ah, bh);
+                double dist = d < 2 ? (ah + bh)/2.0 : (aw + bw)/2.0;
+                flux        += (u[b->id] - u[a->id])*face/dist;
+            }
+        }
+        change[i]       = dt*k*flux/(aw*ah);
+    }
+    for(int i = 0; i < n; i++)
+        u[leaves[i]->id] += change[i];
+}
+
+double HeatSolver::stableStep(){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    double h = 0.0;
+    for(vector<Node*>::iterator IT = leaves.begin(); IT!=leaves.end(); IT++){
+        double s = min(tree->getWidth(*IT), tree->getHeight(*IT));
+        if(h == 0.0 || s < h)
+            h = s;
+    }
+    return h*h/(4.0*k);
+}
+
+double HeatSolver::total(){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    double * u = tree->getFields()->field(field);
+    double sum = 0.0;
+    for(vector<Node*>::iterator IT = leaves.begin(); IT!=leaves.end(); IT++)
+        sum += u[(*IT)->id]*tree->getWidth(*IT)*tree->getHeight(*IT);
+    return sum;
+}
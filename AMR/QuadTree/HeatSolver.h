@@ -0,0 +1,64 @@
+//
+//  HeatSolver.h
+//
+/*
+ * An explicit finite volume solver for the heat equation u_t = k(u_xx+u_yy)
+ * on the leaves of a QuadTree, a sample of the computation an adaptive tree
+ * hosts.  The temperature is one field of the tree's FieldData, a cell
+ * average per leaf, so it follows the tree as it refines and coarsens.
+ *
+ * A step sums the fluxes across the faces of each leaf, found from the
+ * cached neighbor lists.  The flux between two leaves is k times the
+ * difference of their values over the distance between their centers,
+ * across the face they share, so it leaves one and enters the other and the
+ * total heat only changes through rounding.  The boundary is insulated.
+ */
+//
+
+#ifndef ____HeatSolver__
+#define ____HeatSolver__
+
+#include <vector>
+#include "QuadTree.h"
+#include "FieldData.h"
+
+class HeatSolver {
+public:
+    
+    /*
+     * Constructor for the heat in field of the tree's fields, which turns
+     * the tree's neighbor caching on
+     */
+    HeatSolver(QuadTree * tree, int field, double diffusivity);
+    
+    /*
+     * Sets every leaf to f at its center
+     */
+    void setValues(double (*f)(double x, double y));
+    
+    /*
+     * Advances the solution by dt, which must be at most stableStep()
+     */
+    void step(double dt);
+    
+    /*
+     * Largest stable time step on the current leaves
+     */
+    double stableStep();
+    
+    /*
+     * Integral of the field over the space
+     */
+    double total();
+    
+private:
+    QuadTree * tree;
+    int field;
+    double k;
+    
+    std::vector<Node*> leaves; //Morton order, refound every step
+    std::vector<double> change;
+    
+};
+
+#endif /* defined(____HeatSolver__) */
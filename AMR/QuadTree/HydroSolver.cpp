@@ -0,0 +1,238 @@
+//
+//  HydroSolver.cpp
+//
+//  See HydroSolver.h for more detailed comments
+//
+//
+
+#include "HydroSolver.h"
+
+//the flux components of MISH's Riemann solvers, normal momentum in VARVX
+#define VARRHO 0
+#define VARVX  1
+#define VARVY  2
+#define VARPR  3
+#include "../../MISH/common/riemann_approx.h"
+
+using namespace std;
+
+//floors of the density and pressure, as MISH's smallr
+#define SMALL_R 1e-10
+#define SMALL_P 1e-20
+
+/*
+ * Constructor
+ */
+HydroSolver::HydroSolver(QuadTree * t, int f, double g, double c){
+    tree    = t;
+    first   = f;
+    gamma   = g;
+    courant = c;
+    tree->setCacheNeighbors(true);
+}
+
+void HydroSolver::setValues(void (*f)(double x, double y, double * q)){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    FieldData * fields = tree->getFields();
+    double * u[4];
+    for(int v = 0; v < 4; v++)
+        u[v] = fields->field(first+v);
+    for(vector<Node*>::iterator IT = leaves.begin(); IT!=leaves.end(); IT++){
+        double s[4];
+        f(tree->getX(*IT) + tree->getWidth(*IT)/2.0,
+          tree->getY(*IT) + tree->getHeight(*IT)/2.0, s);
+        int id          = (*IT)->id;
+        u[0][id]        = s[0];
+        u[1][id]        = s[0]*s[1];
+        u[2][id]        = s[0]*s[2];
+        u[3][id]        = s[3]/(gamma-1.0) + 0.5*s[0]*(s[1]*s[1]+s[2]*s[2]);
+    }
+}
+
+void HydroSolver::findPrimitives(){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    int n = leaves.size();
+    int ids = 0;
+
+    //finding a leaf's lists changes the cache, so it is filled serially
+    for(int i = 0; i < n; i++){
+        tree->neighborLists(leaves[i]);
+        ids = max(ids, leaves[i]->id + 1);
+    }
+
+    FieldData * fields = tree->getFields();
+    const double * u[4];
+    for(int v = 0; v < 4; v++){
+        u[v] = fields->field(first+v);
+        q[v].resize(ids);
+    }
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < n; i++){
+        int id      = leaves[i]->id;
+        double r    = max(u[0][id], SMALL_R);
+        double vx   = u[1][id]/r;
+        double vy   = u[2][id]/r;
+        double e    = u[3][id] - 0.5*r*(vx*vx+vy*vy);
+        q[0][id]    = r;
+        q[1][id]    = vx;
+        q[2][id]    = vy;
+        q[3][id]    = max((gamma-1.0)*e, SMALL_P);
+    }
+}
+
+void HydroSolver::step(double dt){
+    findPrimitives();
+    int n = leaves.size();
+    change.assign(4*n, 0.0);
+
+    const double * r    = &q[0][0];
+    const double * vx   = &q[1][0];
+    const double * vy   = &q[2][0];
+    const double * p    = &q[3][0];
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < n; i++){
+        Node * a        = leaves[i];
+        vector<Node*> * lists = a->neighbors;
+        int ia          = a->id;
+        double aw       = tree->getWidth(a);
+        double ah       = tree->getHeight(a);
+        double sum[4]   = {0.0, 0.0, 0.0, 0.0};
+        for(int d = 0; d < 4; d++){
+            //north and east faces have the leaf on the left, and north and
+            //south faces are solved along y, with the velocities swapped
+            bool left   = d == 0 || d == 2;
+            bool alongY = d < 2;
+            double un   = alongY ? vy[ia] : vx[ia];
+            double ut   = alongY ? vx[ia] : vy[ia];
+            double f[4];
+            if(lists[d].empty()){
+                //the wall mirrors the leaf with its normal velocity reversed
+                if(left)
+                    hllcFlux(gamma, r[ia], un, ut, p[ia],
+                             r[ia], -un, ut, p[ia], f, 1);
+                else
+                    hllcFlux(gamma, r[ia], -un, ut, p[ia],
+                             r[ia], un, ut, p[ia], f, 1);
+                double face = alongY ? aw : ah;
+                double s    = left ? -face : face;
+                sum[0]      += s*f[VARRHO];
+                sum[1]      += s*(alongY ? f[VARVY] : f[VARVX]);
+                sum[2]      += s*(alongY ? f[VARVX] : f[VARVY]);
+                sum[3]      += s*f[VARPR];
+                continue;
+            }
+            for(vector<Node*>::iterator IT = lists[d].begin();
+                IT!=lists[d].end(); IT++){
+                Node * b    = *IT;
+                int ib      = b->id;
+                double bn   = alongY ? vy[ib] : vx[ib];
+                double bt   = alongY ? vx[ib] : vy[ib];
+                if(left)
+                    hllcFlux(gamma, r[ia], un, ut, p[ia],
+                             r[ib], bn, bt, p[ib], f, 1);
+                else
+                    hllcFlux(gamma, r[ib], bn, bt, p[ib],
+                             r[ia], un, ut, p[ia], f, 1);
+                double face = alongY ? min(aw, tree->getWidth(b)) :
+                                       min(ah, tree->getHeight(b));
+                double s    = left ? -face : face;
+                sum[0]      += s*f[VARRHO];
+                sum[1]      += s*(alongY ? f[VARVY] : f[VARVX]);
+                sum[2]      += s*(alongY ? f[VARVX] : f[VARVY]);
+                sum[3]      += s*f[VARPR];
+            }
+        }
+        for(int v = 0; v < 4; v++)
+            change[4*i+v] = dt*sum[v]/(aw*ah);
+    }
+    FieldData * fields = tree->getFields();
+    for(int v = 0; v < 4; v++){
+        double * u = fields->field(first+v);
+        for(int i = 0; i < n; i++)
+            u[leaves[i]->id] += change[4*i+v];
+    }
+}
+
+double HydroSolver::stableStep(){
+    findPrimitives();
+    int n = leaves.size();
+    double rate = 0.0;
+#pragma omp parallel for schedule(static) reduction(max:rate)
+    for(int i = 0; i < n; i++){
+        int id      = leaves[i]->id;
+        double c    = sqrt(gamma*q[3][id]/q[0][id]);
+        double s    = (fabs(q[1][id])+c)/tree->getWidth(leaves[i]) +
+                      (fabs(q[2][id])+c)/tree->getHeight(leaves[i]);
+        rate        = max(rate, s);
+    }
+    return courant/rate;
+}
+
+void HydroSolver::markGradients(){
+    findPrimitives();
+    int n = leaves.size();
+    double * ind = tree->getFields()->field(first+4);
+    const double * r = &q[0][0];
+#pragma omp parallel for schedule(static)
+    for(int i = 0; i < n; i++){
+        Node * a        = leaves[i];
+        vector<Node*> * lists = a->neighbors;
+        double jump     = 0.0;
+        for(int d = 0; d < 4; d++){
+            for(vector<Node*>::iterator IT = lists[d].begin();
+                IT!=lists[d].end(); IT++){
+                double ra   = r[a->id];
+                double rb   = r[(*IT)->id];
+                jump        = max(jump, fabs(ra-rb)/min(ra, rb));
+            }
+        }
+        ind[a->id]      = jump;
+    }
+}
+
+double HydroSolver::total(int v){
+    leaves.clear();
+    tree->findLeavesMorton(leaves);
+    double * u = tree->getFields()->field(first+v);
+    double sum = 0.0;
+    for(vector<Node*>::iterator IT = leaves.begin(); IT!=leaves.end(); IT++)
+        sum += u[(*IT)->id]*tree->getWidth(*IT)*tree->getHeight(*IT);
+    return sum;
+}
+
+/*
+ * DensityGradient
+ */
+DensityGradient::DensityGradient(int f, double rTol, double cTol){
+    tree        = NULL;
+    field       = f;
+    refineTol   = rTol;
+    coarsenTol  = cTol;
+}
+
+void DensityGradient::setTree(QuadTree * t){
+    tree = t;
+}
+
+bool DensityGradient::refine(double x, double y, double w, double h){
+    if(tree == NULL || tree->getFields() == NULL)
+        return false;
+    Node * leaf = tree->findNode(x+w/2.0, y+h/2.0);
+    return tree->getFields()->field(field)[leaf->id] > refineTol;
+}
+
+bool DensityGradient::coarsen(double x, double y, double w, double h){
+    if(tree == NULL || tree->getFields() == NULL)
+        return false;
+    double * ind = tree->getFields()->field(field);
+    for(int c = 0; c < 4; c++){
+        Node * leaf = tree->findNode(x + (c%2 == 0 ? 0.25 : 0.75)*w,
+                                     y + (c/2 == 0 ? 0.25 : 0.75)*h);
+        //a leaf narrower than a child is below one of the children
+        if(tree->getWidth(leaf) < 0.75*w/2.0 || ind[leaf->id] >= coarsenTol)
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,116 @@
+//
+//  HydroSolver.h
+//
+/*
+ * The 2-D Euler equations of MISH (MISH/common) solved on the leaves of a
+ * QuadTree, so the cells go where the shocks are rather than on a uniform
+ * nx*ny grid.  The density, x and y momentum and total energy are four
+ * consecutive fields of the tree's FieldData, a cell average per leaf, and
+ * a fifth field holds the refinement indicator of DensityGradient below.
+ *
+ * A step is a first order unsplit Godunov step: the flux across each face
+ * of a leaf, found from the cached neighbor lists, is the HLLC flux of MISH
+ * (riemann_approx.h) between the two leaves' states, times the length of
+ * the face they share.  Both leaves of a face solve the same Riemann problem
+ * with the southern or western leaf on the left, so what leaves one enters
+ * the other and mass, momentum and energy only change through rounding.
+ * The boundary is a reflecting wall, as in MISH.
+ *
+ * The tree should be a Neighbor tree, whose 2:1 balance keeps a face
+ * between leaves at most one level apart.
+ */
+//
+
+#ifndef ____HydroSolver__
+#define ____HydroSolver__
+
+#include <vector>
+#include "QuadTree.h"
+#include "FieldData.h"
+
+class HydroSolver {
+public:
+
+    /*
+     * Constructor for the gas in fields first to first+4 of the tree's
+     * fields, which turns the tree's neighbor caching on
+     */
+    HydroSolver(QuadTree * tree, int first, double gamma, double courant);
+
+    /*
+     * Sets every leaf to the density, velocity and pressure f writes to
+     * q[0] .. q[3] at its center
+     */
+    void setValues(void (*f)(double x, double y, double * q));
+
+    /*
+     * Advances the solution by dt, which must be at most stableStep()
+     */
+    void step(double dt);
+
+    /*
+     * Courant factor times the largest stable time step on the current
+     * leaves
+     */
+    double stableStep();
+
+    /*
+     * Sets the indicator field of each leaf to the largest relative jump
+     * in density across its faces, for DensityGradient to read in the next
+     * update
+     */
+    void markGradients();
+
+    /*
+     * Integral of the conserved variable v, 0 to 3, over the space
+     */
+    double total(int v);
+
+private:
+    /*
+     * Finds the leaves and their neighbor lists, and the primitive state
+     * of every leaf, indexed by its id
+     */
+    void findPrimitives();
+
+    QuadTree * tree;
+    int first;
+    double gamma;
+    double courant;
+
+    std::vector<Node*> leaves; //Morton order, refound every step
+    std::vector<double> q[4]; //density, velocity and pressure by leaf id
+    std::vector<double> change;
+
+};
+
+/*
+ * Refines a leaf whose indicator, set by HydroSolver::markGradients, is
+ * above refineTol, and coarsens a node whose children are all leaves with
+ * indicators below coarsenTol.  A leaf refined in an update passes its
+ * indicator to its children, so a front is refined to the maximum level in
+ * one update, and a node is coarsened by at most one level an update
+ */
+class DensityGradient : public Application {
+public:
+
+    DensityGradient(int field, double refineTol, double coarsenTol);
+
+    /*
+     * The tree whose fields hold the indicator, which must be set before
+     * the tree updates
+     */
+    void setTree(QuadTree * t);
+
+    bool refine(double x, double y, double w, double h);
+    bool coarsen(double x, double y, double w, double h);
+
+private:
+    QuadTree * tree;
+    int field;
+    double refineTol;
+    double coarsenTol;
+
+};
+
+#endif /* defined(____HydroSolver__) */
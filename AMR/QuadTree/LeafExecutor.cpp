@@ -0,0 +1,146 @@
+//
+//  LeafExecutor.cpp
+//
+//  See LeafExecutor.h for more detailed comments
+//
+//
+
+#include "LeafExecutor.h"
+
+using namespace std;
+
+/*
+ * Constructor
+ */
+LeafExecutor::LeafExecutor(int threadCount, int size){
+    numThreads      = threadCount > 0 ? threadCount : 1;
+    chunkSize       = size > 0 ? size : 1;
+    leaves          = NULL;
+    kernel          = NULL;
+    arg             = NULL;
+    steals          = 0;
+    generation      = 0;
+    busy            = 0;
+    stop            = false;
+    for(int i = 0; i < numThreads; i++)
+        deques.push_back(new WorkDeque());
+    for(int i = 1; i < numThreads; i++)
+        threads.push_back(thread(&LeafExecutor::worker, this, i));
+}
+
+/*
+ * Destructor
+ */
+LeafExecutor::~LeafExecutor(){
+    {
+        lock_guard<mutex> lk(runLock);
+        stop        = true;
+    }
+    runStart.notify_all();
+    for(vector<thread>::iterator IT = threads.begin(); IT!=threads.end(); IT++)
+        IT->join();
+    for(vector<WorkDeque*>::iterator IT = deques.begin(); IT!=deques.end(); IT++)
+        delete *IT;
+}
+
+void LeafExecutor::run(QuadTree * tree, LeafKernel k, void * a){
+    vector<Node*> list;
+    tree->findLeavesMorton(list);
+    run(list, k, a);
+}
+
+void LeafExecutor::run(std::vector<Node*>& list, LeafKernel k, void * a){
+    int numChunks = (list.size() + chunkSize - 1)/chunkSize;
+    if(numChunks == 0)
+        return;
+
+    //each thread starts with a contiguous run of the chunks
+    for(int t = 0; t < numThreads; t++){
+        deques[t]->chunks.clear();
+        for(int c = t*numChunks/numThreads; c < (t+1)*numChunks/numThreads; c++)
+            deques[t]->chunks.push_back(c);
+    }
+    leaves          = &list;
+    kernel          = k;
+    arg             = a;
+    steals          = 0;
+
+    {
+        lock_guard<mutex> lk(runLock);
+        busy        = numThreads - 1;
+        generation++;
+    }
+    runStart.notify_all();
+    work(0);
+
+    unique_lock<mutex> lk(runLock);
+    while(busy > 0)
+        runDone.wait(lk);
+}
+
+void LeafExecutor::worker(int id){
+    int seen = 0;
+    while(true){
+        {
+            unique_lock<mutex> lk(runLock);
+            while(!stop && generation == seen)
+                runStart.wait(lk);
+            if(stop)
+                return;
+            seen    = generation;
+        }
+        work(id);
+        {
+            lock_guard<mutex> lk(runLock);
+            busy--;
+            if(busy == 0)
+                runDone.notify_one();
+        }
+    }
+}
+
+void LeafExecutor::work(int id){
+    int chunk;
+    int size = leaves->size();
+    while(true){
+        bool found = take(id, chunk);
+        //no chunks are added during a run, so once every deque is empty
+        //there is nothing left to do
+        for(int v = 1; !found && v < numThreads; v++){
+            found = steal((id + v) % numThreads, chunk);
+            if(found)
+                steals++;
+        }
+        if(!found)
+            return;
+        int end = (chunk + 1)*chunkSize < size ? (chunk + 1)*chunkSize : size;
+        for(int i = chunk*chunkSize; i < end; i++)
+            kernel((*leaves)[i], arg);
+    }
+}
+
+bool LeafExecutor::take(int id, int& chunk){
+    lock_guard<mutex> lk(deques[id]->lock);
+    if(deques[id]->chunks.empty())
+        return false;
+    chunk   = deques[id]->chunks.front();
+    deques[id]->chunks.pop_front();
+    return true;
+}
+
+bool LeafExecutor::steal(int victim, int& chunk){
+    lock_guard<mutex> lk(deques[victim]->lock);
+    if(deques[victim]->chunks.empty())
+        return false;
+    chunk   = deques[victim]->chunks.back();
+    deques[victim]->chunks.pop_back();
+    return true;
+}
+
+int LeafExecutor::getNumThreads(){
+    return numThreads;
+}
+
+int LeafExecutor::getSteals(){
+    return steals;
+}
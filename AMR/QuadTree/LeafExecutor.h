@@ -0,0 +1,115 @@
+//
+//  LeafExecutor.h
+//
+/*
+ * Applies a kernel to every leaf of a QuadTree on a pool of threads, the
+ * C++ counterpart of WorkParallel in the Go and D models in
+ * AMR/ConcurrentModels.
+ *
+ * The leaves are taken in Morton order and cut into chunks of contiguous
+ * leaves, so a chunk covers a compact patch of space.  Each thread starts
+ * with its own deque holding a contiguous run of the chunks and takes them
+ * from the front; a thread whose deque is empty steals from the back of
+ * another thread's deque, which takes the chunks farthest from where the
+ * owner is working.  The calling thread works as thread 0 and the others
+ * wait between runs, so a run costs no thread creation.
+ */
+//
+
+#ifndef ____LeafExecutor__
+#define ____LeafExecutor__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "QuadTree.h"
+
+/*
+ * The work done on each leaf, arg is passed through from run
+ */
+typedef void (*LeafKernel)(Node * leaf, void * arg);
+
+class LeafExecutor {
+public:
+
+    /*
+     * Constructor that starts numThreads - 1 threads, the caller of run
+     * being the last, and cuts the leaves into chunks of chunkSize
+     */
+    LeafExecutor(int numThreads, int chunkSize);
+
+    /*
+     * Destructor, stops the threads
+     */
+    ~LeafExecutor();
+
+    /*
+     * Applies kernel to every leaf of the tree and returns when all are done
+     */
+    void run(QuadTree * tree, LeafKernel kernel, void * arg);
+
+    /*
+     * Applies kernel to every leaf in the vector, in the order given
+     */
+    void run(std::vector<Node*>& leaves, LeafKernel kernel, void * arg);
+
+    /*
+     * Returns the number of threads and the chunks stolen in the last run
+     */
+    int getNumThreads();
+    int getSteals();
+
+private:
+    /*
+     * The loop of the threads started by the constructor
+     */
+    void worker(int id);
+
+    /*
+     * Works through the chunks of the current run as thread id, its own
+     * first and then those it steals
+     */
+    void work(int id);
+
+    /*
+     * Takes a chunk from the front of id's deque or the back of victim's,
+     * false if the deque is empty
+     */
+    bool take(int id, int& chunk);
+    bool steal(int victim, int& chunk);
+
+    /*
+     * Deques of chunk numbers, one per thread
+     */
+    struct WorkDeque {
+        std::mutex lock;
+        std::deque<int> chunks;
+    };
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    int numThreads;
+    int chunkSize;
+    std::vector<std::thread> threads;
+    std::vector<WorkDeque*> deques;
+
+    //the current run
+    std::vector<Node*> * leaves;
+    LeafKernel kernel;
+    void * arg;
+    std::atomic<int> steals;
+
+    //starting and stopping the threads
+    std::mutex runLock;
+    std::condition_variable runStart;
+    std::condition_variable runDone;
+    int generation; //counts runs, a thread works once per generation
+    int busy; //threads still working on the current run
+    bool stop;
+
+};
+
+#endif /* defined(____LeafExecutor__) */
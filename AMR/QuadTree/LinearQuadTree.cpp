@@ -0,0 +1,473 @@
+//
+//  LinearQuadTree.cpp
+//
+//  See LinearQuadTree.h for more detailed comments
+//
+//
+
+#include "LinearQuadTree.h"
+
+using namespace std;
+
+//cells of the finest grid along a side of a node at the level
+static uint64_t side(int level){
+    return 1ULL << (LINEAR_MAX_DEPTH - level);
+}
+
+//keys a node at the level covers
+static uint64_t span(int level){
+    return mortonSpan(level);
+}
+
+static bool keyLess(const LinearNode& node, uint64_t key){
+    return node.key < key;
+}
+
+static bool keyGreater(uint64_t key, const LinearNode& node){
+    return key < node.key;
+}
+
+/*
+ * Children of a node on each of its faces, north, south, east and west
+ */
+static const int faceChildren[4][2] = {{2,3},{0,1},{1,3},{0,2}};
+
+/*
+ * Constructor
+ */
+LinearQuadTree::LinearQuadTree(double x, double y, double width, double height,
+                               int numCells, int max, Application * application){
+    app             = application;
+    rootX           = x;
+    rootY           = y;
+    rootWidth       = width;
+    rootHeight      = height;
+    int numLevels   = 0; //stores the number of levels in the tree
+    int i           = numCells;
+    while(i>>=1)
+        ++numLevels;
+
+    //the initial decomposition is every node of its level, in key order
+    int level       = numLevels/2;
+    uint64_t n      = 1ULL << (2*level);
+    leaves.reserve(n);
+    for(uint64_t k = 0; k < n; k++)
+        leaves.push_back(LinearNode(k*span(level), level));
+
+    setMaxLevel(max);
+    time            = false;
+}
+
+/*
+ * Destructor
+ */
+LinearQuadTree::~LinearQuadTree(){
+}
+
+/*
+ * Updates the tree using refinement and coarsening criteria
+ * Times the phases of the update if time is true
+ */
+void LinearQuadTree::update(){
+    stats.reset();
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    vector<LinearNode> next;
+    next.reserve(leaves.size());
+    checkCriteria(LinearNode(0,0), 0, leaves.size(), next);
+    leaves.swap(next);
+    if(time){
+        stats.total     = UpdateStats::since(start);
+        stats.criteria  = stats.total - stats.allocation - stats.deletion;
+    }
+}
+
+/*
+ * Recursive helper method for updating the tree
+ */
+void LinearQuadTree::checkCriteria(const LinearNode& node, size_t lo,
+                                   size_t hi, vector<LinearNode>& next){
+    if(hi - lo == 1 && leaves[lo].level == node.level){
+        if(refine(node)){
+            //the criteria of the new nodes are timed with their allocation
+            std::chrono::steady_clock::time_point start;
+            if(time)
+                start       = UpdateStats::now();
+            fullyRefine(node, next);
+            if(time)
+                stats.allocation += UpdateStats::since(start);
+        }
+        else
+            next.push_back(node);
+    }
+    else if(coarsen(node)){
+        //the leaves below are dropped by not copying them
+        next.push_back(node);
+        stats.destroyed += descendants(hi - lo);
+    }
+    else{
+        //split the run of leaves between the children
+        for(int c = 0; c < 4; c++){
+            LinearNode ch   = child(node, c);
+            size_t end      = hi;
+            if(c < 3)
+                end = lower_bound(leaves.begin()+lo, leaves.begin()+hi,
+                                  ch.key + span(ch.level), keyLess) -
+                      leaves.begin();
+            checkCriteria(ch, lo, end, next);
+            lo              = end;
+        }
+    }
+}
+
+/*
+ * Returns a boolean determining if the node should be coarsened
+ */
+bool LinearQuadTree::coarsen(const LinearNode& node){
+    vector<double> b = getBounds(node);
+    return app->coarsen(b[0],b[1],b[2],b[3]);
+}
+
+/*
+ * Returns a boolean determining if the node should be refined
+ */
+bool LinearQuadTree::refine(const LinearNode& node){
+    if(node.level >= maxLevel){
+        return false;
+    }
+
+    else {
+        vector<double> b = getBounds(node);
+        return app->refine(b[0],b[1],b[2],b[3]);
+    }
+
+}
+
+/*
+ * Refines a leaf node by replacing it with its four children
+ */
+void LinearQuadTree::refineNode(const LinearNode& node){
+    size_t i = lowerBound(node.key);
+    if(i == leaves.size() || !(leaves[i] == node))
+        return; //not a leaf
+    leaves[i] = child(node, 0);
+    LinearNode rest[3] = {child(node, 1), child(node, 2), child(node, 3)};
+    leaves.insert(leaves.begin()+i+1, rest, rest+3);
+    stats.created += 4;
+}
+
+/*
+ * Coarsens a node by replacing all of its descendants with it
+ */
+void LinearQuadTree::coarsenNode(const LinearNode& node){
+    size_t lo = lowerBound(node.key);
+    size_t hi = lowerBound(node.key + span(node.level));
+    if(lo == hi)
+        return;
+    leaves[lo] = node;
+    leaves.erase(leaves.begin()+lo+1, leaves.begin()+hi);
+    stats.destroyed += descendants(hi - lo);
+}
+
+/*
+ * Refines the nodes as far as necessary:
+ *
+ * To the maximum level or
+ * The refinement criteria is no longer satisfied
+ */
+void LinearQuadTree::fullyRefine(const LinearNode& node,
+                                 vector<LinearNode>& next){
+    stats.created += 4;
+    for(int c = 0; c < 4; c++){
+        LinearNode ch = child(node, c);
+        if(refine(ch))
+            fullyRefine(ch, next);
+        else
+            next.push_back(ch);
+    }
+}
+
+LinearNode LinearQuadTree::child(const LinearNode& node, int type){
+    return LinearNode(node.key + type*span(node.level+1), node.level+1);
+}
+
+LinearNode LinearQuadTree::parent(const LinearNode& node){
+    if(node.level == 0)
+        return node;
+    return LinearNode(node.key & ~(span(node.level-1)-1), node.level-1);
+}
+
+//every node above the leaves has four children, so a node with n leaves
+//below it has (4n-1)/3 nodes in its subtree
+long LinearQuadTree::descendants(size_t n){
+    return (4*long(n)-1)/3 - 1;
+}
+
+bool LinearQuadTree::isLeaf(const LinearNode& node){
+    size_t i = lowerBound(node.key);
+    return i < leaves.size() && leaves[i] == node;
+}
+
+size_t LinearQuadTree::lowerBound(uint64_t key){
+    return lower_bound(leaves.begin(), leaves.end(), key, keyLess) -
+           leaves.begin();
+}
+
+size_t LinearQuadTree::locate(uint64_t key){
+    return upper_bound(leaves.begin(), leaves.end(), key, keyGreater) -
+           leaves.begin() - 1;
+}
+
+/*
+ * The leaves are already in Morton order, so the keys are written as they
+ * are and the bits split the runs of leaves as update does
+ */
+void LinearQuadTree::write(std::ostream& out, int format){
+    TreeHeader header;
+    header.format       = format;
+    header.maxLevel     = maxLevel;
+    header.x            = rootX;
+    header.y            = rootY;
+    header.width        = rootWidth;
+    header.height       = rootHeight;
+    header.count        = format == TREE_BITS ? countNodes() : leaves.size();
+    header.numFields    = 0;
+    header.write(out);
+
+    if(format == TREE_BITS){
+        BitWriter bits(out);
+        writeBits(LinearNode(0,0), 0, leaves.size(), bits);
+        bits.flush();
+    }
+    else {
+        for(size_t k = 0; k < leaves.size(); k++){
+            writeRaw(out, leaves[k].key);
+            writeRaw(out, (uint8_t) leaves[k].level);
+        }
+    }
+}
+
+void LinearQuadTree::writeBits(const LinearNode& node, size_t lo, size_t hi,
+                               BitWriter& bits){
+    bool leaf       = hi - lo == 1 && leaves[lo].level == node.level;
+    bits.put(!leaf);
+    if(leaf)
+        return;
+    for(int c = 0; c < 4; c++){
+        LinearNode ch   = child(node, c);
+        size_t end      = hi;
+        if(c < 3)
+            end = lower_bound(leaves.begin()+lo, leaves.begin()+hi,
+                              ch.key + span(ch.level), keyLess) -
+                  leaves.begin();
+        writeBits(ch, lo, end, bits);
+        lo              = end;
+    }
+}
+
+/*
+ * Reads and checks the whole stream into a new array before it replaces
+ * the leaves
+ */
+bool LinearQuadTree::read(std::istream& in){
+    TreeHeader header;
+    if(!header.read(in) || header.x != rootX || header.y != rootY ||
+       header.width != rootWidth || header.height != rootHeight)
+        return false;
+    vector<LinearNode> next;
+    uint64_t numLeaves;
+    if(header.format == TREE_BITS){
+        vector<uint8_t> bits;
+        if(!readTreeBits(in, header.count, bits, numLeaves))
+            return false;
+        next.reserve(numLeaves);
+        uint64_t pos    = 0;
+        readBits(LinearNode(0,0), bits, pos, next);
+    }
+    else {
+        vector<pair<uint64_t,int> > keys;
+        if(!readTreeKeys(in, header.count, keys))
+            return false;
+        numLeaves       = keys.size();
+        next.reserve(numLeaves);
+        for(size_t k = 0; k < keys.size(); k++)
+            next.push_back(LinearNode(keys[k].first, keys[k].second));
+    }
+    vector<double> values;
+    if(!readTreeValues(in, numLeaves, header.numFields, values))
+        return false;
+
+    leaves.swap(next);
+    setMaxLevel(header.maxLevel);
+    return true;
+}
+
+void LinearQuadTree::readBits(const LinearNode& node,
+                              const std::vector<uint8_t>& bits,
+                              uint64_t& pos, vector<LinearNode>& next){
+    if(!bitAt(bits, pos++))
+        next.push_back(node);
+    else
+        for(int c = 0; c < 4; c++)
+            readBits(child(node, c), bits, pos, next);
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+int LinearQuadTree::getMaxLevel(){
+    return maxLevel;
+}
+
+void LinearQuadTree::setMaxLevel(int level){
+    //the keys have no room below LINEAR_MAX_DEPTH
+    maxLevel = level < LINEAR_MAX_DEPTH ? level : LINEAR_MAX_DEPTH;
+}
+
+bool LinearQuadTree::getTime(){
+    return time;
+}
+void LinearQuadTree::setTime(bool t){
+    time = t;
+}
+
+double LinearQuadTree::getTotalCoarsen(){
+    return stats.deletion;
+}
+
+double LinearQuadTree::getTotalRefine(){
+    return stats.allocation;
+}
+
+const UpdateStats& LinearQuadTree::getStats(){
+    return stats;
+}
+
+//memory usage
+int LinearQuadTree::storage(){
+    return leaves.size()*sizeof(LinearNode);
+}
+
+//every node above the leaves has four children
+int LinearQuadTree::countNodes(){
+    return (4*leaves.size()-1)/3;
+}
+
+int LinearQuadTree::countLeaves(){
+    return leaves.size();
+}
+
+//find which node a given set of coordinates is located
+LinearNode LinearQuadTree::findNode(double x, double y){
+    return leaves[locate(mortonKey(x,y,rootX,rootY,rootWidth,rootHeight))];
+}
+
+void LinearQuadTree::findNodes(const double * xs, const double * ys, int n,
+                               LinearNode * out){
+    vector<pair<uint64_t,int> > queries(n);
+#pragma omp parallel for if(n >= FIND_PARALLEL_MIN)
+    for(int k = 0; k < n; k++)
+        queries[k] = make_pair(mortonKey(xs[k],ys[k],rootX,rootY,rootWidth,
+                                         rootHeight), k);
+    if(n == 0)
+        return;
+
+#pragma omp parallel if(n >= FIND_PARALLEL_MIN)
+#pragma omp single
+    findNodesHelper(LinearNode(0,0),0,leaves.size(),&queries[0],0,n,out);
+}
+
+//finds the leaves of the points lo up to hi, which are inside node and
+//its leaves llo up to lhi, sorting them by key as far down as the tree goes
+void LinearQuadTree::findNodesHelper(LinearNode node, size_t llo, size_t lhi,
+                                     std::pair<uint64_t,int> * queries,
+                                     int lo, int hi, LinearNode * out){
+    if(lhi - llo == 1 && leaves[llo].level == node.level){
+        for(int k = lo; k < hi; k++)
+            out[queries[k].second] = node;
+        return;
+    }
+    int bounds[5];
+    mortonSplit(queries,lo,hi,node.level,bounds);
+    for(int c = 0; c < 4; c++){
+        LinearNode ch   = child(node, c);
+        size_t end      = lhi;
+        if(c < 3)
+            end = lower_bound(leaves.begin()+llo, leaves.begin()+lhi,
+                              ch.key + span(ch.level), keyLess) -
+                  leaves.begin();
+        if(bounds[c] < bounds[c+1]){
+#pragma omp task if(bounds[c+1]-bounds[c] >= FIND_PARALLEL_MIN)
+            findNodesHelper(ch,llo,end,queries,bounds[c],bounds[c+1],out);
+        }
+        llo             = end;
+    }
+#pragma omp taskwait
+}
+
+void LinearQuadTree::findLeaves(std::vector<LinearNode>& list){
+    list.insert(list.end(), leaves.begin(), leaves.end());
+}
+
+std::vector<double> LinearQuadTree::getBounds(const LinearNode& node){
+    vector<double> bounds;
+    bounds.push_back(rootX + ldexp(rootWidth*mortonCompact(node.key),
+                                   -LINEAR_MAX_DEPTH));
+    bounds.push_back(rootY + ldexp(rootHeight*mortonCompact(node.key >> 1),
+                                   -LINEAR_MAX_DEPTH));
+    bounds.push_back(ldexp(rootWidth, -node.level));
+    bounds.push_back(ldexp(rootHeight, -node.level));
+    return bounds;
+}
+
+std::vector<double> LinearQuadTree::getDimensions(){
+    vector<double> dims;
+    dims.push_back(rootX);
+    dims.push_back(rootY);
+    dims.push_back(rootWidth);
+    dims.push_back(rootHeight);
+    return dims;
+}
+
+
+/************************* NEIGHBOR FINDING ******************************/
+
+void LinearQuadTree::getNeighbors(const LinearNode& node,
+                                  std::vector<std::vector<LinearNode> >& neighbors){
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    uint64_t i  = mortonCompact(node.key);
+    uint64_t j  = mortonCompact(node.key >> 1);
+    uint64_t s  = side(node.level);
+    uint64_t n  = side(0);
+
+    //the node of the same size across each face, if inside the space
+    bool inside[4]  = {j+s < n, j >= s, i+s < n, i >= s};
+    uint64_t ni[4]  = {i, i, i+s, i-s};
+    uint64_t nj[4]  = {j+s, j-s, j, j};
+
+    for(int d = 0; d < 4; d++){
+        if(!inside[d])
+            continue;
+        LinearNode across(mortonEncode(ni[d],nj[d]), node.level);
+        const LinearNode& leaf = leaves[locate(across.key)];
+        if(leaf.level <= node.level)
+            neighbors[d].push_back(leaf); //same level or less refined
+        else
+            faceLeaves(across, d^1, neighbors[d]); //more refined
+    }
+    if(time)
+        stats.neighbors += UpdateStats::since(start);
+}
+
+void LinearQuadTree::faceLeaves(const LinearNode& node, int face,
+                                std::vector<LinearNode>& list){
+    const LinearNode& leaf = leaves[locate(node.key)];
+    if(leaf.level <= node.level)
+        list.push_back(leaf);
+    else {
+        faceLeaves(child(node, faceChildren[face][0]), face, list);
+        faceLeaves(child(node, faceChildren[face][1]), face, list);
+    }
+}
@@ -0,0 +1,280 @@
+//
+//  LinearQuadTree.h
+//
+/*
+ * A linear quad tree with the same interface as QuadTree.  Instead of a tree
+ * of nodes connected by pointers only the leaves are stored, in one array
+ * sorted by the Morton key of their lower left corner on the grid of the
+ * finest level the tree can hold.  A node, leaf or not, is the key of its
+ * lower left corner and its level, so nodes are passed by value and every
+ * node is found in the array by a binary search.
+ *
+ * The Morton order is the order of a depth first traversal that visits the
+ * children SW, SE, NW, NE, so the leaves below a node are one contiguous run
+ * of the array, traversing the tree is a scan of the array and updating the
+ * tree writes a new array in one pass.  Neighbors are found by adding the
+ * node's size to its coordinates and searching for the leaf that holds the
+ * result, instead of walking up to a common ancestor and back down.
+ *
+ * findLeaves returns the leaves in Morton order, not in the NE, NW, SW, SE
+ * order of QuadTree, and the neighbors in the same order.  Refinement and
+ * coarsening criteria that look at the tree during update see it as it was
+ * when update started.
+ */
+//
+
+#ifndef ____LinearQuadTree__
+#define ____LinearQuadTree__
+
+#include <iostream>
+#include <cstdio>
+#include <math.h>
+#include <time.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "Application.h"
+#include "Morton.h"
+#include "UpdateStats.h"
+#include "TreeStream.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/*
+ * Levels the keys have room for
+ */
+#define LINEAR_MAX_DEPTH MORTON_MAX_DEPTH
+
+/*
+ * A node of the linear quad tree
+ */
+
+struct LinearNode{
+
+public:
+
+    uint64_t key; //Morton key of the lower left corner on the finest grid
+    int level; //level in tree where the node is
+
+    //constructors
+    LinearNode(){
+        key     = 0;
+        level   = 0;
+    }
+
+    LinearNode(uint64_t k, int l){
+        key     = k;
+        level   = l;
+    }
+
+    bool operator==(const LinearNode& other) const{
+        return key == other.key && level == other.level;
+    }
+
+};
+
+
+
+class LinearQuadTree {
+public:
+
+    /*
+     * Constructor that initializes the tree, takes in the lower left corner
+     * and size of the space, the number of cells in the initial
+     * decomposition (must be a power of 4) and the maximum level, which
+     * is at most LINEAR_MAX_DEPTH
+     */
+    LinearQuadTree(double x,double y, double width, double height,
+                   int numCells,int max,Application * app);
+
+    /*
+     * Destructor
+     */
+    virtual ~LinearQuadTree();
+
+    /*
+     * Refines and coarsens the quadtree until the desired refinement is reached
+     */
+    void update();
+
+    /*
+     * Refines a leaf, and coarsens a node by replacing all the leaves below
+     * it with the node
+     */
+    void refineNode(const LinearNode& node);
+    void coarsenNode(const LinearNode& node);
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(const LinearNode& node);
+    virtual bool coarsen(const LinearNode& node);
+
+    /*
+     * Returns the parent of a node and whether a node is a leaf
+     */
+    LinearNode parent(const LinearNode& node);
+    bool isLeaf(const LinearNode& node);
+
+    /*
+     * Checkpointing, as QuadTree: write puts the tree on a stream as
+     * TREE_BITS or TREE_KEYS of TreeStream.h, and read replaces the tree
+     * and its maximum level with one written by either tree for the same
+     * space, skipping any values of the leaves.  Nothing is changed and
+     * false returned if the stream does not hold a whole tree of the space
+     */
+    void write(std::ostream& out, int format);
+    bool read(std::istream& in);
+
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    /*
+     * Returns all the leaf nodes
+     */
+    void findLeaves(std::vector<LinearNode>& leaves);
+
+    /*
+     * Method for getting the neighbors of a node in the tree, in the same
+     * four vectors as QuadTree: north, south, east and west
+     */
+    void getNeighbors(const LinearNode& node,
+                      std::vector<std::vector<LinearNode> >& neighbors);
+
+    /*
+     * Returns the lower left corner, width and height of a node
+     */
+    std::vector<double> getBounds(const LinearNode& node);
+
+    /*
+     * Method for getting dimensions of quad tree
+     */
+    std::vector<double> getDimensions();
+
+    /*
+     * Getter and setter for max level of the tree
+     */
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    /*
+     * Getter and setter to turn update timing on/off
+     */
+    bool getTime();
+    void setTime(bool t);
+
+    /*
+     * Returns the total amount of time spend in coarsening and refinement
+     * in the last update.  Coarsening only drops leaves, so it takes no
+     * time of its own
+     */
+    double getTotalCoarsen();
+    double getTotalRefine();
+    
+    /*
+     * Returns where the time of the last update went and the nodes it
+     * created and destroyed, with the neighbor searches since it started
+     */
+    const UpdateStats& getStats();
+
+    /*
+     * Counts the number of nodes in the tree, the leaves and the nodes
+     * above them, and the number of leaves
+     */
+    int countNodes();
+    int countLeaves();
+
+    /*
+     * Returns the total amount of memory used to store the quad tree
+     */
+    int storage();
+
+    /*
+     * Finds the leaf node that contains the particular x,y point
+     */
+    LinearNode findNode(double x,double y);
+    
+    /*
+     * Finds the leaf nodes that contain the n points xs[k],ys[k] and stores
+     * them in out[k].  The points are sorted by Morton key down to the
+     * leaves and merged with them in one pass, large runs of points by
+     * OpenMP tasks
+     */
+    void findNodes(const double * xs, const double * ys, int n,
+                   LinearNode * out);
+
+private:
+    /*
+     * Traverses the tree refining and coarsening the nodes, node holds the
+     * leaves from lo up to hi and the leaves after updating are added to
+     * next
+     */
+    void checkCriteria(const LinearNode& node, size_t lo, size_t hi,
+                       std::vector<LinearNode>& next);
+
+    /*
+     * Refines the node as far as possible, adding the leaves to next
+     */
+    void fullyRefine(const LinearNode& node, std::vector<LinearNode>& next);
+    
+    /*
+     * Finds the leaves of a run of points inside node, which holds the
+     * leaves from llo up to lhi
+     */
+    void findNodesHelper(LinearNode node, size_t llo, size_t lhi,
+                         std::pair<uint64_t,int> * queries, int lo, int hi,
+                         LinearNode * out);
+
+    /*
+     * Returns the index of the leaf that holds the cell with the given key
+     * on the finest grid and the index of the first leaf from the key on
+     */
+    size_t locate(uint64_t key);
+    size_t lowerBound(uint64_t key);
+    
+    /*
+     * Nodes below a node with n leaves below it
+     */
+    long descendants(size_t n);
+
+    /*
+     * Adds the leaves below node that touch one of its faces, 0 north,
+     * 1 south, 2 east and 3 west
+     */
+    void faceLeaves(const LinearNode& node, int face,
+                    std::vector<LinearNode>& list);
+
+    /*
+     * Writes the bits of the nodes below and including node, which holds
+     * the leaves from lo up to hi, and adds the leaves below node the bits
+     * from pos on give to next
+     */
+    void writeBits(const LinearNode& node, size_t lo, size_t hi,
+                   BitWriter& bits);
+    void readBits(const LinearNode& node, const std::vector<uint8_t>& bits,
+                  uint64_t& pos, std::vector<LinearNode>& next);
+
+    /*
+     * Returns a child of a node, 0 SW, 1 SE, 2 NW and 3 NE
+     */
+    LinearNode child(const LinearNode& node, int type);
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<LinearNode> leaves; //sorted by key
+    Application * app;
+
+    double rootX;
+    double rootY;
+    double rootWidth;
+    double rootHeight;
+
+    int maxLevel;
+    bool time;
+    UpdateStats stats;
+
+};
+
+#endif /* defined(____LinearQuadTree__) */
@@ -0,0 +1,189 @@
+//
+//  Morton.h
+//
+//  Morton keys of the cells of the finest grid a tree can hold, shared by
+//  LinearQuadTree and the batched point location of QuadTree.  A key
+//  interleaves the bits of the x and y cell coordinates, x in the even bits
+//  and y in the odd bits, so sorting by key orders the cells along the
+//  Z-shaped curve that visits the children of a node SW, SE, NW, NE.
+//
+
+#ifndef ____Morton__
+#define ____Morton__
+
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include <utility>
+
+/*
+ * Levels the keys have room for, two bits per level
+ */
+#define MORTON_MAX_DEPTH 30
+
+/*
+ * Batches of points smaller than this are located serially
+ */
+#define FIND_PARALLEL_MIN 4096
+
+inline uint64_t mortonSpread(uint64_t v){
+    v = (v | (v << 16)) & 0x0000FFFF0000FFFFULL;
+    v = (v | (v << 8))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v << 4))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v << 2))  & 0x3333333333333333ULL;
+    v = (v | (v << 1))  & 0x5555555555555555ULL;
+    return v;
+}
+
+inline uint64_t mortonCompact(uint64_t v){
+    v = v & 0x5555555555555555ULL;
+    v = (v | (v >> 1))  & 0x3333333333333333ULL;
+    v = (v | (v >> 2))  & 0x0F0F0F0F0F0F0F0FULL;
+    v = (v | (v >> 4))  & 0x00FF00FF00FF00FFULL;
+    v = (v | (v >> 8))  & 0x0000FFFF0000FFFFULL;
+    v = (v | (v >> 16)) & 0x00000000FFFFFFFFULL;
+    return v;
+}
+
+inline uint64_t mortonEncode(uint64_t i, uint64_t j){
+    return mortonSpread(i) | (mortonSpread(j) << 1);
+}
+
+/*
+ * Keys a node at the level covers
+ */
+inline uint64_t mortonSpan(int level){
+    return 1ULL << (2*(MORTON_MAX_DEPTH - level));
+}
+
+/*
+ * Key of the finest cell holding the point x,y of the space with lower left
+ * corner x0,y0 and size w,h, points outside taken to the nearest cell
+ */
+inline uint64_t mortonKey(double x, double y, double x0, double y0,
+                          double w, double h){
+    double n    = ldexp(1.0, MORTON_MAX_DEPTH);
+    double fi   = floor((x - x0)/w*n);
+    double fj   = floor((y - y0)/h*n);
+    uint64_t i  = fi < 0 ? 0 : (fi >= n ? (uint64_t) n - 1 : (uint64_t) fi);
+    uint64_t j  = fj < 0 ? 0 : (fj >= n ? (uint64_t) n - 1 : (uint64_t) fj);
+    return mortonEncode(i, j);
+}
+
+/*
+ * Whether a key's x or y bit of a level is clear
+ */
+struct MortonBitClear {
+    uint64_t mask;
+    MortonBitClear(uint64_t m){
+        mask = m;
+    }
+    bool operator()(const std::pair<uint64_t,int>& q) const{
+        return (q.first & mask) == 0;
+    }
+};
+
+/*
+ * Sorts the (key, index) pairs lo up to hi, which are inside a node at the
+ * level, into the runs of its children SW, SE, NW, NE, and returns the
+ * start of each run and the end of the last in bounds
+ */
+inline void mortonSplit(std::pair<uint64_t,int> * q, int lo, int hi,
+                        int level, int * bounds){
+    int shift   = 2*(MORTON_MAX_DEPTH - level - 1);
+    uint64_t x  = 1ULL << shift;
+    uint64_t y  = 1ULL << (shift + 1);
+    int mid     = std::partition(q+lo, q+hi, MortonBitClear(y)) - q;
+    bounds[0]   = lo;
+    bounds[1]   = std::partition(q+lo, q+mid, MortonBitClear(x)) - q;
+    bounds[2]   = mid;
+    bounds[3]   = std::partition(q+mid, q+hi, MortonBitClear(x)) - q;
+    bounds[4]   = hi;
+}
+
+/*
+ * The spreading and compacting of the keys of three dimensional cells,
+ * 21 bits per axis every third bit
+ */
+inline uint64_t mortonSpread3(uint64_t v){
+    v = v & 0x1FFFFFULL;
+    v = (v | (v << 32)) & 0x001F00000000FFFFULL;
+    v = (v | (v << 16)) & 0x001F0000FF0000FFULL;
+    v = (v | (v << 8))  & 0x100F00F00F00F00FULL;
+    v = (v | (v << 4))  & 0x10C30C30C30C30C3ULL;
+    v = (v | (v << 2))  & 0x1249249249249249ULL;
+    return v;
+}
+
+inline uint64_t mortonCompact3(uint64_t v){
+    v = v & 0x1249249249249249ULL;
+    v = (v | (v >> 2))  & 0x10C30C30C30C30C3ULL;
+    v = (v | (v >> 4))  & 0x100F00F00F00F00FULL;
+    v = (v | (v >> 8))  & 0x001F0000FF0000FFULL;
+    v = (v | (v >> 16)) & 0x001F00000000FFFFULL;
+    v = (v | (v >> 32)) & 0x1FFFFFULL;
+    return v;
+}
+
+/*
+ * Morton keys of the cells of D dimensions, D bits per level with axis a,
+ * x first, in bits a, a+D, a+2D and so on, so the keys order the cells
+ * along the curve that visits the children of a node in the order of their
+ * index, bit a of the index set for the upper half along axis a.  The keys
+ * of two and three dimensions spread the bits with the masks above, others
+ * a bit at a time
+ */
+template<int D>
+struct MortonCode {
+    
+    //levels the keys have room for
+    static const int maxDepth = 60/D;
+    
+    static uint64_t encode(const uint64_t * c){
+        uint64_t key = 0;
+        for(int b = 0; b < maxDepth; b++)
+            for(int a = 0; a < D; a++)
+                key |= ((c[a] >> b) & 1ULL) << (D*b + a);
+        return key;
+    }
+    
+    static void decode(uint64_t key, uint64_t * c){
+        for(int a = 0; a < D; a++){
+            c[a] = 0;
+            for(int b = 0; b < maxDepth; b++)
+                c[a] |= ((key >> (D*b + a)) & 1ULL) << b;
+        }
+    }
+    
+    //keys a node at the level covers
+    static uint64_t span(int level){
+        return 1ULL << (D*(maxDepth - level));
+    }
+    
+};
+
+template<>
+inline uint64_t MortonCode<2>::encode(const uint64_t * c){
+    return mortonEncode(c[0], c[1]);
+}
+
+template<>
+inline void MortonCode<2>::decode(uint64_t key, uint64_t * c){
+    c[0] = mortonCompact(key);
+    c[1] = mortonCompact(key >> 1);
+}
+
+template<>
+inline uint64_t MortonCode<3>::encode(const uint64_t * c){
+    return mortonSpread3(c[0]) | (mortonSpread3(c[1]) << 1) |
+           (mortonSpread3(c[2]) << 2);
+}
+
+template<>
+inline void MortonCode<3>::decode(uint64_t key, uint64_t * c){
+    c[0] = mortonCompact3(key);
+    c[1] = mortonCompact3(key >> 1);
+    c[2] = mortonCompact3(key >> 2);
+}
+
+#endif /* defined(____Morton__) */
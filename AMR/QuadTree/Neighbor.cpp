@@ -12,35 +12,121 @@ using namespace std;
 
 Neighbor::Neighbor(double x,double y, double width, double height,
                    int numCells, int max, Application * app) : QuadTree(x,y,width,height, numCells, max, app){
+    setLogChanges(true);
+    dims = getDimensions();
 }
 
 Neighbor::~Neighbor(){}
 
-bool Neighbor::refine(Node * node){
-
-    return QuadTree::refine(node) && levelPassed(node);
+void Neighbor::update(){
+    QuadTree::update();
+    std::chrono::steady_clock::time_point start;
+    double allocation = stats.allocation;
+    if(getTime())
+        start = UpdateStats::now();
+    balance();
+    if(getTime()){
+        //the refining balance does is allocation
+        double t        = UpdateStats::since(start);
+        stats.total     += t;
+        stats.balance   = t - (stats.allocation - allocation);
+    }
 }
 
+/*
+ * A leaf, from a click in the visualization, is coarsened with its
+ * siblings only if they are all leaves
+ */
 bool Neighbor::coarsen(Node * node){
-    return QuadTree::coarsen(node) && node->parent->NEChild->isLeaf &&
-    node->parent->NWChild->isLeaf &&
-    node->parent->SWChild->isLeaf &&
-    node->parent->SEChild->isLeaf;
+    if(!node->isLeaf)
+        return QuadTree::coarsen(node);
+    return QuadTree::coarsen(node) && node->parent->child(NE)->isLeaf &&
+    node->parent->child(NW)->isLeaf &&
+    node->parent->child(SW)->isLeaf &&
+    node->parent->child(SE)->isLeaf;
+}
+
+void Neighbor::balance(){
+    vector<Node*> work;
+    while(!changed.empty() || !coarsened.empty()){
+        //refining in a pass logs the refined nodes for the next pass
+        work.swap(changed);
+        changed.clear();
+        for(vector<Node*>::iterator IT = work.begin(); IT!=work.end(); IT++){
+            if((*IT)->isLeaf)
+                coarsened.push_back(*IT);
+            else
+                tooCoarse(*IT);
+        }
+        work.swap(coarsened);
+        coarsened.clear();
+        for(vector<Node*>::iterator IT = work.begin(); IT!=work.end(); IT++)
+            tooFine(*IT);
+    }
+}
+
+/*
+ * The points are half a cell of the finest level across each face, at the
+ * middle of the face for a refined node, whose neighbor is too coarse if
+ * one leaf covers the whole face, and at a quarter and three quarters of
+ * it for a leaf, whose neighbor is too fine if either half of the face has
+ * more than one leaf along it
+ */
+void Neighbor::tooCoarse(Node * node){
+    double d        = dims[2]/pow(2.0,getMaxLevel()+1);
+    vector<double> b = getBounds(node);
+    double midX     = b[0] + b[2]/2.0;
+    double midY     = b[1] + b[3]/2.0;
+    double acrossX[4] = {midX, midX, b[0]+b[2]+d, b[0]-d};
+    double acrossY[4] = {b[1]+b[3]+d, b[1]-d, midY, midY};
+    for(int f = 0; f < 4; f++){
+        Node * leaf = leafAt(acrossX[f],acrossY[f]);
+        if(leaf != NULL && leaf->currentLevel < node->currentLevel){
+            refineNode(leaf);
+            markDirty(leaf);
+            //the node checks again, in case the leaf was two levels coarser
+            changed.push_back(node);
+        }
+    }
 }
 
-bool Neighbor::levelPassed(Node * node){
-    vector<Node*> vec;
-    vector<vector<Node*> > neighbors (4, vec);
-    getNeighbors(node,neighbors);
-    int newLevel = node->currentLevel+1;
-    for(vector<vector<Node*> >::iterator IT = neighbors.begin();
-        IT!=neighbors.end();IT++){
-        for(vector<Node*>::iterator direction = (*IT).begin();
-            direction!=(*IT).end();direction++){
-            if(abs(newLevel - (*direction)->currentLevel)>1)
-                return false;
+void Neighbor::tooFine(Node * node){
+    if(!node->isLeaf){
+        //refined since, its leaves are as exposed as it was
+        coarsened.push_back(node->child(NE));
+        coarsened.push_back(node->child(NW));
+        coarsened.push_back(node->child(SW));
+        coarsened.push_back(node->child(SE));
+        return;
+    }
+    double d        = dims[2]/pow(2.0,getMaxLevel()+1);
+    vector<double> b = getBounds(node);
+    double x[4]     = {b[0] + b[2]/4.0, b[0] + 3.0*b[2]/4.0, b[0] + b[2] + d,
+                       b[0] - d};
+    double y[4]     = {b[1] + b[3]/4.0, b[1] + 3.0*b[3]/4.0, b[1] + b[3] + d,
+                       b[1] - d};
+    //two points across the north, south, east and west faces
+    double px[8]    = {x[0], x[1], x[0], x[1], x[2], x[2], x[3], x[3]};
+    double py[8]    = {y[2], y[2], y[3], y[3], y[0], y[1], y[0], y[1]};
+    for(int k = 0; k < 8; k++){
+        Node * leaf = leafAt(px[k],py[k]);
+        if(leaf != NULL && leaf->currentLevel > node->currentLevel+1){
+            //the children check again, in case the leaf was three or more
+            //levels finer
+            refineNode(node);
+            markDirty(node);
+            coarsened.push_back(node->child(NE));
+            coarsened.push_back(node->child(NW));
+            coarsened.push_back(node->child(SW));
+            coarsened.push_back(node->child(SE));
+            return;
         }
     }
-    return true;
-    
-}
\ No newline at end of file
+}
+
+Node * Neighbor::leafAt(double x, double y){
+    if(x < dims[0] || y < dims[1] || x >= dims[0]+dims[2] ||
+       y >= dims[1]+dims[3])
+        return NULL;
+    return findNode(x,y);
+}
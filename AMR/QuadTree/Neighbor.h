@@ -5,8 +5,13 @@
 //  Subclass of QuadTree which will not allow a nodes to have more than one
 //  level different of refinement.
 //
-//  Achieved by overriding the global refine/coarsen methods in the QuadTree
-//  base class
+//  Achieved by balancing the tree after it changes rather than checking the
+//  neighbors before each refinement: refineNode and coarsenNode log the
+//  nodes they change, and a ripple pass refines the leaves that a change
+//  leaves more than one level coarser than a neighbor, logging them in
+//  turn.  A logged node is checked by finding the leaves at a few points
+//  just across its faces, so balancing costs a few point searches per
+//  changed node
 //
 //
 
@@ -23,11 +28,39 @@ public:
              int numCells,int max,Application * app);
     ~Neighbor();
     
-    bool refine(Node * node);
+    /*
+     * Updates the tree and then balances it
+     */
+    void update();
+    
+    /*
+     * Ripples the changes since the last balance out until no two
+     * neighboring leaves differ by more than one level
+     */
+    void balance();
+    
     bool coarsen(Node * node);
     
 private:
-    bool levelPassed(Node * node);
+    /*
+     * Refines the leaves across the faces of a refined node that are
+     * coarser than it
+     */
+    void tooCoarse(Node * node);
+    
+    /*
+     * Refines a coarsened leaf if a leaf across its faces is more than one
+     * level finer, or checks the leaves below it if it has been refined
+     */
+    void tooFine(Node * node);
+    
+    /*
+     * Finds the leaf at a point, NULL outside the space
+     */
+    Node * leafAt(double x, double y);
+    
+    std::vector<Node*> coarsened; //leaves to check with tooFine
+    std::vector<double> dims; //of the space
 };
 
-#endif /* defined(____Neighbor__) */
\ No newline at end of file
+#endif /* defined(____Neighbor__) */
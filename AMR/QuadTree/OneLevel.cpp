@@ -21,8 +21,8 @@ bool OneLevel::refine(Node * node){
 bool OneLevel::coarsen(Node * node){
     
     return QuadTree::coarsen(node) &&
-    node->parent->NEChild->isLeaf &&
-    node->parent->NWChild->isLeaf &&
-    node->parent->SWChild->isLeaf &&
-    node->parent->SEChild->isLeaf;
+    node->parent->child(NE)->isLeaf &&
+    node->parent->child(NW)->isLeaf &&
+    node->parent->child(SW)->isLeaf &&
+    node->parent->child(SE)->isLeaf;
 }
\ No newline at end of file
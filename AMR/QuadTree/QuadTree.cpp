@@ -8,23 +8,105 @@
 //
 
 #include "QuadTree.h"
+#include "../../instrument/cody.h"
 
 using namespace std;
 
+/*
+ * Node pool
+ */
+NodePool::NodePool(){
+    freeList    = NULL;
+    chunkQuads  = 0;
+    next        = 0;
+    total       = 0;
+    inUse       = 0;
+}
+
+NodePool::~NodePool(){
+    for(vector<Node*>::iterator IT = chunks.begin(); IT!=chunks.end(); IT++)
+        cody_free(*IT);
+}
+
+Node * NodePool::allocate(){
+    Node * quad;
+    if(freeList != NULL){
+        quad        = freeList;
+        freeList    = quad->children;
+    }
+    else {
+        if(next == chunkQuads){
+            chunkQuads  = chunkQuads == 0 ? MIN_QUADS_PER_CHUNK :
+                          (chunkQuads < MAX_QUADS_PER_CHUNK ? 2*chunkQuads :
+                           chunkQuads);
+            //untouched, so the pages land on the node of the thread whose
+            //pool this is, which builds the nodes
+            Node * chunk = (Node*) cody_alloc(sizeof(Node)*4*chunkQuads, 64,
+                                              CODY_FIRST_TOUCH);
+            if(chunk == NULL)
+                throw std::bad_alloc();
+            chunks.push_back(chunk);
+            total       = total + chunkQuads;
+            next        = 0;
+        }
+        quad        = chunks.back() + 4*next;
+        next++;
+    }
+    inUse++;
+    return quad;
+}
+
+void NodePool::release(Node * quad){
+    quad->children  = freeList;
+    freeList        = quad;
+    inUse--;
+}
+
+int NodePool::used(){
+    return inUse;
+}
+
+int NodePool::capacity(){
+    return total;
+}
+
+int NodePool::bytes(){
+    return total*4*sizeof(Node);
+}
+
 /*
  * Constructor
  */
 QuadTree::QuadTree(double x, double y, double width, double height,
-                   int numCells, int max, Application * app) {
-    root            = new Node(x, y, width, height, NULL, 0, -1, app);
+                   int numCells, int max, Application * application) {
+    app             = application;
+    rootX           = x;
+    rootY           = y;
+    cellWidth       = ldexp(width, -MORTON_MAX_DEPTH);
+    cellHeight      = ldexp(height, -MORTON_MAX_DEPTH);
+    for(int l = 0; l <= MORTON_MAX_DEPTH; l++){
+        widths[l]   = ldexp(width, -l);
+        heights[l]  = ldexp(height, -l);
+    }
+    taskCutoff      = 0;
+    batchCriteria   = false;
+    incremental     = false;
+    epoch           = -1;
+    cacheNeighbors  = false;
+    cachedLeaves    = 0;
+    fields          = NULL;
+    epochs          = NULL;
+    logChanges      = false;
+    time            = false;
+    addPools();
+    root            = new Node(0, 0, NULL, 0);
     int numLevels   = 0; //stores the number of levels in the tree
     int i           = numCells;
     while(i>>=1)
         ++numLevels;
  
     insert(root, (numLevels/2), 0);
-    maxLevel        = max;
-    time            = false;
+    setMaxLevel(max);
 
 }
 
@@ -41,10 +123,10 @@ void QuadTree::insert(Node * node, int levelsRemaining,int currentLevel){
         int newLevel = node->currentLevel + 1;
         refineNode(node);
         
-        insert(node->NEChild, levelsRemaining - 1, newLevel);
-        insert(node->NWChild, levelsRemaining - 1, newLevel);
-        insert(node->SWChild, levelsRemaining - 1, newLevel);
-        insert(node->SEChild, levelsRemaining - 1, newLevel);
+        insert(node->child(NE), levelsRemaining - 1, newLevel);
+        insert(node->child(NW), levelsRemaining - 1, newLevel);
+        insert(node->child(SW), levelsRemaining - 1, newLevel);
+        insert(node->child(SE), levelsRemaining - 1, newLevel);
     }
 }
 
@@ -52,69 +134,246 @@ void QuadTree::insert(Node * node, int levelsRemaining,int currentLevel){
  * Destructor
  */
 QuadTree::~QuadTree(){
-    destroyTree(root);
+    //the pools free the rest of the nodes
+    clearNeighborCache();
+    delete root;
+    delete epochs;
+    for(vector<NodePool*>::iterator IT = pools.begin(); IT!=pools.end(); IT++)
+        delete *IT;
+}
+
+NodePool * QuadTree::threadPool(){
+#ifdef _OPENMP
+    return pools[omp_get_thread_num()];
+#else
+    return pools[0];
+#endif
+}
+
+void QuadTree::addPools(){
+    size_t n = 1;
+#ifdef _OPENMP
+    n = omp_get_max_threads();
+#endif
+    while(pools.size() < n)
+        pools.push_back(new NodePool());
 }
 
 /*
- * Recursive destructor helper
+ * Recursive helper returning the quads below a node to the pool
  */
-void QuadTree::destroyTree(Node * node){
-    if(node == NULL)
-        return;
-    else {
-        destroyTree(node->NEChild);
-        destroyTree(node->NWChild);
-        destroyTree(node->SWChild);
-        destroyTree(node->SEChild);
-        
-        delete node;
+void QuadTree::destroyTree(Node * quad){
+    for(int c = 0; c < 4; c++){
+        if(!quad[c].isLeaf)
+            destroyTree(quad[c].children);
+        dropNeighbors(quad+c);
     }
+    if(epochs != NULL)
+        epochs->retire(quad);
+    else
+        threadPool()->release(quad);
+#pragma omp atomic
+    stats.destroyed += 4;
+}
+
+void QuadTree::reclaim(){
+    if(epochs == NULL)
+        return;
+    vector<void*> freed;
+    epochs->advance(freed);
+    for(size_t k = 0; k < freed.size(); k++)
+        threadPool()->release((Node*) freed[k]);
 }
 
 /*
  * Updates the tree using refinement and coarsening criteria
- * Times the refinement and coarsening if time is true
+ * Times the phases of the update if time is true
  */
 void QuadTree::update(){
+    stats.reset();
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    vector<double> boxes;
+    bool dirty = incremental && !batchCriteria &&
+                 app->dirtyRegions(epoch, boxes);
+    boxes.insert(boxes.end(), pending.begin(), pending.end());
+    pending.clear();
+    if(batchCriteria)
+        checkCriteriaBatched();
+    else if(dirty){
+        vector<int> in(boxes.size()/4);
+        for(size_t k = 0; k < in.size(); k++)
+            in[k] = k;
+        dirtyIn.resize(MORTON_MAX_DEPTH+1);
+        checkCriteriaIn(root, boxes, in);
+    }
+#ifdef _OPENMP
+    else if(taskCutoff > 0 && fields == NULL){
+        //the tasks would drop each other's lists
+        clearNeighborCache();
+        addPools();
+#pragma omp parallel
+#pragma omp single
+        checkCriteria(root);
+    }
+#endif
+    else
+        checkCriteria(root);
+    reclaim();
     if(time){
-        totalRefine     = 0;
-        totalCoarsen    = 0;
+        stats.total     = UpdateStats::since(start);
+        stats.criteria  = stats.total - stats.allocation - stats.deletion;
     }
-    checkCriteria(root);
+}
 
+void QuadTree::balance(){
+}
+
+void QuadTree::markDirty(Node * node){
+    if(!incremental)
+        return;
+    pending.push_back(getX(node));
+    pending.push_back(getY(node));
+    pending.push_back(getWidth(node));
+    pending.push_back(getHeight(node));
+}
+
+void QuadTree::setLogChanges(bool l){
+    logChanges = l;
+    changed.clear();
 }
 
 /*
  * Recursive helper method for updating the tree
  */
 void QuadTree::checkCriteria(Node * node){
-    double start, finish;
     if(node->isLeaf){
-        if(refine(node)){
-            if(time)
-                start       = clock();
+        if(refine(node))
             fullyRefine(node);
-            if(time){
-                finish      = clock();
-                totalRefine = totalRefine + (double(finish-start)/CLOCKS_PER_SEC);
+    }
+    else if(coarsen(node))
+        coarsenNode(node);
+    else if(node->currentLevel < taskCutoff){
+        //each child's subtree is a task
+#pragma omp task
+        checkCriteria(node->child(NE));
+#pragma omp task
+        checkCriteria(node->child(NW));
+#pragma omp task
+        checkCriteria(node->child(SW));
+#pragma omp task
+        checkCriteria(node->child(SE));
+#pragma omp taskwait
+    }
+    else{
+        checkCriteria(node->child(NE));
+        checkCriteria(node->child(NW));
+        checkCriteria(node->child(SW));
+        checkCriteria(node->child(SE));
+    }
+}
+
+void QuadTree::checkCriteriaIn(Node * node, const std::vector<double>& boxes,
+                               const std::vector<int>& in){
+    double x    = getX(node);
+    double y    = getY(node);
+    double w    = getWidth(node);
+    double h    = getHeight(node);
+    //a box touching the node counts, checking a node too many is harmless
+    vector<int>& here = dirtyIn[node->currentLevel];
+    here.clear();
+    for(vector<int>::const_iterator IT = in.begin(); IT!=in.end(); IT++){
+        const double * b = &boxes[4*(*IT)];
+        if(b[0] <= x+w && x <= b[0]+b[2] && b[1] <= y+h && y <= b[1]+b[3]){
+            //below a node inside a box every node reaches into it
+            if(b[0] <= x && x+w <= b[0]+b[2] && b[1] <= y && y+h <= b[1]+b[3]){
+                checkCriteria(node);
+                return;
             }
+            here.push_back(*IT);
         }
     }
-    else if(coarsen(node)){
-        if(time)
-            start           = clock();
+    if(here.empty())
+        return;
+    if(node->isLeaf){
+        if(refine(node))
+            fullyRefine(node);
+    }
+    else if(coarsen(node))
         coarsenNode(node);
-        if(time){
-            finish          = clock();
-            totalCoarsen    = totalCoarsen + (double(finish-start)/CLOCKS_PER_SEC);
-        }
-
+    else {
+        checkCriteriaIn(node->child(NE), boxes, here);
+        checkCriteriaIn(node->child(NW), boxes, here);
+        checkCriteriaIn(node->child(SW), boxes, here);
+        checkCriteriaIn(node->child(SE), boxes, here);
     }
-    else{
-        checkCriteria(node->NEChild);
-        checkCriteria(node->NWChild);
-        checkCriteria(node->SWChild);
-        checkCriteria(node->SEChild);
+}
+
+/*
+ * Level by level version of checkCriteria: the leaves of a level are asked
+ * whether to refine and the other nodes whether to coarsen, and the
+ * children of the nodes refined or kept are the next level
+ */
+void QuadTree::checkCriteriaBatched(){
+    vector<Node*> level(1, root);
+    vector<Node*> next;
+    //batch 0 holds the leaves that may refine, batch 1 the other nodes
+    vector<Node*> nodes[2];
+    vector<double> xs[2], ys[2], ws[2], hs[2];
+    vector<uint8_t> out;
+    while(!level.empty()){
+        for(int b = 0; b < 2; b++){
+            nodes[b].clear();
+            xs[b].clear();
+            ys[b].clear();
+            ws[b].clear();
+            hs[b].clear();
+        }
+        for(vector<Node*>::iterator IT = level.begin(); IT!=level.end(); IT++){
+            Node * node = *IT;
+            int b       = node->isLeaf ? 0 : 1;
+            if(b == 0 && node->currentLevel == maxLevel)
+                continue;
+            nodes[b].push_back(node);
+            xs[b].push_back(getX(node));
+            ys[b].push_back(getY(node));
+            ws[b].push_back(getWidth(node));
+            hs[b].push_back(getHeight(node));
+        }
+        next.clear();
+        
+        for(int b = 0; b < 2; b++){
+            int n   = nodes[b].size();
+            if(n == 0)
+                continue;
+            out.resize(n);
+            if(b == 0)
+                app->refineBatch(&xs[b][0],&ys[b][0],&ws[b][0],
+                                 &hs[b][0],n,&out[0]);
+            else
+                app->coarsenBatch(&xs[b][0],&ys[b][0],&ws[b][0],
+                                  &hs[b][0],n,&out[0]);
+            
+            for(int k = 0; k < n; k++){
+                Node * node = nodes[b][k];
+                if(out[k]){
+                    if(b == 0)
+                        refineNode(node);
+                    else {
+                        coarsenNode(node);
+                        continue;
+                    }
+                }
+                if(!node->isLeaf){
+                    next.push_back(node->child(NE));
+                    next.push_back(node->child(NW));
+                    next.push_back(node->child(SW));
+                    next.push_back(node->child(SE));
+                }
+            }
+        }
+        level.swap(next);
     }
 }
 
@@ -122,7 +381,8 @@ void QuadTree::checkCriteria(Node * node){
  * Returns a boolean determining if the node should be coarsened
  */
 bool QuadTree::coarsen(Node * node){
-        return node->app->coarsen(node->x,node->y,node->width,node->height);
+        return app->coarsen(getX(node),getY(node),getWidth(node),
+                            getHeight(node));
 }
 
 /*
@@ -134,43 +394,242 @@ bool QuadTree::refine(Node * node){
     }
 
     else {
-        return node->app->refine(node->x,node->y,node->width,node->height);
+        return app->refine(getX(node),getY(node),getWidth(node),
+                           getHeight(node));
     }
     
 }
 
 /*
- * Refines a leaf node by adding four children
+ * Refines a leaf node by adding four children, next to each other in a quad
+ * from the pool
  */
 void QuadTree::refineNode(Node * node){
-    double x        = node->x;
-    double y        = node->y;
-    double w        = (node->width)/2.0;
-    double h        = (node->height)/2.0;
+    if(node->currentLevel >= MORTON_MAX_DEPTH)
+        return; //no finer cells to put the children on
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start       = UpdateStats::now();
+    uint32_t i      = node->i;
+    uint32_t j      = node->j;
     int newLevel    = node->currentLevel +1;
-    node->NEChild   = new Node((x+w),(y+h),w,h,node,newLevel,0,node->app);
-    node->NWChild   = new Node(x,y+h,w,h,node,newLevel,1,node->app);
-    node->SWChild   = new Node(x,y,w,h,node,newLevel,2,node->app);
-    node->SEChild   = new Node(x+w,y,w,h,node,newLevel,3,node->app);
-    node->isLeaf    = false;
+    uint32_t s      = 1u << (MORTON_MAX_DEPTH - newLevel); //cells along a child
+    invalidateNeighbors(node);
+    dropNeighbors(node);
+    Node * quad     = threadPool()->allocate();
+    new (quad+NE) Node(i+s,j+s,node,newLevel);
+    new (quad+NW) Node(i,j+s,node,newLevel);
+    new (quad+SW) Node(i,j,node,newLevel);
+    new (quad+SE) Node(i+s,j,node,newLevel);
+    if(fields != NULL && node->id >= 0){
+        //prolongation, the children start with the parent's averages
+        for(int c = 0; c < 4; c++)
+            quad[c].id = fields->allocate();
+        for(int f = 0; f < fields->getNumFields(); f++){
+            double * u = fields->field(f);
+            for(int c = 0; c < 4; c++)
+                u[quad[c].id] = u[node->id];
+        }
+        fields->release(node->id);
+        node->id    = -1;
+    }
+    node->link(quad);
+    if(logChanges)
+        changed.push_back(node);
+#pragma omp atomic
+    stats.created   += 4;
+    if(time){
+        double t    = UpdateStats::since(start);
+#pragma omp atomic
+        stats.allocation += t;
+    }
 }
 
 /*
- * Coarsens a node by deleting all of its descendants
+ * Coarsens a node by returning all of its descendants to the pool
  */
 void QuadTree::coarsenNode(Node * node){
     //cout<<"we tagged a node for coarsening"<<endl;
-    destroyTree(node->SEChild);
-    destroyTree(node->SWChild);
-    destroyTree(node->NWChild);
-    destroyTree(node->NEChild);
-    
-    //reset child pointers
-    node->NEChild   = NULL;
-    node->NWChild   = NULL;
-    node->SWChild   = NULL;
-    node->SEChild   = NULL;
-    node->isLeaf    = true;
+    if(node->isLeaf)
+        return;
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start       = UpdateStats::now();
+    invalidateNeighbors(node);
+    if(fields != NULL){
+        //restriction, the node takes the average of the leaves below it
+        vector<double> sums(fields->getNumFields(), 0.0);
+        restrictFields(node, sums);
+        node->id    = fields->allocate();
+        double area = getWidth(node)*getHeight(node);
+        for(int f = 0; f < fields->getNumFields(); f++)
+            fields->field(f)[node->id] = sums[f]/area;
+    }
+    //unlinked first, so a reader finds the node a leaf or the quads intact
+    Node * quad     = node->children;
+    node->link(NULL);
+    destroyTree(quad);
+    if(logChanges)
+        changed.push_back(node);
+    if(time){
+        double t    = UpdateStats::since(start);
+#pragma omp atomic
+        stats.deletion += t;
+    }
+}
+
+void QuadTree::restrictFields(Node * node, std::vector<double>& sums){
+    if(node->isLeaf){
+        if(node->id >= 0){
+            double area = getWidth(node)*getHeight(node);
+            for(int f = 0; f < fields->getNumFields(); f++)
+                sums[f] += area*fields->field(f)[node->id];
+            fields->release(node->id);
+            node->id    = -1;
+        }
+    }
+    else {
+        restrictFields(node->child(NE), sums);
+        restrictFields(node->child(NW), sums);
+        restrictFields(node->child(SW), sums);
+        restrictFields(node->child(SE), sums);
+    }
+}
+
+FieldData * QuadTree::getFields(){
+    return fields;
+}
+
+void QuadTree::setFields(FieldData * f){
+    fields = f;
+    setFieldsHelper(root);
+}
+
+void QuadTree::setFieldsHelper(Node * node){
+    if(node->isLeaf)
+        node->id = fields != NULL ? fields->allocate() : -1;
+    else {
+        setFieldsHelper(node->child(NE));
+        setFieldsHelper(node->child(NW));
+        setFieldsHelper(node->child(SW));
+        setFieldsHelper(node->child(SE));
+    }
+}
+
+/*
+ * Writes the header, the structure and the values of the leaves
+ */
+void QuadTree::write(std::ostream& out, int format){
+    vector<Node*> leaves;
+    findLeavesMorton(leaves);
+    TreeHeader header;
+    header.format       = format;
+    header.maxLevel     = maxLevel;
+    header.x            = rootX;
+    header.y            = rootY;
+    header.width        = widths[0];
+    header.height       = heights[0];
+    header.count        = format == TREE_BITS ? countNodes() : leaves.size();
+    header.numFields    = fields != NULL ? fields->getNumFields() : 0;
+    header.write(out);
+
+    if(format == TREE_BITS){
+        BitWriter bits(out);
+        writeBits(root, bits);
+        bits.flush();
+    }
+    else {
+        for(size_t k = 0; k < leaves.size(); k++){
+            writeRaw(out, mortonEncode(leaves[k]->i, leaves[k]->j));
+            writeRaw(out, leaves[k]->currentLevel);
+        }
+    }
+    for(size_t k = 0; k < leaves.size() && fields != NULL; k++)
+        for(int f = 0; f < fields->getNumFields(); f++)
+            writeRaw(out, fields->field(f)[leaves[k]->id]);
+}
+
+void QuadTree::writeBits(Node * node, BitWriter& bits){
+    bits.put(!node->isLeaf);
+    if(!node->isLeaf){
+        writeBits(node->child(SW), bits);
+        writeBits(node->child(SE), bits);
+        writeBits(node->child(NW), bits);
+        writeBits(node->child(NE), bits);
+    }
+}
+
+/*
+ * Reads and checks the whole stream before the tree is touched, then
+ * coarsens the tree to the root and refines it again as the stream says
+ */
+bool QuadTree::read(std::istream& in){
+    TreeHeader header;
+    if(!header.read(in) || header.x != rootX || header.y != rootY ||
+       header.width != widths[0] || header.height != heights[0])
+        return false;
+    vector<uint8_t> bits;
+    vector<pair<uint64_t,int> > keys;
+    uint64_t numLeaves;
+    if(header.format == TREE_BITS){
+        if(!readTreeBits(in, header.count, bits, numLeaves))
+            return false;
+    }
+    else {
+        if(!readTreeKeys(in, header.count, keys))
+            return false;
+        numLeaves           = keys.size();
+    }
+    vector<double> values;
+    if(!readTreeValues(in, numLeaves, header.numFields, values))
+        return false;
+
+    coarsenNode(root);
+    setMaxLevel(header.maxLevel);
+    if(header.format == TREE_BITS){
+        uint64_t pos        = 0;
+        readBits(root, bits, pos);
+    }
+    else {
+        size_t pos          = 0;
+        readKeys(root, keys, pos);
+    }
+    if(fields != NULL && (int) header.numFields == fields->getNumFields()){
+        vector<Node*> leaves;
+        findLeavesMorton(leaves);
+        for(size_t k = 0; k < leaves.size(); k++)
+            for(int f = 0; f < fields->getNumFields(); f++)
+                fields->field(f)[leaves[k]->id] = values[k*header.numFields+f];
+    }
+    balance();
+    return true;
+}
+
+void QuadTree::readBits(Node * node, const std::vector<uint8_t>& bits,
+                        uint64_t& pos){
+    if(bitAt(bits, pos++)){
+        refineNode(node);
+        readBits(node->child(SW), bits, pos);
+        readBits(node->child(SE), bits, pos);
+        readBits(node->child(NW), bits, pos);
+        readBits(node->child(NE), bits, pos);
+    }
+}
+
+//the keys tile the space in Morton order, so the next one starts at the
+//node and is the node or below it
+void QuadTree::readKeys(Node * node,
+                        const std::vector<std::pair<uint64_t,int> >& keys,
+                        size_t& pos){
+    if(keys[pos].second == node->currentLevel)
+        pos++;
+    else {
+        refineNode(node);
+        readKeys(node->child(SW), keys, pos);
+        readKeys(node->child(SE), keys, pos);
+        readKeys(node->child(NW), keys, pos);
+        readKeys(node->child(NE), keys, pos);
+    }
 }
 
 /*
@@ -183,17 +642,43 @@ void QuadTree::fullyRefine(Node * node){
     
     refineNode(node);
     
-    if(refine(node->NEChild))
-        fullyRefine(node->NEChild);
+    if(node->currentLevel < taskCutoff){
+        //each child's subtree is a task
+#pragma omp task
+        {
+            if(refine(node->child(NE)))
+                fullyRefine(node->child(NE));
+        }
+#pragma omp task
+        {
+            if(refine(node->child(NW)))
+                fullyRefine(node->child(NW));
+        }
+#pragma omp task
+        {
+            if(refine(node->child(SW)))
+                fullyRefine(node->child(SW));
+        }
+#pragma omp task
+        {
+            if(refine(node->child(SE)))
+                fullyRefine(node->child(SE));
+        }
+#pragma omp taskwait
+        return;
+    }
+    
+    if(refine(node->child(NE)))
+        fullyRefine(node->child(NE));
     
-    if(refine(node->NWChild))
-        fullyRefine(node->NWChild);
+    if(refine(node->child(NW)))
+        fullyRefine(node->child(NW));
     
-    if(refine(node->SWChild))
-        fullyRefine(node->SWChild);
+    if(refine(node->child(SW)))
+        fullyRefine(node->child(SW));
     
-    if(refine(node->SEChild))
-        fullyRefine(node->SEChild);
+    if(refine(node->child(SE)))
+        fullyRefine(node->child(SE));
     
 }
 
@@ -208,7 +693,35 @@ int QuadTree::getMaxLevel(){
 }
 
 void QuadTree::setMaxLevel(int level){
-    maxLevel = level;
+    //the nodes' corners have no room below MORTON_MAX_DEPTH
+    maxLevel = level < MORTON_MAX_DEPTH ? level : MORTON_MAX_DEPTH;
+    epoch    = -1; //the criteria change everywhere
+}
+
+int QuadTree::getTaskCutoff(){
+    return taskCutoff;
+}
+
+void QuadTree::setTaskCutoff(int level){
+    taskCutoff = level;
+}
+
+bool QuadTree::getBatchCriteria(){
+    return batchCriteria;
+}
+
+void QuadTree::setBatchCriteria(bool b){
+    batchCriteria = b;
+}
+
+bool QuadTree::getIncremental(){
+    return incremental;
+}
+
+void QuadTree::setIncremental(bool i){
+    incremental = i;
+    epoch       = -1;
+    pending.clear();
 }
 
 bool QuadTree::getTime(){
@@ -219,53 +732,96 @@ void QuadTree::setTime(bool t){
 }
 
 double QuadTree::getTotalCoarsen(){
-    return totalCoarsen;
+    return stats.deletion;
 }
 
 double QuadTree::getTotalRefine(){
-    return totalRefine;
+    return stats.allocation;
+}
+
+const UpdateStats& QuadTree::getStats(){
+    return stats;
 }
 
 //memory usage
 int QuadTree::storage(){
-    return storageHelper(root);
+    int bytes = sizeof(Node);
+    for(vector<NodePool*>::iterator IT = pools.begin(); IT!=pools.end(); IT++)
+        bytes += (*IT)->bytes();
+    return bytes;
 }
 
-int QuadTree::storageHelper(Node * node){
-    if(node->isLeaf)
-        return sizeof(Node);
-    else {
-        return sizeof(Node)+
-        storageHelper(node->NEChild)+
-        storageHelper(node->NWChild)+
-        storageHelper(node->SWChild)+
-        storageHelper(node->SEChild);
+double QuadTree::poolUtilization(){
+    int used = 0;
+    int capacity = 0;
+    for(vector<NodePool*>::iterator IT = pools.begin(); IT!=pools.end(); IT++){
+        used += (*IT)->used();
+        capacity += (*IT)->capacity();
     }
-    
+    if(capacity == 0)
+        return 0.0;
+    return double(used)/capacity;
 }
 
-Node* QuadTree::findNode(float x, float y) {
-    return findNodeHelper(x,y,root);
+Node* QuadTree::findNode(double x, double y) {
+    //the cell of the finest level, points outside taken to the nearest
+    double n    = ldexp(1.0, MORTON_MAX_DEPTH);
+    double fi   = floor((x - rootX)/cellWidth);
+    double fj   = floor((y - rootY)/cellHeight);
+    uint32_t i  = fi < 0 ? 0 : (fi >= n ? (uint32_t) n - 1 : (uint32_t) fi);
+    uint32_t j  = fj < 0 ? 0 : (fj >= n ? (uint32_t) n - 1 : (uint32_t) fj);
+    return findNodeHelper(i,j,root);
+}
+
+void QuadTree::findNodes(const double * xs, const double * ys, int n,
+                         Node ** out){
+    vector<pair<uint64_t,int> > queries(n);
+#pragma omp parallel for if(n >= FIND_PARALLEL_MIN)
+    for(int k = 0; k < n; k++)
+        queries[k] = make_pair(mortonKey(xs[k],ys[k],rootX,rootY,
+                                         widths[0],heights[0]), k);
+    if(n == 0)
+        return;
+    
+#pragma omp parallel if(n >= FIND_PARALLEL_MIN)
+#pragma omp single
+    findNodesHelper(root,&queries[0],0,n,out);
 }
 
-//find which node a given set of coordinates is located
-Node* QuadTree::findNodeHelper(float x, float y, Node * node){
-    if(node->isLeaf  && (x < (node->x + node->width)) &&
-       (y < (node->y + node->height)))
-        return node;
-    else if ((x < node->x + (node->width)/2.0)){
-        if(y < node->y + (node->height)/2.0)
-            return findNodeHelper(x,y,node->SWChild);
-        else
-            return findNodeHelper(x,y,node->NWChild);
+//finds the leaves of the points lo up to hi, which are inside node, sorting
+//them by key as far down as the tree goes
+void QuadTree::findNodesHelper(Node * node, std::pair<uint64_t,int> * queries,
+                               int lo, int hi, Node ** out){
+    Node * quad = node->quad();
+    if(quad == NULL){
+        for(int k = lo; k < hi; k++)
+            out[queries[k].second] = node;
     }
     else {
-        if(y < node->y + (node->height)/2.0)
-            return findNodeHelper(x,y,node->SEChild);
-        else
-            return findNodeHelper(x,y,node->NEChild);
+        //the points of the children in key order, SW, SE, NW, NE
+        int bounds[5];
+        mortonSplit(queries,lo,hi,node->currentLevel,bounds);
+        Node * children[4] = {quad+SW,quad+SE,quad+NW,quad+NE};
+        for(int c = 0; c < 4; c++){
+            if(bounds[c] == bounds[c+1])
+                continue;
+#pragma omp task if(bounds[c+1]-bounds[c] >= FIND_PARALLEL_MIN)
+            findNodesHelper(children[c],queries,bounds[c],bounds[c+1],out);
+        }
+#pragma omp taskwait
     }
-    
+}
+
+//find which leaf holds the cell i,j of the finest level
+Node* QuadTree::findNodeHelper(uint32_t i, uint32_t j, Node * node){
+    Node * quad;
+    while((quad = node->quad()) != NULL){
+        int bit     = MORTON_MAX_DEPTH - node->currentLevel - 1;
+        bool east   = (i >> bit) & 1;
+        bool north  = (j >> bit) & 1;
+        node        = quad + (north ? (east ? NE : NW) : (east ? SE : SW));
+    }
+    return node;
 }
 
 void QuadTree::findLeaves(std::vector<Node*>& leaves){
@@ -273,13 +829,30 @@ void QuadTree::findLeaves(std::vector<Node*>& leaves){
 }
 
 void QuadTree::findLeavesHelper(std::vector<Node*>& leaves,Node * node){
-    if(node->isLeaf)
+    Node * quad = node->quad();
+    if(quad == NULL)
         leaves.push_back(node);
     else {
-        findLeavesHelper(leaves,node->NEChild);
-        findLeavesHelper(leaves,node->NWChild);
-        findLeavesHelper(leaves,node->SWChild);
-        findLeavesHelper(leaves,node->SEChild);
+        findLeavesHelper(leaves,quad+NE);
+        findLeavesHelper(leaves,quad+NW);
+        findLeavesHelper(leaves,quad+SW);
+        findLeavesHelper(leaves,quad+SE);
+    }
+}
+
+void QuadTree::findLeavesMorton(std::vector<Node*>& leaves){
+    findLeavesMortonHelper(leaves,root);
+}
+
+void QuadTree::findLeavesMortonHelper(std::vector<Node*>& leaves,Node * node){
+    Node * quad = node->quad();
+    if(quad == NULL)
+        leaves.push_back(node);
+    else {
+        findLeavesMortonHelper(leaves,quad+SW);
+        findLeavesMortonHelper(leaves,quad+SE);
+        findLeavesMortonHelper(leaves,quad+NW);
+        findLeavesMortonHelper(leaves,quad+NE);
     }
 }
 
@@ -293,20 +866,24 @@ int QuadTree::countNodesHelper(Node * node){
         return 1;
     else{
         return 1+
-        countNodesHelper(node->NEChild)+
-        countNodesHelper(node->NWChild)+
-        countNodesHelper(node->SWChild)+
-        countNodesHelper(node->SEChild);
+        countNodesHelper(node->child(NE))+
+        countNodesHelper(node->child(NW))+
+        countNodesHelper(node->child(SW))+
+        countNodesHelper(node->child(SE));
     }
 }
 
 std::vector<double> QuadTree::getDimensions(){
-    vector<double> dims;
-    dims.push_back(root->x);
-    dims.push_back(root->y);
-    dims.push_back(root->width);
-    dims.push_back(root->height);
-    return dims;
+    return getBounds(root);
+}
+
+std::vector<double> QuadTree::getBounds(Node * node){
+    vector<double> bounds;
+    bounds.push_back(getX(node));
+    bounds.push_back(getY(node));
+    bounds.push_back(getWidth(node));
+    bounds.push_back(getHeight(node));
+    return bounds;
 }
 
 
@@ -314,16 +891,134 @@ std::vector<double> QuadTree::getDimensions(){
 
 void QuadTree::getNeighbors(Node * node,
                             std::vector<std::vector<Node*> >& neighbors){
+    if(!cacheNeighbors || !node->isLeaf){
+        std::chrono::steady_clock::time_point start;
+        if(time)
+            start = UpdateStats::now();
+        findNeighbors(node,neighbors);
+        if(time)
+            stats.neighbors += UpdateStats::since(start);
+        return;
+    }
+    vector<Node*> * lists = neighborLists(node);
+    for(int d = 0; d < 4; d++)
+        neighbors[d].insert(neighbors[d].end(),lists[d].begin(),lists[d].end());
+}
+
+std::vector<Node*> * QuadTree::neighborLists(Node * leaf){
+    if(leaf->neighbors == NULL){
+        std::chrono::steady_clock::time_point start;
+        if(time)
+            start = UpdateStats::now();
+        vector<Node*> vec;
+        vector<vector<Node*> > lists (4, vec);
+        findNeighbors(leaf,lists);
+        leaf->neighbors = new vector<Node*>[4];
+        for(int d = 0; d < 4; d++)
+            leaf->neighbors[d].swap(lists[d]);
+        cachedLeaves++;
+        if(time)
+            stats.neighbors += UpdateStats::since(start);
+    }
+    return leaf->neighbors;
+}
+
+bool QuadTree::getConcurrentReads(){
+    return epochs != NULL;
+}
+
+void QuadTree::setConcurrentReads(bool c){
+    if(c && epochs == NULL){
+        setCacheNeighbors(false);
+        epochs      = new EpochDomain();
+    }
+    else if(!c && epochs != NULL){
+        //no reads are running, so everything retired is freed
+        reclaim();
+        delete epochs;
+        epochs      = NULL;
+    }
+}
+
+int QuadTree::beginRead(){
+    return epochs != NULL ? epochs->enter() : -1;
+}
+
+void QuadTree::endRead(int slot){
+    if(epochs != NULL)
+        epochs->exit(slot);
+}
+
+bool QuadTree::getCacheNeighbors(){
+    return cacheNeighbors;
+}
+
+void QuadTree::setCacheNeighbors(bool c){
+    cacheNeighbors = c;
+    if(!c)
+        clearNeighborCache();
+}
+
+void QuadTree::clearNeighborCache(){
+    if(cachedLeaves > 0)
+        clearNeighborCacheHelper(root);
+}
+
+void QuadTree::clearNeighborCacheHelper(Node * node){
+    dropNeighbors(node);
+    if(!node->isLeaf){
+        clearNeighborCacheHelper(node->child(NE));
+        clearNeighborCacheHelper(node->child(NW));
+        clearNeighborCacheHelper(node->child(SW));
+        clearNeighborCacheHelper(node->child(SE));
+    }
+}
+
+void QuadTree::dropNeighbors(Node * node){
+    if(node->isLeaf && node->neighbors != NULL){
+        delete [] node->neighbors;
+        node->neighbors = NULL;
+        cachedLeaves--;
+    }
+}
+
+/*
+ * Neighbors are mutual, so the leaves that list a node, or a leaf below it,
+ * are the leaves across its faces
+ */
+void QuadTree::invalidateNeighbors(Node * node){
+    if(cachedLeaves == 0)
+        return;
+    vector<Node*> vec;
+    vector<vector<Node*> > lists (4, vec);
+    if(node->isLeaf && node->neighbors != NULL){
+        for(int d = 0; d < 4; d++)
+            lists[d] = node->neighbors[d];
+    }
+    else
+        findNeighbors(node,lists);
+    for(int d = 0; d < 4; d++){
+        for(vector<Node*>::iterator IT = lists[d].begin(); IT!=lists[d].end(); IT++)
+            dropNeighbors(*IT);
+    }
+}
+
+void QuadTree::findNeighbors(Node * node,
+                             std::vector<std::vector<Node*> >& neighbors){
     if(node->parent == NULL){ //we're at the root which has no neighbors
         return;
     }
     
+    //the siblings, none if a concurrent update coarsened the node away
+    Node * sibs = node->parent->quad();
+    if(sibs == NULL)
+        return;
     vector<vector<Node*> > parentsNeighbors = getParentsNeighbors(node->parent);
-    switch(node->childType){
+    switch(node->childType()){
         case 0://NEChild
             //cout<<"northeast child"<<endl;
-            getNeighborsSibs(node->parent->NWChild,neighbors[3],0,3);
-            getNeighborsSibs(node->parent->SEChild,neighbors[1],0,1);
+            getNeighborsSibs(sibs+NW,neighbors[3],0,3);
+            getNeighborsSibs(sibs+SE,neighbors[1],0,1);
             
             processNeighbors(parentsNeighbors[2],neighbors[2],
                              node->currentLevel-1,1);
@@ -333,8 +1028,8 @@ void QuadTree::getNeighbors(Node * node,
             
         case 1: //NWChild
             //cout<<"northwest child"<<endl;
-            getNeighborsSibs(node->parent->NEChild,neighbors[2],1,2);
-            getNeighborsSibs(node->parent->SWChild,neighbors[1],0,1);
+            getNeighborsSibs(sibs+NE,neighbors[2],1,2);
+            getNeighborsSibs(sibs+SW,neighbors[1],0,1);
             
             processNeighbors(parentsNeighbors[3],neighbors[3],
                              node->currentLevel-1,0);
@@ -344,8 +1039,8 @@ void QuadTree::getNeighbors(Node * node,
             
         case 2:  //SWChild
             //cout<<"southwest child"<<endl;
-            getNeighborsSibs(node->parent->SEChild,neighbors[2],1,2);
-            getNeighborsSibs(node->parent->NWChild,neighbors[0],2,3);
+            getNeighborsSibs(sibs+SE,neighbors[2],1,2);
+            getNeighborsSibs(sibs+NW,neighbors[0],2,3);
             
             processNeighbors(parentsNeighbors[3],neighbors[3],
                              node->currentLevel-1,3);
@@ -355,8 +1050,8 @@ void QuadTree::getNeighbors(Node * node,
             
         case 3:  //SEChild
             //cout<<"southeast child"<<endl;
-            getNeighborsSibs(node->parent->SWChild,neighbors[3],0,3);
-            getNeighborsSibs(node->parent->NEChild,neighbors[0],2,3);
+            getNeighborsSibs(sibs+SW,neighbors[3],0,3);
+            getNeighborsSibs(sibs+NE,neighbors[0],2,3);
             
             processNeighbors(parentsNeighbors[2],neighbors[2],
                              node->currentLevel-1,2);
@@ -375,26 +1070,27 @@ std::vector<std::vector<Node*> > QuadTree::getParentsNeighbors(Node * parent){
     //vector<vector<Node*> > parentsNeighbors;
     vector<Node*> vec;
     vector<vector<Node*> > parentsNeighbors (4, vec);
-    getNeighbors(parent,parentsNeighbors);//get neighbors
+    findNeighbors(parent,parentsNeighbors);//get neighbors
     return parentsNeighbors;//return neighbors
 }
 
 void QuadTree::getNeighborsSibs(Node * node, std::vector<Node*>& list,
                                 int sibOneType, int sibTwoType){
-    if(node->isLeaf)
+    Node * quad = node->quad();
+    if(quad == NULL)
         list.push_back(node);
     else {
         if((sibOneType == 0) || (sibTwoType == 0)){
-            getNeighborsSibs(node->NEChild,list,sibOneType,sibTwoType);
+            getNeighborsSibs(quad+NE,list,sibOneType,sibTwoType);
         }
         if(sibOneType == 1 || sibTwoType == 1){
-            getNeighborsSibs(node->NWChild,list,sibOneType,sibTwoType);
+            getNeighborsSibs(quad+NW,list,sibOneType,sibTwoType);
         }
         if(sibOneType == 2 || sibTwoType == 2){
-            getNeighborsSibs(node->SWChild,list,sibOneType,sibTwoType);
+            getNeighborsSibs(quad+SW,list,sibOneType,sibTwoType);
         }
         if(sibOneType == 3 || sibTwoType == 3) {
-            getNeighborsSibs(node->SEChild,list,sibOneType,sibTwoType);
+            getNeighborsSibs(quad+SE,list,sibOneType,sibTwoType);
         }
         
     }
@@ -402,7 +1098,7 @@ void QuadTree::getNeighborsSibs(Node * node, std::vector<Node*>& list,
 
 bool QuadTree::actualNeighbor(Node * node, int level, int nodeType){
     if(node->currentLevel == level)
-        return node->childType == nodeType;
+        return node->childType() == nodeType;
     else
         return actualNeighbor(node->parent,level,nodeType);
     
@@ -421,7 +1117,7 @@ void QuadTree::processNeighbors(std::vector <Node*> pNeighbors,
         for(vector<Node*>::iterator vecIt = pNeighbors.begin();
             vecIt!=pNeighbors.end();vecIt++) {
             if((*vecIt)->currentLevel == pLevel+1 &&
-               (*vecIt)->childType == nodeType)
+               (*vecIt)->childType() == nodeType)
                 list.push_back((*vecIt)); //same level of refined
             else if(actualNeighbor((*vecIt),(pLevel+1),nodeType))//more refined have to check individually
                 list.push_back((*vecIt));
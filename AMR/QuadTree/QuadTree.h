@@ -34,52 +34,153 @@
 #include <math.h>
 #include <time.h>
 #include <vector>
+#include <algorithm>
+#include <new>
 #include <cstdlib>
 #include "Application.h"
+#include "Morton.h"
+#include "FieldData.h"
+#include "UpdateStats.h"
+#include "TreeStream.h"
+#include "Epoch.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 /*
  * The QuadTree is composed of nodes
+ *
+ * A node keeps only what cannot be worked out from where it is.  Its lower
+ * left corner is its cell on the grid of the finest level, MORTON_MAX_DEPTH,
+ * and its level gives its size, so the tree turns them into coordinates
+ * with getX, getY, getWidth and getHeight, and which child it is comes from
+ * the bit of its corner at its level.  Its children are one quad from the
+ * pool, so one pointer to the NE child finds all four, and a leaf, which
+ * has no children, keeps its cached neighbors in the same place.
  */
 
+enum ChildType { NE = 0, NW = 1, SW = 2, SE = 3 };
+
 struct Node{
     
 public:
     
-    Node * NEChild;//pointer to first quadrant child
-    Node * NWChild;//pointer to second quadrant child
-    Node * SWChild;//pointer to third quadrant child
-    Node * SEChild;//pointer to fourth quadrant child
+    union {
+        Node * children;//if not a leaf the NE, NW, SW, SE children, in that order
+        std::vector<Node*> * neighbors; //if a leaf the cached N, S, E, W neighbors, NULL if not cached
+    };
     Node * parent;//pointer to parent (used in neighbor finding and coarsening)
-    Application * app; //what are we using this tree for
-    double width; //how wide am I
-    double height; //how tall am I
-    double x; //where do I start x coord
-    double y; //where do I start y coord
-    int currentLevel;//level in tree where the node is
-    int childType; //what child am I? 0 - NE, 1 - NW, 2-SW, 3-SE.  If root -1
+    uint32_t i; //where do I start, in cells of the finest level along x
+    uint32_t j; //and along y
+    int id; //slot of a leaf in the tree's FieldData, -1 if none
+    uint8_t currentLevel;//level in tree where the node is
     bool isLeaf;
     
     //constructor
-    Node(double xStart, double yStart, double w, double h,
-         Node * par, double level, int cType, Application * application){
-     NEChild        = NULL;
-     NWChild        = NULL;
-     SWChild        = NULL;
-     SEChild        = NULL;
+    Node(uint32_t iStart, uint32_t jStart, Node * par, int level){
+     children       = NULL;
      parent         = par;
-     app            = application;
-     x              = xStart;
-     y              = yStart;
-     width          = w;
-     height         = h;
-  
+     i              = iStart;
+     j              = jStart;
+     id             = -1;
      currentLevel   = level;
-     childType      = cType;
      isLeaf         = true;
 
      }
     
+    /*
+     * The quad of children, NULL for a leaf, for a reader that may run
+     * while another thread refines or coarsens the node (see
+     * QuadTree::setConcurrentReads).  It may give the quad of a node just
+     * coarsened, which stays valid until the read is over
+     */
+    Node * quad() const {
+        if(__atomic_load_n(&isLeaf, __ATOMIC_ACQUIRE))
+            return NULL;
+        return __atomic_load_n(&children, __ATOMIC_ACQUIRE);
+    }
+    
+    /*
+     * Publishes a quad of children, or NULL to make the node a leaf, so a
+     * reader that sees the new quad sees it built
+     */
+    void link(Node * quad){
+        if(quad != NULL){
+            __atomic_store_n(&children, quad, __ATOMIC_RELEASE);
+            __atomic_store_n(&isLeaf, false, __ATOMIC_RELEASE);
+        }
+        else {
+            __atomic_store_n(&isLeaf, true, __ATOMIC_RELEASE);
+            __atomic_store_n(&children, (Node*) NULL, __ATOMIC_RELEASE);
+        }
+    }
+    
+    /*
+     * Returns a child, NE, NW, SW or SE, of a node that is not a leaf
+     */
+    Node * child(int type) const {
+        return children + type;
+    }
+    
+    /*
+     * What child am I? 0 - NE, 1 - NW, 2-SW, 3-SE.  If root -1
+     */
+    int childType() const {
+        if(parent == NULL)
+            return -1;
+        int bit = MORTON_MAX_DEPTH - currentLevel;
+        bool east   = (i >> bit) & 1;
+        bool north  = (j >> bit) & 1;
+        return north ? (east ? NE : NW) : (east ? SE : SW);
+    }
+    
+};
+
+
+/*
+ * The nodes below the root come in fours, so they are allocated four at a
+ * time from a pool.  The pool hands out the NE, NW, SW, SE children of a
+ * node as one contiguous quad carved from a chunk, and keeps the quads given
+ * back on a free list that is reused before a new quad is carved.  Chunks
+ * start at MIN_QUADS_PER_CHUNK quads and double up to MAX_QUADS_PER_CHUNK,
+ * and are all freed together when the pool is destroyed.
+ *
+ * A pool is not thread safe, the tree keeps one per thread.  A quad may be
+ * given back to another thread's pool than the one it came from.
+ */
+
+#define MIN_QUADS_PER_CHUNK 16
+#define MAX_QUADS_PER_CHUNK 4096
+
+class NodePool {
+public:
+    
+    NodePool();
+    ~NodePool();
+    
+    /*
+     * Returns the memory for four nodes, which the caller constructs, and
+     * takes it back
+     */
+    Node * allocate();
+    void release(Node * quad);
+    
+    /*
+     * Quads handed out, quads the chunks hold and bytes the chunks take
+     */
+    int used();
+    int capacity();
+    int bytes();
+    
+private:
+    std::vector<Node*> chunks;
+    Node * freeList; //released quads, linked through children of their first node
+    int chunkQuads; //quads in the last chunk
+    int next; //first quad of the last chunk never handed out
+    int total;
+    int inUse;
+    
 };
 
 
@@ -98,12 +199,41 @@ public:
     /*
      * Destructor
      */
-    ~QuadTree();
+    virtual ~QuadTree();
     
     /*
      * Refines and coarsens the quadtree until the desired refinement is reached
+     *
+     * With a task cutoff above 0 and OpenMP the update runs on the OpenMP
+     * threads, every node above the cutoff level handing its four children's
+     * subtrees to tasks.  The refinement and coarsening criteria then must
+     * not look at other nodes, which other tasks may be changing, so
+     * Neighbor and OneLevel must update with a cutoff of 0.  A tree with
+     * fields attached updates serially whatever the cutoff.
+     *
+     * With batch criteria on the update goes down the tree a level at a
+     * time, asking the Application about all the leaves of a level that
+     * may refine, and all the nodes that may coarsen, in one call of
+     * refineBatch and coarsenBatch.  The tree is the same as a node by node
+     * update gives, but the tree's own refine and coarsen are bypassed, so
+     * Neighbor and OneLevel must leave it off.
+     *
+     * With incremental updates on, and batch criteria off, the update asks
+     * the Application for the regions where its criteria changed since the
+     * last update and checks only the nodes that reach into them, serially,
+     * so its cost follows the moving feature rather than the tree.  Nodes
+     * outside the regions are left as they are, so the tree is what a full
+     * update gives if the last update left every node meeting the criteria.
+     * The first update, and any the Application cannot answer, check the
+     * whole tree.
      */
-    void update();
+    virtual void update();
+    
+    /*
+     * Restores what a subclass requires of the tree after refineNode and
+     * coarsenNode are called directly, nothing for a QuadTree
+     */
+    virtual void balance();
     
     /*
      * Refines and coarsens the node
@@ -116,6 +246,50 @@ public:
      */
     virtual bool refine(Node * node);
     virtual bool coarsen(Node * node);
+    
+    /*
+     * Getter and setter for reading the tree from other threads while it
+     * updates.  With concurrent reads on, findNode, findNodes, findLeaves,
+     * findLeavesMorton and getNeighbors, and the coordinates of the nodes
+     * they return, may be called between beginRead and endRead (or in the
+     * life of a TreeReader) by any number of threads while one thread
+     * updates, refines or coarsens the tree.  A reader sees each node as it
+     * was before or after a change, so a query racing a change may give a
+     * leaf that has just been refined or coarsened away, but every node it
+     * gets stays valid until its read is over: coarsening retires the
+     * quads instead of returning them to the pool, and the quads retired
+     * before the oldest read still going are reused at the end of the next
+     * update.  Neighbor caching and timing write to the tree, so they must
+     * stay off, and turning concurrent reads on turns caching off; the
+     * fields are not covered
+     */
+    bool getConcurrentReads();
+    void setConcurrentReads(bool c);
+    int beginRead();
+    void endRead(int slot);
+    
+    /*
+     * Getter and setter for the solution data of the leaves.  Attaching
+     * gives every leaf a slot, its values 0, and from then on refineNode
+     * copies a leaf's values to its children and coarsenNode sets a node's
+     * values to the area weighted average of the leaves below it, which
+     * conserves the integral of each field.  NULL detaches them, leaving
+     * the slots to the caller
+     */
+    FieldData * getFields();
+    void setFields(FieldData * f);
+    
+    /*
+     * Checkpointing.  write puts the tree on a stream as TREE_BITS, a bit
+     * per node, or TREE_KEYS, the leaves' keys, with the leaves' values if
+     * fields are attached, see TreeStream.h.  read replaces the tree with
+     * the one on the stream, written by a QuadTree or a LinearQuadTree of
+     * the same space, and its maximum level, and the values of the leaves
+     * if it has as many fields as are attached.  Nothing is changed and
+     * false returned if the stream does not hold a whole tree of the space
+     */
+    void write(std::ostream& out, int format);
+    bool read(std::istream& in);
 
     
     /**********************DEBUGGING AND TREE INFO****************************/
@@ -125,28 +299,84 @@ public:
      */
     void findLeaves(std::vector<Node*>& leaves);
     
+    /*
+     * Returns pointers to all the leaf nodes in Morton order, visiting the
+     * children SW, SE, NW, NE, so nearby leaves are nearby in the vector
+     */
+    void findLeavesMorton(std::vector<Node*>& leaves);
+    
     /*
      * Method for getting the neighbors of a node in the tree
+     *
+     * With neighbor caching on, the neighbors of a leaf are found once and
+     * kept with the leaf until refining or coarsening changes them:
+     * refineNode and coarsenNode drop the lists of the leaves across the
+     * faces of the nodes they change, and no others
      */
     void getNeighbors(Node * node,
                       std::vector<std::vector<Node*> >& neighbors);
     
+    /*
+     * Returns the four cached neighbor lists of a leaf, north, south, east
+     * and west, finding them if they are not cached.  Needs neighbor
+     * caching on, and the lists last until the tree around the leaf changes
+     */
+    std::vector<Node*> * neighborLists(Node * leaf);
+    
+    /*
+     * Getter and setter to turn neighbor caching on/off, and a method that
+     * drops every cached list
+     */
+    bool getCacheNeighbors();
+    void setCacheNeighbors(bool c);
+    void clearNeighborCache();
+    
     /*
      * Method for getting dimensions of quad tree
      */
     std::vector<double> getDimensions();
     
+    /*
+     * Returns the lower left corner, width and height of a node, one at a
+     * time or all four
+     */
+    double getX(Node * node);
+    double getY(Node * node);
+    double getWidth(Node * node);
+    double getHeight(Node * node);
+    std::vector<double> getBounds(Node * node);
+    
     /*
      * Returns the total memory used to store the root node
      */
     int getSizeRoot();
     
     /* 
-     * Getter and setter for max level of the tree
+     * Getter and setter for max level of the tree, which is at most
+     * MORTON_MAX_DEPTH
      */
     int getMaxLevel();
     void setMaxLevel(int level);
     
+    /*
+     * Getter and setter for the level down to which update spawns tasks,
+     * 0 for a serial update
+     */
+    int getTaskCutoff();
+    void setTaskCutoff(int level);
+    
+    /*
+     * Getter and setter to turn batched evaluation of the criteria on/off
+     */
+    bool getBatchCriteria();
+    void setBatchCriteria(bool b);
+    
+    /*
+     * Getter and setter to turn incremental updates on/off
+     */
+    bool getIncremental();
+    void setIncremental(bool i);
+    
     /*
      * Getter and setter to turn update timing on/off
      */
@@ -155,24 +385,67 @@ public:
     
     /*
      * Returns the total amount of time spend in coarsening and refinement
+     * nodes in the last update
      */
     double getTotalCoarsen();
     double getTotalRefine();
     
+    /*
+     * Returns where the time of the last update went and the nodes it
+     * created and destroyed, with the neighbor searches since it started
+     */
+    const UpdateStats& getStats();
+    
     /*
      * Counts the number of nodes in the tree
      */
     int countNodes();
     
     /*
-     * Returns the total amount of memory used to store the quad tree
+     * Returns the total amount of memory used to store the quad tree, the
+     * root and the chunks of the node pool
      */
     int storage();
     
     /*
-     * Finds the leaf node that contains the particular x,y point
+     * Returns the fraction of the node pool's quads in use
+     */
+    double poolUtilization();
+    
+    /*
+     * Finds the leaf node that contains the particular x,y point, or the
+     * nearest leaf to a point outside the space
      */
-    Node * findNode(float x,float y);
+    Node * findNode(double x,double y);
+    
+    /*
+     * Finds the leaf nodes that contain the n points xs[k],ys[k] and stores
+     * them in out[k].  The points are sorted by Morton key on the way down,
+     * splitting the points of a node between its children, so each run of
+     * points inside a node is found with one walk down to it and the
+     * sorting stops at the leaves.  Large runs are walked by OpenMP tasks.  Points on a face
+     * to within rounding may be put in the leaf on either side, and points
+     * outside the space in the nearest leaf
+     */
+    void findNodes(const double * xs, const double * ys, int n, Node ** out);
+    
+protected:
+    /*
+     * With logging on, refineNode and coarsenNode add the node they change
+     * to changed, for a subclass to work through before the tree is
+     * coarsened again
+     */
+    void setLogChanges(bool l);
+    std::vector<Node*> changed;
+    
+    /*
+     * With incremental updates on, adds the box of a node refined or
+     * coarsened against the criteria, as balancing does, to the regions the
+     * next update checks, where a full update would undo and redo it
+     */
+    void markDirty(Node * node);
+    
+    UpdateStats stats;
     
 private:
     /*
@@ -182,10 +455,16 @@ private:
     void insert(Node * node, int levelsRemaining,int currentLevel);
     
     /*
-     * Helper method for recursively destructing the tree
+     * Helper method for recursively returning a quad, unlinked from its
+     * parent, and the quads below it to the pool, or retiring them with
+     * concurrent reads on
      */
-    void destroyTree(Node * node);
+    void destroyTree(Node * quad);
     
+    /*
+     * Returns the quads no reader can reach any more to the pool
+     */
+    void reclaim();
     
     /*
      * Traverses the tree refining and coarsening the nodes
@@ -197,19 +476,60 @@ private:
      */
     void fullyRefine(Node * node);
     
+    /*
+     * Updates the tree a level at a time with the batched criteria
+     */
+    void checkCriteriaBatched();
+    
+    /*
+     * checkCriteria for the nodes that reach into one of the boxes, x, y,
+     * w, h each, in of the parent's boxes, the whole subtree of a node
+     * inside a box
+     */
+    void checkCriteriaIn(Node * node, const std::vector<double>& boxes,
+                         const std::vector<int>& in);
+    
+    /*
+     * Returns the node pool of the calling thread, and makes sure there is
+     * a pool for each thread of the next parallel region
+     */
+    NodePool * threadPool();
+    void addPools();
+    
 /***************** DEBUGGING AND TREE INFO HELPERS ***************************/
     
     /*
      * Recursive helper methods for counting the nodes, printing the values,
-     * and calculating the left Riemann summ, memory usage, finding the location
+     * and calculating the left Riemann summ, finding the location
      * of an (x,y) pair, and the leaves of the tree.  These methods are private
      * in order to prevent the user from needing access to the root
      */
     
-    int storageHelper(Node * node);
     int countNodesHelper(Node * node);
-    Node * findNodeHelper(float x, float y, Node * node);
+    Node * findNodeHelper(uint32_t i, uint32_t j, Node * node);
+    void findNodesHelper(Node * node, std::pair<uint64_t,int> * queries,
+                         int lo, int hi, Node ** out);
     void findLeavesHelper(std::vector<Node*>& leaves, Node * node);
+    void findLeavesMortonHelper(std::vector<Node*>& leaves, Node * node);
+    void clearNeighborCacheHelper(Node * node);
+    void setFieldsHelper(Node * node);
+    
+    /*
+     * Writes the bits of the nodes below and including node, and builds
+     * the tree below a leaf from the bits or leaf keys from pos on
+     */
+    void writeBits(Node * node, BitWriter& bits);
+    void readBits(Node * node, const std::vector<uint8_t>& bits,
+                  uint64_t& pos);
+    void readKeys(Node * node,
+                  const std::vector<std::pair<uint64_t,int> >& keys,
+                  size_t& pos);
+    
+    /*
+     * Adds the area weighted values of the leaves below a node to sums and
+     * releases their slots
+     */
+    void restrictFields(Node * node, std::vector<double>& sums);
     
     /*
      * Helper methods for finding the neighbors of a given node
@@ -219,6 +539,9 @@ private:
      * These are face neighbors.  Each vector holds pointers to the neighbor nodes
      */
 
+    void findNeighbors(Node * node,
+                       std::vector<std::vector<Node*> >& neighbors);
+    
     std::vector<std::vector<Node*> > getParentsNeighbors(Node * parent);
     
     void getNeighborsSibs(Node * node, std::vector<Node*>& list,
@@ -226,18 +549,85 @@ private:
     
     bool actualNeighbor(Node * node, int level, int nodeType);
     
+    /*
+     * Drops the cached neighbors of the leaves across the faces of a node
+     * about to be refined or coarsened, and of one node
+     */
+    void invalidateNeighbors(Node * node);
+    void dropNeighbors(Node * node);
+    
     void processNeighbors(std::vector <Node*> pNeighbors,
                           std::vector<Node*>& list, int plevel, int nodeType);
     
 /*********************** INSTANCE VARIABLES *********************************/
   
     Node * root;
+    std::vector<NodePool*> pools; //one per thread
+    Application * app; //what are we using this tree for
+    
+    double rootX;
+    double rootY;
+    double cellWidth; //size of a cell of the finest level
+    double cellHeight;
+    double widths[MORTON_MAX_DEPTH+1]; //size of a node of each level
+    double heights[MORTON_MAX_DEPTH+1];
     
     int maxLevel;
+    int taskCutoff;
+    bool batchCriteria;
+    bool incremental;
+    long epoch; //of the Application at the last update, -1 for none
+    std::vector<double> pending; //the boxes of markDirty
+    std::vector<std::vector<int> > dirtyIn; //boxes reaching a node, by level
     bool time;
-    double totalCoarsen;
-    double totalRefine;
     
+    bool cacheNeighbors;
+    int cachedLeaves; //leaves with cached neighbors
+    
+    FieldData * fields; //NULL if the leaves hold no data
+    
+    EpochDomain * epochs; //NULL without concurrent reads
+    
+    bool logChanges;
+    
+};
+
+/*
+ * The nodes' coordinates are asked for per leaf by the solvers, so they are
+ * inline
+ */
+inline double QuadTree::getX(Node * node){
+    return rootX + cellWidth*node->i;
+}
+
+inline double QuadTree::getY(Node * node){
+    return rootY + cellHeight*node->j;
+}
+
+inline double QuadTree::getWidth(Node * node){
+    return widths[node->currentLevel];
+}
+
+inline double QuadTree::getHeight(Node * node){
+    return heights[node->currentLevel];
+}
+
+/*
+ * A read of a tree with concurrent reads on, from construction to
+ * destruction
+ */
+class TreeReader {
+public:
+    TreeReader(QuadTree * t){
+        tree    = t;
+        slot    = tree->beginRead();
+    }
+    ~TreeReader(){
+        tree->endRead(slot);
+    }
+private:
+    QuadTree * tree;
+    int slot;
 };
 
 #endif /* defined(____QuadTree__) */
\ No newline at end of file
@@ -0,0 +1,109 @@
+//
+//  SpaceApplication.h
+//
+/*
+ * The refinement and coarsening criteria of a SpaceTree of D dimensions,
+ * the counterpart of Application for any number of dimensions.  A node is
+ * passed as its lower corner and its size along each axis, x first.
+ *
+ * PlaneApplication passes the nodes of a SpaceTree<2> to an Application, so
+ * the criteria written for the QuadTree drive the two dimensional instance
+ * of the template, and Sphere is a criteria for any number of dimensions.
+ */
+//
+
+#ifndef ____SpaceApplication__
+#define ____SpaceApplication__
+
+#include <math.h>
+#include "Application.h"
+
+template<int D>
+class SpaceApplication {
+public:
+
+    virtual ~SpaceApplication(){}
+
+    /*
+     * Returns whether the node with lower corner corner[0..D-1] and sizes
+     * size[0..D-1] should be refined or coarsened
+     */
+    virtual bool refine(const double * corner, const double * size) = 0;
+    virtual bool coarsen(const double * corner, const double * size) = 0;
+
+};
+
+/*
+ * The criteria of an Application, for a SpaceTree<2>
+ */
+
+class PlaneApplication : public SpaceApplication<2> {
+public:
+
+    PlaneApplication(Application * application){
+        app = application;
+    }
+
+    bool refine(const double * corner, const double * size){
+        return app->refine(corner[0],corner[1],size[0],size[1]);
+    }
+
+    bool coarsen(const double * corner, const double * size){
+        return app->coarsen(corner[0],corner[1],size[0],size[1]);
+    }
+
+private:
+    Application * app;
+
+};
+
+/*
+ * The surface of a sphere is the refinement criteria, a circle in two
+ * dimensions: a node is refined if the surface passes through it, which is
+ * when the nearest point of the node is inside the sphere and the farthest
+ * is outside, and coarsened otherwise
+ */
+
+template<int D>
+class Sphere : public SpaceApplication<D> {
+public:
+
+    Sphere(const double * c, double r){
+        for(int a = 0; a < D; a++)
+            center[a] = c[a];
+        radius      = r;
+    }
+
+    bool refine(const double * corner, const double * size){
+        double nearest  = 0.0;
+        double farthest = 0.0;
+        for(int a = 0; a < D; a++){
+            double lo   = corner[a] - center[a];
+            double hi   = lo + size[a];
+            double n    = lo > 0.0 ? lo : (hi < 0.0 ? -hi : 0.0);
+            double f    = fabs(lo) > fabs(hi) ? fabs(lo) : fabs(hi);
+            nearest     += n*n;
+            farthest    += f*f;
+        }
+        return nearest <= radius*radius && farthest >= radius*radius;
+    }
+
+    bool coarsen(const double * corner, const double * size){
+        return !refine(corner, size);
+    }
+
+    /*
+     * Moves the center by offset[0..D-1]
+     */
+    void translate(const double * offset){
+        for(int a = 0; a < D; a++)
+            center[a] += offset[a];
+    }
+
+private:
+    double center[D];
+    double radius;
+
+};
+
+#endif /* defined(____SpaceApplication__) */
@@ -0,0 +1,592 @@
+//
+//  SpaceTree.h
+//
+/*
+ * A linear tree of any number of dimensions D: a quad tree for D = 2 and an
+ * octree for D = 3.  It is LinearQuadTree with the dimension a template
+ * parameter: only the leaves are stored, in one array sorted by the Morton
+ * key of their lower corner on the grid of the finest level, and a node is
+ * its key and level, passed by value.  A node has 2^D children, numbered
+ * by the bits of their corner as in MortonCode, and 2*D faces, the upper
+ * and lower face along each axis, with the axes from the last to the first
+ * so the faces of SpaceTree<2> are north, south, east and west as in
+ * QuadTree.  The numbers of children and faces and the children on each
+ * face are compile time constants of SpaceTraits.
+ *
+ * The criteria are a SpaceApplication<D>, PlaneApplication for the
+ * Applications of QuadTree.  SpaceTree<2> gives the same leaves and
+ * neighbors as LinearQuadTree; the pointer trees, QuadTree and its
+ * subclasses, stay two dimensional.
+ *
+ * Everything is in this header, as it is a template.
+ */
+//
+
+#ifndef ____SpaceTree__
+#define ____SpaceTree__
+
+#include <iostream>
+#include <cstdio>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "SpaceApplication.h"
+#include "Morton.h"
+#include "UpdateStats.h"
+
+/*
+ * The shape of a node of D dimensions
+ */
+template<int D>
+struct SpaceTraits {
+
+    static const int children = 1 << D;
+    static const int faces = 2*D;
+    static const int faceChildren = 1 << (D-1); //children on each face
+    static const int maxDepth = MortonCode<D>::maxDepth;
+
+    /*
+     * The axis across a face and whether it is the upper face
+     */
+    static int axis(int face){
+        return D - 1 - face/2;
+    }
+
+    static bool upper(int face){
+        return face % 2 == 0;
+    }
+
+    /*
+     * The k-th child on a face, 0 <= k < faceChildren: its bit along the
+     * face's axis is set for the upper face, the other bits are k's
+     */
+    static int faceChild(int face, int k){
+        int a   = axis(face);
+        int low = k & ((1 << a) - 1);
+        return ((k >> a) << (a + 1)) | ((upper(face) ? 1 : 0) << a) | low;
+    }
+
+};
+
+/*
+ * A node of the tree
+ */
+
+template<int D>
+struct SpaceNode{
+
+public:
+
+    uint64_t key; //Morton key of the lower corner on the finest grid
+    int level; //level in tree where the node is
+
+    //constructors
+    SpaceNode(){
+        key     = 0;
+        level   = 0;
+    }
+
+    SpaceNode(uint64_t k, int l){
+        key     = k;
+        level   = l;
+    }
+
+    bool operator==(const SpaceNode& other) const{
+        return key == other.key && level == other.level;
+    }
+
+};
+
+
+
+template<int D>
+class SpaceTree {
+public:
+
+    typedef SpaceNode<D> Node;
+    typedef SpaceTraits<D> Traits;
+
+    /*
+     * Constructor that initializes the tree, takes in the lower corner and
+     * size of the space along each axis, the number of cells in the initial
+     * decomposition (must be a power of 2^D) and the maximum level, which
+     * is at most Traits::maxDepth
+     */
+    SpaceTree(const double * corner, const double * size, int numCells,
+              int max, SpaceApplication<D> * app);
+
+    /*
+     * Destructor
+     */
+    virtual ~SpaceTree(){}
+
+    /*
+     * Refines and coarsens the tree until the desired refinement is reached
+     */
+    void update();
+
+    /*
+     * Refines a leaf, and coarsens a node by replacing all the leaves below
+     * it with the node
+     */
+    void refineNode(const Node& node);
+    void coarsenNode(const Node& node);
+
+    /*
+     * Returns false if the node cannot be coarsened or refined
+     */
+    virtual bool refine(const Node& node);
+    virtual bool coarsen(const Node& node);
+
+    /*
+     * Returns the parent and a child of a node, and whether a node is a leaf
+     */
+    Node parent(const Node& node);
+    Node child(const Node& node, int type);
+    bool isLeaf(const Node& node);
+
+
+    /**********************DEBUGGING AND TREE INFO****************************/
+
+    /*
+     * Returns all the leaf nodes, in Morton order
+     */
+    void findLeaves(std::vector<Node>& list);
+
+    /*
+     * Method for getting the neighbors of a node in the tree, in 2*D
+     * vectors, one per face
+     */
+    void getNeighbors(const Node& node,
+                      std::vector<std::vector<Node> >& neighbors);
+
+    /*
+     * Returns the lower corner of a node and then its size, along each axis
+     */
+    std::vector<double> getBounds(const Node& node);
+
+    /*
+     * Method for getting dimensions of the tree, the lower corner and the
+     * size along each axis
+     */
+    std::vector<double> getDimensions();
+
+    /*
+     * Getter and setter for max level of the tree
+     */
+    int getMaxLevel();
+    void setMaxLevel(int level);
+
+    /*
+     * Getter and setter to turn update timing on/off
+     */
+    bool getTime();
+    void setTime(bool t);
+
+    /*
+     * Returns where the time of the last update went and the nodes it
+     * created and destroyed, with the neighbor searches since it started
+     */
+    const UpdateStats& getStats();
+
+    /*
+     * Counts the number of nodes in the tree, the leaves and the nodes
+     * above them, and the number of leaves
+     */
+    long countNodes();
+    int countLeaves();
+
+    /*
+     * Returns the total amount of memory used to store the tree
+     */
+    int storage();
+
+    /*
+     * Finds the leaf node that contains the point p[0..D-1], or the nearest
+     * leaf to a point outside the space
+     */
+    Node findNode(const double * p);
+
+private:
+    /*
+     * Traverses the tree refining and coarsening the nodes, node holds the
+     * leaves from lo up to hi and the leaves after updating are added to
+     * next
+     */
+    void checkCriteria(const Node& node, size_t lo, size_t hi,
+                       std::vector<Node>& next);
+
+    /*
+     * Refines the node as far as possible, adding the leaves to next
+     */
+    void fullyRefine(const Node& node, std::vector<Node>& next);
+
+    /*
+     * Returns the index of the leaf that holds the cell with the given key
+     * on the finest grid and the index of the first leaf from the key on
+     */
+    size_t locate(uint64_t key);
+    size_t lowerBound(uint64_t key);
+
+    /*
+     * Nodes below a node with n leaves below it
+     */
+    long descendants(size_t n);
+
+    /*
+     * Adds the leaves below node that touch one of its faces
+     */
+    void faceLeaves(const Node& node, int face, std::vector<Node>& list);
+
+    static bool keyLess(const Node& node, uint64_t key){
+        return node.key < key;
+    }
+
+    static bool keyGreater(uint64_t key, const Node& node){
+        return key < node.key;
+    }
+
+/*********************** INSTANCE VARIABLES *********************************/
+
+    std::vector<Node> leaves; //sorted by key
+    SpaceApplication<D> * app;
+
+    double rootCorner[D];
+    double rootSize[D];
+
+    int maxLevel;
+    bool time;
+    UpdateStats stats;
+
+};
+
+/*
+ * Constructor
+ */
+template<int D>
+SpaceTree<D>::SpaceTree(const double * corner, const double * size,
+                        int numCells, int max, SpaceApplication<D> * application){
+    app             = application;
+    for(int a = 0; a < D; a++){
+        rootCorner[a]   = corner[a];
+        rootSize[a]     = size[a];
+    }
+    int numLevels   = 0; //stores the number of levels in the tree
+    int i           = numCells;
+    while(i>>=1)
+        ++numLevels;
+
+    //the initial decomposition is every node of its level, in key order
+    int level       = numLevels/D;
+    uint64_t n      = 1ULL << (D*level);
+    leaves.reserve(n);
+    for(uint64_t k = 0; k < n; k++)
+        leaves.push_back(Node(k*MortonCode<D>::span(level), level));
+
+    setMaxLevel(max);
+    time            = false;
+}
+
+/*
+ * Updates the tree using refinement and coarsening criteria
+ * Times the phases of the update if time is true
+ */
+template<int D>
+void SpaceTree<D>::update(){
+    stats.reset();
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    std::vector<Node> next;
+    next.reserve(leaves.size());
+    checkCriteria(Node(0,0), 0, leaves.size(), next);
+    leaves.swap(next);
+    if(time){
+        stats.total     = UpdateStats::since(start);
+        stats.criteria  = stats.total - stats.allocation - stats.deletion;
+    }
+}
+
+/*
+ * Recursive helper method for updating the tree
+ */
+template<int D>
+void SpaceTree<D>::checkCriteria(const Node& node, size_t lo, size_t hi,
+                                 std::vector<Node>& next){
+    if(hi - lo == 1 && leaves[lo].level == node.level){
+        if(refine(node)){
+            //the criteria of the new nodes are timed with their allocation
+            std::chrono::steady_clock::time_point start;
+            if(time)
+                start       = UpdateStats::now();
+            fullyRefine(node, next);
+            if(time)
+                stats.allocation += UpdateStats::since(start);
+        }
+        else
+            next.push_back(node);
+    }
+    else if(coarsen(node)){
+        //the leaves below are dropped by not copying them
+        next.push_back(node);
+        stats.destroyed += descendants(hi - lo);
+    }
+    else{
+        //split the run of leaves between the children
+        for(int c = 0; c < Traits::children; c++){
+            Node ch         = child(node, c);
+            size_t end      = hi;
+            if(c < Traits::children - 1)
+                end = std::lower_bound(leaves.begin()+lo, leaves.begin()+hi,
+                                       ch.key + MortonCode<D>::span(ch.level),
+                                       keyLess) - leaves.begin();
+            checkCriteria(ch, lo, end, next);
+            lo              = end;
+        }
+    }
+}
+
+/*
+ * Returns a boolean determining if the node should be coarsened
+ */
+template<int D>
+bool SpaceTree<D>::coarsen(const Node& node){
+    std::vector<double> b = getBounds(node);
+    return app->coarsen(&b[0], &b[D]);
+}
+
+/*
+ * Returns a boolean determining if the node should be refined
+ */
+template<int D>
+bool SpaceTree<D>::refine(const Node& node){
+    if(node.level >= maxLevel){
+        return false;
+    }
+
+    else {
+        std::vector<double> b = getBounds(node);
+        return app->refine(&b[0], &b[D]);
+    }
+
+}
+
+/*
+ * Refines a leaf node by replacing it with its children
+ */
+template<int D>
+void SpaceTree<D>::refineNode(const Node& node){
+    size_t i = lowerBound(node.key);
+    if(i == leaves.size() || !(leaves[i] == node) ||
+       node.level >= Traits::maxDepth)
+        return; //not a leaf, or no room for children
+    leaves[i] = child(node, 0);
+    Node rest[Traits::children - 1];
+    for(int c = 1; c < Traits::children; c++)
+        rest[c-1] = child(node, c);
+    leaves.insert(leaves.begin()+i+1, rest, rest+Traits::children-1);
+    stats.created += Traits::children;
+}
+
+/*
+ * Coarsens a node by replacing all of its descendants with it
+ */
+template<int D>
+void SpaceTree<D>::coarsenNode(const Node& node){
+    size_t lo = lowerBound(node.key);
+    size_t hi = lowerBound(node.key + MortonCode<D>::span(node.level));
+    if(lo == hi)
+        return;
+    leaves[lo] = node;
+    leaves.erase(leaves.begin()+lo+1, leaves.begin()+hi);
+    stats.destroyed += descendants(hi - lo);
+}
+
+/*
+ * Refines the nodes as far as necessary:
+ *
+ * To the maximum level or
+ * The refinement criteria is no longer satisfied
+ */
+template<int D>
+void SpaceTree<D>::fullyRefine(const Node& node, std::vector<Node>& next){
+    stats.created += Traits::children;
+    for(int c = 0; c < Traits::children; c++){
+        Node ch = child(node, c);
+        if(refine(ch))
+            fullyRefine(ch, next);
+        else
+            next.push_back(ch);
+    }
+}
+
+template<int D>
+SpaceNode<D> SpaceTree<D>::child(const Node& node, int type){
+    return Node(node.key + type*MortonCode<D>::span(node.level+1),
+                node.level+1);
+}
+
+template<int D>
+SpaceNode<D> SpaceTree<D>::parent(const Node& node){
+    if(node.level == 0)
+        return node;
+    return Node(node.key & ~(MortonCode<D>::span(node.level-1)-1),
+                node.level-1);
+}
+
+//every node above the leaves has 2^D children, so a node with n leaves
+//below it has (2^D n-1)/(2^D-1) nodes in its subtree
+template<int D>
+long SpaceTree<D>::descendants(size_t n){
+    long c = Traits::children;
+    return (c*long(n)-1)/(c-1) - 1;
+}
+
+template<int D>
+bool SpaceTree<D>::isLeaf(const Node& node){
+    size_t i = lowerBound(node.key);
+    return i < leaves.size() && leaves[i] == node;
+}
+
+template<int D>
+size_t SpaceTree<D>::lowerBound(uint64_t key){
+    return std::lower_bound(leaves.begin(), leaves.end(), key, keyLess) -
+           leaves.begin();
+}
+
+template<int D>
+size_t SpaceTree<D>::locate(uint64_t key){
+    return std::upper_bound(leaves.begin(), leaves.end(), key, keyGreater) -
+           leaves.begin() - 1;
+}
+
+/**********************DEBUGGING AND TREE INFO****************************/
+
+template<int D>
+int SpaceTree<D>::getMaxLevel(){
+    return maxLevel;
+}
+
+template<int D>
+void SpaceTree<D>::setMaxLevel(int level){
+    //the keys have no room below Traits::maxDepth
+    maxLevel = level < Traits::maxDepth ? level : Traits::maxDepth;
+}
+
+template<int D>
+bool SpaceTree<D>::getTime(){
+    return time;
+}
+
+template<int D>
+void SpaceTree<D>::setTime(bool t){
+    time = t;
+}
+
+template<int D>
+const UpdateStats& SpaceTree<D>::getStats(){
+    return stats;
+}
+
+//memory usage
+template<int D>
+int SpaceTree<D>::storage(){
+    return leaves.size()*sizeof(Node);
+}
+
+template<int D>
+long SpaceTree<D>::countNodes(){
+    return descendants(leaves.size()) + 1;
+}
+
+template<int D>
+int SpaceTree<D>::countLeaves(){
+    return leaves.size();
+}
+
+//find which node a given point is located, points outside taken to the
+//nearest cell
+template<int D>
+SpaceNode<D> SpaceTree<D>::findNode(const double * p){
+    double n    = ldexp(1.0, Traits::maxDepth);
+    uint64_t c[D];
+    for(int a = 0; a < D; a++){
+        double f    = floor((p[a] - rootCorner[a])/rootSize[a]*n);
+        c[a]        = f < 0 ? 0 : (f >= n ? (uint64_t) n - 1 : (uint64_t) f);
+    }
+    return leaves[locate(MortonCode<D>::encode(c))];
+}
+
+template<int D>
+void SpaceTree<D>::findLeaves(std::vector<Node>& list){
+    list.insert(list.end(), leaves.begin(), leaves.end());
+}
+
+template<int D>
+std::vector<double> SpaceTree<D>::getBounds(const Node& node){
+    std::vector<double> bounds(2*D);
+    uint64_t c[D];
+    MortonCode<D>::decode(node.key, c);
+    for(int a = 0; a < D; a++){
+        bounds[a]   = rootCorner[a] + ldexp(rootSize[a]*c[a],
+                                            -Traits::maxDepth);
+        bounds[D+a] = ldexp(rootSize[a], -node.level);
+    }
+    return bounds;
+}
+
+template<int D>
+std::vector<double> SpaceTree<D>::getDimensions(){
+    std::vector<double> dims(rootCorner, rootCorner+D);
+    dims.insert(dims.end(), rootSize, rootSize+D);
+    return dims;
+}
+
+
+/************************* NEIGHBOR FINDING ******************************/
+
+template<int D>
+void SpaceTree<D>::getNeighbors(const Node& node,
+                                std::vector<std::vector<Node> >& neighbors){
+    std::chrono::steady_clock::time_point start;
+    if(time)
+        start = UpdateStats::now();
+    uint64_t c[D];
+    MortonCode<D>::decode(node.key, c);
+    uint64_t s  = 1ULL << (Traits::maxDepth - node.level);
+    uint64_t n  = 1ULL << Traits::maxDepth;
+
+    for(int f = 0; f < Traits::faces; f++){
+        //the node of the same size across the face, if inside the space
+        int a       = Traits::axis(f);
+        uint64_t o  = c[a];
+        if(Traits::upper(f) ? c[a]+s >= n : c[a] < s)
+            continue;
+        c[a]        = Traits::upper(f) ? c[a]+s : c[a]-s;
+        Node across(MortonCode<D>::encode(c), node.level);
+        c[a]        = o;
+        const Node& leaf = leaves[locate(across.key)];
+        if(leaf.level <= node.level)
+            neighbors[f].push_back(leaf); //same level or less refined
+        else
+            faceLeaves(across, f^1, neighbors[f]); //more refined
+    }
+    if(time)
+        stats.neighbors += UpdateStats::since(start);
+}
+
+template<int D>
+void SpaceTree<D>::faceLeaves(const Node& node, int face,
+                              std::vector<Node>& list){
+    const Node& leaf = leaves[locate(node.key)];
+    if(leaf.level <= node.level)
+        list.push_back(leaf);
+    else {
+        for(int k = 0; k < Traits::faceChildren; k++)
+            faceLeaves(child(node, Traits::faceChild(face, k)), face, list);
+    }
+}
+
+#endif /* defined(____SpaceTree__) */
@@ -0,0 +1,207 @@
+//
+//  TreeStream.h
+//
+//  The binary checkpoint format of QuadTree and LinearQuadTree, so either
+//  tree reads what the other writes.  A checkpoint is a header followed by
+//  the structure of the tree in one of two forms:
+//
+//  TREE_BITS  one bit per node in depth first order, 1 for a node with
+//             children and 0 for a leaf, visiting the children SW, SE, NW,
+//             NE, packed eight to a byte from the lowest bit
+//  TREE_KEYS  the leaves in Morton order, each its 8 byte key on the grid
+//             of the finest level and 1 byte level
+//
+//  and then, if the tree had fields, the values of each leaf, all fields of
+//  the first leaf in Morton order, then the next.  Numbers are written in
+//  the byte order of the machine.
+//
+
+#ifndef ____TreeStream__
+#define ____TreeStream__
+
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+#include "Morton.h"
+
+#define TREE_STREAM_MAGIC 0x54524d41 //AMRT
+#define TREE_STREAM_VERSION 1
+
+/*
+ * The forms of the structure
+ */
+#define TREE_BITS 0
+#define TREE_KEYS 1
+
+template<class T>
+inline void writeRaw(std::ostream& out, const T& v){
+    out.write((const char*) &v, sizeof(T));
+}
+
+template<class T>
+inline bool readRaw(std::istream& in, T& v){
+    return (bool) in.read((char*) &v, sizeof(T));
+}
+
+/*
+ * The header: the form, the maximum level and the space of the tree, the
+ * number of bits or leaves that follow and the number of fields
+ */
+struct TreeHeader{
+
+public:
+
+    uint32_t format;
+    int32_t maxLevel;
+    double x;
+    double y;
+    double width;
+    double height;
+    uint64_t count;
+    uint32_t numFields;
+
+    void write(std::ostream& out) const{
+        writeRaw(out, (uint32_t) TREE_STREAM_MAGIC);
+        writeRaw(out, (uint32_t) TREE_STREAM_VERSION);
+        writeRaw(out, format);
+        writeRaw(out, maxLevel);
+        writeRaw(out, x);
+        writeRaw(out, y);
+        writeRaw(out, width);
+        writeRaw(out, height);
+        writeRaw(out, count);
+        writeRaw(out, numFields);
+    }
+
+    /*
+     * False if the stream ends or is not a checkpoint of this version
+     */
+    bool read(std::istream& in){
+        uint32_t magic;
+        uint32_t version;
+        if(!readRaw(in, magic) || magic != TREE_STREAM_MAGIC ||
+           !readRaw(in, version) || version != TREE_STREAM_VERSION)
+            return false;
+        return readRaw(in, format) && readRaw(in, maxLevel) &&
+               readRaw(in, x) && readRaw(in, y) && readRaw(in, width) &&
+               readRaw(in, height) && readRaw(in, count) &&
+               readRaw(in, numFields) &&
+               (format == TREE_BITS || format == TREE_KEYS);
+    }
+
+};
+
+/*
+ * Writes bits packed eight to a byte
+ */
+class BitWriter{
+public:
+
+    BitWriter(std::ostream& o) : out(o){
+        byte    = 0;
+        n       = 0;
+    }
+
+    void put(bool bit){
+        byte    |= (bit ? 1 : 0) << n;
+        if(++n == 8)
+            flush();
+    }
+
+    //writes the last partial byte
+    void flush(){
+        if(n > 0)
+            out.put(byte);
+        byte    = 0;
+        n       = 0;
+    }
+
+private:
+    std::ostream& out;
+    uint8_t byte;
+    int n;
+
+};
+
+/*
+ * Returns bit k of packed bits
+ */
+inline bool bitAt(const std::vector<uint8_t>& bits, uint64_t k){
+    return (bits[k >> 3] >> (k & 7)) & 1;
+}
+
+/*
+ * Reads the packed bits of count nodes, returning false if the stream ends
+ * or they are not one whole tree at most MORTON_MAX_DEPTH levels deep, and
+ * counts the leaves.  The bytes are read a block at a time, so a count the
+ * stream does not hold fails when the stream ends
+ */
+inline bool readTreeBits(std::istream& in, uint64_t count,
+                         std::vector<uint8_t>& bits, uint64_t& leaves){
+    uint64_t bytes  = (count + 7)/8;
+    bits.clear();
+    while(bits.size() < bytes){
+        size_t n    = bytes - bits.size() < 65536 ? bytes - bits.size() : 65536;
+        size_t at   = bits.size();
+        bits.resize(at + n);
+        if(!in.read((char*) &bits[at], n))
+            return false;
+    }
+
+    //the levels of the nodes still to come, deepest last
+    std::vector<int> pending(1, 0);
+    leaves          = 0;
+    for(uint64_t k = 0; k < count; k++){
+        if(pending.empty())
+            return false;
+        int level   = pending.back();
+        pending.pop_back();
+        if(bitAt(bits, k)){
+            if(level >= MORTON_MAX_DEPTH)
+                return false;
+            pending.insert(pending.end(), 4, level + 1);
+        }
+        else
+            leaves++;
+    }
+    return pending.empty();
+}
+
+/*
+ * Reads the keys and levels of count leaves, returning false if the stream
+ * ends or they are not nodes that tile the space in Morton order
+ */
+inline bool readTreeKeys(std::istream& in, uint64_t count,
+                         std::vector<std::pair<uint64_t,int> >& keys){
+    keys.clear();
+    uint64_t next   = 0; //key the next leaf must start at
+    for(uint64_t k = 0; k < count; k++){
+        uint64_t key;
+        uint8_t level;
+        if(!readRaw(in, key) || !readRaw(in, level) ||
+           level > MORTON_MAX_DEPTH || key != next ||
+           (key & (mortonSpan(level) - 1)) != 0)
+            return false;
+        keys.push_back(std::make_pair(key, (int) level));
+        next        += mortonSpan(level);
+    }
+    return next == mortonSpan(0);
+}
+
+/*
+ * Reads the numFields values of each of the leaves
+ */
+inline bool readTreeValues(std::istream& in, uint64_t leaves, int numFields,
+                           std::vector<double>& values){
+    values.clear();
+    for(uint64_t k = 0; k < leaves*numFields; k++){
+        double v;
+        if(!readRaw(in, v))
+            return false;
+        values.push_back(v);
+    }
+    return true;
+}
+
+#endif /* defined(____TreeStream__) */
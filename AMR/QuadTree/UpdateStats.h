@@ -0,0 +1,74 @@
+//
+//  UpdateStats.h
+//
+//  Where the time of a tree update goes, shared by QuadTree,
+//  LinearQuadTree and DistributedQuadTree.  The times are wall clock
+//  seconds from steady_clock, taken only when the tree's timing is on; the
+//  node counts are kept always.  Phases run by several threads add up each
+//  thread's time, so they can sum to more than total.
+//
+
+#ifndef ____UpdateStats__
+#define ____UpdateStats__
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+struct UpdateStats{
+    
+public:
+    
+    double total; //the whole update
+    double criteria; //in update, but not refining, coarsening or balancing
+    double allocation; //refining nodes
+    double deletion; //coarsening nodes
+    double balance; //restoring 2:1 balance, Neighbor only
+    double neighbors; //finding neighbors, in and since the update
+    double partition; //moving leaves between ranks and exchanging ghosts, DistributedQuadTree only
+    long created; //nodes
+    long destroyed;
+    
+    UpdateStats(){
+        reset();
+    }
+    
+    void reset(){
+        total       = 0.0;
+        criteria    = 0.0;
+        allocation  = 0.0;
+        deletion    = 0.0;
+        balance     = 0.0;
+        neighbors   = 0.0;
+        partition   = 0.0;
+        created     = 0;
+        destroyed   = 0;
+    }
+    
+    /*
+     * The stats as one JSON object
+     */
+    std::string json() const{
+        std::ostringstream out;
+        out <<"{\"total\": "<<total<<", \"criteria\": "<<criteria<<
+        ", \"allocation\": "<<allocation<<", \"deletion\": "<<deletion<<
+        ", \"balance\": "<<balance<<", \"neighbors\": "<<neighbors<<
+        ", \"partition\": "<<partition<<
+        ", \"created\": "<<created<<", \"destroyed\": "<<destroyed<<"}";
+        return out.str();
+    }
+    
+    /*
+     * Seconds from a time taken with now()
+     */
+    static std::chrono::steady_clock::time_point now(){
+        return std::chrono::steady_clock::now();
+    }
+    
+    static double since(std::chrono::steady_clock::time_point start){
+        return std::chrono::duration<double>(now() - start).count();
+    }
+    
+};
+
+#endif /* defined(____UpdateStats__) */
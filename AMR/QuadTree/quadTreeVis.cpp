@@ -15,13 +15,18 @@
 #include <stdlib.h>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <math.h>
 #include <vector>
 #include <string>
-#include <time.h>
+#include "../../instrument/cody.h"
 //#include "QuadTree.h"
 #include "OneLevel.h" //include the derived class
 #include "Neighbor.h"
+#include "LinearQuadTree.h"
+#include "SpaceTree.h"
+#include "HeatSolver.h"
+#include "HydroSolver.h"
 #include "treeRenderer.h"
 
 //#include "Application.h"
@@ -43,8 +48,9 @@ double originalB;
 
 //holds neighbor info, passed to treeRenderer
 vector<vector<Rectangle> > neighborInfo;
-//holds grid info, passed to treeRenderer
-vector<Rectangle> gridInfo;
+//the outlines of the leaves, brought up to date only when the tree changed
+LeafBuffer leafBuffer;
+bool treeChanged = true;
 
 bool dynamic            = false;
 double sleepTime        = 0;
@@ -53,6 +59,18 @@ bool updateDestructTest = true;
 bool neighborTest       = true;
 bool traversalTest      = true;
 bool updateTest         = false;
+bool linearTest         = true;
+bool parallelTest       = true;
+bool findTest           = true;
+bool heatTest           = true;
+bool hydroTest          = true;
+bool batchTest          = true;
+bool balanceTest        = true;
+bool incrementalTest    = true;
+bool concurrentTest     = true;
+bool statsTest          = true;
+bool spaceTest          = true;
+bool checkpointTest     = true;
 
 
 /*
@@ -78,7 +96,8 @@ vector<Rectangle> convert(vector<Node*> nodes){
     vector<Rectangle> coords;
     for(vector<Node*>::iterator IT = nodes.begin();
         IT!=nodes.end();IT++){
-        Rectangle rec((*IT)->x,(*IT)->y,(*IT)->width,(*IT)->height);
+        vector<double> b = tree->getBounds(*IT);
+        Rectangle rec(b[0],b[1],b[2],b[3]);
         coords.push_back(rec);
     }
     return coords;
@@ -110,19 +129,6 @@ vector<vector<Rectangle> > getNeighbors(double x,double y,
     return neighborCoords;
 }
 
-/* 
- * Returns the unfilled rectangles used to draw the grid
- * First finds all the leaves of the quad tree
- * Second convert leaves to rectangles to be drawn by treeRenderer
- * Again this method or variation of it might be later placed in the
- * quad tree class
- */
-vector<Rectangle> getGrid(){
-    vector<Node*> grid;
-    tree->findLeaves(grid);
-    return convert(grid);
-}
-
 /* 
  * Refines the node that was clicked in
  * First converts from pixel to world coordinates
@@ -134,6 +140,7 @@ bool refineNode(double x, double y, int dimX,int dimY){
     Node * node = tree->findNode(act[0],act[1]);
     if(tree->refine(node)){
         tree->refineNode(node);
+        tree->balance();
         return true;
     }
     else
@@ -152,6 +159,7 @@ bool coarsenNode(double x,double y,int dimX,int dimY){
     Node * node         = tree->findNode(act[0],act[1]);
     if(tree->coarsen(node)){
         tree->coarsenNode(node->parent);
+        tree->balance();
         return true;
     }
     else
@@ -163,6 +171,53 @@ bool coarsenNode(double x,double y,int dimX,int dimY){
  */
 void updateTree(){
     tree->update();
+    const UpdateStats& stats = tree->getStats();
+    if(stats.created > 0 || stats.destroyed > 0)
+        treeChanged = true;
+}
+
+/*
+ * Initial temperature of the heat test, a bump in the center of the space
+ */
+double heatBump(double x, double y){
+    return exp(-((x+2.0)*(x+2.0)+(y+2.0)*(y+2.0)));
+}
+
+/*
+ * Initial state of the hydro test, MISH's crn problem: density 1 and
+ * pressure 2.5 in the lower left quarter of the unit square, 0.125 and 0.25
+ * elsewhere, the gas at rest
+ */
+void crnState(double x, double y, double * q){
+    bool hi = x < 0.5 && y < 0.5;
+    q[0]    = hi ? 1.0 : 0.125;
+    q[1]    = 0.0;
+    q[2]    = 0.0;
+    q[3]    = hi ? 2.5 : 0.25;
+}
+
+/*
+ * Writes a row of the space test: the dimensions, max level and leaves of a
+ * tree and the time of its update and of finding the neighbors of every leaf
+ */
+template<int D>
+void spaceRow(ofstream& file, SpaceTree<D>& tree){
+    double start    = cody_now();
+    tree.update();
+    double update   = cody_now()-start;
+    vector<SpaceNode<D> > leaves;
+    tree.findLeaves(leaves);
+    start           = cody_now();
+    for(size_t k = 0; k < leaves.size(); k++){
+        vector<vector<SpaceNode<D> > > neighbors(2*D);
+        tree.getNeighbors(leaves[k], neighbors);
+    }
+    double find     = cody_now()-start;
+    if(file.is_open())
+        file <<D<<","<<tree.getMaxLevel()<<","<<leaves.size()<<","<<update<<
+        ","<<find<<"\n";
+    else
+        cout<<"FILE ERROR"<<endl;
 }
 
 /*
@@ -175,7 +230,10 @@ void display(){
     glColor3f (1.0, 1.0, 1.0);
     if(dynamic)
         updateTree();
-    gridInfo = getGrid();
+    if(treeChanged){
+        leafBuffer.update(tree);
+        treeChanged = false;
+    }
     
     
     treeRenderer::drawString(GLUT_BITMAP_HELVETICA_18, text, leftX, leftY, 0);
@@ -183,7 +241,7 @@ void display(){
     if(displayNeighbors)
         treeRenderer::displayHelperNeighbors(neighborInfo);
     
-    treeRenderer::displayHelperTree(gridInfo);
+    leafBuffer.draw();
     
     if(update || dynamic)
         treeRenderer::drawLine(seg->getx0(),seg->gety0(),
@@ -280,7 +338,6 @@ void mouse(int button, int state, int x, int y){
         if(update){
             updateTree();
             //cout<<"we finished updating"<<endl;
-            gridInfo        = getGrid();
             
         }
         if(displayNeighbors){//if the 'n' key was pressed, display neighbors
@@ -292,7 +349,7 @@ void mouse(int button, int state, int x, int y){
                 if(!coarsenNode(x,y,NPIX,NPIY))
                     text    = "Cannot Coarsen: at root or siblings not leaves";
                 else {
-                    gridInfo = getGrid();
+                    treeChanged = true;
                     text    = "";
                 }
             }
@@ -301,7 +358,7 @@ void mouse(int button, int state, int x, int y){
                 if(!refineNode(x,y,NPIX,NPIY))
                     text        = "Cannot Refine: reached max level";
                 else {
-                    gridInfo    = getGrid();
+                    treeChanged = true;
                     text        = "";
                 }
             }
@@ -358,6 +415,7 @@ int main(int argc, char* argv[]){
             seg                 = new Segment(-4.0,0.0,-1.0,originalB);
             Line * app2         = new Line(seg);
             tree                = new QuadTree(-4.0,-4.0,4.0,4.0,16,4,app2);
+            tree->setIncremental(true);
         }
         else if(string(argv[2]) == "neighbor") { //neighbor restriction
             Interaction * app = new Interaction();
@@ -372,7 +430,6 @@ int main(int argc, char* argv[]){
         width                   = dims[2];
         height                  = dims[3];
         NPIX = NPIY             = 512;
-        gridInfo                = getGrid();
         
         //glut initialization
         glutInit(&argc, argv);
@@ -395,38 +452,40 @@ int main(int argc, char* argv[]){
         seg                     = new Segment(-4.0,0.0,-1.0,originalB);
         seg->translate(1.5,1.5);
         Line * app3             = new Line(seg);
-        clock_t start,finish;
+        double start,finish;
         
         if(updateDestructTest) {
             //Tests the amount of time for the constructor and destructor as
             //as well as memory for different sizes trees
             ofstream file;
             file.open("updateDestruct.csv");
-            file <<"nodes,memory,update,destruct \n";
+            file <<"nodes,memory,utilization,update,destruct \n";
             
             for(int i=0;i<10;i++){//construct trees with a line through the center of different maximum depths, also neighbors
                 double averageTimeUpdate = 0.0;
                 double averageTimeDestructor = 0.0;
                 int nodes;
                 int memory;
+                double utilization;
                 for(int j=0;j<10;j++){
                     tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
-                    start   = clock();
+                    start   = cody_now();
                     updateTree();
-                    finish  = clock();
+                    finish  = cody_now();
                     nodes   = tree->countNodes();
                     memory  = tree->storage();
-                    averageTimeUpdate += (double(finish-start)/CLOCKS_PER_SEC);
+                    utilization = tree->poolUtilization();
+                    averageTimeUpdate += (finish-start);
                 
-                    start   = clock();
+                    start   = cody_now();
                     delete tree;
-                    finish  = clock();
-                    averageTimeDestructor += (double(finish-start)/CLOCKS_PER_SEC);
+                    finish  = cody_now();
+                    averageTimeDestructor += (finish-start);
                 }
                 averageTimeUpdate       = averageTimeUpdate/10.0;
                 averageTimeDestructor   = averageTimeDestructor/10.0;
                 if(file.is_open())
-                    file <<nodes<<","<<memory<<","<<averageTimeUpdate<<","<<
+                    file <<nodes<<","<<memory<<","<<utilization<<","<<averageTimeUpdate<<","<<
                     averageTimeDestructor<<"\n";
                 else
                     cout<<"FILE ERROR"<<endl;
@@ -441,9 +500,10 @@ int main(int argc, char* argv[]){
             tree = new QuadTree(-4.0,-4.0,4.0,4.0,1,0,app3);
             ofstream file;
             file.open("neighborTest.csv");
-            file <<"leaves,time,neighbors \n";
+            file <<"leaves,time,neighbors,cached \n";
             for(int i=0;i<10;i++){//construct trees with a line through the center of different maximum depths, also neighbors
                 double averageTimeNeighbors = 0.0;
+                double averageTimeCached = 0.0;
                 int nodes;
                 int numberOfNeighbors = 0;
                 for(int j=0;j<10;j++){
@@ -453,7 +513,7 @@ int main(int argc, char* argv[]){
                     nodes   = tree->countNodes();
                     tree->findLeaves(leaves);
                     nodes   = leaves.size();
-                    start   = clock();
+                    start   = cody_now();
                     for(int m = 0;m<leaves.size();m++) {
                         vector<Node*> vec;
                         vector<vector<Node*> > neighbors (4, vec);
@@ -463,16 +523,584 @@ int main(int argc, char* argv[]){
                         numberOfNeighbors += neighbors[2].size();
                         numberOfNeighbors += neighbors[3].size();
                     }
-                    finish = clock();
-                    averageTimeNeighbors += (double(finish-start)/CLOCKS_PER_SEC);
+                    finish = cody_now();
+                    averageTimeNeighbors += (finish-start);
+                    
+                    //again from the cache, once it is filled
+                    tree->setCacheNeighbors(true);
+                    for(int m = 0;m<leaves.size();m++)
+                        tree->neighborLists(leaves[m]);
+                    start   = cody_now();
+                    for(int m = 0;m<leaves.size();m++) {
+                        vector<Node*> vec;
+                        vector<vector<Node*> > neighbors (4, vec);
+                        tree->getNeighbors(leaves[m],neighbors);
+                    }
+                    finish = cody_now();
+                    averageTimeCached += (finish-start);
                     delete tree;
                 }
                 averageTimeNeighbors    = averageTimeNeighbors/10.0;
+                averageTimeCached       = averageTimeCached/10.0;
+                numberOfNeighbors       = numberOfNeighbors/10;
+                if(file.is_open())
+                    file <<nodes<<","<<averageTimeNeighbors<<","<<numberOfNeighbors<<","<<
+                    averageTimeCached<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+            file.close();
+        }
+        
+        if(linearTest){
+            // Tests the neighbor finding of the linear quad tree with the
+            // same trees as the neighbor test
+            ofstream file;
+            file.open("linearNeighborTest.csv");
+            file <<"leaves,update,time,neighbors,memory \n";
+            for(int i=0;i<10;i++){
+                double averageTimeUpdate = 0.0;
+                double averageTimeNeighbors = 0.0;
+                int nodes;
+                int memory;
+                int numberOfNeighbors = 0;
+                for(int j=0;j<10;j++){
+                    vector<LinearNode> leaves;
+                    LinearQuadTree * linear = new LinearQuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                    start   = cody_now();
+                    linear->update();
+                    finish  = cody_now();
+                    averageTimeUpdate += (finish-start);
+                    linear->findLeaves(leaves);
+                    nodes   = leaves.size();
+                    memory  = linear->storage();
+                    start   = cody_now();
+                    for(int m = 0;m<leaves.size();m++) {
+                        vector<LinearNode> vec;
+                        vector<vector<LinearNode> > neighbors (4, vec);
+                        linear->getNeighbors(leaves[m],neighbors);
+                        numberOfNeighbors += neighbors[0].size();
+                        numberOfNeighbors += neighbors[1].size();
+                        numberOfNeighbors += neighbors[2].size();
+                        numberOfNeighbors += neighbors[3].size();
+                    }
+                    finish = cody_now();
+                    averageTimeNeighbors += (finish-start);
+                    delete linear;
+                }
+                averageTimeUpdate       = averageTimeUpdate/10.0;
+                averageTimeNeighbors    = averageTimeNeighbors/10.0;
                 numberOfNeighbors       = numberOfNeighbors/10;
                 if(file.is_open())
-                    file <<nodes<<","<<averageTimeNeighbors<<","<<numberOfNeighbors<<"\n";
+                    file <<nodes<<","<<averageTimeUpdate<<","<<averageTimeNeighbors<<","<<
+                    numberOfNeighbors<<","<<memory<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+            file.close();
+        }
+        
+#ifdef _OPENMP
+        if(parallelTest){
+            // Tests the time to update trees of varying sizes serially and
+            // with tasks down to level 4
+            ofstream file;
+            file.open("parallelTest.csv");
+            file <<"threads,nodes,serial,parallel \n";
+            for(int i=6;i<14;i++){
+                double averageTimeSerial = 0.0;
+                double averageTimeParallel = 0.0;
+                int nodes;
+                for(int j=0;j<10;j++){
+                    for(int cutoff=0;cutoff<=4;cutoff+=4){
+                        tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                        tree->setTaskCutoff(cutoff);
+                        double begin = cody_now();
+                        updateTree();
+                        double end = cody_now();
+                        nodes   = tree->countNodes();
+                        if(cutoff == 0)
+                            averageTimeSerial += end-begin;
+                        else
+                            averageTimeParallel += end-begin;
+                        delete tree;
+                    }
+                }
+                averageTimeSerial       = averageTimeSerial/10.0;
+                averageTimeParallel     = averageTimeParallel/10.0;
+                if(file.is_open())
+                    file <<omp_get_max_threads()<<","<<nodes<<","<<averageTimeSerial<<","<<
+                    averageTimeParallel<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+            file.close();
+        }
+#endif
+        
+        if(findTest){
+            // Tests the time to locate a batch of random points one at a
+            // time and all at once, for trees of different sizes
+            ofstream file;
+            file.open("findTest.csv");
+            file <<"leaves,points,single,batch \n";
+            int numPoints = 100000;
+            vector<double> xs(numPoints), ys(numPoints);
+            vector<Node*> found(numPoints);
+            for(int k=0;k<numPoints;k++){
+                xs[k] = -4.0 + 4.0*(rand()/(RAND_MAX+1.0));
+                ys[k] = -4.0 + 4.0*(rand()/(RAND_MAX+1.0));
+            }
+            for(int i=0;i<14;i+=2){
+                vector<Node *> leaves;
+                tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                updateTree();
+                tree->findLeaves(leaves);
+                start   = cody_now();
+                for(int k=0;k<numPoints;k++)
+                    found[k] = tree->findNode(xs[k],ys[k]);
+                finish  = cody_now();
+                double single = (finish-start);
+                start   = cody_now();
+                tree->findNodes(&xs[0],&ys[0],numPoints,&found[0]);
+                finish  = cody_now();
+                double batch = (finish-start);
+                if(file.is_open())
+                    file <<leaves.size()<<","<<numPoints<<","<<single<<","<<batch<<"\n";
                 else
                     cout<<"FILE ERROR"<<endl;
+                delete tree;
+            }
+            file.close();
+        }
+        
+        if(heatTest){
+            // Tests the cost of an AMR timestep, updating the tree as the
+            // line moves and taking a step of the heat equation on the
+            // leaves, and how well the heat is conserved
+            ofstream file;
+            file.open("heatTest.csv");
+            file <<"leaves,update,step,drift \n";
+            int numSteps = 20;
+            for(int i=4;i<12;i+=2){
+                tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                updateTree();
+                FieldData * fields = new FieldData(1);
+                tree->setFields(fields);
+                HeatSolver * heat  = new HeatSolver(tree,0,1.0);
+                heat->setValues(heatBump);
+                double initial     = heat->total();
+                double updateTime  = 0.0;
+                double stepTime    = 0.0;
+                for(int j=0;j<numSteps;j++){
+                    seg->translate(0.01,0.01);
+                    start   = cody_now();
+                    updateTree();
+                    finish  = cody_now();
+                    updateTime += (finish-start);
+                    start   = cody_now();
+                    heat->step(heat->stableStep());
+                    finish  = cody_now();
+                    stepTime += (finish-start);
+                }
+                seg->translate(-0.01*numSteps,-0.01*numSteps);
+                vector<Node *> leaves;
+                tree->findLeaves(leaves);
+                double drift = fabs(heat->total()-initial)/initial;
+                if(file.is_open())
+                    file <<leaves.size()<<","<<updateTime/numSteps<<","<<
+                    stepTime/numSteps<<","<<drift<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+                delete heat;
+                delete tree;
+                delete fields;
+            }
+            file.close();
+        }
+        
+        if(hydroTest){
+            // Tests MISH's crn problem on the leaves of a balanced tree
+            // refined along the shocks by the density jumps, against the
+            // cells of the uniform grid of the finest level, and how well
+            // mass and energy are conserved
+            ofstream file;
+            file.open("hydroTest.csv");
+            file <<"maxLevel,leaves,uniform,steps,update,step,massDrift,energyDrift \n";
+            double tEnd = 0.1;
+            for(int i=5;i<9;i++){
+                DensityGradient * grad = new DensityGradient(4,0.05,0.01);
+                tree    = new Neighbor(0.0,0.0,1.0,1.0,16,i,grad);
+                FieldData * fields = new FieldData(5);
+                tree->setFields(fields);
+                grad->setTree(tree);
+                HydroSolver * hydro = new HydroSolver(tree,0,1.4,0.8);
+                //refine the initial discontinuity until the tree stops changing
+                int numLeaves = 0;
+                vector<Node *> leaves;
+                for(int l=0;l<=i;l++){
+                    hydro->setValues(crnState);
+                    hydro->markGradients();
+                    updateTree();
+                    leaves.clear();
+                    tree->findLeaves(leaves);
+                    if((int) leaves.size() == numLeaves)
+                        break;
+                    numLeaves = leaves.size();
+                }
+                hydro->setValues(crnState);
+                double mass        = hydro->total(0);
+                double energy      = hydro->total(3);
+                double updateTime  = 0.0;
+                double stepTime    = 0.0;
+                double t           = 0.0;
+                int numSteps       = 0;
+                long leafSteps     = 0;
+                while(t < tEnd){
+                    start   = cody_now();
+                    hydro->markGradients();
+                    updateTree();
+                    finish  = cody_now();
+                    updateTime += (finish-start);
+                    start   = cody_now();
+                    double dt = min(hydro->stableStep(), tEnd-t);
+                    hydro->step(dt);
+                    finish  = cody_now();
+                    stepTime += (finish-start);
+                    t       += dt;
+                    numSteps++;
+                    leaves.clear();
+                    tree->findLeaves(leaves);
+                    leafSteps += leaves.size();
+                }
+                double massDrift   = fabs(hydro->total(0)-mass)/mass;
+                double energyDrift = fabs(hydro->total(3)-energy)/energy;
+                if(file.is_open())
+                    file <<i<<","<<leafSteps/numSteps<<","<<(1L<<(2*i))<<","<<
+                    numSteps<<","<<updateTime/numSteps<<","<<stepTime/numSteps<<
+                    ","<<massDrift<<","<<energyDrift<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+                delete hydro;
+                delete tree;
+                delete fields;
+                delete grad;
+            }
+            file.close();
+        }
+        
+        if(batchTest){
+            // Tests the time to update trees of different sizes as the line
+            // moves, asking the application about one node at a time and
+            // about a level of nodes at once
+            ofstream file;
+            file.open("batchTest.csv");
+            file <<"leaves,single,batch \n";
+            int numSteps = 10;
+            for(int i=4;i<16;i+=2){
+                double times[2];
+                int numLeaves;
+                for(int b=0;b<2;b++){
+                    tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
+                    tree->setBatchCriteria(b == 1);
+                    updateTree();
+                    start   = cody_now();
+                    for(int j=0;j<numSteps;j++){
+                        seg->translate(0.01,0.01);
+                        updateTree();
+                    }
+                    finish  = cody_now();
+                    times[b] = (finish-start)/numSteps;
+                    seg->translate(-0.01*numSteps,-0.01*numSteps);
+                    vector<Node *> leaves;
+                    tree->findLeaves(leaves);
+                    numLeaves = leaves.size();
+                    delete tree;
+                }
+                if(file.is_open())
+                    file <<numLeaves<<","<<times[0]<<","<<times[1]<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+            file.close();
+        }
+        
+        if(balanceTest){
+            // Tests the time to update trees of different sizes as the line
+            // moves, without and with the 2:1 balance of Neighbor
+            ofstream file;
+            file.open("balanceTest.csv");
+            file <<"leaves,balanced leaves,update,balanced update \n";
+            int numSteps = 10;
+            for(int i=4;i<14;i+=2){
+                double times[2];
+                int numLeaves[2];
+                for(int b=0;b<2;b++){
+                    if(b == 0)
+                        tree = new QuadTree(-4.0,-4.0,4.0,4.0,16,i,app3);
+                    else
+                        tree = new Neighbor(-4.0,-4.0,4.0,4.0,16,i,app3);
+                    updateTree();
+                    start   = cody_now();
+                    for(int j=0;j<numSteps;j++){
+                        seg->translate(0.01,0.01);
+                        updateTree();
+                    }
+                    finish  = cody_now();
+                    times[b] = (finish-start)/numSteps;
+                    seg->translate(-0.01*numSteps,-0.01*numSteps);
+                    vector<Node *> leaves;
+                    tree->findLeaves(leaves);
+                    numLeaves[b] = leaves.size();
+                    delete tree;
+                }
+                if(file.is_open())
+                    file <<numLeaves[0]<<","<<numLeaves[1]<<","<<times[0]<<","<<
+                    times[1]<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+            }
+            file.close();
+        }
+        
+        if(incrementalTest){
+            // Tests the time to update trees of different sizes as the line
+            // moves and as it grows, checking the whole tree and only the
+            // regions the line reports, and that both give the same leaves
+            ofstream file;
+            file.open("incrementalTest.csv");
+            file <<"feature,leaves,full,incremental,same \n";
+            int numSteps = 10;
+            double x1    = seg->getx1();
+            for(int g=0;g<2;g++){
+                for(int i=4;i<16;i+=2){
+                    QuadTree * trees[2];
+                    double times[2] = {0.0, 0.0};
+                    for(int b=0;b<2;b++){
+                        trees[b] = new QuadTree(-4.0,-4.0,4.0,4.0,16,i,app3);
+                        trees[b]->setIncremental(b == 1);
+                        trees[b]->update();
+                    }
+                    for(int j=0;j<numSteps;j++){
+                        if(g == 0)
+                            seg->translate(0.01,0.01);
+                        else
+                            seg->setx1(seg->getx1()+0.1);
+                        for(int b=0;b<2;b++){
+                            tree    = trees[b];
+                            start   = cody_now();
+                            updateTree();
+                            finish  = cody_now();
+                            times[b] += (finish-start);
+                        }
+                    }
+                    if(g == 0)
+                        seg->translate(-0.01*numSteps,-0.01*numSteps);
+                    else
+                        seg->setx1(x1);
+                    vector<Node *> leaves[2];
+                    for(int b=0;b<2;b++)
+                        trees[b]->findLeavesMorton(leaves[b]);
+                    bool same = leaves[0].size() == leaves[1].size();
+                    for(size_t k=0;same && k<leaves[0].size();k++)
+                        same = leaves[0][k]->i == leaves[1][k]->i &&
+                        leaves[0][k]->j == leaves[1][k]->j &&
+                        leaves[0][k]->currentLevel == leaves[1][k]->currentLevel;
+                    if(file.is_open())
+                        file <<(g == 0 ? "move" : "grow")<<","<<leaves[0].size()<<
+                        ","<<times[0]/numSteps<<","<<times[1]/numSteps<<","<<same<<"\n";
+                    else
+                        cout<<"FILE ERROR"<<endl;
+                    delete trees[0];
+                    delete trees[1];
+                }
+            }
+            file.close();
+        }
+        
+        if(concurrentTest){
+            // Tests the time to update trees of different sizes as the line
+            // moves, alone and while the other OpenMP threads find the
+            // leaves at points spread over the space, and how many points
+            // they found in the meantime
+            ofstream file;
+            file.open("concurrentTest.csv");
+            file <<"leaves,update,concurrent update,points \n";
+            int numSteps = 10;
+            for(int i=4;i<14;i+=2){
+                tree    = new QuadTree(-4.0,-4.0,4.0,4.0,16,i,app3);
+                tree->setConcurrentReads(true);
+                updateTree();
+                double times[2];
+                long points = 0;
+                for(int b=0;b<2;b++){
+                    int done = 0;
+#pragma omp parallel if(b == 1) reduction(+:points)
+                    {
+                        int thread = 0;
+#ifdef _OPENMP
+                        thread = omp_get_thread_num();
+#endif
+                        if(thread == 0){
+                            double begin = cody_now();
+                            for(int j=0;j<numSteps;j++){
+                                seg->translate(0.01,0.01);
+                                updateTree();
+                            }
+                            times[b] = (cody_now()-begin)/numSteps;
+                            seg->translate(-0.01*numSteps,-0.01*numSteps);
+#pragma omp atomic write
+                            done = 1;
+                        }
+                        else {
+                            for(int k=0;;k++){
+                                int stop;
+#pragma omp atomic read
+                                stop = done;
+                                if(stop)
+                                    break;
+                                TreeReader reader(tree);
+                                for(int p=0;p<100;p++){
+                                    double f = (k*100+p)*0.6180339887;
+                                    tree->findNode(-4.0+4.0*(f-floor(f)),
+                                                   -4.0+4.0*(thread*0.1+p*0.01));
+                                }
+                                points += 100;
+                            }
+                        }
+                    }
+                }
+                vector<Node *> leaves;
+                tree->findLeaves(leaves);
+                if(file.is_open())
+                    file <<leaves.size()<<","<<times[0]<<","<<times[1]<<","<<
+                    points<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+                delete tree;
+            }
+            file.close();
+        }
+        
+        if(statsTest){
+            // Records where the time of an update goes, for the pointer,
+            // balanced and linear trees of different sizes as the line moves
+            ofstream file;
+            file.open("statsTest.json");
+            file <<"[\n";
+            for(int i=4;i<14;i+=2){
+                for(int t=0;t<3;t++){
+                    string name;
+                    UpdateStats stats;
+                    if(t < 2){
+                        if(t == 0)
+                            tree = new QuadTree(-4.0,-4.0,4.0,4.0,16,i,app3);
+                        else
+                            tree = new Neighbor(-4.0,-4.0,4.0,4.0,16,i,app3);
+                        name    = t == 0 ? "pointer" : "balanced";
+                        tree->setTime(true);
+                        updateTree();
+                        seg->translate(0.01,0.01);
+                        updateTree();
+                        stats   = tree->getStats();
+                        delete tree;
+                    }
+                    else {
+                        LinearQuadTree * linear = new LinearQuadTree(-4.0,-4.0,4.0,4.0,
+                                                                     16,i,app3);
+                        name    = "linear";
+                        linear->setTime(true);
+                        linear->update();
+                        seg->translate(0.01,0.01);
+                        linear->update();
+                        stats   = linear->getStats();
+                        delete linear;
+                    }
+                    seg->translate(-0.01,-0.01);
+                    if(file.is_open())
+                        file <<(i == 4 && t == 0 ? "" : ",\n")<<"{\"tree\": \""<<
+                        name<<"\", \"max level\": "<<i<<", \"stats\": "<<
+                        stats.json()<<"}";
+                    else
+                        cout<<"FILE ERROR"<<endl;
+                }
+            }
+            file <<"\n]\n";
+            file.close();
+        }
+        
+        if(spaceTest){
+            // Tests the templated tree in two dimensions, with the line, and
+            // in three, with a sphere refined along its surface
+            ofstream file;
+            file.open("spaceTest.csv");
+            file <<"dimensions,max level,leaves,update,neighbors \n";
+            PlaneApplication plane(app3);
+            double corner2[2]   = {-4.0,-4.0};
+            double size2[2]     = {4.0,4.0};
+            double corner3[3]   = {-4.0,-4.0,-4.0};
+            double size3[3]     = {4.0,4.0,4.0};
+            double center[3]    = {-2.0,-2.0,-2.0};
+            Sphere<3> sphere(center,1.0);
+            for(int i=4;i<10;i++){
+                SpaceTree<2> quad(corner2,size2,16,i,&plane);
+                spaceRow(file,quad);
+                SpaceTree<3> oct(corner3,size3,64,i,&sphere);
+                spaceRow(file,oct);
+            }
+            file.close();
+        }
+        
+        if(checkpointTest){
+            // Tests the size of a tree written as a bit per node and as
+            // the keys of its leaves, and the time to write it and read it
+            // back into a new pointer tree and a linear tree
+            ofstream file;
+            file.open("checkpointTest.csv");
+            file <<"leaves,bits bytes,keys bytes,write bits,read bits,"
+            "write keys,read keys,read linear \n";
+            for(int i=4;i<18;i+=2){
+                tree    = new QuadTree(-4.0,-4.0,4.0,4.0,16,i,app3);
+                updateTree();
+                vector<Node *> leaves;
+                tree->findLeaves(leaves);
+                size_t bytes[2];
+                double times[5];
+                bool same = true;
+                for(int f=0;f<2;f++){
+                    stringstream stream;
+                    start   = cody_now();
+                    tree->write(stream, f == 0 ? TREE_BITS : TREE_KEYS);
+                    finish  = cody_now();
+                    times[2*f] = finish-start;
+                    bytes[f] = stream.str().size();
+                    QuadTree copy(-4.0,-4.0,4.0,4.0,1,0,app3);
+                    start   = cody_now();
+                    same    = copy.read(stream) && same;
+                    finish  = cody_now();
+                    times[2*f+1] = finish-start;
+                    same    = copy.countNodes() == tree->countNodes() && same;
+                    if(f == 0){
+                        LinearQuadTree linear(-4.0,-4.0,4.0,4.0,1,0,app3);
+                        stream.clear();
+                        stream.seekg(0);
+                        start   = cody_now();
+                        same    = linear.read(stream) && same;
+                        finish  = cody_now();
+                        times[4] = finish-start;
+                        same    = linear.countLeaves() == (int) leaves.size() &&
+                                  same;
+                    }
+                }
+                if(!same)
+                    cout<<"CHECKPOINT ERROR"<<endl;
+                if(file.is_open())
+                    file <<leaves.size()<<","<<bytes[0]<<","<<bytes[1]<<","<<
+                    times[0]<<","<<times[1]<<","<<times[2]<<","<<times[3]<<
+                    ","<<times[4]<<"\n";
+                else
+                    cout<<"FILE ERROR"<<endl;
+                delete tree;
             }
             file.close();
         }
@@ -489,10 +1117,10 @@ int main(int argc, char* argv[]){
                 for(int j=0;j<10;j++){
                     tree    = new QuadTree(-4.0,-4.0,4.0,4.0,1,i,app3);
                     updateTree();
-                    start   = clock();
+                    start   = cody_now();
                     nodes   = tree->countNodes();
-                    finish  = clock();
-                    averageTimeTraversal += (double(finish-start)/CLOCKS_PER_SEC);
+                    finish  = cody_now();
+                    averageTimeTraversal += (finish-start);
                     delete tree;
                 }
                 averageTimeTraversal = averageTimeTraversal/10.0;
@@ -520,19 +1148,19 @@ int main(int argc, char* argv[]){
                 int initialNodes;
                 int finalNodes;
                 initialNodes        = tree->countNodes();
-                start = clock();
+                start = cody_now();
                 updateTree();
-                finish = clock();
-                updateTime          = (double(finish-start)/CLOCKS_PER_SEC);
+                finish = cody_now();
+                updateTime          = (finish-start);
                 finalNodes          = tree->countNodes();
                 refineTime          = tree->getTotalRefine();
                 coarsenTime         = tree->getTotalCoarsen();
                 seg->translate(0.25,0.25);
                 initialNodes        = tree->countNodes();
-                start               = clock();
+                start               = cody_now();
                 updateTree();
-                finish              = clock();
-                updateTime          = (double(finish-start)/CLOCKS_PER_SEC);
+                finish              = cody_now();
+                updateTime          = (finish-start);
                 finalNodes          = tree->countNodes();
                 refineTime          = tree->getTotalRefine();
                 coarsenTime         = tree->getTotalCoarsen();
@@ -544,10 +1172,10 @@ int main(int argc, char* argv[]){
                     cout<<"FILE ERROR"<<endl;
                 while(tree->countNodes() > 1){
                     initialNodes    = tree->countNodes();
-                    start           = clock();
+                    start           = cody_now();
                     updateTree();
-                    finish          = clock();
-                    updateTime      = (double(finish-start)/CLOCKS_PER_SEC);
+                    finish          = cody_now();
+                    updateTime      = (finish-start);
                     finalNodes      = tree->countNodes();
                     refineTime      = tree->getTotalRefine();
                     coarsenTime     = tree->getTotalCoarsen();
@@ -114,3 +114,151 @@ void treeRenderer::displayHelperTree(std::vector<Rectangle> gridInfo){
     glEnd();
     
 }
+
+
+/************************* LEAF BUFFER ******************************/
+
+//vertices of a slot and floats of a vertex
+#define SLOT_VERTICES 8
+#define SLOT_FLOATS (2*SLOT_VERTICES)
+
+//slots apart that are still copied to the buffer in one call
+#define UPLOAD_GAP 64
+
+LeafBuffer::LeafBuffer(){
+    numSlots    = 0;
+    capacity    = 0;
+    written     = 0;
+    buffer      = 0;
+}
+
+LeafBuffer::~LeafBuffer(){
+    if(buffer != 0)
+        glDeleteBuffers(1, &buffer);
+}
+
+/*
+ * Merges the leaves of the tree with the last ones, both in key order.  A
+ * leaf with the same key and level keeps its slot, the others give theirs
+ * back, and the new leaves take the slots given back before new ones
+ */
+void LeafBuffer::update(QuadTree * tree){
+    vector<Node*> nodes;
+    tree->findLeavesMorton(nodes);
+    vector<Slot> next;
+    next.reserve(nodes.size());
+    vector<int> dirty;
+    vector<size_t> added; //where the new leaves are in next
+    size_t k    = 0;
+    for(size_t n = 0; n < nodes.size(); n++){
+        uint64_t key    = mortonEncode(nodes[n]->i, nodes[n]->j);
+        int level       = nodes[n]->currentLevel;
+        while(k < leaves.size() && leaves[k].key < key){
+            clear(leaves[k].slot);
+            dirty.push_back(leaves[k].slot);
+            k++;
+        }
+        if(k < leaves.size() && leaves[k].key == key){
+            if(leaves[k].level == level){
+                next.push_back(leaves[k++]);
+                continue;
+            }
+            clear(leaves[k].slot);
+            dirty.push_back(leaves[k].slot);
+            k++;
+        }
+        added.push_back(next.size());
+        next.push_back(Slot(key, level, -1));
+    }
+    for(; k < leaves.size(); k++){
+        clear(leaves[k].slot);
+        dirty.push_back(leaves[k].slot);
+    }
+    
+    for(size_t a = 0; a < added.size(); a++){
+        Slot& leaf      = next[added[a]];
+        if(!freeSlots.empty()){
+            leaf.slot   = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        else {
+            leaf.slot   = numSlots++;
+            vertices.resize(numSlots*SLOT_FLOATS);
+        }
+        fill(leaf.slot, tree, nodes[added[a]]);
+        dirty.push_back(leaf.slot);
+    }
+    leaves.swap(next);
+    upload(dirty);
+}
+
+void LeafBuffer::fill(int slot, QuadTree * tree, Node * node){
+    float x0    = tree->getX(node);
+    float y0    = tree->getY(node);
+    float x1    = x0 + tree->getWidth(node);
+    float y1    = y0 + tree->getHeight(node);
+    float edges[SLOT_FLOATS] = {x0,y0, x1,y0,  x1,y0, x1,y1,
+                                x1,y1, x0,y1,  x0,y1, x0,y0};
+    copy(edges, edges+SLOT_FLOATS, vertices.begin()+slot*SLOT_FLOATS);
+}
+
+void LeafBuffer::clear(int slot){
+    fill_n(vertices.begin()+slot*SLOT_FLOATS, SLOT_FLOATS, 0.0f);
+    freeSlots.push_back(slot);
+}
+
+/*
+ * Copies runs of dirty slots to the buffer, or all of it when the buffer
+ * has to grow
+ */
+void LeafBuffer::upload(std::vector<int>& dirty){
+    sort(dirty.begin(), dirty.end());
+    dirty.erase(unique(dirty.begin(), dirty.end()), dirty.end());
+    if(buffer == 0)
+        glGenBuffers(1, &buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    if(numSlots > capacity){
+        capacity    = max(2*capacity, numSlots);
+        glBufferData(GL_ARRAY_BUFFER, capacity*SLOT_FLOATS*sizeof(float),
+                     NULL, GL_DYNAMIC_DRAW);
+        if(numSlots > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0,
+                            numSlots*SLOT_FLOATS*sizeof(float), &vertices[0]);
+        written     = numSlots;
+    }
+    else {
+        written     = dirty.size();
+        for(size_t d = 0; d < dirty.size();){
+            size_t e    = d + 1;
+            while(e < dirty.size() && dirty[e] - dirty[e-1] <= UPLOAD_GAP)
+                e++;
+            int lo      = dirty[d];
+            int hi      = dirty[e-1] + 1;
+            glBufferSubData(GL_ARRAY_BUFFER, lo*SLOT_FLOATS*sizeof(float),
+                            (hi-lo)*SLOT_FLOATS*sizeof(float),
+                            &vertices[lo*SLOT_FLOATS]);
+            d           = e;
+        }
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void LeafBuffer::draw(){
+    if(buffer == 0)
+        return;
+    glColor3f (0.0, 1.0, 0.0);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, 0);
+    glDrawArrays(GL_LINES, 0, numSlots*SLOT_VERTICES);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+int LeafBuffer::countLeaves(){
+    return leaves.size();
+}
+
+int LeafBuffer::getWritten(){
+    return written;
+}
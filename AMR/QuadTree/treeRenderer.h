@@ -13,12 +13,15 @@
 #define ____treeRenderer__
 
 #include <cstdio>
+#define GL_GLEXT_PROTOTYPES //the buffer object calls of OpenGL 1.5
 #include "GLUT/glut.h"
 #include <cstdlib>
 #include <iostream>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <stdint.h>
+#include "QuadTree.h"
 
 /* 
  * Simple struct to hold coordinates of quad tree leaves
@@ -69,4 +72,68 @@ public:
     
 };
 
+/*
+ * The outlines of the leaves of a QuadTree in one vertex buffer, drawn with
+ * one call instead of a glBegin and glEnd per leaf.  Each leaf has a slot
+ * of eight vertices, its four edges as GL_LINES.  update compares the
+ * leaves, in Morton order, with those it saw last, so only the slots of
+ * the leaves that came and went are written to the buffer; the slot of a
+ * leaf that went is zeroed, which draws nothing, until a new leaf takes
+ * it.  One LeafBuffer follows one tree, and needs a GL context
+ */
+class LeafBuffer{
+public:
+    
+    LeafBuffer();
+    ~LeafBuffer();
+    
+    /*
+     * Brings the buffer up to date with the leaves of the tree
+     */
+    void update(QuadTree * tree);
+    
+    /*
+     * Draws the outlines of the leaves
+     */
+    void draw();
+    
+    /*
+     * Leaves in the buffer, and slots written by the last update
+     */
+    int countLeaves();
+    int getWritten();
+    
+private:
+    /*
+     * A leaf, by its Morton key and level, and its slot
+     */
+    struct Slot{
+        uint64_t key;
+        int level;
+        int slot;
+        Slot(uint64_t k, int l, int s){
+            key     = k;
+            level   = l;
+            slot    = s;
+        }
+    };
+    
+    /*
+     * Writes the edges of a leaf to its slot, or zeros it, and copies the
+     * slots that changed to the buffer
+     */
+    void fill(int slot, QuadTree * tree, Node * node);
+    void clear(int slot);
+    void upload(std::vector<int>& dirty);
+    
+    std::vector<Slot> leaves; //sorted by key
+    std::vector<int> freeSlots;
+    std::vector<float> vertices; //x,y of the eight vertices of each slot
+    int numSlots;
+    int capacity; //slots the buffer object holds
+    int written;
+    GLuint buffer; //0 until the first update
+    
+};
+
 #endif /* defined(____treeRenderer__) */
\ No newline at end of file
@@ -0,0 +1,140 @@
+#!/usr/bin/python
+
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# Benchmark harness for the MISH implementations. Every combination of
+# implementation, init, size multiplier, rank count and thread count is run
+# in a scratch directory, and the TIME and PHASE lines printed by the shared
+# driver are collected into one CSV and/or JSON file.
+
+# How each implementation is launched: directory, MPI, threaded
+IMPLS={
+	'c':           ('hydro_c',         False, False),
+	'omp':         ('hydro_c_omp',     False, True),
+	'oac':         ('hydro_c_oac',     False, False),
+	'ispc':        ('hydro_ispc',      False, True),
+	'mpi':         ('hydro_c_mpi',     True,  False),
+	'mpi_omp':     ('hydro_c_mpi_omp', True,  True),
+	'cuda':        ('hydro_cuda',      False, False),
+	'cuda_mpi':    ('hydro_cuda_mpi',  True,  False),
+	'opencl':      ('hydro_opencl',    False, False),
+	'kokkos':      ('hydro_kokkos',    False, True),
+	'legion':      ('hydro_legion',    False, True),
+}
+# Threaded implementations that take their thread count as an argument
+# rather than from OMP_NUM_THREADS
+THREAD_ARG={'legion':'-ll:cpu'}
+
+PHASES=['prim','trace','riemann','flux','halo','dt','output']
+CTRS=['cycles','l2miss','l3miss','flops']
+FIELDS=['impl','cType','mType','init','size','nproc','nth','niters','ncells','wRunt']+PHASES
+
+def csvList(s):
+	return [v for v in s.split(',') if v]
+
+def intList(s):
+	return [int(v) for v in csvList(s)]
+
+# Parse the TIME, PHASE and CTR lines of one run into a record
+def parseRun(out):
+	rec={}
+	for line in out.splitlines():
+		if line.startswith('TIME:'):
+			row=next(csv.reader([line[5:]]))
+			rec['cType']=row[0]
+			rec['mType']=row[1]
+			rec['nproc']=int(row[3])
+			rec['nth']=int(row[4])
+			rec['niters']=int(row[5])
+			rec['ncells']=int(row[6])
+			rec['wRunt']=float(row[7])
+		elif line.startswith('PHASE:'):
+			row=next(csv.reader([line[6:]]))
+			for ph,v in zip(PHASES,row[5:]):
+				rec[ph]=float(v)
+		elif line.startswith('CTR:'):
+			# Hardware counters of one phase, JSON only
+			row=next(csv.reader([line[4:]]))
+			for c,v in zip(CTRS,row[5:]):
+				rec[row[4]+'_'+c]=int(v)
+	return rec if 'wRunt' in rec else None
+
+def runOne(args, impl, init, size, ranks, nth):
+	d,mpi,threaded=IMPLS[impl]
+	exe=os.path.join(args.root,d,'hydro')
+	cmd=[exe,init]
+	if init in ('wsc','scs'):
+		cmd.append(str(size))
+	if args.steps>=0:
+		cmd+=['-n',str(args.steps)]
+	if impl in THREAD_ARG:
+		cmd+=[THREAD_ARG[impl],str(nth)]
+	if mpi:
+		cmd=args.mpirun.split()+['-np',str(ranks)]+cmd
+	env=dict(os.environ)
+	env['OMP_NUM_THREADS']=str(nth)
+	env['MISH_MACHINE']=args.machine
+	with tempfile.TemporaryDirectory() as wd:
+		os.mkdir(os.path.join(wd,'outDir'))
+		p=subprocess.run(cmd,cwd=wd,env=env,stdout=subprocess.PIPE,stderr=subprocess.STDOUT,universal_newlines=True)
+	rec=parseRun(p.stdout)
+	if p.returncode!=0 or rec is None:
+		sys.stderr.write('FAILED: %s\n'%' '.join(cmd))
+		return None
+	rec['impl']=impl
+	rec['init']=init
+	rec['size']=size
+	return rec
+
+def main():
+	parser=argparse.ArgumentParser(description='Sweep the MISH implementations and collect their timings')
+	parser.add_argument('-i','--impl',default='c,omp',help='implementations: '+','.join(sorted(IMPLS)))
+	parser.add_argument('--init',default='wsc',help='inits to run')
+	parser.add_argument('-s','--size',default='1',help='size multipliers for wsc and scs')
+	parser.add_argument('-r','--ranks',default='1',help='MPI rank counts')
+	parser.add_argument('-t','--threads',default='1',help='OpenMP thread counts')
+	parser.add_argument('-n','--steps',type=int,default=100,help='timesteps per run, -1 for the init default')
+	parser.add_argument('--reps',type=int,default=1,help='repetitions of each run')
+	parser.add_argument('--machine',default='?',help='machine label for the mType column')
+	parser.add_argument('--mpirun',default='mpirun',help='MPI launcher')
+	parser.add_argument('--root',default=os.path.dirname(os.path.abspath(__file__)),help='MISH directory')
+	parser.add_argument('--csv',help='CSV file to write')
+	parser.add_argument('--json',help='JSON file to write')
+	args=parser.parse_args()
+
+	recs=[]
+	for impl in csvList(args.impl):
+		if impl not in IMPLS:
+			parser.error('unknown implementation '+impl)
+		d,mpi,threaded=IMPLS[impl]
+		for init in csvList(args.init):
+			sizes=intList(args.size) if init in ('wsc','scs') else [1]
+			for size in sizes:
+				for ranks in (intList(args.ranks) if mpi else [1]):
+					for nth in (intList(args.threads) if threaded else [1]):
+						for rep in range(args.reps):
+							rec=runOne(args,impl,init,size,ranks,nth)
+							if rec is None:
+								continue
+							recs.append(rec)
+							print(','.join(str(rec.get(f,'')) for f in FIELDS))
+							sys.stdout.flush()
+
+	if args.csv:
+		with open(args.csv,'w') as f:
+			w=csv.DictWriter(f,fieldnames=FIELDS,extrasaction='ignore')
+			w.writeheader()
+			for rec in recs:
+				w.writerow(rec)
+	if args.json:
+		with open(args.json,'w') as f:
+			json.dump(recs,f,indent=1)
+
+if __name__=='__main__':
+	main()
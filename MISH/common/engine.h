@@ -0,0 +1,37 @@
+#ifndef ENGINE_H_
+#define ENGINE_H_
+
+#include "hydro_struct.h"
+
+//Interface every implementation provides to the shared driver in main.c.
+//engine runs the problem in Hp on mesh (nvar*nx*ny, no halo), leaving the
+//final time and step count in Hp. MPI builds get a NULL mesh and set up
+//each rank's block themselves, from Ha->initFile or with initBlock
+void engine(int *argc, char **argv[], double *mesh, hydro_prob *Hp, hydro_args *Ha);
+//Release anything engine keeps from one call to the next
+void freeScratch();
+//Builds that define MISH_BATCH also provide engineBatch, which runs the nb
+//independent problems Hp[m] on mesh[m] together, as engine would run each
+#ifdef MISH_BATCH
+void engineBatch(int *argc, char **argv[], int nb, double **mesh, hydro_prob *Hp, hydro_args *Ha);
+#endif
+//Builds that define MISH_LIB can also be driven a few steps at a time, by
+//another code, through instances that hold their own copy of the problem,
+//mesh and scratch. Stepping allocates nothing and does no I/O. Ha needs
+//the physics (sigma, smallc, smallr, niter_riemann, scheme) and tend,
+//which may be negative to run without an end time
+#ifdef MISH_LIB
+typedef struct __hydroCtx hydro_ctx;
+hydro_ctx *hydro_create(hydro_prob *Hp, hydro_args *Ha, double *mesh);
+int hydro_step(hydro_ctx *ctx, int n);
+void hydro_get_state(hydro_ctx *ctx, double *mesh, hydro_prob *Hp);
+void hydro_set_state(hydro_ctx *ctx, double *mesh);
+void hydro_destroy(hydro_ctx *ctx);
+#endif
+
+//Provided by the driver: fill the bnx by bny block of the initial condition
+//from global cell (x0,y0) into blk, which has row stride rs and variable
+//stride vs
+void initBlock(double *blk, int rs, int vs, hydro_prob *Hp, hydro_args *Ha, int x0, int bnx, int y0, int bny);
+
+#endif //ENGINE_H_
@@ -4,6 +4,7 @@
 typedef struct __hydroProb{
     // Time
     double t;
+    int nstep;
 
     // Dimensions
     int nx, ny;
@@ -20,6 +21,7 @@ typedef struct __hydroProb{
 
 #define PREFIX_LEN 20
 #define INIT_FN_LEN 50
+#define LABEL_LEN 64
 
 typedef struct __hydroArgs{
     // I/O arguments
@@ -29,10 +31,16 @@ typedef struct __hydroArgs{
     double dtoutput;
     char outPre[PREFIX_LEN];
     char initFile[INIT_FN_LEN];
+    char chkFile[INIT_FN_LEN];
+    char initName[PREFIX_LEN];
+    char machine[LABEL_LEN];
 
    //Dimensions
    int nx, ny;
 
+    //Initial condition: cells with i<iDiv and j<jDiv start in the high state
+    int iDiv, jDiv;
+
     // Physics
     double sigma;
     double smallc, smallr;
@@ -44,4 +52,9 @@ typedef struct __hydroArgs{
     int scheme;
 } hydro_args;
 
+//Riemann solvers of hydro_args.scheme, see riemann_approx.h
+#define SCHEME_EXACT 0
+#define SCHEME_HLL 1
+#define SCHEME_HLLC 2
+
 #endif
@@ -0,0 +1,112 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cuda_runtime.h>
+#include "launch.h"
+
+//Launches timed per candidate block size, after one to warm up
+#define TUNE_REPS 10
+
+static const int tuneCand[]={32,64,96,128,192,256,384,512,768,1024};
+
+static int isPow2(int n){
+  return n>0&&(n&(n-1))==0;
+}
+
+void initLaunch(launch_cfg *lc, const char *name, int occTh, int maxTh, int pow2, void (*launch)(int nTh)){
+  int nTh;
+
+  nTh=(occTh<maxTh)?occTh:maxTh;
+  if(nTh<1)nTh=1;
+  if(pow2){
+    while(!isPow2(nTh))nTh&=nTh-1;
+  }
+  lc->name=name;
+  lc->nTh=nTh;
+  lc->maxTh=maxTh;
+  lc->pow2=pow2;
+  lc->launch=launch;
+}
+
+//Time the candidate block sizes of lc and keep the fastest
+static void tuneOne(launch_cfg *lc, cudaStream_t s){
+  cudaEvent_t start, end;
+  float t, tBest;
+  int c, r, nTh;
+
+  cudaEventCreate(&start);
+  cudaEventCreate(&end);
+  tBest=-1.0;
+  for(c=0;c<(int)(sizeof(tuneCand)/sizeof(int));c++){
+    nTh=tuneCand[c];
+    if(nTh>lc->maxTh||(lc->pow2&&!isPow2(nTh)))continue;
+    lc->launch(nTh);
+    cudaEventRecord(start,s);
+    for(r=0;r<TUNE_REPS;r++){
+      lc->launch(nTh);
+    }
+    cudaEventRecord(end,s);
+    cudaEventSynchronize(end);
+    //A block size the kernel cannot be launched with is skipped
+    if(cudaGetLastError()!=cudaSuccess)continue;
+    cudaEventElapsedTime(&t,start,end);
+    if(tBest<0.0||t<tBest){
+      tBest=t;
+      lc->nTh=nTh;
+    }
+  }
+  cudaEventDestroy(start);
+  cudaEventDestroy(end);
+}
+
+int tuneLaunch(launch_cfg *lc, int nk, const char *gpu, cudaStream_t s, int save){
+  const char *file;
+  FILE *fp;
+  char line[256], kern[64], model[192];
+  int *found;
+  int k, nTh, nTuned;
+
+  if(!(file=getenv("MISH_CUDA_TUNE"))||!file[0])return 0;
+
+  found=(int*)calloc(nk,sizeof(int));
+  if((fp=fopen(file,"r"))){
+    while(fgets(line,sizeof(line),fp)){
+      if(sscanf(line,"%63s %d %191[^\n]",kern,&nTh,model)!=3||strcmp(model,gpu))continue;
+      for(k=0;k<nk;k++){
+        if(strcmp(kern,lc[k].name)||nTh<1||nTh>lc[k].maxTh||(lc[k].pow2&&!isPow2(nTh)))continue;
+        lc[k].nTh=nTh;
+        found[k]=1;
+      }
+    }
+    fclose(fp);
+  }
+
+  nTuned=0;
+  for(k=0;k<nk;k++){
+    if(found[k]||!lc[k].launch)continue;
+    tuneOne(lc+k,s);
+    nTuned++;
+  }
+  if(nTuned&&save){
+    if((fp=fopen(file,"a"))){
+      for(k=0;k<nk;k++){
+        if(!found[k]&&lc[k].launch)fprintf(fp,"%s %d %s\n",lc[k].name,lc[k].nTh,gpu);
+      }
+      fclose(fp);
+    }else{
+      fprintf(stderr,"Could not add the tuned block sizes to %s\n",file);
+    }
+  }
+  free(found);
+  return nTuned;
+}
+
+void printLaunch(launch_cfg *lc, int nk){
+  int k;
+
+  printf("Block sizes:");
+  for(k=0;k<nk;k++){
+    printf(" %s %d",lc[k].name,lc[k].nTh);
+  }
+  printf("\n");
+}
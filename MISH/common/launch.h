@@ -0,0 +1,29 @@
+#ifndef LAUNCH_H_
+#define LAUNCH_H_
+
+#include <cuda_runtime.h>
+
+//Launch configuration of one kernel, or of a group of kernels sharing a
+//block size, in the CUDA implementations. nTh starts as the occupancy
+//calculator's choice and can be replaced by tuneLaunch
+typedef struct __launchCfg{
+  const char *name;        //Key in the tuning cache
+  int nTh;                 //Threads per block
+  int maxTh;               //Largest block the kernel can be launched with
+  int pow2;                //The kernel only works with powers of 2
+  void (*launch)(int nTh); //Queue a representative launch, for tuning
+} launch_cfg;
+
+//Set lc from the occupancy calculator's block size for the kernel
+void initLaunch(launch_cfg *lc, const char *name, int occTh, int maxTh, int pow2, void (*launch)(int nTh));
+
+//If MISH_CUDA_TUNE names a cache file, take the block sizes of the nk
+//kernels of lc from the lines of the file for the GPU model gpu. The
+//kernels not there are timed with candidate block sizes on stream s, and,
+//if save is set, their fastest are added to the file. Returns the number
+//of kernels tuned
+int tuneLaunch(launch_cfg *lc, int nk, const char *gpu, cudaStream_t s, int save);
+
+void printLaunch(launch_cfg *lc, int nk);
+
+#endif //LAUNCH_H_
@@ -0,0 +1,24 @@
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+//Where variable v of cell c of an n cell mesh lives in the mesh the C and
+//OMP kernels work on. By default it is variable major, as in the restart
+//and visualisation files, so a cell's variables are n doubles apart.
+//Defining MESH_AOSOA as a block length B (e.g. 8) interleaves blocks of
+//B cells: the B values of the first variable, then the same cells' B
+//values of the next, so a cell's variables are B doubles apart and a
+//kernel streams through one array instead of nvar of them. MESH_LEN is
+//the number of doubles to allocate for nvar variables, the last block
+//being padded
+#ifdef MESH_AOSOA
+#define MESH_IDX(v,c,n) (((c)/MESH_AOSOA)*(MESH_AOSOA*MESH_NVAR)+(v)*MESH_AOSOA+(c)%MESH_AOSOA)
+#define MESH_LEN(nvar,n) ((size_t)(nvar)*((((size_t)(n))+MESH_AOSOA-1)/MESH_AOSOA)*MESH_AOSOA)
+#else
+#define MESH_IDX(v,c,n) ((c)+(n)*(v))
+#define MESH_LEN(nvar,n) ((size_t)(nvar)*(n))
+#endif
+
+//Variables per cell of an AoSoA block: VARRHO to VARPR
+#define MESH_NVAR 4
+
+#endif //LAYOUT_H_
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hydro.h"
+#include "restart.h"
+#include "cody.h"
+
+//Driver shared by every implementation. It sets up the problem and hands
+//it to the engine of the implementation it is linked with, see hydro.h
+
+//Longest line and most words of a batch file line
+#define BATCH_LINE 256
+#define BATCH_ARGS 32
+
+void initBlock(double *blk, int rs, int vs, hydro_prob *Hp, hydro_args *Ha, int x0, int bnx, int y0, int bny){
+  int i, j, hi;
+
+  for(j=0;j<bny;j++){
+    for(i=0;i<bnx;i++){
+      hi=(x0+i<Ha->iDiv&&y0+j<Ha->jDiv);
+      blk[i+rs*j+vs*VARRHO]=hi?1.0:0.125;
+      blk[i+rs*j+vs*VARVX ]=0.0;
+      blk[i+rs*j+vs*VARVY ]=0.0;
+      blk[i+rs*j+vs*VARPR ]=hi?2.5:0.25;
+    }
+  }
+}
+
+//Set up the problem of the command line argv (init, size multiplier and
+//options, from argv[1]) in Hp and Ha, and in non-MPI builds its mesh.
+//Returns the init, or -1 if the command line is not usable
+int setupProblem(int argc, char *argv[], hydro_prob *pHp, hydro_args *pHa, double **pMesh){
+  double *mesh;
+  hydro_prob Hp;
+  hydro_args Ha;
+  int i;
+  int init=0;
+  int pSMul=1;
+  int nStep=-1;
+  int scheme=SCHEME_EXACT;
+  double gamma=-1.0;
+
+  //select from hardcoded inits
+
+  if(argc<2){
+    printf("No init supplied\n");
+  } else {
+    if(!strcmp(argv[1],"sod")) init=1;
+    else if(!strcmp(argv[1],"crn")) init=2;
+    else if(!strcmp(argv[1],"wsc")) init=3;
+    else if(!strcmp(argv[1],"scs")) init=4;
+    else if(!strcmp(argv[1],"file")) init=5;
+    else printf("Unknown init\n");
+  }
+
+  //Get size multiplier
+  if((init==3||init==4)&&(argc<3||sscanf(argv[2],"%d",&pSMul)!=1)){
+    printf("No problem size multiplier supplied\n");
+    return -1;
+  }
+  if(pSMul<=0){
+    return -1;
+  }
+
+  //Restart file to start from and, after -c, one to write at the end.
+  //-n overrides the step limit of the init, -g the gas's gamma and -s
+  //selects the Riemann solver, exact (the default), hll or hllc
+  Ha.initFile[0]='\0';
+  if(init==5){
+    if(argc<3){
+      printf("No restart file supplied\n");
+      return -1;
+    }
+    snprintf(Ha.initFile,INIT_FN_LEN,"%s",argv[2]);
+  }
+  Ha.chkFile[0]='\0';
+  for(i=2;i+1<argc;i++){
+    if(!strcmp(argv[i],"-c"))snprintf(Ha.chkFile,INIT_FN_LEN,"%s",argv[i+1]);
+    if(!strcmp(argv[i],"-n")&&sscanf(argv[i+1],"%d",&nStep)!=1)nStep=-1;
+    if(!strcmp(argv[i],"-g")&&sscanf(argv[i+1],"%lf",&gamma)!=1)gamma=-1.0;
+    if(!strcmp(argv[i],"-s")){
+      if(!strcmp(argv[i+1],"exact"))scheme=SCHEME_EXACT;
+      else if(!strcmp(argv[i+1],"hll"))scheme=SCHEME_HLL;
+      else if(!strcmp(argv[i+1],"hllc"))scheme=SCHEME_HLLC;
+      else{
+        printf("Unknown Riemann solver %s\n",argv[i+1]);
+        return -1;
+      }
+    }
+  }
+
+  Ha.sigma=0.9;
+  Ha.nprtLine=100;
+
+  //Labels for the TIME line, the machine coming from MISH_MACHINE
+  snprintf(Ha.initName,PREFIX_LEN,"%s",(argc<2)?"default":argv[1]);
+  if(init==3||init==4)snprintf(Ha.initName,PREFIX_LEN,"%s%d",argv[1],pSMul);
+  snprintf(Ha.machine,LABEL_LEN,"%s",getenv("MISH_MACHINE")?getenv("MISH_MACHINE"):"?");
+
+  printf("INIT:%s\n",Ha.initName);
+  switch(init){
+    case 1:
+      Hp.nx=100;
+      Hp.ny=1000;
+      Hp.dx=0.25/Hp.nx;
+      Hp.dy=1.0/Hp.ny;
+      Ha.iDiv=100;
+      Ha.jDiv=500;
+      sprintf(Ha.outPre,"outDir/sod");
+      Ha.tend=-1.0;
+      Ha.dtoutput=-0.01;
+      Ha.nstepmax=1000;
+      Ha.noutput=-1;
+      break;
+    case 2:
+      Hp.nx=1000;
+      Hp.ny=1000;
+      Hp.dx=1.0/Hp.nx;
+      Hp.dy=1.0/Hp.ny;
+      Ha.iDiv=500;
+      Ha.jDiv=500;
+      sprintf(Ha.outPre,"outDir/crn");
+      Ha.tend=-1.0;
+      Ha.dtoutput=-0.01;
+      Ha.nstepmax=1000;
+      Ha.noutput=-1;
+      break;
+    case 3:
+      Hp.nx=100;
+      Hp.ny=1000*pSMul;
+      Hp.dx=0.25/Hp.nx;
+      Hp.dy=1.0/Hp.ny;
+      Ha.iDiv=100;
+      Ha.jDiv=0.5*Hp.ny;
+      sprintf(Ha.outPre,"outDir/wsc");
+      Ha.tend=-1.0;
+      Ha.dtoutput=-0.01;
+      Ha.nstepmax=1000;
+      Ha.noutput=-1;
+      break;
+    case 4:
+      Hp.nx=10*pSMul;
+      Hp.ny=10*pSMul;
+      Hp.dx=1.0/Hp.nx;
+      Hp.dy=1.0/Hp.ny;
+      Ha.iDiv=4;
+      Ha.jDiv=500;
+      sprintf(Ha.outPre,"outDir/scs");
+      Ha.tend=-1.0;
+      Ha.dtoutput=-0.01;
+      Ha.nstepmax=1000;
+      Ha.noutput=-1;
+      break;
+    case 5:
+      printf("INIT:FILE %s\n",Ha.initFile);
+      sprintf(Ha.outPre,"outDir/rst");
+      Ha.tend=-1.0;
+      Ha.dtoutput=-0.01;
+      Ha.nstepmax=1000;
+      Ha.noutput=-1;
+      break;
+    default:
+      Hp.nx=100;
+      Hp.ny=100;
+      Hp.dx=0.1;
+      Hp.dy=0.1;
+      Ha.iDiv=0;
+      Ha.jDiv=0;
+      sprintf(Ha.outPre,"outDir/out");
+      Ha.tend=-1.0;
+      Ha.dtoutput=-0.01;
+      Ha.nstepmax=100;
+      Ha.noutput=-1;
+      break;
+  }
+  if(nStep>=0)Ha.nstepmax=nStep;
+  Hp.t=0.0;
+  Hp.nstep=0;
+
+  Hp.nvar=4;
+
+  Hp.gamma=1.4;
+
+  Hp.bndL=BND_REFL;
+  Hp.bndR=BND_REFL;
+  Hp.bndU=BND_REFL;
+  Hp.bndD=BND_REFL;
+
+  Ha.smallr=1e-10;
+  Ha.smallc=1e-10;
+  Ha.niter_riemann=10;
+  Ha.scheme=scheme;
+  
+#ifdef MISH_MPI
+  //Each process reads or initializes only its own block of the mesh in
+  //engine, so no process holds the global mesh
+  if(init==5&&readRestartHead(Ha.initFile,&Hp))return -1;
+  mesh=NULL;
+#else
+  if(init==5){
+    //Sizes, time and physics come from the file, whose mesh is used in place
+    mesh=mapRestart(Ha.initFile,&Hp);
+    if(mesh==NULL)return -1;
+  }
+#endif
+  if(gamma>0.0)Hp.gamma=gamma;
+#ifndef MISH_MPI
+  if(init!=5){
+    mesh=(double*)cody_alloc(Hp.nvar*Hp.nx*Hp.ny*sizeof(double),64,CODY_FIRST_TOUCH);
+    initBlock(mesh,Hp.nx,Hp.nx*Hp.ny,&Hp,&Ha,0,Hp.nx,0,Hp.ny);
+  }
+#endif
+
+  *pHp=Hp;
+  *pHa=Ha;
+  *pMesh=mesh;
+  return init;
+}
+
+//Release the mesh setupProblem made for init
+void freeProblem(int init, double *mesh, hydro_prob *Hp){
+#ifndef MISH_MPI
+  if(init==5){
+    unmapRestart(mesh,Hp);
+    return;
+  }
+#endif
+  cody_free(mesh);
+}
+
+//Run every problem listed in the file fname, one command line per line as
+//for a single run (e.g. "sod -n 200 -c s1.chk -g 1.6"). Blank lines and
+//lines starting with # are skipped. Each member's visualisation files get
+//its index in their prefix. Builds that define MISH_BATCH advance the
+//members together with engineBatch, the others run them one by one
+int runBatch(char *fname, int *argc, char **argv[]){
+  FILE *fp;
+  char line[BATCH_LINE], *tok;
+  char *lArgv[BATCH_ARGS];
+  char pre[PREFIX_LEN];
+  int lArgc, nb, m, init;
+  int *inits=NULL;
+  double **meshes=NULL;
+  hydro_prob *Hps=NULL;
+  hydro_args *Has=NULL;
+
+#ifdef MISH_MPI
+  printf("Batch runs need a build without MPI\n");
+  return 1;
+#endif
+  fp=fopen(fname,"r");
+  if(fp==NULL){
+    printf("Could not open batch file %s\n",fname);
+    return 1;
+  }
+  nb=0;
+  while(fgets(line,BATCH_LINE,fp)!=NULL){
+    lArgc=1;
+    lArgv[0]=(*argv)[0];
+    for(tok=strtok(line," \t\r\n");tok!=NULL&&lArgc<BATCH_ARGS;tok=strtok(NULL," \t\r\n")){
+      lArgv[lArgc++]=tok;
+    }
+    if(lArgc<2||lArgv[1][0]=='#')continue;
+    inits =(int*)realloc(inits,(nb+1)*sizeof(int));
+    meshes=(double**)realloc(meshes,(nb+1)*sizeof(double*));
+    Hps   =(hydro_prob*)realloc(Hps,(nb+1)*sizeof(hydro_prob));
+    Has   =(hydro_args*)realloc(Has,(nb+1)*sizeof(hydro_args));
+    init=setupProblem(lArgc,lArgv,Hps+nb,Has+nb,meshes+nb);
+    if(init<0){
+      printf("Batch member %d is not usable\n",nb);
+      fclose(fp);
+      return 1;
+    }
+    inits[nb]=init;
+    snprintf(pre,PREFIX_LEN,"%s",Has[nb].outPre);
+    snprintf(Has[nb].outPre,PREFIX_LEN,"%s%04d_",pre,nb);
+    nb++;
+  }
+  fclose(fp);
+  printf("BATCH: %d members\n",nb);
+
+#if defined(MISH_BATCH)
+  engineBatch(argc,argv,nb,meshes,Hps,Has);
+#else
+  for(m=0;m<nb;m++){
+    engine(argc,argv,meshes[m],Hps+m,Has+m);
+  }
+#endif
+  freeScratch();
+  for(m=0;m<nb;m++){
+    freeProblem(inits[m],meshes[m],Hps+m);
+  }
+  free(inits);
+  free(meshes);
+  free(Hps);
+  free(Has);
+  return 0;
+}
+
+int main(int argc, char* argv[]){
+  double *mesh;
+  hydro_prob Hp;
+  hydro_args Ha;
+  int init;
+
+  if(argc>=2&&!strcmp(argv[1],"batch")){
+    if(argc<3){
+      printf("No batch file supplied\n");
+      return 1;
+    }
+    return runBatch(argv[2],&argc,&argv);
+  }
+
+  init=setupProblem(argc,argv,&Hp,&Ha,&mesh);
+  if(init<0)return 1;
+
+  engine(&argc,&argv,mesh,&Hp,&Ha);
+  freeScratch();
+  freeProblem(init,mesh,&Hp);
+
+  return 0;
+}
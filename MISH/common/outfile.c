@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "hydro_struct.h"
+#include "hydro_defs.h"
+#include "outfile.h"
+#include "visfile.h"
+
+//Snapshot being written by the writer thread. mesh is a copy, kept from
+//one snapshot to the next, so the time loop can go on updating its own
+typedef struct __visSnap{
+  char fname[30];
+  double *mesh;
+  size_t size;
+  double dx, dy;
+  int nvar, nx, ny;
+} vis_snap;
+
+vis_snap visS={"",NULL,0};
+pthread_t visTh;
+int visBusy=0;
+
+void writeVis(char* fname, double *u, double dx, double dy, int nvar, int nx, int ny){
+  char outName[53], *ext;
+
+  strncpy(outName,fname,50);
+  outName[49]='\0';
+  if(!(ext=strrchr(outName,'.'))) ext=strchr(outName,'\0');
+  sprintf(ext,".vts");
+  writeVts(outName,u,dx,dy,nvar,0,nx,0,ny);
+}
+
+void *visWriter(void *arg){
+  vis_snap *vs=(vis_snap*)arg;
+
+  writeVis(vs->fname,vs->mesh,vs->dx,vs->dy,vs->nvar,vs->nx,vs->ny);
+  return NULL;
+}
+
+//Copy the mesh and write it on the writer thread, so the conversion and
+//compression overlap the next steps
+void writeVisAsync(char* fname, double *u, double dx, double dy, int nvar, int nx, int ny){
+  size_t sz=(size_t)nvar*nx*ny*sizeof(double);
+
+  waitVis();
+  if(sz>visS.size){
+    free(visS.mesh);
+    visS.mesh=(double*)malloc(sz);
+    visS.size=visS.mesh?sz:0;
+  }
+  if(visS.mesh==NULL){
+    writeVis(fname,u,dx,dy,nvar,nx,ny);
+    return;
+  }
+  memcpy(visS.mesh,u,sz);
+  strncpy(visS.fname,fname,29);
+  visS.fname[29]='\0';
+  visS.dx=dx;
+  visS.dy=dy;
+  visS.nvar=nvar;
+  visS.nx=nx;
+  visS.ny=ny;
+  if(pthread_create(&visTh,NULL,visWriter,&visS)!=0){
+    //No thread to spare, write it now
+    visWriter(&visS);
+    return;
+  }
+  visBusy=1;
+}
+
+//Wait for the snapshot being written, if any
+void waitVis(){
+  if(visBusy){
+    pthread_join(visTh,NULL);
+    visBusy=0;
+  }
+}
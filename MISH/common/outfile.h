@@ -5,4 +5,7 @@
 
 void writeVis(char *name, double *mesh, double dx, double dy, int nvar, int nx, int ny);
 
+void writeVisAsync(char *name, double *mesh, double dx, double dy, int nvar, int nx, int ny);
+void waitVis();
+
 #endif //OUTFILE_H_
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "hydro_struct.h"
+#include "hydro_defs.h"
+#include "outfile_mpi.h"
+#include "visfile.h"
+
+//Arguments of the piece being written by the writer thread
+typedef struct __visPiece{
+  char fname[60];
+  int p;
+  double *u;
+  double dx, dy;
+  int nvar;
+  int x0, bnx, y0, bny;
+} vis_piece;
+
+vis_piece visP;
+pthread_t visTh;
+int visBusy=0;
+
+//Build the name of piece p (p<0 for the .pvts) of output fname in outName
+void visName(char *outName, char *fname, int p){
+  char *ext;
+
+  strncpy(outName,fname,50);
+  outName[49]='\0';
+  if(!(ext=strrchr(outName,'.'))) ext=strchr(outName,'\0');
+  if(p<0){
+    sprintf(ext,".pvts");
+  }else{
+    sprintf(ext,"_%04d.vts",p);
+  }
+}
+
+void writeVisPiece(char* fname, int p, double *u, double dx, double dy, int nvar, int x0, int bnx, int y0, int bny){
+  char outName[60];
+
+  visName(outName,fname,p);
+  writeVts(outName,u,dx,dy,nvar,x0,bnx,y0,bny);
+}
+
+void writeVisMaster(char* fname, int nvar, int nx, int ny, int nPc, int *ext){
+  int nv, p;
+  FILE *vis;
+  char outName[60], pcName[60], *base;
+
+  visName(outName,fname,-1);
+  vis=fopen(outName,"w");
+  if(vis==NULL){
+    fprintf(stderr,"Could not open file %s\n",outName);
+    return;
+  }
+  fprintf(vis, "<?xml version=\"1.0\"?>\n");
+  fprintf(vis, "<VTKFile type=\"PStructuredGrid\" version=\"1.0\">\n");
+  fprintf(vis, "<PStructuredGrid WholeExtent=\"%d %d %d %d %d %d\" GhostLevel=\"0\">\n", 0, nx, 0, ny, 0, 0);
+  fprintf(vis, "<PPointData></PPointData>\n");
+  fprintf(vis, "<PCellData Scalars=\"");
+  for (nv = 0; nv < nvar; nv++){
+    fprintf(vis, " %s", varName(nv));
+  }
+  fprintf(vis, "\">\n");
+  for (nv = 0; nv < nvar; nv++){
+    fprintf(vis, "<PDataArray type=\"%s\" Name=\"%s\"/>\n", VIS_TYPE, varName(nv));
+  }
+  fprintf(vis, "</PCellData>\n");
+  fprintf(vis, "<PPoints>\n");
+  fprintf(vis, "<PDataArray type=\"%s\" NumberOfComponents=\"3\"/>\n", VIS_TYPE);
+  fprintf(vis, "</PPoints>\n");
+
+  //Pieces are named relative to the .pvts
+  for (p = 0; p < nPc; p++){
+    visName(pcName,fname,p);
+    if(!(base=strrchr(pcName,'/'))) base=pcName;
+    else base++;
+    fprintf(vis, "<Piece Extent=\"%d %d %d %d %d %d\" Source=\"%s\"/>\n",
+	    ext[4*p], ext[4*p]+ext[4*p+1], ext[4*p+2], ext[4*p+2]+ext[4*p+3], 0, 0, base);
+  }
+  fprintf(vis, "</PStructuredGrid>\n");
+  fprintf(vis, "</VTKFile>\n");
+  fclose(vis);
+}
+
+void *visWriter(void *arg){
+  vis_piece *vp=(vis_piece*)arg;
+
+  writeVisPiece(vp->fname,vp->p,vp->u,vp->dx,vp->dy,vp->nvar,vp->x0,vp->bnx,vp->y0,vp->bny);
+  return NULL;
+}
+
+//Write a piece on the writer thread. u must not change until waitVis returns
+void writeVisPieceAsync(char* fname, int p, double *u, double dx, double dy, int nvar, int x0, int bnx, int y0, int bny){
+  waitVis();
+  strncpy(visP.fname,fname,59);
+  visP.fname[59]='\0';
+  visP.p=p;
+  visP.u=u;
+  visP.dx=dx;
+  visP.dy=dy;
+  visP.nvar=nvar;
+  visP.x0=x0;
+  visP.bnx=bnx;
+  visP.y0=y0;
+  visP.bny=bny;
+  if(pthread_create(&visTh,NULL,visWriter,&visP)!=0){
+    //No thread to spare, write it now
+    visWriter(&visP);
+    return;
+  }
+  visBusy=1;
+}
+
+//Wait for the piece being written, if any
+void waitVis(){
+  if(visBusy){
+    pthread_join(visTh,NULL);
+    visBusy=0;
+  }
+}
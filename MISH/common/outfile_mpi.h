@@ -0,0 +1,12 @@
+#ifndef OUTFILE_MPI_H_
+#define OUTFILE_MPI_H_
+
+#include "hydro_struct.h"
+
+void writeVisPiece(char *name, int p, double *mesh, double dx, double dy, int nvar, int x0, int bnx, int y0, int bny);
+void writeVisMaster(char *name, int nvar, int nx, int ny, int nPc, int *ext);
+
+void writeVisPieceAsync(char *name, int p, double *mesh, double dx, double dy, int nvar, int x0, int bnx, int y0, int bny);
+void waitVis();
+
+#endif //OUTFILE_MPI_H_
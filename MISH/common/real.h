@@ -0,0 +1,24 @@
+#ifndef REAL_H_
+#define REAL_H_
+
+#include <float.h>
+
+//Floating point type of the pass scratch (q, ql, qr and flx) and of the
+//trace and Riemann solver that work on it. The mesh, the flux update into
+//it, the timestep and the conservation sums are double in every build, so
+//MISH_SINGLE gives a mixed precision run: single precision kernels on
+//double state. REAL_TAG is appended to the implementation name in the
+//timing output and REAL_EPSILON is the kernel precision
+#ifdef MISH_SINGLE
+//sqrt, fabs and friends of a real stay in single precision
+#include <tgmath.h>
+typedef float real;
+#define REAL_EPSILON FLT_EPSILON
+#define REAL_TAG "/SP"
+#else
+typedef double real;
+#define REAL_EPSILON DBL_EPSILON
+#define REAL_TAG ""
+#endif
+
+#endif //REAL_H_
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef MISH_MPI
+#include <mpi.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include "hydro_struct.h"
+#include "restart.h"
+
+size_t restartLen(hydro_prob *Hp){
+  return RST_HEAD_LEN+(size_t)Hp->nvar*Hp->nx*Hp->ny*sizeof(double);
+}
+
+//Read and check the header of fname, filling in Hp. Returns 0 on success
+int readRestartHead(char *fname, hydro_prob *Hp){
+  FILE *rst;
+  rst_head hd;
+  long len;
+
+  rst=fopen(fname,"rb");
+  if(rst==NULL){
+    fprintf(stderr,"Could not open restart file %s\n",fname);
+    return 1;
+  }
+  if(fread(&hd,sizeof(rst_head),1,rst)!=1||memcmp(hd.magic,RST_MAGIC,8)){
+    fprintf(stderr,"%s is not a restart file\n",fname);
+    fclose(rst);
+    return 1;
+  }
+  if(hd.order!=1||hd.version!=RST_VERSION){
+    fprintf(stderr,"Restart file %s was written by an incompatible build\n",fname);
+    fclose(rst);
+    return 1;
+  }
+  fseek(rst,0,SEEK_END);
+  len=ftell(rst);
+  fclose(rst);
+
+  Hp->t=hd.t;
+  Hp->nstep=hd.nstep;
+  Hp->nvar=hd.nvar;
+  Hp->nx=hd.nx;
+  Hp->ny=hd.ny;
+  Hp->dx=hd.dx;
+  Hp->dy=hd.dy;
+  Hp->gamma=hd.gamma;
+  Hp->bndL=hd.bndL;
+  Hp->bndR=hd.bndR;
+  Hp->bndU=hd.bndU;
+  Hp->bndD=hd.bndD;
+  if(hd.nvar<=0||hd.nx<=0||hd.ny<=0||len<0||(size_t)len<restartLen(Hp)){
+    fprintf(stderr,"Restart file %s is truncated\n",fname);
+    return 1;
+  }
+  return 0;
+}
+
+
+//Write the header for Hp into a zeroed RST_HEAD_LEN buffer
+void packRestartHead(char *buf, hydro_prob *Hp){
+  rst_head hd;
+
+  memset(&hd,0,sizeof(rst_head));
+  memcpy(hd.magic,RST_MAGIC,8);
+  hd.version=RST_VERSION;
+  hd.order=1;
+  hd.nvar=Hp->nvar;
+  hd.nx=Hp->nx;
+  hd.ny=Hp->ny;
+  hd.nstep=Hp->nstep;
+  hd.t=Hp->t;
+  hd.dx=Hp->dx;
+  hd.dy=Hp->dy;
+  hd.gamma=Hp->gamma;
+  hd.bndL=Hp->bndL;
+  hd.bndR=Hp->bndR;
+  hd.bndU=Hp->bndU;
+  hd.bndD=Hp->bndD;
+  memset(buf,0,RST_HEAD_LEN);
+  memcpy(buf,&hd,sizeof(rst_head));
+}
+
+#ifdef MISH_MPI
+//File and memory types of the block at x0,y0 of bnx*bny cells, held in a
+//mesh with a 2 cell halo on every side
+void blockTypes(hydro_prob *Hp, int x0, int bnx, int y0, int bny, MPI_Datatype *fType, MPI_Datatype *mType){
+  int gSz[3], bSz[3], st[3];
+
+  gSz[0]=Hp->nvar; gSz[1]=Hp->ny; gSz[2]=Hp->nx;
+  bSz[0]=Hp->nvar; bSz[1]=bny;    bSz[2]=bnx;
+  st[0]=0;         st[1]=y0;      st[2]=x0;
+  MPI_Type_create_subarray(3,gSz,bSz,st,MPI_ORDER_C,MPI_DOUBLE,fType);
+  MPI_Type_commit(fType);
+  gSz[1]=bny+4; gSz[2]=bnx+4;
+  st[1]=2;      st[2]=2;
+  MPI_Type_create_subarray(3,gSz,bSz,st,MPI_ORDER_C,MPI_DOUBLE,mType);
+  MPI_Type_commit(mType);
+}
+
+//Collectively read each process's block of restart file fname into the
+//interior of lMesh. The header must already have been read into Hp
+int readRestartBlock(char *fname, double *lMesh, hydro_prob *Hp, int x0, int bnx, int y0, int bny){
+  MPI_File fh;
+  MPI_Datatype fType, mType;
+  int err;
+
+  err=MPI_File_open(MPI_COMM_WORLD,fname,MPI_MODE_RDONLY,MPI_INFO_NULL,&fh);
+  if(err!=MPI_SUCCESS){
+    fprintf(stderr,"Could not open restart file %s\n",fname);
+    return 1;
+  }
+  blockTypes(Hp,x0,bnx,y0,bny,&fType,&mType);
+  MPI_File_set_view(fh,RST_HEAD_LEN,MPI_DOUBLE,fType,"native",MPI_INFO_NULL);
+  err=MPI_File_read_all(fh,lMesh,1,mType,MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+  MPI_Type_free(&fType);
+  MPI_Type_free(&mType);
+  if(err!=MPI_SUCCESS){
+    fprintf(stderr,"Could not read restart file %s\n",fname);
+    return 1;
+  }
+  return 0;
+}
+
+//Collectively checkpoint the interior of every process's lMesh to fname,
+//rank 0 writing the header. Returns 0 on success
+int writeRestartBlock(char *fname, double *lMesh, hydro_prob *Hp, int x0, int bnx, int y0, int bny){
+  MPI_File fh;
+  MPI_Datatype fType, mType;
+  char buf[RST_HEAD_LEN];
+  int rank, err, hErr=MPI_SUCCESS;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  err=MPI_File_open(MPI_COMM_WORLD,fname,MPI_MODE_WRONLY|MPI_MODE_CREATE,MPI_INFO_NULL,&fh);
+  if(err!=MPI_SUCCESS){
+    if(rank==0)fprintf(stderr,"Could not open restart file %s\n",fname);
+    return 1;
+  }
+  MPI_File_set_size(fh,restartLen(Hp));
+  if(rank==0){
+    packRestartHead(buf,Hp);
+    hErr=MPI_File_write_at(fh,0,buf,RST_HEAD_LEN,MPI_CHAR,MPI_STATUS_IGNORE);
+  }
+  blockTypes(Hp,x0,bnx,y0,bny,&fType,&mType);
+  MPI_File_set_view(fh,RST_HEAD_LEN,MPI_DOUBLE,fType,"native",MPI_INFO_NULL);
+  err=MPI_File_write_all(fh,lMesh,1,mType,MPI_STATUS_IGNORE);
+  MPI_File_close(&fh);
+  MPI_Type_free(&fType);
+  MPI_Type_free(&mType);
+  if(err!=MPI_SUCCESS||hErr!=MPI_SUCCESS){
+    fprintf(stderr,"Could not write restart file %s\n",fname);
+    return 1;
+  }
+  if(rank==0)printf("Restart file %s @ step %d\n",fname,Hp->nstep);
+  return 0;
+}
+#else
+//Map the mesh of restart file fname, filling in Hp. The mapping is private,
+//so the run updates it in place and the file is left untouched
+double *mapRestart(char *fname, hydro_prob *Hp){
+  int fd;
+  void *map;
+
+  if(readRestartHead(fname,Hp))return NULL;
+  fd=open(fname,O_RDONLY);
+  if(fd<0){
+    fprintf(stderr,"Could not open restart file %s\n",fname);
+    return NULL;
+  }
+  map=mmap(NULL,restartLen(Hp),PROT_READ|PROT_WRITE,MAP_PRIVATE,fd,0);
+  close(fd);
+  if(map==MAP_FAILED){
+    fprintf(stderr,"Could not map restart file %s\n",fname);
+    return NULL;
+  }
+#ifdef MADV_SEQUENTIAL
+  madvise(map,restartLen(Hp),MADV_SEQUENTIAL);
+#endif
+  return (double*)((char*)map+RST_HEAD_LEN);
+}
+
+void unmapRestart(double *mesh, hydro_prob *Hp){
+  munmap((char*)mesh-RST_HEAD_LEN,restartLen(Hp));
+}
+
+//Checkpoint mesh (nvar*nx*ny, no halo) to fname. Returns 0 on success
+int writeRestart(char *fname, double *mesh, hydro_prob *Hp){
+  FILE *rst;
+  char buf[RST_HEAD_LEN];
+  size_t nC=(size_t)Hp->nvar*Hp->nx*Hp->ny;
+
+  rst=fopen(fname,"wb");
+  if(rst==NULL){
+    fprintf(stderr,"Could not open restart file %s\n",fname);
+    return 1;
+  }
+  packRestartHead(buf,Hp);
+  if(fwrite(buf,1,RST_HEAD_LEN,rst)!=RST_HEAD_LEN||fwrite(mesh,sizeof(double),nC,rst)!=nC){
+    fprintf(stderr,"Could not write restart file %s\n",fname);
+    fclose(rst);
+    return 1;
+  }
+  fclose(rst);
+  printf("Restart file %s @ step %d\n",fname,Hp->nstep);
+  return 0;
+}
+#endif
@@ -0,0 +1,37 @@
+#ifndef RESTART_H_
+#define RESTART_H_
+
+#include "hydro_struct.h"
+
+//Restart file layout: a RST_HEAD_LEN byte header holding an rst_head, then
+//every variable's nx*ny interior cells as native doubles, x fastest. The
+//header is padded to a page so the mesh can be mapped in place. MPI
+//builds instead read and write each process's block through MPI-IO.
+#define RST_MAGIC "MISHRST1"
+#define RST_VERSION 1
+#define RST_HEAD_LEN 4096
+
+typedef struct __rstHead{
+  char magic[8];
+  int version;
+  int order; //1 in the byte order of the writer
+  int nvar, nx, ny;
+  int nstep;
+  double t;
+  double dx, dy;
+  double gamma;
+  int bndL, bndR;
+  int bndU, bndD;
+} rst_head;
+
+int readRestartHead(char *fname, hydro_prob *Hp);
+#ifdef MISH_MPI
+int readRestartBlock(char *fname, double *lMesh, hydro_prob *Hp, int x0, int bnx, int y0, int bny);
+int writeRestartBlock(char *fname, double *lMesh, hydro_prob *Hp, int x0, int bnx, int y0, int bny);
+#else
+double *mapRestart(char *fname, hydro_prob *Hp);
+void unmapRestart(double *mesh, hydro_prob *Hp);
+int writeRestart(char *fname, double *mesh, hydro_prob *Hp);
+#endif
+
+#endif //RESTART_H_
@@ -0,0 +1,95 @@
+#ifndef RIEMANN_APPROX_H_
+#define RIEMANN_APPROX_H_
+
+#include <math.h>
+#include "real.h"
+
+//The approximate Riemann solvers of hydro_args.scheme (SCHEME_HLL and
+//SCHEME_HLLC), shared by the implementations' riemann kernels. Each one
+//takes the primitive states on the left and right of one interface,
+//already floored at smallr and smallp like the exact solver's, and writes
+//the interface flux to f[fs*VARRHO] .. f[fs*VARPR]. u is the velocity
+//normal to the interface and v the transverse one. Both use Davis' wave
+//speed estimates, have a fixed cost and only select, never branch, so
+//they vectorise and do not diverge on GPUs. The VAR* indices come from
+//the implementation's hydro_defs.h
+
+//CUDA builds compile them for the device and OpenACC builds for the
+//accelerator. A programming model with its own function qualifier defines
+//RIEMANN_FN before including this
+#ifndef RIEMANN_FN
+#ifdef __CUDACC__
+#define RIEMANN_FN static __device__ inline
+#else
+#define RIEMANN_FN static inline
+#endif
+#endif
+
+//HLL: one intermediate state between the fastest left and right going
+//waves, which smears contacts
+#ifdef _OPENACC
+#pragma acc routine seq
+#endif
+RIEMANN_FN void hllFlux(real gmma, real rl, real ul, real vl, real pl,
+                        real rr, real ur, real vr, real pr, real *f, int fs){
+  real entho, cl, cr, el, er, sl, sr, idn;
+
+  entho=1.0/(gmma-1.0);
+  cl=sqrt(gmma*pl/rl);
+  cr=sqrt(gmma*pr/rr);
+  el=pl*entho+0.5*rl*(ul*ul+vl*vl);
+  er=pr*entho+0.5*rr*(ur*ur+vr*vr);
+  //Clamping the speeds at 0 gives the left or right flux outside the fan
+  sl=ul-cl<ur-cr?ul-cl:ur-cr;
+  sr=ul+cl>ur+cr?ul+cl:ur+cr;
+  sl=sl<0.0?sl:0.0;
+  sr=sr>0.0?sr:0.0;
+  idn=1.0/(sr-sl);
+
+  f[fs*VARRHO]=(sr*rl*ul-sl*rr*ur+sl*sr*(rr-rl))*idn;
+  f[fs*VARVX ]=(sr*(rl*ul*ul+pl)-sl*(rr*ur*ur+pr)+sl*sr*(rr*ur-rl*ul))*idn;
+  f[fs*VARVY ]=(sr*rl*ul*vl-sl*rr*ur*vr+sl*sr*(rr*vr-rl*vl))*idn;
+  f[fs*VARPR ]=(sr*ul*(el+pl)-sl*ur*(er+pr)+sl*sr*(er-el))*idn;
+}
+
+//HLLC: HLL with the contact restored, two intermediate states either side
+//of a contact moving at ss (Toro, Spruce and Speares)
+#ifdef _OPENACC
+#pragma acc routine seq
+#endif
+RIEMANN_FN void hllcFlux(real gmma, real rl, real ul, real vl, real pl,
+                         real rr, real ur, real vr, real pr, real *f, int fs){
+  real entho, cl, cr, sl, sr, ml, mr, ss;
+  real s, r, u, v, p, m, e, ds, out, left;
+
+  entho=1.0/(gmma-1.0);
+  cl=sqrt(gmma*pl/rl);
+  cr=sqrt(gmma*pr/rr);
+  sl=ul-cl<ur-cr?ul-cl:ur-cr;
+  sr=ul+cl>ur+cr?ul+cl:ur+cr;
+  //Mass fluxes through the outer waves, ml<0<mr
+  ml=rl*(sl-ul);
+  mr=rr*(sr-ur);
+  ss=(pr-pl+ul*ml-ur*mr)/(ml-mr);
+
+  //Only the side of the contact the interface is on matters
+  left=ss>=0.0;
+  s=left?sl:sr;
+  r=left?rl:rr;
+  u=left?ul:ur;
+  v=left?vl:vr;
+  p=left?pl:pr;
+  m=left?ml:mr;
+  e=p*entho+0.5*r*(u*u+v*v);
+  //Outside the fan the flux is that of the side's own state
+  out=left?sl>=0.0:sr<=0.0;
+  //F*=F+s*(U*-U), with U*=ds*(1,ss,v,e/r+(ss-u)*(ss+p/m))
+  ds=out?r:m/(s-ss);
+  s=out?0.0:s;
+  f[fs*VARRHO]=r*u+s*(ds-r);
+  f[fs*VARVX ]=r*u*u+p+s*(ds*ss-r*u);
+  f[fs*VARVY ]=r*u*v+s*(ds-r)*v;
+  f[fs*VARPR ]=u*(e+p)+s*(ds*(e/r+(ss-u)*(ss+p/m))-e);
+}
+
+#endif //RIEMANN_APPROX_H_
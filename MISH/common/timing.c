@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <time.h>
+#ifdef MISH_MPI
+#include <mpi.h>
+#endif
+#ifdef MISH_PAPI
+#include <papi.h>
+#include <pthread.h>
+#endif
+#include "hydro_struct.h"
+#include "timing.h"
+#include "cody.h"
+
+const char *phaseName[NPHASE]={"prim","trace","riemann","flux","halo","dt","output"};
+const char *ctrName[NCTR]={"cycles","l2miss","l3miss","flops"};
+
+//Monotonic wall clock in seconds for timing phases, the one every CODY
+//mini-app uses
+double wallNow(){
+  return cody_now();
+}
+
+#ifdef MISH_PAPI
+hydro_timing *ctrHt=NULL;
+int ctrEv[NCTR]={PAPI_TOT_CYC,PAPI_L2_TCM,PAPI_L3_TCM,PAPI_DP_OPS};
+int ctrOk[NCTR];
+
+//Every thread counts on its own event set, started on its first mark
+__thread int thEvSet=PAPI_NULL;
+__thread long long thLast[NCTR];
+
+//Start the counters of the calling thread, if not yet started
+int ctrThread(){
+  int k;
+
+  if(thEvSet!=PAPI_NULL)return 0;
+  if(PAPI_create_eventset(&thEvSet)!=PAPI_OK)return 1;
+  for(k=0;k<NCTR;k++){
+    if(ctrOk[k])PAPI_add_event(thEvSet,ctrEv[k]);
+  }
+  if(PAPI_start(thEvSet)!=PAPI_OK){
+    PAPI_cleanup_eventset(thEvSet);
+    PAPI_destroy_eventset(&thEvSet);
+    thEvSet=PAPI_NULL;
+    return 1;
+  }
+  return 0;
+}
+
+//Read the counters of the calling thread into v, in NCTR order
+void ctrRead(long long *v){
+  long long raw[NCTR];
+  int k, r;
+
+  PAPI_read(thEvSet,raw);
+  for(k=0,r=0;k<NCTR;k++){
+    v[k]=ctrOk[k]?raw[r++]:0;
+  }
+}
+
+void ctrMark(){
+  if(ctrHt==NULL||ctrThread())return;
+  ctrRead(thLast);
+}
+
+//Attribute the counts since the last mark of this thread to phase ph
+void ctrAdd(int ph){
+  long long v[NCTR];
+  int k;
+
+  if(ctrHt==NULL||ctrThread())return;
+  ctrRead(v);
+  for(k=0;k<NCTR;k++){
+#pragma omp atomic
+    ctrHt->ctr[ph][k]+=v[k]-thLast[k];
+    thLast[k]=v[k];
+  }
+}
+
+//Initialise PAPI and find which of the counters this machine has
+void ctrInit(hydro_timing *Ht){
+  int k;
+
+  if(PAPI_is_initialized()==PAPI_NOT_INITED){
+    if(PAPI_library_init(PAPI_VER_CURRENT)!=PAPI_VER_CURRENT){
+      fprintf(stderr,"Could not initialise PAPI, no counters\n");
+      return;
+    }
+    PAPI_thread_init((unsigned long (*)(void))pthread_self);
+  }
+  for(k=0;k<NCTR;k++){
+    ctrOk[k]=(PAPI_query_event(ctrEv[k])==PAPI_OK);
+  }
+  ctrHt=Ht;
+}
+#endif
+
+void initTiming(hydro_timing *Ht, const char *cType, const char *mType, int nproc, int nth){
+  int ph, k;
+#ifdef MISH_MPI
+  int rank;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+#endif
+
+  Ht->cType=cType;
+  Ht->mType=mType;
+  Ht->nproc=nproc;
+  Ht->nth=nth;
+  Ht->niters=0;
+  Ht->ncells=0;
+  Ht->runt=0.0;
+  for(ph=0;ph<NPHASE;ph++){
+    Ht->phase[ph]=0.0;
+    for(k=0;k<NCTR;k++){
+      Ht->ctr[ph][k]=-1;
+    }
+  }
+  cody_init("mish",cType);
+#ifdef MISH_MPI
+  cody_rank(rank,nproc);
+#endif
+#ifdef MISH_PAPI
+  ctrInit(Ht);
+  for(ph=0;ph<NPHASE;ph++){
+    for(k=0;k<NCTR;k++){
+      if(ctrHt!=NULL&&ctrOk[k])Ht->ctr[ph][k]=0;
+    }
+  }
+#endif
+}
+
+//Combine the timing of every rank on rank 0: the slowest rank's time in
+//each phase and the sum of the counters
+void reduceTiming(hydro_timing *Ht){
+#ifdef MISH_MPI
+  int rank;
+
+  MPI_Comm_rank(MPI_COMM_WORLD,&rank);
+  MPI_Reduce((rank==0)?MPI_IN_PLACE:Ht->phase,Ht->phase,NPHASE,MPI_DOUBLE,MPI_MAX,0,MPI_COMM_WORLD);
+  MPI_Reduce((rank==0)?MPI_IN_PLACE:Ht->ctr,Ht->ctr,NPHASE*NCTR,MPI_LONG_LONG,MPI_SUM,0,MPI_COMM_WORLD);
+#endif
+}
+
+//Hand the run to cody, which writes it in the schema every CODY mini-app
+//shares if CODY_OUT is set. Phases an implementation cannot time are left out
+static void codyTiming(hydro_timing *Ht, hydro_args *Ha){
+  int ph, k;
+
+  cody_param("mType","%s",Ht->mType);
+  cody_param("machine","%s",Ha->machine);
+  cody_param("init","%s",Ha->initName);
+  cody_param("nth","%d",Ht->nth);
+  cody_param("niters","%d",Ht->niters);
+  cody_param("ncells","%d",Ht->ncells);
+  cody_record("run",Ht->runt,1);
+  for(ph=0;ph<NPHASE;ph++){
+    if(Ht->phase[ph]<0)continue;
+    cody_record(phaseName[ph],Ht->phase[ph],Ht->niters>0?Ht->niters:1);
+    for(k=0;k<NCTR;k++){
+      if(Ht->ctr[ph][k]>=0)cody_count(phaseName[ph],ctrName[k],(double)Ht->ctr[ph][k]);
+    }
+  }
+  if(Ht->runt>0){
+    cody_metric("updates",1e-6*(double)Ht->ncells*(double)Ht->niters/Ht->runt,"Mupdates/s");
+  }
+  //The run's energy is counted from initTiming, just before the time steps
+  cody_work(NULL,1e-6*(double)Ht->ncells*(double)Ht->niters,"Mupdates");
+  cody_finish();
+}
+
+//Print the run time in the layout described in the README, then the time
+//spent in each phase in seconds, both easily extracted as csv. Counters
+//follow, one line per phase, when any were collected
+void printTiming(hydro_timing *Ht, hydro_args *Ha){
+  int ph, k;
+
+  codyTiming(Ht,Ha);
+  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
+  printf("TIME:\"%s\",\"%s:%s\",\"%s\",%d,%d,%d,%d,%g\n",Ht->cType,Ht->mType,Ha->machine,Ha->initName,
+	 Ht->nproc,Ht->nth,Ht->niters,Ht->ncells,Ht->runt);
+  printf("PFMT:%s,%s,%s,%s,%s","cType","init","nproc","nth","ncells");
+  for(ph=0;ph<NPHASE;ph++){
+    printf(",%s",phaseName[ph]);
+  }
+  printf("\n");
+  printf("PHASE:\"%s\",\"%s\",%d,%d,%d",Ht->cType,Ha->initName,Ht->nproc,Ht->nth,Ht->ncells);
+  for(ph=0;ph<NPHASE;ph++){
+    printf(",%g",Ht->phase[ph]);
+  }
+  printf("\n");
+
+  for(ph=0;ph<NPHASE;ph++){
+    for(k=0;k<NCTR;k++){
+      if(Ht->ctr[ph][k]>=0)break;
+    }
+    if(k<NCTR)break;
+  }
+  if(ph==NPHASE)return;
+  printf("CFMT:%s,%s,%s,%s,%s","cType","init","nproc","nth","phase");
+  for(k=0;k<NCTR;k++){
+    printf(",%s",ctrName[k]);
+  }
+  printf("\n");
+  for(ph=0;ph<NPHASE;ph++){
+    printf("CTR:\"%s\",\"%s\",%d,%d,\"%s\"",Ht->cType,Ha->initName,Ht->nproc,Ht->nth,phaseName[ph]);
+    for(k=0;k<NCTR;k++){
+      printf(",%lld",Ht->ctr[ph][k]);
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,56 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include "hydro_struct.h"
+
+//Phases of the time loop timed by every engine. A phase that an
+//implementation cannot time on its own (e.g. fused into one kernel) is
+//left at -1 and reported as such
+enum {PH_PRIM, PH_TRACE, PH_RIEMANN, PH_FLUX, PH_HALO, PH_DT, PH_OUTPUT, NPHASE};
+
+//Hardware counters attributed to each phase when built with MISH_PAPI:
+//cycles, L2 and L3 misses and double precision operations
+#define NCTR 4
+
+typedef struct __hydroTiming{
+  const char *cType; //Implementation: "C", "OMP", "MPI", ...
+  const char *mType; //"CPU" or "GPU"
+  int nproc, nth;
+  int niters, ncells;
+  double runt;
+  double phase[NPHASE];
+  long long ctr[NPHASE][NCTR]; //Summed over threads and ranks, -1 if unavailable
+} hydro_timing;
+
+double wallNow();
+void initTiming(hydro_timing *Ht, const char *cType, const char *mType, int nproc, int nth);
+void reduceTiming(hydro_timing *Ht);
+void printTiming(hydro_timing *Ht, hydro_args *Ha);
+
+#ifdef MISH_PAPI
+void ctrMark();
+void ctrAdd(int ph);
+#define PH_CTR_MARK() ctrMark()
+#define PH_CTR_ADD(ph) ctrAdd(ph)
+#else
+#define PH_CTR_MARK()
+#define PH_CTR_ADD(ph)
+#endif
+
+//Start timing a phase in t0 on this thread
+#define PH_START(t0) do{(t0)=wallNow();PH_CTR_MARK();}while(0)
+//Add the time since t0 to acc[ph], and the counters since the last mark
+//to phase ph, restarting the clock in t0
+#define PH_ADD(acc,ph,t0) do{double t1_=wallNow();(acc)[ph]+=t1_-(t0);(t0)=t1_;PH_CTR_ADD(ph);}while(0)
+
+//NVTX ranges around the phases of the CUDA builds, when built with MISH_NVTX
+#ifdef MISH_NVTX
+#include <nvToolsExt.h>
+#define NVTX_PUSH(name) nvtxRangePushA(name)
+#define NVTX_POP() nvtxRangePop()
+#else
+#define NVTX_PUSH(name)
+#define NVTX_POP()
+#endif
+
+#endif //TIMING_H_
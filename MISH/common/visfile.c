@@ -0,0 +1,219 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "hydro_struct.h"
+#include "hydro_defs.h"
+#include "visfile.h"
+
+#if defined(MISH_LZ4)
+#include <lz4.h>
+#define VIS_COMPRESSOR "vtkLZ4DataCompressor"
+#elif defined(MISH_ZLIB)
+#include <zlib.h>
+#define VIS_COMPRESSOR "vtkZLibDataCompressor"
+#endif
+
+#ifdef VIS_FLOAT32
+typedef float vis_real;
+#else
+typedef double vis_real;
+#endif
+
+//One appended array being written. The values are gathered a block at a
+//time, converted to vis_real, and compressed if the build compresses
+typedef struct __visArray{
+  FILE *vis;
+  long hPos;
+  uint64_t nB;
+  int nBlk, iBlk;
+  uint64_t *head;
+  vis_real *raw;
+  int fill;
+  char *cBuf;
+  size_t cCap;
+} vis_array;
+
+const char *varName(int nv){
+  static char name[30];
+
+  switch(nv){
+  case VARRHO:
+    return "Density";
+  case VARVX:
+    return "MomX";
+  case VARVY:
+    return "MomY";
+  case VARPR:
+    return "ENE";
+  default:
+    sprintf(name, "var%d", nv);
+    return name;
+  }
+}
+
+//Declare an appended array. Its offset is not known until the arrays
+//before it are compressed, so a fixed width placeholder is printed and
+//its position returned in offPos
+void visDataArray(FILE *vis, const char *name, int ncomp, long *offPos){
+  fprintf(vis, "<DataArray type=\"%s\"", VIS_TYPE);
+  if(name)fprintf(vis, " Name=\"%s\"", name);
+  if(ncomp>1)fprintf(vis, " NumberOfComponents=\"%d\"", ncomp);
+  fprintf(vis, " format=\"appended\" offset=\"");
+  *offPos=ftell(vis);
+  fprintf(vis, "%020llu\"/>\n", 0ULL);
+}
+
+//Start an array of n values at the end of the file, whose appended data
+//start at base, and fill in its offset
+void visArrayBegin(vis_array *va, FILE *vis, uint64_t n, long base, long offPos){
+  va->vis=vis;
+  va->hPos=ftell(vis);
+  fseek(vis,offPos,SEEK_SET);
+  fprintf(vis, "%020llu", (unsigned long long)(va->hPos-base));
+  fseek(vis,va->hPos,SEEK_SET);
+
+  va->nB=n*sizeof(vis_real);
+  va->fill=0;
+  va->iBlk=0;
+  va->raw=(vis_real*)malloc(VIS_BLOCK*sizeof(vis_real));
+#ifdef VIS_COMPRESSOR
+  //Block count, block size, size of a partial last block, then the
+  //compressed size of every block, filled in by visArrayEnd
+  va->nBlk=(int)((n+VIS_BLOCK-1)/VIS_BLOCK);
+  va->head=(uint64_t*)calloc(3+va->nBlk,sizeof(uint64_t));
+  fwrite(va->head,sizeof(uint64_t),3+va->nBlk,vis);
+#ifdef MISH_LZ4
+  va->cCap=LZ4_compressBound(VIS_BLOCK*sizeof(vis_real));
+#else
+  va->cCap=compressBound(VIS_BLOCK*sizeof(vis_real));
+#endif
+  va->cBuf=(char*)malloc(va->cCap);
+#else
+  va->nBlk=0;
+  va->head=NULL;
+  va->cBuf=NULL;
+  fwrite(&va->nB,sizeof(uint64_t),1,vis);
+#endif
+}
+
+//Write out the gathered block
+void visArrayFlush(vis_array *va){
+  size_t nB=va->fill*sizeof(vis_real);
+#ifdef VIS_COMPRESSOR
+#ifdef MISH_LZ4
+  int cB;
+
+  cB=LZ4_compress_default((const char*)va->raw,va->cBuf,(int)nB,(int)va->cCap);
+#else
+  uLongf cB=va->cCap;
+
+  compress2((Bytef*)va->cBuf,&cB,(const Bytef*)va->raw,nB,VIS_ZLEVEL);
+#endif
+  fwrite(va->cBuf,1,cB,va->vis);
+  va->head[3+va->iBlk]=cB;
+#else
+  fwrite(va->raw,1,nB,va->vis);
+#endif
+  va->iBlk++;
+  va->fill=0;
+}
+
+void visArrayPut(vis_array *va, const double *u, uint64_t n){
+  uint64_t i;
+
+  for(i=0;i<n;i++){
+    va->raw[va->fill++]=(vis_real)u[i];
+    if(va->fill==VIS_BLOCK)visArrayFlush(va);
+  }
+}
+
+void visArrayEnd(vis_array *va){
+#ifdef VIS_COMPRESSOR
+  long end;
+#endif
+
+  if(va->fill>0)visArrayFlush(va);
+#ifdef VIS_COMPRESSOR
+  va->head[0]=va->nBlk;
+  va->head[1]=VIS_BLOCK*sizeof(vis_real);
+  va->head[2]=va->nB%(VIS_BLOCK*sizeof(vis_real));
+  end=ftell(va->vis);
+  fseek(va->vis,va->hPos,SEEK_SET);
+  fwrite(va->head,sizeof(uint64_t),3+va->nBlk,va->vis);
+  fseek(va->vis,end,SEEK_SET);
+#endif
+  free(va->head);
+  free(va->cBuf);
+  free(va->raw);
+}
+
+//Write the bnx x bny cells of mesh, whose lower corner is cell (x0,y0) of
+//the whole mesh, to outName as a binary .vts with every array appended
+void writeVts(char *outName, double *u, double dx, double dy, int nvar, int x0, int bnx, int y0, int bny){
+  int i,j,nv;
+  int one=1;
+  FILE *vis;
+  long *offPos, base;
+  double *pts;
+  vis_array va;
+
+  vis=fopen(outName,"wb");
+  if(vis==NULL){
+    fprintf(stderr,"Could not open file %s\n",outName);
+    return;
+  }
+  offPos=(long*)malloc((nvar+1)*sizeof(long));
+  fprintf(vis, "<?xml version=\"1.0\"?>\n");
+  fprintf(vis, "<VTKFile type=\"StructuredGrid\" version=\"1.0\" byte_order=\"%s\" header_type=\"UInt64\"",
+	  (*(char*)&one)?"LittleEndian":"BigEndian");
+#ifdef VIS_COMPRESSOR
+  fprintf(vis, " compressor=\"%s\"", VIS_COMPRESSOR);
+#endif
+  fprintf(vis, ">\n");
+  fprintf(vis, "<StructuredGrid WholeExtent=\"%d %d %d %d %d %d\">\n", x0, x0+bnx, y0, y0+bny, 0, 0);
+  fprintf(vis, "<Piece Extent=\"%d %d %d %d %d %d\">\n", x0, x0+bnx, y0, y0+bny, 0, 0);
+  fprintf(vis, "<PointData></PointData>\n");
+
+  // declaration of the variable list
+  fprintf(vis, "<CellData Scalars=\"");
+  for (nv = 0; nv < nvar; nv++){
+    fprintf(vis, " %s", varName(nv));
+  }
+  fprintf(vis, "\">\n");
+  for (nv = 0; nv < nvar; nv++){
+    visDataArray(vis,varName(nv),1,offPos+nv);
+  }
+  fprintf(vis, "</CellData>\n");
+  fprintf(vis, "<Points>\n");
+  visDataArray(vis,NULL,3,offPos+nvar);
+  fprintf(vis, "</Points>\n");
+  fprintf(vis, "</Piece>\n");
+  fprintf(vis, "</StructuredGrid>\n");
+  fprintf(vis, "<AppendedData encoding=\"raw\">\n_");
+  base=ftell(vis);
+
+  for (nv = 0; nv < nvar; nv++){
+    visArrayBegin(&va,vis,(uint64_t)bnx*bny,base,offPos[nv]);
+    visArrayPut(&va,u+(size_t)nv*bnx*bny,(uint64_t)bnx*bny);
+    visArrayEnd(&va);
+  }
+
+  pts=(double*)malloc(3*(bnx+1)*sizeof(double));
+  visArrayBegin(&va,vis,(uint64_t)3*(bnx+1)*(bny+1),base,offPos[nvar]);
+  for (j = 0; j <= bny; j++){
+    for (i = 0; i <= bnx; i++){
+      pts[3*i  ]=(x0+i)*dx;
+      pts[3*i+1]=(y0+j)*dy;
+      pts[3*i+2]=0.0;
+    }
+    visArrayPut(&va,pts,3*(bnx+1));
+  }
+  visArrayEnd(&va);
+  free(pts);
+  free(offPos);
+
+  fprintf(vis, "\n</AppendedData>\n");
+  fprintf(vis, "</VTKFile>\n");
+  fclose(vis);
+}
@@ -0,0 +1,25 @@
+#ifndef VISFILE_H_
+#define VISFILE_H_
+
+//Type of the mesh and point arrays of the visualisation files.
+//VIS_FLOAT32 rounds them to single precision, which halves the files
+#ifdef VIS_FLOAT32
+#define VIS_TYPE "Float32"
+#else
+#define VIS_TYPE "Float64"
+#endif
+
+//Values per compression block of the zlib and LZ4 builds
+#ifndef VIS_BLOCK
+#define VIS_BLOCK 32768
+#endif
+
+//zlib level of the zlib build, fast rather than small by default
+#ifndef VIS_ZLEVEL
+#define VIS_ZLEVEL 1
+#endif
+
+const char *varName(int nv);
+void writeVts(char *outName, double *mesh, double dx, double dy, int nvar, int x0, int bnx, int y0, int bny);
+
+#endif //VISFILE_H_
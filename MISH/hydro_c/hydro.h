@@ -3,8 +3,8 @@
 
 #include "hydro_struct.h"
 #include "hydro_defs.h"
-
-void engine(double *mesh, hydro_prob *Hp, hydro_args *Ha);
-
+#include "real.h"
+#include "layout.h"
+#include "engine.h"
 
 #endif //HYDRO_H_
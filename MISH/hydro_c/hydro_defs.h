@@ -11,5 +11,47 @@
 
 #define BND_REFL 0
 #define BND_PERM 1
+#define BND_INT 2
+
+//Number of pencils runPass sweeps at once; 8 columns fill a cache
+//line in the y pass
+#ifndef PENCIL_TILE
+#define PENCIL_TILE 8
+#endif
+
+//Number of interfaces the Riemann solver works on at once, a few times
+//the SIMD width
+#ifndef RIEMANN_BATCH
+#define RIEMANN_BATCH 16
+#endif
+
+//Define TEMPORAL_BLOCK to run both passes of a step on one block of
+//TBLOCK x TBLOCK cells at a time, see blockStep
+#ifndef TBLOCK
+#define TBLOCK 64
+#endif
+
+//The blocks of TEMPORAL_BLOCK are strided views of the mesh, which an
+//AoSoA mesh (MESH_AOSOA, see layout.h) cannot be given as
+#if defined(TEMPORAL_BLOCK)&&defined(MESH_AOSOA)
+#error "TEMPORAL_BLOCK needs the variable major mesh"
+#endif
+
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//sweep over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+//The kernels' globals are thread local in the library build, so library
+//instances can step on different threads at once
+#ifdef MISH_LIB
+#define MISH_TLS _Thread_local
+#else
+#define MISH_TLS
+#endif
 
 #endif //HYDRO_DEFS_H_
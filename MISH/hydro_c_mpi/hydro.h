@@ -3,8 +3,7 @@
 
 #include "hydro_struct.h"
 #include "hydro_defs.h"
-
-void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya);
-
+#include "real.h"
+#include "engine.h"
 
 #endif //HYDRO_H_
@@ -13,4 +13,31 @@
 #define BND_PERM 1
 #define BND_INT 2
 
+//Number of pencils runPass sweeps at once; 8 columns fill a cache
+//line in the y pass
+#ifndef PENCIL_TILE
+#define PENCIL_TILE 8
+#endif
+
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//sweep over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+//Define LOAD_BALANCE to move the row boundaries between the process rows
+//every LB_INTERVAL steps, so each process row gets an equal share of the
+//measured sweep time. Boundaries only move when the slowest process row
+//is LB_TOL times the mean, and no strip gets fewer than LB_MIN_ROWS rows
+#ifndef LB_INTERVAL
+#define LB_INTERVAL 50
+#endif
+#ifndef LB_TOL
+#define LB_TOL 1.05
+#endif
+#define LB_MIN_ROWS 4
+
 #endif //HYDRO_DEFS_H_
@@ -1,25 +1,57 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
 #include <mpi.h>
 #include "hydro.h"
+#include "restart.h"
+#include "outfile_mpi.h"
+#include "timing.h"
 #include "float.h"
+#include "riemann_approx.h"
+#include "cody.h"
 
 hydro_args *Ha;
 hydro_prob *Hp;
-double *q, *bndLS, *bndLR, *bndHS, *bndHR;
-double *qr, *ql;
-double *flx;
+hydro_timing Ht;
+real *q, *qr, *ql;
+double *bndLS, *bndLR, *bndHS, *bndHR;
+double *edgT, *edgB;
+double *visMesh;
+real *flx;
+size_t primSize, qSize, flxSize;
 
 //MPI Vars
-int bndT, bndB;
-int pProc, nProc;
+int bndT, bndB, bndLf, bndRt;
+int pProc, nProc, lProc, rProc;
 int rank, size;
-int myNy;
+int dims[2];
+int myNx, myNy;
 int varSize;
-
-double slope(double *q,int ind);
+MPI_Comm cartComm;
+MPI_Datatype colType, rowType;
+MPI_Request hReqs[4], vReqs[4];
+//Set if MPI lets any one thread at a time call it, as the halo task needs
+int taskHalo;
+
+//Mass and energy sums with their Neumaier corrections, and the number of
+//cells holding a NaN or Inf, gathered tile by tile by the last pass of a
+//step that prints a progress line
+typedef struct {
+  double sum[2], corr[2];
+  int nans;
+} mesh_diag;
+
+//Progress line of step n whose rank partials are in flight to rank 0
+typedef struct {
+  MPI_Request req;
+  double part[5], *parts;
+  int pend, n;
+  double t, dt;
+} diag_line;
+
+real slope(real *q,int ind);
 
 void printArray(char* label,double *arr, int nvar, int nx, int ny){
   int nV,i,j;
@@ -42,192 +74,213 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny){
   }
 }
 
-double calcDT(double *mesh){
+//Max CFL denominator of the ni by nj block of interior cells from (i0,j0),
+//on a mesh with row stride rs and variable stride vs. At least smallc
+double blockDenom(double *mesh, int rs, int vs, int i0, int ni, int j0, int nj){
   int lI, i, j;
   double denom, max_denom;
-  double gmax;
   double r,vx,vy,eint,p;
   double c,cx,cy;
   double smallp;
 
-  c=0.0;
   max_denom=Ha->smallc;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp parallel for private(i,j,r,vx,vy,eint,p,denom,c,cx,cy) shared(max_denom, mesh, Ha, Hp, smallp)
-  for (lI=0; lI<Hp->nx*myNy; lI++){
-    i=lI%Hp->nx;
-    j=lI/Hp->nx;
-    r   =MAX(mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
-    vx  =    mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARVX ]/r;
-    vy  =    mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARVY ]/r;
-    eint=    mesh[i+2+(j+2)*(Hp->nx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for (lI=0; lI<ni*nj; lI++){
+    i=i0+lI%ni;
+    j=j0+lI/ni;
+    r   =MAX(mesh[i+2+(j+2)*rs+vs*VARRHO],Ha->smallr);
+    vx  =    mesh[i+2+(j+2)*rs+vs*VARVX ]/r;
+    vy  =    mesh[i+2+(j+2)*rs+vs*VARVY ]/r;
+    eint=    mesh[i+2+(j+2)*rs+vs*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
     
     c=sqrt((Hp->gamma*p/r));
     cx=(c+fabs(vx))/Hp->dx;
     cy=(c+fabs(vy))/Hp->dy;
     denom=cx+cy;
-    if(denom>max_denom){
-#pragma omp critical
-      {
-	if(max_denom<denom)max_denom=denom;
-      }
+    if(max_denom<denom)max_denom=denom;
+  }
+  return max_denom;
+}
+
+void neumaierAdd(double *sum, double *corr, double v);
+
+//Fold the ni by nj block of interior cells from (i0,j0), on a mesh with row
+//stride rs and variable stride vs, into the diagnostics dg
+void blockDiag(mesh_diag *dg, double *mesh, int rs, int vs, int i0, int ni, int j0, int nj){
+  int lI, i, j, nV, bad;
+
+  for (lI=0; lI<ni*nj; lI++){
+    i=i0+lI%ni;
+    j=j0+lI/ni;
+    neumaierAdd(&dg->sum[0],&dg->corr[0],mesh[i+2+(j+2)*rs+vs*VARRHO]);
+    neumaierAdd(&dg->sum[1],&dg->corr[1],mesh[i+2+(j+2)*rs+vs*VARPR ]);
+    bad=0;
+    for(nV=0;nV<Hp->nvar;nV++){
+      if(!isfinite(mesh[i+2+(j+2)*rs+vs*nV]))bad=1;
     }
+    dg->nans+=bad;
   }
-  //printf("NODE %d: denom %g\n",rank,max_denom);
-  MPI_Allreduce(&max_denom,&gmax,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
-  //printf("NODE %d: gdenom %g\n",rank,gmax);
+}
+
+//Timestep from this rank's CFL denominator, the max over all ranks
+double globalDT(double denom){
+  double gmax;
+
+  MPI_Allreduce(&denom,&gmax,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
   return 0.5/gmax;
 }
 
+double calcDT(double *mesh){
+  int j;
+  double max_denom;
+
+  max_denom=Ha->smallc;
+#pragma omp parallel for reduction(max:max_denom)
+  for(j=0;j<myNy;j++){
+    max_denom=MAX(max_denom,blockDenom(mesh,myNx+4,varSize,0,myNx,j,1));
+  }
+  return globalDT(max_denom);
+}
+
 void setHHalo(double *mesh, int LBnd, int RBnd){
   int lI, i,j;
-#pragma omp parallel for private(i,j) shared(mesh,LBnd,RBnd,Hp,myNy)
+  MPI_Status stat[4];
+  MPI_Startall(4,hReqs);
+  MPI_Waitall(4,hReqs,stat);
+#pragma omp parallel for private(i,j) shared(mesh,LBnd,RBnd,Hp,myNx,myNy)
   for(lI=0;lI<2*myNy;lI++){
     i=lI%2;
     j=lI/2;
     //Left Boundary
     if(LBnd==BND_REFL){
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }else if(LBnd==BND_PERM){
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVX )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[3-i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }
     //Right Boundary
     if(RBnd==BND_REFL){
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVX )]=-mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }else if(RBnd==BND_PERM){
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARRHO)];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVX )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARVY )];
-      mesh[Hp->nx+2+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )]= mesh[Hp->nx+i+(Hp->nx+4)*(j+2+(myNy+4)*VARPR )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARRHO)];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVX )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVX )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARVY )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARVY )];
+      mesh[myNx+2+i+(myNx+4)*(j+2+(myNy+4)*VARPR )]= mesh[myNx+i+(myNx+4)*(j+2+(myNy+4)*VARPR )];
     }
   }
 }
 
+void setVBnd(double *mesh, int TBnd, int BBnd);
+
 void setVHalo(double *mesh, int TBnd, int BBnd){
+  MPI_Status stat[4];
+  MPI_Startall(4,vReqs);
+  MPI_Waitall(4,vReqs,stat);
+  setVBnd(mesh,TBnd,BBnd);
+}
+
+//Apply the top and bottom boundary conditions to the halo rows
+void setVBnd(double *mesh, int TBnd, int BBnd){
   int lI, i,j;
-  int row=Hp->nx+4;
-  MPI_Request reqs[16];
-  MPI_Status stat[16];
-  MPI_Irecv(mesh+(     0)*row+VARRHO*varSize,2*row,MPI_DOUBLE,pProc,1,MPI_COMM_WORLD,reqs+ 0);
-  MPI_Irecv(mesh+(     0)*row+VARVX *varSize,2*row,MPI_DOUBLE,pProc,3,MPI_COMM_WORLD,reqs+ 1);
-  MPI_Irecv(mesh+(     0)*row+VARVY *varSize,2*row,MPI_DOUBLE,pProc,5,MPI_COMM_WORLD,reqs+ 2);
-  MPI_Irecv(mesh+(     0)*row+VARPR *varSize,2*row,MPI_DOUBLE,pProc,7,MPI_COMM_WORLD,reqs+ 3);
-  MPI_Isend(mesh+(     2)*row+VARRHO*varSize,2*row,MPI_DOUBLE,pProc,2,MPI_COMM_WORLD,reqs+ 4);
-  MPI_Isend(mesh+(     2)*row+VARVX *varSize,2*row,MPI_DOUBLE,pProc,4,MPI_COMM_WORLD,reqs+ 5);
-  MPI_Isend(mesh+(     2)*row+VARVY *varSize,2*row,MPI_DOUBLE,pProc,6,MPI_COMM_WORLD,reqs+ 6);
-  MPI_Isend(mesh+(     2)*row+VARPR *varSize,2*row,MPI_DOUBLE,pProc,8,MPI_COMM_WORLD,reqs+ 7);
-  MPI_Isend(mesh+(myNy  )*row+VARRHO*varSize,2*row,MPI_DOUBLE,nProc,1,MPI_COMM_WORLD,reqs+ 8);
-  MPI_Isend(mesh+(myNy  )*row+VARVX *varSize,2*row,MPI_DOUBLE,nProc,3,MPI_COMM_WORLD,reqs+ 9);
-  MPI_Isend(mesh+(myNy  )*row+VARVY *varSize,2*row,MPI_DOUBLE,nProc,5,MPI_COMM_WORLD,reqs+10);
-  MPI_Isend(mesh+(myNy  )*row+VARPR *varSize,2*row,MPI_DOUBLE,nProc,7,MPI_COMM_WORLD,reqs+11);
-  MPI_Irecv(mesh+(myNy+2)*row+VARRHO*varSize,2*row,MPI_DOUBLE,nProc,2,MPI_COMM_WORLD,reqs+12);
-  MPI_Irecv(mesh+(myNy+2)*row+VARVX *varSize,2*row,MPI_DOUBLE,nProc,4,MPI_COMM_WORLD,reqs+13);
-  MPI_Irecv(mesh+(myNy+2)*row+VARVY *varSize,2*row,MPI_DOUBLE,nProc,6,MPI_COMM_WORLD,reqs+14);
-  MPI_Irecv(mesh+(myNy+2)*row+VARPR *varSize,2*row,MPI_DOUBLE,nProc,8,MPI_COMM_WORLD,reqs+15);
-  MPI_Waitall(16,reqs,stat);
-#pragma omp parallel for private(i,j) shared(mesh,TBnd,BBnd,Hp,myNy)
-  for(lI=0;lI<2*Hp->nx;lI++){
+#pragma omp parallel for private(i,j) shared(mesh,TBnd,BBnd,Hp,myNx,myNy)
+  for(lI=0;lI<2*myNx;lI++){
     i=lI/2;
     j=lI%2;
     //Top boundary
     if(TBnd==BND_REFL){
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVY )]=-mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVY )]=-mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARPR )];
     }else if(TBnd==BND_PERM){
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARVY )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(3-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARVY )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(3-j+(myNy+4)*VARPR )];
     }
     //Bottom boundary
     if(BBnd==BND_REFL){
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVY )]=-mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVY )]=-mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARPR )];
     }else if(BBnd==BND_PERM){
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVX )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARVY )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARVY )];
-      mesh[i+2+(Hp->nx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(Hp->nx+4)*(myNy+1-j+(myNy+4)*VARPR )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARRHO)]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARRHO)];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVX )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVX )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARVY )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARVY )];
+      mesh[i+2+(myNx+4)*(myNy+2+j+(myNy+4)*VARPR )]= mesh[i+2+(myNx+4)*(myNy+1-j+(myNy+4)*VARPR )];
     }
   }
 }
 
-void toPrimX(double *q, double *mesh){
+void toPrimX(real *q, double *mesh, int t0, int tn){
   int i;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp,myNy)
-  for(i=0;i<myNy*(Hp->nx+4);i++){
-    xI=i%(Hp->nx+4);
-    yI=i/(Hp->nx+4);
-    r   =MAX(mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
-    vx  =mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARVX ]/r;
-    vy  =mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARVY ]/r;
-    eint=mesh[xI+(yI+2)*(Hp->nx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for(i=0;i<tn*(myNx+4);i++){
+    xI=i%(myNx+4);
+    yI=i/(myNx+4);
+    r   =MAX(mesh[xI+(yI+t0+2)*(myNx+4)+varSize*VARRHO],Ha->smallr);
+    vx  =mesh[xI+(yI+t0+2)*(myNx+4)+varSize*VARVX ]/r;
+    vy  =mesh[xI+(yI+t0+2)*(myNx+4)+varSize*VARVY ]/r;
+    eint=mesh[xI+(yI+t0+2)*(myNx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[xI+(Hp->nx+4)*(yI+myNy*VARRHO)]=r;
-    q[xI+(Hp->nx+4)*(yI+myNy*VARVX )]=vx;
-    q[xI+(Hp->nx+4)*(yI+myNy*VARVY )]=vy;
-    q[xI+(Hp->nx+4)*(yI+myNy*VARPR )]=p;
+    q[xI+(myNx+4)*(yI+tn*VARRHO)]=r;
+    q[xI+(myNx+4)*(yI+tn*VARVX )]=vx;
+    q[xI+(myNx+4)*(yI+tn*VARVY )]=vy;
+    q[xI+(myNx+4)*(yI+tn*VARPR )]=p;
   }
 }
 
-void toPrimY(double *q, double *mesh){
+void toPrimY(real *q, double *mesh, int np, int vs, int t0, int tn){
   int i;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp prallel for private(xI,yI,r,vx,,vy,eint,p) shared(q,mesh,smallp,Ha,Hp,myNy)
-  for(i=0;i<(myNy+4)*Hp->nx;i++){
-    xI=i%Hp->nx;
-    yI=i/Hp->nx;
-    r   =MAX(mesh[xI+2+yI*(Hp->nx+4)+varSize*VARRHO],Ha->smallr);
-    vx  =mesh[xI+2+yI*(Hp->nx+4)+varSize*VARVX ]/r;
-    vy  =mesh[xI+2+yI*(Hp->nx+4)+varSize*VARVY ]/r;
-    eint=mesh[xI+2+yI*(Hp->nx+4)+varSize*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for(i=0;i<(np+4)*tn;i++){
+    xI=i%tn;
+    yI=i/tn;
+    r   =MAX(mesh[xI+t0+2+yI*(myNx+4)+vs*VARRHO],Ha->smallr);
+    vx  =mesh[xI+t0+2+yI*(myNx+4)+vs*VARVX ]/r;
+    vy  =mesh[xI+t0+2+yI*(myNx+4)+vs*VARVY ]/r;
+    eint=mesh[xI+t0+2+yI*(myNx+4)+vs*VARPR ]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[yI+(myNy+4)*(xI+Hp->nx*VARRHO)]=r;
-    q[yI+(myNy+4)*(xI+Hp->nx*VARVX )]=vy;
-    q[yI+(myNy+4)*(xI+Hp->nx*VARVY )]=vx;
-    q[yI+(myNy+4)*(xI+Hp->nx*VARPR )]=p;
+    q[yI+(np+4)*(xI+tn*VARRHO)]=r;
+    q[yI+(np+4)*(xI+tn*VARVX )]=vy;
+    q[yI+(np+4)*(xI+tn*VARVY )]=vx;
+    q[yI+(np+4)*(xI+tn*VARPR )]=p;
   }
 }
 
-void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+void trace(real *ql, real *qr, real *q, real dtdx, int np, int nt){
   int lI;
   int i,j;
-  double  r, u, v1, p, a;
-  double dr,du,dv1,dp,da;
-  double cc,csq;
-  double alpham,alphap,alphazr;
-  double spplus,spzerol,spzeror,spminus;
-  double ap,am,azr,azv1,acmp;
+  real  r, u, v1, p, a;
+  real dr,du,dv1,dp,da;
+  real cc,csq;
+  real alpham,alphap,alphazr;
+  real spplus,spzerol,spzeror,spminus;
+  real ap,am,azr,azv1,acmp;
+  real gmma;
 
   //if(isnan(dtdx))printf("N[%2d]: dtdx isnan\n",rank);
 
-#pragma omp parallel for shared(q,qr,ql,dtdx,np,nt,Hp,Ha)\
-  private(i,j,r,u,v1,p,dr,du,dv1,dp,cc,csq,ap,am,azr,azv1,acmp)	\
-  private(alpham,alphap,alphazr,spplus,spminus,spzerol,spzeror)
+  gmma=Hp->gamma;
   for(lI=0;lI<(np+2)*nt;lI++){
     i=lI%(np+2);
     j=lI/(np+2);
@@ -236,7 +289,7 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
     v1=q[i+1+(np+4)*(j+nt*VARVY )];
     p =q[i+1+(np+4)*(j+nt*VARPR )];
     
-    csq=Hp->gamma*p/r;
+    csq=gmma*p/r;
     cc=sqrt(csq);
 
     dr =slope(q,i+1+(np+4)*(j+nt*VARRHO));
@@ -276,8 +329,8 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
   }
 }
 
-double slope(double *q,int ind){
-  double dlft, drgt, dcen, dsgn, dlim;
+real slope(real *q,int ind){
+  real dlft, drgt, dcen, dsgn, dlim;
   //  printf("Calc slope for %d refs: [%d,%d,%d]\n",ind,ind-1,ind,ind+1);
   dlft=q[ind  ]-q[ind-1];
   drgt=q[ind+1]-q[ind  ];
@@ -289,47 +342,53 @@ double slope(double *q,int ind){
   return dsgn*MIN(dlim,fabs(dcen));
 }
 
-void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+void riemann(real *flx, real *qxm, real *qxp, int np, int nt){
   int lI, i,j,n;
-  double smallp, smallpp;
-  double gmma6, entho;
-  double qgdnvR,qgdnvVX,qgdnvVY,qgdnvP;
-  double rl,vxl,vyl,pl,cl,wl,ql,vsl;
-  double rr,vxr,vyr,pr,cr,wr,qr,vsr;
-  double ro,vxo,po,wo,co;
-  double rx,vxx,px,wx,cx;
-  double sgnm, scr, frac;
-  double spout,spin,ushk;
-  double ekin,etot,delp;
-
+  real smallr, smallc, smallp, smallpp;
+  real gmma;
+  real gmma6, entho;
+  real qgdnvR,qgdnvVX,qgdnvVY,qgdnvP;
+  real rl,vxl,vyl,pl,cl,wl,ql,vsl;
+  real rr,vxr,vyr,pr,cr,wr,qr,vsr;
+  real ro,vxo,po,wo,co;
+  real rx,vxx,px,wx,cx;
+  real sgnm, scr, frac;
+  real spout,spin,ushk;
+  real ekin,etot,delp;
+
+  smallr=Ha->smallr;
+  smallc=Ha->smallc;
+  gmma=Hp->gamma;
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
   smallpp=Ha->smallr*smallp;
   gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
   entho=1.0/(Hp->gamma-1.0);
-#pragma omp parallel for shared(flx,qxm,qxp,np,nt,Ha,Hp,gmma6,entho,smallpp,smallp) \
-  private(i,j,n,sgnm,scr,frac) \
-  private(rl,vxl,vyl,pl,cl,wl,ql,vsl) \
-  private(rr,vxr,vyr,pr,cr,wr,qr,vsr) \
-  private(ro,vxo,po,wo,co)\
-  private(rx,vxx,px,wx,cx)\
-  private(spout,spin,ushk,delp)\
-  private(qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,ekin,etot)
   for(lI=0;lI<(np+1)*nt;lI++){
     i=lI%(np+1);
     j=lI/(np+1);
     
-    rl =MAX(qxm[i  +(np+2)*(j+nt*VARRHO)],Ha->smallr);
+    rl =MAX(qxm[i  +(np+2)*(j+nt*VARRHO)],smallr);
     vxl=    qxm[i  +(np+2)*(j+nt*VARVX )];
     vyl=    qxm[i  +(np+2)*(j+nt*VARVY )];
     pl =MAX(qxm[i  +(np+2)*(j+nt*VARPR )],rl*smallp);
 
-    rr =MAX(qxp[i+1+(np+2)*(j+nt*VARRHO)],Ha->smallr);
+    rr =MAX(qxp[i+1+(np+2)*(j+nt*VARRHO)],smallr);
     vxr=    qxp[i+1+(np+2)*(j+nt*VARVX )];
     vyr=    qxp[i+1+(np+2)*(j+nt*VARVY )];
     pr =MAX(qxp[i+1+(np+2)*(j+nt*VARPR )],rr*smallp);
+
+    //The approximate solvers of Ha->scheme, see riemann_approx.h
+    if(Ha->scheme==SCHEME_HLLC){
+      hllcFlux(gmma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,flx+i+(np+1)*j,(np+1)*nt);
+      continue;
+    }
+    if(Ha->scheme==SCHEME_HLL){
+      hllFlux(gmma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,flx+i+(np+1)*j,(np+1)*nt);
+      continue;
+    }
     
-    cl=Hp->gamma*pl*rl;
-    cr=Hp->gamma*pr*rr;
+    cl=gmma*pl*rl;
+    cr=gmma*pr*rr;
     
     wl=sqrt(cl);
     wr=sqrt(cr);
@@ -368,11 +427,11 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
       wo = wr;
       qgdnvVY=vyr;
     }
-    co=MAX(Ha->smallc,sqrt(fabs(Hp->gamma*po/ro)));
+    co=MAX(smallc,sqrt(fabs(gmma*po/ro)));
     
-    rx=MAX(Ha->smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
+    rx=MAX(smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
     
-    cx=MAX(Ha->smallc,sqrt(fabs(Hp->gamma*px/rx)));
+    cx=MAX(smallc,sqrt(fabs(gmma*px/rx)));
       
     spout=co   -sgnm*vxo;
     spin =cx   -sgnm*vxx;
@@ -383,7 +442,7 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
       spout=ushk;
     }
 
-    scr=MAX(spout-spin,Ha->smallc+fabs(spout+spin));
+    scr=MAX(spout-spin,smallc+fabs(spout+spin));
 
     frac=0.5*(1.0+(spout+spin)/scr);
     frac=MAX(0.0,MIN(1.0,frac));
@@ -409,67 +468,146 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
-void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxX(double *mesh, real *flx, double dtdx, int np, int nt, int t0, int tn){
   int lI, i, j;
 
-#pragma omp parallel for private(i,j) shared(mesh,flx,dtdx,np,nt)
-  for(lI=0;lI<np*nt;lI++){
+  for(lI=0;lI<np*tn;lI++){
     i=lI%np;
     j=lI/np;
-    mesh[i+2+(np+4)*(j+2+(nt+4)*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
-						flx[i+1+(np+1)*(j+nt*VARRHO)]);
-    mesh[i+2+(np+4)*(j+2+(nt+4)*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
-						flx[i+1+(np+1)*(j+nt*VARVX )]);
-    mesh[i+2+(np+4)*(j+2+(nt+4)*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
-						flx[i+1+(np+1)*(j+nt*VARVY )]);
-    mesh[i+2+(np+4)*(j+2+(nt+4)*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
-						flx[i+1+(np+1)*(j+nt*VARPR )]);
+    mesh[i+2+(np+4)*(j+t0+2+(nt+4)*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARRHO)]-
+						   flx[i+1+(np+1)*(j+tn*VARRHO)]);
+    mesh[i+2+(np+4)*(j+t0+2+(nt+4)*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVX )]-
+						   flx[i+1+(np+1)*(j+tn*VARVX )]);
+    mesh[i+2+(np+4)*(j+t0+2+(nt+4)*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVY )]-
+						   flx[i+1+(np+1)*(j+tn*VARVY )]);
+    mesh[i+2+(np+4)*(j+t0+2+(nt+4)*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+tn*VARPR )]-
+						   flx[i+1+(np+1)*(j+tn*VARPR )]);
   }
 }
 
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxY(double *mesh, real *flx, double dtdx, int np, int nt, int vs, int t0, int tn){
   int lI, i, j;
 
-#pragma omp parallel for private(i,j) shared(mesh,flx,dtdx,np,nt)
-  for(lI=0;lI<np*nt;lI++){
-    i=lI%np;
-    j=lI/np;
-    mesh[j+2+(nt+4)*(i+2+(np+4)*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
-						flx[i+1+(np+1)*(j+nt*VARRHO)]);
-    mesh[j+2+(nt+4)*(i+2+(np+4)*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
-						flx[i+1+(np+1)*(j+nt*VARVY )]);
-    mesh[j+2+(nt+4)*(i+2+(np+4)*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
-						flx[i+1+(np+1)*(j+nt*VARVX )]);
-    mesh[j+2+(nt+4)*(i+2+(np+4)*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
-						flx[i+1+(np+1)*(j+nt*VARPR )]);
+  for(lI=0;lI<np*tn;lI++){
+    j=lI%tn;
+    i=lI/tn;
+    mesh[j+t0+2+(nt+4)*(i+2)+vs*VARRHO]+=dtdx*(flx[i  +(np+1)*(j+tn*VARRHO)]-
+						   flx[i+1+(np+1)*(j+tn*VARRHO)]);
+    mesh[j+t0+2+(nt+4)*(i+2)+vs*VARVX ]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVY )]-
+						   flx[i+1+(np+1)*(j+tn*VARVY )]);
+    mesh[j+t0+2+(nt+4)*(i+2)+vs*VARVY ]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVX )]-
+						   flx[i+1+(np+1)*(j+tn*VARVX )]);
+    mesh[j+t0+2+(nt+4)*(i+2)+vs*VARPR ]+=dtdx*(flx[i  +(np+1)*(j+tn*VARPR )]-
+						   flx[i+1+(np+1)*(j+tn*VARPR )]);
   }
 }
 
+void neumaierAdd(double *sum, double *corr, double v){
+  double t;
+
+  t=*sum+v;
+  if(fabs(*sum)>=fabs(v)){
+    *corr+=(*sum-t)+v;
+  }else{
+    *corr+=(v-t)+*sum;
+  }
+  *sum=t;
+}
+
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   int lI,i,j;
+  int th, nth;
   double sum, corr;
-  double nsum, c_nxt;
-  double gsum, gcorr;
+  double tsum, tcorr;
+  double *thSum, *thCorr;
+  double part[2], *parts;
+
+  nth=omp_get_max_threads();
+  thSum =(double*)calloc(nth,sizeof(double));
+  thCorr=(double*)calloc(nth,sizeof(double));
+
+  //Each thread keeps its own compensated partial, combined in thread order
+#pragma omp parallel private(lI,i,j,th,tsum,tcorr) shared(mesh,var,nx,ny,nHx,nHy,thSum,thCorr)
+  {
+    th=omp_get_thread_num();
+    tsum=0.0;
+    tcorr=0.0;
+#pragma omp for schedule(static)
+    for(lI=0;lI<nx*ny;lI++){
+      i=lI%(nx);
+      j=lI/(nx);
+      neumaierAdd(&tsum,&tcorr,mesh[i+nHx+(nx+2*nHx)*(j+nHy+(ny+2*nHy)*var)]);
+    }
+    thSum[th]=tsum;
+    thCorr[th]=tcorr;
+  }
 
   sum=0.0;
   corr=0.0;
+  for(th=0;th<nth;th++){
+    neumaierAdd(&sum,&corr,thSum[th]);
+    corr+=thCorr[th];
+  }
+  free(thSum);
+  free(thCorr);
+
+  //Combine the rank partials in rank order so every rank gets the same total
+  part[0]=sum;
+  part[1]=corr;
+  parts=(double*)malloc(2*size*sizeof(double));
+  MPI_Allgather(part,2,MPI_DOUBLE,parts,2,MPI_DOUBLE,MPI_COMM_WORLD);
+  sum=0.0;
+  corr=0.0;
+  for(i=0;i<size;i++){
+    neumaierAdd(&sum,&corr,parts[2*i]);
+    corr+=parts[2*i+1];
+  }
+  free(parts);
+  return sum+corr;
+}
 
-  //printf("N[%2d]: summing var %d over range (%d,%d) w/ halos of size (%d,%d)\n",rank,var,nx,ny,nHx,nHy);
+//Start gathering the diagnostics dg of step n to rank 0 for its progress
+//line. The gather completes in finishDiag, after the next step has run
+void postDiag(diag_line *ln, mesh_diag *dg, int n, double t, double dt){
+  ln->part[0]=dg->sum[0];
+  ln->part[1]=dg->corr[0];
+  ln->part[2]=dg->sum[1];
+  ln->part[3]=dg->corr[1];
+  ln->part[4]=dg->nans;
+  ln->n=n;
+  ln->t=t;
+  ln->dt=dt;
+  ln->pend=1;
+#if MPI_VERSION>=3
+  MPI_Igather(ln->part,5,MPI_DOUBLE,ln->parts,5,MPI_DOUBLE,0,MPI_COMM_WORLD,&ln->req);
+#else
+  MPI_Gather(ln->part,5,MPI_DOUBLE,ln->parts,5,MPI_DOUBLE,0,MPI_COMM_WORLD);
+#endif
+}
 
-  for(lI=0;lI<nx*ny;lI++){
-    i=lI%(nx);
-    j=lI/(nx);
-    c_nxt=mesh[i+nHx+(nx+2*nHx)*(j+nHy+(ny+2*nHy)*var)];
-    nsum=sum+c_nxt;
-    corr=(nsum-sum)-c_nxt;
-    sum=nsum;
-    //printf("N[%2d]: @(%d,%d) %g\n",rank,i,j,sum+corr);
+//Complete the pending gather of ln, if any, and on rank 0 combine the rank
+//partials in rank order into TM and TE. Returns 1 if a line was pending
+int finishDiag(diag_line *ln, double *TM, double *TE, int *nans){
+  int i;
+  double sum[2]={0.0}, corr[2]={0.0};
+
+  if(!ln->pend)return 0;
+  ln->pend=0;
+#if MPI_VERSION>=3
+  MPI_Wait(&ln->req,MPI_STATUS_IGNORE);
+#endif
+  if(rank!=0)return 1;
+  *nans=0;
+  for(i=0;i<size;i++){
+    neumaierAdd(&sum[0],&corr[0],ln->parts[5*i  ]);
+    corr[0]+=ln->parts[5*i+1];
+    neumaierAdd(&sum[1],&corr[1],ln->parts[5*i+2]);
+    corr[1]+=ln->parts[5*i+3];
+    *nans+=(int)ln->parts[5*i+4];
   }
-  //printf("N[%2d]: lsum %g+%g\n",rank,sum,corr);
-  MPI_Allreduce(&sum,&gsum,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-  MPI_Allreduce(&corr,&gcorr,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-  //printf("N[%2d]: gsum %g+%g\n",rank,gsum,gcorr);
-  return gsum+gcorr;
+  *TM=sum[0]+corr[0];
+  *TE=sum[1]+corr[1];
+  return 1;
 }
 
 void nanScan(int *ret, double *mesh, int nvar, int nx, int ny, int nHx, int nHy){
@@ -497,57 +635,328 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 }
 
-void runPass(double *mesh, double dt, int n, int dir){
-  int np,nt;
-  double dx,dy;
-  char dCh;
-  char outLab[30];
+//Sweep the tn pencils of mesh from pencil t0, of nt pencils each np cells
+//long plus halos, in direction dir through the calling thread's slice of
+//q, ql, qr and flx. vs is the stride between the variables of mesh. Phase
+//times are added to tTh. If cdt is set, the CFL denominator of the updated
+//cells is folded into den, and if dg is set their diagnostics into dg,
+//both while the tile is in cache
+void sweepTile(double *mesh, double dt, double dx, int dir, int np, int nt, int vs, int t0, int tn,
+	       int cdt, double *tTh, double *den, mesh_diag *dg){
+  real *tq, *tqr, *tql, *tflx;
+  double tDen, tPh;
+
+  PH_START(tPh);
+  tq  =q  +omp_get_thread_num()*primSize;
+  tqr =qr +omp_get_thread_num()*qSize;
+  tql =ql +omp_get_thread_num()*qSize;
+  tflx=flx+omp_get_thread_num()*flxSize;
+  if(dir==0){
+    toPrimX(tq,mesh,t0,tn);
+  }else{
+    toPrimY(tq,mesh,np,vs,t0,tn);
+  }
+  PH_ADD(tTh,PH_PRIM,tPh);
+  trace(tql,tqr,tq,dt/dx,np,tn);
+  PH_ADD(tTh,PH_TRACE,tPh);
+  riemann(tflx,tql,tqr,np,tn);
+  PH_ADD(tTh,PH_RIEMANN,tPh);
+  if(dir==0){
+    addFluxX(mesh,tflx,dt/dx,np,nt,t0,tn);
+  }else{
+    addFluxY(mesh,tflx,dt/dx,np,nt,vs,t0,tn);
+  }
+  if(cdt){
+    if(dir==0){
+      tDen=blockDenom(mesh,np+4,vs,0,np,t0,tn);
+    }else{
+      tDen=blockDenom(mesh,nt+4,vs,t0,tn,0,np);
+    }
+    *den=MAX(*den,tDen);
+  }
+  if(dg){
+    if(dir==0){
+      blockDiag(dg,mesh,np+4,vs,0,np,t0,tn);
+    }else{
+      blockDiag(dg,mesh,nt+4,vs,t0,tn,0,np);
+    }
+  }
+  PH_ADD(tTh,PH_FLUX,tPh);
+}
+
+//Add the per thread phase times tTh, diagnostics thDg and denominators
+//thDen of nth threads into Ht, dg and the returned max, in thread order
+double mergeThreads(int nth, double *tTh, mesh_diag *thDg, mesh_diag *dg, double *thDen){
+  int th, ph;
+  double den=0.0;
+
+  for(th=0;th<nth;th++){
+    //Report the mean time per thread
+    for(ph=0;ph<NPHASE;ph++){
+      Ht.phase[ph]+=tTh[th*NPHASE+ph]/nth;
+    }
+    if(thDen)den=MAX(den,thDen[th]);
+    if(thDg){
+      neumaierAdd(&dg->sum[0],&dg->corr[0],thDg[th].sum[0]);
+      dg->corr[0]+=thDg[th].corr[0];
+      neumaierAdd(&dg->sum[1],&dg->corr[1],thDg[th].sum[1]);
+      dg->corr[1]+=thDg[th].corr[1];
+      dg->nans+=thDg[th].nans;
+    }
+  }
+  return den;
+}
+
+//Sweep the nt pencils of mesh, each np cells long plus halos, in direction
+//dir. vs is the stride between the variables of mesh
+//If cdt is set, also return the CFL denominator of the cells this sweep
+//updated, and if dg is set gather their diagnostics into it, see sweepTile
+double sweep(double *mesh, double dt, double dx, int dir, int np, int nt, int vs, int cdt, mesh_diag *dg){
+  int t0, nth;
+  double den, *tTh, *thDen;
+  mesh_diag *thDg=NULL;
+
+  //Each thread sweeps whole tiles of pencils through its own slice of q, ql,
+  //qr and flx. Phase times, denominators and diagnostics are kept per
+  //thread and combined in thread order
+  nth=omp_get_max_threads();
+  tTh=(double*)calloc(nth*NPHASE,sizeof(double));
+  thDen=(double*)calloc(nth,sizeof(double));
+  if(dg)thDg=(mesh_diag*)calloc(nth,sizeof(mesh_diag));
+#pragma omp parallel for shared(mesh,dt,dx,np,nt,vs,dir,cdt,tTh,thDen,thDg)
+  for(t0=0;t0<nt;t0+=PENCIL_TILE){
+    sweepTile(mesh,dt,dx,dir,np,nt,vs,t0,MIN(PENCIL_TILE,nt-t0),cdt,
+	      tTh+NPHASE*omp_get_thread_num(),thDen+omp_get_thread_num(),
+	      (thDg)?thDg+omp_get_thread_num():NULL);
+  }
+  den=mergeThreads(nth,tTh,thDg,dg,thDen);
+  free(tTh);
+  free(thDen);
+  free(thDg);
+  return den;
+}
 
+//Copy n rows of every variable between meshes with variable strides dvs and svs
+void copyRows(double *dst, int dvs, double *src, int svs, int n){
+  int nV, i;
 
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(i=0;i<n*(myNx+4);i++){
+      dst[i+nV*dvs]=src[i+nV*svs];
+    }
+  }
+}
+
+//The y pass of runPass as OpenMP tasks, for myNy>=4. One task starts the
+//halo exchange, waits on it and fills the halo rows of edgT and edgB, so
+//the thread running it acts as the communication thread for the pass. The
+//interior tiles are swept by the other threads meanwhile, and each edge
+//tile as soon as the halo task is done
+double taskPassY(double *mesh, double dt, int cdt, mesh_diag *dg){
+  int row=myNx+4;
+  int eVs=6*(myNx+4);
+  int t0, nth;
+  int halo=0;
+  double den, *tTh, *thDen;
+  double tPh;
+  mesh_diag *thDg=NULL;
+
+  nth=omp_get_max_threads();
+  tTh=(double*)calloc(nth*NPHASE,sizeof(double));
+  thDen=(double*)calloc(nth,sizeof(double));
+  if(dg)thDg=(mesh_diag*)calloc(nth,sizeof(mesh_diag));
+  //The edges keep the old values of the four rows next to them
+  PH_START(tPh);
+  copyRows(edgT+2*row,eVs,mesh+(     2)*row,varSize,4);
+  copyRows(edgB      ,eVs,mesh+(myNy-2)*row,varSize,4);
+  PH_ADD(Ht.phase,PH_HALO,tPh);
+#pragma omp parallel shared(mesh,dt,cdt,halo,tTh,thDen,thDg) private(t0)
+#pragma omp single
+  {
+#pragma omp task depend(out:halo) shared(mesh,halo,tTh)
+    {
+      double cPh;
+      MPI_Status stat[4];
+
+      //Time in the exchange counts as halo time of the thread running it
+      PH_START(cPh);
+      MPI_Startall(4,vReqs);
+      MPI_Waitall(4,vReqs,stat);
+      setVBnd(mesh,bndT,bndB);
+      copyRows(edgT      ,eVs,mesh+(     0)*row,varSize,2);
+      copyRows(edgB+4*row,eVs,mesh+(myNy+2)*row,varSize,2);
+      PH_ADD(tTh+NPHASE*omp_get_thread_num(),PH_HALO,cPh);
+    }
+    for(t0=0;t0<myNx;t0+=PENCIL_TILE){
+#pragma omp task firstprivate(t0) shared(mesh,dt,cdt,tTh,thDen,thDg)
+      sweepTile(mesh+2*row,dt,Hp->dy,1,myNy-4,myNx,varSize,t0,MIN(PENCIL_TILE,myNx-t0),cdt,
+		tTh+NPHASE*omp_get_thread_num(),thDen+omp_get_thread_num(),
+		(thDg)?thDg+omp_get_thread_num():NULL);
+    }
+    for(t0=0;t0<myNx;t0+=PENCIL_TILE){
+#pragma omp task firstprivate(t0) depend(in:halo) shared(dt,cdt,tTh,thDen,thDg)
+      {
+	sweepTile(edgT,dt,Hp->dy,1,2,myNx,eVs,t0,MIN(PENCIL_TILE,myNx-t0),cdt,
+		  tTh+NPHASE*omp_get_thread_num(),thDen+omp_get_thread_num(),
+		  (thDg)?thDg+omp_get_thread_num():NULL);
+	sweepTile(edgB,dt,Hp->dy,1,2,myNx,eVs,t0,MIN(PENCIL_TILE,myNx-t0),cdt,
+		  tTh+NPHASE*omp_get_thread_num(),thDen+omp_get_thread_num(),
+		  (thDg)?thDg+omp_get_thread_num():NULL);
+      }
+    }
+  }
+  den=mergeThreads(nth,tTh,thDg,dg,thDen);
+  PH_START(tPh);
+  copyRows(mesh+(   2)*row,varSize,edgT+2*row,eVs,2);
+  copyRows(mesh+(myNy)*row,varSize,edgB+2*row,eVs,2);
+  PH_ADD(Ht.phase,PH_HALO,tPh);
+  free(tTh);
+  free(thDen);
+  free(thDg);
+  return den;
+}
+
+//Run the pass in direction dir. If cdt is set, also return this rank's
+//CFL denominator of the updated mesh, and if dg is set gather this rank's
+//diagnostics of it
+double runPass(double *mesh, double dt, int n, int dir, int cdt, mesh_diag *dg){
+  int row=myNx+4;
+  int eVs=6*(myNx+4);
+  MPI_Status stat[4];
+  double den, eDen;
+  double tPh;
+
+  //Time spent filling and waiting on halos, the sweeps time themselves
+  PH_START(tPh);
   if(dir==0){
-    np=Hp->nx;
-    nt=myNy;
-    dx=Hp->dx;
-    dy=Hp->dy;
-    dCh='x';
-    //printf("N[%2d]:X-pass\n",rank);
-    setHHalo(mesh,Hp->bndL,Hp->bndR);
-    toPrimX(q,mesh);
-  }else{
-    np=myNy;
-    nt=Hp->nx;
-    dx=Hp->dy;
-    dy=Hp->dx;
-    dCh='y';
-    //printf("N[%2d]:Y-pass\n",rank);
+    setHHalo(mesh,bndLf,bndRt);
+    PH_ADD(Ht.phase,PH_HALO,tPh);
+    den=sweep(mesh,dt,Hp->dx,0,myNx,myNy,varSize,cdt,dg);
+  }else if(myNy<4){
     setVHalo(mesh,bndT,bndB);
-    toPrimY(q,mesh);
-  }
-  //sprintf(outLab,"MESH-%c",dCh);
-  //if(rank==0)printArray(outLab,mesh,Hp->nvar,Hp->nx+4,myNy+4);
-  //sprintf(outLab,"Q   -%c",dCh);
-  //if(rank==0)printArray(outLab,q,Hp->nvar,np+4,nt);
-  trace(ql,qr,q,dt/dx,np,nt);
-  //sprintf(outLab,"QL  -%c",dCh);
-  //if(rank==0)printArray(outLab,ql,Hp->nvar,np+2,nt);
-  //sprintf(outLab,"QR  -%c",dCh);
-  //if(rank==0)printArray(outLab,qr,Hp->nvar,np+2,nt);
-  riemann(flx,ql,qr,np,nt);
-  //sprintf(outLab,"FLX -%c",dCh);
-  //if(rank==0)printArray(outLab,flx,Hp->nvar,np+1,nt);
-  if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    PH_ADD(Ht.phase,PH_HALO,tPh);
+    den=sweep(mesh,dt,Hp->dy,1,myNy,myNx,varSize,cdt,dg);
+  }else if(taskHalo){
+    den=taskPassY(mesh,dt,cdt,dg);
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    //Rows 4 to myNy-1 need no halo cells, so update them while the halo
+    //rows are in flight. The two rows at each edge are updated afterwards
+    //on edgT and edgB, which keep the old values of the four rows next to
+    //each edge
+    MPI_Startall(4,vReqs);
+    copyRows(edgT+2*row,eVs,mesh+(     2)*row,varSize,4);
+    copyRows(edgB      ,eVs,mesh+(myNy-2)*row,varSize,4);
+    PH_ADD(Ht.phase,PH_HALO,tPh);
+    den=sweep(mesh+2*row,dt,Hp->dy,1,myNy-4,myNx,varSize,cdt,dg);
+    PH_START(tPh);
+    MPI_Waitall(4,vReqs,stat);
+    setVBnd(mesh,bndT,bndB);
+    copyRows(edgT      ,eVs,mesh+(     0)*row,varSize,2);
+    copyRows(edgB+4*row,eVs,mesh+(myNy+2)*row,varSize,2);
+    PH_ADD(Ht.phase,PH_HALO,tPh);
+    eDen=sweep(edgT,dt,Hp->dy,1,2,myNx,eVs,cdt,dg);
+    den=MAX(den,eDen);
+    eDen=sweep(edgB,dt,Hp->dy,1,2,myNx,eVs,cdt,dg);
+    den=MAX(den,eDen);
+    copyRows(mesh+(   2)*row,varSize,edgT+2*row,eVs,2);
+    copyRows(mesh+(myNy)*row,varSize,edgB+2*row,eVs,2);
+  }
+  //printArray("Post-pass",mesh,Hp->nvar,myNx+4,myNy+4);
+  return den;
+}
+
+//Set up the persistent halo exchanges of mesh, one message per neighbour.
+//colType is two columns of the interior rows and rowType two full rows,
+//both covering every variable
+void initHaloReqs(double *mesh){
+  int row=myNx+4;
+
+  MPI_Recv_init(mesh+2*row       ,1,colType,lProc,1,cartComm,hReqs+0);
+  MPI_Send_init(mesh+2*row+2     ,1,colType,lProc,2,cartComm,hReqs+1);
+  MPI_Send_init(mesh+2*row+myNx  ,1,colType,rProc,1,cartComm,hReqs+2);
+  MPI_Recv_init(mesh+2*row+myNx+2,1,colType,rProc,2,cartComm,hReqs+3);
+  MPI_Recv_init(mesh+(     0)*row,1,rowType,pProc,3,cartComm,vReqs+0);
+  MPI_Send_init(mesh+(     2)*row,1,rowType,pProc,4,cartComm,vReqs+1);
+  MPI_Send_init(mesh+(myNy  )*row,1,rowType,nProc,3,cartComm,vReqs+2);
+  MPI_Recv_init(mesh+(myNy+2)*row,1,rowType,nProc,4,cartComm,vReqs+3);
+}
+
+//Split n cells over np processes, giving process p its offset and length
+void splitDim(int n, int np, int p, int *off, int *len){
+  *len=n/np;
+  *off=p*(n/np);
+  if((n%np)>p){
+    (*len)++;
+    *off+=p;
+  }else{
+    *off+=n%np;
+  }
+}
+
+//Get the offset and size of the block of the global mesh owned by rank r
+void getBlock(int r, int *x0, int *bnx, int *y0, int *bny){
+  int coords[2];
+
+  MPI_Cart_coords(cartComm,r,2,coords);
+  splitDim(Hp->nx,dims[1],coords[1],x0,bnx);
+  splitDim(Hp->ny,dims[0],coords[0],y0,bny);
+}
+
+//Pick the process grid with the shortest block perimeter, dims[0] in y
+void chooseDims(int *dims){
+  int px, py;
+  double cost, best;
+
+  best=-1.0;
+  for(px=1;px<=size;px++){
+    if(size%px!=0)continue;
+    py=size/px;
+    if(px>Hp->nx||py>Hp->ny)continue;
+    cost=(double)Hp->nx/px+(double)Hp->ny/py;
+    if(best<0.0||cost<best){
+      best=cost;
+      dims[0]=py;
+      dims[1]=px;
+    }
+  }
+}
+
+//Write the interior of mesh as output step n. Each rank writes its own
+//piece of a .pvts from visMesh on the writer thread, so the time loop
+//carries on while it drains
+void writeOutput(double *mesh, int n){
+  int nV, lI, i, j, r;
+  int x0, bnx, y0, bny;
+  int *ext;
+  char outfile[30];
+
+  //visMesh may still be in use by the previous write
+  waitVis();
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<myNx*myNy;lI++){
+      i=lI%(myNx);
+      j=lI/(myNx);
+      visMesh[i+myNx*(j+myNy*nV)]=mesh[i+2+(myNx+4)*(j+2+(myNy+4)*nV)];
+    }
+  }
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  getBlock(rank,&x0,&bnx,&y0,&bny);
+  writeVisPieceAsync(outfile,rank,visMesh,Hp->dx,Hp->dy,Hp->nvar,x0,bnx,y0,bny);
+  if(rank==0){
+    ext=(int*)malloc(4*size*sizeof(int));
+    for(r=0;r<size;r++){
+      getBlock(r,ext+4*r,ext+4*r+1,ext+4*r+2,ext+4*r+3);
+    }
+    writeVisMaster(outfile,Hp->nvar,Hp->nx,Hp->ny,size,ext);
+    free(ext);
   }
-  //printArray("Post-pass",mesh,Hp->nvar,Hp->nx+4,myNy+4);
 }
 
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
-  int n, nV, lI, i,j;
+  int n, i;
   int bndL;
   int bndH;
-  double dt;
+  double dt, den;
   double cTime, nxttout;
 
   double volCell;
@@ -555,115 +964,136 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   double TM,TE;
   int M_exp, E_exp;
   double M_prec, E_prec;
+  int nans;
+  mesh_diag diag, *dg;
+  diag_line pLine;
   double *lMesh;
-  double *recvMesh;
 
-  char outfile[30];
   char outLab[30];
 
-  size_t primSize, qSize, flxSize;
 
   double initT, endT;
+  double tPh;
 
-  int mpi_err;
+  int mpi_err, thLevel;
+  int local, nlocal;
+  MPI_Comm node;
 
-  int *counts, *dspls;
+  int periods[2]={0,0};
+  int x0, y0;
+  MPI_Datatype col;
 
-  mpi_err=MPI_Init(argc,argv);
+  //The halo task may run on any thread of the team, one at a time
+  mpi_err=MPI_Init_thread(argc,argv,MPI_THREAD_SERIALIZED,&thLevel);
 
   if(mpi_err!=MPI_SUCCESS){
     printf("Error initializing MPI\n");
   }
+  taskHalo=TASK_HALO&&thLevel>=MPI_THREAD_SERIALIZED;
 
   Hp=Hyp;
   Ha=Hya;
 
   n=0;
+  den=0.0;
   cTime=0;
   nxttout=-1.0;
 
   if(Ha->nstepmax<0&&Ha->tend<0.0)return;
 
 
-  //Calculate sizes for dispersal
+  //Calculate sizes for dispersal over a 2-D grid of processes
   MPI_Comm_size(MPI_COMM_WORLD,&size);
   MPI_Comm_rank(MPI_COMM_WORLD,&rank);
-  //if(rank==0)printf("Before loc size calcs\n");
-  counts=(int *)malloc(size*sizeof(int));
-  dspls=(int *)malloc(size*sizeof(int));
-  dspls[0]=0;
-  counts[0]=Hp->ny/size;
-  if((Hp->ny%size)!=0)counts[0]++;
-  counts[0]*=Hp->nx;
-  for(i=1;i<size;i++){
-    counts[i]=Hp->ny/size;
-    if((Hp->ny%size)>i)counts[i]++;
-    counts[i]*=Hp->nx;
-    dspls[i]=dspls[i-1]+counts[i-1];
-  }
-  myNy=counts[rank]/Hp->nx;
-  if(rank==0){
-    pProc=MPI_PROC_NULL;
+  chooseDims(dims);
+  MPI_Cart_create(MPI_COMM_WORLD,2,dims,periods,0,&cartComm);
+  MPI_Cart_shift(cartComm,0,1,&pProc,&nProc);
+  MPI_Cart_shift(cartComm,1,1,&lProc,&rProc);
+  getBlock(rank,&x0,&myNx,&y0,&myNy);
+  if(pProc==MPI_PROC_NULL){
     bndT=Hp->bndU;
   }else{
-    pProc=rank-1;
     bndT=BND_INT;
   }
-  if(rank==size-1){
-    nProc=MPI_PROC_NULL;
+  if(nProc==MPI_PROC_NULL){
     bndB=Hp->bndD;
   }else{
-    nProc=rank+1;
     bndB=BND_INT;
   }
-  
+  if(lProc==MPI_PROC_NULL){
+    bndLf=Hp->bndL;
+  }else{
+    bndLf=BND_INT;
+  }
+  if(rProc==MPI_PROC_NULL){
+    bndRt=Hp->bndR;
+  }else{
+    bndRt=BND_INT;
+  }
+  if(rank==0)printf("Process grid %d x %d\n",dims[1],dims[0]);
 
   //Calculate arraysizes
-  varSize=(Hp->nx+4)*(myNy+4);
-  if(myNy>=Hp->nx){
-    primSize=Hp->nvar*(Hp->nx+4)*myNy;
-    qSize   =Hp->nvar*(Hp->nx+2)*myNy;
-    flxSize =Hp->nvar*(Hp->nx+1)*myNy;
+  varSize=(myNx+4)*(myNy+4);
+  if(myNy>=myNx){
+    primSize=Hp->nvar*(myNy+4)*PENCIL_TILE;
+    qSize   =Hp->nvar*(myNy+2)*PENCIL_TILE;
+    flxSize =Hp->nvar*(myNy+1)*PENCIL_TILE;
   }else{
-    primSize=Hp->nvar*(myNy+4)*Hp->nx;
-    qSize   =Hp->nvar*(myNy+2)*Hp->nx;
-    flxSize =Hp->nvar*(myNy+1)*Hp->nx;
+    primSize=Hp->nvar*(myNx+4)*PENCIL_TILE;
+    qSize   =Hp->nvar*(myNx+2)*PENCIL_TILE;
+    flxSize =Hp->nvar*(myNx+1)*PENCIL_TILE;
   }
-  //if(rank==0)printf("Done loc size calcs\n");
+
+  //Two halo columns of every interior row, for all variables
+  MPI_Type_vector(myNy,2,myNx+4,MPI_DOUBLE,&col);
+  MPI_Type_create_hvector(Hp->nvar,1,varSize*sizeof(double),col,&colType);
+  MPI_Type_commit(&colType);
+  MPI_Type_free(&col);
+  //Two full halo rows, for all variables
+  MPI_Type_create_hvector(Hp->nvar,2*(myNx+4),varSize*sizeof(double),MPI_DOUBLE,&rowType);
+  MPI_Type_commit(&rowType);
+
+  //The ranks on a node share its cores, pinned before the block is touched
+  MPI_Comm_split_type(MPI_COMM_WORLD,MPI_COMM_TYPE_SHARED,rank,MPI_INFO_NULL,&node);
+  MPI_Comm_rank(node,&local);
+  MPI_Comm_size(node,&nlocal);
+  MPI_Comm_free(&node);
+  cody_pin(local,nlocal);
 
   //Allocate arrays
-  recvMesh=(double*)malloc(Hp->nvar*Hp->nx*myNy*sizeof(double));
-  lMesh =(double*)malloc(Hp->nvar*varSize*sizeof(double));
-  q  =(double*)malloc(primSize*sizeof(double));
-  qr =(double*)malloc(qSize*sizeof(double));
-  ql =(double*)malloc(qSize*sizeof(double));
-  flx=(double*)malloc(flxSize*sizeof(double));
+  lMesh =(double*)cody_alloc(Hp->nvar*varSize*sizeof(double),64,CODY_FIRST_TOUCH);
+  q  =(real*)cody_alloc(omp_get_max_threads()*primSize*sizeof(real),64,CODY_FIRST_TOUCH);
+  qr =(real*)cody_alloc(omp_get_max_threads()*qSize*sizeof(real),64,CODY_FIRST_TOUCH);
+  ql =(real*)cody_alloc(omp_get_max_threads()*qSize*sizeof(real),64,CODY_FIRST_TOUCH);
+  flx=(real*)cody_alloc(omp_get_max_threads()*flxSize*sizeof(real),64,CODY_FIRST_TOUCH);
+  edgT=(double*)cody_alloc(Hp->nvar*6*(myNx+4)*sizeof(double),64,CODY_FIRST_TOUCH);
+  edgB=(double*)cody_alloc(Hp->nvar*6*(myNx+4)*sizeof(double),64,CODY_FIRST_TOUCH);
+  visMesh=(double*)cody_alloc(Hp->nvar*myNx*myNy*sizeof(double),64,CODY_FIRST_TOUCH);
+  pLine.parts=(double*)malloc(5*size*sizeof(double));
+  pLine.pend=0;
 
   //if(rank==0)printf("Arrays allocated\n");
 
+  initHaloReqs(lMesh);
+
   //Zero lMesh
   for(i=0;i<Hp->nvar*varSize;i++){
     lMesh[i]=0.0;
   }
 
-  //distribute over processors
-  for(nV=0;nV<Hp->nvar;nV++){
-    mpi_err=MPI_Scatterv(gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,0,MPI_COMM_WORLD);
-    if(mpi_err!=MPI_SUCCESS){
-      printf("Error scattering data to other processors\n");
-    }
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)]=recvMesh[i+Hp->nx*(j+myNy*nV)];
-    }
+  //Each rank reads its block straight from a restart file or sets up the
+  //initial condition of its block only, so no rank holds the global mesh
+  if(Ha->initFile[0]){
+    if(readRestartBlock(Ha->initFile,lMesh,Hp,x0,myNx,y0,myNy))MPI_Abort(MPI_COMM_WORLD,1);
+  }else{
+    initBlock(lMesh+2+2*(myNx+4),myNx+4,varSize,Hp,Ha,x0,myNx,y0,myNy);
   }
 
   MPI_Barrier(MPI_COMM_WORLD);
   //sprintf(outLab,"Loc mesh n %d",rank);
-  //printArray(outLab,lMesh,4,Hp->nx+4,myNy+4);
+  //printArray(outLab,lMesh,4,myNx+4,myNy+4);
 
-  if(rank==0)printf("Initial conditions distributed\n");
+  if(rank==0)printf("Initial conditions set up\n");
 
   if(Ha->tend>0.0){
     nxttout=Ha->tend;
@@ -673,69 +1103,78 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   }
 
   volCell=Hp->dx*Hp->dy;
-  oTM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
-  oTE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
+  oTM=sumArray(lMesh,VARRHO,myNx,myNy,2,2);
+  oTE=sumArray(lMesh,VARPR ,myNx,myNy,2,2);
 #ifdef M_PREC_CMP
   frexp(oTM,&M_exp);
   frexp(oTE,&E_exp);
 
-  M_prec=ldexp(DBL_EPSILON,M_exp-1);
-  E_prec=ldexp(DBL_EPSILON,E_exp-1);
+  M_prec=ldexp(REAL_EPSILON,M_exp-1);
+  E_prec=ldexp(REAL_EPSILON,E_exp-1);
 
   if(rank==0)printf("TM:%g+-%g TE:%g+-%g\n",volCell*oTM,volCell*M_prec,volCell*oTE,volCell*E_prec);
 #endif
 
   //Print initial condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
-  if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-    printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
-  }
+  writeOutput(lMesh,n);
+  if(rank==0)printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
   
+  initTiming(&Ht,"MPI/OMP" REAL_TAG,"CPU",size,omp_get_max_threads());
   initT=MPI_Wtime();
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
     //Calculate timestep
-    dt=Ha->sigma*calcDT(lMesh);
+    PH_START(tPh);
+    //The last pass of the previous step found this rank's CFL denominator,
+    //unless this is the first step
+    if(den>0.0){
+      dt=Ha->sigma*globalDT(den);
+    }else{
+      dt=Ha->sigma*calcDT(lMesh);
+    }
+    PH_ADD(Ht.phase,PH_DT,tPh);
     if(nxttout>0.0&&dt>(nxttout-cTime)){
       if(rank==0)printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
       dt=(nxttout-cTime);
     }
-    if(n%2==0){
+    //The last pass of a step that prints a progress line also gathers this
+    //rank's diagnostics, so they cost no extra sweep over the mesh
+    dg=NULL;
+    if((n+1)%Ha->nprtLine==0){
+      memset(&diag,0,sizeof(diag));
+      dg=&diag;
+    }
+    if((Hp->nstep+n)%2==0){
       //X Dir
-      runPass(lMesh,dt,n,0);
+      runPass(lMesh,dt,n,0,0,NULL);
       //Y Dir
-      runPass(lMesh,dt,n,1);
+      den=runPass(lMesh,dt,n,1,FUSE_DT,dg);
     }else{
       //Y Dir
-      runPass(lMesh,dt,n,1);
+      runPass(lMesh,dt,n,1,0,NULL);
       //X Dir
-      runPass(lMesh,dt,n,0);
+      den=runPass(lMesh,dt,n,0,FUSE_DT,dg);
     }
     n+=1;
     cTime+=dt;
-    if(n%Ha->nprtLine==0){
-      TM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
-      TE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
+    PH_START(tPh);
+    //The line of the step before was gathered while this step ran, so
+    //progress lines are printed one step late and never stall the ranks
+    if(finishDiag(&pLine,&TM,&TE,&nans)){
       if(rank==0){
-	printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+	printf("Iter %05d time %f dt %g TM: %g TE: %g\n",pLine.n,pLine.t,pLine.dt,volCell*TM,volCell*TE);
+	if(nans)printf("Iter %05d: %d cells hold NaN or Inf\n",pLine.n,nans);
 	if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
 	  printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(TM-oTM),volCell*(TE-oTE));
 	  printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(TM-oTM)/oTM,100.0*(TE-oTE)/oTE);
+	}
 #ifdef M_PREC_CMP
-	  printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
+	//Conservation drift in units of the kernel precision
+	printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
 #endif
-	}
       }
     }
+    if(dg)postDiag(&pLine,dg,n,cTime,dt);
     if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
       if(rank==0)printf("Vis file @ time %f iter %d\n",cTime,n);
       if(cTime>=nxttout&&nxttout>0.0){
@@ -743,53 +1182,57 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	//if(rank==0)printf("Next Vis Time: %f\n",nxttout);
       }
-      for(nV=0;nV<Hp->nvar;nV++){
-	for(lI=0;lI<Hp->nx*myNy;lI++){
-	  i=lI%(Hp->nx);
-	  j=lI/(Hp->nx);
-	  recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-	}
-	MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-      }
-      if(rank==0){
-	snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-	writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-	}
+      writeOutput(lMesh,n);
     }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+  }
+  //The last progress line is still in flight
+  if(finishDiag(&pLine,&TM,&TE,&nans)&&rank==0){
+    printf("Iter %05d time %f dt %g TM: %g TE: %g\n",pLine.n,pLine.t,pLine.dt,volCell*TM,volCell*TE);
+    if(nans)printf("Iter %05d: %d cells hold NaN or Inf\n",pLine.n,nans);
   }
   if(rank==0)printf("time: %f, %d iters run\n",cTime,n);
 
   endT=MPI_Wtime();
 
+  reduceTiming(&Ht);
   if(rank==0){
-    printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"MPI/OMP\"","\"CPU:?\"","\"Init\"",size,omp_get_max_threads(),n,Hp->nx*Hp->ny,(endT-initT));
+    Ht.niters=n;
+    Ht.ncells=Hp->nx*Hp->ny;
+    Ht.runt=endT-initT;
+    printTiming(&Ht,Ha);
   }
 
   //Print final condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
-  if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-  }
+  writeOutput(lMesh,n);
+  waitVis();
   Hp->t+=cTime;
-
-  free(recvMesh);
-  free(lMesh);
-  free(q  );
-  free(qr );
-  free(ql );
-  free(flx);
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestartBlock(Ha->chkFile,lMesh,Hp,x0,myNx,y0,myNy);
+
+  cody_free(visMesh);
+  free(pLine.parts);
+  cody_free(lMesh);
+  for(i=0;i<4;i++){
+    MPI_Request_free(hReqs+i);
+    MPI_Request_free(vReqs+i);
+  }
+  MPI_Type_free(&colType);
+  MPI_Type_free(&rowType);
+  MPI_Comm_free(&cartComm);
+  cody_free(q  );
+  cody_free(qr );
+  cody_free(ql );
+  cody_free(flx);
+  cody_free(edgT);
+  cody_free(edgB);
 
   printf("NODE %d: Finalizing MPI\n",rank);
   MPI_Finalize();
 
   printf("N %d: Returning from engine\n",rank);
 }
+
+//Nothing is kept between engine calls
+void freeScratch(){
+}
@@ -13,4 +13,29 @@
 #define BND_PERM 1
 #define BND_INT 2
 
+//Number of pencils runPass sweeps at once; 8 columns fill a cache
+//line in the y pass
+#ifndef PENCIL_TILE
+#define PENCIL_TILE 8
+#endif
+
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//sweep over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+//The y pass runs as OpenMP tasks: one task exchanges the halo rows while
+//the others sweep the tiles that do not need them, and the edge tiles
+//start as soon as the halo is in. Define BULK_SYNC_HALO to exchange the
+//halo from the master thread between parallel sweeps instead
+#ifdef BULK_SYNC_HALO
+#define TASK_HALO 0
+#else
+#define TASK_HALO 1
+#endif
+
 #endif //HYDRO_DEFS_H_
@@ -2,38 +2,28 @@
 #include <stdlib.h>
 #include <math.h>
 //#include <openacc.h>
-#include <time.h>
-#include <sys/time.h>
 #include "hydro.h"
+#include "restart.h"
+#include "outfile.h"
+#include "timing.h"
 #include "float.h"
+#include "riemann_approx.h"
 
 hydro_args *Ha;
 hydro_prob *Hp;
+hydro_timing Ht;
 int nx, ny;
 double *q;
 double *qr, *ql;
 double *flx;
+//CFL denominator found by the last flux update, see addFluxX
+double fluxDen;
 
 size_t meshSize, primSize, qSize, flxSize;
 
 
 double slope(double *q,int ind);
 
-//Utility function to get wall runtime
-double getNow(){
-  struct timeval tv;
-  struct timezone tz;
-  double t;
-
-  gettimeofday(&tv, &tz);
-
-  t = (double)tv.tv_sec;
-  t += ((double)tv.tv_usec)/1000000.0;
-
-  return t;
-}
-
-
 static inline void printArray(char* label,double *arr, int nvar, int nx, int ny, int nHx, int nHy){
 #if 0
   int nV,i,j;
@@ -73,8 +63,8 @@ double calcDT(double *mesh){
   smallr=Ha->smallr;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma acc kernels pcopyin(mesh[0:meshSize]) copyin(smallp,smallr,gamma,nx,ny,dx,dy)
-#pragma acc loop independent reduction(max:max_denom) private(r,vx,vy,eint,p,c,cx,cy,denom) 
+#pragma acc parallel loop present(mesh[0:meshSize]) firstprivate(nx,ny) async(ACC_Q)\
+  reduction(max:max_denom) private(r,vx,vy,eint,p,c,cx,cy,denom)
   for(i=0; i<nx*ny; i++){
     r   =fmax(mesh[i+nx*ny*VARRHO],smallr);
     vx  =     mesh[i+nx*ny*VARVX ]/r;
@@ -88,6 +78,7 @@ double calcDT(double *mesh){
     denom=cx+cy;
     max_denom=fmax(denom,max_denom);
   }
+#pragma acc wait(ACC_Q)
   return 0.5/max_denom;
 }
 
@@ -101,11 +92,8 @@ void toPrimX(double *q, double *mesh){
   smallr=Ha->smallr;
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
 
-#pragma acc kernels \
-  pcopyin(mesh[0:meshSize])\
-  pcopyout(q[0:primSize])\
-  copyin(nx,ny,gamma,smallr,smallp)
-#pragma acc loop independent private(i,xI,yI,r,vx,vy,eint,p)
+#pragma acc parallel loop present(mesh[0:meshSize],q[0:primSize])\
+  firstprivate(nx,ny) async(ACC_Q) private(xI,yI,r,vx,vy,eint,p)
   for(i=0;i<ny*nx;i++){
     xI=i%nx;
     yI=i/nx;
@@ -131,10 +119,8 @@ void toPrimY(double *q, double *mesh){
   smallr=Ha->smallr;
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
 
-#pragma acc kernels pcopyin(mesh[0:meshSize])\
-  pcopyout(q[0:primSize])\
-  copyin(gamma,smallr,smallp)
-#pragma acc loop independent private(xI,yI,r,vx,vy,eint,p)
+#pragma acc parallel loop present(mesh[0:meshSize],q[0:primSize])\
+  firstprivate(nx,ny) async(ACC_Q) private(xI,yI,r,vx,vy,eint,p)
   for(i=0;i<ny*nx;i++){
     xI=i%nx;
     yI=i/nx;
@@ -158,9 +144,8 @@ void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
 
   //printf("Running bnd cnds for %dx%d prims\n",np,nt);
 
-#pragma acc kernels \
-  pcopy(q[0:primSize])
-#pragma acc loop independent private(pI,tI,wInd,rInd)
+#pragma acc parallel loop present(q[0:primSize]) async(ACC_Q)\
+  private(pI,tI,wInd,rInd)
   for(i=0;i<2*nt;i++){
     pI=i%2;
     tI=i/2;
@@ -209,8 +194,9 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
 
   gamma=Hp->gamma;
 
-#pragma acc kernels pcopyin(q[0:primSize]) pcopyout(qr[0:qSize],ql[0:qSize]) copyin(gamma,dtdx,np,nt)
-#pragma acc loop independent private(i,j,r,u,v1,p,csq,cc,dr,du,dv1,dp,ap,am,azr,azv1,acmp)
+#pragma acc parallel loop present(q[0:primSize],qr[0:qSize],ql[0:qSize]) async(ACC_Q)\
+  private(i,j,r,u,v1,p,csq,cc,dr,du,dv1,dp,ap,am,azr,azv1,acmp)\
+  private(dlft,drgt,dcen,dlim,alpham,alphap,alphazr,spplus,spzerol,spzeror,spminus)
   for(lI=0;lI<(np+2)*nt;lI++){
     i=lI%(np+2);
     j=lI/(np+2);
@@ -302,9 +288,10 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   double sgnm, scr, frac;
   double spout,spin,ushk;
   double ekin,etot,delp;
-  int niter_riemann;
+  int niter_riemann, scheme;
 
   niter_riemann=Ha->niter_riemann;
+  scheme=Ha->scheme;
   gamma=Hp->gamma;
   smallr=Ha->smallr;
   smallc=Ha->smallc;
@@ -313,8 +300,10 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
   entho=1.0/(Hp->gamma-1.0);
 
-#pragma acc kernels pcopyin(qxm[0:qSize],qxp[0:qSize]) pcopyout(flx[0:flxSize]) pcopyin(np,nt,gamma,smallr,smallc,smallp,smallpp,gmma6,entho)
-#pragma acc loop independent
+#pragma acc parallel loop present(qxm[0:qSize],qxp[0:qSize],flx[0:flxSize]) async(ACC_Q)\
+  private(i,j,n,qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,rl,vxl,vyl,pl,cl,wl,ql,vsl)\
+  private(rr,vxr,vyr,pr,cr,wr,qr,vsr,ro,vxo,po,wo,co,rx,vxx,px,wx,cx)\
+  private(sgnm,scr,frac,spout,spin,ushk,ekin,etot,delp)
   for(lI=0;lI<(np+1)*nt;lI++){
     i=lI%(np+1);
     j=lI/(np+1);
@@ -328,6 +317,16 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
     vxr=    qxp[i+1+(np+2)*(j+nt*VARVX )];
     vyr=    qxp[i+1+(np+2)*(j+nt*VARVY )];
     pr =MAX(qxp[i+1+(np+2)*(j+nt*VARPR )],rr*smallp);
+
+    //The approximate solvers of Ha->scheme, see riemann_approx.h
+    if(scheme==SCHEME_HLLC){
+      hllcFlux(gamma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,flx+i+(np+1)*j,(np+1)*nt);
+      continue;
+    }
+    if(scheme==SCHEME_HLL){
+      hllFlux(gamma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,flx+i+(np+1)*j,(np+1)*nt);
+      continue;
+    }
     
     cl=gamma*pl*rl;
     cr=gamma*pr*rr;
@@ -410,11 +409,27 @@ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
-void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
+//If cdt is set, also leave the CFL denominator of the updated cells in
+//fluxDen, found in the same kernel so the mesh is not read again for the
+//next timestep. It is only valid once the queue has been waited on
+void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt, int cdt){
   int lI, i, j;
+  double r,vx,vy,eint,p;
+  double c,cx,cy;
+  double smallp,smallr;
+  double gamma;
+  double dx,dy;
+  double denom;
 
-#pragma acc kernels pcopy(mesh[0:meshSize]) pcopyin(flx[0:flxSize]) pcopyin(dtdx,np,nt)
-#pragma acc loop independent
+  fluxDen=0.0;
+  gamma=Hp->gamma;
+  dx=Hp->dx;
+  dy=Hp->dy;
+  smallr=Ha->smallr;
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+
+#pragma acc parallel loop present(mesh[0:meshSize],flx[0:flxSize]) async(ACC_Q)\
+  reduction(max:fluxDen) private(i,j,r,vx,vy,eint,p,c,cx,cy,denom)
   for(lI=0;lI<np*nt;lI++){
     i=lI%np;
     j=lI/np;
@@ -426,14 +441,42 @@ void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
 				    flx[i+1+(np+1)*(j+nt*VARVY )]);
     mesh[i+np*(j+nt*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
 				    flx[i+1+(np+1)*(j+nt*VARPR )]);
+    if(cdt){
+      r   =fmax(mesh[i+np*(j+nt*VARRHO)],smallr);
+      vx  =     mesh[i+np*(j+nt*VARVX )]/r;
+      vy  =     mesh[i+np*(j+nt*VARVY )]/r;
+      eint=     mesh[i+np*(j+nt*VARPR )]-0.5*r*(vx*vx+vy*vy);
+      p   =fmax((gamma-1.0)*eint,r*smallp);
+      c=sqrt((gamma*p/r));
+      cx=(c+fabs(vx))/dx;
+      cy=(c+fabs(vy))/dy;
+      denom=cx+cy;
+      fluxDen=fmax(denom,fluxDen);
+    }
   }
 }
 
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+//If cdt is set, also leave the CFL denominator of the updated cells in
+//fluxDen, found in the same kernel so the mesh is not read again for the
+//next timestep. It is only valid once the queue has been waited on
+void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt, int cdt){
   int lI, i, j;
+  double r,vx,vy,eint,p;
+  double c,cx,cy;
+  double smallp,smallr;
+  double gamma;
+  double dx,dy;
+  double denom;
 
-#pragma acc kernels pcopy(mesh[0:meshSize]) pcopyin(flx[0:flxSize]) pcopyin(dtdx,np,nt)
-#pragma acc loop independent
+  fluxDen=0.0;
+  gamma=Hp->gamma;
+  dx=Hp->dx;
+  dy=Hp->dy;
+  smallr=Ha->smallr;
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+
+#pragma acc parallel loop present(mesh[0:meshSize],flx[0:flxSize]) async(ACC_Q)\
+  reduction(max:fluxDen) private(i,j,r,vx,vy,eint,p,c,cx,cy,denom)
   for(lI=0;lI<np*nt;lI++){
     i=lI%np;
     j=lI/np;
@@ -445,6 +488,18 @@ void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
 				    flx[i+1+(np+1)*(j+nt*VARVX )]);
     mesh[j+nt*(i+np*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
 				    flx[i+1+(np+1)*(j+nt*VARPR )]);
+    if(cdt){
+      r   =fmax(mesh[j+nt*(i+np*VARRHO)],smallr);
+      vx  =     mesh[j+nt*(i+np*VARVX )]/r;
+      vy  =     mesh[j+nt*(i+np*VARVY )]/r;
+      eint=     mesh[j+nt*(i+np*VARPR )]-0.5*r*(vx*vx+vy*vy);
+      p   =fmax((gamma-1.0)*eint,r*smallp);
+      c=sqrt((gamma*p/r));
+      cx=(c+fabs(vx))/dx;
+      cy=(c+fabs(vy))/dy;
+      denom=cx+cy;
+      fluxDen=fmax(denom,fluxDen);
+    }
   }
 }
 
@@ -476,27 +531,63 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 } 
 
+void neumaierAdd(double *sum, double *corr, double v){
+  double t;
+
+  t=*sum+v;
+  if(fabs(*sum)>=fabs(v)){
+    *corr+=(*sum-t)+v;
+  }else{
+    *corr+=(v-t)+*sum;
+  }
+  *sum=t;
+}
+
 double sumArray(double *mesh, int var, int nx, int ny){
-  int i;
+  int i, j;
   double sum, corr;
-  double nsum, c_nxt;
+  double rsum, rcorr, t, c_nxt;
+  double *rowSum, *rowCorr;
+
+  rowSum =(double*)malloc(ny*sizeof(double));
+  rowCorr=(double*)malloc(ny*sizeof(double));
+
+  //Compensated sum of each row on the device, rows combined on the host
+#pragma acc parallel loop present(mesh[0:meshSize]) copyout(rowSum[0:ny],rowCorr[0:ny])\
+  async(ACC_Q) private(i,rsum,rcorr,t,c_nxt)
+  for(j=0;j<ny;j++){
+    rsum=0.0;
+    rcorr=0.0;
+#pragma acc loop seq
+    for(i=0;i<nx;i++){
+      c_nxt=mesh[i+nx*(j+ny*var)];
+      t=rsum+c_nxt;
+      if(fabs(rsum)>=fabs(c_nxt)){
+	rcorr+=(rsum-t)+c_nxt;
+      }else{
+	rcorr+=(c_nxt-t)+rsum;
+      }
+      rsum=t;
+    }
+    rowSum[j]=rsum;
+    rowCorr[j]=rcorr;
+  }
+#pragma acc wait(ACC_Q)
 
   sum=0.0;
   corr=0.0;
-
-#pragma acc kernels \
-  pcopyin(mesh[0:meshSize])
-#pragma acc loop independent reduction(+:sum,corr)
-  for(i=0;i<nx*ny;i++){
-    c_nxt=mesh[i+nx*ny*var];
-    nsum=sum+c_nxt;
-    corr=(nsum-sum)-c_nxt;
-    sum=nsum;
+  for(j=0;j<ny;j++){
+    neumaierAdd(&sum,&corr,rowSum[j]);
+    corr+=rowCorr[j];
   }
+  free(rowSum);
+  free(rowCorr);
   return sum+corr;
 }
 
-void runPass(double *mesh, double dt, int n, int dir){
+//Queue the kernels of the pass in direction dir. If cdt is set, the flux
+//update also finds the CFL denominator of the updated mesh
+void runPass(double *mesh, double dt, int n, int dir, int cdt){
   int bndL,bndH;
   int np,nt;
   double dx,dy;
@@ -556,9 +647,9 @@ void runPass(double *mesh, double dt, int n, int dir){
   //printArray("FLX :",flx,4,np+1,nt,0,0);
   //printf("FLX: %d %d %d %d\n",nanList[0],nanList[1],nanList[2],nanList[3]);
   if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    addFluxX(mesh,flx,dt/dx,np,nt,cdt);
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    addFluxY(mesh,flx,dt/dx,np,nt,cdt);
   }
   //printf("Flx added\n");
   //#pragma acc update host(mesh[0:meshSize])
@@ -567,10 +658,11 @@ void runPass(double *mesh, double dt, int n, int dir){
   //printf("Post-pass mesh: %d %d %d %d\n",nanList[1],nanList[1],nanList[2],nanList[3]);
 }
 
-void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
+void engine(int *argc, char **argv[], double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, i,j;
   int bndL;
   int bndH;
+  int ph;
   double dt;
   double cTime, nxttout;
 
@@ -583,6 +675,7 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   char outfile[30];
 
   double initT, endT;
+  double tPh;
 
   Hp=Hyp;
   Ha=Hya;
@@ -622,6 +715,11 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
     nxttout=Ha->dtoutput;
   }
 
+  //The mesh and the pass scratch stay on the device for the whole run. Every
+  //kernel is queued on ACC_Q and the host only waits for the timestep
+  //reduction, the conservation sums and the output
+#pragma acc enter data copyin(mesh[0:meshSize]) create(q[0:primSize],qr[0:qSize],ql[0:qSize],flx[0:flxSize])
+
   volCell=Hp->dx*Hp->dy;
   oTM=sumArray(mesh,VARRHO,Hp->nx,Hp->ny);
   oTE=sumArray(mesh,VARPR ,Hp->nx,Hp->ny);
@@ -636,76 +734,102 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 #endif
 
   //Print initial condition
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
   printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
   
-  initT=getNow();
-
-#pragma acc data copy(mesh[0:meshSize]) create(q[0:primSize],qr[0:qSize],ql[0:qSize],flx[0:flxSize])
-  {
-    while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
-      //Calculate timestep
-      //printf("Timestep calculation\n");
+  //The passes only queue their kernels, so only the output is timed on
+  //its own
+  initTiming(&Ht,"OAC","GPU",1,1);
+  for(ph=0;ph<NPHASE;ph++){
+    if(ph!=PH_OUTPUT)Ht.phase[ph]=-1.0;
+  }
+  initT=wallNow();
+
+  while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
+    //Calculate timestep
+    //printf("Timestep calculation\n");
+    //The last pass of the previous step found the CFL denominator,
+    //unless this is the first step
+    if(FUSE_DT&&n>0){
+#pragma acc wait(ACC_Q)
+      dt=Ha->sigma*(0.5/fmax(fluxDen,Ha->smallc));
+    }else{
       dt=Ha->sigma*calcDT(mesh);
-      //printf("DT=%g\n",dt);
-      if(nxttout>0.0&&dt>(nxttout-cTime)){
-	printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
-	dt=(nxttout-cTime);
-      }
-      if(n%2==0){
-	//X Dir
-	runPass(mesh,dt,n,0);
-	//Y Dir
-	runPass(mesh,dt,n,1);
-      }else{
-	//Y Dir
-	runPass(mesh,dt,n,1);
-	//X Dir
-	runPass(mesh,dt,n,0);
-      }
-      n+=1;
-      cTime+=dt;
-      if(n%Ha->nprtLine==0){
-	TM=sumArray(mesh,VARRHO,Hp->nx,Hp->ny);
-	TE=sumArray(mesh,VARPR ,Hp->nx,Hp->ny);
-	printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
-	if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
-	  printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(TM-oTM),volCell*(TE-oTE));
-	  printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(TM-oTM)/oTM,100.0*(TE-oTE)/oTE);
+    }
+    //printf("DT=%g\n",dt);
+    if(nxttout>0.0&&dt>(nxttout-cTime)){
+      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+      dt=(nxttout-cTime);
+    }
+    if((Hp->nstep+n)%2==0){
+      //X Dir
+      runPass(mesh,dt,n,0,0);
+      //Y Dir
+      runPass(mesh,dt,n,1,FUSE_DT);
+    }else{
+      //Y Dir
+      runPass(mesh,dt,n,1,0);
+      //X Dir
+      runPass(mesh,dt,n,0,FUSE_DT);
+    }
+    n+=1;
+    cTime+=dt;
+    PH_START(tPh);
+    if(n%Ha->nprtLine==0){
+      TM=sumArray(mesh,VARRHO,Hp->nx,Hp->ny);
+      TE=sumArray(mesh,VARPR ,Hp->nx,Hp->ny);
+      printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+      if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
+	printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(TM-oTM),volCell*(TE-oTE));
+	printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(TM-oTM)/oTM,100.0*(TE-oTE)/oTE);
 #ifdef M_PREC_CMP
-	  printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
+	printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
 #endif
-	}
       }
-      if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
-	printf("Vis file @ time %f iter %d\n",cTime,n);
-	if(cTime>=nxttout&&nxttout>0.0){
-	  nxttout+=Ha->dtoutput;
-	  if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
-	  //printf("Next Vis Time: %f\n",nxttout);
-	}
-        //#pragma acc update host(mesh[0:meshSize])
-	snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-	writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-        printf("Vis. file \"%s\" written.\n",outfile);
+    }
+    if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(cTime>=nxttout&&nxttout>0.0){
+	nxttout+=Ha->dtoutput;
+	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
+	//printf("Next Vis Time: %f\n",nxttout);
       }
+#pragma acc update host(mesh[0:meshSize]) async(ACC_Q)
+#pragma acc wait(ACC_Q)
+      snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+      writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+      printf("Vis. file \"%s\" written.\n",outfile);
     }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
   }
+#pragma acc wait(ACC_Q)
+#pragma acc exit data copyout(mesh[0:meshSize]) delete(q[0:primSize],qr[0:qSize],ql[0:qSize],flx[0:flxSize])
   printf("time: %f, %d iters run\n",cTime,n);
 
-  endT=getNow();
+  endT=wallNow();
+
+  Ht.niters=n;
+  Ht.ncells=Hp->nx*Hp->ny;
+  Ht.runt=endT-initT;
+  printTiming(&Ht,Ha);
 
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"OAC\"","\"GPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,endT-initT);
+  //The last snapshot may share the final condition's name
+  waitVis();
 
   //Print final condition
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
   writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
 
   Hp->t+=cTime;
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestart(Ha->chkFile,mesh,Hp);
   free(q  );
   free(qr );
   free(ql );
   free(flx);
 }
+
+//Nothing is kept between engine calls
+void freeScratch(){
+}
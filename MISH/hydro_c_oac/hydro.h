@@ -3,8 +3,6 @@
 
 #include "hydro_struct.h"
 #include "hydro_defs.h"
-
-void engine(double *mesh, hydro_prob *Hp, hydro_args *Ha);
-
+#include "engine.h"
 
 #endif //HYDRO_H_
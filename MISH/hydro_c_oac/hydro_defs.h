@@ -12,4 +12,17 @@
 #define BND_REFL 0
 #define BND_PERM 1
 
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//kernel over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+//OpenACC async queue every kernel and device copy is launched on, so the
+//host only blocks where it needs a result
+#define ACC_Q 1
+
 #endif //HYDRO_DEFS_H_
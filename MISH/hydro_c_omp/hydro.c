@@ -1,18 +1,67 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
 #include <time.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 #include "hydro.h"
+#include "restart.h"
+#include "outfile.h"
+#include "timing.h"
 #include "float.h"
+#include "riemann_approx.h"
+#include "cody.h"
 
 hydro_args *Ha;
 hydro_prob *Hp;
-double *q;
-double *qr, *ql;
-double *flx;
+hydro_timing Ht;
+//Each member of a batch runs on its own thread with its own problem, so
+//the parallel regions of a pass copy the problem in from the thread that
+//starts them
+#pragma omp threadprivate(Ha,Hp,Ht)
+real *q;
+real *qr, *ql;
+real *flx;
+size_t primSize, qSize, flxSize;
+
+//Scratch arena for the q, qr, ql and flx tiles, one page aligned slice
+//per thread. It outlives engine so repeated runs reuse the faulted pages
+#ifdef MADV_HUGEPAGE
+#define SCR_PAGE (2*1024*1024)
+#else
+#define SCR_PAGE 4096
+#endif
+#define SCR_ALIGN 64
+#define SCR_PAD(n,a) ((((n)+(a)-1)/(a))*(a))
+real *scr=NULL;
+size_t scrSlice=0;
+int scrTh=0;
 
-double slope(double *q,int ind);
+//Arena slice, tblk slice and diagnostics partial of the calling thread. A
+//batch member runs its passes in an inactive nested region on one thread
+//of the batch team, whose slice it uses
+static inline int scrSlot(){
+  return (omp_get_level()>1)?omp_get_ancestor_thread_num(1):omp_get_thread_num();
+}
+//Cell p of pencil t of a block of conserved variables is b[p*ps+t*ts],
+//and each variable is vs further on
+typedef struct {
+  double *b;
+  int ps, ts, vs;
+} blk_view;
+
+//Mass and energy sums with their Neumaier corrections, and the number of
+//cells holding a NaN or Inf, gathered tile by tile by the last pass of a
+//step that prints a progress line
+typedef struct {
+  double sum[2], corr[2];
+  int nans;
+} mesh_diag;
+
+real slope(real *q,int ind,int s);
 
 void printArray(char* label,double *arr, int nvar, int nx, int ny){
   int nV,i,j;
@@ -27,14 +76,15 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny){
     for(j=0;j<ny;j++){
       printf("%3d",j);
       for(i=0;i<nx;i++){
-	printf("|%10g",arr[i+nx*(j+ny*nV)]);
+	printf("|%10g",arr[MESH_IDX(nV,i+nx*j,nx*ny)]);
       }
       printf("|\n");
     }
   }
 }
 
-double calcDT(double *mesh){
+//Max CFL denominator over the n cells of mesh from cell c0, at least smallc
+double cellsDenom(double *mesh, int c0, int n){
   int i;
   double denom, max_denom;
   double r,vx,vy,eint,p;
@@ -45,11 +95,11 @@ double calcDT(double *mesh){
   max_denom=Ha->smallc;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-  for (i=0; i<Hp->nx*Hp->ny; i++){
-    r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
-    vx  =    mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
-    vy  =    mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
-    eint=    mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for (i=c0; i<c0+n; i++){
+    r   =MAX(mesh[MESH_IDX(VARRHO,i,Hp->nx*Hp->ny)],Ha->smallr);
+    vx  =    mesh[MESH_IDX(VARVX ,i,Hp->nx*Hp->ny)]/r;
+    vy  =    mesh[MESH_IDX(VARVY ,i,Hp->nx*Hp->ny)]/r;
+    eint=    mesh[MESH_IDX(VARPR ,i,Hp->nx*Hp->ny)]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1.0)*eint,r*smallp);
     
     c=sqrt((Hp->gamma*p/r));
@@ -58,68 +108,145 @@ double calcDT(double *mesh){
     denom=cx+cy;
     if(max_denom<denom)max_denom=denom;
   }
-  return 0.5/max_denom;
+  return max_denom;
 }
 
-void toPrimX(double *q, double *mesh){
-  int i;
+//Function to calculate timestep
+double calcDT(double *mesh){
+  return 0.5/cellsDenom(mesh,0,Hp->nx*Hp->ny);
+}
+
+//Max CFL denominator of the cells of tile t0 to t0+tn-1 of a pass in
+//direction dir, straight after its flux update while it is in cache
+double tileDenom(double *mesh, int dir, int t0, int tn){
+  int j;
+  double den, rDen;
+
+  if(dir==0)return cellsDenom(mesh,Hp->nx*t0,Hp->nx*tn);
+  den=Ha->smallc;
+  for(j=0;j<Hp->ny;j++){
+    rDen=cellsDenom(mesh,t0+Hp->nx*j,tn);
+    den=MAX(den,rDen);
+  }
+  return den;
+}
+
+void toPrimX(real *q, double *mesh, int t0, int tn){
+  int i, lI;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp)
-  for(i=0;i<Hp->ny*Hp->nx;i++){
-    xI=i%Hp->nx;
-    yI=i/Hp->nx;
-    r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
-    vx  =mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
-    vy  =mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
-    eint=mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for(lI=0;lI<tn*Hp->nx;lI++){
+    xI=lI%Hp->nx;
+    yI=lI/Hp->nx;
+    i=xI+Hp->nx*(yI+t0);
+    r   =MAX(mesh[MESH_IDX(VARRHO,i,Hp->nx*Hp->ny)],Ha->smallr);
+    vx  =mesh[MESH_IDX(VARVX ,i,Hp->nx*Hp->ny)]/r;
+    vy  =mesh[MESH_IDX(VARVY ,i,Hp->nx*Hp->ny)]/r;
+    eint=mesh[MESH_IDX(VARPR ,i,Hp->nx*Hp->ny)]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,smallp);
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARRHO)]=r;
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARVX )]=vx;
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARVY )]=vy;
-    q[xI+2+(Hp->nx+4)*(yI+Hp->ny*VARPR )]=p;
+    q[xI+2+(Hp->nx+4)*(yI+tn*VARRHO)]=r;
+    q[xI+2+(Hp->nx+4)*(yI+tn*VARVX )]=vx;
+    q[xI+2+(Hp->nx+4)*(yI+tn*VARVY )]=vy;
+    q[xI+2+(Hp->nx+4)*(yI+tn*VARPR )]=p;
   }
 }
 
-void toPrimY(double *q, double *mesh){
-  int i;
+void toPrimY(real *q, double *mesh, int t0, int tn){
+  int i, lI;
+  int xI, yI;
+  double r,vx,vy,eint,p;
+  double smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  for(lI=0;lI<Hp->ny*tn;lI++){
+    xI=lI%tn;
+    yI=lI/tn;
+    i=xI+t0+Hp->nx*yI;
+    r   =MAX(mesh[MESH_IDX(VARRHO,i,Hp->nx*Hp->ny)],Ha->smallr);
+    vx  =mesh[MESH_IDX(VARVX ,i,Hp->nx*Hp->ny)]/r;
+    vy  =mesh[MESH_IDX(VARVY ,i,Hp->nx*Hp->ny)]/r;
+    eint=mesh[MESH_IDX(VARPR ,i,Hp->nx*Hp->ny)]-0.5*r*(vx*vx+vy*vy);
+    p   =MAX((Hp->gamma-1)*r*eint,r*smallp);
+    q[yI+2+(Hp->ny+4)*(xI+tn*VARRHO)]=r;
+    q[yI+2+(Hp->ny+4)*(xI+tn*VARVX )]=vy;
+    q[yI+2+(Hp->ny+4)*(xI+tn*VARVY )]=vx;
+    q[yI+2+(Hp->ny+4)*(xI+tn*VARPR )]=p;
+  }
+}
+
+//As toPrimY, but keeping the columns interleaved as in the mesh:
+//q[xI+tn*(yI+2+(ny+4)*VAR)]
+void toPrimYN(real *q, double *mesh, int t0, int tn){
+  int i, lI;
   int xI, yI;
   double r,vx,vy,eint,p;
   double smallp;
 
   smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-#pragma omp parallel for private(xI,yI,r,vx,vy,eint,p) shared(q,mesh,smallp,Ha,Hp)
-  for(i=0;i<Hp->ny*Hp->nx;i++){
-    xI=i%Hp->nx;
-    yI=i/Hp->nx;
-    r   =MAX(mesh[i+Hp->nx*Hp->ny*VARRHO],Ha->smallr);
-    vx  =mesh[i+Hp->nx*Hp->ny*VARVX ]/r;
-    vy  =mesh[i+Hp->nx*Hp->ny*VARVY ]/r;
-    eint=mesh[i+Hp->nx*Hp->ny*VARPR ]-0.5*r*(vx*vx+vy*vy);
+  for(lI=0;lI<Hp->ny*tn;lI++){
+    xI=lI%tn;
+    yI=lI/tn;
+    i=xI+t0+Hp->nx*yI;
+    r   =MAX(mesh[MESH_IDX(VARRHO,i,Hp->nx*Hp->ny)],Ha->smallr);
+    vx  =mesh[MESH_IDX(VARVX ,i,Hp->nx*Hp->ny)]/r;
+    vy  =mesh[MESH_IDX(VARVY ,i,Hp->nx*Hp->ny)]/r;
+    eint=mesh[MESH_IDX(VARPR ,i,Hp->nx*Hp->ny)]-0.5*r*(vx*vx+vy*vy);
     p   =MAX((Hp->gamma-1)*r*eint,r*smallp);
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARRHO)]=r;
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVX )]=vy;
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARVY )]=vx;
-    q[yI+2+(Hp->ny+4)*(xI+Hp->nx*VARPR )]=p;
+    q[xI+tn*(yI+2+(Hp->ny+4)*VARRHO)]=r;
+    q[xI+tn*(yI+2+(Hp->ny+4)*VARVX )]=vy;
+    q[xI+tn*(yI+2+(Hp->ny+4)*VARVY )]=vx;
+    q[xI+tn*(yI+2+(Hp->ny+4)*VARPR )]=p;
   }
 }
 
-void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
+//Convert conserved to primitive for a pass in direction dir over the tn
+//pencils of a block, interleaved as in toPrimYN. Cells plo to np+phi-1 of
+//each pencil are read, so a pencil end takes its 2 cell halo from the
+//block's neighbours (plo=-2, phi=2) or leaves it to setBndCnd (0)
+void toPrimB(real *q, blk_view src, int dir, int np, int tn, int plo, int phi){
+  int i, lI;
+  int pI, tI;
+  int vn, vt;
+  double r,vx,vy,eint,p;
+  double smallp;
+
+  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  //Normal and transverse velocity
+  vn=(dir==0)?VARVX:VARVY;
+  vt=(dir==0)?VARVY:VARVX;
+  for(lI=0;lI<(np-plo+phi)*tn;lI++){
+    tI=lI%tn;
+    pI=lI/tn+plo;
+    i=pI*src.ps+tI*src.ts;
+    r   =MAX(src.b[i+src.vs*VARRHO],Ha->smallr);
+    vx  =src.b[i+src.vs*vn]/r;
+    vy  =src.b[i+src.vs*vt]/r;
+    eint=src.b[i+src.vs*VARPR]-0.5*r*(vx*vx+vy*vy);
+    //The pressure floor of toPrimX or toPrimYN
+    p   =MAX((Hp->gamma-1)*r*eint,(dir==0)?smallp:r*smallp);
+    q[tI+tn*(pI+2+(np+4)*VARRHO)]=r;
+    q[tI+tn*(pI+2+(np+4)*VARVX )]=vx;
+    q[tI+tn*(pI+2+(np+4)*VARVY )]=vy;
+    q[tI+tn*(pI+2+(np+4)*VARPR )]=p;
+  }
+}
+
+//Cell p of pencil t is q[ps*p+ts*t]
+void setBndCnd(real* q, int cndL, int cndH, int np, int nt, int ps, int ts){
   int i;
   int pI,tI;
   int wInd, rInd;
 
 
   //printf("Running bnd cnds for %dx%d prims\n",np,nt);
-#pragma omp parallel for private(i,pI,tI,wInd,rInd) shared(q,cndL,cndH,np,nt,Hp,Ha)
   for(i=0;i<2*nt;i++){
     pI=i%2;
     tI=i/2;
-    wInd=pI+(np+4)*tI;
-    rInd=3-pI+(np+4)*tI;
+    wInd=ps*pI+ts*tI;
+    rInd=ps*(3-pI)+ts*tI;
     //printf("BND: %d refs %d\n",wInd,rInd);
     if(cndL==BND_REFL){
       q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
@@ -132,8 +259,8 @@ void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
       q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
       q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
     }
-    wInd=np+2+pI+(np+4)*tI;
-    rInd=np+1-pI+(np+4)*tI;
+    wInd=ps*(np+2+pI)+ts*tI;
+    rInd=ps*(np+1-pI)+ts*tI;
     //printf("BND: %d refs %d\n",wInd,rInd);
     if(cndH==BND_REFL){
       q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
@@ -149,33 +276,32 @@ void setBndCnd(double* q, int cndL, int cndH, int np, int nt){
   }
 }
 
-void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
-  int lI;
-  int i,j;
-  double  r, u, v1, p, a;
-  double dr,du,dv1,dp,da;
-  double cc,csq;
-  double alpham,alphap,alphazr;
-  double spplus,spzerol,spzeror,spminus;
-  double ap,am,azr,azv1,acmp;
-
-#pragma omp parallel for default(none) shared(qr,ql,q,np,nt,Hp,Ha,dtdx)	\
-  private(i,j,r,u,v1,p,dr,du,dv1,dp,cc,csq,alpham,alphap,alphazr,spplus,spminus,spzeror,spzerol,ap,am,azr,azv1,acmp)
-  for(lI=0;lI<(np+2)*nt;lI++){
-    i=lI%(np+2);
-    j=lI/(np+2);
-    r =q[i+1+(np+4)*(j+nt*VARRHO)];
-    u =q[i+1+(np+4)*(j+nt*VARVX )];
-    v1=q[i+1+(np+4)*(j+nt*VARVY )];
-    p =q[i+1+(np+4)*(j+nt*VARPR )];
+//Calculate ql and qr for a run of n cells of q whose neighbours are s
+//apart. qvs and ovs are the variable strides of q and of ql/qr
+void traceRun(real *ql, real *qr, real *q, real dtdx, int n, int s, int qvs, int ovs){
+  int k;
+  real  r, u, v1, p, a;
+  real dr,du,dv1,dp,da;
+  real cc,csq;
+  real alpham,alphap,alphazr;
+  real spplus,spzerol,spzeror,spminus;
+  real ap,am,azr,azv1,acmp;
+  real gmma;
+
+  gmma=Hp->gamma;
+  for(k=0;k<n;k++){
+    r =q[k+qvs*VARRHO];
+    u =q[k+qvs*VARVX ];
+    v1=q[k+qvs*VARVY ];
+    p =q[k+qvs*VARPR ];
     
-    csq=Hp->gamma*p/r;
+    csq=gmma*p/r;
     cc=sqrt(csq);
     
-    dr =slope(q,i+1+(np+4)*(j+nt*VARRHO));
-    du =slope(q,i+1+(np+4)*(j+nt*VARVX ));
-    dv1=slope(q,i+1+(np+4)*(j+nt*VARVY ));
-    dp =slope(q,i+1+(np+4)*(j+nt*VARPR ));
+    dr =slope(q,k+qvs*VARRHO,s);
+    du =slope(q,k+qvs*VARVX ,s);
+    dv1=slope(q,k+qvs*VARVY ,s);
+    dp =slope(q,k+qvs*VARPR ,s);
     
     alpham = 0.5*(dp/(r*cc)-du)*r/cc;
     alphap = 0.5*(dp/(r*cc)+du)*r/cc;
@@ -189,10 +315,10 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
     am  =-0.5*spminus*alpham ;
     azr =-0.5*spzeror*alphazr;
     azv1=-0.5*spzeror*dv1;
-    qr[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    qr[i+(np+2)*(j+nt*VARVX )]=u +(ap-am    )*cc/r;
-    qr[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    qr[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
+    qr[k+ovs*VARRHO]=r +(ap+am+azr);
+    qr[k+ovs*VARVX ]=u +(ap-am    )*cc/r;
+    qr[k+ovs*VARVY ]=v1+(azv1     );
+    qr[k+ovs*VARPR ]=p +(ap+am    )*csq;
     
     //left
     spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
@@ -202,18 +328,27 @@ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
     am  =-0.5*spminus*alpham ;
     azr =-0.5*spzerol*alphazr;
     azv1=-0.5*spzerol*dv1;
-    ql[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    ql[i+(np+2)*(j+nt*VARVX )]=u +(ap-am    )*cc/r;
-    ql[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    ql[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
+    ql[k+ovs*VARRHO]=r +(ap+am+azr);
+    ql[k+ovs*VARVX ]=u +(ap-am    )*cc/r;
+    ql[k+ovs*VARVY ]=v1+(azv1     );
+    ql[k+ovs*VARPR ]=p +(ap+am    )*csq;
+  }
+}
+
+//Calculate ql and qr from q
+void trace(real *ql, real *qr, real *q, real dtdx, int np, int nt){
+  int j;
+
+  for(j=0;j<nt;j++){
+    traceRun(ql+(np+2)*j,qr+(np+2)*j,q+1+(np+4)*j,dtdx,np+2,1,(np+4)*nt,(np+2)*nt);
   }
 }
 
-double slope(double *q,int ind){
-  double dlft, drgt, dcen, dsgn, dlim;
+real slope(real *q,int ind,int s){
+  real dlft, drgt, dcen, dsgn, dlim;
   //  printf("Calc slope for %d refs: [%d,%d,%d]\n",ind,ind-1,ind,ind+1);
-  dlft=q[ind  ]-q[ind-1];
-  drgt=q[ind+1]-q[ind  ];
+  dlft=q[ind  ]-q[ind-s];
+  drgt=q[ind+s]-q[ind  ];
   dcen=0.5*(dlft+drgt);
   if(dcen>=0)dsgn=1.0;
   else dsgn=-1.0;
@@ -222,189 +357,396 @@ double slope(double *q,int ind){
   return dsgn*MIN(dlim,fabs(dcen));
 }
 
-void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
-  int lI, i,j,n;
-  double smallp, smallpp;
-  double gmma6, entho;
-  double qgdnvR,qgdnvVX,qgdnvVY,qgdnvP;
-  double rl,vxl,vyl,pl,cl,wl,ql,vsl;
-  double rr,vxr,vyr,pr,cr,wr,qr,vsr;
-  double ro,vxo,po,wo,co;
-  double rx,vxx,px,wx,cx;
-  double sgnm, scr, frac;
-  double spout,spin,ushk;
-  double ekin,etot,delp;
+//riemannRun for the approximate solvers of Ha->scheme, see
+//riemann_approx.h. They have no iterations, so it is one branch free loop
+//over the run
+void riemannApproxRun(real *flx, real *qxm, real *qxp, int nf, int qvs, int fvs){
+  int i, hllc;
+  real smallr, smallp, gmma;
 
-  smallp=Ha->smallc*Ha->smallc/Hp->gamma;
-  smallpp=Ha->smallr*smallp;
-  gmma6=(Hp->gamma+1.0)/(2.0*Hp->gamma);
-  entho=1.0/(Hp->gamma-1.0);
-#pragma omp parallel for shared(flx,qxm,qxp,np,nt,Ha,Hp,gmma6,entho,smallpp,smallp) \
-  default(none)\
-  private(i,j,n,sgnm,scr,frac)\
-  private(rl,vxl,vyl,pl,cl,wl,ql,vsl)\
-  private(rr,vxr,vyr,pr,cr,wr,qr,vsr)\
-  private(ro,vxo,po,wo,co)\
-  private(rx,vxx,px,wx,cx)\
-  private(spout,spin,ushk,delp)\
-  private(qgdnvR,qgdnvVX,qgdnvVY,qgdnvP,ekin,etot)
-  for(lI=0;lI<(np+1)*nt;lI++){
-    i=lI%(np+1);
-    j=lI/(np+1);
-    
-    rl =MAX(qxm[i  +(np+2)*(j+nt*VARRHO)],Ha->smallr);
-    vxl=    qxm[i  +(np+2)*(j+nt*VARVX )];
-    vyl=    qxm[i  +(np+2)*(j+nt*VARVY )];
-    pl =MAX(qxm[i  +(np+2)*(j+nt*VARPR )],rl*smallp);
-
-    rr =MAX(qxp[i+1+(np+2)*(j+nt*VARRHO)],Ha->smallr);
-    vxr=    qxp[i+1+(np+2)*(j+nt*VARVX )];
-    vyr=    qxp[i+1+(np+2)*(j+nt*VARVY )];
-    pr =MAX(qxp[i+1+(np+2)*(j+nt*VARPR )],rr*smallp);
-    
-    cl=Hp->gamma*pl*rl;
-    cr=Hp->gamma*pr*rr;
-    
-    wl=sqrt(cl);
-    wr=sqrt(cr);
-    
-    px=((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr);
-    px=MAX(px,0.0);
-    for(n=0;n<Ha->niter_riemann;n++){
-      wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
-      wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
-      ql=2.0*wl*wl*wl/(wl*wl+cl);
-      qr=2.0*wr*wr*wr/(wr*wr+cr);
-      vsl=vxl-(px-pl)/wl;
-      vsr=vxr+(px-pr)/wr;
-      delp=qr*ql/(qr+ql)*(vsl-vsr);
-      delp=MAX(delp,-px);
-      px+=delp;
-      vxo=fabs(delp/(px+smallpp));
-      if(vxo<1.0e-6)break;
-    }
-    wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
-    wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
-    vxx=0.5*(vxl+(pl-px)/wl+
-	     vxr-(pr-px)/wr);
-    if(vxx>=0.0){
-      sgnm=1.0;
-      ro = rl;
-      vxo=vxl;
-      po = pl;
-      wo = wl;
-      qgdnvVY=vyl;
-    }else{
-      sgnm=-1.0;
-      ro = rr;
-      vxo=vxr;
-      po = pr;
-      wo = wr;
-      qgdnvVY=vyr;
-    }
-    co=MAX(Ha->smallc,sqrt(fabs(Hp->gamma*po/ro)));
-    
-    rx=MAX(Ha->smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
-    
-    cx=MAX(Ha->smallc,sqrt(fabs(Hp->gamma*px/rx)));
-      
-    spout=co   -sgnm*vxo;
-    spin =cx   -sgnm*vxx;
-    ushk =wo/ro-sgnm*vxo;
-    
-    if(px>=po){
-      spin=ushk;
-      spout=ushk;
+  smallr=Ha->smallr;
+  gmma=Hp->gamma;
+  smallp=Ha->smallc*Ha->smallc/gmma;
+  hllc=Ha->scheme==SCHEME_HLLC;
+#pragma omp simd
+  for(i=0;i<nf;i++){
+    real rl, vxl, vyl, pl, rr, vxr, vyr, pr;
+
+    rl =MAX(qxm[i+qvs*VARRHO],smallr);
+    vxl=    qxm[i+qvs*VARVX ];
+    vyl=    qxm[i+qvs*VARVY ];
+    pl =MAX(qxm[i+qvs*VARPR ],rl*smallp);
+    rr =MAX(qxp[i+qvs*VARRHO],smallr);
+    vxr=    qxp[i+qvs*VARVX ];
+    vyr=    qxp[i+qvs*VARVY ];
+    pr =MAX(qxp[i+qvs*VARPR ],rr*smallp);
+    if(hllc)hllcFlux(gmma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,flx+i,fvs);
+    else hllFlux(gmma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,flx+i,fvs);
+  }
+}
+
+//Riemann solver for a run of nf interfaces between qxm[i] and qxp[i],
+//with variable strides qvs and fvs. It works on batches of RIEMANN_BATCH
+//interfaces; every stage is a branch free loop over the batch so that it vectorises.
+//The Newton iterations are masked per interface and stop once the whole
+//batch has converged
+void riemannRun(real *flx, real *qxm, real *qxp, int nf, int qvs, int fvs){
+  int i0,n,l,nb,nAct;
+  real smallr, smallc, smallp, smallpp;
+  real gmma, gmma6, entho;
+  real rl[RIEMANN_BATCH],vxl[RIEMANN_BATCH],vyl[RIEMANN_BATCH],pl[RIEMANN_BATCH],cl[RIEMANN_BATCH];
+  real rr[RIEMANN_BATCH],vxr[RIEMANN_BATCH],vyr[RIEMANN_BATCH],pr[RIEMANN_BATCH],cr[RIEMANN_BATCH];
+  real px[RIEMANN_BATCH];
+  int act[RIEMANN_BATCH];
+  real *m, *p, *f;
+
+  if(Ha->scheme!=SCHEME_EXACT){
+    riemannApproxRun(flx,qxm,qxp,nf,qvs,fvs);
+    return;
+  }
+  smallr=Ha->smallr;
+  smallc=Ha->smallc;
+  gmma=Hp->gamma;
+  smallp=smallc*smallc/gmma;
+  smallpp=smallr*smallp;
+  gmma6=(gmma+1.0)/(2.0*gmma);
+  entho=1.0/(gmma-1.0);
+  for(i0=0;i0<nf;i0+=RIEMANN_BATCH){
+    nb=MIN(RIEMANN_BATCH,nf-i0);
+    m=qxm+i0;
+    p=qxp+i0;
+    f=flx+i0;
+
+#pragma omp simd
+    for(l=0;l<nb;l++){
+      real wl, wr;
+
+      rl[l] =MAX(m[l+qvs*VARRHO],smallr);
+      vxl[l]=    m[l+qvs*VARVX ];
+      vyl[l]=    m[l+qvs*VARVY ];
+      pl[l] =MAX(m[l+qvs*VARPR ],rl[l]*smallp);
+
+      rr[l] =MAX(p[l+qvs*VARRHO],smallr);
+      vxr[l]=    p[l+qvs*VARVX ];
+      vyr[l]=    p[l+qvs*VARVY ];
+      pr[l] =MAX(p[l+qvs*VARPR ],rr[l]*smallp);
+
+      cl[l]=gmma*pl[l]*rl[l];
+      cr[l]=gmma*pr[l]*rr[l];
+
+      wl=sqrt(cl[l]);
+      wr=sqrt(cr[l]);
+
+      px[l]=((wr*pl[l]+wl*pr[l])+wl*wr*(vxl[l]-vxr[l]))/(wl+wr);
+      px[l]=MAX(px[l],0.0);
+      act[l]=1;
     }
 
-    scr=MAX(spout-spin,Ha->smallc+fabs(spout+spin));
-
-    frac=0.5*(1.0+(spout+spin)/scr);
-    frac=MAX(0.0,MIN(1.0,frac));
-    qgdnvR =frac* rx+(1.0-frac)* ro;
-    qgdnvVX=frac*vxx+(1.0-frac)*vxo;
-    qgdnvP =frac* px+(1.0-frac)* po;
-    if(spout<0.0){
-      qgdnvR =ro;
-      qgdnvVX=vxo;
-      qgdnvP =po;
+    nAct=nb;
+    for(n=0;n<Ha->niter_riemann&&nAct>0;n++){
+      nAct=0;
+#pragma omp simd reduction(+:nAct)
+      for(l=0;l<nb;l++){
+        real wl, wr, ql, qr, vsl, vsr, delp, pn;
+
+        wl=sqrt(cl[l]*(1.0+gmma6*(px[l]-pl[l])/pl[l]));
+        wr=sqrt(cr[l]*(1.0+gmma6*(px[l]-pr[l])/pr[l]));
+        ql=2.0*wl*wl*wl/(wl*wl+cl[l]);
+        qr=2.0*wr*wr*wr/(wr*wr+cr[l]);
+        vsl=vxl[l]-(px[l]-pl[l])/wl;
+        vsr=vxr[l]+(px[l]-pr[l])/wr;
+        delp=qr*ql/(qr+ql)*(vsl-vsr);
+        delp=MAX(delp,-px[l]);
+        pn=px[l]+delp;
+        //Converged interfaces keep their pressure
+        px[l]=act[l]?pn:px[l];
+        act[l]=act[l]&&!(fabs(delp/(pn+smallpp))<1.0e-6);
+        nAct+=act[l];
+      }
     }
-    if(spin>0.0){
-      qgdnvR =rx;
-      qgdnvVX=vxx;
-      qgdnvP =px;
+
+#pragma omp simd
+    for(l=0;l<nb;l++){
+      real wl, wr, vxx, up;
+      real ro, vxo, po, wo, co, rx, cx;
+      real sgnm, scr, frac;
+      real spout, spin, ushk, sw;
+      real qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
+      real ekin, etot;
+
+      wl=sqrt(cl[l]*(1.0+gmma6*(px[l]-pl[l])/pl[l]));
+      wr=sqrt(cr[l]*(1.0+gmma6*(px[l]-pr[l])/pr[l]));
+      vxx=0.5*(vxl[l]+(pl[l]-px[l])/wl+
+               vxr[l]-(pr[l]-px[l])/wr);
+      up=vxx>=0.0;
+      sgnm   =up?  1.0:  -1.0;
+      ro     =up? rl[l]: rr[l];
+      vxo    =up?vxl[l]:vxr[l];
+      po     =up? pl[l]: pr[l];
+      wo     =up?    wl:    wr;
+      qgdnvVY=up?vyl[l]:vyr[l];
+      co=MAX(smallc,sqrt(fabs(gmma*po/ro)));
+      rx=MAX(smallr,ro/(1.0+ro*(po-px[l])/(wo*wo)));
+      cx=MAX(smallc,sqrt(fabs(gmma*px[l]/rx)));
+
+      spout=co   -sgnm*vxo;
+      spin =cx   -sgnm*vxx;
+      ushk =wo/ro-sgnm*vxo;
+
+      sw=px[l]>=po;
+      spin =sw?ushk:spin;
+      spout=sw?ushk:spout;
+
+      scr=MAX(spout-spin,smallc+fabs(spout+spin));
+
+      frac=0.5*(1.0+(spout+spin)/scr);
+      frac=MAX(0.0,MIN(1.0,frac));
+      qgdnvR =frac*   rx+(1.0-frac)* ro;
+      qgdnvVX=frac*  vxx+(1.0-frac)*vxo;
+      qgdnvP =frac*px[l]+(1.0-frac)* po;
+      qgdnvR =(spout<0.0)?   ro:qgdnvR;
+      qgdnvVX=(spout<0.0)?  vxo:qgdnvVX;
+      qgdnvP =(spout<0.0)?   po:qgdnvP;
+      qgdnvR =(spin >0.0)?   rx:qgdnvR;
+      qgdnvVX=(spin >0.0)?  vxx:qgdnvVX;
+      qgdnvP =(spin >0.0)?px[l]:qgdnvP;
+
+      f[l+fvs*VARRHO]=qgdnvR*qgdnvVX;
+      f[l+fvs*VARVX ]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+      f[l+fvs*VARVY ]=qgdnvR*qgdnvVX*qgdnvVY;
+      ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
+      etot=qgdnvP*entho+ekin;
+      f[l+fvs*VARPR ]=qgdnvVX*(etot+qgdnvP);
     }
-    flx[i+(np+1)*(j+nt*VARRHO)]=qgdnvR*qgdnvVX;
-    flx[i+(np+1)*(j+nt*VARVX )]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
-    flx[i+(np+1)*(j+nt*VARVY )]=qgdnvR*qgdnvVX*qgdnvVY;
-    ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
-    etot=qgdnvP*entho+ekin;
-    flx[i+(np+1)*(j+nt*VARPR )]=qgdnvVX*(etot+qgdnvP);
   }
 }
 
-void addFluxX(double *mesh, double *flx, double dtdx, int np, int nt){
+void riemann(real *flx, real *qxm, real *qxp, int np, int nt){
+  int j;
+
+  for(j=0;j<nt;j++){
+    riemannRun(flx+(np+1)*j,qxm+(np+2)*j,qxp+1+(np+2)*j,np+1,(np+2)*nt,(np+1)*nt);
+  }
+}
+
+void addFluxX(double *mesh, real *flx, double dtdx, int np, int nt, int t0, int tn){
   int lI, i, j;
 
-#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(lI,i,j)
-  for(lI=0;lI<np*nt;lI++){
+  for(lI=0;lI<np*tn;lI++){
     i=lI%np;
     j=lI/np;
-    mesh[i+np*(j+nt*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
-				    flx[i+1+(np+1)*(j+nt*VARRHO)]);
-    mesh[i+np*(j+nt*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
-				    flx[i+1+(np+1)*(j+nt*VARVX )]);
-    mesh[i+np*(j+nt*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
-				    flx[i+1+(np+1)*(j+nt*VARVY )]);
-    mesh[i+np*(j+nt*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
-				    flx[i+1+(np+1)*(j+nt*VARPR )]);
+    mesh[MESH_IDX(VARRHO,i+np*(j+t0),np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARRHO)]-
+						    flx[i+1+(np+1)*(j+tn*VARRHO)]);
+    mesh[MESH_IDX(VARVX ,i+np*(j+t0),np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVX )]-
+						    flx[i+1+(np+1)*(j+tn*VARVX )]);
+    mesh[MESH_IDX(VARVY ,i+np*(j+t0),np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVY )]-
+						    flx[i+1+(np+1)*(j+tn*VARVY )]);
+    mesh[MESH_IDX(VARPR ,i+np*(j+t0),np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARPR )]-
+						    flx[i+1+(np+1)*(j+tn*VARPR )]);
   }
 }
 
-void addFluxY(double *mesh, double *flx, double dtdx, int np, int nt){
+void addFluxY(double *mesh, real *flx, double dtdx, int np, int nt, int t0, int tn){
   int lI, i, j;
 
-#pragma omp parallel for shared(mesh,flx,dtdx,np,nt) private(lI,i,j)
-  for(lI=0;lI<np*nt;lI++){
-    i=lI%np;
-    j=lI/np;
-    mesh[j+nt*(i+np*VARRHO)]+=dtdx*(flx[i  +(np+1)*(j+nt*VARRHO)]-
-				    flx[i+1+(np+1)*(j+nt*VARRHO)]);
-    mesh[j+nt*(i+np*VARVX )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVY )]-
-				    flx[i+1+(np+1)*(j+nt*VARVY )]);
-    mesh[j+nt*(i+np*VARVY )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARVX )]-
-				    flx[i+1+(np+1)*(j+nt*VARVX )]);
-    mesh[j+nt*(i+np*VARPR )]+=dtdx*(flx[i  +(np+1)*(j+nt*VARPR )]-
-				    flx[i+1+(np+1)*(j+nt*VARPR )]);
+  for(lI=0;lI<np*tn;lI++){
+    j=lI%tn;
+    i=lI/tn;
+    mesh[MESH_IDX(VARRHO,j+t0+nt*i,np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARRHO)]-
+						  flx[i+1+(np+1)*(j+tn*VARRHO)]);
+    mesh[MESH_IDX(VARVX ,j+t0+nt*i,np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVY )]-
+						  flx[i+1+(np+1)*(j+tn*VARVY )]);
+    mesh[MESH_IDX(VARVY ,j+t0+nt*i,np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARVX )]-
+						  flx[i+1+(np+1)*(j+tn*VARVX )]);
+    mesh[MESH_IDX(VARPR ,j+t0+nt*i,np*nt)]+=dtdx*(flx[i  +(np+1)*(j+tn*VARPR )]-
+						  flx[i+1+(np+1)*(j+tn*VARPR )]);
+  }
+}
+
+//Add flux from a native layout y pass to conserved state vars
+void addFluxYN(double *mesh, real *flx, double dtdx, int np, int nt, int t0, int tn){
+  int lI, i, j;
+
+  for(lI=0;lI<np*tn;lI++){
+    j=lI%tn;
+    i=lI/tn;
+    mesh[MESH_IDX(VARRHO,j+t0+nt*i,np*nt)]+=dtdx*(flx[j+tn*(i  +(np+1)*VARRHO)]-
+						  flx[j+tn*(i+1+(np+1)*VARRHO)]);
+    mesh[MESH_IDX(VARVX ,j+t0+nt*i,np*nt)]+=dtdx*(flx[j+tn*(i  +(np+1)*VARVY )]-
+						  flx[j+tn*(i+1+(np+1)*VARVY )]);
+    mesh[MESH_IDX(VARVY ,j+t0+nt*i,np*nt)]+=dtdx*(flx[j+tn*(i  +(np+1)*VARVX )]-
+						  flx[j+tn*(i+1+(np+1)*VARVX )]);
+    mesh[MESH_IDX(VARPR ,j+t0+nt*i,np*nt)]+=dtdx*(flx[j+tn*(i  +(np+1)*VARPR )]-
+						  flx[j+tn*(i+1+(np+1)*VARPR )]);
+  }
+}
+
+//Add the flux of a pass in direction dir over the tn pencils of a block,
+//interleaved as in addFluxYN, to the np cells of each pencil of src and
+//store the result in dst
+void addFluxB(blk_view dst, blk_view src, real *flx, double dtdx, int dir, int np, int tn){
+  int lI, i, j, d, s;
+  int vn, vt;
+
+  vn=(dir==0)?VARVX:VARVY;
+  vt=(dir==0)?VARVY:VARVX;
+  for(lI=0;lI<np*tn;lI++){
+    j=lI%tn;
+    i=lI/tn;
+    d=i*dst.ps+j*dst.ts;
+    s=i*src.ps+j*src.ts;
+    dst.b[d+dst.vs*VARRHO]=src.b[s+src.vs*VARRHO]+dtdx*(flx[j+tn*(i  +(np+1)*VARRHO)]-
+							 flx[j+tn*(i+1+(np+1)*VARRHO)]);
+    dst.b[d+dst.vs*vn    ]=src.b[s+src.vs*vn    ]+dtdx*(flx[j+tn*(i  +(np+1)*VARVX )]-
+							 flx[j+tn*(i+1+(np+1)*VARVX )]);
+    dst.b[d+dst.vs*vt    ]=src.b[s+src.vs*vt    ]+dtdx*(flx[j+tn*(i  +(np+1)*VARVY )]-
+							 flx[j+tn*(i+1+(np+1)*VARVY )]);
+    dst.b[d+dst.vs*VARPR ]=src.b[s+src.vs*VARPR ]+dtdx*(flx[j+tn*(i  +(np+1)*VARPR )]-
+							 flx[j+tn*(i+1+(np+1)*VARPR )]);
+  }
+}
+
+void neumaierAdd(double *sum, double *corr, double v){
+  double t;
+
+  t=*sum+v;
+  if(fabs(*sum)>=fabs(v)){
+    *corr+=(*sum-t)+v;
+  }else{
+    *corr+=(v-t)+*sum;
+  }
+  *sum=t;
+}
+
+//Fold the n cells of mesh from cell c0 into the diagnostics dg
+void cellsDiag(mesh_diag *dg, double *mesh, int c0, int n){
+  int i, nV, bad;
+
+  for(i=c0;i<c0+n;i++){
+    neumaierAdd(&dg->sum[0],&dg->corr[0],mesh[MESH_IDX(VARRHO,i,Hp->nx*Hp->ny)]);
+    neumaierAdd(&dg->sum[1],&dg->corr[1],mesh[MESH_IDX(VARPR ,i,Hp->nx*Hp->ny)]);
+    bad=0;
+    for(nV=0;nV<Hp->nvar;nV++){
+      if(!isfinite(mesh[MESH_IDX(nV,i,Hp->nx*Hp->ny)]))bad=1;
+    }
+    dg->nans+=bad;
+  }
+}
+
+//Fold tile t0 to t0+tn-1 of a pass in direction dir into dg, straight
+//after its flux update while it is in cache
+void tileDiag(mesh_diag *dg, double *mesh, int dir, int t0, int tn){
+  int j;
+
+  if(dir==0){
+    cellsDiag(dg,mesh,Hp->nx*t0,Hp->nx*tn);
+    return;
+  }
+  for(j=0;j<Hp->ny;j++){
+    cellsDiag(dg,mesh,t0+Hp->nx*j,tn);
   }
 }
 
+//Add the partial diagnostics part into dg
+void mergeDiag(mesh_diag *dg, mesh_diag *part){
+  int v;
+
+  for(v=0;v<2;v++){
+    neumaierAdd(&dg->sum[v],&dg->corr[v],part->sum[v]);
+    dg->corr[v]+=part->corr[v];
+  }
+  dg->nans+=part->nans;
+}
+
 double sumArray(double *mesh, int var, int nx, int ny){
-  int i;
+  int i, th, nth;
   double sum, corr;
-  double nsum, c_nxt;
+  double tsum, tcorr;
+  double *thSum, *thCorr;
+
+  nth=omp_get_max_threads();
+  thSum =(double*)calloc(nth,sizeof(double));
+  thCorr=(double*)calloc(nth,sizeof(double));
+
+  //Each thread keeps its own compensated partial, combined in thread order
+#pragma omp parallel private(i,th,tsum,tcorr) shared(mesh,var,nx,ny,thSum,thCorr)
+  {
+    th=omp_get_thread_num();
+    tsum=0.0;
+    tcorr=0.0;
+#pragma omp for schedule(static)
+    for(i=0;i<nx*ny;i++){
+      neumaierAdd(&tsum,&tcorr,mesh[MESH_IDX(var,i,nx*ny)]);
+    }
+    thSum[th]=tsum;
+    thCorr[th]=tcorr;
+  }
 
   sum=0.0;
   corr=0.0;
+  for(th=0;th<nth;th++){
+    neumaierAdd(&sum,&corr,thSum[th]);
+    corr+=thCorr[th];
+  }
+  free(thSum);
+  free(thCorr);
+  return sum+corr;
+}
+
+//Point q, qr, ql and flx at the arena, growing it if the tiles no longer
+//fit. Every array starts on a SCR_ALIGN byte boundary
+void getScratch(size_t primSz, size_t qSz, size_t flxSz){
+  size_t slice, bytes;
+  int nth;
 
-#pragma omp parallel for reduction(+:sum,corr) shared(mesh,var,nx,ny) private(i,nsum,c_nxt)
-  for(i=0;i<nx*ny;i++){
-    c_nxt=mesh[i+nx*ny*var];
-    nsum=sum+c_nxt;
-#pragma omp critical
+  nth=omp_get_max_threads();
+  slice=SCR_PAD(primSz,SCR_ALIGN/sizeof(real))+2*SCR_PAD(qSz,SCR_ALIGN/sizeof(real))+
+	SCR_PAD(flxSz,SCR_ALIGN/sizeof(real));
+  slice=SCR_PAD(slice,SCR_PAGE/sizeof(real));
+  if(scr==NULL||slice>scrSlice||nth!=scrTh){
+    cody_free(scr);
+    bytes=nth*slice*sizeof(real);
+    scr=(real*)cody_alloc(bytes,SCR_PAGE,CODY_HUGE|CODY_FIRST_TOUCH);
+    if(scr==NULL){
+      fprintf(stderr,"Could not allocate %zu bytes of scratch\n",bytes);
+      exit(1);
+    }
+    //Each slice is first touched by the thread that sweeps with it
+#pragma omp parallel
     {
-      corr=(nsum-sum)-c_nxt;
-      sum=nsum;
+      memset(scr+omp_get_thread_num()*slice,0,slice*sizeof(real));
     }
+    scrSlice=slice;
+    scrTh=nth;
   }
-  return sum+corr;
+  q  =scr;
+  qr =q +SCR_PAD(primSz,SCR_ALIGN/sizeof(real));
+  ql =qr+SCR_PAD(qSz,SCR_ALIGN/sizeof(real));
+  flx=ql+SCR_PAD(qSz,SCR_ALIGN/sizeof(real));
+}
+
+//Release the scratch arena once no more engine calls are coming
+void freeScratch(){
+  cody_free(scr);
+  scr=NULL;
+  scrSlice=0;
+  scrTh=0;
 }
 
-void runPass(double *mesh, double dt, int n, int dir){
+//Sweep the tiles of the pass in direction dir, shared out over the team
+//of the enclosing parallel region without a barrier at the end. If cdt is
+//set, also fold the CFL denominator of the updated mesh, found tile by tile
+//after the flux update, into den, and if thDg is set gather the mesh
+//diagnostics into the calling thread's partial the same way. Phase times
+//are added to tTh. den and tTh belong to the calling thread
+void passTiles(double *mesh, double dt, int dir, int cdt, mesh_diag *thDg, double *den, double *tTh){
   int bndL,bndH;
   int np,nt;
-  double dx,dy;
-  char dirCh, outfile[30];
+  int t0,tn;
+  real *tq, *tqr, *tql, *tflx;
+  double dx;
+  double tDen;
+  double tPh;
 
   if(dir==0){
     np=Hp->nx;
@@ -412,35 +754,299 @@ void runPass(double *mesh, double dt, int n, int dir){
     bndL=Hp->bndL;
     bndH=Hp->bndR;
     dx=Hp->dx;
-    dy=Hp->dy;
-    dirCh='x';
-    toPrimX(q,mesh);
   }else{
     np=Hp->ny;
     nt=Hp->nx;
     bndL=Hp->bndU;
     bndH=Hp->bndD;
     dx=Hp->dy;
-    dy=Hp->dx;
-    dirCh='y';
-    toPrimY(q,mesh);
   }
-  setBndCnd(q,bndL,bndH,np,nt);
-  trace(ql,qr,q,dt/dx,np,nt);
-  riemann(flx,ql,qr,np,nt);
+  //Each thread sweeps whole tiles of pencils through its own slice of the
+  //arena
+  tq  =q  +scrSlot()*scrSlice;
+  tqr =qr +scrSlot()*scrSlice;
+  tql =ql +scrSlot()*scrSlice;
+  tflx=flx+scrSlot()*scrSlice;
+#pragma omp for nowait
+  for(t0=0;t0<nt;t0+=PENCIL_TILE){
+    PH_START(tPh);
+    tn=MIN(PENCIL_TILE,nt-t0);
+#ifndef YPASS_TRANSPOSE
+    if(dir==1){
+      //Native layout y pass: the tn columns stay interleaved, so every
+      //step runs along whole rows of the tile
+      toPrimYN(tq,mesh,t0,tn);
+      PH_ADD(tTh,PH_PRIM,tPh);
+      setBndCnd(tq,bndL,bndH,np,tn,tn,1);
+      PH_ADD(tTh,PH_HALO,tPh);
+      traceRun(tql,tqr,tq+tn,dt/dx,tn*(np+2),tn,tn*(np+4),tn*(np+2));
+      PH_ADD(tTh,PH_TRACE,tPh);
+      riemannRun(tflx,tql,tqr+tn,tn*(np+1),tn*(np+2),tn*(np+1));
+      PH_ADD(tTh,PH_RIEMANN,tPh);
+      addFluxYN(mesh,tflx,dt/dx,np,nt,t0,tn);
+      if(cdt){
+	tDen=tileDenom(mesh,dir,t0,tn);
+	*den=MAX(*den,tDen);
+      }
+      if(thDg)tileDiag(thDg+scrSlot(),mesh,dir,t0,tn);
+      PH_ADD(tTh,PH_FLUX,tPh);
+      continue;
+    }
+#endif
+    if(dir==0){
+      toPrimX(tq,mesh,t0,tn);
+    }else{
+      toPrimY(tq,mesh,t0,tn);
+    }
+    PH_ADD(tTh,PH_PRIM,tPh);
+    setBndCnd(tq,bndL,bndH,np,tn,1,np+4);
+    PH_ADD(tTh,PH_HALO,tPh);
+    trace(tql,tqr,tq,dt/dx,np,tn);
+    PH_ADD(tTh,PH_TRACE,tPh);
+    riemann(tflx,tql,tqr,np,tn);
+    PH_ADD(tTh,PH_RIEMANN,tPh);
+    if(dir==0){
+      addFluxX(mesh,tflx,dt/dx,np,nt,t0,tn);
+    }else{
+      addFluxY(mesh,tflx,dt/dx,np,nt,t0,tn);
+    }
+    if(cdt){
+      tDen=tileDenom(mesh,dir,t0,tn);
+      *den=MAX(*den,tDen);
+    }
+    if(thDg)tileDiag(thDg+scrSlot(),mesh,dir,t0,tn);
+    PH_ADD(tTh,PH_FLUX,tPh);
+  }
+}
+
+//Run both passes of a step, first in direction dir and then across it, in
+//one parallel region. The only barrier inside it is between the passes,
+//as the tiles of the second read cells of every tile of the first. If cdt
+//is set, also return the CFL denominator of the updated mesh from the
+//second pass, and if dg is set gather the mesh diagnostics into it
+double runStep(double *mesh, double dt, int dir, int cdt, mesh_diag *dg){
+  double den=0.0;
+  double tTh[NPHASE]={0.0};
+  mesh_diag *thDg=NULL;
+  int ph, t;
+
+  //Phase times are summed over the threads in tTh, and diagnostics
+  //gathered per thread in thDg, combined in thread order
+  if(dg)thDg=(mesh_diag*)calloc(omp_get_max_threads(),sizeof(mesh_diag));
+#pragma omp parallel shared(mesh,dt,dir,cdt,q,qr,ql,flx,scrSlice,thDg) reduction(+:tTh[:NPHASE]) reduction(max:den) copyin(Hp,Ha)
+  {
+    passTiles(mesh,dt,dir,0,NULL,&den,tTh);
+#pragma omp barrier
+    passTiles(mesh,dt,1-dir,cdt,thDg,&den,tTh);
+  }
+  //Report the mean time per thread
+  for(ph=0;ph<NPHASE;ph++){
+    Ht.phase[ph]+=tTh[ph]/omp_get_max_threads();
+  }
+  if(thDg){
+    for(t=0;t<omp_get_max_threads();t++){
+      mergeDiag(dg,thDg+t);
+    }
+    free(thDg);
+  }
+  return den;
+}
+
+//Run both passes of a step, first in direction dir and then across it,
+//one block of TBLOCK x TBLOCK cells at a time, reading mesh and writing
+//out. The first pass also updates the 2 pencils on either side of the
+//block that the second pass needs as its halo, into tblk, so a block goes
+//to memory once per step instead of once per pass. If cdt is set, also
+//return the CFL denominator of out, found block by block, and if dg is set
+//gather the diagnostics of out into it
+double blockStep(double *out, double *mesh, double *tblk, double dt, int dir, int cdt, mesh_diag *dg){
+  int na, nb, aS, bS;
+  int bndAL, bndAH, bndBL, bndBH;
+  int bI, nab, nbb;
+  int a0, an, alo, ahi;
+  int b0, bn, blo, bhi;
+  int tn, j, c0, cn;
+  double dxa, dxb;
+  double den=0.0, tDen;
+  double tPh, tTh[NPHASE]={0.0};
+  real *tq, *tqr, *tql, *tflx;
+  mesh_diag *thDg=NULL;
+  blk_view src, tb, dst;
+
+  //a runs along the first pass and b across it, s being their mesh strides
   if(dir==0){
-    addFluxX(mesh,flx,dt/dx,np,nt);
+    na=Hp->nx;
+    nb=Hp->ny;
+    aS=1;
+    bS=Hp->nx;
+    bndAL=Hp->bndL;
+    bndAH=Hp->bndR;
+    bndBL=Hp->bndU;
+    bndBH=Hp->bndD;
+    dxa=Hp->dx;
+    dxb=Hp->dy;
   }else{
-    addFluxY(mesh,flx,dt/dx,np,nt);
+    na=Hp->ny;
+    nb=Hp->nx;
+    aS=Hp->nx;
+    bS=1;
+    bndAL=Hp->bndU;
+    bndAH=Hp->bndD;
+    bndBL=Hp->bndL;
+    bndBH=Hp->bndR;
+    dxa=Hp->dy;
+    dxb=Hp->dx;
   }
+  //Each thread runs whole blocks through its own slice of the arena and
+  //of tblk. Phase times are summed over the threads in tTh, and
+  //diagnostics gathered per thread in thDg, combined in thread order
+  nab=(na+TBLOCK-1)/TBLOCK;
+  nbb=(nb+TBLOCK-1)/TBLOCK;
+  if(dg)thDg=(mesh_diag*)calloc(omp_get_max_threads(),sizeof(mesh_diag));
+#pragma omp parallel for private(a0,an,alo,ahi,b0,bn,blo,bhi,tn,j,c0,cn,tq,tqr,tql,tflx,src,tb,dst,tDen,tPh) shared(out,mesh,tblk,dt,dir,cdt,na,nb,aS,bS,nab,bndAL,bndAH,bndBL,bndBH,dxa,dxb,q,qr,ql,flx,scrSlice,thDg) reduction(+:tTh[:NPHASE]) reduction(max:den) copyin(Hp,Ha)
+  for(bI=0;bI<nab*nbb;bI++){
+    PH_START(tPh);
+    tq  =q  +scrSlot()*scrSlice;
+    tqr =qr +scrSlot()*scrSlice;
+    tql =ql +scrSlot()*scrSlice;
+    tflx=flx+scrSlot()*scrSlice;
+    b0=(bI/nab)*TBLOCK;
+    bn=MIN(TBLOCK,nb-b0);
+    blo=(b0>0)?2:0;
+    bhi=(b0+bn<nb)?2:0;
+    tn=blo+bn+bhi;
+    a0=(bI%nab)*TBLOCK;
+    an=MIN(TBLOCK,na-a0);
+    alo=(a0>0)?2:0;
+    ahi=(a0+an<na)?2:0;
+    //First pass over the block and its halo pencils, into tblk
+    src.b=mesh+a0*aS+(b0-blo)*bS;
+    src.ps=aS;
+    src.ts=bS;
+    src.vs=Hp->nx*Hp->ny;
+    toPrimB(tq,src,dir,an,tn,-alo,ahi);
+    PH_ADD(tTh,PH_PRIM,tPh);
+    setBndCnd(tq,alo?BND_INT:bndAL,ahi?BND_INT:bndAH,an,tn,tn,1);
+    PH_ADD(tTh,PH_HALO,tPh);
+    traceRun(tql,tqr,tq+tn,dt/dxa,tn*(an+2),tn,tn*(an+4),tn*(an+2));
+    PH_ADD(tTh,PH_TRACE,tPh);
+    riemannRun(tflx,tql,tqr+tn,tn*(an+1),tn*(an+2),tn*(an+1));
+    PH_ADD(tTh,PH_RIEMANN,tPh);
+    tb.b=tblk+scrSlot()*TBLOCK*(TBLOCK+4)*Hp->nvar;
+    tb.ps=1;
+    tb.ts=an;
+    tb.vs=an*tn;
+    addFluxB(tb,src,tflx,dt/dxa,dir,an,tn);
+    PH_ADD(tTh,PH_FLUX,tPh);
+    //Second pass over the block, taking its halo from tblk
+    tb.b+=an*blo;
+    tb.ps=an;
+    tb.ts=1;
+    toPrimB(tq,tb,1-dir,bn,an,-blo,bhi);
+    PH_ADD(tTh,PH_PRIM,tPh);
+    setBndCnd(tq,blo?BND_INT:bndBL,bhi?BND_INT:bndBH,bn,an,an,1);
+    PH_ADD(tTh,PH_HALO,tPh);
+    traceRun(tql,tqr,tq+an,dt/dxb,an*(bn+2),an,an*(bn+4),an*(bn+2));
+    PH_ADD(tTh,PH_TRACE,tPh);
+    riemannRun(tflx,tql,tqr+an,an*(bn+1),an*(bn+2),an*(bn+1));
+    PH_ADD(tTh,PH_RIEMANN,tPh);
+    dst.b=out+a0*aS+b0*bS;
+    dst.ps=bS;
+    dst.ts=aS;
+    dst.vs=Hp->nx*Hp->ny;
+    addFluxB(dst,tb,tflx,dt/dxb,1-dir,bn,an);
+    //Rows of the block in out
+    for(j=0;(cdt||thDg)&&j<((dir==0)?bn:an);j++){
+      if(dir==0){
+	c0=a0+Hp->nx*(b0+j);
+	cn=an;
+      }else{
+	c0=b0+Hp->nx*(a0+j);
+	cn=bn;
+      }
+      if(cdt){
+	tDen=cellsDenom(out,c0,cn);
+	den=MAX(den,tDen);
+      }
+      if(thDg)cellsDiag(thDg+scrSlot(),out,c0,cn);
+    }
+    PH_ADD(tTh,PH_FLUX,tPh);
+  }
+  //Report the mean time per thread
+  for(j=0;j<NPHASE;j++){
+    Ht.phase[j]+=tTh[j]/omp_get_max_threads();
+  }
+  if(thDg){
+    for(j=0;j<omp_get_max_threads();j++){
+      mergeDiag(dg,thDg+j);
+    }
+    free(thDg);
+  }
+  return den;
+}
+
+//Scratch tile sizes of the problem in Hp
+void tileSizes(size_t *primSz, size_t *qSz, size_t *flxSz){
+#ifdef TEMPORAL_BLOCK
+  //The first pass of a block also runs over its halo
+  *primSz=Hp->nvar*(TBLOCK+4)*(TBLOCK+4);
+  *qSz   =Hp->nvar*(TBLOCK+2)*(TBLOCK+4);
+  *flxSz =Hp->nvar*(TBLOCK+1)*(TBLOCK+4);
+#else
+  if(Hp->ny>=Hp->nx){
+    *primSz=Hp->nvar*(Hp->ny+4)*PENCIL_TILE;
+    *qSz   =Hp->nvar*(Hp->ny+2)*PENCIL_TILE;
+    *flxSz =Hp->nvar*(Hp->ny+1)*PENCIL_TILE;
+  }else{
+    *primSz=Hp->nvar*(Hp->nx+4)*PENCIL_TILE;
+    *qSz   =Hp->nvar*(Hp->nx+2)*PENCIL_TILE;
+    *flxSz =Hp->nvar*(Hp->nx+1)*PENCIL_TILE;
+  }
+#endif
 }
 
-void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
-  int n, i,j;
-  int bndL;
-  int bndH;
-  double dt;
+#ifdef MESH_AOSOA
+//Copy the variable major mesh vm into the AoSoA mesh m, or back if back
+//is set. The threads touch the cells they sweep first
+void meshLayout(double *m, double *vm, int back){
+  int i, nV, n, nvar;
+
+  n=Hp->nx*Hp->ny;
+  nvar=Hp->nvar;
+#pragma omp parallel for private(i,nV) shared(m,vm,back,n,nvar) schedule(static)
+  for(i=0;i<n;i++){
+    for(nV=0;nV<nvar;nV++){
+      if(back){
+	vm[i+n*nV]=m[MESH_IDX(nV,i,n)];
+      }else{
+	m[MESH_IDX(nV,i,n)]=vm[i+n*nV];
+      }
+    }
+  }
+}
+#endif
+
+//Mesh m in the layout of the restart and visualisation files: m itself,
+//or for MESH_AOSOA its copy in vm
+double *fileMesh(double *m, double *vm){
+#ifdef MESH_AOSOA
+  meshLayout(m,vm,1);
+  return vm;
+#else
+  return m;
+#endif
+}
+
+//Run the problem in Hp and Ha on mesh, in the scratch arena getScratch
+//set up. A batch member runs quietly: it prints no progress lines or
+//timing and writes no initial and final visualisation files. Returns the
+//number of steps run
+int runProblem(double *mesh, int verbose){
+  int n;
+  double dt, den;
   double cTime, nxttout;
+  double *cur, *nxt, *tmp, *tblk, *vmesh;
+  mesh_diag diag, *dg;
 
   double volCell;
   double oTM,oTE;
@@ -450,33 +1056,34 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
 
   char outfile[30];
 
-  size_t primSize, qSize, flxSize;
-
   double initT, endT;
-
-  Hp=Hyp;
-  Ha=Hya;
+  double tPh;
 
   n=0;
+  den=0.0;
   cTime=0;
   nxttout=-1.0;
-  
-  if(Hp->ny>=Hp->nx){
-    primSize=Hp->nvar*(Hp->nx+4)*Hp->ny;
-    qSize   =Hp->nvar*(Hp->nx+2)*Hp->ny;
-    flxSize =Hp->nvar*(Hp->nx+1)*Hp->ny;
-  }else{
-    primSize=Hp->nvar*(Hp->ny+4)*Hp->nx;
-    qSize   =Hp->nvar*(Hp->ny+2)*Hp->nx;
-    flxSize =Hp->nvar*(Hp->ny+1)*Hp->nx;
-  }
 
-  if(Ha->nstepmax<0&&Ha->tend<0.0)return;
-
-  q  =(double*)malloc(primSize*sizeof(double));
-  qr =(double*)malloc(qSize*sizeof(double));
-  ql =(double*)malloc(qSize*sizeof(double));
-  flx=(double*)malloc(flxSize*sizeof(double));
+  //The kernels work on a copy of the mesh in the layout.h layout, vmesh
+  //being the caller's variable major one
+  vmesh=mesh;
+#ifdef MESH_AOSOA
+  mesh=(double*)cody_alloc(MESH_LEN(Hp->nvar,Hp->nx*Hp->ny)*sizeof(double),SCR_ALIGN,CODY_FIRST_TOUCH);
+  if(mesh==NULL){
+    fprintf(stderr,"Could not allocate the AoSoA mesh\n");
+    exit(1);
+  }
+  meshLayout(mesh,vmesh,0);
+#endif
+  cur=mesh;
+  nxt=NULL;
+  tblk=NULL;
+#ifdef TEMPORAL_BLOCK
+  //Each step is written to the other mesh, as the blocks around the one
+  //being updated still need the old one. Every thread has its own tblk
+  nxt =(double*)cody_alloc(Hp->nvar*Hp->nx*Hp->ny*sizeof(double),SCR_ALIGN,CODY_FIRST_TOUCH);
+  tblk=(double*)cody_alloc(omp_get_max_threads()*Hp->nvar*TBLOCK*(TBLOCK+4)*sizeof(double),SCR_ALIGN,CODY_FIRST_TOUCH);
+#endif
 
   if(Ha->tend>0.0){
     nxttout=Ha->tend;
@@ -492,76 +1099,182 @@ void engine(double *mesh, hydro_prob *Hyp, hydro_args *Hya){
   frexp(oTM,&M_exp);
   frexp(oTE,&E_exp);
 
-  M_prec=ldexp(DBL_EPSILON,M_exp-1);
-  E_prec=ldexp(DBL_EPSILON,E_exp-1);
+  M_prec=ldexp(REAL_EPSILON,M_exp-1);
+  E_prec=ldexp(REAL_EPSILON,E_exp-1);
 
-  printf("TM:%g+-%g TE:%g+-%g\n",volCell*oTM,volCell*M_prec,volCell*oTE,volCell*E_prec);
+  if(verbose)printf("TM:%g+-%g TE:%g+-%g\n",volCell*oTM,volCell*M_prec,volCell*oTE,volCell*E_prec);
 #endif
 
   //Print initial condition
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-  printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
-  
-  initT=omp_get_wtime();
+  if(verbose){
+    snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+    writeVisAsync(outfile,vmesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
+  }
+
+  initTiming(&Ht,"OMP" REAL_TAG,"CPU",1,omp_get_max_threads());
+  initT=wallNow();
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
     //Calculate timestep
-    dt=Ha->sigma*calcDT(mesh);
+    PH_START(tPh);
+    //The last pass of the previous step found the CFL denominator, unless
+    //this is the first step
+    if(den>0.0){
+      dt=Ha->sigma*(0.5/den);
+    }else{
+      dt=Ha->sigma*calcDT(cur);
+    }
+    PH_ADD(Ht.phase,PH_DT,tPh);
     if(nxttout>0.0&&dt>(nxttout-cTime)){
-      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+      if(verbose)printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
       dt=(nxttout-cTime);
     }
-    if(n%2==0){
-      //X Dir
-      runPass(mesh,dt,n,0);
-      //Y Dir
-      runPass(mesh,dt,n,1);
-    }else{
-      //Y Dir
-      runPass(mesh,dt,n,1);
-      //X Dir
-      runPass(mesh,dt,n,0);
+    //The last pass of a step that prints a progress line also gathers its
+    //diagnostics, so they cost no extra sweep over the mesh
+    dg=NULL;
+    if(verbose&&(n+1)%Ha->nprtLine==0){
+      memset(&diag,0,sizeof(diag));
+      dg=&diag;
     }
+#ifdef TEMPORAL_BLOCK
+    den=blockStep(nxt,cur,tblk,dt,(Hp->nstep+n)%2,FUSE_DT,dg);
+    tmp=cur;
+    cur=nxt;
+    nxt=tmp;
+#else
+    //X then Y on even steps, Y then X on odd ones
+    den=runStep(mesh,dt,(Hp->nstep+n)%2,FUSE_DT,dg);
+#endif
     n+=1;
     cTime+=dt;
-    if(n%Ha->nprtLine==0){
-      TM=sumArray(mesh,VARRHO,Hp->nx,Hp->ny);
-      TE=sumArray(mesh,VARPR ,Hp->nx,Hp->ny);
+    PH_START(tPh);
+    if(dg){
+      TM=diag.sum[0]+diag.corr[0];
+      TE=diag.sum[1]+diag.corr[1];
       printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+      if(diag.nans)printf("Iter %05d: %d cells hold NaN or Inf\n",n,diag.nans);
       if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
 	printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(TM-oTM),volCell*(TE-oTE));
 	printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(TM-oTM)/oTM,100.0*(TE-oTE)/oTE);
+      }
 #ifdef M_PREC_CMP
-	printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
+      //Conservation drift in units of the kernel precision
+      printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
 #endif
-      }
     }
     if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
-      printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(verbose)printf("Vis file @ time %f iter %d\n",cTime,n);
       if(cTime>=nxttout&&nxttout>0.0){
 	nxttout+=Ha->dtoutput;
 	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
 	//printf("Next Vis Time: %f\n",nxttout);
       }
-      snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-      writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+      snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+      //Batch members run side by side, so they write their own files
+      if(verbose)writeVisAsync(outfile,fileMesh(cur,vmesh),Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+      else writeVis(outfile,fileMesh(cur,vmesh),Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
     }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+  }
+  if(verbose)printf("time: %f, %d iters run\n",cTime,n);
+
+  endT=wallNow();
+
+  //An odd number of blocked steps leaves the result in the other mesh
+  if(cur!=mesh){
+    memcpy(mesh,cur,Hp->nvar*Hp->nx*Hp->ny*sizeof(double));
+    nxt=cur;
   }
-  printf("time: %f, %d iters run\n",cTime,n);
+  cody_free(nxt);
+  cody_free(tblk);
+#ifdef MESH_AOSOA
+  meshLayout(mesh,vmesh,1);
+  cody_free(mesh);
+  mesh=vmesh;
+#endif
 
-  endT=omp_get_wtime();
+  if(verbose){
+    Ht.niters=n;
+    Ht.ncells=Hp->nx*Hp->ny;
+    Ht.runt=endT-initT;
+    printTiming(&Ht,Ha);
 
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"OMP\"","\"CPU:?\"","\"Init\"",1,omp_get_max_threads(),n,Hp->nx*Hp->ny,(endT-initT));
+    //The last snapshot may share the final condition's name
+    waitVis();
 
-  //Print final condition
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    //Print final condition
+    snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+    writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  }
 
   Hp->t+=cTime;
-  free(q  );
-  free(qr );
-  free(ql );
-  free(flx);
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestart(Ha->chkFile,mesh,Hp);
+  return n;
+}
+
+void engine(int *argc, char **argv[], double *mesh, hydro_prob *Hyp, hydro_args *Hya){
+  Hp=Hyp;
+  Ha=Hya;
+
+  tileSizes(&primSize,&qSize,&flxSize);
+  if(Ha->nstepmax<0&&Ha->tend<0.0)return;
+
+  //Pin the team before the threads first touch their scratch slices
+  cody_pin(0,1);
+  getScratch(primSize,qSize,flxSize);
+  runProblem(mesh,1);
+}
+
+//Run the nb problems of a batch together, each member on one thread at a
+//time, so many small meshes fill the node instead of a few threads each.
+//Members are handed out dynamically as threads free up. One TIME line
+//covers the whole batch: niters is the most steps any member ran and
+//ncells the cells of all the members
+void engineBatch(int *argc, char **argv[], int nb, double **mesh, hydro_prob *Hyp, hydro_args *Hya){
+  int m, nIt, nMax=0, nCells=0, lvl, ph;
+  size_t pS, qS, fS;
+  double initT;
+  hydro_args bHa;
+
+  //One arena slice per thread, big enough for any member
+  primSize=qSize=flxSize=0;
+  for(m=0;m<nb;m++){
+    Hp=Hyp+m;
+    tileSizes(&pS,&qS,&fS);
+    primSize=MAX(primSize,pS);
+    qSize   =MAX(qSize,qS);
+    flxSize =MAX(flxSize,fS);
+  }
+  cody_pin(0,1);
+  getScratch(primSize,qSize,flxSize);
+
+  //The passes of a member run on its thread alone
+  lvl=omp_get_max_active_levels();
+  omp_set_max_active_levels(1);
+  initT=wallNow();
+#pragma omp parallel for schedule(dynamic,1) private(nIt) reduction(max:nMax) reduction(+:nCells)
+  for(m=0;m<nb;m++){
+    Hp=Hyp+m;
+    Ha=Hya+m;
+    nIt=0;
+    if(Ha->nstepmax>=0||Ha->tend>=0.0)nIt=runProblem(mesh[m],0);
+    printf("MEMBER %04d %s: time %f, %d iters run\n",m,Ha->initName,Hp->t,nIt);
+    nMax=MAX(nMax,nIt);
+    nCells+=Hp->nx*Hp->ny;
+  }
+  omp_set_max_active_levels(lvl);
+
+  //Phases are per member and not reported for the batch
+  bHa=Hya[0];
+  snprintf(bHa.initName,PREFIX_LEN,"batch%d",nb);
+  initTiming(&Ht,"OMP/BATCH" REAL_TAG,"CPU",1,omp_get_max_threads());
+  for(ph=0;ph<NPHASE;ph++){
+    Ht.phase[ph]=-1.0;
+  }
+  Ht.niters=nMax;
+  Ht.ncells=nCells;
+  Ht.runt=wallNow()-initT;
+  printTiming(&Ht,&bHa);
 }
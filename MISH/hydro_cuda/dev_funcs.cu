@@ -4,11 +4,12 @@
 
 #include "dev_funcs.h"
 #include "hydro_defs.h"
+#include "riemann_approx.h"
 
 __device__ __constant__ int d_nx, d_ny, d_nvar;
 __device__ __constant__ double d_gamma, d_dx, d_dy;
 __device__ __constant__ double d_smallr, d_smallc, d_smallp;
-__device__ __constant__ int d_niterR;
+__device__ __constant__ int d_niterR, d_scheme;
 
 void print_cuda_err(char *file, const char *func, int line, cudaError_t err){
   fprintf(stderr,"CUDA error in %s: %s(%d):\n",file,func,line);
@@ -47,17 +48,37 @@ void device_init(hydro_prob *Hp, hydro_args *Ha){
   HANDLE_CUDA_ERROR(errVar);
   cudaMemcpyToSymbol(d_niterR,&(Ha->niter_riemann),sizeof(int));
   HANDLE_CUDA_ERROR(errVar);
+  cudaMemcpyToSymbol(d_scheme,&(Ha->scheme),sizeof(int));
+  HANDLE_CUDA_ERROR(errVar);
 }
 
 extern __shared__ double dynVar[];
+
+//CFL denominator of one cell from its conserved variables
+__device__ double cell_denom(double rho, double vx, double vy, double eint){
+    double eken, p, c;
+    double courx, coury;
+
+    rho=fmax(rho,d_smallr);
+    vx=vx/rho;
+    vy=vy/rho;
+    eken=0.5*(vx*vx+vy*vy);
+    eint=eint/rho-eken;
+
+    p=fmax((d_gamma-(double)1.0)*rho*eint,rho*d_smallp);
+    c=sqrt(d_gamma*p/rho);
+
+    courx=(c+fabs(vx))/d_dx;
+    coury=(c+fabs(vy))/d_dy;
+    return courx+coury;
+}
+
 __global__ void calc_denom(double *u, double *den){
 double *denom=dynVar;
     uint stInd, i,j;
     int thInd;
     int mxInd, stride;
-    double rho, vx, vy, eken, eint;
-    double p, c;
-    double courx, coury;
+    double rho, vx, vy, eint;
 
     //Calculate indicies
     thInd=threadIdx.x;
@@ -71,18 +92,7 @@ double *denom=dynVar;
       vx  =u[(VARVX *(d_ny+4)+j+2)*(d_nx+4)+i+2];
       vy  =u[(VARVY *(d_ny+4)+j+2)*(d_nx+4)+i+2];
       eint=u[(VARPR *(d_ny+4)+j+2)*(d_nx+4)+i+2];
-      rho=fmax(rho,d_smallr);
-      vx=vx/rho;
-      vy=vy/rho;
-      eken=0.5*(vx*vx+vy*vy);
-      eint=eint/rho-eken;
-
-      p=fmax((d_gamma-(double)1.0)*rho*eint,rho*d_smallp);
-      c=sqrt(d_gamma*p/rho);
-
-      courx=(c+fabs(vx))/d_dx;
-      coury=(c+fabs(vy))/d_dy;
-      denom[thInd]=courx+coury;
+      denom[thInd]=cell_denom(rho,vx,vy,eint);
     }
     //Reduce to maximum value of denomenator over whole mesh.
     __syncthreads();
@@ -129,6 +139,56 @@ __global__ void redu_max(double *arrIn, double *arrOut, int nVals){
     if(thInd==0)arrOut[blockIdx.x]=arr[0];
 }
 
+//Set the timestep from the reduced CFL denominator, clipped to the next
+//output time. Once that time is reached dt is 0 and steps are held until
+//the host moves tOut on
+__global__ void calc_dt(step_state *st, double *den, double sigma){
+    double dt;
+
+    if(threadIdx.x==0&&blockIdx.x==0){
+      dt=0.5*sigma/den[0];
+      if(st->tOut>0.0&&dt>(st->tOut-st->t)){
+        dt=st->tOut-st->t;
+      }
+      st->dt=fmax(dt,0.0);
+      //Clear the denominator for the last pass of a step that runs to find
+      if(st->dt>0.0)st->den=0.0;
+    }
+}
+
+__global__ void end_step(step_state *st){
+    if(threadIdx.x==0&&blockIdx.x==0&&st->dt>0.0){
+      st->t+=st->dt;
+      st->dtRun=st->dt;
+      st->n++;
+    }
+}
+
+//Sum variable var over the interior cells of each block into sums
+__global__ void sum_var(double *u, int var, double *sums){
+    double *part=dynVar;
+    int thInd, stInd, stride;
+    int i, j;
+
+    thInd=threadIdx.x;
+    stInd=threadIdx.x+blockDim.x*blockIdx.x;
+    part[thInd]=0.0;
+    if(stInd<d_nx*d_ny){
+      i=stInd%d_nx;
+      j=stInd/d_nx;
+      part[thInd]=u[(var*(d_ny+4)+j+2)*(d_nx+4)+i+2];
+    }
+    __syncthreads();
+    //Pairwise, so any block size works
+    for(stride=1;stride<blockDim.x;stride<<=1){
+      if(thInd%(2*stride)==0&&thInd+stride<blockDim.x){
+        part[thInd]+=part[thInd+stride];
+      }
+      __syncthreads();
+    }
+    if(thInd==0)sums[blockIdx.x]=part[0];
+}
+
 __global__ void gen_bndXL(double *u, int bndT){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd%2;
@@ -278,10 +338,9 @@ __device__ double slope(double *q, int ind){
   return dsgn*fmin(dlim,fabs(dcen));
 }
 
-__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+2);
-  int j=thInd/(np+2);
+//Traced left and right states of cell qi of q (variable stride qs) into
+//entry oi of ql/qr (variable stride os)
+__device__ void trace_cell(double *ql, double *qr, double *q, int qi, int qs, int oi, int os, double dtdx){
   double  r,  u,  v1,  p;
   double dr, du, dv1, dp;
   double cc, csq;
@@ -289,57 +348,54 @@ __global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, in
   double spplus, spzero, spminus;
   double ap, am, azr, azv1;
 
-  if(j<nt){
-    r =q[i+1+(np+4)*(j+nt*VARRHO)];
-    u =q[i+1+(np+4)*(j+nt*VARVX )];
-    v1=q[i+1+(np+4)*(j+nt*VARVY )];
-    p =q[i+1+(np+4)*(j+nt*VARPR )];
+  r =q[qi+qs*(VARRHO)];
+  u =q[qi+qs*(VARVX )];
+  v1=q[qi+qs*(VARVY )];
+  p =q[qi+qs*(VARPR )];
 
-    csq=d_gamma*p/r;
-    cc=sqrt(csq);
+  csq=d_gamma*p/r;
+  cc=sqrt(csq);
 
-    dr =slope(q,i+1+(np+4)*(j+nt*VARRHO));
-    du =slope(q,i+1+(np+4)*(j+nt*VARVX ));
-    dv1=slope(q,i+1+(np+4)*(j+nt*VARVY ));
-    dp =slope(q,i+1+(np+4)*(j+nt*VARPR ));
+  dr =slope(q,qi+qs*(VARRHO));
+  du =slope(q,qi+qs*(VARVX ));
+  dv1=slope(q,qi+qs*(VARVY ));
+  dp =slope(q,qi+qs*(VARPR ));
    
 
-    alpham  = 0.5*(dp/(r*cc)-du)*r/cc;
-    alphap  = 0.5*(dp/(r*cc)+du)*r/cc;
-    alphazr = dr-dp/csq;
-
-    //Right
-    spminus=((u-cc)>=0.0)?0.0:(u-cc)*dtdx+1.0;
-    spzero =((u   )>=0.0)?0.0:(u   )*dtdx+1.0;
-    spplus =((u+cc)>=0.0)?0.0:(u+cc)*dtdx+1.0;
-    ap  =-0.5*spplus *alphap;
-    am  =-0.5*spminus*alpham;
-    azr =-0.5*spzero *alphazr;
-    azv1=-0.5*spzero *dv1;
-    qr[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    qr[i+(np+2)*(j+nt*VARVX )]=u +(am-am    )*cc/r;
-    qr[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    qr[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
-
-    //Left
-    spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
-    spzero =((u   )<=0.0)?0.0:(u   )*dtdx-1.0;
-    spplus =((u+cc)<=0.0)?0.0:(u+cc)*dtdx-1.0;
-    ap  =-0.5*spplus *alphap;
-    am  =-0.5*spminus*alpham;
-    azr =-0.5*spzero *alphazr;
-    azv1=-0.5*spzero *dv1;
-    ql[i+(np+2)*(j+nt*VARRHO)]=r +(ap+am+azr);
-    ql[i+(np+2)*(j+nt*VARVX )]=u +(am-am    )*cc/r;
-    ql[i+(np+2)*(j+nt*VARVY )]=v1+(azv1     );
-    ql[i+(np+2)*(j+nt*VARPR )]=p +(ap+am    )*csq;
-  }
+  alpham  = 0.5*(dp/(r*cc)-du)*r/cc;
+  alphap  = 0.5*(dp/(r*cc)+du)*r/cc;
+  alphazr = dr-dp/csq;
+
+  //Right
+  spminus=((u-cc)>=0.0)?0.0:(u-cc)*dtdx+1.0;
+  spzero =((u   )>=0.0)?0.0:(u   )*dtdx+1.0;
+  spplus =((u+cc)>=0.0)?0.0:(u+cc)*dtdx+1.0;
+  ap  =-0.5*spplus *alphap;
+  am  =-0.5*spminus*alpham;
+  azr =-0.5*spzero *alphazr;
+  azv1=-0.5*spzero *dv1;
+  qr[oi+os*(VARRHO)]=r +(ap+am+azr);
+  qr[oi+os*(VARVX )]=u +(am-am    )*cc/r;
+  qr[oi+os*(VARVY )]=v1+(azv1     );
+  qr[oi+os*(VARPR )]=p +(ap+am    )*csq;
+
+  //Left
+  spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
+  spzero =((u   )<=0.0)?0.0:(u   )*dtdx-1.0;
+  spplus =((u+cc)<=0.0)?0.0:(u+cc)*dtdx-1.0;
+  ap  =-0.5*spplus *alphap;
+  am  =-0.5*spminus*alpham;
+  azr =-0.5*spzero *alphazr;
+  azv1=-0.5*spzero *dv1;
+  ql[oi+os*(VARRHO)]=r +(ap+am+azr);
+  ql[oi+os*(VARVX )]=u +(am-am    )*cc/r;
+  ql[oi+os*(VARVY )]=v1+(azv1     );
+  ql[oi+os*(VARPR )]=p +(ap+am    )*csq;
 }
 
-__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+1);
-  int j=thInd/(np+1);
+//Godunov flux at face fi of flx (variable stride fs) between the left
+//state mi of qxm and the right state pi of qxp (variable stride qs)
+__device__ void riemann_face(double *flx, int fi, int fs, double *qxm, double *qxp, int mi, int pi, int qs){
   int n;
   double gmma6, entho, smallpp;
   double qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
@@ -355,126 +411,173 @@ __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   gmma6=(d_gamma+1)/(2.0*d_gamma);
   entho=1.0/(d_gamma-1.0);
 
-  if(j<nt){
-    rl =fmax(qxm[i  +(np+2)*(j+nt*VARRHO)],d_smallr);
-    vxl=     qxm[i  +(np+2)*(j+nt*VARVX )];
-    vyl=     qxm[i  +(np+2)*(j+nt*VARVY )];
-    pl =fmax(qxm[i  +(np+2)*(j+nt*VARPR )],rl*d_smallp);
-
-    rr =fmax(qxp[i+1+(np+2)*(j+nt*VARRHO)],d_smallr);
-    vxr=     qxp[i+1+(np+2)*(j+nt*VARVX )];
-    vyr=     qxp[i+1+(np+2)*(j+nt*VARVY )];
-    pr =fmax(qxp[i+1+(np+2)*(j+nt*VARPR )],rl*d_smallp);
-
-    cl=d_gamma*pl*rl;
-    cr=d_gamma*pr*rr;
-
-    wl=sqrt(cl);
-    wr=sqrt(cr);
-
-    px=fmax(0.0,((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr));
-    for(n=0;n<d_niterR;n++){
-      wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
-      wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
-      ql=2.0*wl*wl*wl/(wl*wl+cl);
-      qr=2.0*wr*wr*wr/(wr*wr+cr);
-      vsl=vxl-(px-pl)/wl;
-      vsr=vxr+(px-pr)/wr;
-      delp=fmax(-px,qr*ql/(qr+ql)*(vsl-vsr));
-      px+=delp;
-      vxo=fabs(delp/(px+smallpp));
-      if(vxo<1.0e-6)break;
-    }
-    wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
-    wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
-    vxx=0.5*(vxl+(pl-px)/wl+
-             vxr-(pr-px)/wr);
-    if(vxx>=0.0){
-      sgnm=1.0;
-      ro = rl;
-      vxo=vxl;
-      po = pl;
-      wo = wl;
-      qgdnvVY=vyl;
-    }else{
-      sgnm=-1.0;
-      ro = rr;
-      vxo=vxr;
-      po = pr;
-      wo = wr;
-      qgdnvVY=vyr;
-    }
-    co=fmax(d_smallc,sqrt(fabs(d_gamma*po/ro)));
-    rx=fmax(d_smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
-    cx=fmax(d_smallc,sqrt(fabs(d_gamma*px/rx)));
-
-    spout=co   -sgnm*vxo;
-    spin =cx   -sgnm*vxx;
-    ushk =wo/ro-sgnm*vxo;
+  rl =fmax(qxm[mi+qs*(VARRHO)],d_smallr);
+  vxl=     qxm[mi+qs*(VARVX )];
+  vyl=     qxm[mi+qs*(VARVY )];
+  pl =fmax(qxm[mi+qs*(VARPR )],rl*d_smallp);
+
+  rr =fmax(qxp[pi+qs*(VARRHO)],d_smallr);
+  vxr=     qxp[pi+qs*(VARVX )];
+  vyr=     qxp[pi+qs*(VARVY )];
+  pr =fmax(qxp[pi+qs*(VARPR )],rl*d_smallp);
+
+  //The approximate solvers of hydro_args.scheme, see riemann_approx.h.
+  //d_scheme is uniform, so the warps do not diverge on it
+  if(d_scheme==SCHEME_HLLC){
+    hllcFlux(d_gamma,rl,vxl,vyl,pl,rr,vxr,vyr,fmax(pr,rr*d_smallp),flx+fi,fs);
+    return;
+  }
+  if(d_scheme==SCHEME_HLL){
+    hllFlux(d_gamma,rl,vxl,vyl,pl,rr,vxr,vyr,fmax(pr,rr*d_smallp),flx+fi,fs);
+    return;
+  }
 
-    if(px>=po){
-      spin=ushk;
-      spout=ushk;
-    }
+  cl=d_gamma*pl*rl;
+  cr=d_gamma*pr*rr;
 
-    scr=fmax(spout-spin,d_smallc+fabs(spout+spin));
-
-    frac=0.5*(1.0+(spout+spin)/scr);
-    frac=fmax(0.0,fmin(1.0,frac));
-    qgdnvR =frac* rx+(1.0-frac)* ro;
-    qgdnvVX=frac*vxx+(1.0-frac)*vxo;
-    qgdnvP=frac* px+(1.0-frac)* po;
-    if(spout<0.0){
-      qgdnvR = ro;
-      qgdnvVX=vxo;
-      qgdnvP = po;
-    }
-    if(spin>0.0){
-      qgdnvR = rx;
-      qgdnvVX=vxx;
-      qgdnvP = px;
-    }
+  wl=sqrt(cl);
+  wr=sqrt(cr);
 
-    flx[i+(np+1)*(j+nt*VARRHO)]=qgdnvR*qgdnvVX;
-    flx[i+(np+1)*(j+nt*VARVX )]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
-    flx[i+(np+1)*(j+nt*VARVY )]=qgdnvVY;//qgdnvR*qgdnvVX*qgdnvVY;
-    ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
-    etot=qgdnvP*entho+ekin;
-    flx[i+(np+1)*(j+nt*VARPR )]=qgdnvVX*(etot+qgdnvP);
+  px=fmax(0.0,((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr));
+  for(n=0;n<d_niterR;n++){
+    wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+    wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+    ql=2.0*wl*wl*wl/(wl*wl+cl);
+    qr=2.0*wr*wr*wr/(wr*wr+cr);
+    vsl=vxl-(px-pl)/wl;
+    vsr=vxr+(px-pr)/wr;
+    delp=fmax(-px,qr*ql/(qr+ql)*(vsl-vsr));
+    px+=delp;
+    vxo=fabs(delp/(px+smallpp));
+    if(vxo<1.0e-6)break;
   }
-}
+  wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+  wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+  vxx=0.5*(vxl+(pl-px)/wl+
+           vxr-(pr-px)/wr);
+  if(vxx>=0.0){
+    sgnm=1.0;
+    ro = rl;
+    vxo=vxl;
+    po = pl;
+    wo = wl;
+    qgdnvVY=vyl;
+  }else{
+    sgnm=-1.0;
+    ro = rr;
+    vxo=vxr;
+    po = pr;
+    wo = wr;
+    qgdnvVY=vyr;
+  }
+  co=fmax(d_smallc,sqrt(fabs(d_gamma*po/ro)));
+  rx=fmax(d_smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
+  cx=fmax(d_smallc,sqrt(fabs(d_gamma*px/rx)));
 
-__global__ void addFluxX(double *u, double *flx, double dtdx){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%d_nx;
-  int j=thInd/d_nx;
+  spout=co   -sgnm*vxo;
+  spin =cx   -sgnm*vxx;
+  ushk =wo/ro-sgnm*vxo;
 
-  if(j<d_ny){
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)]+=dtdx*(flx[i  +(d_nx+1)*(j+d_ny*VARRHO)]-
-                                                 flx[i+1+(d_nx+1)*(j+d_ny*VARRHO)]);
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVX )]+=dtdx*(flx[i  +(d_nx+1)*(j+d_ny*VARVX )]-
-                                                 flx[i+1+(d_nx+1)*(j+d_ny*VARVX )]);
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVY )]+=dtdx*(flx[i  +(d_nx+1)*(j+d_ny*VARVY )]-
-                                                 flx[i+1+(d_nx+1)*(j+d_ny*VARVY )]);
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARPR )]+=dtdx*(flx[i  +(d_nx+1)*(j+d_ny*VARPR )]-
-                                                 flx[i+1+(d_nx+1)*(j+d_ny*VARPR )]);
+  if(px>=po){
+    spin=ushk;
+    spout=ushk;
   }
-}
 
-__global__ void addFluxY(double *u, double *flx, double dtdx){
-  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd/d_ny;
-  int j=thInd%d_ny;
+  scr=fmax(spout-spin,d_smallc+fabs(spout+spin));
+
+  frac=0.5*(1.0+(spout+spin)/scr);
+  frac=fmax(0.0,fmin(1.0,frac));
+  qgdnvR =frac* rx+(1.0-frac)* ro;
+  qgdnvVX=frac*vxx+(1.0-frac)*vxo;
+  qgdnvP=frac* px+(1.0-frac)* po;
+  if(spout<0.0){
+    qgdnvR = ro;
+    qgdnvVX=vxo;
+    qgdnvP = po;
+  }
+  if(spin>0.0){
+    qgdnvR = rx;
+    qgdnvVX=vxx;
+    qgdnvP = px;
+  }
 
-  if(i<d_nx){
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARRHO)]-
-                                                 flx[j+1+(d_ny+1)*(i+d_nx*VARRHO)]);
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVX )]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARVY )]-
-                                                 flx[j+1+(d_ny+1)*(i+d_nx*VARVY )]);
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVY )]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARVX )]-
-                                                 flx[j+1+(d_ny+1)*(i+d_nx*VARVX )]);
-    u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARPR )]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARPR )]-
-                                                 flx[j+1+(d_ny+1)*(i+d_nx*VARPR )]);
+  flx[fi+fs*(VARRHO)]=qgdnvR*qgdnvVX;
+  flx[fi+fs*(VARVX )]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+  flx[fi+fs*(VARVY )]=qgdnvVY;//qgdnvR*qgdnvVX*qgdnvVY;
+  ekin=0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY);
+  etot=qgdnvP*entho+ekin;
+  flx[fi+fs*(VARPR )]=qgdnvVX*(etot+qgdnvP);
+}
+
+//One block per tile of blockDim.x cells of a pencil: q is staged with its
+//2 cell halo in shared memory, traced, solved and the fluxes applied to u
+//without the states or fluxes going back to global memory. If cdt is set the
+//block also folds the CFL denominator of its updated cells into st->den
+__global__ void tile_flux(double *u, double *q, step_state *st, double dx, int np, int nt, int dir, int cdt){
+  int tl=blockDim.x;
+  int nSeg=(np+tl-1)/tl;
+  int j=blockIdx.x/nSeg;
+  int c0=(blockIdx.x%nSeg)*tl;
+  int nc=min(tl,np-c0);
+  int k, nv, ind, stride;
+  double den=0.0;
+  double *sq  =dynVar;            //Cells c0-2..c0+nc+1
+  double *sql =sq +NVAR*(tl+4);   //Cells c0-1..c0+nc
+  double *sqr =sql+NVAR*(tl+2);
+  double *sflx=sqr+NVAR*(tl+2);   //Faces c0..c0+nc
+  double dtdx=st->dt/dx;
+
+  //A held step leaves u alone
+  if(j>=nt||st->dt<=0.0)return;
+
+  for(k=threadIdx.x;k<nc+4;k+=tl){
+    for(nv=0;nv<NVAR;nv++){
+      sq[k+(tl+4)*nv]=q[c0+k+(np+4)*(j+nt*nv)];
+    }
+  }
+  __syncthreads();
+  for(k=threadIdx.x;k<nc+2;k+=tl){
+    trace_cell(sql,sqr,sq,k+1,tl+4,k,tl+2,dtdx);
+  }
+  __syncthreads();
+  for(k=threadIdx.x;k<nc+1;k+=tl){
+    riemann_face(sflx,k,tl+1,sql,sqr,k,k+1,tl+2);
+  }
+  __syncthreads();
+  for(k=threadIdx.x;k<nc;k+=tl){
+    if(dir==0){
+      ind=c0+k+2+(d_nx+4)*(j+2);
+      u[ind+(d_nx+4)*(d_ny+4)*VARRHO]+=dtdx*(sflx[k+(tl+1)*VARRHO]-sflx[k+1+(tl+1)*VARRHO]);
+      u[ind+(d_nx+4)*(d_ny+4)*VARVX ]+=dtdx*(sflx[k+(tl+1)*VARVX ]-sflx[k+1+(tl+1)*VARVX ]);
+      u[ind+(d_nx+4)*(d_ny+4)*VARVY ]+=dtdx*(sflx[k+(tl+1)*VARVY ]-sflx[k+1+(tl+1)*VARVY ]);
+      u[ind+(d_nx+4)*(d_ny+4)*VARPR ]+=dtdx*(sflx[k+(tl+1)*VARPR ]-sflx[k+1+(tl+1)*VARPR ]);
+    }else{
+      //The y pencils carry the normal velocity in VARVX
+      ind=j+2+(d_nx+4)*(c0+k+2);
+      u[ind+(d_nx+4)*(d_ny+4)*VARRHO]+=dtdx*(sflx[k+(tl+1)*VARRHO]-sflx[k+1+(tl+1)*VARRHO]);
+      u[ind+(d_nx+4)*(d_ny+4)*VARVX ]+=dtdx*(sflx[k+(tl+1)*VARVY ]-sflx[k+1+(tl+1)*VARVY ]);
+      u[ind+(d_nx+4)*(d_ny+4)*VARVY ]+=dtdx*(sflx[k+(tl+1)*VARVX ]-sflx[k+1+(tl+1)*VARVX ]);
+      u[ind+(d_nx+4)*(d_ny+4)*VARPR ]+=dtdx*(sflx[k+(tl+1)*VARPR ]-sflx[k+1+(tl+1)*VARPR ]);
+    }
+    if(cdt){
+      den=cell_denom(u[ind+(d_nx+4)*(d_ny+4)*VARRHO],u[ind+(d_nx+4)*(d_ny+4)*VARVX],
+                     u[ind+(d_nx+4)*(d_ny+4)*VARVY ],u[ind+(d_nx+4)*(d_ny+4)*VARPR]);
+    }
+  }
+  if(!cdt)return;
+  //Max over the block, then over the blocks. The denominators are positive
+  //so they order like their bit patterns
+  __syncthreads();
+  sq[threadIdx.x]=den;
+  __syncthreads();
+  for(stride=1;stride<tl;stride<<=1){
+    if(threadIdx.x%(2*stride)==0&&threadIdx.x+stride<tl){
+      sq[threadIdx.x]=fmax(sq[threadIdx.x],sq[threadIdx.x+stride]);
+    }
+    __syncthreads();
+  }
+  if(threadIdx.x==0){
+    atomicMax((unsigned long long*)&st->den,(unsigned long long)__double_as_longlong(sq[0]));
   }
 }
 
@@ -11,8 +11,21 @@ void handle_cuda_err(char * file, const char *func, int line, cudaError_t err);
 
 void device_init(hydro_prob *Hp, hydro_args *Ha);
 
+//Time stepping state, kept on the device so a step needs no host sync
+typedef struct __stepState{
+  double dt;    //Timestep of the current step, 0 while held at tOut
+  double dtRun; //Last timestep taken
+  double t;     //Simulation time
+  double tOut;  //Time of the next output, <=0 for none
+  double den;   //CFL denominator found by the last pass of the step
+  int n;        //Number of steps taken
+} step_state;
+
 __global__ void calc_denom(double *u, double *den);
 __global__ void redu_max(double *arrIn, double *arrOut, int nVals);
+__global__ void calc_dt(step_state *st, double *den, double sigma);
+__global__ void end_step(step_state *st);
+__global__ void sum_var(double *u, int var, double *sums);
 
 __global__ void gen_bndXL(double *u, int bnd);
 __global__ void gen_bndXU(double *u, int bnd);
@@ -22,10 +35,9 @@ __global__ void gen_bndYU(double *u, int bnd);
 __global__ void toPrimX(double *q, double *u);
 __global__ void toPrimY(double *q, double *u);
 
-__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt);
-__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt);
+//Shared memory a tile_flux block of tl threads needs
+#define TILE_SHMEM(tl) (NVAR*(4*(tl)+9)*sizeof(double))
 
-__global__ void addFluxX(double *u, double *flx, double dtdx);
-__global__ void addFluxY(double *u, double *flx, double dtdx);
+__global__ void tile_flux(double *u, double *q, step_state *st, double dx, int np, int nt, int dir, int cdt);
 
 #endif
@@ -3,26 +3,37 @@
 #include <math.h>
 #include <float.h>
 #include "hydro.h"
+#include "restart.h"
 #include "dev_funcs.h"
 #include "outfile.h"
-
-#define CDT_REGS 64
-#define STEP_REGS 64
+#include "timing.h"
+#include "launch.h"
 
 hydro_args *Ha;
 hydro_prob *Hp;
-size_t varSize, meshSize, primSize, qSize, flxSize;
+hydro_timing Ht;
+size_t varSize, meshSize, primSize;
 double *bndLS, *bndLR, *bndHS, *bndHR;
 double *d_u;
 double *d_q;
-double *d_qr, *d_ql;
-double *d_flx;
 
 //temp variable to store data for checking
 double *h_ref;
 
 //CUDA vars
-int nTh;
+//Block sizes of the boundary, primitive, fused pass and reduction
+//kernels, see setLaunch
+enum {LC_BND, LC_PRIM, LC_TILE, LC_CDT, NLAUNCH};
+launch_cfg lCfg[NLAUNCH];
+int nBlockM;
+double *d_denA, *d_denB;
+double *d_sums, *h_sums;
+step_state *d_st;
+cudaStream_t sStep;
+//Snapshots are downloaded into pinned memory on sOut behind the steps
+cudaStream_t sOut;
+double *h_snap;
+cudaEvent_t snapReady, snapDone;
 
 //MPI Vars
 int bndT, bndB;
@@ -48,13 +59,17 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny, int nHx, int
 }
 
 void setHHalo(int LBnd, int RBnd){
-  gen_bndXL<<<BL_TH(2*Hp->ny,nTh)>>>(d_u,LBnd);
-  gen_bndXU<<<BL_TH(2*Hp->ny,nTh)>>>(d_u,RBnd);
+  int nTh=lCfg[LC_BND].nTh;
+
+  gen_bndXL<<<BL_TH(2*Hp->ny,nTh),0,sStep>>>(d_u,LBnd);
+  gen_bndXU<<<BL_TH(2*Hp->ny,nTh),0,sStep>>>(d_u,RBnd);
 }
 
 void setVHalo(int TBnd, int BBnd){
-  gen_bndYL<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,BBnd);
-  gen_bndYU<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,TBnd);
+  int nTh=lCfg[LC_BND].nTh;
+
+  gen_bndYL<<<BL_TH(2*Hp->nx,nTh),0,sStep>>>(d_u,BBnd);
+  gen_bndYU<<<BL_TH(2*Hp->nx,nTh),0,sStep>>>(d_u,TBnd);
 }
 
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
@@ -104,8 +119,12 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 }
 
-void runPass(double dt, int dir){
+//Queue the pass in direction dir on sStep. If cdt is set the pass also
+//finds the CFL denominator of the updated mesh in st->den
+void runPass(int dir, int cdt){
   int np,nt;
+  int nTh=lCfg[LC_PRIM].nTh;
+  int nThTile=lCfg[LC_TILE].nTh;
   double dx;
   char dCh;
   char outLab[30];
@@ -117,14 +136,14 @@ void runPass(double dt, int dir){
     dx=Hp->dx;
     dCh='x';
     setHHalo(Hp->bndL,Hp->bndR);
-    toPrimX<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    toPrimX<<<BL_TH((np+4)*nt,nTh),0,sStep>>>(d_q,d_u);
   }else{
     np=Hp->ny;
     nt=Hp->nx;
     dx=Hp->dy;
     dCh='y';
     setVHalo(bndT,bndB);
-    toPrimY<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    toPrimY<<<BL_TH((np+4)*nt,nTh),0,sStep>>>(d_q,d_u);
   }
   //cudaMemcpy(h_ref,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"MESH-%c",dCh);
@@ -135,32 +154,168 @@ void runPass(double dt, int dir){
   //cudaMemcpy(h_ref,d_q,primSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"Q   -%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,np+4,nt,0,0);
-  trace<<<BL_TH((np+2)*nt,nTh)>>>(d_ql,d_qr,d_q,dt/dx,np,nt);
-  //cudaMemcpy(h_ref,d_ql,qSize*sizeof(double),cudaMemcpyDeviceToHost);
-  //sprintf(outLab,"QL  -%c",dCh);
-  //printArray(outLab,h_ref,Hp->nvar,np+2,nt,0,0);
-  //cudaMemcpy(h_ref,d_qr,qSize*sizeof(double),cudaMemcpyDeviceToHost);
-  //sprintf(outLab,"QR  -%c",dCh);
-  //printArray(outLab,h_ref,Hp->nvar,np+2,nt,0,0);
-  riemann<<<BL_TH((np+1)*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt);
-  //cudaMemcpy(h_ref,d_flx,flxSize*sizeof(double),cudaMemcpyDeviceToHost);
-  //sprintf(outLab,"FLX -%c",dCh);
-  //printArray(outLab,h_ref,Hp->nvar,np+1,nt,0,0);
-  if(dir==0){
-    addFluxX<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
-  }else{
-    addFluxY<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
-  }
+  //Trace, Riemann and flux update in one pass over tiles of the pencils
+  tile_flux<<<BL(np,nThTile)*nt,nThTile,TILE_SHMEM(nThTile),sStep>>>(d_u,d_q,d_st,dx,np,nt,dir,cdt);
   //cudaMemcpy(h_ref,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
   //sprintf(outLab,"POST-%c",dCh);
   //printArray(outLab,h_ref,Hp->nvar,Hp->nx,Hp->ny,2,2);
 }
 
+//Queue the CFL reduction over the mesh on sStep, returning the device
+//array whose first element will hold the result
+double *queueDenom(){
+  int nDen, redBlocks;
+  int nTh=lCfg[LC_CDT].nTh;
+  double *tmp;
+
+  nDen=nBlockM;
+  redBlocks=nDen;
+  calc_denom<<<nBlockM,nTh,nTh*sizeof(double),sStep>>>(d_u,d_denA);
+  while(redBlocks>1){
+    redBlocks=(nDen+2*nTh-1)/(2*nTh);
+    redu_max<<<redBlocks,nTh,nTh*sizeof(double),sStep>>>(d_denA,d_denB,nDen);
+    nDen=redBlocks;
+    tmp=d_denA;
+    d_denA=d_denB;
+    d_denB=tmp;
+  }
+  return d_denA;
+}
+
+//Queue one time step on sStep: dt and both passes, in the pass order of an
+//even or odd step. dt never leaves the device. The CFL denominator comes
+//from the last pass of the step before, or from a reduction over the mesh
+//if SEPARATE_CALCDT is defined
+void queueStep(int odd){
+  double *den;
+
+  if(FUSE_DT){
+    den=&d_st->den;
+  }else{
+    den=queueDenom();
+  }
+  calc_dt<<<1,1,0,sStep>>>(d_st,den,Ha->sigma);
+  if(odd==0){
+    //X Dir
+    runPass(0,0);
+    //Y Dir
+    runPass(1,FUSE_DT);
+  }else{
+    //Y Dir
+    runPass(1,0);
+    //X Dir
+    runPass(0,FUSE_DT);
+  }
+  end_step<<<1,1,0,sStep>>>(d_st);
+}
+
+//Sum variable var over the mesh on the device, copying back only the
+//per-block partial sums
+double sumVar(int var){
+  cudaError_t cuErrVar;
+  int nTh=lCfg[LC_CDT].nTh;
+
+  sum_var<<<nBlockM,nTh,nTh*sizeof(double),sStep>>>(d_u,var,d_sums);
+  cudaMemcpyAsync(h_sums,d_sums,nBlockM*sizeof(double),cudaMemcpyDeviceToHost,sStep);
+  cudaStreamSynchronize(sStep);
+  HANDLE_CUDA_ERROR(cuErrVar);
+  return sumArray(h_sums,0,nBlockM,1,0,0);
+}
+
+//Representative launches of the step kernels with nTh threads per block,
+//for tuneLaunch. The y primitives go first so the x pass tiles read the
+//q they expect
+void tunePrim(int nTh){
+  toPrimY<<<BL_TH((Hp->ny+4)*Hp->nx,nTh),0,sStep>>>(d_q,d_u);
+  toPrimX<<<BL_TH((Hp->nx+4)*Hp->ny,nTh),0,sStep>>>(d_q,d_u);
+}
+
+void tuneTile(int nTh){
+  tile_flux<<<BL(Hp->nx,nTh)*Hp->ny,nTh,TILE_SHMEM(nTh),sStep>>>(d_u,d_q,d_st,Hp->dx,Hp->nx,Hp->ny,0,1);
+}
+
+//Dynamic shared memory of a block of n threads
+size_t dblShmem(int n){
+  return n*sizeof(double);
+}
+
+size_t tileShmem(int n){
+  return TILE_SHMEM(n);
+}
+
+//Give every kernel the block size the occupancy calculator picks for it,
+//within what its registers and shared memory allow. The pass tiles of
+//tile_flux are as long as its blocks. The reductions halve their blocks
+//so need powers of 2
+void setLaunch(cudaDeviceProp *prop){
+  cudaFuncAttributes fa, fb;
+  int minG, occ, maxTh;
+
+  cudaFuncGetAttributes(&fa,gen_bndXL);
+  cudaOccupancyMaxPotentialBlockSize(&minG,&occ,gen_bndXL,0,0);
+  initLaunch(lCfg+LC_BND,"bnd",occ,fa.maxThreadsPerBlock,0,NULL);
+
+  cudaFuncGetAttributes(&fa,toPrimX);
+  cudaFuncGetAttributes(&fb,toPrimY);
+  maxTh=MIN(fa.maxThreadsPerBlock,fb.maxThreadsPerBlock);
+  cudaOccupancyMaxPotentialBlockSize(&minG,&occ,toPrimX,0,maxTh);
+  initLaunch(lCfg+LC_PRIM,"prim",occ,maxTh,0,tunePrim);
+
+  cudaFuncGetAttributes(&fa,tile_flux);
+  maxTh=((prop->sharedMemPerBlock-fa.sharedSizeBytes)/(NVAR*sizeof(double))-9)/4;
+  maxTh=MIN(maxTh,fa.maxThreadsPerBlock);
+  cudaOccupancyMaxPotentialBlockSizeVariableSMem(&minG,&occ,tile_flux,tileShmem,maxTh);
+  initLaunch(lCfg+LC_TILE,"tile",occ,maxTh,0,tuneTile);
+
+  cudaFuncGetAttributes(&fa,calc_denom);
+  cudaFuncGetAttributes(&fb,redu_max);
+  maxTh=MIN(fa.maxThreadsPerBlock,fb.maxThreadsPerBlock);
+  cudaOccupancyMaxPotentialBlockSizeVariableSMem(&minG,&occ,calc_denom,dblShmem,maxTh);
+  initLaunch(lCfg+LC_CDT,"cdt",occ,maxTh,1,NULL);
+}
+
+//Queue a download of the mesh into h_snap on sOut, behind the steps queued
+//so far. The steps queued after it wait for the copy on the device rather
+//than on the host
+void queueSnap(){
+  cudaEventRecord(snapReady,sStep);
+  cudaStreamWaitEvent(sOut,snapReady,0);
+  cudaMemcpyAsync(h_snap,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost,sOut);
+  cudaEventRecord(snapDone,sOut);
+  cudaStreamWaitEvent(sStep,snapDone,0);
+}
+
+//Copy the interior of the downloaded mesh into gMesh
+void unpackSnap(double *gMesh){
+  int i, j, k;
+
+  for(k=0;k<Hp->nvar;k++){
+    for(i=0;i<Hp->nx;i++){
+      for(j=0;j<Hp->ny;j++){
+        gMesh[(k*Hp->ny+j)*Hp->nx+i]=h_snap[(k*(Hp->ny+4)+j+2)*(Hp->nx+4)+i+2];
+      }
+    }
+  }
+}
+
+//Write the snapshot queued at step n on the writer thread, which has its
+//own copy, so h_snap is free for the next download while it is written
+void writeSnap(double *gMesh, int n){
+  char outfile[30];
+  cudaError_t cuErrVar;
+
+  cudaEventSynchronize(snapDone);
+  HANDLE_CUDA_ERROR(cuErrVar);
+  unpackSnap(gMesh);
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVisAsync(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+}
+
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
   int n, nV, lI, i,j,k;
   int bndL;
   int bndH;
-  double dt, dt_denom;
+  double dt;
   double cTime, nxttout;
 
   double volCell;
@@ -170,22 +325,25 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   double M_prec, E_prec;
   double *lMesh;
   double *recvMesh;
-  double *tmp, *d_denA, *d_denB;
 
   char outfile[30];
   char outLab[30];
 
   float runT;
+  double tPh;
+  int ph;
 
   //Cuda vars
   int dev;
   cudaDeviceProp prop;
-  int nDen, redBlocks;
+  int nB;
+  int snapQueued, snapN;
+  step_state st, tuneSt;
+  cudaGraph_t stepG;
+  cudaGraphExec_t stepGE[2];
   cudaError_t cuErrVar;
   int rpBl;
-  int mxTh, thWp;
-  int nBlockM;
-  int nThCDT, nThStep;
+  int mxTh;
   size_t shMpBl;
   size_t mem_reqd, mem_avail;
 
@@ -207,15 +365,10 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   mxTh=prop.maxThreadsPerBlock;
   shMpBl=prop.sharedMemPerBlock;
   rpBl=prop.regsPerBlock;
-  thWp=prop.warpSize;
-  nThCDT=mxTh;//thread upper bound
-  nThCDT=MIN(nThCDT,thWp*(rpBl/(CDT_REGS*thWp)));//register upper bound
-  nThStep=thWp;//thread upper bound
-  nThStep=MIN(nThStep,thWp*(rpBl/(STEP_REGS*thWp)));//register upper bound
-  nTh=nThCDT;
-  nBlockM=((Hp->ny*Hp->nx)+nTh-1)/nTh;
+  setLaunch(&prop);
+  HANDLE_CUDA_ERROR(cuErrVar);
+  nBlockM=((Hp->ny*Hp->nx)+lCfg[LC_CDT].nTh-1)/lCfg[LC_CDT].nTh;
   printf("Per block: Max threads %d, regs %d\n", mxTh,rpBl, shMpBl);
-  printf("Block size lims: cdt %d step %d\n",nThCDT,nThStep);
 
   n=0;
   cTime=0;
@@ -232,17 +385,13 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   meshSize=Hp->nvar*(Hp->nx+4)*(Hp->ny+4);
   if(Hp->ny>=Hp->nx){
     primSize=Hp->nvar*(Hp->nx+4)*Hp->ny;
-    qSize   =Hp->nvar*(Hp->nx+2)*Hp->ny;
-    flxSize =Hp->nvar*(Hp->nx+1)*Hp->ny;
   }else{
     primSize=Hp->nvar*(Hp->ny+4)*Hp->nx;
-    qSize   =Hp->nvar*(Hp->ny+2)*Hp->nx;
-    flxSize =Hp->nvar*(Hp->ny+1)*Hp->nx;
   }
   //printf("Done loc size calcs\n");
 
   //Print relative sizes of memory requirements
-  mem_reqd=(meshSize+primSize+2*qSize+flxSize)*sizeof(double);
+  mem_reqd=(meshSize+primSize)*sizeof(double);
   mem_avail=prop.totalGlobalMem;
   printf("%u/%u of %f%% memory required for a %d var %dx%d mesh\n",mem_reqd,mem_avail,
          ((double)mem_reqd/(double)mem_avail)*100.0,Hp->nvar,Hp->nx,Hp->ny);
@@ -260,15 +409,16 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_q,primSize*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_qr,qSize*sizeof(double));
+  cudaMalloc(&d_denA,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_ql,qSize*sizeof(double));
+  cudaMalloc(&d_denB,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_flx,flxSize*sizeof(double));
+  cudaMalloc(&d_sums,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_denA,nBlockM*sizeof(double));
+  cudaMalloc(&d_st,sizeof(step_state));
   HANDLE_CUDA_ERROR(cuErrVar);
-  cudaMalloc(&d_denB,nBlockM*sizeof(double));
+  h_sums=(double*)malloc(nBlockM*sizeof(double));
+  cudaMallocHost(&h_snap,meshSize*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
 
   //printf("Arrays allocated\n");
@@ -303,7 +453,7 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 #endif
 
   //Print initial condition
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
   writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
   printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
 
@@ -311,86 +461,125 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   cudaMemcpy(d_u,lMesh,meshSize*sizeof(double),cudaMemcpyHostToDevice);
   HANDLE_CUDA_ERROR(cuErrVar);
 
+  //Capture an even and an odd step as CUDA graphs so that a step is a
+  //single launch
+  cudaStreamCreate(&sStep);
+  //The step kernels are tuned on the initial mesh before the steps are
+  //captured. The tiny dt barely moves the mesh, which is put back anyway
+  tuneSt.dt=1.0e-30;
+  tuneSt.dtRun=0.0;
+  tuneSt.t=0.0;
+  tuneSt.tOut=-1.0;
+  tuneSt.den=0.0;
+  tuneSt.n=0;
+  cudaMemcpy(d_st,&tuneSt,sizeof(step_state),cudaMemcpyHostToDevice);
+  if(tuneLaunch(lCfg,NLAUNCH,prop.name,sStep,1)){
+    cudaMemcpy(d_u,lMesh,meshSize*sizeof(double),cudaMemcpyHostToDevice);
+  }
+  HANDLE_CUDA_ERROR(cuErrVar);
+  printLaunch(lCfg,NLAUNCH);
+  cudaStreamCreateWithFlags(&sOut,cudaStreamNonBlocking);
+  cudaEventCreateWithFlags(&snapReady,cudaEventDisableTiming);
+  cudaEventCreateWithFlags(&snapDone,cudaEventDisableTiming);
+  snapQueued=0;
+  snapN=0;
+  for(k=0;k<2;k++){
+    cudaStreamBeginCapture(sStep,cudaStreamCaptureModeGlobal);
+    queueStep(k);
+    cudaStreamEndCapture(sStep,&stepG);
+    cudaGraphInstantiateWithFlags(&stepGE[k],stepG,0);
+    cudaGraphDestroy(stepG);
+    HANDLE_CUDA_ERROR(cuErrVar);
+  }
+
+  st.dt=0.0;
+  st.dtRun=0.0;
+  st.t=cTime;
+  st.tOut=nxttout;
+  st.den=0.0;
+  st.n=n;
+  cudaMemcpy(d_st,&st,sizeof(step_state),cudaMemcpyHostToDevice);
+  HANDLE_CUDA_ERROR(cuErrVar);
+  //The first step needs its CFL denominator from the mesh
+  if(FUSE_DT){
+    cudaMemcpyAsync(&d_st->den,queueDenom(),sizeof(double),cudaMemcpyDeviceToDevice,sStep);
+    HANDLE_CUDA_ERROR(cuErrVar);
+  }
+
+  //A step is a single graph launch, so only the host side output is timed
+  //on its own
+  initTiming(&Ht,"CUDA","GPU",1,1);
+  for(ph=0;ph<NPHASE;ph++){
+    if(ph!=PH_OUTPUT)Ht.phase[ph]=-1.0;
+  }
+
   //Get start time  
   cudaEventCreate(&start);
   cudaEventCreate(&end);
   cudaEventRecord(start,0);
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
-    //Calculate timestep
-    dt=0.0;
-    nDen=nBlockM;
-    redBlocks=nDen;
-    nTh=nThCDT;
-    //cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
-    //printArray("Mesh",lMesh,4,Hp->nx,Hp->ny,2,2);
-    calc_denom<<<nBlockM,nTh,nTh*sizeof(double)>>>(d_u,d_denA);
-    //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
-    //printArray("Dens",recvMesh,1,nDen,1,0,0);
-    while(redBlocks>1){
-      redBlocks=(nDen+2*nTh-1)/(2*nTh);
-      redu_max<<<redBlocks,nTh,nTh*sizeof(double)>>>(d_denA,d_denB,nDen);
-      nDen=redBlocks;
-      //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
-      //printArray("Dens",recvMesh,1,nDen,1,0,0);
-      tmp=d_denA;
-      d_denA=d_denB;
-      d_denB=tmp;
-    }
-    cudaMemcpy(&dt_denom,d_denA,sizeof(double),cudaMemcpyDeviceToHost);
-    //printf("ITER %d denom=%g\n",n,dt_denom);
-    dt=0.5*Ha->sigma/dt_denom;
-    if(nxttout>0.0&&dt>(nxttout-cTime)){
-      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
-      dt=(nxttout-cTime);
+    //Launch the steps up to the next one the host has to look at
+    nB=Ha->nprtLine-n%Ha->nprtLine;
+    if(Ha->noutput>0&&Ha->noutput-n%Ha->noutput<nB)nB=Ha->noutput-n%Ha->noutput;
+    if(Ha->nstepmax>=0&&Ha->nstepmax-n<nB)nB=Ha->nstepmax-n;
+    NVTX_PUSH("steps");
+    for(k=0;k<nB;k++){
+      cudaGraphLaunch(stepGE[(Hp->nstep+n+k)%2],sStep);
     }
-    //break;
-    if(n%2==0){
-      //X Dir
-      runPass(dt,0);
-      //Y Dir
-      runPass(dt,1);
-    }else{
-      //Y Dir
-      runPass(dt,1);
-      //X Dir
-      runPass(dt,0);
+    //The snapshot queued before these steps is written while they run
+    if(snapQueued){
+      PH_START(tPh);
+      writeSnap(gMesh,snapN);
+      snapQueued=0;
+      PH_ADD(Ht.phase,PH_OUTPUT,tPh);
     }
-    n+=1;
-    cTime+=dt;
-    if(n%Ha->nprtLine==0||(cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
-      cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
-      HANDLE_CUDA_ERROR(cuErrVar);
-      if(n%Ha->nprtLine==0){
-        TM=sumArray(lMesh,VARRHO,Hp->nx,Hp->ny,2,2);
-        TE=sumArray(lMesh,VARPR ,Hp->nx,Hp->ny,2,2);
-        printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
-        if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
-          printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(TM-oTM),volCell*(TE-oTE));
-          printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(TM-oTM)/oTM,100.0*(TE-oTE)/oTE);
+    //Steps are held once an output time is reached, so st.n counts the
+    //steps actually taken
+    cudaMemcpyAsync(&st,d_st,sizeof(step_state),cudaMemcpyDeviceToHost,sStep);
+    cudaStreamSynchronize(sStep);
+    HANDLE_CUDA_ERROR(cuErrVar);
+    n=st.n;
+    cTime=st.t;
+    dt=st.dtRun;
+    NVTX_POP();
+    PH_START(tPh);
+    NVTX_PUSH("output");
+    if(n%Ha->nprtLine==0){
+      TM=sumVar(VARRHO);
+      TE=sumVar(VARPR );
+      printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+      if(0&&(fabs(TM-oTM)>0.0||fabs(TE-oTE)>0.0)){
+        printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(TM-oTM),volCell*(TE-oTE));
+        printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(TM-oTM)/oTM,100.0*(TE-oTE)/oTE);
 #ifdef M_PREC_CMP
-          printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
+        printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
 #endif
-        }
       }
-      if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
-        printf("Vis file @ time %f iter %d\n",cTime,n);
-        if(cTime>=nxttout&&nxttout>0.0){
-          nxttout+=Ha->dtoutput;
-          if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
-          printf("Next Vis Time: %f\n",nxttout);
-        }
-        for(k=0;k<Hp->nvar;k++){
-          for(i=0;i<Hp->nx;i++){
-	    for(j=0;j<Hp->ny;j++){
-              gMesh[(k*Hp->ny+j)*Hp->nx+i]=lMesh[(k*(Hp->ny+4)+j+2)*(Hp->nx+4)+i+2];
-	    }
-	  }
-        }
-        snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-        writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    }
+    if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(cTime>=nxttout&&nxttout>0.0){
+        nxttout+=Ha->dtoutput;
+        if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
+        printf("Next Vis Time: %f\n",nxttout);
+        //Release the held steps
+        st.tOut=nxttout;
+        cudaMemcpy(d_st,&st,sizeof(step_state),cudaMemcpyHostToDevice);
+        HANDLE_CUDA_ERROR(cuErrVar);
       }
+      queueSnap();
+      HANDLE_CUDA_ERROR(cuErrVar);
+      snapQueued=1;
+      snapN=n;
     }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+    NVTX_POP();
+  }
+  if(snapQueued){
+    PH_START(tPh);
+    writeSnap(gMesh,snapN);
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
   }
   printf("time: %f, %d iters run\n",cTime,n);
 
@@ -398,32 +587,42 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   cudaEventRecord(end,0);
   cudaEventElapsedTime(&runT,start,end);
 
-  printf("TFMT:%s,%s,%s,%s,%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-  printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"CUDA\"","\"GPU:?\"","\"Init\"",1,1,n,Hp->nx*Hp->ny,runT*1.0e-3);
+  Ht.niters=n;
+  Ht.ncells=Hp->nx*Hp->ny;
+  Ht.runt=runT*1.0e-3;
+  printTiming(&Ht,Ha);
 
   //Print final condition
-  cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
+  cudaMemcpy(h_snap,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
   HANDLE_CUDA_ERROR(cuErrVar);
-  for(k=0;k<Hp->nvar;k++){
-    for(i=0;i<Hp->nx;i++){
-      for(j=0;j<Hp->ny;j++){
-        gMesh[(k*Hp->ny+j)*Hp->nx+i]=lMesh[(k*(Hp->ny+4)+j+2)*(Hp->nx+4)+i+2];
-      }
-    }
-  }
-  snprintf(outfile,29,"%s%05d",Ha->outPre,n);
+  unpackSnap(gMesh);
+  waitVis();
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
   writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
   Hp->t+=cTime;
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestart(Ha->chkFile,gMesh,Hp);
 
   free(recvMesh);
   free(lMesh);
   cudaFree(d_u  );
   cudaFree(d_q  );
-  cudaFree(d_qr );
-  cudaFree(d_ql );
-  cudaFree(d_flx);
   cudaFree(d_denA);
   cudaFree(d_denB);
+  cudaFree(d_sums);
+  cudaFree(d_st);
+  free(h_sums);
+  cudaFreeHost(h_snap);
+  cudaEventDestroy(snapReady);
+  cudaEventDestroy(snapDone);
+  cudaStreamDestroy(sOut);
+  cudaGraphExecDestroy(stepGE[0]);
+  cudaGraphExecDestroy(stepGE[1]);
+  cudaStreamDestroy(sStep);
 
   printf("Returning from engine\n");
 }
+
+//Nothing is kept between engine calls
+void freeScratch(){
+}
@@ -8,6 +8,7 @@
 #define VARVX  1
 #define VARVY  2
 #define VARPR  3
+#define NVAR   4
 
 #define BND_REFL 0
 #define BND_PERM 1
@@ -16,4 +17,13 @@
 #define BL(totTh, maxTh) ((totTh)+(maxTh)-1)/(maxTh)
 #define BL_TH(totTh, maxTh) ((totTh)+(maxTh)-1)/(maxTh),(maxTh)
 
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//reduction over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
 #endif //HYDRO_DEFS_H_
@@ -4,11 +4,12 @@
 
 #include "dev_funcs.h"
 #include "hydro_defs.h"
+#include "riemann_approx.h"
 
 __device__ __constant__ int d_nx, d_ny, d_nvar;
 __device__ __constant__ double d_gamma, d_dx, d_dy;
 __device__ __constant__ double d_smallr, d_smallc, d_smallp;
-__device__ __constant__ int d_niterR;
+__device__ __constant__ int d_niterR, d_scheme;
 
 void print_cuda_err(char *file, const char *func, int line, cudaError_t err){
   fprintf(stderr,"CUDA error in %s: %s(%d):\n",file,func,line);
@@ -33,6 +34,8 @@ void device_init(hydro_prob *Hp, hydro_args *Ha, int ny){
   HANDLE_CUDA_ERROR(errVar);
   cudaMemcpyToSymbol(d_ny,&(ny),sizeof(int));
   HANDLE_CUDA_ERROR(errVar);
+  cudaMemcpyToSymbol(d_nvar,&(Hp->nvar),sizeof(int));
+  HANDLE_CUDA_ERROR(errVar);
   cudaMemcpyToSymbol(d_dx,&(Hp->dx),sizeof(double));
   HANDLE_CUDA_ERROR(errVar);
   cudaMemcpyToSymbol(d_dy,&(Hp->dy),sizeof(double));
@@ -47,17 +50,37 @@ void device_init(hydro_prob *Hp, hydro_args *Ha, int ny){
   HANDLE_CUDA_ERROR(errVar);
   cudaMemcpyToSymbol(d_niterR,&(Ha->niter_riemann),sizeof(int));
   HANDLE_CUDA_ERROR(errVar);
+  cudaMemcpyToSymbol(d_scheme,&(Ha->scheme),sizeof(int));
+  HANDLE_CUDA_ERROR(errVar);
 }
 
 extern __shared__ double dynVar[];
+
+//CFL denominator of one cell from its conserved variables
+__device__ double cell_denom(double rho, double vx, double vy, double eint){
+    double eken, p, c;
+    double courx, coury;
+
+    rho=fmax(rho,d_smallr);
+    vx=vx/rho;
+    vy=vy/rho;
+    eken=0.5*(vx*vx+vy*vy);
+    eint=eint/rho-eken;
+
+    p=fmax((d_gamma-(double)1.0)*rho*eint,rho*d_smallp);
+    c=sqrt(d_gamma*p/rho);
+
+    courx=(c+fabs(vx))/d_dx;
+    coury=(c+fabs(vy))/d_dy;
+    return courx+coury;
+}
+
 __global__ void calc_denom(double *u, double *den){
 double *denom=dynVar;
     uint stInd, i,j;
     int thInd;
     int mxInd, stride;
-    double rho, vx, vy, eken, eint;
-    double p, c;
-    double courx, coury;
+    double rho, vx, vy, eint;
 
     //Calculate indicies
     thInd=threadIdx.x;
@@ -71,18 +94,7 @@ double *denom=dynVar;
       vx  =u[(VARVX *(d_ny+4)+j+2)*(d_nx+4)+i+2];
       vy  =u[(VARVY *(d_ny+4)+j+2)*(d_nx+4)+i+2];
       eint=u[(VARPR *(d_ny+4)+j+2)*(d_nx+4)+i+2];
-      rho=fmax(rho,d_smallr);
-      vx=vx/rho;
-      vy=vy/rho;
-      eken=0.5*(vx*vx+vy*vy);
-      eint=eint/rho-eken;
-
-      p=fmax((d_gamma-(double)1.0)*rho*eint,rho*d_smallp);
-      c=sqrt(d_gamma*p/rho);
-
-      courx=(c+fabs(vx))/d_dx;
-      coury=(c+fabs(vy))/d_dy;
-      denom[thInd]=courx+coury;
+      denom[thInd]=cell_denom(rho,vx,vy,eint);
     }
     //Reduce to maximum value of denomenator over whole mesh.
     __syncthreads();
@@ -129,6 +141,47 @@ __global__ void redu_max(double *arrIn, double *arrOut, int nVals){
     if(thInd==0)arrOut[blockIdx.x]=arr[0];
 }
 
+//Mass, energy and non-finite cell count of the interior cells of each
+//block into diag[blockIdx.x], diag[gridDim.x+blockIdx.x] and
+//diag[2*gridDim.x+blockIdx.x]. Needs 3*blockDim.x doubles of shared memory
+__global__ void diag_part(double *u, double *diag){
+    double *mass=dynVar;
+    double *ene=dynVar+blockDim.x;
+    double *bad=dynVar+2*blockDim.x;
+    int thInd, stInd, stride;
+    int i, j, nV;
+
+    thInd=threadIdx.x;
+    stInd=threadIdx.x+blockDim.x*blockIdx.x;
+    mass[thInd]=0.0;
+    ene[thInd]=0.0;
+    bad[thInd]=0.0;
+    if(stInd<d_nx*d_ny){
+      i=stInd%d_nx;
+      j=stInd/d_nx;
+      mass[thInd]=u[(VARRHO*(d_ny+4)+j+2)*(d_nx+4)+i+2];
+      ene[thInd] =u[(VARPR *(d_ny+4)+j+2)*(d_nx+4)+i+2];
+      for(nV=0;nV<d_nvar;nV++){
+        if(!isfinite(u[(nV*(d_ny+4)+j+2)*(d_nx+4)+i+2]))bad[thInd]=1.0;
+      }
+    }
+    __syncthreads();
+    //Pairwise, so any block size works
+    for(stride=1;stride<blockDim.x;stride<<=1){
+      if(thInd%(2*stride)==0&&thInd+stride<blockDim.x){
+        mass[thInd]+=mass[thInd+stride];
+        ene[thInd] +=ene[thInd+stride];
+        bad[thInd] +=bad[thInd+stride];
+      }
+      __syncthreads();
+    }
+    if(thInd==0){
+      diag[blockIdx.x]            =mass[0];
+      diag[gridDim.x+blockIdx.x]  =ene[0];
+      diag[2*gridDim.x+blockIdx.x]=bad[0];
+    }
+}
+
 __global__ void gen_bndXL(double *u, int bndT){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd%2;
@@ -229,6 +282,28 @@ __global__ void gen_bndYU(double *u, int bndT){
   } 
 }
 
+__global__ void pack_rows(double *buf, double *u, int j0){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int row=2*(d_nx+4);
+  int k=thInd%row;
+  int v=thInd/row;
+
+  if(v<d_nvar){
+    buf[thInd]=u[k+(d_nx+4)*(j0+(d_ny+4)*v)];
+  }
+}
+
+__global__ void unpack_rows(double *u, double *buf, int j0){
+  int thInd=threadIdx.x+blockDim.x*blockIdx.x;
+  int row=2*(d_nx+4);
+  int k=thInd%row;
+  int v=thInd/row;
+
+  if(v<d_nvar){
+    u[k+(d_nx+4)*(j0+(d_ny+4)*v)]=buf[thInd];
+  }
+}
+
 __global__ void toPrimX(double *q, double *u){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd%(d_nx+4);
@@ -248,10 +323,11 @@ __global__ void toPrimX(double *q, double *u){
   }
 }
 
-__global__ void toPrimY(double *q, double *u){
+//Converts rows j0 to j0+nj-1 of u, counting the halo rows
+__global__ void toPrimY(double *q, double *u, int j0, int nj){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd/(d_ny+4);
-  int j=thInd%(d_ny+4);
+  int i=thInd/nj;
+  int j=j0+thInd%nj;
   double r, vx, vy, eint, p;
 
   if(i<d_nx){
@@ -278,10 +354,11 @@ __device__ double slope(double *q, int ind){
   return dsgn*fmin(dlim,fabs(dcen));
 }
 
-__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt){
+//Traces cells i0 to i0+ni-1 of the np+2 in each pencil
+__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt, int i0, int ni){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+2);
-  int j=thInd/(np+2);
+  int i=i0+thInd%ni;
+  int j=thInd/ni;
   double  r,  u,  v1,  p;
   double dr, du, dv1, dp;
   double cc, csq;
@@ -336,10 +413,11 @@ __global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, in
   }
 }
 
-__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
+//Solves interfaces i0 to i0+ni-1 of the np+1 in each pencil
+__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt, int i0, int ni){
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
-  int i=thInd%(np+1);
-  int j=thInd/(np+1);
+  int i=i0+thInd%ni;
+  int j=thInd/ni;
   int n;
   double gmma6, entho, smallpp;
   double qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
@@ -366,6 +444,17 @@ __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
     vyr=     qxp[i+1+(np+2)*(j+nt*VARVY )];
     pr =fmax(qxp[i+1+(np+2)*(j+nt*VARPR )],rl*d_smallp);
 
+    //The approximate solvers of hydro_args.scheme, see riemann_approx.h.
+    //d_scheme is uniform, so the warps do not diverge on it
+    if(d_scheme==SCHEME_HLLC){
+      hllcFlux(d_gamma,rl,vxl,vyl,pl,rr,vxr,vyr,fmax(pr,rr*d_smallp),flx+i+(np+1)*j,(np+1)*nt);
+      return;
+    }
+    if(d_scheme==SCHEME_HLL){
+      hllFlux(d_gamma,rl,vxl,vyl,pl,rr,vxr,vyr,fmax(pr,rr*d_smallp),flx+i+(np+1)*j,(np+1)*nt);
+      return;
+    }
+
     cl=d_gamma*pl*rl;
     cr=d_gamma*pr*rr;
 
@@ -444,10 +533,13 @@ __global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt){
   }
 }
 
-__global__ void addFluxX(double *u, double *flx, double dtdx){
+__global__ void addFluxX(double *u, double *flx, double dtdx, double *den){
+  double *dens=dynVar;
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd%d_nx;
   int j=thInd/d_nx;
+  int stride;
+  double cDen=0.0;
 
   if(j<d_ny){
     u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)]+=dtdx*(flx[i  +(d_nx+1)*(j+d_ny*VARRHO)]-
@@ -458,13 +550,34 @@ __global__ void addFluxX(double *u, double *flx, double dtdx){
                                                  flx[i+1+(d_nx+1)*(j+d_ny*VARVY )]);
     u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARPR )]+=dtdx*(flx[i  +(d_nx+1)*(j+d_ny*VARPR )]-
                                                  flx[i+1+(d_nx+1)*(j+d_ny*VARPR )]);
+    if(den!=NULL){
+      cDen=cell_denom(u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)],u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVX)],
+                      u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVY )],u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARPR)]);
+    }
+  }
+  if(den==NULL)return;
+  //Max over the block, then over the blocks. The denominators are positive
+  //so they order like their bit patterns
+  dens[threadIdx.x]=cDen;
+  __syncthreads();
+  for(stride=1;stride<blockDim.x;stride<<=1){
+    if(threadIdx.x%(2*stride)==0&&threadIdx.x+stride<blockDim.x){
+      dens[threadIdx.x]=fmax(dens[threadIdx.x],dens[threadIdx.x+stride]);
+    }
+    __syncthreads();
+  }
+  if(threadIdx.x==0){
+    atomicMax((unsigned long long*)den,(unsigned long long)__double_as_longlong(dens[0]));
   }
 }
 
-__global__ void addFluxY(double *u, double *flx, double dtdx){
+__global__ void addFluxY(double *u, double *flx, double dtdx, double *den){
+  double *dens=dynVar;
   int thInd=threadIdx.x+blockDim.x*blockIdx.x;
   int i=thInd/d_ny;
   int j=thInd%d_ny;
+  int stride;
+  double cDen=0.0;
 
   if(i<d_nx){
     u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARRHO)]-
@@ -475,6 +588,24 @@ __global__ void addFluxY(double *u, double *flx, double dtdx){
                                                  flx[j+1+(d_ny+1)*(i+d_nx*VARVX )]);
     u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARPR )]+=dtdx*(flx[j  +(d_ny+1)*(i+d_nx*VARPR )]-
                                                  flx[j+1+(d_ny+1)*(i+d_nx*VARPR )]);
+    if(den!=NULL){
+      cDen=cell_denom(u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARRHO)],u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVX)],
+                      u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARVY )],u[i+2+(d_nx+4)*(j+2+(d_ny+4)*VARPR)]);
+    }
+  }
+  if(den==NULL)return;
+  //Max over the block, then over the blocks. The denominators are positive
+  //so they order like their bit patterns
+  dens[threadIdx.x]=cDen;
+  __syncthreads();
+  for(stride=1;stride<blockDim.x;stride<<=1){
+    if(threadIdx.x%(2*stride)==0&&threadIdx.x+stride<blockDim.x){
+      dens[threadIdx.x]=fmax(dens[threadIdx.x],dens[threadIdx.x+stride]);
+    }
+    __syncthreads();
+  }
+  if(threadIdx.x==0){
+    atomicMax((unsigned long long*)den,(unsigned long long)__double_as_longlong(dens[0]));
   }
 }
 
@@ -13,19 +13,29 @@ void device_init(hydro_prob *Hp, hydro_args *Ha, int ny);
 
 __global__ void calc_denom(double *u, double *den);
 __global__ void redu_max(double *arrIn, double *arrOut, int nVals);
+//Per block mass, energy and non-finite cell count of the interior, for the
+//progress lines. Needs 3*blockDim.x doubles of shared memory
+__global__ void diag_part(double *u, double *diag);
 
 __global__ void gen_bndXL(double *u, int bnd);
 __global__ void gen_bndXU(double *u, int bnd);
 __global__ void gen_bndYL(double *u, int bnd);
 __global__ void gen_bndYU(double *u, int bnd);
 
+//Halo rows j0 and j0+1 of every variable to and from a contiguous buffer,
+//one thread per value
+__global__ void pack_rows(double *buf, double *u, int j0);
+__global__ void unpack_rows(double *u, double *buf, int j0);
+
 __global__ void toPrimX(double *q, double *u);
-__global__ void toPrimY(double *q, double *u);
+__global__ void toPrimY(double *q, double *u, int j0, int nj);
 
-__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt);
-__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt);
+__global__ void trace(double *ql, double *qr, double *q, double dtdx, int np, int nt, int i0, int ni);
+__global__ void riemann(double *flx, double *qxm, double *qxp, int np, int nt, int i0, int ni);
 
-__global__ void addFluxX(double *u, double *flx, double dtdx);
-__global__ void addFluxY(double *u, double *flx, double dtdx);
+//With den set, addFluxX and addFluxY also fold the CFL denominator of the
+//updated cells into den[0], and need blockDim.x doubles of shared memory
+__global__ void addFluxX(double *u, double *flx, double dtdx, double *den);
+__global__ void addFluxY(double *u, double *flx, double dtdx, double *den);
 
 #endif
@@ -1,30 +1,41 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 #include <omp.h>
 #include <mpi.h>
+#if defined(OPEN_MPI)&&OMPI_MAJOR_VERSION>=2
+#include <mpi-ext.h>
+#endif
 #include <float.h>
 #include "hydro.h"
+#include "restart.h"
 #include "dev_funcs.h"
-#include "outfile.h"
-
-#define CDT_REGS 64
-#define STEP_REGS 64
+#include "outfile_mpi.h"
+#include "timing.h"
+#include "launch.h"
 
 hydro_args *Ha;
 hydro_prob *Hp;
+hydro_timing Ht;
 double *lMesh;
+double *visMesh;
 double *bndLS, *bndLR, *bndHS, *bndHR;
+double *d_bndLS, *d_bndLR, *d_bndHS, *d_bndHR;
 double *d_u;
 double *d_q;
 double *d_qr, *d_ql;
 double *d_flx;
+double *d_den;
 
 //temp variable to store data for checking
 double *h_ref;
 
 //CUDA vars
-int nTh;
+//Block sizes of the boundary and halo, primitive, trace, Riemann, flux
+//update and reduction kernels, see setLaunch
+enum {LC_BND, LC_PRIM, LC_TRACE, LC_RIEM, LC_FLUX, LC_CDT, NLAUNCH};
+launch_cfg lCfg[NLAUNCH];
 
 //MPI Vars
 int bndT, bndB;
@@ -32,6 +43,29 @@ int pProc, nProc;
 int rank, size;
 int myNy;
 int varSize;
+int cudaMPI;
+MPI_Request vReqs[4];
+cudaStream_t sComp, sHalo;
+cudaEvent_t haloDone;
+//Snapshots are downloaded into pinned memory on sOut behind the steps
+cudaStream_t sOut;
+double *h_snap;
+cudaEvent_t snapReady, snapDone;
+
+//Mass and energy sums with their Neumaier corrections, and the number of
+//cells holding a NaN or Inf, for one progress line
+typedef struct {
+  double sum[2], corr[2];
+  int nans;
+} mesh_diag;
+
+//Progress line of step n whose rank partials are in flight to rank 0
+typedef struct {
+  MPI_Request req;
+  double part[5], *parts;
+  int pend, n;
+  double t, dt;
+} diag_line;
 
 void printArray(char* label,double *arr, int nvar, int nx, int ny){
   int nV,i,j;
@@ -54,31 +88,85 @@ void printArray(char* label,double *arr, int nvar, int nx, int ny){
   }
 }
 
+//Bind this rank to one of the GPUs of its node, round robin over the
+//ranks that share the node
+int bindDevice(){
+  int lRank, nDev, dev;
+#if MPI_VERSION>=3
+  MPI_Comm node;
+
+  MPI_Comm_split_type(MPI_COMM_WORLD,MPI_COMM_TYPE_SHARED,0,MPI_INFO_NULL,&node);
+  MPI_Comm_rank(node,&lRank);
+  MPI_Comm_free(&node);
+#else
+  //No shared memory communicator before MPI 3, so ask the launcher
+  char *env;
+
+  lRank=0;
+  if((env=getenv("OMPI_COMM_WORLD_LOCAL_RANK"))||
+     (env=getenv("MV2_COMM_WORLD_LOCAL_RANK"))||
+     (env=getenv("SLURM_LOCALID")))lRank=atoi(env);
+#endif
+  cudaGetDeviceCount(&nDev);
+  dev=(nDev>0)?lRank%nDev:0;
+  cudaSetDevice(dev);
+  return dev;
+}
+
+//Whether MPI takes device pointers. Define CUDA_AWARE_MPI as 1 or 0 to
+//override the check, which only Open MPI offers
+int mpiTakesDevPtrs(){
+#if defined(CUDA_AWARE_MPI)
+  return CUDA_AWARE_MPI;
+#elif defined(MPIX_CUDA_AWARE_SUPPORT)&&MPIX_CUDA_AWARE_SUPPORT
+  return MPIX_Query_cuda_support();
+#else
+  return 0;
+#endif
+}
+
 void setHHalo(int LBnd, int RBnd){
+  int nTh=lCfg[LC_BND].nTh;
+
   gen_bndXL<<<BL_TH(2*myNy,nTh)>>>(d_u,LBnd);
   gen_bndXU<<<BL_TH(2*myNy,nTh)>>>(d_u,RBnd);
 }
 
-void setVHalo(int TBnd, int BBnd){
-  int row=Hp->nx+4;
-  int nV;
-  MPI_Request reqs[16];
-  MPI_Status stat[16];
-  for(nV=0;nV<Hp->nvar;nV++){
-    cudaMemcpy(lMesh+(2   )*row+nV*varSize,d_u+(2   )*row+nV*varSize,2*row*sizeof(double),cudaMemcpyDeviceToHost);
-    cudaMemcpy(lMesh+(myNy)*row+nV*varSize,d_u+(myNy)*row+nV*varSize,2*row*sizeof(double),cudaMemcpyDeviceToHost);
-    MPI_Irecv(lMesh+(     0)*row+nV*varSize,2*row,MPI_DOUBLE,pProc,1+2*nV,MPI_COMM_WORLD,reqs+ 0+nV);
-    MPI_Isend(lMesh+(     2)*row+nV*varSize,2*row,MPI_DOUBLE,pProc,2+2*nV,MPI_COMM_WORLD,reqs+ 4+nV);
-    MPI_Irecv(lMesh+(myNy+2)*row+nV*varSize,2*row,MPI_DOUBLE,nProc,2+2*nV,MPI_COMM_WORLD,reqs+ 8+nV);
-    MPI_Isend(lMesh+(myNy  )*row+nV*varSize,2*row,MPI_DOUBLE,nProc,1+2*nV,MPI_COMM_WORLD,reqs+12+nV);
-  }
-  MPI_Waitall(16,reqs,stat);
-  for(nV=0;nV<Hp->nvar;nV++){
-    cudaMemcpy(d_u+(     0)*row+nV*varSize,lMesh+(     0)*row+nV*varSize,2*row*sizeof(double),cudaMemcpyHostToDevice);
-    cudaMemcpy(d_u+(myNy+2)*row+nV*varSize,lMesh+(myNy+2)*row+nV*varSize,2*row*sizeof(double),cudaMemcpyHostToDevice);
+//Pack the two edge rows of every variable into one device buffer per
+//neighbour on sHalo, and stage them to the host unless MPI takes device
+//pointers
+void sendVHalo(){
+  int nB=2*(Hp->nx+4)*Hp->nvar;
+  int nTh=lCfg[LC_BND].nTh;
+
+  if(pProc!=MPI_PROC_NULL){
+    pack_rows<<<BL_TH(nB,nTh),0,sHalo>>>(d_bndLS,d_u,2);
+    if(!cudaMPI)cudaMemcpyAsync(bndLS,d_bndLS,nB*sizeof(double),cudaMemcpyDeviceToHost,sHalo);
+  }
+  if(nProc!=MPI_PROC_NULL){
+    pack_rows<<<BL_TH(nB,nTh),0,sHalo>>>(d_bndHS,d_u,myNy);
+    if(!cudaMPI)cudaMemcpyAsync(bndHS,d_bndHS,nB*sizeof(double),cudaMemcpyDeviceToHost,sHalo);
+  }
+}
+
+//Exchange the rows packed by sendVHalo and fill the halo rows on sHalo
+void recvVHalo(int TBnd, int BBnd){
+  int nB=2*(Hp->nx+4)*Hp->nvar;
+  int nTh=lCfg[LC_BND].nTh;
+  MPI_Status stat[4];
+  cudaStreamSynchronize(sHalo);
+  MPI_Startall(4,vReqs);
+  MPI_Waitall(4,vReqs,stat);
+  if(pProc!=MPI_PROC_NULL){
+    if(!cudaMPI)cudaMemcpyAsync(d_bndLR,bndLR,nB*sizeof(double),cudaMemcpyHostToDevice,sHalo);
+    unpack_rows<<<BL_TH(nB,nTh),0,sHalo>>>(d_u,d_bndLR,0);
+  }
+  if(nProc!=MPI_PROC_NULL){
+    if(!cudaMPI)cudaMemcpyAsync(d_bndHR,bndHR,nB*sizeof(double),cudaMemcpyHostToDevice,sHalo);
+    unpack_rows<<<BL_TH(nB,nTh),0,sHalo>>>(d_u,d_bndHR,myNy+2);
   }
-  gen_bndYL<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,TBnd);
-  gen_bndYU<<<BL_TH(2*Hp->nx,nTh)>>>(d_u,BBnd);
+  gen_bndYL<<<BL_TH(2*Hp->nx,nTh),0,sHalo>>>(d_u,TBnd);
+  gen_bndYU<<<BL_TH(2*Hp->nx,nTh),0,sHalo>>>(d_u,BBnd);
 }
 
 double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
@@ -108,6 +196,75 @@ double sumArray(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return gsum+gcorr;
 }
 
+void neumaierAdd(double *sum, double *corr, double v){
+  double t;
+
+  t=*sum+v;
+  if(fabs(*sum)>=fabs(v)){
+    *corr+=(*sum-t)+v;
+  }else{
+    *corr+=(v-t)+*sum;
+  }
+  *sum=t;
+}
+
+//Fold the per block partials diag_part left in part, nBlk blocks of each,
+//into dg in block order
+void foldDiag(mesh_diag *dg, double *part, int nBlk){
+  int i;
+
+  memset(dg,0,sizeof(*dg));
+  for(i=0;i<nBlk;i++){
+    neumaierAdd(&dg->sum[0],&dg->corr[0],part[i]);
+    neumaierAdd(&dg->sum[1],&dg->corr[1],part[nBlk+i]);
+    dg->nans+=(int)part[2*nBlk+i];
+  }
+}
+
+//Start gathering the diagnostics dg of step n to rank 0 for its progress
+//line. The gather completes in finishDiag, after the next step has run
+void postDiag(diag_line *ln, mesh_diag *dg, int n, double t, double dt){
+  ln->part[0]=dg->sum[0];
+  ln->part[1]=dg->corr[0];
+  ln->part[2]=dg->sum[1];
+  ln->part[3]=dg->corr[1];
+  ln->part[4]=dg->nans;
+  ln->n=n;
+  ln->t=t;
+  ln->dt=dt;
+  ln->pend=1;
+#if MPI_VERSION>=3
+  MPI_Igather(ln->part,5,MPI_DOUBLE,ln->parts,5,MPI_DOUBLE,0,MPI_COMM_WORLD,&ln->req);
+#else
+  MPI_Gather(ln->part,5,MPI_DOUBLE,ln->parts,5,MPI_DOUBLE,0,MPI_COMM_WORLD);
+#endif
+}
+
+//Complete the pending gather of ln, if any, and on rank 0 combine the rank
+//partials in rank order into TM and TE. Returns 1 if a line was pending
+int finishDiag(diag_line *ln, double *TM, double *TE, int *nans){
+  int i;
+  double sum[2]={0.0}, corr[2]={0.0};
+
+  if(!ln->pend)return 0;
+  ln->pend=0;
+#if MPI_VERSION>=3
+  MPI_Wait(&ln->req,MPI_STATUS_IGNORE);
+#endif
+  if(rank!=0)return 1;
+  *nans=0;
+  for(i=0;i<size;i++){
+    neumaierAdd(&sum[0],&corr[0],ln->parts[5*i  ]);
+    corr[0]+=ln->parts[5*i+1];
+    neumaierAdd(&sum[1],&corr[1],ln->parts[5*i+2]);
+    corr[1]+=ln->parts[5*i+3];
+    *nans+=(int)ln->parts[5*i+4];
+  }
+  *TM=sum[0]+corr[0];
+  *TE=sum[1]+corr[1];
+  return 1;
+}
+
 int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy);
 
 void nanScan(int *ret, double *mesh, int nvar, int nx, int ny, int nHx, int nHy){
@@ -135,63 +292,244 @@ int nansIn(double *mesh, int var, int nx, int ny, int nHx, int nHy){
   return cnt;
 }
 
-void runPass(double dt, int dir){
+//Run the pass in direction dir. If cdt is set the flux update also leaves
+//this rank's CFL denominator of the updated mesh in d_den
+void runPass(double dt, int dir, int cdt){
   int np,nt;
-  double dx,dy;
-  char dCh;
-  char outLab[30];
-
+  int nThPrim=lCfg[LC_PRIM].nTh;
+  int nThTrace=lCfg[LC_TRACE].nTh;
+  int nThRiem=lCfg[LC_RIEM].nTh;
+  int nThFlux=lCfg[LC_FLUX].nTh;
+  double dx;
+  double *den;
 
   if(dir==0){
     np=Hp->nx;
     nt=myNy;
     dx=Hp->dx;
-    dy=Hp->dy;
-    dCh='x';
     //printf("N[%2d]:X-pass\n",rank);
+    NVTX_PUSH("halo");
     setHHalo(Hp->bndL,Hp->bndR);
-    toPrimX<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    NVTX_POP();
+    NVTX_PUSH("prim");
+    toPrimX<<<BL_TH((np+4)*nt,nThPrim)>>>(d_q,d_u);
+    NVTX_POP();
+    NVTX_PUSH("trace");
+    trace<<<BL_TH((np+2)*nt,nThTrace)>>>(d_ql,d_qr,d_q,dt/dx,np,nt,0,np+2);
+    NVTX_POP();
+    NVTX_PUSH("riemann");
+    riemann<<<BL_TH((np+1)*nt,nThRiem)>>>(d_flx,d_ql,d_qr,np,nt,0,np+1);
+    NVTX_POP();
+    NVTX_PUSH("flux");
+    den=(cdt)?d_den:NULL;
+    if(cdt)cudaMemset(d_den,0,sizeof(double));
+    addFluxX<<<BL_TH((np)*nt,nThFlux),nThFlux*sizeof(double)>>>(d_u,d_flx,dt/dx,den);
+    NVTX_POP();
+  }else if(myNy<4){
+    np=myNy;
+    nt=Hp->nx;
+    dx=Hp->dy;
+    NVTX_PUSH("halo");
+    sendVHalo();
+    recvVHalo(bndT,bndB);
+    cudaStreamSynchronize(sHalo);
+    NVTX_POP();
+    NVTX_PUSH("prim");
+    toPrimY<<<BL_TH((np+4)*nt,nThPrim)>>>(d_q,d_u,0,np+4);
+    NVTX_POP();
+    NVTX_PUSH("trace");
+    trace<<<BL_TH((np+2)*nt,nThTrace)>>>(d_ql,d_qr,d_q,dt/dx,np,nt,0,np+2);
+    NVTX_POP();
+    NVTX_PUSH("riemann");
+    riemann<<<BL_TH((np+1)*nt,nThRiem)>>>(d_flx,d_ql,d_qr,np,nt,0,np+1);
+    NVTX_POP();
+    NVTX_PUSH("flux");
+    den=(cdt)?d_den:NULL;
+    if(cdt)cudaMemset(d_den,0,sizeof(double));
+    addFluxY<<<BL_TH((np)*nt,nThFlux),nThFlux*sizeof(double)>>>(d_u,d_flx,dt/dx,den);
+    NVTX_POP();
   }else{
     np=myNy;
     nt=Hp->nx;
     dx=Hp->dy;
-    dy=Hp->dx;
-    dCh='y';
     //printf("N[%2d]:Y-pass\n",rank);
-    setVHalo(bndT,bndB);
-    toPrimY<<<BL_TH((np+4)*nt,nTh)>>>(d_q,d_u);
+    //Work on the cells that need no halo rows on sComp while the halo is
+    //exchanged on sHalo: primitives of rows 2 to myNy+1, traces of pencil
+    //cells 2 to myNy-1 and fluxes 2 to myNy-2
+    NVTX_PUSH("halo");
+    sendVHalo();
+    NVTX_POP();
+    NVTX_PUSH("prim");
+    toPrimY<<<BL_TH((np  )*nt,nThPrim),0,sComp>>>(d_q,d_u,2,np);
+    NVTX_POP();
+    NVTX_PUSH("trace");
+    trace<<<BL_TH((np-2)*nt,nThTrace),0,sComp>>>(d_ql,d_qr,d_q,dt/dx,np,nt,2,np-2);
+    NVTX_POP();
+    NVTX_PUSH("riemann");
+    riemann<<<BL_TH((np-3)*nt,nThRiem),0,sComp>>>(d_flx,d_ql,d_qr,np,nt,2,np-3);
+    NVTX_POP();
+    NVTX_PUSH("halo");
+    recvVHalo(bndT,bndB);
+    cudaEventRecord(haloDone,sHalo);
+    cudaStreamWaitEvent(sComp,haloDone,0);
+    NVTX_POP();
+    //Finish the two rows at each edge
+    NVTX_PUSH("prim");
+    toPrimY<<<BL_TH(2*nt,nThPrim),0,sComp>>>(d_q,d_u,0   ,2);
+    toPrimY<<<BL_TH(2*nt,nThPrim),0,sComp>>>(d_q,d_u,np+2,2);
+    NVTX_POP();
+    NVTX_PUSH("trace");
+    trace<<<BL_TH(2*nt,nThTrace),0,sComp>>>(d_ql,d_qr,d_q,dt/dx,np,nt,0 ,2);
+    trace<<<BL_TH(2*nt,nThTrace),0,sComp>>>(d_ql,d_qr,d_q,dt/dx,np,nt,np,2);
+    NVTX_POP();
+    NVTX_PUSH("riemann");
+    riemann<<<BL_TH(2*nt,nThRiem),0,sComp>>>(d_flx,d_ql,d_qr,np,nt,0   ,2);
+    riemann<<<BL_TH(2*nt,nThRiem),0,sComp>>>(d_flx,d_ql,d_qr,np,nt,np-1,2);
+    NVTX_POP();
+    NVTX_PUSH("flux");
+    den=(cdt)?d_den:NULL;
+    if(cdt)cudaMemsetAsync(d_den,0,sizeof(double),sComp);
+    addFluxY<<<BL_TH((np)*nt,nThFlux),nThFlux*sizeof(double),sComp>>>(d_u,d_flx,dt/dx,den);
+    NVTX_POP();
   }
-  trace<<<BL_TH((np+2)*nt,nTh)>>>(d_ql,d_qr,d_q,dt/dx,np,nt);
-  riemann<<<BL_TH((np+1)*nt,nTh)>>>(d_flx,d_ql,d_qr,np,nt);
-  if(dir==0){
-    addFluxX<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
-  }else{
-    addFluxY<<<BL_TH((np)*nt,nTh)>>>(d_u,d_flx,dt/dx);
+}
+
+//Write the interior of mesh as output step n. Each rank writes its own
+//piece of a .pvts from visMesh on the writer thread, so the time loop
+//carries on while it drains
+void writeOutput(double *mesh, int n, int *counts, int *dspls){
+  int nV, lI, i, j, r;
+  int *ext;
+  char outfile[30];
+
+  //visMesh may still be in use by the previous write
+  waitVis();
+  for(nV=0;nV<Hp->nvar;nV++){
+    for(lI=0;lI<Hp->nx*myNy;lI++){
+      i=lI%(Hp->nx);
+      j=lI/(Hp->nx);
+      visMesh[i+Hp->nx*(j+myNy*nV)]=mesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
+    }
   }
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVisPieceAsync(outfile,rank,visMesh,Hp->dx,Hp->dy,Hp->nvar,0,Hp->nx,dspls[rank]/Hp->nx,myNy);
+  if(rank==0){
+    ext=(int*)malloc(4*size*sizeof(int));
+    for(r=0;r<size;r++){
+      ext[4*r  ]=0;
+      ext[4*r+1]=Hp->nx;
+      ext[4*r+2]=dspls[r]/Hp->nx;
+      ext[4*r+3]=counts[r]/Hp->nx;
+    }
+    writeVisMaster(outfile,Hp->nvar,Hp->nx,Hp->ny,size,ext);
+    free(ext);
+  }
+}
+
+//Representative launches of the step kernels with nTh threads per block,
+//for tuneLaunch, each on what the one before left. A dt of 0 leaves the
+//mesh as it is
+void tunePrim(int nTh){
+  toPrimY<<<BL_TH((myNy+4)*Hp->nx,nTh)>>>(d_q,d_u,0,myNy+4);
+  toPrimX<<<BL_TH((Hp->nx+4)*myNy,nTh)>>>(d_q,d_u);
+}
+
+void tuneTrace(int nTh){
+  trace<<<BL_TH((Hp->nx+2)*myNy,nTh)>>>(d_ql,d_qr,d_q,0.0,Hp->nx,myNy,0,Hp->nx+2);
+}
+
+void tuneRiem(int nTh){
+  riemann<<<BL_TH((Hp->nx+1)*myNy,nTh)>>>(d_flx,d_ql,d_qr,Hp->nx,myNy,0,Hp->nx+1);
+}
+
+void tuneFlux(int nTh){
+  addFluxX<<<BL_TH(Hp->nx*myNy,nTh),nTh*sizeof(double)>>>(d_u,d_flx,0.0,d_den);
+}
+
+//Dynamic shared memory of a block of n threads
+size_t dblShmem(int n){
+  return n*sizeof(double);
+}
+
+//Give every kernel the block size the occupancy calculator picks for it,
+//within what its registers allow. The reductions halve their blocks so
+//need powers of 2
+void setLaunch(){
+  cudaFuncAttributes fa, fb;
+  int minG, occ, maxTh;
+
+  cudaFuncGetAttributes(&fa,gen_bndXL);
+  cudaOccupancyMaxPotentialBlockSize(&minG,&occ,gen_bndXL,0,0);
+  initLaunch(lCfg+LC_BND,"bnd",occ,fa.maxThreadsPerBlock,0,NULL);
+
+  cudaFuncGetAttributes(&fa,toPrimX);
+  cudaFuncGetAttributes(&fb,toPrimY);
+  maxTh=MIN(fa.maxThreadsPerBlock,fb.maxThreadsPerBlock);
+  cudaOccupancyMaxPotentialBlockSize(&minG,&occ,toPrimX,0,maxTh);
+  initLaunch(lCfg+LC_PRIM,"prim",occ,maxTh,0,tunePrim);
+
+  cudaFuncGetAttributes(&fa,trace);
+  cudaOccupancyMaxPotentialBlockSize(&minG,&occ,trace,0,0);
+  initLaunch(lCfg+LC_TRACE,"trace",occ,fa.maxThreadsPerBlock,0,tuneTrace);
+
+  cudaFuncGetAttributes(&fa,riemann);
+  cudaOccupancyMaxPotentialBlockSize(&minG,&occ,riemann,0,0);
+  initLaunch(lCfg+LC_RIEM,"riemann",occ,fa.maxThreadsPerBlock,0,tuneRiem);
+
+  cudaFuncGetAttributes(&fa,addFluxX);
+  cudaFuncGetAttributes(&fb,addFluxY);
+  maxTh=MIN(fa.maxThreadsPerBlock,fb.maxThreadsPerBlock);
+  cudaOccupancyMaxPotentialBlockSizeVariableSMem(&minG,&occ,addFluxX,dblShmem,maxTh);
+  initLaunch(lCfg+LC_FLUX,"flux",occ,maxTh,0,tuneFlux);
+
+  cudaFuncGetAttributes(&fa,calc_denom);
+  cudaFuncGetAttributes(&fb,redu_max);
+  maxTh=MIN(fa.maxThreadsPerBlock,fb.maxThreadsPerBlock);
+  cudaOccupancyMaxPotentialBlockSizeVariableSMem(&minG,&occ,calc_denom,dblShmem,maxTh);
+  initLaunch(lCfg+LC_CDT,"cdt",occ,maxTh,1,NULL);
+}
+
+//Queue a download of the mesh into h_snap on sOut. The event on the
+//default stream waits for the passes on every stream, and as sOut is a
+//blocking stream the next step's work on the default stream, which comes
+//before any of its updates, waits for the copy
+void queueSnap(size_t meshSize){
+  cudaEventRecord(snapReady,0);
+  cudaStreamWaitEvent(sOut,snapReady,0);
+  cudaMemcpyAsync(h_snap,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost,sOut);
+  cudaEventRecord(snapDone,sOut);
 }
 
 void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
-  int n, nV, lI, i,j;
+  int n, i;
   int bndL;
   int bndH;
   double dt, dt_denom, gDenom;
+  int fusedDen;
   double cTime, nxttout;
 
   double volCell;
   double ogTM,ogTE;
-  double lTM,lTE;
   double gTM,gTE;
+  int nans;
+  mesh_diag diag;
+  diag_line pLine;
+  int dgQueued, dgN;
+  int snapQueued, snapN;
+  double dgT, dgDt;
+  double *d_diag, *h_diag;
   int M_exp, E_exp;
   double M_prec, E_prec;
-  double *recvMesh;
   double *tmp, *d_denA, *d_denB;
 
-  char outfile[30];
   char outLab[30];
 
   size_t meshSize, primSize, qSize, flxSize;
+  int bndSize;
 
   double initT, endT;
+  double tPh;
+  int ph;
 
   //MPI vars
   int mpi_err;
@@ -203,9 +541,9 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   int nDen, redBlocks;
   cudaError_t cuErrVar;
   int rpBl;
-  int mxTh, thWp;
-  int nBlockM;
-  int nThCDT, nThStep;
+  int mxTh;
+  int nBlockM, nBlockD;
+  int nThCDT;
   size_t shMpBl;
   size_t mem_reqd, mem_avail;
 
@@ -220,28 +558,25 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   Hp=Hyp;
   Ha=Hya;
 
-  cudaGetDevice(&dev);
+  dev=bindDevice();
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaGetDeviceProperties(&prop,dev);
   HANDLE_CUDA_ERROR(cuErrVar);
 
   //Set dev comm vars
   printf("Setting vars for kernel calls\n");
-  printf("Device is %s with compute capability %d.%d\n",prop.name,prop.major,prop.minor);
+  printf("Device %d is %s with compute capability %d.%d\n",dev,prop.name,prop.major,prop.minor);
   mxTh=prop.maxThreadsPerBlock;
   shMpBl=prop.sharedMemPerBlock;
   rpBl=prop.regsPerBlock;
-  thWp=prop.warpSize;
-  nThCDT=mxTh;//thread upper bound
-  nThCDT=MIN(nThCDT,thWp*(rpBl/(CDT_REGS*thWp)));//register upper bound
-  nThStep=thWp;//thread upper bound
-  nThStep=MIN(nThStep,thWp*(rpBl/(STEP_REGS*thWp)));//register upper bound
-  nTh=nThCDT;
-  nBlockM=((Hp->ny*Hp->nx)+nTh-1)/nTh;
+  setLaunch();
+  HANDLE_CUDA_ERROR(cuErrVar);
+  nThCDT=lCfg[LC_CDT].nTh;
+  nBlockM=((Hp->ny*Hp->nx)+nThCDT-1)/nThCDT;
   printf("Per block: Max threads %d, regs %d\n", mxTh,rpBl, shMpBl);
-  printf("Block size lims: cdt %d step %d\n",nThCDT,nThStep);
 
   n=0;
+  fusedDen=0;
   cTime=0;
   nxttout=-1.0;
 
@@ -308,8 +643,8 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   }
 
   //Allocate arrays
-  recvMesh=(double*)malloc(Hp->nvar*Hp->nx*myNy*sizeof(double));
   lMesh =(double*)malloc(Hp->nvar*varSize*sizeof(double));
+  visMesh=(double*)malloc(Hp->nvar*Hp->nx*myNy*sizeof(double));
   cudaMalloc(&d_u,meshSize*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_q,primSize*sizeof(double));
@@ -324,6 +659,55 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   HANDLE_CUDA_ERROR(cuErrVar);
   cudaMalloc(&d_denB,nBlockM*sizeof(double));
   HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMalloc(&d_den,sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  //Per block progress line partials, copied back instead of the mesh
+  nBlockD=((Hp->nx*myNy)+nThCDT-1)/nThCDT;
+  cudaMalloc(&d_diag,3*nBlockD*sizeof(double));
+  cudaMallocHost(&h_diag,3*nBlockD*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMallocHost(&h_snap,meshSize*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  snapQueued=0;
+  snapN=0;
+  pLine.parts=(double*)malloc(5*size*sizeof(double));
+  pLine.pend=0;
+  dgQueued=0;
+  //Halo buffers, two rows of every variable each. The rows are packed on
+  //the device and MPI is handed the device buffers if it takes them, or
+  //pinned host copies otherwise
+  bndSize=2*(Hp->nx+4)*Hp->nvar;
+  cudaMalloc(&d_bndLS,bndSize*sizeof(double));
+  cudaMalloc(&d_bndLR,bndSize*sizeof(double));
+  cudaMalloc(&d_bndHS,bndSize*sizeof(double));
+  cudaMalloc(&d_bndHR,bndSize*sizeof(double));
+  HANDLE_CUDA_ERROR(cuErrVar);
+  cudaMPI=mpiTakesDevPtrs();
+  if(cudaMPI){
+    bndLS=d_bndLS;
+    bndLR=d_bndLR;
+    bndHS=d_bndHS;
+    bndHR=d_bndHR;
+  }else{
+    cudaMallocHost(&bndLS,bndSize*sizeof(double));
+    cudaMallocHost(&bndLR,bndSize*sizeof(double));
+    cudaMallocHost(&bndHS,bndSize*sizeof(double));
+    cudaMallocHost(&bndHR,bndSize*sizeof(double));
+    HANDLE_CUDA_ERROR(cuErrVar);
+  }
+  if(rank==0)printf("Halos %s\n",cudaMPI?"exchanged from device memory":"staged through the host");
+  MPI_Recv_init(bndLR,bndSize,MPI_DOUBLE,pProc,1,MPI_COMM_WORLD,vReqs+0);
+  MPI_Send_init(bndLS,bndSize,MPI_DOUBLE,pProc,2,MPI_COMM_WORLD,vReqs+1);
+  MPI_Recv_init(bndHR,bndSize,MPI_DOUBLE,nProc,2,MPI_COMM_WORLD,vReqs+2);
+  MPI_Send_init(bndHS,bndSize,MPI_DOUBLE,nProc,1,MPI_COMM_WORLD,vReqs+3);
+  //The y pass overlaps its interior work on sComp with the halo on sHalo
+  cudaStreamCreate(&sComp);
+  cudaStreamCreate(&sHalo);
+  cudaEventCreateWithFlags(&haloDone,cudaEventDisableTiming);
+  cudaStreamCreate(&sOut);
+  cudaEventCreateWithFlags(&snapReady,cudaEventDisableTiming);
+  cudaEventCreateWithFlags(&snapDone,cudaEventDisableTiming);
+  HANDLE_CUDA_ERROR(cuErrVar);
 
   //if(rank==0)printf("Arrays allocated\n");
 
@@ -332,24 +716,19 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
     lMesh[i]=0.0;
   }
 
-  //distribute over processors
-  for(nV=0;nV<Hp->nvar;nV++){
-    mpi_err=MPI_Scatterv(gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,0,MPI_COMM_WORLD);
-    if(mpi_err!=MPI_SUCCESS){
-      printf("Error scattering data to other processors\n");
-    }
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)]=recvMesh[i+Hp->nx*(j+myNy*nV)];
-    }
+  //Each rank reads its block straight from a restart file or sets up the
+  //initial condition of its block only, so no rank holds the global mesh
+  if(Ha->initFile[0]){
+    if(readRestartBlock(Ha->initFile,lMesh,Hp,0,Hp->nx,dspls[rank]/Hp->nx,myNy))MPI_Abort(MPI_COMM_WORLD,1);
+  }else{
+    initBlock(lMesh+2+2*(Hp->nx+4),Hp->nx+4,varSize,Hp,Ha,0,Hp->nx,dspls[rank]/Hp->nx,myNy);
   }
 
   MPI_Barrier(MPI_COMM_WORLD);
   //sprintf(outLab,"Loc mesh n %d",rank);
   //printArray(outLab,lMesh,4,Hp->nx+4,myNy+4);
 
-  if(rank==0)printf("Initial conditions distributed\n");
+  if(rank==0)printf("Initial conditions set up\n");
 
   if(Ha->tend>0.0){
     nxttout=Ha->tend;
@@ -359,10 +738,9 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   }
 
   volCell=Hp->dx*Hp->dy;
-  lTM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
-  lTE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
-  MPI_Allreduce(&lTM,&ogTM,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD); 
-  MPI_Allreduce(&lTE,&ogTE,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
+  //sumArray already reduces over the ranks
+  ogTM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
+  ogTE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
 #ifdef M_PREC_CMP
   frexp(ogTM,&M_exp);
   frexp(ogTE,&E_exp);
@@ -374,137 +752,168 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
 #endif
 
   //Print initial condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
-  if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-    printf("INIT: TM: %g TE: %g\n",volCell*ogTM,volCell*ogTE);
-  }
+  writeOutput(lMesh,n,counts,dspls);
+  if(rank==0)printf("INIT: TM: %g TE: %g\n",volCell*ogTM,volCell*ogTE);
  
   cudaMemcpy(d_u,lMesh,meshSize*sizeof(double),cudaMemcpyHostToDevice);
+
+  //Tune the step kernels on the initial mesh. Every rank tunes its own
+  //device, and rank 0 adds its block sizes to the cache
+  if(tuneLaunch(lCfg,NLAUNCH,prop.name,0,rank==0)){
+    cudaDeviceSynchronize();
+    HANDLE_CUDA_ERROR(cuErrVar);
+  }
+  if(rank==0)printLaunch(lCfg,NLAUNCH);
  
+  //The pass kernels run asynchronously, so only the dt reduction, which
+  //waits on its result, and the output are timed on the host
+  initTiming(&Ht,"MPI/CUDA","GPU",size,1);
+  for(ph=0;ph<NPHASE;ph++){
+    if(ph!=PH_DT&&ph!=PH_OUTPUT)Ht.phase[ph]=-1.0;
+  }
   initT=MPI_Wtime();
 
   while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
     //Calculate timestep
+    PH_START(tPh);
+    NVTX_PUSH("dt");
     dt=0.0;
-    nDen=nBlockM;
-    redBlocks=nDen;
-    nTh=nThCDT;
-    //cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
-    //printArray("Mesh",lMesh,4,Hp->nx,Hp->ny,2,2);
-    calc_denom<<<nBlockM,nTh,nTh*sizeof(double)>>>(d_u,d_denA);
-    //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
-    //printArray("Dens",recvMesh,1,nDen,1,0,0);
-    while(redBlocks>1){
-      redBlocks=(nDen+2*nTh-1)/(2*nTh);
-      redu_max<<<redBlocks,nTh,nTh*sizeof(double)>>>(d_denA,d_denB,nDen);
-      nDen=redBlocks;
+    if(fusedDen){
+      //The last pass of the previous step left this rank's denominator
+      cudaMemcpy(&dt_denom,d_den,sizeof(double),cudaMemcpyDeviceToHost);
+    }else{
+      nDen=nBlockM;
+      redBlocks=nDen;
+      //cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
+      //printArray("Mesh",lMesh,4,Hp->nx,Hp->ny,2,2);
+      calc_denom<<<nBlockM,nThCDT,nThCDT*sizeof(double)>>>(d_u,d_denA);
       //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
       //printArray("Dens",recvMesh,1,nDen,1,0,0);
-      tmp=d_denA;
-      d_denA=d_denB;
-      d_denB=tmp;
+      while(redBlocks>1){
+        redBlocks=(nDen+2*nThCDT-1)/(2*nThCDT);
+        redu_max<<<redBlocks,nThCDT,nThCDT*sizeof(double)>>>(d_denA,d_denB,nDen);
+        nDen=redBlocks;
+        //cudaMemcpy(recvMesh,d_denA,nDen*sizeof(double),cudaMemcpyDeviceToHost);
+        //printArray("Dens",recvMesh,1,nDen,1,0,0);
+        tmp=d_denA;
+        d_denA=d_denB;
+        d_denB=tmp;
+      }
+      cudaMemcpy(&dt_denom,d_denA,sizeof(double),cudaMemcpyDeviceToHost);
     }
-    cudaMemcpy(&dt_denom,d_denA,sizeof(double),cudaMemcpyDeviceToHost);
     //printf("N[%2d] ITER %d l denom=%g\n",rank,n,dt_denom);
     MPI_Allreduce(&dt_denom,&gDenom,1,MPI_DOUBLE,MPI_MAX,MPI_COMM_WORLD);
     //printf("N[%2d] ITER %d g denom=%g\n",rank,n,gDenom);
     dt=0.5*Ha->sigma/gDenom;
+    PH_ADD(Ht.phase,PH_DT,tPh);
+    NVTX_POP();
+    //The denominator copy above waited on the partials queued after the
+    //last step, so send them on their way while this step runs
+    if(dgQueued){
+      foldDiag(&diag,h_diag,nBlockD);
+      postDiag(&pLine,&diag,dgN,dgT,dgDt);
+      dgQueued=0;
+    }
     if(nxttout>0.0&&dt>(nxttout-cTime)){
       printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
       dt=(nxttout-cTime);
     }
-    if(n%2==0){
+    if((Hp->nstep+n)%2==0){
       //X Dir
-      runPass(dt,0);
+      runPass(dt,0,0);
       //Y Dir
-      runPass(dt,1);
+      runPass(dt,1,FUSE_DT);
     }else{
       //Y Dir
-      runPass(dt,1);
+      runPass(dt,1,0);
       //X Dir
-      runPass(dt,0);
+      runPass(dt,0,FUSE_DT);
     }
+    fusedDen=FUSE_DT;
     n+=1;
     cTime+=dt;
-    if(n%Ha->nprtLine==0||((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0))){
-      cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
-      if(n%Ha->nprtLine==0){
-        //nanScan(nanCnt,lMesh,Hp->nvar,Hp->nx,myNy,2,2);
-        lTM=sumArray(lMesh,VARRHO,Hp->nx,myNy,2,2);
-        lTE=sumArray(lMesh,VARPR ,Hp->nx,myNy,2,2);
-        MPI_Allreduce(&lTM,&gTM,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-        MPI_Allreduce(&lTE,&gTE,1,MPI_DOUBLE,MPI_SUM,MPI_COMM_WORLD);
-        //printf("N[%2d] Nans: %d %d %d %d\n",rank,nanCnt[0],nanCnt[1],nanCnt[2],nanCnt[3]);
-        if(rank==0){
-          printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*gTM,volCell*gTE); 
-          if(0&&(fabs(gTM-ogTM)>0.0||fabs(gTE-ogTE)>0.0)){
-            printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(gTM-ogTM),volCell*(gTE-ogTE));
-            printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(gTM-ogTM)/ogTM,100.0*(gTE-ogTE)/ogTE);
+    PH_START(tPh);
+    NVTX_PUSH("output");
+    //The snapshot of the step before is written while this step runs
+    if(snapQueued){
+      cudaEventSynchronize(snapDone);
+      writeOutput(h_snap,snapN,counts,dspls);
+      snapQueued=0;
+    }
+    //The line of the step before was gathered while this step ran, so
+    //progress lines are printed one step late and never stall the ranks
+    if(finishDiag(&pLine,&gTM,&gTE,&nans)&&rank==0){
+      printf("Iter %05d time %f dt %g TM: %g TE: %g\n",pLine.n,pLine.t,pLine.dt,volCell*gTM,volCell*gTE);
+      if(nans)printf("Iter %05d: %d cells hold NaN or Inf\n",pLine.n,nans);
+      if(0&&(fabs(gTM-ogTM)>0.0||fabs(gTE-ogTE)>0.0)){
+        printf("ERR(%5s): Mass %g Ene %g\n","RAW",volCell*(gTM-ogTM),volCell*(gTE-ogTE));
+        printf("ERR(%5s): Mass %g Ene %g\n","%",100.0*(gTM-ogTM)/ogTM,100.0*(gTE-ogTE)/ogTE);
 #ifdef M_PREC_CMP
-            printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
+        printf("ERR(%5s): Mass %g Ene %g\n","M PRE",(TM-oTM)/M_prec,(TE-oTE)/E_prec);
 #endif
-          }
-        }
       }
-      if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
-        if(rank==0)printf("Vis file @ time %f iter %d\n",cTime,n);
-        if(cTime>=nxttout&&nxttout>0.0){
-          nxttout+=Ha->dtoutput;
-          if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
-          //if(rank==0)printf("Next Vis Time: %f\n",nxttout);
-        }
-        for(nV=0;nV<Hp->nvar;nV++){
-          for(lI=0;lI<Hp->nx*myNy;lI++){
-            i=lI%(Hp->nx);
-            j=lI/(Hp->nx);
-            recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-          }
-          MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-        }
-        if(rank==0){
-          snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-          writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-        }
+    }
+    //Progress lines reduce on the device and copy back only the per block
+    //partials, queued behind the step and picked up by the next one
+    if(n%Ha->nprtLine==0){
+      diag_part<<<nBlockD,nThCDT,3*nThCDT*sizeof(double)>>>(d_u,d_diag);
+      cudaMemcpyAsync(h_diag,d_diag,3*nBlockD*sizeof(double),cudaMemcpyDeviceToHost,0);
+      dgQueued=1;
+      dgN=n;
+      dgT=cTime;
+      dgDt=dt;
+    }
+    if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      queueSnap(meshSize);
+      snapQueued=1;
+      snapN=n;
+      if(rank==0)printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(cTime>=nxttout&&nxttout>0.0){
+        nxttout+=Ha->dtoutput;
+        if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
+        //if(rank==0)printf("Next Vis Time: %f\n",nxttout);
       }
     }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+    NVTX_POP();
+  }
+  if(snapQueued){
+    cudaEventSynchronize(snapDone);
+    writeOutput(h_snap,snapN,counts,dspls);
+  }
+  //The last progress line is still queued or in flight
+  if(dgQueued){
+    cudaDeviceSynchronize();
+    foldDiag(&diag,h_diag,nBlockD);
+    postDiag(&pLine,&diag,dgN,dgT,dgDt);
+  }
+  if(finishDiag(&pLine,&gTM,&gTE,&nans)&&rank==0){
+    printf("Iter %05d time %f dt %g TM: %g TE: %g\n",pLine.n,pLine.t,pLine.dt,volCell*gTM,volCell*gTE);
+    if(nans)printf("Iter %05d: %d cells hold NaN or Inf\n",pLine.n,nans);
   }
   if(rank==0)printf("time: %f, %d iters run\n",cTime,n);
 
   endT=MPI_Wtime();
 
+  reduceTiming(&Ht);
   if(rank==0){
-    printf("TFMT:%s,%s,%s,%s.%s,%s,%s,%s\n","cType","mType","init","nproc","nth","niters","ncells","wRunt");
-    printf("TIME:%s,%s,%s,%d,%d,%d,%d,%g\n","\"MPI/CUDA\"","\"GPU:?\"","\"Init\"",size,1,n,Hp->nx*Hp->ny,(endT-initT));
+    Ht.niters=n;
+    Ht.ncells=Hp->nx*Hp->ny;
+    Ht.runt=endT-initT;
+    printTiming(&Ht,Ha);
   }
   
   cudaMemcpy(lMesh,d_u,meshSize*sizeof(double),cudaMemcpyDeviceToHost);
 
   //Print final condition
-  for(nV=0;nV<Hp->nvar;nV++){
-    for(lI=0;lI<Hp->nx*myNy;lI++){
-      i=lI%(Hp->nx);
-      j=lI/(Hp->nx);
-      recvMesh[i+Hp->nx*(j+myNy*nV)]=lMesh[i+2+(Hp->nx+4)*(j+2+(myNy+4)*nV)];
-    }
-    MPI_Gatherv(recvMesh+nV*Hp->nx*myNy,Hp->nx*myNy,MPI_DOUBLE,gMesh+nV*Hp->nx*Hp->ny,counts,dspls,MPI_DOUBLE,0,MPI_COMM_WORLD);
-  }
-  if(rank==0){
-    snprintf(outfile,29,"%s%05d",Ha->outPre,n);
-    writeVis(outfile,gMesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
-  }
+  writeOutput(lMesh,n,counts,dspls);
+  waitVis();
   Hp->t+=cTime;
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestartBlock(Ha->chkFile,lMesh,Hp,0,Hp->nx,dspls[rank]/Hp->nx,myNy);
 
-  free(recvMesh);
   free(lMesh);
+  free(visMesh);
   cudaFree(d_u  );
   cudaFree(d_q  );
   cudaFree(d_qr );
@@ -512,9 +921,37 @@ void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args
   cudaFree(d_flx);
   cudaFree(d_denA);
   cudaFree(d_denB);
+  cudaFree(d_den);
+  cudaFree(d_diag);
+  cudaFreeHost(h_diag);
+  cudaFreeHost(h_snap);
+  free(pLine.parts);
+  for(i=0;i<4;i++){
+    MPI_Request_free(vReqs+i);
+  }
+  if(!cudaMPI){
+    cudaFreeHost(bndLS);
+    cudaFreeHost(bndLR);
+    cudaFreeHost(bndHS);
+    cudaFreeHost(bndHR);
+  }
+  cudaFree(d_bndLS);
+  cudaFree(d_bndLR);
+  cudaFree(d_bndHS);
+  cudaFree(d_bndHR);
+  cudaEventDestroy(haloDone);
+  cudaStreamDestroy(sComp);
+  cudaStreamDestroy(sHalo);
+  cudaEventDestroy(snapReady);
+  cudaEventDestroy(snapDone);
+  cudaStreamDestroy(sOut);
 
   printf("NODE %d: Finalizing MPI\n",rank);
   MPI_Finalize();
 
   printf("N %d: Returning from engine\n",rank);
 }
+
+//Nothing is kept between engine calls
+void freeScratch(){
+}
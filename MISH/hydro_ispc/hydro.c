@@ -0,0 +1,410 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <omp.h>
+#include "hydro.h"
+#include "restart.h"
+#include "outfile.h"
+#include "timing.h"
+#include "kernels_ispc.h"
+#include "cody.h"
+
+hydro_args *Ha;
+hydro_prob *Hp;
+hydro_timing Ht;
+real *q;
+real *qr, *ql;
+real *flx;
+
+//Scratch arena for the q, qr, ql and flx tiles, one slice per thread,
+//kept from one engine call to the next
+#define SCR_ALIGN 64
+#define SCR_PAD(n,a) ((((n)+(a)-1)/(a))*(a))
+real *scr=NULL;
+size_t scrSlice=0;
+int scrTh=0;
+
+//Cell p of pencil t of the mesh is b[p*ps+t*ts], and each variable is vs
+//further on
+typedef struct {
+  double *b;
+  int ps, ts, vs;
+} blk_view;
+
+//Mass and energy sums with their Neumaier corrections, and the number of
+//cells holding a NaN or Inf, gathered tile by tile by the last pass of a
+//step that prints a progress line
+typedef struct {
+  double sum[2], corr[2];
+  int nans;
+} mesh_diag;
+
+//View of tile t0 of a pass in direction dir: rows of the mesh for the x
+//pass, columns for the y pass
+blk_view tileView(double *mesh, int dir, int t0){
+  blk_view v;
+
+  v.vs=Hp->nx*Hp->ny;
+  if(dir==0){
+    v.b=mesh+Hp->nx*t0;
+    v.ps=1;
+    v.ts=Hp->nx;
+  }else{
+    v.b=mesh+t0;
+    v.ps=Hp->nx;
+    v.ts=1;
+  }
+  return v;
+}
+
+//Function to calculate timestep
+double calcDT(double *mesh){
+  return 0.5/ispcDenom(mesh,1,Hp->nx,Hp->nx*Hp->ny,Hp->nx,Hp->ny,
+		       Hp->gamma,Ha->smallr,Ha->smallc,Hp->dx,Hp->dy);
+}
+
+//Cell p of pencil t is q[ps*p+ts*t]
+void setBndCnd(real* q, int cndL, int cndH, int np, int nt, int ps, int ts){
+  int i;
+  int pI,tI;
+  int wInd, rInd;
+
+  for(i=0;i<2*nt;i++){
+    pI=i%2;
+    tI=i/2;
+    wInd=ps*pI+ts*tI;
+    rInd=ps*(3-pI)+ts*tI;
+    if(cndL==BND_REFL){
+      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
+      q[wInd+(np+4)*nt*VARVX ]=-q[rInd+(np+4)*nt*VARVX ];
+      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
+      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+    }else if(cndL==BND_PERM){
+      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
+      q[wInd+(np+4)*nt*VARVX ]= q[rInd+(np+4)*nt*VARVX ];
+      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
+      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+    }
+    wInd=ps*(np+2+pI)+ts*tI;
+    rInd=ps*(np+1-pI)+ts*tI;
+    if(cndH==BND_REFL){
+      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
+      q[wInd+(np+4)*nt*VARVX ]=-q[rInd+(np+4)*nt*VARVX ];
+      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
+      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+    }else if(cndH==BND_PERM){
+      q[wInd+(np+4)*nt*VARRHO]= q[rInd+(np+4)*nt*VARRHO];
+      q[wInd+(np+4)*nt*VARVX ]= q[rInd+(np+4)*nt*VARVX ];
+      q[wInd+(np+4)*nt*VARVY ]= q[rInd+(np+4)*nt*VARVY ];
+      q[wInd+(np+4)*nt*VARPR ]= q[rInd+(np+4)*nt*VARPR ];
+    }
+  }
+}
+
+void neumaierAdd(double *sum, double *corr, double v){
+  double t;
+
+  t=*sum+v;
+  if(fabs(*sum)>=fabs(v)){
+    *corr+=(*sum-t)+v;
+  }else{
+    *corr+=(v-t)+*sum;
+  }
+  *sum=t;
+}
+
+//Fold the n cells of mesh from cell c0 into the diagnostics dg
+void cellsDiag(mesh_diag *dg, double *mesh, int c0, int n){
+  int i, nV, bad;
+
+  for(i=c0;i<c0+n;i++){
+    neumaierAdd(&dg->sum[0],&dg->corr[0],mesh[i+Hp->nx*Hp->ny*VARRHO]);
+    neumaierAdd(&dg->sum[1],&dg->corr[1],mesh[i+Hp->nx*Hp->ny*VARPR ]);
+    bad=0;
+    for(nV=0;nV<Hp->nvar;nV++){
+      if(!isfinite(mesh[i+Hp->nx*Hp->ny*nV]))bad=1;
+    }
+    dg->nans+=bad;
+  }
+}
+
+//Fold tile t0 to t0+tn-1 of a pass in direction dir into dg, straight
+//after its flux update while it is in cache
+void tileDiag(mesh_diag *dg, double *mesh, int dir, int t0, int tn){
+  int j;
+
+  if(dir==0){
+    cellsDiag(dg,mesh,Hp->nx*t0,Hp->nx*tn);
+    return;
+  }
+  for(j=0;j<Hp->ny;j++){
+    cellsDiag(dg,mesh,t0+Hp->nx*j,tn);
+  }
+}
+
+//Add the partial diagnostics part into dg
+void mergeDiag(mesh_diag *dg, mesh_diag *part){
+  int v;
+
+  for(v=0;v<2;v++){
+    neumaierAdd(&dg->sum[v],&dg->corr[v],part->sum[v]);
+    dg->corr[v]+=part->corr[v];
+  }
+  dg->nans+=part->nans;
+}
+
+double sumArray(double *mesh, int var, int nx, int ny){
+  int i;
+  double sum, corr;
+
+  sum=0.0;
+  corr=0.0;
+  for(i=0;i<nx*ny;i++){
+    neumaierAdd(&sum,&corr,mesh[i+nx*ny*var]);
+  }
+  return sum+corr;
+}
+
+//Point q, qr, ql and flx at the arena, growing it if the tiles no longer
+//fit. Every array starts on a SCR_ALIGN byte boundary
+void getScratch(size_t primSz, size_t qSz, size_t flxSz){
+  size_t slice, bytes;
+  int nth;
+
+  nth=omp_get_max_threads();
+  slice=SCR_PAD(primSz,SCR_ALIGN/sizeof(real))+2*SCR_PAD(qSz,SCR_ALIGN/sizeof(real))+
+	SCR_PAD(flxSz,SCR_ALIGN/sizeof(real));
+  if(scr==NULL||slice>scrSlice||nth!=scrTh){
+    cody_free(scr);
+    bytes=nth*slice*sizeof(real);
+    scr=(real*)cody_alloc(bytes,SCR_ALIGN,CODY_FIRST_TOUCH);
+    if(scr==NULL){
+      fprintf(stderr,"Could not allocate %zu bytes of scratch\n",bytes);
+      exit(1);
+    }
+    scrSlice=slice;
+    scrTh=nth;
+  }
+  q  =scr;
+  qr =q +SCR_PAD(primSz,SCR_ALIGN/sizeof(real));
+  ql =qr+SCR_PAD(qSz,SCR_ALIGN/sizeof(real));
+  flx=ql+SCR_PAD(qSz,SCR_ALIGN/sizeof(real));
+}
+
+//Release the scratch arena once no more engine calls are coming
+void freeScratch(){
+  cody_free(scr);
+  scr=NULL;
+  scrSlice=0;
+  scrTh=0;
+}
+
+//Run the pass in direction dir. The threads share out the tiles of
+//pencils and the ISPC kernels run each tile in SIMD across its
+//interleaved pencils. If cdt is set, also return the CFL denominator of
+//the updated mesh, found tile by tile after the flux update, and if dg is
+//set gather the mesh diagnostics into it the same way
+double runPass(double *mesh, double dt, int n, int dir, int cdt, mesh_diag *dg){
+  int bndL,bndH;
+  int np,nt;
+  int t0,tn;
+  real *tq, *tqr, *tql, *tflx;
+  double dx;
+  double den=0.0, tDen;
+  double tPh, tTh[NPHASE]={0.0};
+  mesh_diag *thDg=NULL;
+  blk_view v;
+
+  if(dir==0){
+    np=Hp->nx;
+    nt=Hp->ny;
+    bndL=Hp->bndL;
+    bndH=Hp->bndR;
+    dx=Hp->dx;
+  }else{
+    np=Hp->ny;
+    nt=Hp->nx;
+    bndL=Hp->bndU;
+    bndH=Hp->bndD;
+    dx=Hp->dy;
+  }
+  //Each thread sweeps whole tiles of pencils through its own slice of the
+  //arena. Phase times are summed over the threads in tTh, and diagnostics
+  //gathered per thread in thDg, combined in thread order
+  if(dg)thDg=(mesh_diag*)calloc(omp_get_max_threads(),sizeof(mesh_diag));
+#pragma omp parallel for private(tn,tq,tqr,tql,tflx,tDen,tPh,v) shared(mesh,dt,dx,np,nt,bndL,bndH,dir,q,qr,ql,flx,scrSlice,thDg) reduction(+:tTh[:NPHASE]) reduction(max:den)
+  for(t0=0;t0<nt;t0+=PENCIL_TILE){
+    PH_START(tPh);
+    tn=MIN(PENCIL_TILE,nt-t0);
+    tq  =q  +omp_get_thread_num()*scrSlice;
+    tqr =qr +omp_get_thread_num()*scrSlice;
+    tql =ql +omp_get_thread_num()*scrSlice;
+    tflx=flx+omp_get_thread_num()*scrSlice;
+    v=tileView(mesh,dir,t0);
+    //The pressure floor of the C implementations' x and y passes
+    ispcToPrim(tq,v.b,v.ps,v.ts,v.vs,dir,np,tn,0,0,Hp->gamma,Ha->smallr,Ha->smallc,dir);
+    PH_ADD(tTh,PH_PRIM,tPh);
+    setBndCnd(tq,bndL,bndH,np,tn,tn,1);
+    PH_ADD(tTh,PH_HALO,tPh);
+    ispcTrace(tql,tqr,tq+tn,dt/dx,Hp->gamma,tn*(np+2),tn,tn*(np+4),tn*(np+2));
+    PH_ADD(tTh,PH_TRACE,tPh);
+    if(Ha->scheme==SCHEME_EXACT){
+      ispcRiemann(tflx,tql,tqr+tn,tn*(np+1),tn*(np+2),tn*(np+1),Hp->gamma,Ha->smallr,Ha->smallc,Ha->niter_riemann);
+    }else{
+      ispcRiemannApprox(tflx,tql,tqr+tn,tn*(np+1),tn*(np+2),tn*(np+1),Hp->gamma,Ha->smallr,Ha->smallc,
+                        Ha->scheme==SCHEME_HLLC);
+    }
+    PH_ADD(tTh,PH_RIEMANN,tPh);
+    ispcAddFlux(v.b,v.ps,v.ts,v.vs,tflx,dt/dx,dir,np,tn);
+    if(cdt){
+      tDen=ispcDenom(v.b,v.ps,v.ts,v.vs,np,tn,Hp->gamma,Ha->smallr,Ha->smallc,Hp->dx,Hp->dy);
+      den=MAX(den,tDen);
+    }
+    if(thDg)tileDiag(thDg+omp_get_thread_num(),mesh,dir,t0,tn);
+    PH_ADD(tTh,PH_FLUX,tPh);
+  }
+  //Report the mean time per thread
+  for(t0=0;t0<NPHASE;t0++){
+    Ht.phase[t0]+=tTh[t0]/omp_get_max_threads();
+  }
+  if(thDg){
+    for(t0=0;t0<omp_get_max_threads();t0++){
+      mergeDiag(dg,thDg+t0);
+    }
+    free(thDg);
+  }
+  return den;
+}
+
+void engine(int *argc, char **argv[], double *mesh, hydro_prob *Hyp, hydro_args *Hya){
+  int n;
+  double dt, den;
+  double cTime, nxttout;
+  mesh_diag diag, *dg;
+
+  double volCell;
+  double oTM,oTE;
+  double TM,TE;
+
+  char outfile[30];
+
+  size_t primSize, qSize, flxSize;
+
+  double initT, endT;
+  double tPh;
+
+  Hp=Hyp;
+  Ha=Hya;
+
+  n=0;
+  den=0.0;
+  cTime=0;
+  nxttout=-1.0;
+
+  if(Ha->nstepmax<0&&Ha->tend<0.0)return;
+
+  //Calculate arraysizes
+  if(Hp->ny>=Hp->nx){
+    primSize=Hp->nvar*(Hp->ny+4)*PENCIL_TILE;
+    qSize   =Hp->nvar*(Hp->ny+2)*PENCIL_TILE;
+    flxSize =Hp->nvar*(Hp->ny+1)*PENCIL_TILE;
+  }else{
+    primSize=Hp->nvar*(Hp->nx+4)*PENCIL_TILE;
+    qSize   =Hp->nvar*(Hp->nx+2)*PENCIL_TILE;
+    flxSize =Hp->nvar*(Hp->nx+1)*PENCIL_TILE;
+  }
+  getScratch(primSize,qSize,flxSize);
+
+  if(Ha->tend>0.0){
+    nxttout=Ha->tend;
+  }
+  if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
+    nxttout=Ha->dtoutput;
+  }
+
+  volCell=Hp->dx*Hp->dy;
+  oTM=sumArray(mesh,VARRHO,Hp->nx,Hp->ny);
+  oTE=sumArray(mesh,VARPR ,Hp->nx,Hp->ny);
+
+  //Print initial condition
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
+
+  initTiming(&Ht,"ISPC" REAL_TAG,"CPU",1,omp_get_max_threads());
+  initT=wallNow();
+
+  while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
+    //Calculate timestep
+    PH_START(tPh);
+    //The last pass of the previous step found the CFL denominator, unless
+    //this is the first step
+    if(den>0.0){
+      dt=Ha->sigma*(0.5/den);
+    }else{
+      dt=Ha->sigma*calcDT(mesh);
+    }
+    PH_ADD(Ht.phase,PH_DT,tPh);
+    if(nxttout>0.0&&dt>(nxttout-cTime)){
+      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+      dt=(nxttout-cTime);
+    }
+    //The last pass of a step that prints a progress line also gathers its
+    //diagnostics, so they cost no extra sweep over the mesh
+    dg=NULL;
+    if((n+1)%Ha->nprtLine==0){
+      memset(&diag,0,sizeof(diag));
+      dg=&diag;
+    }
+    if((Hp->nstep+n)%2==0){
+      //X Dir
+      runPass(mesh,dt,n,0,0,NULL);
+      //Y Dir
+      den=runPass(mesh,dt,n,1,FUSE_DT,dg);
+    }else{
+      //Y Dir
+      runPass(mesh,dt,n,1,0,NULL);
+      //X Dir
+      den=runPass(mesh,dt,n,0,FUSE_DT,dg);
+    }
+    n+=1;
+    cTime+=dt;
+    PH_START(tPh);
+    if(dg){
+      TM=diag.sum[0]+diag.corr[0];
+      TE=diag.sum[1]+diag.corr[1];
+      printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+      if(diag.nans)printf("Iter %05d: %d cells hold NaN or Inf\n",n,diag.nans);
+    }
+    if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(cTime>=nxttout&&nxttout>0.0){
+	nxttout+=Ha->dtoutput;
+	if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
+      }
+      snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+      writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+  }
+  printf("time: %f, %d iters run\n",cTime,n);
+
+  endT=wallNow();
+
+  Ht.niters=n;
+  Ht.ncells=Hp->nx*Hp->ny;
+  Ht.runt=endT-initT;
+  printTiming(&Ht,Ha);
+
+  //The last snapshot may share the final condition's name
+  waitVis();
+
+  //Print final condition
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+
+  Hp->t+=cTime;
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestart(Ha->chkFile,mesh,Hp);
+}
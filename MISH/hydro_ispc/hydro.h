@@ -0,0 +1,9 @@
+#ifndef HYDRO_H_
+#define HYDRO_H_
+
+#include "hydro_struct.h"
+#include "hydro_defs.h"
+#include "real.h"
+#include "engine.h"
+
+#endif //HYDRO_H_
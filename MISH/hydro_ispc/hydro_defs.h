@@ -0,0 +1,32 @@
+#ifndef HYDRO_DEFS_H_
+#define HYDRO_DEFS_H_
+
+#define MAX(x,y) ((x)<(y))?(y):(x)
+#define MIN(x,y) ((x)>(y))?(y):(x)
+
+#define VARRHO 0
+#define VARVX  1
+#define VARVY  2
+#define VARPR  3
+
+#define BND_REFL 0
+#define BND_PERM 1
+#define BND_INT 2
+
+//Number of pencils runPass sweeps at once; 8 columns fill a cache
+//line in the y pass. The ISPC kernels run across the pencils of a tile, so
+//make it a multiple of the gang size
+#ifndef PENCIL_TILE
+#define PENCIL_TILE 8
+#endif
+
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//sweep over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+#endif //HYDRO_DEFS_H_
@@ -0,0 +1,537 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <Kokkos_Core.hpp>
+#include "hydro.h"
+#include "restart.h"
+#include "outfile.h"
+#include "timing.h"
+
+//The approximate Riemann solvers run inside the kernels, on whichever
+//device Kokkos was built for
+#define RIEMANN_FN KOKKOS_INLINE_FUNCTION
+#include "riemann_approx.h"
+
+//Every view is indexed (x, y, var), so the default layout of the execution
+//space decides what is contiguous: LayoutLeft on GPUs, where neighbouring
+//threads then touch neighbouring cells of a row, and LayoutRight on the
+//host, where a cell holds its variables together. The cell loops are
+//MDRanges, whose default iteration order follows the same layout
+typedef Kokkos::View<double***> mesh_view;
+typedef Kokkos::MDRangePolicy<Kokkos::Rank<2> > cell_range;
+//The caller's variable major mesh, as a view the mesh can be copied through
+typedef Kokkos::View<double***,Kokkos::LayoutLeft,Kokkos::HostSpace,
+                     Kokkos::MemoryTraits<Kokkos::Unmanaged> > host_mesh;
+
+//Physics constants, copied into every kernel by value
+typedef struct __kkPhys{
+  double gamma, smallr, smallc, smallp;
+  double dx, dy;
+  int niter, scheme;
+} kk_phys;
+
+//Device mesh and pass scratch, kept from one engine call to the next so
+//the members of a batch of one mesh size reuse them. q, ql, qr and flx
+//have a 2 cell halo on every side and are indexed like u, offset by 2, in
+//both passes, so the y pass needs no transposed copy; they hold the
+//velocity normal to the pass in VARVX
+typedef struct __kkState{
+  mesh_view u;
+  mesh_view::HostMirror hu;
+  mesh_view q, ql, qr, flx;
+  int nx, ny;
+} kk_state;
+
+hydro_args *Ha;
+hydro_prob *Hp;
+hydro_timing Ht;
+kk_state *kk=NULL;
+kk_phys phys;
+//Fence after every kernel so all the phases are timed, see MISH_KK_PROFILE
+int kkProfile;
+
+//Add the time since tPh to phase ph. The kernels are asynchronous on a
+//GPU, so they are only waited for, and timed, when profiling
+void phaseAdd(int ph, double *tPh){
+  if(!kkProfile)return;
+  Kokkos::fence();
+  PH_ADD(Ht.phase,ph,*tPh);
+}
+
+//CFL denominator of cell (i,j) of u
+KOKKOS_INLINE_FUNCTION double cellDenom(const mesh_view &u, int i, int j, const kk_phys &ph){
+  double r, vx, vy, eint, p, c;
+
+  r   =fmax(u(i,j,VARRHO),ph.smallr);
+  vx  =u(i,j,VARVX)/r;
+  vy  =u(i,j,VARVY)/r;
+  eint=u(i,j,VARPR)-0.5*r*(vx*vx+vy*vy);
+  p   =fmax((ph.gamma-1.0)*eint,r*ph.smallp);
+  c   =sqrt(ph.gamma*p/r);
+  return (c+fabs(vx))/ph.dx+(c+fabs(vy))/ph.dy;
+}
+
+//Limited slope of variable v of q at (i,j), along the pass (di,dj). As
+//the C slope(), whose MIN macro drops the sign
+KOKKOS_INLINE_FUNCTION double slope(const mesh_view &q, int i, int j, int di, int dj, int v){
+  double dlft, drgt, dcen, dlim;
+
+  dlft=q(i,j,v)-q(i-di,j-dj,v);
+  drgt=q(i+di,j+dj,v)-q(i,j,v);
+  dcen=0.5*(dlft+drgt);
+  dlim=(dlft*drgt<=0.0)?0.0:fmin(fabs(dlft),fabs(drgt));
+  return fmin(dlim,fabs(dcen));
+}
+
+//Traced left and right states of cell (i,j) of q into ql and qr
+KOKKOS_INLINE_FUNCTION void traceCell(const mesh_view &ql, const mesh_view &qr, const mesh_view &q,
+                                      int i, int j, int di, int dj, double dtdx, const kk_phys &ph){
+  double r, u, v1, p, csq, cc;
+  double dr, du, dv1, dp;
+  double alpham, alphap, alphazr;
+  double spminus, spzero, spplus;
+  double ap, am, azr, azv1;
+
+  r =q(i,j,VARRHO);
+  u =q(i,j,VARVX );
+  v1=q(i,j,VARVY );
+  p =q(i,j,VARPR );
+
+  csq=ph.gamma*p/r;
+  cc=sqrt(csq);
+
+  dr =slope(q,i,j,di,dj,VARRHO);
+  du =slope(q,i,j,di,dj,VARVX );
+  dv1=slope(q,i,j,di,dj,VARVY );
+  dp =slope(q,i,j,di,dj,VARPR );
+
+  alpham = 0.5*(dp/(r*cc)-du)*r/cc;
+  alphap = 0.5*(dp/(r*cc)+du)*r/cc;
+  alphazr= dr-dp/csq;
+
+  //right
+  spminus=((u-cc)>=0.0)?0.0:(u-cc)*dtdx+1.0;
+  spzero =((u   )>=0.0)?0.0:(u   )*dtdx+1.0;
+  spplus =((u+cc)>=0.0)?0.0:(u+cc)*dtdx+1.0;
+  ap  =-0.5*spplus *alphap ;
+  am  =-0.5*spminus*alpham ;
+  azr =-0.5*spzero *alphazr;
+  azv1=-0.5*spzero *dv1;
+  qr(i,j,VARRHO)=r +(ap+am+azr);
+  qr(i,j,VARVX )=u +(ap-am    )*cc/r;
+  qr(i,j,VARVY )=v1+(azv1     );
+  qr(i,j,VARPR )=p +(ap+am    )*csq;
+
+  //left
+  spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
+  spzero =((u   )<=0.0)?0.0:(u   )*dtdx-1.0;
+  spplus =((u+cc)<=0.0)?0.0:(u+cc)*dtdx-1.0;
+  ap  =-0.5*spplus *alphap ;
+  am  =-0.5*spminus*alpham ;
+  azr =-0.5*spzero *alphazr;
+  azv1=-0.5*spzero *dv1;
+  ql(i,j,VARRHO)=r +(ap+am+azr);
+  ql(i,j,VARVX )=u +(ap-am    )*cc/r;
+  ql(i,j,VARVY )=v1+(azv1     );
+  ql(i,j,VARPR )=p +(ap+am    )*csq;
+}
+
+//Godunov flux f between the floored left and right states, by the exact
+//solver of the C implementation
+KOKKOS_INLINE_FUNCTION void riemannExact(double *f, double rl, double vxl, double vyl, double pl,
+                                         double rr, double vxr, double vyr, double pr, const kk_phys &ph){
+  int n;
+  double gmma6, entho, smallpp;
+  double cl, cr, wl, wr, ql, qr, px, pn, delp, vxx;
+  double sgnm, ro, vxo, po, wo, co, rx, cx;
+  double spout, spin, ushk, scr, frac;
+  double qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
+
+  smallpp=ph.smallr*ph.smallp;
+  gmma6=(ph.gamma+1.0)/(2.0*ph.gamma);
+  entho=1.0/(ph.gamma-1.0);
+
+  cl=ph.gamma*pl*rl;
+  cr=ph.gamma*pr*rr;
+  wl=sqrt(cl);
+  wr=sqrt(cr);
+
+  //Newton iterations on the pressure at the contact
+  px=fmax(((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr),0.0);
+  for(n=0;n<ph.niter;n++){
+    wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+    wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+    ql=2.0*wl*wl*wl/(wl*wl+cl);
+    qr=2.0*wr*wr*wr/(wr*wr+cr);
+    delp=qr*ql/(qr+ql)*((vxl-(px-pl)/wl)-(vxr+(px-pr)/wr));
+    delp=fmax(delp,-px+ph.smallp);
+    pn=px+delp;
+    px=pn;
+    if(fabs(delp/(pn+smallpp))<1.0e-6)break;
+  }
+
+  wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+  wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+  ql=2.0*wl*wl*wl/(wl*wl+cl);
+  qr=2.0*wr*wr*wr/(wr*wr+cr);
+  vxx=((vxl-(px-pl)/wl)*ql+
+       (vxr+(px-pr)/wr)*qr)/(ql+qr);
+  sgnm   =vxx>=0.0?1.0:-1.0;
+  ro     =vxx>=0.0? rl: rr;
+  vxo    =vxx>=0.0?vxl:vxr;
+  po     =vxx>=0.0? pl: pr;
+  wo     =vxx>=0.0? wl: wr;
+  qgdnvVY=vxx>=0.0?vyl:vyr;
+  co=fmax(ph.smallc,sqrt(fabs(ph.gamma*po/ro)));
+  rx=fmax(ph.smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
+  cx=fmax(ph.smallc,sqrt(fabs(ph.gamma*px/rx)));
+
+  spout=co   -sgnm*vxo;
+  spin =cx   -sgnm*vxx;
+  ushk =wo/ro-sgnm*vxo;
+  if(spout<spin){
+    spin =ushk;
+    spout=ushk;
+  }
+
+  scr=fmax(spout-spin,ph.smallc+fabs(spout+spin));
+  frac=fmax(0.0,fmin(1.0,0.5*(1.0+(spout+spin)/scr)));
+  qgdnvR =frac*rx +(1.0-frac)*ro;
+  qgdnvVX=frac*vxx+(1.0-frac)*vxo;
+  qgdnvP =frac*px +(1.0-frac)*po;
+  if(spout<0.0){
+    qgdnvR =ro;
+    qgdnvVX=vxo;
+    qgdnvP =po;
+  }
+  if(spin>0.0){
+    qgdnvR =rx;
+    qgdnvVX=vxx;
+    qgdnvP =px;
+  }
+
+  f[VARRHO]=qgdnvR*qgdnvVX;
+  f[VARVX ]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+  f[VARVY ]=qgdnvR*qgdnvVX*qgdnvVY;
+  f[VARPR ]=qgdnvVX*(qgdnvP*entho+0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY)+qgdnvP);
+}
+
+//Flux at the face between ql of (i-di,j-dj) and qr of (i,j) into flx
+//at (i,j), by the Riemann solver of hydro_args.scheme
+KOKKOS_INLINE_FUNCTION void riemannFace(const mesh_view &flx, const mesh_view &ql, const mesh_view &qr,
+                                        int i, int j, int di, int dj, const kk_phys &ph){
+  double rl, vxl, vyl, pl, rr, vxr, vyr, pr;
+  double f[NVAR];
+  int v;
+
+  rl =fmax(ql(i-di,j-dj,VARRHO),ph.smallr);
+  vxl=     ql(i-di,j-dj,VARVX );
+  vyl=     ql(i-di,j-dj,VARVY );
+  pl =fmax(ql(i-di,j-dj,VARPR ),rl*ph.smallp);
+
+  rr =fmax(qr(i,j,VARRHO),ph.smallr);
+  vxr=     qr(i,j,VARVX );
+  vyr=     qr(i,j,VARVY );
+  pr =fmax(qr(i,j,VARPR ),rr*ph.smallp);
+
+  if(ph.scheme==SCHEME_HLLC){
+    hllcFlux(ph.gamma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,f,1);
+  }else if(ph.scheme==SCHEME_HLL){
+    hllFlux(ph.gamma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,f,1);
+  }else{
+    riemannExact(f,rl,vxl,vyl,pl,rr,vxr,vyr,pr,ph);
+  }
+  for(v=0;v<NVAR;v++)flx(i,j,v)=f[v];
+}
+
+//Max CFL denominator of the whole mesh, at least smallc
+double meshDenom(){
+  mesh_view u=kk->u;
+  kk_phys ph=phys;
+  double den;
+
+  Kokkos::parallel_reduce("MISH::denom",cell_range({0,0},{kk->nx,kk->ny}),
+    KOKKOS_LAMBDA(int i, int j, double &d){
+      d=fmax(d,cellDenom(u,i,j,ph));
+    },Kokkos::Max<double>(den));
+  return fmax(den,ph.smallc);
+}
+
+//Sum of variable var over the mesh
+double sumVar(int var){
+  mesh_view u=kk->u;
+  double sum;
+
+  Kokkos::parallel_reduce("MISH::sum",cell_range({0,0},{kk->nx,kk->ny}),
+    KOKKOS_LAMBDA(int i, int j, double &s){
+      s+=u(i,j,var);
+    },sum);
+  return sum;
+}
+
+//One pass in direction dir, one kernel per stage, each over the whole
+//mesh. If cdt is set the flux update also reduces the CFL denominator of
+//the updated mesh, which is returned
+double runPass(double dt, int dir, int cdt, double *tPh){
+  mesh_view u=kk->u, q=kk->q, ql=kk->ql, qr=kk->qr, flx=kk->flx;
+  kk_phys ph=phys;
+  int nx=kk->nx, ny=kk->ny;
+  int np, nt, bndL, bndH;
+  int di, dj, vn, vt;
+  double dtdx, den;
+
+  //Neighbours along the pass are (di,dj) apart, and the normal and
+  //transverse velocities of u go to VARVX and VARVY of q
+  di=(dir==0);
+  dj=(dir==1);
+  vn=dir?VARVY:VARVX;
+  vt=dir?VARVX:VARVY;
+  np=dir?ny:nx;
+  nt=dir?nx:ny;
+  bndL=dir?Hp->bndU:Hp->bndL;
+  bndH=dir?Hp->bndD:Hp->bndR;
+  dtdx=dt/(dir?ph.dy:ph.dx);
+
+  Kokkos::parallel_for("MISH::prim",cell_range({0,0},{nx,ny}),
+    KOKKOS_LAMBDA(int i, int j){
+      double r, vx, vy, eint;
+
+      r   =fmax(u(i,j,VARRHO),ph.smallr);
+      vx  =u(i,j,vn)/r;
+      vy  =u(i,j,vt)/r;
+      eint=u(i,j,VARPR)-0.5*r*(vx*vx+vy*vy);
+      q(i+2,j+2,VARRHO)=r;
+      q(i+2,j+2,VARVX )=vx;
+      q(i+2,j+2,VARVY )=vy;
+      q(i+2,j+2,VARPR )=fmax((ph.gamma-1.0)*r*eint,ph.smallp);
+    });
+  phaseAdd(PH_PRIM,tPh);
+
+  //Two boundary cells at each end of each pencil, mirrored from the first
+  //and last two cells. Cell p of pencil t is q(p,t+2) in x, q(t+2,p) in y
+  Kokkos::parallel_for("MISH::bnd",Kokkos::RangePolicy<>(0,4*nt),
+    KOKKOS_LAMBDA(int k){
+      int hi=k/(2*nt), c=k%2, t=(k%(2*nt))/2;
+      int bnd=hi?bndH:bndL;
+      int w=hi?np+2+c:c;
+      int r=hi?np+1-c:3-c;
+      int wi=dir?t+2:w, wj=dir?w:t+2;
+      int ri=dir?t+2:r, rj=dir?r:t+2;
+
+      if(bnd==BND_REFL||bnd==BND_PERM){
+        q(wi,wj,VARRHO)=q(ri,rj,VARRHO);
+        q(wi,wj,VARVX )=(bnd==BND_REFL)?-q(ri,rj,VARVX):q(ri,rj,VARVX);
+        q(wi,wj,VARVY )=q(ri,rj,VARVY);
+        q(wi,wj,VARPR )=q(ri,rj,VARPR);
+      }
+    });
+  phaseAdd(PH_HALO,tPh);
+
+  //Cells 1 to np+2 of each pencil, everything but the outer boundary cells
+  Kokkos::parallel_for("MISH::trace",cell_range({2-di,2-dj},{nx+2+di,ny+2+dj}),
+    KOKKOS_LAMBDA(int i, int j){
+      traceCell(ql,qr,q,i,j,di,dj,dtdx,ph);
+    });
+  phaseAdd(PH_TRACE,tPh);
+
+  //The np+1 faces of each pencil, face f being on the low side of cell
+  //f+2 of q
+  Kokkos::parallel_for("MISH::riemann",cell_range({2,2},{nx+2+di,ny+2+dj}),
+    KOKKOS_LAMBDA(int i, int j){
+      riemannFace(flx,ql,qr,i,j,di,dj,ph);
+    });
+  phaseAdd(PH_RIEMANN,tPh);
+
+  den=0.0;
+  if(cdt){
+    Kokkos::parallel_reduce("MISH::flux_denom",cell_range({0,0},{nx,ny}),
+      KOKKOS_LAMBDA(int i, int j, double &d){
+        u(i,j,VARRHO)+=dtdx*(flx(i+2,j+2,VARRHO)-flx(i+2+di,j+2+dj,VARRHO));
+        u(i,j,vn    )+=dtdx*(flx(i+2,j+2,VARVX )-flx(i+2+di,j+2+dj,VARVX ));
+        u(i,j,vt    )+=dtdx*(flx(i+2,j+2,VARVY )-flx(i+2+di,j+2+dj,VARVY ));
+        u(i,j,VARPR )+=dtdx*(flx(i+2,j+2,VARPR )-flx(i+2+di,j+2+dj,VARPR ));
+        d=fmax(d,cellDenom(u,i,j,ph));
+      },Kokkos::Max<double>(den));
+    den=fmax(den,ph.smallc);
+  }else{
+    Kokkos::parallel_for("MISH::flux",cell_range({0,0},{nx,ny}),
+      KOKKOS_LAMBDA(int i, int j){
+        u(i,j,VARRHO)+=dtdx*(flx(i+2,j+2,VARRHO)-flx(i+2+di,j+2+dj,VARRHO));
+        u(i,j,vn    )+=dtdx*(flx(i+2,j+2,VARVX )-flx(i+2+di,j+2+dj,VARVX ));
+        u(i,j,vt    )+=dtdx*(flx(i+2,j+2,VARVY )-flx(i+2+di,j+2+dj,VARVY ));
+        u(i,j,VARPR )+=dtdx*(flx(i+2,j+2,VARPR )-flx(i+2+di,j+2+dj,VARPR ));
+      });
+  }
+  phaseAdd(PH_FLUX,tPh);
+  return den;
+}
+
+//(Re)allocate the device mesh and scratch for an nx x ny mesh. Nothing is
+//read before it is written, so nothing is initialised
+void getViews(int nx, int ny){
+  if(kk->nx==nx&&kk->ny==ny)return;
+  kk->u  =mesh_view(Kokkos::ViewAllocateWithoutInitializing("MISH::u"),nx,ny,NVAR);
+  kk->q  =mesh_view(Kokkos::ViewAllocateWithoutInitializing("MISH::q"),nx+4,ny+4,NVAR);
+  kk->ql =mesh_view(Kokkos::ViewAllocateWithoutInitializing("MISH::ql"),nx+4,ny+4,NVAR);
+  kk->qr =mesh_view(Kokkos::ViewAllocateWithoutInitializing("MISH::qr"),nx+4,ny+4,NVAR);
+  kk->flx=mesh_view(Kokkos::ViewAllocateWithoutInitializing("MISH::flx"),nx+4,ny+4,NVAR);
+  kk->hu =Kokkos::create_mirror_view(kk->u);
+  kk->nx=nx;
+  kk->ny=ny;
+}
+
+//Copy the caller's mesh to the device (back=0) or the device mesh to the
+//caller's (back=1), through the host mirror, which has the device layout
+void copyMesh(double *mesh, int back){
+  host_mesh hm(mesh,kk->nx,kk->ny,NVAR);
+
+  if(back){
+    Kokkos::deep_copy(kk->hu,kk->u);
+    Kokkos::deep_copy(hm,kk->hu);
+  }else{
+    Kokkos::deep_copy(kk->hu,hm);
+    Kokkos::deep_copy(kk->u,kk->hu);
+  }
+}
+
+void engine(int *argc, char **argv[], double *mesh, hydro_prob *Hyp, hydro_args *Hya){
+  int n, odd, onHost;
+  double dt, den;
+  double cTime, nxttout;
+  double volCell;
+  double oTM, oTE;
+  double TM, TE;
+  double initT, endT;
+  double tPh;
+  char outfile[30];
+
+  Hp=Hyp;
+  Ha=Hya;
+
+  //If no end condition provided, end without running
+  if(Ha->nstepmax<0&&Ha->tend<0.0)return;
+
+  //Kokkos takes its --kokkos-* arguments from the command line
+  if(!Kokkos::is_initialized()){
+    Kokkos::initialize(*argc,*argv);
+    kk=new kk_state;
+    kk->nx=-1;
+    kk->ny=-1;
+    kkProfile=getenv("MISH_KK_PROFILE")?atoi(getenv("MISH_KK_PROFILE")):0;
+  }
+  onHost=Kokkos::SpaceAccessibility<Kokkos::HostSpace,Kokkos::DefaultExecutionSpace::memory_space>::accessible;
+  printf("Kokkos execution space %s, concurrency %d\n",Kokkos::DefaultExecutionSpace::name(),
+         (int)Kokkos::DefaultExecutionSpace().concurrency());
+
+  phys.gamma =Hp->gamma;
+  phys.smallr=Ha->smallr;
+  phys.smallc=Ha->smallc;
+  phys.smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  phys.dx    =Hp->dx;
+  phys.dy    =Hp->dy;
+  phys.niter =Ha->niter_riemann;
+  phys.scheme=Ha->scheme;
+  getViews(Hp->nx,Hp->ny);
+
+  n=0;
+  den=0.0;
+  cTime=0.0;
+  nxttout=-1.0;
+
+  //Set initial value of next time to aim to hit exactly
+  if(Ha->tend>0.0){
+    nxttout=Ha->tend;
+  }
+  if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
+    nxttout=Ha->dtoutput;
+  }
+
+  //Print initial condition
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+
+  //The mesh stays on the device until the end of the run
+  copyMesh(mesh,0);
+  volCell=Hp->dx*Hp->dy;
+  oTM=sumVar(VARRHO);
+  oTE=sumVar(VARPR);
+  printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
+
+  //The kernels only run in step with the host when profiling; otherwise
+  //only the timestep and output are timed
+  initTiming(&Ht,"Kokkos",onHost?"CPU":"GPU",1,onHost?(int)Kokkos::DefaultExecutionSpace().concurrency():1);
+  if(!kkProfile){
+    Ht.phase[PH_PRIM]=-1.0;
+    Ht.phase[PH_HALO]=-1.0;
+    Ht.phase[PH_TRACE]=-1.0;
+    Ht.phase[PH_RIEMANN]=-1.0;
+    Ht.phase[PH_FLUX]=-1.0;
+  }
+  initT=wallNow();
+
+  while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
+    //The last pass of the previous step found the CFL denominator, unless
+    //this is the first step
+    PH_START(tPh);
+    if(den<=0.0)den=meshDenom();
+    dt=Ha->sigma*(0.5/den);
+    PH_ADD(Ht.phase,PH_DT,tPh);
+    if(nxttout>0.0&&dt>(nxttout-cTime)){
+      printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+      dt=(nxttout-cTime);
+    }
+    odd=(Hp->nstep+n)%2;
+    runPass(dt,odd,0,&tPh);
+    den=runPass(dt,!odd,FUSE_DT,&tPh);
+    n+=1;
+    cTime+=dt;
+    PH_START(tPh);
+    //Print simple output line
+    if(n%Ha->nprtLine==0){
+      TM=sumVar(VARRHO);
+      TE=sumVar(VARPR);
+      printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+    }
+    //Print visualization file
+    if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(cTime>=nxttout&&nxttout>0.0){
+        nxttout+=Ha->dtoutput;
+        if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
+      }
+      copyMesh(mesh,1);
+      snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+      writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+  }
+  Kokkos::fence();
+  printf("time: %f, %d iters run\n",cTime,n);
+
+  endT=wallNow();
+
+  //Print timing information in manner easily extracted to process as csv
+  Ht.niters=n;
+  Ht.ncells=Hp->nx*Hp->ny;
+  Ht.runt=endT-initT;
+  printTiming(&Ht,Ha);
+
+  //The last snapshot may share the final condition's name
+  waitVis();
+
+  //Print final condition
+  copyMesh(mesh,1);
+  snprintf(outfile,29,"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+
+  Hp->t+=cTime;
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestart(Ha->chkFile,mesh,Hp);
+}
+
+//The views have to go before Kokkos is finalized
+void freeScratch(){
+  delete kk;
+  kk=NULL;
+  if(Kokkos::is_initialized())Kokkos::finalize();
+}
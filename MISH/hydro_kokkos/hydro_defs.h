@@ -0,0 +1,25 @@
+#ifndef HYDRO_DEFS_H_
+#define HYDRO_DEFS_H_
+
+#define MAX(x,y) ((x)<(y))?(y):(x)
+#define MIN(x,y) ((x)>(y))?(y):(x)
+
+#define VARRHO 0
+#define VARVX  1
+#define VARVY  2
+#define VARPR  3
+#define NVAR   4
+
+#define BND_REFL 0
+#define BND_PERM 1
+
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//reduction over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+#endif //HYDRO_DEFS_H_
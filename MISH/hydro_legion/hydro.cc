@@ -0,0 +1,867 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+#include <vector>
+#include <set>
+#include "legion.h"
+#include "hydro.h"
+#include "restart.h"
+#include "outfile.h"
+#include "timing.h"
+#include "riemann_approx.h"
+
+using namespace LegionRuntime::HighLevel;
+using namespace LegionRuntime::Accessor;
+using namespace LegionRuntime::Arrays;
+
+//The mesh is a 2-D region of the conserved variables, cut into tiles by a
+//disjoint partition. The pass scratch (q, ql, qr and flx) is a second
+//region over the mesh plus the 2 cell boundary ring, with the same tiles,
+//the ring going to the tiles on the edge, and an aliased ghost partition
+//per direction that widens each tile by a cell along the pass. Every stage
+//of a pass is an index launch of a leaf task over the tiles, reading its
+//neighbours' cells through the ghost partition, so a tile of one stage
+//(or of the next pass) only waits for the tiles it reads from. The
+//scratch holds the velocity normal to the pass in VARVX in both passes
+typedef struct __lgMesh{
+  LogicalRegion u, s;
+  LogicalPartition uTile, sTile, sGhost[2];
+  Domain tiles;
+  int ntx, nty;
+} lg_mesh;
+
+//Physics constants and the pass of a leaf task. dt is the timestep if
+//the host knows it, or negative if the task gets it from the CFL
+//denominator future it is given
+typedef struct __lgPass{
+  double gamma, smallr, smallc, smallp, sigma;
+  double dx, dy, dt;
+  int niter, scheme;
+  int nx, ny;
+  int dir, bndL, bndH, cdt, var;
+} lg_pass;
+
+//The problems engineBatch was given, which the top level task runs
+typedef struct __lgBatch{
+  int nb;
+  double **mesh;
+  hydro_prob *Hp;
+  hydro_args *Ha;
+} lg_batch;
+
+hydro_args *Ha;
+hydro_prob *Hp;
+hydro_timing Ht;
+lg_batch batch;
+
+//Combines the CFL denominators of the tiles
+class MaxRedop {
+public:
+  typedef double LHS;
+  typedef double RHS;
+  static const double identity;
+
+  template <bool EXCLUSIVE>
+  static void apply(LHS &lhs, RHS rhs){ lhs=fmax(lhs,rhs); }
+
+  template <bool EXCLUSIVE>
+  static void fold(RHS &rhs1, RHS rhs2){ rhs1=fmax(rhs1,rhs2); }
+};
+const double MaxRedop::identity=-DBL_MAX;
+
+//Combines the conservation sums of the tiles
+class SumRedop {
+public:
+  typedef double LHS;
+  typedef double RHS;
+  static const double identity;
+
+  template <bool EXCLUSIVE>
+  static void apply(LHS &lhs, RHS rhs){ lhs+=rhs; }
+
+  template <bool EXCLUSIVE>
+  static void fold(RHS &rhs1, RHS rhs2){ rhs1+=rhs2; }
+};
+const double SumRedop::identity=0.0;
+
+//Field fid of a mapped region, indexed by mesh cell (i,j) whatever the
+//instance's layout
+typedef struct __lgField{
+  char *base;
+  ptrdiff_t si, sj;
+  double &operator()(int i, int j) const { return *(double*)(base+i*si+j*sj); }
+} lg_field;
+
+//Field fid of region pr, and the cells it covers in rect
+lg_field getField(const PhysicalRegion &pr, FieldID fid, Rect<2> &rect, Context ctx, HighLevelRuntime *rt){
+  RegionAccessor<AccessorType::Generic,double> acc=pr.get_field_accessor(fid,true).typeify<double>();
+  Domain dom=rt->get_index_space_domain(ctx,pr.get_logical_region().get_index_space());
+  Rect<2> sub;
+  ByteOffset off[2];
+  lg_field f;
+  double *p;
+
+  rect=dom.get_rect<2>();
+  p=acc.raw_rect_ptr<2>(rect,sub,off);
+  assert(p!=NULL&&sub==rect);
+  f.si=off[0].offset;
+  f.sj=off[1].offset;
+  f.base=(char*)p-rect.lo.x[0]*f.si-rect.lo.x[1]*f.sj;
+  return f;
+}
+
+//The fields fid0 to fid0+NVAR-1 of pr, as getField
+void getFields(lg_field *f, const PhysicalRegion &pr, FieldID fid0, Rect<2> &rect, Context ctx, HighLevelRuntime *rt){
+  int v;
+
+  for(v=0;v<NVAR;v++)f[v]=getField(pr,fid0+v,rect,ctx,rt);
+}
+
+//Timestep of a pass task: the host's, or from the CFL denominator future
+double passDt(const lg_pass *a, const Task *task){
+  double den;
+
+  if(a->dt>0.0)return a->dt;
+  den=task->futures[0].get_result<double>(true);
+  return a->sigma*(0.5/den);
+}
+
+//CFL denominator of cell (i,j) of u
+inline double cellDenom(const lg_field *u, int i, int j, const lg_pass *a){
+  double r, vx, vy, eint, p, c;
+
+  r   =fmax(u[VARRHO](i,j),a->smallr);
+  vx  =u[VARVX](i,j)/r;
+  vy  =u[VARVY](i,j)/r;
+  eint=u[VARPR](i,j)-0.5*r*(vx*vx+vy*vy);
+  p   =fmax((a->gamma-1.0)*eint,r*a->smallp);
+  c   =sqrt(a->gamma*p/r);
+  return (c+fabs(vx))/a->dx+(c+fabs(vy))/a->dy;
+}
+
+//Limited slope of q at (i,j), along the pass (di,dj). As the C slope(),
+//whose MIN macro drops the sign
+inline double slope(const lg_field &q, int i, int j, int di, int dj){
+  double dlft, drgt, dcen, dlim;
+
+  dlft=q(i,j)-q(i-di,j-dj);
+  drgt=q(i+di,j+dj)-q(i,j);
+  dcen=0.5*(dlft+drgt);
+  dlim=(dlft*drgt<=0.0)?0.0:fmin(fabs(dlft),fabs(drgt));
+  return fmin(dlim,fabs(dcen));
+}
+
+//Godunov flux f between the floored left and right states, by the exact
+//solver of the C implementation
+void riemannExact(double *f, double rl, double vxl, double vyl, double pl,
+                  double rr, double vxr, double vyr, double pr, const lg_pass *a){
+  int n;
+  double gmma6, entho, smallpp;
+  double cl, cr, wl, wr, ql, qr, px, pn, delp, vxx;
+  double sgnm, ro, vxo, po, wo, co, rx, cx;
+  double spout, spin, ushk, scr, frac;
+  double qgdnvR, qgdnvVX, qgdnvVY, qgdnvP;
+
+  smallpp=a->smallr*a->smallp;
+  gmma6=(a->gamma+1.0)/(2.0*a->gamma);
+  entho=1.0/(a->gamma-1.0);
+
+  cl=a->gamma*pl*rl;
+  cr=a->gamma*pr*rr;
+  wl=sqrt(cl);
+  wr=sqrt(cr);
+
+  //Newton iterations on the pressure at the contact
+  px=fmax(((wr*pl+wl*pr)+wl*wr*(vxl-vxr))/(wl+wr),0.0);
+  for(n=0;n<a->niter;n++){
+    wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+    wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+    ql=2.0*wl*wl*wl/(wl*wl+cl);
+    qr=2.0*wr*wr*wr/(wr*wr+cr);
+    delp=qr*ql/(qr+ql)*((vxl-(px-pl)/wl)-(vxr+(px-pr)/wr));
+    delp=fmax(delp,-px+a->smallp);
+    pn=px+delp;
+    px=pn;
+    if(fabs(delp/(pn+smallpp))<1.0e-6)break;
+  }
+
+  wl=sqrt(cl*(1.0+gmma6*(px-pl)/pl));
+  wr=sqrt(cr*(1.0+gmma6*(px-pr)/pr));
+  ql=2.0*wl*wl*wl/(wl*wl+cl);
+  qr=2.0*wr*wr*wr/(wr*wr+cr);
+  vxx=((vxl-(px-pl)/wl)*ql+
+       (vxr+(px-pr)/wr)*qr)/(ql+qr);
+  sgnm   =vxx>=0.0?1.0:-1.0;
+  ro     =vxx>=0.0? rl: rr;
+  vxo    =vxx>=0.0?vxl:vxr;
+  po     =vxx>=0.0? pl: pr;
+  wo     =vxx>=0.0? wl: wr;
+  qgdnvVY=vxx>=0.0?vyl:vyr;
+  co=fmax(a->smallc,sqrt(fabs(a->gamma*po/ro)));
+  rx=fmax(a->smallr,ro/(1.0+ro*(po-px)/(wo*wo)));
+  cx=fmax(a->smallc,sqrt(fabs(a->gamma*px/rx)));
+
+  spout=co   -sgnm*vxo;
+  spin =cx   -sgnm*vxx;
+  ushk =wo/ro-sgnm*vxo;
+  if(spout<spin){
+    spin =ushk;
+    spout=ushk;
+  }
+
+  scr=fmax(spout-spin,a->smallc+fabs(spout+spin));
+  frac=fmax(0.0,fmin(1.0,0.5*(1.0+(spout+spin)/scr)));
+  qgdnvR =frac*rx +(1.0-frac)*ro;
+  qgdnvVX=frac*vxx+(1.0-frac)*vxo;
+  qgdnvP =frac*px +(1.0-frac)*po;
+  if(spout<0.0){
+    qgdnvR =ro;
+    qgdnvVX=vxo;
+    qgdnvP =po;
+  }
+  if(spin>0.0){
+    qgdnvR =rx;
+    qgdnvVX=vxx;
+    qgdnvP =px;
+  }
+
+  f[VARRHO]=qgdnvR*qgdnvVX;
+  f[VARVX ]=qgdnvR*qgdnvVX*qgdnvVX+qgdnvP;
+  f[VARVY ]=qgdnvR*qgdnvVX*qgdnvVY;
+  f[VARPR ]=qgdnvVX*(qgdnvP*entho+0.5*qgdnvR*(qgdnvVX*qgdnvVX+qgdnvVY*qgdnvVY)+qgdnvP);
+}
+
+//Primitives of the tile's cells into q, and the boundary cells of q along
+//the pass that belong to the tile, mirrored from its first or last two
+//cells. Tiles are at least 2 cells wide, so those are its own
+void primTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+              Context ctx, HighLevelRuntime *rt){
+  const lg_pass *a=(const lg_pass*)task->args;
+  lg_field u[NVAR], q[NVAR];
+  Rect<2> ur, sr;
+  int i, j, w, r, di, dj, vn, vt, np, bnd;
+  double rho, vx, vy, eint;
+
+  getFields(u,regions[0],FID_U,ur,ctx,rt);
+  getFields(q,regions[1],FID_Q,sr,ctx,rt);
+  di=(a->dir==0);
+  dj=(a->dir==1);
+  vn=a->dir?VARVY:VARVX;
+  vt=a->dir?VARVX:VARVY;
+  np=a->dir?a->ny:a->nx;
+
+  for(j=ur.lo.x[1];j<=ur.hi.x[1];j++){
+    for(i=ur.lo.x[0];i<=ur.hi.x[0];i++){
+      rho =fmax(u[VARRHO](i,j),a->smallr);
+      vx  =u[vn](i,j)/rho;
+      vy  =u[vt](i,j)/rho;
+      eint=u[VARPR](i,j)-0.5*rho*(vx*vx+vy*vy);
+      q[VARRHO](i,j)=rho;
+      q[VARVX ](i,j)=vx;
+      q[VARVY ](i,j)=vy;
+      q[VARPR ](i,j)=fmax((a->gamma-1.0)*rho*eint,a->smallp);
+    }
+  }
+
+  //Ghost cell w of each pencil of the tile is mirrored from cell r
+  for(j=ur.lo.x[1]-2*dj;j<=ur.hi.x[1]+2*dj;j++){
+    for(i=ur.lo.x[0]-2*di;i<=ur.hi.x[0]+2*di;i++){
+      w=a->dir?j:i;
+      if(w>=0&&w<np)continue;
+      if((a->dir?sr.lo.x[1]:sr.lo.x[0])>w||(a->dir?sr.hi.x[1]:sr.hi.x[0])<w)continue;
+      bnd=(w<0)?a->bndL:a->bndH;
+      r=(w<0)?-1-w:2*np-1-w;
+      if(bnd!=BND_REFL&&bnd!=BND_PERM)continue;
+      q[VARRHO](i,j)=q[VARRHO](a->dir?i:r,a->dir?r:j);
+      q[VARVX ](i,j)=(bnd==BND_REFL?-1.0:1.0)*q[VARVX](a->dir?i:r,a->dir?r:j);
+      q[VARVY ](i,j)=q[VARVY ](a->dir?i:r,a->dir?r:j);
+      q[VARPR ](i,j)=q[VARPR ](a->dir?i:r,a->dir?r:j);
+    }
+  }
+}
+
+//Traced left and right states into ql and qr of the tile's cells, the
+//boundary cells next to the mesh included
+void traceTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+               Context ctx, HighLevelRuntime *rt){
+  const lg_pass *a=(const lg_pass*)task->args;
+  lg_field q[NVAR], ql[NVAR], qr[NVAR];
+  Rect<2> gr, sr;
+  int i, j, p, di, dj, np;
+  double dtdx;
+  double r, u, v1, pr, csq, cc;
+  double dr, du, dv1, dp;
+  double alpham, alphap, alphazr;
+  double spminus, spzero, spplus;
+  double ap, am, azr, azv1;
+
+  getFields(q,regions[0],FID_Q,gr,ctx,rt);
+  getFields(ql,regions[1],FID_QL,sr,ctx,rt);
+  getFields(qr,regions[1],FID_QR,sr,ctx,rt);
+  di=(a->dir==0);
+  dj=(a->dir==1);
+  np=a->dir?a->ny:a->nx;
+  dtdx=passDt(a,task)/(a->dir?a->dy:a->dx);
+
+  for(j=sr.lo.x[1];j<=sr.hi.x[1];j++){
+    for(i=sr.lo.x[0];i<=sr.hi.x[0];i++){
+      //Cells -1 to np along the pass, within the mesh across it
+      p=a->dir?j:i;
+      if(p<-1||p>np||(a->dir?i:j)<0||(a->dir?i:j)>=(a->dir?a->nx:a->ny))continue;
+
+      r =q[VARRHO](i,j);
+      u =q[VARVX ](i,j);
+      v1=q[VARVY ](i,j);
+      pr=q[VARPR ](i,j);
+
+      csq=a->gamma*pr/r;
+      cc=sqrt(csq);
+
+      dr =slope(q[VARRHO],i,j,di,dj);
+      du =slope(q[VARVX ],i,j,di,dj);
+      dv1=slope(q[VARVY ],i,j,di,dj);
+      dp =slope(q[VARPR ],i,j,di,dj);
+
+      alpham = 0.5*(dp/(r*cc)-du)*r/cc;
+      alphap = 0.5*(dp/(r*cc)+du)*r/cc;
+      alphazr= dr-dp/csq;
+
+      //right
+      spminus=((u-cc)>=0.0)?0.0:(u-cc)*dtdx+1.0;
+      spzero =((u   )>=0.0)?0.0:(u   )*dtdx+1.0;
+      spplus =((u+cc)>=0.0)?0.0:(u+cc)*dtdx+1.0;
+      ap  =-0.5*spplus *alphap ;
+      am  =-0.5*spminus*alpham ;
+      azr =-0.5*spzero *alphazr;
+      azv1=-0.5*spzero *dv1;
+      qr[VARRHO](i,j)=r +(ap+am+azr);
+      qr[VARVX ](i,j)=u +(ap-am    )*cc/r;
+      qr[VARVY ](i,j)=v1+(azv1     );
+      qr[VARPR ](i,j)=pr+(ap+am    )*csq;
+
+      //left
+      spminus=((u-cc)<=0.0)?0.0:(u-cc)*dtdx-1.0;
+      spzero =((u   )<=0.0)?0.0:(u   )*dtdx-1.0;
+      spplus =((u+cc)<=0.0)?0.0:(u+cc)*dtdx-1.0;
+      ap  =-0.5*spplus *alphap ;
+      am  =-0.5*spminus*alpham ;
+      azr =-0.5*spzero *alphazr;
+      azv1=-0.5*spzero *dv1;
+      ql[VARRHO](i,j)=r +(ap+am+azr);
+      ql[VARVX ](i,j)=u +(ap-am    )*cc/r;
+      ql[VARVY ](i,j)=v1+(azv1     );
+      ql[VARPR ](i,j)=pr+(ap+am    )*csq;
+    }
+  }
+}
+
+//Flux through the low face of the tile's cells, between ql of the cell
+//before and qr of the cell, by the Riemann solver of hydro_args.scheme.
+//The edge tile also has the mesh's last face, on the low side of cell np
+void riemannTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+                 Context ctx, HighLevelRuntime *rt){
+  const lg_pass *a=(const lg_pass*)task->args;
+  lg_field ql[NVAR], qr[NVAR], flx[NVAR];
+  Rect<2> gr, sr;
+  int i, j, p, di, dj, np, v;
+  double rl, vxl, vyl, pl, rr, vxr, vyr, pr;
+  double f[NVAR];
+
+  getFields(ql,regions[0],FID_QL,gr,ctx,rt);
+  getFields(qr,regions[0],FID_QR,gr,ctx,rt);
+  getFields(flx,regions[1],FID_F,sr,ctx,rt);
+  di=(a->dir==0);
+  dj=(a->dir==1);
+  np=a->dir?a->ny:a->nx;
+
+  for(j=sr.lo.x[1];j<=sr.hi.x[1];j++){
+    for(i=sr.lo.x[0];i<=sr.hi.x[0];i++){
+      p=a->dir?j:i;
+      if(p<0||p>np||(a->dir?i:j)<0||(a->dir?i:j)>=(a->dir?a->nx:a->ny))continue;
+
+      rl =fmax(ql[VARRHO](i-di,j-dj),a->smallr);
+      vxl=     ql[VARVX ](i-di,j-dj);
+      vyl=     ql[VARVY ](i-di,j-dj);
+      pl =fmax(ql[VARPR ](i-di,j-dj),rl*a->smallp);
+
+      rr =fmax(qr[VARRHO](i,j),a->smallr);
+      vxr=     qr[VARVX ](i,j);
+      vyr=     qr[VARVY ](i,j);
+      pr =fmax(qr[VARPR ](i,j),rr*a->smallp);
+
+      if(a->scheme==SCHEME_HLLC){
+        hllcFlux(a->gamma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,f,1);
+      }else if(a->scheme==SCHEME_HLL){
+        hllFlux(a->gamma,rl,vxl,vyl,pl,rr,vxr,vyr,pr,f,1);
+      }else{
+        riemannExact(f,rl,vxl,vyl,pl,rr,vxr,vyr,pr,a);
+      }
+      for(v=0;v<NVAR;v++)flx[v](i,j)=f[v];
+    }
+  }
+}
+
+//Flux differences into the tile's cells of u. If cdt is set, returns the
+//max CFL denominator of the updated cells, at least smallc
+double fluxTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+                Context ctx, HighLevelRuntime *rt){
+  const lg_pass *a=(const lg_pass*)task->args;
+  lg_field flx[NVAR], u[NVAR];
+  Rect<2> gr, ur;
+  int i, j, di, dj, vn, vt;
+  double dtdx, den;
+
+  getFields(flx,regions[0],FID_F,gr,ctx,rt);
+  getFields(u,regions[1],FID_U,ur,ctx,rt);
+  di=(a->dir==0);
+  dj=(a->dir==1);
+  vn=a->dir?VARVY:VARVX;
+  vt=a->dir?VARVX:VARVY;
+  dtdx=passDt(a,task)/(a->dir?a->dy:a->dx);
+
+  den=a->smallc;
+  for(j=ur.lo.x[1];j<=ur.hi.x[1];j++){
+    for(i=ur.lo.x[0];i<=ur.hi.x[0];i++){
+      u[VARRHO](i,j)+=dtdx*(flx[VARRHO](i,j)-flx[VARRHO](i+di,j+dj));
+      u[vn    ](i,j)+=dtdx*(flx[VARVX ](i,j)-flx[VARVX ](i+di,j+dj));
+      u[vt    ](i,j)+=dtdx*(flx[VARVY ](i,j)-flx[VARVY ](i+di,j+dj));
+      u[VARPR ](i,j)+=dtdx*(flx[VARPR ](i,j)-flx[VARPR ](i+di,j+dj));
+      if(a->cdt)den=fmax(den,cellDenom(u,i,j,a));
+    }
+  }
+  return den;
+}
+
+//Max CFL denominator of the tile's cells, at least smallc
+double denomTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+                 Context ctx, HighLevelRuntime *rt){
+  const lg_pass *a=(const lg_pass*)task->args;
+  lg_field u[NVAR];
+  Rect<2> ur;
+  int i, j;
+  double den;
+
+  getFields(u,regions[0],FID_U,ur,ctx,rt);
+  den=a->smallc;
+  for(j=ur.lo.x[1];j<=ur.hi.x[1];j++){
+    for(i=ur.lo.x[0];i<=ur.hi.x[0];i++){
+      den=fmax(den,cellDenom(u,i,j,a));
+    }
+  }
+  return den;
+}
+
+//Sum of variable var over the tile's cells
+double sumTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+               Context ctx, HighLevelRuntime *rt){
+  const lg_pass *a=(const lg_pass*)task->args;
+  lg_field u;
+  Rect<2> ur;
+  int i, j;
+  double sum;
+
+  u=getField(regions[0],FID_U+a->var,ur,ctx,rt);
+  sum=0.0;
+  for(j=ur.lo.x[1];j<=ur.hi.x[1];j++){
+    for(i=ur.lo.x[0];i<=ur.hi.x[0];i++){
+      sum+=u(i,j);
+    }
+  }
+  return sum;
+}
+
+//Requirement on the fields fid0 to fid0+nf-1 of the tiles lp of parent
+void addFields(IndexLauncher &il, LogicalPartition lp, LogicalRegion parent,
+               PrivilegeMode priv, FieldID fid0, int nf){
+  int v;
+
+  il.add_region_requirement(RegionRequirement(lp,0,priv,EXCLUSIVE,parent));
+  for(v=0;v<nf;v++)il.region_requirements.back().add_field(fid0+v);
+}
+
+//Launch the leaf task tid over the tiles of m, reading the mesh
+Future launchMeshReduce(int tid, int redop, lg_pass *a, lg_mesh *m, Context ctx, HighLevelRuntime *rt){
+  IndexLauncher il(tid,m->tiles,TaskArgument(a,sizeof(lg_pass)),ArgumentMap());
+
+  addFields(il,m->uTile,m->u,READ_ONLY,FID_U,NVAR);
+  return rt->execute_index_space(ctx,il,redop);
+}
+
+//Max CFL denominator of the mesh, as a future
+Future meshDenom(lg_pass *a, lg_mesh *m, Context ctx, HighLevelRuntime *rt){
+  return launchMeshReduce(DENOM_TID,MAX_REDOP,a,m,ctx,rt);
+}
+
+//Sum of variable var over the mesh
+double sumVar(int var, lg_pass *a, lg_mesh *m, Context ctx, HighLevelRuntime *rt){
+  lg_pass sa=*a;
+
+  sa.var=var;
+  return launchMeshReduce(SUM_TID,SUM_REDOP,&sa,m,ctx,rt).get_result<double>(true);
+}
+
+//Launch one pass in direction dir, with timestep dt, or from the CFL
+//denominator den if dt is negative. If cdt is set the flux update also
+//reduces the CFL denominator of the updated mesh, whose future is returned
+Future runPass(double dt, Future den, int dir, int cdt, lg_pass *a, lg_mesh *m,
+               Context ctx, HighLevelRuntime *rt){
+  lg_pass pa=*a;
+
+  pa.dt=dt;
+  pa.dir=dir;
+  pa.cdt=cdt;
+  pa.bndL=dir?Hp->bndU:Hp->bndL;
+  pa.bndH=dir?Hp->bndD:Hp->bndR;
+  TaskArgument arg(&pa,sizeof(lg_pass));
+
+  IndexLauncher prim(PRIM_TID,m->tiles,arg,ArgumentMap());
+  addFields(prim,m->uTile,m->u,READ_ONLY,FID_U,NVAR);
+  addFields(prim,m->sTile,m->s,WRITE_DISCARD,FID_Q,NVAR);
+  rt->execute_index_space(ctx,prim);
+
+  IndexLauncher trace(TRACE_TID,m->tiles,arg,ArgumentMap());
+  addFields(trace,m->sGhost[dir],m->s,READ_ONLY,FID_Q,NVAR);
+  addFields(trace,m->sTile,m->s,WRITE_DISCARD,FID_QL,2*NVAR);
+  if(dt<0.0)trace.add_future(den);
+  rt->execute_index_space(ctx,trace);
+
+  IndexLauncher riemann(RIEMANN_TID,m->tiles,arg,ArgumentMap());
+  addFields(riemann,m->sGhost[dir],m->s,READ_ONLY,FID_QL,2*NVAR);
+  addFields(riemann,m->sTile,m->s,WRITE_DISCARD,FID_F,NVAR);
+  rt->execute_index_space(ctx,riemann);
+
+  IndexLauncher flux(FLUX_TID,m->tiles,arg,ArgumentMap());
+  addFields(flux,m->sGhost[dir],m->s,READ_ONLY,FID_F,NVAR);
+  addFields(flux,m->uTile,m->u,READ_WRITE,FID_U,NVAR);
+  if(dt<0.0)flux.add_future(den);
+  if(cdt)return rt->execute_index_space(ctx,flux,MAX_REDOP);
+  rt->execute_index_space(ctx,flux);
+  return Future();
+}
+
+//Bounds of tile t of n along a side of nc cells
+void tileBounds(int t, int n, int nc, int *lo, int *hi){
+  *lo=(int)(((long)nc*t)/n);
+  *hi=(int)(((long)nc*(t+1))/n)-1;
+}
+
+//Number of CPU processors in the machine
+int getNumProcs(){
+  std::set<Processor> all;
+  int np=0;
+
+  Realm::Machine::get_machine().get_all_processors(all);
+  for(std::set<Processor>::iterator p=all.begin();p!=all.end();p++){
+    if(p->kind()==Processor::LOC_PROC)np++;
+  }
+  return np;
+}
+
+//Create the mesh and scratch regions of an nx by ny mesh and their tile
+//and ghost partitions. The tiles are MISH_LG_TILES (e.g. "4x8"), or about
+//two per CPU, as square as the mesh allows and at least 2 cells a side
+void makeMesh(lg_mesh *m, int nx, int ny, int nproc, Context ctx, HighLevelRuntime *rt){
+  IndexSpace uis, sis;
+  FieldSpace ufs, sfs;
+  IndexPartition ip;
+  DomainColoring uCol, sCol, gCol[2];
+  Rect<2> sBox, r, g;
+  int tx, ty, t, v, d, nt;
+  int x0, x1, y0, y1;
+  char *env;
+
+  env=getenv("MISH_LG_TILES");
+  if(env==NULL||sscanf(env,"%dx%d",&m->ntx,&m->nty)!=2){
+    nt=2*nproc;
+    m->ntx=(int)(sqrt((double)nt*nx/ny)+0.5);
+    m->ntx=MIN(MAX(m->ntx,1),nx/2);
+    m->nty=(nt+m->ntx-1)/m->ntx;
+  }
+  m->ntx=MIN(MAX(m->ntx,1),nx/2);
+  m->nty=MIN(MAX(m->nty,1),ny/2);
+  m->tiles=Domain::from_rect<1>(Rect<1>(Point<1>(0),Point<1>(m->ntx*m->nty-1)));
+
+  uis=rt->create_index_space(ctx,Domain::from_rect<2>(Rect<2>(make_point(0,0),make_point(nx-1,ny-1))));
+  sBox=Rect<2>(make_point(-2,-2),make_point(nx+1,ny+1));
+  sis=rt->create_index_space(ctx,Domain::from_rect<2>(sBox));
+  ufs=rt->create_field_space(ctx);
+  sfs=rt->create_field_space(ctx);
+  {
+    FieldAllocator ua=rt->create_field_allocator(ctx,ufs);
+    FieldAllocator sa=rt->create_field_allocator(ctx,sfs);
+    for(v=0;v<NVAR;v++)ua.allocate_field(sizeof(double),FID_U+v);
+    for(v=0;v<4*NVAR;v++)sa.allocate_field(sizeof(double),FID_Q+v);
+  }
+  m->u=rt->create_logical_region(ctx,uis,ufs);
+  m->s=rt->create_logical_region(ctx,sis,sfs);
+  rt->attach_name(m->u,"MISH::u");
+  rt->attach_name(m->s,"MISH::scratch");
+
+  for(ty=0;ty<m->nty;ty++){
+    for(tx=0;tx<m->ntx;tx++){
+      t=tx+m->ntx*ty;
+      tileBounds(tx,m->ntx,nx,&x0,&x1);
+      tileBounds(ty,m->nty,ny,&y0,&y1);
+      uCol[t]=Domain::from_rect<2>(Rect<2>(make_point(x0,y0),make_point(x1,y1)));
+      //The boundary ring goes to the tiles on the edge
+      if(tx==0)x0-=2;
+      if(ty==0)y0-=2;
+      if(tx==m->ntx-1)x1+=2;
+      if(ty==m->nty-1)y1+=2;
+      r=Rect<2>(make_point(x0,y0),make_point(x1,y1));
+      sCol[t]=Domain::from_rect<2>(r);
+      for(d=0;d<2;d++){
+        g=Rect<2>(make_point(x0-(d==0),y0-(d==1)),make_point(x1+(d==0),y1+(d==1)));
+        gCol[d][t]=Domain::from_rect<2>(g.intersection(sBox));
+      }
+    }
+  }
+  ip=rt->create_index_partition(ctx,uis,m->tiles,uCol,true);
+  m->uTile=rt->get_logical_partition(ctx,m->u,ip);
+  ip=rt->create_index_partition(ctx,sis,m->tiles,sCol,true);
+  m->sTile=rt->get_logical_partition(ctx,m->s,ip);
+  for(d=0;d<2;d++){
+    ip=rt->create_index_partition(ctx,sis,m->tiles,gCol[d],false);
+    m->sGhost[d]=rt->get_logical_partition(ctx,m->s,ip);
+  }
+}
+
+void freeMesh(lg_mesh *m, Context ctx, HighLevelRuntime *rt){
+  rt->destroy_logical_region(ctx,m->u);
+  rt->destroy_logical_region(ctx,m->s);
+}
+
+//Copy the caller's mesh into the mesh region (back=0) or the region back
+//to the caller's mesh (back=1), through an inline mapping
+void copyMesh(double *mesh, int back, lg_mesh *m, Context ctx, HighLevelRuntime *rt){
+  RegionRequirement req(m->u,back?READ_ONLY:WRITE_DISCARD,EXCLUSIVE,m->u);
+  PhysicalRegion pr;
+  lg_field u[NVAR];
+  Rect<2> ur;
+  int i, j, v, nx, ny;
+
+  for(v=0;v<NVAR;v++)req.add_field(FID_U+v);
+  pr=rt->map_region(ctx,req);
+  pr.wait_until_valid();
+  getFields(u,pr,FID_U,ur,ctx,rt);
+  nx=Hp->nx;
+  ny=Hp->ny;
+  for(v=0;v<NVAR;v++){
+    for(j=0;j<ny;j++){
+      for(i=0;i<nx;i++){
+        if(back)mesh[i+nx*(j+ny*v)]=u[v](i,j);
+        else u[v](i,j)=mesh[i+nx*(j+ny*v)];
+      }
+    }
+  }
+  rt->unmap_region(ctx,pr);
+}
+
+//Run the problem in Hp on mesh, as engine does in the other implementations
+void runProblem(double *mesh, Context ctx, HighLevelRuntime *rt){
+  int n, odd, nproc, hostDt;
+  double dt, den;
+  double cTime, nxttout;
+  double volCell;
+  double oTM, oTE;
+  double TM, TE;
+  double initT, endT;
+  double tPh;
+  char outfile[64];
+  lg_mesh m;
+  lg_pass a;
+  Future denF;
+  std::vector<Future> pend;
+
+  //If no end condition provided, end without running
+  if(Ha->nstepmax<0&&Ha->tend<0.0)return;
+
+  a.gamma =Hp->gamma;
+  a.smallr=Ha->smallr;
+  a.smallc=Ha->smallc;
+  a.smallp=Ha->smallc*Ha->smallc/Hp->gamma;
+  a.sigma =Ha->sigma;
+  a.dx    =Hp->dx;
+  a.dy    =Hp->dy;
+  a.dt    =-1.0;
+  a.niter =Ha->niter_riemann;
+  a.scheme=Ha->scheme;
+  a.nx    =Hp->nx;
+  a.ny    =Hp->ny;
+  a.dir   =0;
+  a.bndL  =Hp->bndL;
+  a.bndH  =Hp->bndR;
+  a.cdt   =0;
+  a.var   =0;
+  nproc=getNumProcs();
+  makeMesh(&m,Hp->nx,Hp->ny,nproc,ctx,rt);
+  printf("Legion %dx%d tiles on %d CPUs\n",m.ntx,m.nty,nproc);
+
+  n=0;
+  dt=0.0;
+  cTime=0.0;
+  nxttout=-1.0;
+
+  //Set initial value of next time to aim to hit exactly
+  if(Ha->tend>0.0){
+    nxttout=Ha->tend;
+  }
+  if(Ha->dtoutput>0.0&&nxttout>Ha->dtoutput){
+    nxttout=Ha->dtoutput;
+  }
+  //Only an end time or output interval needs the timestep on the host
+  //every step. Otherwise the passes take it from the CFL denominator
+  //future, and the host only waits for it at the progress lines
+  hostDt=(nxttout>0.0);
+
+  //Print initial condition
+  snprintf(outfile,sizeof(outfile),"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+
+  copyMesh(mesh,0,&m,ctx,rt);
+  volCell=Hp->dx*Hp->dy;
+  oTM=sumVar(VARRHO,&a,&m,ctx,rt);
+  oTE=sumVar(VARPR,&a,&m,ctx,rt);
+  printf("INIT: TM: %g TE: %g\n",volCell*oTM,volCell*oTE);
+
+  //The tasks run asynchronously, so only the waits for the timestep and
+  //the output are timed; see Legion Prof for the tasks
+  initTiming(&Ht,"Legion","CPU",1,nproc);
+  Ht.phase[PH_PRIM]=-1.0;
+  Ht.phase[PH_HALO]=-1.0;
+  Ht.phase[PH_TRACE]=-1.0;
+  Ht.phase[PH_RIEMANN]=-1.0;
+  Ht.phase[PH_FLUX]=-1.0;
+  initT=wallNow();
+
+  denF=meshDenom(&a,&m,ctx,rt);
+  while((n<Ha->nstepmax||Ha->nstepmax<0)&&(cTime<Ha->tend||Ha->tend<0)){
+    if(!FUSE_DT&&n>0)denF=meshDenom(&a,&m,ctx,rt);
+    if(hostDt){
+      PH_START(tPh);
+      den=denF.get_result<double>(true);
+      dt=Ha->sigma*(0.5/den);
+      PH_ADD(Ht.phase,PH_DT,tPh);
+      if(nxttout>0.0&&dt>(nxttout-cTime)){
+        printf("Adjusting timestep from %g to %g for iter %d\n",dt,nxttout-cTime,n);
+        dt=(nxttout-cTime);
+      }
+      cTime+=dt;
+    }else{
+      pend.push_back(denF);
+    }
+    odd=(Hp->nstep+n)%2;
+    runPass(hostDt?dt:-1.0,denF,odd,0,&a,&m,ctx,rt);
+    denF=runPass(hostDt?dt:-1.0,denF,!odd,FUSE_DT,&a,&m,ctx,rt);
+    n+=1;
+    //The host catches up with the steps' timesteps for a progress line or
+    //a visualisation file
+    if(n%Ha->nprtLine==0||(Ha->noutput>0&&n%Ha->noutput==0)||
+       (n>=Ha->nstepmax&&Ha->nstepmax>=0)){
+      PH_START(tPh);
+      for(size_t k=0;k<pend.size();k++){
+        dt=Ha->sigma*(0.5/pend[k].get_result<double>(true));
+        cTime+=dt;
+      }
+      pend.clear();
+      PH_ADD(Ht.phase,PH_DT,tPh);
+    }
+    PH_START(tPh);
+    //Print simple output line
+    if(n%Ha->nprtLine==0){
+      TM=sumVar(VARRHO,&a,&m,ctx,rt);
+      TE=sumVar(VARPR,&a,&m,ctx,rt);
+      printf("Iter %05d time %f dt %g TM: %g TE: %g\n",n,cTime,dt,volCell*TM,volCell*TE);
+    }
+    //Print visualization file
+    if((cTime>=nxttout&&nxttout>0)||(Ha->noutput>0&&n%Ha->noutput==0)){
+      printf("Vis file @ time %f iter %d\n",cTime,n);
+      if(cTime>=nxttout&&nxttout>0.0){
+        nxttout+=Ha->dtoutput;
+        if(nxttout>Ha->tend&&Ha->tend>0)nxttout=Ha->tend;
+      }
+      copyMesh(mesh,1,&m,ctx,rt);
+      snprintf(outfile,sizeof(outfile),"%s%05d",Ha->outPre,Hp->nstep+n);
+      writeVisAsync(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+    }
+    PH_ADD(Ht.phase,PH_OUTPUT,tPh);
+  }
+  printf("time: %f, %d iters run\n",cTime,n);
+
+  endT=wallNow();
+
+  //Print timing information in manner easily extracted to process as csv
+  Ht.niters=n;
+  Ht.ncells=Hp->nx*Hp->ny;
+  Ht.runt=endT-initT;
+  printTiming(&Ht,Ha);
+
+  //The last snapshot may share the final condition's name
+  waitVis();
+
+  //Print final condition
+  copyMesh(mesh,1,&m,ctx,rt);
+  snprintf(outfile,sizeof(outfile),"%s%05d",Ha->outPre,Hp->nstep+n);
+  writeVis(outfile,mesh,Hp->dx,Hp->dy,Hp->nvar,Hp->nx,Hp->ny);
+  freeMesh(&m,ctx,rt);
+
+  Hp->t+=cTime;
+  Hp->nstep+=n;
+  if(Ha->chkFile[0])writeRestart(Ha->chkFile,mesh,Hp);
+}
+
+//Top level task: the problems of the batch, one after another
+void topTask(const Task *task, const std::vector<PhysicalRegion> &regions,
+             Context ctx, HighLevelRuntime *rt){
+  int m;
+
+  for(m=0;m<batch.nb;m++){
+    Hp=batch.Hp+m;
+    Ha=batch.Ha+m;
+    runProblem(batch.mesh[m],ctx,rt);
+  }
+}
+
+void registerTasks(){
+  TaskVariantRegistrar tvr(TOP_TID,"topTask");
+  tvr.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+  Runtime::preregister_task_variant<topTask>(tvr,"topTask");
+  Runtime::set_top_level_task_id(TOP_TID);
+
+  HighLevelRuntime::register_legion_task<primTask>(PRIM_TID,Processor::LOC_PROC,true,true,
+    AUTO_GENERATE_ID,TaskConfigOptions(true /*leaf*/),"primTask");
+  HighLevelRuntime::register_legion_task<traceTask>(TRACE_TID,Processor::LOC_PROC,true,true,
+    AUTO_GENERATE_ID,TaskConfigOptions(true /*leaf*/),"traceTask");
+  HighLevelRuntime::register_legion_task<riemannTask>(RIEMANN_TID,Processor::LOC_PROC,true,true,
+    AUTO_GENERATE_ID,TaskConfigOptions(true /*leaf*/),"riemannTask");
+  HighLevelRuntime::register_legion_task<double,fluxTask>(FLUX_TID,Processor::LOC_PROC,true,true,
+    AUTO_GENERATE_ID,TaskConfigOptions(true /*leaf*/),"fluxTask");
+  HighLevelRuntime::register_legion_task<double,denomTask>(DENOM_TID,Processor::LOC_PROC,true,true,
+    AUTO_GENERATE_ID,TaskConfigOptions(true /*leaf*/),"denomTask");
+  HighLevelRuntime::register_legion_task<double,sumTask>(SUM_TID,Processor::LOC_PROC,true,true,
+    AUTO_GENERATE_ID,TaskConfigOptions(true /*leaf*/),"sumTask");
+  HighLevelRuntime::register_reduction_op<MaxRedop>(MAX_REDOP);
+  HighLevelRuntime::register_reduction_op<SumRedop>(SUM_REDOP);
+}
+
+//The runtime can only be started once per process, so a batch is run by
+//one top level task. The runtime takes its -ll: and -lg: arguments from
+//the command line and shuts down when the top level task returns
+void engineBatch(int *argc, char **argv[], int nb, double **mesh, hydro_prob *Hyp, hydro_args *Hya){
+  batch.nb=nb;
+  batch.mesh=mesh;
+  batch.Hp=Hyp;
+  batch.Ha=Hya;
+  registerTasks();
+  Runtime::start(*argc,*argv);
+}
+
+void engine(int *argc, char **argv[], double *mesh, hydro_prob *Hyp, hydro_args *Hya){
+  engineBatch(argc,argv,1,&mesh,Hyp,Hya);
+}
+
+//The regions go with the runtime
+void freeScratch(){
+}
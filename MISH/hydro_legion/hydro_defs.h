@@ -0,0 +1,55 @@
+#ifndef HYDRO_DEFS_H_
+#define HYDRO_DEFS_H_
+
+#define MAX(x,y) ((x)<(y))?(y):(x)
+#define MIN(x,y) ((x)>(y))?(y):(x)
+
+#define VARRHO 0
+#define VARVX  1
+#define VARVY  2
+#define VARPR  3
+#define NVAR   4
+
+#define BND_REFL 0
+#define BND_PERM 1
+
+//The last pass of each step finds the CFL denominator for the next step
+//as it updates the mesh. Define SEPARATE_CALCDT to find it with a separate
+//reduction over the mesh at the start of each step instead
+#ifdef SEPARATE_CALCDT
+#define FUSE_DT 0
+#else
+#define FUSE_DT 1
+#endif
+
+//Task IDs
+enum {
+  TOP_TID=0,
+  PRIM_TID,
+  TRACE_TID,
+  RIEMANN_TID,
+  FLUX_TID,
+  DENOM_TID,
+  SUM_TID
+};
+
+//Reduction operators of the index launches whose futures are combined.
+//0 is reserved by the runtime
+enum {
+  MAX_REDOP=1,
+  SUM_REDOP
+};
+
+//Fields of the mesh region, the conserved variables, and of the pass
+//scratch region, one per variable of q, ql, qr and flx
+enum {
+  FID_U=0
+};
+enum {
+  FID_Q=0,
+  FID_QL=FID_Q+NVAR,
+  FID_QR=FID_QL+NVAR,
+  FID_F=FID_QR+NVAR
+};
+
+#endif //HYDRO_DEFS_H_
@@ -0,0 +1,104 @@
+#ifndef APP_INCLUDED_H
+#define APP_INCLUDED_H 1
+
+#include "common/app-base.hpp"
+
+#include "hydro.h"
+
+// Time stepping state kept on the device, as step_state in the device
+// program text
+struct step_state {
+    double dt;
+    double dtRun;
+    double t;
+    double tOut;
+    double den;
+    cl_int n;
+};
+
+///
+// The MISH hydrocode on an OpenCL device.  setup() takes the problem of an
+// engine call, building the program when the physics constants change and
+// acquiring the buffers from the pool, and host_run() runs it: the mesh
+// and the step state stay on the device, and the steps are queued back to
+// back up to the next progress line or output.  Every command goes through
+// the device's task graph with the buffers it reads and writes, so on an
+// out-of-order queue a step's first primitives and halo overlap the end of
+// the step before, and the two sums of a progress line run together.
+///
+class App : public AppBase {
+
+public:
+
+    App(int profile,
+        int verbose,
+        int device,
+        int out_of_order)
+        : AppBase(0, profile, verbose, out_of_order),
+          device_id_m(device)
+        {
+        }
+
+    void setup(double *mesh,
+               hydro_prob *Hp,
+               hydro_args *Ha);
+
+    virtual void host_run();
+
+private:
+
+    virtual std::string const & get_device_program_text();
+
+    void create_kernels();
+
+    void enqueue(cl::Kernel const & kernel,
+                 size_t items,
+                 size_t local,
+                 TaskGraph::Buffers const & reads,
+                 TaskGraph::Buffers const & writes);
+
+    void queue_pass(int dir,
+                    int cdt);
+
+    void queue_denom();
+
+    void queue_step(int odd);
+
+    void sum_vars(double *rho,
+                  double *pr);
+
+    void read_mesh();
+
+    void release_buffers();
+
+    int device_id_m;
+    double *mesh_m;
+    hydro_prob *hp_m;
+    hydro_args *ha_m;
+    Defines defines_m;
+
+    cl::Kernel to_prim_m;
+    cl::Kernel set_bnd_m;
+    cl::Kernel tile_flux_m;
+    cl::Kernel calc_denom_m;
+    cl::Kernel reduce_den_m;
+    cl::Kernel calc_dt_m;
+    cl::Kernel end_step_m;
+    cl::Kernel sum_var_m;
+
+    cl::Buffer u_m;
+    cl::Buffer q_m;
+    cl::Buffer den_m;
+    cl::Buffer sums_m[2];
+    cl::Buffer st_m;
+    std::vector<double> sums_host_m[2];
+
+    size_t prim_local_m;
+    size_t bnd_local_m;
+    size_t flux_local_m;
+    size_t redu_local_m;
+    size_t redu_groups_m;
+
+};
+
+#endif
@@ -0,0 +1,427 @@
+// Host code...
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+
+#include "app.hpp"
+#include "restart.h"
+#include "outfile.h"
+#include "timing.h"
+
+// Neumaier compensated sum of the n values of v
+static double sum_array(double const *v,
+                        size_t n)
+{
+    double sum = 0.0;
+    double corr = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double t = sum + v[i];
+        if (fabs(sum) >= fabs(v[i])) {
+            corr += (sum - t) + v[i];
+        } else {
+            corr += (v[i] - t) + sum;
+        }
+        sum = t;
+    }
+    return sum + corr;
+}
+
+
+void App::setup(double *mesh,
+                hydro_prob *Hp,
+                hydro_args *Ha)
+{
+    int rc;
+
+    mesh_m = mesh;
+    hp_m = Hp;
+    ha_m = Ha;
+    if (device_id_m < 0 || device_id_m >= (int)device_m.size()) {
+        device_id_m = get_most_capable_device();
+    }
+
+    // The physics constants are compiled in, so the program is only
+    // rebuilt, or loaded from the binary cache, when they change
+    Defines defines;
+    defines["GAMMA"] = define_value(Hp->gamma);
+    defines["SMALLR"] = define_value(Ha->smallr);
+    defines["SMALLC"] = define_value(Ha->smallc);
+    defines["SMALLP"] = define_value(Ha->smallc * Ha->smallc / Hp->gamma);
+    defines["NITER"] = define_value(Ha->niter_riemann);
+    defines["SCHEME"] = define_value(Ha->scheme);
+    if (defines_m != defines) {
+        build_program(get_device_program_text(), defines);
+        defines_m = defines;
+        create_kernels();
+    }
+
+    int const nx = Hp->nx;
+    int const ny = Hp->ny;
+    size_t const nc = (size_t)nx * ny;
+    cl::Device const & device = device_m[device_id_m];
+
+    // The reductions' work groups are a power of two no larger than any of
+    // their kernels allows
+    size_t largest = REDU_TILE;
+    largest = std::min(largest, calc_denom_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    largest = std::min(largest, reduce_den_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    largest = std::min(largest, sum_var_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    for (redu_local_m = 1; redu_local_m * 2 <= largest; redu_local_m *= 2) {
+    }
+    redu_groups_m = (nc + redu_local_m - 1) / redu_local_m;
+
+    // The flux kernel's segments are as long as its work group size and
+    // local memory allow
+    size_t const local_mem = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
+    flux_local_m = std::min((size_t)FLUX_TILE,
+                            tile_flux_m.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device));
+    while (flux_local_m > 1 && NVAR * (4 * flux_local_m + 9) * sizeof(double) > local_mem) {
+        flux_local_m /= 2;
+    }
+    size_t const flux_groups = std::max((nx + flux_local_m - 1) / flux_local_m * ny,
+                                        (ny + flux_local_m - 1) / flux_local_m * nx);
+
+    // Device memory from the pool, kept for the whole run
+    size_t const prim_size = NVAR * std::max((size_t)(nx + 4) * ny, (size_t)(ny + 4) * nx);
+    u_m = pool_m.acquire(NVAR * nc * sizeof(double));
+    q_m = pool_m.acquire(prim_size * sizeof(double));
+    den_m = pool_m.acquire(std::max(redu_groups_m, flux_groups) * sizeof(double));
+    for (int k = 0; k < 2; k++) {
+        sums_m[k] = pool_m.acquire(redu_groups_m * sizeof(double));
+        sums_host_m[k].resize(redu_groups_m);
+    }
+    st_m = pool_m.acquire(sizeof(step_state));
+
+    rc = to_prim_m.setArg(0, q_m);
+    rc = to_prim_m.setArg(1, u_m);
+    rc = to_prim_m.setArg(2, (cl_int)nx);
+    rc = to_prim_m.setArg(3, (cl_int)ny);
+    rc = to_prim_m.setArg(4, (cl_int)0);
+
+    rc = set_bnd_m.setArg(0, q_m);
+    rc = set_bnd_m.setArg(1, (cl_int)nx);
+    rc = set_bnd_m.setArg(2, (cl_int)ny);
+    rc = set_bnd_m.setArg(3, (cl_int)Hp->bndL);
+    rc = set_bnd_m.setArg(4, (cl_int)Hp->bndR);
+
+    rc = tile_flux_m.setArg(0, u_m);
+    rc = tile_flux_m.setArg(1, q_m);
+    rc = tile_flux_m.setArg(2, st_m);
+    rc = tile_flux_m.setArg(3, cl::__local(NVAR * (4 * flux_local_m + 9) * sizeof(double)));
+    rc = tile_flux_m.setArg(4, den_m);
+    rc = tile_flux_m.setArg(5, (cl_int)nx);
+    rc = tile_flux_m.setArg(6, (cl_int)ny);
+    rc = tile_flux_m.setArg(9, Hp->dx);
+    rc = tile_flux_m.setArg(10, Hp->dy);
+
+    rc = calc_denom_m.setArg(0, u_m);
+    rc = calc_denom_m.setArg(1, cl::__local(redu_local_m * sizeof(double)));
+    rc = calc_denom_m.setArg(2, den_m);
+    rc = calc_denom_m.setArg(3, (cl_int)nx);
+    rc = calc_denom_m.setArg(4, (cl_int)ny);
+    rc = calc_denom_m.setArg(5, Hp->dx);
+    rc = calc_denom_m.setArg(6, Hp->dy);
+
+    rc = reduce_den_m.setArg(0, st_m);
+    rc = reduce_den_m.setArg(1, den_m);
+    rc = reduce_den_m.setArg(2, cl::__local(redu_local_m * sizeof(double)));
+
+    rc = calc_dt_m.setArg(0, st_m);
+    rc = calc_dt_m.setArg(1, Ha->sigma);
+
+    rc = end_step_m.setArg(0, st_m);
+
+    rc = sum_var_m.setArg(0, u_m);
+    rc = sum_var_m.setArg(1, cl::__local(redu_local_m * sizeof(double)));
+    rc = sum_var_m.setArg(3, (cl_int)nc);
+
+    // Tuning runs the kernels, so only those that just rewrite the
+    // primitives are tuned
+    prim_local_m = tune_work_group_size(to_prim_m, device_id_m, nc);
+    bnd_local_m = tune_work_group_size(set_bnd_m, device_id_m, 4 * ny);
+}
+
+
+void App::create_kernels()
+{
+    int rc;
+
+    to_prim_m = cl::Kernel(program_m, "to_prim", &rc);
+    set_bnd_m = cl::Kernel(program_m, "set_bnd", &rc);
+    tile_flux_m = cl::Kernel(program_m, "tile_flux", &rc);
+    calc_denom_m = cl::Kernel(program_m, "calc_denom", &rc);
+    reduce_den_m = cl::Kernel(program_m, "reduce_den", &rc);
+    calc_dt_m = cl::Kernel(program_m, "calc_dt", &rc);
+    end_step_m = cl::Kernel(program_m, "end_step", &rc);
+    sum_var_m = cl::Kernel(program_m, "sum_var", &rc);
+}
+
+
+// Queue a kernel on the device's task graph, after the commands that use
+// the buffers it reads and writes
+void App::enqueue(cl::Kernel const & kernel,
+                  size_t items,
+                  size_t local,
+                  TaskGraph::Buffers const & reads,
+                  TaskGraph::Buffers const & writes)
+{
+    cl::Event event = graph_m[device_id_m].kernel(kernel,
+                                                  cl::NullRange,
+                                                  cl::NDRange(round_up(items, local)),
+                                                  cl::NDRange(local),
+                                                  reads,
+                                                  writes);
+    if (profile_m) {
+        profiler_m.record(kernel.getInfo<CL_KERNEL_FUNCTION_NAME>(), device_id_m,
+                          "step", event);
+    }
+}
+
+
+// Queue the pass in direction dir. If cdt is set the pass also finds the
+// CFL denominator of the updated mesh in st->den
+void App::queue_pass(int dir,
+                     int cdt)
+{
+    int rc;
+    int const np = dir ? hp_m->ny : hp_m->nx;
+    int const nt = dir ? hp_m->nx : hp_m->ny;
+    size_t const groups = (np + flux_local_m - 1) / flux_local_m * nt;
+
+    rc = to_prim_m.setArg(4, (cl_int)dir);
+    enqueue(to_prim_m, (size_t)np * nt, prim_local_m,
+            TaskGraph::buffers(u_m), TaskGraph::buffers(q_m));
+
+    // y takes bndU at its low end and bndD at its high end
+    rc = set_bnd_m.setArg(1, (cl_int)np);
+    rc = set_bnd_m.setArg(2, (cl_int)nt);
+    rc = set_bnd_m.setArg(3, (cl_int)(dir ? hp_m->bndU : hp_m->bndL));
+    rc = set_bnd_m.setArg(4, (cl_int)(dir ? hp_m->bndD : hp_m->bndR));
+    enqueue(set_bnd_m, 4 * nt, bnd_local_m,
+            TaskGraph::buffers(q_m), TaskGraph::buffers(q_m));
+
+    rc = tile_flux_m.setArg(7, (cl_int)dir);
+    rc = tile_flux_m.setArg(8, (cl_int)cdt);
+    enqueue(tile_flux_m, groups * flux_local_m, flux_local_m,
+            TaskGraph::buffers(u_m, q_m, st_m),
+            cdt ? TaskGraph::buffers(u_m, den_m) : TaskGraph::buffers(u_m));
+    if (cdt) {
+        rc = reduce_den_m.setArg(3, (cl_int)groups);
+        rc = reduce_den_m.setArg(4, (cl_int)0);
+        enqueue(reduce_den_m, redu_local_m, redu_local_m,
+                TaskGraph::buffers(st_m, den_m), TaskGraph::buffers(st_m));
+    }
+}
+
+
+// Queue the CFL reduction over the whole mesh into st->den
+void App::queue_denom()
+{
+    int rc;
+
+    enqueue(calc_denom_m, (size_t)hp_m->nx * hp_m->ny, redu_local_m,
+            TaskGraph::buffers(u_m), TaskGraph::buffers(den_m));
+    rc = reduce_den_m.setArg(3, (cl_int)redu_groups_m);
+    rc = reduce_den_m.setArg(4, (cl_int)1);
+    enqueue(reduce_den_m, redu_local_m, redu_local_m,
+            TaskGraph::buffers(st_m, den_m), TaskGraph::buffers(st_m));
+}
+
+
+// Queue one time step: dt and both passes, in the pass order of an even or
+// odd step. dt never leaves the device. The CFL denominator comes from the
+// last pass of the step before, or from a reduction over the mesh if
+// SEPARATE_CALCDT is defined
+void App::queue_step(int odd)
+{
+    if (!FUSE_DT) {
+        queue_denom();
+    }
+    enqueue(calc_dt_m, 1, 1, TaskGraph::buffers(st_m), TaskGraph::buffers(st_m));
+    queue_pass(odd, 0);
+    queue_pass(!odd, FUSE_DT);
+    enqueue(end_step_m, 1, 1, TaskGraph::buffers(st_m), TaskGraph::buffers(st_m));
+}
+
+
+// Sum density and pressure over the mesh on the device, reading back only
+// the per work group partial sums, each into its own buffer so the two
+// sums and reads are independent
+void App::sum_vars(double *rho,
+                   double *pr)
+{
+    int rc;
+    int const var[2] = {VARRHO, VARPR};
+    TaskGraph & graph = graph_m[device_id_m];
+
+    for (int k = 0; k < 2; k++) {
+        rc = sum_var_m.setArg(2, sums_m[k]);
+        rc = sum_var_m.setArg(4, (cl_int)var[k]);
+        enqueue(sum_var_m, (size_t)hp_m->nx * hp_m->ny, redu_local_m,
+                TaskGraph::buffers(u_m), TaskGraph::buffers(sums_m[k]));
+        graph.read(sums_m[k], 0, redu_groups_m * sizeof(double), &sums_host_m[k][0]);
+    }
+    graph.finish();
+    *rho = sum_array(&sums_host_m[0][0], redu_groups_m);
+    *pr = sum_array(&sums_host_m[1][0], redu_groups_m);
+}
+
+
+// The device mesh to the host mesh, whose layout it shares
+void App::read_mesh()
+{
+    graph_m[device_id_m].read(u_m, 0, NVAR * (size_t)hp_m->nx * hp_m->ny * sizeof(double),
+                              mesh_m, true);
+}
+
+
+void App::release_buffers()
+{
+    pool_m.release(u_m);
+    pool_m.release(q_m);
+    pool_m.release(den_m);
+    pool_m.release(sums_m[0]);
+    pool_m.release(sums_m[1]);
+    pool_m.release(st_m);
+}
+
+
+void App::host_run()
+{
+    hydro_prob *Hp = hp_m;
+    hydro_args *Ha = ha_m;
+    hydro_timing Ht;
+    TaskGraph & graph = graph_m[device_id_m];
+    size_t const nc = (size_t)Hp->nx * Hp->ny;
+    char outfile[30];
+    step_state st;
+
+    printf("Device is %s\n", device_m[device_id_m].getInfo<CL_DEVICE_NAME>().c_str());
+    printf("Work group sizes: prim %d halo %d flux %d reduction %d\n",
+           (int)prim_local_m, (int)bnd_local_m, (int)flux_local_m, (int)redu_local_m);
+
+    int n = 0;
+    double cTime = 0.0;
+    double dt = 0.0;
+    double nxttout = -1.0;
+    if (Ha->tend > 0.0) {
+        nxttout = Ha->tend;
+    }
+    if (Ha->dtoutput > 0.0 && nxttout > Ha->dtoutput) {
+        nxttout = Ha->dtoutput;
+    }
+    double const volCell = Hp->dx * Hp->dy;
+    double const oTM = sum_array(mesh_m + nc * VARRHO, nc);
+    double const oTE = sum_array(mesh_m + nc * VARPR, nc);
+
+    // Print initial condition
+    snprintf(outfile, 29, "%s%05d", Ha->outPre, Hp->nstep + n);
+    writeVis(outfile, mesh_m, Hp->dx, Hp->dy, Hp->nvar, Hp->nx, Hp->ny);
+    printf("INIT: TM: %g TE: %g\n", volCell * oTM, volCell * oTE);
+
+    // Move mesh and step state onto the device
+    graph.write(u_m, 0, NVAR * nc * sizeof(double), mesh_m);
+    st.dt = 0.0;
+    st.dtRun = 0.0;
+    st.t = cTime;
+    st.tOut = nxttout;
+    st.den = 0.0;
+    st.n = n;
+    graph.write(st_m, 0, sizeof(step_state), &st, true);
+
+    // The first step needs its CFL denominator from the mesh
+    if (FUSE_DT) {
+        queue_denom();
+    }
+
+    // The steps are queued without waits, so only the host side output is
+    // timed on its own, unless the kernels are profiled
+    initTiming(&Ht, "OpenCL", "GPU", 1, 1);
+    for (int ph = 0; ph < NPHASE; ph++) {
+        if (ph != PH_OUTPUT) {
+            Ht.phase[ph] = -1.0;
+        }
+    }
+
+    double const time0 = wall_time();
+    while ((n < Ha->nstepmax || Ha->nstepmax < 0) && (cTime < Ha->tend || Ha->tend < 0)) {
+        // Queue the steps up to the next one the host has to look at
+        int nB = Ha->nprtLine - n % Ha->nprtLine;
+        if (Ha->noutput > 0 && Ha->noutput - n % Ha->noutput < nB) {
+            nB = Ha->noutput - n % Ha->noutput;
+        }
+        if (Ha->nstepmax >= 0 && Ha->nstepmax - n < nB) {
+            nB = Ha->nstepmax - n;
+        }
+        for (int k = 0; k < nB; k++) {
+            queue_step((Hp->nstep + n + k) % 2);
+        }
+        // Steps are held once an output time is reached, so st.n counts
+        // the steps actually taken
+        graph.read(st_m, 0, sizeof(step_state), &st, true);
+        n = st.n;
+        cTime = st.t;
+        dt = st.dtRun;
+
+        double tPh;
+        PH_START(tPh);
+        if (n % Ha->nprtLine == 0) {
+            double TM, TE;
+            sum_vars(&TM, &TE);
+            printf("Iter %05d time %f dt %g TM: %g TE: %g\n", n, cTime, dt, volCell * TM, volCell * TE);
+        }
+        if ((cTime >= nxttout && nxttout > 0) || (Ha->noutput > 0 && n % Ha->noutput == 0)) {
+            printf("Vis file @ time %f iter %d\n", cTime, n);
+            if (cTime >= nxttout && nxttout > 0.0) {
+                nxttout += Ha->dtoutput;
+                if (nxttout > Ha->tend && Ha->tend > 0) {
+                    nxttout = Ha->tend;
+                }
+                printf("Next Vis Time: %f\n", nxttout);
+                // Release the held steps
+                st.tOut = nxttout;
+                graph.write(st_m, 0, sizeof(step_state), &st, true);
+            }
+            read_mesh();
+            snprintf(outfile, 29, "%s%05d", Ha->outPre, Hp->nstep + n);
+            writeVis(outfile, mesh_m, Hp->dx, Hp->dy, Hp->nvar, Hp->nx, Hp->ny);
+        }
+        PH_ADD(Ht.phase, PH_OUTPUT, tPh);
+    }
+    graph.finish();
+    double const time1 = wall_time();
+    printf("time: %f, %d iters run\n", cTime, n);
+
+    // Kernel times, in s, for the phases they make up
+    if (profile_m) {
+        Ht.phase[PH_PRIM] = profiler_m.total("to_prim") * 1.0e-3;
+        Ht.phase[PH_HALO] = profiler_m.total("set_bnd") * 1.0e-3;
+        Ht.phase[PH_FLUX] = profiler_m.total("tile_flux") * 1.0e-3;
+        Ht.phase[PH_DT] = (profiler_m.total("calc_denom") + profiler_m.total("reduce_den") +
+                           profiler_m.total("calc_dt")) * 1.0e-3;
+    }
+    Ht.niters = n;
+    Ht.ncells = nc;
+    Ht.runt = time1 - time0;
+    printTiming(&Ht, Ha);
+
+    // Print final condition
+    read_mesh();
+    snprintf(outfile, 29, "%s%05d", Ha->outPre, Hp->nstep + n);
+    writeVis(outfile, mesh_m, Hp->dx, Hp->dy, Hp->nvar, Hp->nx, Hp->ny);
+    Hp->t += cTime;
+    Hp->nstep += n;
+    if (Ha->chkFile[0]) {
+        writeRestart(Ha->chkFile, mesh_m, Hp);
+    }
+
+    if (profile_m) {
+        profiler_m.report(std::cerr);
+        if (profiler_m.write_trace("hydro-trace.json")) {
+            std::cerr << "  timeline written to hydro-trace.json\n";
+        }
+        profiler_m.clear();
+    }
+    release_buffers();
+}
@@ -0,0 +1,32 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "app.hpp"
+
+//The OpenCL state, its program and its buffer pool, lives from the first
+//engine call to freeScratch, so later calls reuse them
+App *app=NULL;
+
+void engine(int *argc, char **argv[], double *gMesh, hydro_prob *Hyp, hydro_args *Hya){
+  const char *env;
+  int device=-1;
+  int verbose=0;
+  int profile=0;
+  int outOfOrder=0;
+  if(Hya->nstepmax<0&&Hya->tend<0.0)return;
+  if(!app){
+    if((env=getenv("MISH_CL_DEVICE")))device=atoi(env);
+    if((env=getenv("MISH_CL_VERBOSE")))verbose=atoi(env);
+    if((env=getenv("MISH_CL_PROFILE")))profile=atoi(env);
+    if((env=getenv("MISH_CL_OUT_OF_ORDER")))outOfOrder=atoi(env);
+    app=new App(profile,verbose,device,outOfOrder);
+  }
+  printf("Setting vars for kernel calls\n");
+  app->setup(gMesh,Hyp,Hya);
+  app->host_run();
+  printf("Returning from engine\n");
+}
+
+void freeScratch(){
+  delete app;
+  app=NULL;
+}
@@ -4,17 +4,122 @@
 #include <algorithm>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <sstream>
 #include <string>
 
 #include <cstdio>
 #include <cstdlib>
 
+#include <sys/stat.h>
+#include <unistd.h>
+
 #define __CL_ENABLE_EXCEPTIONS
 #include "common/cl.hpp"
+#include "common/buffer-pool.hpp"
+#include "common/event-profiler.hpp"
+#include "common/task-graph.hpp"
+#include "cody.h"
+
+///
+// Host memory the devices transfer from and to at full speed: a buffer
+// allocated with CL_MEM_ALLOC_HOST_PTR, which the implementation places in
+// pinned memory, kept mapped so the host uses it as an array.  Copies from
+// it to other buffers are DMA transfers from pinned memory rather than
+// staged through pageable memory.  On a device sharing memory with the
+// host (CL_DEVICE_HOST_UNIFIED_MEMORY) kernels can instead use buffer()
+// itself with no copy at all: unmap() it before the kernels run and map()
+// it again, which waits for them, before the host reads it.  On an
+// out-of-order queue map() waits for nothing else: finish the queue first.
+///
+class HostBuffer {
+
+public:
+
+    HostBuffer()
+        : host_m(NULL),
+          size_m(0)
+        {
+        }
+
+    ~HostBuffer()
+        {
+            release();
+        }
+
+    void allocate(cl::Context const & context,
+                  cl::CommandQueue const & queue,
+                  size_t size,
+                  cl_mem_flags flags = CL_MEM_READ_WRITE)
+        {
+            release();
+            queue_m = queue;
+            size_m = size;
+            buffer_m = cl::Buffer(context, flags | CL_MEM_ALLOC_HOST_PTR, size);
+            map();
+        }
+
+    // Map the memory for the host, waiting for the commands using it
+    void map(cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE)
+        {
+            if (host_m == NULL) {
+                host_m = queue_m.enqueueMapBuffer(buffer_m, CL_TRUE, flags, 0, size_m);
+            }
+        }
+
+    // Give the memory to the devices
+    void unmap()
+        {
+            if (host_m) {
+                queue_m.enqueueUnmapMemObject(buffer_m, host_m);
+                host_m = NULL;
+            }
+        }
+
+    void release()
+        {
+            if (host_m) {
+                unmap();
+                queue_m.finish();
+            }
+            buffer_m = cl::Buffer();
+            size_m = 0;
+        }
+
+    template <typename T>
+    T * data() const
+        {
+            return (T *)host_m;
+        }
+
+    size_t size() const
+        {
+            return size_m;
+        }
+
+    cl::Buffer const & buffer() const
+        {
+            return buffer_m;
+        }
+
+private:
+
+    HostBuffer(HostBuffer const &);
+    HostBuffer & operator=(HostBuffer const &);
+
+    cl::Buffer buffer_m;
+    cl::CommandQueue queue_m;
+    void *host_m;
+    size_t size_m;
+
+};
 
 ///
-// A class providing OpenCL boiler plate for simple applications
+// A class providing OpenCL boiler plate for simple applications.  With
+// out_of_order the queues of queue_m are out-of-order where the devices
+// allow it, and commands on them are ordered through graph_m, the device's
+// TaskGraph, which derives the waits from the buffers each command reads
+// and writes so that independent kernels and transfers overlap
 ///
 class AppBase {
 
@@ -22,13 +127,25 @@ public:
 
     AppBase(int debug,
             int profile,
-            int verbose)
+            int verbose,
+            int out_of_order = 0)
         : debug_m(debug),
           profile_m(profile),
-          verbose_m(verbose)
+          verbose_m(verbose),
+          out_of_order_m(out_of_order)
         {
             int rc = CL_SUCCESS;
 
+            // Program binaries are cached in $APP_CL_CACHE, or in
+            // $HOME/.cache/app-cl; an empty APP_CL_CACHE turns the cache off
+            char const *cache = getenv("APP_CL_CACHE");
+            char const *home = getenv("HOME");
+            if (cache) {
+                cache_dir_m = cache;
+            } else if (home) {
+                cache_dir_m = std::string(home) + "/.cache/app-cl";
+            }
+
             // Check we have an OpenCL implementation
             cl::Platform::get(&platform_m);
             if (platform_m.size() == 0) {
@@ -99,28 +216,64 @@ public:
             if (profile_m) {
                 properties |= CL_QUEUE_PROFILING_ENABLE;
             }
+            graph_m.resize(device_m.size());
             for (size_t i = 0; i < device_m.size(); ++i) {
-                queue_m.push_back(cl::CommandQueue(context_m, device_m[i], properties, &rc));
+                cl_uint device_properties = properties;
+                if (out_of_order_m) {
+                    if (device_m[i].getInfo<CL_DEVICE_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) {
+                        device_properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+                    } else if (verbose_m) {
+                        std::cerr << "  device[" << i << "]: no out-of-order queues, commands run in order\n";
+                    }
+                }
+                queue_m.push_back(cl::CommandQueue(context_m, device_m[i], device_properties, &rc));
+                graph_m[i].init(queue_m[i]);
+            }
+
+            // Small buffers of the pool are carved from 16 MiB slabs,
+            // aligned for every device
+            size_t align = 1;
+            for (size_t i = 0; i < device_m.size(); ++i) {
+                align = std::max(align, (size_t)device_m[i].getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>() / 8);
             }
+            pool_m.init(context_m, 16 << 20, align);
+
+            // Until calibrate() measures them, work is split evenly
+            throughput_m.assign(device_m.size(), 1.0);
+            work_group_size_loaded_m = false;
 		}
 
     ~AppBase()
 		{
 		}
 
-	virtual void build_program(std::string const & device_program_text = "")
+	///
+	// Build the device program for every device.  The binaries of a build
+	// are cached, one file per device named by a hash of the program text,
+	// the build options, and the device name and driver version, so a later
+	// run with the same program on the same devices loads them instead of
+	// compiling.  If any device has no binary cached, or the binaries are
+	// rejected, the program is built from source and the cache rewritten.
+	///
+	virtual void build_program(std::string const & device_program_text = "",
+							   std::string const & build_options = "")
 		{
 			if (device_program_text.size()) {
 				device_program_text_m = device_program_text;
 			} else {
 				device_program_text_m = get_device_program_text();
 			}
-			
+			build_options_m = build_options;
+
+			if (load_program_binaries()) {
+				return;
+			}
+
 			// Build the program
 			cl::Program::Sources source(1, std::make_pair(device_program_text_m.c_str(), device_program_text_m.length()));
 			program_m = cl::Program(context_m, source);
 			try {
-				program_m.build(device_m);
+				program_m.build(device_m, build_options_m.c_str());
 			}
 			catch (cl::Error error) {
 				std::cerr << "ERROR: Build failed\n";
@@ -130,9 +283,57 @@ public:
 					std::cerr << "Build log for device[" << i << "]:\n" << build_log << "\n";
 				}
 				throw;
-			}			
+			}
+			store_program_binaries();
 		}
-		
+
+	// Compile-time constants of a device program, by name
+	typedef std::map<std::string, std::string> Defines;
+
+	///
+	// Build the device program specialized for a problem: every name and
+	// value of defines becomes a -Dname=value build option, in name order,
+	// ahead of build_options.  The program text uses the names as
+	// constants, so the compiler folds the sizes and unrolls the loops they
+	// bound, and as the options are part of the cache key every set of
+	// values is cached as a program of its own.  Values must not contain
+	// spaces; define_value() formats numbers as OpenCL C literals.
+	///
+	void build_program(std::string const & device_program_text,
+					   Defines const & defines,
+					   std::string const & build_options = "")
+		{
+			std::string options;
+			for (Defines::const_iterator it = defines.begin(); it != defines.end(); ++it) {
+				options += (options.empty() ? "-D" : " -D") + it->first + "=" + it->second;
+			}
+			if (build_options.size()) {
+				options += (options.empty() ? "" : " ") + build_options;
+			}
+			build_program(device_program_text, options);
+		}
+
+	template <typename T>
+	static std::string define_value(T value)
+		{
+			std::ostringstream s;
+			s << value;
+			return s.str();
+		}
+
+	// A double with every digit it needs to round trip, and a decimal
+	// point even when whole, so it is a double literal in the program
+	static std::string define_value(double value)
+		{
+			char s[32];
+			snprintf(s, sizeof(s), "%.17g", value);
+			std::string literal(s);
+			if (literal.find_first_of(".eEn") == std::string::npos) {
+				literal += ".0";
+			}
+			return literal;
+		}
+
     static const char *opencl_error_string(cl_int err)
 	{
 		switch (err) {
@@ -215,21 +416,519 @@ public:
 		return device_id;
 	}
 	
+	// Whether all the devices share memory with the host, so HostBuffers
+	// need no copies
+	bool host_unified_memory(std::vector<int> const & devices)
+	{
+		for (size_t i = 0; i < devices.size(); ++i) {
+			if (!device_m[devices[i]].getInfo<CL_DEVICE_HOST_UNIFIED_MEMORY>()) {
+				return false;
+			}
+		}
+		return devices.size() > 0;
+	}
+
+	///
+	// The part of an NDRange one device runs: the rows [offset, offset +
+	// size) of the last dimension
+	///
+	struct DeviceRange {
+		int device;
+		size_t offset;
+		size_t size;
+	};
+
+	// The devices of a device list, or all of them if it is empty
+	std::vector<int> select_devices(std::vector<int> const & device_list)
+	{
+		std::vector<int> devices(device_list);
+		if (devices.empty()) {
+			for (size_t i = 0; i < device_m.size(); ++i) {
+				devices.push_back(i);
+			}
+		}
+		return devices;
+	}
+
+	// n rounded up to a multiple of m
+	static size_t round_up(size_t n, size_t m)
+	{
+		return (n + m - 1) / m * m;
+	}
+
+	///
+	// The fastest 1-D work group size of a kernel whose arguments are set
+	// on a device.  The first time a kernel and device are asked about, the
+	// kernel is timed over items work items, the global size rounded up to
+	// each work group size, for the powers of two from the kernel's
+	// preferred multiple up to its largest work group size; the kernel
+	// should ignore ids past the items.  The best size is kept with the
+	// program binaries, keyed by the program and device like them, so later
+	// runs use it without timing
+	///
+	size_t tune_work_group_size(cl::Kernel const & kernel,
+								int device,
+								size_t items)
+	{
+		std::string name = kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+		char key[64];
+		snprintf(key, sizeof(key), "%016llx",
+				 fnv1a(std::string(1, '\0') + name, program_hash(device)));
+		load_work_group_sizes();
+		std::map<std::string, size_t>::iterator found = work_group_size_m.find(key);
+		if (found != work_group_size_m.end()) {
+			return found->second;
+		}
+
+		size_t largest = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_m[device]);
+		size_t multiple = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device_m[device]);
+		size_t first = 1;
+		while (first < multiple && first * 2 <= largest) {
+			first *= 2;
+		}
+		size_t best = first;
+		double best_time = 0.0;
+		if (verbose_m) {
+			std::cerr << "[Autotune]\n  " << name << " on device[" << device << "]:";
+		}
+		for (size_t size = first; size <= largest; size *= 2) {
+			cl::NDRange global(round_up(items, size));
+			queue_m[device].enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(size));
+			queue_m[device].finish();
+			double start = wall_time();
+			queue_m[device].enqueueNDRangeKernel(kernel, cl::NullRange, global, cl::NDRange(size));
+			queue_m[device].finish();
+			double t = wall_time() - start;
+			if (verbose_m) {
+				std::cerr << " " << size << " (" << t * 1.0e3 << " ms)";
+			}
+			if (size == first || t < best_time) {
+				best = size;
+				best_time = t;
+			}
+		}
+		if (verbose_m) {
+			std::cerr << "\n  best " << best << "\n";
+		}
+		work_group_size_m[key] = best;
+		store_work_group_sizes();
+		return best;
+	}
+
+	///
+	// Measure the throughput of each device on a kernel whose arguments are
+	// set, running the range on each device alone, once to warm up and once
+	// timed.  The range should be a representative part of the real one
+	///
+	void calibrate(cl::Kernel const & kernel,
+				   std::vector<int> const & devices,
+				   cl::NDRange const & global,
+				   cl::NDRange const & local)
+	{
+		size_t items = 1;
+		for (size_t d = 0; d < global.dimensions(); ++d) {
+			items *= ((const size_t *)global)[d];
+		}
+		for (size_t i = 0; i < devices.size(); ++i) {
+			cl::CommandQueue & queue = queue_m[devices[i]];
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local);
+			queue.finish();
+			double start = wall_time();
+			queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local);
+			queue.finish();
+			double t = wall_time() - start;
+			throughput_m[devices[i]] = items / std::max(t, 1.0e-9);
+			if (verbose_m) {
+				std::cerr << "[Calibration]\n  device[" << devices[i] << "]: "
+						  << throughput_m[devices[i]] << " work items/s\n";
+			}
+		}
+	}
+
+	///
+	// Split extent rows among the devices in proportion to their throughput,
+	// each part a multiple of granularity but for the last.  Devices given
+	// no rows are left out
+	///
+	std::vector<DeviceRange> split_range(std::vector<int> const & devices,
+										 size_t extent,
+										 size_t granularity = 1)
+	{
+		double total = 0.0;
+		for (size_t i = 0; i < devices.size(); ++i) {
+			total += throughput_m[devices[i]];
+		}
+		std::vector<DeviceRange> parts;
+		size_t offset = 0;
+		double sum = 0.0;
+		for (size_t i = 0; i < devices.size(); ++i) {
+			sum += throughput_m[devices[i]];
+			size_t end = extent;
+			if (i + 1 < devices.size()) {
+				end = (size_t)(extent * (sum / total) / granularity + 0.5) * granularity;
+				end = std::min(std::max(end, offset), extent);
+			}
+			if (end > offset) {
+				DeviceRange part = { devices[i], offset, end - offset };
+				parts.push_back(part);
+			}
+			offset = end;
+		}
+		return parts;
+	}
+
+	///
+	// Launch a 1-D or 2-D kernel on the queues of the parts, each over its
+	// rows of the global range, without waiting for them.  The kernel sees
+	// its global ids in the full range, so each device works on its own
+	// region of shared buffers; the caller reads each part back through its
+	// device's queue and waits on the queues.  With profiling on the
+	// launches are recorded in profiler_m
+	///
+	void enqueue_split(cl::Kernel const & kernel,
+					   std::vector<DeviceRange> const & parts,
+					   cl::NDRange const & global,
+					   cl::NDRange const & local)
+	{
+		std::string name = kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+		for (size_t i = 0; i < parts.size(); ++i) {
+			// The rows rounded up to whole work groups, which the kernel
+			// ignores past the end of the range
+			cl::NDRange offset, range;
+			size_t rows = parts[i].size;
+			if (local.dimensions() == global.dimensions()) {
+				rows = round_up(rows, ((const size_t *)local)[global.dimensions() - 1]);
+			}
+			if (global.dimensions() == 1) {
+				offset = cl::NDRange(parts[i].offset);
+				range = cl::NDRange(rows);
+			} else {
+				offset = cl::NDRange(0, parts[i].offset);
+				range = cl::NDRange(((const size_t *)global)[0], rows);
+			}
+			cl::Event event;
+			queue_m[parts[i].device].enqueueNDRangeKernel(kernel, offset, range, local, NULL, &event);
+			if (profile_m) {
+				profiler_m.record(name, parts[i].device, "compute", event);
+			}
+			// The caller's reads of the part come after it, as on an
+			// in-order queue
+			if (graph_m[parts[i].device].out_of_order()) {
+				graph_m[parts[i].device].barrier();
+			}
+			queue_m[parts[i].device].flush();
+		}
+	}
+
+	// Wait for the queues of the parts
+	void finish_split(std::vector<DeviceRange> const & parts)
+	{
+		for (size_t i = 0; i < parts.size(); ++i) {
+			queue_m[parts[i].device].finish();
+		}
+	}
+
+	///
+	// Stream items through a kernel on one device a chunk at a time, so
+	// the data need not fit in device memory and transfers overlap the
+	// kernel.  The kernel's arguments 0 and 1 are set to the input and
+	// output buffers of each chunk and argument 2 to its number of items
+	// as a size_t; the kernel indexes the chunk from 0 and ignores ids past
+	// its size.  Chunks rotate through depth pairs of buffers: each is
+	// written on an upload queue, run on the device's queue and read on a
+	// download queue, chained by events, so while chunk c runs chunk c + 1
+	// is written and chunk c - 1 read.  Returns without waiting; the host
+	// arrays must stay valid until finish_stream().  With profiling on the
+	// writes, launches and reads are recorded in profiler_m
+	///
+	void stream_kernel(int device,
+					   cl::Kernel & kernel,
+					   void const * input,
+					   size_t input_item_size,
+					   void * output,
+					   size_t output_item_size,
+					   size_t items,
+					   size_t chunk_items,
+					   size_t work_group_size,
+					   int depth = 2)
+	{
+		std::vector<cl::CommandQueue> & queues = stream_queues(device);
+		size_t chunks = (items + chunk_items - 1) / chunk_items;
+		depth = std::max(1, (int)std::min((size_t)depth, chunks));
+
+		// The buffers come from the pool and go back once the stream is
+		// finished
+		std::vector<cl::Buffer> ibuf, obuf;
+		std::vector<cl::Buffer> & in_use = stream_buffer_m[device];
+		for (int k = 0; k < depth; ++k) {
+			ibuf.push_back(pool_m.acquire(input_item_size * chunk_items, CL_MEM_READ_ONLY));
+			obuf.push_back(pool_m.acquire(output_item_size * chunk_items, CL_MEM_WRITE_ONLY));
+			in_use.push_back(ibuf.back());
+			in_use.push_back(obuf.back());
+		}
+		std::vector<cl::Event> write(chunks), run(chunks), read(chunks);
+		for (size_t c = 0; c < chunks; ++c) {
+			int slot = c % depth;
+			size_t first = c * chunk_items;
+			size_t count = std::min(chunk_items, items - first);
+			size_t global = (count + work_group_size - 1) / work_group_size * work_group_size;
+
+			// The input buffer is free once the kernel of the chunk before
+			// in this slot ran, the output buffer once it was read
+			std::vector<cl::Event> wait_write;
+			if (c >= (size_t)depth) {
+				wait_write.push_back(run[c - depth]);
+			}
+			queues[0].enqueueWriteBuffer(ibuf[slot], CL_FALSE, 0, input_item_size * count,
+										 (char const *)input + input_item_size * first,
+										 wait_write.size() ? &wait_write : NULL, &write[c]);
+			std::vector<cl::Event> wait_run(1, write[c]);
+			if (c >= (size_t)depth) {
+				wait_run.push_back(read[c - depth]);
+			}
+			kernel.setArg(0, ibuf[slot]);
+			kernel.setArg(1, obuf[slot]);
+			kernel.setArg(2, count);
+			queue_m[device].enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(global),
+												 cl::NDRange(work_group_size), &wait_run, &run[c]);
+			std::vector<cl::Event> wait_read(1, run[c]);
+			queues[1].enqueueReadBuffer(obuf[slot], CL_FALSE, 0, output_item_size * count,
+										(char *)output + output_item_size * first,
+										&wait_read, &read[c]);
+			queues[0].flush();
+			queue_m[device].flush();
+			queues[1].flush();
+		}
+		if (profile_m) {
+			std::string name = kernel.getInfo<CL_KERNEL_FUNCTION_NAME>();
+			for (size_t c = 0; c < chunks; ++c) {
+				size_t count = std::min(chunk_items, items - c * chunk_items);
+				profiler_m.record("write", device, "upload", write[c], input_item_size * count);
+				profiler_m.record(name, device, "compute", run[c]);
+				profiler_m.record("read", device, "download", read[c], output_item_size * count);
+			}
+		}
+	}
+
+	// Wait for the streams of a device, returning their buffers to the pool
+	void finish_stream(int device)
+	{
+		std::vector<cl::CommandQueue> & queues = stream_queues(device);
+		queues[0].finish();
+		queue_m[device].finish();
+		queues[1].finish();
+		std::vector<cl::Buffer> & in_use = stream_buffer_m[device];
+		for (size_t k = 0; k < in_use.size(); ++k) {
+			pool_m.release(in_use[k]);
+		}
+		in_use.clear();
+	}
+
     virtual void host_run() = 0;
 
 protected:
 	
 	virtual std::string const & get_device_program_text() = 0;
 
+	// Read the work group sizes tuned by earlier runs, once
+	void load_work_group_sizes()
+	{
+		if (work_group_size_loaded_m || cache_dir_m.empty()) {
+			return;
+		}
+		work_group_size_loaded_m = true;
+		std::ifstream in((cache_dir_m + "/work-group-sizes").c_str());
+		std::string key;
+		size_t size;
+		while (in >> key >> size) {
+			if (size > 0) {
+				work_group_size_m[key] = size;
+			}
+		}
+	}
+
+	// Rewrite the tuned work group sizes, through a temporary file as the
+	// binaries are
+	void store_work_group_sizes()
+	{
+		if (!make_cache_dir()) {
+			return;
+		}
+		std::string path = cache_dir_m + "/work-group-sizes";
+		std::ostringstream temp;
+		temp << path << "." << getpid();
+		std::ofstream out(temp.str().c_str());
+		std::map<std::string, size_t>::iterator it;
+		for (it = work_group_size_m.begin(); it != work_group_size_m.end(); ++it) {
+			out << it->first << " " << it->second << "\n";
+		}
+		out.close();
+		if (!out || rename(temp.str().c_str(), path.c_str()) != 0) {
+			remove(temp.str().c_str());
+		}
+	}
+
+	// The upload and download queues of a device's streams, made the
+	// first time they are needed
+	std::vector<cl::CommandQueue> & stream_queues(int device)
+	{
+		if (stream_queue_m.size() < device_m.size()) {
+			stream_queue_m.resize(device_m.size());
+			stream_buffer_m.resize(device_m.size());
+		}
+		std::vector<cl::CommandQueue> & queues = stream_queue_m[device];
+		if (queues.empty()) {
+			cl_command_queue_properties properties = profile_m ? CL_QUEUE_PROFILING_ENABLE : 0;
+			for (int k = 0; k < 2; ++k) {
+				queues.push_back(cl::CommandQueue(context_m, device_m[device], properties));
+			}
+		}
+		return queues;
+	}
+
+	static double wall_time()
+	{
+		return cody_now();
+	}
+
+	// 64-bit FNV-1a hash, continuing from h
+	static unsigned long long fnv1a(std::string const & s,
+									unsigned long long h = 14695981039346656037ULL)
+	{
+		for (size_t i = 0; i < s.size(); ++i) {
+			h ^= (unsigned char)s[i];
+			h *= 1099511628211ULL;
+		}
+		return h;
+	}
+
+	// The hash of the program for device i: its text, build options, and
+	// the device name and driver version
+	unsigned long long program_hash(size_t i)
+	{
+		unsigned long long h = fnv1a(device_program_text_m);
+		h = fnv1a(std::string(1, '\0') + build_options_m, h);
+		h = fnv1a(std::string(1, '\0') + device_m[i].getInfo<CL_DEVICE_NAME>(), h);
+		return fnv1a(std::string(1, '\0') + device_m[i].getInfo<CL_DRIVER_VERSION>(), h);
+	}
+
+	// The cache file of the binary of the program for device i
+	std::string program_binary_path(size_t i)
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.bin", program_hash(i));
+		return cache_dir_m + name;
+	}
+
+	// Create the cache directory and its parents, returning false if there
+	// is no cache
+	bool make_cache_dir()
+	{
+		if (cache_dir_m.empty()) {
+			return false;
+		}
+		for (size_t pos = cache_dir_m.find('/', 1); ; pos = cache_dir_m.find('/', pos + 1)) {
+			mkdir(cache_dir_m.substr(0, pos).c_str(), 0755);
+			if (pos == std::string::npos) {
+				break;
+			}
+		}
+		return true;
+	}
+
+	// Create program_m from the cached binaries of every device and build
+	// it, returning false if any is missing or the build fails
+	bool load_program_binaries()
+	{
+		if (cache_dir_m.empty()) {
+			return false;
+		}
+		std::vector<std::string> binary(device_m.size());
+		cl::Program::Binaries binaries;
+		for (size_t i = 0; i < device_m.size(); ++i) {
+			std::string path = program_binary_path(i);
+			std::ifstream in(path.c_str(), std::ios::binary);
+			std::ostringstream text;
+			text << in.rdbuf();
+			binary[i] = text.str();
+			if (verbose_m) {
+				std::cerr << "[Program cache]\n  device[" << i << "]: "
+						  << (binary[i].size() ? "hit " : "miss ") << path << "\n";
+			}
+			if (binary[i].empty()) {
+				return false;
+			}
+			binaries.push_back(std::make_pair(binary[i].data(), binary[i].size()));
+		}
+		try {
+			std::vector<cl_int> status(device_m.size());
+			program_m = cl::Program(context_m, device_m, binaries, &status);
+			program_m.build(device_m, build_options_m.c_str());
+		}
+		catch (cl::Error const & error) {
+			if (verbose_m) {
+				std::cerr << "  cached binaries rejected (" << opencl_error_string(error.err())
+						  << "), building from source\n";
+			}
+			program_m = cl::Program();
+			return false;
+		}
+		return true;
+	}
+
+	// Write the binary program_m was built into for each device to the
+	// cache.  Each file is written under a temporary name and renamed, so
+	// concurrent runs never load a partial binary.  Failures only mean the
+	// next run compiles again, so they are not errors
+	void store_program_binaries()
+	{
+		if (!make_cache_dir()) {
+			return;
+		}
+		std::vector<size_t> sizes = program_m.getInfo<CL_PROGRAM_BINARY_SIZES>();
+		std::vector<std::vector<char> > binary(sizes.size());
+		std::vector<char *> pointers(sizes.size());
+		for (size_t i = 0; i < sizes.size(); ++i) {
+			binary[i].resize(sizes[i] + 1);
+			pointers[i] = &binary[i][0];
+		}
+		program_m.getInfo(CL_PROGRAM_BINARIES, &pointers);
+		for (size_t i = 0; i < sizes.size() && i < device_m.size(); ++i) {
+			if (sizes[i] == 0) {
+				continue;
+			}
+			std::string path = program_binary_path(i);
+			std::ostringstream temp;
+			temp << path << "." << getpid();
+			std::ofstream out(temp.str().c_str(), std::ios::binary);
+			out.write(&binary[i][0], sizes[i]);
+			out.close();
+			if (!out || rename(temp.str().c_str(), path.c_str()) != 0) {
+				remove(temp.str().c_str());
+			}
+		}
+	}
+
     cl::Context context_m;
     cl::Program program_m;
     int debug_m;
     int profile_m;
     int verbose_m;
+    int out_of_order_m;
     std::string device_program_text_m;
+    std::string build_options_m;
+    std::string cache_dir_m;
     std::vector<cl::CommandQueue> queue_m;
+    std::vector<TaskGraph> graph_m;
     std::vector<cl::Device> device_m;
     std::vector<cl::Platform> platform_m;
+    EventProfiler profiler_m;
+    std::vector<double> throughput_m;
+    std::vector<std::vector<cl::CommandQueue> > stream_queue_m;
+    std::vector<std::vector<cl::Buffer> > stream_buffer_m;
+    BufferPool pool_m;
+    std::map<std::string, size_t> work_group_size_m;
+    bool work_group_size_loaded_m;
 	
 };
 
@@ -0,0 +1,178 @@
+#ifndef BUFFER_POOL_INCLUDED_H
+#define BUFFER_POOL_INCLUDED_H 1
+
+#include <exception>
+#include <map>
+#include <utility>
+#include <vector>
+
+#define __CL_ENABLE_EXCEPTIONS
+#include "common/cl.hpp"
+
+///
+// A pool of the device buffers of a context, so repeated runs and the
+// steps of iterative solvers reuse buffers rather than create and release
+// them.  Sizes are rounded up to size classes, the powers of two up to
+// 1 KiB and above that four classes to each doubling, and released buffers
+// wait in a bin per class and flags for the next acquire of the class.
+// With a slab size, small buffers of access flags alone are sub-buffers
+// carved from slabs of that size, aligned for every device, so many small
+// temporaries cost one allocation.  A buffer must only be released once
+// the commands using it are done.
+///
+class BufferPool {
+
+public:
+
+    BufferPool()
+        : slab_size_m(0),
+          align_m(1),
+          slab_used_m(0),
+          allocations_m(0),
+          reuses_m(0)
+        {
+        }
+
+    // align is the alignment of sub-buffers in bytes, and slab_size 0 for
+    // no slabs
+    void init(cl::Context const & context,
+              size_t slab_size,
+              size_t align)
+        {
+            clear();
+            context_m = context;
+            slab_size_m = slab_size;
+            align_m = align ? align : 1;
+            slab_used_m = slab_size;
+        }
+
+    cl::Buffer acquire(size_t size,
+                       cl_mem_flags flags = CL_MEM_READ_WRITE)
+        {
+            size_t bytes = size_class(size);
+            std::pair<size_t, cl_mem_flags> bin(bytes, flags);
+            std::vector<cl::Buffer> & free = free_m[bin];
+            if (free.size()) {
+                cl::Buffer buffer = free.back();
+                free.pop_back();
+                reuses_m++;
+                return buffer;
+            }
+
+            cl::Buffer buffer;
+            cl_mem_flags const access = CL_MEM_READ_WRITE | CL_MEM_WRITE_ONLY | CL_MEM_READ_ONLY;
+            if (bytes <= slab_size_m / 8 && (flags & ~access) == 0) {
+                size_t origin = (slab_used_m + align_m - 1) / align_m * align_m;
+                if (origin + bytes > slab_size_m) {
+                    slabs_m.push_back(cl::Buffer(context_m, CL_MEM_READ_WRITE, slab_size_m));
+                    allocations_m++;
+                    origin = 0;
+                }
+                cl_buffer_region region = { origin, bytes };
+                buffer = slabs_m.back().createSubBuffer(flags, CL_BUFFER_CREATE_TYPE_REGION, &region);
+                slab_used_m = origin + bytes;
+            } else {
+                buffer = cl::Buffer(context_m, flags, bytes);
+                allocations_m++;
+            }
+            bin_m[buffer()] = bin;
+            return buffer;
+        }
+
+    // Return a buffer of the pool to its bin
+    void release(cl::Buffer const & buffer)
+        {
+            std::map<cl_mem, std::pair<size_t, cl_mem_flags> >::iterator it = bin_m.find(buffer());
+            if (it != bin_m.end()) {
+                free_m[it->second].push_back(buffer);
+            }
+        }
+
+    // Drop every buffer of the pool; those still acquired stay valid but
+    // are no longer returned to it
+    void clear()
+        {
+            free_m.clear();
+            bin_m.clear();
+            slabs_m.clear();
+            slab_used_m = slab_size_m;
+        }
+
+    // Device allocations made, buffers and slabs
+    size_t allocations() const
+        {
+            return allocations_m;
+        }
+
+    // Acquires served from the bins
+    size_t reuses() const
+        {
+            return reuses_m;
+        }
+
+    static size_t size_class(size_t size)
+        {
+            size_t p = 256;
+            while (p < size) {
+                p *= 2;
+            }
+            if (p <= 1024) {
+                return p;
+            }
+            size_t step = p / 8;
+            return (size + step - 1) / step * step;
+        }
+
+private:
+
+    BufferPool(BufferPool const &);
+    BufferPool & operator=(BufferPool const &);
+
+    cl::Context context_m;
+    size_t slab_size_m;
+    size_t align_m;
+    std::vector<cl::Buffer> slabs_m;
+    size_t slab_used_m;
+    std::map<std::pair<size_t, cl_mem_flags>, std::vector<cl::Buffer> > free_m;
+    std::map<cl_mem, std::pair<size_t, cl_mem_flags> > bin_m;
+    size_t allocations_m;
+    size_t reuses_m;
+
+};
+
+///
+// A buffer of a pool for a scope, released to the pool at its end
+///
+class PooledBuffer {
+
+public:
+
+    PooledBuffer(BufferPool & pool,
+                 size_t size,
+                 cl_mem_flags flags = CL_MEM_READ_WRITE)
+        : pool_m(pool),
+          buffer_m(pool.acquire(size, flags))
+        {
+        }
+
+    ~PooledBuffer()
+        {
+            pool_m.release(buffer_m);
+        }
+
+    cl::Buffer const & buffer() const
+        {
+            return buffer_m;
+        }
+
+private:
+
+    PooledBuffer(PooledBuffer const &);
+    PooledBuffer & operator=(PooledBuffer const &);
+
+    BufferPool & pool_m;
+    cl::Buffer buffer_m;
+
+};
+
+#endif
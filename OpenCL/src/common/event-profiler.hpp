@@ -0,0 +1,223 @@
+#ifndef EVENT_PROFILER_INCLUDED_H
+#define EVENT_PROFILER_INCLUDED_H 1
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#define __CL_ENABLE_EXCEPTIONS
+#include "common/cl.hpp"
+#include "cody.h"
+
+///
+// Collects the events of the commands an application enqueues, on queues
+// made with CL_QUEUE_PROFILING_ENABLE, and once they complete summarizes
+// them by name (count, total, min, max, mean wait from queued to start
+// and, for transfers, GB/s) and writes them as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev): a process per device, a thread
+// per queue, and beside each queue a thread of the time each command
+// waited from being queued to starting.
+///
+class EventProfiler {
+
+public:
+
+    void record(std::string const & name,
+                int device,
+                std::string const & queue,
+                cl::Event const & event,
+                size_t bytes = 0)
+        {
+            Record r = { name, device, queue, event, bytes };
+            records_m.push_back(r);
+        }
+
+    void clear()
+        {
+            records_m.clear();
+        }
+
+    size_t size() const
+        {
+            return records_m.size();
+        }
+
+    // Total run time in ms of the records named name; they must all have
+    // completed
+    double total(std::string const & name)
+        {
+            double t = 0.0;
+            for (size_t i = 0; i < records_m.size(); ++i) {
+                if (records_m[i].name == name) {
+                    cl::Event const & e = records_m[i].event;
+                    t += (e.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+                          e.getProfilingInfo<CL_PROFILING_COMMAND_START>()) * 1.0e-6;
+                }
+            }
+            return t;
+        }
+
+    // Summarize the records by name, also to cody as regions inside the
+    // open ones; they must all have completed
+    void report(std::ostream & out)
+        {
+            std::vector<Times> times = get_times();
+            std::map<std::string, Stats> stats;
+            std::vector<std::string> order;
+            for (size_t i = 0; i < records_m.size(); ++i) {
+                double t = (times[i].end - times[i].start) * 1.0e-6;
+                double wait = (times[i].start - times[i].queued) * 1.0e-6;
+                if (stats.find(records_m[i].name) == stats.end()) {
+                    Stats s = { 0, 0.0, t, t, 0.0, 0 };
+                    stats[records_m[i].name] = s;
+                    order.push_back(records_m[i].name);
+                }
+                Stats & s = stats[records_m[i].name];
+                s.count++;
+                s.total += t;
+                s.min = std::min(s.min, t);
+                s.max = std::max(s.max, t);
+                s.wait += wait;
+                s.bytes += records_m[i].bytes;
+            }
+
+            out << "[Profile]\n"
+                << "  " << std::left << std::setw(20) << "name" << std::right
+                << std::setw(8) << "count"
+                << std::setw(12) << "total ms"
+                << std::setw(12) << "min ms"
+                << std::setw(12) << "max ms"
+                << std::setw(12) << "wait ms"
+                << std::setw(10) << "GB/s" << "\n";
+            for (size_t i = 0; i < order.size(); ++i) {
+                Stats const & s = stats[order[i]];
+                cody_record(order[i].c_str(), s.total * 1.0e-3, s.count);
+                if (s.bytes) {
+                    cody_count(order[i].c_str(), "bytes", (double)s.bytes);
+                }
+                out << "  " << std::left << std::setw(20) << order[i] << std::right
+                    << std::setw(8) << s.count
+                    << std::setw(12) << s.total
+                    << std::setw(12) << s.min
+                    << std::setw(12) << s.max
+                    << std::setw(12) << s.wait / s.count;
+                if (s.bytes && s.total > 0.0) {
+                    out << std::setw(10) << s.bytes / (s.total * 1.0e-3) * 1.0e-9;
+                } else {
+                    out << std::setw(10) << "-";
+                }
+                out << "\n";
+            }
+        }
+
+    // Write the Chrome trace of the records, returning false if the file
+    // cannot be written
+    bool write_trace(std::string const & path)
+        {
+            std::ofstream out(path.c_str());
+            if (!out) {
+                return false;
+            }
+            std::vector<Times> times = get_times();
+            cl_ulong origin = 0;
+            for (size_t i = 0; i < times.size(); ++i) {
+                if (i == 0 || times[i].queued < origin) {
+                    origin = times[i].queued;
+                }
+            }
+
+            // Number the queues of each device, their wait threads after
+            std::map<std::pair<int, std::string>, int> threads;
+            for (size_t i = 0; i < records_m.size(); ++i) {
+                std::pair<int, std::string> key(records_m[i].device, records_m[i].queue);
+                if (threads.find(key) == threads.end()) {
+                    int n = threads.size();
+                    threads[key] = 2 * n;
+                }
+            }
+
+            out << "{\"traceEvents\":[\n";
+            std::map<std::pair<int, std::string>, int>::iterator it;
+            bool first = true;
+            for (it = threads.begin(); it != threads.end(); ++it) {
+                out << (first ? "" : ",\n")
+                    << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << it->first.first
+                    << ",\"args\":{\"name\":\"device[" << it->first.first << "]\"}},\n"
+                    << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << it->first.first
+                    << ",\"tid\":" << it->second
+                    << ",\"args\":{\"name\":\"" << it->first.second << "\"}},\n"
+                    << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << it->first.first
+                    << ",\"tid\":" << it->second + 1
+                    << ",\"args\":{\"name\":\"" << it->first.second << " wait\"}}";
+                first = false;
+            }
+            out << std::fixed << std::setprecision(3);
+            for (size_t i = 0; i < records_m.size(); ++i) {
+                Record const & r = records_m[i];
+                int tid = threads[std::make_pair(r.device, r.queue)];
+                double queued = (times[i].queued - origin) * 1.0e-3;
+                double submit = (times[i].submit - origin) * 1.0e-3;
+                double start = (times[i].start - origin) * 1.0e-3;
+                double end = (times[i].end - origin) * 1.0e-3;
+                out << ",\n{\"ph\":\"X\",\"cat\":\"command\",\"name\":\"" << r.name
+                    << "\",\"pid\":" << r.device << ",\"tid\":" << tid
+                    << ",\"ts\":" << start << ",\"dur\":" << end - start
+                    << ",\"args\":{\"bytes\":" << r.bytes << "}}"
+                    << ",\n{\"ph\":\"X\",\"cat\":\"wait\",\"name\":\"" << r.name
+                    << "\",\"pid\":" << r.device << ",\"tid\":" << tid + 1
+                    << ",\"ts\":" << queued << ",\"dur\":" << start - queued
+                    << ",\"args\":{\"submit latency us\":" << submit - queued
+                    << ",\"start latency us\":" << start - submit << "}}";
+            }
+            out << "\n]}\n";
+            return (bool)out;
+        }
+
+private:
+
+    struct Record {
+        std::string name;
+        int device;
+        std::string queue;
+        cl::Event event;
+        size_t bytes;
+    };
+
+    struct Times {
+        cl_ulong queued;
+        cl_ulong submit;
+        cl_ulong start;
+        cl_ulong end;
+    };
+
+    struct Stats {
+        size_t count;
+        double total;
+        double min;
+        double max;
+        double wait;
+        size_t bytes;
+    };
+
+    std::vector<Times> get_times()
+        {
+            std::vector<Times> times(records_m.size());
+            for (size_t i = 0; i < records_m.size(); ++i) {
+                cl::Event const & e = records_m[i].event;
+                times[i].queued = e.getProfilingInfo<CL_PROFILING_COMMAND_QUEUED>();
+                times[i].submit = e.getProfilingInfo<CL_PROFILING_COMMAND_SUBMIT>();
+                times[i].start = e.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+                times[i].end = e.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+            }
+            return times;
+        }
+
+    std::vector<Record> records_m;
+
+};
+
+#endif
@@ -0,0 +1,252 @@
+#ifndef TASK_GRAPH_INCLUDED_H
+#define TASK_GRAPH_INCLUDED_H 1
+
+#include <map>
+#include <vector>
+
+#define __CL_ENABLE_EXCEPTIONS
+#include "common/cl.hpp"
+
+///
+// Orders the commands of a queue by the buffers they use rather than by the
+// order they are enqueued in, so on a queue made with
+// CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE independent kernels and transfers
+// can run at once.  Each command is declared with the buffers it reads and
+// writes and waits only on those it conflicts with: the last writer of
+// every buffer it uses, and for every buffer it writes the readers since
+// that writer.  Buffers are told apart by handle, so sub-buffers of one
+// buffer must not overlap, as those of the pool do not, and writing part of
+// a buffer counts as writing all of it.  Kernel arguments are taken when a
+// kernel is enqueued, so a kernel can be set up again for the next command
+// at once.  On an in-order queue the waits are redundant and the commands
+// run as enqueued.  Commands enqueued on the queue directly are not ordered
+// against those of the graph; barrier() orders everything before it.
+///
+class TaskGraph {
+
+public:
+
+    typedef std::vector<cl::Memory> Buffers;
+
+    TaskGraph()
+        : out_of_order_m(false),
+          commands_m(0),
+          waits_m(0)
+        {
+        }
+
+    void init(cl::CommandQueue const & queue)
+        {
+            queue_m = queue;
+            out_of_order_m = (queue.getInfo<CL_QUEUE_PROPERTIES>() &
+                              CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) != 0;
+            uses_m.clear();
+        }
+
+    cl::Event kernel(cl::Kernel const & kernel,
+                     cl::NDRange const & offset,
+                     cl::NDRange const & global,
+                     cl::NDRange const & local,
+                     Buffers const & reads,
+                     Buffers const & writes)
+        {
+            std::vector<cl::Event> wait = wait_list(reads, writes);
+            cl::Event event;
+            queue_m.enqueueNDRangeKernel(kernel, offset, global, local,
+                                         wait.size() ? &wait : NULL, &event);
+            retire(reads, writes, event);
+            return event;
+        }
+
+    // Host to device; unless blocking the host data must stay valid until
+    // the event completes
+    cl::Event write(cl::Buffer const & buffer,
+                    size_t offset,
+                    size_t size,
+                    void const * host,
+                    bool blocking = false)
+        {
+            Buffers writes(1, buffer);
+            std::vector<cl::Event> wait = wait_list(Buffers(), writes);
+            cl::Event event;
+            queue_m.enqueueWriteBuffer(buffer, blocking ? CL_TRUE : CL_FALSE, offset, size, host,
+                                       wait.size() ? &wait : NULL, &event);
+            retire(Buffers(), writes, event);
+            return event;
+        }
+
+    // Device to host; unless blocking the host data is only there once the
+    // event completes
+    cl::Event read(cl::Buffer const & buffer,
+                   size_t offset,
+                   size_t size,
+                   void * host,
+                   bool blocking = false)
+        {
+            Buffers reads(1, buffer);
+            std::vector<cl::Event> wait = wait_list(reads, Buffers());
+            cl::Event event;
+            queue_m.enqueueReadBuffer(buffer, blocking ? CL_TRUE : CL_FALSE, offset, size, host,
+                                      wait.size() ? &wait : NULL, &event);
+            retire(reads, Buffers(), event);
+            return event;
+        }
+
+    cl::Event copy(cl::Buffer const & source,
+                   cl::Buffer const & destination,
+                   size_t source_offset,
+                   size_t destination_offset,
+                   size_t size)
+        {
+            Buffers reads(1, source), writes(1, destination);
+            std::vector<cl::Event> wait = wait_list(reads, writes);
+            cl::Event event;
+            queue_m.enqueueCopyBuffer(source, destination, source_offset, destination_offset, size,
+                                      wait.size() ? &wait : NULL, &event);
+            retire(reads, writes, event);
+            return event;
+        }
+
+    // Everything enqueued on the queue so far, through the graph or not,
+    // before everything enqueued later
+    void barrier()
+        {
+            queue_m.enqueueBarrier();
+            uses_m.clear();
+        }
+
+    // Wait for every command of the queue
+    void finish()
+        {
+            queue_m.finish();
+            uses_m.clear();
+        }
+
+    bool out_of_order() const
+        {
+            return out_of_order_m;
+        }
+
+    // Commands enqueued, and the events they waited on in all
+    size_t commands() const
+        {
+            return commands_m;
+        }
+
+    size_t waits() const
+        {
+            return waits_m;
+        }
+
+    cl::CommandQueue & queue()
+        {
+            return queue_m;
+        }
+
+    // The buffers of a read or write set
+    static Buffers buffers(cl::Memory const & a)
+        {
+            return Buffers(1, a);
+        }
+
+    static Buffers buffers(cl::Memory const & a,
+                           cl::Memory const & b)
+        {
+            Buffers set(1, a);
+            set.push_back(b);
+            return set;
+        }
+
+    static Buffers buffers(cl::Memory const & a,
+                           cl::Memory const & b,
+                           cl::Memory const & c)
+        {
+            Buffers set = buffers(a, b);
+            set.push_back(c);
+            return set;
+        }
+
+private:
+
+    // The last writer of a buffer and its readers since
+    struct Uses {
+        cl::Event writer;
+        std::vector<cl::Event> readers;
+    };
+
+    // Readers of a buffer kept before those that completed are dropped
+    enum { READERS = 16 };
+
+    static void add(std::vector<cl::Event> & list,
+                    cl::Event const & event)
+        {
+            if (event() == NULL) {
+                return;
+            }
+            for (size_t i = 0; i < list.size(); ++i) {
+                if (list[i]() == event()) {
+                    return;
+                }
+            }
+            list.push_back(event);
+        }
+
+    // The events a command reading reads and writing writes must wait on
+    std::vector<cl::Event> wait_list(Buffers const & reads,
+                                     Buffers const & writes)
+        {
+            std::vector<cl::Event> wait;
+            for (size_t i = 0; i < reads.size(); ++i) {
+                std::map<cl_mem, Uses>::iterator found = uses_m.find(reads[i]());
+                if (found != uses_m.end()) {
+                    add(wait, found->second.writer);
+                }
+            }
+            for (size_t i = 0; i < writes.size(); ++i) {
+                std::map<cl_mem, Uses>::iterator found = uses_m.find(writes[i]());
+                if (found != uses_m.end()) {
+                    add(wait, found->second.writer);
+                    for (size_t k = 0; k < found->second.readers.size(); ++k) {
+                        add(wait, found->second.readers[k]);
+                    }
+                }
+            }
+            commands_m++;
+            waits_m += wait.size();
+            return wait;
+        }
+
+    // Make event the last reader of reads and the writer of writes
+    void retire(Buffers const & reads,
+                Buffers const & writes,
+                cl::Event const & event)
+        {
+            for (size_t i = 0; i < reads.size(); ++i) {
+                std::vector<cl::Event> & readers = uses_m[reads[i]()].readers;
+                if (readers.size() >= READERS) {
+                    std::vector<cl::Event> running;
+                    for (size_t k = 0; k < readers.size(); ++k) {
+                        if (readers[k].getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() != CL_COMPLETE) {
+                            running.push_back(readers[k]);
+                        }
+                    }
+                    readers.swap(running);
+                }
+                readers.push_back(event);
+            }
+            for (size_t i = 0; i < writes.size(); ++i) {
+                Uses & uses = uses_m[writes[i]()];
+                uses.writer = event;
+                uses.readers.clear();
+            }
+        }
+
+    cl::CommandQueue queue_m;
+    bool out_of_order_m;
+    std::map<cl_mem, Uses> uses_m;
+    size_t commands_m;
+    size_t waits_m;
+
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef APP_INCLUDED_H
+#define APP_INCLUDED_H 1
+
+#include "common/app-base.hpp"
+
+// Work items per side of a work group, each updating one mesh cell
+#define HEAT_TILE 16
+
+///
+// A 2D heat transfer simulation stepped on an OpenCL device
+///
+class App : public AppBase {
+
+public:
+
+    App(int debug,
+        int profile,
+        int verbose,
+        std::vector<int> const & device_list,
+        size_t n,
+        size_t max_t,
+        double c)
+        : AppBase(debug, profile, verbose),
+          device_list_m(device_list),
+          n_m(n),
+          max_t_m(max_t),
+          c_m(c)
+        {
+        }
+
+    virtual void host_run();
+
+private:
+
+    virtual std::string const & get_device_program_text();
+
+    void set_initial_conds(std::vector<double> & mesh);
+
+    void dump(std::vector<double> const & mesh, std::string const & path);
+
+    std::vector<int> const & device_list_m;
+    size_t n_m;
+    size_t max_t_m;
+    double c_m;
+
+};
+
+#endif
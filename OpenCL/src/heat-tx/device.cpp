@@ -0,0 +1,66 @@
+// Device kernels...
+
+#include "heat-tx/app.hpp"
+
+#define STRINGIFY(X) #X
+
+// The program is specialized for a run, see App::host_run: TILE is the
+// work group side, N the mesh side and CDTODS2 the diffusion coefficient
+std::string const program_text =
+    "#pragma OPENCL EXTENSION cl_khr_fp64 : enable\n"
+    STRINGIFY(
+
+
+    // One step of the N x N mesh old_mesh into new_mesh. Work item (x, y)
+    // updates interior cell (y + 1, x + 1), reading its neighbors from a
+    // TILE x TILE block of old_mesh, plus its halo, staged in local memory.
+    // Cells where source is not zero are held at the source value. The
+    // edges of the mesh are never written, so they stay at zero.
+    __kernel void step(__global const double* old_mesh,
+                       __global double* new_mesh,
+                       __global const double* source)
+    {
+        __local double tile[TILE + 2][TILE + 2];
+        size_t const li = get_local_id(1) + 1;
+        size_t const lj = get_local_id(0) + 1;
+        size_t const i = get_global_id(1) + 1;
+        size_t const j = get_global_id(0) + 1;
+        size_t const c = i * N + j;
+        int const inside = i < N - 1 && j < N - 1;
+
+        // every work item reaches the barrier, those past the mesh loading
+        // nothing
+        if (inside) {
+            tile[li][lj] = old_mesh[c];
+            if (li == 1) {
+                tile[0][lj] = old_mesh[c - N];
+            }
+            if (li == TILE || i == N - 2) {
+                tile[li + 1][lj] = old_mesh[c + N];
+            }
+            if (lj == 1) {
+                tile[li][0] = old_mesh[c - 1];
+            }
+            if (lj == TILE || j == N - 2) {
+                tile[li][lj + 1] = old_mesh[c + 1];
+            }
+        }
+        barrier(CLK_LOCAL_MEM_FENCE);
+
+        if (inside) {
+            double const s = source[c];
+            double const o = tile[li][lj];
+            new_mesh[c] = (s != 0.0) ? s :
+                o + (CDTODS2 * (tile[li + 1][lj] + tile[li - 1][lj] - 4.0 *
+                                o + tile[li][lj + 1] + tile[li][lj - 1]));
+        }
+    }
+
+
+    );
+
+
+std::string const & App::get_device_program_text()
+{
+    return program_text;
+}
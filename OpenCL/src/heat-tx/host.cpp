@@ -0,0 +1,188 @@
+// Host code...
+
+#include "heat-tx/app.hpp"
+
+// Heat source strength
+#define K 0.4
+
+// The heat source, a ring of cells set in an otherwise cold n x n mesh, as
+// in the other heat-tx versions
+void App::set_initial_conds(std::vector<double> & mesh)
+{
+    long const n = n_m;
+    long x0 = n / 2;
+    long y0 = n / 2;
+    long x = n / 4, y = 0;
+    long radius_err = 1 - x;
+
+    mesh.assign(n * n, 0.0);
+    while (x >= y) {
+        mesh[( x + x0) * n + ( y + y0)] = K * .50;
+        mesh[( y + x0) * n + ( x + y0)] = K * .60;
+        mesh[(-x + x0) * n + ( y + y0)] = K * .70;
+        mesh[(-y + x0) * n + ( x + y0)] = K * .80;
+        mesh[(-x + x0) * n + (-y + y0)] = K * .70;
+        mesh[(-y + x0) * n + (-x + y0)] = K * .60;
+        mesh[( x + x0) * n + (-y + y0)] = K * .50;
+        mesh[( y + x0) * n + (-x + y0)] = K;
+        y++;
+        if (radius_err < 0) {
+            radius_err += 2 * y + 1;
+        } else {
+            --x;
+            radius_err += 2 * (y - x + 1);
+        }
+    }
+}
+
+
+void App::dump(std::vector<double> const & mesh, std::string const & path)
+{
+    FILE *imgfp = fopen(path.c_str(), "wb");
+
+    if (NULL == imgfp) {
+        std::cerr << "ERROR: cannot open " << path << "\n";
+        throw;
+    }
+    for (size_t i = 0; i < n_m; ++i) {
+        for (size_t j = 0; j < n_m; ++j) {
+            fprintf(imgfp, "%lf%s", mesh[i * n_m + j],
+                    (j == n_m - 1) ? "" : " ");
+        }
+        fprintf(imgfp, "\n");
+    }
+    fclose(imgfp);
+}
+
+
+void App::host_run()
+{
+    int rc;
+    size_t const n = n_m;
+    size_t const bytes = sizeof(double) * n * n;
+    double const delta_s = 1.0 / (double)(n + 1);
+    double const delta_t = (delta_s * delta_s) / (4.0 * c_m);
+    double const cdtods2 = (c_m * delta_t) / (delta_s * delta_s);
+
+    // The initial mesh is cold but for the source, so it is also the mask
+    // of the cells the kernel holds at the source values
+    std::vector<double> mesh;
+    set_initial_conds(mesh);
+    cody_init("heat-tx", "opencl");
+    cody_param("n", "%zu", n);
+    cody_param("steps", "%zu", max_t_m);
+
+    // Select a device
+    int device_id;
+    if (device_list_m.size()) {
+        // use first device in the device list
+        device_id = device_list_m[0];
+    } else {
+        device_id = get_most_capable_device();
+    }
+    if (verbose_m) {
+        std::cerr << "[Device selection]\n  using device[" << device_id << "]:\n";
+    }
+    cl::CommandQueue & queue = queue_m[device_id];
+
+    // Events for timing
+    cl::Event event1, event2, event3;
+
+    // Allocate device memory from the pool: the source and the meshes of
+    // the even and the odd steps, which trade places every step
+    PooledBuffer source_buffer(pool_m, bytes, CL_MEM_READ_ONLY);
+    PooledBuffer even_buffer(pool_m, bytes);
+    PooledBuffer odd_buffer(pool_m, bytes);
+    cl::Buffer const & source = source_buffer.buffer();
+    cl::Buffer meshes[2] = { even_buffer.buffer(), odd_buffer.buffer() };
+
+    // Copy input
+    queue.enqueueWriteBuffer(source, CL_TRUE, 0, bytes, &mesh[0]);
+    queue.enqueueWriteBuffer(meshes[0], CL_TRUE, 0, bytes, &mesh[0]);
+    std::fill(mesh.begin(), mesh.end(), 0.0);
+    queue.enqueueWriteBuffer(meshes[1], CL_TRUE, 0, bytes, &mesh[0], NULL,
+                             &event1);
+
+    // Build the program for this mesh, so the kernel's index arithmetic
+    // and update are on compile-time constants, and create the kernel
+    AppBase::Defines defines;
+    defines["TILE"] = define_value(HEAT_TILE);
+    defines["N"] = define_value(n);
+    defines["CDTODS2"] = define_value(cdtods2);
+    build_program(get_device_program_text(), defines);
+    cl::Kernel kernel(program_m, "step", &rc);
+    rc = kernel.setArg(2, source);
+
+    // One work item per interior cell, rounded up to whole tiles
+    size_t const global = (n - 2 + HEAT_TILE - 1) / HEAT_TILE * HEAT_TILE;
+    if (verbose_m) {
+        std::cerr << "  work group size = " << HEAT_TILE << " x "
+                  << HEAT_TILE << "\n";
+    }
+
+    // Run kernel, swapping the meshes between steps. Nothing comes back to
+    // the host until the dump
+    std::cout << "o starting simulation...\n";
+    cody_begin("run");
+    double secs = cody_now();
+    for (size_t t = 0; t < max_t_m; ++t) {
+        if (verbose_m && 0 == t % 100) {
+            std::cout << ". starting iteration " << t << " of " << max_t_m
+                      << "\n";
+        }
+        rc = kernel.setArg(0, meshes[t % 2]);
+        rc = kernel.setArg(1, meshes[(t + 1) % 2]);
+        queue.enqueueNDRangeKernel(kernel,
+                                   cl::NullRange,
+                                   cl::NDRange(global, global),
+                                   cl::NDRange(HEAT_TILE, HEAT_TILE),
+                                   NULL,
+                                   (t == max_t_m - 1) ? &event2 : NULL);
+    }
+    queue.finish();
+    secs = cody_now() - secs;
+    cody_end();
+    double const updates = (double)(n - 2) * (double)(n - 2) * (double)max_t_m;
+    std::cout << "o simulation done\n";
+    fprintf(stdout, "%10s %10s %12s %14s %10s\n", "n", "steps", "seconds",
+            "Mupdates/s", "GB/s");
+    fprintf(stdout, "%10zu %10zu %12.4lf %14.2lf %10.2lf\n", n, max_t_m, secs,
+            updates / secs * 1e-6,
+            updates * 2.0 * sizeof(double) / secs * 1e-9);
+    char name[64];
+    snprintf(name, sizeof(name), "updates n=%zu", n);
+    cody_metric(name, updates / secs * 1e-6, "Mupdates/s");
+    snprintf(name, sizeof(name), "bandwidth n=%zu", n);
+    cody_metric(name, updates * 2.0 * sizeof(double) / secs * 1e-9, "GB/s");
+    cody_work("run", updates * 1e-6, "Mupdates");
+
+    // Copy output: the odd steps, as the other heat-tx versions dump
+    queue.enqueueReadBuffer(meshes[1], CL_TRUE, 0, bytes, &mesh[0], NULL,
+                            &event3);
+
+    // Timings
+    if (profile_m) {
+        cl_ulong start, end;
+        float t; // execution time in milliseconds
+
+        std::cerr << "[Timing]\n";
+        start = event1.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        end = event1.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        t = (end - start) * 1.0e-6f;
+        std::cerr << "  write execution time = " << t << " ms\n";
+        if (max_t_m) {
+            start = event2.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+            end = event2.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+            t = (end - start) * 1.0e-6f;
+            std::cerr << "  last step execution time = " << t << " ms\n";
+        }
+        start = event3.getProfilingInfo<CL_PROFILING_COMMAND_START>();
+        end = event3.getProfilingInfo<CL_PROFILING_COMMAND_END>();
+        t = (end - start) * 1.0e-6f;
+        std::cerr << "  read execution time = " << t << " ms\n";
+    }
+
+    std::cout << "o dumping mesh to heat-img.dat\n";
+    dump(mesh, "heat-img.dat");
+    cody_finish();
+}
@@ -6,98 +6,116 @@ void App::host_run()
 {
     int rc;
 
-    // host data for tests
     size_t const size = 1 << 25;
-    std::vector<float> idata;
-    std::vector<float> odata;
 
-    for (size_t i = 0; i < size; ++i) {
-        idata.push_back((i));
-    }
-    odata.resize(idata.size());
+    // Unless the kernels use the host memory in place, the data is streamed
+    // through the devices in chunks of a sixteenth, so it need not fit in
+    // device memory
+    size_t const chunk = size / 16;
 
-    // Events for timing
-    cl::Event event1, event2, event3;
+    // Create kernel, its arguments first the buffers of the calibration
+    PooledBuffer ibuf(pool_m, sizeof(float) * chunk, CL_MEM_READ_ONLY);
+    PooledBuffer obuf(pool_m, sizeof(float) * chunk, CL_MEM_WRITE_ONLY);
+    cl::Kernel kernel(program_m, "square", &rc);
+    rc = kernel.setArg(0, ibuf.buffer());
+    rc = kernel.setArg(1, obuf.buffer());
+    rc = kernel.setArg(2, chunk);
 
-    // Allocate device memory
-    cl::Buffer ibuf(context_m, CL_MEM_READ_ONLY, sizeof(float) * idata.size());
-    cl::Buffer obuf(context_m, CL_MEM_WRITE_ONLY, sizeof(float) * odata.size());
+    // Select the devices, those in the device list or else all of them
+    std::vector<int> devices = select_devices(device_list_m);
 
-    // Create kernel
-    cl::Kernel kernel(program_m, "square", &rc);
-    rc = kernel.setArg(0, ibuf);
-    rc = kernel.setArg(1, obuf);
-    rc = kernel.setArg(2, size);
+    // Host data for tests, in pinned memory, which the kernels use in
+    // place if every device shares memory with the host
+    bool const zero_copy = host_unified_memory(devices);
+    HostBuffer input, output;
+    input.allocate(context_m, queue_m[devices[0]], sizeof(float) * size, CL_MEM_READ_ONLY);
+    output.allocate(context_m, queue_m[devices[0]], sizeof(float) * size, CL_MEM_WRITE_ONLY);
+    float *idata = input.data<float>();
+    float *odata = output.data<float>();
+    for (size_t i = 0; i < size; ++i) {
+        idata[i] = i;
+    }
 
-    // Select a device
-    int device_id;
-    if (device_list_m.size()) {
-        // use first device in the device list
-        device_id = device_list_m[0];
-    } else {
-        device_id = get_most_capable_device();
+    // Tune the work group size of each device on one chunk.  Parts are
+    // split in multiples of the largest, which the others, powers of two,
+    // divide, and a kernel run on every device at once takes the smallest
+    queue_m[devices[0]].enqueueWriteBuffer(ibuf.buffer(), CL_TRUE, 0, sizeof(float) * chunk, &idata[0]);
+    std::vector<size_t> work_group_size(device_m.size());
+    size_t smallest = 0, largest = 0;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        size_t s = tune_work_group_size(kernel, devices[i], chunk);
+        work_group_size[devices[i]] = s;
+        smallest = (smallest == 0) ? s : std::min(smallest, s);
+        largest = std::max(largest, s);
     }
     if (verbose_m) {
-        std::cerr << "[Device selection]\n  using device[" << device_id << "]:\n";
+        std::cerr << "[Device selection]\n  using device[s]:";
+        for (size_t i = 0; i < devices.size(); ++i) {
+            std::cerr << " " << devices[i] << " (work group size " << work_group_size[devices[i]] << ")";
+        }
+        std::cerr << "\n  host memory: " << (zero_copy ? "zero-copy" : "pinned") << "\n";
     }
 
-    // Copy input
-    queue_m[device_id].enqueueWriteBuffer(ibuf,
-                                          CL_TRUE,
-                                          0,
-                                          idata.size() * sizeof(float),
-                                          &idata[0],
-                                          NULL,
-                                          &event1);
+    // Split the work by the throughput of each device on one chunk
+    if (devices.size() > 1) {
+        for (size_t i = 0; i < devices.size(); ++i) {
+            calibrate(kernel, std::vector<int>(1, devices[i]), cl::NDRange(chunk),
+                      cl::NDRange(work_group_size[devices[i]]));
+        }
+    }
+    std::vector<DeviceRange> parts = split_range(devices, size, largest);
 
-    // Run kernel
-    size_t work_group_size;
-    work_group_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device_m[device_id]);
-    if (verbose_m) {
-        std::cerr << "  work group size = " << work_group_size << "\n";
+    // Run each device on its part in place, or else stream it its part
+    // from the pinned memory, all devices at once
+    double start_time = wall_time();
+    if (zero_copy) {
+        input.unmap();
+        output.unmap();
+        rc = kernel.setArg(0, input.buffer());
+        rc = kernel.setArg(1, output.buffer());
+        rc = kernel.setArg(2, size);
+        enqueue_split(kernel, parts, cl::NDRange(size), cl::NDRange(smallest));
+        finish_split(parts);
+        input.map();
+        output.map();
+        idata = input.data<float>();
+        odata = output.data<float>();
+    }
+    for (size_t i = 0; i < parts.size() && !zero_copy; ++i) {
+        stream_kernel(parts[i].device,
+                      kernel,
+                      idata + parts[i].offset,
+                      sizeof(float),
+                      odata + parts[i].offset,
+                      sizeof(float),
+                      parts[i].size,
+                      chunk,
+                      work_group_size[parts[i].device]);
     }
-    queue_m[device_id].enqueueNDRangeKernel(kernel,
-                                            cl::NullRange,
-                                            cl::NDRange(size),
-                                            cl::NDRange(work_group_size),
-                                            NULL,
-                                            &event2);
-    // Copy output
-    queue_m[device_id].enqueueReadBuffer(obuf,
-                                         CL_TRUE,
-                                         0,
-                                         odata.size() * sizeof(float),
-                                         &odata[0],
-                                         NULL,
-                                         &event3);
 
     // Wait for completion
-    queue_m[device_id].finish();
+    for (size_t i = 0; i < parts.size() && !zero_copy; ++i) {
+        finish_stream(parts[i].device);
+    }
+    double elapsed = wall_time() - start_time;
+    if (verbose_m) {
+        std::cerr << "[Buffer pool]\n  allocations: " << pool_m.allocations()
+                  << "\n  reuses: " << pool_m.reuses() << "\n";
+    }
 
-    // Timings
+    // Timings of the commands, and their timeline in square-trace.json
     if (profile_m) {
-        cl_ulong start, end;
-        float t; // execution time in milliseconds
-
-        std::cerr << "[Timing]\n";
-        start = event1.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-        end = event1.getProfilingInfo<CL_PROFILING_COMMAND_END>();
-        t = (end - start) * 1.0e-6f;
-        std::cerr << "  write execution time = " << t << " ms\n";
-        start = event2.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-        end = event2.getProfilingInfo<CL_PROFILING_COMMAND_END>();
-        t = (end - start) * 1.0e-6f;
-        std::cerr << "  kernel execution time = " << t << " ms\n";
-        start = event3.getProfilingInfo<CL_PROFILING_COMMAND_START>();
-        end = event3.getProfilingInfo<CL_PROFILING_COMMAND_END>();
-        t = (end - start) * 1.0e-6f;
-        std::cerr << "  read execution time = " << t << " ms\n";
+        profiler_m.report(std::cerr);
+        std::cerr << "  elapsed time = " << elapsed * 1.0e3 << " ms\n";
+        if (profiler_m.write_trace("square-trace.json")) {
+            std::cerr << "  timeline written to square-trace.json\n";
+        }
     }
 
     // Check results
     std::cout << "[Results]\n";
     int nerror = 0;
-    for (size_t i = 0; i < idata.size(); ++i) {
+    for (size_t i = 0; i < size; ++i) {
         float result = idata[i] * idata[i];
         if (result != odata[i]) {
             nerror++;
@@ -110,5 +128,5 @@ void App::host_run()
                       << ")\n";
         }
     }
-    std::cerr << "  found " << nerror << " error(s) out of " << idata.size() << "\n";
+    std::cerr << "  found " << nerror << " error(s) out of " << size << "\n";
 }
@@ -0,0 +1,75 @@
+#ifndef APP_INCLUDED_H
+#define APP_INCLUDED_H 1
+
+#include "common/app-base.hpp"
+
+// Scatter strategies, as in the other UMMA versions
+#define SCATTER_ATOMIC 0
+#define SCATTER_COLOR  1
+
+///
+// The UMMA unstructured mesh mini-app on an OpenCL device: every loop
+// gathers the points of each edge of a graph to it, computes on the edges
+// and scatters the results back to the points.  The graph and its data
+// stay on the device for all the loops, and the scatter either adds
+// atomically or runs a kernel per color of an edge coloring, no two edges
+// of a color sharing a point, without atomics.
+///
+class App : public AppBase {
+
+public:
+
+    App(int debug,
+        int profile,
+        int verbose,
+        std::vector<int> const & device_list,
+        std::string const & type,
+        std::string const & file,
+        int npoints,
+        int nedges,
+        unsigned long seed,
+        int nloops,
+        int warmup,
+        int scatter)
+        : AppBase(debug, profile, verbose),
+          device_list_m(device_list),
+          type_m(type),
+          file_m(file),
+          npoints_m(npoints),
+          nedges_m(nedges),
+          seed_m(seed),
+          nloops_m(nloops),
+          warmup_m(warmup),
+          scatter_m(scatter)
+        {
+        }
+
+    virtual void host_run();
+
+private:
+
+    virtual std::string const & get_device_program_text();
+
+    int color_edges(std::vector<int> const & v0,
+                    std::vector<int> const & v1,
+                    std::vector<int> & color_edges,
+                    std::vector<int> & color_start);
+
+    void enqueue(cl::Kernel const & kernel,
+                 int device,
+                 size_t items,
+                 size_t local);
+
+    std::vector<int> const & device_list_m;
+    std::string type_m;
+    std::string file_m;
+    int npoints_m;
+    int nedges_m;
+    unsigned long seed_m;
+    int nloops_m;
+    int warmup_m;
+    int scatter_m;
+
+};
+
+#endif
@@ -0,0 +1,135 @@
+// Device kernels...
+
+#include "umma/app.hpp"
+
+#define STRINGIFY(X) #X
+
+std::string const program_text = STRINGIFY(
+
+
+    // *p += v atomically, by swapping in the sum of the bits last read until
+    // no other work item wrote in between, as OpenCL 1.1 has no atomic add
+    // of floats
+    void atomic_add_float(volatile __global float* p, float v)
+    {
+        union { unsigned int u; float f; } old;
+        union { unsigned int u; float f; } sum;
+        do {
+            old.f = *p;
+            sum.f = old.f + v;
+        } while (atomic_cmpxchg((volatile __global unsigned int*)p,
+                                old.u, sum.u) != old.u);
+    }
+
+
+    // the points of every edge and its data, to the edge
+    __kernel void edge_gather(__global const float* pt_data,
+                              __global const float* edge_data,
+                              __global const int* v0,
+                              __global const int* v1,
+                              __global float* v0_data,
+                              __global float* v1_data,
+                              __global float* data,
+                              int const nedges)
+    {
+        int i = get_global_id(0);
+        if (i < nedges) {
+            int p0 = v0[i];
+            int p1 = v1[i];
+
+            v0_data[3*i+0] = pt_data[3*p0+0];
+            v0_data[3*i+1] = pt_data[3*p0+1];
+            v0_data[3*i+2] = pt_data[3*p0+2];
+
+            v1_data[3*i+0] = pt_data[3*p1+0];
+            v1_data[3*i+1] = pt_data[3*p1+1];
+            v1_data[3*i+2] = pt_data[3*p1+2];
+
+            data[i] = edge_data[i];
+        }
+    }
+
+
+    // the sum of the edge's points times its data, for both its points
+    __kernel void edge_compute(__global float* v0_data,
+                               __global float* v1_data,
+                               __global const float* data,
+                               int const nedges)
+    {
+        int i = get_global_id(0);
+        if (i < nedges) {
+            float x0 = (v0_data[3*i+0] + v1_data[3*i+0]) * data[i];
+            float x1 = (v0_data[3*i+1] + v1_data[3*i+1]) * data[i];
+            float x2 = (v0_data[3*i+2] + v1_data[3*i+2]) * data[i];
+
+            v0_data[3*i+0] = x0;
+            v0_data[3*i+1] = x1;
+            v0_data[3*i+2] = x2;
+
+            v1_data[3*i+0] = x0;
+            v1_data[3*i+1] = x1;
+            v1_data[3*i+2] = x2;
+        }
+    }
+
+
+    // the edges' results added to their points, atomically as points are
+    // shared
+    __kernel void edge_scatter(__global float* pt_data,
+                               __global const int* v0,
+                               __global const int* v1,
+                               __global const float* v0_data,
+                               __global const float* v1_data,
+                               int const nedges)
+    {
+        int i = get_global_id(0);
+        if (i < nedges) {
+            int p0 = v0[i];
+            int p1 = v1[i];
+
+            atomic_add_float(&pt_data[3*p0+0], v0_data[3*i+0]);
+            atomic_add_float(&pt_data[3*p0+1], v0_data[3*i+1]);
+            atomic_add_float(&pt_data[3*p0+2], v0_data[3*i+2]);
+
+            atomic_add_float(&pt_data[3*p1+0], v1_data[3*i+0]);
+            atomic_add_float(&pt_data[3*p1+1], v1_data[3*i+1]);
+            atomic_add_float(&pt_data[3*p1+2], v1_data[3*i+2]);
+        }
+    }
+
+
+    // the results of the n edges of one color, color_edges[first] on, added
+    // to their points, which no two of them share
+    __kernel void edge_scatter_color(__global float* pt_data,
+                                     __global const int* v0,
+                                     __global const int* v1,
+                                     __global const float* v0_data,
+                                     __global const float* v1_data,
+                                     __global const int* color_edges,
+                                     int const first,
+                                     int const n)
+    {
+        int k = get_global_id(0);
+        if (k < n) {
+            int i = color_edges[first + k];
+            int p0 = v0[i];
+            int p1 = v1[i];
+
+            pt_data[3*p0+0] += v0_data[3*i+0];
+            pt_data[3*p0+1] += v0_data[3*i+1];
+            pt_data[3*p0+2] += v0_data[3*i+2];
+
+            pt_data[3*p1+0] += v1_data[3*i+0];
+            pt_data[3*p1+1] += v1_data[3*i+1];
+            pt_data[3*p1+2] += v1_data[3*i+2];
+        }
+    }
+
+
+    );
+
+
+std::string const & App::get_device_program_text()
+{
+    return program_text;
+}
@@ -0,0 +1,245 @@
+// Host code...
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "umma/app.hpp"
+#include "graph.h"
+#include "bench.h"
+
+// Greedy edge coloring, as graph_color_soa in the CUDA version: lists the
+// edges color by color in color_edges, color c's from color_start[c] up to
+// color_start[c + 1], and returns the number of colors
+int App::color_edges(std::vector<int> const & v0,
+                     std::vector<int> const & v1,
+                     std::vector<int> & color_edges,
+                     std::vector<int> & color_start)
+{
+    int const nedges = v0.size();
+    std::vector<int> mark(npoints_m, -1);
+    int c;
+    int next = 0;
+
+    color_edges.resize(nedges);
+    for (int k = 0; k < nedges; ++k) {
+        color_edges[k] = k;
+    }
+    color_start.clear();
+    for (c = 0; next < nedges; ++c) {
+        color_start.push_back(next);
+        // move the edges this color can take to the front of the rest
+        for (int k = next; k < nedges; ++k) {
+            int e = color_edges[k];
+            if (mark[v0[e]] != c && mark[v1[e]] != c) {
+                mark[v0[e]] = c;
+                mark[v1[e]] = c;
+                color_edges[k] = color_edges[next];
+                color_edges[next++] = e;
+            }
+        }
+    }
+    color_start.push_back(next);
+    return c;
+}
+
+
+void App::enqueue(cl::Kernel const & kernel,
+                  int device,
+                  size_t items,
+                  size_t local)
+{
+    cl::Event event;
+    queue_m[device].enqueueNDRangeKernel(kernel,
+                                         cl::NullRange,
+                                         cl::NDRange(round_up(items, local)),
+                                         cl::NDRange(local),
+                                         NULL,
+                                         profile_m ? &event : NULL);
+    if (profile_m) {
+        profiler_m.record(kernel.getInfo<CL_KERNEL_FUNCTION_NAME>(), device,
+                          "compute", event);
+    }
+}
+
+
+void App::host_run()
+{
+    int rc;
+
+    // Create the graph
+    struct edge_list el;
+    double time0 = wall_time();
+    if (graph_create(type_m.c_str(), npoints_m, nedges_m, seed_m,
+                     file_m.c_str(), &el) < 0) {
+        printf("Error creating graph. \n");
+        exit(1);
+    }
+    npoints_m = el.npoints;
+    nedges_m = el.nedges;
+    std::vector<int> v0(el.v0, el.v0 + nedges_m);
+    std::vector<int> v1(el.v1, el.v1 + nedges_m);
+    graph_release(&el);
+    double time1 = wall_time();
+    printf("Graph: %d points, %d edges in %f s \n", npoints_m, nedges_m,
+           time1 - time0);
+
+    std::vector<int> color_list;
+    std::vector<int> color_start;
+    if (scatter_m == SCATTER_COLOR) {
+        time0 = wall_time();
+        int ncolors = color_edges(v0, v1, color_list, color_start);
+        time1 = wall_time();
+        printf("Colors: %d in %f s \n", ncolors, time1 - time0);
+    }
+
+    // The points and the edges start out uniform
+    std::vector<float> pt_data(3 * npoints_m, 1.0f);
+    std::vector<float> edge_data(nedges_m, 1.0f);
+
+    struct bench stats;
+    cody_init("umma", "opencl");
+    if (bench_init(&stats, nloops_m) < 0) {
+        printf("Error allocating timers. \n");
+        exit(1);
+    }
+
+    // Select a device
+    int device_id;
+    if (device_list_m.size()) {
+        // use first device in the device list
+        device_id = device_list_m[0];
+    } else {
+        device_id = get_most_capable_device();
+    }
+    if (verbose_m) {
+        std::cerr << "[Device selection]\n  using device[" << device_id << "]:\n";
+    }
+    cl::CommandQueue & queue = queue_m[device_id];
+
+    // Allocate device memory from the pool, the graph and its data for all
+    // the loops
+    size_t const pt_bytes = 3 * npoints_m * sizeof(float);
+    size_t const ncolor_edges = color_list.size() ? color_list.size() : 1;
+    PooledBuffer pt_buffer(pool_m, pt_bytes);
+    PooledBuffer edge_data_buffer(pool_m, nedges_m * sizeof(float), CL_MEM_READ_ONLY);
+    PooledBuffer v0_buffer(pool_m, nedges_m * sizeof(int), CL_MEM_READ_ONLY);
+    PooledBuffer v1_buffer(pool_m, nedges_m * sizeof(int), CL_MEM_READ_ONLY);
+    PooledBuffer v0_data_buffer(pool_m, 3 * nedges_m * sizeof(float));
+    PooledBuffer v1_data_buffer(pool_m, 3 * nedges_m * sizeof(float));
+    PooledBuffer data_buffer(pool_m, nedges_m * sizeof(float));
+    PooledBuffer color_buffer(pool_m, ncolor_edges * sizeof(int), CL_MEM_READ_ONLY);
+    cl::Buffer const & pt = pt_buffer.buffer();
+
+    // Upload once
+    double up0 = wall_time();
+    queue.enqueueWriteBuffer(pt, CL_FALSE, 0, pt_bytes, &pt_data[0]);
+    queue.enqueueWriteBuffer(edge_data_buffer.buffer(), CL_FALSE, 0,
+                             nedges_m * sizeof(float), &edge_data[0]);
+    queue.enqueueWriteBuffer(v0_buffer.buffer(), CL_FALSE, 0,
+                             nedges_m * sizeof(int), &v0[0]);
+    queue.enqueueWriteBuffer(v1_buffer.buffer(), CL_FALSE, 0,
+                             nedges_m * sizeof(int), &v1[0]);
+    if (color_list.size()) {
+        queue.enqueueWriteBuffer(color_buffer.buffer(), CL_FALSE, 0,
+                                 nedges_m * sizeof(int), &color_list[0]);
+    }
+    queue.finish();
+    double up1 = wall_time();
+
+    // Create kernels
+    cl::Kernel gather(program_m, "edge_gather", &rc);
+    rc = gather.setArg(0, pt);
+    rc = gather.setArg(1, edge_data_buffer.buffer());
+    rc = gather.setArg(2, v0_buffer.buffer());
+    rc = gather.setArg(3, v1_buffer.buffer());
+    rc = gather.setArg(4, v0_data_buffer.buffer());
+    rc = gather.setArg(5, v1_data_buffer.buffer());
+    rc = gather.setArg(6, data_buffer.buffer());
+    rc = gather.setArg(7, (cl_int)nedges_m);
+
+    cl::Kernel compute(program_m, "edge_compute", &rc);
+    rc = compute.setArg(0, v0_data_buffer.buffer());
+    rc = compute.setArg(1, v1_data_buffer.buffer());
+    rc = compute.setArg(2, data_buffer.buffer());
+    rc = compute.setArg(3, (cl_int)nedges_m);
+
+    cl::Kernel scatter;
+    if (scatter_m == SCATTER_COLOR) {
+        scatter = cl::Kernel(program_m, "edge_scatter_color", &rc);
+        rc = scatter.setArg(5, color_buffer.buffer());
+        rc = scatter.setArg(6, (cl_int)0);
+        rc = scatter.setArg(7, (cl_int)nedges_m);
+    } else {
+        scatter = cl::Kernel(program_m, "edge_scatter", &rc);
+        rc = scatter.setArg(5, (cl_int)nedges_m);
+    }
+    rc = scatter.setArg(0, pt);
+    rc = scatter.setArg(1, v0_buffer.buffer());
+    rc = scatter.setArg(2, v1_buffer.buffer());
+    rc = scatter.setArg(3, v0_data_buffer.buffer());
+    rc = scatter.setArg(4, v1_data_buffer.buffer());
+
+    // Work group sizes, the color scatter's tuned over all the edges at
+    // once. Tuning runs the kernels, so the points are reset below
+    size_t const gather_local = tune_work_group_size(gather, device_id, nedges_m);
+    size_t const compute_local = tune_work_group_size(compute, device_id, nedges_m);
+    size_t const scatter_local = tune_work_group_size(scatter, device_id, nedges_m);
+    if (verbose_m) {
+        std::cerr << "  work group sizes = " << gather_local << " "
+                  << compute_local << " " << scatter_local << "\n";
+    }
+
+    // Loop, launches only, after the warm-up loops. The phases wait for
+    // their kernels to be timed
+    for (int i = -warmup_m; i < nloops_m; i++) {
+        if (i == 0) {
+            // the device's points are reset after the warm-up and the
+            // tuning, as the host's are still the initial ones
+            queue.enqueueWriteBuffer(pt, CL_TRUE, 0, pt_bytes, &pt_data[0]);
+            time0 = wall_time();
+        }
+        bench_loop(&stats, i);
+        enqueue(gather, device_id, nedges_m, gather_local);
+        queue.finish();
+        bench_phase(&stats, PHASE_GATHER);
+        enqueue(compute, device_id, nedges_m, compute_local);
+        queue.finish();
+        bench_phase(&stats, PHASE_COMPUTE);
+        if (scatter_m == SCATTER_COLOR) {
+            for (size_t c = 0; c + 1 < color_start.size(); ++c) {
+                int n = color_start[c + 1] - color_start[c];
+                rc = scatter.setArg(6, (cl_int)color_start[c]);
+                rc = scatter.setArg(7, (cl_int)n);
+                enqueue(scatter, device_id, n, scatter_local);
+            }
+        } else {
+            enqueue(scatter, device_id, nedges_m, scatter_local);
+        }
+        queue.finish();
+        bench_phase(&stats, PHASE_SCATTER);
+    }
+    time1 = wall_time();
+
+    // Download once
+    double down0 = wall_time();
+    queue.enqueueReadBuffer(pt, CL_TRUE, 0, pt_bytes, &pt_data[0]);
+    double down1 = wall_time();
+
+    for (int i = 0; i < 10 && i < npoints_m; i++) {
+        printf("%i : %f %f %f \n", i, pt_data[3*i+0], pt_data[3*i+1],
+               pt_data[3*i+2]);
+    }
+    printf("Time: %f s \n", (time1 - time0) / nloops_m);
+    printf("Upload: %f s \n", up1 - up0);
+    printf("Download: %f s \n", down1 - down0);
+    bench_report(&stats, npoints_m, nedges_m);
+    bench_free(&stats);
+
+    if (profile_m) {
+        profiler_m.report(std::cerr);
+        if (profiler_m.write_trace("umma-trace.json")) {
+            std::cerr << "  timeline written to umma-trace.json\n";
+        }
+    }
+    cody_finish();
+}
@@ -0,0 +1,229 @@
+///
+// A generic main program for an OpenCL mini-app
+///
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <getopt.h>
+
+#include "app.hpp"
+#include "graph.h"
+
+void usage(const char *name)
+{
+    std::cerr << "Usage: " << name << "[options] [args]\n"
+              << "       " << name << "-h | --help\n";
+    exit(1);
+}
+
+
+void help(const char *name)
+{
+    std::cout << "Usage: " << name << "[options]\n"
+              << "\n"
+              << "Options:\n"
+              << "  -h | --help         print help (this message)\n"
+              << "  -D | --device-list  comma-separated list of devices to use\n"
+              << "  -d | --debug        enable debugging\n"
+              << "  -p | --profile      enable profiling\n"
+              << "  -v | --verbose      verbose output\n"
+              << "  -t | --type         graph type, pure_random, regular_random,\n"
+              << "                      contiguous or file (default pure_random)\n"
+              << "  -f | --file         file from which to read the graph\n"
+              << "  -n | --npoints      points of the generated graph (default 10000)\n"
+              << "  -e | --nedges       edges, or edges per point for regular_random\n"
+              << "                      (default 10000)\n"
+              << "  -S | --seed         seed of the random graphs (default 17)\n"
+              << "  -l | --nloops       timed loops (default 10)\n"
+              << "  -w | --warmup       untimed loops first, their results reset\n"
+              << "                      (default 1)\n"
+              << "  -s | --scatter      scatter strategy, atomic or color\n"
+              << "                      (default atomic)\n"
+              << "\n";
+    exit(0);
+}
+
+
+int csv_to_list(const char *string, std::vector<int> & list)
+{
+    std::string sep(",");
+    std::string s(string);
+    size_t start = 0;
+    size_t end = 0;
+
+    do {
+        int val;
+        end = s.find(sep, start);
+        if (!(std::istringstream(s.substr(start, end - start)) >> val)) {
+            return -1;
+        }
+        list.push_back(val);
+        start = end + sep.size();
+    } while (end != std::string::npos);
+    return 0;
+}
+
+
+int main (int argc, char *argv[])
+{
+    // default options
+    int debug = 0;
+    int profile = 0;
+    int verbose = 0;
+    std::vector<int> device_list;
+    std::string type = "pure_random";
+    std::string file = "";
+    int npoints = 10000;
+    int nedges = 10000;
+    unsigned long seed = GRAPH_SEED;
+    int nloops = 10;
+    int warmup = 1;
+    int scatter = SCATTER_ATOMIC;
+
+    // process options
+    while (1) {
+        static struct option long_options[] = {
+            {"help", no_argument, NULL, 'h'},
+            {"debug", no_argument, NULL, 'd'},
+            {"profile", no_argument, NULL, 'p'},
+            {"verbose", no_argument, NULL, 'v'},
+            {"device-list", required_argument, NULL, 'D'},
+            {"type", required_argument, NULL, 't'},
+            {"file", required_argument, NULL, 'f'},
+            {"npoints", required_argument, NULL, 'n'},
+            {"nedges", required_argument, NULL, 'e'},
+            {"seed", required_argument, NULL, 'S'},
+            {"nloops", required_argument, NULL, 'l'},
+            {"warmup", required_argument, NULL, 'w'},
+            {"scatter", required_argument, NULL, 's'},
+            {NULL, 0, NULL, 0}
+        };
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "dhpvD:t:f:n:e:S:l:w:s:", long_options, &option_index);
+        if (c == -1) {
+            break;
+        } else if (c == '?') {
+            usage(argv[0]);
+            return 1;
+        } else if ('h' == c) {
+            help(argv[0]);
+            return 0;
+        } else if ('d' == c) {
+            debug = 1;
+        } else if ('p' == c) {
+            profile = 1;
+        } else if ('v' == c) {
+            verbose = 1;
+        } else if ('D' == c) {
+            if (csv_to_list(optarg, device_list) < 0) {
+                fprintf(stderr, "Invalid device list: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('t' == c) {
+            type = optarg;
+        } else if ('f' == c) {
+            file = optarg;
+        } else if ('n' == c) {
+            npoints = atoi(optarg);
+            if (npoints < 2) {
+                fprintf(stderr, "Invalid number of points: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('e' == c) {
+            nedges = atoi(optarg);
+            if (nedges < 1) {
+                fprintf(stderr, "Invalid number of edges: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('S' == c) {
+            seed = strtoul(optarg, NULL, 10);
+        } else if ('l' == c) {
+            nloops = atoi(optarg);
+            if (nloops < 1) {
+                fprintf(stderr, "Invalid number of loops: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('w' == c) {
+            warmup = atoi(optarg);
+            if (warmup < 0) {
+                fprintf(stderr, "Invalid number of warm-up loops: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else if ('s' == c) {
+            if (strcmp(optarg, "atomic") == 0) {
+                scatter = SCATTER_ATOMIC;
+            } else if (strcmp(optarg, "color") == 0) {
+                scatter = SCATTER_COLOR;
+            } else {
+                fprintf(stderr, "Invalid scatter strategy: %s\n", optarg);
+                usage(argv[0]);
+                return 1;
+            }
+        } else {
+            return 1;
+        }
+    }
+    if (debug) {
+        std::cerr << "[Options]\n"
+                  << "  debug = " << debug << "\n"
+                  << "  profile = " << profile << "\n"
+                  << "  verbose = " << verbose << "\n"
+                  << "  type = " << type << "\n"
+                  << "  file = " << file << "\n"
+                  << "  npoints = " << npoints << "\n"
+                  << "  nedges = " << nedges << "\n"
+                  << "  seed = " << seed << "\n"
+                  << "  nloops = " << nloops << "\n"
+                  << "  warmup = " << warmup << "\n"
+                  << "  scatter = " << (scatter == SCATTER_COLOR ? "color" : "atomic") << "\n"
+                  << "  device list = ";
+        for (size_t i = 0; i < device_list.size(); ++i) {
+            std::cerr << " " << device_list[i];
+        }
+        std::cerr << "\n";
+        if (optind < argc) {
+            std::cerr << "Non-option arguments: ";
+            while (optind < argc) {
+                std::cerr << argv[optind++];
+            }
+            std::cerr << "\n";
+        }
+    }
+
+    // start work
+    try {
+        App app(debug,
+                profile,
+                verbose,
+                device_list,
+                type,
+                file,
+                npoints,
+                nedges,
+                seed,
+                nloops,
+                warmup,
+                scatter);
+		app.build_program();
+        app.host_run();
+        
+    }
+    catch (cl::Error const & e) {
+        std::cerr << "ERROR: OpenCL: "
+                  << e.what()
+                  << "("
+                  << App::opencl_error_string(e.err())
+                  << ")\n";
+        return 1;
+    }
+
+    return 0;
+}
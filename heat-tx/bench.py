@@ -0,0 +1,161 @@
+#!/usr/bin/python
+
+import argparse
+import csv
+import json
+import os
+import subprocess
+import sys
+import tempfile
+
+# Benchmark harness for the heat-tx implementations. Every implementation is
+# run with the same mesh size, steps and thread count in a scratch directory.
+# The rate line each one prints and its peak RSS are collected into one CSV
+# and/or JSON file. The heat-img.dat of every implementation is then checked
+# against the first one's.
+
+# Executable of each implementation, relative to heat-tx
+IMPLS={
+	'c':    'c/heat-tx',
+	'c-simd':   'c/heat-tx',
+	'c-stream': 'c/heat-tx',
+	'ispc': 'ispc/heat-tx',
+	'go':   'go/heat-tx',
+	'd':    'd/heattx',
+}
+
+# Options of the implementations that are one executable run another way:
+# the C one's vector row kernels, the streaming one on the plain loop
+ARGS={
+	'c-simd':   ['-K','simd'],
+	'c-stream': ['-b','0','-K','stream'],
+}
+
+FIELDS=['impl','n','steps','nth','rep','secs','mups','gbs','maxrss','maxdiff']
+
+# What runs when neither the config nor the command line says
+DEFAULTS={'impls':['c','ispc','go','d'],'n':[512],'steps':1024,'threads':[1],'reps':1}
+
+def csvList(s):
+	return [v for v in s.split(',') if v]
+
+def intList(s):
+	return [int(v) for v in csvList(s)]
+
+# The row after the n/steps/seconds/Mupdates/s/GB/s header
+def parseRun(out):
+	lines=out.splitlines()
+	for k,line in enumerate(lines[:-1]):
+		if 'Mupdates/s' in line.split():
+			row=lines[k+1].split()
+			return {'secs':float(row[2]),'mups':float(row[3]),'gbs':float(row[4])}
+	return None
+
+# The largest difference between two heat-img.dat files, None if their shapes
+# differ
+def maxDiff(a, b):
+	diff=0.0
+	with open(a) as fa, open(b) as fb:
+		for la,lb in zip(fa,fb):
+			va=la.split()
+			vb=lb.split()
+			if len(va)!=len(vb):
+				return None
+			for x,y in zip(va,vb):
+				diff=max(diff,abs(float(x)-float(y)))
+		if fa.readline() or fb.readline():
+			return None
+	return diff
+
+# Run one implementation in wd and return its record, its peak RSS from
+# wait4 in kB
+def runOne(args, impl, n, steps, nth, wd):
+	exe=os.path.join(args.root,IMPLS[impl])
+	cmd=[exe,'-n',str(n),'-s',str(steps),'-p',str(nth)]+ARGS.get(impl,[])
+	env=dict(os.environ)
+	env['OMP_NUM_THREADS']=str(nth)
+	try:
+		p=subprocess.Popen(cmd,cwd=wd,env=env,stdout=subprocess.PIPE,stderr=subprocess.STDOUT,universal_newlines=True)
+	except OSError as e:
+		sys.stderr.write('FAILED: %s: %s\n'%(' '.join(cmd),e))
+		return None
+	out=p.stdout.read()
+	p.stdout.close()
+	pid,status,ru=os.wait4(p.pid,0)
+	rec=parseRun(out)
+	if status!=0 or rec is None:
+		sys.stderr.write('FAILED: %s\n'%' '.join(cmd))
+		return None
+	rec['maxrss']=ru.ru_maxrss
+	return rec
+
+def main():
+	parser=argparse.ArgumentParser(description='Run the heat-tx implementations on the same configs and check their outputs agree')
+	parser.add_argument('--config',help='JSON file with impls, n, steps, threads and reps, e.g. bench.json')
+	parser.add_argument('-i','--impl',help='implementations: '+','.join(sorted(IMPLS)))
+	parser.add_argument('-n','--size',help='mesh sizes')
+	parser.add_argument('-s','--steps',type=int,help='time steps')
+	parser.add_argument('-t','--threads',help='thread counts')
+	parser.add_argument('--reps',type=int,help='repetitions of each run')
+	parser.add_argument('--tol',type=float,default=2e-6,help='largest difference from the first implementation\'s heat-img.dat')
+	parser.add_argument('--root',default=os.path.dirname(os.path.abspath(__file__)),help='heat-tx directory')
+	parser.add_argument('--csv',help='CSV file to write')
+	parser.add_argument('--json',help='JSON file to write')
+	args=parser.parse_args()
+
+	# The command line wins over the config, which wins over the defaults
+	cfg=dict(DEFAULTS)
+	if args.config:
+		with open(args.config) as f:
+			cfg.update(json.load(f))
+	if args.impl: cfg['impls']=csvList(args.impl)
+	if args.size: cfg['n']=intList(args.size)
+	if args.steps is not None: cfg['steps']=args.steps
+	if args.threads: cfg['threads']=intList(args.threads)
+	if args.reps is not None: cfg['reps']=args.reps
+	for impl in cfg['impls']:
+		if impl not in IMPLS:
+			parser.error('unknown implementation '+impl)
+
+	recs=[]
+	bad=0
+	print(','.join(FIELDS))
+	for n in cfg['n']:
+		for nth in cfg['threads']:
+			for rep in range(cfg['reps']):
+				with tempfile.TemporaryDirectory() as wd:
+					ref=None
+					for impl in cfg['impls']:
+						rd=os.path.join(wd,impl)
+						os.mkdir(rd)
+						rec=runOne(args,impl,n,cfg['steps'],nth,rd)
+						if rec is None:
+							bad+=1
+							continue
+						rec.update(impl=impl,n=n,steps=cfg['steps'],nth=nth,rep=rep)
+						img=os.path.join(rd,'heat-img.dat')
+						if ref is None:
+							ref=img
+							rec['maxdiff']=0.0
+						else:
+							rec['maxdiff']=maxDiff(ref,img)
+							if rec['maxdiff'] is None or rec['maxdiff']>args.tol:
+								sys.stderr.write('MISMATCH: %s n=%d differs from %s by %s\n'%(impl,n,os.path.basename(os.path.dirname(ref)),rec['maxdiff']))
+								bad+=1
+						recs.append(rec)
+						print(','.join(str(rec.get(f,'')) for f in FIELDS))
+						sys.stdout.flush()
+
+	if args.csv:
+		with open(args.csv,'w') as f:
+			w=csv.DictWriter(f,fieldnames=FIELDS,extrasaction='ignore')
+			w.writeheader()
+			for rec in recs:
+				w.writerow(rec)
+	if args.json:
+		with open(args.json,'w') as f:
+			json.dump({'config':cfg,'runs':recs},f,indent=1)
+	return 1 if bad else 0
+
+if __name__=='__main__':
+	sys.exit(main())
@@ -63,394 +63,566 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <inttypes.h>
-#include <math.h>
-
-/* return codes */
-enum {
-    SUCCESS = 0,
-    FAILURE,
-    FAILURE_OOR,
-    FAILURE_IO,
-    FAILURE_INVALID_ARG
-};
+#include <pthread.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "heattx.h"
+#include "cody.h"
 
 static char *app_name = "c-heat-tx";
 static char *app_ver = "0.2";
 
-/* max simulation time */
+/* default max simulation time */
 #define T_MAX 1024
-/* nx and ny */
+/* default nx and ny */
 #define N 512
-/* thermal conductivity */
+/* default thermal conductivity */
 #define THERM_COND 0.6
-/* some constant */
-#define K 0.4
-
-typedef struct mesh_t {
-    /* mesh size in x and y */
-    uint64_t nx, ny; 
-    /* mesh cells */
-    double **cells;
-} mesh_t;
-
-/* simulation parameters */
-typedef struct simulation_params_t {
-    /* thermal conductivity */
-    double c;
-    double delta_s;
-    /* time interval */
-    double delta_t;
-    /* max simulation time */
-    uint64_t max_t;
-} simulation_params_t;
-
-typedef struct simulation_t {
-    /* the meshes */
-    mesh_t *old_mesh, *new_mesh;
-    /* simulation parameters */
-    simulation_params_t *params;
-} simulation_t;
-
-/* static forward declarations */
-static int
-mesh_construct(mesh_t **new_mesh,
-               int x /* number of rows */,
-               int y /* number of columns */);
-
-static int
-mesh_destruct(mesh_t *mesh);
-
-static int
-params_construct(simulation_params_t **params);
-
-static int
-params_destruct(simulation_params_t *params);
-
-static int
-set_initial_conds(mesh_t *sim);
+/* default steps between steady state checks */
+#define CHECK_EVERY 100
+
+/* the benchmark runs n = BENCH_N_MIN, 2 * BENCH_N_MIN, ... up to its
+ * largest size, BENCH_N_MAX unless given */
+#define BENCH_N_MIN 64
+#define BENCH_N_MAX 8192
+/* the largest for a 3-D mesh, whose two meshes then take 2 GB */
+#define BENCH_N_MAX_3D 512
+/* cell updates per benchmark size when its steps are not given, but never
+ * fewer than BENCH_MIN_STEPS steps */
+#define BENCH_UPDATES (1ULL << 30)
+#define BENCH_MIN_STEPS 10
+
+static const char *dump_ext[] = {"dat", "raw", "npy"};
+static const char *prec_name[] = {"double", "float", "mixed"};
+static const char *kernel_type[] = {"scalar", "simd", "stream", "auto"};
+
+/* a copy of the mesh being written by a background thread */
+typedef struct snapshot_t {
+    mesh_t *mesh;
+    char path[64];
+    int format;
+    /* whether thread is writing, and how that went */
+    bool busy;
+    int rc;
+    pthread_t thread;
+} snapshot_t;
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* heat-tx has always dumped new_mesh, which holds the odd steps */
 static int
-sim_param_cp(const simulation_params_t *from,
-             simulation_params_t *to)
+dump(const simulation_t *sim, int format)
 {
-    if (!from || !to) return FAILURE_INVALID_ARG;
-    (void)memcpy(to, from, sizeof(*from));
-    return SUCCESS;
+    char path[64];
+
+    snprintf(path, sizeof(path), "heat-img.%s", dump_ext[format]);
+    return mesh_write(sim->new_mesh, path, format);
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
-params_construct(simulation_params_t **params)
+snapshot_construct(snapshot_t **new_snap,
+                   uint64_t nx,
+                   uint64_t ny,
+                   uint64_t nz,
+                   int type,
+                   int format)
 {
-    simulation_params_t *tmp = NULL;
-    if (!params) return FAILURE_INVALID_ARG;
-    if (NULL == (tmp = calloc(1, sizeof(*tmp)))) {
+    snapshot_t *snap = NULL;
+    int rc = FAILURE;
+
+    if (NULL == new_snap) return FAILURE_INVALID_ARG;
+    if (NULL == (snap = calloc(1, sizeof(*snap)))) {
         fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
         return FAILURE_OOR;
     }
-    *params = tmp;
+    if (SUCCESS != (rc = mesh_construct_3d(&snap->mesh, nx, ny, nz, type))) {
+        free(snap);
+        return rc;
+    }
+    snap->format = format;
+    *new_snap = snap;
     return SUCCESS;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
-params_destruct(simulation_params_t *params)
+static void *
+snapshot_write(void *arg)
 {
-    if (!params) return FAILURE_INVALID_ARG;
-    free(params);
-    return SUCCESS;
+    snapshot_t *snap = (snapshot_t *)arg;
+
+    snap->rc = mesh_write(snap->mesh, snap->path, snap->format);
+    return NULL;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* wait for the snapshot being written, if any */
 static int
-mesh_construct(mesh_t **new_mesh,
-               int x /* number of rows */,
-               int y /* number of columns */)
+snapshot_wait(snapshot_t *snap)
 {
-    mesh_t *tmp_mesh = NULL;
-    int i;
+    if (NULL == snap || !snap->busy) return SUCCESS;
+    (void)pthread_join(snap->thread, NULL);
+    snap->busy = false;
+    return snap->rc;
+}
 
-    if (NULL == new_mesh) return FAILURE_INVALID_ARG;
+/* ////////////////////////////////////////////////////////////////////////// */
+/* copy mesh, the state after step t, and write it to heat-img-<t> in the
+ * background while the simulation goes on */
+static int
+snapshot_take(snapshot_t *snap, const mesh_t *mesh, uint64_t t)
+{
+    int rc = FAILURE;
 
-    tmp_mesh = (mesh_t *)calloc(1, sizeof(*tmp_mesh));
-    if (NULL == tmp_mesh) {
-        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-        /* just bail */
-        return FAILURE_OOR;
-    }
-    tmp_mesh->cells = (double **)calloc(x, sizeof(double *));
-    if (NULL == tmp_mesh->cells) {
-        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-        goto error;
-    }
-    for (i = 0; i < y; ++i) {
-        tmp_mesh->cells[i] = (double *)calloc(y, sizeof(double));
-        if (NULL == tmp_mesh->cells[i]) {
-            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-            goto error;
-        }
+    if (SUCCESS != (rc = snapshot_wait(snap))) return rc;
+    if (SUCCESS != (rc = mesh_copy(snap->mesh, mesh))) return rc;
+    snprintf(snap->path, sizeof(snap->path), "heat-img-%06"PRIu64".%s", t,
+             dump_ext[snap->format]);
+    if (0 != pthread_create(&snap->thread, NULL, snapshot_write, snap)) {
+        /* write it here then */
+        return mesh_write(snap->mesh, snap->path, snap->format);
     }
-    tmp_mesh->nx = x;
-    tmp_mesh->ny = y;
-
-    *new_mesh = tmp_mesh;
+    snap->busy = true;
     return SUCCESS;
-
-error:
-    if (NULL != tmp_mesh) free(tmp_mesh);
-    mesh_destruct(tmp_mesh);
-    return FAILURE_OOR;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
-mesh_destruct(mesh_t *mesh)
+snapshot_destruct(snapshot_t *snap)
 {
-    uint64_t i;
-
-    if (!mesh) return FAILURE_INVALID_ARG;
-    if (mesh->cells) {
-        for (i = 0; i < mesh->ny; ++i) {
-            if (NULL != mesh->cells[i]) {
-                free(mesh->cells[i]);
-                mesh->cells[i] = NULL;
-            }
-        }
-        free(mesh->cells);
-        mesh->cells = NULL;
-    }
-    free(mesh);
+    if (!snap) return FAILURE_INVALID_ARG;
+    (void)snapshot_wait(snap);
+    (void)mesh_destruct(snap->mesh);
+    free(snap);
     return SUCCESS;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
-gen_meshes(simulation_t *sim, uint64_t nx, uint64_t ny)
+/* steps from t to the next multiple of every, or forever if every is 0 */
+static uint64_t
+steps_to(uint64_t t, uint64_t every)
 {
-    int rc = FAILURE;
-
-    if (SUCCESS != (rc = mesh_construct(&sim->old_mesh, nx, ny))) {
-        fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
-                __LINE__);
-        goto out;
-    }
-    if (SUCCESS != (rc = mesh_construct(&sim->new_mesh, nx, ny))) {
-        fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
-                __LINE__);
-        goto out;
-    }
-out:
-    if (SUCCESS != rc) {
-        mesh_destruct(sim->new_mesh);
-        mesh_destruct(sim->old_mesh);
-    }
-    return rc;
+    return (0 == every) ? UINT64_MAX : every - t % every;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* step ref, a double precision copy of sim, up to sim and report how far
+ * apart they are */
 static int
-simulation_destruct(simulation_t *sim)
+check_error(simulation_t *sim, simulation_t *ref, double *max_err)
 {
-    if (!sim) return FAILURE_INVALID_ARG;
-    (void)params_destruct(sim->params);
-    (void)mesh_destruct(sim->new_mesh);
-    (void)mesh_destruct(sim->old_mesh);
-    free(sim);
+    int rc = FAILURE;
+    double err;
+
+    if (SUCCESS != (rc = simulation_step(ref, sim->t - ref->t)) ||
+        SUCCESS != (rc = mesh_max_diff(simulation_mesh(sim),
+                                       simulation_mesh(ref), &err))) {
+        return rc;
+    }
+    printf(". iteration %"PRIu64": max error %le against double\n", sim->t,
+           err);
+    if (err > *max_err) *max_err = err;
     return SUCCESS;
 }
+
 /* ////////////////////////////////////////////////////////////////////////// */
+/* run sim's max_t steps, or until it converges, and time them, handing the
+ * mesh to snap every snap_every steps if that is not 0. Every check_every
+ * steps, if ref is given, bring it up to sim and keep the largest error in
+ * max_err; that is not timed */
 static int
-simulation_construct(simulation_t **new_sim,
-               const simulation_params_t *params)
+run_timed(simulation_t *sim, snapshot_t *snap, uint64_t snap_every,
+          simulation_t *ref, uint64_t check_every, double *max_err,
+          double *secs)
 {
-    simulation_t *sim = NULL;
-    int rc = FAILURE;
-
-    if (!new_sim || !params) return FAILURE_INVALID_ARG;
-
-    if (NULL == (sim = (simulation_t *)calloc(1, sizeof(*sim)))) {
-        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-        return FAILURE_OOR;
-    }
-    if (SUCCESS != (rc = params_construct(&sim->params))) {
-        fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
-                __LINE__, rc);
-        goto out;
-    }
-    if (SUCCESS != (rc = sim_param_cp(params, sim->params))) {
-        fprintf(stderr, "sim_param_cp failure @ %s:%d: rc = %d\n", __FILE__,
-                __LINE__, rc);
-        goto out;
-    }
-    if (SUCCESS != (rc = gen_meshes(sim, N, N))) {
-        fprintf(stderr, "gen_meshes failure @ %s:%d: rc = %d\n", __FILE__,
-                __LINE__, rc);
-        /* on failure, gen_meshes cleans up after itself */
-        goto out;
+    int rc = SUCCESS;
+    uint64_t nb;
+    double start = cody_now(), ref_secs = 0.0, ref_start;
+
+    while (SUCCESS == rc && !sim->converged && sim->t < sim->params->max_t) {
+        nb = sim->params->max_t - sim->t;
+        if (nb > steps_to(sim->t, snap_every)) {
+            nb = steps_to(sim->t, snap_every);
+        }
+        if (NULL != ref && nb > steps_to(sim->t, check_every)) {
+            nb = steps_to(sim->t, check_every);
+        }
+        cody_begin("step");
+        rc = simulation_step(sim, nb);
+        cody_end();
+        if (SUCCESS == rc && NULL != snap && 0 == sim->t % snap_every &&
+            !sim->converged) {
+            cody_begin("snapshot");
+            rc = snapshot_take(snap, simulation_mesh(sim), sim->t);
+            cody_end();
+        }
+        if (SUCCESS == rc && NULL != ref &&
+            (0 == sim->t % check_every || sim->converged ||
+             sim->t == sim->params->max_t)) {
+            ref_start = cody_now();
+            cody_begin("check");
+            rc = check_error(sim, ref, max_err);
+            cody_end();
+            ref_secs += cody_now() - ref_start;
+        }
     }
-    *new_sim = sim;
-out:
+    if (SUCCESS == rc) rc = snapshot_wait(snap);
+    *secs = cody_now() - start - ref_secs;
     return rc;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* run sim's steps with the row kernel of type, see simulation_kernel, and
+ * put its name in name */
 static int
-init_params(simulation_params_t *params,
-            int n,
-            double c,
-            int max_t)
+set_kernel(simulation_t *sim, int type, const char **name)
 {
-    if (NULL == params) return FAILURE_INVALID_ARG;
+    rows_kernel_t kernel = simulation_kernel(sim, type, name);
 
-    printf("o initializing simulation parameters...\n");
-
-    params->c = c;
-    params->max_t = max_t;
-    params->delta_s = 1.0 / (double)(n + 1);
-    /* we know from theory that we have to obey the restriction:
-     * delta_t <= (delta_s)^2/2c. so just make them equal.
-     */
-    params->delta_t = pow(params->delta_s, 2.0) / (4.0 * params->c);
-
-    printf(". max_t: %"PRIu64"\n", params->max_t);
-    printf(". c: %lf\n", params->c);
-    printf(". delta_s: %lf\n", params->delta_s);
-    printf(". delta_t: %lf\n\n", params->delta_t);
-
-    return SUCCESS;
+    if (NULL == kernel) {
+        fprintf(stderr, "the %s kernel needs a 2-D double precision mesh\n",
+                kernel_type[type]);
+        return FAILURE_INVALID_ARG;
+    }
+    return simulation_set_kernel(sim, kernel);
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-static int
-dump(const simulation_t *sim)
+static void
+report_header(void)
 {
-    FILE *imgfp = NULL;
-    uint64_t i, j;
+    printf("%10s %10s %12s %14s %10s  %s\n", "n", "steps", "seconds",
+           "Mupdates/s", "GB/s", "kernel");
+}
 
-    if (NULL == (imgfp = fopen("heat-img.dat", "wb"))) {
-        fprintf(stderr, "fopen failure @ %s:%d\n", __FILE__, __LINE__);
-        return FAILURE_IO;
-    }
-    /* write the matrix */
-    for (i = 0; i < sim->new_mesh->nx; ++i) {
-        for (j = 0; j < sim->new_mesh->ny; ++j) {
-            fprintf(imgfp, "%lf%s", sim->new_mesh->cells[i][j],
-                    (j == sim->new_mesh->ny - 1) ? "" : " ");
-        }
-        fprintf(imgfp, "\n");
-    }
-    fflush(imgfp);
-    fclose(imgfp);
-    return SUCCESS;
+/* ////////////////////////////////////////////////////////////////////////// */
+/* cell updates per second of steps steps and the memory bandwidth they imply
+ * if every update reads its old cell and writes its new one once, and the
+ * row kernel that ran them, also handed to cody by mesh size with the
+ * updates as the work of the region that timed them */
+static void
+report_rate(const simulation_params_t *params, uint64_t steps, double secs,
+            const char *kernel, const char *region)
+{
+    double side = (double)(params->n - 2);
+    double updates = side * side * ((3 == params->dims) ? side : 1.0) *
+                     (double)steps;
+    size_t size = (PREC_DOUBLE == params->precision) ? sizeof(double)
+                                                     : sizeof(float);
+    char name[64];
+
+    printf("%10"PRIu64" %10"PRIu64" %12.4lf %14.2lf %10.2lf  %s\n",
+           params->n, steps, secs, updates / secs * 1e-6,
+           updates * 2.0 * size / secs * 1e-9, kernel);
+    snprintf(name, sizeof(name), "updates n=%"PRIu64, params->n);
+    cody_metric(name, updates / secs * 1e-6, "Mupdates/s");
+    snprintf(name, sizeof(name), "bandwidth n=%"PRIu64, params->n);
+    cody_metric(name, updates * 2.0 * size / secs * 1e-9, "GB/s");
+    cody_work(region, updates * 1e-6, "Mupdates");
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* run every benchmark size up to base->n, each for max_t steps or, if that
+ * is 0, for about BENCH_UPDATES cell updates, with the row kernel of type,
+ * in base->dims dimensions */
 static int
-run_simulation(simulation_t *sim)
+benchmark(const simulation_params_t *base,
+          uint64_t max_t,
+          int type)
 {
     int rc = FAILURE;
-    uint64_t t, i, j;
-    uint64_t nx = sim->old_mesh->nx;
-    uint64_t ny = sim->old_mesh->ny;
-    double ds2 = sim->params->delta_s * sim->params->delta_s;
-    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
-    uint64_t t_max = sim->params->max_t;
-    mesh_t *new_mesh = sim->new_mesh;
-    mesh_t *old_mesh = sim->old_mesh;
-    double *nci, *oci, *ocip, *ocin;
-
-    printf("o starting simulation...\n");
-    for (t = 0; t < t_max; ++t) {
-        if (0 == t % 100) {
-            printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t, t_max); 
+    uint64_t n, steps;
+    bool last = false;
+    simulation_params_t params;
+    simulation_t *sim = NULL;
+    const char *kernel = NULL;
+    char name[32];
+    double secs;
+
+    report_header();
+    for (n = BENCH_N_MIN; !last; n *= 2) {
+        if (n >= base->n) {
+            n = base->n;
+            last = true;
         }
-        for (i = 1; i < nx - 1; ++i) {
-            nci =  new_mesh->cells[i];
-            oci =  old_mesh->cells[i];
-            ocip = old_mesh->cells[i - 1];
-            ocin = old_mesh->cells[i + 1];
-            for (j = 1; j < ny - 1; ++j) {
-                nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
-                                   oci[j] + oci[j + 1] + oci[j - 1]));
-            }
+        steps = max_t ? max_t : BENCH_UPDATES /
+                                (n * n * ((3 == base->dims) ? n : 1));
+        if (steps < BENCH_MIN_STEPS) steps = BENCH_MIN_STEPS;
+        (void)init_params(&params, n, base->c, steps, base->t_block,
+                          base->row_block, false);
+        (void)params_set_dims(&params, base->dims);
+        params.precision = base->precision;
+        if (SUCCESS != (rc = simulation_construct(&sim, &params))) {
+            fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
+                    __FILE__, __LINE__, rc);
+            return rc;
+        }
+        if (SUCCESS != (rc = set_kernel(sim, type, &kernel))) {
+            (void)simulation_destruct(sim);
+            return rc;
         }
-        /* swap the mesh pointers */
-        mesh_t *tmp_meshp = old_mesh; old_mesh = new_mesh; new_mesh = tmp_meshp;
-        /* constant heat source */
-        if (SUCCESS != (rc = set_initial_conds(old_mesh))) return rc;
+        snprintf(name, sizeof(name), "n=%"PRIu64, n);
+        cody_begin(name);
+        rc = run_timed(sim, NULL, 0, NULL, 0, NULL, &secs);
+        cody_end();
+        if (SUCCESS != rc) {
+            fprintf(stderr, "benchmark failure @ %s:%d: rc = %d\n",
+                    __FILE__, __LINE__, rc);
+            (void)simulation_destruct(sim);
+            return rc;
+        }
+        report_rate(&params, sim->t, secs, kernel, name);
+        (void)simulation_destruct(sim);
+        sim = NULL;
     }
     return SUCCESS;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+usage(void)
+{
+    printf("usage: heat-tx [-n N] [-s STEPS] [-c COND] [-p THREADS] "
+           "[-b T_BLOCK] [-r ROW_BLOCK]\n"
+           "               [-f dat|raw|npy] [-k STEPS] [-e TOL] [-i STEPS] "
+           "[-I X]\n"
+           "               [-P double|float|mixed] [-E STEPS] "
+           "[-K scalar|simd|stream|auto] [-D 2|3] [-B]\n"
+           "  -n  mesh cells in x and y (default %d)\n"
+           "  -s  time steps (default %d)\n"
+           "  -c  thermal conductivity (default %lf)\n"
+           "  -p  threads (default OMP_NUM_THREADS)\n"
+           "  -b  steps per tile, 0 for the plain loop (default %d)\n"
+           "  -r  rows per tile, at least 2 (default %d)\n"
+           "  -f  dump format: text, raw doubles or NumPy (default dat)\n"
+           "  -k  also write heat-img-<step> every STEPS steps, in the "
+           "background\n"
+           "  -e  stop once a step changes no cell by more than TOL\n"
+           "  -i  steps between those checks (default %d)\n"
+           "  -I  backward Euler steps X times the explicit limit on "
+           "delta_t\n"
+           "  -P  cells and updates in double, in float, or float cells "
+           "updated in double\n"
+           "      (default double)\n"
+           "  -E  every STEPS steps, report the error against a double run\n"
+           "  -K  row kernel: scalar, AVX2 or AVX-512, those with streaming "
+           "stores, or\n"
+           "      streaming with -b 0 past the last level cache (default "
+           "scalar)\n"
+           "  -D  dimensions, an N by N mesh or an N by N by N one with a "
+           "7-point stencil\n"
+           "      (default 2)\n"
+           "  -B  benchmark sizes %d, %d, ... up to -n (default %d, or %d in "
+           "3-D), each for\n"
+           "      -s steps or about %llu cell updates, instead of one run "
+           "with a dump\n",
+           N, T_MAX, THERM_COND, T_BLOCK, ROW_BLOCK, CHECK_EVERY, BENCH_N_MIN,
+           2 * BENCH_N_MIN, BENCH_N_MAX, BENCH_N_MAX_3D, BENCH_UPDATES);
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
-set_initial_conds(mesh_t *mesh)
+parse_u64(const char *str, uint64_t *val)
 {
-    if (NULL == mesh) return FAILURE_INVALID_ARG;
-
-    int x0 = mesh->nx / 2;
-    int y0 = mesh->ny / 2;
-    int x = mesh->nx / 4, y = 0;
-    int radius_err = 1 - x;
-
-    while (x >= y) {
-        mesh->cells[ x + x0][ y + y0] = K * .50;
-        mesh->cells[ y + x0][ x + y0] = K * .60;
-        mesh->cells[-x + x0][ y + y0] = K * .70;
-        mesh->cells[-y + x0][ x + y0] = K * .80;
-        mesh->cells[-x + x0][-y + y0] = K * .70;
-        mesh->cells[-y + x0][-x + y0] = K * .60;
-        mesh->cells[ x + x0][-y + y0] = K * .50;
-        mesh->cells[ y + x0][-x + y0] = K;
-        y++;
-        if (radius_err < 0) radius_err += 2 * y + 1;
-        else {
-            --x;
-            radius_err += 2 * (y - x + 1);
-        }
-    }
-    return SUCCESS;
+    char *end = NULL;
+
+    if ('\0' == *str || '-' == *str) return FAILURE_INVALID_ARG;
+    *val = strtoull(str, &end, 10);
+    return ('\0' == *end) ? SUCCESS : FAILURE_INVALID_ARG;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 int
-main(void)
+main(int argc, char **argv)
 {
     int rc = FAILURE;
     int erc = EXIT_FAILURE;
-    simulation_params_t *params = NULL;
-    simulation_t *sim = NULL;
+    simulation_params_t *params = NULL, ref_params;
+    simulation_t *sim = NULL, *ref = NULL;
+    snapshot_t *snap = NULL;
+    uint64_t n = N, max_t = T_MAX, nthreads = 0;
+    uint64_t t_block = T_BLOCK, row_block = ROW_BLOCK, snap_every = 0;
+    uint64_t check_every = CHECK_EVERY, err_every = 0, dims = 2;
+    double c = THERM_COND, tol = 0.0, dt_factor = 0.0, secs, max_err = 0.0;
+    int format = DUMP_TEXT, precision = PREC_DOUBLE, type = KERNEL_SCALAR;
+    const char *kernel = NULL;
+    bool bench = false, n_set = false, max_t_set = false;
+    char *end = NULL;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "n:s:c:p:b:r:f:k:e:i:I:P:E:K:D:Bh"))) {
+        rc = SUCCESS;
+        switch (opt) {
+        case 'n': rc = parse_u64(optarg, &n); n_set = true; break;
+        case 's': rc = parse_u64(optarg, &max_t); max_t_set = true; break;
+        case 'c':
+            c = strtod(optarg, &end);
+            if ('\0' == *optarg || '\0' != *end || c <= 0.0) {
+                rc = FAILURE_INVALID_ARG;
+            }
+            break;
+        case 'p': rc = parse_u64(optarg, &nthreads); break;
+        case 'b': rc = parse_u64(optarg, &t_block); break;
+        case 'r': rc = parse_u64(optarg, &row_block); break;
+        case 'f':
+            for (format = DUMP_NPY; format >= 0; --format) {
+                if (0 == strcmp(optarg, dump_ext[format])) break;
+            }
+            if (format < 0) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'k': rc = parse_u64(optarg, &snap_every); break;
+        case 'e':
+            tol = strtod(optarg, &end);
+            if ('\0' == *optarg || '\0' != *end || tol <= 0.0) {
+                rc = FAILURE_INVALID_ARG;
+            }
+            break;
+        case 'i': rc = parse_u64(optarg, &check_every); break;
+        case 'I':
+            dt_factor = strtod(optarg, &end);
+            if ('\0' == *optarg || '\0' != *end || dt_factor <= 0.0) {
+                rc = FAILURE_INVALID_ARG;
+            }
+            break;
+        case 'P':
+            for (precision = PREC_MIXED; precision >= 0; --precision) {
+                if (0 == strcmp(optarg, prec_name[precision])) break;
+            }
+            if (precision < 0) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'E': rc = parse_u64(optarg, &err_every); break;
+        case 'K':
+            for (type = KERNEL_AUTO; type >= 0; --type) {
+                if (0 == strcmp(optarg, kernel_type[type])) break;
+            }
+            if (type < 0) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'D':
+            rc = parse_u64(optarg, &dims);
+            if (2 != dims && 3 != dims) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'B': bench = true; break;
+        case 'h': usage(); return EXIT_SUCCESS;
+        default: rc = FAILURE_INVALID_ARG; break;
+        }
+        if (SUCCESS != rc) {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (bench && !n_set) n = (3 == dims) ? BENCH_N_MAX_3D : BENCH_N_MAX;
+    /* the heat source needs a few cells around it */
+    if (optind != argc || n < 8 || row_block < 2 || 0 == check_every ||
+        (bench && n < BENCH_N_MIN)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+#ifdef _OPENMP
+    if (nthreads > 0) omp_set_num_threads((int)nthreads);
+#else
+    if (nthreads > 1) fprintf(stderr, "warning: built without OpenMP, "
+                              "running one thread\n");
+#endif
+
+    cody_init("heat-tx", "c");
+    /* before any mesh is first touched */
+    cody_pin(0, 1);
+    cody_param("n", "%"PRIu64, n);
+    cody_param("dims", "%"PRIu64, dims);
+    cody_param("precision", "%s", prec_name[precision]);
+    cody_param("kernel", "%s", kernel_type[type]);
+    cody_param("t_block", "%"PRIu64, t_block);
+    cody_param("row_block", "%"PRIu64, row_block);
+    cody_param("mode", "%s", bench ? "benchmark" : "run");
 
     /* print application banner */
     printf("o %s %s\n", app_name, app_ver);
+#ifdef _OPENMP
+    printf(". threads: %d\n", omp_get_max_threads());
+    cody_param("threads", "%d", omp_get_max_threads());
+#endif
 
     if (SUCCESS != (rc = params_construct(&params))) {
         fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
                 __LINE__, rc);
         goto cleanup;
     }
-    if (SUCCESS != (rc = init_params(params, N, THERM_COND, T_MAX))) {
+    if (SUCCESS != (rc = init_params(params, n, c, max_t, t_block, row_block,
+                                     !bench))) {
         fprintf(stderr, "init_params failure @ %s:%d: rc = %d\n", __FILE__,
                 __LINE__, rc);
         goto cleanup;
     }
+    params->tol = tol;
+    params->check_every = check_every;
+    params->precision = precision;
+    printf(". precision: %s\n", prec_name[precision]);
+    if (3 == dims) {
+        (void)params_set_dims(params, 3);
+        printf(". 3-D delta_t: %lf\n", params->delta_t);
+    }
+    if (dt_factor > 0.0) {
+        params->implicit = true;
+        params->delta_t *= dt_factor;
+        printf(". implicit delta_t: %lf\n", params->delta_t);
+    }
+    if (bench) {
+        if (SUCCESS != (rc = benchmark(params, max_t_set ? max_t : 0,
+                                       type))) {
+            goto cleanup;
+        }
+        erc = EXIT_SUCCESS;
+        goto cleanup;
+    }
     if (SUCCESS != (rc = simulation_construct(&sim, params))) {
         fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
         goto cleanup;
     }
-    if (SUCCESS != (rc = set_initial_conds(sim->old_mesh))) {
-        fprintf(stderr, "set_initial_conds failure @ %s:%d: rc = %d\n",
+    if (SUCCESS != (rc = set_kernel(sim, type, &kernel))) goto cleanup;
+    printf(". kernel: %s\n", kernel);
+    if (0 != snap_every &&
+        SUCCESS != (rc = snapshot_construct(&snap, n, n, sim->old_mesh->nz,
+                                            sim->old_mesh->type, format))) {
+        fprintf(stderr, "snapshot_construct failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
         goto cleanup;
     }
-    if (SUCCESS != (rc = run_simulation(sim))) {
+    if (0 != err_every) {
+        /* the same run in double, quietly and to the end */
+        ref_params = *params;
+        ref_params.precision = PREC_DOUBLE;
+        ref_params.verbose = false;
+        ref_params.tol = 0.0;
+        if (SUCCESS != (rc = simulation_construct(&ref, &ref_params))) {
+            fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
+                    __FILE__, __LINE__, rc);
+            goto cleanup;
+        }
+    }
+    printf("o starting simulation...\n");
+    cody_param("steps", "%"PRIu64, max_t);
+    cody_begin("run");
+    rc = run_timed(sim, snap, snap_every, ref, err_every, &max_err, &secs);
+    cody_end();
+    if (SUCCESS != rc) {
         fprintf(stderr, "run_simulation failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
         goto cleanup;
     }
-    if (SUCCESS != dump(sim)) {
+    if (sim->converged) {
+        printf("o converged after %"PRIu64" steps: max change %le\n",
+               sim->t, sim->delta);
+    }
+    printf("o simulation done\n");
+    report_header();
+    report_rate(params, sim->t, secs, kernel, "run");
+    if (NULL != ref) printf("o max error against double: %le\n", max_err);
+    cody_begin("dump");
+    rc = dump(sim, format);
+    cody_end();
+    if (SUCCESS != rc) {
         fprintf(stderr, "dump failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
         goto cleanup;
@@ -459,7 +631,10 @@ main(void)
     erc = EXIT_SUCCESS;
 
 cleanup:
+    (void)snapshot_destruct(snap);
+    (void)simulation_destruct(ref);
     (void)simulation_destruct(sim);
     (void)params_destruct(params);
+    if (0 != cody_finish()) erc = EXIT_FAILURE;
     return erc;
 }
@@ -0,0 +1,1101 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* A simple 2D heat transfer simulation in C by Samuel K. Gutierrez */
+
+/* what we are solving
+ *
+ * u_t = c * (u_xx * u_yy), 0 <= x,y <= NX, t >= 0
+ */
+
+/* http://www.cosy.sbg.ac.at/events/parnum05/book/horak1.pdf */
+
+/*
+ * NOTES
+ * see also: Crank-Nicolson method
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+#include <sched.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "heattx.h"
+#include "cody.h"
+
+/* some constant */
+#define K 0.4
+
+/* static forward declarations */
+static int
+set_initial_conds(mesh_t *mesh,
+                  uint64_t gnx,
+                  uint64_t gny,
+                  int64_t wx,
+                  int64_t wy);
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+sim_param_cp(const simulation_params_t *from,
+             simulation_params_t *to)
+{
+    if (!from || !to) return FAILURE_INVALID_ARG;
+    (void)memcpy(to, from, sizeof(*from));
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+params_construct(simulation_params_t **params)
+{
+    simulation_params_t *tmp = NULL;
+    if (!params) return FAILURE_INVALID_ARG;
+    if (NULL == (tmp = calloc(1, sizeof(*tmp)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    *params = tmp;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+params_destruct(simulation_params_t *params)
+{
+    if (!params) return FAILURE_INVALID_ARG;
+    free(params);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* bytes per cell of mesh */
+static size_t
+cell_size(const mesh_t *mesh)
+{
+    return (MESH_FLOAT == mesh->type) ? sizeof(float) : sizeof(double);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_construct(mesh_t **new_mesh,
+               int x /* number of rows */,
+               int y /* number of columns */)
+{
+    return mesh_construct_type(new_mesh, x, y, MESH_DOUBLE);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_construct_type(mesh_t **new_mesh,
+                    int x /* number of rows */,
+                    int y /* number of columns */,
+                    int type)
+{
+    return mesh_construct_3d(new_mesh, x, y, 1, type);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the rows the engines step a mesh by, or its planes if it is 3-D */
+static uint64_t
+mesh_slabs(const mesh_t *mesh)
+{
+    return (mesh->nz > 1) ? mesh->nz : mesh->nx;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_construct_3d(mesh_t **new_mesh,
+                  int x /* number of rows */,
+                  int y /* number of columns */,
+                  int z /* number of planes */,
+                  int type)
+{
+    mesh_t *tmp_mesh = NULL;
+    void *data = NULL;
+    char *rows;
+    uint64_t pitch, plane, slab, nslabs;
+    size_t size;
+    int i;
+
+    if (NULL == new_mesh || z < 1 ||
+        (MESH_DOUBLE != type && MESH_FLOAT != type)) {
+        return FAILURE_INVALID_ARG;
+    }
+
+    tmp_mesh = (mesh_t *)calloc(1, sizeof(*tmp_mesh));
+    if (NULL == tmp_mesh) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        /* just bail */
+        return FAILURE_OOR;
+    }
+    tmp_mesh->type = type;
+    size = cell_size(tmp_mesh);
+    /* all the rows live in one aligned block, each padded so the next one
+     * starts on a MESH_ALIGN boundary */
+    pitch = (y * size + MESH_ALIGN - 1) / MESH_ALIGN * MESH_ALIGN / size;
+    plane = x * pitch;
+    /* left untouched, for the threads below to place its pages */
+    data = cody_alloc(z * plane * size, MESH_ALIGN, CODY_FIRST_TOUCH);
+    if (NULL == data) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        goto error;
+    }
+    rows = (char *)data;
+    if (MESH_FLOAT == type) tmp_mesh->fdata = (float *)data;
+    else tmp_mesh->data = (double *)data;
+    /* zero the rows, or the planes of a 3-D mesh, on the threads that will
+     * update them, with the same static schedule, so each one's pages land
+     * on that thread's NUMA node */
+    nslabs = (z > 1) ? (uint64_t)z : (uint64_t)x;
+    slab = (z > 1) ? plane : pitch;
+    (void)memset(rows, 0, slab * size);
+    (void)memset(rows + (nslabs - 1) * slab * size, 0, slab * size);
+#pragma omp parallel for schedule(static)
+    for (i = 1; i < (int)nslabs - 1; ++i) {
+        (void)memset(rows + i * slab * size, 0, slab * size);
+    }
+    /* row pointer view of the block */
+    if (MESH_FLOAT == type) {
+        tmp_mesh->fcells = (float **)calloc(z * x, sizeof(float *));
+    }
+    else {
+        tmp_mesh->cells = (double **)calloc(z * x, sizeof(double *));
+    }
+    if (NULL == tmp_mesh->cells && NULL == tmp_mesh->fcells) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        goto error;
+    }
+    for (i = 0; i < z * x; ++i) {
+        if (MESH_FLOAT == type) tmp_mesh->fcells[i] = tmp_mesh->fdata + i * pitch;
+        else tmp_mesh->cells[i] = tmp_mesh->data + i * pitch;
+    }
+    tmp_mesh->nx = x;
+    tmp_mesh->ny = y;
+    tmp_mesh->nz = z;
+    tmp_mesh->pitch = pitch;
+    tmp_mesh->plane = plane;
+
+    *new_mesh = tmp_mesh;
+    return SUCCESS;
+
+error:
+    mesh_destruct(tmp_mesh);
+    return FAILURE_OOR;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_destruct(mesh_t *mesh)
+{
+    if (!mesh) return FAILURE_INVALID_ARG;
+    free(mesh->cells);
+    cody_free(mesh->data);
+    free(mesh->fcells);
+    cody_free(mesh->fdata);
+    free(mesh);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_copy(mesh_t *to, const mesh_t *from)
+{
+    if (NULL == to || NULL == from || to->type != from->type ||
+        to->nx != from->nx || to->nz != from->nz ||
+        to->pitch != from->pitch) {
+        return FAILURE_INVALID_ARG;
+    }
+    (void)memcpy((MESH_FLOAT == to->type) ? (void *)to->fdata
+                                           : (void *)to->data,
+                 (MESH_FLOAT == from->type) ? (const void *)from->fdata
+                                             : (const void *)from->data,
+                 from->nz * from->plane * cell_size(from));
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_max_diff(const mesh_t *a, const mesh_t *b, double *diff)
+{
+    uint64_t i, j;
+    double max = 0.0;
+
+    if (NULL == a || NULL == b || NULL == diff || a->nx != b->nx ||
+        a->ny != b->ny || a->nz != b->nz) {
+        return FAILURE_INVALID_ARG;
+    }
+    /* every row of every plane */
+#pragma omp parallel for schedule(static) private(j) reduction(max:max)
+    for (i = 0; i < a->nz * a->nx; ++i) {
+        for (j = 0; j < a->ny; ++j) {
+            double va = (MESH_FLOAT == a->type) ? a->fcells[i][j]
+                                                : a->cells[i][j];
+            double vb = (MESH_FLOAT == b->type) ? b->fcells[i][j]
+                                                : b->cells[i][j];
+            double d = fabs(va - vb);
+            max = (d > max) ? d : max;
+        }
+    }
+    *diff = max;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+gen_meshes(simulation_t *sim, uint64_t nx, uint64_t ny, uint64_t nz, int type)
+{
+    int rc = FAILURE;
+
+    if (SUCCESS != (rc = mesh_construct_3d(&sim->old_mesh, nx, ny, nz,
+                                           type))) {
+        fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
+                __LINE__);
+        goto out;
+    }
+    if (SUCCESS != (rc = mesh_construct_3d(&sim->new_mesh, nx, ny, nz,
+                                           type))) {
+        fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
+                __LINE__);
+        goto out;
+    }
+out:
+    if (SUCCESS != rc) {
+        mesh_destruct(sim->new_mesh);
+        mesh_destruct(sim->old_mesh);
+        sim->new_mesh = sim->old_mesh = NULL;
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+source_destruct(source_t *src)
+{
+    if (!src) return FAILURE_INVALID_ARG;
+    free(src->row);
+    free(src->col);
+    free(src->val);
+    free(src);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* rasterize the heat source into a scratch mesh and keep the cells it set,
+ * so it can be reimposed one row at a time */
+int
+source_construct(source_t **new_src,
+                 uint64_t gnx,
+                 uint64_t gny,
+                 int64_t wx,
+                 int64_t wy,
+                 uint64_t nx,
+                 uint64_t ny)
+{
+    int rc = FAILURE;
+    mesh_t *scratch = NULL;
+    source_t *src = NULL;
+    uint64_t i, j, n = 0;
+
+    if (NULL == new_src) return FAILURE_INVALID_ARG;
+
+    if (SUCCESS != (rc = mesh_construct(&scratch, nx, ny))) return rc;
+    if (SUCCESS != (rc = set_initial_conds(scratch, gnx, gny, wx, wy))) {
+        goto out;
+    }
+    /* every source value is positive, so the zeros are the other cells */
+    for (i = 0; i < nx; ++i) {
+        for (j = 0; j < ny; ++j) {
+            if (0.0 != scratch->cells[i][j]) ++n;
+        }
+    }
+    rc = FAILURE_OOR;
+    if (NULL == (src = calloc(1, sizeof(*src))) ||
+        NULL == (src->row = calloc(nx + 1, sizeof(uint64_t))) ||
+        NULL == (src->col = calloc(n + 1, sizeof(uint64_t))) ||
+        NULL == (src->val = calloc(n + 1, sizeof(double)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        (void)source_destruct(src);
+        goto out;
+    }
+    for (n = 0, i = 0; i < nx; ++i) {
+        src->row[i] = n;
+        for (j = 0; j < ny; ++j) {
+            if (0.0 != scratch->cells[i][j]) {
+                src->col[n] = j;
+                src->val[n++] = scratch->cells[i][j];
+            }
+        }
+    }
+    src->row[nx] = n;
+    *new_src = src;
+    rc = SUCCESS;
+out:
+    (void)mesh_destruct(scratch);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the cells of the n by n by n mesh less than half a cell from the sphere of
+ * radius n / 4 around its middle, the eight octants of the shell taking the
+ * values of set_initial_conds' eight octants of the circle */
+int
+source_construct_3d(source_t **new_src,
+                    uint64_t n,
+                    uint64_t pitch)
+{
+    static const double oct_val[8] = {K, K * .50, K * .60, K * .70,
+                                      K * .80, K * .70, K * .60, K * .50};
+    source_t *src = NULL;
+    int64_t c = n / 2, r = n / 4, di, dj, dk, d2;
+    int64_t lo2 = (2 * r - 1) * (2 * r - 1), hi2 = (2 * r + 1) * (2 * r + 1);
+    /* the shell's bounding box in y and z */
+    uint64_t b0 = c - r - 1, b1 = c + r + 2;
+    uint64_t i, j, k, m, pass;
+
+    if (NULL == new_src) return FAILURE_INVALID_ARG;
+
+    /* count the cells, then keep them; 4 d^2 against (2r -+ 1)^2 is d
+     * within half a cell of r */
+    for (pass = 0; pass < 2; ++pass) {
+        m = 0;
+        for (i = 0; i < n; ++i) {
+            if (1 == pass) src->row[i] = m;
+            for (j = b0; j < b1; ++j) {
+                for (k = b0; k < b1; ++k) {
+                    di = (int64_t)i - c;
+                    dj = (int64_t)j - c;
+                    dk = (int64_t)k - c;
+                    d2 = 4 * (di * di + dj * dj + dk * dk);
+                    if (d2 < lo2 || d2 >= hi2) continue;
+                    if (1 == pass) {
+                        src->col[m] = j * pitch + k;
+                        src->val[m] = oct_val[4 * (di < 0) + 2 * (dj < 0) +
+                                              (dk < 0)];
+                    }
+                    ++m;
+                }
+            }
+        }
+        if (0 == pass &&
+            (NULL == (src = calloc(1, sizeof(*src))) ||
+             NULL == (src->row = calloc(n + 1, sizeof(uint64_t))) ||
+             NULL == (src->col = calloc(m + 1, sizeof(uint64_t))) ||
+             NULL == (src->val = calloc(m + 1, sizeof(double))))) {
+            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+            (void)source_destruct(src);
+            return FAILURE_OOR;
+        }
+    }
+    src->row[n] = m;
+    *new_src = src;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+simulation_destruct(simulation_t *sim)
+{
+    if (!sim) return FAILURE_INVALID_ARG;
+    (void)params_destruct(sim->params);
+    (void)source_destruct(sim->source);
+    (void)implicit_destruct(sim->solver);
+    (void)mesh_destruct(sim->new_mesh);
+    (void)mesh_destruct(sim->old_mesh);
+    free(sim->done);
+    free(sim);
+    return SUCCESS;
+}
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+simulation_construct(simulation_t **new_sim,
+               const simulation_params_t *params)
+{
+    simulation_t *sim = NULL;
+    uint64_t i, k;
+    int rc = FAILURE;
+
+    if (!new_sim || !params) return FAILURE_INVALID_ARG;
+
+    if (NULL == (sim = (simulation_t *)calloc(1, sizeof(*sim)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    if (SUCCESS != (rc = params_construct(&sim->params))) {
+        fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        goto out;
+    }
+    if (SUCCESS != (rc = sim_param_cp(params, sim->params))) {
+        fprintf(stderr, "sim_param_cp failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        goto out;
+    }
+    if (params->implicit && PREC_DOUBLE != params->precision) {
+        fprintf(stderr, "implicit steps need double precision\n");
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    if (3 == params->dims &&
+        (params->implicit || PREC_DOUBLE != params->precision)) {
+        fprintf(stderr, "3-D steps are explicit and in double precision\n");
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    if (SUCCESS != (rc = gen_meshes(sim, params->n, params->n,
+                                    (3 == params->dims) ? params->n : 1,
+                                    (PREC_DOUBLE == params->precision) ?
+                                    MESH_DOUBLE : MESH_FLOAT))) {
+        fprintf(stderr, "gen_meshes failure @ %s:%d: rc = %d\n", __FILE__,
+                __LINE__, rc);
+        /* on failure, gen_meshes cleans up after itself */
+        goto out;
+    }
+    if (3 == params->dims) {
+        rc = source_construct_3d(&sim->source, params->n,
+                                 sim->old_mesh->pitch);
+    }
+    else {
+        rc = source_construct(&sim->source, params->n, params->n, 0, 0,
+                              params->n, params->n);
+    }
+    if (SUCCESS != rc) {
+        fprintf(stderr, "source_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto out;
+    }
+    if (0 != params->t_block) {
+        if (params->row_block < 2) {
+            rc = FAILURE_INVALID_ARG;
+            goto out;
+        }
+        /* as many tiles as the longest block needs */
+        sim->done = calloc((params->n - 3 + params->t_block +
+                            params->row_block - 1) / params->row_block,
+                           sizeof(*sim->done));
+        if (NULL == sim->done) {
+            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+            rc = FAILURE_OOR;
+            goto out;
+        }
+    }
+    if (params->implicit &&
+        SUCCESS != (rc = implicit_construct(&sim->solver, params->n,
+                                            sim->source))) {
+        fprintf(stderr, "implicit_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto out;
+    }
+    /* step 0 is cold but for the source */
+    for (i = 0; i < params->n; ++i) {
+        for (k = sim->source->row[i]; k < sim->source->row[i + 1]; ++k) {
+            if (3 == params->dims) {
+                sim->old_mesh->data[i * sim->old_mesh->plane +
+                                    sim->source->col[k]] = sim->source->val[k];
+            }
+            else if (MESH_FLOAT == sim->old_mesh->type) {
+                sim->old_mesh->fcells[i][sim->source->col[k]] =
+                    sim->source->val[k];
+            }
+            else {
+                sim->old_mesh->cells[i][sim->source->col[k]] =
+                    sim->source->val[k];
+            }
+        }
+    }
+    switch (params->precision) {
+    case PREC_FLOAT: sim->kernel = step_rows_float; break;
+    case PREC_MIXED: sim->kernel = step_rows_mixed; break;
+    default: sim->kernel = (3 == params->dims) ? step_rows_3d : step_rows;
+    }
+    *new_sim = sim;
+out:
+    if (SUCCESS != rc) (void)simulation_destruct(sim);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+init_params(simulation_params_t *params,
+            uint64_t n,
+            double c,
+            uint64_t max_t,
+            uint64_t t_block,
+            uint64_t row_block,
+            bool verbose)
+{
+    if (NULL == params) return FAILURE_INVALID_ARG;
+
+    params->verbose = verbose;
+    if (params->verbose) printf("o initializing simulation parameters...\n");
+
+    params->n = n;
+    params->c = c;
+    params->max_t = max_t;
+    params->t_block = t_block;
+    params->row_block = row_block;
+    params->tol = 0.0;
+    params->check_every = 0;
+    params->implicit = false;
+    params->precision = PREC_DOUBLE;
+    params->delta_s = 1.0 / (double)(n + 1);
+    (void)params_set_dims(params, 2);
+
+    if (params->verbose) {
+        printf(". n: %"PRIu64"\n", params->n);
+        printf(". max_t: %"PRIu64"\n", params->max_t);
+        printf(". c: %lf\n", params->c);
+        printf(". delta_s: %lf\n", params->delta_s);
+        printf(". delta_t: %lf\n", params->delta_t);
+        printf(". t_block: %"PRIu64"\n", params->t_block);
+        printf(". row_block: %"PRIu64"\n\n", params->row_block);
+    }
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+params_set_dims(simulation_params_t *params, int dims)
+{
+    if (NULL == params || (2 != dims && 3 != dims)) {
+        return FAILURE_INVALID_ARG;
+    }
+    params->dims = dims;
+    /* we know from theory that we have to obey the restriction:
+     * delta_t <= (delta_s)^2/(2 dims c). so just make them equal.
+     */
+    params->delta_t = pow(params->delta_s, 2.0) / (2.0 * dims * params->c);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the header of a .npy array of type cells of the given shape, padded so
+ * the data start on a 64-byte boundary */
+static int
+npy_header_shape(char hdr[NPY_HEADER_MAX], const char *shape, int type)
+{
+    char dict[NPY_HEADER_MAX];
+    int one = 1;
+    int len, pad;
+
+    len = snprintf(dict, sizeof(dict), "{'descr': '%cf%d', 'fortran_order': "
+                   "False, 'shape': (%s), }", (*(char *)&one) ? '<' : '>',
+                   (MESH_FLOAT == type) ? 4 : 8, shape);
+    /* magic, version and length, the dictionary and a newline */
+    pad = (64 - (10 + len + 1) % 64) % 64;
+    (void)memcpy(hdr, "\x93NUMPY\x01\x00", 8);
+    hdr[8] = (len + pad + 1) & 0xff;
+    hdr[9] = (len + pad + 1) >> 8;
+    (void)memcpy(hdr + 10, dict, len);
+    (void)memset(hdr + 10 + len, ' ', pad);
+    hdr[10 + len + pad] = '\n';
+    return 10 + len + pad + 1;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+npy_header(char hdr[NPY_HEADER_MAX], uint64_t nx, uint64_t ny, int type)
+{
+    char shape[64];
+
+    snprintf(shape, sizeof(shape), "%"PRIu64", %"PRIu64, nx, ny);
+    return npy_header_shape(hdr, shape, type);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+mesh_write(const mesh_t *mesh, const char *path, int format)
+{
+    FILE *imgfp = NULL;
+    uint64_t i, j;
+    int rc = SUCCESS;
+
+    if (NULL == (imgfp = fopen(path, "wb"))) {
+        fprintf(stderr, "fopen failure @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_IO;
+    }
+    if (DUMP_TEXT == format) {
+        /* write the matrix, a blank line after each plane of a 3-D one */
+        for (i = 0; i < mesh->nz * mesh->nx; ++i) {
+            if (i > 0 && 0 == i % mesh->nx) fprintf(imgfp, "\n");
+            for (j = 0; j < mesh->ny; ++j) {
+                fprintf(imgfp, "%lf%s", (MESH_FLOAT == mesh->type) ?
+                        (double)mesh->fcells[i][j] : mesh->cells[i][j],
+                        (j == mesh->ny - 1) ? "" : " ");
+            }
+            fprintf(imgfp, "\n");
+        }
+    }
+    else {
+        if (DUMP_NPY == format) {
+            char hdr[NPY_HEADER_MAX], shape[64];
+            size_t len;
+
+            if (mesh->nz > 1) {
+                snprintf(shape, sizeof(shape), "%"PRIu64", %"PRIu64", %"
+                         PRIu64, mesh->nz, mesh->nx, mesh->ny);
+                len = npy_header_shape(hdr, shape, mesh->type);
+            }
+            else len = npy_header(hdr, mesh->nx, mesh->ny, mesh->type);
+            if (len != fwrite(hdr, 1, len, imgfp)) rc = FAILURE_IO;
+        }
+        /* one write per row, leaving out the padding */
+        for (i = 0; SUCCESS == rc && i < mesh->nz * mesh->nx; ++i) {
+            const void *row = (MESH_FLOAT == mesh->type) ?
+                              (const void *)mesh->fcells[i] :
+                              (const void *)mesh->cells[i];
+
+            if (mesh->ny != fwrite(row, cell_size(mesh), mesh->ny, imgfp)) {
+                rc = FAILURE_IO;
+            }
+        }
+    }
+    if (0 != fclose(imgfp)) rc = FAILURE_IO;
+    if (SUCCESS != rc) {
+        fprintf(stderr, "write failure @ %s:%d: %s\n", __FILE__, __LINE__,
+                path);
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* one step of rows [lo, hi) from old_mesh into new_mesh, heat source
+ * included */
+void
+step_rows(mesh_t *new_mesh,
+          const mesh_t *old_mesh,
+          const source_t *src,
+          uint64_t lo,
+          uint64_t hi,
+          double cdtods2)
+{
+    uint64_t i, j, k;
+    uint64_t ny = old_mesh->ny;
+    uint64_t pitch = old_mesh->pitch;
+    double *nci, *oci, *ocip, *ocin;
+
+    for (i = lo; i < hi; ++i) {
+        nci =  new_mesh->data + i * pitch;
+        oci =  old_mesh->data + i * pitch;
+        ocip = oci - pitch;
+        ocin = oci + pitch;
+        for (j = 1; j < ny - 1; ++j) {
+            nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
+                               oci[j] + oci[j + 1] + oci[j - 1]));
+        }
+        for (k = src->row[i]; k < src->row[i + 1]; ++k) {
+            nci[src->col[k]] = src->val[k];
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+step_rows_float(mesh_t *new_mesh,
+                const mesh_t *old_mesh,
+                const source_t *src,
+                uint64_t lo,
+                uint64_t hi,
+                double cdtods2)
+{
+    uint64_t i, j, k;
+    uint64_t ny = old_mesh->ny;
+    uint64_t pitch = old_mesh->pitch;
+    float c = (float)cdtods2;
+    float *nci, *oci, *ocip, *ocin;
+
+    for (i = lo; i < hi; ++i) {
+        nci =  new_mesh->fdata + i * pitch;
+        oci =  old_mesh->fdata + i * pitch;
+        ocip = oci - pitch;
+        ocin = oci + pitch;
+        for (j = 1; j < ny - 1; ++j) {
+            nci[j] = oci[j] + (c * (ocin[j] + ocip[j] - 4.0f *
+                               oci[j] + oci[j + 1] + oci[j - 1]));
+        }
+        for (k = src->row[i]; k < src->row[i + 1]; ++k) {
+            nci[src->col[k]] = (float)src->val[k];
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+step_rows_mixed(mesh_t *new_mesh,
+                const mesh_t *old_mesh,
+                const source_t *src,
+                uint64_t lo,
+                uint64_t hi,
+                double cdtods2)
+{
+    uint64_t i, j, k;
+    uint64_t ny = old_mesh->ny;
+    uint64_t pitch = old_mesh->pitch;
+    float *nci, *oci, *ocip, *ocin;
+
+    for (i = lo; i < hi; ++i) {
+        nci =  new_mesh->fdata + i * pitch;
+        oci =  old_mesh->fdata + i * pitch;
+        ocip = oci - pitch;
+        ocin = oci + pitch;
+        for (j = 1; j < ny - 1; ++j) {
+            double o = oci[j];
+            nci[j] = (float)(o + (cdtods2 * ((double)ocin[j] + ocip[j] -
+                                             4.0 * o + oci[j + 1] +
+                                             oci[j - 1])));
+        }
+        for (k = src->row[i]; k < src->row[i + 1]; ++k) {
+            nci[src->col[k]] = (float)src->val[k];
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+step_rows_3d(mesh_t *new_mesh,
+             const mesh_t *old_mesh,
+             const source_t *src,
+             uint64_t lo,
+             uint64_t hi,
+             double cdtods2)
+{
+    uint64_t p, i, j, k;
+    uint64_t nx = old_mesh->nx, ny = old_mesh->ny;
+    uint64_t pitch = old_mesh->pitch, plane = old_mesh->plane;
+    double *ncp, *nci, *oci, *ocip, *ocin, *ocid, *ociu;
+
+    for (p = lo; p < hi; ++p) {
+        ncp = new_mesh->data + p * plane;
+        for (i = 1; i < nx - 1; ++i) {
+            nci =  ncp + i * pitch;
+            oci =  old_mesh->data + p * plane + i * pitch;
+            ocip = oci - pitch;
+            ocin = oci + pitch;
+            ocid = oci - plane;
+            ociu = oci + plane;
+            for (j = 1; j < ny - 1; ++j) {
+                nci[j] = oci[j] + (cdtods2 * (ociu[j] + ocid[j] + ocin[j] +
+                                   ocip[j] - 6.0 * oci[j] + oci[j + 1] +
+                                   oci[j - 1]));
+            }
+        }
+        for (k = src->row[p]; k < src->row[p + 1]; ++k) {
+            ncp[src->col[k]] = src->val[k];
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+run_simulation(simulation_t *sim, uint64_t nsteps)
+{
+    uint64_t t, i;
+    uint64_t nx = mesh_slabs(sim->old_mesh);
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    uint64_t t_max = sim->params->max_t;
+    mesh_t *meshes[2] = {sim->old_mesh, sim->new_mesh};
+
+    for (t = sim->t; t < sim->t + nsteps; ++t) {
+        if (sim->params->verbose && 0 == t % 100) {
+            printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t, t_max); 
+        }
+        /* each row, or plane, reimposes its part of the constant heat
+         * source */
+#pragma omp parallel for schedule(static)
+        for (i = 1; i < nx - 1; ++i) {
+            sim->kernel(meshes[(t + 1) % 2], meshes[t % 2], sim->source, i,
+                        i + 1, cdtods2);
+        }
+    }
+    sim->t += nsteps;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* The temporally blocked engine. Each block of t_block steps cuts the rows
+ * into tiles of row_block rows, and a tile advances all the block's steps
+ * while its rows are in cache, its rows moving back one per step so that
+ * every row it reads was computed by it or by the tile before it. The two
+ * meshes hold alternate steps, as in the plain loop, so a tile may compute
+ * step s once the tile before it has finished step s - 1: the rows it then
+ * overwrites are no longer read by that tile. Tiles go round robin to the
+ * threads, each waiting on its predecessor's progress. The result is
+ * bit-for-bit that of the plain loop. A 3-D mesh is tiled the same way by
+ * its planes, row_block of them a tile. */
+static int
+run_simulation_blocked(simulation_t *sim, uint64_t nsteps)
+{
+    uint64_t t, t0, nb, s;
+    uint64_t nx = mesh_slabs(sim->old_mesh);
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    uint64_t t_max = sim->params->max_t;
+    uint64_t t_block = sim->params->t_block;
+    uint64_t row_block = sim->params->row_block;
+    mesh_t *meshes[2] = {sim->old_mesh, sim->new_mesh};
+    uint64_t t_end = sim->t + nsteps;
+    uint64_t *done = sim->done;
+    int64_t tile, ntiles, lo, hi;
+
+    for (t0 = sim->t; t0 < t_end; t0 += nb) {
+        nb = (t_end - t0 < t_block) ? t_end - t0 : t_block;
+        for (t = t0; t < t0 + nb; ++t) {
+            if (sim->params->verbose && 0 == t % 100) {
+                printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t,
+                       t_max);
+            }
+        }
+        /* enough tiles that the last one still reaches row nx - 2 */
+        ntiles = (nx - 3 + nb + row_block - 1) / row_block;
+        (void)memset(done, 0, ntiles * sizeof(*done));
+#pragma omp parallel for schedule(static, 1) private(s, lo, hi)
+        for (tile = 0; tile < ntiles; ++tile) {
+            for (s = 1; s <= nb; ++s) {
+                if (tile > 0) {
+                    uint64_t prev;
+                    /* yield while waiting, in case the tile before is
+                     * waiting for this thread's core */
+                    for (;;) {
+#pragma omp atomic read seq_cst
+                        prev = done[tile - 1];
+                        if (prev >= s - 1) break;
+                        (void)sched_yield();
+                    }
+                }
+                lo = 1 + tile * (int64_t)row_block - (int64_t)(s - 1);
+                hi = lo + (int64_t)row_block;
+                if (lo < 1) lo = 1;
+                if (hi > (int64_t)nx - 1) hi = nx - 1;
+                if (lo < hi) {
+                    sim->kernel(meshes[(t0 + s) % 2],
+                                meshes[(t0 + s - 1) % 2], sim->source, lo, hi,
+                                cdtods2);
+                }
+#pragma omp atomic write seq_cst
+                done[tile] = s;
+            }
+        }
+    }
+    sim->t = t_end;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+run_implicit(simulation_t *sim, uint64_t nsteps)
+{
+    int rc = SUCCESS;
+    uint64_t t, iters;
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    uint64_t t_max = sim->params->max_t;
+    mesh_t *meshes[2] = {sim->old_mesh, sim->new_mesh};
+    double resid;
+
+    for (t = sim->t; SUCCESS == rc && t < sim->t + nsteps; ++t) {
+        rc = implicit_step(sim->solver, meshes[(t + 1) % 2], meshes[t % 2],
+                           cdtods2, &iters, &resid);
+        if (sim->params->verbose && 0 == t % 100) {
+            printf(". iteration %"PRIu64" of %"PRIu64": %"PRIu64" CG "
+                   "iterations, residual %le\n", t, t_max, iters, resid);
+        }
+    }
+    sim->t += nsteps;
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* one step that also finds the largest change of a cell, comparing each row
+ * while it is still in cache when the step is explicit */
+static int
+run_checked(simulation_t *sim)
+{
+    int rc = SUCCESS;
+    uint64_t i, j, r;
+    uint64_t nx = mesh_slabs(sim->old_mesh), ny = sim->old_mesh->ny;
+    /* the rows of a slab, one unless it is a plane */
+    uint64_t rows = (sim->old_mesh->nz > 1) ? sim->old_mesh->nx : 1;
+    double ds2 = sim->params->delta_s * sim->params->delta_s;
+    double cdtods2 = (sim->params->c * sim->params->delta_t) / ds2;
+    mesh_t *meshes[2] = {sim->old_mesh, sim->new_mesh};
+    mesh_t *old_mesh = meshes[sim->t % 2], *new_mesh = meshes[(sim->t + 1) % 2];
+    double delta = 0.0;
+
+    if (sim->params->implicit) {
+        rc = implicit_step(sim->solver, new_mesh, old_mesh, cdtods2, NULL,
+                           NULL);
+        if (SUCCESS != rc) return rc;
+    }
+#pragma omp parallel for schedule(static) private(j, r) reduction(max:delta)
+    for (i = 1; i < nx - 1; ++i) {
+        if (!sim->params->implicit) {
+            sim->kernel(new_mesh, old_mesh, sim->source, i, i + 1, cdtods2);
+        }
+        for (r = i * rows; r < (i + 1) * rows; ++r) {
+            if (MESH_FLOAT == old_mesh->type) {
+                const float *oci = old_mesh->fcells[r];
+                const float *nci = new_mesh->fcells[r];
+
+                for (j = 1; j < ny - 1; ++j) {
+                    double d = fabs((double)nci[j] - oci[j]);
+                    delta = (d > delta) ? d : delta;
+                }
+            }
+            else {
+                const double *oci = old_mesh->cells[r];
+                const double *nci = new_mesh->cells[r];
+
+                for (j = 1; j < ny - 1; ++j) {
+                    double d = fabs(nci[j] - oci[j]);
+                    delta = (d > delta) ? d : delta;
+                }
+            }
+        }
+    }
+    sim->t++;
+    sim->delta = delta;
+    sim->converged = (delta <= sim->params->tol);
+    if (sim->params->verbose) {
+        printf(". iteration %"PRIu64": max change %le\n", sim->t, delta);
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+run_engine(simulation_t *sim, uint64_t nsteps)
+{
+    if (sim->params->implicit) return run_implicit(sim, nsteps);
+    return (0 == sim->params->t_block) ? run_simulation(sim, nsteps)
+                                       : run_simulation_blocked(sim, nsteps);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+simulation_step(simulation_t *sim, uint64_t nsteps)
+{
+    int rc = SUCCESS;
+    uint64_t every, nb, t_end;
+
+    if (NULL == sim) return FAILURE_INVALID_ARG;
+    every = sim->params->check_every;
+    if (0.0 == sim->params->tol || 0 == every) return run_engine(sim, nsteps);
+
+    /* the steps up to the next checked one go through the engine, which
+     * then takes step every, 2 * every, ... */
+    t_end = sim->t + nsteps;
+    while (SUCCESS == rc && !sim->converged && sim->t < t_end) {
+        nb = every - 1 - sim->t % every;
+        if (nb > t_end - sim->t) nb = t_end - sim->t;
+        if (nb > 0) rc = run_engine(sim, nb);
+        if (SUCCESS == rc && sim->t < t_end) rc = run_checked(sim);
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+mesh_t *
+simulation_mesh(simulation_t *sim)
+{
+    if (NULL == sim) return NULL;
+    return (1 == sim->t % 2) ? sim->new_mesh : sim->old_mesh;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+simulation_set_kernel(simulation_t *sim, rows_kernel_t kernel)
+{
+    if (NULL == sim || NULL == kernel) return FAILURE_INVALID_ARG;
+    sim->kernel = kernel;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* set the heat source of a gnx by gny mesh in mesh, which holds the part of
+ * it starting at cell (wx, wy) */
+static int
+set_initial_conds(mesh_t *mesh,
+                  uint64_t gnx,
+                  uint64_t gny,
+                  int64_t wx,
+                  int64_t wy)
+{
+    if (NULL == mesh) return FAILURE_INVALID_ARG;
+
+    int x0 = gnx / 2;
+    int y0 = gny / 2;
+    int x = gnx / 4, y = 0;
+    int radius_err = 1 - x;
+
+#define SET_CELL(gi, gj, v) do {                                       \
+    int64_t i_ = (gi) - wx, j_ = (gj) - wy;                             \
+    if (i_ >= 0 && i_ < (int64_t)mesh->nx &&                            \
+        j_ >= 0 && j_ < (int64_t)mesh->ny) mesh->cells[i_][j_] = (v);   \
+} while (0)
+    while (x >= y) {
+        SET_CELL( x + x0,  y + y0, K * .50);
+        SET_CELL( y + x0,  x + y0, K * .60);
+        SET_CELL(-x + x0,  y + y0, K * .70);
+        SET_CELL(-y + x0,  x + y0, K * .80);
+        SET_CELL(-x + x0, -y + y0, K * .70);
+        SET_CELL(-y + x0, -x + y0, K * .60);
+        SET_CELL( x + x0, -y + y0, K * .50);
+        SET_CELL( y + x0, -x + y0, K);
+        y++;
+        if (radius_err < 0) radius_err += 2 * y + 1;
+        else {
+            --x;
+            radius_err += 2 * (y - x + 1);
+        }
+    }
+#undef SET_CELL
+    return SUCCESS;
+}
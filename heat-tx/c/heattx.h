@@ -0,0 +1,374 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* libheattx: the heat-tx simulation as a library. A simulation is built once
+ * and then advanced any number of steps at a time, without allocating, by
+ * the engine and row kernel it was given. Its current mesh can be read and
+ * changed in place between steps. */
+
+#ifndef _HEATTX_H
+#define _HEATTX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* return codes */
+enum {
+    SUCCESS = 0,
+    FAILURE,
+    FAILURE_OOR,
+    FAILURE_IO,
+    FAILURE_INVALID_ARG
+};
+
+/* default steps advanced per tile by the temporally blocked engine; 0
+ * selects the plain loop over the whole mesh */
+#define T_BLOCK 8
+/* default mesh rows per tile of the temporally blocked engine, at least 2 */
+#define ROW_BLOCK 32
+
+/* alignment in bytes of the mesh block and of every row in it */
+#define MESH_ALIGN 64
+
+/* mesh_write formats: text, one row per line; the rows' doubles back to
+ * back; or those in a NumPy .npy file */
+enum {
+    DUMP_TEXT = 0,
+    DUMP_RAW,
+    DUMP_NPY
+};
+
+/* mesh cell types */
+enum {
+    MESH_DOUBLE = 0,
+    MESH_FLOAT
+};
+
+/* simulation precisions: double cells; float cells, for half the memory
+ * traffic and twice the SIMD width; or float cells updated in double */
+enum {
+    PREC_DOUBLE = 0,
+    PREC_FLOAT,
+    PREC_MIXED
+};
+
+/* simulation_kernel's row kernels: the scalar one of the mesh; AVX2 or
+ * AVX-512 ones for 2-D double meshes, writing new_mesh through the cache or
+ * with non-temporal stores around it; or the best of those for the mesh,
+ * streaming with the plain loop on meshes past the last level cache */
+enum {
+    KERNEL_SCALAR = 0,
+    KERNEL_SIMD,
+    KERNEL_STREAM,
+    KERNEL_AUTO
+};
+
+typedef struct mesh_t {
+    /* mesh size in x and y */
+    uint64_t nx, ny;
+    /* cells from the start of one row to the start of the next */
+    uint64_t pitch;
+    /* MESH_DOUBLE or MESH_FLOAT */
+    int type;
+    /* mesh cells, nz planes of nx rows of pitch cells, if double */
+    double *data;
+    /* row pointers into data, plane after plane */
+    double **cells;
+    /* the same if float, data and cells being NULL */
+    float *fdata;
+    float **fcells;
+    /* planes in z, 1 for a 2-D mesh, and cells from the start of one plane
+     * to the start of the next */
+    uint64_t nz, plane;
+} mesh_t;
+
+/* simulation parameters */
+typedef struct simulation_params_t {
+    /* mesh size in x and y */
+    uint64_t n;
+    /* thermal conductivity */
+    double c;
+    double delta_s;
+    /* time interval */
+    double delta_t;
+    /* max simulation time */
+    uint64_t max_t;
+    /* steps and rows per tile, see T_BLOCK and ROW_BLOCK */
+    uint64_t t_block, row_block;
+    /* whether to report progress */
+    bool verbose;
+    /* stop early once a step changes no cell by more than tol, checked every
+     * check_every steps; 0 for either always runs every step */
+    double tol;
+    uint64_t check_every;
+    /* whether steps are backward Euler, stable for any delta_t, instead of
+     * explicit; double precision only */
+    bool implicit;
+    /* PREC_DOUBLE, PREC_FLOAT or PREC_MIXED */
+    int precision;
+    /* 2 for an n by n mesh, or 3 for an n by n by n one, see params_set_dims */
+    int dims;
+} simulation_params_t;
+
+/* the heat source cells, row by row, or plane by plane in 3-D */
+typedef struct source_t {
+    /* row i's cells are col[row[i]] to col[row[i + 1] - 1]; in 3-D, plane
+     * i's, each col being the cell's offset from the start of the plane */
+    uint64_t *row;
+    uint64_t *col;
+    /* their values */
+    double *val;
+} source_t;
+
+/* a row kernel: one step of rows [lo, hi) from old_mesh into new_mesh,
+ * reimposing the heat source cells in them, or of planes [lo, hi) for a 3-D
+ * mesh. Both engines run their steps through one, which may be called for
+ * different rows at once. */
+typedef void (*rows_kernel_t)(mesh_t *new_mesh,
+                              const mesh_t *old_mesh,
+                              const source_t *src,
+                              uint64_t lo,
+                              uint64_t hi,
+                              double cdtods2);
+
+/* the backward Euler solver's meshes */
+typedef struct implicit_t implicit_t;
+
+typedef struct simulation_t {
+    /* the meshes, old_mesh holding the even steps and new_mesh the odd */
+    mesh_t *old_mesh, *new_mesh;
+    /* simulation parameters */
+    simulation_params_t *params;
+    /* the constant heat source */
+    source_t *source;
+    /* steps taken */
+    uint64_t t;
+    /* the row kernel, step_rows or its float versions unless set */
+    rows_kernel_t kernel;
+    /* per tile progress of the blocked engine */
+    uint64_t *done;
+    /* the largest cell change of the last checked step, and whether it was
+     * within params->tol */
+    double delta;
+    bool converged;
+    /* the backward Euler solver, if params->implicit */
+    implicit_t *solver;
+} simulation_t;
+
+int
+params_construct(simulation_params_t **params);
+
+int
+params_destruct(simulation_params_t *params);
+
+int
+init_params(simulation_params_t *params,
+            uint64_t n,
+            double c,
+            uint64_t max_t,
+            uint64_t t_block,
+            uint64_t row_block,
+            bool verbose);
+
+/* make params 2-D or 3-D, with the largest stable explicit delta_t of that,
+ * delta_s^2 / (2 dims c) */
+int
+params_set_dims(simulation_params_t *params, int dims);
+
+/* a zeroed mesh of doubles */
+int
+mesh_construct(mesh_t **new_mesh,
+               int x /* number of rows */,
+               int y /* number of columns */);
+
+/* a zeroed mesh of type cells */
+int
+mesh_construct_type(mesh_t **new_mesh,
+                    int x /* number of rows */,
+                    int y /* number of columns */,
+                    int type);
+
+/* a zeroed 3-D mesh of type cells, z planes of x by y, or a 2-D one if z
+ * is 1 */
+int
+mesh_construct_3d(mesh_t **new_mesh,
+                  int x,
+                  int y,
+                  int z,
+                  int type);
+
+int
+mesh_destruct(mesh_t *mesh);
+
+/* copy the cells of from to to, a mesh of the same size and type */
+int
+mesh_copy(mesh_t *to, const mesh_t *from);
+
+/* the largest difference between the cells of two meshes of the same size,
+ * of either type */
+int
+mesh_max_diff(const mesh_t *a, const mesh_t *b, double *diff);
+
+int
+mesh_write(const mesh_t *mesh, const char *path, int format);
+
+/* the largest npy_header */
+#define NPY_HEADER_MAX 128
+
+/* put the .npy header of an nx by ny array of type cells in hdr and return
+ * its length */
+int
+npy_header(char hdr[NPY_HEADER_MAX], uint64_t nx, uint64_t ny, int type);
+
+/* the heat source of a gnx by gny mesh, restricted to its nx by ny window
+ * starting at cell (wx, wy), which may reach past the mesh; rows and
+ * columns count from the window */
+int
+source_construct(source_t **new_src,
+                 uint64_t gnx,
+                 uint64_t gny,
+                 int64_t wx,
+                 int64_t wy,
+                 uint64_t nx,
+                 uint64_t ny);
+
+/* the heat source of an n by n by n mesh whose rows are pitch cells apart,
+ * a spherical shell as set_initial_conds draws a circle */
+int
+source_construct_3d(source_t **new_src,
+                    uint64_t n,
+                    uint64_t pitch);
+
+int
+source_destruct(source_t *src);
+
+/* a simulation of params at step 0, the heat source in place; a 3-D one
+ * must be explicit and in double precision */
+int
+simulation_construct(simulation_t **new_sim,
+                     const simulation_params_t *params);
+
+int
+simulation_destruct(simulation_t *sim);
+
+/* advance sim nsteps steps: backward Euler ones if params->implicit, else
+ * with the plain loop if params->t_block is 0 and the temporally blocked
+ * engine otherwise. With params->tol set, stop early
+ * once sim->converged, which sim->t then tells */
+int
+simulation_step(simulation_t *sim, uint64_t nsteps);
+
+/* the mesh after sim->t steps, not a copy */
+mesh_t *
+simulation_mesh(simulation_t *sim);
+
+/* run kernel instead of step_rows from now on */
+int
+simulation_set_kernel(simulation_t *sim, rows_kernel_t kernel);
+
+/* the row kernel of type for sim on this CPU, naming it in name unless
+ * NULL, for simulation_set_kernel. Without AVX2 the vector ones are the
+ * scalar one; NULL if they were asked for and sim is not 2-D in double
+ * precision */
+rows_kernel_t
+simulation_kernel(const simulation_t *sim, int type, const char **name);
+
+/* a backward Euler solver for an n by n mesh with heat source src */
+int
+implicit_construct(implicit_t **new_imp,
+                   uint64_t n,
+                   const source_t *src);
+
+int
+implicit_destruct(implicit_t *imp);
+
+/* one backward Euler step from old_mesh into new_mesh, r being
+ * c * delta_t / delta_s^2, by preconditioned CG; its iterations and final
+ * relative residual go to iters and resid unless NULL */
+int
+implicit_step(implicit_t *imp,
+              mesh_t *new_mesh,
+              const mesh_t *old_mesh,
+              double r,
+              uint64_t *iters,
+              double *resid);
+
+/* the scalar row kernel */
+void
+step_rows(mesh_t *new_mesh,
+          const mesh_t *old_mesh,
+          const source_t *src,
+          uint64_t lo,
+          uint64_t hi,
+          double cdtods2);
+
+/* the same for float meshes, updating in float */
+void
+step_rows_float(mesh_t *new_mesh,
+                const mesh_t *old_mesh,
+                const source_t *src,
+                uint64_t lo,
+                uint64_t hi,
+                double cdtods2);
+
+/* and updating in double */
+void
+step_rows_mixed(mesh_t *new_mesh,
+                const mesh_t *old_mesh,
+                const source_t *src,
+                uint64_t lo,
+                uint64_t hi,
+                double cdtods2);
+
+/* the 7-point one for the planes [lo, hi) of a 3-D double mesh */
+void
+step_rows_3d(mesh_t *new_mesh,
+             const mesh_t *old_mesh,
+             const source_t *src,
+             uint64_t lo,
+             uint64_t hi,
+             double cdtods2);
+
+#endif
@@ -0,0 +1,436 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* Backward Euler steps for heat-tx, after the CG and multigrid of HPCG */
+
+/* what we are solving
+ *
+ * (1 + 4r) u'_ij - r (u'_i-1j + u'_i+1j + u'_ij-1 + u'_ij+1) = u_ij,
+ * r = c * delta_t / delta_s^2
+ *
+ * for the new mesh u' of every cell but the heat source's, which keep their
+ * values, and the mesh edges, which stay at 0. Moving the source cells' terms
+ * to the right-hand side leaves a symmetric positive definite system in the
+ * other cells, stable for any delta_t. It is solved without a matrix by CG,
+ * preconditioned with one multigrid V-cycle as in HPCG: a symmetric
+ * Gauss-Seidel sweep, the residual moved to a mesh of half the cells a side,
+ * the same done there, its correction moved back and a second sweep. Where
+ * HPCG injects both ways, the residual is averaged over the fine cells
+ * around a coarse one and the correction interpolated bilinearly, which
+ * keeps CG iterations down when delta_t is far past the explicit limit.
+ * Only the finest level holds the source cells: a coarse mesh cannot
+ * resolve their one cell thick ring, and dropping it there costs fewer
+ * iterations than coarsening it. The correction is masked when it comes
+ * back, so the source cells' stays 0 and the cycle stays symmetric.
+ * The sweeps go red cells, black, red again so the cells of a color can be
+ * updated by many threads; that order is its own reverse, which keeps the
+ * preconditioner symmetric. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "heattx.h"
+
+/* most meshes in the V-cycle, the finest included; they stop at a few
+ * cells a side */
+#define MG_LEVELS 16
+/* symmetric Gauss-Seidel sweeps on the coarsest mesh */
+#define MG_COARSE_SWEEPS 4
+/* CG stops when the residual is this much smaller than at the start */
+#define CG_TOL 1e-10
+/* or after this many iterations */
+#define CG_MAX_ITERS 100
+
+typedef struct mg_level_t {
+    /* cells a side, the edges included */
+    uint64_t n;
+    /* c * delta_t / delta_s^2 for this level's cell size */
+    double r;
+    /* 1 for the cells solved for, 0 for the edges and the source */
+    mesh_t *mask;
+    /* the right-hand side and solution of the coarser levels, and the
+     * residual */
+    mesh_t *b, *x, *ax;
+} mg_level_t;
+
+struct implicit_t {
+    int nlevels;
+    mg_level_t level[MG_LEVELS];
+    /* the CG vectors on the finest level */
+    mesh_t *b, *res, *z, *p, *ap;
+};
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* y = A x on level lev */
+static void
+apply(const mg_level_t *lev, const mesh_t *x, mesh_t *y)
+{
+    const double diag = 1.0 + 4.0 * lev->r, r = lev->r;
+    const int64_t n = lev->n;
+    int64_t i, j;
+
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        const double *m = lev->mask->cells[i];
+        const double *mp = lev->mask->cells[i - 1];
+        const double *mn = lev->mask->cells[i + 1];
+        const double *xi = x->cells[i];
+        const double *xp = x->cells[i - 1];
+        const double *xn = x->cells[i + 1];
+        double *yi = y->cells[i];
+
+        for (j = 1; j < n - 1; ++j) {
+            double ax = diag * xi[j] - r * (mp[j] * xp[j] + mn[j] * xn[j] +
+                                            m[j - 1] * xi[j - 1] +
+                                            m[j + 1] * xi[j + 1]);
+            yi[j] = (0.0 != m[j]) ? ax : xi[j];
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* Gauss-Seidel for the cells of one color, i + j even or odd */
+static void
+sweep_color(const mg_level_t *lev, const mesh_t *b, mesh_t *x, int color)
+{
+    const double diag = 1.0 + 4.0 * lev->r, r = lev->r;
+    const int64_t n = lev->n;
+    int64_t i, j;
+
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        const double *m = lev->mask->cells[i];
+        const double *mp = lev->mask->cells[i - 1];
+        const double *mn = lev->mask->cells[i + 1];
+        const double *bi = b->cells[i];
+        const double *xp = x->cells[i - 1];
+        const double *xn = x->cells[i + 1];
+        double *xi = x->cells[i];
+
+        for (j = 1 + (i + 1 + color) % 2; j < n - 1; j += 2) {
+            if (0.0 == m[j]) {
+                xi[j] = bi[j];
+                continue;
+            }
+            xi[j] = (bi[j] + r * (mp[j] * xp[j] + mn[j] * xn[j] +
+                                  m[j - 1] * xi[j - 1] +
+                                  m[j + 1] * xi[j + 1])) / diag;
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+symgs(const mg_level_t *lev, const mesh_t *b, mesh_t *x)
+{
+    sweep_color(lev, b, x, 0);
+    sweep_color(lev, b, x, 1);
+    sweep_color(lev, b, x, 0);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+zero(mesh_t *x)
+{
+    (void)memset(x->data, 0, x->nx * x->pitch * sizeof(double));
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* x = M^-1 b, one V-cycle from level l down, x starting at 0 */
+static void
+vcycle(implicit_t *imp, int l, const mesh_t *b, mesh_t *x)
+{
+    mg_level_t *lev = &imp->level[l], *coarse;
+    const int64_t n = lev->n;
+    int64_t i, j, nc;
+    int s;
+
+    zero(x);
+    if (l == imp->nlevels - 1) {
+        for (s = 0; s < MG_COARSE_SWEEPS; ++s) symgs(lev, b, x);
+        return;
+    }
+    coarse = &imp->level[l + 1];
+    nc = coarse->n;
+    symgs(lev, b, x);
+    apply(lev, x, lev->ax);
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        for (j = 1; j < n - 1; ++j) {
+            lev->ax->cells[i][j] = b->cells[i][j] - lev->ax->cells[i][j];
+        }
+    }
+    /* coarse cell (i, j) sits on fine cell (2i, 2j): full weighting */
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < nc - 1; ++i) {
+        const double *rp = lev->ax->cells[2 * i - 1];
+        const double *ri = lev->ax->cells[2 * i];
+        const double *rn = lev->ax->cells[2 * i + 1];
+
+        for (j = 1; j < nc - 1; ++j) {
+            int64_t f = 2 * j;
+            coarse->b->cells[i][j] =
+                0.25 * ri[f] +
+                0.125 * (rp[f] + rn[f] + ri[f - 1] + ri[f + 1]) +
+                0.0625 * (rp[f - 1] + rp[f + 1] + rn[f - 1] + rn[f + 1]);
+        }
+    }
+    vcycle(imp, l + 1, coarse->b, coarse->x);
+    /* and bilinear interpolation, the transpose up to a factor of 4 */
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        const double *c0 = coarse->x->cells[i / 2];
+        const double *c1 = coarse->x->cells[(i + 1) / 2];
+        const double *m = lev->mask->cells[i];
+        double *xi = x->cells[i];
+
+        for (j = 1; j < n - 1; ++j) {
+            xi[j] += m[j] * 0.25 * (c0[j / 2] + c0[(j + 1) / 2] +
+                                    c1[j / 2] + c1[(j + 1) / 2]);
+        }
+    }
+    symgs(lev, b, x);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static double
+dot(const mg_level_t *lev, const mesh_t *x, const mesh_t *y)
+{
+    const int64_t n = lev->n;
+    int64_t i, j;
+    double sum = 0.0;
+
+#pragma omp parallel for schedule(static) private(j) reduction(+:sum)
+    for (i = 1; i < n - 1; ++i) {
+        for (j = 1; j < n - 1; ++j) sum += x->cells[i][j] * y->cells[i][j];
+    }
+    return sum;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* y = a * x + y */
+static void
+axpy(const mg_level_t *lev, double a, const mesh_t *x, mesh_t *y)
+{
+    const int64_t n = lev->n;
+    int64_t i, j;
+
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        for (j = 1; j < n - 1; ++j) y->cells[i][j] += a * x->cells[i][j];
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+implicit_destruct(implicit_t *imp)
+{
+    int l;
+
+    if (!imp) return FAILURE_INVALID_ARG;
+    for (l = 0; l < imp->nlevels; ++l) {
+        (void)mesh_destruct(imp->level[l].mask);
+        (void)mesh_destruct(imp->level[l].b);
+        (void)mesh_destruct(imp->level[l].x);
+        (void)mesh_destruct(imp->level[l].ax);
+    }
+    (void)mesh_destruct(imp->b);
+    (void)mesh_destruct(imp->res);
+    (void)mesh_destruct(imp->z);
+    (void)mesh_destruct(imp->p);
+    (void)mesh_destruct(imp->ap);
+    free(imp);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+implicit_construct(implicit_t **new_imp,
+                   uint64_t n,
+                   const source_t *src)
+{
+    int rc = FAILURE;
+    implicit_t *imp = NULL;
+    mg_level_t *lev;
+    uint64_t i, j, k;
+    int l;
+
+    if (NULL == new_imp || NULL == src || n < 3) return FAILURE_INVALID_ARG;
+    if (NULL == (imp = calloc(1, sizeof(*imp)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    /* halve the interior while it stays a few cells a side */
+    for (l = 0; l < MG_LEVELS; ++l) {
+        lev = &imp->level[l];
+        lev->n = (0 == l) ? n : (imp->level[l - 1].n - 2) / 2 + 2;
+        if (l > 0 && lev->n < 2 + 3) break;
+        imp->nlevels = l + 1;
+        if (SUCCESS != (rc = mesh_construct(&lev->mask, lev->n, lev->n)) ||
+            SUCCESS != (rc = mesh_construct(&lev->ax, lev->n, lev->n))) {
+            goto out;
+        }
+        if (l > 0 &&
+            (SUCCESS != (rc = mesh_construct(&lev->b, lev->n, lev->n)) ||
+             SUCCESS != (rc = mesh_construct(&lev->x, lev->n, lev->n)))) {
+            goto out;
+        }
+    }
+    if (SUCCESS != (rc = mesh_construct(&imp->b, n, n)) ||
+        SUCCESS != (rc = mesh_construct(&imp->res, n, n)) ||
+        SUCCESS != (rc = mesh_construct(&imp->z, n, n)) ||
+        SUCCESS != (rc = mesh_construct(&imp->p, n, n)) ||
+        SUCCESS != (rc = mesh_construct(&imp->ap, n, n))) {
+        goto out;
+    }
+    /* every cell but the edges, and on the finest level but the source */
+    for (l = 0; l < imp->nlevels; ++l) {
+        lev = &imp->level[l];
+        for (i = 1; i < lev->n - 1; ++i) {
+            for (j = 1; j < lev->n - 1; ++j) lev->mask->cells[i][j] = 1.0;
+        }
+    }
+    lev = &imp->level[0];
+    for (i = 1; i < n - 1; ++i) {
+        for (k = src->row[i]; k < src->row[i + 1]; ++k) {
+            lev->mask->cells[i][src->col[k]] = 0.0;
+        }
+    }
+    *new_imp = imp;
+    rc = SUCCESS;
+out:
+    if (SUCCESS != rc) (void)implicit_destruct(imp);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+implicit_step(implicit_t *imp,
+              mesh_t *new_mesh,
+              const mesh_t *old_mesh,
+              double r,
+              uint64_t *iters,
+              double *resid)
+{
+    mg_level_t *lev;
+    const mesh_t *mask;
+    int64_t n, i, j;
+    uint64_t k;
+    double rtz = 0.0, old_rtz, alpha, normr, normr0;
+    int l;
+
+    if (NULL == imp || NULL == new_mesh || NULL == old_mesh) {
+        return FAILURE_INVALID_ARG;
+    }
+    lev = &imp->level[0];
+    mask = lev->mask;
+    n = lev->n;
+    for (l = 0; l < imp->nlevels; ++l) {
+        imp->level[l].r = r;
+        r /= 4.0;
+    }
+    r = lev->r;
+
+    /* the old mesh, plus the source cells' terms, is the right-hand side
+     * and the first guess */
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        const double *m = mask->cells[i];
+        const double *mp = mask->cells[i - 1];
+        const double *mn = mask->cells[i + 1];
+        const double *u = old_mesh->cells[i];
+        const double *up = old_mesh->cells[i - 1];
+        const double *un = old_mesh->cells[i + 1];
+
+        for (j = 1; j < n - 1; ++j) {
+            double fixed = (1.0 - mp[j]) * up[j] + (1.0 - mn[j]) * un[j] +
+                           (1.0 - m[j - 1]) * u[j - 1] +
+                           (1.0 - m[j + 1]) * u[j + 1];
+            imp->b->cells[i][j] = (0.0 != m[j]) ? u[j] + r * fixed : u[j];
+        }
+    }
+    (void)memcpy(new_mesh->data, old_mesh->data,
+                 n * old_mesh->pitch * sizeof(double));
+
+    apply(lev, new_mesh, imp->ap);
+#pragma omp parallel for schedule(static) private(j)
+    for (i = 1; i < n - 1; ++i) {
+        for (j = 1; j < n - 1; ++j) {
+            imp->res->cells[i][j] = imp->b->cells[i][j] - imp->ap->cells[i][j];
+        }
+    }
+    normr = normr0 = sqrt(dot(lev, imp->res, imp->res));
+
+    for (k = 0; k < CG_MAX_ITERS && normr > CG_TOL * normr0; ++k) {
+        vcycle(imp, 0, imp->res, imp->z);
+        old_rtz = rtz;
+        rtz = dot(lev, imp->res, imp->z);
+        if (0 == k) {
+            (void)memcpy(imp->p->data, imp->z->data,
+                         n * imp->z->pitch * sizeof(double));
+        }
+        else {
+            double beta = rtz / old_rtz;
+#pragma omp parallel for schedule(static) private(j)
+            for (i = 1; i < n - 1; ++i) {
+                for (j = 1; j < n - 1; ++j) {
+                    imp->p->cells[i][j] = imp->z->cells[i][j] +
+                                          beta * imp->p->cells[i][j];
+                }
+            }
+        }
+        apply(lev, imp->p, imp->ap);
+        alpha = rtz / dot(lev, imp->p, imp->ap);
+        axpy(lev, alpha, imp->p, new_mesh);
+        axpy(lev, -alpha, imp->ap, imp->res);
+        normr = sqrt(dot(lev, imp->res, imp->res));
+    }
+    if (NULL != iters) *iters = k;
+    if (NULL != resid) *resid = (normr0 > 0.0) ? normr / normr0 : 0.0;
+    return SUCCESS;
+}
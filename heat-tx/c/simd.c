@@ -0,0 +1,301 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* Row kernels for heat-tx in AVX2 and AVX-512 intrinsics, picked for the CPU
+ * at run time */
+
+/* An explicit step writes every cell of new_mesh once and reads none of it
+ * before the swap, yet each store first reads its cache line into cache.
+ * The stream kernels store the rows with non-temporal stores instead, which
+ * go to memory without that read, saving a third of the traffic of a mesh
+ * too large for cache. In cache they are slower, as the next step then reads
+ * the rows back from memory, so they only pay with the plain loop on a mesh
+ * past the last level cache, which is what KERNEL_AUTO checks.
+ *
+ * The rows are MESH_ALIGN aligned, so after the cells up to the first line
+ * boundary, done one at a time, every vector load of the row above, the row
+ * below and the cell itself is aligned, and the stores fill whole lines. The
+ * left and right neighbors are unaligned loads. The sums are in the order of
+ * step_rows, which they match but for the compiler's contractions. */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "heattx.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86 1
+#endif
+
+/* last level cache bytes if the system does not say */
+#define LLC_BYTES (32 << 20)
+
+#ifdef HAVE_X86
+/* ////////////////////////////////////////////////////////////////////////// */
+/* one cell as step_rows does it */
+static inline double
+cell(const double *oci,
+     const double *ocip,
+     const double *ocin,
+     uint64_t j,
+     double cdtods2)
+{
+    return oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 * oci[j] +
+                                oci[j + 1] + oci[j - 1]));
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the heat source cells of row i; after non-temporal stores to the row they
+ * are fenced first, so the source's stores land after them */
+static inline void
+reimpose(double *nci, const source_t *src, uint64_t i, bool stream)
+{
+    uint64_t k;
+
+    if (src->row[i] == src->row[i + 1]) return;
+    if (stream) _mm_sfence();
+    for (k = src->row[i]; k < src->row[i + 1]; ++k) {
+        nci[src->col[k]] = src->val[k];
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+__attribute__((target("avx2"), always_inline))
+static inline void
+rows_avx2(mesh_t *new_mesh,
+          const mesh_t *old_mesh,
+          const source_t *src,
+          uint64_t lo,
+          uint64_t hi,
+          double cdtods2,
+          bool stream)
+{
+    const uint64_t line = MESH_ALIGN / sizeof(double);
+    uint64_t i, j;
+    uint64_t ny = old_mesh->ny;
+    uint64_t pitch = old_mesh->pitch;
+    const __m256d c = _mm256_set1_pd(cdtods2);
+    const __m256d four = _mm256_set1_pd(4.0);
+    double *nci;
+    const double *oci, *ocip, *ocin;
+
+    for (i = lo; i < hi; ++i) {
+        nci =  new_mesh->data + i * pitch;
+        oci =  old_mesh->data + i * pitch;
+        ocip = oci - pitch;
+        ocin = oci + pitch;
+        for (j = 1; j < line && j < ny - 1; ++j) {
+            nci[j] = cell(oci, ocip, ocin, j, cdtods2);
+        }
+        for (; j + 4 <= ny - 1; j += 4) {
+            __m256d o = _mm256_load_pd(oci + j);
+            __m256d s = _mm256_add_pd(_mm256_load_pd(ocin + j),
+                                      _mm256_load_pd(ocip + j));
+            s = _mm256_sub_pd(s, _mm256_mul_pd(four, o));
+            s = _mm256_add_pd(s, _mm256_loadu_pd(oci + j + 1));
+            s = _mm256_add_pd(s, _mm256_loadu_pd(oci + j - 1));
+            s = _mm256_add_pd(o, _mm256_mul_pd(c, s));
+            if (stream) _mm256_stream_pd(nci + j, s);
+            else _mm256_store_pd(nci + j, s);
+        }
+        for (; j < ny - 1; ++j) {
+            nci[j] = cell(oci, ocip, ocin, j, cdtods2);
+        }
+        reimpose(nci, src, i, stream);
+    }
+    /* the rows are read by other threads after this */
+    if (stream) _mm_sfence();
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+__attribute__((target("avx512f"), always_inline))
+static inline void
+rows_avx512(mesh_t *new_mesh,
+            const mesh_t *old_mesh,
+            const source_t *src,
+            uint64_t lo,
+            uint64_t hi,
+            double cdtods2,
+            bool stream)
+{
+    const uint64_t line = MESH_ALIGN / sizeof(double);
+    uint64_t i, j;
+    uint64_t ny = old_mesh->ny;
+    uint64_t pitch = old_mesh->pitch;
+    const __m512d c = _mm512_set1_pd(cdtods2);
+    const __m512d four = _mm512_set1_pd(4.0);
+    double *nci;
+    const double *oci, *ocip, *ocin;
+
+    for (i = lo; i < hi; ++i) {
+        nci =  new_mesh->data + i * pitch;
+        oci =  old_mesh->data + i * pitch;
+        ocip = oci - pitch;
+        ocin = oci + pitch;
+        for (j = 1; j < line && j < ny - 1; ++j) {
+            nci[j] = cell(oci, ocip, ocin, j, cdtods2);
+        }
+        for (; j + 8 <= ny - 1; j += 8) {
+            __m512d o = _mm512_load_pd(oci + j);
+            __m512d s = _mm512_add_pd(_mm512_load_pd(ocin + j),
+                                      _mm512_load_pd(ocip + j));
+            s = _mm512_sub_pd(s, _mm512_mul_pd(four, o));
+            s = _mm512_add_pd(s, _mm512_loadu_pd(oci + j + 1));
+            s = _mm512_add_pd(s, _mm512_loadu_pd(oci + j - 1));
+            s = _mm512_add_pd(o, _mm512_mul_pd(c, s));
+            if (stream) _mm512_stream_pd(nci + j, s);
+            else _mm512_store_pd(nci + j, s);
+        }
+        for (; j < ny - 1; ++j) {
+            nci[j] = cell(oci, ocip, ocin, j, cdtods2);
+        }
+        reimpose(nci, src, i, stream);
+    }
+    if (stream) _mm_sfence();
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the rows_kernel_t versions, each with its stores fixed */
+__attribute__((target("avx2")))
+static void
+step_rows_avx2(mesh_t *new_mesh, const mesh_t *old_mesh, const source_t *src,
+               uint64_t lo, uint64_t hi, double cdtods2)
+{
+    rows_avx2(new_mesh, old_mesh, src, lo, hi, cdtods2, false);
+}
+
+__attribute__((target("avx2")))
+static void
+step_rows_avx2_stream(mesh_t *new_mesh, const mesh_t *old_mesh,
+                      const source_t *src, uint64_t lo, uint64_t hi,
+                      double cdtods2)
+{
+    rows_avx2(new_mesh, old_mesh, src, lo, hi, cdtods2, true);
+}
+
+__attribute__((target("avx512f")))
+static void
+step_rows_avx512(mesh_t *new_mesh, const mesh_t *old_mesh,
+                 const source_t *src, uint64_t lo, uint64_t hi,
+                 double cdtods2)
+{
+    rows_avx512(new_mesh, old_mesh, src, lo, hi, cdtods2, false);
+}
+
+__attribute__((target("avx512f")))
+static void
+step_rows_avx512_stream(mesh_t *new_mesh, const mesh_t *old_mesh,
+                        const source_t *src, uint64_t lo, uint64_t hi,
+                        double cdtods2)
+{
+    rows_avx512(new_mesh, old_mesh, src, lo, hi, cdtods2, true);
+}
+#endif
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* bytes of the last level cache */
+static uint64_t
+llc_bytes(void)
+{
+    long bytes = 0;
+
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    bytes = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (bytes <= 0) bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+    return (bytes > 0) ? (uint64_t)bytes : LLC_BYTES;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+rows_kernel_t
+simulation_kernel(const simulation_t *sim, int type, const char **name)
+{
+    const char *unused;
+    const mesh_t *mesh;
+
+    if (NULL == sim) return NULL;
+    if (NULL == name) name = &unused;
+    mesh = sim->old_mesh;
+    /* the vector kernels are for 2-D double meshes, the best for the others
+     * being the scalar one */
+    if (KERNEL_AUTO == type &&
+        (MESH_DOUBLE != mesh->type || mesh->nz > 1)) {
+        type = KERNEL_SCALAR;
+    }
+    if (KERNEL_SCALAR == type) {
+        *name = "scalar";
+        switch (sim->params->precision) {
+        case PREC_FLOAT: return step_rows_float;
+        case PREC_MIXED: return step_rows_mixed;
+        default: return (mesh->nz > 1) ? step_rows_3d : step_rows;
+        }
+    }
+    if (MESH_DOUBLE != mesh->type || mesh->nz > 1) return NULL;
+    if (KERNEL_AUTO == type) {
+        /* both meshes pass through the cache every step */
+        type = (0 == sim->params->t_block &&
+                2 * mesh->nx * mesh->pitch * sizeof(double) > llc_bytes()) ?
+               KERNEL_STREAM : KERNEL_SIMD;
+    }
+#ifdef HAVE_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        *name = (KERNEL_STREAM == type) ? "avx512 stream" : "avx512";
+        return (KERNEL_STREAM == type) ? step_rows_avx512_stream
+                                       : step_rows_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        *name = (KERNEL_STREAM == type) ? "avx2 stream" : "avx2";
+        return (KERNEL_STREAM == type) ? step_rows_avx2_stream
+                                       : step_rows_avx2;
+    }
+#endif
+    /* what the compiler makes of the scalar one */
+    *name = "scalar";
+    return step_rows;
+}
@@ -46,6 +46,9 @@
 // To Build:
 // go build heat-tx.go
 
+// To Run (the same options as the C version):
+// ./heat-tx -n 512 -s 1024 -c 0.6 -p 4
+
 // To Profile:
 // Build
 // ./heat-tx -cpuprofile=heat-tx.prof
@@ -63,7 +66,10 @@ import (
     "bufio"
     "os"
     "log"
+    "runtime"
     "runtime/pprof"
+    "sync"
+    "time"
 )
 
 // Application constants
@@ -96,6 +102,8 @@ type SimParams struct {
     deltaT float64
     // Max sim iterations
     tMax uint64
+    // Goroutines stepping the rows
+    nThreads int
 }
 
 type HeatTxSim struct {
@@ -119,11 +127,13 @@ func NewMesh(x, y uint64) *Mesh {
 
 // NewSimParams returns a new set of initialized simulation parameters based on
 // the provided input.
-func NewSimParams(nx uint64, thermCond float64, tMax uint64) *SimParams {
+func NewSimParams(nx uint64, thermCond float64, tMax uint64,
+                  nThreads int) *SimParams {
     fmt.Println("o initializing simulation parameters...")
     ds := 1.0 / (float64(nx) + 1.0)
     dt := (ds * ds) / (4.0 * thermCond)
-    sp := &SimParams{c: thermCond, deltaS: ds, deltaT: dt, tMax: tMax}
+    sp := &SimParams{c: thermCond, deltaS: ds, deltaT: dt, tMax: tMax,
+                     nThreads: nThreads}
     fmt.Print(sp)
     return sp
 }
@@ -131,6 +141,7 @@ func NewSimParams(nx uint64, thermCond float64, tMax uint64) *SimParams {
 // Nice SimParams printing
 func (p *SimParams) String() string {
     pStr := ""
+    pStr += fmt.Sprintf(". threads: %d\n", p.nThreads)
     pStr += fmt.Sprintf(". max_t: %d\n", p.tMax)
     pStr += fmt.Sprintf(". c: %f\n", p.c)
     pStr += fmt.Sprintf(". delta_s: %f\n", p.deltaS)
@@ -151,8 +162,9 @@ func (m *Mesh) String() string {
     return mStr
 }
 
-func NewHeatTxSim(x, y uint64,  thermCond float64, tMax uint64) *HeatTxSim {
-    return &HeatTxSim{params: NewSimParams(x, thermCond, tMax),
+func NewHeatTxSim(x, y uint64,  thermCond float64, tMax uint64,
+                  nThreads int) *HeatTxSim {
+    return &HeatTxSim{params: NewSimParams(x, thermCond, tMax, nThreads),
                       newMesh: NewMesh(x, y), oldMesh: NewMesh(x, y)}
 }
 
@@ -182,7 +194,21 @@ func (m *Mesh) SetInitConds() {
     }
 }
 
-// Runs the simulation
+// Updates rows [lo, hi) of newMesh from oldMesh
+func stepRows(newMesh, oldMesh *Mesh, lo, hi, ny int, cdtods2 float64) {
+    for i := lo; i < hi; i++ {
+        nci := newMesh.cells[i]
+        oci := oldMesh.cells[i]
+        ocip := oldMesh.cells[i - 1]
+        ocin := oldMesh.cells[i + 1]
+        for j := 1; j < ny; j++ {
+            nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
+                               oci[j] + oci[j + 1] + oci[j - 1]))
+        }
+    }
+}
+
+// Runs the simulation, each step's rows split in nThreads contiguous blocks
 func (s *HeatTxSim) Run() {
     nx := len(s.oldMesh.cells) - 1
     ny := len(s.oldMesh.cells[0]) - 1
@@ -191,22 +217,25 @@ func (s *HeatTxSim) Run() {
     tMax := s.params.tMax;
     newMesh := s.newMesh
     oldMesh := s.oldMesh
+    nThreads := s.params.nThreads
+    span := (nx - 1 + nThreads - 1) / nThreads
+    var wg sync.WaitGroup
 
     fmt.Println("o starting simulation...")
     for t := uint64(0); t < tMax; t++ {
         if t % 100 == 0 {
             fmt.Println(". starting iteration", t, "of", tMax)
         }
-        for i := 1; i < nx; i++ {
-            nci := newMesh.cells[i]
-            oci := oldMesh.cells[i]
-            ocip := oldMesh.cells[i - 1]
-            ocin := oldMesh.cells[i + 1]
-            for j := 1; j < ny; j++ {
-                nci[j] = oci[j] + (cdtods2 * (ocin[j] + ocip[j] - 4.0 *
-                                   oci[j] + oci[j + 1] + oci[j - 1]))
-            }
+        for lo := 1; lo < nx; lo += span {
+            hi := lo + span
+            if hi > nx { hi = nx }
+            wg.Add(1)
+            go func(lo, hi int) {
+                defer wg.Done()
+                stepRows(newMesh, oldMesh, lo, hi, ny, cdtods2)
+            }(lo, hi)
         }
+        wg.Wait()
         // swap old and new - this is just a pointer swap
         oldMesh, newMesh = newMesh, oldMesh
         // Constant heat source
@@ -238,10 +267,32 @@ func (s *HeatTxSim) Dump() error {
 }
 
 
+// Prints the cell updates per second of secs seconds of stepping and the
+// memory bandwidth they imply, as the C version does
+func (s *HeatTxSim) ReportRate(secs float64) {
+    n := float64(s.oldMesh.nx)
+    updates := (n - 2) * (n - 2) * float64(s.params.tMax)
+    fmt.Printf("%10s %10s %12s %14s %10s\n", "n", "steps", "seconds",
+               "Mupdates/s", "GB/s")
+    fmt.Printf("%10d %10d %12.4f %14.2f %10.2f\n", s.oldMesh.nx,
+               s.params.tMax, secs, updates / secs * 1e-6,
+               updates * 2.0 * 8.0 / secs * 1e-9)
+}
+
 func main() {
     var cpuprofile = flag.String("cpuprofile", "", "write CPU profile to file")
+    var n = flag.Uint64("n", N, "mesh cells in x and y")
+    var tMax = flag.Uint64("s", TMax, "time steps")
+    var thermCond = flag.Float64("c", ThermCond, "thermal conductivity")
+    var nThreads = flag.Int("p", runtime.NumCPU(), "threads")
     // Parse user input
     flag.Parse()
+    // the heat source needs a few cells around it
+    if *n < 8 || *thermCond <= 0.0 || *nThreads < 1 || flag.NArg() != 0 {
+        flag.Usage()
+        os.Exit(1)
+    }
+    runtime.GOMAXPROCS(*nThreads)
     // Determine whther or not CPU profiling is on
     if *cpuprofile != "" {
         f, err := os.Create(*cpuprofile)
@@ -253,9 +304,13 @@ func main() {
     }
     // Let the games begin
     fmt.Println("o", AppName, AppVerStr)
-    sim := NewHeatTxSim(N, N, ThermCond, TMax)
+    sim := NewHeatTxSim(*n, *n, *thermCond, *tMax, *nThreads)
     sim.oldMesh.SetInitConds()
+    start := time.Now()
     sim.Run()
+    secs := time.Since(start).Seconds()
+    fmt.Println("o simulation done")
+    sim.ReportRate(secs)
     err := sim.Dump()
     if (err != nil) { panic(err) }
 }
@@ -64,16 +64,38 @@
 #include <stdbool.h>
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "heat-tx.h"
+#include "cody.h"
 
 static char *app_name = "ispc-heat-tx";
 static char *app_ver = "0.2";
 
+static const char *dump_ext[] = {"dat", "raw", "npy"};
+
+static const char *prec_name[] = {"double", "float", "mixed"};
+
+/* a copy of the mesh being written by a background thread */
+typedef struct {
+    mesh_t *mesh;
+    char path[64];
+    int format;
+    /* whether thread is writing, and how that went */
+    bool busy;
+    int rc;
+    pthread_t thread;
+} snapshot_t;
+
 /* static forward declarations */
 static int
 mesh_construct(mesh_t **new_mesh,
                int x /* number of rows */,
-               int y /* number of columns */);
+               int y /* number of columns */,
+               int type);
 
 static int
 mesh_destruct(mesh_t *mesh);
@@ -84,7 +106,7 @@ params_construct(simulation_params_t **params);
 static int
 params_destruct(simulation_params_t *params);
 
-int
+static int
 set_initial_conds(mesh_t *sim);
 
 extern int32_t
@@ -124,15 +146,31 @@ params_destruct(simulation_params_t *params)
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
+/* bytes per cell of mesh */
+static size_t
+cell_size(const mesh_t *mesh)
+{
+    return (MESH_FLOAT == mesh->type) ? sizeof(float) : sizeof(double);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* a zeroed mesh of type cells */
 static int
 mesh_construct(mesh_t **new_mesh,
                int x /* number of rows */,
-               int y /* number of columns */)
+               int y /* number of columns */,
+               int type)
 {
     mesh_t *tmp_mesh = NULL;
+    void *data = NULL;
+    char *rows;
+    uint64_t pitch;
+    size_t size;
     int i;
 
-    if (NULL == new_mesh) return FAILURE_INVALID_ARG;
+    if (NULL == new_mesh || (MESH_DOUBLE != type && MESH_FLOAT != type)) {
+        return FAILURE_INVALID_ARG;
+    }
 
     tmp_mesh = (mesh_t *)calloc(1, sizeof(*tmp_mesh));
     if (NULL == tmp_mesh) {
@@ -140,26 +178,51 @@ mesh_construct(mesh_t **new_mesh,
         /* just bail */
         return FAILURE_OOR;
     }
-    tmp_mesh->cells = (double **)calloc(x, sizeof(double *));
-    if (NULL == tmp_mesh->cells) {
+    tmp_mesh->type = type;
+    size = cell_size(tmp_mesh);
+    /* all the rows live in one aligned block, each padded so the next one
+     * starts on a MESH_ALIGN boundary */
+    pitch = (y * size + MESH_ALIGN - 1) / MESH_ALIGN * MESH_ALIGN / size;
+    /* left untouched, for the threads below to place its pages */
+    data = cody_alloc(x * pitch * size, MESH_ALIGN, CODY_FIRST_TOUCH);
+    if (NULL == data) {
         fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
         goto error;
     }
-    for (i = 0; i < y; ++i) {
-        tmp_mesh->cells[i] = (double *)calloc(y, sizeof(double));
-        if (NULL == tmp_mesh->cells[i]) {
-            fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
-            goto error;
-        }
+    rows = (char *)data;
+    if (MESH_FLOAT == type) tmp_mesh->fdata = (float *)data;
+    else tmp_mesh->data = (double *)data;
+    /* zero the rows on the threads that will update them, with the same
+     * static schedule, so each row's pages land on that thread's NUMA node */
+    (void)memset(rows, 0, pitch * size);
+    (void)memset(rows + (x - 1) * pitch * size, 0, pitch * size);
+#pragma omp parallel for schedule(static)
+    for (i = 1; i < x - 1; ++i) {
+        (void)memset(rows + i * pitch * size, 0, pitch * size);
+    }
+    /* row pointer view of the block */
+    if (MESH_FLOAT == type) {
+        tmp_mesh->fcells = (float **)calloc(x, sizeof(float *));
+    }
+    else {
+        tmp_mesh->cells = (double **)calloc(x, sizeof(double *));
+    }
+    if (NULL == tmp_mesh->cells && NULL == tmp_mesh->fcells) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        goto error;
+    }
+    for (i = 0; i < x; ++i) {
+        if (MESH_FLOAT == type) tmp_mesh->fcells[i] = tmp_mesh->fdata + i * pitch;
+        else tmp_mesh->cells[i] = tmp_mesh->data + i * pitch;
     }
     tmp_mesh->nx = x;
     tmp_mesh->ny = y;
+    tmp_mesh->pitch = pitch;
 
     *new_mesh = tmp_mesh;
     return SUCCESS;
 
 error:
-    if (NULL != tmp_mesh) free(tmp_mesh);
     mesh_destruct(tmp_mesh);
     return FAILURE_OOR;
 }
@@ -168,35 +231,27 @@ error:
 static int
 mesh_destruct(mesh_t *mesh)
 {
-    uint64_t i;
-
     if (!mesh) return FAILURE_INVALID_ARG;
-    if (mesh->cells) {
-        for (i = 0; i < mesh->ny; ++i) {
-            if (NULL != mesh->cells[i]) {
-                free(mesh->cells[i]);
-                mesh->cells[i] = NULL;
-            }
-        }
-        free(mesh->cells);
-        mesh->cells = NULL;
-    }
+    free(mesh->cells);
+    cody_free(mesh->data);
+    free(mesh->fcells);
+    cody_free(mesh->fdata);
     free(mesh);
     return SUCCESS;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
-gen_meshes(simulation_t *sim, uint64_t nx, uint64_t ny)
+gen_meshes(simulation_t *sim, uint64_t nx, uint64_t ny, int type)
 {
     int rc = FAILURE;
 
-    if (SUCCESS != (rc = mesh_construct(&sim->old_mesh, nx, ny))) {
+    if (SUCCESS != (rc = mesh_construct(&sim->old_mesh, nx, ny, type))) {
         fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
                 __LINE__);
         goto out;
     }
-    if (SUCCESS != (rc = mesh_construct(&sim->new_mesh, nx, ny))) {
+    if (SUCCESS != (rc = mesh_construct(&sim->new_mesh, nx, ny, type))) {
         fprintf(stderr, "\nmesh_construct failure @ %s:%d\n", __FILE__,
                 __LINE__);
         goto out;
@@ -205,16 +260,79 @@ out:
     if (SUCCESS != rc) {
         mesh_destruct(sim->new_mesh);
         mesh_destruct(sim->old_mesh);
+        sim->new_mesh = sim->old_mesh = NULL;
     }
     return rc;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+source_destruct(source_t *src)
+{
+    if (!src) return FAILURE_INVALID_ARG;
+    free(src->row);
+    free(src->col);
+    free(src->val);
+    free(src);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* rasterize the heat source into a scratch mesh and keep the cells it set,
+ * so it can be reimposed one row at a time */
+static int
+source_construct(source_t **new_src, uint64_t nx, uint64_t ny)
+{
+    int rc = FAILURE;
+    mesh_t *scratch = NULL;
+    source_t *src = NULL;
+    uint64_t i, j, n = 0;
+
+    if (NULL == new_src) return FAILURE_INVALID_ARG;
+
+    if (SUCCESS != (rc = mesh_construct(&scratch, nx, ny, MESH_DOUBLE))) {
+        return rc;
+    }
+    if (SUCCESS != (rc = set_initial_conds(scratch))) goto out;
+    /* every source value is positive, so the zeros are the other cells */
+    for (i = 0; i < nx; ++i) {
+        for (j = 0; j < ny; ++j) {
+            if (0.0 != scratch->cells[i][j]) ++n;
+        }
+    }
+    rc = FAILURE_OOR;
+    if (NULL == (src = calloc(1, sizeof(*src))) ||
+        NULL == (src->row = calloc(nx + 1, sizeof(uint64_t))) ||
+        NULL == (src->col = calloc(n + 1, sizeof(uint64_t))) ||
+        NULL == (src->val = calloc(n + 1, sizeof(double)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        (void)source_destruct(src);
+        goto out;
+    }
+    for (n = 0, i = 0; i < nx; ++i) {
+        src->row[i] = n;
+        for (j = 0; j < ny; ++j) {
+            if (0.0 != scratch->cells[i][j]) {
+                src->col[n] = j;
+                src->val[n++] = scratch->cells[i][j];
+            }
+        }
+    }
+    src->row[nx] = n;
+    *new_src = src;
+    rc = SUCCESS;
+out:
+    (void)mesh_destruct(scratch);
+    return rc;
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 simulation_destruct(simulation_t *sim)
 {
     if (!sim) return FAILURE_INVALID_ARG;
     (void)params_destruct(sim->params);
+    (void)source_destruct(sim->source);
     (void)mesh_destruct(sim->new_mesh);
     (void)mesh_destruct(sim->old_mesh);
     free(sim);
@@ -244,12 +362,20 @@ simulation_construct(simulation_t **new_sim,
                 __LINE__, rc);
         goto out;
     }
-    if (SUCCESS != (rc = gen_meshes(sim, N, N))) {
+    if (SUCCESS != (rc = gen_meshes(sim, params->n, params->n,
+                                    (PREC_DOUBLE == params->precision) ?
+                                    MESH_DOUBLE : MESH_FLOAT))) {
         fprintf(stderr, "gen_meshes failure @ %s:%d: rc = %d\n", __FILE__,
                 __LINE__, rc);
         /* on failure, gen_meshes cleans up after itself */
         goto out;
     }
+    if (SUCCESS != (rc = source_construct(&sim->source, params->n,
+                                          params->n))) {
+        fprintf(stderr, "source_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto out;
+    }
     *new_sim = sim;
 out:
     return rc;
@@ -258,56 +384,260 @@ out:
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
 init_params(simulation_params_t *params,
-            int n,
+            uint64_t n,
             double c,
-            int max_t)
+            uint64_t max_t,
+            bool verbose)
 {
     if (NULL == params) return FAILURE_INVALID_ARG;
 
-    printf("o initializing simulation parameters...\n");
+    params->verbose = verbose;
+    if (params->verbose) printf("o initializing simulation parameters...\n");
 
+    params->n = n;
     params->c = c;
     params->max_t = max_t;
+    params->snap_every = 0;
+    params->format = DUMP_TEXT;
+    params->precision = PREC_DOUBLE;
     params->delta_s = 1.0 / (double)(n + 1);
     /* we know from theory that we have to obey the restriction:
      * delta_t <= (delta_s)^2/2c. so just make them equal.
      */
     params->delta_t = pow(params->delta_s, 2.0) / (4.0 * params->c);
 
-    printf(". max_t: %"PRIu64"\n", params->max_t);
-    printf(". c: %lf\n", params->c);
-    printf(". delta_s: %lf\n", params->delta_s);
-    printf(". delta_t: %lf\n\n", params->delta_t);
+    if (params->verbose) {
+        printf(". n: %"PRIu64"\n", params->n);
+        printf(". max_t: %"PRIu64"\n", params->max_t);
+        printf(". c: %lf\n", params->c);
+        printf(". delta_s: %lf\n", params->delta_s);
+        printf(". delta_t: %lf\n\n", params->delta_t);
+    }
+    return SUCCESS;
+}
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the header of an nx by ny .npy array of type cells, padded so the data
+ * start on a 64-byte boundary */
+static int
+npy_header(FILE *fp, uint64_t nx, uint64_t ny, int type)
+{
+    char dict[128];
+    unsigned char hlen[2];
+    int one = 1;
+    int len, pad;
+
+    len = snprintf(dict, sizeof(dict), "{'descr': '%cf%d', 'fortran_order': "
+                   "False, 'shape': (%"PRIu64", %"PRIu64"), }",
+                   (*(char *)&one) ? '<' : '>',
+                   (MESH_FLOAT == type) ? 4 : 8, nx, ny);
+    /* magic, version and length, the dictionary and a newline */
+    pad = (64 - (10 + len + 1) % 64) % 64;
+    hlen[0] = (len + pad + 1) & 0xff;
+    hlen[1] = (len + pad + 1) >> 8;
+    if (8 != fwrite("\x93NUMPY\x01\x00", 1, 8, fp) ||
+        2 != fwrite(hlen, 1, 2, fp) ||
+        (size_t)len != fwrite(dict, 1, len, fp)) {
+        return FAILURE_IO;
+    }
+    while (pad--) fputc(' ', fp);
+    fputc('\n', fp);
     return SUCCESS;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
 static int
-dump(const simulation_t *sim)
+mesh_write(const mesh_t *mesh, const char *path, int format)
 {
     FILE *imgfp = NULL;
     uint64_t i, j;
+    int rc = SUCCESS;
 
-    if (NULL == (imgfp = fopen("heat-img.dat", "wb"))) {
+    if (NULL == (imgfp = fopen(path, "wb"))) {
         fprintf(stderr, "fopen failure @ %s:%d\n", __FILE__, __LINE__);
         return FAILURE_IO;
     }
-    /* write the matrix */
-    for (i = 0; i < sim->new_mesh->nx; ++i) {
-        for (j = 0; j < sim->new_mesh->ny; ++j) {
-            fprintf(imgfp, "%lf%s", sim->new_mesh->cells[i][j],
-                    (j == sim->new_mesh->ny - 1) ? "" : " ");
+    if (DUMP_TEXT == format) {
+        /* write the matrix */
+        for (i = 0; i < mesh->nx; ++i) {
+            for (j = 0; j < mesh->ny; ++j) {
+                fprintf(imgfp, "%lf%s", (MESH_FLOAT == mesh->type) ?
+                        (double)mesh->fcells[i][j] : mesh->cells[i][j],
+                        (j == mesh->ny - 1) ? "" : " ");
+            }
+            fprintf(imgfp, "\n");
         }
-        fprintf(imgfp, "\n");
     }
-    fflush(imgfp);
-    fclose(imgfp);
+    else {
+        if (DUMP_NPY == format) {
+            rc = npy_header(imgfp, mesh->nx, mesh->ny, mesh->type);
+        }
+        /* one write per row, leaving out the padding */
+        for (i = 0; SUCCESS == rc && i < mesh->nx; ++i) {
+            const void *row = (MESH_FLOAT == mesh->type) ?
+                              (const void *)mesh->fcells[i] :
+                              (const void *)mesh->cells[i];
+
+            if (mesh->ny != fwrite(row, cell_size(mesh), mesh->ny, imgfp)) {
+                rc = FAILURE_IO;
+            }
+        }
+    }
+    if (0 != fclose(imgfp)) rc = FAILURE_IO;
+    if (SUCCESS != rc) {
+        fprintf(stderr, "write failure @ %s:%d: %s\n", __FILE__, __LINE__,
+                path);
+    }
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+dump(const simulation_t *sim)
+{
+    char path[64];
+
+    snprintf(path, sizeof(path), "heat-img.%s",
+             dump_ext[sim->params->format]);
+    return mesh_write(sim->new_mesh, path, sim->params->format);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+snapshot_construct(snapshot_t **new_snap,
+                   uint64_t nx,
+                   uint64_t ny,
+                   int type,
+                   int format)
+{
+    snapshot_t *snap = NULL;
+    int rc = FAILURE;
+
+    if (NULL == new_snap) return FAILURE_INVALID_ARG;
+    if (NULL == (snap = calloc(1, sizeof(*snap)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    if (SUCCESS != (rc = mesh_construct(&snap->mesh, nx, ny, type))) {
+        free(snap);
+        return rc;
+    }
+    snap->format = format;
+    *new_snap = snap;
     return SUCCESS;
 }
 
 /* ////////////////////////////////////////////////////////////////////////// */
-int
+static void *
+snapshot_write(void *arg)
+{
+    snapshot_t *snap = (snapshot_t *)arg;
+
+    snap->rc = mesh_write(snap->mesh, snap->path, snap->format);
+    return NULL;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* wait for the snapshot being written, if any */
+static int
+snapshot_wait(snapshot_t *snap)
+{
+    if (NULL == snap || !snap->busy) return SUCCESS;
+    (void)pthread_join(snap->thread, NULL);
+    snap->busy = false;
+    return snap->rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* copy mesh, the state after step t, and write it to heat-img-<t> in the
+ * background while the simulation goes on */
+static int
+snapshot_take(snapshot_t *snap, const mesh_t *mesh, uint64_t t)
+{
+    int rc = FAILURE;
+
+    if (SUCCESS != (rc = snapshot_wait(snap))) return rc;
+    (void)memcpy((MESH_FLOAT == mesh->type) ? (void *)snap->mesh->fdata
+                                             : (void *)snap->mesh->data,
+                 (MESH_FLOAT == mesh->type) ? (const void *)mesh->fdata
+                                             : (const void *)mesh->data,
+                 mesh->nx * mesh->pitch * cell_size(mesh));
+    snprintf(snap->path, sizeof(snap->path), "heat-img-%06"PRIu64".%s", t,
+             dump_ext[snap->format]);
+    if (0 != pthread_create(&snap->thread, NULL, snapshot_write, snap)) {
+        /* write it here then */
+        return mesh_write(snap->mesh, snap->path, snap->format);
+    }
+    snap->busy = true;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+snapshot_destruct(snapshot_t *snap)
+{
+    if (!snap) return FAILURE_INVALID_ARG;
+    (void)snapshot_wait(snap);
+    (void)mesh_destruct(snap->mesh);
+    free(snap);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* run sim, stopping every snap_every steps to hand the newest state to
+ * snap */
+static int
+run_snapshots(simulation_t *sim, snapshot_t *snap)
+{
+    int rc = SUCCESS;
+    uint64_t t, nb;
+    uint64_t t_max = sim->params->max_t;
+    uint64_t snap_every = sim->params->snap_every;
+    int verbose = sim->params->verbose;
+    mesh_t *tmp_meshp;
+
+    if (verbose) printf("o starting simulation...\n");
+    sim->params->verbose = 0;
+    for (t = 0; SUCCESS == rc && t < t_max; t += nb) {
+        nb = (t_max - t < snap_every) ? t_max - t : snap_every;
+        sim->params->max_t = nb;
+        rc = run_simulation(sim);
+        /* after an odd number of steps the newest state is in new_mesh */
+        if (1 == nb % 2) {
+            tmp_meshp = sim->old_mesh;
+            sim->old_mesh = sim->new_mesh;
+            sim->new_mesh = tmp_meshp;
+        }
+        if (SUCCESS == rc && 0 == (t + nb) % snap_every) {
+            if (verbose) printf(". snapshot at step %"PRIu64"\n", t + nb);
+            rc = snapshot_take(snap, sim->old_mesh, t + nb);
+        }
+    }
+    /* leave the even steps in old_mesh, as one run_simulation would */
+    if (1 == t_max % 2) {
+        tmp_meshp = sim->old_mesh;
+        sim->old_mesh = sim->new_mesh;
+        sim->new_mesh = tmp_meshp;
+    }
+    sim->params->max_t = t_max;
+    sim->params->verbose = verbose;
+    if (SUCCESS != rc) {
+        (void)snapshot_wait(snap);
+        return rc;
+    }
+    return snapshot_wait(snap);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+set_cell(mesh_t *mesh, int i, int j, double val)
+{
+    if (MESH_FLOAT == mesh->type) mesh->fcells[i][j] = (float)val;
+    else mesh->cells[i][j] = val;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
 set_initial_conds(mesh_t *mesh)
 {
     if (NULL == mesh) return FAILURE_INVALID_ARG;
@@ -318,14 +648,14 @@ set_initial_conds(mesh_t *mesh)
     int radius_err = 1 - x;
 
     while (x >= y) {
-        mesh->cells[ x + x0][ y + y0] = K * .50;
-        mesh->cells[ y + x0][ x + y0] = K * .60;
-        mesh->cells[-x + x0][ y + y0] = K * .70;
-        mesh->cells[-y + x0][ x + y0] = K * .80;
-        mesh->cells[-x + x0][-y + y0] = K * .70;
-        mesh->cells[-y + x0][-x + y0] = K * .60;
-        mesh->cells[ x + x0][-y + y0] = K * .50;
-        mesh->cells[ y + x0][-x + y0] = K;
+        set_cell(mesh,  x + x0,  y + y0, K * .50);
+        set_cell(mesh,  y + x0,  x + y0, K * .60);
+        set_cell(mesh, -x + x0,  y + y0, K * .70);
+        set_cell(mesh, -y + x0,  x + y0, K * .80);
+        set_cell(mesh, -x + x0, -y + y0, K * .70);
+        set_cell(mesh, -y + x0, -x + y0, K * .60);
+        set_cell(mesh,  x + x0, -y + y0, K * .50);
+        set_cell(mesh,  y + x0, -x + y0, K);
         y++;
         if (radius_err < 0) radius_err += 2 * y + 1;
         else {
@@ -336,28 +666,205 @@ set_initial_conds(mesh_t *mesh)
     return SUCCESS;
 }
 
+/* ////////////////////////////////////////////////////////////////////////// */
+/* run sim, taking snapshots into snap if it asks for them, and time it */
+static int
+run_timed(simulation_t *sim, snapshot_t *snap, double *secs)
+{
+    int rc = FAILURE;
+    double start = cody_now();
+
+    rc = (0 == sim->params->snap_every) ? run_simulation(sim)
+                                        : run_snapshots(sim, snap);
+    *secs = cody_now() - start;
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* cell updates per second and the memory bandwidth they imply if every
+ * update reads its old cell and writes its new one once */
+static void
+report_rate(const simulation_params_t *params, double secs)
+{
+    double updates = (double)(params->n - 2) * (double)(params->n - 2) *
+                     (double)params->max_t;
+    size_t size = (PREC_DOUBLE == params->precision) ? sizeof(double)
+                                                     : sizeof(float);
+
+    printf("%10"PRIu64" %10"PRIu64" %12.4lf %14.2lf %10.2lf\n", params->n,
+           params->max_t, secs, updates / secs * 1e-6,
+           updates * 2.0 * size / secs * 1e-9);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* run every benchmark size up to base->n, each for max_t steps or, if that
+ * is 0, for about BENCH_UPDATES cell updates */
+static int
+benchmark(const simulation_params_t *base,
+          uint64_t max_t)
+{
+    int rc = FAILURE;
+    uint64_t n, steps;
+    bool last = false;
+    simulation_params_t params;
+    simulation_t *sim = NULL;
+    double secs;
+
+    printf("%10s %10s %12s %14s %10s\n", "n", "steps", "seconds",
+           "Mupdates/s", "GB/s");
+    for (n = BENCH_N_MIN; !last; n *= 2) {
+        if (n >= base->n) {
+            n = base->n;
+            last = true;
+        }
+        steps = max_t ? max_t : BENCH_UPDATES / (n * n);
+        if (steps < BENCH_MIN_STEPS) steps = BENCH_MIN_STEPS;
+        (void)init_params(&params, n, base->c, steps, false);
+        params.precision = base->precision;
+        if (SUCCESS != (rc = simulation_construct(&sim, &params))) {
+            fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
+                    __FILE__, __LINE__, rc);
+            return rc;
+        }
+        if (SUCCESS != (rc = set_initial_conds(sim->old_mesh)) ||
+            SUCCESS != (rc = run_timed(sim, NULL, &secs))) {
+            fprintf(stderr, "benchmark failure @ %s:%d: rc = %d\n",
+                    __FILE__, __LINE__, rc);
+            (void)simulation_destruct(sim);
+            return rc;
+        }
+        report_rate(&params, secs);
+        (void)simulation_destruct(sim);
+        sim = NULL;
+    }
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+usage(void)
+{
+    printf("usage: heat-tx [-n N] [-s STEPS] [-c COND] [-p THREADS]\n"
+           "               [-f dat|raw|npy] [-k STEPS] "
+           "[-P double|float|mixed] [-B]\n"
+           "  -n  mesh cells in x and y (default %d)\n"
+           "  -s  time steps (default %d)\n"
+           "  -c  thermal conductivity (default %lf)\n"
+           "  -p  threads (default OMP_NUM_THREADS)\n"
+           "  -f  dump format: text, raw doubles or NumPy (default dat)\n"
+           "  -k  also write heat-img-<step> every STEPS steps, in the "
+           "background\n"
+           "  -P  cells and updates in double, in float, or float cells "
+           "updated in double\n"
+           "      (default double)\n"
+           "  -B  benchmark sizes %d, %d, ... up to -n (default %d), each "
+           "for -s steps or\n"
+           "      about %llu cell updates, instead of one run with a dump\n",
+           N, T_MAX, THERM_COND, BENCH_N_MIN,
+           2 * BENCH_N_MIN, BENCH_N_MAX, BENCH_UPDATES);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+parse_u64(const char *str, uint64_t *val)
+{
+    char *end = NULL;
+
+    if ('\0' == *str || '-' == *str) return FAILURE_INVALID_ARG;
+    *val = strtoull(str, &end, 10);
+    return ('\0' == *end) ? SUCCESS : FAILURE_INVALID_ARG;
+}
+
 /* ////////////////////////////////////////////////////////////////////////// */
 int
-main(void)
+main(int argc, char **argv)
 {
     int rc = FAILURE;
     int erc = EXIT_FAILURE;
     simulation_params_t *params = NULL;
     simulation_t *sim = NULL;
+    snapshot_t *snap = NULL;
+    uint64_t n = N, max_t = T_MAX, nthreads = 0, snap_every = 0;
+    double c = THERM_COND, secs;
+    int format = DUMP_TEXT, precision = PREC_DOUBLE;
+    bool bench = false, n_set = false, max_t_set = false;
+    char *end = NULL;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "n:s:c:p:f:k:P:Bh"))) {
+        rc = SUCCESS;
+        switch (opt) {
+        case 'n': rc = parse_u64(optarg, &n); n_set = true; break;
+        case 's': rc = parse_u64(optarg, &max_t); max_t_set = true; break;
+        case 'c':
+            c = strtod(optarg, &end);
+            if ('\0' == *optarg || '\0' != *end || c <= 0.0) {
+                rc = FAILURE_INVALID_ARG;
+            }
+            break;
+        case 'p': rc = parse_u64(optarg, &nthreads); break;
+        case 'f':
+            for (format = DUMP_NPY; format >= 0; --format) {
+                if (0 == strcmp(optarg, dump_ext[format])) break;
+            }
+            if (format < 0) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'k': rc = parse_u64(optarg, &snap_every); break;
+        case 'P':
+            for (precision = PREC_MIXED; precision >= 0; --precision) {
+                if (0 == strcmp(optarg, prec_name[precision])) break;
+            }
+            if (precision < 0) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'B': bench = true; break;
+        case 'h': usage(); return EXIT_SUCCESS;
+        default: rc = FAILURE_INVALID_ARG; break;
+        }
+        if (SUCCESS != rc) {
+            usage();
+            return EXIT_FAILURE;
+        }
+    }
+    if (bench && !n_set) n = BENCH_N_MAX;
+    /* the heat source needs a few cells around it */
+    if (optind != argc || n < 8 || (bench && n < BENCH_N_MIN)) {
+        usage();
+        return EXIT_FAILURE;
+    }
+#ifdef _OPENMP
+    if (nthreads > 0) omp_set_num_threads((int)nthreads);
+#else
+    if (nthreads > 1) fprintf(stderr, "warning: built without OpenMP, "
+                              "running one thread\n");
+#endif
 
     /* print application banner */
     printf("o %s %s\n", app_name, app_ver);
+#ifdef _OPENMP
+    printf(". threads: %d\n", omp_get_max_threads());
+#endif
 
     if (SUCCESS != (rc = params_construct(&params))) {
         fprintf(stderr, "params_construct failure @ %s:%d: rc = %d\n", __FILE__,
                 __LINE__, rc);
         goto cleanup;
     }
-    if (SUCCESS != (rc = init_params(params, N, THERM_COND, T_MAX))) {
+    if (SUCCESS != (rc = init_params(params, n, c, max_t, !bench))) {
         fprintf(stderr, "init_params failure @ %s:%d: rc = %d\n", __FILE__,
                 __LINE__, rc);
         goto cleanup;
     }
+    params->format = format;
+    params->precision = precision;
+    printf(". precision: %s\n", prec_name[precision]);
+    if (!bench) params->snap_every = snap_every;
+    if (bench) {
+        if (SUCCESS != (rc = benchmark(params, max_t_set ? max_t : 0))) {
+            goto cleanup;
+        }
+        erc = EXIT_SUCCESS;
+        goto cleanup;
+    }
     if (SUCCESS != (rc = simulation_construct(&sim, params))) {
         fprintf(stderr, "simulation_construct failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
@@ -368,11 +875,22 @@ main(void)
                 __FILE__, __LINE__, rc);
         goto cleanup;
     }
-    if (SUCCESS != (rc = run_simulation(sim))) {
+    if (0 != params->snap_every &&
+        SUCCESS != (rc = snapshot_construct(&snap, n, n,
+                                           sim->old_mesh->type, format))) {
+        fprintf(stderr, "snapshot_construct failure @ %s:%d: rc = %d\n",
+                __FILE__, __LINE__, rc);
+        goto cleanup;
+    }
+    if (SUCCESS != (rc = run_timed(sim, snap, &secs))) {
         fprintf(stderr, "run_simulation failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
         goto cleanup;
     }
+    printf("o simulation done\n");
+    printf("%10s %10s %12s %14s %10s\n", "n", "steps", "seconds",
+           "Mupdates/s", "GB/s");
+    report_rate(params, secs);
     if (SUCCESS != dump(sim)) {
         fprintf(stderr, "dump failure @ %s:%d: rc = %d\n",
                 __FILE__, __LINE__, rc);
@@ -382,6 +900,7 @@ main(void)
     erc = EXIT_SUCCESS;
 
 cleanup:
+    (void)snapshot_destruct(snap);
     (void)simulation_destruct(sim);
     (void)params_destruct(params);
     return erc;
@@ -65,15 +65,52 @@ enum {
 # define DOUBLE_C(N) N
 #endif
 
-/* max simulation time */
+/* default max simulation time */
 #define T_MAX 1024
-/* nx and ny */
+/* default nx and ny */
 #define N 512
-/* thermal conductivity */
+/* default thermal conductivity */
 #define THERM_COND DOUBLE_C(0.6)
 /* some constant */
 #define K DOUBLE_C(0.4)
 
+/* alignment in bytes of the mesh block and of every row in it */
+#define MESH_ALIGN 64
+
+/* row blocks launched per core in each step */
+#define ROW_TASKS_PER_CORE 4
+
+/* the benchmark runs n = BENCH_N_MIN, 2 * BENCH_N_MIN, ... up to its
+ * largest size, BENCH_N_MAX unless given */
+#define BENCH_N_MIN 64
+#define BENCH_N_MAX 8192
+/* cell updates per benchmark size when its steps are not given, but never
+ * fewer than BENCH_MIN_STEPS steps */
+#define BENCH_UPDATES (1ULL << 30)
+#define BENCH_MIN_STEPS 10
+
+/* dump formats: text, one row per line; the rows' doubles back to back; or
+ * those in a NumPy .npy file */
+enum {
+    DUMP_TEXT = 0,
+    DUMP_RAW,
+    DUMP_NPY
+};
+
+/* mesh cell types */
+enum {
+    MESH_DOUBLE = 0,
+    MESH_FLOAT
+};
+
+/* simulation precisions: double cells; float cells, for half the memory
+ * traffic and twice the SIMD width; or float cells updated in double */
+enum {
+    PREC_DOUBLE = 0,
+    PREC_FLOAT,
+    PREC_MIXED
+};
+
 /* Bridge the gap between C and ISPC. */
 #ifdef ISPC
 typedef unsigned int64 uint64_t;
@@ -88,8 +125,17 @@ typedef struct {
 #endif
     /* mesh size in x and y */
     uniform uint64_t nx, ny;
-    /* mesh cells */
+    /* cells from the start of one row to the start of the next */
+    uniform uint64_t pitch;
+    /* MESH_DOUBLE or MESH_FLOAT */
+    uniform int type;
+    /* mesh cells, nx rows of pitch cells, if double */
+    uniform double *uniform data;
+    /* row pointers into data */
     uniform double *uniform *uniform cells;
+    /* the same if float, data and cells being NULL */
+    uniform float *uniform fdata;
+    uniform float *uniform *uniform fcells;
 #ifdef ISPC
 };
 #else
@@ -102,6 +148,8 @@ struct simulation_params_t {
 #else
 typedef struct {
 #endif
+    /* mesh size in x and y */
+    uniform uint64_t n;
     /* thermal conductivity */
     uniform double c;
     uniform double delta_s;
@@ -109,12 +157,37 @@ typedef struct {
     uniform double delta_t;
     /* max simulation time */
     uniform uint64_t max_t;
+    /* whether to report progress */
+    uniform int verbose;
+    /* steps between snapshots, 0 for none */
+    uniform uint64_t snap_every;
+    /* dump and snapshot format */
+    uniform int format;
+    /* PREC_DOUBLE, PREC_FLOAT or PREC_MIXED */
+    uniform int precision;
 #ifdef ISPC
 };
 #else
 } simulation_params_t;
 #endif
 
+/* the heat source cells, row by row */
+#ifdef ISPC
+struct source_t {
+#else
+typedef struct {
+#endif
+    /* row i's cells are col[row[i]] to col[row[i + 1] - 1] */
+    uniform uint64_t *uniform row;
+    uniform uint64_t *uniform col;
+    /* their values */
+    uniform double *uniform val;
+#ifdef ISPC
+};
+#else
+} source_t;
+#endif
+
 #ifdef ISPC
 struct simulation_t {
 #else
@@ -125,6 +198,8 @@ typedef struct {
     uniform mesh_t *uniform new_mesh;
     /* simulation parameters */
     uniform simulation_params_t *uniform params;
+    /* the constant heat source */
+    uniform source_t *uniform source;
 #ifdef ISPC
 };
 #else
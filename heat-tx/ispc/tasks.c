@@ -0,0 +1,126 @@
+/**
+ * Copyright (c) 2015, Los Alamos National Security, LLC All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* The task runtime ISPC's launch and sync call into. launch runs all of a
+ * launch's tasks on the OpenMP threads before it returns, so sync only has
+ * to free the memory the tasks' arguments were allocated in. */
+
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* what one launch[] allocated */
+typedef struct {
+    void **mem;
+    int nmem, cap;
+} task_group_t;
+
+typedef void (*task_fn_t)(void *data, int thread_index, int thread_count,
+                          int task_index, int task_count,
+                          int task_index0, int task_index1, int task_index2,
+                          int task_count0, int task_count1, int task_count2);
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void *
+ISPCAlloc(void **handle, int64_t size, int32_t alignment)
+{
+    task_group_t *group = (task_group_t *)*handle;
+    void *mem = NULL;
+
+    if (NULL == group) {
+        if (NULL == (group = calloc(1, sizeof(*group)))) return NULL;
+        *handle = group;
+    }
+    if (group->nmem == group->cap) {
+        int cap = group->cap ? 2 * group->cap : 8;
+        void **tmp = realloc(group->mem, cap * sizeof(void *));
+        if (NULL == tmp) return NULL;
+        group->mem = tmp;
+        group->cap = cap;
+    }
+    if (alignment < (int32_t)sizeof(void *)) alignment = sizeof(void *);
+    if (0 != posix_memalign(&mem, alignment, size)) return NULL;
+    group->mem[group->nmem++] = mem;
+    return mem;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+ISPCLaunch(void **handle, void *f, void *data,
+           int count0, int count1, int count2)
+{
+    task_fn_t fn = (task_fn_t)f;
+    int count = count0 * count1 * count2;
+    int t;
+
+    (void)handle;
+    /* consecutive tasks go to the same thread, as consecutive rows do in
+     * mesh_construct's first touch */
+#pragma omp parallel for schedule(static)
+    for (t = 0; t < count; ++t) {
+        int thread = 0, nthreads = 1;
+#ifdef _OPENMP
+        thread = omp_get_thread_num();
+        nthreads = omp_get_num_threads();
+#endif
+        fn(data, thread, nthreads, t, count,
+           t % count0, (t / count0) % count1, t / (count0 * count1),
+           count0, count1, count2);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+ISPCSync(void *handle)
+{
+    task_group_t *group = (task_group_t *)handle;
+    int i;
+
+    if (NULL == group) return;
+    for (i = 0; i < group->nmem; ++i) free(group->mem[i]);
+    free(group->mem);
+    free(group);
+}
@@ -0,0 +1,543 @@
+/**
+ * Copyright (c) 2014-2015 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * This software was produced under U.S. Government contract DE-AC52-06NA25396
+ * for Los Alamos National Laboratory (LANL), which is operated by Los Alamos
+ * National Security, LLC for the U.S. Department of Energy. The U.S. Government
+ * has rights to use, reproduce, and distribute this software.  NEITHER THE
+ * GOVERNMENT NOR LOS ALAMOS NATIONAL SECURITY, LLC MAKES ANY WARRANTY, EXPRESS
+ * OR IMPLIED, OR ASSUMES ANY LIABILITY FOR THE USE OF THIS SOFTWARE.  If
+ * software is modified to produce derivative works, such modified software
+ * should be clearly marked, so as not to confuse it with the version available
+ * from LANL.
+ *
+ * Additionally, redistribution and use in source and binary forms, with or
+ * without modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * . Redistributions of source code must retain the above copyright notice, this
+ *   list of conditions and the following disclaimer.
+ *
+ * . Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * . Neither the name of Los Alamos National Security, LLC, Los Alamos National
+ *   Laboratory, LANL, the U.S. Government, nor the names of its contributors
+ *   may be used to endorse or promote products derived from this software
+ *   without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY LOS ALAMOS NATIONAL SECURITY, LLC AND
+ * CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT
+ * NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A
+ * PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL LOS ALAMOS NATIONAL
+ * SECURITY, LLC OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS;
+ * OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR
+ * OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/* A simple 2D heat transfer simulation in C by Samuel K. Gutierrez,
+ * distributed with MPI over a 2D grid of ranks */
+
+/* Each rank owns a block of the mesh interior plus a one cell halo, and
+ * steps it with libheattx's step_rows. The halos of a step are exchanged
+ * while the cells that do not need them are updated. */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <mpi.h>
+#include "heattx.h"
+#include "cody.h"
+
+static char *app_name = "mpi-heat-tx";
+static char *app_ver = "0.2";
+
+/* default max simulation time */
+#define T_MAX 1024
+/* default nx and ny */
+#define N 512
+/* default thermal conductivity */
+#define THERM_COND 0.6
+
+static const char *dump_ext[] = {"dat", "raw", "npy"};
+
+/* bytes per cell of a text dump: "%lf" of a value in [0, 10) and a space or
+ * a newline, so every rank knows where its cells go */
+#define TEXT_CELL 9
+
+/* neighbors, and the tags of halos going that way */
+enum {
+    NORTH = 0,
+    SOUTH,
+    WEST,
+    EAST
+};
+
+/* the parts of a block a step updates: the cells away from the halo while
+ * it is exchanged, then the first and last rows and columns */
+enum {
+    R_INNER = 0,
+    R_ROWS,
+    R_WEST,
+    R_EAST,
+    R_COUNT
+};
+
+/* a rank's block of the mesh */
+typedef struct block_t {
+    MPI_Comm comm;
+    int rank;
+    int nbr[4];
+    /* global mesh size, and the global cell of local cell (0, 0) */
+    uint64_t n;
+    int64_t gx, gy;
+    /* owned rows 1 to bx and columns 1 to by */
+    uint64_t bx, by;
+    /* the even and the odd steps */
+    mesh_t *meshes[2];
+    /* each region's view of the meshes, and its heat source */
+    mesh_t views[2][R_COUNT];
+    source_t *src[R_COUNT];
+    /* one column of owned cells */
+    MPI_Datatype col_type;
+    /* steps taken */
+    uint64_t t;
+} block_t;
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the cells of src in columns [c0, c1), moved shift columns left */
+static int
+source_view(source_t **new_src,
+            const source_t *src,
+            uint64_t nrows,
+            uint64_t c0,
+            uint64_t c1,
+            uint64_t shift)
+{
+    source_t *view = NULL;
+    uint64_t i, k, n = 0;
+
+    if (NULL == (view = calloc(1, sizeof(*view))) ||
+        NULL == (view->row = calloc(nrows + 1, sizeof(uint64_t))) ||
+        NULL == (view->col = calloc(src->row[nrows] + 1, sizeof(uint64_t))) ||
+        NULL == (view->val = calloc(src->row[nrows] + 1, sizeof(double)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        (void)source_destruct(view);
+        return FAILURE_OOR;
+    }
+    for (i = 0; i < nrows; ++i) {
+        view->row[i] = n;
+        for (k = src->row[i]; k < src->row[i + 1]; ++k) {
+            if (src->col[k] >= c0 && src->col[k] < c1) {
+                view->col[n] = src->col[k] - shift;
+                view->val[n++] = src->val[k];
+            }
+        }
+    }
+    view->row[nrows] = n;
+    *new_src = view;
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* mesh's columns [c0, c0 + ny) as a mesh of its own */
+static void
+mesh_view(mesh_t *view, const mesh_t *mesh, uint64_t c0, uint64_t ny)
+{
+    view->nx = mesh->nx;
+    view->ny = ny;
+    view->pitch = mesh->pitch;
+    view->type = mesh->type;
+    view->data = mesh->data + c0;
+    view->cells = NULL;
+    view->nz = 1;
+    view->plane = mesh->plane;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+block_destruct(block_t *b)
+{
+    int r;
+
+    if (!b) return FAILURE_INVALID_ARG;
+    for (r = 0; r < R_COUNT; ++r) (void)source_destruct(b->src[r]);
+    (void)mesh_destruct(b->meshes[0]);
+    (void)mesh_destruct(b->meshes[1]);
+    if (MPI_DATATYPE_NULL != b->col_type) MPI_Type_free(&b->col_type);
+    if (MPI_COMM_NULL != b->comm) MPI_Comm_free(&b->comm);
+    free(b);
+    return SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* split the interior of an n by n mesh over the ranks of comm and build this
+ * rank's block at step 0, the heat source in place */
+static int
+block_construct(block_t **new_block, MPI_Comm comm, uint64_t n)
+{
+    int rc = FAILURE;
+    int size, dims[2] = {0, 0}, periods[2] = {0, 0}, coords[2];
+    uint64_t m = n - 2, i, k, x0, x1, y0, y1;
+    block_t *b = NULL;
+    source_t *full = NULL;
+
+    if (NULL == (b = calloc(1, sizeof(*b)))) {
+        fprintf(stderr, "out of resources @ %s:%d\n", __FILE__, __LINE__);
+        return FAILURE_OOR;
+    }
+    b->comm = MPI_COMM_NULL;
+    b->col_type = MPI_DATATYPE_NULL;
+    MPI_Comm_size(comm, &size);
+    MPI_Dims_create(size, 2, dims);
+    MPI_Cart_create(comm, 2, dims, periods, 1, &b->comm);
+    MPI_Comm_rank(b->comm, &b->rank);
+    MPI_Cart_coords(b->comm, b->rank, 2, coords);
+    MPI_Cart_shift(b->comm, 0, 1, &b->nbr[NORTH], &b->nbr[SOUTH]);
+    MPI_Cart_shift(b->comm, 1, 1, &b->nbr[WEST], &b->nbr[EAST]);
+
+    /* interior rows and columns [x0, x1) and [y0, y1) */
+    x0 = 1 + m * coords[0] / dims[0];
+    x1 = 1 + m * (coords[0] + 1) / dims[0];
+    y0 = 1 + m * coords[1] / dims[1];
+    y1 = 1 + m * (coords[1] + 1) / dims[1];
+    if (x1 - x0 < 2 || y1 - y0 < 2) {
+        if (0 == b->rank) {
+            fprintf(stderr, "%"PRIu64" cells a side is too few for %d x %d "
+                    "ranks\n", n, dims[0], dims[1]);
+        }
+        rc = FAILURE_INVALID_ARG;
+        goto out;
+    }
+    b->n = n;
+    b->bx = x1 - x0;
+    b->by = y1 - y0;
+    b->gx = x0 - 1;
+    b->gy = y0 - 1;
+    if (SUCCESS != (rc = mesh_construct(&b->meshes[0], b->bx + 2, b->by + 2)) ||
+        SUCCESS != (rc = mesh_construct(&b->meshes[1], b->bx + 2, b->by + 2))) {
+        goto out;
+    }
+    MPI_Type_vector(b->bx, 1, b->meshes[0]->pitch, MPI_DOUBLE, &b->col_type);
+    MPI_Type_commit(&b->col_type);
+
+    for (i = 0; i < 2; ++i) {
+        mesh_view(&b->views[i][R_INNER], b->meshes[i], 1, b->by);
+        mesh_view(&b->views[i][R_ROWS], b->meshes[i], 0, b->by + 2);
+        mesh_view(&b->views[i][R_WEST], b->meshes[i], 0, 3);
+        mesh_view(&b->views[i][R_EAST], b->meshes[i], b->by - 1, 3);
+    }
+    if (SUCCESS != (rc = source_construct(&full, n, n, b->gx, b->gy,
+                                          b->bx + 2, b->by + 2)) ||
+        SUCCESS != (rc = source_view(&b->src[R_INNER], full, b->bx + 2, 2,
+                                     b->by, 1)) ||
+        SUCCESS != (rc = source_view(&b->src[R_ROWS], full, b->bx + 2, 1,
+                                     b->by + 1, 0)) ||
+        SUCCESS != (rc = source_view(&b->src[R_WEST], full, b->bx + 2, 1, 2,
+                                     0)) ||
+        SUCCESS != (rc = source_view(&b->src[R_EAST], full, b->bx + 2, b->by,
+                                     b->by + 1, b->by - 1))) {
+        goto out;
+    }
+    /* step 0 */
+    for (i = 1; i <= b->bx; ++i) {
+        for (k = full->row[i]; k < full->row[i + 1]; ++k) {
+            if (full->col[k] >= 1 && full->col[k] <= b->by) {
+                b->meshes[0]->cells[i][full->col[k]] = full->val[k];
+            }
+        }
+    }
+    *new_block = b;
+    rc = SUCCESS;
+out:
+    (void)source_destruct(full);
+    if (SUCCESS != rc) (void)block_destruct(b);
+    return rc;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* one step of the block: start the halo exchange of the current mesh,
+ * update the cells that do not read the halo, then the rest once it is in */
+static void
+block_step(block_t *b, double cdtods2)
+{
+    const int from = b->t % 2, to = (b->t + 1) % 2;
+    mesh_t *old_mesh = b->meshes[from];
+    double *d = old_mesh->data;
+    uint64_t p = old_mesh->pitch, bx = b->bx, by = b->by;
+    MPI_Request req[8];
+    int64_t i;
+
+    MPI_Irecv(d + 1, by, MPI_DOUBLE, b->nbr[NORTH], SOUTH, b->comm, &req[0]);
+    MPI_Irecv(d + (bx + 1) * p + 1, by, MPI_DOUBLE, b->nbr[SOUTH], NORTH,
+              b->comm, &req[1]);
+    MPI_Irecv(d + p, 1, b->col_type, b->nbr[WEST], EAST, b->comm, &req[2]);
+    MPI_Irecv(d + p + by + 1, 1, b->col_type, b->nbr[EAST], WEST, b->comm,
+              &req[3]);
+    MPI_Isend(d + p + 1, by, MPI_DOUBLE, b->nbr[NORTH], NORTH, b->comm,
+              &req[4]);
+    MPI_Isend(d + bx * p + 1, by, MPI_DOUBLE, b->nbr[SOUTH], SOUTH, b->comm,
+              &req[5]);
+    MPI_Isend(d + p + 1, 1, b->col_type, b->nbr[WEST], WEST, b->comm, &req[6]);
+    MPI_Isend(d + p + by, 1, b->col_type, b->nbr[EAST], EAST, b->comm,
+              &req[7]);
+
+#pragma omp parallel for schedule(static)
+    for (i = 2; i < (int64_t)bx; ++i) {
+        step_rows(&b->views[to][R_INNER], &b->views[from][R_INNER],
+                  b->src[R_INNER], i, i + 1, cdtods2);
+    }
+    MPI_Waitall(8, req, MPI_STATUSES_IGNORE);
+
+    step_rows(&b->views[to][R_ROWS], &b->views[from][R_ROWS],
+              b->src[R_ROWS], 1, 2, cdtods2);
+    step_rows(&b->views[to][R_ROWS], &b->views[from][R_ROWS],
+              b->src[R_ROWS], bx, bx + 1, cdtods2);
+    step_rows(&b->views[to][R_WEST], &b->views[from][R_WEST],
+              b->src[R_WEST], 2, bx, cdtods2);
+    step_rows(&b->views[to][R_EAST], &b->views[from][R_EAST],
+              b->src[R_EAST], 2, bx, cdtods2);
+    b->t++;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* write one of the meshes of every block to path together. Each rank writes
+ * its owned cells, and the mesh's edge cells next to them */
+static int
+block_write(const block_t *b, int which, const char *path, int format)
+{
+    const mesh_t *mesh = b->meshes[which];
+    int r0 = (MPI_PROC_NULL == b->nbr[NORTH]) ? 0 : 1;
+    int r1 = (MPI_PROC_NULL == b->nbr[SOUTH]) ? b->bx + 2 : b->bx + 1;
+    int c0 = (MPI_PROC_NULL == b->nbr[WEST]) ? 0 : 1;
+    int c1 = (MPI_PROC_NULL == b->nbr[EAST]) ? b->by + 2 : b->by + 1;
+    int sizes[2], subsizes[2], starts[2];
+    int i, j, bad = 0, anybad = 0;
+    size_t ncells = (size_t)(r1 - r0) * (c1 - c0);
+    char hdr[NPY_HEADER_MAX];
+    MPI_Offset disp = 0;
+    MPI_Datatype etype, ftype;
+    MPI_File fh;
+    double *vals = NULL;
+    char *text = NULL, cell[32];
+    void *buf;
+
+    if (DUMP_TEXT == format) {
+        MPI_Type_contiguous(TEXT_CELL, MPI_CHAR, &etype);
+        MPI_Type_commit(&etype);
+        buf = text = malloc(ncells * TEXT_CELL);
+    }
+    else {
+        etype = MPI_DOUBLE;
+        buf = vals = malloc(ncells * sizeof(double));
+    }
+    if (NULL == buf) bad = 1;
+    for (i = r0; !bad && i < r1; ++i) {
+        for (j = c0; j < c1; ++j) {
+            size_t at = (size_t)(i - r0) * (c1 - c0) + (j - c0);
+
+            if (NULL != vals) {
+                vals[at] = mesh->cells[i][j];
+                continue;
+            }
+            if (TEXT_CELL - 1 != snprintf(cell, sizeof(cell), "%lf",
+                                          mesh->cells[i][j])) {
+                bad = 1;
+                break;
+            }
+            (void)memcpy(text + at * TEXT_CELL, cell, TEXT_CELL - 1);
+            text[at * TEXT_CELL + TEXT_CELL - 1] =
+                ((uint64_t)(b->gy + j) == b->n - 1) ? '\n' : ' ';
+        }
+    }
+    MPI_Allreduce(&bad, &anybad, 1, MPI_INT, MPI_MAX, b->comm);
+    if (anybad) {
+        if (0 == b->rank) {
+            fprintf(stderr, "a text dump needs values in [0, 10), "
+                    "try -f raw\n");
+        }
+        free(buf);
+        if (DUMP_TEXT == format) MPI_Type_free(&etype);
+        return FAILURE_IO;
+    }
+
+    sizes[0] = sizes[1] = b->n;
+    subsizes[0] = r1 - r0;
+    subsizes[1] = c1 - c0;
+    starts[0] = b->gx + r0;
+    starts[1] = b->gy + c0;
+    MPI_Type_create_subarray(2, sizes, subsizes, starts, MPI_ORDER_C, etype,
+                             &ftype);
+    MPI_Type_commit(&ftype);
+    if (MPI_SUCCESS != MPI_File_open(b->comm, (char *)path,
+                                     MPI_MODE_CREATE | MPI_MODE_WRONLY,
+                                     MPI_INFO_NULL, &fh)) {
+        if (0 == b->rank) fprintf(stderr, "cannot open %s\n", path);
+        bad = 1;
+    }
+    else {
+        MPI_File_set_size(fh, 0);
+        if (DUMP_NPY == format) {
+            disp = npy_header(hdr, b->n, b->n, MESH_DOUBLE);
+            if (0 == b->rank) {
+                MPI_File_write_at(fh, 0, hdr, disp, MPI_CHAR,
+                                  MPI_STATUS_IGNORE);
+            }
+        }
+        MPI_File_set_view(fh, disp, etype, ftype, "native", MPI_INFO_NULL);
+        MPI_File_write_all(fh, buf, ncells, etype, MPI_STATUS_IGNORE);
+        MPI_File_close(&fh);
+    }
+    MPI_Type_free(&ftype);
+    if (DUMP_TEXT == format) MPI_Type_free(&etype);
+    free(buf);
+    return bad ? FAILURE_IO : SUCCESS;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+usage(void)
+{
+    printf("usage: heat-tx [-n N] [-s STEPS] [-c COND] [-f dat|raw|npy]\n"
+           "  -n  mesh cells in x and y (default %d)\n"
+           "  -s  time steps (default %d)\n"
+           "  -c  thermal conductivity (default %lf)\n"
+           "  -f  dump format: text, raw doubles or NumPy (default dat)\n",
+           N, T_MAX, THERM_COND);
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+parse_u64(const char *str, uint64_t *val)
+{
+    char *end = NULL;
+
+    if ('\0' == *str || '-' == *str) return FAILURE_INVALID_ARG;
+    *val = strtoull(str, &end, 10);
+    return ('\0' == *end) ? SUCCESS : FAILURE_INVALID_ARG;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+int
+main(int argc, char **argv)
+{
+    int rc = FAILURE;
+    int erc = EXIT_FAILURE;
+    int rank, size, local, nlocal, opt, format = DUMP_TEXT;
+    MPI_Comm node;
+    simulation_params_t params;
+    block_t *block = NULL;
+    uint64_t n = N, max_t = T_MAX, t;
+    double c = THERM_COND, ds2, cdtods2, secs, updates;
+    char *end = NULL, path[64];
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    rc = SUCCESS;
+    while (-1 != (opt = getopt(argc, argv, "n:s:c:f:h"))) {
+        switch (opt) {
+        case 'n': rc = parse_u64(optarg, &n); break;
+        case 's': rc = parse_u64(optarg, &max_t); break;
+        case 'c':
+            c = strtod(optarg, &end);
+            if ('\0' == *optarg || '\0' != *end || c <= 0.0) {
+                rc = FAILURE_INVALID_ARG;
+            }
+            break;
+        case 'f':
+            for (format = DUMP_NPY; format >= 0; --format) {
+                if (0 == strcmp(optarg, dump_ext[format])) break;
+            }
+            if (format < 0) rc = FAILURE_INVALID_ARG;
+            break;
+        case 'h': if (0 == rank) usage(); erc = EXIT_SUCCESS; goto cleanup;
+        default: rc = FAILURE_INVALID_ARG; break;
+        }
+        if (SUCCESS != rc) break;
+    }
+    if (SUCCESS != rc || optind != argc || n < 8) {
+        if (0 == rank) usage();
+        goto cleanup;
+    }
+
+    cody_init("heat-tx", "mpi");
+    cody_rank(rank, size);
+    /* the ranks on a node share its cores, before any mesh is touched */
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                        MPI_INFO_NULL, &node);
+    MPI_Comm_rank(node, &local);
+    MPI_Comm_size(node, &nlocal);
+    MPI_Comm_free(&node);
+    cody_pin(local, nlocal);
+    cody_param("n", "%"PRIu64, n);
+    cody_param("steps", "%"PRIu64, max_t);
+    if (0 == rank) {
+        /* print application banner */
+        printf("o %s %s\n", app_name, app_ver);
+        printf(". ranks: %d\n", size);
+    }
+    (void)init_params(&params, n, c, max_t, 0, 0, 0 == rank);
+    ds2 = params.delta_s * params.delta_s;
+    cdtods2 = (params.c * params.delta_t) / ds2;
+    if (SUCCESS != (rc = block_construct(&block, MPI_COMM_WORLD, n))) {
+        goto cleanup;
+    }
+
+    if (0 == rank) printf("o starting simulation...\n");
+    MPI_Barrier(block->comm);
+    cody_begin("run");
+    secs = MPI_Wtime();
+    for (t = 0; t < max_t; ++t) {
+        if (0 == rank && 0 == t % 100) {
+            printf(". starting iteration %"PRIu64" of %"PRIu64"\n", t, max_t);
+        }
+        block_step(block, cdtods2);
+    }
+    MPI_Barrier(block->comm);
+    secs = MPI_Wtime() - secs;
+    cody_end();
+    if (0 == rank) {
+        updates = (double)(n - 2) * (double)(n - 2) * (double)max_t;
+        printf("o simulation done\n");
+        printf("%10s %10s %12s %14s %10s\n", "n", "steps", "seconds",
+               "Mupdates/s", "GB/s");
+        printf("%10"PRIu64" %10"PRIu64" %12.4lf %14.2lf %10.2lf\n", n, max_t,
+               secs, updates / secs * 1e-6,
+               updates * 2.0 * sizeof(double) / secs * 1e-9);
+        /* named as the other heat-tx versions name them */
+        snprintf(path, sizeof(path), "updates n=%"PRIu64, n);
+        cody_metric(path, updates / secs * 1e-6, "Mupdates/s");
+        snprintf(path, sizeof(path), "bandwidth n=%"PRIu64, n);
+        cody_metric(path, updates * 2.0 * sizeof(double) / secs * 1e-9,
+                    "GB/s");
+        cody_work("run", updates * 1e-6, "Mupdates");
+    }
+    /* the odd steps, as the other heat-tx versions dump */
+    snprintf(path, sizeof(path), "heat-img.%s", dump_ext[format]);
+    cody_begin("dump");
+    rc = block_write(block, 1, path, format);
+    cody_end();
+    if (SUCCESS != rc) goto cleanup;
+    /* all is well */
+    erc = EXIT_SUCCESS;
+    if (0 != cody_finish()) erc = EXIT_FAILURE;
+
+cleanup:
+    (void)block_destruct(block);
+    MPI_Finalize();
+    return erc;
+}
@@ -0,0 +1,1198 @@
+/* See cody.h */
+
+#define _POSIX_C_SOURCE 200809L
+/* madvise, MAP_HUGETLB, syscall and sched_setaffinity */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "cody.h"
+
+#ifdef CODY_PAPI
+#include <papi.h>
+#endif
+#ifdef CODY_NVML
+#include <nvml.h>
+#endif
+
+#define CODY_PARAMS  32
+#define CODY_METRICS 64
+#define CODY_KEY     64
+#define CODY_VALUE   128
+#define CODY_BLOCKS  256   /* blocks of cody_alloc live at once */
+
+#define HUGE_PAGE  (2UL * 1024 * 1024)
+/* the NUMA nodes, and interleaving them as mbind(2) takes it */
+#define NODE_PATH  "/sys/devices/system/node/online"
+#define NODE_MASK  16
+#define MPOL_INTERLEAVE_ 3
+
+/* the topology of every CPU, and the largest set of them */
+#define CPU_PATH "/sys/devices/system/cpu/cpu%d/topology/%s"
+#ifndef CPU_SETSIZE
+#define CPU_SETSIZE 1024
+#endif
+
+/* package energy is read from the powercap zones of Linux, which AMD
+ * processors also use */
+#define RAPL_ZONES 8
+#define RAPL_PATH  "/sys/class/powercap/intel-rapl:%d/%s"
+/* and that of NVIDIA GPUs from NVML, Volta and later */
+#define NVML_GPUS  8
+
+/* the hardware counters of every region: cycles, L2 and L3 misses and
+ * double precision operations when built with CODY_PAPI, as MISH counts
+ * them, the energy of the packages with CODY_RAPL set and that of the GPUs
+ * when built with CODY_NVML and CODY_NVML set */
+enum {HW_CYCLES, HW_L2MISS, HW_L3MISS, HW_FLOPS, HW_ENERGY, HW_GPU_ENERGY,
+      NHW};
+
+static const char *hw_name[NHW] = {
+    "cycles", "l2miss", "l3miss", "flops", "energy_j", "gpu_energy_j"
+};
+
+/* the counters, and the joules of the packages and of the GPUs since
+ * cody_init */
+typedef struct {
+    long long papi[HW_ENERGY];
+    double joules[NHW - HW_ENERGY];
+} sample_t;
+
+typedef struct {
+    char name[CODY_NAME];
+    long calls;
+    double seconds, min, max;
+    int ncounters;
+    char counter[CODY_COUNTERS][CODY_KEY];
+    double count[CODY_COUNTERS];
+} region_t;
+
+static struct {
+    int on;
+    int rank, nranks;
+    char app[CODY_KEY], impl[CODY_KEY], host[CODY_KEY], start[CODY_KEY];
+    const char *out;
+    int full;
+
+    region_t region[CODY_REGIONS];
+    int nregions;
+    struct {
+        int region;
+        double t0;
+        sample_t hw;
+    } open[CODY_DEPTH];
+    int depth;
+
+    char key[CODY_PARAMS][CODY_KEY], value[CODY_PARAMS][CODY_VALUE];
+    int nparams;
+    char metric[CODY_METRICS][CODY_KEY], unit[CODY_METRICS][CODY_KEY];
+    double measure[CODY_METRICS];
+    int nmetrics;
+    /* the work of regions, or of the run for region -1 */
+    struct {
+        int region;
+        double amount;
+        char unit[CODY_KEY];
+    } work[CODY_METRICS];
+    int nworks;
+
+    int hw_on[NHW];
+    int rapl_zones;
+    double rapl_range[RAPL_ZONES];
+    /* the last readings of the energy counters, which wrap, and the joules
+     * they add up to; sampled at every region's ends, so that a region may
+     * run longer than the counters take to wrap */
+    double uj[RAPL_ZONES], mj[NVML_GPUS];
+    double joules[NHW - HW_ENERGY];
+    int gpus;
+    double t0;
+    sample_t hw0;
+#ifdef CODY_PAPI
+    int eventset;
+#endif
+#ifdef CODY_NVML
+    nvmlDevice_t gpu[NVML_GPUS];
+#endif
+} cody;
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* counters */
+/* ////////////////////////////////////////////////////////////////////////// */
+static int
+rapl_value(int zone, const char *file, double *v)
+{
+    char path[128];
+    FILE *f;
+    int ok;
+
+    snprintf(path, sizeof(path), RAPL_PATH, zone, file);
+    if (NULL == (f = fopen(path, "r"))) return 0;
+    ok = (1 == fscanf(f, "%lf", v));
+    fclose(f);
+    return ok;
+}
+
+static void
+rapl_init(void)
+{
+    const char *env = getenv("CODY_RAPL");
+    int z;
+
+    if (NULL == env || 0 == strcmp(env, "0")) return;
+    for (z = 0; z < RAPL_ZONES; z++) {
+        if (!rapl_value(z, "energy_uj", &cody.uj[z]) ||
+            !rapl_value(z, "max_energy_range_uj", &cody.rapl_range[z])) break;
+    }
+    cody.rapl_zones = z;
+    cody.hw_on[HW_ENERGY] = (z > 0);
+    if (0 == z) {
+        fprintf(stderr, "CODY_RAPL: no readable RAPL zones, no energy\n");
+    }
+}
+
+static void
+nvml_init(void)
+{
+    const char *env = getenv("CODY_NVML");
+#ifdef CODY_NVML
+    unsigned int n = 0, i;
+    unsigned long long mj;
+#endif
+
+    if (NULL == env || 0 == strcmp(env, "0")) return;
+#ifdef CODY_NVML
+    if (NVML_SUCCESS != nvmlInit_v2()) {
+        fprintf(stderr, "CODY_NVML: could not initialise NVML, no GPU "
+                "energy\n");
+        return;
+    }
+    (void)nvmlDeviceGetCount_v2(&n);
+    for (i = 0; i < n && cody.gpus < NVML_GPUS; i++) {
+        nvmlDevice_t *gpu = &cody.gpu[cody.gpus];
+
+        if (NVML_SUCCESS == nvmlDeviceGetHandleByIndex_v2(i, gpu) &&
+            NVML_SUCCESS == nvmlDeviceGetTotalEnergyConsumption(*gpu, &mj)) {
+            cody.mj[cody.gpus++] = (double)mj;
+        }
+    }
+    cody.hw_on[HW_GPU_ENERGY] = (cody.gpus > 0);
+    if (0 == cody.gpus) {
+        fprintf(stderr, "CODY_NVML: no GPU reports its energy\n");
+        nvmlShutdown();
+    }
+#else
+    fprintf(stderr, "CODY_NVML: cody.c built without CODY_NVML, no GPU "
+            "energy\n");
+#endif
+}
+
+static void
+papi_init(void)
+{
+#ifdef CODY_PAPI
+    static const int event[HW_ENERGY] = {
+        PAPI_TOT_CYC, PAPI_L2_TCM, PAPI_L3_TCM, PAPI_DP_OPS
+    };
+    int k;
+
+    cody.eventset = PAPI_NULL;
+    if (PAPI_NOT_INITED == PAPI_is_initialized() &&
+        PAPI_VER_CURRENT != PAPI_library_init(PAPI_VER_CURRENT)) {
+        fprintf(stderr, "CODY_PAPI: could not initialise PAPI\n");
+        return;
+    }
+    if (PAPI_OK != PAPI_create_eventset(&cody.eventset)) return;
+    for (k = 0; k < HW_ENERGY; k++) {
+        cody.hw_on[k] = (PAPI_OK == PAPI_query_event(event[k]) &&
+                         PAPI_OK == PAPI_add_event(cody.eventset, event[k]));
+    }
+    /* a thread runs one event set at a time, so an app counting on its own
+     * keeps its counters and cody goes without */
+    if (PAPI_OK != PAPI_start(cody.eventset)) {
+        fprintf(stderr, "CODY_PAPI: could not start the counters\n");
+        PAPI_cleanup_eventset(cody.eventset);
+        PAPI_destroy_eventset(&cody.eventset);
+        cody.eventset = PAPI_NULL;
+        for (k = 0; k < HW_ENERGY; k++) cody.hw_on[k] = 0;
+    }
+#endif
+}
+
+static void
+hw_sample(sample_t *s)
+{
+    double v;
+    int z, g;
+
+#ifdef CODY_PAPI
+    if (PAPI_NULL != cody.eventset) {
+        long long raw[HW_ENERGY];
+        int k, r;
+
+        PAPI_read(cody.eventset, raw);
+        for (k = 0, r = 0; k < HW_ENERGY; k++) {
+            s->papi[k] = cody.hw_on[k] ? raw[r++] : 0;
+        }
+    }
+#endif
+    for (z = 0; z < cody.rapl_zones; z++) {
+        if (!rapl_value(z, "energy_uj", &v)) continue;
+        /* the counters wrap at the zone's range */
+        cody.joules[0] += 1e-6 * ((v < cody.uj[z]) ? v - cody.uj[z] +
+                                  cody.rapl_range[z] : v - cody.uj[z]);
+        cody.uj[z] = v;
+    }
+    for (g = 0; g < cody.gpus; g++) {
+#ifdef CODY_NVML
+        unsigned long long mj;
+
+        if (NVML_SUCCESS !=
+            nvmlDeviceGetTotalEnergyConsumption(cody.gpu[g], &mj)) continue;
+        v = (double)mj;
+#else
+        v = cody.mj[g];
+#endif
+        cody.joules[1] += 1e-3 * (v - cody.mj[g]);
+        cody.mj[g] = v;
+    }
+    memcpy(s->joules, cody.joules, sizeof(s->joules));
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* regions */
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the region of name inside the open ones, added if new, or -1 once the
+ * table is full */
+static int
+region_find(const char *name)
+{
+    char path[2 * CODY_NAME];
+    region_t *r;
+    int i;
+
+    if (cody.depth > 0) {
+        snprintf(path, sizeof(path), "%s/%s",
+                 cody.region[cody.open[cody.depth - 1].region].name, name);
+    }
+    else {
+        snprintf(path, sizeof(path), "%s", name);
+    }
+    path[CODY_NAME - 1] = '\0';
+    for (i = 0; i < cody.nregions; i++) {
+        if (0 == strcmp(cody.region[i].name, path)) return i;
+    }
+    if (CODY_REGIONS == cody.nregions) {
+        if (!cody.full) {
+            fprintf(stderr, "cody: more than %d regions, %s and later "
+                    "dropped\n", CODY_REGIONS, path);
+        }
+        cody.full = 1;
+        return -1;
+    }
+    r = &cody.region[cody.nregions];
+    memset(r, 0, sizeof(*r));
+    memcpy(r->name, path, CODY_NAME);
+    return cody.nregions++;
+}
+
+static void
+region_time(region_t *r, double seconds, long calls)
+{
+    double each = seconds / (double)calls;
+
+    if (0 == r->calls || each < r->min) r->min = each;
+    if (0 == r->calls || each > r->max) r->max = each;
+    r->calls += calls;
+    r->seconds += seconds;
+}
+
+static void
+region_count(region_t *r, const char *counter, double value)
+{
+    int k;
+
+    for (k = 0; k < r->ncounters; k++) {
+        if (0 == strcmp(r->counter[k], counter)) break;
+    }
+    if (k == r->ncounters) {
+        if (CODY_COUNTERS == k) return;
+        snprintf(r->counter[k], CODY_KEY, "%s", counter);
+        r->count[k] = 0;
+        r->ncounters++;
+    }
+    r->count[k] += value;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* interface */
+/* ////////////////////////////////////////////////////////////////////////// */
+void
+cody_init(const char *app, const char *impl)
+{
+    const char *base = strrchr(impl, '/');
+    time_t now = time(NULL);
+
+    memset(&cody, 0, sizeof(cody));
+    cody.on = 1;
+    cody.nranks = 1;
+    snprintf(cody.app, CODY_KEY, "%s", app);
+    snprintf(cody.impl, CODY_KEY, "%s", base ? base + 1 : impl);
+    if (0 != gethostname(cody.host, CODY_KEY)) strcpy(cody.host, "unknown");
+    cody.host[CODY_KEY - 1] = '\0';
+    strftime(cody.start, CODY_KEY, "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+    cody.out = getenv("CODY_OUT");
+    if (NULL != cody.out && '\0' == cody.out[0]) cody.out = NULL;
+    papi_init();
+    rapl_init();
+    nvml_init();
+    hw_sample(&cody.hw0);
+    cody.t0 = cody_now();
+}
+
+void
+cody_rank(int rank, int nranks)
+{
+    cody.rank = rank;
+    cody.nranks = nranks;
+}
+
+void
+cody_param(const char *key, const char *fmt, ...)
+{
+    va_list ap;
+    int i;
+
+    if (!cody.on) return;
+    for (i = 0; i < cody.nparams; i++) {
+        if (0 == strcmp(cody.key[i], key)) break;
+    }
+    if (i == cody.nparams) {
+        if (CODY_PARAMS == i) return;
+        cody.nparams++;
+    }
+    snprintf(cody.key[i], CODY_KEY, "%s", key);
+    va_start(ap, fmt);
+    vsnprintf(cody.value[i], CODY_VALUE, fmt, ap);
+    va_end(ap);
+}
+
+void
+cody_begin(const char *name)
+{
+    int d = cody.depth;
+
+    if (!cody.on) return;
+    if (CODY_DEPTH == d) {
+        fprintf(stderr, "cody: regions nested deeper than %d\n", CODY_DEPTH);
+        cody.depth++;
+        return;
+    }
+    cody.open[d].region = region_find(name);
+    hw_sample(&cody.open[d].hw);
+    cody.depth++;
+    /* last, so that reading the counters is not timed */
+    cody.open[d].t0 = cody_now();
+}
+
+void
+cody_end(void)
+{
+    double t1 = cody_now();
+    sample_t hw;
+    region_t *r;
+    int d, k;
+
+    if (!cody.on) return;
+    if (0 == cody.depth) {
+        fprintf(stderr, "cody: cody_end without cody_begin\n");
+        return;
+    }
+    d = --cody.depth;
+    if (d >= CODY_DEPTH || cody.open[d].region < 0) return;
+    r = &cody.region[cody.open[d].region];
+    region_time(r, t1 - cody.open[d].t0, 1);
+    hw_sample(&hw);
+    for (k = 0; k < HW_ENERGY; k++) {
+        if (cody.hw_on[k]) {
+            region_count(r, hw_name[k],
+                         (double)(hw.papi[k] - cody.open[d].hw.papi[k]));
+        }
+    }
+    for (k = HW_ENERGY; k < NHW; k++) {
+        if (cody.hw_on[k]) {
+            region_count(r, hw_name[k], hw.joules[k - HW_ENERGY] -
+                                        cody.open[d].hw.joules[k - HW_ENERGY]);
+        }
+    }
+}
+
+void
+cody_record(const char *name, double seconds, long calls)
+{
+    int i;
+
+    if (!cody.on || calls <= 0 || (i = region_find(name)) < 0) return;
+    region_time(&cody.region[i], seconds, calls);
+}
+
+void
+cody_count(const char *name, const char *counter, double value)
+{
+    int i;
+
+    if (!cody.on || (i = region_find(name)) < 0) return;
+    region_count(&cody.region[i], counter, value);
+}
+
+void
+cody_metric(const char *name, double value, const char *unit)
+{
+    int m = cody.nmetrics;
+
+    if (!cody.on || CODY_METRICS == m) return;
+    snprintf(cody.metric[m], CODY_KEY, "%s", name);
+    snprintf(cody.unit[m], CODY_KEY, "%s", unit);
+    cody.measure[m] = value;
+    cody.nmetrics++;
+}
+
+void
+cody_work(const char *name, double amount, const char *unit)
+{
+    int i = -1, w;
+
+    if (!cody.on || (NULL != name && (i = region_find(name)) < 0)) return;
+    for (w = 0; w < cody.nworks; w++) {
+        if (cody.work[w].region == i && 0 == strcmp(cody.work[w].unit, unit)) {
+            break;
+        }
+    }
+    if (w == cody.nworks) {
+        if (CODY_METRICS == w) return;
+        cody.work[w].region = i;
+        cody.work[w].amount = 0;
+        snprintf(cody.work[w].unit, CODY_KEY, "%s", unit);
+        cody.nworks++;
+    }
+    cody.work[w].amount += amount;
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* allocation */
+/* ////////////////////////////////////////////////////////////////////////// */
+/* kept apart from cody, as apps allocate before cody_init and free after
+ * cody_finish, and locked, as library instances of MISH allocate on their
+ * own threads */
+static struct {
+    volatile int lock;
+    int ready;
+    const char *pages, *numa;
+    int nodes;
+    unsigned long mask[NODE_MASK];
+    struct {
+        void *p;
+        size_t bytes;
+        int mapped;
+    } block[CODY_BLOCKS];
+    int nblocks, full, warned;
+    size_t live, peak;
+} mem;
+
+/* the online nodes, from a list such as "0-3,8" */
+static void
+mem_nodes(void)
+{
+    FILE *f = fopen(NODE_PATH, "r");
+    int lo, hi, n;
+    char sep;
+
+    if (NULL == f) return;
+    while (fscanf(f, "%d", &lo) == 1) {
+        hi = lo;
+        if (1 == fscanf(f, "%c", &sep) && '-' == sep) {
+            if (1 != fscanf(f, "%d", &hi)) break;
+            if (1 != fscanf(f, "%c", &sep)) sep = '\n';
+        }
+        for (n = lo; n <= hi && n < NODE_MASK * 64; n++) {
+            mem.mask[n / 64] |= 1UL << (n % 64);
+            mem.nodes++;
+        }
+        if (',' != sep) break;
+    }
+    fclose(f);
+}
+
+static void
+mem_init(void)
+{
+    mem.ready = 1;
+    mem.pages = getenv("CODY_PAGES");
+    mem.numa = getenv("CODY_NUMA");
+    if (NULL != mem.pages && '\0' == mem.pages[0]) mem.pages = NULL;
+    if (NULL != mem.numa && '\0' == mem.numa[0]) mem.numa = NULL;
+    if (NULL != mem.pages && 0 != strcmp(mem.pages, "small") &&
+        0 != strcmp(mem.pages, "huge") && 0 != strcmp(mem.pages, "hugetlb")) {
+        fprintf(stderr, "CODY_PAGES: %s is not small, huge or hugetlb\n",
+                mem.pages);
+        mem.pages = NULL;
+    }
+    if (NULL != mem.numa && 0 != strcmp(mem.numa, "local") &&
+        0 != strcmp(mem.numa, "interleave")) {
+        fprintf(stderr, "CODY_NUMA: %s is not local or interleave\n",
+                mem.numa);
+        mem.numa = NULL;
+    }
+    mem_nodes();
+}
+
+/* a block of hugetlbfs pages, which the kernel hands out zeroed and
+ * aligned to their size, or NULL if none are reserved */
+static void *
+mem_hugetlb(size_t bytes)
+{
+#ifdef MAP_HUGETLB
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+    if (MAP_FAILED != p) return p;
+#endif
+    if (!mem.warned) {
+        fprintf(stderr, "CODY_PAGES: no hugetlbfs pages, using transparent "
+                "huge pages\n");
+        mem.warned = 1;
+    }
+    return NULL;
+}
+
+static void
+mem_interleave(void *p, size_t bytes)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if (mem.nodes > 1 &&
+        0 != syscall(SYS_mbind, p, bytes, MPOL_INTERLEAVE_, mem.mask,
+                     (unsigned long)(NODE_MASK * 64 + 1), 0UL)) {
+        fprintf(stderr, "CODY_NUMA: cannot interleave %zu bytes\n", bytes);
+    }
+#else
+    (void)p;
+    (void)bytes;
+#endif
+}
+
+static void
+mem_lock(void)
+{
+    while (__sync_lock_test_and_set(&mem.lock, 1)) {
+        while (mem.lock) {}
+    }
+}
+
+static void
+mem_unlock(void)
+{
+    __sync_lock_release(&mem.lock);
+}
+
+void *
+cody_alloc(size_t bytes, size_t align, int flags)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    void *p = NULL;
+    int mapped = 0, tracked;
+
+    mem_lock();
+    if (!mem.ready) mem_init();
+    /* the environment sets the policy of every block large enough to be
+     * worth a huge page, so the apps can be compared without rebuilding */
+    if (NULL != mem.pages && bytes >= HUGE_PAGE) {
+        if (0 == strcmp(mem.pages, "small")) flags &= ~CODY_HUGE;
+        else flags |= CODY_HUGE;
+    }
+    if (NULL != mem.numa) {
+        if (0 == strcmp(mem.numa, "local")) flags &= ~CODY_INTERLEAVE;
+        else flags |= CODY_INTERLEAVE;
+    }
+    if (align < sizeof(void *)) align = sizeof(void *);
+    /* madvise and mbind work on whole pages, and rounding to the
+     * alignment keeps other data off them */
+    if ((flags & CODY_HUGE) && align < HUGE_PAGE) align = HUGE_PAGE;
+    if ((flags & CODY_INTERLEAVE) && align < page) align = page;
+    if (bytes > (size_t)-1 - align) {
+        mem_unlock();
+        return NULL;
+    }
+    bytes = (0 == bytes) ? align : (bytes + align - 1) / align * align;
+
+    tracked = (CODY_BLOCKS != mem.nblocks);
+    if (!tracked && !mem.full) {
+        fprintf(stderr, "cody: more than %d blocks, later ones not "
+                "counted\n", CODY_BLOCKS);
+        mem.full = 1;
+    }
+    /* a mapping has to be unmapped, so only counted blocks are mapped */
+    if (tracked && (flags & CODY_HUGE) && align <= HUGE_PAGE &&
+        NULL != mem.pages && 0 == strcmp(mem.pages, "hugetlb")) {
+        mapped = (NULL != (p = mem_hugetlb(bytes)));
+    }
+    if (NULL == p && 0 != posix_memalign(&p, align, bytes)) {
+        mem_unlock();
+        return NULL;
+    }
+#ifdef MADV_HUGEPAGE
+    /* only advice, the kernel may still use small pages */
+    if (!mapped && (flags & CODY_HUGE)) (void)madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+    /* before the first touch, which places the pages */
+    if (flags & CODY_INTERLEAVE) mem_interleave(p, bytes);
+    if (tracked) {
+        mem.block[mem.nblocks].p = p;
+        mem.block[mem.nblocks].bytes = bytes;
+        mem.block[mem.nblocks].mapped = mapped;
+        mem.nblocks++;
+        mem.live += bytes;
+        if (mem.live > mem.peak) mem.peak = mem.live;
+    }
+    mem_unlock();
+
+    if (!mapped && !(flags & CODY_FIRST_TOUCH)) memset(p, 0, bytes);
+    return p;
+}
+
+void
+cody_free(void *p)
+{
+    int i;
+
+    if (NULL == p) return;
+    mem_lock();
+    for (i = mem.nblocks - 1; i >= 0; i--) {
+        if (mem.block[i].p == p) break;
+    }
+    if (i < 0) free(p);
+    else {
+        mem.live -= mem.block[i].bytes;
+        if (mem.block[i].mapped) (void)munmap(p, mem.block[i].bytes);
+        else free(p);
+        mem.block[i] = mem.block[--mem.nblocks];
+    }
+    mem_unlock();
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* pinning */
+/* ////////////////////////////////////////////////////////////////////////// */
+/* a CPU this process may run on: its package, its core and which hardware
+ * thread of the core it is, and the index of its core in the node and in
+ * its package */
+typedef struct {
+    int cpu, pkg, core, smt;
+    int node_core, pkg_core;
+} place_t;
+
+/* kept apart from cody, as apps pin their threads before cody_init */
+static struct {
+    const char *mode;
+    char cpus[CODY_VALUE];
+} pin;
+
+static int
+cpu_topology(int cpu, const char *file)
+{
+    char path[128];
+    FILE *f;
+    int v;
+
+    snprintf(path, sizeof(path), CPU_PATH, cpu, file);
+    if (NULL == (f = fopen(path, "r"))) return -1;
+    if (1 != fscanf(f, "%d", &v)) v = -1;
+    fclose(f);
+    return v;
+}
+
+/* the node's order, core by core, in which the ranks split it */
+static int
+place_node(const void *a, const void *b)
+{
+    const place_t *p = (const place_t *)a, *q = (const place_t *)b;
+
+    if (p->pkg != q->pkg) return p->pkg - q->pkg;
+    if (p->core != q->core) return p->core - q->core;
+    return p->smt - q->smt;
+}
+
+/* one thread per core first, filling a package before the next */
+static int
+place_compact(const void *a, const void *b)
+{
+    const place_t *p = (const place_t *)a, *q = (const place_t *)b;
+
+    if (p->smt != q->smt) return p->smt - q->smt;
+    return place_node(a, b);
+}
+
+/* one thread per core first, dealt round the packages */
+static int
+place_scatter(const void *a, const void *b)
+{
+    const place_t *p = (const place_t *)a, *q = (const place_t *)b;
+
+    if (p->smt != q->smt) return p->smt - q->smt;
+    if (p->pkg_core != q->pkg_core) return p->pkg_core - q->pkg_core;
+    return p->pkg - q->pkg;
+}
+
+static int
+cpu_order(const void *a, const void *b)
+{
+    return *(const int *)a - *(const int *)b;
+}
+
+/* cpus in thread order, runs of consecutive ones as ranges */
+static void
+cpus_text(const int *cpu, int n, char *text, size_t len)
+{
+    size_t used = 0;
+    int i, j;
+
+    text[0] = '\0';
+    for (i = 0; i < n && used < len; i = j + 1) {
+        for (j = i; j + 1 < n && cpu[j + 1] == cpu[j] + 1; j++) {}
+        if (j > i) {
+            used += snprintf(text + used, len - used, "%s%d-%d",
+                             i ? "," : "", cpu[i], cpu[j]);
+        }
+        else {
+            used += snprintf(text + used, len - used, "%s%d", i ? "," : "",
+                             cpu[i]);
+        }
+    }
+    if (used >= len && len > 4) strcpy(text + len - 4, "...");
+}
+
+#ifdef __linux__
+/* the CPUs of the process, with their topology, in the node's order */
+static int
+pin_places(place_t *place)
+{
+    cpu_set_t set;
+    int n = 0, i, c, k, cores = 0, pkg_cores = 0;
+
+    if (0 != sched_getaffinity(0, sizeof(set), &set)) return 0;
+    for (c = 0; c < CPU_SETSIZE; c++) {
+        if (!CPU_ISSET(c, &set)) continue;
+        place[n].cpu = c;
+        place[n].pkg = cpu_topology(c, "physical_package_id");
+        place[n].core = cpu_topology(c, "core_id");
+        if (place[n].pkg < 0) place[n].pkg = 0;
+        if (place[n].core < 0) place[n].core = c;
+        place[n].smt = 0;
+        for (k = 0; k < n; k++) {
+            if (place[k].pkg == place[n].pkg &&
+                place[k].core == place[n].core) place[n].smt++;
+        }
+        n++;
+    }
+    qsort(place, n, sizeof(*place), place_node);
+    for (i = 0; i < n; i++) {
+        if (i > 0 && place[i].pkg != place[i - 1].pkg) pkg_cores = 0;
+        if (0 == place[i].smt) {
+            cores++;
+            pkg_cores++;
+        }
+        place[i].node_core = cores - 1;
+        place[i].pkg_core = pkg_cores - 1;
+    }
+    return n;
+}
+
+static int
+pin_cpu(int cpu)
+{
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+}
+#endif
+
+void
+cody_pin(int local, int nlocal)
+{
+    static place_t place[CPU_SETSIZE];
+    static int cpu[CPU_SETSIZE];
+    const char *mode = getenv("CODY_PIN");
+    char where[64] = "";
+    int n = 0, nthreads = 1, ncores, lo, hi, i, k, failed = 0;
+
+    if (NULL != mode && ('\0' == mode[0] || 0 == strcmp(mode, "none"))) {
+        mode = NULL;
+    }
+    if (NULL != mode && 0 != strcmp(mode, "compact") &&
+        0 != strcmp(mode, "scatter")) {
+        fprintf(stderr, "CODY_PIN: %s is not compact, scatter or none\n",
+                mode);
+        mode = NULL;
+    }
+#ifdef __linux__
+    n = pin_places(place);
+#endif
+    if (NULL != mode && n > 0) {
+        /* this rank's share of the cores, with all their hardware threads */
+        ncores = place[n - 1].node_core + 1;
+        if (nlocal > 1 && ncores < nlocal) {
+            fprintf(stderr, "CODY_PIN: %d cores for %d ranks, run the ranks "
+                    "unbound\n", ncores, nlocal);
+        }
+        else if (nlocal > 1) {
+            lo = (int)((long)local * ncores / nlocal);
+            hi = (int)((long)(local + 1) * ncores / nlocal);
+            for (i = 0, k = 0; i < n; i++) {
+                if (place[i].node_core >= lo && place[i].node_core < hi) {
+                    place[k++] = place[i];
+                }
+            }
+            n = k;
+        }
+        qsort(place, n, sizeof(*place),
+              ('c' == mode[0]) ? place_compact : place_scatter);
+    }
+#ifdef __linux__
+    if (NULL != mode && n > 0) {
+#ifdef _OPENMP
+        /* each thread of the team binds itself; the runtime keeps the same
+         * threads for later teams of the same size */
+#pragma omp parallel reduction(+:failed)
+        {
+            int t = omp_get_thread_num();
+
+#pragma omp single
+            nthreads = omp_get_num_threads();
+            if (t < CPU_SETSIZE) {
+                cpu[t] = place[t % n].cpu;
+                failed += (0 != pin_cpu(cpu[t]));
+            }
+        }
+        if (nthreads > CPU_SETSIZE) nthreads = CPU_SETSIZE;
+#else
+        cpu[0] = place[0].cpu;
+        failed = (0 != pin_cpu(cpu[0]));
+#endif
+        if (failed) {
+            fprintf(stderr, "CODY_PIN: %d threads could not be bound\n",
+                    failed);
+        }
+    }
+#endif
+    if (NULL == mode || 0 == n) {
+        /* unbound: the CPUs the process may use */
+#ifdef _OPENMP
+        nthreads = omp_get_max_threads();
+#endif
+        for (i = 0; i < n; i++) cpu[i] = place[i].cpu;
+        qsort(cpu, n, sizeof(*cpu), cpu_order);
+        cpus_text(cpu, n, pin.cpus, sizeof(pin.cpus));
+    }
+    else {
+        cpus_text(cpu, nthreads, pin.cpus, sizeof(pin.cpus));
+    }
+    pin.mode = (NULL != mode && n > 0) ? mode : "none";
+    /* one write, so that the lines of the ranks do not mix */
+    if (nlocal > 1) {
+        snprintf(where, sizeof(where), "rank %d of %d on the node, ", local,
+                 nlocal);
+    }
+    if (0 == strcmp(pin.mode, "none")) {
+        fprintf(stderr, "cody: %s%d thread%s unpinned on cpus %s\n", where,
+                nthreads, (1 == nthreads) ? "" : "s", pin.cpus);
+    }
+    else {
+        fprintf(stderr, "cody: %s%d thread%s pinned %s to cpus %s\n", where,
+                nthreads, (1 == nthreads) ? "" : "s", pin.mode, pin.cpus);
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* energy */
+/* ////////////////////////////////////////////////////////////////////////// */
+/* the joules of the packages and the GPUs that region r counted */
+static double
+region_joules(const region_t *r)
+{
+    double j = 0;
+    int k;
+
+    for (k = 0; k < r->ncounters; k++) {
+        if (0 == strcmp(r->counter[k], hw_name[HW_ENERGY]) ||
+            0 == strcmp(r->counter[k], hw_name[HW_GPU_ENERGY])) {
+            j += r->count[k];
+        }
+    }
+    return j;
+}
+
+/* the energy and mean power of the run, of each region given work and the
+ * work per joule, as metrics and, from the rank that writes, on stderr */
+static void
+energy_metrics(void)
+{
+    char name[CODY_KEY], unit[CODY_KEY];
+    double seconds = cody_now() - cody.t0, joules, cpu, gpu;
+    const region_t *r;
+    sample_t hw;
+    int w;
+
+    if (!cody.hw_on[HW_ENERGY] && !cody.hw_on[HW_GPU_ENERGY]) return;
+    hw_sample(&hw);
+    cpu = hw.joules[0] - cody.hw0.joules[0];
+    gpu = hw.joules[1] - cody.hw0.joules[1];
+    cody_metric("energy", cpu + gpu, "J");
+    cody_metric("power", (cpu + gpu) / seconds, "W");
+    if (cody.hw_on[HW_GPU_ENERGY]) {
+        cody_metric("gpu energy", gpu, "J");
+        cody_metric("gpu power", gpu / seconds, "W");
+    }
+    if (0 == cody.rank) {
+        fprintf(stderr, "cody: %.4g J in %.4g s, %.4g W", cpu + gpu, seconds,
+                (cpu + gpu) / seconds);
+        if (cody.hw_on[HW_GPU_ENERGY]) {
+            fprintf(stderr, ", of which %d GPU%s %.4g J", cody.gpus,
+                    (1 == cody.gpus) ? "" : "s", gpu);
+        }
+        fputc('\n', stderr);
+    }
+    for (w = 0; w < cody.nworks; w++) {
+        snprintf(unit, sizeof(unit), "%.*s/J", CODY_KEY - 3,
+                 cody.work[w].unit);
+        if (cody.work[w].region < 0) {
+            if (cpu + gpu > 0) {
+                cody_metric("efficiency", cody.work[w].amount / (cpu + gpu),
+                            unit);
+            }
+            continue;
+        }
+        r = &cody.region[cody.work[w].region];
+        if ((joules = region_joules(r)) <= 0 || r->seconds <= 0) continue;
+        snprintf(name, sizeof(name), "energy %.*s", CODY_KEY - 8, r->name);
+        cody_metric(name, joules, "J");
+        snprintf(name, sizeof(name), "power %.*s", CODY_KEY - 7, r->name);
+        cody_metric(name, joules / r->seconds, "W");
+        snprintf(name, sizeof(name), "efficiency %.*s", CODY_KEY - 12,
+                 r->name);
+        cody_metric(name, cody.work[w].amount / joules, unit);
+        if (0 == cody.rank) {
+            fprintf(stderr, "cody: %s %.4g J, %.4g W, %.4g %s\n", r->name,
+                    joules, joules / r->seconds, cody.work[w].amount / joules,
+                    unit);
+        }
+    }
+}
+
+/* ////////////////////////////////////////////////////////////////////////// */
+/* output */
+/* ////////////////////////////////////////////////////////////////////////// */
+static void
+json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if ('"' == *s || '\\' == *s) fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20) fprintf(f, "\\u%04x", *s);
+        else fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+static void
+json_number(FILE *f, double v)
+{
+    if (isfinite(v)) fprintf(f, "%.9g", v);
+    else fputs("null", f);
+}
+
+/* the run as one JSON object on one line, so that runs appended to a file
+ * are read a line at a time */
+static void
+write_json(FILE *f)
+{
+    region_t *r;
+    int i, k;
+
+    fprintf(f, "{\"schema\":\"cody-1\",\"app\":");
+    json_string(f, cody.app);
+    fprintf(f, ",\"impl\":");
+    json_string(f, cody.impl);
+    fprintf(f, ",\"host\":");
+    json_string(f, cody.host);
+    fprintf(f, ",\"start\":\"%s\",\"ranks\":%d,\"params\":{", cody.start,
+            cody.nranks);
+    for (i = 0; i < cody.nparams; i++) {
+        if (i) fputc(',', f);
+        json_string(f, cody.key[i]);
+        fputc(':', f);
+        json_string(f, cody.value[i]);
+    }
+    fprintf(f, "},\"regions\":[");
+    for (i = 0; i < cody.nregions; i++) {
+        r = &cody.region[i];
+        fprintf(f, "%s{\"name\":", i ? "," : "");
+        json_string(f, r->name);
+        fprintf(f, ",\"calls\":%ld,\"seconds\":", r->calls);
+        json_number(f, r->seconds);
+        fprintf(f, ",\"min\":");
+        json_number(f, r->min);
+        fprintf(f, ",\"max\":");
+        json_number(f, r->max);
+        fprintf(f, ",\"counters\":{");
+        for (k = 0; k < r->ncounters; k++) {
+            if (k) fputc(',', f);
+            json_string(f, r->counter[k]);
+            fputc(':', f);
+            json_number(f, r->count[k]);
+        }
+        fprintf(f, "}}");
+    }
+    fprintf(f, "],\"metrics\":[");
+    for (i = 0; i < cody.nmetrics; i++) {
+        fprintf(f, "%s{\"name\":", i ? "," : "");
+        json_string(f, cody.metric[i]);
+        fprintf(f, ",\"value\":");
+        json_number(f, cody.measure[i]);
+        fprintf(f, ",\"unit\":");
+        json_string(f, cody.unit[i]);
+        fputc('}', f);
+    }
+    fprintf(f, "]}\n");
+}
+
+static void
+csv_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++) {
+        if ('"' == *s) fputc('"', f);
+        fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+/* one row per run, kind, name and statistic, so that the files of every
+ * app concatenate into one table */
+static void
+csv_row(FILE *f, const char *kind, const char *name, const char *stat,
+        double v, const char *text, const char *unit)
+{
+    csv_string(f, cody.app);
+    fputc(',', f);
+    csv_string(f, cody.impl);
+    fputc(',', f);
+    csv_string(f, cody.host);
+    fprintf(f, ",%s,%d,%s,", cody.start, cody.nranks, kind);
+    csv_string(f, name);
+    fprintf(f, ",%s,", stat);
+    if (NULL != text) csv_string(f, text);
+    else if (isfinite(v)) fprintf(f, "%.9g", v);
+    fputc(',', f);
+    csv_string(f, unit);
+    fputc('\n', f);
+}
+
+static void
+write_csv(FILE *f)
+{
+    region_t *r;
+    int i, k;
+
+    fseek(f, 0, SEEK_END);
+    if (0 == ftell(f)) {
+        fprintf(f, "app,impl,host,start,ranks,kind,name,stat,value,unit\n");
+    }
+    for (i = 0; i < cody.nparams; i++) {
+        csv_row(f, "param", cody.key[i], "value", 0, cody.value[i], "");
+    }
+    for (i = 0; i < cody.nregions; i++) {
+        r = &cody.region[i];
+        csv_row(f, "region", r->name, "calls", (double)r->calls, NULL, "");
+        csv_row(f, "region", r->name, "seconds", r->seconds, NULL, "s");
+        csv_row(f, "region", r->name, "min", r->min, NULL, "s");
+        csv_row(f, "region", r->name, "max", r->max, NULL, "s");
+        for (k = 0; k < r->ncounters; k++) {
+            csv_row(f, "region", r->name, r->counter[k], r->count[k], NULL,
+                    "");
+        }
+    }
+    for (i = 0; i < cody.nmetrics; i++) {
+        csv_row(f, "metric", cody.metric[i], "value", cody.measure[i], NULL,
+                cody.unit[i]);
+    }
+}
+
+int
+cody_finish(void)
+{
+    const char *ext;
+    FILE *f;
+    int rc = 0;
+
+    if (!cody.on) return 0;
+    cody.on = 0;
+#ifdef CODY_PAPI
+    if (PAPI_NULL != cody.eventset) {
+        long long raw[HW_ENERGY];
+
+        PAPI_stop(cody.eventset, raw);
+        PAPI_cleanup_eventset(cody.eventset);
+        PAPI_destroy_eventset(&cody.eventset);
+    }
+#endif
+    if (0 != cody.depth) {
+        fprintf(stderr, "cody: %d regions left open\n", cody.depth);
+    }
+    cody.on = 1;
+    energy_metrics();
+    if (NULL != pin.mode) {
+        cody_param("pin", "%s", pin.mode);
+        cody_param("cpus", "%s", pin.cpus);
+    }
+    if (mem.peak > 0) {
+        cody_param("pages", "%s", mem.pages ? mem.pages : "app");
+        cody_param("numa", "%s", mem.numa ? mem.numa : "app");
+        cody_metric("memory peak", 1e-6 * (double)mem.peak, "MB");
+    }
+    cody.on = 0;
+#ifdef CODY_NVML
+    if (cody.gpus > 0) nvmlShutdown();
+#endif
+    if (NULL == cody.out || 0 != cody.rank) return 0;
+    if (0 == strcmp(cody.out, "-")) {
+        write_json(stdout);
+        return 0;
+    }
+    if (NULL == (f = fopen(cody.out, "a"))) {
+        fprintf(stderr, "cody: cannot open %s\n", cody.out);
+        return 1;
+    }
+    ext = strrchr(cody.out, '.');
+    if (NULL != ext && 0 == strcmp(ext, ".csv")) write_csv(f);
+    else write_json(f);
+    if (0 != fclose(f)) {
+        fprintf(stderr, "cody: cannot write %s\n", cody.out);
+        rc = 1;
+    }
+    return rc;
+}
@@ -0,0 +1,107 @@
+/* cody: instrumentation shared by the CODY mini-apps, so that their timings
+ * can be compared with one another. An app names its implementation, times
+ * named regions, which nest, adds figures of merit and parameters, and at
+ * the end writes them in one schema to the file CODY_OUT names (see
+ * README.md), whatever the language, model or device it runs on.
+ *
+ * Regions are begun and ended by one thread, outside parallel regions, and
+ * are meant for at least microseconds of work. Each region counts calls,
+ * total, minimum and maximum seconds and, where available, hardware
+ * counters and the energy of the packages and GPUs over its calls. */
+
+#ifndef _CODY_H
+#define _CODY_H
+
+#include <stddef.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CODY_REGIONS  64   /* distinct regions in a run */
+#define CODY_DEPTH    8    /* regions open at once */
+#define CODY_COUNTERS 8    /* counters per region */
+#define CODY_NAME     128  /* bytes of a region's path */
+
+/* Seconds on the monotonic clock, from an arbitrary start. Inline, so that
+ * apps that only need a clock can include this header without linking
+ * cody.c. Strict C standards hide clock_gettime unless the includer defines
+ * _POSIX_C_SOURCE, as cody.c does */
+static inline double
+cody_now(void)
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+}
+
+/* Starts the run of app's implementation impl, of which only the part after
+ * the last '/' is kept so that argv[0] may be passed. Reads CODY_OUT,
+ * CODY_RAPL and CODY_NVML and starts the counters */
+void cody_init(const char *app, const char *impl);
+
+/* The rank of this process and the number of ranks; only rank 0 writes */
+void cody_rank(int rank, int nranks);
+
+/* A parameter of the run, e.g. the mesh size, as printf would format it */
+void cody_param(const char *key, const char *fmt, ...);
+
+/* Times a region until the matching cody_end. Its path is the paths of the
+ * open regions and name, joined by '/' */
+void cody_begin(const char *name);
+void cody_end(void);
+
+/* Adds calls calls of a region, inside the open ones, that took seconds in
+ * all, for times an app measured itself, e.g. on a device. Their minimum
+ * and maximum are taken to be the mean */
+void cody_record(const char *name, double seconds, long calls);
+
+/* Adds value to a counter of a region inside the open ones, for counters an
+ * app read itself */
+void cody_count(const char *name, const char *counter, double value);
+
+/* A figure of merit of the run, e.g. updates per second */
+void cody_metric(const char *name, double value, const char *unit);
+
+/* Adds amount of work, in unit, e.g. 1e-6 * cell updates in "Mupdates", to
+ * a region inside the open ones or, for a NULL name, to the whole run. With
+ * energy counted, the run ends with the region's joules, mean watts and
+ * work per joule as metrics */
+void cody_work(const char *name, double amount, const char *unit);
+
+/* cody_alloc flags */
+#define CODY_HUGE        1  /* backed by 2 MB transparent huge pages */
+#define CODY_INTERLEAVE  2  /* pages spread round robin over the NUMA nodes */
+#define CODY_FIRST_TOUCH 4  /* left unzeroed, so that each page is placed on
+                             * the node of the thread that first writes it */
+
+/* bytes of memory aligned to align, a power of two, zeroed unless
+ * CODY_FIRST_TOUCH is given, or NULL if out of memory. CODY_PAGES and
+ * CODY_NUMA override the flags for every app alike (see README.md). The
+ * bytes count towards the peak the run reports. Unlike the rest, may be
+ * called from any thread, and with or without cody_init */
+void *cody_alloc(size_t bytes, size_t align, int flags);
+
+/* Releases memory of cody_alloc; other memory is passed to free() */
+void cody_free(void *p);
+
+/* Pins the threads as CODY_PIN says: compact, one per core filling a
+ * package before the next, scatter, one per core dealt round the packages,
+ * or none. Process local of the nlocal on the node takes an even share of
+ * the cores it may run on, so MPI ranks should be started unbound. Binds
+ * the threads of an OpenMP team of the current size if cody.c is built
+ * with OpenMP, else the calling thread, and reports the binding on stderr.
+ * Called once threads are set and before the data is first touched */
+void cody_pin(int local, int nlocal);
+
+/* Writes the run to CODY_OUT, if set, and stops the counters. Returns
+ * non-zero if it could not be written */
+int cody_finish(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
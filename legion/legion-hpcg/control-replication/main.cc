@@ -0,0 +1,956 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/**
+ * A control-replicated CG for the HPCG problem.
+ *
+ * The top-level task is replicable, so the runtime runs a copy of it (a
+ * shard) on every node and splits each index launch between them. The
+ * top-level task is written as if it ran alone: the vectors of every MG level
+ * are one logical region, each launch point works on one piece of it, and the
+ * halo exchange and the allreduces of the explicit SPMD version are left to
+ * the runtime:
+ * - SPMV and SYMGS read their piece through an aliased ghost partition, which
+ *   overlaps the pieces above and below by one z-plane, and Legion copies
+ *   those planes between pieces.
+ * - The dot products are index launches whose future map is reduced with a
+ *   sum, and the CG scalars reach the update tasks as futures.
+ *
+ * The pieces are slabs of whole z-planes with the row numbering of
+ * GenerateProblem (x fastest), so the ghost rows of a piece are contiguous.
+ * The operator is the 27-point stencil applied matrix-free (26 on the
+ * diagonal, -1 for every neighbor), and b is A times ones, so x converges to
+ * ones. CG is preconditioned with the V-cycle of ComputeMG_ref: at each level
+ * a symmetric Gauss-Seidel pre- and post-smoother, and in between the residual
+ * injected into the grid coarsened by two in every dimension, which piece c
+ * also holds at the coarser level. Like the ranks of the reference, a piece
+ * sweeps its own rows with the ghost rows as they were before the sweep.
+ */
+
+#include "legion.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace Legion;
+
+enum TaskIDs {
+    TOP_LEVEL_TID,
+    INIT_TID,
+    SPMV_TID,
+    SYMGS_TID,
+    RESTRICTION_TID,
+    PROLONGATION_TID,
+    DOT_TID,
+    UPDATE_XR_TID,
+    UPDATE_P_TID,
+    RESIDUAL_TID,
+    ERROR_TID
+};
+
+/**
+ * The fields of every level. Coarse levels use R (their right-hand side), Z
+ * and Z2 (the MG result, which alternates between the two as the smoothers
+ * read one and write the other) and AP (A times the smoothed result).
+ */
+enum FieldIDs {
+    FID_X,
+    FID_B,
+    FID_R,
+    FID_P,
+    FID_AP,
+    FID_Z,
+    FID_Z2
+};
+
+/**
+ * The global grid of a level, nz whole planes split evenly between the
+ * pieces.
+ */
+struct CRGeometry {
+    coord_t nx, ny, nz;
+};
+
+/**
+ * A level and the next coarser one, for restriction and prolongation.
+ */
+struct CRGeometryPair {
+    CRGeometry fine, coarse;
+};
+
+/**
+ * The vectors of an MG level, level 0 being the CG problem.
+ */
+struct CRLevel {
+    CRGeometry g;
+    coord_t rows;
+    IndexSpace rowSpace;
+    LogicalRegion vectors;
+    LogicalPartition owned;
+    LogicalPartition ghost;
+};
+
+typedef FieldAccessor<READ_ONLY, double, 1, coord_t,
+                      Realm::AffineAccessor<double, 1, coord_t> > ROAccessor;
+typedef FieldAccessor<READ_WRITE, double, 1, coord_t,
+                      Realm::AffineAccessor<double, 1, coord_t> > RWAccessor;
+typedef FieldAccessor<WRITE_DISCARD, double, 1, coord_t,
+                      Realm::AffineAccessor<double, 1, coord_t> > WDAccessor;
+
+/**
+ * Run options, in the --name=value form of explicit-spmd.
+ */
+struct CRParams {
+    // Local grid of each piece, as --nx, --ny and --nz of explicit-spmd.
+    int nx, ny, nz;
+    int pieces;
+    int mgLevels;
+    int maxIters;
+    // CG iterations between residual checks, which wait on the dot product.
+    int checkFreq;
+    double tolerance;
+};
+
+static bool
+startswith(const char *s, const char *prefix)
+{
+    return strncmp(s, prefix, strlen(prefix)) == 0;
+}
+
+static CRParams
+parseParams(void)
+{
+    CRParams p;
+    p.nx = p.ny = p.nz = 32;
+    p.pieces = 4;
+    p.mgLevels = 4;
+    p.maxIters = 50;
+    p.checkFreq = 1;
+    p.tolerance = 0.0;
+    const InputArgs &args = Runtime::get_input_args();
+    for (int i = 1; i < args.argc; ++i) {
+        const char *a = args.argv[i];
+        if (startswith(a, "--nx=")) p.nx = atoi(a + 5);
+        else if (startswith(a, "--ny=")) p.ny = atoi(a + 5);
+        else if (startswith(a, "--nz=")) p.nz = atoi(a + 5);
+        else if (startswith(a, "--pieces=")) p.pieces = atoi(a + 9);
+        else if (startswith(a, "--mg-levels=")) p.mgLevels = atoi(a + 12);
+        else if (startswith(a, "--iters=")) p.maxIters = atoi(a + 8);
+        else if (startswith(a, "--check-freq=")) p.checkFreq = atoi(a + 13);
+        else if (startswith(a, "--tolerance=")) p.tolerance = atof(a + 12);
+    }
+    if (p.nx < 1) p.nx = 1;
+    if (p.ny < 1) p.ny = 1;
+    if (p.nz < 1) p.nz = 1;
+    if (p.pieces < 1) p.pieces = 1;
+    if (p.mgLevels < 1) p.mgLevels = 1;
+    if (p.maxIters < 1) p.maxIters = 1;
+    if (p.checkFreq < 1) p.checkFreq = 1;
+    // Every coarser level halves the local grid, as in HPCG.
+    while (p.mgLevels > 1) {
+        const int f = 1 << (p.mgLevels - 1);
+        if (p.nx % f == 0 && p.ny % f == 0 && p.nz % f == 0) break;
+        --p.mgLevels;
+    }
+    return p;
+}
+
+static Rect<1>
+pieceRect(
+    const Task *task,
+    unsigned rid,
+    Runtime *runtime
+) {
+    return runtime->get_index_space_domain(
+               task->regions[rid].region.get_index_space()
+           );
+}
+
+static FieldID
+fieldOf(
+    const Task *task,
+    unsigned rid
+) {
+    return task->regions[rid].instance_fields[0];
+}
+
+/**
+ * Init Task ///////////////////////////////////////////////////////////////////
+ * b = A * ones, x = 0, r = b.
+ */
+void
+initTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRGeometry &g = *(const CRGeometry *)task->args;
+    const WDAccessor x(regions[0], FID_X);
+    const WDAccessor b(regions[0], FID_B);
+    const WDAccessor r(regions[0], FID_R);
+    const Rect<1> rect = pieceRect(task, 0, runtime);
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        const coord_t ix = i % g.nx;
+        const coord_t iy = (i / g.nx) % g.ny;
+        const coord_t iz = i / (g.nx * g.ny);
+        // Points of the 3x3x3 neighborhood inside the grid, the row included.
+        const coord_t cx = (ix > 0) + 1 + (ix < g.nx - 1);
+        const coord_t cy = (iy > 0) + 1 + (iy < g.ny - 1);
+        const coord_t cz = (iz > 0) + 1 + (iz < g.nz - 1);
+        const double bi = 27.0 - double(cx * cy * cz);
+        x[i] = 0.0;
+        b[i] = bi;
+        r[i] = bi;
+    }
+}
+
+/**
+ * SPMV Task ///////////////////////////////////////////////////////////////////
+ * out = A * in, with in read through the ghost partition.
+ */
+void
+spmvTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRGeometry &g = *(const CRGeometry *)task->args;
+    const ROAccessor p(regions[0], fieldOf(task, 0));
+    const WDAccessor ap(regions[1], fieldOf(task, 1));
+    const Rect<1> rect = pieceRect(task, 1, runtime);
+    const coord_t plane = g.nx * g.ny;
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        const coord_t ix = i % g.nx;
+        const coord_t iy = (i / g.nx) % g.ny;
+        const coord_t iz = i / plane;
+        double sum = 27.0 * p[i];
+        for (coord_t dz = -1; dz <= 1; ++dz) {
+            if (iz + dz < 0 || iz + dz >= g.nz) continue;
+            for (coord_t dy = -1; dy <= 1; ++dy) {
+                if (iy + dy < 0 || iy + dy >= g.ny) continue;
+                for (coord_t dx = -1; dx <= 1; ++dx) {
+                    if (ix + dx < 0 || ix + dx >= g.nx) continue;
+                    sum -= p[i + dz * plane + dy * g.nx + dx];
+                }
+            }
+        }
+        ap[i] = sum;
+    }
+}
+
+/**
+ * SYMGS Task //////////////////////////////////////////////////////////////////
+ * One forward and one back Gauss-Seidel sweep of A out = rhs over the rows of
+ * the piece, starting from in, which is read through the ghost partition. The
+ * ghost rows keep the values of in; the result goes to the other field, since
+ * a launch may not read and write one field through aliased partitions.
+ */
+void
+symgsTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRGeometry &g = *(const CRGeometry *)task->args;
+    const ROAccessor in(regions[0], fieldOf(task, 0));
+    const ROAccessor rhs(regions[1], fieldOf(task, 1));
+    const WDAccessor out(regions[2], fieldOf(task, 2));
+    const Rect<1> rect = pieceRect(task, 2, runtime);
+    const coord_t lo = rect.lo[0], hi = rect.hi[0];
+    const coord_t plane = g.nx * g.ny;
+    std::vector<double> xl(hi - lo + 1);
+    for (coord_t i = lo; i <= hi; ++i) {
+        xl[i - lo] = in[i];
+    }
+    for (int sweep = 0; sweep < 2; ++sweep) {
+        for (coord_t k = 0; k <= hi - lo; ++k) {
+            const coord_t i = sweep == 0 ? lo + k : hi - k;
+            const coord_t ix = i % g.nx;
+            const coord_t iy = (i / g.nx) % g.ny;
+            const coord_t iz = i / plane;
+            double sum = rhs[i];
+            for (coord_t dz = -1; dz <= 1; ++dz) {
+                if (iz + dz < 0 || iz + dz >= g.nz) continue;
+                for (coord_t dy = -1; dy <= 1; ++dy) {
+                    if (iy + dy < 0 || iy + dy >= g.ny) continue;
+                    for (coord_t dx = -1; dx <= 1; ++dx) {
+                        if (ix + dx < 0 || ix + dx >= g.nx) continue;
+                        const coord_t j = i + dz * plane + dy * g.nx + dx;
+                        if (j == i) continue;
+                        sum += (j >= lo && j <= hi) ? xl[j - lo] : in[j];
+                    }
+                }
+            }
+            xl[i - lo] = sum / 26.0;
+        }
+    }
+    for (coord_t i = lo; i <= hi; ++i) {
+        out[i] = xl[i - lo];
+    }
+}
+
+/**
+ * The fine row that coarse row ic is injected from.
+ */
+static coord_t
+fineRow(
+    const CRGeometryPair &gp,
+    coord_t ic
+) {
+    const coord_t ixc = ic % gp.coarse.nx;
+    const coord_t iyc = (ic / gp.coarse.nx) % gp.coarse.ny;
+    const coord_t izc = ic / (gp.coarse.nx * gp.coarse.ny);
+    return 2 * ixc + gp.fine.nx * (2 * iyc + gp.fine.ny * 2 * izc);
+}
+
+/**
+ * Restriction Task ////////////////////////////////////////////////////////////
+ * rc = (r - Az) at the injected fine rows.
+ */
+void
+restrictionTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRGeometryPair &gp = *(const CRGeometryPair *)task->args;
+    const ROAccessor rf(regions[0], FID_R);
+    const ROAccessor azf(regions[0], FID_AP);
+    const WDAccessor rc(regions[1], FID_R);
+    const Rect<1> rect = pieceRect(task, 1, runtime);
+    for (coord_t ic = rect.lo[0]; ic <= rect.hi[0]; ++ic) {
+        const coord_t i = fineRow(gp, ic);
+        rc[ic] = rf[i] - azf[i];
+    }
+}
+
+/**
+ * Prolongation Task ///////////////////////////////////////////////////////////
+ * z += zc at the injected fine rows.
+ */
+void
+prolongationTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRGeometryPair &gp = *(const CRGeometryPair *)task->args;
+    const RWAccessor zf(regions[0], fieldOf(task, 0));
+    const ROAccessor zc(regions[1], fieldOf(task, 1));
+    const Rect<1> rect = pieceRect(task, 1, runtime);
+    for (coord_t ic = rect.lo[0]; ic <= rect.hi[0]; ++ic) {
+        const coord_t i = fineRow(gp, ic);
+        zf[i] = zf[i] + zc[ic];
+    }
+}
+
+/**
+ * Dot Task ////////////////////////////////////////////////////////////////////
+ * The contribution of a piece to a dot product of two fields, summed over the
+ * pieces by the reduction of the index launch.
+ */
+double
+dotTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const std::vector<FieldID> &fields =
+        task->regions[0].instance_fields;
+    const ROAccessor a(regions[0], fields[0]);
+    const ROAccessor b(regions[0], fields.size() > 1 ? fields[1] : fields[0]);
+    const Rect<1> rect = pieceRect(task, 0, runtime);
+    double sum = 0.0;
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/**
+ * Update X and R Task /////////////////////////////////////////////////////////
+ * alpha = rtz / pAp, x += alpha * p, r -= alpha * Ap.
+ */
+void
+updateXRTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const double rtz = task->futures[0].get_result<double>();
+    const double pAp = task->futures[1].get_result<double>();
+    const double alpha = rtz / pAp;
+    const RWAccessor x(regions[0], FID_X);
+    const RWAccessor r(regions[0], FID_R);
+    const ROAccessor p(regions[1], FID_P);
+    const ROAccessor ap(regions[1], FID_AP);
+    const Rect<1> rect = pieceRect(task, 0, runtime);
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        x[i] = x[i] + alpha * p[i];
+        r[i] = r[i] - alpha * ap[i];
+    }
+}
+
+/**
+ * Update P Task ///////////////////////////////////////////////////////////////
+ * p = z in the first iteration, then beta = rtz / rtzOld, p = z + beta * p.
+ */
+void
+updatePTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const bool first = *(const bool *)task->args;
+    const ROAccessor z(regions[0], fieldOf(task, 0));
+    const RWAccessor p(regions[1], FID_P);
+    const Rect<1> rect = pieceRect(task, 0, runtime);
+    if (first) {
+        for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+            p[i] = z[i];
+        }
+        return;
+    }
+    const double rtz = task->futures[0].get_result<double>();
+    const double rtzOld = task->futures[1].get_result<double>();
+    const double beta = rtz / rtzOld;
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        p[i] = z[i] + beta * p[i];
+    }
+}
+
+/**
+ * Residual Task ///////////////////////////////////////////////////////////////
+ * The contribution of a piece to |b - Ax|^2, with Ax in AP.
+ */
+double
+residualTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const ROAccessor b(regions[0], FID_B);
+    const ROAccessor ax(regions[0], FID_AP);
+    const Rect<1> rect = pieceRect(task, 0, runtime);
+    double sum = 0.0;
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        const double d = b[i] - ax[i];
+        sum += d * d;
+    }
+    return sum;
+}
+
+/**
+ * Error Task //////////////////////////////////////////////////////////////////
+ * The largest difference of x from the exact solution (ones) in a piece.
+ */
+double
+errorTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const ROAccessor x(regions[0], FID_X);
+    const Rect<1> rect = pieceRect(task, 0, runtime);
+    double err = 0.0;
+    for (coord_t i = rect.lo[0]; i <= rect.hi[0]; ++i) {
+        err = std::max(err, fabs(x[i] - 1.0));
+    }
+    return err;
+}
+
+/**
+ * Creates the vectors of a level and its owned and ghost partitions, for a
+ * local grid of nz planes per piece.
+ */
+static CRLevel
+createLevel(
+    const CRGeometry &g,
+    coord_t nz,
+    IndexSpaceT<1> pieces,
+    coord_t nPieces,
+    FieldSpace fs,
+    Context ctx,
+    Runtime *runtime
+) {
+    CRLevel l;
+    l.g = g;
+    const coord_t plane = g.nx * g.ny;
+    const coord_t pieceRows = plane * nz;
+    l.rows = pieceRows * nPieces;
+    const IndexSpaceT<1> rows =
+        runtime->create_index_space(ctx, Rect<1>(0, l.rows - 1));
+    l.rowSpace = rows;
+    l.vectors = runtime->create_logical_region(ctx, rows, fs);
+    // Piece c owns rows [c * pieceRows, (c + 1) * pieceRows).
+    Transform<1, 1> stride;
+    stride[0][0] = pieceRows;
+    const IndexPartition ownedIP = runtime->create_partition_by_restriction(
+        ctx, rows, pieces, stride, Rect<1>(0, pieceRows - 1),
+        LEGION_DISJOINT_COMPLETE_KIND
+    );
+    // And reads a plane more on each side, clipped to the grid.
+    const IndexPartition ghostIP = runtime->create_partition_by_restriction(
+        ctx, rows, pieces, stride, Rect<1>(-plane, pieceRows - 1 + plane),
+        nPieces > 1 ? LEGION_ALIASED_COMPLETE_KIND
+                    : LEGION_DISJOINT_COMPLETE_KIND
+    );
+    l.owned = runtime->get_logical_partition(ctx, l.vectors, ownedIP);
+    l.ghost = runtime->get_logical_partition(ctx, l.vectors, ghostIP);
+    return l;
+}
+
+/**
+ * out = A * in on a level.
+ */
+static void
+spmv(
+    const CRLevel &l,
+    FieldID in,
+    FieldID out,
+    IndexSpace pieces,
+    Context ctx,
+    Runtime *runtime
+) {
+    IndexTaskLauncher launcher(SPMV_TID, pieces,
+                               TaskArgument(&l.g, sizeof(l.g)), ArgumentMap());
+    launcher.add_region_requirement(
+        RegionRequirement(l.ghost, 0, READ_ONLY, EXCLUSIVE, l.vectors)
+    );
+    launcher.add_field(0, in);
+    launcher.add_region_requirement(
+        RegionRequirement(l.owned, 0, WRITE_DISCARD, EXCLUSIVE, l.vectors)
+    );
+    launcher.add_field(1, out);
+    runtime->execute_index_space(ctx, launcher);
+}
+
+/**
+ * A SYMGS sweep of a level from the MG result in field in, with the level's
+ * R on the right-hand side. Returns the field it leaves the result in.
+ */
+static FieldID
+symgs(
+    const CRLevel &l,
+    FieldID in,
+    IndexSpace pieces,
+    Context ctx,
+    Runtime *runtime
+) {
+    const FieldID out = in == FID_Z ? FID_Z2 : FID_Z;
+    IndexTaskLauncher launcher(SYMGS_TID, pieces,
+                               TaskArgument(&l.g, sizeof(l.g)), ArgumentMap());
+    launcher.add_region_requirement(
+        RegionRequirement(l.ghost, 0, READ_ONLY, EXCLUSIVE, l.vectors)
+    );
+    launcher.add_field(0, in);
+    launcher.add_region_requirement(
+        RegionRequirement(l.owned, 0, READ_ONLY, EXCLUSIVE, l.vectors)
+    );
+    launcher.add_field(1, FID_R);
+    launcher.add_region_requirement(
+        RegionRequirement(l.owned, 0, WRITE_DISCARD, EXCLUSIVE, l.vectors)
+    );
+    launcher.add_field(2, out);
+    runtime->execute_index_space(ctx, launcher);
+    return out;
+}
+
+/**
+ * The V-cycle of ComputeMG_ref from level k down, z = M r with r in field R
+ * of level k. Returns the field of level k holding z.
+ */
+static FieldID
+mg(
+    const std::vector<CRLevel> &levels,
+    size_t k,
+    IndexSpace pieces,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRLevel &l = levels[k];
+    runtime->fill_field<double>(ctx, l.vectors, l.vectors, FID_Z, 0.0);
+    FieldID z = symgs(l, FID_Z, pieces, ctx, runtime);
+    if (k + 1 == levels.size()) return z;
+
+    const CRLevel &c = levels[k + 1];
+    CRGeometryPair gp;
+    gp.fine = l.g;
+    gp.coarse = c.g;
+    const TaskArgument gpArg(&gp, sizeof(gp));
+    spmv(l, z, FID_AP, pieces, ctx, runtime);
+    {
+        IndexTaskLauncher launcher(RESTRICTION_TID, pieces, gpArg,
+                                   ArgumentMap());
+        launcher.add_region_requirement(
+            RegionRequirement(l.owned, 0, READ_ONLY, EXCLUSIVE, l.vectors)
+        );
+        launcher.add_field(0, FID_R);
+        launcher.add_field(0, FID_AP);
+        launcher.add_region_requirement(
+            RegionRequirement(c.owned, 0, WRITE_DISCARD, EXCLUSIVE, c.vectors)
+        );
+        launcher.add_field(1, FID_R);
+        runtime->execute_index_space(ctx, launcher);
+    }
+    const FieldID zc = mg(levels, k + 1, pieces, ctx, runtime);
+    {
+        IndexTaskLauncher launcher(PROLONGATION_TID, pieces, gpArg,
+                                   ArgumentMap());
+        launcher.add_region_requirement(
+            RegionRequirement(l.owned, 0, READ_WRITE, EXCLUSIVE, l.vectors)
+        );
+        launcher.add_field(0, z);
+        launcher.add_region_requirement(
+            RegionRequirement(c.owned, 0, READ_ONLY, EXCLUSIVE, c.vectors)
+        );
+        launcher.add_field(1, zc);
+        runtime->execute_index_space(ctx, launcher);
+    }
+    return symgs(l, z, pieces, ctx, runtime);
+}
+
+/**
+ * The sum over the pieces of the dot product of fields a and b of a level.
+ */
+static Future
+dot(
+    const CRLevel &l,
+    FieldID a,
+    FieldID b,
+    IndexSpace pieces,
+    Context ctx,
+    Runtime *runtime
+) {
+    IndexTaskLauncher launcher(DOT_TID, pieces, TaskArgument(), ArgumentMap());
+    launcher.add_region_requirement(
+        RegionRequirement(l.owned, 0, READ_ONLY, EXCLUSIVE, l.vectors)
+    );
+    launcher.add_field(0, a);
+    if (b != a) launcher.add_field(0, b);
+    return runtime->execute_index_space(ctx, launcher,
+                                        LEGION_REDOP_SUM_FLOAT64);
+}
+
+/**
+ * Floating point operations of a CG iteration, counted as ReportResults does:
+ * 2 per stencil point in SPMV and in each SYMGS sweep, 1 per row in
+ * restriction and prolongation, 2 per row in each dot and AXPY.
+ */
+static double
+iterationFlops(
+    const std::vector<CRLevel> &levels
+) {
+    double flops = double(levels[0].rows) * (2.0 * 27 + 3 * 2 + 3 * 2);
+    for (size_t k = 0; k < levels.size(); ++k) {
+        const double n = double(levels[k].rows);
+        const double sweep = 2.0 * 27 * n;
+        if (k + 1 < levels.size()) {
+            const double nc = double(levels[k + 1].rows);
+            flops += 4 * sweep + 2.0 * 27 * n + 2 * nc;
+        }
+        else {
+            flops += 2 * sweep;
+        }
+    }
+    return flops;
+}
+
+/**
+ * Top-Level Task //////////////////////////////////////////////////////////////
+ * Replicated: every shard runs all of it, with identical control flow, since
+ * the only values it branches on are reduced futures that all shards see.
+ */
+void
+topLevelTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *runtime
+) {
+    const CRParams params = parseParams();
+
+    const IndexSpaceT<1> pieces =
+        runtime->create_index_space(ctx, Rect<1>(0, params.pieces - 1));
+    const FieldSpace fs = runtime->create_field_space(ctx);
+    {
+        FieldAllocator fa = runtime->create_field_allocator(ctx, fs);
+        fa.allocate_field(sizeof(double), FID_X);
+        fa.allocate_field(sizeof(double), FID_B);
+        fa.allocate_field(sizeof(double), FID_R);
+        fa.allocate_field(sizeof(double), FID_P);
+        fa.allocate_field(sizeof(double), FID_AP);
+        fa.allocate_field(sizeof(double), FID_Z);
+        fa.allocate_field(sizeof(double), FID_Z2);
+    }
+    std::vector<CRLevel> levels;
+    for (int k = 0; k < params.mgLevels; ++k) {
+        CRGeometry g;
+        g.nx = params.nx >> k;
+        g.ny = params.ny >> k;
+        const coord_t nz = params.nz >> k;
+        g.nz = nz * params.pieces;
+        levels.push_back(
+            createLevel(g, nz, pieces, params.pieces, fs, ctx, runtime)
+        );
+    }
+    const CRLevel &fine = levels[0];
+
+    LEGION_PRINT_ONCE(runtime, ctx, stdout,
+        "--> Control-replicated CG: global grid %lldx%lldx%lld, "
+        "%d pieces of %lld rows, %d MG levels\n",
+        (long long)fine.g.nx, (long long)fine.g.ny, (long long)fine.g.nz,
+        params.pieces, (long long)(fine.rows / params.pieces),
+        params.mgLevels);
+
+    {
+        IndexTaskLauncher launcher(INIT_TID, pieces,
+                                   TaskArgument(&fine.g, sizeof(fine.g)),
+                                   ArgumentMap());
+        launcher.add_region_requirement(
+            RegionRequirement(fine.owned, 0, WRITE_DISCARD, EXCLUSIVE,
+                              fine.vectors)
+        );
+        launcher.add_field(0, FID_X);
+        launcher.add_field(0, FID_B);
+        launcher.add_field(0, FID_R);
+        runtime->execute_index_space(ctx, launcher);
+    }
+    IndexTaskLauncher updateXR(UPDATE_XR_TID, pieces, TaskArgument(),
+                               ArgumentMap());
+    updateXR.add_region_requirement(
+        RegionRequirement(fine.owned, 0, READ_WRITE, EXCLUSIVE, fine.vectors)
+    );
+    updateXR.add_field(0, FID_X);
+    updateXR.add_field(0, FID_R);
+    updateXR.add_region_requirement(
+        RegionRequirement(fine.owned, 0, READ_ONLY, EXCLUSIVE, fine.vectors)
+    );
+    updateXR.add_field(1, FID_P);
+    updateXR.add_field(1, FID_AP);
+
+    const Future rr0 = dot(fine, FID_R, FID_R, pieces, ctx, runtime);
+    const double normr0 = sqrt(rr0.get_result<double>());
+    double normr = normr0;
+    // Timed from when setup is done to when the last launch is.
+    const Future start = runtime->get_current_time_in_microseconds(
+        ctx, runtime->issue_execution_fence(ctx)
+    );
+    Future rtz;
+    int niters = 0;
+    for (int k = 1; k <= params.maxIters; ++k) {
+        const FieldID z = mg(levels, 0, pieces, ctx, runtime);
+        const Future rtzOld = rtz;
+        rtz = dot(fine, FID_R, z, pieces, ctx, runtime);
+        const bool first = k == 1;
+        IndexTaskLauncher updateP(UPDATE_P_TID, pieces,
+                                  TaskArgument(&first, sizeof(first)),
+                                  ArgumentMap());
+        updateP.add_region_requirement(
+            RegionRequirement(fine.owned, 0, READ_ONLY, EXCLUSIVE,
+                              fine.vectors)
+        );
+        updateP.add_field(0, z);
+        updateP.add_region_requirement(
+            RegionRequirement(fine.owned, 0, READ_WRITE, EXCLUSIVE,
+                              fine.vectors)
+        );
+        updateP.add_field(1, FID_P);
+        if (!first) {
+            updateP.add_future(rtz);
+            updateP.add_future(rtzOld);
+        }
+        runtime->execute_index_space(ctx, updateP);
+        spmv(fine, FID_P, FID_AP, pieces, ctx, runtime);
+        const Future pAp = dot(fine, FID_P, FID_AP, pieces, ctx, runtime);
+        updateXR.futures.clear();
+        updateXR.add_future(rtz);
+        updateXR.add_future(pAp);
+        runtime->execute_index_space(ctx, updateXR);
+        niters = k;
+        if (k % params.checkFreq == 0 || k == params.maxIters) {
+            const Future rr = dot(fine, FID_R, FID_R, pieces, ctx, runtime);
+            normr = sqrt(rr.get_result<double>());
+            if (normr / normr0 <= params.tolerance) break;
+        }
+    }
+    const Future stop = runtime->get_current_time_in_microseconds(
+        ctx, runtime->issue_execution_fence(ctx)
+    );
+
+    // The residual of x itself, against the recurrence's normr.
+    spmv(fine, FID_X, FID_AP, pieces, ctx, runtime);
+    IndexTaskLauncher residual(RESIDUAL_TID, pieces, TaskArgument(),
+                               ArgumentMap());
+    residual.add_region_requirement(
+        RegionRequirement(fine.owned, 0, READ_ONLY, EXCLUSIVE, fine.vectors)
+    );
+    residual.add_field(0, FID_B);
+    residual.add_field(0, FID_AP);
+    const double trueNormr = sqrt(runtime->execute_index_space(
+        ctx, residual, LEGION_REDOP_SUM_FLOAT64
+    ).get_result<double>());
+    IndexTaskLauncher errorLauncher(ERROR_TID, pieces, TaskArgument(),
+                                    ArgumentMap());
+    errorLauncher.add_region_requirement(
+        RegionRequirement(fine.owned, 0, READ_ONLY, EXCLUSIVE, fine.vectors)
+    );
+    errorLauncher.add_field(0, FID_X);
+    const double maxError = runtime->execute_index_space(
+        ctx, errorLauncher, LEGION_REDOP_MAX_FLOAT64
+    ).get_result<double>();
+
+    const double seconds = 1e-6 * double(
+        stop.get_result<long long>() - start.get_result<long long>()
+    );
+    const double flops = double(niters) * iterationFlops(levels);
+    LEGION_PRINT_ONCE(runtime, ctx, stdout,
+        "--> Iterations = %d\n"
+        "--> Scaled residual = %e\n"
+        "--> Scaled residual of x = %e\n"
+        "--> Max error of x = %e\n"
+        "--> Solve time (s) = %f\n"
+        "--> GFLOP/s = %f\n",
+        niters, normr / normr0, trueNormr / normr0, maxError, seconds,
+        seconds > 0.0 ? 1e-9 * flops / seconds : 0.0);
+
+    for (size_t k = 0; k < levels.size(); ++k) {
+        runtime->destroy_logical_region(ctx, levels[k].vectors);
+        runtime->destroy_index_space(ctx, levels[k].rowSpace);
+    }
+    runtime->destroy_field_space(ctx, fs);
+    runtime->destroy_index_space(ctx, pieces);
+}
+
+/**
+ * Main ////////////////////////////////////////////////////////////////////////
+ * Responsible for RT initialization.
+ */
+int
+main(int argc, char **argv)
+{
+    Runtime::set_top_level_task_id(TOP_LEVEL_TID);
+    {
+        TaskVariantRegistrar registrar(TOP_LEVEL_TID, "topLevelTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_replicable();
+        Runtime::preregister_task_variant<topLevelTask>(
+            registrar, "topLevelTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(INIT_TID, "initTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<initTask>(registrar, "initTask");
+    }
+    {
+        TaskVariantRegistrar registrar(SPMV_TID, "spmvTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<spmvTask>(registrar, "spmvTask");
+    }
+    {
+        TaskVariantRegistrar registrar(SYMGS_TID, "symgsTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<symgsTask>(registrar, "symgsTask");
+    }
+    {
+        TaskVariantRegistrar registrar(RESTRICTION_TID, "restrictionTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<restrictionTask>(
+            registrar, "restrictionTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(PROLONGATION_TID, "prolongationTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<prolongationTask>(
+            registrar, "prolongationTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(DOT_TID, "dotTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<double, dotTask>(
+            registrar, "dotTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(UPDATE_XR_TID, "updateXRTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<updateXRTask>(
+            registrar, "updateXRTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(UPDATE_P_TID, "updatePTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<updatePTask>(
+            registrar, "updatePTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(RESIDUAL_TID, "residualTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<double, residualTask>(
+            registrar, "residualTask"
+        );
+    }
+    {
+        TaskVariantRegistrar registrar(ERROR_TID, "errorTask");
+        registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+        registrar.set_leaf();
+        Runtime::preregister_task_variant<double, errorTask>(
+            registrar, "errorTask"
+        );
+    }
+    return Runtime::start(argc, argv);
+}
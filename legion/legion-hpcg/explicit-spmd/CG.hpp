@@ -61,6 +61,7 @@
 #include "ComputeDotProduct.hpp"
 #include "ComputeMG.hpp"
 #include "FutureMath.hpp"
+#include "ResidualHistory.hpp"
 
 #include <fstream>
 #include <cmath>
@@ -107,10 +108,13 @@
 
     @return Returns zero on success and a non-zero value otherwise.
 
+    @param[inout] dcarsDot  The allreduce used by the dot products.
+
     @see CG()
 */
+template <typename DCT>
 inline int
-CG(
+CGWithDot(
     SparseMatrix     &A,
     CGData           &data,
     Array<floatType> &b,
@@ -122,6 +126,7 @@ CG(
     floatType        &normr0,
     double           *times,
     bool             doPreconditioning,
+    Item< DynColl<DCT> > &dcarsDot,
     Context          ctx,
     Runtime          *lrt
 ) {
@@ -134,7 +139,10 @@ CG(
     const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
     //
     Future normrFuture, pApFuture, rtzFuture, oldrtzFuture;
-    floatType alpha = 0.0, beta = 0.0;
+    // alpha and beta stay futures: the WAXPBY tasks read them, so the host
+    // only waits on the residual norm (every convergenceCheckFreq iterations).
+    Future alphaFuture, betaFuture;
+    const int checkFreq = data.convergenceCheckFreq;
     double t0 = 0.0, t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0, t6 = 0.0;
     //
     normr = 0.0;
@@ -144,8 +152,6 @@ CG(
     Array<floatType> &p  = *(data.p); // Direction vector (ncol >= nrow).
     Array<floatType> &Ap = *(data.Ap);// Holds result from A * p.
     //
-    Item< DynColl<floatType> > &dcarsFT = *A.dcAllRedSumFT;
-    //
     if (!doPreconditioning && rank == 0) {
         cout << "WARNING: PERFORMING UNPRECONDITIONED ITERATIONS" << endl;
     }
@@ -161,7 +167,7 @@ CG(
     TOCK(t2);
     //
     TICK();
-    ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
+    ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsDot, ctx, lrt);
     TOCK(t1);
     //
     normr = ComputeFuture(
@@ -171,8 +177,22 @@ CG(
     if (rank == 0) std::cout << "Initial Residual = "<< normr << std::endl;
     // Record initial residual for convergence testing.
     normr0 = normr;
+    // Prints the residuals of the iterations we did not wait on once they
+    // are available.
+    ResidualHistory history(normr0);
+    auto printNorm = [&](int k, floatType norm) {
+        if (rank == 0 && (k % print_freq == 0 || k == maxIter)) {
+            cout << "Iteration = "<< k << "   Scaled Residual = "
+                 << norm / normr0 << std::endl;
+        }
+    };
     // Start iterations.
     for (int k = 1; k <= maxIter && normr / normr0 > tolerance; k++ ) {
+#ifdef LGNCG_USE_TRACING
+        // The first iteration takes a different path, so only trace the rest.
+        const bool traced = (k > 1);
+        if (traced) lrt->begin_trace(ctx, CG_ITERATION_TRACE_ID);
+#endif
         TICK();
         if (doPreconditioning) {
             // Apply preconditioner.
@@ -190,58 +210,58 @@ CG(
             TOCK(t2);
             //
             TICK(); // rtz = r' * z
-            ComputeDotProduct(nrow, r, z, rtzFuture, t4, dcarsFT, ctx, lrt);
+            ComputeDotProduct(nrow, r, z, rtzFuture, t4, dcarsDot, ctx, lrt);
             TOCK(t1);
         }
         else {
             oldrtzFuture = rtzFuture;
             //
             TICK(); // rtz = r' * z
-            ComputeDotProduct(nrow, r, z, rtzFuture, t4, dcarsFT, ctx, lrt);
+            ComputeDotProduct(nrow, r, z, rtzFuture, t4, dcarsDot, ctx, lrt);
             TOCK(t1);
             //
-            beta = ComputeFuture(
-                       &rtzFuture, FMO_DIV, &oldrtzFuture, ctx, lrt
-                   ).get_result<floatType>(silenceWarnings);
+            betaFuture = ComputeFuture(
+                             &rtzFuture, FMO_DIV, &oldrtzFuture, ctx, lrt
+                         );
             //
             TICK(); // p = beta * p + z
-            ComputeWAXPBY(nrow, 1.0, z, beta, p, p, ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, z, 1.0, &betaFuture, p, p, ctx, lrt);
             TOCK(t2);
         }
-        TICK(); // Ap = A * p
-        ComputeSPMV(A, p, Ap, ctx, lrt);
+        TICK(); // Ap = A * p and p' * Ap in one pass.
+        ComputeSPMVDot(A, p, Ap, pApFuture, t4, dcarsDot, ctx, lrt);
         TOCK(t3);
         //
-        TICK(); // alpha = p' * Ap
-        ComputeDotProduct(nrow, p, Ap, pApFuture, t4, dcarsFT, ctx, lrt);
-        TOCK(t1);
-        //
-        alpha = ComputeFuture(
-                    &rtzFuture, FMO_DIV, &pApFuture, ctx, lrt
-                ).get_result<floatType>(silenceWarnings);
+        alphaFuture = ComputeFuture(
+                          &rtzFuture, FMO_DIV, &pApFuture, ctx, lrt
+                      );
         //
         TICK(); // x = x + alpha * p
-        ComputeWAXPBY(nrow, 1.0, x, alpha, p, x, ctx, lrt);
-        // r = r - alpha * Ap
-        ComputeWAXPBY(nrow, 1.0, r, -alpha, Ap, r, ctx, lrt);
+        ComputeWAXPBY(nrow, 1.0, x, 1.0, &alphaFuture, p, x, ctx, lrt);
+        // r = r - alpha * Ap and r' * r in one pass.
+        ComputeWAXPBYDot(
+            nrow, 1.0, r, -1.0, &alphaFuture, Ap, r,
+            normrFuture, t4, dcarsDot, ctx, lrt
+        );
         TOCK(t2);
         //
-        TICK();
-        ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
-        TOCK(t1);
-        //
-        normr = ComputeFuture(
-                    &normrFuture, FMO_SQRT, NULL, ctx, lrt
-                ).get_result<floatType>(silenceWarnings);
-        //
-        if (rank == 0 && ( k % print_freq == 0 || k == maxIter)) {
-            cout << "Iteration = "<< k << "   Scaled Residual = "
-                 << normr / normr0 << std::endl;
-        }
+        Future normrSqrtFuture = ComputeFuture(
+                                     &normrFuture, FMO_SQRT, NULL, ctx, lrt
+                                 );
+#ifdef LGNCG_USE_TRACING
+        if (traced) lrt->end_trace(ctx, CG_ITERATION_TRACE_ID);
+#endif
+        // Between checks, the loop keeps issuing iterations against the last
+        // residual norm we waited for.
+        history.push(k, normrSqrtFuture);
+        const bool check = (k % checkFreq == 0 || k == maxIter);
+        history.drain(check, printNorm);
+        if (check) normr = history.norms()[k];
         //
         niters = k;
   }
-    // TODO pass future to WAXPBY instead of future result.
+    // Every exit from the loop follows a check, so nothing is pending.
+    data.residualHistory = history.norms();
     // Store times.
     times[1] += t1; // Dot product time.
     times[2] += t2; // WAXPBY time.
@@ -253,3 +273,36 @@ CG(
     //
     return 0;
 }
+
+/**
+ * CG with the dot product reduction selected by --ddot= (see
+ * KernelVariants.hpp).
+ */
+inline int
+CG(
+    SparseMatrix     &A,
+    CGData           &data,
+    Array<floatType> &b,
+    Array<floatType> &x,
+    const int        maxIter,
+    const floatType  tolerance,
+    int              &niters,
+    floatType        &normr,
+    floatType        &normr0,
+    double           *times,
+    bool             doPreconditioning,
+    Context          ctx,
+    Runtime          *lrt
+) {
+    if (ShardKernelVariants().dot == DOT_VARIANT_REPRO) {
+        // Order-independent dot products (see ReproSum.hpp).
+        return CGWithDot(
+                   A, data, b, x, maxIter, tolerance, niters, normr, normr0,
+                   times, doPreconditioning, *A.dcAllRedSumRepro, ctx, lrt
+               );
+    }
+    return CGWithDot(
+               A, data, b, x, maxIter, tolerance, niters, normr, normr0,
+               times, doPreconditioning, *A.dcAllRedSumFT, ctx, lrt
+           );
+}
@@ -0,0 +1,718 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file CGMapper.hpp
+
+    Mapper for the explicit-SPMD HPCG. Pins every shard (and all of the leaf
+    tasks it launches) to one CPU and keeps instances in memory local to that
+    CPU, so they are reused across CG iterations instead of migrating.
+
+    With --sub-blocks=N, shard i is placed on CPU i * N and the N points of
+    its sub-block index launches on CPUs i * N to i * N + N - 1.
+
+    With --persistent-instances, the instances it creates are never garbage
+    collected, so repeated benchmark runs (--benchmark-runs=N) map the
+    problem regions onto the instances of the first run.
+
+    With LGNCG_USE_CUDA, tasks that have a GPU variant are sent to a GPU on the
+    shard's node instead, and their instances live in that GPU's framebuffer.
+
+    Placement is tuned at run time with -cgm: flags, in the style of Legion's
+    -ll: and -lg: flags (see CGMapperOptions):
+
+    -cgm:subregions N   CPUs (sub-blocks) per shard, same as --sub-blocks=N.
+    -cgm:mem KIND       Instance memory: numa (default: NUMA-local if Realm
+                        has socket memories, else system memory), sysmem,
+                        regmem (registered, for RDMA) or zcmem (zero-copy).
+    -cgm:affinity A     Shard placement: blocked (default: consecutive shards
+                        on one node) or cyclic (round-robin over the nodes).
+    -cgm:hugepages      Start instances of at least HPCG_HUGE_PAGE_SIZE bytes
+                        on a huge page boundary and ask the kernel to back
+                        them with transparent huge pages.
+    -cgm:verbose        Print the options and where the instances go.
+
+    Other Legion applications can use the mapper with their own task IDs by
+    passing the IDs of their top-level and shard tasks to the constructor.
+ */
+
+#pragma once
+
+#include "TaskTIDs.hpp"
+#include "hpcg.hpp"
+
+#include "legion.h"
+#include "default_mapper.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <set>
+#include <vector>
+
+#include <sys/mman.h>
+
+/**
+ * Tunable that returns the number of sub-regions (sub-blocks) per shard, like
+ * the SUBREGION_TUNABLE of the legacy mapper. Chosen above the IDs the default
+ * mapper answers.
+ */
+enum {
+    CGMAPPER_SUBREGION_TUNABLE = 1 << 20
+};
+
+/**
+ * Memory kinds instances can be placed in (-cgm:mem).
+ */
+enum CGMapperMemKind {
+    CGMAPPER_MEM_NUMA = 0,
+    CGMAPPER_MEM_SYSMEM,
+    CGMAPPER_MEM_REGMEM,
+    CGMAPPER_MEM_ZCMEM
+};
+
+/**
+ * Shard placement over the nodes (-cgm:affinity).
+ */
+enum CGMapperAffinity {
+    CGMAPPER_AFFINITY_BLOCKED = 0,
+    CGMAPPER_AFFINITY_CYCLIC
+};
+
+/**
+ * Placement tunables, parsed from the command line so they can be changed
+ * without recompiling.
+ */
+struct CGMapperOptions {
+    // CPUs given to each shard (-cgm:subregions N or --sub-blocks=N).
+    int subRegions = 1;
+    //
+    CGMapperMemKind memKind = CGMAPPER_MEM_NUMA;
+    //
+    CGMapperAffinity affinity = CGMAPPER_AFFINITY_BLOCKED;
+    // Huge page aligned and backed large instances (-cgm:hugepages).
+    bool hugePages = false;
+    //
+    bool verbose = false;
+
+    /**
+     * Parses the options from the Legion input arguments. Unknown values keep
+     * the defaults.
+     */
+    static CGMapperOptions
+    fromArgs(void)
+    {
+        const Legion::InputArgs &args = Legion::Runtime::get_input_args();
+        CGMapperOptions opts;
+        const char *sb = "--sub-blocks=";
+        for (int i = 1; i < args.argc; ++i) {
+            const char *arg = args.argv[i];
+            const char *val = (i + 1 < args.argc) ? args.argv[i + 1] : "";
+            if (strncmp(arg, sb, strlen(sb)) == 0) {
+                mParseCount(arg + strlen(sb), opts.subRegions);
+            }
+            else if (strcmp(arg, "-cgm:subregions") == 0) {
+                mParseCount(val, opts.subRegions);
+            }
+            else if (strcmp(arg, "-cgm:mem") == 0) {
+                if (strcmp(val, "numa") == 0) {
+                    opts.memKind = CGMAPPER_MEM_NUMA;
+                }
+                else if (strcmp(val, "sysmem") == 0) {
+                    opts.memKind = CGMAPPER_MEM_SYSMEM;
+                }
+                else if (strcmp(val, "regmem") == 0) {
+                    opts.memKind = CGMAPPER_MEM_REGMEM;
+                }
+                else if (strcmp(val, "zcmem") == 0) {
+                    opts.memKind = CGMAPPER_MEM_ZCMEM;
+                }
+            }
+            else if (strcmp(arg, "-cgm:affinity") == 0) {
+                if (strcmp(val, "blocked") == 0) {
+                    opts.affinity = CGMAPPER_AFFINITY_BLOCKED;
+                }
+                else if (strcmp(val, "cyclic") == 0) {
+                    opts.affinity = CGMAPPER_AFFINITY_CYCLIC;
+                }
+            }
+            else if (strcmp(arg, "-cgm:hugepages") == 0) {
+                opts.hugePages = true;
+            }
+            else if (strcmp(arg, "-cgm:verbose") == 0) {
+                opts.verbose = true;
+            }
+        }
+        return opts;
+    }
+
+    /**
+     *
+     */
+    static const char *
+    memKindName(
+        CGMapperMemKind kind
+    ) {
+        switch (kind) {
+            case CGMAPPER_MEM_NUMA:   return "numa";
+            case CGMAPPER_MEM_SYSMEM: return "sysmem";
+            case CGMAPPER_MEM_REGMEM: return "regmem";
+            case CGMAPPER_MEM_ZCMEM:  return "zcmem";
+        }
+        return "unknown";
+    }
+
+private:
+    static void
+    mParseCount(
+        const char *s,
+        int &count
+    ) {
+        if (sscanf(s, "%d", &count) != 1 || count < 1) count = 1;
+    }
+};
+
+/**
+ * Returns all CPUs in the machine in shard placement order. Blocked orders by
+ * address space first so that consecutive shards land on the same node, like
+ * a blocked MPI rank placement. Cyclic takes the k-th CPU of every node before
+ * any node's (k + 1)-th, so consecutive shards land on different nodes.
+ */
+inline std::vector<Legion::Processor>
+CGMapperSortedCPUs(
+    Legion::Machine machine,
+    CGMapperAffinity affinity = CGMapperOptions::fromArgs().affinity
+) {
+    using namespace Legion;
+    //
+    Machine::ProcessorQuery cpuQuery(machine);
+    cpuQuery.only_kind(Processor::LOC_PROC);
+    std::vector<Processor> cpus(cpuQuery.begin(), cpuQuery.end());
+    std::sort(
+        cpus.begin(), cpus.end(),
+        [](const Processor &a, const Processor &b) {
+            if (a.address_space() != b.address_space()) {
+                return a.address_space() < b.address_space();
+            }
+            return a.id < b.id;
+        }
+    );
+    if (affinity == CGMAPPER_AFFINITY_CYCLIC) {
+        // Rank of each CPU within its node.
+        std::map<Processor, size_t> local;
+        for (size_t i = 0; i < cpus.size(); ++i) {
+            const bool first = (i == 0 ||
+                cpus[i].address_space() != cpus[i - 1].address_space());
+            local[cpus[i]] = first ? 0 : local[cpus[i - 1]] + 1;
+        }
+        std::stable_sort(
+            cpus.begin(), cpus.end(),
+            [&local](const Processor &a, const Processor &b) {
+                return local.at(a) < local.at(b);
+            }
+        );
+    }
+    return cpus;
+}
+
+/**
+ * Returns the number of sub-blocks per shard (see SubBlocks.hpp), 1 if not
+ * given.
+ */
+inline int
+CGMapperSubBlocks(void)
+{
+    return CGMapperOptions::fromArgs().subRegions;
+}
+
+/**
+ * Returns true if -cgm:hugepages was given.
+ */
+inline bool
+CGMapperHugePages(void)
+{
+    static const bool hugePages = CGMapperOptions::fromArgs().hugePages;
+    return hugePages;
+}
+
+/**
+ * Asks the kernel to back the huge pages within [base, base + bytes) with
+ * transparent huge pages (MADV_HUGEPAGE). Pages that are not touched yet are
+ * then faulted in as huge pages, and khugepaged collapses the others. Every
+ * instance is advised once per process, however many Items map it.
+ */
+inline void
+CGMapperAdviseHugePages(
+    const void *base,
+    size_t bytes
+) {
+#ifdef MADV_HUGEPAGE
+    if (bytes < HPCG_HUGE_PAGE_SIZE) return;
+    //
+    static std::mutex lock;
+    static std::set<uintptr_t> advised;
+    //
+    const uintptr_t page = HPCG_HUGE_PAGE_SIZE;
+    const uintptr_t lo = reinterpret_cast<uintptr_t>(base);
+    const uintptr_t first = (lo + page - 1) / page * page;
+    const uintptr_t last = (lo + bytes) / page * page;
+    if (first >= last) return;
+    //
+    std::lock_guard<std::mutex> guard(lock);
+    if (!advised.insert(lo).second) return;
+    madvise(reinterpret_cast<void *>(first), last - first, MADV_HUGEPAGE);
+#endif
+}
+
+/**
+ * Returns true if the --persistent-instances run option was given.
+ */
+inline bool
+CGMapperPersistentInstances(void)
+{
+    const Legion::InputArgs &args = Legion::Runtime::get_input_args();
+    for (int i = 1; i < args.argc; ++i) {
+        if (strcmp(args.argv[i], "--persistent-instances") == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * Returns true if the --no-gpu run option was given.
+ */
+inline bool
+CGMapperNoGPU(void)
+{
+    const Legion::InputArgs &args = Legion::Runtime::get_input_args();
+    for (int i = 1; i < args.argc; ++i) {
+        if (strcmp(args.argv[i], "--no-gpu") == 0) return true;
+    }
+    return false;
+}
+
+/**
+ * Returns the address space (node) that CGMapper places each of nShards
+ * shards on.
+ */
+inline std::vector<int>
+CGMapperShardNodes(
+    int64_t nShards
+) {
+    const auto cpus = CGMapperSortedCPUs(Legion::Machine::get_machine());
+    const int64_t nSubBlocks = CGMapperSubBlocks();
+    std::vector<int> nodes(nShards);
+    for (int64_t i = 0; i < nShards; ++i) {
+        nodes[i] = cpus[(i * nSubBlocks) % cpus.size()].address_space();
+    }
+    return nodes;
+}
+
+/**
+ * Returns the number of consecutive shards CGMapper places on each node, or 1
+ * if the nodes don't all get the same number of consecutive shards.
+ * GenerateGeometry lays out each node's shards as one brick of the process
+ * grid, so this is what keeps their halo neighbors on the node.
+ */
+inline int
+CGMapperShardsPerNode(
+    int64_t nShards
+) {
+    const std::vector<int> nodes = CGMapperShardNodes(nShards);
+    int64_t perNode = 0;
+    while (perNode < nShards && nodes[perNode] == nodes[0]) ++perNode;
+    //
+    if (nShards % perNode != 0) return 1;
+    for (int64_t i = 0; i < nShards; ++i) {
+        if (nodes[i] != nodes[i - i % perNode]) return 1;
+        if (i % perNode == 0 && i > 0 && nodes[i] == nodes[i - 1]) return 1;
+    }
+    return int(perNode);
+}
+
+/**
+ *
+ */
+class CGMapper : public Legion::Mapping::DefaultMapper {
+    // Placement tunables (-cgm: flags).
+    CGMapperOptions mOptions;
+    // Tasks that are not leaf tasks and are mapped by the default policy.
+    std::set<Legion::TaskID> mNonLeafTasks;
+    // Memory of the -cgm:mem kind closest to local_proc.
+    Legion::Memory mLocalMem;
+    // All CPUs in the machine, in a stable (shard placement) order.
+    std::vector<Legion::Processor> mCPUs;
+    // Number of CPUs given to each shard (--sub-blocks).
+    int mSubBlocks = 1;
+    // Index of local_proc in mCPUs.
+    size_t mLocalCPUIndex = 0;
+    // Never collect instances (--persistent-instances).
+    bool mPersistentInstances = false;
+#ifdef LGNCG_USE_CUDA
+    // GPU that runs the GPU variants of the tasks launched from local_proc.
+    Legion::Processor mLocalGPU;
+#endif
+
+public:
+    /**
+     *
+     */
+    CGMapper(
+        Legion::Mapping::MapperRuntime *mrt,
+        Legion::Machine machine,
+        Legion::Processor p,
+        const std::set<Legion::TaskID> &nonLeafTasks = {
+            MAIN_TID, GEN_PROB_TID, START_BENCHMARK_TID
+        }
+    ) : Legion::Mapping::DefaultMapper(mrt, machine, p, "CGMapper")
+      , mOptions(CGMapperOptions::fromArgs())
+      , mNonLeafTasks(nonLeafTasks)
+    {
+        mCPUs = CGMapperSortedCPUs(machine, mOptions.affinity);
+        mSubBlocks = mOptions.subRegions;
+        mPersistentInstances = CGMapperPersistentInstances();
+        mLocalCPUIndex = std::find(mCPUs.begin(), mCPUs.end(), p)
+                       - mCPUs.begin();
+        mLocalMem = mFindLocalMemory(machine, p, mOptions.memKind);
+#ifdef LGNCG_USE_CUDA
+        // With --no-gpu, mLocalGPU stays NO_PROC and every task maps to CPUs.
+        if (!CGMapperNoGPU()) {
+            mLocalGPU = mFindLocalGPU(machine, p, mCPUs);
+        }
+#endif
+        //
+        if (p == mCPUs.front()) {
+            printf("cgmapper: number of CPUs: %lu\n", mCPUs.size());
+            if (mOptions.verbose) {
+                printf("cgmapper: subregions %d, mem %s (%llx), "
+                       "affinity %s, hugepages %s\n", mSubBlocks,
+                       CGMapperOptions::memKindName(mOptions.memKind),
+                       (unsigned long long)mLocalMem.id,
+                       mOptions.affinity == CGMAPPER_AFFINITY_CYCLIC ?
+                       "cyclic" : "blocked",
+                       mOptions.hugePages ? "on" : "off");
+            }
+            if (!mLocalMem.exists()) {
+                printf("cgmapper: no %s memory, using the default mapper's "
+                       "choice\n",
+                       CGMapperOptions::memKindName(mOptions.memKind));
+            }
+        }
+    }
+
+    /**
+     * Answers CGMAPPER_SUBREGION_TUNABLE; the default mapper answers the rest.
+     */
+    virtual void
+    select_tunable_value(
+        const Legion::Mapping::MapperContext ctx,
+        const Legion::Task &task,
+        const SelectTunableInput &input,
+        SelectTunableOutput &output
+    ) {
+        if (input.tunable_id == CGMAPPER_SUBREGION_TUNABLE) {
+            runtime->pack_tunable<int>(mSubBlocks, output);
+            return;
+        }
+        DefaultMapper::select_tunable_value(ctx, task, input, output);
+    }
+
+    /**
+     * Leaf tasks stay on the processor of the shard that launched them.
+     */
+    virtual void
+    select_task_options(
+        const Legion::Mapping::MapperContext ctx,
+        const Legion::Task &task,
+        TaskOptions &output
+    ) {
+        DefaultMapper::select_task_options(ctx, task, output);
+        //
+        if (mNonLeafTasks.count(task.task_id) == 0) {
+            output.initial_proc = local_proc;
+            output.inline_task  = false;
+            output.stealable    = false;
+            output.map_locally  = true;
+#ifdef LGNCG_USE_CUDA
+            if (mLocalGPU.exists() && mHasGPUVariant(task.task_id)) {
+                output.initial_proc = mLocalGPU;
+            }
+#endif
+        }
+    }
+
+    /**
+     * Point b of a sub-block index launch runs on the b-th CPU after the
+     * launching shard's CPU.
+     */
+    virtual void
+    slice_task(
+        const Legion::Mapping::MapperContext ctx,
+        const Legion::Task &task,
+        const SliceTaskInput &input,
+        SliceTaskOutput &output
+    ) {
+        if (!mIsSubBlockTask(task.task_id)) {
+            DefaultMapper::slice_task(ctx, task, input, output);
+            return;
+        }
+        //
+        using Legion::Domain;
+        for (Domain::DomainPointIterator itr(input.domain); itr; itr++) {
+            const size_t b = itr.p.point_data[0];
+            const Legion::Processor target =
+                mCPUs[(mLocalCPUIndex + b) % mCPUs.size()];
+            output.slices.push_back(
+                TaskSlice(
+                    Domain::from_domain_point(itr.p),
+                    target,
+                    false /* recurse */,
+                    false /* stealable */
+                )
+            );
+        }
+    }
+
+protected:
+    /**
+     * Shard i always runs on mCPUs[(i * mSubBlocks) % nCPUs].
+     */
+    virtual void
+    default_policy_select_must_epoch_processors(
+        Legion::Mapping::MapperContext ctx,
+        const std::vector< std::set<const Legion::Task *> > &tasks,
+        Legion::Processor::Kind proc_kind,
+        std::map<const Legion::Task *, Legion::Processor> &target_procs
+    ) {
+        if (proc_kind != Legion::Processor::LOC_PROC) {
+            DefaultMapper::default_policy_select_must_epoch_processors(
+                ctx, tasks, proc_kind, target_procs
+            );
+            return;
+        }
+        //
+        for (const auto &group : tasks) {
+            for (const auto *t : group) {
+                const size_t shard = t->index_point.point_data[0];
+                target_procs[t] = mCPUs[(shard * mSubBlocks) % mCPUs.size()];
+            }
+        }
+    }
+
+    /**
+     * Place all instances in the memory closest to the target processor.
+     */
+    virtual Legion::Memory
+    default_policy_select_target_memory(
+        Legion::Mapping::MapperContext ctx,
+        Legion::Processor target_proc,
+        const Legion::RegionRequirement &req
+    ) {
+        if (target_proc == local_proc && mLocalMem.exists()) return mLocalMem;
+#ifdef LGNCG_USE_CUDA
+        if (target_proc.kind() == Legion::Processor::TOC_PROC) {
+            Legion::Machine::MemoryQuery fbMems(machine);
+            fbMems.has_affinity_to(target_proc);
+            fbMems.only_kind(Legion::Memory::GPU_FB_MEM);
+            if (fbMems.count() > 0) return fbMems.first();
+        }
+#endif
+        //
+        const Legion::Memory mem = mFindLocalMemory(
+                                       machine, target_proc, mOptions.memKind
+                                   );
+        if (mem.exists()) return mem;
+        //
+        return DefaultMapper::default_policy_select_target_memory(
+                   ctx, target_proc, req
+               );
+    }
+
+    /**
+     * Every instance starts on an HPCG_ALIGNMENT byte boundary, so the leaf
+     * kernels can take their aligned paths (see VectorKernels.hpp). The
+     * layout is the default mapper's, one field stored contiguously, which
+     * Item::data() checks. With -cgm:hugepages, instances of at least
+     * HPCG_HUGE_PAGE_SIZE bytes (matrixValues, mtxIndL, and the fine vectors
+     * of large problems) start on a huge page boundary instead, so that
+     * CGMapperAdviseHugePages can back all of them with huge pages.
+     */
+    virtual void
+    default_policy_select_constraints(
+        Legion::Mapping::MapperContext ctx,
+        Legion::LayoutConstraintSet &constraints,
+        Legion::Memory target_memory,
+        const Legion::RegionRequirement &req
+    ) {
+        DefaultMapper::default_policy_select_constraints(
+            ctx, constraints, target_memory, req
+        );
+        size_t volume = 0;
+        if (mOptions.hugePages) {
+            volume = runtime->get_index_space_domain(
+                         ctx, req.region.get_index_space()
+                     ).get_volume();
+        }
+        for (const Legion::FieldID fid : req.privilege_fields) {
+            size_t alignment = HPCG_ALIGNMENT;
+            if (mOptions.hugePages) {
+                const size_t bytes = volume * runtime->get_field_size(
+                                         ctx, req.region.get_field_space(), fid
+                                     );
+                if (bytes >= HPCG_HUGE_PAGE_SIZE) {
+                    alignment = HPCG_HUGE_PAGE_SIZE;
+                }
+            }
+            constraints.add_constraint(
+                Legion::AlignmentConstraint(fid, GE_EK, alignment)
+            );
+        }
+    }
+
+    /**
+     * With --persistent-instances, instances stay alive until their region is
+     * destroyed instead of being collected once no mapping holds them.
+     */
+    virtual Legion::GCPriority
+    default_policy_select_garbage_collection_priority(
+        Legion::Mapping::MapperContext ctx,
+        MappingKind kind,
+        Legion::Memory memory,
+        const Legion::Mapping::PhysicalInstance &instance,
+        bool meets_fill_constraints,
+        bool reduction
+    ) {
+        if (mPersistentInstances && !reduction) return GC_NEVER_PRIORITY;
+        //
+        return DefaultMapper::default_policy_select_garbage_collection_priority(
+                   ctx, kind, memory, instance, meets_fill_constraints,
+                   reduction
+               );
+    }
+
+private:
+    /**
+     * Task IDs launched over sub-blocks (see SubBlocks.hpp).
+     */
+    static bool
+    mIsSubBlockTask(
+        Legion::TaskID tid
+    ) {
+        return tid == SPMV_BLOCK_TID ||
+               tid == WAXPBY_BLOCK_TID ||
+               tid == DDOT_BLOCK_TID;
+    }
+
+    /**
+     * Returns the memory of the given kind with affinity to p. For numa, that
+     * is the NUMA (socket) memory if Realm was started with one (-ll:nsize),
+     * otherwise p's system memory. regmem and zcmem need Realm to have been
+     * started with -ll:rsize and -ll:zsize.
+     */
+    static Legion::Memory
+    mFindLocalMemory(
+        Legion::Machine machine,
+        Legion::Processor p,
+        CGMapperMemKind kind
+    ) {
+        using namespace Legion;
+        //
+        if (kind != CGMAPPER_MEM_NUMA) {
+            Machine::MemoryQuery mems(machine);
+            mems.has_affinity_to(p);
+            mems.only_kind(
+                kind == CGMAPPER_MEM_SYSMEM ? Memory::SYSTEM_MEM :
+                kind == CGMAPPER_MEM_REGMEM ? Memory::REGDMA_MEM :
+                                              Memory::Z_COPY_MEM
+            );
+            return mems.count() > 0 ? mems.first() : Memory::NO_MEMORY;
+        }
+        //
+        Machine::MemoryQuery socketMems(machine);
+        socketMems.has_affinity_to(p);
+        socketMems.only_kind(Memory::SOCKET_MEM);
+        if (socketMems.count() > 0) return socketMems.first();
+        //
+        Machine::MemoryQuery sysMems(machine);
+        sysMems.has_affinity_to(p);
+        sysMems.only_kind(Memory::SYSTEM_MEM);
+        if (sysMems.count() > 0) return sysMems.first();
+        //
+        return Memory::NO_MEMORY;
+    }
+
+#ifdef LGNCG_USE_CUDA
+    /**
+     * Task IDs registered with a TOC_PROC variant.
+     */
+    static bool
+    mHasGPUVariant(
+        Legion::TaskID tid
+    ) {
+        switch (tid) {
+            case SPMV_TID:
+            case DDOT_TID:
+            case WAXPBY_TID:
+            case SYMGS_MC_TID:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * The k-th CPU of a node shares GPU k % nGPUs of that node, so shards on
+     * a node are spread evenly across its GPUs.
+     */
+    static Legion::Processor
+    mFindLocalGPU(
+        Legion::Machine machine,
+        Legion::Processor p,
+        const std::vector<Legion::Processor> &cpus
+    ) {
+        using namespace Legion;
+        //
+        Machine::ProcessorQuery gpuQuery(machine);
+        gpuQuery.only_kind(Processor::TOC_PROC);
+        gpuQuery.same_address_space_as(p);
+        std::vector<Processor> gpus(gpuQuery.begin(), gpuQuery.end());
+        if (gpus.empty()) return Processor::NO_PROC;
+        std::sort(gpus.begin(), gpus.end());
+        //
+        size_t k = 0;
+        for (const auto &cpu : cpus) {
+            if (cpu == p) break;
+            if (cpu.address_space() == p.address_space()) ++k;
+        }
+        return gpus[k % gpus.size()];
+    }
+#endif
+};
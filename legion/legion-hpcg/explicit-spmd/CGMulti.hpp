@@ -0,0 +1,297 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file CGMulti.hpp
+
+    CG with several right-hand sides solved together (--rhs=N). The columns
+    run their own CG recurrences in lockstep. SpMV and the MG smoother stream
+    the matrix once per iteration for all of them, and the per-column dot
+    products share one collective (see ComputeMultiRHS.hpp).
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "mytimer.hpp"
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionMultiCGData.hpp"
+#include "VectorOps.hpp"
+
+// For TICK and TOCK.
+#include "CG.hpp"
+#include "ComputeMultiRHS.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "ComputeRestriction.hpp"
+#include "ComputeProlongation.hpp"
+
+#include <cmath>
+#include <iostream>
+
+/**
+ * The multigrid V-cycle of ComputeMG applied to the nRhs columns of r, with
+ * the results in x. level indexes the MGColumns of data that belong to A.
+ */
+inline int
+ComputeMGMulti(
+    SparseMatrix &A,
+    MultiCGData &data,
+    int level,
+    Array<floatType> *const *r,
+    Array<floatType> *const *x,
+    Context ctx,
+    Runtime *lrt
+) {
+    const int nRhs = data.nRhs;
+    for (int j = 0; j < nRhs; ++j) ZeroVector(*x[j], ctx, lrt);
+    //
+    int ierr = 0;
+    if (A.mgData != NULL) {
+        Array<floatType> *rc[HPCG_MAX_RHS], *xc[HPCG_MAX_RHS];
+        Array<floatType> *Axf[HPCG_MAX_RHS];
+        for (int j = 0; j < nRhs; ++j) {
+            rc[j]  = data.mg[level][j]->rc;
+            xc[j]  = data.mg[level][j]->xc;
+            Axf[j] = data.mg[level][j]->Axf;
+        }
+        //
+        const int nPre = A.mgData->numberOfPresmootherSteps;
+        for (int i = 0; i < nPre; ++i) {
+            ierr += ComputeSYMGSMulti(A, r, x, nRhs, ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+        //
+        const bool inPreconditioner = true;
+        ierr = ComputeSPMVMulti(A, x, Axf, nRhs, ctx, lrt, inPreconditioner);
+        if (ierr != 0) return ierr;
+        //
+        for (int j = 0; j < nRhs; ++j) {
+            ierr += ComputeRestriction(A, *Axf[j], *rc[j], *r[j], ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+        //
+        ierr = ComputeMGMulti(*A.Ac, data, level + 1, rc, xc, ctx, lrt);
+        if (ierr != 0) return ierr;
+        //
+        for (int j = 0; j < nRhs; ++j) {
+            ierr += ComputeProlongation(A, *xc[j], *x[j], ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+        //
+        const int nPost = A.mgData->numberOfPostsmootherSteps;
+        for (int i = 0; i < nPost; ++i) {
+            ierr += ComputeSYMGSMulti(A, r, x, nRhs, ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+    }
+    else {
+        for (int i = 0; i < A.numberOfCoarseSweeps; ++i) {
+            ierr += ComputeSYMGSMulti(A, r, x, nRhs, ctx, lrt);
+        }
+        if (ierr != 0) return ierr;
+    }
+    //
+    return 0;
+}
+
+/**
+ * Waits on a ComputeDotProductsMulti result.
+ */
+inline FusedReduceValues
+GetDotProductsMulti(
+    Future &f
+) {
+    return f.get_result<FusedReduceValues>(silenceWarnings);
+}
+
+/*!
+    CG on the data.nRhs columns of data (b and x of each RHSColumn), with the
+    same parameters as CG(). normr and normr0 hold one value per column. The
+    iteration stops when every column meets tolerance or after maxIter
+    iterations. Unlike CG(), the step lengths are computed on the shard, so it
+    waits on the three batched dot products of every iteration.
+
+    @see CG()
+*/
+inline int
+CGMulti(
+    SparseMatrix     &A,
+    MultiCGData      &data,
+    const int        maxIter,
+    const floatType  tolerance,
+    int              &niters,
+    floatType        *normr,
+    floatType        *normr0,
+    double           *times,
+    bool             doPreconditioning,
+    Context          ctx,
+    Runtime          *lrt
+) {
+    using namespace std;
+    // Start timing right away.
+    double t_begin = mytimer();
+    //
+    const int print_freq = 10;
+    const int rank = A.geom->data()->rank;
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    const int nRhs = data.nRhs;
+    double t0 = 0.0, t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0, t6 = 0.0;
+    //
+    Array<floatType> *b[HPCG_MAX_RHS], *x[HPCG_MAX_RHS];
+    Array<floatType> *r[HPCG_MAX_RHS], *z[HPCG_MAX_RHS];
+    Array<floatType> *p[HPCG_MAX_RHS], *Ap[HPCG_MAX_RHS];
+    for (int j = 0; j < nRhs; ++j) {
+        b[j]  = data.columns[j]->b;
+        x[j]  = data.columns[j]->x;
+        r[j]  = data.columns[j]->r;
+        z[j]  = data.columns[j]->z;
+        p[j]  = data.columns[j]->p;
+        Ap[j] = data.columns[j]->Ap;
+    }
+    //
+    Item< DynColl<FusedReduceValues> > &dcarsDots = *A.dcAllRedSumFused;
+    Future dotsFuture;
+    FusedReduceValues rtz = {}, oldrtz = {}, pAp = {}, rtr = {};
+    //
+    if (!doPreconditioning && rank == 0) {
+        cout << "WARNING: PERFORMING UNPRECONDITIONED ITERATIONS" << endl;
+    }
+    // p is of length ncols, copy x to p for sparse MV operation
+    for (int j = 0; j < nRhs; ++j) CopyVector(*x[j], *p[j], ctx, lrt);
+    //
+    TICK(); // Ap = A*p
+    ComputeSPMVMulti(A, p, Ap, nRhs, ctx, lrt);
+    TOCK(t3);
+    //
+    TICK(); // r = b - Ax (x stored in p)
+    for (int j = 0; j < nRhs; ++j) {
+        ComputeWAXPBY(nrow, 1.0, *b[j], -1.0, *Ap[j], *r[j], ctx, lrt);
+    }
+    TOCK(t2);
+    //
+    TICK();
+    ComputeDotProductsMulti(nrow, r, r, nRhs, dotsFuture, t4, dcarsDots,
+                            ctx, lrt);
+    rtr = GetDotProductsMulti(dotsFuture);
+    TOCK(t1);
+    //
+    floatType worst = 0.0;
+    for (int j = 0; j < nRhs; ++j) {
+        normr[j] = sqrt(rtr.v[j]);
+        normr0[j] = normr[j];
+        if (rank == 0) {
+            cout << "Initial Residual [" << j << "] = " << normr[j] << endl;
+        }
+        // Columns that start at the solution are done.
+        if (normr0[j] > 0.0) worst = 1.0;
+    }
+    // Start iterations.
+    niters = 0;
+    for (int k = 1; k <= maxIter && worst > tolerance; k++) {
+        TICK();
+        if (doPreconditioning) {
+            // Apply preconditioner.
+            ComputeMGMulti(A, data, 0, r, z, ctx, lrt);
+        }
+        else {
+            // Copy r to z (no preconditioning).
+            for (int j = 0; j < nRhs; ++j) CopyVector(*r[j], *z[j], ctx, lrt);
+        }
+        TOCK(t5); // Preconditioner apply time.
+        //
+        oldrtz = rtz;
+        TICK(); // rtz = r' * z
+        ComputeDotProductsMulti(nrow, r, z, nRhs, dotsFuture, t4, dcarsDots,
+                                ctx, lrt);
+        rtz = GetDotProductsMulti(dotsFuture);
+        TOCK(t1);
+        //
+        TICK(); // p = beta * p + z (p = z on the first iteration)
+        for (int j = 0; j < nRhs; ++j) {
+            if (k == 1 || oldrtz.v[j] == 0.0) {
+                ComputeWAXPBY(nrow, 1.0, *z[j], 0.0, *z[j], *p[j], ctx, lrt);
+            }
+            else {
+                const floatType beta = rtz.v[j] / oldrtz.v[j];
+                ComputeWAXPBY(nrow, 1.0, *z[j], beta, *p[j], *p[j], ctx, lrt);
+            }
+        }
+        TOCK(t2);
+        //
+        TICK(); // Ap = A * p
+        ComputeSPMVMulti(A, p, Ap, nRhs, ctx, lrt);
+        TOCK(t3);
+        //
+        TICK(); // pAp = p' * Ap
+        ComputeDotProductsMulti(nrow, p, Ap, nRhs, dotsFuture, t4, dcarsDots,
+                                ctx, lrt);
+        pAp = GetDotProductsMulti(dotsFuture);
+        TOCK(t1);
+        //
+        TICK(); // x = x + alpha * p, r = r - alpha * Ap
+        for (int j = 0; j < nRhs; ++j) {
+            // A converged column has p' * Ap == 0: leave it as it is.
+            const floatType alpha = pAp.v[j] != 0.0 ? rtz.v[j] / pAp.v[j]
+                                                    : 0.0;
+            ComputeWAXPBY(nrow, 1.0, *x[j], alpha, *p[j], *x[j], ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, *r[j], -alpha, *Ap[j], *r[j], ctx, lrt);
+        }
+        TOCK(t2);
+        //
+        TICK(); // r' * r
+        ComputeDotProductsMulti(nrow, r, r, nRhs, dotsFuture, t4, dcarsDots,
+                                ctx, lrt);
+        rtr = GetDotProductsMulti(dotsFuture);
+        TOCK(t1);
+        //
+        worst = 0.0;
+        for (int j = 0; j < nRhs; ++j) {
+            normr[j] = sqrt(rtr.v[j]);
+            if (normr0[j] > 0.0) worst = max(worst, normr[j] / normr0[j]);
+        }
+        if (rank == 0 && (k % print_freq == 0 || k == maxIter)) {
+            cout << "Iteration = " << k << "   Worst Scaled Residual = "
+                 << worst << endl;
+        }
+        //
+        niters = k;
+    }
+    // Store times.
+    times[1] += t1; // Dot product time.
+    times[2] += t2; // WAXPBY time.
+    times[3] += t3; // SPMV time.
+    times[4] += t4; // AllReduce time.
+    times[5] += t5; // Preconditioner apply time.
+    times[6] += t6; // Exchange halo time.
+    times[0] += mytimer() - t_begin;  // Total time. All done...
+    //
+    return 0;
+}
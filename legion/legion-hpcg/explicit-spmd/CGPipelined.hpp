@@ -0,0 +1,214 @@
+/**
+ * Copyright (c) 2016-2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file CGPipelined.hpp
+
+    Pipelined preconditioned CG (Ghysels and Vanroose). All of the inner
+    products of an iteration are combined into a single collective that is
+    started before, and overlapped with, the preconditioner apply and SpMV.
+ */
+
+#pragma once
+
+#include "CG.hpp"
+
+/*!
+    Pipelined routine to compute an approximate solution to Ax = b. Takes the
+    same parameters as CG(), but only synchronizes once per iteration. The
+    auxiliary recurrences make it slightly less stable than CG(), so it is
+    only used when explicitly requested (see --pipelined-cg).
+
+    @see CG()
+*/
+inline int
+CGPipelined(
+    SparseMatrix     &A,
+    CGData           &data,
+    Array<floatType> &b,
+    Array<floatType> &x,
+    const int        maxIter,
+    const floatType  tolerance,
+    int              &niters,
+    floatType        &normr,
+    floatType        &normr0,
+    double           *times,
+    bool             doPreconditioning,
+    Context          ctx,
+    Runtime          *lrt
+) {
+    using namespace std;
+    // Start timing right away.
+    double t_begin = mytimer();
+    //
+    const int print_freq = 10;
+    const int rank = A.geom->data()->rank;
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    //
+    Future dotsFuture, normrFuture;
+    floatType alpha = 0.0, beta = 0.0, alphaOld = 0.0;
+    floatType gamma = 0.0, gammaOld = 0.0, delta = 0.0;
+    double t0 = 0.0, t1 = 0.0, t2 = 0.0, t3 = 0.0, t4 = 0.0, t5 = 0.0, t6 = 0.0;
+    //
+    normr = 0.0;
+    niters = 0;
+    //
+    Array<floatType> &r  = *(data.r); // Residual vector.
+    Array<floatType> &u  = *(data.z); // Preconditioned residual vector.
+    Array<floatType> &p  = *(data.p); // Direction vector (ncol >= nrow).
+    Array<floatType> &s  = *(data.Ap);// s = A * p.
+    Array<floatType> &w  = *(data.w); // w = A * u.
+    Array<floatType> &m  = *(data.m); // m = M * w (ncol >= nrow).
+    Array<floatType> &n  = *(data.n); // n = A * m.
+    Array<floatType> &q  = *(data.q); // q = M * s.
+    Array<floatType> &zz = *(data.Aq);// zz = A * q.
+    //
+    Item< DynColl<FusedReduceValues> > &dcarsFused = *A.dcAllRedSumFused;
+    Item< DynColl<floatType> > &dcarsFT = *A.dcAllRedSumFT;
+    //
+    if (!doPreconditioning && rank == 0) {
+        cout << "WARNING: PERFORMING UNPRECONDITIONED ITERATIONS" << endl;
+    }
+    // p is of length ncols, copy x to p for sparse MV operation
+    CopyVector(x, p, ctx, lrt);
+    //
+    TICK(); // s = A*p
+    ComputeSPMV(A, p, s, ctx, lrt);
+    TOCK(t3);
+    //
+    TICK(); // r = b - Ax (x stored in p)
+    ComputeWAXPBY(nrow, 1.0, b, -1.0, s, r, ctx, lrt);
+    TOCK(t2);
+    //
+    TICK(); // u = M * r
+    if (doPreconditioning) ComputeMG(A, r, u, ctx, lrt);
+    else CopyVector(r, u, ctx, lrt);
+    TOCK(t5);
+    //
+    TICK(); // w = A * u
+    ComputeSPMV(A, u, w, ctx, lrt);
+    TOCK(t3);
+    //
+    bool converged = false;
+    // Start iterations.
+    for (int k = 1; k <= maxIter; k++) {
+        TICK(); // [gamma, delta, r'r] = [r'u, w'u, r'r]
+        ComputeFusedDotProducts(
+            nrow, r, u, w, dotsFuture, t4, dcarsFused, ctx, lrt
+        );
+        TOCK(t1);
+        // Overlap the reduction with m = M * w and n = A * m.
+        TICK();
+        if (doPreconditioning) ComputeMG(A, w, m, ctx, lrt);
+        else CopyVector(w, m, ctx, lrt);
+        TOCK(t5);
+        //
+        TICK();
+        ComputeSPMV(A, m, n, ctx, lrt);
+        TOCK(t3);
+        // The only synchronization point of the iteration.
+        const FusedReduceValues dots =
+            dotsFuture.get_result<FusedReduceValues>(silenceWarnings);
+        gamma = dots.v[0];
+        delta = dots.v[1];
+        normr = sqrt(dots.v[2]);
+        //
+        if (k == 1) {
+            if (rank == 0) cout << "Initial Residual = "<< normr << endl;
+            // Record initial residual for convergence testing.
+            normr0 = normr;
+        }
+        else if (rank == 0 && (k - 1) % print_freq == 0) {
+            cout << "Iteration = "<< k - 1 << "   Scaled Residual = "
+                 << normr / normr0 << std::endl;
+        }
+        //
+        if (normr / normr0 <= tolerance) {
+            converged = true;
+            break;
+        }
+        //
+        TICK();
+        if (k == 1) {
+            alpha = gamma / delta;
+            // Start the recurrences: zz = n, q = m, s = w, p = u.
+            ComputeWAXPBY(nrow, 1.0, n, 0.0, n, zz, ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, m, 0.0, m, q,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, w, 0.0, w, s,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, u, 0.0, u, p,  ctx, lrt);
+        }
+        else {
+            beta = gamma / gammaOld;
+            alpha = gamma / (delta - beta * gamma / alphaOld);
+            //
+            ComputeWAXPBY(nrow, 1.0, n, beta, zz, zz, ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, m, beta, q,  q,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, w, beta, s,  s,  ctx, lrt);
+            ComputeWAXPBY(nrow, 1.0, u, beta, p,  p,  ctx, lrt);
+        }
+        // x = x + alpha * p
+        ComputeWAXPBY(nrow, 1.0, x,  alpha, p,  x, ctx, lrt);
+        // r = r - alpha * s
+        ComputeWAXPBY(nrow, 1.0, r, -alpha, s,  r, ctx, lrt);
+        // u = u - alpha * q
+        ComputeWAXPBY(nrow, 1.0, u, -alpha, q,  u, ctx, lrt);
+        // w = w - alpha * zz
+        ComputeWAXPBY(nrow, 1.0, w, -alpha, zz, w, ctx, lrt);
+        TOCK(t2);
+        //
+        gammaOld = gamma;
+        alphaOld = alpha;
+        niters = k;
+    }
+    // The residual norm of the last update has not been reduced yet.
+    if (!converged) {
+        TICK();
+        ComputeDotProduct(nrow, r, r, normrFuture, t4, dcarsFT, ctx, lrt);
+        TOCK(t1);
+        //
+        normr = ComputeFuture(
+                    &normrFuture, FMO_SQRT, NULL, ctx, lrt
+                ).get_result<floatType>(silenceWarnings);
+        //
+        if (rank == 0) {
+            cout << "Iteration = "<< niters << "   Scaled Residual = "
+                 << normr / normr0 << std::endl;
+        }
+    }
+    // Store times.
+    times[1] += t1; // Dot product time.
+    times[2] += t2; // WAXPBY time.
+    times[3] += t3; // SPMV time.
+    times[4] += t4; // AllReduce time.
+    times[5] += t5; // Preconditioner apply time.
+    times[6] += t6; // Exchange halo time.
+    times[0] += mytimer() - t_begin;  // Total time. All done...
+    //
+    return 0;
+}
@@ -0,0 +1,242 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file CGSequence.hpp
+
+    CG over a sequence of slowly drifting right-hand sides (--sequence=N).
+    Every solve starts from the previous solution. With --recycle=K, the
+    solution updates of earlier solves are kept as an A-orthonormal basis W,
+    and each solve starts from the Galerkin projection W W' b of its new
+    solution onto that basis instead, which is never further from it in the
+    A-norm. When the basis is full it restarts from the last solution.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "mytimer.hpp"
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionCGData.hpp"
+#include "LegionSequenceData.hpp"
+#include "VectorOps.hpp"
+
+#include "CG.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "ComputeDotProduct.hpp"
+#include "FutureMath.hpp"
+
+#include <cmath>
+#include <vector>
+
+/**
+ * Results of a CGSequence run, for ReportResults.
+ */
+struct SequenceSolveData {
+    int nSolves = 0;
+    // Maximum number of recycled vectors (0: warm start only).
+    int nBasis = 0;
+    double drift = 0.0;
+    floatType tolerance = 0.0;
+    // Iterations of each solve. The first one starts from zero.
+    std::vector<int> niters;
+    // ||b_k - A x_k|| / ||b_k|| after each solve.
+    std::vector<floatType> scaledResiduals;
+    // Wall time of the whole sequence, basis updates included.
+    double seconds = 0.0;
+};
+
+/**
+ * Returns sqrt(x' y) once it is available.
+ */
+inline floatType
+SequenceNorm(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Context ctx,
+    Runtime *lrt
+) {
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    double tAllreduce = 0.0;
+    Future dotF;
+    ComputeDotProduct(nrow, x, y, dotF, tAllreduce, *A.dcAllRedSumFT, ctx, lrt);
+    return ComputeFuture(
+               &dotF, FMO_SQRT, NULL, ctx, lrt
+           ).get_result<floatType>(silenceWarnings);
+}
+
+/**
+ * Makes x - x0, the update of the last solve, the next basis vector: it is
+ * A-orthogonalized against the basis (classical Gram-Schmidt) and scaled to
+ * unit A-norm. p and Ap of data are used for the SpMVs.
+ */
+inline void
+SequenceExtendBasis(
+    SparseMatrix &A,
+    CGData &data,
+    SequenceData &seq,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    Array<floatType> &p  = *data.p;
+    Array<floatType> &Ap = *data.Ap;
+    double tAllreduce = 0.0;
+    // Restart from the last solution alone.
+    if (seq.nUsed == seq.nBasis) {
+        seq.nUsed = 0;
+        ZeroVector(*seq.x0, ctx, lrt);
+    }
+    Array<floatType> &w = *seq.W[seq.nUsed];
+    ComputeWAXPBY(nrow, 1.0, x, -1.0, *seq.x0, w, ctx, lrt);
+    //
+    CopyVector(w, p, ctx, lrt);
+    ComputeSPMV(A, p, Ap, ctx, lrt);
+    for (int j = 0; j < seq.nUsed; ++j) {
+        Future cF; // w -= (W[j]' A w) W[j]
+        ComputeDotProduct(
+            nrow, *seq.W[j], Ap, cF, tAllreduce, *A.dcAllRedSumFT, ctx, lrt
+        );
+        ComputeWAXPBY(nrow, 1.0, w, -1.0, &cF, *seq.W[j], w, ctx, lrt);
+    }
+    //
+    CopyVector(w, p, ctx, lrt);
+    ComputeSPMV(A, p, Ap, ctx, lrt);
+    const floatType normA = SequenceNorm(A, w, Ap, ctx, lrt);
+    // Nothing new (or lost to rounding): keep the basis as it is.
+    if (!(normA > 0.0)) return;
+    ComputeWAXPBY(nrow, 0.0, w, 1.0 / normA, w, w, ctx, lrt);
+    seq.nUsed++;
+}
+
+/**
+ * Solves A x_k = b + k delta for k = 0, ..., nSolves - 1, each to
+ * ||b_k - A x_k|| <= tolerance ||b_k||, where delta is random with
+ * ||delta|| = drift ||b||. On entry x is the initial guess of the first
+ * solve, on exit the last solution. CG's phase times are added to times.
+ *
+ * @return Returns zero on success and a non-zero value otherwise.
+ */
+inline int
+CGSequence(
+    SparseMatrix     &A,
+    CGData           &data,
+    SequenceData     &seq,
+    Array<floatType> &b,
+    Array<floatType> &x,
+    int              nSolves,
+    double           drift,
+    const int        maxIter,
+    const floatType  tolerance,
+    SequenceSolveData &result,
+    double           *times,
+    bool             doPreconditioning,
+    Context          ctx,
+    Runtime          *lrt
+) {
+    using namespace std;
+    const double tBegin = mytimer();
+    const int rank = A.geom->data()->rank;
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    //
+    Array<floatType> &r  = *data.r;
+    Array<floatType> &p  = *data.p;
+    Array<floatType> &Ap = *data.Ap;
+    //
+    result.nSolves = nSolves;
+    result.nBasis = seq.nBasis;
+    result.drift = drift;
+    result.tolerance = tolerance;
+    result.niters.assign(nSolves, 0);
+    result.scaledResiduals.assign(nSolves, 0.0);
+    seq.nUsed = 0;
+    //
+    FillRandomVector(*seq.delta, ctx, lrt);
+    const floatType normb = SequenceNorm(A, b, b, ctx, lrt);
+    const floatType normDelta = SequenceNorm(
+                                    A, *seq.delta, *seq.delta, ctx, lrt
+                                );
+    ComputeWAXPBY(
+        nrow, 0.0, *seq.delta, drift * normb / normDelta, *seq.delta,
+        *seq.delta, ctx, lrt
+    );
+    //
+    int ierr = 0;
+    for (int k = 0; k < nSolves; ++k) {
+        ComputeWAXPBY(nrow, 1.0, b, floatType(k), *seq.delta, *seq.b, ctx, lrt);
+        // x0 = W W' b_k. Without a basis x keeps the last solution.
+        if (seq.nBasis > 0) {
+            double tAllreduce = 0.0;
+            ZeroVector(*seq.x0, ctx, lrt);
+            for (int j = 0; j < seq.nUsed; ++j) {
+                Future cF;
+                ComputeDotProduct(
+                    nrow, *seq.W[j], *seq.b, cF, tAllreduce,
+                    *A.dcAllRedSumFT, ctx, lrt
+                );
+                ComputeWAXPBY(
+                    nrow, 1.0, *seq.x0, 1.0, &cF, *seq.W[j], *seq.x0, ctx, lrt
+                );
+            }
+            CopyVector(*seq.x0, x, ctx, lrt);
+        }
+        // CG stops relative to its initial residual, so scale the tolerance
+        // to be relative to ||b_k|| instead.
+        const floatType normbk = SequenceNorm(A, *seq.b, *seq.b, ctx, lrt);
+        CopyVector(x, p, ctx, lrt);
+        ComputeSPMV(A, p, Ap, ctx, lrt);
+        ComputeWAXPBY(nrow, 1.0, *seq.b, -1.0, Ap, r, ctx, lrt);
+        const floatType normr0 = SequenceNorm(A, r, r, ctx, lrt);
+        //
+        int niters = 0;
+        floatType normr = normr0, cgNormr0 = normr0;
+        if (normr0 > tolerance * normbk) {
+            ierr += CG(A, data, *seq.b, x, maxIter,
+                       tolerance * normbk / normr0, niters, normr, cgNormr0,
+                       times, doPreconditioning, ctx, lrt
+                    );
+        }
+        result.niters[k] = niters;
+        result.scaledResiduals[k] = normr / normbk;
+        if (rank == 0) {
+            cout << "Solve [" << k << "] Iterations [" << niters
+                 << "] Scaled Residual [" << normr / normbk << "]" << endl;
+        }
+        //
+        if (seq.nBasis > 0) SequenceExtendBasis(A, data, seq, x, ctx, lrt);
+    }
+    result.seconds = mytimer() - tBegin;
+    //
+    return ierr;
+}
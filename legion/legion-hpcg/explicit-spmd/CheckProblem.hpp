@@ -72,6 +72,9 @@
                          the exact solution (if the xexact!=0 non-zero on
                          entry).
 
+    Reads mtxIndG and localToGlobalMap, so it must run before
+    SparseMatrix::releaseSetupIndices.
+
     @see GenerateGeometry
 */
 
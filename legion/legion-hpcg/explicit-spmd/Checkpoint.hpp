@@ -0,0 +1,267 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file Checkpoint.hpp
+
+    Per-shard binary dumps of the generated problem (one file per MG level) so
+    that restarts can map them back in instead of regenerating.
+ */
+
+#pragma once
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Identifies (and versions) checkpoint files.
+#define LGNCG_CHECKPOINT_MAGIC 0x4c474e4347434b31ULL
+// Section payloads start at multiples of this many bytes.
+#define LGNCG_CHECKPOINT_ALIGN 64
+
+/**
+ *
+ */
+struct CheckpointHeader {
+    uint64_t magic;
+    int32_t rank;
+    int32_t level;
+    uint64_t nSections;
+};
+
+/**
+ * A contiguous piece of a region to dump or restore.
+ */
+struct CheckpointSection {
+    void *data;
+    uint64_t bytes;
+};
+
+/**
+ *
+ */
+template <typename TYPE>
+inline void
+addCheckpointSection(
+    std::vector<CheckpointSection> &sections,
+    Item<TYPE> *item
+) {
+    assert(item && item->data());
+    sections.push_back({item->data(), sizeof(TYPE)});
+}
+
+/**
+ *
+ */
+template <typename TYPE>
+inline void
+addCheckpointSection(
+    std::vector<CheckpointSection> &sections,
+    Array<TYPE> *array
+) {
+    assert(array && array->data());
+    sections.push_back({array->data(), array->length() * sizeof(TYPE)});
+}
+
+/**
+ * Returns everything GenerateProblem, GetNeighborInfo, and
+ * GenerateCoarseProblem produce for A, followed by the vectors that are not
+ * NULL. Restoring these sections is equivalent to regenerating the level.
+ */
+inline std::vector<CheckpointSection>
+getCheckpointSections(
+    SparseMatrix &A,
+    Array<floatType> *b,
+    Array<floatType> *x,
+    Array<floatType> *xexact
+) {
+    std::vector<CheckpointSection> sections;
+    addCheckpointSection(sections, A.geom);
+    addCheckpointSection(sections, A.sclrs);
+    addCheckpointSection(sections, A.nonzerosInRow);
+    addCheckpointSection(sections, A.mtxIndG);
+    addCheckpointSection(sections, A.matrixValues);
+    addCheckpointSection(sections, A.matrixDiagonal);
+    addCheckpointSection(sections, A.localToGlobalMap);
+    addCheckpointSection(sections, A.neighbors);
+    addCheckpointSection(sections, A.sendLength);
+    addCheckpointSection(sections, A.recvLength);
+    addCheckpointSection(sections, A.matdIdxToMatRowCol);
+    for (auto *v : {b, x, xexact}) {
+        if (v) addCheckpointSection(sections, v);
+    }
+    return sections;
+}
+
+/**
+ *
+ */
+inline std::string
+getCheckpointFileName(
+    const std::string &dir,
+    int rank,
+    int level
+) {
+    return dir + "/lgncg-ckpt-s" + std::to_string(rank)
+         + "-l" + std::to_string(level) + ".bin";
+}
+
+/**
+ *
+ */
+inline uint64_t
+alignCheckpointOffset(uint64_t off)
+{
+    const uint64_t a = LGNCG_CHECKPOINT_ALIGN;
+    return (off + a - 1) / a * a;
+}
+
+/**
+ * Writes level of A (and the vectors that are not NULL) to dir.
+ *
+ * @return Returns zero on success and a non-zero value otherwise.
+ */
+inline int
+WriteCheckpoint(
+    const std::string &dir,
+    int level,
+    SparseMatrix &A,
+    Array<floatType> *b,
+    Array<floatType> *x,
+    Array<floatType> *xexact
+) {
+    const int rank = A.geom->data()->rank;
+    const auto sections = getCheckpointSections(A, b, x, xexact);
+    const std::string fName = getCheckpointFileName(dir, rank, level);
+    //
+    FILE *f = fopen(fName.c_str(), "wb");
+    if (!f) {
+        fprintf(stderr, "could not open %s for writing\n", fName.c_str());
+        return 1;
+    }
+    CheckpointHeader hdr = {
+        .magic = LGNCG_CHECKPOINT_MAGIC,
+        .rank = rank,
+        .level = level,
+        .nSections = sections.size()
+    };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    // Section sizes follow the header so readers can validate the layout.
+    for (const auto &s : sections) {
+        ok = ok && fwrite(&s.bytes, sizeof(s.bytes), 1, f) == 1;
+    }
+    uint64_t off = sizeof(hdr) + sections.size() * sizeof(uint64_t);
+    static const char zeros[LGNCG_CHECKPOINT_ALIGN] = {0};
+    for (const auto &s : sections) {
+        const uint64_t aligned = alignCheckpointOffset(off);
+        ok = ok && fwrite(zeros, 1, aligned - off, f) == aligned - off;
+        ok = ok && fwrite(s.data, 1, s.bytes, f) == s.bytes;
+        off = aligned + s.bytes;
+    }
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        fprintf(stderr, "could not write %s\n", fName.c_str());
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * Restores level of A (and the vectors that are not NULL) from a file
+ * written by WriteCheckpoint with the same problem setup. The file is mapped
+ * read-only and each section is copied into its region.
+ *
+ * @return Returns zero on success and a non-zero value otherwise.
+ */
+inline int
+ReadCheckpoint(
+    const std::string &dir,
+    int rank,
+    int level,
+    SparseMatrix &A,
+    Array<floatType> *b,
+    Array<floatType> *x,
+    Array<floatType> *xexact
+) {
+    const auto sections = getCheckpointSections(A, b, x, xexact);
+    const std::string fName = getCheckpointFileName(dir, rank, level);
+    //
+    const int fd = open(fName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        fprintf(stderr, "could not open %s for reading\n", fName.c_str());
+        return 1;
+    }
+    struct stat sb;
+    if (fstat(fd, &sb) == -1 || size_t(sb.st_size) < sizeof(CheckpointHeader)) {
+        fprintf(stderr, "%s is not a checkpoint file\n", fName.c_str());
+        close(fd);
+        return 1;
+    }
+    const size_t fSize = sb.st_size;
+    void *map = mmap(NULL, fSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "could not map %s\n", fName.c_str());
+        return 1;
+    }
+    const char *const base = (const char *)map;
+    const auto *const hdr = (const CheckpointHeader *)base;
+    const auto *const sizes = (const uint64_t *)(base + sizeof(*hdr));
+    //
+    uint64_t off = sizeof(*hdr) + sections.size() * sizeof(uint64_t);
+    bool ok = off <= fSize &&
+              hdr->magic == LGNCG_CHECKPOINT_MAGIC &&
+              hdr->rank == rank &&
+              hdr->level == level &&
+              hdr->nSections == sections.size();
+    for (size_t i = 0; ok && i < sections.size(); ++i) {
+        const uint64_t aligned = alignCheckpointOffset(off);
+        ok = sizes[i] == sections[i].bytes &&
+             aligned + sizes[i] <= fSize;
+        if (ok) memcpy(sections[i].data, base + aligned, sizes[i]);
+        off = aligned + sizes[i];
+    }
+    munmap(map, fSize);
+    if (!ok) {
+        fprintf(stderr, "%s does not match this problem setup\n",
+                fName.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -124,6 +124,64 @@ FloatReduceMinAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
     exit(1);
 }
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const FusedReduceValues FusedReduceSumAccumulate::identity = {};
+
+template<>
+void
+FusedReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
+    for (int i = 0; i < LGNCG_FUSED_REDUCE_LEN; ++i) lhs.v[i] += rhs.v[i];
+}
+
+template<>
+void
+FusedReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
+    exit(1);
+}
+
+template<>
+void
+FusedReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
+    for (int i = 0; i < LGNCG_FUSED_REDUCE_LEN; ++i) rhs1.v[i] += rhs2.v[i];
+}
+
+template<>
+void
+FusedReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
+    exit(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+const ReproSumValue ReproReduceSumAccumulate::identity = {};
+
+template<>
+void
+ReproReduceSumAccumulate::apply<true>(LHS &lhs, RHS rhs) {
+    ReproSumMerge(lhs, rhs);
+}
+
+template<>
+void
+ReproReduceSumAccumulate::apply<false>(LHS &lhs, RHS rhs) {
+    exit(1);
+}
+
+template<>
+void
+ReproReduceSumAccumulate::fold<true>(RHS &rhs1, RHS rhs2) {
+    ReproSumMerge(rhs1, rhs2);
+}
+
+template<>
+void
+ReproReduceSumAccumulate::fold<false>(RHS &rhs1, RHS rhs2) {
+    exit(1);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -163,8 +221,11 @@ dynCollTaskContribFT(
     Context,
     Runtime *
 ) {
+    const auto *const args = (NodeReduceArgs *)task->args;
     Future f = task->futures[0];
-    return f.get_result<floatType>(silenceWarnings);
+    return NodeReducer<floatType>::instance().contribute(
+        *args, f.get_result<floatType>(silenceWarnings)
+    );
 }
 
 /**
@@ -177,8 +238,59 @@ dynCollTaskContribGIT(
     Context,
     Runtime *
 ) {
+    const auto *const args = (NodeReduceArgs *)task->args;
+    Future f = task->futures[0];
+    return NodeReducer<global_int_t>::instance().contribute(
+        *args, f.get_result<global_int_t>(silenceWarnings)
+    );
+}
+
+/**
+ *
+ */
+FusedReduceValues
+dynCollTaskContribFused(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    const auto *const args = (NodeReduceArgs *)task->args;
+    Future f = task->futures[0];
+    return NodeReducer<FusedReduceValues>::instance().contribute(
+        *args, f.get_result<FusedReduceValues>(silenceWarnings)
+    );
+}
+
+/**
+ *
+ */
+ReproSumValue
+dynCollTaskContribRepro(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    const auto *const args = (NodeReduceArgs *)task->args;
     Future f = task->futures[0];
-    return f.get_result<global_int_t>(silenceWarnings);
+    return NodeReducer<ReproSumValue>::instance().contribute(
+        *args, f.get_result<ReproSumValue>(silenceWarnings)
+    );
+}
+
+/**
+ *
+ */
+floatType
+reproSumToFloatTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context,
+    Runtime *
+) {
+    Future f = task->futures[0];
+    return ReproSumToDouble(f.get_result<ReproSumValue>(silenceWarnings));
 }
 
 /**
@@ -205,6 +317,37 @@ registerCollectiveOpsTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "dynCollTaskContribFT"
     );
+    HighLevelRuntime::register_legion_task<
+        FusedReduceValues, dynCollTaskContribFused
+    >(
+        DYN_COLL_TASK_CONTRIB_FUSED_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "dynCollTaskContribFused"
+    );
+    HighLevelRuntime::register_legion_task<
+        ReproSumValue, dynCollTaskContribRepro
+    >(
+        DYN_COLL_TASK_CONTRIB_REPRO_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "dynCollTaskContribRepro"
+    );
+    HighLevelRuntime::register_legion_task<floatType, reproSumToFloatTask>(
+        REPRO_SUM_TO_FLOAT_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "reproSumToFloatTask"
+    );
     HighLevelRuntime::register_reduction_op<FloatReduceSumAccumulate>(
         FLOAT_REDUCE_SUM_TID
     );
@@ -214,7 +357,13 @@ registerCollectiveOpsTasks(void)
     HighLevelRuntime::register_reduction_op<FloatReduceMaxAccumulate>(
         FLOAT_REDUCE_MAX_TID
     );
+    HighLevelRuntime::register_reduction_op<FusedReduceSumAccumulate>(
+        FUSED_REDUCE_SUM_TID
+    );
     HighLevelRuntime::register_reduction_op<IntReduceSumAccumulate>(
         INT_REDUCE_SUM_TID
     );
+    HighLevelRuntime::register_reduction_op<ReproReduceSumAccumulate>(
+        REPRO_REDUCE_SUM_TID
+    );
 }
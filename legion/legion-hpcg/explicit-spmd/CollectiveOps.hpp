@@ -31,13 +31,31 @@
 
 #include "Types.hpp"
 #include "LegionItems.hpp"
+#include "ReproSum.hpp"
 
 #include "legion.h"
 
+#include <algorithm>
 #include <cfloat>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <utility>
 
 using namespace LegionRuntime::HighLevel;
 
+// Number of scalars that can be packed into a single fused reduction (three
+// for pipelined CG, one per right-hand side for CGMulti).
+#define LGNCG_FUSED_REDUCE_LEN 4
+
+/**
+ * A small, fixed-size vector of values that are reduced (summed) together
+ * using a single collective.
+ */
+struct FusedReduceValues {
+    floatType v[LGNCG_FUSED_REDUCE_LEN];
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -48,6 +66,16 @@ struct DynColl {
     int tid;
     //
     int nArrivals = 0;
+    // Shards on the same node first combine their contributions in shared
+    // memory (see NodeReducer), and only the node leader arrives at dc. With
+    // one shard per node every shard is its own leader.
+    int nodeArrivals = 1;
+    //
+    bool nodeLeader = true;
+    // Identifies this collective in NodeReducer.
+    int64_t nodeKey = 0;
+    // Number of allReduce()s issued on this collective so far.
+    int64_t generation = 0;
     //
     TYPE localBuffer;
     //
@@ -106,6 +134,42 @@ private:
                 assert(false);
         }
     }
+
+    /**
+     *
+     */
+    void
+    mInitLocalBuffer(
+        int tid,
+        FusedReduceValues &lb
+    ) {
+        switch (tid) {
+            case FUSED_REDUCE_SUM_TID:
+                for (int i = 0; i < LGNCG_FUSED_REDUCE_LEN; ++i) {
+                    lb.v[i] = 0.0;
+                }
+                break;
+            default:
+                assert(false);
+        }
+    }
+
+    /**
+     *
+     */
+    void
+    mInitLocalBuffer(
+        int tid,
+        ReproSumValue &lb
+    ) {
+        switch (tid) {
+            case REPRO_REDUCE_SUM_TID:
+                ReproSumClear(lb);
+                break;
+            default:
+                assert(false);
+        }
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -156,6 +220,41 @@ public:
     static void fold(RHS &rhs1, RHS rhs2);
 };
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+class FusedReduceSumAccumulate {
+public:
+    typedef FusedReduceValues LHS;
+    typedef FusedReduceValues RHS;
+    static const FusedReduceValues identity;
+
+    template <bool EXCLUSIVE>
+    static void apply(LHS &lhs, RHS rhs);
+
+    template <bool EXCLUSIVE>
+    static void fold(RHS &rhs1, RHS rhs2);
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * Exact, order-independent sum (see ReproSum.hpp).
+ */
+class ReproReduceSumAccumulate {
+public:
+    typedef ReproSumValue LHS;
+    typedef ReproSumValue RHS;
+    static const ReproSumValue identity;
+
+    template <bool EXCLUSIVE>
+    static void apply(LHS &lhs, RHS rhs);
+
+    template <bool EXCLUSIVE>
+    static void fold(RHS &rhs1, RHS rhs2);
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -172,6 +271,130 @@ public:
     static void fold(RHS &rhs1, RHS rhs2);
 };
 
+/**
+ * Returns a new key for NodeReducer.
+ */
+inline int64_t
+NextNodeReduceKey(void)
+{
+    static int64_t key = 0;
+    return key++;
+}
+
+/**
+ * Arguments passed to the dynamic collective contribution tasks.
+ */
+struct NodeReduceArgs {
+    int64_t key;
+    int64_t generation;
+    int nodeArrivals;
+    bool nodeLeader;
+    // Reduction operator ID of the collective.
+    int redop;
+};
+
+/**
+ *
+ */
+inline void
+NodeCombine(int redop, floatType &acc, floatType v)
+{
+    switch (redop) {
+        case FLOAT_REDUCE_SUM_TID: acc += v; break;
+        case FLOAT_REDUCE_MIN_TID: acc = std::min(acc, v); break;
+        case FLOAT_REDUCE_MAX_TID: acc = std::max(acc, v); break;
+        default: assert(false);
+    }
+}
+
+/**
+ *
+ */
+inline void
+NodeCombine(int redop, global_int_t &acc, global_int_t v)
+{
+    assert(redop == INT_REDUCE_SUM_TID);
+    acc += v;
+}
+
+/**
+ *
+ */
+inline void
+NodeCombine(int redop, FusedReduceValues &acc, const FusedReduceValues &v)
+{
+    assert(redop == FUSED_REDUCE_SUM_TID);
+    for (int i = 0; i < LGNCG_FUSED_REDUCE_LEN; ++i) acc.v[i] += v.v[i];
+}
+
+/**
+ *
+ */
+inline void
+NodeCombine(int redop, ReproSumValue &acc, const ReproSumValue &v)
+{
+    assert(redop == REPRO_REDUCE_SUM_TID);
+    ReproSumMerge(acc, v);
+}
+
+/**
+ * Combines the contributions of all shards on a node in shared memory. Every
+ * shard deposits its value; the node leader blocks until all of its peers
+ * have done so and returns the node total, which is what enters the global
+ * dynamic collective.
+ */
+template <typename TYPE>
+class NodeReducer {
+    //
+    struct Slot {
+        TYPE acc;
+        int count = 0;
+    };
+    //
+    std::mutex mLock;
+    //
+    std::condition_variable mCV;
+    //
+    std::map< std::pair<int64_t, int64_t>, Slot > mSlots;
+
+public:
+    /**
+     *
+     */
+    static NodeReducer &
+    instance(void) {
+        static NodeReducer reducer;
+        return reducer;
+    }
+
+    /**
+     * Returns the node total for the leader and value for everyone else.
+     */
+    TYPE
+    contribute(
+        const NodeReduceArgs &args,
+        const TYPE &value
+    ) {
+        if (args.nodeArrivals == 1) return value;
+        //
+        const auto key = std::make_pair(args.key, args.generation);
+        std::unique_lock<std::mutex> guard(mLock);
+        Slot &slot = mSlots[key];
+        if (slot.count == 0) slot.acc = value;
+        else NodeCombine(args.redop, slot.acc, value);
+        //
+        if (++slot.count == args.nodeArrivals) mCV.notify_all();
+        if (!args.nodeLeader) return value;
+        //
+        mCV.wait(guard, [&] {
+            return mSlots[key].count == args.nodeArrivals;
+        });
+        const TYPE res = mSlots[key].acc;
+        mSlots.erase(key);
+        return res;
+    }
+};
+
 /**
  * The type of DynColl passed in changes the behavior of the all reduce.
  */
@@ -191,20 +414,52 @@ allReduce(
     else if (typeid(TYPE) == typeid(global_int_t)) {
         tid = DYN_COLL_TASK_CONTRIB_GIT_TID;
     }
+    else if (typeid(TYPE) == typeid(FusedReduceValues)) {
+        tid = DYN_COLL_TASK_CONTRIB_FUSED_TID;
+    }
+    else if (typeid(TYPE) == typeid(ReproSumValue)) {
+        tid = DYN_COLL_TASK_CONTRIB_REPRO_TID;
+    }
     else {
         exit(1);
     }
     //
-    TaskLauncher tl(tid, TaskArgument(NULL, 0));
+    DynColl<TYPE> *dcd = dc.data();
+    //
+    NodeReduceArgs args {
+        .key = dcd->nodeKey,
+        .generation = dcd->generation++,
+        .nodeArrivals = dcd->nodeArrivals,
+        .nodeLeader = dcd->nodeLeader,
+        .redop = dcd->tid
+    };
+    TaskLauncher tl(tid, TaskArgument(&args, sizeof(args)));
     //
     tl.add_future(localFuture);
     //
     Future f = runtime->execute_task(ctx, tl);
     //
-    DynamicCollective &dynCol = dc.data()->dc;
-    //
-    runtime->defer_dynamic_collective_arrival(ctx, dynCol, f);
+    DynamicCollective &dynCol = dcd->dc;
+    // Everyone else's contribution is part of the leader's.
+    if (dcd->nodeLeader) {
+        runtime->defer_dynamic_collective_arrival(ctx, dynCol, f);
+    }
     dynCol = runtime->advance_dynamic_collective(ctx, dynCol);
     //
     return runtime->get_dynamic_collective_result(ctx, dynCol);
 }
+
+/**
+ * Returns a future holding the double nearest to the ReproSumValue in
+ * reproFuture.
+ */
+inline Future
+reproSumToFloat(
+    Future reproFuture,
+    Context ctx,
+    Runtime *runtime
+) {
+    TaskLauncher tl(REPRO_SUM_TO_FLOAT_TID, TaskArgument(NULL, 0));
+    tl.add_future(reproFuture);
+    return runtime->execute_task(ctx, tl);
+}
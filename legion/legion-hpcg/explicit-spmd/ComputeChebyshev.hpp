@@ -0,0 +1,393 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file ComputeChebyshev.hpp
+
+    Jacobi-preconditioned Chebyshev polynomial smoother, an alternative to
+    SYMGS in ComputeMG (--smoother=chebyshev). A smoother step of degree k
+    costs k SpMVs and k vector updates and has no sequential row dependences,
+    unlike the Gauss-Seidel sweeps. The polynomial targets the upper part,
+    [lambdaMax / HPCG_CHEBYSHEV_EIG_RATIO, lambdaMax], of the spectrum of
+    D^-1 A. lambdaMax is estimated once per level by SetupChebyshevSmoother
+    from a few Jacobi-PCG (Lanczos) steps. The polynomial is fixed, so the
+    V-cycle remains a symmetric preconditioner.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionCGData.hpp"
+#include "LegionMGData.hpp"
+#include "VectorOps.hpp"
+#include "VectorKernels.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "ComputeDotProduct.hpp"
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <cassert>
+
+/**
+ *
+ */
+struct ComputeChebyshevArgs {
+    local_int_t n;
+    floatType c1;
+    floatType c2;
+    // If not set, b - Ax is b (x is zero).
+    bool hasAx;
+    // If set, x += d.
+    bool updateX;
+};
+
+/**
+ * d = c1 * d + c2 * D^-1 (b - Ax), then x += d if x is not NULL.
+ */
+inline int
+ComputeChebyshevKernel(
+    const Array<floatType> &b,
+    const Array<floatType> *Ax,
+    const Array<floatType> &AmatrixDiagonal,
+    Array<floatType> &d,
+    Array<floatType> *x,
+    const ComputeChebyshevArgs &args
+) {
+    const local_int_t n = args.n;
+    assert(b.length() >= size_t(n));
+    assert(d.length() >= size_t(n));
+    //
+    const floatType *const bv = b.data();
+    assert(bv);
+    const floatType *const Axv = Ax ? Ax->data() : nullptr;
+    const floatType *const diag = AmatrixDiagonal.data();
+    assert(diag);
+    floatType *const dv = d.data();
+    assert(dv);
+    floatType *const xv = x ? x->data() : nullptr;
+
+    const int nVectors = 3 + (Ax ? 1 : 0) + (x ? 2 : 0)
+                       + (args.c1 != 0.0 ? 1 : 0);
+    LGNCG_PROFILE(CHEBYSHEV_TID, nVectors * n * sizeof(floatType));
+
+    ChebyshevRows(n, args.c1, args.c2, bv, Axv, diag, dv, xv);
+    //
+    return 0;
+}
+
+/**
+ * d = c1 * d + c2 * D^-1 (b - Ax), then x += d if x is not NULL. Ax may
+ * be NULL if x is zero.
+ */
+inline int
+ChebyshevUpdate(
+    SparseMatrix &A,
+    floatType c1,
+    floatType c2,
+    Array<floatType> &b,
+    Array<floatType> *Ax,
+    Array<floatType> &d,
+    Array<floatType> *x,
+    Context ctx,
+    Runtime *lrt
+) {
+    const ComputeChebyshevArgs args = {
+        .n       = A.sclrs->data()->localNumberOfRows,
+        .c1      = c1,
+        .c2      = c2,
+        .hasAx   = (Ax != nullptr),
+        .updateX = (x != nullptr)
+    };
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        CHEBYSHEV_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    b.intent(RO_E, tl, ctx, lrt);
+    if (Ax) Ax->intent(RO_E, tl, ctx, lrt);
+    A.matrixDiagonal->intent(RO_E, tl, ctx, lrt);
+    d.intent(c1 != 0.0 ? RW_E : WO_E, tl, ctx, lrt);
+    if (x) x->intent(RW_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    return 0;
+#else
+    return ComputeChebyshevKernel(b, Ax, *A.matrixDiagonal, d, x, args);
+#endif
+}
+
+/**
+ *
+ */
+void
+ComputeChebyshevTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeChebyshevArgs *)task->args;
+    //
+    int rid = 0;
+    Array<floatType> b(regions[rid++], ctx, lrt);
+    Array<floatType> *Ax = nullptr;
+    if (args->hasAx) Ax = new Array<floatType>(regions[rid++], ctx, lrt);
+    Array<floatType> AmatrixDiagonal(regions[rid++], ctx, lrt);
+    Array<floatType> d(regions[rid++], ctx, lrt);
+    Array<floatType> *x = nullptr;
+    if (args->updateX) x = new Array<floatType>(regions[rid++], ctx, lrt);
+    //
+    ComputeChebyshevKernel(b, Ax, AmatrixDiagonal, d, x, *args);
+    //
+    delete Ax;
+    delete x;
+}
+
+/*!
+    Applies one Chebyshev smoother step of degree
+    ShardKernelVariants().chebyshevDegree to A x = r. This is the
+    three-term recurrence of Saad, Iterative Methods for Sparse Linear
+    Systems, Algorithm 12.1, preconditioned with the matrix diagonal.
+    A.mgData->Axf holds A x and A.mgData->chebyD the update.
+
+    @param[in] A the known system matrix, with mgData and chebyshevLambdaMax.
+
+    @param[in] r the input vector.
+
+    @param[inout] x the approximation to Ax = r, updated by the smoother.
+
+    @param[in] xIsZero if set, x is known to be zero on entry, which saves the
+    first SpMV.
+
+    @return returns 0 upon success and non-zero otherwise.
+*/
+inline int
+ComputeChebyshev(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    bool xIsZero,
+    Context ctx,
+    Runtime *lrt
+) {
+    assert(A.mgData);
+    assert(A.chebyshevLambdaMax > 0.0);
+    //
+    const floatType lambdaMax = A.chebyshevLambdaMax;
+    const floatType lambdaMin = lambdaMax / HPCG_CHEBYSHEV_EIG_RATIO;
+    const floatType theta = 0.5 * (lambdaMax + lambdaMin);
+    const floatType delta = 0.5 * (lambdaMax - lambdaMin);
+    const floatType sigma = theta / delta;
+    const int degree = ShardKernelVariants().chebyshevDegree;
+    const bool inPreconditioner = true;
+    //
+    Array<floatType> &Ax = *A.mgData->Axf;
+    Array<floatType> &d = *A.mgData->chebyD;
+    //
+    int ierr = 0;
+    if (!xIsZero) {
+        ierr = ComputeSPMV(A, x, Ax, ctx, lrt, inPreconditioner);
+        if (ierr != 0) return ierr;
+    }
+    ierr = ChebyshevUpdate(
+               A, 0.0, 1.0 / theta, r, xIsZero ? nullptr : &Ax, d, &x,
+               ctx, lrt
+           );
+    if (ierr != 0) return ierr;
+    //
+    floatType rho = 1.0 / sigma;
+    for (int k = 1; k < degree; ++k) {
+        const floatType rhoNext = 1.0 / (2.0 * sigma - rho);
+        ierr = ComputeSPMV(A, x, Ax, ctx, lrt, inPreconditioner);
+        if (ierr != 0) return ierr;
+        ierr = ChebyshevUpdate(
+                   A, rhoNext * rho, 2.0 * rhoNext / delta, r, &Ax, d, &x,
+                   ctx, lrt
+               );
+        if (ierr != 0) return ierr;
+        rho = rhoNext;
+    }
+    //
+    return 0;
+}
+
+/**
+ * Largest eigenvalue of the symmetric tridiagonal matrix with the given
+ * diagonal and off-diagonal (one entry shorter), by Sturm sequence bisection.
+ */
+inline double
+TridiagonalMaxEigenvalue(
+    const std::vector<double> &diag,
+    const std::vector<double> &offDiag
+) {
+    const size_t m = diag.size();
+    assert(m > 0 && offDiag.size() + 1 == m);
+    // Gershgorin bounds.
+    double lo = diag[0], hi = diag[0];
+    for (size_t i = 0; i < m; ++i) {
+        double radius = 0.0;
+        if (i > 0)     radius += std::fabs(offDiag[i - 1]);
+        if (i + 1 < m) radius += std::fabs(offDiag[i]);
+        lo = std::min(lo, diag[i] - radius);
+        hi = std::max(hi, diag[i] + radius);
+    }
+    // Number of eigenvalues smaller than s.
+    auto nBelow = [&](double s) {
+        size_t count = 0;
+        double q = 1.0;
+        for (size_t i = 0; i < m; ++i) {
+            const double e2 = (i > 0) ? offDiag[i - 1] * offDiag[i - 1] : 0.0;
+            q = diag[i] - s - (i > 0 ? e2 / q : 0.0);
+            if (q == 0.0) q = -1e-300;
+            if (q < 0.0) ++count;
+        }
+        return count;
+    };
+    for (int it = 0; it < 100 && hi - lo > 1e-12 * std::fabs(hi); ++it) {
+        const double mid = 0.5 * (lo + hi);
+        if (nBelow(mid) == m) hi = mid;
+        else                  lo = mid;
+    }
+    return hi;
+}
+
+/**
+ * Estimates the largest eigenvalue of D^-1 A with HPCG_CHEBYSHEV_LANCZOS_STEPS
+ * Jacobi-PCG steps from a random right-hand side. The CG coefficients give
+ * the Lanczos tridiagonal matrix, whose largest eigenvalue approaches that
+ * of D^-1 A from below. p must have room for halo values.
+ */
+inline double
+EstimateChebyshevLambdaMax(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &z,
+    Array<floatType> &p,
+    Array<floatType> &Ap,
+    Context ctx,
+    Runtime *lrt
+) {
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    const bool inPreconditioner = true;
+    double tAllreduce = 0.0;
+    Future result;
+    //
+    FillRandomVector(r, ctx, lrt);
+    // z = D^-1 r.
+    ChebyshevUpdate(A, 0.0, 1.0, r, nullptr, z, nullptr, ctx, lrt);
+    CopyVector(z, p, ctx, lrt);
+    ComputeDotProduct(
+        nrow, r, z, result, tAllreduce, *A.dcAllRedSumFT, ctx, lrt
+    );
+    double rtz = result.get_result<floatType>(silenceWarnings);
+    //
+    std::vector<double> diag, offDiag;
+    double alphaPrev = 0.0, betaPrev = 0.0;
+    for (int k = 0; k < HPCG_CHEBYSHEV_LANCZOS_STEPS && rtz > 0.0; ++k) {
+        ComputeSPMV(A, p, Ap, ctx, lrt, inPreconditioner);
+        ComputeDotProduct(
+            nrow, p, Ap, result, tAllreduce, *A.dcAllRedSumFT, ctx, lrt
+        );
+        const double pAp = result.get_result<floatType>(silenceWarnings);
+        if (pAp <= 0.0) break;
+        const double alpha = rtz / pAp;
+        if (k > 0) {
+            diag.push_back(1.0 / alpha + betaPrev / alphaPrev);
+            offDiag.push_back(std::sqrt(betaPrev) / alphaPrev);
+        }
+        else {
+            diag.push_back(1.0 / alpha);
+        }
+        // r -= alpha Ap, z = D^-1 r.
+        ComputeWAXPBY(nrow, 1.0, r, -alpha, Ap, r, ctx, lrt);
+        ChebyshevUpdate(A, 0.0, 1.0, r, nullptr, z, nullptr, ctx, lrt);
+        ComputeDotProduct(
+            nrow, r, z, result, tAllreduce, *A.dcAllRedSumFT, ctx, lrt
+        );
+        const double rtzNext = result.get_result<floatType>(silenceWarnings);
+        betaPrev = rtzNext / rtz;
+        alphaPrev = alpha;
+        rtz = rtzNext;
+        // p = z + beta p.
+        ComputeWAXPBY(nrow, 1.0, z, betaPrev, p, p, ctx, lrt);
+    }
+    // D^-1 A of the HPCG operator never has eigenvalues above 2.
+    if (diag.empty()) return 2.0;
+    return TridiagonalMaxEigenvalue(diag, offDiag);
+}
+
+/**
+ * Sets chebyshevLambdaMax at every level that has a coarse level (the
+ * coarsest level is always smoothed with SYMGS). The estimate is enlarged by
+ * 10%, since Lanczos underestimates it and the smoother diverges on
+ * eigenvalues above the bound. The level's MG vectors (or the CG vectors on
+ * the fine level) are used as scratch space.
+ */
+inline void
+SetupChebyshevSmoother(
+    SparseMatrix &A,
+    CGData &data,
+    Context ctx,
+    Runtime *lrt
+) {
+    SparseMatrix *prev = nullptr;
+    for (SparseMatrix *L = &A; L->mgData; prev = L, L = L->Ac) {
+        Array<floatType> &r = prev ? *prev->mgData->rc : *data.r;
+        Array<floatType> &p = prev ? *prev->mgData->xc : *data.p;
+        const double lambdaMax = EstimateChebyshevLambdaMax(
+            *L, r, *L->mgData->chebyD, p, *L->mgData->Axf, ctx, lrt
+        );
+        L->chebyshevLambdaMax = 1.1 * lambdaMax;
+    }
+}
+
+/**
+ *
+ */
+inline void
+registerChebyshevTasks(void)
+{
+#ifdef LGNCG_TASKING
+    HighLevelRuntime::register_legion_task<ComputeChebyshevTask>(
+        CHEBYSHEV_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeChebyshevTask"
+    );
+#endif
+}
@@ -52,6 +52,12 @@
 #include "CollectiveOps.hpp"
 
 #include "mytimer.hpp"
+#include "SubBlocks.hpp"
+#include "VectorKernels.hpp"
+
+#ifdef LGNCG_USE_CUDA
+#include "GPUKernels.hpp"
+#endif
 
 #include <cassert>
 
@@ -65,8 +71,7 @@ struct ComputeDotProductArgs {
 /*!
     Routine to compute the dot product of two vectors where:
 
-    This is the reference dot-product implementation.  It _CANNOT_ be modified
-    for the purposes of this benchmark.
+    Vectorized, threaded and summed pairwise, see VectorDot.
 
     @param[in] n the number of vector elements (on this processor)
     @param[in] x, y the input vectors
@@ -89,8 +94,6 @@ ComputeDotProductKernel(
     assert(x.length() >= size_t(args.n));
     assert(y.length() >= size_t(args.n));
     //
-    floatType local_result = 0.0;
-    //
     const floatType *const xv = x.data();
     assert(xv);
     //
@@ -98,9 +101,8 @@ ComputeDotProductKernel(
     assert(yv);
     //
     const local_int_t n = args.n;
-    for (local_int_t i = 0; i < n; i++) local_result += xv[i] * yv[i];
-    //
-    result = local_result;
+    LGNCG_PROFILE(DDOT_TID, 2 * n * sizeof(floatType));
+    result = VectorDot(n, xv, yv);
     //
     return 0;
 }
@@ -127,9 +129,163 @@ ComputeDotProduct(
     //
     int rc = 0;
 #ifdef LGNCG_TASKING
+    const int nBlocks = NumberOfSubBlocks(n);
+    if (nBlocks > 1) {
+        IndexLauncher il(
+            DDOT_BLOCK_TID,
+            SubBlockLaunchDomain(nBlocks),
+            TaskArgument(&args, sizeof(args)),
+            ArgumentMap()
+        );
+        //
+        SubBlockIntent(x, READ_ONLY, n, nBlocks, 1, il, ctx, lrt);
+        if (&x != &y) {
+            SubBlockIntent(y, READ_ONLY, n, nBlocks, 1, il, ctx, lrt);
+        }
+        //
+        localFuture = lrt->execute_index_space(ctx, il, FLOAT_REDUCE_SUM_TID);
+    }
+    else {
+        TaskLauncher tl(
+            DDOT_TID,
+            TaskArgument(&args, sizeof(args))
+        );
+        //
+        x.intent(RO_E, tl, ctx, lrt);
+        y.intent(RO_E, tl, ctx, lrt);
+        //
+        localFuture = lrt->execute_task(ctx, tl);
+    }
+#else
+    floatType localResult = 0.0;
+    rc = ComputeDotProductKernel(x, y, args, localResult);
+    localFuture = Future::from_value(lrt, localResult);
+#endif
+    double t0 = mytimer(); // FIXME
+    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
+    timeAllreduce += mytimer() - t0;
+    //
+    return rc;
+}
+
+/**
+ *
+ */
+floatType
+ComputeDotProductTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeDotProductArgs *)task->args;
+    //
+    Array<floatType> x(regions[0], ctx, lrt);
+    Array<floatType> y(regions[1], ctx, lrt);
+    //
+    floatType localResult = 0.0;
+    ComputeDotProductKernel(x, y, *args, localResult);
+    //
+    return localResult;
+}
+
+/**
+ * Point task of a sub-block DDOT: x and y are the point's blocks (the same
+ * region if x and y alias).
+ */
+floatType
+ComputeDotProductBlockTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    Array<floatType> x(regions[0], ctx, lrt);
+    Array<floatType> y(regions[regions.size() - 1], ctx, lrt);
+    //
+    const ComputeDotProductArgs args = {
+        .n = local_int_t(x.length())
+    };
+    floatType localResult = 0.0;
+    ComputeDotProductKernel(x, y, args, localResult);
+    //
+    return localResult;
+}
+
+#ifdef LGNCG_USE_CUDA
+/**
+ * TOC_PROC variant of ComputeDotProductTask.
+ */
+floatType
+ComputeDotProductTaskGPU(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeDotProductArgs *)task->args;
+    //
+    Array<floatType> x(regions[0], ctx, lrt);
+    Array<floatType> y(regions[1], ctx, lrt);
     //
+    return GPUComputeDot(x.data(), y.data(), args->n);
+}
+#endif
+
+/**
+ * Computes the local part of x'y exactly (see ReproSum.hpp).
+ */
+inline int
+ComputeDotProductReproKernel(
+    Array<floatType> &x,
+    Array<floatType> &y,
+    const ComputeDotProductArgs &args,
+    ReproSumValue &result
+) {
+    assert(x.length() >= size_t(args.n));
+    assert(y.length() >= size_t(args.n));
+    //
+    const floatType *const xv = x.data();
+    assert(xv);
+    //
+    const floatType *const yv = y.data();
+    assert(yv);
+    //
+    const local_int_t n = args.n;
+    LGNCG_PROFILE(DDOT_REPRO_TID, 2 * n * sizeof(floatType));
+    ReproSumClear(result);
+    VectorDotRepro(n, xv, yv, result);
+    //
+    return 0;
+}
+
+/**
+ * Reproducible ComputeDotProduct: the local contributions are exact and are
+ * combined with the REPRO_REDUCE_SUM_TID collective, so resultFuture (a
+ * floatType, like the other overload's) doesn't depend on the shard count or
+ * the order in which contributions arrive. Always a single CPU task.
+ */
+inline int
+ComputeDotProduct(
+    local_int_t n,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<ReproSumValue> > &dcReproSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeDotProductArgs args = {
+        .n = n
+    };
+    //
+    Future localFuture;
+    //
+    int rc = 0;
+#ifdef LGNCG_TASKING
     TaskLauncher tl(
-        DDOT_TID,
+        DDOT_REPRO_TID,
         TaskArgument(&args, sizeof(args))
     );
     //
@@ -138,22 +294,24 @@ ComputeDotProduct(
     //
     localFuture = lrt->execute_task(ctx, tl);
 #else
-    floatType localResult = 0.0;
-    rc = ComputeDotProductKernel(x, y, args, localResult);
+    ReproSumValue localResult;
+    rc = ComputeDotProductReproKernel(x, y, args, localResult);
     localFuture = Future::from_value(lrt, localResult);
 #endif
-    double t0 = mytimer(); // FIXME
-    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
+    double t0 = mytimer();
+    Future sumFuture = allReduce(localFuture, dcReproSum, ctx, lrt);
     timeAllreduce += mytimer() - t0;
     //
+    resultFuture = reproSumToFloat(sumFuture, ctx, lrt);
+    //
     return rc;
 }
 
 /**
  *
  */
-floatType
-ComputeDotProductTask(
+ReproSumValue
+ComputeDotProductReproTask(
     const Task *task,
     const std::vector<PhysicalRegion> &regions,
     Context ctx,
@@ -164,8 +322,120 @@ ComputeDotProductTask(
     Array<floatType> x(regions[0], ctx, lrt);
     Array<floatType> y(regions[1], ctx, lrt);
     //
-    floatType localResult = 0.0;
-    ComputeDotProductKernel(x, y, *args, localResult);
+    ReproSumValue localResult;
+    ComputeDotProductReproKernel(x, y, *args, localResult);
+    //
+    return localResult;
+}
+
+/**
+ * Computes the three dot products needed by pipelined CG in a single sweep
+ * over the vectors: result = [r' * u, w' * u, r' * r].
+ */
+inline int
+ComputeFusedDotProductsKernel(
+    Array<floatType> &r,
+    Array<floatType> &u,
+    Array<floatType> &w,
+    const ComputeDotProductArgs &args,
+    FusedReduceValues &result
+) {
+    assert(r.length() >= size_t(args.n));
+    assert(u.length() >= size_t(args.n));
+    assert(w.length() >= size_t(args.n));
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    //
+    const floatType *const uv = u.data();
+    assert(uv);
+    //
+    const floatType *const wv = w.data();
+    assert(wv);
+    //
+    floatType rtu = 0.0, wtu = 0.0, rtr = 0.0;
+    //
+    const local_int_t n = args.n;
+    LGNCG_PROFILE(DDOT_FUSED_TID, 3 * n * sizeof(floatType));
+    for (local_int_t i = 0; i < n; i++) {
+        rtu += rv[i] * uv[i];
+        wtu += wv[i] * uv[i];
+        rtr += rv[i] * rv[i];
+    }
+    //
+    result.v[0] = rtu;
+    result.v[1] = wtu;
+    result.v[2] = rtr;
+    //
+    return 0;
+}
+
+/**
+ * Starts a single (non-blocking) collective that reduces [r' * u, w' * u,
+ * r' * r]. The caller is free to launch more work before waiting on
+ * resultFuture.
+ */
+inline int
+ComputeFusedDotProducts(
+    local_int_t n,
+    Array<floatType> &r,
+    Array<floatType> &u,
+    Array<floatType> &w,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<FusedReduceValues> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeDotProductArgs args = {
+        .n = n
+    };
+    //
+    Future localFuture;
+    //
+    int rc = 0;
+#ifdef LGNCG_TASKING
+    //
+    TaskLauncher tl(
+        DDOT_FUSED_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    r.intent(RO_E, tl, ctx, lrt);
+    u.intent(RO_E, tl, ctx, lrt);
+    w.intent(RO_E, tl, ctx, lrt);
+    //
+    localFuture = lrt->execute_task(ctx, tl);
+#else
+    FusedReduceValues localResult;
+    rc = ComputeFusedDotProductsKernel(r, u, w, args, localResult);
+    localFuture = Future::from_value(lrt, localResult);
+#endif
+    double t0 = mytimer();
+    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
+    timeAllreduce += mytimer() - t0;
+    //
+    return rc;
+}
+
+/**
+ *
+ */
+FusedReduceValues
+ComputeFusedDotProductsTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeDotProductArgs *)task->args;
+    //
+    Array<floatType> r(regions[0], ctx, lrt);
+    Array<floatType> u(regions[1], ctx, lrt);
+    Array<floatType> w(regions[2], ctx, lrt);
+    //
+    FusedReduceValues localResult;
+    ComputeFusedDotProductsKernel(r, u, w, *args, localResult);
     //
     return localResult;
 }
@@ -183,5 +453,49 @@ registerDDotTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeDotProductTask"
     );
+    HighLevelRuntime::register_legion_task<
+        floatType, ComputeDotProductBlockTask
+    >(
+        DDOT_BLOCK_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        false /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeDotProductBlockTask"
+    );
+#ifdef LGNCG_USE_CUDA
+    HighLevelRuntime::register_legion_task<floatType, ComputeDotProductTaskGPU>(
+        DDOT_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeDotProductTaskGPU"
+    );
+#endif
+    HighLevelRuntime::register_legion_task<
+        FusedReduceValues, ComputeFusedDotProductsTask
+    >(
+        DDOT_FUSED_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeFusedDotProductsTask"
+    );
+    HighLevelRuntime::register_legion_task<
+        ReproSumValue, ComputeDotProductReproTask
+    >(
+        DDOT_REPRO_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeDotProductReproTask"
+    );
 #endif
 }
@@ -53,10 +53,85 @@
 #include "LegionMatrices.hpp"
 #include "VectorOps.hpp"
 #include "ComputeSYMGS.hpp"
+#include "ComputeChebyshev.hpp"
 #include "ComputeRestriction.hpp"
 #include "ComputeProlongation.hpp"
 
 #include <iostream>
+#include <vector>
+
+/*!
+    Additive (BPX-style) multigrid: the residual is injected down to every
+    level first, then each level smooths its own residual from zero, and the
+    corrections are prolonged and summed from the coarsest level up. No level
+    waits on another level's smoother, so their tasks can run at the same
+    time. Injection and prolongation are transposes and the smoothers are
+    symmetric, so the preconditioner stays symmetric for CG. Levels with a
+    coarser grid take numberOfPresmootherSteps sweeps and the coarsest takes
+    numberOfCoarseSweeps.
+
+    @param[in] A the known system matrix.
+
+    @param[in] r the input vector.
+
+    @param[inout] x On exit contains the sum of the level corrections.
+
+    @return returns 0 upon success and non-zero otherwise.
+
+    @see ComputeMG
+*/
+inline int
+ComputeMGAdditive(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    // Matrix, right-hand side and correction of every level.
+    std::vector<SparseMatrix *> As = {&A};
+    std::vector<Array<floatType> *> rs = {&r}, xs = {&x};
+    while (As.back()->mgData) {
+        SparseMatrix &Al = *As.back();
+        ComputeInjection(Al, *rs.back(), ctx, lrt);
+        As.push_back(Al.Ac);
+        rs.push_back(Al.mgData->rc);
+        xs.push_back(Al.mgData->xc);
+    }
+    //
+    const bool chebyshev =
+        ShardKernelVariants().smoother == SMOOTHER_VARIANT_CHEBYSHEV;
+    int ierr = 0;
+    for (size_t l = 0; l < As.size(); ++l) {
+        SparseMatrix &Al = *As[l];
+        Array<floatType> &rl = *rs[l], &xl = *xs[l];
+        ZeroVector(xl, ctx, lrt);
+        if (Al.mgData) {
+            const int nPre = Al.mgData->numberOfPresmootherSteps;
+            for (int i = 0; i < nPre; ++i) {
+                if (chebyshev) {
+                    ierr += ComputeChebyshev(Al, rl, xl, i == 0, ctx, lrt);
+                }
+                else {
+                    ierr += ComputeSYMGS(Al, rl, xl, ctx, lrt);
+                }
+            }
+        }
+        else {
+            for (int i = 0; i < Al.numberOfCoarseSweeps; ++i) {
+                ierr += ComputeSYMGS(Al, rl, xl, ctx, lrt);
+            }
+        }
+        if (ierr != 0) return ierr;
+    }
+    // x_l += P x_(l+1), coarsest first.
+    for (size_t l = As.size() - 1; l-- > 0; ) {
+        ierr = ComputeProlongation(*As[l], *xs[l], ctx, lrt);
+        if (ierr != 0) return ierr;
+    }
+    //
+    return 0;
+}
 
 /*!
     @param[in] A the known system matrix.
@@ -78,6 +153,10 @@ ComputeMG(
     Context ctx,
     Runtime *lrt
 ) {
+    // The V-cycle only recurses into itself, so this is only taken at the top.
+    if (ShardKernelVariants().mgCycle == MG_CYCLE_ADDITIVE) {
+        return ComputeMGAdditive(A, r, x, ctx, lrt);
+    }
     const auto *const Asclrs = A.sclrs->data();
     assert(Asclrs);
     // Make sure x contain space for halo values.
@@ -89,16 +168,51 @@ ComputeMG(
     // Go to next coarse level if defined
     if (A.mgData != NULL) {
         const int nPre = A.mgData->numberOfPresmootherSteps;
+        const bool chebyshev =
+            ShardKernelVariants().smoother == SMOOTHER_VARIANT_CHEBYSHEV;
+        // Compute the restricted residual inside the last presmoother sweep.
+        const bool fuseResidual =
+            ShardKernelVariants().symgs == SYMGS_VARIANT_BLOCKED &&
+            !chebyshev && nPre > 0 && !A.isMgOptimized;
         for (int i = 0; i < nPre; ++i) {
-            ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+            if (chebyshev) {
+                const bool xIsZero = (i == 0);
+                ierr += ComputeChebyshev(A, r, x, xIsZero, ctx, lrt);
+            }
+            else if (fuseResidual && i == nPre - 1) {
+                ierr += ComputeSYMGSResidual(A, r, x, ctx, lrt);
+            }
+            else {
+                ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+            }
         }
         if (ierr != 0) return ierr;
         //
-        ierr = ComputeSPMV(A, x, *A.mgData->Axf, ctx, lrt);
-        if (ierr != 0) return ierr;
-        // Perform restriction operation using simple injection.
-        ierr = ComputeRestriction(A, r, ctx, lrt);
-        if (ierr != 0) return ierr;
+#ifdef LGNCG_USE_CUDA
+        // RESTRICTION_RESIDUAL has no GPU variant: keep the SpMV on the GPU.
+        const bool restrictedResidual = false;
+#else
+        // Only the injected rows of the residual are needed, so compute just
+        // those instead of all of Axf.
+        const bool restrictedResidual = true;
+#endif
+        if (fuseResidual) {
+            // ComputeSYMGSResidual already restricted the residual into rc.
+        }
+        else if (restrictedResidual) {
+            ierr = ComputeRestrictionResidual(A, x, r, ctx, lrt);
+            if (ierr != 0) return ierr;
+        }
+        else {
+            const bool inPreconditioner = true;
+            ierr = ComputeSPMV(
+                       A, x, *A.mgData->Axf, ctx, lrt, inPreconditioner
+                   );
+            if (ierr != 0) return ierr;
+            // Perform restriction operation using simple injection.
+            ierr = ComputeRestriction(A, r, ctx, lrt);
+            if (ierr != 0) return ierr;
+        }
         //
         ierr = ComputeMG(*A.Ac, *A.mgData->rc, *A.mgData->xc, ctx, lrt);
         if (ierr != 0) return ierr;
@@ -107,12 +221,21 @@ ComputeMG(
         if (ierr!=0) return ierr;
         const int nPost = A.mgData->numberOfPostsmootherSteps;
         for (int i = 0; i < nPost; ++i) {
-            ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+            if (chebyshev) {
+                ierr += ComputeChebyshev(A, r, x, false, ctx, lrt);
+            }
+            else {
+                ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+            }
         }
         if (ierr != 0) return ierr;
     }
     else {
-        ierr = ComputeSYMGS(A, r, x, ctx, lrt);
+        // Coarsest level: more sweeps give a better coarse solve for the cost
+        // of some extra halo exchanges.
+        for (int i = 0; i < A.numberOfCoarseSweeps; ++i) {
+            ierr += ComputeSYMGS(A, r, x, ctx, lrt);
+        }
         if (ierr != 0) return ierr;
     }
     //
@@ -0,0 +1,612 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file ComputeMultiRHS.hpp
+
+    SpMV, SYMGS and dot products over the nRhs columns of a CGMulti solve. The
+    kernels visit the rows in the same order as their single vector versions
+    and apply each row to every column before moving on, so the row's values
+    and column indices are read from memory once per sweep instead of once per
+    column. Each column gives the same result as the single vector kernel.
+
+    Only the CSR matrix and the sequential smoother have multi-column kernels.
+    With SELL-C-sigma, multicoloring or the matrix-free variants, the wrappers
+    call the single vector routines column by column.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "ExchangeHalo.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeSYMGS.hpp"
+#include "ComputeDotProduct.hpp"
+#include "StencilRows.hpp"
+#include "VectorKernels.hpp"
+
+#include <cassert>
+#include <deque>
+
+static_assert(
+    HPCG_MAX_RHS <= LGNCG_FUSED_REDUCE_LEN,
+    "CGMulti reduces one dot product per column in a FusedReduceValues"
+);
+
+/**
+ *
+ */
+struct ComputeMultiRHSArgs {
+    local_int_t localNumberOfColumns;
+    local_int_t localNumberOfRows;
+    int stencilSize;
+    // Matrix values are mgFloatType (SparseMatrix::matrixValuesMG).
+    bool mixedPrecision;
+    // Number of columns.
+    int nRhs;
+};
+
+/**
+ * y[j] = A x[j] for j in [0, nRhs).
+ */
+template <int STENCIL, typename MT>
+inline int
+ComputeSPMVMultiStencilKernel(
+    Array<MT>                 &matrixValues,
+    Array<local_int_t>        &mtxIndL,
+    Array<char>               &nonzerosInRow,
+    const floatType *const    *xv,
+    floatType *const          *yv,
+    const ComputeMultiRHSArgs &args
+) {
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nzpr = STENCIL > 0 ? STENCIL : args.stencilSize;
+    const int nRhs = args.nRhs;
+    //
+    Array2D<MT> AmatrixValues(nrow, nzpr, matrixValues.data());
+    //
+    Array2D<local_int_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
+    //
+    const char *const AnonzerosInRow = nonzerosInRow.data();
+    //
+    LGNCG_PROFILE(
+        SPMV_MULTI_TID,
+        nrow * (nzpr * (sizeof(MT) + sizeof(local_int_t))
+             + sizeof(char) + 2 * nRhs * sizeof(floatType))
+    );
+    //
+    for (local_int_t i = 0; i < nrow; i++) {
+        const MT *const vals = AmatrixValues(i);
+        const local_int_t *const inds = AmtxIndL(i);
+        const int nnz = AnonzerosInRow[i];
+        for (int j = 0; j < nRhs; j++) {
+            yv[j][i] = StencilRowDot<STENCIL>(vals, inds, nnz, xv[j]);
+        }
+    }
+    //
+    return 0;
+}
+
+/**
+ *
+ */
+template <typename MT>
+inline int
+ComputeSPMVMultiKernel(
+    Array<MT>                 &matrixValues,
+    Array<local_int_t>        &mtxIndL,
+    Array<char>               &nonzerosInRow,
+    const floatType *const    *xv,
+    floatType *const          *yv,
+    const ComputeMultiRHSArgs &args
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSPMVMultiStencilKernel<HPCG_STENCIL>(
+                   matrixValues, mtxIndL, nonzerosInRow, xv, yv, args
+               );
+    }
+    return ComputeSPMVMultiStencilKernel<0>(
+               matrixValues, mtxIndL, nonzerosInRow, xv, yv, args
+           );
+}
+
+/**
+ * One symmetric Gauss-Seidel step on x[j] with right-hand side r[j] for j in
+ * [0, nRhs) (see ComputeSYMGSStencilKernel).
+ */
+template <int STENCIL, typename MT>
+inline int
+ComputeSYMGSMultiStencilKernel(
+    Array<MT>                 &AmatrixValues,
+    Array<local_int_t>        &AmtxIndL,
+    const Array<char>         &AnonzerosInRow,
+    const Array<floatType>    &AmatrixDiagonal,
+    const floatType *const    *rv,
+    floatType *const          *xv,
+    const ComputeMultiRHSArgs &args
+) {
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nnpr = STENCIL > 0 ? STENCIL : args.stencilSize;
+    const int nRhs = args.nRhs;
+    //
+    const floatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    // Interpreted as 2D array
+    Array2D<MT> matrixValues(
+        nrow, nnpr, AmatrixValues.data()
+    );
+    // Interpreted as 2D array
+    Array2D<local_int_t> mtxIndL(
+        nrow, nnpr, AmtxIndL.data()
+    );
+    const char *const nonzerosInRow = AnonzerosInRow.data();
+    //
+    LGNCG_PROFILE(
+        SYMGS_MULTI_TID,
+        2 * nrow * (nnpr * (sizeof(MT) + sizeof(local_int_t))
+                 + sizeof(char) + sizeof(floatType)
+                 + 2 * nRhs * sizeof(floatType))
+    );
+    //
+    for (local_int_t i = 0; i < nrow; i++) {
+        for (int j = 0; j < nRhs; j++) {
+            StencilRowRelax<STENCIL>(
+                matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+                matrixDiagonal[i], rv[j][i], xv[j], i
+            );
+        }
+    }
+    // Now the back sweep.
+    for (local_int_t i = nrow - 1; i >= 0; i--) {
+        for (int j = 0; j < nRhs; j++) {
+            StencilRowRelax<STENCIL>(
+                matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+                matrixDiagonal[i], rv[j][i], xv[j], i
+            );
+        }
+    }
+    //
+    return 0;
+}
+
+/**
+ *
+ */
+template <typename MT>
+inline int
+ComputeSYMGSMultiKernel(
+    Array<MT>                 &AmatrixValues,
+    Array<local_int_t>        &AmtxIndL,
+    const Array<char>         &AnonzerosInRow,
+    const Array<floatType>    &AmatrixDiagonal,
+    const floatType *const    *rv,
+    floatType *const          *xv,
+    const ComputeMultiRHSArgs &args
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSYMGSMultiStencilKernel<HPCG_STENCIL>(
+                   AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+                   rv, xv, args
+               );
+    }
+    return ComputeSYMGSMultiStencilKernel<0>(
+               AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+               rv, xv, args
+           );
+}
+
+/**
+ * result.v[j] = x[j]' * y[j] over the first n rows.
+ */
+inline int
+ComputeDotProductsMultiKernel(
+    local_int_t n,
+    const floatType *const *xv,
+    const floatType *const *yv,
+    int nRhs,
+    FusedReduceValues &result
+) {
+    LGNCG_PROFILE(DDOT_MULTI_TID, 2 * nRhs * n * sizeof(floatType));
+    for (int j = 0; j < LGNCG_FUSED_REDUCE_LEN; j++) {
+        result.v[j] = j < nRhs ? VectorDot(n, xv[j], yv[j]) : 0.0;
+    }
+    return 0;
+}
+
+/**
+ * Returns the data pointers of the first n arrays of a.
+ */
+template <typename ARRAY>
+inline void
+ColumnPointers(
+    ARRAY *const *a,
+    int n,
+    floatType **out
+) {
+    for (int j = 0; j < n; j++) {
+        out[j] = a[j]->data();
+        assert(out[j]);
+    }
+}
+
+/**
+ * y[j] = A x[j] for the nRhs columns. inPreconditioner selects the
+ * mgFloatType matrix values, as in ComputeSPMV.
+ */
+inline int
+ComputeSPMVMulti(
+    SparseMatrix &A,
+    Array<floatType> *const *x,
+    Array<floatType> *const *y,
+    int nRhs,
+    Context ctx,
+    Runtime *lrt,
+    bool inPreconditioner = false
+) {
+    // No multi-column kernels for these, so go one column at a time.
+    if (A.isSpmvOptimized ||
+        ShardKernelVariants().spmv == SPMV_VARIANT_MATRIX_FREE) {
+        int ierr = 0;
+        for (int j = 0; j < nRhs; j++) {
+            ierr += ComputeSPMV(A, *x[j], *y[j], ctx, lrt, inPreconditioner);
+        }
+        return ierr;
+    }
+    //
+    for (int j = 0; j < nRhs; j++) {
+        if (x[j]->hasGhosts()) ExchangeHalo(A, *x[j], ctx, lrt);
+    }
+    const bool mp = inPreconditioner && A.matrixValuesMG;
+    const ComputeMultiRHSArgs args = {
+        .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
+        .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
+        .stencilSize          = A.geom->data()->stencilSize,
+        .mixedPrecision       = mp,
+        .nRhs                 = nRhs
+    };
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        SPMV_MULTI_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    if (mp) A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    else    A.matrixValues->intent(RO_E, tl, ctx, lrt);
+    A.mtxIndL->intent(RO_E, tl, ctx, lrt);
+    A.nonzerosInRow->intent(RO_E, tl, ctx, lrt);
+    //
+    for (int j = 0; j < nRhs; j++) x[j]->intent(RO_E, tl, ctx, lrt);
+    for (int j = 0; j < nRhs; j++) y[j]->intent(WO_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    //
+    return 0;
+#else
+    floatType *xv[HPCG_MAX_RHS], *yv[HPCG_MAX_RHS];
+    ColumnPointers(x, nRhs, xv);
+    ColumnPointers(y, nRhs, yv);
+    if (mp) {
+        return ComputeSPMVMultiKernel(
+                   *A.matrixValuesMG, *A.mtxIndL, *A.nonzerosInRow,
+                   xv, yv, args
+               );
+    }
+    return ComputeSPMVMultiKernel(
+               *A.matrixValues, *A.mtxIndL, *A.nonzerosInRow, xv, yv, args
+           );
+#endif
+}
+
+/**
+ * One symmetric Gauss-Seidel step on each of the nRhs columns of x, with the
+ * matching column of r as its right-hand side.
+ */
+inline int
+ComputeSYMGSMulti(
+    SparseMatrix &A,
+    Array<floatType> *const *r,
+    Array<floatType> *const *x,
+    int nRhs,
+    Context ctx,
+    Runtime *lrt
+) {
+    // No multi-column kernels for these, so go one column at a time.
+    if (A.isMgOptimized ||
+        ShardKernelVariants().symgs == SYMGS_VARIANT_MATRIX_FREE) {
+        int ierr = 0;
+        for (int j = 0; j < nRhs; j++) {
+            ierr += ComputeSYMGS(A, *r[j], *x[j], ctx, lrt);
+        }
+        return ierr;
+    }
+    //
+    for (int j = 0; j < nRhs; j++) {
+        assert(x[j]->length() == size_t(A.sclrs->data()->localNumberOfColumns));
+        ExchangeHalo(A, *x[j], ctx, lrt);
+    }
+    const bool mp = (A.matrixValuesMG != nullptr);
+    const ComputeMultiRHSArgs args = {
+        .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
+        .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
+        .stencilSize          = A.geom->data()->stencilSize,
+        .mixedPrecision       = mp,
+        .nRhs                 = nRhs
+    };
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        SYMGS_MULTI_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    if (mp) A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    else    A.matrixValues->intent  (RO_E, tl, ctx, lrt);
+    A.mtxIndL->intent       (RO_E, tl, ctx, lrt);
+    A.nonzerosInRow->intent (RO_E, tl, ctx, lrt);
+    A.matrixDiagonal->intent(RO_E, tl, ctx, lrt);
+    //
+    for (int j = 0; j < nRhs; j++) r[j]->intent(RO_E, tl, ctx, lrt);
+    for (int j = 0; j < nRhs; j++) x[j]->intent(RW_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    //
+    return 0;
+#else
+    floatType *rv[HPCG_MAX_RHS], *xv[HPCG_MAX_RHS];
+    ColumnPointers(r, nRhs, rv);
+    ColumnPointers(x, nRhs, xv);
+    if (mp) {
+        return ComputeSYMGSMultiKernel(
+                   *A.matrixValuesMG, *A.mtxIndL, *A.nonzerosInRow,
+                   *A.matrixDiagonal, rv, xv, args
+               );
+    }
+    return ComputeSYMGSMultiKernel(
+               *A.matrixValues, *A.mtxIndL, *A.nonzerosInRow,
+               *A.matrixDiagonal, rv, xv, args
+           );
+#endif
+}
+
+/**
+ * Starts one collective that reduces x[j]' * y[j] for all nRhs columns
+ * (result v[j], see FusedReduceValues).
+ */
+inline int
+ComputeDotProductsMulti(
+    local_int_t n,
+    Array<floatType> *const *x,
+    Array<floatType> *const *y,
+    int nRhs,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<FusedReduceValues> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeMultiRHSArgs args = {
+        .localNumberOfColumns = n,
+        .localNumberOfRows    = n,
+        .stencilSize          = 0,
+        .mixedPrecision       = false,
+        .nRhs                 = nRhs
+    };
+    //
+    Future localFuture;
+    //
+    int rc = 0;
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        DDOT_MULTI_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    for (int j = 0; j < nRhs; j++) x[j]->intent(RO_E, tl, ctx, lrt);
+    for (int j = 0; j < nRhs; j++) y[j]->intent(RO_E, tl, ctx, lrt);
+    //
+    localFuture = lrt->execute_task(ctx, tl);
+#else
+    floatType *xv[HPCG_MAX_RHS], *yv[HPCG_MAX_RHS];
+    ColumnPointers(x, nRhs, xv);
+    ColumnPointers(y, nRhs, yv);
+    FusedReduceValues localResult;
+    rc = ComputeDotProductsMultiKernel(n, xv, yv, nRhs, localResult);
+    localFuture = Future::from_value(lrt, localResult);
+#endif
+    double t0 = mytimer();
+    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
+    timeAllreduce += mytimer() - t0;
+    //
+    return rc;
+}
+
+/**
+ * Unpacks nRhs floatType columns starting at regions[rid] and stores their
+ * data pointers in out.
+ */
+inline void
+UnpackColumns(
+    const std::vector<PhysicalRegion> &regions,
+    int &rid,
+    int nRhs,
+    std::deque< Array<floatType> > &columns,
+    floatType **out,
+    Context ctx,
+    Runtime *lrt
+) {
+    for (int j = 0; j < nRhs; j++) {
+        columns.emplace_back(regions[rid++], ctx, lrt);
+        out[j] = columns.back().data();
+        assert(out[j]);
+    }
+}
+
+/**
+ *
+ */
+void
+ComputeSPMVMultiTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeMultiRHSArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow (regions[rid++], ctx, lrt);
+    //
+    std::deque< Array<floatType> > columns;
+    floatType *xv[HPCG_MAX_RHS], *yv[HPCG_MAX_RHS];
+    UnpackColumns(regions, rid, args->nRhs, columns, xv, ctx, lrt);
+    UnpackColumns(regions, rid, args->nRhs, columns, yv, ctx, lrt);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVMultiKernel(
+            matrixValues, mtxIndL, nonzerosInRow, xv, yv, *args
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVMultiKernel(
+            matrixValues, mtxIndL, nonzerosInRow, xv, yv, *args
+        );
+    }
+}
+
+/**
+ *
+ */
+void
+ComputeSYMGSMultiTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeMultiRHSArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL     (regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow      (regions[rid++], ctx, lrt);
+    Array<floatType> matrixDiagonal(regions[rid++], ctx, lrt);
+    //
+    std::deque< Array<floatType> > columns;
+    floatType *rv[HPCG_MAX_RHS], *xv[HPCG_MAX_RHS];
+    UnpackColumns(regions, rid, args->nRhs, columns, rv, ctx, lrt);
+    UnpackColumns(regions, rid, args->nRhs, columns, xv, ctx, lrt);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSMultiKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+            rv, xv, *args
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSMultiKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+            rv, xv, *args
+        );
+    }
+}
+
+/**
+ *
+ */
+FusedReduceValues
+ComputeDotProductsMultiTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeMultiRHSArgs *)task->args;
+    //
+    int rid = 0;
+    std::deque< Array<floatType> > columns;
+    floatType *xv[HPCG_MAX_RHS], *yv[HPCG_MAX_RHS];
+    UnpackColumns(regions, rid, args->nRhs, columns, xv, ctx, lrt);
+    UnpackColumns(regions, rid, args->nRhs, columns, yv, ctx, lrt);
+    //
+    FusedReduceValues localResult;
+    ComputeDotProductsMultiKernel(
+        args->localNumberOfRows, xv, yv, args->nRhs, localResult
+    );
+    //
+    return localResult;
+}
+
+/**
+ *
+ */
+inline void
+registerMultiRHSTasks(void)
+{
+#ifdef LGNCG_TASKING
+    HighLevelRuntime::register_legion_task<ComputeSPMVMultiTask>(
+        SPMV_MULTI_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVMultiTask"
+    );
+    HighLevelRuntime::register_legion_task<ComputeSYMGSMultiTask>(
+        SYMGS_MULTI_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSMultiTask"
+    );
+    HighLevelRuntime::register_legion_task<
+        FusedReduceValues, ComputeDotProductsMultiTask
+    >(
+        DDOT_MULTI_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeDotProductsMultiTask"
+    );
+#endif
+}
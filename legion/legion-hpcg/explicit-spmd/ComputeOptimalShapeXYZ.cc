@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 
@@ -112,3 +113,72 @@ ComputeOptimalShapeXYZ(int xyz, int & x, int & y, int & z) {
     }
   }
 }
+
+// Grid points on the faces cut by a (cx, cy, cz) split of an (x, y, z) grid of
+// nx*ny*nz blocks.
+static double
+cut_area(int x, int y, int z, int cx, int cy, int cz, int nx, int ny, int nz) {
+  return (cx - 1) * double(y) * z * ny * nz
+       + (cy - 1) * double(x) * z * nx * nz
+       + (cz - 1) * double(x) * y * nx * ny;
+}
+
+/*!
+  Factors xyz shards into an x*y*z grid and groups them into bricks of
+  bx*by*bz = per_node shards, one brick per node. The grid and brick are chosen
+  to first minimize the halo surface between nodes and then the total halo
+  surface, both measured in grid points of the nx*ny*nz local blocks. Grids
+  that fail the 0.125 process grid aspect ratio check are only used if no
+  other grid exists. If per_node shards can't form a brick of any grid, each
+  shard is its own brick (bx = by = bz = 1).
+*/
+void
+ComputeTopologyAwareShapeXYZ(int xyz, int nx, int ny, int nz, int per_node,
+                             int & x, int & y, int & z,
+                             int & bx, int & by, int & bz) {
+  if (per_node < 1 || xyz % per_node != 0) per_node = 1;
+
+  bool found = false, found_valid = false;
+  double min_off_node = 0.0, min_total = 0.0;
+
+  for (int tx = 1; tx <= xyz; ++tx) {
+    if (xyz % tx) continue;
+    for (int ty = 1; ty <= xyz / tx; ++ty) {
+      if ((xyz / tx) % ty) continue;
+      int tz = xyz / tx / ty;
+
+      double ratio = std::min(std::min(tx, ty), tz) / double(std::max(std::max(tx, ty), tz));
+      bool valid = ratio >= 0.125;
+      if (found_valid && ! valid) continue;
+
+      double total = cut_area(tx, ty, tz, tx, ty, tz, nx, ny, nz);
+
+      for (int tbx = 1; tbx <= tx; ++tbx) {
+        if (tx % tbx || per_node % tbx) continue;
+        for (int tby = 1; tby <= ty; ++tby) {
+          if (ty % tby || (per_node / tbx) % tby) continue;
+          int tbz = per_node / tbx / tby;
+          if (tz % tbz) continue;
+
+          double off_node = cut_area(tx, ty, tz, tx / tbx, ty / tby, tz / tbz, nx, ny, nz);
+          // The first valid grid replaces any invalid one found before it.
+          bool better = ! found || (valid && ! found_valid) ||
+                        off_node < min_off_node ||
+                        (off_node == min_off_node && total < min_total);
+          if (better) {
+            found = true;
+            found_valid = found_valid || valid;
+            min_off_node = off_node;
+            min_total = total;
+            x = tx; y = ty; z = tz;
+            bx = tbx; by = tby; bz = tbz;
+          }
+        }
+      }
+    }
+  }
+  // No grid can hold per_node shards per brick.
+  if (! found) {
+    ComputeTopologyAwareShapeXYZ(xyz, nx, ny, nz, 1, x, y, z, bx, by, bz);
+  }
+}
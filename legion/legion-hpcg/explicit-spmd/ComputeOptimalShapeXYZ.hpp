@@ -1,2 +1,6 @@
 
 void ComputeOptimalShapeXYZ(int xyz, int & x, int & y, int & z);
+
+void ComputeTopologyAwareShapeXYZ(int xyz, int nx, int ny, int nz, int per_node,
+                                  int & x, int & y, int & z,
+                                  int & bx, int & by, int & bz);
@@ -51,6 +51,7 @@
 #include "LegionStuff.hpp"
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
+#include "VectorKernels.hpp"
 
 /**
  *
@@ -91,19 +92,23 @@ ComputeProlongationKernel(
     //
     const local_int_t nc = args.nc;
 
-    for (local_int_t i = 0; i < nc; ++i) {
-        xfv[f2c[i]] += xcv[i];
-    }
+    LGNCG_PROFILE(
+        PROLONGATION_TID, nc * (3 * sizeof(floatType) + sizeof(local_int_t))
+    );
+
+    ProlongRows(nc, xcv, f2c, xfv);
     //
     return 0;
 }
 
 /**
- *
+ * Prolongation with an explicit coarse correction vector (the MG vectors of
+ * one right-hand side in CGMulti).
  */
 inline int
 ComputeProlongation(
     SparseMatrix &Af,
+    Array<floatType> &xc,
     Array<floatType> &xf,
     Context ctx,
     Runtime *lrt
@@ -118,7 +123,7 @@ ComputeProlongation(
         TaskArgument(&args, sizeof(args))
     );
     //
-    Af.mgData->xc->intent         (RO_E, tl, ctx, lrt);
+    xc.intent                     (RO_E, tl, ctx, lrt);
     Af.mgData->f2cOperator->intent(RO_E, tl, ctx, lrt);
     //
     xf.intent(WO_E, tl, ctx, lrt);
@@ -127,7 +132,7 @@ ComputeProlongation(
     return 0;
 #else
     return ComputeProlongationKernel(
-               *Af.mgData->xc,
+               xc,
                *Af.mgData->f2cOperator,
                xf,
                args
@@ -135,6 +140,19 @@ ComputeProlongation(
 #endif
 }
 
+/**
+ *
+ */
+inline int
+ComputeProlongation(
+    SparseMatrix &Af,
+    Array<floatType> &xf,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeProlongation(Af, *Af.mgData->xc, xf, ctx, lrt);
+}
+
 /**
  *
  */
@@ -85,6 +85,8 @@ ComputeResidualKernel(
     const floatType *const v2v = v2.data();
     floatType local_residual = 0.0;
 
+    LGNCG_PROFILE(COMPUTE_RESIDUAL_TID, 2 * args.n * sizeof(floatType));
+
     for (local_int_t i = 0; i < args.n; i++) {
         floatType diff = std::fabs(v1v[i] - v2v[i]);
         if (diff > local_residual) local_residual = diff;
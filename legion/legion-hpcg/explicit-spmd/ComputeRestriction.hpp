@@ -51,6 +51,8 @@
 #include "LegionStuff.hpp"
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
+#include "VectorKernels.hpp"
+#include "ComputeSPMV.hpp"
 
 /*!
     Routine to compute the coarse residual vector.
@@ -82,16 +84,23 @@ ComputeRestrictionKernel(
     const floatType *const rfv = rf.data();
 
     const local_int_t nc = rc.length();
-    for (local_int_t i = 0; i < nc; ++i) {
-        rcv[i] = rfv[f2c[i]] - Axfv[f2c[i]];
-    }
+    LGNCG_PROFILE(
+        RESTRICTION_TID, nc * (3 * sizeof(floatType) + sizeof(local_int_t))
+    );
+    RestrictRows(nc, rfv, Axfv, f2c, rcv);
     //
     return 0;
 }
 
+/**
+ * Restriction with explicit fine residual product and coarse residual vectors
+ * (the MG vectors of one right-hand side in CGMulti).
+ */
 inline int
 ComputeRestriction(
     SparseMatrix &A,
+    Array<floatType> &Axf,
+    Array<floatType> &rc,
     Array<floatType> &rf,
     Context ctx,
     Runtime *lrt
@@ -103,9 +112,9 @@ ComputeRestriction(
         TaskArgument(NULL, 0)
     );
     //
-    A.mgData->Axf->intent        (RO_E, tl, ctx, lrt);
+    Axf.intent                   (RO_E, tl, ctx, lrt);
     A.mgData->f2cOperator->intent(RO_E, tl, ctx, lrt);
-    A.mgData->rc->intent         (WO_E, tl, ctx, lrt);
+    rc.intent                    (WO_E, tl, ctx, lrt);
     //
     rf.intent(RO_E, tl, ctx, lrt);
     //
@@ -113,14 +122,245 @@ ComputeRestriction(
     return 0;
 #else
     return ComputeRestrictionKernel(
-               *A.mgData->Axf,
+               Axf,
                *A.mgData->f2cOperator,
-               *A.mgData->rc,
+               rc,
                rf
            );
 #endif
 }
 
+inline int
+ComputeRestriction(
+    SparseMatrix &A,
+    Array<floatType> &rf,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeRestriction(
+               A, *A.mgData->Axf, *A.mgData->rc, rf, ctx, lrt
+           );
+}
+
+/*!
+    Injects the fine grid vector rf into mgData->rc, without subtracting a
+    residual product (the additive MG cycle restricts r itself, see
+    ComputeMGAdditive).
+
+    @return Returns zero on success and a non-zero value otherwise.
+*/
+inline int
+ComputeInjectionKernel(
+    Array<local_int_t> &Af2c,
+    Array<floatType>   &rc,
+    Array<floatType>   &rf
+) {
+    const local_int_t nc = rc.length();
+    LGNCG_PROFILE(
+        INJECTION_TID, nc * (2 * sizeof(floatType) + sizeof(local_int_t))
+    );
+    InjectRows(nc, rf.data(), Af2c.data(), rc.data());
+    //
+    return 0;
+}
+
+/**
+ *
+ */
+inline int
+ComputeInjection(
+    SparseMatrix &A,
+    Array<floatType> &rf,
+    Context ctx,
+    Runtime *lrt
+) {
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        INJECTION_TID,
+        TaskArgument(NULL, 0)
+    );
+    //
+    A.mgData->f2cOperator->intent(RO_E, tl, ctx, lrt);
+    A.mgData->rc->intent         (WO_E, tl, ctx, lrt);
+    rf.intent                    (RO_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    return 0;
+#else
+    return ComputeInjectionKernel(
+               *A.mgData->f2cOperator, *A.mgData->rc, rf
+           );
+#endif
+}
+
+/**
+ *
+ */
+struct ComputeRestrictionResidualArgs {
+    ComputeSPMVArgs spmvArgs;
+    // Only compute the rows with ghost columns (ComputeSYMGSResidual computed
+    // the others).
+    bool boundaryOnly;
+};
+
+/*!
+    Routine to compute the coarse residual vector straight from the fine grid
+    matrix: rc[i] = rf[f2c[i]] - (Ax)[f2c[i]], computing only the rows of Ax
+    that are injected, so mgData->Axf is not used.
+
+    @param[in]  x the fine grid approximation, with its halo exchanged.
+    @param[out] rc the coarse residual vector.
+    @param[in]  rf the fine grid RHS.
+
+    @return Returns zero on success and a non-zero value otherwise.
+
+    @see ComputeRestrictionResidual
+*/
+template <int STENCIL, typename MT>
+inline int
+ComputeRestrictionResidualStencilKernel(
+    Array<MT>                            &matrixValues,
+    Array<local_int_t>                   &mtxIndL,
+    Array<char>                          &nonzerosInRow,
+    Array<local_int_t>                   &Af2c,
+    Array<floatType>                     &x,
+    Array<floatType>                     &rc,
+    Array<floatType>                     &rf,
+    const ComputeRestrictionResidualArgs &rargs
+) {
+    const ComputeSPMVArgs &args = rargs.spmvArgs;
+    // Test vector lengths
+    assert(x.length() >= size_t(args.localNumberOfColumns));
+    //
+    const floatType *const xv    = x.data();
+    const local_int_t *const f2c = Af2c.data();
+    floatType *const rcv         = rc.data();
+    const floatType *const rfv   = rf.data();
+    // Number of rows.
+    const local_int_t nrow       = args.localNumberOfRows;
+    // Number of non-zeros per row.
+    const local_int_t nzpr       = STENCIL > 0 ? STENCIL : args.stencilSize;
+    //
+    Array2D<MT> AmatrixValues(nrow, nzpr, matrixValues.data());
+    //
+    Array2D<local_int_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
+    //
+    const char *const AnonzerosInRow = nonzerosInRow.data();
+    //
+    const local_int_t nc = rc.length();
+    LGNCG_PROFILE(
+        RESTRICTION_RESIDUAL_TID,
+        nc * (nzpr * (sizeof(MT) + sizeof(local_int_t))
+            + sizeof(char) + sizeof(local_int_t) + 3 * sizeof(floatType))
+    );
+    // Each coarse row reads its own fine row, so the rows are independent.
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(nc >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < nc; ++i) {
+        const local_int_t fi = f2c[i];
+        const local_int_t *const inds = AmtxIndL(fi);
+        if (rargs.boundaryOnly &&
+            !StencilRowHasGhosts(inds, AnonzerosInRow[fi], nrow)) continue;
+        const floatType Axfi = StencilRowDot<STENCIL>(
+                                   AmatrixValues(fi), inds,
+                                   AnonzerosInRow[fi], xv
+                               );
+        rcv[i] = rfv[fi] - Axfi;
+    }
+    //
+    return 0;
+}
+
+/**
+ * Dispatches to the ComputeRestrictionResidualStencilKernel specialized on
+ * HPCG_STENCIL if the matrix has that stencil size.
+ */
+template <typename MT>
+inline int
+ComputeRestrictionResidualKernel(
+    Array<MT>                            &matrixValues,
+    Array<local_int_t>                   &mtxIndL,
+    Array<char>                          &nonzerosInRow,
+    Array<local_int_t>                   &Af2c,
+    Array<floatType>                     &x,
+    Array<floatType>                     &rc,
+    Array<floatType>                     &rf,
+    const ComputeRestrictionResidualArgs &args
+) {
+    if (args.spmvArgs.stencilSize == HPCG_STENCIL) {
+        return ComputeRestrictionResidualStencilKernel<HPCG_STENCIL>(
+                   matrixValues, mtxIndL, nonzerosInRow, Af2c, x, rc, rf, args
+               );
+    }
+    return ComputeRestrictionResidualStencilKernel<0>(
+               matrixValues, mtxIndL, nonzerosInRow, Af2c, x, rc, rf, args
+           );
+}
+
+/**
+ * The MG residual SpMV and the restriction in one pass: after the halo
+ * exchange of x, only the fine rows that f2cOperator injects (one in eight)
+ * are multiplied, so the other rows of A are never read. Uses the reduced
+ * precision matrix values if OptimizeProblem provided them, as ComputeSPMV
+ * does in the preconditioner. If boundaryOnly, rows without ghost columns are
+ * left as they are.
+ */
+inline int
+ComputeRestrictionResidual(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &rf,
+    Context ctx,
+    Runtime *lrt,
+    bool boundaryOnly = false
+) {
+    const ComputeRestrictionResidualArgs args = {
+        .spmvArgs = {
+            .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
+            .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
+            .stencilSize          = A.geom->data()->stencilSize,
+            .mixedPrecision       = (A.matrixValuesMG != nullptr)
+        },
+        .boundaryOnly = boundaryOnly
+    };
+    const bool mp = args.spmvArgs.mixedPrecision;
+    //
+    ExchangeHalo(A, x, ctx, lrt);
+    //
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        RESTRICTION_RESIDUAL_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    if (mp) A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    else    A.matrixValues->intent  (RO_E, tl, ctx, lrt);
+    A.mtxIndL->intent            (RO_E, tl, ctx, lrt);
+    A.nonzerosInRow->intent      (RO_E, tl, ctx, lrt);
+    A.mgData->f2cOperator->intent(RO_E, tl, ctx, lrt);
+    //
+    x.intent(RO_E, tl, ctx, lrt);
+    if (boundaryOnly) A.mgData->rc->intent(RW_E, tl, ctx, lrt);
+    else              A.mgData->rc->intent(WO_E, tl, ctx, lrt);
+    rf.intent(RO_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    return 0;
+#else
+    if (mp) {
+        return ComputeRestrictionResidualKernel(
+                   *A.matrixValuesMG, *A.mtxIndL, *A.nonzerosInRow,
+                   *A.mgData->f2cOperator, x, *A.mgData->rc, rf, args
+               );
+    }
+    return ComputeRestrictionResidualKernel(
+               *A.matrixValues, *A.mtxIndL, *A.nonzerosInRow,
+               *A.mgData->f2cOperator, x, *A.mgData->rc, rf, args
+           );
+#endif
+}
+
 /**
  *
  */
@@ -147,6 +387,61 @@ ComputeRestrictionTask(
     );
 }
 
+/**
+ *
+ */
+void
+ComputeInjectionTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    int rid = 0;
+    Array<local_int_t> Af2c(regions[rid++], ctx, lrt);
+    Array<floatType>   rc  (regions[rid++], ctx, lrt);
+    Array<floatType>   rf  (regions[rid++], ctx, lrt);
+    //
+    ComputeInjectionKernel(Af2c, rc, rf);
+}
+
+/**
+ *
+ */
+void
+ComputeRestrictionResidualTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeRestrictionResidualArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow (regions[rid++], ctx, lrt);
+    Array<local_int_t> Af2c   (regions[rid++], ctx, lrt);
+    //
+    Array<floatType> x (regions[rid++], ctx, lrt);
+    Array<floatType> rc(regions[rid++], ctx, lrt);
+    Array<floatType> rf(regions[rid++], ctx, lrt);
+    //
+    if (args->spmvArgs.mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeRestrictionResidualKernel(
+            matrixValues, mtxIndL, nonzerosInRow, Af2c, x, rc, rf, *args
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeRestrictionResidualKernel(
+            matrixValues, mtxIndL, nonzerosInRow, Af2c, x, rc, rf, *args
+        );
+    }
+}
+
 /**
  *
  */
@@ -163,5 +458,23 @@ registerRestrictionTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeRestrictionTask"
     );
+    HighLevelRuntime::register_legion_task<ComputeRestrictionResidualTask>(
+        RESTRICTION_RESIDUAL_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeRestrictionResidualTask"
+    );
+    HighLevelRuntime::register_legion_task<ComputeInjectionTask>(
+        INJECTION_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeInjectionTask"
+    );
 #endif
 }
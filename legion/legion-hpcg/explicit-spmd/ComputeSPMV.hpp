@@ -43,10 +43,21 @@
 #pragma once
 
 #include <cassert>
+#include <algorithm>
 
+#include "hpcg.hpp"
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 #include "ExchangeHalo.hpp"
+#include "MatrixFree.hpp"
+#include "ComputeDotProduct.hpp"
+#include "FutureMath.hpp"
+#include "SubBlocks.hpp"
+#include "StencilRows.hpp"
+
+#ifdef LGNCG_USE_CUDA
+#include "GPUKernels.hpp"
+#endif
 
 /**
  *
@@ -55,6 +66,8 @@ struct ComputeSPMVArgs {
     local_int_t localNumberOfColumns;
     local_int_t localNumberOfRows;
     int stencilSize;
+    // Matrix values are mgFloatType (SparseMatrix::matrixValuesMG).
+    bool mixedPrecision;
 };
 
 /*!
@@ -64,19 +77,22 @@ struct ComputeSPMVArgs {
     @param[in]  A the known system matrix
     @param[in]  x the known vector
     @param[out] y the On exit contains the result: Ax.
+    @param[out] xty if not NULL, on exit contains the local part of x'Ax.
 
     @return returns 0 upon success and non-zero otherwise
 
     @see ComputeSPMV
 */
+template <int STENCIL, typename MT>
 inline int
-ComputeSPMVKernel(
-    Array<floatType>      &matrixValues,
+ComputeSPMVStencilKernel(
+    Array<MT>             &matrixValues,
     Array<local_int_t>    &mtxIndL,
     Array<char>           &nonzerosInRow,
     Array<floatType>      &x,
     Array<floatType>      &y,
-    const ComputeSPMVArgs &args
+    const ComputeSPMVArgs &args,
+    floatType             *xty
 ) {
     // Test vector lengths
     assert(x.length() >= size_t(args.localNumberOfColumns));
@@ -87,24 +103,321 @@ ComputeSPMVKernel(
     // Number of rows.
     const local_int_t nrow    = args.localNumberOfRows;
     // Number of non-zeros per row.
-    const local_int_t nzpr    = args.stencilSize;
+    const local_int_t nzpr    = STENCIL > 0 ? STENCIL : args.stencilSize;
     //
-    Array2D<floatType> AmatrixValues(nrow, nzpr, matrixValues.data());
+    Array2D<MT> AmatrixValues(nrow, nzpr, matrixValues.data());
     //
     Array2D<local_int_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
     //
     const char *const AnonzerosInRow = nonzerosInRow.data();
     //
+    LGNCG_PROFILE(
+        xty ? SPMV_DOT_TID : SPMV_TID,
+        nrow * (nzpr * (sizeof(MT) + sizeof(local_int_t))
+             + sizeof(char) + 2 * sizeof(floatType))
+    );
+    //
+    double dot = 0.0;
     for (local_int_t i = 0; i < nrow; i++) {
-        double sum = 0.0;
-        const floatType *const cur_vals = AmatrixValues(i);
-        const local_int_t *const cur_inds = AmtxIndL(i);
-        const int cur_nnz = AnonzerosInRow[i];
-        //
-        for (int j = 0; j < cur_nnz; j++) {
-            sum += cur_vals[j] * xv[cur_inds[j]];
+        const double sum = StencilRowDot<STENCIL>(
+                               AmatrixValues(i), AmtxIndL(i),
+                               AnonzerosInRow[i], xv
+                           );
+        yv[i] = sum;
+        dot += xv[i] * sum;
+    }
+    //
+    if (xty) *xty = dot;
+    //
+    return 0;
+}
+
+/**
+ * Dispatches to the ComputeSPMVStencilKernel specialized on HPCG_STENCIL if
+ * the matrix has that stencil size.
+ */
+template <typename MT>
+inline int
+ComputeSPMVKernel(
+    Array<MT>             &matrixValues,
+    Array<local_int_t>    &mtxIndL,
+    Array<char>           &nonzerosInRow,
+    Array<floatType>      &x,
+    Array<floatType>      &y,
+    const ComputeSPMVArgs &args,
+    floatType             *xty = NULL
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSPMVStencilKernel<HPCG_STENCIL>(
+                   matrixValues, mtxIndL, nonzerosInRow, x, y, args, xty
+               );
+    }
+    return ComputeSPMVStencilKernel<0>(
+               matrixValues, mtxIndL, nonzerosInRow, x, y, args, xty
+           );
+}
+
+/**
+ *
+ */
+struct ComputeSPMVRowsArgs {
+    ComputeSPMVArgs spmvArgs;
+    // Range [rowBegin, rowEnd) of haloRowOrder to compute.
+    local_int_t rowBegin;
+    local_int_t rowEnd;
+    // Compute rows from geom instead of the stored matrix (only valid for
+    // rows without ghost columns).
+    bool matrixFree;
+    Geometry geom;
+};
+
+/*!
+    Computes y = Ax for the subset of rows listed in rowOrder[rowBegin, rowEnd).
+    Used to split SpMV into an interior pass (that only needs local values of x)
+    and a boundary pass (that needs ghost values from ExchangeHalo).
+
+    @param[in]  rowOrder local rows (see SparseMatrix::haloRowOrder).
+    @param[in]  x the known vector (only the first nrow entries are accessed
+                  for an interior pass).
+    @param[out] y the On exit contains the result: Ax for the selected rows.
+    @param[out] xty On exit contains x'Ax restricted to the selected rows.
+
+    @return returns 0 upon success and non-zero otherwise
+
+    @see SetupHalo
+*/
+template <int STENCIL, typename MT>
+inline int
+ComputeSPMVRowsStencilKernel(
+    Array<MT>                 &matrixValues,
+    Array<local_int_t>        &mtxIndL,
+    Array<char>               &nonzerosInRow,
+    Array<local_int_t>        &rowOrder,
+    Array<floatType>          &x,
+    Array<floatType>          &y,
+    const ComputeSPMVRowsArgs &args,
+    floatType                 &xty
+) {
+    const ComputeSPMVArgs &sargs = args.spmvArgs;
+    // Test vector lengths
+    assert(y.length() >= size_t(sargs.localNumberOfRows));
+    //
+    const floatType *const xv = x.data();
+    floatType *const yv       = y.data();
+    // Number of rows.
+    const local_int_t nrow    = sargs.localNumberOfRows;
+    // Number of non-zeros per row.
+    const local_int_t nzpr    = STENCIL > 0 ? STENCIL : sargs.stencilSize;
+    //
+    Array2D<MT> AmatrixValues(nrow, nzpr, matrixValues.data());
+    //
+    Array2D<local_int_t> AmtxIndL(nrow, nzpr, mtxIndL.data());
+    //
+    const char *const AnonzerosInRow = nonzerosInRow.data();
+    const local_int_t *const rows    = rowOrder.data();
+    //
+    LGNCG_PROFILE(
+        SPMV_ROWS_TID,
+        (args.rowEnd - args.rowBegin)
+            * ((args.matrixFree ? 0 : nzpr * (sizeof(MT) + sizeof(local_int_t)))
+             + sizeof(char) + sizeof(local_int_t) + 2 * sizeof(floatType))
+    );
+    //
+    double dot = 0.0;
+    if (args.matrixFree) {
+        for (local_int_t r = args.rowBegin; r < args.rowEnd; r++) {
+            const local_int_t i = rows[r];
+            const floatType sum = StencilRowApply(args.geom, xv, i);
+            yv[i] = sum;
+            dot += xv[i] * sum;
         }
+        xty = dot;
+        return 0;
+    }
+    for (local_int_t r = args.rowBegin; r < args.rowEnd; r++) {
+        const local_int_t i = rows[r];
+        const double sum = StencilRowDot<STENCIL>(
+                               AmatrixValues(i), AmtxIndL(i),
+                               AnonzerosInRow[i], xv
+                           );
         yv[i] = sum;
+        dot += xv[i] * sum;
+    }
+    //
+    xty = dot;
+    //
+    return 0;
+}
+
+/**
+ * Dispatches to the ComputeSPMVRowsStencilKernel specialized on HPCG_STENCIL
+ * if the matrix has that stencil size.
+ */
+template <typename MT>
+inline int
+ComputeSPMVRowsKernel(
+    Array<MT>                 &matrixValues,
+    Array<local_int_t>        &mtxIndL,
+    Array<char>               &nonzerosInRow,
+    Array<local_int_t>        &rowOrder,
+    Array<floatType>          &x,
+    Array<floatType>          &y,
+    const ComputeSPMVRowsArgs &args,
+    floatType                 &xty
+) {
+    if (args.spmvArgs.stencilSize == HPCG_STENCIL) {
+        return ComputeSPMVRowsStencilKernel<HPCG_STENCIL>(
+                   matrixValues, mtxIndL, nonzerosInRow, rowOrder,
+                   x, y, args, xty
+               );
+    }
+    return ComputeSPMVRowsStencilKernel<0>(
+               matrixValues, mtxIndL, nonzerosInRow, rowOrder, x, y, args, xty
+           );
+}
+
+/**
+ * Launches (or, without tasking, computes) a row-subset SpMV. x's region
+ * requirement is given explicitly so that an interior pass can request only the
+ * private sub-region of x. If xtyFuture is not NULL, it is set to the partial
+ * x'Ax of the selected rows.
+ */
+inline int
+ComputeSPMVRows(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    const LogicalRegion &xlr,
+    Array<floatType> &y,
+    const ComputeSPMVRowsArgs &args,
+    Future *xtyFuture,
+    Context ctx,
+    Runtime *lrt
+) {
+    if (args.rowBegin == args.rowEnd) {
+        if (xtyFuture) *xtyFuture = Future::from_value(lrt, floatType(0.0));
+        return 0;
+    }
+#ifdef LGNCG_TASKING
+    //
+    TaskLauncher tl(
+        SPMV_ROWS_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    if (args.spmvArgs.mixedPrecision) {
+        A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    }
+    else {
+        A.matrixValues->intent(RO_E, tl, ctx, lrt);
+    }
+    A.mtxIndL->intent      (RO_E, tl, ctx, lrt);
+    A.nonzerosInRow->intent(RO_E, tl, ctx, lrt);
+    A.haloRowOrder->intent (RO_E, tl, ctx, lrt);
+    //
+    tl.add_region_requirement(
+        RegionRequirement(xlr, RO_E, x.logicalRegion)
+    ).add_field(x.fid);
+    // Other row passes write other parts of y, so don't discard it.
+    y.intent(RW_E, tl, ctx, lrt);
+    //
+    Future f = lrt->execute_task(ctx, tl);
+    if (xtyFuture) *xtyFuture = f;
+    //
+    return 0;
+#else
+    LGNCG_UNUSED(xlr);
+    floatType xty = 0.0;
+    const int rc = args.spmvArgs.mixedPrecision ?
+                   ComputeSPMVRowsKernel(
+                       *A.matrixValuesMG,
+                       *A.mtxIndL,
+                       *A.nonzerosInRow,
+                       *A.haloRowOrder,
+                       x,
+                       y,
+                       args,
+                       xty
+                   ) :
+                   ComputeSPMVRowsKernel(
+                       *A.matrixValues,
+                       *A.mtxIndL,
+                       *A.nonzerosInRow,
+                       *A.haloRowOrder,
+                       x,
+                       y,
+                       args,
+                       xty
+                   );
+    if (xtyFuture) *xtyFuture = Future::from_value(lrt, xty);
+    return rc;
+#endif
+}
+
+/*!
+    SELL-C-sigma variant of ComputeSPMVKernel. Each chunk holds HPCG_SELL_C rows
+    stored column-major, so the inner loop runs over rows and vectorizes.
+
+    @param[in]  sellValues   chunked matrix values (zero padded).
+    @param[in]  sellColInds  chunked local column indices.
+    @param[in]  sellChunkPtr offset of each chunk (nChunks + 1 entries).
+    @param[in]  sellRowPerm  maps SELL-C-sigma row position to local row.
+    @param[in]  x the known vector
+    @param[out] y the On exit contains the result: Ax.
+
+    @return returns 0 upon success and non-zero otherwise
+
+    @see GenerateSELLCSigma
+*/
+inline int
+ComputeSPMVSELLKernel(
+    Array<floatType>      &sellValues,
+    Array<local_int_t>    &sellColInds,
+    Array<local_int_t>    &sellChunkPtr,
+    Array<local_int_t>    &sellRowPerm,
+    Array<floatType>      &x,
+    Array<floatType>      &y,
+    const ComputeSPMVArgs &args
+) {
+    // Test vector lengths
+    assert(x.length() >= size_t(args.localNumberOfColumns));
+    assert(y.length() >= size_t(args.localNumberOfRows));
+    //
+    const floatType *const xv = x.data();
+    floatType *const yv       = y.data();
+    // Number of rows.
+    const local_int_t nrow    = args.localNumberOfRows;
+    //
+    const floatType *const vals       = sellValues.data();
+    const local_int_t *const inds     = sellColInds.data();
+    const local_int_t *const chunkPtr = sellChunkPtr.data();
+    const local_int_t *const rowPerm  = sellRowPerm.data();
+    //
+    const local_int_t C = HPCG_SELL_C;
+    const local_int_t nChunks = sellChunkPtr.length() - 1;
+    //
+    LGNCG_PROFILE(
+        SPMV_SELL_TID,
+        sellValues.length() * (sizeof(floatType) + sizeof(local_int_t))
+            + nrow * (sizeof(local_int_t) + 2 * sizeof(floatType))
+    );
+    //
+    for (local_int_t c = 0; c < nChunks; ++c) {
+        const local_int_t base = chunkPtr[c];
+        const local_int_t width = (chunkPtr[c + 1] - base) / C;
+        double sum[HPCG_SELL_C] = {0.0};
+        //
+        for (local_int_t j = 0; j < width; ++j) {
+            const floatType *const cur_vals = vals + base + j * C;
+            const local_int_t *const cur_inds = inds + base + j * C;
+            for (local_int_t r = 0; r < C; ++r) {
+                sum[r] += cur_vals[r] * xv[cur_inds[r]];
+            }
+        }
+        // Scatter back to original row order (last chunk may be partial).
+        const local_int_t nr = std::min(C, nrow - c * C);
+        for (local_int_t r = 0; r < nr; ++r) {
+            yv[rowPerm[c * C + r]] = sum[r];
+        }
     }
     //
     return 0;
@@ -114,29 +427,160 @@ ComputeSPMVKernel(
  *
  */
 inline int
-ComputeSPMV(
+ComputeSPMVSELL(
     SparseMatrix &A,
     Array<floatType> &x,
     Array<floatType> &y,
+    const ComputeSPMVArgs &args,
     Context ctx,
     Runtime *lrt
 ) {
-    ExchangeHalo(A, x, ctx, lrt);
+#ifdef LGNCG_TASKING
     //
+    TaskLauncher tl(
+        SPMV_SELL_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    A.sellValues->intent  (RO_E, tl, ctx, lrt);
+    A.sellColInds->intent (RO_E, tl, ctx, lrt);
+    A.sellChunkPtr->intent(RO_E, tl, ctx, lrt);
+    A.sellRowPerm->intent (RO_E, tl, ctx, lrt);
+    //
+    x.intent(RO_E, tl, ctx, lrt);
+    //
+    y.intent(WO_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+    //
+    return 0;
+#else
+    return ComputeSPMVSELLKernel(
+               *A.sellValues,
+               *A.sellColInds,
+               *A.sellChunkPtr,
+               *A.sellRowPerm,
+               x,
+               y,
+               args
+           );
+#endif
+}
+
+/**
+ * Computes y = Ax. inPreconditioner is set by ComputeMG: if OptimizeProblem
+ * provided reduced precision matrix values, they are used in that case.
+ */
+inline int
+ComputeSPMV(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Context ctx,
+    Runtime *lrt,
+    bool inPreconditioner = false
+) {
+    const bool mp = inPreconditioner && A.matrixValuesMG;
     const ComputeSPMVArgs args = {
         .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
         .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
-        .stencilSize          = A.geom->data()->stencilSize
+        .stencilSize          = A.geom->data()->stencilSize,
+        .mixedPrecision       = mp
     };
+    const bool matrixFree =
+        (ShardKernelVariants().spmv == SPMV_VARIANT_MATRIX_FREE);
+    const int nBlocks = NumberOfSubBlocks(args.localNumberOfRows);
+#ifdef LGNCG_USE_CUDA
+    // SPMV_ROWS has no GPU variant, so keep the whole product in one task.
+    const bool splitRows = false;
+#else
+    // Sub-blocks already spread the rows over several tasks.
+    const bool splitRows = (nBlocks == 1);
+#endif
+    // Overlap the halo exchange with the interior rows: the interior pass only
+    // reads x's private sub-region, so it does not depend on the ghost updates
+    // performed by ExchangeHalo.
+    if (splitRows && (x.hasGhosts() || matrixFree) &&
+        A.haloRowOrder && (mp || !A.isSpmvOptimized)) {
+        const local_int_t nInterior = A.numberOfInteriorRows;
+        //
+        const ComputeSPMVRowsArgs interiorArgs = {
+            .spmvArgs   = args,
+            .rowBegin   = 0,
+            .rowEnd     = nInterior,
+            .matrixFree = matrixFree,
+            .geom       = *A.geom->data()
+        };
+        const LogicalRegion xPrivateLR =
+            x.hasGhosts() ? GetPrivateLogicalRegion(x, ctx, lrt)
+                          : x.logicalRegion;
+        ComputeSPMVRows(A, x, xPrivateLR, y, interiorArgs, NULL, ctx, lrt);
+        //
+        ExchangeHalo(A, x, ctx, lrt);
+        //
+        const ComputeSPMVRowsArgs boundaryArgs = {
+            .spmvArgs   = args,
+            .rowBegin   = nInterior,
+            .rowEnd     = args.localNumberOfRows,
+            .matrixFree = false,
+            .geom       = *A.geom->data()
+        };
+        return ComputeSPMVRows(
+                   A, x, x.logicalRegion, y, boundaryArgs, NULL, ctx, lrt
+               );
+    }
+    //
+    ExchangeHalo(A, x, ctx, lrt);
+    // Use SELL-C-sigma storage if OptimizeProblem provided it.
+    if (A.isSpmvOptimized && !mp) {
+        return ComputeSPMVSELL(A, x, y, args, ctx, lrt);
+    }
     //
 #ifdef LGNCG_TASKING
+    // One point task per sub-block of rows, each reading all of x.
+    if (nBlocks > 1) {
+        const local_int_t nrow = args.localNumberOfRows;
+        const int64_t nzpr = args.stencilSize;
+        IndexLauncher il(
+            SPMV_BLOCK_TID,
+            SubBlockLaunchDomain(nBlocks),
+            TaskArgument(&args, sizeof(args)),
+            ArgumentMap()
+        );
+        //
+        if (mp) {
+            SubBlockIntent(
+                *A.matrixValuesMG, READ_ONLY, nrow, nBlocks, nzpr, il, ctx, lrt
+            );
+        }
+        else {
+            SubBlockIntent(
+                *A.matrixValues, READ_ONLY, nrow, nBlocks, nzpr, il, ctx, lrt
+            );
+        }
+        SubBlockIntent(
+            *A.mtxIndL, READ_ONLY, nrow, nBlocks, nzpr, il, ctx, lrt
+        );
+        SubBlockIntent(
+            *A.nonzerosInRow, READ_ONLY, nrow, nBlocks, 1, il, ctx, lrt
+        );
+        //
+        SubBlockWholeIntent(x, il);
+        //
+        SubBlockIntent(y, WRITE_DISCARD, nrow, nBlocks, 1, il, ctx, lrt);
+        //
+        lrt->execute_index_space(ctx, il);
+        //
+        return 0;
+    }
     //
     TaskLauncher tl(
         SPMV_TID,
         TaskArgument(&args, sizeof(args))
     );
     //
-    A.matrixValues->intent(RO_E, tl, ctx, lrt);
+    if (mp) A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    else    A.matrixValues->intent(RO_E, tl, ctx, lrt);
     A.mtxIndL->intent(RO_E, tl, ctx, lrt);
     A.nonzerosInRow->intent(RO_E, tl, ctx, lrt);
     //
@@ -148,6 +592,16 @@ ComputeSPMV(
     //
     return 0;
 #else
+    if (mp) {
+        return ComputeSPMVKernel(
+                   *A.matrixValuesMG,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   x,
+                   y,
+                   args
+               );
+    }
     return ComputeSPMVKernel(
                *A.matrixValues,
                *A.mtxIndL,
@@ -168,6 +622,176 @@ ComputeSPMVTask(
     const std::vector<PhysicalRegion> &regions,
     Context ctx,
     Runtime *lrt
+) {
+    const auto *const args = (ComputeSPMVArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow(regions[rid++], ctx, lrt);
+    //
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    Array<floatType> y(regions[rid++], ctx, lrt);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, *args);
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, *args);
+    }
+}
+
+/**
+ * Point task of a sub-block SPMV: the matrix arrays and y are the point's
+ * block of rows, x is the whole vector (column indices are shard-local).
+ */
+void
+ComputeSPMVBlockTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    auto args = *(ComputeSPMVArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow(regions[rid++], ctx, lrt);
+    //
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    Array<floatType> y(regions[rid++], ctx, lrt);
+    //
+    args.localNumberOfRows = local_int_t(y.length());
+    //
+    if (args.mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, args);
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, args);
+    }
+}
+
+#ifdef LGNCG_USE_CUDA
+/**
+ * TOC_PROC variant of ComputeSPMVTask. All instances are in framebuffer
+ * memory (see CGMapper).
+ */
+void
+ComputeSPMVTaskGPU(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeSPMVArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow(regions[rid++], ctx, lrt);
+    //
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    Array<floatType> y(regions[rid++], ctx, lrt);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        GPUComputeSPMV(
+            matrixValues.data(), mtxIndL.data(), nonzerosInRow.data(),
+            x.data(), y.data(), args->localNumberOfRows, args->stencilSize
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        GPUComputeSPMV(
+            matrixValues.data(), mtxIndL.data(), nonzerosInRow.data(),
+            x.data(), y.data(), args->localNumberOfRows, args->stencilSize
+        );
+    }
+}
+#endif
+
+/**
+ *
+ */
+void
+ComputeSPMVSELLTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeSPMVArgs *)task->args;
+    //
+    int rid = 0;
+    Array<floatType> sellValues(regions[rid++], ctx, lrt);
+    Array<local_int_t> sellColInds(regions[rid++], ctx, lrt);
+    Array<local_int_t> sellChunkPtr(regions[rid++], ctx, lrt);
+    Array<local_int_t> sellRowPerm(regions[rid++], ctx, lrt);
+    //
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    Array<floatType> y(regions[rid++], ctx, lrt);
+    //
+    ComputeSPMVSELLKernel(
+        sellValues, sellColInds, sellChunkPtr, sellRowPerm, x, y, *args
+    );
+}
+
+/**
+ *
+ */
+floatType
+ComputeSPMVRowsTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeSPMVRowsArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL(regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow(regions[rid++], ctx, lrt);
+    Array<local_int_t> rowOrder(regions[rid++], ctx, lrt);
+    //
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    Array<floatType> y(regions[rid++], ctx, lrt);
+    //
+    floatType xty = 0.0;
+    if (args->spmvArgs.mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVRowsKernel(
+            matrixValues, mtxIndL, nonzerosInRow, rowOrder, x, y, *args, xty
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSPMVRowsKernel(
+            matrixValues, mtxIndL, nonzerosInRow, rowOrder, x, y, *args, xty
+        );
+    }
+    //
+    return xty;
+}
+
+/**
+ *
+ */
+floatType
+ComputeSPMVDotTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
 ) {
     const auto *const args = (ComputeSPMVArgs *)task->args;
     //
@@ -179,7 +803,142 @@ ComputeSPMVTask(
     Array<floatType> x(regions[rid++], ctx, lrt);
     Array<floatType> y(regions[rid++], ctx, lrt);
     //
-    ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, *args);
+    floatType xty = 0.0;
+    ComputeSPMVKernel(matrixValues, mtxIndL, nonzerosInRow, x, y, *args, &xty);
+    //
+    return xty;
+}
+
+/**
+ * Computes y = Ax and starts the all reduce of x'y (returned in resultFuture)
+ * without a separate pass over x and y.
+ */
+inline int
+ComputeSPMVDot(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<floatType> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    const ComputeSPMVArgs args = {
+        .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
+        .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
+        .stencilSize          = A.geom->data()->stencilSize,
+        .mixedPrecision       = false
+    };
+#ifdef LGNCG_USE_CUDA
+    // SPMV_DOT has no GPU variant: use the SPMV and DDOT GPU variants instead.
+    const bool fuse = false;
+#else
+    // Nor a sub-block variant.
+    const bool fuse = (NumberOfSubBlocks(args.localNumberOfRows) == 1);
+#endif
+    // The SELL-C-sigma kernel works in permuted row order, so don't fuse.
+    if (A.isSpmvOptimized || !fuse) {
+        ComputeSPMV(A, x, y, ctx, lrt);
+        return ComputeDotProduct(
+                   args.localNumberOfRows, x, y,
+                   resultFuture, timeAllreduce, dcReduceSum, ctx, lrt
+               );
+    }
+    //
+    Future localFuture;
+    const bool matrixFree =
+        (ShardKernelVariants().spmv == SPMV_VARIANT_MATRIX_FREE);
+    // Same interior/boundary overlap as in ComputeSPMV, each pass contributing
+    // its part of x'y.
+    if ((x.hasGhosts() || matrixFree) && A.haloRowOrder) {
+        const local_int_t nInterior = A.numberOfInteriorRows;
+        //
+        const ComputeSPMVRowsArgs interiorArgs = {
+            .spmvArgs   = args,
+            .rowBegin   = 0,
+            .rowEnd     = nInterior,
+            .matrixFree = matrixFree,
+            .geom       = *A.geom->data()
+        };
+        Future interiorFuture, boundaryFuture;
+        const LogicalRegion xPrivateLR =
+            x.hasGhosts() ? GetPrivateLogicalRegion(x, ctx, lrt)
+                          : x.logicalRegion;
+        ComputeSPMVRows(
+            A, x, xPrivateLR, y, interiorArgs, &interiorFuture, ctx, lrt
+        );
+        //
+        ExchangeHalo(A, x, ctx, lrt);
+        //
+        const ComputeSPMVRowsArgs boundaryArgs = {
+            .spmvArgs   = args,
+            .rowBegin   = nInterior,
+            .rowEnd     = args.localNumberOfRows,
+            .matrixFree = false,
+            .geom       = *A.geom->data()
+        };
+        ComputeSPMVRows(
+            A, x, x.logicalRegion, y, boundaryArgs, &boundaryFuture, ctx, lrt
+        );
+        //
+        localFuture = ComputeFuture(
+                          &interiorFuture, FMO_ADD, &boundaryFuture, ctx, lrt
+                      );
+    }
+    else {
+        ExchangeHalo(A, x, ctx, lrt);
+#ifdef LGNCG_TASKING
+        TaskLauncher tl(
+            SPMV_DOT_TID,
+            TaskArgument(&args, sizeof(args))
+        );
+        //
+        A.matrixValues->intent(RO_E, tl, ctx, lrt);
+        A.mtxIndL->intent(RO_E, tl, ctx, lrt);
+        A.nonzerosInRow->intent(RO_E, tl, ctx, lrt);
+        //
+        x.intent(RO_E, tl, ctx, lrt);
+        //
+        y.intent(WO_E, tl, ctx, lrt);
+        //
+        localFuture = lrt->execute_task(ctx, tl);
+#else
+        floatType xty = 0.0;
+        ComputeSPMVKernel(
+            *A.matrixValues, *A.mtxIndL, *A.nonzerosInRow, x, y, args, &xty
+        );
+        localFuture = Future::from_value(lrt, xty);
+#endif
+    }
+    //
+    double t0 = mytimer();
+    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
+    timeAllreduce += mytimer() - t0;
+    //
+    return 0;
+}
+
+/**
+ * Reproducible ComputeSPMVDot: y = Ax, then the reproducible dot product
+ * (not fused, the exact sum needs its own pass).
+ */
+inline int
+ComputeSPMVDot(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Array<floatType> &y,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<ReproSumValue> > &dcReproSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeSPMV(A, x, y, ctx, lrt);
+    return ComputeDotProduct(
+               A.sclrs->data()->localNumberOfRows, x, y,
+               resultFuture, timeAllreduce, dcReproSum, ctx, lrt
+           );
 }
 
 /**
@@ -198,5 +957,52 @@ registerSPMVTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeSPMVTask"
     );
+    HighLevelRuntime::register_legion_task<ComputeSPMVSELLTask>(
+        SPMV_SELL_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVSELLTask"
+    );
+    HighLevelRuntime::register_legion_task<floatType, ComputeSPMVRowsTask>(
+        SPMV_ROWS_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVRowsTask"
+    );
+    HighLevelRuntime::register_legion_task<floatType, ComputeSPMVDotTask>(
+        SPMV_DOT_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVDotTask"
+    );
+    HighLevelRuntime::register_legion_task<ComputeSPMVBlockTask>(
+        SPMV_BLOCK_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        false /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVBlockTask"
+    );
+#ifdef LGNCG_USE_CUDA
+    HighLevelRuntime::register_legion_task<ComputeSPMVTaskGPU>(
+        SPMV_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSPMVTaskGPU"
+    );
+#endif
 #endif
 }
@@ -48,10 +48,19 @@
 
 #pragma once
 
+#include "hpcg.hpp"
 #include "LegionStuff.hpp"
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 #include "ExchangeHalo.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeRestriction.hpp"
+#include "MatrixFree.hpp"
+#include "StencilRows.hpp"
+
+#ifdef LGNCG_USE_CUDA
+#include "GPUKernels.hpp"
+#endif
 
 #include <cassert>
 
@@ -62,6 +71,11 @@ struct ComputeSYMGSArgs {
     local_int_t localNumberOfColumns;
     local_int_t localNumberOfRows;
     int stencilSize;
+    // Matrix values are mgFloatType (SparseMatrix::matrixValuesMG).
+    bool mixedPrecision;
+    // Update rows without ghost columns from geom (--symgs=matrix-free).
+    bool matrixFree;
+    Geometry geom;
 };
 
 /*!
@@ -99,9 +113,10 @@ struct ComputeSYMGSArgs {
 
     @see ComputeSYMGS
 */
+template <int STENCIL, typename MT>
 inline int
-ComputeSYMGSKernel(
-    Array<floatType>       &AmatrixValues,
+ComputeSYMGSStencilKernel(
+    Array<MT>              &AmatrixValues,
     Array<local_int_t>     &AmtxIndL,
     const Array<char>      &AnonzerosInRow,
     const Array<floatType> &AmatrixDiagonal,
@@ -113,7 +128,7 @@ ComputeSYMGSKernel(
     assert(x.length() == size_t(args.localNumberOfColumns));
     //
     const local_int_t nrow = args.localNumberOfRows;
-    const local_int_t nnpr = args.stencilSize;
+    const local_int_t nnpr = STENCIL > 0 ? STENCIL : args.stencilSize;
     //
     const floatType *const matrixDiagonal = AmatrixDiagonal.data();
     assert(matrixDiagonal);
@@ -123,7 +138,7 @@ ComputeSYMGSKernel(
     floatType *const xv = x.data();
     assert(xv);
     // Interpreted as 2D array
-    Array2D<floatType> matrixValues(
+    Array2D<MT> matrixValues(
         nrow, nnpr, AmatrixValues.data()
     );
     // Interpreted as 2D array
@@ -132,42 +147,324 @@ ComputeSYMGSKernel(
     );
     const char *const nonzerosInRow = AnonzerosInRow.data();
     //
+    LGNCG_PROFILE(
+        SYMGS_TID,
+        2 * nrow * (nnpr * (sizeof(MT) + sizeof(local_int_t))
+                 + sizeof(char) + 3 * sizeof(floatType))
+    );
+    //
     for (local_int_t i = 0; i < nrow; i++) {
-        const floatType *const currentValues = matrixValues(i);
-        const local_int_t *const currentColIndices = mtxIndL(i);
-        const uint8_t currentNumberOfNonzeros = nonzerosInRow[i];
-        const floatType currentDiagonal = matrixDiagonal[i];
-        floatType sum = rv[i]; // RHS value
-        //
-        for (uint8_t j = 0; j < currentNumberOfNonzeros; j++) {
-            const local_int_t curCol = currentColIndices[j];
-            sum -= currentValues[j] * xv[curCol];
+        if (args.matrixFree && !StencilRowHasGhostColumns(args.geom, i)) {
+            StencilSYMGSRowUpdate(args.geom, rv, xv, i);
+            continue;
         }
-        // Remove diagonal contribution from previous loop.
-        sum += xv[i] * currentDiagonal;
-        //
-        xv[i] = sum / currentDiagonal;
+        StencilRowRelax<STENCIL>(
+            matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+            matrixDiagonal[i], rv[i], xv, i
+        );
     }
     // Now the back sweep.
     for (local_int_t i = nrow - 1; i >= 0; i--) {
-        const floatType *const currentValues = matrixValues(i);
-        const local_int_t *const currentColIndices = mtxIndL(i);
-        const uint8_t currentNumberOfNonzeros = nonzerosInRow[i];
-        const floatType currentDiagonal = matrixDiagonal[i];
-        floatType sum = rv[i]; // RHS value
-        //
-        for (uint8_t j = 0; j < currentNumberOfNonzeros; j++) {
-            const local_int_t curCol = currentColIndices[j];
-            sum -= currentValues[j] * xv[curCol];
+        if (args.matrixFree && !StencilRowHasGhostColumns(args.geom, i)) {
+            StencilSYMGSRowUpdate(args.geom, rv, xv, i);
+            continue;
+        }
+        StencilRowRelax<STENCIL>(
+            matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+            matrixDiagonal[i], rv[i], xv, i
+        );
+    }
+    //
+    return 0;
+}
+
+/**
+ * Dispatches to the ComputeSYMGSStencilKernel specialized on HPCG_STENCIL if
+ * the matrix has that stencil size.
+ */
+template <typename MT>
+inline int
+ComputeSYMGSKernel(
+    Array<MT>              &AmatrixValues,
+    Array<local_int_t>     &AmtxIndL,
+    const Array<char>      &AnonzerosInRow,
+    const Array<floatType> &AmatrixDiagonal,
+    const Array<floatType> &r,
+    Array<floatType>       &x,
+    const ComputeSYMGSArgs &args
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSYMGSStencilKernel<HPCG_STENCIL>(
+                   AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+                   r, x, args
+               );
+    }
+    return ComputeSYMGSStencilKernel<0>(
+               AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+               r, x, args
+           );
+}
+
+/*!
+    ComputeSYMGSStencilKernel followed by the coarse residual, rc[c] =
+    r[f2c[c]] - (Ax)[f2c[c]], for the injected rows that have no ghost columns,
+    with the same x values and per-row sums as ComputeRestrictionResidual.
+
+    The back sweep runs one z-plane at a time, from the last plane to the first.
+    Once plane pz is done, every column of a row in plane pz + 1 is final, so
+    the injected rows of that plane are multiplied while their matrix rows are
+    still in cache. The forward and back sweeps visit rows in the same order as
+    ComputeSYMGSStencilKernel, so x is bit-identical.
+
+    @param[in]  Af2c the fine row of each coarse row, in increasing order (see
+                     f2cOperatorPopulate).
+    @param[out] rc On exit contains the coarse residual of the interior rows.
+                   Boundary rows need the ghost values of the updated x and
+                   are left untouched.
+
+    @see ComputeSYMGSResidual
+*/
+template <int STENCIL, typename MT>
+inline int
+ComputeSYMGSResidualStencilKernel(
+    Array<MT>                &AmatrixValues,
+    Array<local_int_t>       &AmtxIndL,
+    const Array<char>        &AnonzerosInRow,
+    const Array<floatType>   &AmatrixDiagonal,
+    const Array<floatType>   &r,
+    Array<floatType>         &x,
+    const Array<local_int_t> &Af2c,
+    Array<floatType>         &rc,
+    const ComputeSYMGSArgs   &args
+) {
+    // Make sure x contain space for halo values.
+    assert(x.length() == size_t(args.localNumberOfColumns));
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nnpr = STENCIL > 0 ? STENCIL : args.stencilSize;
+    const local_int_t planeSize = args.geom.nx * args.geom.ny;
+    const local_int_t nPlanes = args.geom.nz;
+    assert(planeSize * nPlanes == nrow);
+    //
+    const floatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    floatType *const xv = x.data();
+    assert(xv);
+    const local_int_t *const f2c = Af2c.data();
+    assert(f2c);
+    floatType *const rcv = rc.data();
+    assert(rcv);
+    const local_int_t nc = rc.length();
+    // Interpreted as 2D array
+    Array2D<MT> matrixValues(
+        nrow, nnpr, AmatrixValues.data()
+    );
+    // Interpreted as 2D array
+    Array2D<local_int_t> mtxIndL(
+        nrow, nnpr, AmtxIndL.data()
+    );
+    const char *const nonzerosInRow = AnonzerosInRow.data();
+    // rc for the interior injected rows of plane pz. Planes are finished from
+    // the last to the first, so the coarse rows of plane pz are the ones below
+    // c that lie in it.
+    local_int_t c = nc;
+    auto residualPlane = [&](local_int_t pz) {
+        const local_int_t cEnd = c;
+        while (c > 0 && f2c[c - 1] >= pz * planeSize) c--;
+        for (local_int_t ci = c; ci < cEnd; ci++) {
+            const local_int_t i = f2c[ci];
+            const local_int_t *const inds = mtxIndL(i);
+            if (StencilRowHasGhosts(inds, nonzerosInRow[i], nrow)) continue;
+            rcv[ci] = rv[i] - StencilRowDot<STENCIL>(
+                                  matrixValues(i), inds, nonzerosInRow[i], xv
+                              );
+        }
+    };
+    //
+    LGNCG_PROFILE(
+        SYMGS_RESIDUAL_TID,
+        2 * nrow * (nnpr * (sizeof(MT) + sizeof(local_int_t))
+                 + sizeof(char) + 3 * sizeof(floatType))
+        + nc * (sizeof(local_int_t) + sizeof(floatType))
+    );
+    //
+    for (local_int_t i = 0; i < nrow; i++) {
+        StencilRowRelax<STENCIL>(
+            matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+            matrixDiagonal[i], rv[i], xv, i
+        );
+    }
+    // Now the back sweep, plane by plane.
+    for (local_int_t pz = nPlanes - 1; pz >= 0; pz--) {
+        for (local_int_t i = (pz + 1) * planeSize - 1; i >= pz * planeSize;
+             i--) {
+            StencilRowRelax<STENCIL>(
+                matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+                matrixDiagonal[i], rv[i], xv, i
+            );
+        }
+        if (pz + 1 < nPlanes) residualPlane(pz + 1);
+    }
+    residualPlane(0);
+    //
+    return 0;
+}
+
+/**
+ * Dispatches to the ComputeSYMGSResidualStencilKernel specialized on
+ * HPCG_STENCIL if the matrix has that stencil size.
+ */
+template <typename MT>
+inline int
+ComputeSYMGSResidualKernel(
+    Array<MT>                &AmatrixValues,
+    Array<local_int_t>       &AmtxIndL,
+    const Array<char>        &AnonzerosInRow,
+    const Array<floatType>   &AmatrixDiagonal,
+    const Array<floatType>   &r,
+    Array<floatType>         &x,
+    const Array<local_int_t> &Af2c,
+    Array<floatType>         &rc,
+    const ComputeSYMGSArgs   &args
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSYMGSResidualStencilKernel<HPCG_STENCIL>(
+                   AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+                   r, x, Af2c, rc, args
+               );
+    }
+    return ComputeSYMGSResidualStencilKernel<0>(
+               AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+               r, x, Af2c, rc, args
+           );
+}
+
+/*!
+    Multicolor variant of ComputeSYMGSKernel. The forward sweep visits colors
+    0 to HPCG_NUM_COLORS - 1 and the back sweep visits them in reverse. Rows of
+    the same color are independent, so each color is a parallel loop.
+
+    @param[in] colorRows local rows grouped by color.
+    @param[in] colorPtr  offset of each color into colorRows.
+
+    @see GenerateMulticoloring
+*/
+template <int STENCIL, typename MT>
+inline int
+ComputeSYMGSMCStencilKernel(
+    Array<MT>                &AmatrixValues,
+    Array<local_int_t>       &AmtxIndL,
+    const Array<char>        &AnonzerosInRow,
+    const Array<floatType>   &AmatrixDiagonal,
+    const Array<local_int_t> &AcolorRows,
+    const Array<local_int_t> &AcolorPtr,
+    const Array<floatType>   &r,
+    Array<floatType>         &x,
+    const ComputeSYMGSArgs   &args
+) {
+    // Make sure x contain space for halo values.
+    assert(x.length() == size_t(args.localNumberOfColumns));
+    //
+    const local_int_t nrow = args.localNumberOfRows;
+    const local_int_t nnpr = STENCIL > 0 ? STENCIL : args.stencilSize;
+    //
+    const floatType *const matrixDiagonal = AmatrixDiagonal.data();
+    assert(matrixDiagonal);
+    const local_int_t *const colorRows = AcolorRows.data();
+    assert(colorRows);
+    const local_int_t *const colorPtr = AcolorPtr.data();
+    assert(colorPtr);
+    //
+    const floatType *const rv = r.data();
+    assert(rv);
+    floatType *const xv = x.data();
+    assert(xv);
+    // Interpreted as 2D array
+    Array2D<MT> matrixValues(
+        nrow, nnpr, AmatrixValues.data()
+    );
+    // Interpreted as 2D array
+    Array2D<local_int_t> mtxIndL(
+        nrow, nnpr, AmtxIndL.data()
+    );
+    const char *const nonzerosInRow = AnonzerosInRow.data();
+    //
+    LGNCG_PROFILE(
+        SYMGS_MC_TID,
+        2 * nrow * (nnpr * (sizeof(MT) + sizeof(local_int_t))
+                 + sizeof(char) + 3 * sizeof(floatType))
+    );
+    //
+    for (int color = 0; color < HPCG_NUM_COLORS; ++color) {
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for (local_int_t c = colorPtr[color]; c < colorPtr[color + 1]; ++c) {
+            const local_int_t i = colorRows[c];
+            if (args.matrixFree && !StencilRowHasGhostColumns(args.geom, i)) {
+                StencilSYMGSRowUpdate(args.geom, rv, xv, i);
+                continue;
+            }
+            StencilRowRelax<STENCIL>(
+                matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+                matrixDiagonal[i], rv[i], xv, i
+            );
+        }
+    }
+    // Now the back sweep.
+    for (int color = HPCG_NUM_COLORS - 1; color >= 0; --color) {
+#ifdef _OPENMP
+        #pragma omp parallel for
+#endif
+        for (local_int_t c = colorPtr[color + 1] - 1;
+             c >= colorPtr[color]; --c) {
+            const local_int_t i = colorRows[c];
+            if (args.matrixFree && !StencilRowHasGhostColumns(args.geom, i)) {
+                StencilSYMGSRowUpdate(args.geom, rv, xv, i);
+                continue;
+            }
+            StencilRowRelax<STENCIL>(
+                matrixValues(i), mtxIndL(i), nonzerosInRow[i],
+                matrixDiagonal[i], rv[i], xv, i
+            );
         }
-        // Remove diagonal contribution from previous loop.
-        sum += xv[i] * currentDiagonal;
-        xv[i] = sum / currentDiagonal;
     }
     //
     return 0;
 }
 
+/**
+ * Dispatches to the ComputeSYMGSMCStencilKernel specialized on HPCG_STENCIL if
+ * the matrix has that stencil size.
+ */
+template <typename MT>
+inline int
+ComputeSYMGSMCKernel(
+    Array<MT>                &AmatrixValues,
+    Array<local_int_t>       &AmtxIndL,
+    const Array<char>        &AnonzerosInRow,
+    const Array<floatType>   &AmatrixDiagonal,
+    const Array<local_int_t> &AcolorRows,
+    const Array<local_int_t> &AcolorPtr,
+    const Array<floatType>   &r,
+    Array<floatType>         &x,
+    const ComputeSYMGSArgs   &args
+) {
+    if (args.stencilSize == HPCG_STENCIL) {
+        return ComputeSYMGSMCStencilKernel<HPCG_STENCIL>(
+                   AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+                   AcolorRows, AcolorPtr, r, x, args
+               );
+    }
+    return ComputeSYMGSMCStencilKernel<0>(
+               AmatrixValues, AmtxIndL, AnonzerosInRow, AmatrixDiagonal,
+               AcolorRows, AcolorPtr, r, x, args
+           );
+}
+
 /**
  *
  */
@@ -184,20 +481,32 @@ ComputeSYMGS(
     const ComputeSYMGSArgs args = {
         .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
         .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
-        .stencilSize          = A.geom->data()->stencilSize
+        .stencilSize          = A.geom->data()->stencilSize,
+        .mixedPrecision       = (A.matrixValuesMG != nullptr),
+        .matrixFree           = (ShardKernelVariants().symgs ==
+                                 SYMGS_VARIANT_MATRIX_FREE),
+        .geom                 = *A.geom->data()
     };
+    // Use the multicolor smoother if OptimizeProblem colored A.
+    const bool mc = A.isMgOptimized;
+    const bool mp = args.mixedPrecision;
     //
 #ifdef LGNCG_TASKING
     //
     TaskLauncher tl(
-        SYMGS_TID,
+        mc ? SYMGS_MC_TID : SYMGS_TID,
         TaskArgument(&args, sizeof(args))
     );
     //
-    A.matrixValues->intent  (RO_E, tl, ctx, lrt);
+    if (mp) A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    else    A.matrixValues->intent  (RO_E, tl, ctx, lrt);
     A.mtxIndL->intent       (RO_E, tl, ctx, lrt);
     A.nonzerosInRow->intent (RO_E, tl, ctx, lrt);
     A.matrixDiagonal->intent(RO_E, tl, ctx, lrt);
+    if (mc) {
+        A.colorRows->intent (RO_E, tl, ctx, lrt);
+        A.colorPtr->intent  (RO_E, tl, ctx, lrt);
+    }
     //
     r.intent(RO_E, tl, ctx, lrt);
     x.intent(RW_E, tl, ctx, lrt);
@@ -206,6 +515,43 @@ ComputeSYMGS(
     //
     return 0;
 #else
+    if (mc && mp) {
+        return ComputeSYMGSMCKernel(
+                   *A.matrixValuesMG,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   *A.matrixDiagonal,
+                   *A.colorRows,
+                   *A.colorPtr,
+                   r,
+                   x,
+                   args
+               );
+    }
+    if (mc) {
+        return ComputeSYMGSMCKernel(
+                   *A.matrixValues,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   *A.matrixDiagonal,
+                   *A.colorRows,
+                   *A.colorPtr,
+                   r,
+                   x,
+                   args
+               );
+    }
+    if (mp) {
+        return ComputeSYMGSKernel(
+                   *A.matrixValuesMG,
+                   *A.mtxIndL,
+                   *A.nonzerosInRow,
+                   *A.matrixDiagonal,
+                   r,
+                   x,
+                   args
+               );
+    }
     return ComputeSYMGSKernel(
                *A.matrixValues,
                *A.mtxIndL,
@@ -218,6 +564,76 @@ ComputeSYMGS(
 #endif
 }
 
+/**
+ * ComputeSYMGS followed by the MG restriction of its residual into
+ * A.mgData->rc (see ComputeRestrictionResidual). The interior injected rows
+ * are computed during the back sweep (see ComputeSYMGSResidualStencilKernel),
+ * so only the injected boundary rows take another pass over the matrix, after
+ * a second halo exchange of the updated x. Only for the sequential (not
+ * multicolored) smoother.
+ */
+inline int
+ComputeSYMGSResidual(
+    SparseMatrix &A,
+    Array<floatType> &r,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    assert(!A.isMgOptimized && A.mgData);
+    //
+    ExchangeHalo(A, x, ctx, lrt);
+    //
+    const ComputeSYMGSArgs args = {
+        .localNumberOfColumns = A.sclrs->data()->localNumberOfColumns,
+        .localNumberOfRows    = A.sclrs->data()->localNumberOfRows,
+        .stencilSize          = A.geom->data()->stencilSize,
+        .mixedPrecision       = (A.matrixValuesMG != nullptr),
+        .matrixFree           = false,
+        .geom                 = *A.geom->data()
+    };
+    const bool mp = args.mixedPrecision;
+    //
+#ifdef LGNCG_TASKING
+    TaskLauncher tl(
+        SYMGS_RESIDUAL_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    //
+    if (mp) A.matrixValuesMG->intent(RO_E, tl, ctx, lrt);
+    else    A.matrixValues->intent  (RO_E, tl, ctx, lrt);
+    A.mtxIndL->intent       (RO_E, tl, ctx, lrt);
+    A.nonzerosInRow->intent (RO_E, tl, ctx, lrt);
+    A.matrixDiagonal->intent(RO_E, tl, ctx, lrt);
+    //
+    r.intent(RO_E, tl, ctx, lrt);
+    x.intent(RW_E, tl, ctx, lrt);
+    A.mgData->f2cOperator->intent(RO_E, tl, ctx, lrt);
+    // The boundary pass writes the other rows.
+    A.mgData->rc->intent(RW_E, tl, ctx, lrt);
+    //
+    lrt->execute_task(ctx, tl);
+#else
+    if (mp) {
+        ComputeSYMGSResidualKernel(
+            *A.matrixValuesMG, *A.mtxIndL, *A.nonzerosInRow,
+            *A.matrixDiagonal, r, x, *A.mgData->f2cOperator, *A.mgData->rc,
+            args
+        );
+    }
+    else {
+        ComputeSYMGSResidualKernel(
+            *A.matrixValues, *A.mtxIndL, *A.nonzerosInRow,
+            *A.matrixDiagonal, r, x, *A.mgData->f2cOperator, *A.mgData->rc,
+            args
+        );
+    }
+#endif
+    // Boundary rows need the neighbors' updated values.
+    const bool boundaryOnly = true;
+    return ComputeRestrictionResidual(A, x, r, ctx, lrt, boundaryOnly);
+}
+
 /**
  *
  */
@@ -231,7 +647,8 @@ ComputeSYMGSTask(
     const auto *const args = (ComputeSYMGSArgs *)task->args;
     //
     int rid = 0;
-    Array<floatType> matrixValues  (regions[rid++], ctx, lrt);
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
     Array<local_int_t> mtxIndL     (regions[rid++], ctx, lrt);
     Array<char> nonzerosInRow      (regions[rid++], ctx, lrt);
     Array<floatType> matrixDiagonal(regions[rid++], ctx, lrt);
@@ -239,17 +656,150 @@ ComputeSYMGSTask(
     Array<floatType> r(regions[rid++], ctx, lrt);
     Array<floatType> x(regions[rid++], ctx, lrt);
     //
-    ComputeSYMGSKernel(
-        matrixValues,
-        mtxIndL,
-        nonzerosInRow,
-        matrixDiagonal,
-        r,
-        x,
-        *args
-    );
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal, r, x, *args
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal, r, x, *args
+        );
+    }
 }
 
+/**
+ *
+ */
+void
+ComputeSYMGSResidualTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeSYMGSArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL     (regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow      (regions[rid++], ctx, lrt);
+    Array<floatType> matrixDiagonal(regions[rid++], ctx, lrt);
+    //
+    Array<floatType> r   (regions[rid++], ctx, lrt);
+    Array<floatType> x   (regions[rid++], ctx, lrt);
+    Array<local_int_t> Af2c(regions[rid++], ctx, lrt);
+    Array<floatType> rc  (regions[rid++], ctx, lrt);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSResidualKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal, r, x,
+            Af2c, rc, *args
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSResidualKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal, r, x,
+            Af2c, rc, *args
+        );
+    }
+}
+
+/**
+ *
+ */
+void
+ComputeSYMGSMCTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeSYMGSArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL     (regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow      (regions[rid++], ctx, lrt);
+    Array<floatType> matrixDiagonal(regions[rid++], ctx, lrt);
+    Array<local_int_t> colorRows   (regions[rid++], ctx, lrt);
+    Array<local_int_t> colorPtr    (regions[rid++], ctx, lrt);
+    //
+    Array<floatType> r(regions[rid++], ctx, lrt);
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSMCKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+            colorRows, colorPtr, r, x, *args
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        ComputeSYMGSMCKernel(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+            colorRows, colorPtr, r, x, *args
+        );
+    }
+}
+
+#ifdef LGNCG_USE_CUDA
+/**
+ * TOC_PROC variant of ComputeSYMGSMCTask. The stored matrix is used for every
+ * row, so matrixFree is ignored (it gives the same result).
+ */
+void
+ComputeSYMGSMCTaskGPU(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeSYMGSArgs *)task->args;
+    //
+    int rid = 0;
+    // Matrix values are unpacked below, once we know their type.
+    const int valuesRID = rid++;
+    Array<local_int_t> mtxIndL     (regions[rid++], ctx, lrt);
+    Array<char> nonzerosInRow      (regions[rid++], ctx, lrt);
+    Array<floatType> matrixDiagonal(regions[rid++], ctx, lrt);
+    Array<local_int_t> colorRows   (regions[rid++], ctx, lrt);
+    Array<local_int_t> colorPtr    (regions[rid++], ctx, lrt);
+    //
+    Array<floatType> r(regions[rid++], ctx, lrt);
+    Array<floatType> x(regions[rid++], ctx, lrt);
+    //
+    // Color offsets bound the kernel launches, so they are needed on the host.
+    local_int_t hColorPtr[HPCG_NUM_COLORS + 1];
+    assert(colorPtr.length() >= HPCG_NUM_COLORS + 1);
+    GPUCopyToHost(hColorPtr, colorPtr.data(), HPCG_NUM_COLORS + 1);
+    //
+    if (args->mixedPrecision) {
+        Array<mgFloatType> matrixValues(regions[valuesRID], ctx, lrt);
+        GPUComputeSYMGSMC(
+            matrixValues.data(), mtxIndL.data(), nonzerosInRow.data(),
+            matrixDiagonal.data(), colorRows.data(), hColorPtr,
+            HPCG_NUM_COLORS, r.data(), x.data(), args->stencilSize
+        );
+    }
+    else {
+        Array<floatType> matrixValues(regions[valuesRID], ctx, lrt);
+        GPUComputeSYMGSMC(
+            matrixValues.data(), mtxIndL.data(), nonzerosInRow.data(),
+            matrixDiagonal.data(), colorRows.data(), hColorPtr,
+            HPCG_NUM_COLORS, r.data(), x.data(), args->stencilSize
+        );
+    }
+}
+#endif
+
 /**
  *
  */
@@ -266,5 +816,34 @@ registerSYMGSTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeSYMGSTask"
     );
+    HighLevelRuntime::register_legion_task<ComputeSYMGSMCTask>(
+        SYMGS_MC_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSMCTask"
+    );
+    HighLevelRuntime::register_legion_task<ComputeSYMGSResidualTask>(
+        SYMGS_RESIDUAL_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSResidualTask"
+    );
+#ifdef LGNCG_USE_CUDA
+    HighLevelRuntime::register_legion_task<ComputeSYMGSMCTaskGPU>(
+        SYMGS_MC_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeSYMGSMCTaskGPU"
+    );
+#endif
 #endif
 }
@@ -49,6 +49,16 @@
 #pragma once
 
 #include "LegionArrays.hpp"
+#include "CollectiveOps.hpp"
+
+#include "mytimer.hpp"
+#include "ComputeDotProduct.hpp"
+#include "SubBlocks.hpp"
+#include "VectorKernels.hpp"
+
+#ifdef LGNCG_USE_CUDA
+#include "GPUKernels.hpp"
+#endif
 
 #include <cassert>
 
@@ -62,14 +72,32 @@ struct ComputeWAXPBYArgs {
     bool xySame;
     bool xwSame;
     bool ywSame;
+    // If set, beta is scaled by the value of the task's first future.
+    bool betaScaled;
 };
 
+/**
+ * Returns the beta a WAXPBY task should use: args->beta, times the future
+ * the launcher attached if args->betaScaled. Getting that value here instead
+ * of in the caller lets the launch be issued before the future resolves.
+ */
+inline floatType
+WAXPBYTaskBeta(
+    const ComputeWAXPBYArgs *args,
+    const Task *task
+) {
+    if (!args->betaScaled) return args->beta;
+    //
+    assert(!task->futures.empty());
+    Future betaScale = task->futures[0];
+    return args->beta * betaScale.get_result<floatType>(silenceWarnings);
+}
+
 /*!
     Routine to compute the update of a vector with the sum of two
     scaled vectors where: w = alpha*x + beta*y
 
-    This is the reference WAXPBY impmentation.  It CANNOT be modified for the
-    purposes of this benchmark.
+    Vectorized and threaded, see VectorWAXPBY.
 
     @param[in] n the number of vector elements (on this processor)
     @param[in] alpha, beta the scalars applied to x and y respectively.
@@ -97,21 +125,17 @@ ComputeWAXPBYKernel(
     const floatType *const yv = y.data();
     floatType *const wv = w.data();
 
-    if (alpha == 1.0) {
-        for (local_int_t i = 0; i < n; i++) wv[i] = xv[i] + beta * yv[i];
-    }
-    else if (beta == 1.0) {
-        for (local_int_t i = 0; i < n; i++) wv[i] = alpha * xv[i] + yv[i];
-    }
-    else  {
-        for (local_int_t i = 0; i < n; i++) wv[i] = alpha * xv[i] + beta * yv[i];
-    }
+    LGNCG_PROFILE(WAXPBY_TID, 3 * n * sizeof(floatType));
+    // Multiplying by 1.0 is exact, so the alpha == 1.0 and beta == 1.0 special
+    // cases of the reference version give the same result.
+    VectorWAXPBY(n, alpha, xv, beta, yv, wv);
     //
     return 0;
 }
 
 /**
- *
+ * Computes w = alpha*x + beta*y. If betaScale is not NULL, beta is first
+ * multiplied by its value inside the task, so the caller never waits on it.
  */
 inline int
 ComputeWAXPBY(
@@ -119,6 +143,7 @@ ComputeWAXPBY(
     const floatType alpha,
     Array<floatType> &x,
     const floatType beta,
+    const Future *betaScale,
     Array<floatType> &y,
     Array<floatType> &w,
     Context ctx,
@@ -135,13 +160,41 @@ ComputeWAXPBY(
         .beta   = beta,
         .xySame = xySame,
         .xwSame = xwSame,
-        .ywSame = ywSame
+        .ywSame = ywSame,
+        .betaScaled = (betaScale != NULL)
     };
     //
+    const int nBlocks = NumberOfSubBlocks(n);
+    if (nBlocks > 1) {
+        IndexLauncher il(
+            WAXPBY_BLOCK_TID,
+            SubBlockLaunchDomain(nBlocks),
+            TaskArgument(&args, sizeof(args)),
+            ArgumentMap()
+        );
+        if (betaScale) il.add_future(*betaScale);
+        //
+        SubBlockIntent(
+            x, xwSame ? READ_WRITE : READ_ONLY, n, nBlocks, 1, il, ctx, lrt
+        );
+        if (!xySame) {
+            SubBlockIntent(
+                y, ywSame ? READ_WRITE : READ_ONLY, n, nBlocks, 1, il, ctx, lrt
+            );
+        }
+        if (!xwSame && !ywSame) {
+            SubBlockIntent(w, WRITE_DISCARD, n, nBlocks, 1, il, ctx, lrt);
+        }
+        //
+        lrt->execute_index_space(ctx, il);
+        return 0;
+    }
+    //
     TaskLauncher tl(
         WAXPBY_TID,
         TaskArgument(&args, sizeof(args))
     );
+    if (betaScale) tl.add_future(*betaScale);
     //
     x.intent(
         xwSame ? RW : RO,
@@ -163,10 +216,30 @@ ComputeWAXPBY(
     lrt->execute_task(ctx, tl);
     return 0;
 #else
-    return ComputeWAXPBYKernel(n, alpha, x, beta, y, w);
+    const floatType b = betaScale
+                      ? beta * betaScale->get_result<floatType>(silenceWarnings)
+                      : beta;
+    return ComputeWAXPBYKernel(n, alpha, x, b, y, w);
 #endif
 }
 
+/**
+ * Computes w = alpha*x + beta*y.
+ */
+inline int
+ComputeWAXPBY(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeWAXPBY(n, alpha, x, beta, NULL, y, w, ctx, lrt);
+}
+
 /**
  *
  */
@@ -192,7 +265,276 @@ ComputeWAXPBYTask(
     Array<floatType> y(regions[yRID], ctx, lrt);
     Array<floatType> w(regions[wRID], ctx, lrt);
     //
-    ComputeWAXPBYKernel(args->n, args->alpha, x, args->beta, y, w);
+    ComputeWAXPBYKernel(
+        args->n, args->alpha, x, WAXPBYTaskBeta(args, task), y, w
+    );
+}
+
+/**
+ * Point task of a sub-block WAXPBY: all regions are the point's blocks.
+ */
+void
+ComputeWAXPBYBlockTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeWAXPBYArgs *)task->args;
+    //
+    int xRID = 0;
+    int yRID = 1;
+    int wRID = 2;
+    // Aliased regions.
+    if (2 == regions.size()) {
+        yRID = args->xySame ? 0 : 1;
+        wRID = args->xwSame ? 0 : 1;
+    }
+    //
+    Array<floatType> x(regions[xRID], ctx, lrt);
+    Array<floatType> y(regions[yRID], ctx, lrt);
+    Array<floatType> w(regions[wRID], ctx, lrt);
+    //
+    ComputeWAXPBYKernel(
+        local_int_t(w.length()), args->alpha, x, WAXPBYTaskBeta(args, task),
+        y, w
+    );
+}
+
+#ifdef LGNCG_USE_CUDA
+/**
+ * TOC_PROC variant of ComputeWAXPBYTask.
+ */
+void
+ComputeWAXPBYTaskGPU(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeWAXPBYArgs *)task->args;
+    //
+    int xRID = 0;
+    int yRID = 1;
+    int wRID = 2;
+    // Aliased regions.
+    if (2 == regions.size()) {
+        yRID = args->xySame ? 0 : 1;
+        wRID = args->xwSame ? 0 : 1;
+    }
+    //
+    Array<floatType> x(regions[xRID], ctx, lrt);
+    Array<floatType> y(regions[yRID], ctx, lrt);
+    Array<floatType> w(regions[wRID], ctx, lrt);
+    //
+    GPUComputeWAXPBY(
+        args->n, args->alpha, x.data(), WAXPBYTaskBeta(args, task),
+        y.data(), w.data()
+    );
+}
+#endif
+
+/*!
+    Fused w = alpha*x + beta*y and w'w, computed in the same pass over w.
+
+    @param[out] wtw on exit contains the local part of w'w.
+
+    @see ComputeWAXPBYKernel
+*/
+inline int
+ComputeWAXPBYDotKernel(
+    const local_int_t n,
+    const floatType alpha,
+    const Array<floatType> &x,
+    const floatType beta,
+    const Array<floatType> &y,
+    Array<floatType> &w,
+    floatType &wtw
+) {
+    // Test vector lengths
+    assert(x.length() >= size_t(n));
+    assert(y.length() >= size_t(n));
+
+    const floatType *const xv = x.data();
+    const floatType *const yv = y.data();
+    floatType *const wv = w.data();
+
+    LGNCG_PROFILE(WAXPBY_DOT_TID, 3 * n * sizeof(floatType));
+
+    wtw = VectorWAXPBYDot(n, alpha, xv, beta, yv, wv);
+    //
+    return 0;
+}
+
+/**
+ * Computes w = alpha*x + beta*y and starts the all reduce of w'w (returned in
+ * resultFuture). betaScale is handled as in ComputeWAXPBY.
+ */
+inline int
+ComputeWAXPBYDot(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    const Future *betaScale,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<floatType> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+#ifdef LGNCG_USE_CUDA
+    // WAXPBY_DOT has no GPU variant: use the WAXPBY and DDOT GPU variants.
+    const bool fuse = false;
+#else
+    // Nor a sub-block variant.
+    const bool fuse = (NumberOfSubBlocks(n) == 1);
+#endif
+    if (!fuse) {
+        ComputeWAXPBY(n, alpha, x, beta, betaScale, y, w, ctx, lrt);
+        return ComputeDotProduct(
+                   n, w, w, resultFuture, timeAllreduce, dcReduceSum, ctx, lrt
+               );
+    }
+    Future localFuture;
+    //
+    int rc = 0;
+#ifdef LGNCG_TASKING
+    const bool xySame = (&x == &y);
+    const bool xwSame = (&x == &w);
+    const bool ywSame = (&y == &w);
+    //
+    ComputeWAXPBYArgs args {
+        .n = n,
+        .alpha  = alpha,
+        .beta   = beta,
+        .xySame = xySame,
+        .xwSame = xwSame,
+        .ywSame = ywSame,
+        .betaScaled = (betaScale != NULL)
+    };
+    //
+    TaskLauncher tl(
+        WAXPBY_DOT_TID,
+        TaskArgument(&args, sizeof(args))
+    );
+    if (betaScale) tl.add_future(*betaScale);
+    //
+    x.intent(
+        xwSame ? RW : RO,
+        EXCLUSIVE,
+        tl, ctx, lrt
+    );
+    //
+    if (!xySame) {
+        y.intent(
+            ywSame ? RW : RO,
+            EXCLUSIVE,
+            tl, ctx, lrt
+        );
+    }
+    if (!xwSame && !ywSame) {
+        w.intent(WO_E, tl, ctx, lrt);
+    }
+    //
+    localFuture = lrt->execute_task(ctx, tl);
+#else
+    const floatType b = betaScale
+                      ? beta * betaScale->get_result<floatType>(silenceWarnings)
+                      : beta;
+    floatType localResult = 0.0;
+    rc = ComputeWAXPBYDotKernel(n, alpha, x, b, y, w, localResult);
+    localFuture = Future::from_value(lrt, localResult);
+#endif
+    double t0 = mytimer();
+    resultFuture = allReduce(localFuture, dcReduceSum, ctx, lrt);
+    timeAllreduce += mytimer() - t0;
+    //
+    return rc;
+}
+
+/**
+ * Reproducible ComputeWAXPBYDot: w = alpha*x + beta*y, then the reproducible
+ * dot product (not fused, the exact sum needs its own pass).
+ */
+inline int
+ComputeWAXPBYDot(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    const Future *betaScale,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<ReproSumValue> > &dcReproSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    ComputeWAXPBY(n, alpha, x, beta, betaScale, y, w, ctx, lrt);
+    return ComputeDotProduct(
+               n, w, w, resultFuture, timeAllreduce, dcReproSum, ctx, lrt
+           );
+}
+
+/**
+ * Computes w = alpha*x + beta*y and starts the all reduce of w'w (returned in
+ * resultFuture).
+ */
+inline int
+ComputeWAXPBYDot(
+    const local_int_t n,
+    const floatType alpha,
+    Array<floatType> &x,
+    const floatType beta,
+    Array<floatType> &y,
+    Array<floatType> &w,
+    Future &resultFuture,
+    double &timeAllreduce,
+    Item< DynColl<floatType> > &dcReduceSum,
+    Context ctx,
+    Runtime *lrt
+) {
+    return ComputeWAXPBYDot(
+               n, alpha, x, beta, NULL, y, w,
+               resultFuture, timeAllreduce, dcReduceSum, ctx, lrt
+           );
+}
+
+/**
+ *
+ */
+floatType
+ComputeWAXPBYDotTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    const auto *const args = (ComputeWAXPBYArgs *)task->args;
+    //
+    int xRID = 0;
+    int yRID = 1;
+    int wRID = 2;
+    // Aliased regions.
+    if (2 == regions.size()) {
+        yRID = args->xySame ? 0 : 1;
+        wRID = args->xwSame ? 0 : 1;
+    }
+    //
+    Array<floatType> x(regions[xRID], ctx, lrt);
+    Array<floatType> y(regions[yRID], ctx, lrt);
+    Array<floatType> w(regions[wRID], ctx, lrt);
+    //
+    floatType wtw = 0.0;
+    ComputeWAXPBYDotKernel(
+        args->n, args->alpha, x, WAXPBYTaskBeta(args, task), y, w, wtw
+    );
+    //
+    return wtw;
 }
 
 /**
@@ -211,5 +553,34 @@ registerWAXPBYTasks(void)
         TaskConfigOptions(true /* leaf task */),
         "ComputeWAXPBYTask"
     );
+    HighLevelRuntime::register_legion_task<ComputeWAXPBYBlockTask>(
+        WAXPBY_BLOCK_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        false /* single */,
+        true /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYBlockTask"
+    );
+#ifdef LGNCG_USE_CUDA
+    HighLevelRuntime::register_legion_task<ComputeWAXPBYTaskGPU>(
+        WAXPBY_TID /* task id */,
+        Processor::TOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYTaskGPU"
+    );
+#endif
+    HighLevelRuntime::register_legion_task<floatType, ComputeWAXPBYDotTask>(
+        WAXPBY_DOT_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ComputeWAXPBYDotTask"
+    );
 #endif
 }
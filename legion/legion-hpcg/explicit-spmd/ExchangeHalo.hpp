@@ -48,114 +48,304 @@
 #include "LegionMatrices.hpp"
 #include "RegionToRegionCopy.hpp"
 
+#include <algorithm>
 #include <cstdlib>
+#include <cstring>
 
 #ifdef LGNCG_TASKING
 #define LGNCG_DO_TASKY_EXCHANGE
 #endif
 
-#ifdef LGNCG_DO_TASKY_EXCHANGE
 /**
- *
+ * Returns the logical region of x's private (non-ghost) sub-region.
  */
-struct ExchangeHaloArgs {
-    int nTxNeighbors;
-    int nRxNeighbors;
-};
+inline LogicalRegion
+GetPrivateLogicalRegion(
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    auto xis = x.logicalRegion.get_index_space();
+    auto xip = lrt->get_index_partition(ctx, xis, 0 /* color */);
+    auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
+    return lrt->get_logical_subregion_by_color(
+        ctx,
+        xlp,
+        DomainPoint::from_point<1>(0) // First is private.
+    );
+}
 
-/*
- * PhaseBarriers debug: -level barrier=2 -logfile barriers.log
+/**
+ * Returns the sub-region of lr that holds its first half (rounded up), which
+ * is where a narrow exchange puts its floats, two per floatType. The
+ * partition is made once per index space and kept in A.
  */
+inline LogicalRegion
+GetNarrowLogicalRegion(
+    SparseMatrix &A,
+    const LogicalRegion &lr,
+    Context ctx,
+    Runtime *lrt
+) {
+    const IndexSpace is = lr.get_index_space();
+    auto it = A.narrowHaloParts.find(is);
+    if (it == A.narrowHaloParts.end()) {
+        const Rect<1> bounds = lrt->get_index_space_domain(
+                                   ctx, is
+                               ).get_rect<1>();
+        const int64_t nNarrow = (bounds.volume() + 1) / 2;
+        const int64_t lo = bounds.lo.x[0];
+        Rect<1> colorBounds(Point<1>(0), Point<1>(0));
+        DomainColoring coloring;
+        coloring[0] = Domain::from_rect<1>(
+            Rect<1>(Point<1>(lo), Point<1>(lo + nNarrow - 1))
+        );
+        auto ip = lrt->create_index_partition(
+            ctx, is, Domain::from_rect<1>(colorBounds), coloring, true
+        );
+        it = A.narrowHaloParts.insert(std::make_pair(is, ip)).first;
+    }
+    auto lp = lrt->get_logical_partition(ctx, lr, it->second);
+    return lrt->get_logical_subregion_by_color(
+        ctx, lp, DomainPoint::from_point<1>(0)
+    );
+}
 
-/*!
-    Communicates data that is at the border of the part of the domain assigned to
-    this processor.
+/**
+ * Issues one of the plan's region-to-region copies from a neighbor's pull
+ * buffer into one of our ghost regions. The copy is performed by the
+ * runtime's DMA engine, so no copy task has to be scheduled. It waits on the
+ * neighbor's ready barrier and arrives on its done barrier. Only the barrier
+ * generations change between calls, so the launcher is reused as is.
+ */
+inline void
+IssueHaloCopy(
+    CopyLauncher &cl,
+    PhaseBarriers &neighborPBs,
+    Context ctx,
+    Runtime *lrt
+) {
+    cl.wait_barriers.clear();
+    cl.arrive_barriers.clear();
+    //
+    neighborPBs.ready = lrt->advance_phase_barrier(ctx, neighborPBs.ready);
+    cl.add_wait_barrier(neighborPBs.ready);
+    //
+    cl.add_arrival_barrier(neighborPBs.done);
+    neighborPBs.done = lrt->advance_phase_barrier(ctx, neighborPBs.done);
+    //
+    lrt->issue_copy_operation(ctx, cl);
+}
 
-    @param[in]    A The known system matrix
-    @param[inout] x On entry: the local vector entries followed by entries to be
-    communicated; on exit: the vector with non-local entries updated by other
-    processors
+/**
+ * Builds the launchers that ExchangeHalo uses for x and caches them in A. The
+ * first call for A also takes shard-local copies of its Synchronizers, which
+ * from then on are only advanced by ExchangeHalo. Must be called after
+ * SetupGhostArrays(A, x).
+ *
+ * With narrow, x's halo is exchanged as float: the pack task rounds the
+ * values into the first half of the pull buffers, only that half is copied,
+ * and a widen task expands it in place in x's ghost regions. That halves the
+ * halo volume, so it is for vectors only the MG preconditioner exchanges
+ * (--mg-halo=float). Needs the tasky exchange and a floatType twice the size
+ * of float; otherwise x is exchanged at full precision.
  */
 inline void
-ExchangeHalo(
+SetupHaloPlan(
     SparseMatrix &A,
     Array<floatType> &x,
     Context ctx,
-    Runtime *lrt
+    Runtime *lrt,
+    bool narrow = false
 ) {
-    // Extract Matrix pieces
     const SparseMatrixScalars *const Asclrs = A.sclrs->data();
+    assert(Asclrs);
     const int nTxNeighbors = Asclrs->numberOfSendNeighbors;
     const int nRxNeighbors = Asclrs->numberOfRecvNeighbors;
     const int *const neighbors = A.neighbors->data();
     // Nothing to do.
     if (nTxNeighbors == 0) return;
-    // Make sure that x's ghosts are already setup.
-    if (!x.hasGhosts()) {
-        assert(false && "x does not have ghost regions setup.");
+    //
+    assert(x.hasGhosts());
+    assert(A.haloPlans.find(x.logicalRegion) == A.haloPlans.end());
+    //
+    if (A.haloNeighborPBs.empty()) {
+        const Synchronizers *const syncs = A.synchronizers->data();
+        assert(syncs);
+        A.haloPBs = syncs->mine;
+        A.haloNeighborPBs.assign(
+            syncs->neighbors, syncs->neighbors + nTxNeighbors
+        );
     }
-    ExchangeHaloArgs args {
+    //
+    HaloPlan &plan = A.haloPlans[x.logicalRegion];
+#ifdef LGNCG_DO_TASKY_EXCHANGE
+    plan.narrow = narrow && sizeof(floatType) == 2 * sizeof(float);
+#endif
+    plan.args = {
         .nTxNeighbors = nTxNeighbors,
-        .nRxNeighbors = nRxNeighbors
+        .nRxNeighbors = nRxNeighbors,
+        .narrow       = plan.narrow
     };
-    TaskLauncher tl(
+#ifdef LGNCG_DO_TASKY_EXCHANGE
+    plan.pack = TaskLauncher(
         EXCHANGE_HALO_TID,
-        TaskArgument(&args, sizeof(args))
+        TaskArgument(&plan.args, sizeof(plan.args))
     );
-    LogicalRegion xPrivateLR;
-    {
-        auto xis = x.logicalRegion.get_index_space();
-        auto xip = lrt->get_index_partition(ctx, xis, 0 /* color */);
-        auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
-        xPrivateLR = lrt->get_logical_subregion_by_color(
-            ctx,
-            xlp,
-            DomainPoint::from_point<1>(0) // First is private.
-        );
-    }
     // x (private partition).
     RegionRequirement xrr(
-        xPrivateLR, RO_E, x.logicalRegion
+        GetPrivateLogicalRegion(x, ctx, lrt), RO_E, x.logicalRegion
     );
-    tl.add_region_requirement(xrr).add_field(x.fid);
+    plan.pack.add_region_requirement(xrr).add_field(x.fid);
     // Matrix pieces.
-    A.neighbors->intent(RO_E, tl, ctx, lrt);
-    A.elementsToSend->intent(RO_E, tl, ctx, lrt);
-    A.sendLength->intent(RO_E, tl, ctx, lrt);
-    A.synchronizers->intent(RW_E, tl, ctx, lrt);
+    A.elementsToSend->intent(RO_E, plan.pack, ctx, lrt);
+    A.sendLength->intent(RO_E, plan.pack, ctx, lrt);
     // Pull Buffers.
     for (int n = 0; n < nTxNeighbors; ++n) {
-        A.pullBuffers[n]->intent(RW_E, tl, ctx, lrt);
+        A.pullBuffers[n]->intent(RW_E, plan.pack, ctx, lrt);
     }
-    // Pull regions in neighbor order.
-    for (int n = 0; n < nRxNeighbors; ++n) {
+    // x's ghost regions, after the copies into them.
+    if (plan.narrow) {
+        plan.widen = TaskLauncher(EXCHANGE_HALO_WIDEN_TID, TaskArgument());
+        for (int n = 0; n < nTxNeighbors; ++n) {
+            RegionRequirement grr(
+                x.ghosts[n]->logicalRegion, RW_E, x.logicalRegion
+            );
+            plan.widen.add_region_requirement(grr).add_field(x.fid);
+        }
+    }
+#endif
+    //
+    plan.copies.resize(nTxNeighbors);
+    for (int n = 0; n < nTxNeighbors; ++n) {
         const int nid = neighbors[n];
+        // Source
         auto srcIt = A.nidToPullRegion.find(nid);
         assert(srcIt != A.nidToPullRegion.end());
         auto srclr = srcIt->second.get_logical_region();
-        //
+        // A narrow exchange only copies the first half.
         RegionRequirement srcrr(
-            srclr, RO_E, srclr
+            plan.narrow ? GetNarrowLogicalRegion(A, srclr, ctx, lrt) : srclr,
+            RO_E,
+            srclr
         );
-        static const int fid = 0;
-        tl.add_region_requirement(srcrr).add_field(fid);
-    }
-    for (int n = 0; n < nTxNeighbors; ++n) {
+        // Only ever one field for all of our structures.
+        static const int srcFid = 0;
+        srcrr.add_field(srcFid);
+        // Destination.
         LogicalArray<floatType> *dstArray = x.ghosts[n];
         assert(dstArray->hasParentLogicalRegion());
+        //
         RegionRequirement dstrr(
-            dstArray->logicalRegion,
+            plan.narrow
+                ? GetNarrowLogicalRegion(A, dstArray->logicalRegion, ctx, lrt)
+                : dstArray->logicalRegion,
             WO_E,
             dstArray->getParentLogicalRegion()
         );
-        tl.add_region_requirement(dstrr).add_field(dstArray->fid);
+        dstrr.add_field(dstArray->fid);
+        //
+        plan.copies[n].add_copy_requirements(srcrr, dstrr);
     }
+}
+
+/**
+ * Returns the plan SetupHaloPlan built for x.
+ */
+inline HaloPlan &
+GetHaloPlan(
+    SparseMatrix &A,
+    Array<floatType> &x
+) {
+    // Make sure that x's ghosts are already setup.
+    if (!x.hasGhosts()) {
+        assert(false && "x does not have ghost regions setup.");
+    }
+    auto planIt = A.haloPlans.find(x.logicalRegion);
+    if (planIt == A.haloPlans.end()) {
+        assert(false && "x does not have a halo plan setup.");
+    }
+    return planIt->second;
+}
+
+/**
+ * Stores the advanced shard-local PhaseBarriers of A and all coarser levels
+ * back into their Synchronizers, so that a later benchmark run over the same
+ * regions starts at the generation this one stopped at.
+ */
+inline void
+SaveHaloBarriers(
+    SparseMatrix &A
+) {
+    for (SparseMatrix *curLevelMatrix = &A;
+         curLevelMatrix; curLevelMatrix = curLevelMatrix->Ac) {
+        SparseMatrix &L = *curLevelMatrix;
+        // No plan: the barriers were never advanced.
+        if (L.haloNeighborPBs.empty()) continue;
+        //
+        Synchronizers *const syncs = L.synchronizers->data();
+        assert(syncs);
+        syncs->mine = L.haloPBs;
+        std::copy(
+            L.haloNeighborPBs.begin(), L.haloNeighborPBs.end(),
+            syncs->neighbors
+        );
+    }
+}
+
+#ifdef LGNCG_DO_TASKY_EXCHANGE
+/*
+ * PhaseBarriers debug: -level barrier=2 -logfile barriers.log
+ */
+
+/*!
+    Communicates data that is at the border of the part of the domain assigned to
+    this processor.
+
+    @param[in]    A The known system matrix
+    @param[inout] x On entry: the local vector entries followed by entries to be
+    communicated; on exit: the vector with non-local entries updated by other
+    processors
+ */
+inline void
+ExchangeHalo(
+    SparseMatrix &A,
+    Array<floatType> &x,
+    Context ctx,
+    Runtime *lrt
+) {
+    // Extract Matrix pieces
+    const SparseMatrixScalars *const Asclrs = A.sclrs->data();
+    const int nTxNeighbors = Asclrs->numberOfSendNeighbors;
+    // Nothing to do.
+    if (nTxNeighbors == 0) return;
+    //
+    HaloPlan &plan = GetHaloPlan(A, x);
+    PhaseBarriers &myPBs = A.haloPBs;
+    // The pack task waits until our neighbors are done pulling from the last
+    // exchange and signals that the pull buffers are ready once it completes.
+    TaskLauncher &tl = plan.pack;
+    tl.wait_barriers.clear();
+    tl.arrive_barriers.clear();
+    //
+    tl.add_wait_barrier(myPBs.done);
+    myPBs.done = lrt->advance_phase_barrier(ctx, myPBs.done);
+    //
+    tl.add_arrival_barrier(myPBs.ready);
+    myPBs.ready = lrt->advance_phase_barrier(ctx, myPBs.ready);
     //
     lrt->execute_task(ctx, tl);
+    //
+    for (int n = 0; n < nTxNeighbors; ++n) {
+        IssueHaloCopy(plan.copies[n], A.haloNeighborPBs[n], ctx, lrt);
+    }
+    // The ghost regions now start with floats.
+    if (plan.narrow) lrt->execute_task(ctx, plan.widen);
 }
 
 /**
- *
+ * Fills up the pull buffers (the buffers that neighboring tasks will pull
+ * from). Synchronization is attached to the launch, see ExchangeHalo.
  */
 void
 ExchangeHaloTask(
@@ -166,17 +356,13 @@ ExchangeHaloTask(
 ) {
     const auto *const args = (ExchangeHaloArgs *)task->args;
     const int nTxNeighbors = args->nTxNeighbors;
-    const int nRxNeighbors = args->nRxNeighbors;
+    LGNCG_PROFILE(EXCHANGE_HALO_TID, 0);
     int rid = 0;
     // x
     Array<floatType> x(regions[rid++], ctx, lrt);
     const floatType *const xv = x.data();
     assert(xv);
     // Matrix pieces.
-    Array<int> Aneighbors(regions[rid++], ctx, lrt);
-    const int *const neighbors = Aneighbors.data();
-    assert(neighbors);
-    //
     Array<local_int_t> AelementsToSend(regions[rid++], ctx, lrt);
     const local_int_t *const elementsToSend = AelementsToSend.data();
     assert(elementsToSend);
@@ -185,76 +371,50 @@ ExchangeHaloTask(
     const local_int_t *const sendLengthsd = AsendLength.data();
     assert(sendLengthsd);
     //
-    Array<Synchronizers> Asyncs(regions[rid++], ctx, lrt);
-    Synchronizers *syncs = Asyncs.data();
-    assert(syncs);
-    PhaseBarriers &myPBs = syncs->mine;
-    //
-    std::vector<Array<floatType> *> ApullBuffers;
-    for (int n = 0; n < nTxNeighbors; ++n) {
-        auto *item = new Array<floatType>(regions[rid++], ctx, lrt);
-        assert(item->data());
-        ApullBuffers.push_back(item);
-    }
-    std::vector<LogicalRegion> srclrs;
-    for (int n = 0; n < nRxNeighbors; ++n) {
-        srclrs.push_back(regions[rid++].get_logical_region());
-    }
-    std::vector<LogicalRegion> dstlrs;
-    for (int n = 0; n < nRxNeighbors; ++n) {
-        dstlrs.push_back(regions[rid++].get_logical_region());
-    }
-    //
-    myPBs.done.wait();
-    myPBs.done = lrt->advance_phase_barrier(ctx, myPBs.done);
-    // Fill up pull buffers (the buffers that neighboring task will pull from).
     for (int n = 0, txidx = 0; n < nTxNeighbors; ++n) {
-        floatType *const pbd = ApullBuffers[n]->data();
+        Array<floatType> pullBuffer(regions[rid++], ctx, lrt);
+        floatType *const pbd = pullBuffer.data();
+        assert(pbd);
         //
+        if (args->narrow) {
+            // Floats back to back from the start of the buffer.
+            char *const pbb = reinterpret_cast<char *>(pbd);
+            for (int i = 0; i < sendLengthsd[n]; ++i) {
+                const float v = float(xv[elementsToSend[txidx++]]);
+                memcpy(pbb + i * sizeof(float), &v, sizeof(float));
+            }
+            continue;
+        }
         for (int i = 0; i < sendLengthsd[n]; ++i) {
             pbd[i] = xv[elementsToSend[txidx++]];
         }
     }
-    myPBs.ready.arrive(1);
-    myPBs.ready = lrt->advance_phase_barrier(ctx, myPBs.ready);
-    lrt->unmap_all_regions(ctx);
-    //
-    for (int n = 0; n < nTxNeighbors; ++n) {
-        static const int fid = 0;
-        // Source region requirement.
-        RegionRequirement srcrr(
-            srclrs[n], RO_E, srclrs[n]
-        );
-        srcrr.add_field(fid);
-        // Destination region requirement.
-        //
-        RegionRequirement dstrr(
-            dstlrs[n], WO_E, dstlrs[n]
-        );
-        dstrr.add_field(fid);
-        //
-        TaskLauncher tl(
-            REGION_TO_REGION_COPY_TID,
-            TaskArgument(NULL, 0)
-        );
-        tl.add_region_requirement(srcrr);
-        tl.add_region_requirement(dstrr);
-        //
-        syncs->neighbors[n].ready = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].ready
-        );
-        tl.add_wait_barrier(syncs->neighbors[n].ready);
-        //
-        tl.add_arrival_barrier(syncs->neighbors[n].done);
-        syncs->neighbors[n].done = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].done
-        );
+}
+
+/**
+ * Expands the floats a narrow exchange copied into the start of each ghost
+ * region to floatType, in place. Going from the back, element i only
+ * overwrites floats 2i and 2i + 1, which were already read.
+ */
+void
+ExchangeHaloWidenTask(
+    const Task *task,
+    const std::vector<PhysicalRegion> &regions,
+    Context ctx,
+    Runtime *lrt
+) {
+    LGNCG_PROFILE(EXCHANGE_HALO_WIDEN_TID, 0);
+    for (size_t rid = 0; rid < regions.size(); ++rid) {
+        Array<floatType> ghost(regions[rid], ctx, lrt);
+        floatType *const gd = ghost.data();
+        assert(gd);
+        const char *const gb = reinterpret_cast<const char *>(gd);
         //
-        lrt->execute_task(ctx, tl);
-    }
-    // Cleanup
-    for (int n = 0; n < nTxNeighbors; ++n) {
-        delete ApullBuffers[n];
+        for (int64_t i = int64_t(ghost.length()) - 1; i >= 0; --i) {
+            float v;
+            memcpy(&v, gb + i * sizeof(float), sizeof(float));
+            gd[i] = v;
+        }
     }
 }
 #endif
@@ -272,9 +432,18 @@ registerExchangeHaloTasks(void)
         true /* single */,
         false /* index */,
         AUTO_GENERATE_ID,
-        TaskConfigOptions(false /* leaf task */),
+        TaskConfigOptions(true /* leaf task */),
         "ExchangeHaloTask"
     );
+    HighLevelRuntime::register_legion_task<ExchangeHaloWidenTask>(
+        EXCHANGE_HALO_WIDEN_TID /* task id */,
+        Processor::LOC_PROC /* proc kind  */,
+        true /* single */,
+        false /* index */,
+        AUTO_GENERATE_ID,
+        TaskConfigOptions(true /* leaf task */),
+        "ExchangeHaloWidenTask"
+    );
 #endif
 }
 
@@ -293,22 +462,20 @@ ExchangeHalo(
     // Nothing to do.
     if (nNeighbors == 0) return;
     // Else we have neighbors and data to move around.
-    const int *const neighbors = A.neighbors->data();
+    HaloPlan &plan = GetHaloPlan(A, x);
     // Non-region memory populated during SetupHalo().
     const local_int_t *const elementsToSend = A.elementsToSend->data();
     assert(elementsToSend);
-    // Setup ghost regions if not already there.
-    if (!x.hasGhosts()) {
-        assert(false && "x does not have ghost regions setup.");
-    }
     //
     const floatType *const xv = x.data();
     assert(xv);
     //
-    Synchronizers *syncs = A.synchronizers->data();
-    PhaseBarriers &myPBs = syncs->mine;
+    PhaseBarriers &myPBs = A.haloPBs;
     //
-    myPBs.done.wait();
+    {
+        LGNCG_PROFILE(LGNCG_PB_WAIT_PID, 0);
+        myPBs.done.wait();
+    }
     myPBs.done = lrt->advance_phase_barrier(ctx, myPBs.done);
     // Fill up pull buffers (the buffers that neighboring task will pull from).
     const local_int_t *const sendLengthsd = A.sendLength->data();
@@ -326,48 +493,7 @@ ExchangeHalo(
     myPBs.ready = lrt->advance_phase_barrier(ctx, myPBs.ready);
     //
     for (int n = 0; n < nNeighbors; ++n) {
-        //
-        const int nid = neighbors[n];
-        // Source
-        auto srcIt = A.nidToPullRegion.find(nid);
-        assert(srcIt != A.nidToPullRegion.end());
-        auto srclr = srcIt->second.get_logical_region();
-        //
-        RegionRequirement srcrr(
-            srclr, RO_E, srclr
-        );
-        // Only ever one field for all of our structures.
-        static const int srcFid = 0;
-        srcrr.add_field(srcFid);
-        // Destination.
-        LogicalArray<floatType> *dstArray = x.ghosts[n];
-        assert(dstArray->hasParentLogicalRegion());
-        //
-        RegionRequirement dstrr(
-            dstArray->logicalRegion,
-            WO_E,
-            dstArray->getParentLogicalRegion()
-        );
-        dstrr.add_field(dstArray->fid);
-        //
-        TaskLauncher tl(
-            REGION_TO_REGION_COPY_TID,
-            TaskArgument(NULL, 0)
-        );
-        tl.add_region_requirement(srcrr);
-        tl.add_region_requirement(dstrr);
-        //
-        syncs->neighbors[n].ready = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].ready
-        );
-        tl.add_wait_barrier(syncs->neighbors[n].ready);
-        //
-        tl.add_arrival_barrier(syncs->neighbors[n].done);
-        syncs->neighbors[n].done = lrt->advance_phase_barrier(
-            ctx, syncs->neighbors[n].done
-        );
-        //
-        lrt->execute_task(ctx, tl);
+        IssueHaloCopy(plan.copies[n], A.haloNeighborPBs[n], ctx, lrt);
     }
 }
 #endif
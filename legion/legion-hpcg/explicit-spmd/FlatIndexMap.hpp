@@ -0,0 +1,128 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file FlatIndexMap.hpp
+
+    A sorted-vector replacement for std::map in index lookups during setup.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <cassert>
+
+/**
+ * Maps KEYs to VALUEs using a single contiguous, sorted array. Entries are
+ * appended with insert() and must be finalize()d before lookups.
+ */
+template <typename KEY, typename VALUE>
+class FlatIndexMap {
+    //
+    using Entry = std::pair<KEY, VALUE>;
+    //
+    std::vector<Entry> mEntries;
+    //
+    bool mFinalized = true;
+
+public:
+    /**
+     *
+     */
+    void
+    reserve(size_t n) {
+        mEntries.reserve(n);
+    }
+
+    /**
+     *
+     */
+    void
+    clear(void) {
+        mEntries.clear();
+        mFinalized = true;
+    }
+
+    /**
+     * Appends an entry. Keys must be unique.
+     */
+    void
+    insert(
+        const KEY &key,
+        const VALUE &value
+    ) {
+        if (mFinalized && !mEntries.empty() && !(mEntries.back().first < key)) {
+            // Out of order insertion, so we'll need to sort.
+            mFinalized = false;
+        }
+        mEntries.push_back(Entry(key, value));
+    }
+
+    /**
+     * Sorts the entries (a no-op if they were inserted in key order).
+     */
+    void
+    finalize(void) {
+        if (!mFinalized) {
+            std::sort(
+                mEntries.begin(), mEntries.end(),
+                [](const Entry &a, const Entry &b) {
+                    return a.first < b.first;
+                }
+            );
+            mFinalized = true;
+        }
+    }
+
+    /**
+     * Returns the value for key, which must be present.
+     */
+    VALUE
+    operator[](const KEY &key) const {
+        assert(mFinalized);
+        const auto it = std::lower_bound(
+            mEntries.begin(), mEntries.end(), key,
+            [](const Entry &a, const KEY &k) {
+                return a.first < k;
+            }
+        );
+        assert(it != mEntries.end() && it->first == key);
+        return it->second;
+    }
+
+    /**
+     *
+     */
+    size_t
+    size(void) const {
+        return mEntries.size();
+    }
+};
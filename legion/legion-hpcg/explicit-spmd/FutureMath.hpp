@@ -37,7 +37,8 @@
 
 enum FutureMathOp {
     FMO_DIV,
-    FMO_SQRT
+    FMO_SQRT,
+    FMO_ADD
 };
 
 /**
@@ -66,6 +67,7 @@ ComputeFutureKernel(
     switch (op) {
         case FMO_DIV:  return  av / bv;
         case FMO_SQRT: return  sqrt(av);
+        case FMO_ADD:  return  av + bv;
         default: exit(1);
     }
     //
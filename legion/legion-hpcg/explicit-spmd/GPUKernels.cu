@@ -0,0 +1,350 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file GPUKernels.cu
+
+    CUDA kernels behind GPUKernels.hpp. Built only when USE_CUDA=1.
+ */
+
+#include "GPUKernels.hpp"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include <cuda_runtime.h>
+
+#define LGNCG_CUDA_THREADS 256
+// Upper bound on the number of blocks (and partial sums) used by GPUComputeDot.
+#define LGNCG_CUDA_DOT_BLOCKS 1024
+
+#define LGNCG_CUDA_CHECK(call)                                                 \
+do {                                                                           \
+    const cudaError_t err = (call);                                            \
+    if (err != cudaSuccess) {                                                  \
+        fprintf(stderr, "%s:%d: CUDA error: %s\n",                             \
+                __FILE__, __LINE__, cudaGetErrorString(err));                  \
+        abort();                                                               \
+    }                                                                          \
+} while (0)
+
+/**
+ *
+ */
+static inline int
+nBlocks(
+    int n
+) {
+    return (n + LGNCG_CUDA_THREADS - 1) / LGNCG_CUDA_THREADS;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename MT>
+__global__ void
+spmvKernel(
+    const MT *__restrict__ matrixValues,
+    const int *__restrict__ mtxIndL,
+    const char *__restrict__ nonzerosInRow,
+    const double *__restrict__ x,
+    double *__restrict__ y,
+    int nrow,
+    int nzpr
+) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= nrow) return;
+    //
+    const MT *const curVals = matrixValues + size_t(i) * nzpr;
+    const int *const curInds = mtxIndL + size_t(i) * nzpr;
+    const int curNNZ = nonzerosInRow[i];
+    //
+    double sum = 0.0;
+    for (int j = 0; j < curNNZ; j++) {
+        sum += curVals[j] * x[curInds[j]];
+    }
+    y[i] = sum;
+}
+
+/**
+ *
+ */
+template <typename MT>
+static void
+launchSPMV(
+    const MT *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *x,
+    double *y,
+    int nrow,
+    int nzpr
+) {
+    if (nrow == 0) return;
+    spmvKernel<MT><<<nBlocks(nrow), LGNCG_CUDA_THREADS>>>(
+        matrixValues, mtxIndL, nonzerosInRow, x, y, nrow, nzpr
+    );
+    LGNCG_CUDA_CHECK(cudaGetLastError());
+}
+
+void
+GPUComputeSPMV(
+    const double *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *x,
+    double *y,
+    int nrow,
+    int nzpr
+) {
+    launchSPMV(matrixValues, mtxIndL, nonzerosInRow, x, y, nrow, nzpr);
+}
+
+void
+GPUComputeSPMV(
+    const float *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *x,
+    double *y,
+    int nrow,
+    int nzpr
+) {
+    launchSPMV(matrixValues, mtxIndL, nonzerosInRow, x, y, nrow, nzpr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+dotKernel(
+    const double *__restrict__ x,
+    const double *__restrict__ y,
+    int n,
+    double *__restrict__ partials
+) {
+    __shared__ double sums[LGNCG_CUDA_THREADS];
+    //
+    double sum = 0.0;
+    for (int i = blockIdx.x * blockDim.x + threadIdx.x;
+         i < n; i += blockDim.x * gridDim.x) {
+        sum += x[i] * y[i];
+    }
+    sums[threadIdx.x] = sum;
+    __syncthreads();
+    //
+    for (int s = blockDim.x / 2; s > 0; s >>= 1) {
+        if (threadIdx.x < s) sums[threadIdx.x] += sums[threadIdx.x + s];
+        __syncthreads();
+    }
+    if (threadIdx.x == 0) partials[blockIdx.x] = sums[0];
+}
+
+double
+GPUComputeDot(
+    const double *x,
+    const double *y,
+    int n
+) {
+    if (n == 0) return 0.0;
+    // One scratch buffer per GPU processor thread, reused across calls.
+    static thread_local double *dPartials = nullptr;
+    if (!dPartials) {
+        LGNCG_CUDA_CHECK(
+            cudaMalloc(&dPartials, LGNCG_CUDA_DOT_BLOCKS * sizeof(double))
+        );
+    }
+    //
+    int blocks = nBlocks(n);
+    if (blocks > LGNCG_CUDA_DOT_BLOCKS) blocks = LGNCG_CUDA_DOT_BLOCKS;
+    //
+    dotKernel<<<blocks, LGNCG_CUDA_THREADS>>>(x, y, n, dPartials);
+    LGNCG_CUDA_CHECK(cudaGetLastError());
+    //
+    double partials[LGNCG_CUDA_DOT_BLOCKS];
+    LGNCG_CUDA_CHECK(
+        cudaMemcpy(
+            partials, dPartials, blocks * sizeof(double),
+            cudaMemcpyDeviceToHost
+        )
+    );
+    double result = 0.0;
+    for (int b = 0; b < blocks; ++b) result += partials[b];
+    //
+    return result;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+__global__ void
+waxpbyKernel(
+    int n,
+    double alpha,
+    const double *x,
+    double beta,
+    const double *y,
+    double *w
+) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= n) return;
+    //
+    w[i] = alpha * x[i] + beta * y[i];
+}
+
+void
+GPUComputeWAXPBY(
+    int n,
+    double alpha,
+    const double *x,
+    double beta,
+    const double *y,
+    double *w
+) {
+    if (n == 0) return;
+    waxpbyKernel<<<nBlocks(n), LGNCG_CUDA_THREADS>>>(n, alpha, x, beta, y, w);
+    LGNCG_CUDA_CHECK(cudaGetLastError());
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+template <typename MT>
+__global__ void
+symgsColorKernel(
+    const MT *__restrict__ matrixValues,
+    const int *__restrict__ mtxIndL,
+    const char *__restrict__ nonzerosInRow,
+    const double *__restrict__ matrixDiagonal,
+    const int *__restrict__ colorRows,
+    int cBegin,
+    int cEnd,
+    const double *__restrict__ r,
+    double *x,
+    int nzpr
+) {
+    const int c = cBegin + blockIdx.x * blockDim.x + threadIdx.x;
+    if (c >= cEnd) return;
+    //
+    const int i = colorRows[c];
+    const MT *const curVals = matrixValues + size_t(i) * nzpr;
+    const int *const curInds = mtxIndL + size_t(i) * nzpr;
+    const int curNNZ = nonzerosInRow[i];
+    const double curDiagonal = matrixDiagonal[i];
+    //
+    double sum = r[i];
+    for (int j = 0; j < curNNZ; j++) {
+        sum -= curVals[j] * x[curInds[j]];
+    }
+    // Remove diagonal contribution from previous loop.
+    sum += x[i] * curDiagonal;
+    x[i] = sum / curDiagonal;
+}
+
+/**
+ * Rows of one color are independent, so the launches of consecutive colors
+ * only need to be ordered with respect to each other, which the stream does.
+ */
+template <typename MT>
+static void
+launchSYMGSMC(
+    const MT *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *matrixDiagonal,
+    const int *colorRows,
+    const int *colorPtr,
+    int nColors,
+    const double *r,
+    double *x,
+    int nzpr
+) {
+    auto sweepColor = [&](int color) {
+        const int cBegin = colorPtr[color];
+        const int cEnd = colorPtr[color + 1];
+        if (cEnd <= cBegin) return;
+        symgsColorKernel<MT><<<nBlocks(cEnd - cBegin), LGNCG_CUDA_THREADS>>>(
+            matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+            colorRows, cBegin, cEnd, r, x, nzpr
+        );
+        LGNCG_CUDA_CHECK(cudaGetLastError());
+    };
+    //
+    for (int color = 0; color < nColors; ++color) sweepColor(color);
+    // Now the back sweep.
+    for (int color = nColors - 1; color >= 0; --color) sweepColor(color);
+}
+
+void
+GPUComputeSYMGSMC(
+    const double *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *matrixDiagonal,
+    const int *colorRows,
+    const int *colorPtr,
+    int nColors,
+    const double *r,
+    double *x,
+    int nzpr
+) {
+    launchSYMGSMC(
+        matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+        colorRows, colorPtr, nColors, r, x, nzpr
+    );
+}
+
+void
+GPUComputeSYMGSMC(
+    const float *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *matrixDiagonal,
+    const int *colorRows,
+    const int *colorPtr,
+    int nColors,
+    const double *r,
+    double *x,
+    int nzpr
+) {
+    launchSYMGSMC(
+        matrixValues, mtxIndL, nonzerosInRow, matrixDiagonal,
+        colorRows, colorPtr, nColors, r, x, nzpr
+    );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+void
+GPUCopyToHost(
+    int *dst,
+    const int *src,
+    int n
+) {
+    LGNCG_CUDA_CHECK(
+        cudaMemcpy(dst, src, n * sizeof(int), cudaMemcpyDeviceToHost)
+    );
+}
@@ -0,0 +1,140 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file GPUKernels.hpp
+
+    Host entry points for the CUDA kernels used by the TOC_PROC task variants
+    (LGNCG_USE_CUDA). All pointers are device pointers into framebuffer
+    instances. Kernels are launched on the calling GPU task's stream.
+
+    Types are spelled out instead of using Types.hpp, which pulls in legion.h.
+    The task variants pass floatType, mgFloatType, and local_int_t pointers
+    straight through, so a change to those types will not compile until the
+    kernels are updated to match.
+ */
+
+#pragma once
+
+/**
+ * y = Ax for the ELL-like (nrow x nzpr) layout used by SparseMatrix.
+ */
+void
+GPUComputeSPMV(
+    const double *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *x,
+    double *y,
+    int nrow,
+    int nzpr
+);
+
+/**
+ * Same as above with reduced precision matrix values.
+ */
+void
+GPUComputeSPMV(
+    const float *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *x,
+    double *y,
+    int nrow,
+    int nzpr
+);
+
+/**
+ * Returns x'y. Blocks produce partial sums that are added on the host, which
+ * also synchronizes with the task's stream.
+ */
+double
+GPUComputeDot(
+    const double *x,
+    const double *y,
+    int n
+);
+
+/**
+ * w = alpha * x + beta * y. Any of x, y, and w may alias.
+ */
+void
+GPUComputeWAXPBY(
+    int n,
+    double alpha,
+    const double *x,
+    double beta,
+    const double *y,
+    double *w
+);
+
+/**
+ * Multicolor symmetric Gauss-Seidel sweep, one kernel launch per color.
+ * colorPtr is a host copy of the nColors + 1 color offsets into colorRows.
+ */
+void
+GPUComputeSYMGSMC(
+    const double *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *matrixDiagonal,
+    const int *colorRows,
+    const int *colorPtr,
+    int nColors,
+    const double *r,
+    double *x,
+    int nzpr
+);
+
+/**
+ * Same as above with reduced precision matrix values.
+ */
+void
+GPUComputeSYMGSMC(
+    const float *matrixValues,
+    const int *mtxIndL,
+    const char *nonzerosInRow,
+    const double *matrixDiagonal,
+    const int *colorRows,
+    const int *colorPtr,
+    int nColors,
+    const double *r,
+    double *x,
+    int nzpr
+);
+
+/**
+ * Copies n ints from device memory to host memory.
+ */
+void
+GPUCopyToHost(
+    int *dst,
+    const int *src,
+    int n
+);
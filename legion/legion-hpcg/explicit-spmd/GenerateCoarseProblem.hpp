@@ -108,6 +108,7 @@ GenerateCoarseProblemTopLevel(
         nyc,
         nzc,
         Af.geom->stencilSize,
+        Af.geom->nbx * Af.geom->nby * Af.geom->nbz,
         geomc
     );
     //
@@ -158,6 +159,7 @@ GenerateCoarseProblem(
         nyc,
         nzc,
         AfGeom->stencilSize,
+        AfGeom->nbx * AfGeom->nby * AfGeom->nbz,
         Af.Ac->geom->data()
     );
     //
@@ -186,6 +188,9 @@ f2cOperatorPopulate(
     //
     local_int_t *f2cOperator = Af.mgData->f2cOperator->data();
     assert(f2cOperator);
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
     for (local_int_t izc = 0; izc < nzc; ++izc) {
         local_int_t izf = 2 * izc;
         for (local_int_t iyc = 0; iyc < nyc; ++iyc) {
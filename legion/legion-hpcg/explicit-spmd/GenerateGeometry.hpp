@@ -28,16 +28,18 @@
 
 /*!
     Computes the factorization of the total number of processes into a
-    3-dimensional process grid that is as close as possible to a cube. The
-    quality of the factorization depends on the prime number structure of the
-    total number of processes. It then stores this decompostion together with
-    the parallel parameters of the run in the geometry data structure.
+    3-dimensional process grid and groups the processes of each node into a
+    brick of the grid, so that as many halo neighbors as possible share a node
+    (see ComputeTopologyAwareShapeXYZ). It then stores this decompostion
+    together with the parallel parameters of the run in the geometry data
+    structure.
 
     @param[in]  size total number of MPI processes
     @param[in]  rank this process' rank among other MPI processes
     @param[in]  numThreads number of OpenMP threads in this process
     @param[in]  nx, ny, nz number of grid points for each local block in the x,
                 y, and z dimensions, respectively
+    @param[in]  shardsPerNode number of consecutive ranks placed on one node
     @param[out] geom data structure that will store the above parameters and the
     factoring of total number of processes into three dimensions
 */
@@ -50,17 +52,25 @@ GenerateGeometry(
     int ny,
     int nz,
     int stencilSize,
+    int shardsPerNode,
     Geometry *geom
 ) {
     using namespace std;
 
-    int npx, npy, npz;
+    int npx, npy, npz, nbx, nby, nbz;
     //
-    ComputeOptimalShapeXYZ(size, npx, npy, npz);
+    ComputeTopologyAwareShapeXYZ(
+        size, nx, ny, nz, shardsPerNode, npx, npy, npz, nbx, nby, nbz
+    );
+    geom->npx = npx;
+    geom->npy = npy;
+    geom->npz = npz;
+    geom->nbx = nbx;
+    geom->nby = nby;
+    geom->nbz = nbz;
     // Now compute this process's indices in the 3D cube
-    int ipz = rank / (npx * npy);
-    int ipy = (rank - ipz * npx * npy) / npx;
-    int ipx = rank % npx;
+    int ipx, ipy, ipz;
+    ComputeProcessXYZOfRank(*geom, rank, ipx, ipy, ipz);
 #if 0
     cout << "size = "<< size << endl
          << "nx  = " << nx << endl
@@ -83,9 +93,6 @@ GenerateGeometry(
     geom->nx = nx;
     geom->ny = ny;
     geom->nz = nz;
-    geom->npx = npx;
-    geom->npy = npy;
-    geom->npz = npz;
     geom->stencilSize = stencilSize;
     geom->ipx = ipx;
     geom->ipy = ipy;
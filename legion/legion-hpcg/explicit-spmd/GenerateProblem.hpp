@@ -185,7 +185,11 @@ GenerateProblem(
     }
     //
     global_int_t localNumberOfNonzeros = 0;
-    //
+    // Rows only write their own entries, so z-planes are generated
+    // concurrently when compiled with -fopenmp.
+#ifdef _OPENMP
+    #pragma omp parallel for reduction(+:localNumberOfNonzeros)
+#endif
     for (local_int_t iz = 0; iz < nz; iz++) {
         global_int_t giz = ipz * nz + iz;
         for (local_int_t iy = 0; iy < ny; iy++) {
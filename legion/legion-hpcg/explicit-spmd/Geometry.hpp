@@ -69,9 +69,73 @@ struct Geometry_STRUCT {
     int ipx;  //!< Current rank's x location in the npx by npy by npz processor grid
     int ipy;  //!< Current rank's y location in the npx by npy by npz processor grid
     int ipz;  //!< Current rank's z location in the npx by npy by npz processor grid
+    int nbx;  //!< Number of processors in x-direction on one node (brick)
+    int nby;  //!< Number of processors in y-direction on one node (brick)
+    int nbz;  //!< Number of processors in z-direction on one node (brick)
 };
 typedef struct Geometry_STRUCT Geometry;
 
+/*!
+  Returns the rank at (ipx, ipy, ipz) in the processor grid. Ranks are
+  numbered brick by brick (nbx by nby by nbz processors each, x fastest), so
+  consecutive ranks, which the mapper places on the same node, form a brick.
+  With 1 by 1 by 1 bricks this is the usual x fastest rank order.
+
+  @param[in] geom  The description of the problem's geometry.
+  @param[in] ipx, ipy, ipz The processor grid location
+
+  @return Returns the MPI rank of the process at that location
+*/
+inline int
+ComputeRankOfProcessXYZ(
+    const Geometry &geom,
+    int ipx,
+    int ipy,
+    int ipz
+) {
+    int nBricksX = geom.npx/geom.nbx;
+    int nBricksY = geom.npy/geom.nby;
+    int brick = ipx/geom.nbx+(ipy/geom.nby)*nBricksX
+              + (ipz/geom.nbz)*nBricksX*nBricksY;
+    int inBrick = ipx%geom.nbx+(ipy%geom.nby)*geom.nbx
+                + (ipz%geom.nbz)*geom.nbx*geom.nby;
+    //
+    return brick*geom.nbx*geom.nby*geom.nbz+inBrick;
+}
+
+/*!
+  Inverse of ComputeRankOfProcessXYZ.
+
+  @param[in]  geom  The description of the problem's geometry.
+  @param[in]  rank  The MPI rank
+  @param[out] ipx, ipy, ipz The processor grid location of rank
+*/
+inline void
+ComputeProcessXYZOfRank(
+    const Geometry &geom,
+    int rank,
+    int &ipx,
+    int &ipy,
+    int &ipz
+) {
+    int brickSize = geom.nbx*geom.nby*geom.nbz;
+    int nBricksX = geom.npx/geom.nbx;
+    int nBricksY = geom.npy/geom.nby;
+    int brick = rank/brickSize;
+    int inBrick = rank%brickSize;
+    //
+    int bpz = brick/(nBricksX*nBricksY);
+    int bpy = (brick-bpz*nBricksX*nBricksY)/nBricksX;
+    int bpx = brick%nBricksX;
+    int lz = inBrick/(geom.nbx*geom.nby);
+    int ly = (inBrick-lz*geom.nbx*geom.nby)/geom.nbx;
+    int lx = inBrick%geom.nbx;
+    //
+    ipx = bpx*geom.nbx+lx;
+    ipy = bpy*geom.nby+ly;
+    ipz = bpz*geom.nbz+lz;
+}
+
 /*!
   Returns the rank of the MPI process that is assigned the global row index
   given as the input argument.
@@ -95,9 +159,35 @@ ComputeRankOfMatrixRow(
     global_int_t ipz = iz/geom.nz;
     global_int_t ipy = iy/geom.ny;
     global_int_t ipx = ix/geom.nx;
-    int rank = ipx+ipy*geom.npx+ipz*geom.npy*geom.npx;
     //
-    return rank;
+    return ComputeRankOfProcessXYZ(geom, ipx, ipy, ipz);
+}
+
+/*!
+  Returns the global row index of a local row, the same value GenerateProblem
+  stores in localToGlobalMap.
+
+  @param[in] geom     The description of the problem's geometry.
+  @param[in] localRow The local row index
+
+  @return Returns the global row index
+*/
+inline global_int_t
+ComputeGlobalRowOfLocalRow(
+    const Geometry &geom,
+    local_int_t localRow
+) {
+    global_int_t gnx = geom.nx*geom.npx;
+    global_int_t gny = geom.ny*geom.npy;
+
+    local_int_t iz = localRow/(geom.ny*geom.nx);
+    local_int_t iy = (localRow-iz*geom.ny*geom.nx)/geom.nx;
+    local_int_t ix = localRow%geom.nx;
+    global_int_t giz = geom.ipz*geom.nz+iz;
+    global_int_t giy = geom.ipy*geom.ny+iy;
+    global_int_t gix = geom.ipx*geom.nx+ix;
+    //
+    return giz*gnx*gny+giy*gnx+gix;
 }
 
 /**
@@ -133,4 +223,7 @@ emit(const Geometry &geom) {
     cout << "ipx: "        << geom.ipx << endl;
     cout << "ipy: "        << geom.ipy << endl;
     cout << "ipz: "        << geom.ipz << endl;
+    cout << "nbx: "        << geom.nbx << endl;
+    cout << "nby: "        << geom.nby << endl;
+    cout << "nbz: "        << geom.nbz << endl;
 }
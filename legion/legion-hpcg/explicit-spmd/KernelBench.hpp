@@ -0,0 +1,145 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file KernelBench.hpp
+
+    Kernel microbenchmark definitions shared by legion-xhpcg and the ref-impl
+    xhpcg (--kernel-bench=N). Both binaries generate the same fine-grid
+    problem, run SPMV, SYMGS, DDOT and WAXPBY N times each on the generated b
+    and xexact, and report with the work model and YAML layout below, so the
+    two runtimes are compared on identical data and identical accounting.
+
+    This header must not depend on either runtime.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+
+// Both binaries write their results here, in the working directory.
+#define KERNEL_BENCH_YAML "HPCG-KernelBench.yaml"
+
+/**
+ * The kernels, in the order they are run and reported.
+ *
+ * - SPMV:   Ap = A * p with p = b (p has room for the halo).
+ * - SYMGS:  N sweeps z = SYMGS(A, b, z), starting from z = 0.
+ * - DDOT:   b' * xexact.
+ * - WAXPBY: r = b + 0.5 * xexact.
+ */
+enum KernelBenchKernel {
+    KERNEL_BENCH_SPMV = 0,
+    KERNEL_BENCH_SYMGS,
+    KERNEL_BENCH_DDOT,
+    KERNEL_BENCH_WAXPBY,
+    KERNEL_BENCH_N
+};
+
+static const char *const KernelBenchNames[KERNEL_BENCH_N] = {
+    "SPMV", "SYMGS", "DDOT", "WAXPBY"
+};
+
+/**
+ * Result of one kernel over all calls and all ranks.
+ */
+struct KernelBenchResult {
+    //!< Wall time of all calls on the slowest rank.
+    double seconds;
+    //!< Floating point operations of one call, all ranks.
+    double flops;
+    //!< Bytes moved by one call, all ranks.
+    double bytes;
+    //!< Squared norm (DDOT: value) of the kernel's output after all calls.
+    double checksum;
+};
+
+/**
+ * Fills in the per-call flops and bytes of every kernel for a matrix with
+ * nrow rows and nnz nonzeros in total. Counts use the 8-byte values and
+ * 4-byte column indices both implementations store; SYMGS is a forward and
+ * a back sweep.
+ */
+inline void
+KernelBenchModel(
+    double nrow,
+    double nnz,
+    KernelBenchResult *results
+) {
+    const double matrixBytes = nnz * (8.0 + 4.0);
+    //
+    results[KERNEL_BENCH_SPMV].flops   = 2.0 * nnz;
+    results[KERNEL_BENCH_SPMV].bytes   = matrixBytes + nrow * 2.0 * 8.0;
+    results[KERNEL_BENCH_SYMGS].flops  = 4.0 * nnz;
+    results[KERNEL_BENCH_SYMGS].bytes  = 2.0 * (matrixBytes + nrow * 3.0 * 8.0);
+    results[KERNEL_BENCH_DDOT].flops   = 2.0 * nrow;
+    results[KERNEL_BENCH_DDOT].bytes   = nrow * 2.0 * 8.0;
+    results[KERNEL_BENCH_WAXPBY].flops = 3.0 * nrow;
+    results[KERNEL_BENCH_WAXPBY].bytes = nrow * 3.0 * 8.0;
+}
+
+/**
+ * Writes the results to fileName in the YAML subset bench-xhpcg parses.
+ * Returns false if the file cannot be written.
+ */
+inline bool
+WriteKernelBenchYAML(
+    const std::string &fileName,
+    const std::string &implementation,
+    int nRanks,
+    int nx,
+    int ny,
+    int nz,
+    int numberOfCalls,
+    const KernelBenchResult *results
+) {
+    std::ofstream out(fileName.c_str());
+    if (!out) return false;
+    //
+    out << "HPCG-KernelBench:" << std::endl;
+    out << "  Implementation: " << implementation << std::endl;
+    out << "  Processes: " << nRanks << std::endl;
+    out << "  Local Grid: " << nx << "x" << ny << "x" << nz << std::endl;
+    out << "  Calls: " << numberOfCalls << std::endl;
+    for (int k = 0; k < KERNEL_BENCH_N; ++k) {
+        const KernelBenchResult &r = results[k];
+        const double perCall = r.seconds / numberOfCalls;
+        out << "  " << KernelBenchNames[k] << ":" << std::endl;
+        out << "    Time per call (sec): " << perCall << std::endl;
+        out << "    GFLOP/s: "
+            << (perCall > 0.0 ? r.flops / perCall / 1.0E9 : 0.0) << std::endl;
+        out << "    GB/s: "
+            << (perCall > 0.0 ? r.bytes / perCall / 1.0E9 : 0.0) << std::endl;
+        out.precision(17);
+        out << "    Checksum: " << r.checksum << std::endl;
+        out.precision(6);
+    }
+    return bool(out);
+}
@@ -0,0 +1,218 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file KernelVariants.hpp
+
+    Run-time choice of the SpMV, SYMGS, DDOT and MG smoother implementations
+    (--spmv=, --symgs=, --ddot=, --mg-precision=, --mg-halo=, --smoother=,
+    --mg-cycle=). The LGNCG_USE_* build options only set
+    the defaults, so variants can be compared with one binary. Tasking and
+    the halo exchange flavor stay build options: they change which tasks are
+    registered and how regions are mapped. OptimizeProblem
+    builds the storage the chosen variants need, and the kernels dispatch on
+    that storage or on ShardKernelVariants().
+ */
+
+#pragma once
+
+#include <cstring>
+
+// Default degree of the Chebyshev smoother (SpMVs per smoother step, see
+// --chebyshev-degree=).
+#define HPCG_CHEBYSHEV_DEGREE 2
+
+/**
+ * SpMV implementations.
+ */
+enum SPMVVariant {
+    // CSR rows (interior and boundary passes, see SetupHalo).
+    SPMV_VARIANT_REF = 0,
+    // SELL-C-sigma storage built by OptimizeProblem.
+    SPMV_VARIANT_SELL,
+    // Rows without ghost columns from Geometry (see MatrixFree.hpp).
+    SPMV_VARIANT_MATRIX_FREE
+};
+
+/**
+ * SYMGS implementations.
+ */
+enum SYMGSVariant {
+    // Sequential forward and back sweeps.
+    SYMGS_VARIANT_REF = 0,
+    // Multicolor sweeps (see GenerateMulticoloring).
+    SYMGS_VARIANT_MC,
+    // Sequential sweeps with the MG residual fused into the last presmoother
+    // step (see ComputeSYMGSResidual).
+    SYMGS_VARIANT_BLOCKED,
+    // Sequential sweeps, rows without ghost columns from Geometry.
+    SYMGS_VARIANT_MATRIX_FREE
+};
+
+/**
+ * CG dot product implementations.
+ */
+enum DotVariant {
+    // Floating-point sum reduction.
+    DOT_VARIANT_REF = 0,
+    // Order-independent sum (see ReproSum.hpp).
+    DOT_VARIANT_REPRO
+};
+
+/**
+ * MG smoothers (all levels but the coarsest, which always uses SYMGS).
+ */
+enum SmootherVariant {
+    // ComputeSYMGS with the SYMGS variant above.
+    SMOOTHER_VARIANT_SYMGS = 0,
+    // Jacobi-preconditioned Chebyshev polynomial (see ComputeChebyshev.hpp).
+    SMOOTHER_VARIANT_CHEBYSHEV
+};
+
+/**
+ * How ComputeMG combines the levels.
+ */
+enum MGCycleVariant {
+    // Multiplicative V-cycle: each level smooths the residual the finer
+    // levels left.
+    MG_CYCLE_V = 0,
+    // Additive (BPX-style): every level smooths the injected residual at once
+    // and the corrections are summed (see ComputeMGAdditive).
+    MG_CYCLE_ADDITIVE
+};
+
+/**
+ *
+ */
+struct KernelVariants {
+    int spmv;
+    int symgs;
+    int dot;
+    // Single precision matrix values in the MG smoother and residual.
+    bool mixedPrecisionMG;
+    // Halos of the vectors only MG exchanges travel as float.
+    bool floatMGHalo;
+    int smoother;
+    // Polynomial degree of the Chebyshev smoother.
+    int chebyshevDegree;
+    int mgCycle;
+};
+
+/**
+ * Variants selected by the build options.
+ */
+inline KernelVariants
+DefaultKernelVariants(void)
+{
+    KernelVariants kv = {
+        .spmv             = SPMV_VARIANT_REF,
+        .symgs            = SYMGS_VARIANT_REF,
+        .dot              = DOT_VARIANT_REF,
+        .mixedPrecisionMG = false,
+        .floatMGHalo      = false,
+        .smoother         = SMOOTHER_VARIANT_SYMGS,
+        .chebyshevDegree  = HPCG_CHEBYSHEV_DEGREE,
+        .mgCycle          = MG_CYCLE_V
+    };
+#ifdef LGNCG_USE_SELL_C_SIGMA
+    kv.spmv = SPMV_VARIANT_SELL;
+#endif
+#ifdef LGNCG_USE_MULTICOLORING
+    kv.symgs = SYMGS_VARIANT_MC;
+#elif defined(LGNCG_USE_PLANE_BLOCKED_SYMGS)
+    kv.symgs = SYMGS_VARIANT_BLOCKED;
+#endif
+#ifdef LGNCG_USE_MATRIX_FREE
+    kv.spmv = SPMV_VARIANT_MATRIX_FREE;
+    if (kv.symgs == SYMGS_VARIANT_REF ||
+        kv.symgs == SYMGS_VARIANT_BLOCKED) {
+        kv.symgs = SYMGS_VARIANT_MATRIX_FREE;
+    }
+#endif
+#ifdef LGNCG_USE_REPRO_DOT
+    kv.dot = DOT_VARIANT_REPRO;
+#endif
+#ifdef LGNCG_USE_MIXED_PRECISION
+    kv.mixedPrecisionMG = true;
+#endif
+#ifdef LGNCG_USE_FLOAT_MG_HALO
+    kv.floatMGHalo = true;
+#endif
+#ifdef LGNCG_USE_CHEBYSHEV_SMOOTHER
+    kv.smoother = SMOOTHER_VARIANT_CHEBYSHEV;
+#endif
+#ifdef LGNCG_USE_ADDITIVE_MG
+    kv.mgCycle = MG_CYCLE_ADDITIVE;
+#endif
+    return kv;
+}
+
+/**
+ * Variants used by this process's shards. Same value for all shards, so a
+ * process-wide setting is enough (set from HPCG_Params in
+ * startBenchmarkTask).
+ */
+inline KernelVariants &
+ShardKernelVariants(void)
+{
+    static KernelVariants kv = DefaultKernelVariants();
+    return kv;
+}
+
+// Command-line names, indexed by the enums above.
+static const char *const SPMVVariantNames[] = {
+    "ref", "sell", "matrix-free"
+};
+static const char *const SYMGSVariantNames[] = {
+    "ref", "mc", "blocked", "matrix-free"
+};
+static const char *const DotVariantNames[] = {
+    "ref", "repro"
+};
+static const char *const SmootherVariantNames[] = {
+    "symgs", "chebyshev"
+};
+static const char *const MGCycleVariantNames[] = {
+    "v", "additive"
+};
+
+/**
+ * Returns the index of value in names (nNames entries), or -1.
+ */
+inline int
+KernelVariantIndex(
+    const char *value,
+    const char *const *names,
+    int nNames
+) {
+    for (int i = 0; i < nNames; ++i) {
+        if (strcmp(value, names[i]) == 0) return i;
+    }
+    return -1;
+}
@@ -74,6 +74,19 @@ public:
         this->mAllocate(name, nElems, ctx, lrt);
     }
 
+    /**
+     * Allocates the array on indexSpace, which other arrays share.
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Legion::IndexSpace &indexSpace,
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        this->mAllocate(name, indexSpace, ctx, lrt);
+    }
+
     /**
      *
      */
@@ -83,6 +96,8 @@ public:
         Legion::Context ctx,
         Legion::HighLevelRuntime *lrt
     ) {
+        // Fields of another array's region use its partition.
+        if (this->mSharePartition()) return;
         // Only allow even partitioning.
         assert(0 == this->mLength % nParts && "Uneven partitioning requested.");
         //
@@ -142,6 +157,8 @@ public:
         Legion::Context ctx,
         Legion::HighLevelRuntime *lrt
     ) {
+        if (this->mSharePartition()) return;
+        //
         const size_t nParts = partLens.size();
         Rect<1> colorBounds(Point<1>(0), Point<1>(nParts - 1));
         Domain colorDomain = Domain::from_rect<1>(colorBounds);
@@ -183,6 +200,28 @@ public:
         //
         this->mAttachNameAtPartition(ctx, lrt);
     }
+
+    /**
+     * Partitions the array with indexPart, an existing partition of the index
+     * space it shares (see allocate), whose colors are colorDomain.
+     */
+    void
+    partition(
+        const Legion::IndexPartition &indexPart,
+        const Legion::Domain &colorDomain,
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        this->indexPartition = indexPart;
+        this->logicalPartition = lrt->get_logical_partition(
+            ctx,
+            this->logicalRegion,
+            this->indexPartition
+        );
+        this->launchDomain = colorDomain;
+        // The index partition keeps its maker's name.
+        lrt->attach_name(this->logicalPartition, this->mName.c_str());
+    }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -203,6 +242,16 @@ struct Array : public Item<TYPE> {
         HighLevelRuntime *runtime
     ) : Item<TYPE>(physicalRegion, ctx, runtime) { }
 
+    /**
+     * Array of field fieldID of a region that holds several arrays.
+     */
+    Array(
+        const PhysicalRegion &physicalRegion,
+        Legion::FieldID fieldID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) : Item<TYPE>(physicalRegion, fieldID, ctx, runtime) { }
+
     /**
      *
      */
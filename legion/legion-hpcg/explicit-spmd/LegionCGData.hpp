@@ -33,6 +33,20 @@
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 
+#include <vector>
+
+/**
+ * Fields of the region of the CG vectors without ghosts (r holds field 0).
+ */
+enum CGDataFieldID {
+    CGF_R = 0,
+    CGF_AP,
+    CGF_W,
+    CGF_N,
+    CGF_Q,
+    CGF_AQ
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -42,15 +56,22 @@ struct LogicalCGData : public LogicalMultiBase {
     LogicalArray<floatType> z;  //!< Preconditioned residual vector.
     LogicalArray<floatType> p;  //!< Direction vector.
     LogicalArray<floatType> Ap; //!< Krylov vector.
+    // Auxiliary vectors used only by pipelined CG.
+    LogicalArray<floatType> w;  //!< w = A * z.
+    LogicalArray<floatType> m;  //!< m = M * w.
+    LogicalArray<floatType> n;  //!< n = A * m.
+    LogicalArray<floatType> q;  //!< q = M * Ap.
+    LogicalArray<floatType> Aq; //!< Aq = A * q.
 
 protected:
 
     /**
-     * Order matters here. If you update this, also update unpack.
+     * Order matters here. If you update this, also update unpack. The fields of
+     * r's region come first and take one region.
      */
     void
     mPopulateRegionList(void) {
-        mLogicalItems = {&r, &z, &p, &Ap};
+        mLogicalItems = {&r, &Ap, &w, &n, &q, &Aq, &z, &p, &m};
     }
 
 public:
@@ -83,15 +104,28 @@ public:
         do {                                                                   \
             sName.allocate(name + "-" #sName, size, ctx, rtp);                 \
         } while(0)
+        // Allocates sName as field fieldID of r's region.
+        #define falloca(sName, fieldID, ctx, rtp)                              \
+        do {                                                                   \
+            sName.allocateField(name + "-" #sName, r, fieldID, ctx, rtp);      \
+        } while(0)
 
         const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
-        const local_int_t ncol = A.sclrs->data()->localNumberOfColumns;
-        //
+        // The vectors without ghosts are fields of one region, so they share
+        // an instance and a mapping. z, p, and m have their own regions,
+        // since they are partitioned for their halos.
         aalloca(r,  nrow, ctx, lrt);
-        aalloca(z,  ncol, ctx, lrt);
-        aalloca(p,  ncol, ctx, lrt);
-        aalloca(Ap, nrow, ctx, lrt);
+        falloca(Ap, CGF_AP, ctx, lrt);
+        falloca(w,  CGF_W,  ctx, lrt);
+        falloca(n,  CGF_N,  ctx, lrt);
+        falloca(q,  CGF_Q,  ctx, lrt);
+        falloca(Aq, CGF_AQ, ctx, lrt);
+        //
+        AllocateWithGhosts(A, name + "-z", z, ctx, lrt);
+        AllocateWithGhosts(A, name + "-p", p, ctx, lrt);
+        AllocateWithGhosts(A, name + "-m", m, ctx, lrt);
 
+        #undef falloca
         #undef aalloca
     }
 
@@ -116,7 +150,8 @@ public:
     ) {
         Partition(A, z, ctx, lrt);
         Partition(A, p, ctx, lrt);
-        // r and Ap don't need to be partitioned.
+        Partition(A, m, ctx, lrt);
+        // The remaining vectors don't need to be partitioned.
     }
 };
 
@@ -133,6 +168,22 @@ struct CGData : public PhysicalMultiBase {
     Array<floatType> *p = nullptr;
     //
     Array<floatType> *Ap = nullptr;
+    //
+    Array<floatType> *w = nullptr;
+    //
+    Array<floatType> *m = nullptr;
+    //
+    Array<floatType> *n = nullptr;
+    //
+    Array<floatType> *q = nullptr;
+    //
+    Array<floatType> *Aq = nullptr;
+    // CG waits on the residual norm every this many iterations (and on the
+    // last one). Not a region: set by the shard after unpacking.
+    int convergenceCheckFreq = 1;
+    // Residual norm of every iteration of the last CG call (index 0 is the
+    // initial residual). Not a region: filled by CG.
+    std::vector<floatType> residualHistory;
 
     /**
      *
@@ -148,6 +199,11 @@ struct CGData : public PhysicalMultiBase {
         delete z;
         delete p;
         delete Ap;
+        delete w;
+        delete m;
+        delete n;
+        delete q;
+        delete Aq;
     }
 
     /**
@@ -170,10 +226,11 @@ struct CGData : public PhysicalMultiBase {
         Legion::Context ctx,
         Legion::HighLevelRuntime *lrt
     ) {
+        // Ap, w, n, q, and Aq are fields of r's region.
         lrt->unmap_region(ctx, r->physicalRegion);
         lrt->unmap_region(ctx, z->physicalRegion);
         lrt->unmap_region(ctx, p->physicalRegion);
-        lrt->unmap_region(ctx, Ap->physicalRegion);
+        lrt->unmap_region(ctx, m->physicalRegion);
     }
 
 protected:
@@ -190,18 +247,35 @@ protected:
         HighLevelRuntime *rt
     ) {
         size_t cid = baseRID;
-        // Populate members from physical regions.
-        r = new Array<floatType>(regions[cid++], ctx, rt);
+        // Populate members from physical regions. The first region holds the
+        // vectors without ghosts.
+        const PhysicalRegion &rRegion = regions[cid++];
+        r = new Array<floatType>(rRegion, CGF_R, ctx, rt);
         assert(r->data());
         //
+        Ap = new Array<floatType>(rRegion, CGF_AP, ctx, rt);
+        assert(Ap->data());
+        //
+        w = new Array<floatType>(rRegion, CGF_W, ctx, rt);
+        assert(w->data());
+        //
+        n = new Array<floatType>(rRegion, CGF_N, ctx, rt);
+        assert(n->data());
+        //
+        q = new Array<floatType>(rRegion, CGF_Q, ctx, rt);
+        assert(q->data());
+        //
+        Aq = new Array<floatType>(rRegion, CGF_AQ, ctx, rt);
+        assert(Aq->data());
+        //
         z = new Array<floatType>(regions[cid++], ctx, rt);
         assert(z->data());
         //
         p = new Array<floatType>(regions[cid++], ctx, rt);
         assert(p->data());
         //
-        Ap = new Array<floatType>(regions[cid++], ctx, rt);
-        assert(Ap->data());
+        m = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(m->data());
         // Calculate number of region entries for this structure.
         mNRegionEntries = cid - baseRID;
     }
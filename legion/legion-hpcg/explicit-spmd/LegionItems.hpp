@@ -32,6 +32,7 @@
 
 #include <cassert>
 #include <deque>
+#include <vector>
 
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -57,6 +58,24 @@ protected:
     std::string mName;
     //
     bool mHasParentLogicalRegion = false;
+    // Item whose region this item is a field of, if it doesn't have its own
+    // (see LogicalItem::allocateField).
+    LogicalItemBase *mRegionOwner = nullptr;
+    // Fields of this item's region, if it allocated it.
+    std::vector<Legion::FieldID> mRegionFields;
+
+    /**
+     * An item that is a field of another item's region uses that item's
+     * partition. Returns whether it does.
+     */
+    bool
+    mSharePartition(void) {
+        if (!mRegionOwner) return false;
+        indexPartition   = mRegionOwner->indexPartition;
+        logicalPartition = mRegionOwner->logicalPartition;
+        launchDomain     = mRegionOwner->launchDomain;
+        return true;
+    }
 
 public:
 
@@ -121,6 +140,24 @@ public:
     bool
     hasParentLogicalRegion(void) { return mHasParentLogicalRegion; }
 
+    /**
+     * Fields of the region this item is a field of, this item's included.
+     */
+    const std::vector<Legion::FieldID> &
+    regionFields(void) const {
+        return mRegionOwner ? mRegionOwner->mRegionFields : mRegionFields;
+    }
+
+    /**
+     * Returns whether this item and other are fields of the same region.
+     */
+    bool
+    sharesRegion(
+        const LogicalItemBase &other
+    ) const {
+        return logicalRegion == other.logicalRegion;
+    }
+
     /**
      *
      */
@@ -191,7 +228,9 @@ public:
     }
 
     /**
-     *
+     * Adds the shard's sub-regions of the items to launcher. Consecutive items
+     * that are fields of one region take a single region requirement, so the
+     * physical structure unpacks them from one region.
      */
     virtual void
     intent(
@@ -202,8 +241,17 @@ public:
         Context ctx,
         HighLevelRuntime *lrt
     ) {
-        for (auto &a : mLogicalItems) {
-            a->intent(privMode, cohProp, shard, launcher, ctx, lrt);
+        for (size_t i = 0; i < mLogicalItems.size(); ) {
+            const LogicalItemBase *const a = mLogicalItems[i];
+            auto lsr = lrt->get_logical_subregion_by_color(
+                ctx, a->logicalPartition, shard
+            );
+            RegionRequirement rr(lsr, privMode, cohProp, a->logicalRegion);
+            for (; i < mLogicalItems.size() &&
+                   mLogicalItems[i]->sharesRegion(*a); ++i) {
+                rr.add_field(mLogicalItems[i]->fid);
+            }
+            launcher.add_region_requirement(rr);
         }
     }
 };
@@ -214,6 +262,8 @@ public:
 ////////////////////////////////////////////////////////////////////////////////
 template<typename TYPE>
 struct LogicalItem : public LogicalItemBase {
+    // allocateField reads the region of an item of another type.
+    template<typename> friend struct LogicalItem;
 
     /**
      *
@@ -263,6 +313,8 @@ protected:
     Legion::FieldSpaceID mFieldSpaceID;
     //
     Legion::RegionTreeID mRTreeID;
+    // Whether the item created its index space (and so destroys it).
+    bool mOwnsIndexSpace = true;
 
     /**
      *
@@ -327,6 +379,7 @@ protected:
         fa.allocate_field(sizeof(TYPE), fid);
         // Create the logical region.
         logicalRegion = lrt->create_logical_region(ctx, mIndexSpace, mFS);
+        mRegionFields = {fid};
         // Stash some info for equality checks.
         mIndexSpaceID = logicalRegion.get_index_space().get_id();
         mFieldSpaceID = logicalRegion.get_field_space().get_id();
@@ -336,6 +389,40 @@ protected:
         mAttachNameAtAllocate(ctx, lrt);
     }
 
+    /**
+     * Like mAllocate, but on an index space made elsewhere, so that the
+     * regions on it share its partitions. The maker destroys it.
+     */
+    void
+    mAllocate(
+        const std::string &name,
+        const Legion::IndexSpace &indexSpace,
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        mOwnsIndexSpace = false;
+        mIndexSpace = indexSpace;
+        mBounds = lrt->get_index_space_domain(
+                      ctx, mIndexSpace
+                  ).get_rect<1>();
+        mLength = mBounds.volume();
+        //
+        mFS = lrt->create_field_space(ctx);
+        FieldAllocator fa = lrt->create_field_allocator(ctx, mFS);
+        fa.allocate_field(sizeof(TYPE), fid);
+        //
+        logicalRegion = lrt->create_logical_region(ctx, mIndexSpace, mFS);
+        mRegionFields = {fid};
+        //
+        mIndexSpaceID = logicalRegion.get_index_space().get_id();
+        mFieldSpaceID = logicalRegion.get_field_space().get_id();
+        mRTreeID      = logicalRegion.get_tree_id();
+        // The index space keeps its maker's name.
+        mName = name;
+        lrt->attach_name(mFS, mName.c_str());
+        lrt->attach_name(logicalRegion, mName.c_str());
+    }
+
 public:
     //
     PhysicalRegion physicalRegion;
@@ -352,6 +439,43 @@ public:
         mAllocate(name, 1, ctx, lrt);
     }
 
+    /**
+     * Allocates the item as field fieldID of owner's region instead of in a
+     * region of its own: the items of a structure that have the same length
+     * share an instance and take one region requirement where they are added
+     * together (see LogicalMultiBase::intent). owner keeps the region, its
+     * partition and its deallocation. fieldID must not be owner's (0).
+     */
+    template<typename OTHER>
+    void
+    allocateField(
+        const std::string &name,
+        LogicalItem<OTHER> &owner,
+        Legion::FieldID fieldID,
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        assert(!owner.mRegionOwner && fieldID != owner.fid);
+        mRegionOwner = &owner;
+        fid          = fieldID;
+        mLength      = owner.mLength;
+        mBounds      = owner.mBounds;
+        mIndexSpace  = owner.mIndexSpace;
+        mFS          = owner.mFS;
+        //
+        FieldAllocator fa = lrt->create_field_allocator(ctx, mFS);
+        fa.allocate_field(sizeof(TYPE), fid);
+        owner.mRegionFields.push_back(fid);
+        //
+        logicalRegion = owner.logicalRegion;
+        mIndexSpaceID = owner.mIndexSpaceID;
+        mFieldSpaceID = owner.mFieldSpaceID;
+        mRTreeID      = owner.mRTreeID;
+        //
+        mName = name;
+        lrt->attach_name(mFS, fid, mName.c_str());
+    }
+
     /**
      * Cleans up and returns all allocated resources.
      */
@@ -360,7 +484,10 @@ public:
         Legion::Context ctx,
         Legion::HighLevelRuntime *lrt
     ) {
-        lrt->destroy_index_space(ctx, mIndexSpace);
+        // The region's owner destroys it.
+        if (mRegionOwner) return;
+        //
+        if (mOwnsIndexSpace) lrt->destroy_index_space(ctx, mIndexSpace);
         lrt->destroy_field_space(ctx, mFS);
         lrt->destroy_logical_region(ctx, logicalRegion);
     }
@@ -399,6 +526,29 @@ public:
         return physicalRegion;
     }
 
+    /**
+     * Maps all the fields of the item's region with one mapping (see
+     * allocateField).
+     */
+    Legion::PhysicalRegion
+    mapRegionFields(
+        Legion::PrivilegeMode privMode,
+        Legion::CoherenceProperty cohProp,
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        RegionRequirement req(
+            logicalRegion, privMode, cohProp, logicalRegion
+        );
+        for (const Legion::FieldID f : regionFields()) {
+            req.add_field(f);
+        }
+        //
+        InlineLauncher inl(req);
+        physicalRegion = lrt->map_region(ctx, inl);
+        return physicalRegion;
+    }
+
     /**
      *
      */
@@ -423,28 +573,55 @@ protected:
     //
     TYPE *mData = nullptr;
 
+    /**
+     * Returns the field mapped in a region mapped with one field. Items that
+     * are fields of a shared region are mapped with only their own field
+     * unless the whole region is unpacked at once.
+     */
+    static Legion::FieldID
+    mOnlyField(
+        const PhysicalRegion &physicalReg
+    ) {
+        std::vector<Legion::FieldID> fields;
+        physicalReg.get_fields(fields);
+        assert(fields.size() == 1);
+        return fields[0];
+    }
+
 public:
     //
     LogicalRegion logicalRegion;
     //
     PhysicalRegion physicalRegion;
-    // Field ID (only one, so it doesn't change).
-    const Legion::FieldID fid = 0;
+    // Field ID of the item in its region.
+    Legion::FieldID fid = 0;
 
     /**
-     *
+     * Item of the only field mapped in physicalReg.
+     */
+    Item(
+        const PhysicalRegion &physicalReg,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) : Item(physicalReg, mOnlyField(physicalReg), ctx, runtime) { }
+
+    /**
+     * Item of field fieldID of physicalReg, for regions that hold several
+     * items (see LogicalItem::allocateField).
      */
     Item(
         const PhysicalRegion &physicalReg,
+        Legion::FieldID fieldID,
         Context ctx,
         HighLevelRuntime *runtime
     ) {
         // Cache logical and physical regions.
         physicalRegion = physicalReg;
         logicalRegion = physicalRegion.get_logical_region();
+        fid = fieldID;
         //
         using GRA = RegionAccessor<AccessorType::Generic, TYPE>;
-        GRA tAcc = physicalRegion.get_field_accessor(0,
+        GRA tAcc = physicalRegion.get_field_accessor(fid,
 						     true /*silence_warnings*/
 						     ).template typeify<TYPE>();
         //
@@ -465,6 +642,9 @@ public:
             // Signifies that something went south.
             mData = nullptr;
         }
+        else if (CGMapperHugePages()) {
+            CGMapperAdviseHugePages(mData, mLength * sizeof(TYPE));
+        }
         // It's all good...
     }
 
@@ -484,7 +664,7 @@ public:
      *
      */
     FieldID
-    getFieldID(void) { return 0; }
+    getFieldID(void) { return fid; }
 
     /**
      *
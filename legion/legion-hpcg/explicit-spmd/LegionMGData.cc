@@ -75,15 +75,14 @@ LogicalMGData::allocate(
     auto *Acsclrs = A.Ac->sclrs->data();
     //
     const local_int_t nrowf = Afsclrs->localNumberOfRows;
-    const local_int_t ncolf = Afsclrs->localNumberOfColumns;
-    //
     const local_int_t nrowc = Acsclrs->localNumberOfRows;
-    const local_int_t ncolc = Acsclrs->localNumberOfColumns;
     //
     aalloca(f2cOperator,  nrowf, ctx, lrt);
     aalloca(rc,           nrowc, ctx, lrt);
-    aalloca(xc,           ncolc, ctx, lrt);
-    aalloca(Axf,          ncolf, ctx, lrt);
+    aalloca(chebyD,       nrowf, ctx, lrt);
+    // xc and Axf share their level's halo partition.
+    AllocateWithGhosts(*A.Ac, name + "-xc", xc, ctx, lrt);
+    AllocateWithGhosts(A, name + "-Axf", Axf, ctx, lrt);
 
     #undef aalloca
 }
@@ -101,5 +100,5 @@ LogicalMGData::partition(
     //
     Partition(*A.Ac, xc, ctx, lrt);
     Partition(A, Axf, ctx, lrt);
-    // f2cOperator and rc don't need to be partitioned.
+    // f2cOperator, rc and chebyD don't need to be partitioned.
 }
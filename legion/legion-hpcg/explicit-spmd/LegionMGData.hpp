@@ -68,6 +68,8 @@ struct LogicalMGData : public LogicalMultiBase {
     LogicalArray<floatType> xc;
     // Fine grid residual vector.
     LogicalArray<floatType> Axf;
+    // Chebyshev smoother update (fine grid rows).
+    LogicalArray<floatType> chebyD;
 
 protected:
 
@@ -80,7 +82,8 @@ protected:
             &f2cOperator,
             &rc,
             &xc,
-            &Axf
+            &Axf,
+            &chebyD
         };
     }
 
@@ -153,6 +156,8 @@ struct MGData : public PhysicalMultiBase {
     Array<floatType> *xc = nullptr;
     //
     Array<floatType> *Axf = nullptr;
+    //
+    Array<floatType> *chebyD = nullptr;
 
     /**
      *
@@ -177,6 +182,7 @@ struct MGData : public PhysicalMultiBase {
         delete rc;
         delete xc;
         delete Axf;
+        delete chebyD;
     }
 
     /**
@@ -191,6 +197,7 @@ struct MGData : public PhysicalMultiBase {
         lrt->unmap_region(ctx, rc->physicalRegion);
         lrt->unmap_region(ctx, xc->physicalRegion);
         lrt->unmap_region(ctx, Axf->physicalRegion);
+        lrt->unmap_region(ctx, chebyD->physicalRegion);
     }
 
 protected:
@@ -219,6 +226,9 @@ protected:
         //
         Axf = new Array<floatType>(regions[cid++], ctx, rt);
         assert(Axf->data());
+        //
+        chebyD = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(chebyD->data());
         // Calculate number of region entries for this structure.
         mNRegionEntries = cid - baseRID;
     }
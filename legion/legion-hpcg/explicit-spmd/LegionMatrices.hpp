@@ -48,6 +48,7 @@
 
 #include "hpcg.hpp"
 #include "Geometry.hpp"
+#include "FlatIndexMap.hpp"
 
 #include <vector>
 #include <map>
@@ -96,6 +97,34 @@ struct Synchronizers {
     PhaseBarriers neighbors[HPCG_STENCIL - 1];
 };
 
+/**
+ * Fields of the matrix regions that hold several items of the same length. The
+ * first item of each region holds field 0.
+ */
+enum SparseMatrixFieldID {
+    // Per-shard structures (geoms' region).
+    SMF_GEOMS = 0,
+    SMF_SCLRS,
+    SMF_DC_SUM_GI,
+    SMF_DC_SUM_FT,
+    SMF_DC_MIN_FT,
+    SMF_DC_MAX_FT,
+    SMF_DC_SUM_FUSED,
+    SMF_DC_SUM_REPRO,
+    SMF_SYNCHRONIZERS,
+    // Per-neighbor structures (neighbors' region).
+    SMF_NEIGHBORS = 0,
+    SMF_SEND_LENGTH,
+    SMF_RECV_LENGTH,
+    // Per-row structures (nonzerosInRow's region).
+    SMF_NONZEROS_IN_ROW = 0,
+    SMF_MATRIX_DIAGONAL,
+    SMF_MATD_IDX_TO_MAT_ROW_COL,
+    // Per-nonzero structures (mtxIndL's region).
+    SMF_MTX_IND_L = 0,
+    SMF_MATRIX_VALUES
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -123,6 +152,8 @@ struct LogicalSparseMatrix : public LogicalMultiBase {
     LogicalArray< DynColl<floatType> > dcAllRedSumFT;
     LogicalArray< DynColl<floatType> > dcAllRedMinFT;
     LogicalArray< DynColl<floatType> > dcAllRedMaxFT;
+    LogicalArray< DynColl<FusedReduceValues> > dcAllRedSumFused;
+    LogicalArray< DynColl<ReproSumValue> > dcAllRedSumRepro;
     // Neighboring processes.
     LogicalArray<int> neighbors;
     // Number of items that will be sent on a per neighbor basis.
@@ -156,27 +187,36 @@ protected:
     bool mSharedRegionsPopulated = false;
 
     /**
-     * Order matters here. If you update this, also update unpack.
+     * Order matters here. If you update this, also update unpack. Items that
+     * are fields of one region are listed together, each region's owner first,
+     * so they take one region requirement (see allocate).
      */
     void
     mPopulateRegionList(void) {
         mLogicalItems = {&geoms,
                          &sclrs,
-                         &nonzerosInRow,
-                         &mtxIndG,
-                         &mtxIndL,
-                         &matrixValues,
-                         &matrixDiagonal,
-                         &localToGlobalMap,
                          &dcAllRedSumGI,
                          &dcAllRedSumFT,
                          &dcAllRedMinFT,
                          &dcAllRedMaxFT,
+                         &dcAllRedSumFused,
+                         &dcAllRedSumRepro,
+                         &synchronizers,
+                         //
                          &neighbors,
                          &sendLength,
                          &recvLength,
-                         &synchronizers,
-                         &matdIdxToMatRowCol
+                         //
+                         &nonzerosInRow,
+                         &matrixDiagonal,
+                         &matdIdxToMatRowCol,
+                         //
+                         &mtxIndL,
+                         &matrixValues,
+                         //
+                         &mtxIndG,
+                         //
+                         &localToGlobalMap
         };
     }
 
@@ -366,41 +406,54 @@ public:
         do {                                                                   \
             sName.allocate(name + "-" #sName, size, ctx, rtp);                 \
         } while(0)
+        // Allocates sName as field fieldID of owner's region.
+        #define falloca(sName, owner, fieldID, ctx, rtp)                       \
+        do {                                                                   \
+            sName.allocateField(name + "-" #sName, owner, fieldID, ctx, rtp);  \
+        } while(0)
 
         mSize = geom.size;
         const auto globalXYZ   = getGlobalXYZ(geom);
         const auto stencilSize = geom.stencilSize;
-
+        // Items of the same length are fields of one region, so a shard's
+        // launch takes a requirement per region instead of one per item.
         aalloca(geoms, mSize, ctx, lrt);
-        aalloca(sclrs, mSize, ctx, lrt);
+        falloca(sclrs,            geoms, SMF_SCLRS,         ctx, lrt);
+        falloca(dcAllRedSumGI,    geoms, SMF_DC_SUM_GI,     ctx, lrt);
+        falloca(dcAllRedSumFT,    geoms, SMF_DC_SUM_FT,     ctx, lrt);
+        falloca(dcAllRedMinFT,    geoms, SMF_DC_MIN_FT,     ctx, lrt);
+        falloca(dcAllRedMaxFT,    geoms, SMF_DC_MAX_FT,     ctx, lrt);
+        falloca(dcAllRedSumFused, geoms, SMF_DC_SUM_FUSED,  ctx, lrt);
+        falloca(dcAllRedSumRepro, geoms, SMF_DC_SUM_REPRO,  ctx, lrt);
+        falloca(synchronizers,    geoms, SMF_SYNCHRONIZERS, ctx, lrt);
+        //
+        const int maxNumNeighbors = geom.stencilSize - 1;
+        // Each task will have at most 26 neighbors.
+        aalloca(neighbors,  mSize * maxNumNeighbors, ctx, lrt);
+        falloca(sendLength, neighbors, SMF_SEND_LENGTH, ctx, lrt);
+        falloca(recvLength, neighbors, SMF_RECV_LENGTH, ctx, lrt);
         //
         aalloca(nonzerosInRow, globalXYZ, ctx, lrt);
-        // Flattened to 1D from 2D.
-        aalloca(mtxIndG, globalXYZ * stencilSize, ctx, lrt);
+        // 2D thing in reference implementation, but not needed (1D suffices).
+        falloca(
+            matrixDiagonal, nonzerosInRow, SMF_MATRIX_DIAGONAL, ctx, lrt
+        );
+        falloca(
+            matdIdxToMatRowCol, nonzerosInRow, SMF_MATD_IDX_TO_MAT_ROW_COL,
+            ctx, lrt
+        );
         // Flattened to 1D from 2D.
         aalloca(mtxIndL, globalXYZ * stencilSize, ctx, lrt);
         // Flattened to 1D from 2D.
-        aalloca(matrixValues, globalXYZ * stencilSize, ctx, lrt);
-        // 2D thing in reference implementation, but not needed (1D suffices).
-        aalloca(matrixDiagonal, globalXYZ, ctx, lrt);
+        falloca(matrixValues, mtxIndL, SMF_MATRIX_VALUES, ctx, lrt);
+        // mtxIndG and localToGlobalMap keep their own regions, since
+        // releaseSetupIndices unmaps them once setup is done.
+        // Flattened to 1D from 2D.
+        aalloca(mtxIndG, globalXYZ * stencilSize, ctx, lrt);
         //
         aalloca(localToGlobalMap, globalXYZ, ctx, lrt);
-        //
-        aalloca(dcAllRedSumGI, mSize, ctx, lrt);
-        aalloca(dcAllRedSumFT, mSize, ctx, lrt);
-        aalloca(dcAllRedMinFT, mSize, ctx, lrt);
-        aalloca(dcAllRedMaxFT, mSize, ctx, lrt);
-        //
-        const int maxNumNeighbors = geom.stencilSize - 1;
-        // Each task will have at most 26 neighbors.
-        aalloca(neighbors,  mSize * maxNumNeighbors, ctx, lrt);
-        aalloca(sendLength, mSize * maxNumNeighbors, ctx, lrt);
-        aalloca(recvLength, mSize * maxNumNeighbors, ctx, lrt);
-        //
-        aalloca(synchronizers, mSize, ctx, lrt);
-        //
-        aalloca(matdIdxToMatRowCol, globalXYZ, ctx, lrt);
 
+        #undef falloca
         #undef aalloca
     }
 
@@ -418,18 +471,45 @@ public:
             i->partition(nParts, ctx, lrt);
         }
         // For the DynamicCollectives we need partition info before population.
-        const auto nArrivals = nParts; // Expecting an arrival from each task.
-        DynColl<global_int_t> dynColGI(INT_REDUCE_SUM_TID, nArrivals);
-        mPopulateDynamicCollectives(dcAllRedSumGI, dynColGI, ctx, lrt);
+        // Node of each shard. Without node-level reduction every shard is its
+        // own node, so we expect an arrival from each task.
+        std::vector<int> shardNodes(nParts);
+#ifdef LGNCG_USE_NODE_ALLREDUCE
+        shardNodes = CGMapperShardNodes(nParts);
+#else
+        for (int64_t i = 0; i < nParts; ++i) shardNodes[i] = int(i);
+#endif
+        DynColl<global_int_t> dynColGI(INT_REDUCE_SUM_TID, nParts);
+        mPopulateDynamicCollectives(
+            dcAllRedSumGI, dynColGI, shardNodes, ctx, lrt
+        );
         //
-        DynColl<floatType> dynColSumFT(FLOAT_REDUCE_SUM_TID, nArrivals);
-        mPopulateDynamicCollectives(dcAllRedSumFT, dynColSumFT, ctx, lrt);
+        DynColl<floatType> dynColSumFT(FLOAT_REDUCE_SUM_TID, nParts);
+        mPopulateDynamicCollectives(
+            dcAllRedSumFT, dynColSumFT, shardNodes, ctx, lrt
+        );
         //
-        DynColl<floatType> dynColMinFT(FLOAT_REDUCE_MIN_TID, nArrivals);
-        mPopulateDynamicCollectives(dcAllRedMinFT, dynColMinFT, ctx, lrt);
+        DynColl<floatType> dynColMinFT(FLOAT_REDUCE_MIN_TID, nParts);
+        mPopulateDynamicCollectives(
+            dcAllRedMinFT, dynColMinFT, shardNodes, ctx, lrt
+        );
         //
-        DynColl<floatType> dynColMaxFT(FLOAT_REDUCE_MAX_TID, nArrivals);
-        mPopulateDynamicCollectives(dcAllRedMaxFT, dynColMaxFT, ctx, lrt);
+        DynColl<floatType> dynColMaxFT(FLOAT_REDUCE_MAX_TID, nParts);
+        mPopulateDynamicCollectives(
+            dcAllRedMaxFT, dynColMaxFT, shardNodes, ctx, lrt
+        );
+        //
+        DynColl<FusedReduceValues> dynColSumFused(
+            FUSED_REDUCE_SUM_TID, nParts
+        );
+        mPopulateDynamicCollectives(
+            dcAllRedSumFused, dynColSumFused, shardNodes, ctx, lrt
+        );
+        //
+        DynColl<ReproSumValue> dynColSumRepro(REPRO_REDUCE_SUM_TID, nParts);
+        mPopulateDynamicCollectives(
+            dcAllRedSumRepro, dynColSumRepro, shardNodes, ctx, lrt
+        );
         // Just pick a structure that has a representative launch domain.
         launchDomain = geoms.launchDomain;
     }
@@ -450,13 +530,16 @@ public:
 private:
 
     /**
-     *
+     * Creates dynCol's collective with one arrival per node and gives a copy
+     * to each shard. shardNodes[i] is the node shard i runs on; the first
+     * shard of a node is its leader.
      */
     template <typename TYPE>
     void
     mPopulateDynamicCollectives(
         LogicalArray< DynColl<TYPE> > &targetLogicalArray,
         DynColl<TYPE> &dynCol,
+        const std::vector<int> &shardNodes,
         LegionRuntime::HighLevel::Context ctx,
         LegionRuntime::HighLevel::HighLevelRuntime *lrt
     ) {
@@ -466,6 +549,15 @@ private:
         //
         DynColl<TYPE> *dcsd = dcs.data();
         assert(dcsd);
+        // Node to (leader, number of shards).
+        std::map< int, std::pair<int64_t, int> > nodeInfo;
+        for (int64_t i = 0; i < int64_t(shardNodes.size()); ++i) {
+            auto it = nodeInfo.find(shardNodes[i]);
+            if (it == nodeInfo.end()) nodeInfo[shardNodes[i]] = {i, 1};
+            else it->second.second++;
+        }
+        dynCol.nArrivals = int(nodeInfo.size());
+        dynCol.nodeKey = NextNodeReduceKey();
         //
         dynCol.dc = lrt->create_dynamic_collective(
             ctx,
@@ -475,14 +567,49 @@ private:
             sizeof(dynCol.localBuffer)
         );
         // Replicate
-        for (int64_t i = 0; i < dynCol.nArrivals; ++i) {
+        for (int64_t i = 0; i < int64_t(shardNodes.size()); ++i) {
+            const auto &ni = nodeInfo[shardNodes[i]];
             dcsd[i] = dynCol;
+            dcsd[i].nodeArrivals = ni.second;
+            dcsd[i].nodeLeader = (ni.first == i);
         }
         // Done, so unmap.
         targetLogicalArray.unmapRegion(ctx, lrt);
     }
 };
 
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * Argument of the halo exchange pack task.
+ */
+struct ExchangeHaloArgs {
+    int nTxNeighbors;
+    int nRxNeighbors;
+    // Pack the pull buffers as float (see SetupHaloPlan).
+    bool narrow;
+};
+
+/**
+ * Launchers used to exchange the halo of one vector. Built once by
+ * SetupHaloPlan and reused by every ExchangeHalo on that vector, so the
+ * per-iteration path only swaps in the current PhaseBarrier generations.
+ */
+struct HaloPlan {
+    // Pack argument (must outlive pack, since TaskArgument doesn't copy).
+    ExchangeHaloArgs args;
+    // Fills the pull buffers from x (LGNCG_TASKING only).
+    TaskLauncher pack;
+    // Neighbor pull region to x ghost region copies in neighbor order.
+    std::vector<CopyLauncher> copies;
+    // Whether the exchange moves floats, which widen then expands in place in
+    // x's ghost regions.
+    bool narrow = false;
+    TaskLauncher widen;
+};
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
@@ -513,6 +640,10 @@ struct SparseMatrix : public PhysicalMultiBase {
     //
     Item< DynColl<floatType> > *dcAllRedMaxFT = nullptr;
     //
+    Item< DynColl<FusedReduceValues> > *dcAllRedSumFused = nullptr;
+    // Reproducible sum (see ReproSum.hpp).
+    Item< DynColl<ReproSumValue> > *dcAllRedSumRepro = nullptr;
+    //
     Array<int> *neighbors = nullptr;
     //
     Array<local_int_t> *sendLength = nullptr;
@@ -531,18 +662,68 @@ struct SparseMatrix : public PhysicalMultiBase {
     MGData *mgData = nullptr;
     // Global to local mapping. NOTE: only valid after a call to
     // PopulateGlobalToLocalMap.
-    std::map< global_int_t, local_int_t > globalToLocalMap;
+    FlatIndexMap< global_int_t, local_int_t > globalToLocalMap;
     // Only valid after a call to SetupHalo.
     LogicalArray<local_int_t> lElementsToSend;
     Array<local_int_t> *elementsToSend = nullptr;
+    // Local rows with interior rows first, then boundary rows (rows that
+    // reference ghost values). Only valid after a call to SetupHalo.
+    LogicalArray<local_int_t> lHaloRowOrder;
+    Array<local_int_t> *haloRowOrder = nullptr;
+    // Number of leading interior rows in haloRowOrder.
+    local_int_t numberOfInteriorRows = 0;
+    // Number of SYMGS sweeps ComputeMG applies if this is the coarsest level.
+    int numberOfCoarseSweeps = 1;
+    // Estimated largest eigenvalue of D^-1 A used by the Chebyshev smoother.
+    // Only set by SetupChebyshevSmoother.
+    floatType chebyshevLambdaMax = 0.0;
+    // Bytes unmapped by releaseSetupIndices.
+    size_t nDroppedSetupBytes = 0;
     // A mapping between neighbor IDs and their regions.
     std::map<int, PhysicalRegion> nidToPullRegion;
     // Pull regions that I populate for consumption by other tasks.
     std::vector< Array<floatType> *> pullBuffers;
-    // No optimization here.
+    // Shard-local copies of synchronizers, advanced by every halo exchange.
+    // Only valid after a call to SetupHaloPlan.
+    PhaseBarriers haloPBs;
+    std::vector<PhaseBarriers> haloNeighborPBs;
+    // Halo exchange launchers keyed by the exchanged vector's logical region.
+    std::map<LogicalRegion, HaloPlan> haloPlans;
+    // Index space of this level's vectors with ghosts (one element per local
+    // column) and its halo partition, which all of them share. Made by the
+    // first AllocateWithGhosts and Partition of the level.
+    IndexSpace haloIndexSpace = IndexSpace::NO_SPACE;
+    IndexPartition haloIndexPartition = IndexPartition::NO_PART;
+    Domain haloColorDomain;
+    // Partitions that pick the first half of a pull buffer or ghost region,
+    // keyed by its index space (see GetNarrowLogicalRegion).
+    std::map<IndexSpace, IndexPartition> narrowHaloParts;
+    // SELL-C-sigma storage. NOTE: only valid after a call to OptimizeProblem.
+    LogicalArray<floatType> lSellValues;
+    Array<floatType> *sellValues = nullptr;
+    // Local column indices in SELL-C-sigma order (padding points at column 0).
+    LogicalArray<local_int_t> lSellColInds;
+    Array<local_int_t> *sellColInds = nullptr;
+    // Offset of each chunk into sellValues/sellColInds (nChunks + 1 entries).
+    LogicalArray<local_int_t> lSellChunkPtr;
+    Array<local_int_t> *sellChunkPtr = nullptr;
+    // Maps SELL-C-sigma row position to local row.
+    LogicalArray<local_int_t> lSellRowPerm;
+    Array<local_int_t> *sellRowPerm = nullptr;
+    // Local rows grouped by color. NOTE: only valid after OptimizeProblem.
+    LogicalArray<local_int_t> lColorRows;
+    Array<local_int_t> *colorRows = nullptr;
+    // Offset of each color into colorRows (HPCG_NUM_COLORS + 1 entries).
+    LogicalArray<local_int_t> lColorPtr;
+    Array<local_int_t> *colorPtr = nullptr;
+    // Reduced precision copy of matrixValues used by SYMGS and the MG residual
+    // SpMV. NOTE: only valid after a call to OptimizeProblem.
+    LogicalArray<mgFloatType> lMatrixValuesMG;
+    Array<mgFloatType> *matrixValuesMG = nullptr;
+    // Set by OptimizeProblem when optimized structures are available.
     const bool isDotProductOptimized = false;
-    const bool isSpmvOptimized = false;
-    const bool isMgOptimized = false;
+    bool isSpmvOptimized = false;
+    bool isMgOptimized = false;
     const bool isWaxpbyOptimized = false;
 
     /**
@@ -592,6 +773,8 @@ struct SparseMatrix : public PhysicalMultiBase {
         delete dcAllRedSumFT;
         delete dcAllRedMinFT;
         delete dcAllRedMaxFT;
+        delete dcAllRedSumFused;
+        delete dcAllRedSumRepro;
         delete neighbors;
         delete sendLength;
         delete recvLength;
@@ -604,11 +787,46 @@ struct SparseMatrix : public PhysicalMultiBase {
             //elementsToSend->deallocate
             delete elementsToSend;
         }
+        delete haloRowOrder;
         for (auto *i : pullBuffers) delete i;
+        delete sellValues;
+        delete sellColInds;
+        delete sellChunkPtr;
+        delete sellRowPerm;
+        delete colorRows;
+        delete colorPtr;
+        delete matrixValuesMG;
         if (Ac) delete Ac;
         if (mgData) delete mgData;
     }
 
+    /**
+     * Unmaps the global column indices and the local-to-global row map on this
+     * level and all coarser ones. Both are only read by problem generation,
+     * SetupHalo, and the checkpoint writer, so call this after those (and after
+     * OptimizeProblem) when the memory is better spent elsewhere.
+     */
+    void
+    releaseSetupIndices(
+        Context ctx,
+        HighLevelRuntime *lrt
+    ) {
+        if (mtxIndG) {
+            nDroppedSetupBytes += mtxIndG->length() * sizeof(global_int_t);
+            lrt->unmap_region(ctx, mtxIndG->physicalRegion);
+            delete mtxIndG;
+            mtxIndG = nullptr;
+        }
+        if (localToGlobalMap) {
+            nDroppedSetupBytes += localToGlobalMap->length()
+                               *  sizeof(global_int_t);
+            lrt->unmap_region(ctx, localToGlobalMap->physicalRegion);
+            delete localToGlobalMap;
+            localToGlobalMap = nullptr;
+        }
+        if (Ac) Ac->releaseSetupIndices(ctx, lrt);
+    }
+
 protected:
 
     /**
@@ -639,58 +857,97 @@ protected:
         HighLevelRuntime *rt
     ) {
         size_t cid = baseRID;
-        // Populate members from physical regions.
-        geom = new Item<Geometry>(regions[cid++], ctx, rt);
+        // Populate members from physical regions, several items per region
+        // (see LogicalSparseMatrix::allocate).
+        const PhysicalRegion &shardRegion = regions[cid++];
+        geom = new Item<Geometry>(shardRegion, SMF_GEOMS, ctx, rt);
         assert(geom->data());
         //
-        sclrs = new Item<SparseMatrixScalars>(regions[cid++], ctx, rt);
+        sclrs = new Item<SparseMatrixScalars>(shardRegion, SMF_SCLRS, ctx, rt);
         assert(sclrs->data());
         //
-        nonzerosInRow = new Array<char>(regions[cid++], ctx, rt);
-        assert(nonzerosInRow->data());
-        //
-        mtxIndG = new Array<global_int_t>(regions[cid++], ctx, rt);
-        assert(mtxIndG->data());
-        //
-        mtxIndL = new Array<local_int_t>(regions[cid++], ctx, rt);
-        assert(mtxIndL->data());
-        //
-        matrixValues = new Array<floatType>(regions[cid++], ctx, rt);
-        assert(matrixValues->data());
-        //
-        matrixDiagonal = new Array<floatType>(regions[cid++], ctx, rt);
-        assert(matrixDiagonal->data());
-        //
-        localToGlobalMap = new Array<global_int_t>(regions[cid++], ctx, rt);
-        assert(localToGlobalMap->data());
-        //
-        dcAllRedSumGI = new Item< DynColl<global_int_t> >(regions[cid++], ctx, rt);
+        dcAllRedSumGI = new Item< DynColl<global_int_t> >(
+            shardRegion, SMF_DC_SUM_GI, ctx, rt
+        );
         assert(dcAllRedSumGI->data());
         //
-        dcAllRedSumFT = new Item< DynColl<floatType> >(regions[cid++], ctx, rt);
+        dcAllRedSumFT = new Item< DynColl<floatType> >(
+            shardRegion, SMF_DC_SUM_FT, ctx, rt
+        );
         assert(dcAllRedSumFT->data());
         //
-        dcAllRedMinFT = new Item< DynColl<floatType> >(regions[cid++], ctx, rt);
+        dcAllRedMinFT = new Item< DynColl<floatType> >(
+            shardRegion, SMF_DC_MIN_FT, ctx, rt
+        );
         assert(dcAllRedMinFT->data());
         //
-        dcAllRedMaxFT = new Item< DynColl<floatType> >(regions[cid++], ctx, rt);
+        dcAllRedMaxFT = new Item< DynColl<floatType> >(
+            shardRegion, SMF_DC_MAX_FT, ctx, rt
+        );
         assert(dcAllRedMaxFT->data());
         //
-        neighbors = new Array<int>(regions[cid++], ctx, rt);
+        dcAllRedSumFused = new Item< DynColl<FusedReduceValues> >(
+            shardRegion, SMF_DC_SUM_FUSED, ctx, rt
+        );
+        assert(dcAllRedSumFused->data());
+        //
+        dcAllRedSumRepro = new Item< DynColl<ReproSumValue> >(
+            shardRegion, SMF_DC_SUM_REPRO, ctx, rt
+        );
+        assert(dcAllRedSumRepro->data());
+        //
+        synchronizers = new Item<Synchronizers>(
+            shardRegion, SMF_SYNCHRONIZERS, ctx, rt
+        );
+        assert(synchronizers->data());
+        //
+        const PhysicalRegion &neighborRegion = regions[cid++];
+        neighbors = new Array<int>(neighborRegion, SMF_NEIGHBORS, ctx, rt);
         assert(neighbors->data());
         //
-        sendLength = new Array<local_int_t>(regions[cid++], ctx, rt);
+        sendLength = new Array<local_int_t>(
+            neighborRegion, SMF_SEND_LENGTH, ctx, rt
+        );
         assert(sendLength->data());
         //
-        recvLength = new Array<local_int_t>(regions[cid++], ctx, rt);
+        recvLength = new Array<local_int_t>(
+            neighborRegion, SMF_RECV_LENGTH, ctx, rt
+        );
         assert(recvLength->data());
         //
-        synchronizers = new Item<Synchronizers>(regions[cid++], ctx, rt);
-        assert(synchronizers->data());
+        const PhysicalRegion &rowRegion = regions[cid++];
+        nonzerosInRow = new Array<char>(
+            rowRegion, SMF_NONZEROS_IN_ROW, ctx, rt
+        );
+        assert(nonzerosInRow->data());
+        //
+        matrixDiagonal = new Array<floatType>(
+            rowRegion, SMF_MATRIX_DIAGONAL, ctx, rt
+        );
+        assert(matrixDiagonal->data());
         //
-        matdIdxToMatRowCol = new Array<rcpType>(regions[cid++], ctx, rt);
+        matdIdxToMatRowCol = new Array<rcpType>(
+            rowRegion, SMF_MATD_IDX_TO_MAT_ROW_COL, ctx, rt
+        );
         assert(matdIdxToMatRowCol->data());
         //
+        const PhysicalRegion &nonzeroRegion = regions[cid++];
+        mtxIndL = new Array<local_int_t>(
+            nonzeroRegion, SMF_MTX_IND_L, ctx, rt
+        );
+        assert(mtxIndL->data());
+        //
+        matrixValues = new Array<floatType>(
+            nonzeroRegion, SMF_MATRIX_VALUES, ctx, rt
+        );
+        assert(matrixValues->data());
+        //
+        mtxIndG = new Array<global_int_t>(regions[cid++], ctx, rt);
+        assert(mtxIndG->data());
+        //
+        localToGlobalMap = new Array<global_int_t>(regions[cid++], ctx, rt);
+        assert(localToGlobalMap->data());
+        //
         if (withGhosts(iFlags)) {
             cid += mSetupGhostStructures(regions, cid, ctx, rt);
         }
@@ -752,6 +1009,8 @@ PopulateGlobalToLocalMap(
     const global_int_t gny = ny * npy;
     //!< global-to-local mapping
     auto &globalToLocalMap = A.globalToLocalMap;
+    globalToLocalMap.clear();
+    globalToLocalMap.reserve(nx * ny * nz);
     //
     for (local_int_t iz = 0; iz < nz; iz++) {
         global_int_t giz = ipz*nz+iz;
@@ -761,10 +1020,36 @@ PopulateGlobalToLocalMap(
                 global_int_t gix = ipx*nx+ix;
                 local_int_t currentLocalRow = iz*nx*ny+iy*nx+ix;
                 global_int_t currentGlobalRow = giz*gnx*gny+giy*gnx+gix;
-                globalToLocalMap[currentGlobalRow] = currentLocalRow;
+                globalToLocalMap.insert(currentGlobalRow, currentLocalRow);
             }
         }
     }
+    // Rows are visited in global order, so this doesn't need to sort.
+    globalToLocalMap.finalize();
+}
+
+/**
+ * Allocates x with one element per local column of A, on the index space of
+ * the other vectors with ghosts of A's level, so that Partition gives them one
+ * halo partition.
+ */
+inline void
+AllocateWithGhosts(
+    SparseMatrix &A,
+    const std::string &name,
+    LogicalArray<floatType> &x,
+    LegionRuntime::HighLevel::Context ctx,
+    LegionRuntime::HighLevel::HighLevelRuntime *lrt
+) {
+    if (!A.haloIndexSpace.exists()) {
+        const local_int_t ncol = A.sclrs->data()->localNumberOfColumns;
+        Domain dom(Domain::from_rect<1>(
+            Rect<1>(Point<1>::ZEROES(), Point<1>(ncol - 1))
+        ));
+        A.haloIndexSpace = lrt->create_index_space(ctx, dom);
+        lrt->attach_name(A.haloIndexSpace, (name + "-halo").c_str());
+    }
+    x.allocate(name, A.haloIndexSpace, ctx, lrt);
 }
 
 /**
@@ -785,10 +1070,13 @@ SetupGhostArrays(
     assert(Asclrs);
     const int nNeighbors = Asclrs->numberOfSendNeighbors;
 
+    auto xis = x.logicalRegion.get_index_space();
+    // Vectors allocated with AllocateWithGhosts share the level's partition.
+    auto xip = xis == A.haloIndexSpace && A.haloIndexPartition.exists()
+             ? A.haloIndexPartition
+             : lrt->get_index_partition(ctx, xis, 0 /* color */);
+    auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
     for (int n = 0; n < nNeighbors; ++n) {
-        auto xis = x.logicalRegion.get_index_space();
-        auto xip = lrt->get_index_partition(ctx, xis, 0 /* color */);
-        auto xlp = lrt->get_logical_partition(ctx, x.logicalRegion, xip);
         LogicalRegion xSubReg = lrt->get_logical_subregion_by_color(
             ctx,
             xlp,
@@ -880,6 +1168,13 @@ Partition(
     Context ctx,
     HighLevelRuntime *lrt
 ) {
+    const bool sharesHaloSpace =
+        x.logicalRegion.get_index_space() == A.haloIndexSpace;
+    // The level's halo partition is made once.
+    if (sharesHaloSpace && A.haloIndexPartition.exists()) {
+        x.partition(A.haloIndexPartition, A.haloColorDomain, ctx, lrt);
+        return;
+    }
     const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
     const local_int_t ncol = A.sclrs->data()->localNumberOfColumns;
     // First nrow items are 'local data'. After is remote data.
@@ -899,4 +1194,8 @@ Partition(
     assert(totLen == ncol);
     //
     x.partition(partLens, ctx, lrt);
+    if (sharesHaloSpace) {
+        A.haloIndexPartition = x.indexPartition;
+        A.haloColorDomain = x.launchDomain;
+    }
 }
@@ -0,0 +1,517 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file LegionMultiCGData.hpp
+
+    Shard-private vectors of CGMulti, one set per right-hand side. Every
+    column is a separate Array, so it keeps its own ghost partition and cached
+    halo plan; the multi-RHS kernels (ComputeMultiRHS.hpp) read each matrix
+    row once for all columns.
+ */
+
+#pragma once
+
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "ExchangeHalo.hpp"
+
+#include <string>
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * Right-hand side, solution and CG vectors of one column.
+ */
+struct LogicalRHSColumn : public LogicalMultiBase {
+    LogicalArray<floatType> b;  //!< Right-hand side.
+    LogicalArray<floatType> x;  //!< Solution vector.
+    LogicalArray<floatType> r;  //!< Residual vector.
+    LogicalArray<floatType> z;  //!< Preconditioned residual vector.
+    LogicalArray<floatType> p;  //!< Direction vector.
+    LogicalArray<floatType> Ap; //!< Krylov vector.
+
+protected:
+
+    /**
+     * Order matters here. If you update this, also update unpack.
+     */
+    void
+    mPopulateRegionList(void) {
+        mLogicalItems = {&b, &x, &r, &z, &p, &Ap};
+    }
+
+public:
+    /**
+     *
+     */
+    LogicalRHSColumn(void) {
+        mPopulateRegionList();
+    }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Geometry &geom,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    void
+    allocate(
+        const std::string &name,
+        SparseMatrix &A,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        #define aalloca(sName, size, ctx, rtp)                                 \
+        do {                                                                   \
+            sName.allocate(name + "-" #sName, size, ctx, rtp);                 \
+        } while(0)
+
+        const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+        //
+        aalloca(b,  nrow, ctx, lrt);
+        aalloca(x,  nrow, ctx, lrt);
+        aalloca(r,  nrow, ctx, lrt);
+        AllocateWithGhosts(A, name + "-z", z, ctx, lrt);
+        AllocateWithGhosts(A, name + "-p", p, ctx, lrt);
+        aalloca(Ap, nrow, ctx, lrt);
+
+        #undef aalloca
+    }
+
+    /**
+     *
+     */
+    void
+    partition(
+        int64_t nParts,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    /**
+     *
+     */
+    void
+    partition(
+        SparseMatrix &A,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        Partition(A, z, ctx, lrt);
+        Partition(A, p, ctx, lrt);
+        // The remaining vectors don't need to be partitioned.
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * MG vectors of one column at one level (see LogicalMGData). The f2c operator
+ * is shared with the level's MGData.
+ */
+struct LogicalMGColumn : public LogicalMultiBase {
+    // Coarse grid residual vector.
+    LogicalArray<floatType> rc;
+    // Coarse grid solution vector.
+    LogicalArray<floatType> xc;
+    // Fine grid residual vector.
+    LogicalArray<floatType> Axf;
+
+protected:
+
+    /**
+     * Order matters here. If you update this, also update unpack.
+     */
+    void
+    mPopulateRegionList(void) {
+        mLogicalItems = {&rc, &xc, &Axf};
+    }
+
+public:
+    /**
+     *
+     */
+    LogicalMGColumn(void) {
+        mPopulateRegionList();
+    }
+
+    /**
+     *
+     */
+    void
+    allocate(
+        const std::string &name,
+        const Geometry &geom,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    void
+    allocate(
+        const std::string &name,
+        SparseMatrix &A,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        assert(A.Ac);
+        //
+        const local_int_t nrowc = A.Ac->sclrs->data()->localNumberOfRows;
+        //
+        rc.allocate (name + "-rc",  nrowc, ctx, lrt);
+        AllocateWithGhosts(*A.Ac, name + "-xc", xc, ctx, lrt);
+        AllocateWithGhosts(A, name + "-Axf", Axf, ctx, lrt);
+    }
+
+    /**
+     *
+     */
+    void
+    partition(
+        int64_t nParts,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) { /* Nothing to do. */ }
+
+    /**
+     *
+     */
+    void
+    partition(
+        SparseMatrix &A,
+        LegionRuntime::HighLevel::Context ctx,
+        LegionRuntime::HighLevel::HighLevelRuntime *lrt
+    ) {
+        Partition(*A.Ac, xc, ctx, lrt);
+        Partition(A, Axf, ctx, lrt);
+        // rc doesn't need to be partitioned.
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct RHSColumn : public PhysicalMultiBase {
+    //
+    Array<floatType> *b = nullptr;
+    //
+    Array<floatType> *x = nullptr;
+    //
+    Array<floatType> *r = nullptr;
+    //
+    Array<floatType> *z = nullptr;
+    //
+    Array<floatType> *p = nullptr;
+    //
+    Array<floatType> *Ap = nullptr;
+
+    /**
+     *
+     */
+    RHSColumn(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) {
+        mUnpack(regions, baseRID, IFLAG_NIL, ctx, runtime);
+    }
+
+    /**
+     *
+     */
+    virtual
+    ~RHSColumn(void) {
+        delete b;
+        delete x;
+        delete r;
+        delete z;
+        delete p;
+        delete Ap;
+    }
+
+    /**
+     *
+     */
+    void
+    unmapRegions(
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        lrt->unmap_region(ctx, b->physicalRegion);
+        lrt->unmap_region(ctx, x->physicalRegion);
+        lrt->unmap_region(ctx, r->physicalRegion);
+        lrt->unmap_region(ctx, z->physicalRegion);
+        lrt->unmap_region(ctx, p->physicalRegion);
+        lrt->unmap_region(ctx, Ap->physicalRegion);
+    }
+
+protected:
+
+    /**
+     * MUST MATCH PACK ORDER IN mPopulateRegionList!
+     */
+    void
+    mUnpack(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        ItemFlags iFlags,
+        Context ctx,
+        HighLevelRuntime *rt
+    ) {
+        size_t cid = baseRID;
+        // Populate members from physical regions.
+        b = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(b->data());
+        //
+        x = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(x->data());
+        //
+        r = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(r->data());
+        //
+        z = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(z->data());
+        //
+        p = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(p->data());
+        //
+        Ap = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(Ap->data());
+        // Calculate number of region entries for this structure.
+        mNRegionEntries = cid - baseRID;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+struct MGColumn : public PhysicalMultiBase {
+    //
+    Array<floatType> *rc = nullptr;
+    //
+    Array<floatType> *xc = nullptr;
+    //
+    Array<floatType> *Axf = nullptr;
+
+    /**
+     *
+     */
+    MGColumn(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        Context ctx,
+        HighLevelRuntime *runtime
+    ) {
+        mUnpack(regions, baseRID, IFLAG_NIL, ctx, runtime);
+    }
+
+    /**
+     *
+     */
+    virtual
+    ~MGColumn(void) {
+        delete rc;
+        delete xc;
+        delete Axf;
+    }
+
+    /**
+     *
+     */
+    void
+    unmapRegions(
+        Legion::Context ctx,
+        Legion::HighLevelRuntime *lrt
+    ) {
+        lrt->unmap_region(ctx, rc->physicalRegion);
+        lrt->unmap_region(ctx, xc->physicalRegion);
+        lrt->unmap_region(ctx, Axf->physicalRegion);
+    }
+
+protected:
+
+    /**
+     * MUST MATCH PACK ORDER IN mPopulateRegionList!
+     */
+    void
+    mUnpack(
+        const std::vector<PhysicalRegion> &regions,
+        size_t baseRID,
+        ItemFlags iFlags,
+        Context ctx,
+        HighLevelRuntime *rt
+    ) {
+        size_t cid = baseRID;
+        //
+        rc = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(rc->data());
+        //
+        xc = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(xc->data());
+        //
+        Axf = new Array<floatType>(regions[cid++], ctx, rt);
+        assert(Axf->data());
+        // Calculate number of region entries for this structure.
+        mNRegionEntries = cid - baseRID;
+    }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * All vectors of a CGMulti solve with nRhs right-hand sides: one RHSColumn per
+ * column and one MGColumn per column and coarsened level (mg[level][j] belongs
+ * to the matrix at that level).
+ */
+struct MultiCGData {
+    //
+    int nRhs = 0;
+    //
+    int nLevels = 0;
+    //
+    LogicalRHSColumn lColumns[HPCG_MAX_RHS];
+    //
+    LogicalMGColumn lMG[HPCG_MAX_MG_LEVELS][HPCG_MAX_RHS];
+    //
+    RHSColumn *columns[HPCG_MAX_RHS] = {};
+    //
+    MGColumn *mg[HPCG_MAX_MG_LEVELS][HPCG_MAX_RHS] = {};
+    // Same as CGData::convergenceCheckFreq.
+    int convergenceCheckFreq = 1;
+
+    /**
+     * Allocates and maps the vectors of nRhs columns for the numberOfMgLevels
+     * levels starting at A, and sets up their ghosts and halo plans. Must be
+     * called after SetupHalo on every level.
+     */
+    void
+    allocate(
+        SparseMatrix &A,
+        int nRhs,
+        int numberOfMgLevels,
+        Context ctx,
+        HighLevelRuntime *lrt
+    ) {
+        assert(nRhs >= 1 && nRhs <= HPCG_MAX_RHS);
+        assert(numberOfMgLevels <= HPCG_MAX_MG_LEVELS);
+        this->nRhs = nRhs;
+        nLevels = numberOfMgLevels;
+        //
+        for (int j = 0; j < nRhs; ++j) {
+            const std::string name = "cgmulti-" + std::to_string(j);
+            LogicalRHSColumn &lc = lColumns[j];
+            lc.allocate(name, A, ctx, lrt);
+            lc.partition(A, ctx, lrt);
+            //
+            std::vector<PhysicalRegion> regions = {
+                 lc.b.mapRegion(RW_E, ctx, lrt),
+                 lc.x.mapRegion(RW_E, ctx, lrt),
+                 lc.r.mapRegion(RW_E, ctx, lrt),
+                 lc.z.mapRegion(RW_E, ctx, lrt),
+                 lc.p.mapRegion(RW_E, ctx, lrt),
+                lc.Ap.mapRegion(RW_E, ctx, lrt)
+            };
+            columns[j] = new RHSColumn(regions, 0, ctx, lrt);
+            //
+            SetupGhostArrays(A, *columns[j]->z, ctx, lrt);
+            SetupGhostArrays(A, *columns[j]->p, ctx, lrt);
+            SetupHaloPlan(
+                A, *columns[j]->z, ctx, lrt, ShardKernelVariants().floatMGHalo
+            );
+            SetupHaloPlan(A, *columns[j]->p, ctx, lrt);
+        }
+        //
+        SparseMatrix *curLevelMatrix = &A;
+        for (int level = 0; level < nLevels - 1; ++level) {
+            for (int j = 0; j < nRhs; ++j) {
+                const std::string name = "cgmulti-" + std::to_string(j)
+                                       + "-L" + std::to_string(level);
+                LogicalMGColumn &lm = lMG[level][j];
+                lm.allocate(name, *curLevelMatrix, ctx, lrt);
+                lm.partition(*curLevelMatrix, ctx, lrt);
+                //
+                std::vector<PhysicalRegion> regions = {
+                     lm.rc.mapRegion(RW_E, ctx, lrt),
+                     lm.xc.mapRegion(RW_E, ctx, lrt),
+                    lm.Axf.mapRegion(RW_E, ctx, lrt)
+                };
+                mg[level][j] = new MGColumn(regions, 0, ctx, lrt);
+                //
+                SparseMatrix &Ac = *curLevelMatrix->Ac;
+                SetupGhostArrays(Ac, *mg[level][j]->xc, ctx, lrt);
+                SetupHaloPlan(
+                    Ac, *mg[level][j]->xc, ctx, lrt,
+                    ShardKernelVariants().floatMGHalo
+                );
+            }
+            curLevelMatrix = curLevelMatrix->Ac;
+        }
+    }
+
+    /**
+     * Unmaps and returns everything allocate() created.
+     */
+    void
+    deallocate(
+        Context ctx,
+        HighLevelRuntime *lrt
+    ) {
+        for (int level = 0; level < nLevels - 1; ++level) {
+            for (int j = 0; j < nRhs; ++j) {
+                mg[level][j]->unmapRegions(ctx, lrt);
+                delete mg[level][j];
+                mg[level][j] = nullptr;
+                lMG[level][j].deallocate(ctx, lrt);
+            }
+        }
+        for (int j = 0; j < nRhs; ++j) {
+            columns[j]->unmapRegions(ctx, lrt);
+            delete columns[j];
+            columns[j] = nullptr;
+            lColumns[j].deallocate(ctx, lrt);
+        }
+        nRhs = 0;
+        nLevels = 0;
+    }
+};
@@ -0,0 +1,145 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file LegionSequenceData.hpp
+
+    Shard-private vectors of CGSequence: the drifting right-hand side, its
+    direction of drift, the projected initial guess, and the recycled basis.
+    None of them is an SpMV input, so they are all fields of one region
+    without ghosts.
+ */
+
+#pragma once
+
+#include "LegionStuff.hpp"
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+
+#include <string>
+
+/**
+ * Fields of the sequence region. Basis vector j is field SQF_W0 + j.
+ */
+enum SequenceFieldID {
+    SQF_B = 0,
+    SQF_DELTA,
+    SQF_X0,
+    SQF_W0
+};
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+/**
+ * All vectors of a CGSequence run with up to nBasis recycled vectors.
+ */
+struct SequenceData {
+    //
+    int nBasis = 0;
+    // Number of basis vectors currently in use.
+    int nUsed = 0;
+    //
+    LogicalArray<floatType> lb;
+    //
+    LogicalArray<floatType> lDelta;
+    //
+    LogicalArray<floatType> lx0;
+    //
+    LogicalArray<floatType> lW[HPCG_MAX_RECYCLE];
+    //
+    PhysicalRegion region;
+    //! Right-hand side of the current solve.
+    Array<floatType> *b = nullptr;
+    //! Direction the right-hand side drifts in.
+    Array<floatType> *delta = nullptr;
+    //! Initial guess of the current solve.
+    Array<floatType> *x0 = nullptr;
+    //! A-orthonormal basis of earlier solution updates.
+    Array<floatType> *W[HPCG_MAX_RECYCLE] = {};
+
+    /**
+     * Allocates and maps the vectors for a basis of up to nBasis vectors.
+     */
+    void
+    allocate(
+        SparseMatrix &A,
+        int nBasis,
+        Context ctx,
+        HighLevelRuntime *lrt
+    ) {
+        assert(nBasis >= 0 && nBasis <= HPCG_MAX_RECYCLE);
+        this->nBasis = nBasis;
+        nUsed = 0;
+        //
+        const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+        lb.allocate("cgseq-b", nrow, ctx, lrt);
+        lDelta.allocateField("cgseq-delta", lb, SQF_DELTA, ctx, lrt);
+        lx0.allocateField("cgseq-x0", lb, SQF_X0, ctx, lrt);
+        for (int j = 0; j < nBasis; ++j) {
+            lW[j].allocateField(
+                "cgseq-w" + std::to_string(j), lb, SQF_W0 + j, ctx, lrt
+            );
+        }
+        //
+        region = lb.mapRegionFields(RW_E, ctx, lrt);
+        b = new Array<floatType>(region, SQF_B, ctx, lrt);
+        delta = new Array<floatType>(region, SQF_DELTA, ctx, lrt);
+        x0 = new Array<floatType>(region, SQF_X0, ctx, lrt);
+        for (int j = 0; j < nBasis; ++j) {
+            W[j] = new Array<floatType>(region, SQF_W0 + j, ctx, lrt);
+        }
+    }
+
+    /**
+     * Unmaps and returns everything allocate() created.
+     */
+    void
+    deallocate(
+        Context ctx,
+        HighLevelRuntime *lrt
+    ) {
+        if (!b) return;
+        lrt->unmap_region(ctx, region);
+        for (int j = 0; j < nBasis; ++j) {
+            delete W[j];
+            W[j] = nullptr;
+            lW[j].deallocate(ctx, lrt);
+        }
+        delete x0;
+        delete delta;
+        delete b;
+        x0 = delta = b = nullptr;
+        lx0.deallocate(ctx, lrt);
+        lDelta.deallocate(ctx, lrt);
+        lb.deallocate(ctx, lrt);
+        nBasis = nUsed = 0;
+    }
+};
@@ -33,6 +33,8 @@
 
 #include "TaskTIDs.hpp"
 #include "Types.hpp"
+#include "CGMapper.hpp"
+#include "Profiler.hpp"
 
 #include "legion.h"
 
@@ -124,6 +126,12 @@ registerComputeResidualTasks(void);
 void
 registerExchangeHaloTasks(void);
 
+void
+registerMultiRHSTasks(void);
+
+void
+registerChebyshevTasks(void);
+
 ////////////////////////////////////////////////////////////////////////////////
 // Task Registration
 ////////////////////////////////////////////////////////////////////////////////
@@ -184,6 +192,10 @@ registerTasks(void)
     registerComputeResidualTasks();
     //
     registerExchangeHaloTasks();
+    //
+    registerMultiRHSTasks();
+    //
+    registerChebyshevTasks();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -193,9 +205,11 @@ updateMappers(
     HighLevelRuntime *runtime,
     const std::set<Processor> &local_procs
 ) {
-#if 0 // Disable for now.
+#ifndef LGNCG_USE_DEFAULT_MAPPER
     for (const auto &p : local_procs) {
-        runtime->replace_default_mapper(new CGMapper(machine, runtime, p), p);
+        runtime->replace_default_mapper(
+            new CGMapper(runtime->get_mapper_runtime(), machine, p), p
+        );
     }
 #endif
 }
@@ -0,0 +1,129 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file MatrixFree.hpp
+
+    Helpers for applying the HPCG 27-point operator directly from Geometry
+    (LGNCG_USE_MATRIX_FREE). Only rows without ghost columns are computed this
+    way; rows that couple to a neighbor's points still use the stored matrix,
+    because their ghost column indices come from SetupHalo.
+ */
+
+#pragma once
+
+#include "Types.hpp"
+#include "Geometry.hpp"
+
+// Values generated by GenerateProblem for the 27-point operator.
+#define LGNCG_STENCIL_DIAGONAL      26.0
+#define LGNCG_STENCIL_OFF_DIAGONAL  -1.0
+
+/**
+ * Returns whether local row i has at least one column in another shard's
+ * subdomain (i.e., a ghost column).
+ */
+inline bool
+StencilRowHasGhostColumns(
+    const Geometry &geom,
+    local_int_t i
+) {
+    const local_int_t nx = geom.nx, ny = geom.ny;
+    const local_int_t iz = i / (nx * ny);
+    const local_int_t iy = (i - iz * nx * ny) / nx;
+    const local_int_t ix = i % nx;
+    //
+    return (ix == 0           && geom.ipx > 0)            ||
+           (ix == nx - 1      && geom.ipx < geom.npx - 1) ||
+           (iy == 0           && geom.ipy > 0)            ||
+           (iy == ny - 1      && geom.ipy < geom.npy - 1) ||
+           (iz == 0           && geom.ipz > 0)            ||
+           (iz == geom.nz - 1 && geom.ipz < geom.npz - 1);
+}
+
+/**
+ * Returns the sum of x over the local neighbors of row i, excluding i itself.
+ * Neighbors outside of the local subdomain are skipped, so this is only the
+ * off-diagonal part of a row when !StencilRowHasGhostColumns(geom, i).
+ */
+inline floatType
+StencilNeighborSum(
+    const Geometry &geom,
+    const floatType *const xv,
+    local_int_t i
+) {
+    const local_int_t nx = geom.nx, ny = geom.ny, nz = geom.nz;
+    const local_int_t iz = i / (nx * ny);
+    const local_int_t iy = (i - iz * nx * ny) / nx;
+    const local_int_t ix = i % nx;
+    // Clip the 3x3x3 box to the subdomain.
+    const local_int_t z0 = iz > 0 ? -1 : 0, z1 = iz < nz - 1 ? 1 : 0;
+    const local_int_t y0 = iy > 0 ? -1 : 0, y1 = iy < ny - 1 ? 1 : 0;
+    const local_int_t x0 = ix > 0 ? -1 : 0, x1 = ix < nx - 1 ? 1 : 0;
+    //
+    floatType sum = 0.0;
+    for (local_int_t sz = z0; sz <= z1; ++sz) {
+        for (local_int_t sy = y0; sy <= y1; ++sy) {
+            const floatType *const xrow = xv + i + sz * nx * ny + sy * nx;
+            for (local_int_t sx = x0; sx <= x1; ++sx) {
+                sum += xrow[sx];
+            }
+        }
+    }
+    // Remove the center point.
+    return sum - xv[i];
+}
+
+/**
+ * Returns (Ax)_i for a row without ghost columns.
+ */
+inline floatType
+StencilRowApply(
+    const Geometry &geom,
+    const floatType *const xv,
+    local_int_t i
+) {
+    return LGNCG_STENCIL_DIAGONAL * xv[i]
+         + LGNCG_STENCIL_OFF_DIAGONAL * StencilNeighborSum(geom, xv, i);
+}
+
+/**
+ * Gauss-Seidel update of x_i for a row without ghost columns.
+ */
+inline void
+StencilSYMGSRowUpdate(
+    const Geometry &geom,
+    const floatType *const rv,
+    floatType *const xv,
+    local_int_t i
+) {
+    const floatType sum = rv[i] - LGNCG_STENCIL_OFF_DIAGONAL
+                                * StencilNeighborSum(geom, xv, i);
+    xv[i] = sum / LGNCG_STENCIL_DIAGONAL;
+}
@@ -0,0 +1,197 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file MemoryFootprint.hpp
+
+    Per-level accounting of the bytes a shard holds in its matrix and MG
+    regions, as opposed to the analytic model in ReportResults.
+ */
+
+#pragma once
+
+#include "LegionArrays.hpp"
+#include "LegionMatrices.hpp"
+#include "LegionMGData.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/**
+ *
+ */
+struct RegionFootprint {
+    // Name of the SparseMatrix or MGData member.
+    std::string name;
+    // Bytes mapped by this shard.
+    size_t nBytes;
+};
+
+/**
+ *
+ */
+struct LevelFootprint {
+    //
+    std::vector<RegionFootprint> regions;
+    // Bytes released by SparseMatrix::releaseSetupIndices.
+    size_t nDroppedBytes = 0;
+
+    /**
+     *
+     */
+    size_t
+    total(void) const {
+        size_t nBytes = 0;
+        for (const auto &r : regions) nBytes += r.nBytes;
+        return nBytes;
+    }
+};
+
+/**
+ * Records the size of a mapped Array. Unmapped (nullptr) members are skipped.
+ */
+template<typename TYPE>
+inline void
+addFootprint(
+    LevelFootprint &lf,
+    const char *name,
+    const Array<TYPE> *a
+) {
+    if (!a) return;
+    lf.regions.push_back({name, a->length() * sizeof(TYPE)});
+}
+
+/**
+ * Records the size of a single-element Item.
+ */
+template<typename TYPE>
+inline void
+addFootprint(
+    LevelFootprint &lf,
+    const char *name,
+    const Item<TYPE> *i
+) {
+    if (!i) return;
+    lf.regions.push_back({name, sizeof(TYPE)});
+}
+
+/**
+ * Returns this shard's footprint for each MG level, finest first. The MG
+ * transfer vectors of a level are those that restrict to its coarse level.
+ */
+inline std::vector<LevelFootprint>
+ComputeMemoryFootprint(
+    SparseMatrix &A
+) {
+    std::vector<LevelFootprint> levels;
+    //
+    for (SparseMatrix *curLevelMatrix = &A;
+         curLevelMatrix; curLevelMatrix = curLevelMatrix->Ac) {
+        const SparseMatrix &L = *curLevelMatrix;
+        LevelFootprint lf;
+        //
+        addFootprint(lf, "geom",               L.geom);
+        addFootprint(lf, "sclrs",              L.sclrs);
+        addFootprint(lf, "nonzerosInRow",      L.nonzerosInRow);
+        addFootprint(lf, "mtxIndG",            L.mtxIndG);
+        addFootprint(lf, "mtxIndL",            L.mtxIndL);
+        addFootprint(lf, "matrixValues",       L.matrixValues);
+        addFootprint(lf, "matrixDiagonal",     L.matrixDiagonal);
+        addFootprint(lf, "localToGlobalMap",   L.localToGlobalMap);
+        addFootprint(lf, "dcAllRedSumGI",      L.dcAllRedSumGI);
+        addFootprint(lf, "dcAllRedSumFT",      L.dcAllRedSumFT);
+        addFootprint(lf, "dcAllRedMinFT",      L.dcAllRedMinFT);
+        addFootprint(lf, "dcAllRedMaxFT",      L.dcAllRedMaxFT);
+        addFootprint(lf, "dcAllRedSumFused",   L.dcAllRedSumFused);
+        addFootprint(lf, "dcAllRedSumRepro",   L.dcAllRedSumRepro);
+        addFootprint(lf, "neighbors",          L.neighbors);
+        addFootprint(lf, "sendLength",         L.sendLength);
+        addFootprint(lf, "recvLength",         L.recvLength);
+        addFootprint(lf, "synchronizers",      L.synchronizers);
+        addFootprint(lf, "matdIdxToMatRowCol", L.matdIdxToMatRowCol);
+        addFootprint(lf, "elementsToSend",     L.elementsToSend);
+        addFootprint(lf, "haloRowOrder",       L.haloRowOrder);
+        addFootprint(lf, "sellValues",         L.sellValues);
+        addFootprint(lf, "sellColInds",        L.sellColInds);
+        addFootprint(lf, "sellChunkPtr",       L.sellChunkPtr);
+        addFootprint(lf, "sellRowPerm",        L.sellRowPerm);
+        addFootprint(lf, "colorRows",          L.colorRows);
+        addFootprint(lf, "colorPtr",           L.colorPtr);
+        addFootprint(lf, "matrixValuesMG",     L.matrixValuesMG);
+        size_t nPullBytes = 0;
+        for (const auto *pb : L.pullBuffers) {
+            nPullBytes += pb->length() * sizeof(floatType);
+        }
+        lf.regions.push_back({"pullBuffers", nPullBytes});
+        if (L.mgData) {
+            addFootprint(lf, "f2cOperator", L.mgData->f2cOperator);
+            addFootprint(lf, "rc",          L.mgData->rc);
+            addFootprint(lf, "xc",          L.mgData->xc);
+            addFootprint(lf, "Axf",         L.mgData->Axf);
+            addFootprint(lf, "chebyD",      L.mgData->chebyD);
+        }
+        lf.nDroppedBytes = L.nDroppedSetupBytes;
+        //
+        levels.push_back(lf);
+    }
+    return levels;
+}
+
+/**
+ * Prints the footprint returned by ComputeMemoryFootprint, one line per
+ * region that has any bytes.
+ */
+inline void
+emitMemoryFootprint(
+    const std::vector<LevelFootprint> &levels
+) {
+    using namespace std;
+    //
+    size_t nTotal = 0, nDropped = 0;
+    for (size_t l = 0; l < levels.size(); ++l) {
+        const LevelFootprint &lf = levels[l];
+        cout << "--> Memory footprint level " << l << " (bytes) = "
+             << lf.total() << endl;
+        for (const auto &r : lf.regions) {
+            if (r.nBytes == 0) continue;
+            cout << "    " << left << setw(20) << r.name << right
+                 << setw(14) << r.nBytes << endl;
+        }
+        if (lf.nDroppedBytes) {
+            cout << "    " << left << setw(20) << "(released)" << right
+                 << setw(14) << lf.nDroppedBytes << endl;
+        }
+        nTotal += lf.total();
+        nDropped += lf.nDroppedBytes;
+    }
+    cout << "--> Memory footprint total (bytes) = " << nTotal
+         << " (" << nDropped << " released after setup)" << endl;
+}
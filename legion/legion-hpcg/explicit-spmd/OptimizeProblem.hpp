@@ -48,10 +48,192 @@
 
 #pragma once
 
+#include "hpcg.hpp"
+
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 #include "LegionCGData.hpp"
 
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cassert>
+
+/**
+ * Builds a SELL-C-sigma copy of A's local operator. Rows are sorted by their
+ * number of non-zeros within windows of HPCG_SELL_SIGMA rows, then grouped
+ * into chunks of HPCG_SELL_C rows that are stored column-major and padded to
+ * the longest row in the chunk. The result is used by ComputeSPMV.
+ */
+inline void
+GenerateSELLCSigma(
+    SparseMatrix &A,
+    Context ctx,
+    Runtime *lrt
+) {
+    using namespace std;
+    //
+    static_assert(HPCG_SELL_SIGMA % HPCG_SELL_C == 0,
+                  "HPCG_SELL_SIGMA must be a multiple of HPCG_SELL_C.");
+    //
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    const int nnpr = A.geom->data()->stencilSize;
+    const local_int_t C = HPCG_SELL_C;
+    const local_int_t nChunks = (nrow + C - 1) / C;
+    //
+    const char *const nonzerosInRow = A.nonzerosInRow->data();
+    assert(nonzerosInRow);
+    // Interpreted as 2D arrays
+    Array2D<floatType> matrixValues(nrow, nnpr, A.matrixValues->data());
+    Array2D<local_int_t> mtxIndL(nrow, nnpr, A.mtxIndL->data());
+    // Sort rows by length (longest first) within each sigma window.
+    vector<local_int_t> perm(nrow);
+    iota(perm.begin(), perm.end(), 0);
+    for (local_int_t w0 = 0; w0 < nrow; w0 += HPCG_SELL_SIGMA) {
+        const local_int_t w1 = min(nrow, w0 + HPCG_SELL_SIGMA);
+        stable_sort(
+            perm.begin() + w0, perm.begin() + w1,
+            [&](local_int_t a, local_int_t b) {
+                return nonzerosInRow[a] > nonzerosInRow[b];
+            }
+        );
+    }
+    // Chunk offsets.
+    vector<local_int_t> chunkPtr(nChunks + 1, 0);
+    for (local_int_t c = 0; c < nChunks; ++c) {
+        int width = 0;
+        for (local_int_t r = c * C; r < min(nrow, (c + 1) * C); ++r) {
+            width = max(width, int(nonzerosInRow[perm[r]]));
+        }
+        chunkPtr[c + 1] = chunkPtr[c] + width * C;
+    }
+    const local_int_t nSellEntries = chunkPtr[nChunks];
+    // Allocate and map SELL-C-sigma structures.
+    A.lSellValues.allocate("sellValues", nSellEntries, ctx, lrt);
+    A.sellValues = new Array<floatType>(
+        A.lSellValues.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    A.lSellColInds.allocate("sellColInds", nSellEntries, ctx, lrt);
+    A.sellColInds = new Array<local_int_t>(
+        A.lSellColInds.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    A.lSellChunkPtr.allocate("sellChunkPtr", nChunks + 1, ctx, lrt);
+    A.sellChunkPtr = new Array<local_int_t>(
+        A.lSellChunkPtr.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    A.lSellRowPerm.allocate("sellRowPerm", nrow, ctx, lrt);
+    A.sellRowPerm = new Array<local_int_t>(
+        A.lSellRowPerm.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    //
+    floatType *const sellValues = A.sellValues->data();
+    assert(sellValues);
+    local_int_t *const sellColInds = A.sellColInds->data();
+    assert(sellColInds);
+    local_int_t *const sellChunkPtr = A.sellChunkPtr->data();
+    assert(sellChunkPtr);
+    local_int_t *const sellRowPerm = A.sellRowPerm->data();
+    assert(sellRowPerm);
+    //
+    copy(chunkPtr.begin(), chunkPtr.end(), sellChunkPtr);
+    copy(perm.begin(), perm.end(), sellRowPerm);
+    //
+    for (local_int_t c = 0; c < nChunks; ++c) {
+        const local_int_t base = chunkPtr[c];
+        const int width = (chunkPtr[c + 1] - base) / C;
+        for (local_int_t r = 0; r < C; ++r) {
+            const local_int_t srow = c * C + r;
+            const local_int_t row = srow < nrow ? perm[srow] : -1;
+            const int nnz = row < 0 ? 0 : nonzerosInRow[row];
+            for (int j = 0; j < width; ++j) {
+                const local_int_t idx = base + j * C + r;
+                // Explicit zeros pad rows shorter than the chunk width.
+                sellValues[idx]  = j < nnz ? matrixValues(row, j) : 0.0;
+                sellColInds[idx] = j < nnz ? mtxIndL(row, j) : 0;
+            }
+        }
+    }
+    //
+    A.isSpmvOptimized = true;
+}
+
+/**
+ * Colors A's local rows for multicolor SYMGS. For the 27-point stencil the
+ * parity of a point's (x, y, z) coordinates gives an 8-coloring in which no two
+ * rows of the same color are coupled, so a color's rows may be updated in any
+ * order (or concurrently).
+ */
+inline void
+GenerateMulticoloring(
+    SparseMatrix &A,
+    Context ctx,
+    Runtime *lrt
+) {
+    using namespace std;
+    //
+    const Geometry *const Ageom = A.geom->data();
+    const local_int_t nx = Ageom->nx;
+    const local_int_t ny = Ageom->ny;
+    const local_int_t nz = Ageom->nz;
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    assert(nrow == nx * ny * nz);
+    //
+    A.lColorRows.allocate("colorRows", nrow, ctx, lrt);
+    A.colorRows = new Array<local_int_t>(
+        A.lColorRows.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    A.lColorPtr.allocate("colorPtr", HPCG_NUM_COLORS + 1, ctx, lrt);
+    A.colorPtr = new Array<local_int_t>(
+        A.lColorPtr.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    local_int_t *const colorRows = A.colorRows->data();
+    assert(colorRows);
+    local_int_t *const colorPtr = A.colorPtr->data();
+    assert(colorPtr);
+    // Rows are emitted color by color, in natural order within a color.
+    local_int_t cur = 0;
+    for (int color = 0; color < HPCG_NUM_COLORS; ++color) {
+        colorPtr[color] = cur;
+        const int cx = color & 1, cy = (color >> 1) & 1, cz = (color >> 2) & 1;
+        for (local_int_t iz = cz; iz < nz; iz += 2) {
+            for (local_int_t iy = cy; iy < ny; iy += 2) {
+                for (local_int_t ix = cx; ix < nx; ix += 2) {
+                    colorRows[cur++] = iz * nx * ny + iy * nx + ix;
+                }
+            }
+        }
+    }
+    colorPtr[HPCG_NUM_COLORS] = cur;
+    assert(cur == nrow);
+    //
+    A.isMgOptimized = true;
+}
+
+/**
+ * Stores a mgFloatType copy of A's matrix values for use by the MG
+ * preconditioner (see ComputeSYMGS and ComputeMG).
+ */
+inline void
+GenerateMGMatrixValues(
+    SparseMatrix &A,
+    Context ctx,
+    Runtime *lrt
+) {
+    const size_t nValues = A.matrixValues->length();
+    //
+    A.lMatrixValuesMG.allocate("matrixValuesMG", nValues, ctx, lrt);
+    A.matrixValuesMG = new Array<mgFloatType>(
+        A.lMatrixValuesMG.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    //
+    const floatType *const src = A.matrixValues->data();
+    assert(src);
+    mgFloatType *const dst = A.matrixValuesMG->data();
+    assert(dst);
+    //
+    for (size_t i = 0; i < nValues; ++i) dst[i] = mgFloatType(src[i]);
+}
+
 /*!
     Optimizes the data structures used for CG iteration to increase the
     performance of the benchmark version of the preconditioned CG algorithm.
@@ -76,23 +258,65 @@
 */
 inline int
 OptimizeProblem(
-    SparseMatrix &,
+    SparseMatrix &A,
     CGData &,
     Array<floatType> &,
     Array<floatType> &,
-    Array<floatType> &
+    Array<floatType> &,
+    Context ctx,
+    Runtime *lrt
 ) {
-    // This function can be used to completely transform any part of the data
-    // structures.  Right now it does nothing.
+    // Must be called after SetupHalo, since we need local column indices.
+    // Only build the storage the selected kernel variants read.
+    const KernelVariants &kv = ShardKernelVariants();
+    if (kv.spmv == SPMV_VARIANT_SELL) {
+        for (SparseMatrix *curLevelMatrix = &A;
+             curLevelMatrix; curLevelMatrix = curLevelMatrix->Ac) {
+            GenerateSELLCSigma(*curLevelMatrix, ctx, lrt);
+        }
+    }
+    if (kv.symgs == SYMGS_VARIANT_MC) {
+        for (SparseMatrix *curLevelMatrix = &A;
+             curLevelMatrix; curLevelMatrix = curLevelMatrix->Ac) {
+            GenerateMulticoloring(*curLevelMatrix, ctx, lrt);
+        }
+    }
+    if (kv.mixedPrecisionMG) {
+        for (SparseMatrix *curLevelMatrix = &A;
+             curLevelMatrix; curLevelMatrix = curLevelMatrix->Ac) {
+            GenerateMGMatrixValues(*curLevelMatrix, ctx, lrt);
+        }
+    }
     return 0;
 }
 
 /**
- *
+ * Returns the number of bytes allocated and retained by OptimizeProblem.
  */
 inline double
 OptimizeProblemMemoryUse(
-    SparseMatrix &
+    SparseMatrix &A
 ) {
-    return 0.0;
+    double nBytes = 0.0;
+    //
+    for (SparseMatrix *curLevelMatrix = &A;
+         curLevelMatrix; curLevelMatrix = curLevelMatrix->Ac) {
+        if (curLevelMatrix->isSpmvOptimized) {
+            const SparseMatrix &L = *curLevelMatrix;
+            nBytes += L.sellValues->length()   * sizeof(floatType)
+                   +  L.sellColInds->length()  * sizeof(local_int_t)
+                   +  L.sellChunkPtr->length() * sizeof(local_int_t)
+                   +  L.sellRowPerm->length()  * sizeof(local_int_t);
+        }
+        if (curLevelMatrix->isMgOptimized) {
+            const SparseMatrix &L = *curLevelMatrix;
+            nBytes += L.colorRows->length() * sizeof(local_int_t)
+                   +  L.colorPtr->length()  * sizeof(local_int_t);
+        }
+        if (curLevelMatrix->matrixValuesMG) {
+            const SparseMatrix &L = *curLevelMatrix;
+            nBytes += L.matrixValuesMG->length() * sizeof(mgFloatType);
+        }
+    }
+    return nBytes;
 }
@@ -0,0 +1,265 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file Profiler.hpp
+
+    Lightweight timeline profiler for leaf kernels and phase barrier waits.
+    Enabled with -DLGNCG_USE_PROFILER. Events are attributed to the processor
+    they ran on, which CGMapper keeps equal to the processor of the shard that
+    launched them.
+ */
+
+#pragma once
+
+#include "TaskTIDs.hpp"
+
+#include "legion.h"
+
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Pseudo task ID used for time spent blocked in PhaseBarrier::wait().
+#define LGNCG_PB_WAIT_PID -1
+
+/**
+ * Returns a printable name for a task ID in TaskTIDs.hpp.
+ */
+inline const char *
+ProfileEventName(int id)
+{
+    switch (id) {
+        case LGNCG_PB_WAIT_PID:               return "PHASE_BARRIER_WAIT";
+        case REGION_TO_REGION_COPY_TID:       return "REGION_TO_REGION_COPY";
+        case DYN_COLL_TASK_CONTRIB_GIT_TID:   return "DYN_COLL_CONTRIB_GIT";
+        case DYN_COLL_TASK_CONTRIB_FT_TID:    return "DYN_COLL_CONTRIB_FT";
+        case DYN_COLL_TASK_CONTRIB_FUSED_TID: return "DYN_COLL_CONTRIB_FUSED";
+        case COPY_VECTOR_TID:                 return "COPY_VECTOR";
+        case ZERO_VECTOR_TID:                 return "ZERO_VECTOR";
+        case FILLRAND_VECTOR_TID:             return "FILLRAND_VECTOR";
+        case WAXPBY_TID:                      return "WAXPBY";
+        case WAXPBY_DOT_TID:                  return "WAXPBY_DOT";
+        case SPMV_TID:                        return "SPMV";
+        case SPMV_SELL_TID:                   return "SPMV_SELL";
+        case SPMV_ROWS_TID:                   return "SPMV_ROWS";
+        case SPMV_DOT_TID:                    return "SPMV_DOT";
+        case DDOT_TID:                        return "DDOT";
+        case DDOT_FUSED_TID:                  return "DDOT_FUSED";
+        case DDOT_REPRO_TID:                  return "DDOT_REPRO";
+        case SYMGS_TID:                       return "SYMGS";
+        case SYMGS_MC_TID:                    return "SYMGS_MC";
+        case SYMGS_RESIDUAL_TID:              return "SYMGS_RESIDUAL";
+        case SPMV_MULTI_TID:                  return "SPMV_MULTI";
+        case SYMGS_MULTI_TID:                 return "SYMGS_MULTI";
+        case DDOT_MULTI_TID:                  return "DDOT_MULTI";
+        case CHEBYSHEV_TID:                   return "CHEBYSHEV";
+        case PROLONGATION_TID:                return "PROLONGATION";
+        case RESTRICTION_TID:                 return "RESTRICTION";
+        case RESTRICTION_RESIDUAL_TID:        return "RESTRICTION_RESIDUAL";
+        case INJECTION_TID:                   return "INJECTION";
+        case EXCHANGE_HALO_WIDEN_TID:         return "EXCHANGE_HALO_WIDEN";
+        case FUTURE_MATH_TID:                 return "FUTURE_MATH";
+        case COMPUTE_RESIDUAL_TID:            return "COMPUTE_RESIDUAL";
+        case EXCHANGE_HALO_TID:               return "EXCHANGE_HALO";
+        default:                              return "UNKNOWN";
+    }
+}
+
+/**
+ *
+ */
+struct ProfileEvent {
+    // Task ID (or LGNCG_PB_WAIT_PID).
+    int id;
+    // ID of the processor the event ran on.
+    Legion::Processor::id_t proc;
+    // Start and stop times in microseconds since the profiler's epoch.
+    double start;
+    double stop;
+    // Approximate number of bytes moved to and from memory.
+    size_t bytes;
+};
+
+/**
+ * Accumulated statistics for one kind of event.
+ */
+struct ProfileSummary {
+    size_t count = 0;
+    double seconds = 0.0;
+    double bytes = 0.0;
+};
+
+/**
+ * Process-wide event log. Kernels may run concurrently on different
+ * processors, so recording is serialized.
+ */
+class Profiler {
+    //
+    std::mutex mLock;
+    //
+    std::vector<ProfileEvent> mEvents;
+    //
+    std::chrono::steady_clock::time_point mEpoch;
+
+    /**
+     *
+     */
+    Profiler(void) : mEpoch(std::chrono::steady_clock::now()) { }
+
+public:
+    /**
+     *
+     */
+    static Profiler &
+    instance(void) {
+        static Profiler profiler;
+        return profiler;
+    }
+
+    /**
+     * Returns microseconds since the profiler's epoch.
+     */
+    double
+    now(void) const {
+        using namespace std::chrono;
+        return duration<double, std::micro>(
+            steady_clock::now() - mEpoch
+        ).count();
+    }
+
+    /**
+     *
+     */
+    void
+    record(const ProfileEvent &event) {
+        std::lock_guard<std::mutex> guard(mLock);
+        mEvents.push_back(event);
+    }
+
+    /**
+     * Returns all events recorded on proc.
+     */
+    std::vector<ProfileEvent>
+    events(Legion::Processor::id_t proc) {
+        std::lock_guard<std::mutex> guard(mLock);
+        std::vector<ProfileEvent> res;
+        for (const auto &e : mEvents) {
+            if (e.proc == proc) res.push_back(e);
+        }
+        return res;
+    }
+
+    /**
+     * Returns per event kind statistics of all events recorded on proc.
+     */
+    std::map<int, ProfileSummary>
+    summarize(Legion::Processor::id_t proc) {
+        std::map<int, ProfileSummary> res;
+        for (const auto &e : events(proc)) {
+            ProfileSummary &s = res[e.id];
+            s.count++;
+            s.seconds += (e.stop - e.start) / 1e6;
+            s.bytes += e.bytes;
+        }
+        return res;
+    }
+
+    /**
+     * Writes events recorded on proc as a Chrome/Perfetto trace (JSON). The
+     * shard is used as the trace's process ID so that per-shard files can be
+     * concatenated into one timeline.
+     */
+    int
+    writeChromeTrace(
+        int shard,
+        Legion::Processor::id_t proc,
+        const std::string &fileName
+    ) {
+        FILE *f = fopen(fileName.c_str(), "w");
+        if (!f) return 1;
+        //
+        const auto evs = events(proc);
+        fprintf(f, "{\"traceEvents\":[\n");
+        for (size_t i = 0; i < evs.size(); ++i) {
+            const ProfileEvent &e = evs[i];
+            fprintf(
+                f,
+                "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+                "\"pid\":%d,\"tid\":%llu,\"args\":{\"bytes\":%zu}}%s\n",
+                ProfileEventName(e.id),
+                e.start,
+                e.stop - e.start,
+                shard,
+                (unsigned long long)e.proc,
+                e.bytes,
+                (i + 1 < evs.size() ? "," : "")
+            );
+        }
+        fprintf(f, "]}\n");
+        fclose(f);
+        return 0;
+    }
+};
+
+/**
+ * Records the lifetime of the scope as one event on the executing processor.
+ */
+class ProfileScope {
+    //
+    ProfileEvent mEvent;
+
+public:
+    /**
+     *
+     */
+    ProfileScope(int id, size_t bytes) {
+        mEvent.id = id;
+        mEvent.proc = Legion::Processor::get_executing_processor().id;
+        mEvent.bytes = bytes;
+        mEvent.start = Profiler::instance().now();
+    }
+
+    /**
+     *
+     */
+    ~ProfileScope(void) {
+        mEvent.stop = Profiler::instance().now();
+        Profiler::instance().record(mEvent);
+    }
+};
+
+#ifdef LGNCG_USE_PROFILER
+#define LGNCG_PROFILE(id, bytes) ProfileScope lgncgProfileScope((id), (bytes))
+#else
+#define LGNCG_PROFILE(id, bytes)
+#endif
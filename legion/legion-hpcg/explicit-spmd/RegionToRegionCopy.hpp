@@ -56,5 +56,6 @@ regionToRegionCopyTask(
     assert(dv);
 
     const size_t cpySize = src.length() * sizeof(floatType);
+    LGNCG_PROFILE(REGION_TO_REGION_COPY_TID, 2 * cpySize);
     (void)memmove(dv, sv, cpySize);
 }
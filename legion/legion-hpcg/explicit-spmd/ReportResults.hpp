@@ -53,7 +53,11 @@
 #include "YAML_Element.hpp"
 #include "YAML_Doc.hpp"
 #include "OptimizeProblem.hpp"
+#include "MemoryFootprint.hpp"
+#include "Roofline.hpp"
+#include "CGSequence.hpp"
 
+#include <algorithm>
 #include <fstream>
 #include <vector>
 
@@ -85,9 +89,15 @@
     @param[in] testnorms_data The data structure with the results of the CG norm
                               test including pass/fail information.
 
+    @param[in] sequence_data  Results of the solve sequence phase (nSolves is
+                              0 if it did not run).
+
     @param[in] global_failure indicates whether a failure occured during the
                               correctness tests of CG.
 
+    @param[in] streamBandwidth STREAM triad bandwidth of all shards (bytes/s),
+                               0 if not measured.
+
     @see YAML_Doc
 */
 inline void
@@ -101,8 +111,10 @@ ReportResults(
     const TestCGData &testcg_data,
     const TestSymmetryData &testsymmetry_data,
     const TestNormsData &testnorms_data,
+    const SequenceSolveData &sequence_data,
     int global_failure,
     bool quickPath,
+    double streamBandwidth,
     Context ctx,
     HighLevelRuntime *lrt
 ) {
@@ -152,7 +164,7 @@ ReportResults(
             Af = Af->Ac; // Go to next coarse level
         }
 
-        fnops_precond += fniters * 4.0 * ((double) Af->sclrs->data()->totalNumberOfNonzeros); // One symmetric GS sweep at the coarsest level
+        fnops_precond += Af->numberOfCoarseSweeps * fniters * 4.0 * ((double) Af->sclrs->data()->totalNumberOfNonzeros); // Symmetric GS sweeps at the coarsest level
         double fnops = fnops_ddot + fnops_waxpby + fnops_sparsemv + fnops_precond;
         double frefnops = fnops * ((double) refMaxIters) / ((double) optMaxIters);
 
@@ -187,8 +199,8 @@ ReportResults(
 
         double fnnz_Af = Af->sclrs->data()->totalNumberOfNonzeros;
         double fnrow_Af = Af->sclrs->data()->totalNumberOfRows;
-        fnreads_precond += fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(local_int_t)) + fnrow_Af * sizeof(double));; // One symmetric GS sweep at the coarsest level
-        fnwrites_precond += fniters * fnrow_Af * sizeof(double); // One symmetric GS sweep at the coarsest level
+        fnreads_precond += Af->numberOfCoarseSweeps * fniters * (2.0 * fnnz_Af * (sizeof(double) + sizeof(local_int_t)) + fnrow_Af * sizeof(double));; // Symmetric GS sweeps at the coarsest level
+        fnwrites_precond += Af->numberOfCoarseSweeps * fniters * fnrow_Af * sizeof(double); // Symmetric GS sweeps at the coarsest level
         double fnreads = fnreads_ddot + fnreads_waxpby + fnreads_sparsemv + fnreads_precond;
         double fnwrites = fnwrites_ddot + fnwrites_waxpby + fnwrites_sparsemv + fnwrites_precond;
         double frefnreads = fnreads * ((double) refMaxIters) / ((double) optMaxIters);
@@ -330,6 +342,18 @@ ReportResults(
             doc.get("Memory Use Information")->get("Coarse Grids")->add("Memory used", fnbytesPerLevel[i] / 1000000000.0);
         }
 
+        // Bytes actually mapped by this shard, as opposed to the model above.
+        const std::vector<LevelFootprint> footprint = ComputeMemoryFootprint(A);
+        doc.add("Measured Memory Use (rank 0)", "");
+        for (size_t i = 0; i < footprint.size(); ++i) {
+            YAML_Element *level = doc.get("Measured Memory Use (rank 0)")->add("Grid Level", int(i));
+            for (const auto &r : footprint[i].regions) {
+                level->add(r.name, r.nBytes);
+            }
+            level->add("Total (bytes)", footprint[i].total());
+            level->add("Released after setup (bytes)", footprint[i].nDroppedBytes);
+        }
+
         doc.add("########## V&V Testing Summary  ##########", "");
         doc.add("Spectral Convergence Tests", "");
         if (testcg_data.count_fail == 0) {
@@ -380,6 +404,29 @@ ReportResults(
         doc.get("Reproducibility Information")->add("Scaled residual mean", testnorms_data.mean);
         doc.get("Reproducibility Information")->add("Scaled residual variance", testnorms_data.variance);
 
+        if (sequence_data.nSolves > 0) {
+            // Iterations of the solves after the first show what warm starts
+            // and recycling save (see CGSequence.hpp).
+            const int nSolves = sequence_data.nSolves;
+            int totalIters = 0;
+            for (int n : sequence_data.niters) totalIters += n;
+            floatType maxResidual = 0.0;
+            for (floatType sr : sequence_data.scaledResiduals) maxResidual = std::max(maxResidual, sr);
+            doc.add("########## Solve Sequence Summary  ##########", "");
+            doc.add("Solve Sequence Information", "");
+            doc.get("Solve Sequence Information")->add("Number of solves", nSolves);
+            doc.get("Solve Sequence Information")->add("Recycled vectors", sequence_data.nBasis);
+            doc.get("Solve Sequence Information")->add("Right-hand side drift per solve", sequence_data.drift);
+            doc.get("Solve Sequence Information")->add("Tolerance", sequence_data.tolerance);
+            doc.get("Solve Sequence Information")->add("First solve iterations", sequence_data.niters[0]);
+            if (nSolves > 1) {
+                doc.get("Solve Sequence Information")->add("Average iterations of later solves", double(totalIters - sequence_data.niters[0]) / (nSolves - 1));
+            }
+            doc.get("Solve Sequence Information")->add("Total iterations", totalIters);
+            doc.get("Solve Sequence Information")->add("Maximum scaled residual", maxResidual);
+            doc.get("Solve Sequence Information")->add("Time (sec)", sequence_data.seconds);
+        }
+
         doc.add("########## Performance Summary (times in sec) ##########", "");
 
         doc.add("Benchmark Time Summary", "");
@@ -426,6 +473,52 @@ ReportResults(
         doc.get("DDOT Timing Variations")->add("Max DDOT MPI_Allreduce time", t4max);
         doc.get("DDOT Timing Variations")->add("Avg DDOT MPI_Allreduce time", t4avg);
 
+#ifdef LGNCG_USE_PROFILER
+        // Achieved bandwidth uses each kernel's own byte count, so it is
+        // comparable to the GB/s Summary model above.
+        doc.add("Kernel Profile", "");
+        const auto profile = Profiler::instance().summarize(
+            Processor::get_executing_processor().id
+        );
+        for (const auto &kv : profile) {
+            const ProfileSummary &ps = kv.second;
+            YAML_Element *ke = doc.get("Kernel Profile")->add(
+                ProfileEventName(kv.first), ""
+            );
+            ke->add("Count", ps.count);
+            ke->add("Time (sec)", ps.seconds);
+            ke->add("Achieved GB/s", ps.seconds > 0.0 ?
+                                     ps.bytes / ps.seconds / 1.0E9 : 0.0);
+            // Against this shard's share of the STREAM bandwidth.
+            const double shardStream = streamBandwidth / Ageom->size;
+            ke->add("Percent of STREAM",
+                    ps.seconds > 0.0 && shardStream > 0.0 ?
+                    100.0 * ps.bytes / ps.seconds / shardStream : 0.0);
+        }
+#endif
+
+        // The CG phase times do not split MG into levels and SYMGS, so only
+        // the kernels the Benchmark Time Summary has are on the roofline.
+        std::vector<RooflineLevel> rooflineLevels;
+        Af = &A;
+        for (int i = 0; i < numberOfMgLevels; ++i) {
+            RooflineLevel l;
+            l.rows = Af->sclrs->data()->totalNumberOfRows;
+            l.nnz = Af->sclrs->data()->totalNumberOfNonzeros;
+            l.hasCoarse = (i < numberOfMgLevels - 1);
+            l.sweeps = l.hasCoarse ?
+                       Af->mgData->numberOfPresmootherSteps +
+                       Af->mgData->numberOfPostsmootherSteps :
+                       Af->numberOfCoarseSweeps;
+            l.seconds = -1.0;
+            l.symgsSeconds = -1.0;
+            rooflineLevels.push_back(l);
+            Af = Af->Ac;
+        }
+        std::vector<RooflineEntry> roofline;
+        RooflineModel(fniters, fNumberOfCgSets, times, rooflineLevels, roofline);
+        AddRooflineSection(doc, streamBandwidth, roofline);
+
         //doc.get("Sparse Operations Overheads")->add("Halo exchange time (sec)", (times[6]));
         //doc.get("Sparse Operations Overheads")->add("Halo exchange as percentage of SpMV time", (times[6])/totalSparseMVTime*100.0);
         doc.add("__________ Final Summary __________", "");
@@ -0,0 +1,175 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file ReproSum.hpp
+
+    Order-independent (reproducible) sums of doubles. Every finite double is
+    an integer multiple of 2^-1074, so ReproSumValue keeps its sum as one wide
+    fixed-point integer. The integer is split into LGNCG_REPRO_BINS signed
+    32-bit digits, each held in an int64_t. Integer addition is associative,
+    so the sum doesn't depend on the order values are added or merged in. The
+    summands of a dot product are the element products, so the result is the
+    same for any thread count, row split or shard count.
+
+    Adding a value touches three digits. Digits are normalized (carries
+    pushed up) before they can overflow and before a value is merged or
+    converted, so each digit takes at least 2^30 adds between
+    normalizations.
+ */
+
+#pragma once
+
+#include "Types.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Number of 32-bit digits: enough for every finite double and a carry digit.
+#define LGNCG_REPRO_BINS 67
+// Adds between normalizations.
+#define LGNCG_REPRO_NORM_PERIOD (int64_t(1) << 30)
+
+/**
+ * Exact sum of doubles.
+ */
+struct ReproSumValue {
+    // Digit i has weight 2^(32 * i - 1074).
+    int64_t bins[LGNCG_REPRO_BINS];
+    // Sum of the non-finite values (inf, nan) added, if any.
+    floatType special;
+    // Adds since the last normalization.
+    int64_t nAdds;
+};
+
+/**
+ * Sets v to zero.
+ */
+inline void
+ReproSumClear(
+    ReproSumValue &v
+) {
+    memset(v.bins, 0, sizeof(v.bins));
+    v.special = 0.0;
+    v.nAdds = 0;
+}
+
+/**
+ * Pushes the carries of all digits up, so that all but the top digit are in
+ * [0, 2^32). The normalized form of a value is unique.
+ */
+inline void
+ReproSumNormalize(
+    ReproSumValue &v
+) {
+    for (int i = 0; i < LGNCG_REPRO_BINS - 1; ++i) {
+        const int64_t carry = v.bins[i] >> 32;
+        v.bins[i] -= carry * (int64_t(1) << 32);
+        v.bins[i + 1] += carry;
+    }
+    v.nAdds = 0;
+}
+
+/**
+ * Adds d to v exactly.
+ */
+inline void
+ReproSumAdd(
+    ReproSumValue &v,
+    double d
+) {
+    uint64_t bits;
+    memcpy(&bits, &d, sizeof(bits));
+    const int biasedExp = int((bits >> 52) & 0x7ff);
+    if (biasedExp == 0x7ff) {
+        v.special += d;
+        return;
+    }
+    uint64_t mant = bits & ((uint64_t(1) << 52) - 1);
+    if (biasedExp != 0) mant |= (uint64_t(1) << 52);
+    if (mant == 0) return;
+    // d = +-mant * 2^(shift - 1074).
+    const int shift = (biasedExp == 0 ? 1 : biasedExp) - 1;
+    const int bin = shift / 32;
+    const unsigned __int128 m = (unsigned __int128)mant << (shift % 32);
+    const int64_t d0 = int64_t(uint64_t(m) & 0xffffffff);
+    const int64_t d1 = int64_t(uint64_t(m >> 32) & 0xffffffff);
+    const int64_t d2 = int64_t(uint64_t(m >> 64));
+    if (bits >> 63) {
+        v.bins[bin]     -= d0;
+        v.bins[bin + 1] -= d1;
+        v.bins[bin + 2] -= d2;
+    }
+    else {
+        v.bins[bin]     += d0;
+        v.bins[bin + 1] += d1;
+        v.bins[bin + 2] += d2;
+    }
+    if (++v.nAdds == LGNCG_REPRO_NORM_PERIOD) ReproSumNormalize(v);
+}
+
+/**
+ * Adds b to a exactly. Both are normalized first.
+ */
+inline void
+ReproSumMerge(
+    ReproSumValue &a,
+    ReproSumValue b
+) {
+    ReproSumNormalize(a);
+    ReproSumNormalize(b);
+    for (int i = 0; i < LGNCG_REPRO_BINS; ++i) a.bins[i] += b.bins[i];
+    a.special += b.special;
+    ReproSumNormalize(a);
+}
+
+/**
+ * Returns v rounded to a double. Digits are added from the top, in a fixed
+ * order and from a unique representation, so equal sums give equal results.
+ */
+inline floatType
+ReproSumToDouble(
+    ReproSumValue v
+) {
+    if (v.special != 0.0 || std::isnan(v.special)) return v.special;
+    ReproSumNormalize(v);
+    // Negative sums have a negative top digit. Convert the magnitude.
+    const bool negative = (v.bins[LGNCG_REPRO_BINS - 1] < 0);
+    if (negative) {
+        for (int i = 0; i < LGNCG_REPRO_BINS; ++i) v.bins[i] = -v.bins[i];
+        ReproSumNormalize(v);
+    }
+    double res = 0.0;
+    for (int i = LGNCG_REPRO_BINS - 1; i >= 0; --i) {
+        if (v.bins[i] == 0) continue;
+        res += std::ldexp(double(v.bins[i]), 32 * i - 1074);
+    }
+    return negative ? -res : res;
+}
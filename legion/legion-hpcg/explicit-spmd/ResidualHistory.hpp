@@ -0,0 +1,107 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file ResidualHistory.hpp
+
+    Residual norms of the CG iterations that the shard has not waited for.
+    Between convergence checks (--cg-check-freq=N), CG pushes the future of
+    every iteration's residual norm here and polls the oldest ones without
+    blocking. The history is then complete, and every print_freq-th residual
+    is printed, while only one iteration in N waits on its result.
+ */
+
+#pragma once
+
+#include "LegionStuff.hpp"
+
+#include <deque>
+#include <utility>
+#include <vector>
+
+/**
+ *
+ */
+class ResidualHistory {
+    // (iteration, residual norm future) pairs in iteration order.
+    std::deque< std::pair<int, Future> > mPending;
+    // Residual norm of every iteration drained so far, indexed by iteration.
+    std::vector<floatType> mNorms;
+
+public:
+    /**
+     * Starts a history with the initial residual norm (iteration 0).
+     */
+    explicit ResidualHistory(
+        floatType normr0
+    ) : mNorms(1, normr0) { }
+
+    /**
+     *
+     */
+    void
+    push(
+        int iteration,
+        const Future &normr
+    ) {
+        mPending.push_back(std::make_pair(iteration, normr));
+    }
+
+    /**
+     * Moves resolved norms into the history in iteration order and calls
+     * onNorm(iteration, norm) for each. Without wait, stops at the first
+     * future that is not ready yet, so it never blocks.
+     */
+    template <typename FN>
+    void
+    drain(
+        bool wait,
+        FN onNorm
+    ) {
+        while (!mPending.empty()) {
+            const Future &f = mPending.front().second;
+            if (!wait && !f.is_ready()) return;
+            //
+            const int iteration = mPending.front().first;
+            const floatType norm = f.get_result<floatType>(silenceWarnings);
+            if (int(mNorms.size()) <= iteration) {
+                mNorms.resize(iteration + 1, 0.0);
+            }
+            mNorms[iteration] = norm;
+            mPending.pop_front();
+            onNorm(iteration, norm);
+        }
+    }
+
+    /**
+     * Residual norms drained so far, indexed by iteration.
+     */
+    const std::vector<floatType> &
+    norms(void) const { return mNorms; }
+};
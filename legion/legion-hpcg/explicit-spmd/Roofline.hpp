@@ -0,0 +1,258 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file Roofline.hpp
+
+    Per-kernel roofline counters shared by legion-xhpcg and the ref-impl
+    xhpcg. A STREAM triad probe run at startup measures the bandwidth the
+    machine can sustain. After the timed CG sets, the flops and bytes each
+    kernel moved (from the same model as the GB/s Summary) are divided by its
+    time and set against that bandwidth, which shows right away which kernel
+    is off the roofline.
+
+    This header must not depend on either runtime.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Default STREAM triad length per process, in doubles (three 32 MiB arrays),
+// large enough to spill the last level caches of current CPUs.
+#define ROOFLINE_STREAM_LENGTH (1 << 22)
+
+/**
+ * Runs the STREAM triad a = b + s * c over n doubles ntimes and returns the
+ * best bandwidth of this process in bytes per second. Uses all OpenMP
+ * threads when built with OpenMP.
+ */
+inline double
+StreamTriadBandwidth(
+    size_t n,
+    int ntimes = 10
+) {
+    if (n == 0) return 0.0;
+    //
+    double *a = new double[n];
+    double *b = new double[n];
+    double *c = new double[n];
+    // First touch by the threads that run the triad.
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static)
+#endif
+    for (long i = 0; i < long(n); ++i) {
+        a[i] = 0.0;
+        b[i] = 1.0;
+        c[i] = 2.0;
+    }
+    //
+    const double s = 3.0;
+    double best = 0.0;
+    for (int t = 0; t < ntimes; ++t) {
+        const auto t0 = std::chrono::steady_clock::now();
+#ifdef _OPENMP
+        #pragma omp parallel for schedule(static)
+#endif
+        for (long i = 0; i < long(n); ++i) {
+            a[i] = b[i] + s * c[i];
+        }
+        const std::chrono::duration<double> dt =
+            std::chrono::steady_clock::now() - t0;
+        // Two loads and one store of 8 bytes, as STREAM counts them.
+        const double bw = 3.0 * 8.0 * double(n) / dt.count();
+        if (bw > best) best = bw;
+    }
+    // Keep the triad from being optimized away.
+    volatile double sink = a[n / 2];
+    (void)sink;
+    //
+    delete[] a;
+    delete[] b;
+    delete[] c;
+    return best;
+}
+
+/**
+ * One multigrid level, fine level first, as the roofline model sees it.
+ */
+struct RooflineLevel {
+    //!< Global rows and nonzeros of the level's matrix.
+    double rows;
+    double nnz;
+    //!< SYMGS calls per V cycle at this level (pre + post, or coarse sweeps).
+    double sweeps;
+    //!< True for all levels but the coarsest (residual SpMV, restriction).
+    bool hasCoarse;
+    //!< Time spent in this level alone and in its SYMGS calls, or < 0 if the
+    //!< implementation does not time the levels.
+    double seconds;
+    double symgsSeconds;
+};
+
+/**
+ * Flops and bytes a kernel moved over the timed CG sets, and its time.
+ */
+struct RooflineEntry {
+    std::string name;
+    double flops;
+    double bytes;
+    double seconds;
+};
+
+/**
+ * Builds the roofline entries of fniters optimized CG iterations spread over
+ * fNumberOfCgSets sets, timed in times (the CG times[] layout). Counts follow
+ * ReportResults: 8-byte values and vector entries, 4-byte column indices,
+ * one extra DDOT, WAXPBY and SpMV per set for the CG preamble. SYMGS and the
+ * per-level MG entries are only added if the levels carry their times.
+ */
+inline void
+RooflineModel(
+    double fniters,
+    double fNumberOfCgSets,
+    const double times[],
+    const std::vector<RooflineLevel> &levels,
+    std::vector<RooflineEntry> &entries
+) {
+    const double fnrow = levels[0].rows;
+    const double fnnz = levels[0].nnz;
+    const double nvec = 3.0 * fniters + fNumberOfCgSets;
+    const double nspmv = fniters + fNumberOfCgSets;
+    //
+    entries.clear();
+    entries.push_back({"SpMV", nspmv * 2.0 * fnnz,
+                       nspmv * (fnnz * 12.0 + fnrow * 2.0 * 8.0), times[3]});
+    //
+    bool timedLevels = true;
+    for (const RooflineLevel &l : levels) {
+        if (l.seconds < 0.0 || l.symgsSeconds < 0.0) timedLevels = false;
+    }
+    RooflineEntry symgs = {"SYMGS", 0.0, 0.0, 0.0};
+    RooflineEntry mg = {"MG", 0.0, 0.0, times[5]};
+    std::vector<RooflineEntry> mgLevels;
+    for (size_t i = 0; i < levels.size(); ++i) {
+        const RooflineLevel &l = levels[i];
+        // A forward and a back sweep read the matrix, x, r and the diagonal
+        // twice.
+        const double sweepFlops = l.sweeps * 4.0 * l.nnz;
+        const double sweepBytes = l.sweeps * 2.0 * (l.nnz * 12.0
+                                + l.rows * 3.0 * 8.0);
+        double flops = sweepFlops, bytes = sweepBytes;
+        if (l.hasCoarse) {
+            // Residual SpMV, restriction and prolongation.
+            flops += 2.0 * l.nnz;
+            bytes += l.nnz * 12.0 + l.rows * 2.0 * 8.0
+                   + 2.0 * levels[i + 1].rows * 3.0 * 8.0;
+        }
+        symgs.flops += fniters * sweepFlops;
+        symgs.bytes += fniters * sweepBytes;
+        symgs.seconds += l.symgsSeconds;
+        mg.flops += fniters * flops;
+        mg.bytes += fniters * bytes;
+        mgLevels.push_back({"MG Level " + std::to_string(i), fniters * flops,
+                            fniters * bytes, l.seconds});
+    }
+    if (timedLevels) entries.push_back(symgs);
+    entries.push_back(mg);
+    if (timedLevels) {
+        entries.insert(entries.end(), mgLevels.begin(), mgLevels.end());
+    }
+    entries.push_back({"DDOT", nvec * 2.0 * fnrow, nvec * 2.0 * fnrow * 8.0,
+                       times[1]});
+    entries.push_back({"WAXPBY", nvec * 2.0 * fnrow, nvec * 3.0 * fnrow * 8.0,
+                       times[2]});
+}
+
+/**
+ * Adds a Roofline section to doc (the YAML_Doc of either implementation),
+ * with streamBandwidth the summed STREAM triad bandwidth in bytes/s.
+ */
+template <typename Doc>
+inline void
+AddRooflineSection(
+    Doc &doc,
+    double streamBandwidth,
+    const std::vector<RooflineEntry> &entries
+) {
+    doc.add("Roofline", "");
+    auto *sec = doc.get("Roofline");
+    sec->add("STREAM Triad (GB/s)", streamBandwidth / 1.0E9);
+    for (const RooflineEntry &e : entries) {
+        auto *ke = sec->add(e.name, "");
+        const double gbs = e.seconds > 0.0 ? e.bytes / e.seconds / 1.0E9 : 0.0;
+        ke->add("Flops", e.flops);
+        ke->add("Bytes", e.bytes);
+        ke->add("Time (sec)", e.seconds);
+        ke->add("GFLOP/s", e.seconds > 0.0 ?
+                           e.flops / e.seconds / 1.0E9 : 0.0);
+        ke->add("GB/s", gbs);
+        ke->add("Percent of STREAM", streamBandwidth > 0.0 ?
+                                     100.0 * gbs * 1.0E9 / streamBandwidth :
+                                     0.0);
+    }
+}
+
+/**
+ * Prints the entries as a table, one kernel per line.
+ */
+inline void
+PrintRoofline(
+    std::ostream &out,
+    double streamBandwidth,
+    const std::vector<RooflineEntry> &entries
+) {
+    const std::ios::fmtflags flags = out.flags();
+    const std::streamsize prec = out.precision();
+    out << "--> Roofline (STREAM triad " << std::fixed << std::setprecision(2)
+        << streamBandwidth / 1.0E9 << " GB/s):" << std::endl;
+    out << "    " << std::left << std::setw(12) << "Kernel" << std::right
+        << std::setw(12) << "Time (s)" << std::setw(12) << "GFLOP/s"
+        << std::setw(12) << "GB/s" << std::setw(12) << "% STREAM"
+        << std::endl;
+    for (const RooflineEntry &e : entries) {
+        const double t = e.seconds;
+        const double gbs = t > 0.0 ? e.bytes / t / 1.0E9 : 0.0;
+        out << "    " << std::left << std::setw(12) << e.name << std::right
+            << std::setprecision(4) << std::setw(12) << t
+            << std::setprecision(2)
+            << std::setw(12) << (t > 0.0 ? e.flops / t / 1.0E9 : 0.0)
+            << std::setw(12) << gbs
+            << std::setw(12) << (streamBandwidth > 0.0 ?
+                                 100.0 * gbs * 1.0E9 / streamBandwidth : 0.0)
+            << std::endl;
+    }
+    out.flags(flags);
+    out.precision(prec);
+}
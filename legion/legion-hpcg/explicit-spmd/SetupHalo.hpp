@@ -49,37 +49,47 @@
 #include "LegionArrays.hpp"
 #include "LegionMatrices.hpp"
 
-#include <map>
-#include <set>
+#include <algorithm>
+#include <utility>
 #include <vector>
 #include <cassert>
 
+/**
+ * A (neighbor rank, global index) pair.
+ */
+using HaloEntry = std::pair<int, global_int_t>;
+
+/**
+ * Collects the values that this shard receives from (receiveList) and sends
+ * to (sendList) its neighbors. On return, both lists are sorted by neighbor
+ * rank, then by global index, and contain no duplicates.
+ */
 inline void
-GetNeighborInfo(
-    SparseMatrix &A
+GetHaloLists(
+    SparseMatrix &A,
+    std::vector<HaloEntry> &receiveList,
+    std::vector<HaloEntry> &sendList
 ) {
     using namespace std;
-    // Extract Matrix pieces
-    SparseMatrixScalars *const Asclrs = A.sclrs->data();
+    //
+    const SparseMatrixScalars *const Asclrs = A.sclrs->data();
     const Geometry *const Ageom = A.geom->data();
     //
     const local_int_t numberOfNonzerosPerRow = Ageom->stencilSize;
     //
     const local_int_t localNumberOfRows = Asclrs->localNumberOfRows;
     //
-    char *nonzerosInRow = A.nonzerosInRow->data();
+    const char *const nonzerosInRow = A.nonzerosInRow->data();
     // Interpreted as 2D array
     Array2D<global_int_t> mtxIndG(
         localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndG->data()
     );
     //
-    global_int_t *AlocalToGlobalMap = A.localToGlobalMap->data();
-
-    std::map< int, std::set< global_int_t> > sendList, receiveList;
-    typedef std::map< int, std::set< global_int_t> >::iterator map_iter;
-    typedef std::set<global_int_t>::iterator set_iter;
-    std::map< local_int_t, local_int_t > externalToLocalMap;
-
+    const global_int_t *const AlocalToGlobalMap = A.localToGlobalMap->data();
+    //
+    receiveList.clear();
+    sendList.clear();
+    //
     for (local_int_t i = 0; i < localNumberOfRows; i++) {
         global_int_t currentGlobalRow = AlocalToGlobalMap[i];
         for (int j = 0; j < nonzerosInRow[i]; j++) {
@@ -88,63 +98,83 @@ GetNeighborInfo(
             // If column index is not a row index, then it comes from another
             // processor
             if (Ageom->rank != rankIdOfColumnEntry) {
-                receiveList[rankIdOfColumnEntry].insert(curIndex);
+                receiveList.push_back(HaloEntry(rankIdOfColumnEntry, curIndex));
                 // Matrix symmetry means we know the neighbor process wants my
                 // value
-                sendList[rankIdOfColumnEntry].insert(currentGlobalRow);
+                sendList.push_back(
+                    HaloEntry(rankIdOfColumnEntry, currentGlobalRow)
+                );
             }
         }
     }
-    // Count number of matrix entries to send and receive.
-    local_int_t totalToBeSent = 0;
-    for (map_iter curNeighbor = sendList.begin();
-         curNeighbor != sendList.end(); ++curNeighbor) {
-        totalToBeSent += (curNeighbor->second).size();
+    //
+    for (auto *l : {&receiveList, &sendList}) {
+        sort(l->begin(), l->end());
+        l->erase(unique(l->begin(), l->end()), l->end());
     }
-    // Build the arrays and lists needed by the ExchangeHalo function.
-    local_int_t *elementsToSend = new local_int_t[totalToBeSent];
-    int *neighbors = new int[sendList.size()];
-    local_int_t *receiveLength = new local_int_t[receiveList.size()];
-    local_int_t *sendLength = new local_int_t[sendList.size()];
-    int neighborCount = 0;
-    local_int_t receiveEntryCount = 0;
-    for (map_iter curNeighbor = receiveList.begin();
-         curNeighbor != receiveList.end();
-         ++curNeighbor, ++neighborCount) {
-        // rank of current neighbor we are processing
-        int neighborId = curNeighbor->first;
-        // store rank ID of current neighbor
-        neighbors[neighborCount] = neighborId;
-        receiveLength[neighborCount] = receiveList[neighborId].size();
-        // Get count of sends/receives
-        sendLength[neighborCount] = sendList[neighborId].size();
-        for (set_iter i = receiveList[neighborId].begin();
-             i != receiveList[neighborId].end();
-             ++i, ++receiveEntryCount) {
-            // The remote columns are indexed at end of internals
-            externalToLocalMap[*i] = localNumberOfRows + receiveEntryCount;
+}
+
+/**
+ * Returns the number of distinct neighbors in a sorted list from GetHaloLists.
+ */
+inline int
+GetNumberOfHaloNeighbors(
+    const std::vector<HaloEntry> &list
+) {
+    int n = 0;
+    for (size_t i = 0; i < list.size(); ++i) {
+        if (i == 0 || list[i].first != list[i - 1].first) ++n;
+    }
+    return n;
+}
+
+inline void
+GetNeighborInfo(
+    SparseMatrix &A
+) {
+    using namespace std;
+    // Extract Matrix pieces
+    SparseMatrixScalars *const Asclrs = A.sclrs->data();
+    //
+    std::vector<HaloEntry> receiveList, sendList;
+    GetHaloLists(A, receiveList, sendList);
+    //
+    const int numberOfRecvNeighbors = GetNumberOfHaloNeighbors(receiveList);
+    const int numberOfSendNeighbors = GetNumberOfHaloNeighbors(sendList);
+    // Matrix symmetry means we send to the neighbors we receive from.
+    assert(numberOfRecvNeighbors == numberOfSendNeighbors);
+    //
+    int *neighbors = A.neighbors->data();
+    local_int_t *sendLength = A.sendLength->data();
+    local_int_t *recvLength = A.recvLength->data();
+    //
+    int neighborCount = -1;
+    for (size_t i = 0; i < receiveList.size(); ++i) {
+        if (i == 0 || receiveList[i].first != receiveList[i - 1].first) {
+            ++neighborCount;
+            neighbors[neighborCount] = receiveList[i].first;
+            recvLength[neighborCount] = 0;
         }
+        ++recvLength[neighborCount];
+    }
+    neighborCount = -1;
+    for (size_t i = 0; i < sendList.size(); ++i) {
+        if (i == 0 || sendList[i].first != sendList[i - 1].first) {
+            ++neighborCount;
+            assert(neighbors[neighborCount] == sendList[i].first);
+            sendLength[neighborCount] = 0;
+        }
+        ++sendLength[neighborCount];
     }
     // Store contents in our matrix struct.
-    Asclrs->numberOfRecvNeighbors = receiveList.size();
-    Asclrs->numberOfExternalValues = externalToLocalMap.size();
+    Asclrs->numberOfRecvNeighbors = numberOfRecvNeighbors;
+    Asclrs->numberOfExternalValues = receiveList.size();
     //
     Asclrs->localNumberOfColumns = Asclrs->localNumberOfRows
                                    + Asclrs->numberOfExternalValues;
     //
-    Asclrs->numberOfSendNeighbors = sendList.size();
-    Asclrs->totalToBeSent = totalToBeSent;
-    //
-    for (int i = 0; i < Asclrs->numberOfSendNeighbors; ++i) {
-        A.neighbors->data()[i]  = neighbors[i];
-        A.sendLength->data()[i] = sendLength[i];
-        A.recvLength->data()[i] = receiveLength[i];
-    }
-    //
-    delete[] elementsToSend;
-    delete[] neighbors;
-    delete[] receiveLength;
-    delete[] sendLength;
+    Asclrs->numberOfSendNeighbors = numberOfSendNeighbors;
+    Asclrs->totalToBeSent = sendList.size();
 }
 
 /*!
@@ -182,40 +212,14 @@ SetupHalo(
     Array2D<local_int_t> mtxIndL(
         localNumberOfRows, numberOfNonzerosPerRow, A.mtxIndL->data()
     );
-    //
-    global_int_t *AlocalToGlobalMap = A.localToGlobalMap->data();
 
-    std::map< int, std::set< global_int_t> > sendList, receiveList;
-    typedef std::map< int, std::set< global_int_t> >::iterator map_iter;
-    typedef std::set<global_int_t>::iterator set_iter;
-    std::map< local_int_t, local_int_t > externalToLocalMap;
-
-    for (local_int_t i = 0; i < localNumberOfRows; i++) {
-        global_int_t currentGlobalRow = AlocalToGlobalMap[i];
-        for (int j = 0; j < nonzerosInRow[i]; j++) {
-            global_int_t curIndex = mtxIndG(i, j);
-            int rankIdOfColumnEntry = ComputeRankOfMatrixRow(*(Ageom), curIndex);
-            // If column index is not a row index, then it comes from another
-            // processor
-            if (Ageom->rank != rankIdOfColumnEntry) {
-                receiveList[rankIdOfColumnEntry].insert(curIndex);
-                // Matrix symmetry means we know the neighbor process wants my
-                // value
-                sendList[rankIdOfColumnEntry].insert(currentGlobalRow);
-            }
-        }
-    }
+    std::vector<HaloEntry> receiveList, sendList;
+    GetHaloLists(A, receiveList, sendList);
+    // Maps global indices of remote columns to their local (ghost) index.
+    FlatIndexMap< global_int_t, local_int_t > externalToLocalMap;
+    externalToLocalMap.reserve(receiveList.size());
     // Count number of matrix entries to send and receive.
-    local_int_t totalToBeSent = 0;
-    for (map_iter curNeighbor = sendList.begin();
-         curNeighbor != sendList.end(); ++curNeighbor) {
-        totalToBeSent += (curNeighbor->second).size();
-    }
-    local_int_t totalToBeReceived = 0;
-    for (map_iter curNeighbor = receiveList.begin();
-         curNeighbor != receiveList.end(); ++curNeighbor) {
-        totalToBeReceived += (curNeighbor->second).size();
-    }
+    const local_int_t totalToBeSent = sendList.size();
     // Build the arrays and lists needed by the ExchangeHalo function.
     A.lElementsToSend.allocate(
         "elementsToSend", totalToBeSent, ctx, lrt
@@ -225,37 +229,23 @@ SetupHalo(
     );
     local_int_t *elementsToSend = AelementsToSend->data();
     assert(elementsToSend);
-    //
-    int *neighbors = new int[sendList.size()];
-    local_int_t *receiveLength = new local_int_t[receiveList.size()];
-    local_int_t *sendLength = new local_int_t[sendList.size()];
-    int neighborCount = 0;
-    local_int_t receiveEntryCount = 0;
-    local_int_t sendEntryCount = 0;
-    for (map_iter curNeighbor = receiveList.begin();
-         curNeighbor != receiveList.end();
-         ++curNeighbor, ++neighborCount) {
-        // rank of current neighbor we are processing
-        int neighborId = curNeighbor->first;
-        // store rank ID of current neighbor
-        neighbors[neighborCount] = neighborId;
-        receiveLength[neighborCount] = receiveList[neighborId].size();
-        // Get count of sends/receives
-        sendLength[neighborCount] = sendList[neighborId].size();
-        for (set_iter i = receiveList[neighborId].begin();
-             i != receiveList[neighborId].end();
-             ++i, ++receiveEntryCount) {
-            // The remote columns are indexed at end of internals
-            externalToLocalMap[*i] = localNumberOfRows + receiveEntryCount;
-        }
-        for (set_iter i = sendList[neighborId].begin();
-             i != sendList[neighborId].end();
-             ++i, ++sendEntryCount) {
-            // Store local ids of entry to send.
-            elementsToSend[sendEntryCount] = A.globalToLocalMap[*i];
-        }
+    // Both lists are ordered by neighbor rank, so the remote columns are
+    // indexed at end of internals in the same order as before.
+    for (size_t i = 0; i < receiveList.size(); ++i) {
+        externalToLocalMap.insert(
+            receiveList[i].second, localNumberOfRows + local_int_t(i)
+        );
     }
+    externalToLocalMap.finalize();
     //
+    for (size_t i = 0; i < sendList.size(); ++i) {
+        // Store local ids of entry to send.
+        elementsToSend[i] = A.globalToLocalMap[sendList[i].second];
+    }
+    // Both maps are read-only from here on, so rows are independent.
+#ifdef _OPENMP
+    #pragma omp parallel for
+#endif
     for (local_int_t i = 0; i < localNumberOfRows; i++) {
         for (int j = 0; j < nonzerosInRow[i]; j++) {
             global_int_t curIndex = mtxIndG(i, j);
@@ -270,8 +260,39 @@ SetupHalo(
             }
         }
     }
+    // Order rows so that interior rows (those that only reference local
+    // columns) come first, followed by boundary rows. SpMV computes interior
+    // rows while ghost values are still in flight.
+    A.lHaloRowOrder.allocate(
+        "haloRowOrder", localNumberOfRows, ctx, lrt
+    );
+    auto *AhaloRowOrder = new Array<local_int_t>(
+        A.lHaloRowOrder.mapRegion(RW_E, ctx, lrt), ctx, lrt
+    );
+    local_int_t *haloRowOrder = AhaloRowOrder->data();
+    assert(haloRowOrder);
+    //
+    std::vector<bool> isBoundaryRow(localNumberOfRows, false);
+    for (local_int_t i = 0; i < localNumberOfRows; i++) {
+        for (int j = 0; j < nonzerosInRow[i]; j++) {
+            if (mtxIndL(i, j) >= localNumberOfRows) {
+                isBoundaryRow[i] = true;
+                break;
+            }
+        }
+    }
+    local_int_t rowOrderCount = 0;
+    for (local_int_t i = 0; i < localNumberOfRows; i++) {
+        if (!isBoundaryRow[i]) haloRowOrder[rowOrderCount++] = i;
+    }
+    A.numberOfInteriorRows = rowOrderCount;
+    for (local_int_t i = 0; i < localNumberOfRows; i++) {
+        if (isBoundaryRow[i]) haloRowOrder[rowOrderCount++] = i;
+    }
+    assert(rowOrderCount == localNumberOfRows);
     // Store contents in our matrix struct.
     A.elementsToSend = AelementsToSend;
+    A.haloRowOrder = AhaloRowOrder;
 #if 0 // Debug
     {
         const int me = Ageom->rank;
@@ -295,10 +316,7 @@ SetupHalo(
     }
 #endif
 
-    delete[] neighbors;
-    delete[] receiveLength;
-    delete[] sendLength;
-    // delete[] elementsToSend; Don't delete. Stored in sparse matrix.
+    // elementsToSend is not deleted here. It is stored in the sparse matrix.
 }
 
 /**
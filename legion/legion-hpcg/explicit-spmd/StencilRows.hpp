@@ -0,0 +1,110 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file StencilRows.hpp
+
+    Row kernels specialized on the stencil width. Interior rows of the HPCG
+    operator have exactly HPCG_STENCIL nonzeros. For those rows the inner loop
+    has a compile-time trip count, so the compiler can fully unroll and
+    vectorize it. Rows with fewer nonzeros (global boundary) take the generic
+    loop. The kernels that use these helpers take a STENCIL template
+    parameter: HPCG_STENCIL when the matrix was generated with that stencil
+    size, or 0 for no fast path.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "Types.hpp"
+
+/**
+ * Returns the sum of vals[j] * xv[inds[j]] over the first nnz entries of a
+ * row.
+ */
+template <int STENCIL, typename MT>
+inline floatType
+StencilRowDot(
+    const MT *__restrict__ vals,
+    const local_int_t *__restrict__ inds,
+    int nnz,
+    const floatType *__restrict__ xv
+) {
+    floatType sum = 0.0;
+    if (STENCIL > 0 && nnz == STENCIL) {
+#ifdef _OPENMP
+        #pragma omp simd reduction(+:sum)
+#endif
+        for (int j = 0; j < STENCIL; j++) {
+            sum += vals[j] * xv[inds[j]];
+        }
+        return sum;
+    }
+    for (int j = 0; j < nnz; j++) {
+        sum += vals[j] * xv[inds[j]];
+    }
+    return sum;
+}
+
+/**
+ * Gauss-Seidel update of row i of x: the row's dot product excluding the
+ * diagonal, subtracted from the right-hand side and scaled by the diagonal.
+ */
+template <int STENCIL, typename MT>
+inline void
+StencilRowRelax(
+    const MT *vals,
+    const local_int_t *inds,
+    int nnz,
+    floatType diagonal,
+    floatType rhs,
+    floatType *xv,
+    local_int_t i
+) {
+    floatType sum = rhs - StencilRowDot<STENCIL>(vals, inds, nnz, xv);
+    // Remove diagonal contribution from the dot product.
+    sum += xv[i] * diagonal;
+    xv[i] = sum / diagonal;
+}
+
+/**
+ * Returns whether a row has ghost columns (column indices past the nrow local
+ * rows), that is, whether it needs the halo of x.
+ */
+inline bool
+StencilRowHasGhosts(
+    const local_int_t *inds,
+    int nnz,
+    local_int_t nrow
+) {
+    for (int j = 0; j < nnz; j++) {
+        if (inds[j] >= nrow) return true;
+    }
+    return false;
+}
@@ -0,0 +1,196 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file SubBlocks.hpp
+
+    Row sub-blocks for in-shard index launches (--sub-blocks=N). The rows a
+    shard owns are split into contiguous blocks. Rows are numbered z-major, so
+    each block is a slab of z-planes (whole planes when N divides nz). SPMV,
+    WAXPBY and DDOT then run one point task per block, and CGMapper places
+    those points on the CPUs that follow the shard's own. A single shard can
+    therefore use a whole socket.
+ */
+
+#pragma once
+
+#include "LegionItems.hpp"
+
+#include <algorithm>
+
+// Index partition color of the sub-block partitions. Color 0 is the
+// private/ghost partition of vectors with ghosts (see Partition).
+#define LGNCG_SUB_BLOCKS_PART_COLOR 1
+
+/**
+ * Requested number of sub-blocks per shard. Same value for all shards, so a
+ * process-wide setting is enough.
+ */
+inline int &
+SubBlocksPerShard(void)
+{
+    static int nSubBlocks = 1;
+    return nSubBlocks;
+}
+
+/**
+ * Number of sub-blocks used for nRows rows: never more than one per row.
+ */
+inline int
+NumberOfSubBlocks(
+    local_int_t nRows
+) {
+    return std::max(
+               1, int(std::min(local_int_t(SubBlocksPerShard()), nRows))
+           );
+}
+
+/**
+ * Returns the first row of sub-block b of nBlocks (b == nBlocks returns nRows).
+ */
+inline local_int_t
+SubBlockBegin(
+    local_int_t nRows,
+    int nBlocks,
+    int b
+) {
+    return local_int_t((int64_t(nRows) * b) / nBlocks);
+}
+
+/**
+ * Returns the sub-block partition of item, creating it on first use. Row r
+ * covers elements [r * elemsPerRow, (r + 1) * elemsPerRow) of item, so both
+ * vectors (1) and matrix arrays (stencilSize) can be split by the same rows.
+ */
+template <typename TYPE>
+inline LogicalPartition
+GetSubBlockPartition(
+    Item<TYPE> &item,
+    local_int_t nRows,
+    int nBlocks,
+    int64_t elemsPerRow,
+    Context ctx,
+    Runtime *lrt
+) {
+    const IndexSpace is = item.logicalRegion.get_index_space();
+    //
+    if (!lrt->has_index_partition(ctx, is, LGNCG_SUB_BLOCKS_PART_COLOR)) {
+        // Items of a shard are sub-regions, so they don't necessarily start at
+        // zero.
+        const Rect<1> bounds = lrt->get_index_space_domain(
+                                   ctx, is
+                               ).get_rect<1>();
+        const int64_t base = bounds.lo.x[0];
+        //
+        Rect<1> colorBounds(Point<1>(0), Point<1>(nBlocks - 1));
+        Domain colorDomain = Domain::from_rect<1>(colorBounds);
+        //
+        DomainColoring disjointColoring;
+        for (int b = 0; b < nBlocks; ++b) {
+            const int64_t x0 = base
+                             + SubBlockBegin(nRows, nBlocks, b) * elemsPerRow;
+            const int64_t x1 = base
+                             + SubBlockBegin(nRows, nBlocks, b + 1) * elemsPerRow;
+            Rect<1> subRect((Point<1>(x0)), (Point<1>(x1 - 1)));
+            disjointColoring[b] = Domain::from_rect<1>(subRect);
+        }
+        lrt->create_index_partition(
+            ctx,
+            is,
+            colorDomain,
+            disjointColoring,
+            true /* disjoint */,
+            LGNCG_SUB_BLOCKS_PART_COLOR
+        );
+    }
+    //
+    const IndexPartition ip = lrt->get_index_partition(
+                                  ctx, is, LGNCG_SUB_BLOCKS_PART_COLOR
+                              );
+    return lrt->get_logical_partition(ctx, item.logicalRegion, ip);
+}
+
+/**
+ * Adds item's sub-block b to point task b of il.
+ */
+template <typename TYPE>
+inline void
+SubBlockIntent(
+    Item<TYPE> &item,
+    PrivilegeMode privMode,
+    local_int_t nRows,
+    int nBlocks,
+    int64_t elemsPerRow,
+    IndexLauncher &il,
+    Context ctx,
+    Runtime *lrt
+) {
+    const LogicalPartition lp = GetSubBlockPartition(
+                                    item, nRows, nBlocks, elemsPerRow, ctx, lrt
+                                );
+    il.add_region_requirement(
+        RegionRequirement(
+            lp,
+            0 /* identity projection */,
+            privMode,
+            EXCLUSIVE,
+            item.logicalRegion
+        )
+    ).add_field(item.fid);
+}
+
+/**
+ * Adds all of item to every point task of il (read-only).
+ */
+template <typename TYPE>
+inline void
+SubBlockWholeIntent(
+    Item<TYPE> &item,
+    IndexLauncher &il
+) {
+    il.add_region_requirement(
+        RegionRequirement(
+            item.logicalRegion,
+            0 /* identity projection */,
+            READ_ONLY,
+            EXCLUSIVE,
+            item.logicalRegion
+        )
+    ).add_field(item.fid);
+}
+
+/**
+ * Launch domain of an index launch over nBlocks sub-blocks.
+ */
+inline Domain
+SubBlockLaunchDomain(
+    int nBlocks
+) {
+    return Domain::from_rect<1>(Rect<1>(Point<1>(0), Point<1>(nBlocks - 1)));
+}
@@ -56,5 +56,35 @@ enum {
     RESTRICTION_TID,
     FUTURE_MATH_TID,
     COMPUTE_RESIDUAL_TID,
-    EXCHANGE_HALO_TID
+    EXCHANGE_HALO_TID,
+    SPMV_SELL_TID,
+    SYMGS_MC_TID,
+    SPMV_ROWS_TID,
+    DYN_COLL_TASK_CONTRIB_FUSED_TID,
+    FUSED_REDUCE_SUM_TID,
+    DDOT_FUSED_TID,
+    SPMV_DOT_TID,
+    WAXPBY_DOT_TID,
+    SPMV_BLOCK_TID,
+    WAXPBY_BLOCK_TID,
+    DDOT_BLOCK_TID,
+    DYN_COLL_TASK_CONTRIB_REPRO_TID,
+    REPRO_REDUCE_SUM_TID,
+    REPRO_SUM_TO_FLOAT_TID,
+    DDOT_REPRO_TID,
+    SYMGS_RESIDUAL_TID,
+    SPMV_MULTI_TID,
+    SYMGS_MULTI_TID,
+    DDOT_MULTI_TID,
+    CHEBYSHEV_TID,
+    RESTRICTION_RESIDUAL_TID,
+    EXCHANGE_HALO_WIDEN_TID,
+    INJECTION_TID
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Trace IDs
+////////////////////////////////////////////////////////////////////////////////
+enum {
+    CG_ITERATION_TRACE_ID = 0
 };
@@ -135,9 +135,15 @@ TestCG(
     // Modify the matrix diagonal to greatly exaggerate diagonal values.  CG
     // should converge in about 10 iterations for this problem, regardless of
     // problem size.
-    const global_int_t *const AlocalToGlobalMap = A.localToGlobalMap->data();
+    // The map is gone after SparseMatrix::releaseSetupIndices, in which case
+    // the row IDs are recomputed from the geometry.
+    const global_int_t *const AlocalToGlobalMap =
+        A.localToGlobalMap ? A.localToGlobalMap->data() : nullptr;
+    const Geometry *const Ageom = A.geom->data();
     for (local_int_t i = 0; i < nrow; ++i) {
-        global_int_t globalRowID = AlocalToGlobalMap[i];
+        global_int_t globalRowID = AlocalToGlobalMap
+                                 ? AlocalToGlobalMap[i]
+                                 : ComputeGlobalRowOfLocalRow(*Ageom, i);
         if (globalRowID < 9) {
             floatType scale = (globalRowID + 2) * 1.0e6;
             ScaleVectorValue(exaggeratedDiagA, i, scale, ctx, lrt);
@@ -110,13 +110,12 @@ TestSymmetry(
     const Geometry *const Ageom = A.geom->data();
     //
     const local_int_t nrow = Asclrs->localNumberOfRows;
-    const local_int_t ncol = Asclrs->localNumberOfColumns;
 
     LogicalArray<floatType> x_ncoll, y_ncoll, z_ncoll;
     //
-    x_ncoll.allocate("x_ncol", ncol, ctx, lrt);
-    y_ncoll.allocate("y_ncol", ncol, ctx, lrt);
-    z_ncoll.allocate("z_ncol", ncol, ctx, lrt);
+    AllocateWithGhosts(A, "x_ncol", x_ncoll, ctx, lrt);
+    AllocateWithGhosts(A, "y_ncol", y_ncoll, ctx, lrt);
+    AllocateWithGhosts(A, "z_ncol", z_ncoll, ctx, lrt);
     //
     Partition(A, x_ncoll, ctx, lrt);
     Partition(A, y_ncoll, ctx, lrt);
@@ -71,6 +71,13 @@ struct PhaseBarriers {
  */
 using floatType = double;
 
+/**
+ * Floating point type of the matrix values used by the MG preconditioner when
+ * run with --mg-precision=mixed. Vectors and accumulations stay
+ * floatType.
+ */
+using mgFloatType = float;
+
 /*!
     This defines the type for integers that have local subdomain dimension.
 
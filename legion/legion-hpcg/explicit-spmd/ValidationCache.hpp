@@ -0,0 +1,110 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file ValidationCache.hpp
+
+    Records of earlier reference CG sets, keyed by the run parameters that
+    decide their result (--validate-once). A run whose configuration already
+    has a record reuses it instead of repeating the set. Records are lines of
+    text appended to one file, so every configuration run on a machine can
+    share it; the last record of a key wins.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+/**
+ * Returns the cache key of params: everything that changes the problem, the
+ * decomposition, or the kernels.
+ */
+inline std::string
+ValidationKey(
+    const HPCG_Params &params
+) {
+    const KernelVariants &kv = params.kernels;
+    std::ostringstream key;
+    key << "shards=" << params.commSize
+        << ",nx=" << params.nx << ",ny=" << params.ny << ",nz=" << params.nz
+        << ",stencil=" << params.stencilSize
+        << ",mg=" << params.mgLevels << ",coarse=" << params.coarseSweeps
+        << ",blocks=" << params.subBlocks
+        << ",pipelined=" << params.pipelinedCG
+        << ",spmv=" << kv.spmv << ",symgs=" << kv.symgs << ",dot=" << kv.dot
+        << ",mixed=" << kv.mixedPrecisionMG << ",halo=" << kv.floatMGHalo
+        << ",smoother=" << kv.smoother << ",cheby=" << kv.chebyshevDegree
+        << ",cycle=" << kv.mgCycle;
+    return key.str();
+}
+
+/**
+ * Looks up key in the cache file at path. Returns whether rec was found.
+ */
+inline bool
+ReadValidationRecord(
+    const char *path,
+    const std::string &key,
+    ValidationRecord &rec
+) {
+    std::ifstream in(path);
+    bool found = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream fields(line);
+        std::string lineKey;
+        ValidationRecord r;
+        if (fields >> lineKey >> r.refNiters >> r.refScaledResidual
+                   >> r.refSeconds && lineKey == key) {
+            rec = r;
+            found = true;
+        }
+    }
+    return found;
+}
+
+/**
+ * Appends rec for key to the cache file at path. Returns zero on success.
+ */
+inline int
+AppendValidationRecord(
+    const char *path,
+    const std::string &key,
+    const ValidationRecord &rec
+) {
+    std::ofstream out(path, std::ios::app);
+    out.precision(17);
+    out << key << " " << rec.refNiters << " " << rec.refScaledResidual
+        << " " << rec.refSeconds << std::endl;
+    return out.good() ? 0 : 1;
+}
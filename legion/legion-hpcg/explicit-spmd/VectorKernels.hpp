@@ -0,0 +1,408 @@
+/**
+ * Copyright (c)      2017 Los Alamos National Security, LLC
+ *                         All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright notice,
+ * this list of conditions and the following disclaimer in the documentation
+ * and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS
+ * IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ * LA-CC 10-123
+ */
+
+/*!
+    @file VectorKernels.hpp
+
+    Loops shared by the WAXPBY, DDOT, restriction and prolongation leaf
+    kernels. They take __restrict__ pointers, are vectorized with omp simd,
+    and split their rows over threads when compiled with -fopenmp.
+
+    CGMapper asks for instances that start on an HPCG_ALIGNMENT byte boundary.
+    Sub-region views (ghosts, sub-blocks) can still start anywhere, so each
+    kernel checks its pointers and only takes the aligned path when all of
+    them are aligned.
+
+    Dot products are summed pairwise over fixed HPCG_DOT_BLOCK blocks. The
+    order depends on n only, not on the number of threads, so a shard's
+    contribution is the same from run to run. The error is also much smaller
+    than with one long running sum.
+ */
+
+#pragma once
+
+#include "hpcg.hpp"
+#include "Types.hpp"
+#include "ReproSum.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Rows per dot product block (also the unit of work given to a thread).
+#define HPCG_DOT_BLOCK 512
+// Loops shorter than this stay on the calling thread.
+#define HPCG_OMP_MIN_LENGTH (8 * HPCG_DOT_BLOCK)
+
+/**
+ * Returns whether p starts on an HPCG_ALIGNMENT byte boundary.
+ */
+inline bool
+IsAligned(
+    const void *p
+) {
+    return (reinterpret_cast<uintptr_t>(p) % HPCG_ALIGNMENT) == 0;
+}
+
+/**
+ * Returns p, telling the compiler that it is aligned if ALIGNED.
+ */
+template <bool ALIGNED, typename T>
+inline T *
+AssumeAligned(
+    T *p
+) {
+    if (!ALIGNED) return p;
+    return static_cast<T *>(__builtin_assume_aligned(p, HPCG_ALIGNMENT));
+}
+
+/**
+ * w[i] = alpha * x[i] + beta * y[i] for i in [0, n). w must not alias x or
+ * y (see WAXPBYInPlaceRows).
+ */
+template <bool ALIGNED>
+inline void
+WAXPBYRows(
+    local_int_t n,
+    floatType alpha,
+    const floatType *__restrict__ xv,
+    floatType beta,
+    const floatType *__restrict__ yv,
+    floatType *__restrict__ wv
+) {
+    xv = AssumeAligned<ALIGNED>(xv);
+    yv = AssumeAligned<ALIGNED>(yv);
+    wv = AssumeAligned<ALIGNED>(wv);
+#ifdef _OPENMP
+    #pragma omp parallel for simd schedule(static) if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < n; i++) {
+        wv[i] = alpha * xv[i] + beta * yv[i];
+    }
+}
+
+/**
+ * w[i] = alpha * w[i] + beta * y[i] for i in [0, n).
+ */
+template <bool ALIGNED>
+inline void
+WAXPBYInPlaceRows(
+    local_int_t n,
+    floatType alpha,
+    floatType *__restrict__ wv,
+    floatType beta,
+    const floatType *__restrict__ yv
+) {
+    wv = AssumeAligned<ALIGNED>(wv);
+    yv = AssumeAligned<ALIGNED>(yv);
+#ifdef _OPENMP
+    #pragma omp parallel for simd schedule(static) if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < n; i++) {
+        wv[i] = alpha * wv[i] + beta * yv[i];
+    }
+}
+
+/**
+ * w = alpha * x + beta * y, where w may be the same vector as x or y.
+ */
+inline void
+VectorWAXPBY(
+    local_int_t n,
+    floatType alpha,
+    const floatType *xv,
+    floatType beta,
+    const floatType *yv,
+    floatType *wv
+) {
+    const bool aligned = IsAligned(xv) && IsAligned(yv) && IsAligned(wv);
+    //
+    if (wv == xv && wv == yv) {
+        // Not worth a specialization: no restrict pointers to give out.
+#ifdef _OPENMP
+        #pragma omp parallel for simd schedule(static) \
+                if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+        for (local_int_t i = 0; i < n; i++) {
+            wv[i] = alpha * wv[i] + beta * wv[i];
+        }
+    }
+    else if (wv == xv) {
+        if (aligned) WAXPBYInPlaceRows<true>(n, alpha, wv, beta, yv);
+        else         WAXPBYInPlaceRows<false>(n, alpha, wv, beta, yv);
+    }
+    else if (wv == yv) {
+        if (aligned) WAXPBYInPlaceRows<true>(n, beta, wv, alpha, xv);
+        else         WAXPBYInPlaceRows<false>(n, beta, wv, alpha, xv);
+    }
+    else {
+        if (aligned) WAXPBYRows<true>(n, alpha, xv, beta, yv, wv);
+        else         WAXPBYRows<false>(n, alpha, xv, beta, yv, wv);
+    }
+}
+
+/**
+ * Returns the sum of xv[i] * yv[i] over one block (n <= HPCG_DOT_BLOCK).
+ */
+template <bool ALIGNED>
+inline floatType
+DotBlock(
+    local_int_t n,
+    const floatType *__restrict__ xv,
+    const floatType *__restrict__ yv
+) {
+    xv = AssumeAligned<ALIGNED>(xv);
+    yv = AssumeAligned<ALIGNED>(yv);
+    floatType sum = 0.0;
+#ifdef _OPENMP
+    #pragma omp simd reduction(+:sum)
+#endif
+    for (local_int_t i = 0; i < n; i++) {
+        sum += xv[i] * yv[i];
+    }
+    return sum;
+}
+
+/**
+ * Returns the pairwise sum of the n values in v.
+ */
+inline floatType
+PairwiseSum(
+    const floatType *v,
+    size_t n
+) {
+    if (n <= 8) {
+        floatType sum = 0.0;
+        for (size_t i = 0; i < n; i++) sum += v[i];
+        return sum;
+    }
+    const size_t h = n / 2;
+    return PairwiseSum(v, h) + PairwiseSum(v + h, n - h);
+}
+
+/**
+ * Returns a per-thread scratch buffer of at least n values (grown, never
+ * shrunk, so repeated calls don't allocate).
+ */
+inline floatType *
+DotPartials(
+    size_t n
+) {
+    static thread_local std::vector<floatType> partials;
+    if (partials.size() < n) partials.resize(n);
+    return partials.data();
+}
+
+/**
+ * Returns x' * y: per-block sums (computed concurrently) added pairwise.
+ */
+template <bool ALIGNED>
+inline floatType
+DotRows(
+    local_int_t n,
+    const floatType *xv,
+    const floatType *yv
+) {
+    const local_int_t nb = (n + HPCG_DOT_BLOCK - 1) / HPCG_DOT_BLOCK;
+    floatType *const partials = DotPartials(nb);
+    //
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t b = 0; b < nb; b++) {
+        const local_int_t lo = b * HPCG_DOT_BLOCK;
+        const local_int_t len = std::min(local_int_t(HPCG_DOT_BLOCK), n - lo);
+        partials[b] = DotBlock<ALIGNED>(len, xv + lo, yv + lo);
+    }
+    return PairwiseSum(partials, nb);
+}
+
+/**
+ * Returns x' * y.
+ */
+inline floatType
+VectorDot(
+    local_int_t n,
+    const floatType *xv,
+    const floatType *yv
+) {
+    if (IsAligned(xv) && IsAligned(yv)) return DotRows<true>(n, xv, yv);
+    return DotRows<false>(n, xv, yv);
+}
+
+/**
+ * Adds x' * y to result exactly (see ReproSum.hpp). Each thread accumulates
+ * its own rows; the merge is exact, so the thread count doesn't matter.
+ */
+inline void
+VectorDotRepro(
+    local_int_t n,
+    const floatType *__restrict__ xv,
+    const floatType *__restrict__ yv,
+    ReproSumValue &result
+) {
+#ifdef _OPENMP
+    #pragma omp parallel if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+    {
+        ReproSumValue mine;
+        ReproSumClear(mine);
+#ifdef _OPENMP
+        #pragma omp for schedule(static) nowait
+#endif
+        for (local_int_t i = 0; i < n; i++) {
+            ReproSumAdd(mine, xv[i] * yv[i]);
+        }
+#ifdef _OPENMP
+        #pragma omp critical
+#endif
+        ReproSumMerge(result, mine);
+    }
+}
+
+/**
+ * w = alpha * x + beta * y (w may be x or y) and returns w' * w, summed like
+ * VectorDot.
+ */
+inline floatType
+VectorWAXPBYDot(
+    local_int_t n,
+    floatType alpha,
+    const floatType *xv,
+    floatType beta,
+    const floatType *yv,
+    floatType *wv
+) {
+    const local_int_t nb = (n + HPCG_DOT_BLOCK - 1) / HPCG_DOT_BLOCK;
+    floatType *const partials = DotPartials(nb);
+    // Blocks are short, so each one runs on a single thread.
+#ifdef _OPENMP
+    #pragma omp parallel for schedule(static) if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t b = 0; b < nb; b++) {
+        const local_int_t lo = b * HPCG_DOT_BLOCK;
+        const local_int_t len = std::min(local_int_t(HPCG_DOT_BLOCK), n - lo);
+        floatType *const wb = wv + lo;
+        const floatType *const xb = xv + lo;
+        const floatType *const yb = yv + lo;
+        floatType sum = 0.0;
+        for (local_int_t i = 0; i < len; i++) {
+            const floatType wi = alpha * xb[i] + beta * yb[i];
+            wb[i] = wi;
+            sum += wi * wi;
+        }
+        partials[b] = sum;
+    }
+    return PairwiseSum(partials, nb);
+}
+
+/**
+ * rc[i] = rf[f2c[i]] - Axf[f2c[i]] for i in [0, nc).
+ */
+inline void
+RestrictRows(
+    local_int_t nc,
+    const floatType *__restrict__ rfv,
+    const floatType *__restrict__ Axfv,
+    const local_int_t *__restrict__ f2c,
+    floatType *__restrict__ rcv
+) {
+#ifdef _OPENMP
+    #pragma omp parallel for simd schedule(static) if(nc >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < nc; ++i) {
+        const local_int_t fi = f2c[i];
+        rcv[i] = rfv[fi] - Axfv[fi];
+    }
+}
+
+/**
+ * rc[i] = rf[f2c[i]] for i in [0, nc).
+ */
+inline void
+InjectRows(
+    local_int_t nc,
+    const floatType *__restrict__ rfv,
+    const local_int_t *__restrict__ f2c,
+    floatType *__restrict__ rcv
+) {
+#ifdef _OPENMP
+    #pragma omp parallel for simd schedule(static) if(nc >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < nc; ++i) {
+        rcv[i] = rfv[f2c[i]];
+    }
+}
+
+/**
+ * xf[f2c[i]] += xc[i] for i in [0, nc). f2c is injective, so the rows are
+ * independent.
+ */
+inline void
+ProlongRows(
+    local_int_t nc,
+    const floatType *__restrict__ xcv,
+    const local_int_t *__restrict__ f2c,
+    floatType *__restrict__ xfv
+) {
+#ifdef _OPENMP
+    #pragma omp parallel for simd schedule(static) if(nc >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < nc; ++i) {
+        xfv[f2c[i]] += xcv[i];
+    }
+}
+
+/**
+ * One step of the Jacobi-preconditioned Chebyshev smoother for i in [0, n):
+ * d[i] = c1 * d[i] + c2 * (b[i] - Ax[i]) / diag[i], then x[i] += d[i] if x is
+ * not NULL. Ax may be NULL (x is zero), and d is only read if c1 is not zero.
+ */
+inline void
+ChebyshevRows(
+    local_int_t n,
+    floatType c1,
+    floatType c2,
+    const floatType *__restrict__ bv,
+    const floatType *__restrict__ Axv,
+    const floatType *__restrict__ diag,
+    floatType *__restrict__ dv,
+    floatType *__restrict__ xv
+) {
+    const bool readD = (c1 != 0.0);
+#ifdef _OPENMP
+    #pragma omp parallel for simd schedule(static) if(n >= HPCG_OMP_MIN_LENGTH)
+#endif
+    for (local_int_t i = 0; i < n; ++i) {
+        const floatType ri = Axv ? bv[i] - Axv[i] : bv[i];
+        const floatType di = c2 * ri / diag[i] + (readD ? c1 * dv[i] : 0.0);
+        dv[i] = di;
+        if (xv) xv[i] += di;
+    }
+}
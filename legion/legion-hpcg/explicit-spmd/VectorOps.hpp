@@ -69,6 +69,7 @@ ZeroVectorKernel(
 ) {
     const local_int_t localLength = v.length();
     floatType *const vv = v.data();
+    LGNCG_PROFILE(ZERO_VECTOR_TID, localLength * sizeof(floatType));
     for (local_int_t i = 0; i < localLength; ++i) vv[i] = 0.0;
 }
 
@@ -126,6 +127,7 @@ CopyVectorKernel(
     const floatType *const vv = v.data();
     floatType *const wv = w.data();
     //
+    LGNCG_PROFILE(COPY_VECTOR_TID, 2 * localLength * sizeof(floatType));
     for (local_int_t i = 0; i < localLength; ++i) wv[i] = vv[i];
 }
 
@@ -50,8 +50,75 @@
 
 #include <iostream>
 
+#include "KernelVariants.hpp"
+
 #define HPCG_STENCIL  27
+// Default number of MG levels (including the finest), see --mg-levels.
 #define NUM_MG_LEVELS 4
+// Upper bound on the number of MG levels chosen with --mg-levels=auto.
+#define HPCG_MAX_MG_LEVELS 10
+// Maximum number of right-hand sides solved together (--rhs=N, see
+// CGMulti.hpp).
+#define HPCG_MAX_RHS 4
+// Maximum number of recycled vectors of the solve sequence (--recycle=K, see
+// CGSequence.hpp).
+#define HPCG_MAX_RECYCLE 8
+// Default relative change of the right-hand side between two solves of the
+// sequence (--sequence-drift=).
+#define HPCG_SEQUENCE_DRIFT 1.0e-3
+// Each solve of the sequence stops at ||b - Ax|| <= this * ||b||.
+#define HPCG_SEQUENCE_TOLERANCE 1.0e-6
+// Maximum length of directory names passed on the command line.
+#define HPCG_MAX_PATH 256
+
+// SELL-C-sigma chunk height (number of rows stored column-major per chunk).
+#define HPCG_SELL_C     8
+// SELL-C-sigma sorting scope (rows are sorted by length within windows of this
+// many rows). Must be a multiple of HPCG_SELL_C.
+#define HPCG_SELL_SIGMA 128
+// Number of colors used by the multicolor SYMGS smoother (27-point stencil).
+#define HPCG_NUM_COLORS 8
+// Number of Jacobi-PCG (Lanczos) steps used to estimate the largest
+// eigenvalue of D^-1 A at every level.
+#define HPCG_CHEBYSHEV_LANCZOS_STEPS 10
+// The smoother targets [lambdaMax / HPCG_CHEBYSHEV_EIG_RATIO, lambdaMax].
+#define HPCG_CHEBYSHEV_EIG_RATIO 30.0
+// Byte alignment CGMapper requests for the instances it creates (see
+// VectorKernels.hpp).
+#define HPCG_ALIGNMENT 64
+// With -cgm:hugepages, instances of at least this many bytes start on a
+// boundary of this size and are backed by transparent huge pages.
+#define HPCG_HUGE_PAGE_SIZE (2 << 20)
+
+#if defined(LGNCG_USE_MATRIX_FREE) && defined(LGNCG_USE_SELL_C_SIGMA)
+#error "LGNCG_USE_MATRIX_FREE and LGNCG_USE_SELL_C_SIGMA are exclusive"
+#endif
+
+#if defined(LGNCG_USE_TRACING) && !defined(LGNCG_TASKING)
+#error "LGNCG_USE_TRACING requires LGNCG_TASKING"
+#endif
+
+#if defined(LGNCG_USE_CUDA) && !defined(LGNCG_TASKING)
+#error "LGNCG_USE_CUDA requires LGNCG_TASKING"
+#endif
+
+#if defined(LGNCG_USE_CUDA) && defined(LGNCG_USE_DEFAULT_MAPPER)
+#error "LGNCG_USE_CUDA requires CGMapper (no LGNCG_USE_DEFAULT_MAPPER)"
+#endif
+
+#if defined(LGNCG_USE_NODE_ALLREDUCE) && defined(LGNCG_USE_DEFAULT_MAPPER)
+#error "LGNCG_USE_NODE_ALLREDUCE requires CGMapper's shard placement"
+#endif
+
+/**
+ * Result of a reference CG set, as kept by --validate-once (see
+ * ValidationCache.hpp).
+ */
+struct ValidationRecord {
+    int refNiters; //!< Iterations of the set.
+    double refScaledResidual; //!< normr / normr0 after the set.
+    double refSeconds; //!< Time of the set.
+};
 
 struct HPCG_Params {
     int commSize ; //!< Total number of shards.
@@ -62,6 +129,40 @@ struct HPCG_Params {
     //!< Number of seconds to run the timed portion of the benchmark.
     int runningTime;
     int stencilSize; //!< Size of the stencil
+    int pipelinedCG; //!< Use pipelined (single reduction) CG if non-zero.
+    int mgLevels; //!< Number of MG levels (including the finest).
+    int coarseSweeps; //!< Number of SYMGS sweeps on the coarsest MG level.
+    //!< Doubles per array of the startup STREAM triad probe (0 skips it).
+    int streamLength;
+    int subBlocks; //!< Row sub-blocks per shard kernel (see SubBlocks.hpp).
+    int cgCheckFreq; //!< CG convergence check frequency (in iterations).
+    //!< Unmap mtxIndG and localToGlobalMap after setup if non-zero.
+    int releaseSetupIndices;
+    int benchmarkRuns; //!< Number of benchmark launches over one problem.
+    int shardsPerNode; //!< Consecutive shards placed on one node.
+    //!< Never garbage collect instances if non-zero (see CGMapper.hpp).
+    int persistentInstances;
+    int numberOfRhs; //!< Right-hand sides of the multi-RHS CG phase.
+    int sequenceSolves; //!< Solves of the solve sequence phase (0: none).
+    int recycleVectors; //!< Recycled vectors of the solve sequence.
+    //!< Relative right-hand side change between solves of the sequence.
+    double sequenceDrift;
+    //!< If positive, run only the kernel microbenchmark (see KernelBench.hpp).
+    int kernelBenchCalls;
+    //!< Kernel implementations (--spmv=, --symgs=, --ddot=, --mg-precision=,
+    //!< --mg-halo=, --mg-cycle=).
+    KernelVariants kernels;
+    //!< If not empty, dump the generated problem here (see Checkpoint.hpp).
+    char checkpointDir[HPCG_MAX_PATH];
+    //!< If not empty, restore the problem from here instead of generating it.
+    char restartDir[HPCG_MAX_PATH];
+    //!< Skip the reference CG set if validationCache has a record for this
+    //!< configuration, and record it otherwise.
+    int validateOnce;
+    char validationCache[HPCG_MAX_PATH];
+    //!< Set by mainTask if validationCache has a record (refRecord).
+    int refRecorded;
+    ValidationRecord refRecord;
     double phase1InitTime;
 };
 
@@ -78,6 +179,33 @@ emit(const HPCG_Params &params) {
     cout << "nx: "          << params.nx << endl;
     cout << "ny: "          << params.ny << endl;
     cout << "nz: "          << params.nz << endl;
+    cout << "mgLevels: "    << params.mgLevels << endl;
+    cout << "coarseSweeps: "<< params.coarseSweeps << endl;
+    cout << "streamLength: "<< params.streamLength << endl;
+    cout << "subBlocks: "   << params.subBlocks << endl;
+    cout << "cgCheckFreq: " << params.cgCheckFreq << endl;
+    cout << "releaseSetupIndices: " << params.releaseSetupIndices << endl;
+    cout << "benchmarkRuns: " << params.benchmarkRuns << endl;
+    cout << "shardsPerNode: " << params.shardsPerNode << endl;
+    cout << "persistentInstances: " << params.persistentInstances << endl;
+    cout << "numberOfRhs: " << params.numberOfRhs << endl;
+    cout << "sequenceSolves: " << params.sequenceSolves << endl;
+    cout << "recycleVectors: " << params.recycleVectors << endl;
+    cout << "sequenceDrift: " << params.sequenceDrift << endl;
+    cout << "validateOnce: " << params.validateOnce << endl;
+    cout << "kernelBenchCalls: " << params.kernelBenchCalls << endl;
+    cout << "spmv: "        << SPMVVariantNames[params.kernels.spmv] << endl;
+    cout << "symgs: "       << SYMGSVariantNames[params.kernels.symgs] << endl;
+    cout << "ddot: "        << DotVariantNames[params.kernels.dot] << endl;
+    cout << "mgPrecision: "
+         << (params.kernels.mixedPrecisionMG ? "mixed" : "double") << endl;
+    cout << "mgHalo: "
+         << (params.kernels.floatMGHalo ? "float" : "double") << endl;
+    cout << "smoother: "
+         << SmootherVariantNames[params.kernels.smoother] << endl;
+    cout << "mgCycle: "
+         << MGCycleVariantNames[params.kernels.mgCycle] << endl;
+    cout << "chebyshevDegree: " << params.kernels.chebyshevDegree << endl;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -45,6 +45,7 @@
 
 #include "hpcg.hpp"
 #include "ReadHpcgDat.hpp"
+#include "Roofline.hpp"
 
 #include "LegionStuff.hpp"
 
@@ -59,6 +60,28 @@ startswith(
     return 1;
 }
 
+/**
+ * Returns the number of MG levels a local grid of nx * ny * nz can support.
+ * Every level halves each dimension, and no coarse dimension is smaller than 2.
+ */
+static int
+maxMGLevels(
+    int nx,
+    int ny,
+    int nz
+) {
+    int levels = 1;
+    while (levels < HPCG_MAX_MG_LEVELS &&
+           nx % 2 == 0 && ny % 2 == 0 && nz % 2 == 0 &&
+           nx >= 4 && ny >= 4 && nz >= 4) {
+        nx /= 2;
+        ny /= 2;
+        nz /= 2;
+        levels++;
+    }
+    return levels;
+}
+
 int
 HPCG_Init(
     HPCG_Params &params,
@@ -80,6 +103,237 @@ HPCG_Init(
             }
         }
     }
+    // Check for (valueless) CG variant selection.
+    params.pipelinedCG = 0;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        if (strcmp(cArgs.argv[i], "--pipelined-cg") == 0) {
+            params.pipelinedCG = 1;
+        }
+    }
+    // Check if instances should outlive their tasks (see CGMapper.hpp).
+    params.persistentInstances = 0;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        if (strcmp(cArgs.argv[i], "--persistent-instances") == 0) {
+            params.persistentInstances = 1;
+        }
+    }
+    // Check if setup-only matrix indices should be released before CG.
+    params.releaseSetupIndices = 0;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        if (strcmp(cArgs.argv[i], "--release-setup-indices") == 0) {
+            params.releaseSetupIndices = 1;
+        }
+    }
+    // Problem checkpoint and restart directories.
+    params.checkpointDir[0] = '\0';
+    params.restartDir[0] = '\0';
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *cpd = "--checkpoint-dir=";
+        const char *rsd = "--restart-dir=";
+        if (startswith(cArgs.argv[i], cpd)) {
+            strncpy(params.checkpointDir, cArgs.argv[i] + strlen(cpd),
+                    HPCG_MAX_PATH - 1);
+            params.checkpointDir[HPCG_MAX_PATH - 1] = '\0';
+        }
+        else if (startswith(cArgs.argv[i], rsd)) {
+            strncpy(params.restartDir, cArgs.argv[i] + strlen(rsd),
+                    HPCG_MAX_PATH - 1);
+            params.restartDir[HPCG_MAX_PATH - 1] = '\0';
+        }
+    }
+    // Reuse recorded reference CG sets (see ValidationCache.hpp). Lookups
+    // happen in mainTask, once the whole configuration is known.
+    params.validateOnce = 0;
+    strcpy(params.validationCache, "hpcg-validated.dat");
+    params.refRecorded = 0;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *vc = "--validate-cache=";
+        if (strcmp(cArgs.argv[i], "--validate-once") == 0) {
+            params.validateOnce = 1;
+        }
+        else if (startswith(cArgs.argv[i], vc)) {
+            strncpy(params.validationCache, cArgs.argv[i] + strlen(vc),
+                    HPCG_MAX_PATH - 1);
+            params.validationCache[HPCG_MAX_PATH - 1] = '\0';
+        }
+    }
+    // Multigrid hierarchy. 0 means pick the deepest the local grid supports.
+    params.mgLevels = NUM_MG_LEVELS;
+    params.coarseSweeps = 1;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *mgl = "--mg-levels=";
+        const char *cs  = "--coarse-sweeps=";
+        if (startswith(cArgs.argv[i], mgl)) {
+            const char *v = cArgs.argv[i] + strlen(mgl);
+            if (strcmp(v, "auto") == 0) params.mgLevels = 0;
+            else if (sscanf(v, "%d", &params.mgLevels) != 1 ||
+                     params.mgLevels < 1) {
+                params.mgLevels = NUM_MG_LEVELS;
+            }
+        }
+        else if (startswith(cArgs.argv[i], cs)) {
+            if (sscanf(cArgs.argv[i] + strlen(cs), "%d",
+                       &params.coarseSweeps) != 1 ||
+                params.coarseSweeps < 1) {
+                params.coarseSweeps = 1;
+            }
+        }
+    }
+    // Index launch points per shard kernel (1 means single task launches).
+    // Parsed by the mapper, so --sub-blocks=N and -cgm:subregions N agree
+    // with the CPUs it gives each shard.
+    params.subBlocks = CGMapperSubBlocks();
+    // Iterations between CG convergence checks.
+    params.cgCheckFreq = 1;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *cf = "--cg-check-freq=";
+        if (startswith(cArgs.argv[i], cf)) {
+            if (sscanf(cArgs.argv[i] + strlen(cf), "%d",
+                       &params.cgCheckFreq) != 1 ||
+                params.cgCheckFreq < 1) {
+                params.cgCheckFreq = 1;
+            }
+        }
+    }
+    // mainTask replaces this with the mapper's shard placement.
+    params.shardsPerNode = 1;
+    // Number of times mainTask launches the benchmark over the same problem.
+    params.benchmarkRuns = 1;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *br = "--benchmark-runs=";
+        if (startswith(cArgs.argv[i], br)) {
+            if (sscanf(cArgs.argv[i] + strlen(br), "%d",
+                       &params.benchmarkRuns) != 1 ||
+                params.benchmarkRuns < 1) {
+                params.benchmarkRuns = 1;
+            }
+        }
+    }
+    // Right-hand sides of the multi-RHS CG phase (1: no such phase).
+    params.numberOfRhs = 1;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *nr = "--rhs=";
+        if (startswith(cArgs.argv[i], nr)) {
+            if (sscanf(cArgs.argv[i] + strlen(nr), "%d",
+                       &params.numberOfRhs) != 1 ||
+                params.numberOfRhs < 1 ||
+                params.numberOfRhs > HPCG_MAX_RHS) {
+                params.numberOfRhs = 1;
+            }
+        }
+    }
+    // Solve sequence phase (see CGSequence.hpp).
+    params.sequenceSolves = 0;
+    params.recycleVectors = 0;
+    params.sequenceDrift = HPCG_SEQUENCE_DRIFT;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *sq = "--sequence=";
+        const char *rc = "--recycle=";
+        const char *sd = "--sequence-drift=";
+        const char *arg = cArgs.argv[i];
+        if (startswith(arg, sq)) {
+            if (sscanf(arg + strlen(sq), "%d", &params.sequenceSolves) != 1 ||
+                params.sequenceSolves < 0) {
+                params.sequenceSolves = 0;
+            }
+        }
+        else if (startswith(arg, rc)) {
+            if (sscanf(arg + strlen(rc), "%d", &params.recycleVectors) != 1 ||
+                params.recycleVectors < 0 ||
+                params.recycleVectors > HPCG_MAX_RECYCLE) {
+                params.recycleVectors = 0;
+            }
+        }
+        else if (startswith(arg, sd)) {
+            if (sscanf(arg + strlen(sd), "%lf", &params.sequenceDrift) != 1 ||
+                params.sequenceDrift < 0.0) {
+                params.sequenceDrift = HPCG_SEQUENCE_DRIFT;
+            }
+        }
+    }
+    // Calls per kernel of the microbenchmark mode (0 runs CG instead).
+    params.kernelBenchCalls = 0;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *kb = "--kernel-bench=";
+        if (startswith(cArgs.argv[i], kb)) {
+            if (sscanf(cArgs.argv[i] + strlen(kb), "%d",
+                       &params.kernelBenchCalls) != 1 ||
+                params.kernelBenchCalls < 0) {
+                params.kernelBenchCalls = 0;
+            }
+        }
+    }
+    // STREAM triad probe of the roofline report (see Roofline.hpp).
+    params.streamLength = ROOFLINE_STREAM_LENGTH;
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *sl = "--stream=";
+        if (startswith(cArgs.argv[i], sl)) {
+            if (sscanf(cArgs.argv[i] + strlen(sl), "%d",
+                       &params.streamLength) != 1 ||
+                params.streamLength < 0) {
+                params.streamLength = ROOFLINE_STREAM_LENGTH;
+            }
+        }
+    }
+    // Kernel variants default to the ones selected by the build options.
+    params.kernels = DefaultKernelVariants();
+    for (int i = 1; i < cArgs.argc; ++i) {
+        const char *spmv = "--spmv=";
+        const char *symgs = "--symgs=";
+        const char *ddot = "--ddot=";
+        const char *mgp = "--mg-precision=";
+        const char *mgHalo = "--mg-halo=";
+        const char *smoother = "--smoother=";
+        const char *mgCycle = "--mg-cycle=";
+        const char *chebyDeg = "--chebyshev-degree=";
+        const char *arg = cArgs.argv[i];
+        int v = -1;
+        if (startswith(arg, spmv)) {
+            v = KernelVariantIndex(arg + strlen(spmv), SPMVVariantNames, 3);
+            if (v >= 0) params.kernels.spmv = v;
+        }
+        else if (startswith(arg, symgs)) {
+            v = KernelVariantIndex(arg + strlen(symgs), SYMGSVariantNames, 4);
+            if (v >= 0) params.kernels.symgs = v;
+        }
+        else if (startswith(arg, ddot)) {
+            v = KernelVariantIndex(arg + strlen(ddot), DotVariantNames, 2);
+            if (v >= 0) params.kernels.dot = v;
+        }
+        else if (startswith(arg, mgp)) {
+            if (strcmp(arg + strlen(mgp), "double") == 0) {
+                params.kernels.mixedPrecisionMG = false;
+            }
+            else if (strcmp(arg + strlen(mgp), "mixed") == 0) {
+                params.kernels.mixedPrecisionMG = true;
+            }
+        }
+        else if (startswith(arg, mgHalo)) {
+            if (strcmp(arg + strlen(mgHalo), "double") == 0) {
+                params.kernels.floatMGHalo = false;
+            }
+            else if (strcmp(arg + strlen(mgHalo), "float") == 0) {
+                params.kernels.floatMGHalo = true;
+            }
+        }
+        else if (startswith(arg, smoother)) {
+            v = KernelVariantIndex(
+                    arg + strlen(smoother), SmootherVariantNames, 2
+                );
+            if (v >= 0) params.kernels.smoother = v;
+        }
+        else if (startswith(arg, mgCycle)) {
+            v = KernelVariantIndex(
+                    arg + strlen(mgCycle), MGCycleVariantNames, 2
+                );
+            if (v >= 0) params.kernels.mgCycle = v;
+        }
+        else if (startswith(arg, chebyDeg)) {
+            if (sscanf(arg + strlen(chebyDeg), "%d", &v) == 1 && v > 0) {
+                params.kernels.chebyshevDegree = v;
+            }
+        }
+    }
     // Check if --rt was specified on the command line
     // Assume runtime was not specified and will be read from the hpcg.dat file
     int *rt = iparams + 3;
@@ -106,11 +360,23 @@ HPCG_Init(
     params.ny = iparams[1];
     params.nz = iparams[2];
     //
+    const int mgLevelsMax = maxMGLevels(params.nx, params.ny, params.nz);
+    if (params.mgLevels == 0) {
+        params.mgLevels = mgLevelsMax;
+    }
+    else if (params.mgLevels > mgLevelsMax) {
+        fprintf(stderr,
+                "local grid only supports %d MG levels, using that many\n",
+                mgLevelsMax);
+        params.mgLevels = mgLevelsMax;
+    }
+    //
     params.runningTime = iparams[3];
     //
     params.commSize = spmdMeta.nRanks;
     //
-    params.numThreads = 1;
+    // Each shard's sub-block launches run on that many CPUs.
+    params.numThreads = params.subBlocks;
     //
     params.stencilSize = HPCG_STENCIL;
     //
@@ -55,13 +55,24 @@
 #include "GenerateProblem.hpp"
 #include "GenerateCoarseProblem.hpp"
 #include "SetupHalo.hpp"
+#include "OptimizeProblem.hpp"
+#include "ComputeChebyshev.hpp"
 #include "CG.hpp"
+#include "CGPipelined.hpp"
+#include "CGMulti.hpp"
+#include "CGSequence.hpp"
+#include "Checkpoint.hpp"
+#include "MemoryFootprint.hpp"
 #include "TestNorms.hpp"
 #include "CheckProblem.hpp"
 #include "ComputeResidual.hpp"
+#include "KernelBench.hpp"
+#include "Roofline.hpp"
+#include "ValidationCache.hpp"
 
 #include <iostream>
 #include <cstdlib>
+#include <algorithm>
 
 using namespace std;
 
@@ -102,6 +113,7 @@ genProblemTask(
         params.numThreads,
         nx, ny, nz,
         params.stencilSize,
+        params.shardsPerNode,
         A.geom->data()
     );
     ierr = CheckAspectRatio(
@@ -115,7 +127,7 @@ genProblemTask(
     if (ierr) exit(ierr);
     //
     SparseMatrix *curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < params.mgLevels; ++level) {
         curLevelMatrix->Ac = new SparseMatrix(regions, rid, ctx, runtime);
         rid += curLevelMatrix->Ac->nRegionEntries();
         curLevelMatrix = curLevelMatrix->Ac;
@@ -125,15 +137,43 @@ genProblemTask(
     Array<floatType> x     (regions[rid++], ctx, runtime);
     Array<floatType> xexact(regions[rid++], ctx, runtime);
     //
+    if (params.restartDir[0] != '\0') {
+        // Only the top level has vectors.
+        curLevelMatrix = &A;
+        for (int level = 0; level < params.mgLevels; ++level) {
+            const bool top = (level == 0);
+            ierr = ReadCheckpoint(
+                params.restartDir, rank, level, *curLevelMatrix,
+                top ? &b : NULL, top ? &x : NULL, top ? &xexact : NULL
+            );
+            if (ierr) exit(ierr);
+            curLevelMatrix = curLevelMatrix->Ac;
+        }
+        return;
+    }
+    //
     const int levelZero = 0;
     GenerateProblem(A, &b, &x, &xexact, levelZero, ctx, runtime);
     GetNeighborInfo(A);
     //
     curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < params.mgLevels; ++level) {
         GenerateCoarseProblem(*curLevelMatrix, level, ctx, runtime);
         curLevelMatrix = curLevelMatrix->Ac;
     }
+    //
+    if (params.checkpointDir[0] != '\0') {
+        curLevelMatrix = &A;
+        for (int level = 0; level < params.mgLevels; ++level) {
+            const bool top = (level == 0);
+            ierr = WriteCheckpoint(
+                params.checkpointDir, level, *curLevelMatrix,
+                top ? &b : NULL, top ? &x : NULL, top ? &xexact : NULL
+            );
+            if (ierr) exit(ierr);
+            curLevelMatrix = curLevelMatrix->Ac;
+        }
+    }
 }
 
 /**
@@ -159,6 +199,7 @@ generateInitGeometry(
         params.numThreads,
         nx, ny, nz,
         params.stencilSize,
+        params.shardsPerNode,
         &globalGeom
     );
 }
@@ -173,6 +214,7 @@ createLogicalStructures(
     LogicalArray<floatType> &y,
     LogicalArray<floatType> &xexact,
     const Geometry          &geom,
+    int numberOfMgLevels,
     Context ctx,
     HighLevelRuntime *runtime
 ) {
@@ -194,7 +236,7 @@ createLogicalStructures(
     //
     cout << "*** Creating Logical MG Structures..." << endl;
     LogicalSparseMatrix *curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < numberOfMgLevels; ++level) {
         GenerateCoarseProblemTopLevel(*curLevelMatrix, level, ctx, runtime);
         curLevelMatrix = curLevelMatrix->Ac;
     }
@@ -213,6 +255,7 @@ destroyLogicalStructures(
     LogicalArray<floatType> &x,
     LogicalArray<floatType> &y,
     LogicalArray<floatType> &xexact,
+    int numberOfMgLevels,
     Context ctx,
     HighLevelRuntime *lrt
 ) {
@@ -220,7 +263,7 @@ destroyLogicalStructures(
     const double start = mytimer();
     //
     LogicalSparseMatrix *curLevelMatrix = &A;
-    for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 0; level < numberOfMgLevels; ++level) {
         curLevelMatrix->deallocate(ctx, lrt);
         curLevelMatrix = curLevelMatrix->Ac;
     }
@@ -244,8 +287,11 @@ mainTask(
     const vector<PhysicalRegion> &,
     Context ctx, HighLevelRuntime *runtime
 ) {
-    // Ask the mapper how many shards we can have.
-    const size_t nShards = getNumProcs();
+    // Ask the mapper how many shards we can have. With --sub-blocks=N each
+    // shard gets N CPUs.
+    const size_t nShards = std::max<size_t>(
+        1, getNumProcs() / CGMapperSubBlocks()
+    );
     cout << endl;
     cout << "*****************************************************" << endl;
     cout << "*** Run Statistics..." << endl;
@@ -265,6 +311,8 @@ mainTask(
     HPCG_Params params;
     //
     HPCG_Init(params, meta);
+    // Lay out the process grid so that each node holds a brick of it.
+    params.shardsPerNode = CGMapperShardsPerNode(nShards);
     //
     Geometry initGeom;
     generateInitGeometry(nShards, params, initGeom);
@@ -273,10 +321,12 @@ mainTask(
     cout << "--> npx="  << initGeom.npx  << endl;
     cout << "--> npy="  << initGeom.npy  << endl;
     cout << "--> npz="  << initGeom.npz  << endl;
+    cout << "--> node brick=" << initGeom.nbx << "x" << initGeom.nby
+         << "x" << initGeom.nbz << endl;
     cout << "--> nx="   << initGeom.nx   << endl;
     cout << "--> ny="   << initGeom.ny   << endl;
     cout << "--> nz="   << initGeom.nz   << endl;
-    cout << "--> nmg="  << NUM_MG_LEVELS << endl;
+    cout << "--> nmg="  << params.mgLevels << endl;
     ////////////////////////////////////////////////////////////////////////////
     cout << "*** Starting Initialization..." << endl;;
     // Application structures.
@@ -284,7 +334,7 @@ mainTask(
     LogicalArray<floatType> b, x, xexact;
     //
     createLogicalStructures(
-        A, b, x, xexact, initGeom, ctx, runtime
+        A, b, x, xexact, initGeom, params.mgLevels, ctx, runtime
     );
     // Time to initialize problem before start of benchmark (phase 1).
     const double initStart = mytimer();
@@ -300,7 +350,7 @@ mainTask(
             );
             // Add all matrix levels.
             LogicalSparseMatrix *curLevelMatrix = &A;
-            for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+            for (int level = 0; level < params.mgLevels; ++level) {
                 curLevelMatrix->intent(RW_E, shard, launcher, ctx, runtime);
                 curLevelMatrix = curLevelMatrix->Ac;
             }
@@ -321,7 +371,7 @@ mainTask(
     // PhaseBarriers.
     {
         LogicalSparseMatrix *curLevelMatrix = &A;
-        for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+        for (int level = 0; level < params.mgLevels; ++level) {
             SetupHaloTopLevel(*curLevelMatrix, level, ctx, runtime);
             curLevelMatrix = curLevelMatrix->Ac;
         }
@@ -331,15 +381,27 @@ mainTask(
     cout << "--> Time=" << params.phase1InitTime << " s" << endl;
 
     ////////////////////////////////////////////////////////////////////////////
-    // Launch the tasks to begin the benchmark.
+    // Launch the tasks to begin the benchmark. Repeated runs reuse the
+    // problem regions (and, with --persistent-instances, their instances).
     ////////////////////////////////////////////////////////////////////////////
-    {
+    for (int run = 0; run < params.benchmarkRuns; ++run) {
         cout << endl;
         cout << "*****************************************************" << endl;
-        cout << "*** Starting Benchmark..." << endl;
+        cout << "*** Starting Benchmark (run " << run + 1 << " of "
+             << params.benchmarkRuns << ")..." << endl;
         cout << "*****************************************************" << endl;
         //
         const double start = mytimer();
+        // An earlier run (or process) may have recorded the reference set.
+        if (params.validateOnce) {
+            params.refRecorded = ReadValidationRecord(
+                params.validationCache, ValidationKey(params), params.refRecord
+            );
+            if (params.refRecorded) {
+                cout << "--> Reference CG recorded in "
+                     << params.validationCache << ", skipping it" << endl;
+            }
+        }
         //
         MustEpochLauncher mel;
         //
@@ -351,7 +413,7 @@ mainTask(
             const ItemFlags aif = IFLAG_W_GHOSTS;
             // Add all matrix levels.
             LogicalSparseMatrix *curLevelMatrix = &A;
-            for (int level = 0; level < NUM_MG_LEVELS; ++level) {
+            for (int level = 0; level < params.mgLevels; ++level) {
                 curLevelMatrix->intent(RW_E, aif, shard, launcher, ctx, runtime);
                 curLevelMatrix = curLevelMatrix->Ac;
             }
@@ -377,7 +439,7 @@ mainTask(
     cout << "*** Cleaning Up..." << endl;
     //
     destroyLogicalStructures(
-        A, b, x, xexact, ctx, runtime
+        A, b, x, xexact, params.mgLevels, ctx, runtime
     );
 }
 
@@ -403,6 +465,7 @@ allocateMGData(
     mgRegions.push_back(         lMGData.rc.mapRegion(RW_E, ctx, lrt));
     mgRegions.push_back(         lMGData.xc.mapRegion(RW_E, ctx, lrt));
     mgRegions.push_back(        lMGData.Axf.mapRegion(RW_E, ctx, lrt));
+    mgRegions.push_back(     lMGData.chebyD.mapRegion(RW_E, ctx, lrt));
     //
     const int mgDataBaseRID = 0;
     A.mgData = new MGData(mgRegions, mgDataBaseRID, ctx, lrt);
@@ -415,11 +478,12 @@ static void
 destroySolveLocalStructures(
     SparseMatrix &A,
     CGData &cgData,
+    int numberOfMgLevels,
     Context ctx,
     HighLevelRuntime *lrt
 ) {
     SparseMatrix *curLevelMatrix = &A;
-    for (int level = 1; level < NUM_MG_LEVELS; ++level) {
+    for (int level = 1; level < numberOfMgLevels; ++level) {
         // These were mapped inline in startBenchmarkTask, so explicitly unmap.
         curLevelMatrix->mgData->unmapRegions(ctx, lrt);
         curLevelMatrix = curLevelMatrix->Ac;
@@ -428,6 +492,121 @@ destroySolveLocalStructures(
     cgData.unmapRegions(ctx, lrt);
 }
 
+/**
+ * Waits for all work this shard issued and for the other shards, then
+ * returns the time.
+ */
+static double
+kernelBenchTimer(
+    SparseMatrix &A,
+    Context ctx,
+    HighLevelRuntime *lrt
+) {
+    lrt->issue_execution_fence(ctx).get_void_result();
+    Future zeroF = Future::from_value(lrt, floatType(0.0));
+    allReduce(zeroF, *A.dcAllRedMaxFT, ctx, lrt).get_void_result();
+    return mytimer();
+}
+
+/**
+ * Runs SPMV, SYMGS, DDOT and WAXPBY in isolation, numberOfCalls times each,
+ * on the generated b and xexact, and reports them the way the ref-impl
+ * xhpcg --kernel-bench does (see KernelBench.hpp).
+ */
+static int
+runKernelBench(
+    SparseMatrix &A,
+    CGData &data,
+    Array<floatType> &b,
+    Array<floatType> &xexact,
+    int numberOfCalls,
+    Context ctx,
+    HighLevelRuntime *lrt
+) {
+    using namespace std;
+    //
+    const Geometry *const Ageom = A.geom->data();
+    const local_int_t nrow = A.sclrs->data()->localNumberOfRows;
+    Array<floatType> &p  = *data.p;
+    Array<floatType> &Ap = *data.Ap;
+    Array<floatType> &z  = *data.z;
+    Array<floatType> &r  = *data.r;
+    //
+    KernelBenchResult results[KERNEL_BENCH_N];
+    double t0 = 0.0, tAllreduce = 0.0;
+    Future dotF;
+    //
+    CopyVector(b, p, ctx, lrt);
+    t0 = kernelBenchTimer(A, ctx, lrt);
+    for (int i = 0; i < numberOfCalls; ++i) {
+        ComputeSPMV(A, p, Ap, ctx, lrt);
+    }
+    results[KERNEL_BENCH_SPMV].seconds = kernelBenchTimer(A, ctx, lrt) - t0;
+    //
+    ZeroVector(z, ctx, lrt);
+    t0 = kernelBenchTimer(A, ctx, lrt);
+    for (int i = 0; i < numberOfCalls; ++i) {
+        ComputeSYMGS(A, b, z, ctx, lrt);
+    }
+    results[KERNEL_BENCH_SYMGS].seconds = kernelBenchTimer(A, ctx, lrt) - t0;
+    //
+    t0 = kernelBenchTimer(A, ctx, lrt);
+    for (int i = 0; i < numberOfCalls; ++i) {
+        ComputeDotProduct(nrow, b, xexact, dotF, tAllreduce,
+                          *A.dcAllRedSumFT, ctx, lrt);
+    }
+    results[KERNEL_BENCH_DDOT].seconds = kernelBenchTimer(A, ctx, lrt) - t0;
+    results[KERNEL_BENCH_DDOT].checksum =
+        dotF.get_result<floatType>(silenceWarnings);
+    //
+    t0 = kernelBenchTimer(A, ctx, lrt);
+    for (int i = 0; i < numberOfCalls; ++i) {
+        ComputeWAXPBY(nrow, 1.0, b, 0.5, xexact, r, ctx, lrt);
+    }
+    results[KERNEL_BENCH_WAXPBY].seconds = kernelBenchTimer(A, ctx, lrt) - t0;
+    // Checksums of the outputs, to confirm both runtimes computed the same
+    // thing.
+    Array<floatType> *outputs[KERNEL_BENCH_N] = {&Ap, &z, nullptr, &r};
+    for (int k = 0; k < KERNEL_BENCH_N; ++k) {
+        if (!outputs[k]) continue;
+        ComputeDotProduct(nrow, *outputs[k], *outputs[k], dotF, tAllreduce,
+                          *A.dcAllRedSumFT, ctx, lrt);
+        results[k].checksum = dotF.get_result<floatType>(silenceWarnings);
+    }
+    // Report the slowest shard.
+    for (int k = 0; k < KERNEL_BENCH_N; ++k) {
+        Future localF = Future::from_value(lrt, floatType(results[k].seconds));
+        results[k].seconds = allReduce(
+            localF, *A.dcAllRedMaxFT, ctx, lrt
+        ).get_result<floatType>(silenceWarnings);
+    }
+    KernelBenchModel(
+        A.sclrs->data()->totalNumberOfRows,
+        A.sclrs->data()->totalNumberOfNonzeros,
+        results
+    );
+    //
+    int ierr = 0;
+    if (Ageom->rank == 0) {
+        for (int k = 0; k < KERNEL_BENCH_N; ++k) {
+            const double perCall = results[k].seconds / numberOfCalls;
+            cout << "--> Kernel " << KernelBenchNames[k] << ": "
+                 << perCall << " s/call, "
+                 << results[k].flops / perCall / 1.0E9 << " GFLOP/s, "
+                 << results[k].bytes / perCall / 1.0E9 << " GB/s, checksum "
+                 << results[k].checksum << endl;
+        }
+        if (!WriteKernelBenchYAML(
+                KERNEL_BENCH_YAML, "legion", Ageom->size,
+                Ageom->nx, Ageom->ny, Ageom->nz, numberOfCalls, results
+            )) {
+            cerr << "Cannot write " << KERNEL_BENCH_YAML << endl;
+            ierr = 1;
+        }
+    }
+    return ierr;
+}
+
 /**
  *
  */
@@ -442,12 +621,15 @@ startBenchmarkTask(
     static const bool doMG = true;
     //
     double setup_time = mytimer();
+    //
+    const HPCG_Params params = *(HPCG_Params *)task->args;
     // Number of levels including first.
-    const int numberOfMgLevels = NUM_MG_LEVELS;
+    const int numberOfMgLevels = params.mgLevels;
+    // Kernels of this shard split their rows into this many index points.
+    SubBlocksPerShard() = params.subBlocks;
+    ShardKernelVariants() = params.kernels;
     // Use this array for collecting timing information.
     std::vector<double> times(10, 0.0);
-    //
-    const HPCG_Params params = *(HPCG_Params *)task->args;
     // Check if QuickPath option is enabled.  If the running time is set to
     // zero, we minimize all paths through the program.
     const bool quickPath = (params.runningTime == 0);
@@ -480,11 +662,11 @@ startBenchmarkTask(
     vector<PhysicalRegion> cgRegions;
     const int nCGDataRegions = 4;
     cgRegions.reserve(nCGDataRegions);
-    //
-    cgRegions.push_back( lCGData.r.mapRegion(RW_E, ctx, lrt));
-    cgRegions.push_back( lCGData.z.mapRegion(RW_E, ctx, lrt));
-    cgRegions.push_back( lCGData.p.mapRegion(RW_E, ctx, lrt));
-    cgRegions.push_back(lCGData.Ap.mapRegion(RW_E, ctx, lrt));
+    // r's region holds Ap, w, n, q, and Aq, too.
+    cgRegions.push_back(lCGData.r.mapRegionFields(RW_E, ctx, lrt));
+    cgRegions.push_back(lCGData.z.mapRegion(RW_E, ctx, lrt));
+    cgRegions.push_back(lCGData.p.mapRegion(RW_E, ctx, lrt));
+    cgRegions.push_back(lCGData.m.mapRegion(RW_E, ctx, lrt));
     //
     const int cgDataBaseRID = 0;
     CGData data(cgRegions, cgDataBaseRID, ctx, lrt);
@@ -495,6 +677,8 @@ startBenchmarkTask(
         f2cOperatorPopulate(*curLevelMatrix, ctx, lrt);
         curLevelMatrix = curLevelMatrix->Ac;
     }
+    // curLevelMatrix is now the coarsest level.
+    curLevelMatrix->numberOfCoarseSweeps = params.coarseSweeps;
     // Setup halo information for all levels before we begin.
     curLevelMatrix = &A;
     for (int level = 0; level < numberOfMgLevels; ++level) {
@@ -505,6 +689,14 @@ startBenchmarkTask(
     // doesn't like that (mapping/remapping warnings + bad performance).
     SetupGhostArrays(A, *data.z, ctx, lrt);
     SetupGhostArrays(A, *data.p, ctx, lrt);
+    SetupGhostArrays(A, *data.m, ctx, lrt);
+    // Build the cached halo exchange launchers for the same vectors. z is only
+    // exchanged by the MG preconditioner unless pipelined CG SpMVs it, p and m
+    // feed CG's own SpMVs and stay at full precision.
+    const bool floatMGHalo = params.kernels.floatMGHalo;
+    SetupHaloPlan(A, *data.z, ctx, lrt, floatMGHalo && !params.pipelinedCG);
+    SetupHaloPlan(A, *data.p, ctx, lrt);
+    SetupHaloPlan(A, *data.m, ctx, lrt);
     // Setup ghost information for all levels before we begin.
     curLevelMatrix = &A;
     for (int level = 1; level < numberOfMgLevels; ++level) {
@@ -514,14 +706,43 @@ startBenchmarkTask(
             ctx,
             lrt
         );
+        SetupHaloPlan(
+            *curLevelMatrix->Ac,
+            *curLevelMatrix->mgData->xc,
+            ctx,
+            lrt,
+            floatMGHalo
+        );
         curLevelMatrix = curLevelMatrix->Ac;
     }
+    // Vectors of the multi-RHS CG phase.
+    MultiCGData multiData;
+    if (params.numberOfRhs > 1) {
+        multiData.allocate(A, params.numberOfRhs, numberOfMgLevels, ctx, lrt);
+    }
+    // Vectors of the solve sequence phase.
+    SequenceData sequenceData;
+    if (params.sequenceSolves > 0) {
+        sequenceData.allocate(A, params.recycleVectors, ctx, lrt);
+    }
 
     // Capture total time of setup.
     setup_time = mytimer() - setup_time;
     setup_time += params.phase1InitTime;
     // Save it for reporting.
     times[9] = setup_time;
+    // Call user-tunable set up function.
+    double t7 = mytimer();
+    OptimizeProblem(A, data, b, x, xexact, ctx, lrt);
+    if (params.kernels.smoother == SMOOTHER_VARIANT_CHEBYSHEV) {
+        SetupChebyshevSmoother(A, data, ctx, lrt);
+    }
+    t7 = mytimer() - t7;
+    times[7] = t7;
+    // Nothing past this point needs the global column indices.
+    if (params.releaseSetupIndices) {
+        A.releaseSetupIndices(ctx, lrt);
+    }
     //
     const int rank = A.geom->data()->rank;
     //
@@ -531,11 +752,23 @@ startBenchmarkTask(
         taskingEnabled = true;
 #endif
         cout << "--> Implementation=Legion" << endl;
+        const KernelVariants &kv = params.kernels;
         cout << "--> Options="
-             << (taskingEnabled ? "Tasking" : "")
+             << (taskingEnabled ? "Tasking " : "")
+             << "SpMV=" << SPMVVariantNames[kv.spmv] << " "
+             << "SYMGS=" << SYMGSVariantNames[kv.symgs] << " "
+             << "DDOT=" << DotVariantNames[kv.dot] << " "
+             << (kv.mixedPrecisionMG ? "MixedPrecisionMG " : "")
+             << (kv.floatMGHalo ? "FloatMGHalo " : "")
+             << (kv.smoother == SMOOTHER_VARIANT_CHEBYSHEV ?
+                 "Smoother=chebyshev " : "")
+             << (kv.mgCycle == MG_CYCLE_ADDITIVE ? "MGCycle=additive " : "")
+             << (params.pipelinedCG ? "PipelinedCG" : "")
              << endl;
+        cout << "--> Optimize problem setup time (s) = " << t7 << endl;
         cout << "--> Total problem setup time in main (s) = "
              << setup_time << endl;
+        emitMemoryFootprint(ComputeMemoryFootprint(A));
     }
 
     // Now unmap structures that are done using accessors.
@@ -555,6 +788,26 @@ startBenchmarkTask(
     // Used to check return codes on function calls.
     int ierr = 0;
     int numberOfCalls = 10;
+    //
+    ////////////////////////////////////////////////////////////////////////////
+    // STREAM Triad Probe                                                     //
+    ////////////////////////////////////////////////////////////////////////////
+    // All shards run the triad at once on their own processor, so the sum is
+    // what the machine sustains.
+    {
+        Future zeroF = Future::from_value(lrt, floatType(0.0));
+        allReduce(zeroF, *A.dcAllRedMaxFT, ctx, lrt).get_void_result();
+    }
+    Future localStreamF = Future::from_value(
+        lrt, floatType(StreamTriadBandwidth(params.streamLength))
+    );
+    const double streamBandwidth = allReduce(
+        localStreamF, *A.dcAllRedSumFT, ctx, lrt
+    ).get_result<floatType>(silenceWarnings);
+    if (rank == 0 && params.streamLength > 0) {
+        cout << "--> STREAM triad (GB/s) = " << streamBandwidth / 1.0E9
+             << endl;
+    }
     //QuickPath means we do on one call of each block of repetitive code.
     if (quickPath) numberOfCalls = 1;
     //
@@ -582,6 +835,18 @@ startBenchmarkTask(
     }
 #endif
     //
+    ////////////////////////////////////////////////////////////////////////////
+    // Kernel Microbenchmark Mode                                             //
+    ////////////////////////////////////////////////////////////////////////////
+    // Replaces the CG phases below.
+    const bool kernelBench = (params.kernelBenchCalls > 0);
+    if (kernelBench) {
+        ierr = runKernelBench(
+                   A, data, b, xexact, params.kernelBenchCalls, ctx, lrt
+               );
+        if (ierr) cerr << "Error in call to runKernelBench." << endl;
+    }
+
     ////////////////////////////////////////////////////////////////////////////
     // Reference CG Timing Phase                                              //
     ////////////////////////////////////////////////////////////////////////////
@@ -592,18 +857,27 @@ startBenchmarkTask(
     floatType normr0    = 0.0;
     int refMaxIters     = 50;
     // Only need to run the residual reduction analysis once
-    numberOfCalls = 1;
+    numberOfCalls = kernelBench ? 0 : 1;
     // Compute the residual reduction for the natural ordering and reference
     // kernels.
     std::vector<double> ref_times(9, 0.0);
     // Set tolerance to zero to make all runs do maxIters iterations.
     double tolerance = 0.0;
     int err_count = 0;
-    for (int i = 0; i < numberOfCalls; ++i) {
+    // With --validate-once, a recorded set stands in for the one below.
+    const bool refRecorded = params.validateOnce && params.refRecorded;
+    for (int i = 0; i < numberOfCalls && !refRecorded; ++i) {
         ZeroVector(x, ctx, lrt);
-        ierr = CG(A, data, b, x, refMaxIters, tolerance, niters,
-                  normr, normr0, &ref_times[0], doMG, ctx, lrt
-               );
+        if (params.pipelinedCG) {
+            ierr = CGPipelined(A, data, b, x, refMaxIters, tolerance, niters,
+                               normr, normr0, &ref_times[0], doMG, ctx, lrt
+                   );
+        }
+        else {
+            ierr = CG(A, data, b, x, refMaxIters, tolerance, niters,
+                      normr, normr0, &ref_times[0], doMG, ctx, lrt
+                   );
+        }
         // Count the number of errors in CG.
         if (ierr) ++err_count;
         totalNiters_ref += niters;
@@ -611,6 +885,97 @@ startBenchmarkTask(
     if (rank == 0 && err_count) {
         cerr << err_count << " error(s) in call(s) to reference CG." << endl;
     }
+    if (refRecorded && numberOfCalls > 0) {
+        const ValidationRecord &rec = params.refRecord;
+        totalNiters_ref = niters = rec.refNiters;
+        normr0 = 1.0;
+        normr = rec.refScaledResidual;
+        ref_times[0] = rec.refSeconds;
+    }
+    else if (params.validateOnce && numberOfCalls > 0 && !err_count &&
+             rank == 0) {
+        const ValidationRecord rec = {
+            .refNiters = totalNiters_ref,
+            .refScaledResidual = normr / normr0,
+            .refSeconds = ref_times[0]
+        };
+        if (AppendValidationRecord(
+                params.validationCache, ValidationKey(params), rec
+            )) {
+            cerr << "Could not record the reference CG in "
+                 << params.validationCache << endl;
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Multi-RHS CG Timing Phase                                              //
+    ////////////////////////////////////////////////////////////////////////////
+    if (params.numberOfRhs > 1 && !kernelBench) {
+        const int nRhs = params.numberOfRhs;
+        // The first column is the benchmark system, the others have random
+        // right-hand sides.
+        CopyVector(b, *multiData.columns[0]->b, ctx, lrt);
+        for (int j = 1; j < nRhs; ++j) {
+            FillRandomVector(*multiData.columns[j]->b, ctx, lrt);
+        }
+        for (int j = 0; j < nRhs; ++j) {
+            ZeroVector(*multiData.columns[j]->x, ctx, lrt);
+        }
+        //
+        std::vector<double> multi_times(9, 0.0);
+        std::vector<floatType> multiNormr(nRhs, 0.0), multiNormr0(nRhs, 0.0);
+        int multiNiters = 0;
+        ierr = CGMulti(A, multiData, refMaxIters, tolerance, multiNiters,
+                       multiNormr.data(), multiNormr0.data(), &multi_times[0],
+                       doMG, ctx, lrt
+               );
+        if (rank == 0 && ierr) {
+            cerr << "Error in call to CGMulti: " << ierr << "." << endl;
+        }
+        if (rank == 0) {
+            cout << "--> Multi-RHS CG: " << nRhs << " right-hand sides, "
+                 << multiNiters << " iterations in " << multi_times[0]
+                 << " s (" << multi_times[0] / nRhs
+                 << " s per right-hand side, single CG "
+                 << ref_times[0] / numberOfCalls << " s)" << endl;
+            for (int j = 0; j < nRhs; ++j) {
+                cout << "    Scaled Residual [" << j << "] = "
+                     << multiNormr[j] / multiNormr0[j] << endl;
+            }
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Solve Sequence Phase                                                   //
+    ////////////////////////////////////////////////////////////////////////////
+    SequenceSolveData sequenceSolveData;
+    if (params.sequenceSolves > 0 && !kernelBench) {
+        std::vector<double> seq_times(9, 0.0);
+        ZeroVector(x, ctx, lrt);
+        ierr = CGSequence(A, data, sequenceData, b, x, params.sequenceSolves,
+                          params.sequenceDrift, 10 * refMaxIters,
+                          HPCG_SEQUENCE_TOLERANCE, sequenceSolveData,
+                          &seq_times[0], doMG, ctx, lrt
+               );
+        if (rank == 0 && ierr) {
+            cerr << "Error in call to CGSequence: " << ierr << "." << endl;
+        }
+        if (rank == 0) {
+            const std::vector<int> &its = sequenceSolveData.niters;
+            int total = 0;
+            for (int n : its) total += n;
+            cout << "--> Solve sequence: " << its.size() << " solves, "
+                 << params.recycleVectors << " recycled vectors, "
+                 << total << " iterations in " << sequenceSolveData.seconds
+                 << " s (first solve " << its[0] << " iterations";
+            if (its.size() > 1) {
+                cout << ", later solves "
+                     << double(total - its[0]) / (its.size() - 1)
+                     << " on average";
+            }
+            cout << ")" << endl;
+        }
+    }
 #if 0
     //
     double refTolerance = normr / normr0;
@@ -636,9 +1001,17 @@ startBenchmarkTask(
         // Start x at all zeros.
         ZeroVector(x, ctx, lrt);
         floatType last_cummulative_time = opt_times[0];
-        ierr = CG(A, data, b, x, optMaxIters, refTolerance, niters,
-                  normr, normr0, &opt_times[0], doMG, ctx, lrt
-               );
+        if (params.pipelinedCG) {
+            ierr = CGPipelined(A, data, b, x, optMaxIters, refTolerance,
+                               niters, normr, normr0, &opt_times[0], doMG,
+                               ctx, lrt
+                   );
+        }
+        else {
+            ierr = CG(A, data, b, x, optMaxIters, refTolerance, niters,
+                      normr, normr0, &opt_times[0], doMG, ctx, lrt
+                   );
+        }
         // Count the number of errors in CG.
         if (ierr) ++err_count;
         // The number of failures to reduce residual.
@@ -685,6 +1058,9 @@ startBenchmarkTask(
     optMaxIters = optNiters;
     // Force optMaxIters iterations
     double optTolerance = 0.0;
+    // A fixed iteration count doesn't need the residual every iteration, so
+    // only the timed runs use the requested convergence check frequency.
+    data.convergenceCheckFreq = params.cgCheckFreq;
     TestNormsData testnormsData;
     testnormsData.samples = numberOfCgSets;
     testnormsData.values = new double[numberOfCgSets];
@@ -693,9 +1069,17 @@ startBenchmarkTask(
     for (int i = 0; i < numberOfCgSets; ++i) {
         // Zero out x.
         ZeroVector(x, ctx, lrt);
-        ierr = CG(A, data, b, x, optMaxIters, optTolerance, niters,
-                  normr, normr0, &times[0], doMG, ctx, lrt
-               );
+        if (params.pipelinedCG) {
+            ierr = CGPipelined(A, data, b, x, optMaxIters, optTolerance,
+                               niters, normr, normr0, &times[0], doMG,
+                               ctx, lrt
+                   );
+        }
+        else {
+            ierr = CG(A, data, b, x, optMaxIters, optTolerance, niters,
+                      normr, normr0, &times[0], doMG, ctx, lrt
+                   );
+        }
         if (ierr) {
             cerr << "Error in call to CG: " << ierr << ".\n" << endl;
         }
@@ -751,16 +1135,32 @@ startBenchmarkTask(
         testCGData,
         testSymmetryData,
         testnormsData,
+        sequenceSolveData,
         global_failure,
         quickPath,
+        streamBandwidth,
         ctx,
         lrt
     );
+#endif
+#ifdef LGNCG_USE_PROFILER
+    // Kernels run on the shard's processor (see CGMapper).
+    const std::string traceName = "lgncg-trace-" + std::to_string(rank)
+                                + ".json";
+    if (Profiler::instance().writeChromeTrace(
+            rank, task->current_proc.id, traceName
+        )) {
+        cerr << "Could not write " << traceName << endl;
+    }
 #endif
     ////////////////////////////////////////////////////////////////////////////
     // Cleanup task-local strucutres allocated for solve.
     ////////////////////////////////////////////////////////////////////////////
-    destroySolveLocalStructures(A, data, ctx, lrt);
+    // The next benchmark run (if any) picks up where we left off.
+    SaveHaloBarriers(A);
+    multiData.deallocate(ctx, lrt);
+    sequenceData.deallocate(ctx, lrt);
+    destroySolveLocalStructures(A, data, numberOfMgLevels, ctx, lrt);
     lCGData.deallocate(ctx, lrt);
 }
 
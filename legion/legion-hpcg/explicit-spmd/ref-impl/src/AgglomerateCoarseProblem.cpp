@@ -0,0 +1,194 @@
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+/*!
+ @file AgglomerateCoarseProblem.cpp
+
+ HPCG routine
+ */
+
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
+
+#include "AgglomerateCoarseProblem.hpp"
+#include "MGData.hpp"
+#include <cassert>
+
+/*!
+  Returns the level whose coarse grid is the coarsest one, or 0 if A has no coarse grid.
+*/
+static SparseMatrix * LevelAboveCoarsest(SparseMatrix & A) {
+  SparseMatrix * curLevelMatrix = &A;
+  if (curLevelMatrix->Ac==0) return 0;
+  while (curLevelMatrix->Ac->Ac!=0) curLevelMatrix = curLevelMatrix->Ac;
+  return curLevelMatrix;
+}
+
+/*!
+  Gathers the coarsest grid of the MG hierarchy onto rank 0 if it has at most maxRows rows in
+  total.  ComputeMG then replaces the distributed SYMGS on that grid with ComputeSYMGSAgglomerated.
+
+  @param[inout] A       The known system matrix, with the MG hierarchy in attributes Ac and mgData
+  @param[in]    maxRows Largest number of coarsest grid rows to agglomerate, 0 to disable it
+
+  @return returns 0 upon success and non-zero otherwise
+
+  @see ComputeSYMGSAgglomerated
+*/
+int AgglomerateCoarseProblem(SparseMatrix & A, global_int_t maxRows) {
+
+#ifndef HPCG_NO_MPI
+  SparseMatrix * fineMatrix = LevelAboveCoarsest(A);
+  if (fineMatrix==0 || fineMatrix->mgData==0 || fineMatrix->mgData->optimizationData!=0) return 0;
+  const SparseMatrix & Ac = *fineMatrix->Ac;
+  const Geometry & geom = *Ac.geom;
+  if (geom.size==1 || Ac.totalNumberOfRows>maxRows) return 0;
+
+  CoarseAgglomeration * agglomeration = new CoarseAgglomeration;
+  agglomeration->gnx = ((global_int_t) geom.nx)*geom.npx;
+  agglomeration->gny = ((global_int_t) geom.ny)*geom.npy;
+  agglomeration->gnz = ((global_int_t) geom.nz)*geom.npz;
+  assert(agglomeration->gnx*agglomeration->gny*agglomeration->gnz==Ac.totalNumberOfRows);
+
+  int localNumberOfRows = Ac.localNumberOfRows;
+  if (geom.rank==0) {
+    agglomeration->counts.resize(geom.size);
+    agglomeration->displs.resize(geom.size);
+  }
+  MPI_Gather(&localNumberOfRows, 1, MPI_INT, geom.rank==0 ? &agglomeration->counts[0] : 0, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  if (geom.rank==0) {
+    int offset = 0;
+    for (int i=0; i<geom.size; ++i) {
+      agglomeration->displs[i] = offset;
+      offset += agglomeration->counts[i];
+    }
+    assert(offset==Ac.totalNumberOfRows);
+    agglomeration->gatheredRows.resize(offset);
+    agglomeration->gathered.resize(offset);
+    agglomeration->rg.resize(offset);
+    agglomeration->xg.resize(offset);
+  }
+  // The global row of every gathered entry, so that rank 0 can put them in natural order
+  MPI_Gatherv((void *) &Ac.localToGlobalMap[0], localNumberOfRows, MPI_LONG_LONG_INT,
+      geom.rank==0 ? &agglomeration->gatheredRows[0] : 0,
+      geom.rank==0 ? &agglomeration->counts[0] : 0,
+      geom.rank==0 ? &agglomeration->displs[0] : 0,
+      MPI_LONG_LONG_INT, 0, MPI_COMM_WORLD);
+
+  fineMatrix->mgData->optimizationData = agglomeration;
+#else
+  (void) A;
+  (void) maxRows;
+#endif
+  return 0;
+}
+
+/*!
+  Symmetric Gauss-Seidel on the coarsest grid, gathered onto rank 0.
+
+  Rank 0 gathers r, runs one forward and one back sweep in natural order over the whole grid
+  with the 27-point operator of GenerateProblem (26 on the diagonal, -1 for every neighbor), and
+  scatters the result.  x is zero on entry (ComputeMG zeroes it), which the sweep relies on.
+  Ghost values of x are not updated, since the coarsest grid is not smoothed again.
+
+  @param[in]    A             the coarsest grid matrix
+  @param[in]    r             the input vector
+  @param[inout] x             on exit, the result of the sweep
+  @param[inout] agglomeration the data set up by AgglomerateCoarseProblem
+
+  @return returns 0 upon success and non-zero otherwise
+
+  @see AgglomerateCoarseProblem
+*/
+int ComputeSYMGSAgglomerated(const SparseMatrix & A, const Vector & r, Vector & x, CoarseAgglomeration & agglomeration) {
+
+  assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
+#ifndef HPCG_NO_MPI
+  const int rank = A.geom->rank;
+  double * const gathered = rank==0 ? &agglomeration.gathered[0] : 0;
+  MPI_Gatherv(r.values, A.localNumberOfRows, MPI_DOUBLE, gathered,
+      rank==0 ? &agglomeration.counts[0] : 0, rank==0 ? &agglomeration.displs[0] : 0,
+      MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+  if (rank==0) {
+    const global_int_t gnx = agglomeration.gnx;
+    const global_int_t gny = agglomeration.gny;
+    const global_int_t gnz = agglomeration.gnz;
+    const global_int_t nrow = gnx*gny*gnz;
+    double * const rg = &agglomeration.rg[0];
+    double * const xg = &agglomeration.xg[0];
+    for (global_int_t k=0; k<nrow; ++k) rg[agglomeration.gatheredRows[k]] = gathered[k];
+    for (global_int_t i=0; i<nrow; ++i) xg[i] = 0.0;
+
+    // Forward sweep, then back sweep
+    for (int sweep=0; sweep<2; ++sweep) {
+      for (global_int_t k=0; k<nrow; ++k) {
+        const global_int_t i = sweep==0 ? k : nrow-1-k;
+        const global_int_t iz = i/(gnx*gny);
+        const global_int_t iy = (i-iz*gnx*gny)/gnx;
+        const global_int_t ix = i%gnx;
+        double sum = rg[i];
+        for (int sz=-1; sz<=1; sz++) {
+          if (iz+sz<0 || iz+sz>=gnz) continue;
+          for (int sy=-1; sy<=1; sy++) {
+            if (iy+sy<0 || iy+sy>=gny) continue;
+            for (int sx=-1; sx<=1; sx++) {
+              if (ix+sx<0 || ix+sx>=gnx) continue;
+              if (sz==0 && sy==0 && sx==0) continue;
+              sum += xg[i + sx + sy*gnx + sz*gnx*gny];
+            }
+          }
+        }
+        xg[i] = sum/26.0;
+      }
+    }
+    for (global_int_t k=0; k<nrow; ++k) gathered[k] = xg[agglomeration.gatheredRows[k]];
+  }
+
+  MPI_Scatterv(gathered, rank==0 ? &agglomeration.counts[0] : 0, rank==0 ? &agglomeration.displs[0] : 0,
+      MPI_DOUBLE, x.values, A.localNumberOfRows, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+#else
+  (void) r;
+  (void) agglomeration;
+#endif
+  return 0;
+}
+
+/*!
+  Returns the number of bytes AgglomerateCoarseProblem allocated.
+*/
+double AgglomerationMemoryUse(const SparseMatrix & A) {
+
+  const SparseMatrix * curLevelMatrix = LevelAboveCoarsest(const_cast<SparseMatrix &>(A));
+  if (curLevelMatrix==0 || curLevelMatrix->mgData==0) return 0.0;
+  const CoarseAgglomeration * agglomeration = (const CoarseAgglomeration *) curLevelMatrix->mgData->optimizationData;
+  if (agglomeration==0) return 0.0;
+  double fnbytes = sizeof(CoarseAgglomeration);
+  fnbytes += ((double) sizeof(int))*(agglomeration->counts.size() + agglomeration->displs.size());
+  fnbytes += ((double) sizeof(global_int_t))*agglomeration->gatheredRows.size();
+  fnbytes += ((double) sizeof(double))*(agglomeration->gathered.size() + agglomeration->rg.size() + agglomeration->xg.size());
+  return fnbytes;
+}
+
+/*!
+  Frees what AgglomerateCoarseProblem attached to the MG hierarchy of A.
+*/
+void DeleteAgglomeration(SparseMatrix & A) {
+
+  SparseMatrix * curLevelMatrix = LevelAboveCoarsest(A);
+  if (curLevelMatrix==0 || curLevelMatrix->mgData==0) return;
+  delete (CoarseAgglomeration *) curLevelMatrix->mgData->optimizationData;
+  curLevelMatrix->mgData->optimizationData = 0;
+  return;
+}
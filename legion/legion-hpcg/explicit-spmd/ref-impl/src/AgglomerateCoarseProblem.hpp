@@ -0,0 +1,43 @@
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+#ifndef AGGLOMERATECOARSEPROBLEM_HPP
+#define AGGLOMERATECOARSEPROBLEM_HPP
+#include <vector>
+#include "SparseMatrix.hpp"
+#include "Vector.hpp"
+
+/*!
+  Coarsest grid gathered onto rank 0, stored in MGData::optimizationData of the level above it.
+
+  Rank 0 smooths the whole coarsest grid in natural order, so the coarse solve costs one gather
+  and one scatter instead of a halo exchange with every neighbor.
+ */
+struct CoarseAgglomeration_STRUCT {
+  global_int_t gnx; //!< global number of x-direction grid points of the coarsest grid
+  global_int_t gny; //!< global number of y-direction grid points of the coarsest grid
+  global_int_t gnz; //!< global number of z-direction grid points of the coarsest grid
+  std::vector<int> counts; //!< rows of each rank (rank 0 only)
+  std::vector<int> displs; //!< offset of each rank's rows in the gathered vectors (rank 0 only)
+  std::vector<global_int_t> gatheredRows; //!< global row of each gathered entry (rank 0 only)
+  std::vector<double> gathered; //!< gathered values, in rank order (rank 0 only)
+  std::vector<double> rg; //!< coarsest grid right hand side in global row order (rank 0 only)
+  std::vector<double> xg; //!< coarsest grid solution in global row order (rank 0 only)
+};
+typedef struct CoarseAgglomeration_STRUCT CoarseAgglomeration;
+
+int AgglomerateCoarseProblem(SparseMatrix & A, global_int_t maxRows);
+int ComputeSYMGSAgglomerated(const SparseMatrix & A, const Vector & r, Vector & x, CoarseAgglomeration & agglomeration);
+double AgglomerationMemoryUse(const SparseMatrix & A);
+void DeleteAgglomeration(SparseMatrix & A);
+#endif // AGGLOMERATECOARSEPROBLEM_HPP
@@ -19,9 +19,98 @@
  */
 
 #include "ComputeMG.hpp"
-#include "ComputeMG_ref.hpp"
+#include "ComputeSYMGS.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeRestriction_ref.hpp"
+#include "ComputeProlongation_ref.hpp"
+#include "AgglomerateCoarseProblem.hpp"
+#include "mytimer.hpp"
+#include <cassert>
+#include <vector>
+
+// Time spent in each level alone and in its SYMGS calls, fine level first
+static std::vector<double> mgLevelTimes, mgSymgsTimes;
+
+/*!
+  Resets the per-level times accumulated by ComputeMG.
+
+  @see GetMGLevelTimes
+*/
+void ResetMGLevelTimes() {
+  mgLevelTimes.clear();
+  mgSymgsTimes.clear();
+}
+
+/*!
+  Copies the per-level times ComputeMG accumulated since the last ResetMGLevelTimes.
+
+  @param[in]  numberOfMgLevels number of levels to copy
+  @param[out] levelTimes time spent in each level, excluding the coarser levels
+  @param[out] symgsTimes time spent in the SYMGS calls of each level
+*/
+void GetMGLevelTimes(int numberOfMgLevels, double * levelTimes, double * symgsTimes) {
+  for (int i=0; i<numberOfMgLevels; ++i) {
+    levelTimes[i] = i<(int)mgLevelTimes.size() ? mgLevelTimes[i] : 0.0;
+    symgsTimes[i] = i<(int)mgSymgsTimes.size() ? mgSymgsTimes[i] : 0.0;
+  }
+}
 
 /*!
+  One level of the V-cycle, with A at the given level (0 is the fine level).  If agglomeration is
+  not 0, A is the coarsest grid and is smoothed on rank 0 (see AgglomerateCoarseProblem).
+*/
+static int ComputeMGLevel(const SparseMatrix & A, const Vector & r, Vector & x, int level, CoarseAgglomeration * agglomeration) {
+
+  if ((int)mgLevelTimes.size()<=level) {
+    mgLevelTimes.resize(level+1, 0.0);
+    mgSymgsTimes.resize(level+1, 0.0);
+  }
+  double t0 = mytimer();
+  double tsymgs = 0.0, tsub = 0.0, t1 = 0.0;
+
+  ZeroVector(x); // initialize x to zero
+
+  int ierr = 0;
+  if (A.mgData!=0) { // Go to next coarse level if defined
+    int numberOfPresmootherSteps = A.mgData->numberOfPresmootherSteps;
+    t1 = mytimer();
+    for (int i=0; i< numberOfPresmootherSteps; ++i) ierr += ComputeSYMGS(A, r, x);
+    tsymgs += mytimer() - t1;
+    if (ierr!=0) return ierr;
+    ierr = ComputeSPMV(A, x, *A.mgData->Axf); if (ierr!=0) return ierr;
+    // Perform restriction operation using simple injection
+    ierr = ComputeRestriction_ref(A, r);  if (ierr!=0) return ierr;
+    t1 = mytimer();
+    ierr = ComputeMGLevel(*A.Ac,*A.mgData->rc, *A.mgData->xc, level+1, (CoarseAgglomeration *) A.mgData->optimizationData);  if (ierr!=0) return ierr;
+    tsub = mytimer() - t1;
+    ierr = ComputeProlongation_ref(A, x);  if (ierr!=0) return ierr;
+    int numberOfPostsmootherSteps = A.mgData->numberOfPostsmootherSteps;
+    t1 = mytimer();
+    for (int i=0; i< numberOfPostsmootherSteps; ++i) ierr += ComputeSYMGS(A, r, x);
+    tsymgs += mytimer() - t1;
+    if (ierr!=0) return ierr;
+  }
+  else {
+    t1 = mytimer();
+    if (agglomeration!=0)
+      ierr = ComputeSYMGSAgglomerated(A, r, x, *agglomeration);
+    else
+      ierr = ComputeSYMGS(A, r, x);
+    tsymgs += mytimer() - t1;
+    if (ierr!=0) return ierr;
+  }
+  mgLevelTimes[level] += mytimer() - t0 - tsub;
+  mgSymgsTimes[level] += tsymgs;
+  return 0;
+}
+
+/*!
+  Same V-cycle as ComputeMG_ref, but smoothing with ComputeSYMGS, which uses the level schedules
+  set up by OptimizeProblem.  Without them ComputeSYMGS falls back to the reference sweep, which
+  gives the same cycle as ComputeMG_ref.  A coarsest grid gathered by AgglomerateCoarseProblem is
+  smoothed on rank 0 instead.  The time of each level is accumulated for the roofline
+  report (see GetMGLevelTimes).
+
   @param[in] A the known system matrix
   @param[in] r the input vector
   @param[inout] x On exit contains the result of the multigrid V-cycle with r as the RHS, x is the approximation to Ax = r.
@@ -32,7 +121,9 @@
 */
 int ComputeMG(const SparseMatrix  & A, const Vector & r, Vector & x) {
 
-  // This line and the next two lines should be removed and your version of ComputeSYMGS should be used.
-  A.isMgOptimized = false;
-  return ComputeMG_ref(A, r, x);
+  if (A.optimizationData==0) A.isMgOptimized = false;
+
+  assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
+
+  return ComputeMGLevel(A, r, x, 0, 0);
 }
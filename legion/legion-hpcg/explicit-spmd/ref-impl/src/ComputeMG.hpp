@@ -18,5 +18,7 @@
 #include "Vector.hpp"
 
 int ComputeMG(const SparseMatrix  & A, const Vector & r, Vector & x);
+void ResetMGLevelTimes();
+void GetMGLevelTimes(int numberOfMgLevels, double * levelTimes, double * symgsTimes);
 
 #endif // COMPUTEMG_HPP
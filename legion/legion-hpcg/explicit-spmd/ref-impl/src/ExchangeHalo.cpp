@@ -24,87 +24,118 @@
 #include "Geometry.hpp"
 #include "ExchangeHalo.hpp"
 #include <cstdlib>
+#include <cstring>
+
+#ifndef HPCG_NO_OPENMP
+#include <omp.h>
+#endif
 
 /*!
-  Communicates data that is at the border of the part of the domain assigned to this processor.
+  Creates the persistent requests used by BeginExchangeHalo and EndExchangeHalo.
 
-  @param[in]    A The known system matrix
-  @param[inout] x On entry: the local vector entries followed by entries to be communicated; on exit: the vector with non-local entries updated by other processors
- */
-void ExchangeHalo(const SparseMatrix & A, Vector & x) {
+  The receives are bound to A.receiveBuffer and the sends to A.sendBuffer, so the same requests
+  serve every vector that is exchanged with this matrix.
 
-  // Extract Matrix pieces
+  @param[inout] A The known system matrix; on exit A.receiveBuffer and A.haloRequests are allocated
+
+  @see SetupHalo_ref
+ */
+void SetupExchangeHalo(SparseMatrix & A) {
 
-  local_int_t localNumberOfRows = A.localNumberOfRows;
   int num_neighbors = A.numberOfSendNeighbors;
   local_int_t * receiveLength = A.receiveLength;
   local_int_t * sendLength = A.sendLength;
   int * neighbors = A.neighbors;
-  double * sendBuffer = A.sendBuffer;
-  local_int_t totalToBeSent = A.totalToBeSent;
-  local_int_t * elementsToSend = A.elementsToSend;
-
-  double * const xv = x.values;
-
-  int size, rank; // Number of MPI processes, My process ID
-  MPI_Comm_size(MPI_COMM_WORLD, &size);
-  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
-
-  //
-  //  first post receives, these are immediate receives
-  //  Do not wait for result to come, will do that at the
-  //  wait call below.
-  //
 
   int MPI_MY_TAG = 99;
 
-  MPI_Request * request = new MPI_Request[num_neighbors];
+  A.receiveBuffer = new double[A.numberOfExternalValues];
+  A.haloRequests = new MPI_Request[2*num_neighbors];
 
-  //
-  // Externals are at end of locals
-  //
-  double * x_external = (double *) xv + localNumberOfRows;
-
-  // Post receives first
-  // TODO: Thread this loop
+  // Receives first, then sends, so that MPI_Startall posts the receives before any send.
+  double * receiveBuffer = A.receiveBuffer;
   for (int i = 0; i < num_neighbors; i++) {
     local_int_t n_recv = receiveLength[i];
-    MPI_Irecv(x_external, n_recv, MPI_DOUBLE, neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, request+i);
-    x_external += n_recv;
+    MPI_Recv_init(receiveBuffer, n_recv, MPI_DOUBLE, neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, A.haloRequests+i);
+    receiveBuffer += n_recv;
+  }
+  double * sendBuffer = A.sendBuffer;
+  for (int i = 0; i < num_neighbors; i++) {
+    local_int_t n_send = sendLength[i];
+    MPI_Send_init(sendBuffer, n_send, MPI_DOUBLE, neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD, A.haloRequests+num_neighbors+i);
+    sendBuffer += n_send;
   }
 
+  return;
+}
+
+/*!
+  Starts the exchange of the data at the border of the part of the domain assigned to this processor.
+
+  Packs the send buffer and starts all persistent receives and sends. The external entries of x
+  must not be read until the matching call to EndExchangeHalo.
+
+  @param[in] A The known system matrix
+  @param[in] x The vector whose local entries are sent
+
+  @see EndExchangeHalo
+ */
+void BeginExchangeHalo(const SparseMatrix & A, const Vector & x) {
+
+  double * sendBuffer = A.sendBuffer;
+  local_int_t totalToBeSent = A.totalToBeSent;
+  local_int_t * elementsToSend = A.elementsToSend;
+
+  const double * const xv = x.values;
 
   //
   // Fill up send buffer
   //
 
-  // TODO: Thread this loop
+#ifndef HPCG_NO_OPENMP
+  #pragma omp parallel for
+#endif
   for (local_int_t i=0; i<totalToBeSent; i++) sendBuffer[i] = xv[elementsToSend[i]];
 
-  //
-  // Send to each neighbor
-  //
+  if (MPI_Startall(2*A.numberOfSendNeighbors, A.haloRequests)) {
+    std::exit(-1); // TODO: have better error exit
+  }
 
-  // TODO: Thread this loop
-  for (int i = 0; i < num_neighbors; i++) {
-    local_int_t n_send = sendLength[i];
-    MPI_Send(sendBuffer, n_send, MPI_DOUBLE, neighbors[i], MPI_MY_TAG, MPI_COMM_WORLD);
-    sendBuffer += n_send;
+  return;
+}
+
+/*!
+  Completes the exchange started by BeginExchangeHalo.
+
+  @param[in]    A The known system matrix
+  @param[inout] x On exit: the vector with non-local entries updated by other processors
+
+  @see BeginExchangeHalo
+ */
+void EndExchangeHalo(const SparseMatrix & A, Vector & x) {
+
+  if (MPI_Waitall(2*A.numberOfSendNeighbors, A.haloRequests, MPI_STATUSES_IGNORE)) {
+    std::exit(-1); // TODO: have better error exit
   }
 
   //
-  // Complete the reads issued above
+  // Externals are at end of locals
   //
+  std::memcpy(x.values + A.localNumberOfRows, A.receiveBuffer, sizeof(double)*A.numberOfExternalValues);
 
-  MPI_Status status;
-  // TODO: Thread this loop
-  for (int i = 0; i < num_neighbors; i++) {
-    if ( MPI_Wait(request+i, &status) ) {
-      std::exit(-1); // TODO: have better error exit
-    }
-  }
+  return;
+}
+
+/*!
+  Communicates data that is at the border of the part of the domain assigned to this processor.
+
+  @param[in]    A The known system matrix
+  @param[inout] x On entry: the local vector entries followed by entries to be communicated; on exit: the vector with non-local entries updated by other processors
+ */
+void ExchangeHalo(const SparseMatrix & A, Vector & x) {
 
-  delete [] request;
+  BeginExchangeHalo(A, x);
+  EndExchangeHalo(A, x);
 
   return;
 }
@@ -16,5 +16,8 @@
 #define EXCHANGEHALO_HPP
 #include "SparseMatrix.hpp"
 #include "Vector.hpp"
+void SetupExchangeHalo(SparseMatrix & A);
+void BeginExchangeHalo(const SparseMatrix & A, const Vector & x);
+void EndExchangeHalo(const SparseMatrix & A, Vector & x);
 void ExchangeHalo(const SparseMatrix & A, Vector & x);
 #endif // EXCHANGEHALO_HPP
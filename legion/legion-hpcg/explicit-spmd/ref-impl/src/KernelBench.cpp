@@ -0,0 +1,113 @@
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+/*!
+ @file KernelBench.cpp
+
+ HPCG routine
+ */
+
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
+
+#include <iostream>
+#include "KernelBench.hpp"
+#include "ComputeSPMV.hpp"
+#include "ComputeSYMGS.hpp"
+#include "ComputeDotProduct.hpp"
+#include "ComputeWAXPBY.hpp"
+#include "mytimer.hpp"
+// Work model and report shared with legion-xhpcg
+#include "../../KernelBench.hpp"
+
+// Waits for all processes, then returns the time
+static double KernelBenchTimer(void) {
+#ifndef HPCG_NO_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+  return mytimer();
+}
+
+/*!
+  Runs SPMV, SYMGS, DDOT and WAXPBY in isolation, numberOfCalls times each, on the generated
+  right hand side and exact solution, and reports them as legion-xhpcg --kernel-bench does
+  (see KernelBench.hpp in explicit-spmd).
+
+  @param[in]    A             The known system matrix, after OptimizeProblem
+  @param[inout] data          The CG vectors, used as kernel outputs
+  @param[in]    b             The generated right hand side vector
+  @param[in]    xexact        The generated exact solution
+  @param[in]    numberOfCalls Number of calls of each kernel
+
+  @return Returns 0 upon success and non-zero otherwise.
+*/
+int KernelBench(const SparseMatrix & A, CGData & data, const Vector & b, const Vector & xexact, int numberOfCalls) {
+
+  const local_int_t nrow = A.localNumberOfRows;
+  Vector & p = data.p;
+  Vector & Ap = data.Ap;
+  Vector & z = data.z;
+  Vector & r = data.r;
+
+  KernelBenchResult results[KERNEL_BENCH_N];
+  double t0 = 0.0, result = 0.0, t_allreduce = 0.0;
+  int ierr = 0;
+
+  CopyVector(b, p);
+  t0 = KernelBenchTimer();
+  for (int i=0; i< numberOfCalls; ++i) ierr += ComputeSPMV(A, p, Ap);
+  results[KERNEL_BENCH_SPMV].seconds = KernelBenchTimer() - t0;
+
+  ZeroVector(z);
+  t0 = KernelBenchTimer();
+  for (int i=0; i< numberOfCalls; ++i) ierr += ComputeSYMGS(A, b, z);
+  results[KERNEL_BENCH_SYMGS].seconds = KernelBenchTimer() - t0;
+
+  t0 = KernelBenchTimer();
+  for (int i=0; i< numberOfCalls; ++i) ierr += ComputeDotProduct(nrow, b, xexact, result, t_allreduce, A.isDotProductOptimized);
+  results[KERNEL_BENCH_DDOT].seconds = KernelBenchTimer() - t0;
+  results[KERNEL_BENCH_DDOT].checksum = result;
+
+  t0 = KernelBenchTimer();
+  for (int i=0; i< numberOfCalls; ++i) ierr += ComputeWAXPBY(nrow, 1.0, b, 0.5, xexact, r, A.isWaxpbyOptimized);
+  results[KERNEL_BENCH_WAXPBY].seconds = KernelBenchTimer() - t0;
+
+  // Checksums of the outputs, to confirm both runtimes computed the same thing
+  ierr += ComputeDotProduct(nrow, Ap, Ap, results[KERNEL_BENCH_SPMV].checksum, t_allreduce, A.isDotProductOptimized);
+  ierr += ComputeDotProduct(nrow, z, z, results[KERNEL_BENCH_SYMGS].checksum, t_allreduce, A.isDotProductOptimized);
+  ierr += ComputeDotProduct(nrow, r, r, results[KERNEL_BENCH_WAXPBY].checksum, t_allreduce, A.isDotProductOptimized);
+
+  // Report the slowest process
+#ifndef HPCG_NO_MPI
+  for (int k=0; k<KERNEL_BENCH_N; ++k) {
+    double localSeconds = results[k].seconds;
+    MPI_Allreduce(&localSeconds, &results[k].seconds, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  }
+#endif
+  KernelBenchModel(A.totalNumberOfRows, A.totalNumberOfNonzeros, results);
+
+  if (A.geom->rank==0) {
+    for (int k=0; k<KERNEL_BENCH_N; ++k) {
+      const double perCall = results[k].seconds/numberOfCalls;
+      std::cout << "--> Kernel " << KernelBenchNames[k] << ": " << perCall << " s/call, "
+          << results[k].flops/perCall/1.0E9 << " GFLOP/s, "
+          << results[k].bytes/perCall/1.0E9 << " GB/s, checksum " << results[k].checksum << std::endl;
+    }
+    if (! WriteKernelBenchYAML(KERNEL_BENCH_YAML, "ref", A.geom->size, A.geom->nx, A.geom->ny, A.geom->nz, numberOfCalls, results)) {
+      std::cerr << "Cannot write " << KERNEL_BENCH_YAML << std::endl;
+      ++ierr;
+    }
+  }
+  return ierr;
+}
@@ -0,0 +1,21 @@
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+#ifndef KERNELBENCH_HPP
+#define KERNELBENCH_HPP
+#include "SparseMatrix.hpp"
+#include "Vector.hpp"
+#include "CGData.hpp"
+
+int KernelBench(const SparseMatrix & A, CGData & data, const Vector & b, const Vector & xexact, int numberOfCalls);
+#endif // KERNELBENCH_HPP
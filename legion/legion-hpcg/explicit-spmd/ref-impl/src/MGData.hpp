@@ -54,6 +54,7 @@ inline void InitializeMGData(local_int_t * f2cOperator, Vector * rc, Vector * xc
   data.rc = rc;
   data.xc = xc;
   data.Axf = Axf;
+  data.optimizationData = 0;
   return;
 }
 
@@ -19,6 +19,58 @@
  */
 
 #include "OptimizeProblem.hpp"
+#include "AgglomerateCoarseProblem.hpp"
+#include <vector>
+
+#ifndef HPCG_NO_OPENMP
+/*!
+  Computes the level schedule of one Gauss-Seidel sweep of A.
+
+  The level of a row is one more than the highest level of the local rows it reads that the
+  sweep updates before it (lower columns in the forward sweep, upper ones in the back sweep).
+  External columns are not updated by the sweep and impose no ordering.  Since the matrix
+  structure is symmetric, a row that is updated later than row i and read by it is also the
+  one that reads row i, so it lands in a later level and still sees the old value of row i.
+
+  @param[in]  A              The known system matrix
+  @param[in]  forward        True for the forward sweep, false for the back sweep
+  @param[out] numberOfLevels The number of levels
+  @param[out] levelStart     Offsets of the levels in rows (numberOfLevels+1 entries)
+  @param[out] rows           The local rows grouped by level, in ascending order within a level
+*/
+static void ComputeSweepLevels(const SparseMatrix & A, bool forward, int & numberOfLevels, local_int_t *& levelStart, local_int_t *& rows) {
+
+  const local_int_t nrow = A.localNumberOfRows;
+  std::vector<int> level(nrow, 0);
+  numberOfLevels = nrow>0 ? 1 : 0;
+
+  for (local_int_t k=0; k< nrow; k++) {
+    const local_int_t i = forward ? k : nrow-1-k;
+    const local_int_t * const currentColIndices = A.mtxIndL[i];
+    const int currentNumberOfNonzeros = A.nonzerosInRow[i];
+    for (int j=0; j< currentNumberOfNonzeros; j++) {
+      local_int_t curCol = currentColIndices[j];
+      if (curCol>=nrow) continue; // External value
+      if ((forward && curCol<i) || (!forward && curCol>i))
+        if (level[curCol]+1>level[i]) level[i] = level[curCol]+1;
+    }
+    if (level[i]+1>numberOfLevels) numberOfLevels = level[i]+1;
+  }
+
+  // Counting sort of the rows by level
+  levelStart = new local_int_t[numberOfLevels+1];
+  for (int l=0; l<=numberOfLevels; l++) levelStart[l] = 0;
+  for (local_int_t i=0; i< nrow; i++) levelStart[level[i]+1]++;
+  for (int l=0; l<numberOfLevels; l++) levelStart[l+1] += levelStart[l];
+
+  rows = new local_int_t[nrow];
+  std::vector<local_int_t> next(levelStart, levelStart+numberOfLevels);
+  for (local_int_t i=0; i< nrow; i++) rows[next[level[i]]++] = i;
+
+  return;
+}
+#endif
+
 /*!
   Optimizes the data structures used for CG iteration to increase the
   performance of the benchmark version of the preconditioned CG algorithm.
@@ -37,7 +89,7 @@
 int OptimizeProblem(SparseMatrix & A, CGData & data, Vector & b, Vector & x, Vector & xexact) {
 
   // This function can be used to completely transform any part of the data structures.
-  // Right now it does nothing, so compiling with a check for unused variables results in complaints
+  // With OpenMP it computes the level schedules used by ComputeSYMGS on every grid level.
 
 #if defined(HPCG_USE_MULTICOLORING)
   const local_int_t nrow = A.localNumberOfRows;
@@ -95,12 +147,49 @@ int OptimizeProblem(SparseMatrix & A, CGData & data, Vector & b, Vector & x, Vec
     colors[i] = counters[colors[i]]++;
 #endif
 
+#ifndef HPCG_NO_OPENMP
+  for (SparseMatrix * curLevelMatrix = &A; curLevelMatrix!=0; curLevelMatrix = curLevelMatrix->Ac) {
+    if (curLevelMatrix->optimizationData!=0) continue; // Already optimized
+    SYMGSLevels * levels = new SYMGSLevels;
+    ComputeSweepLevels(*curLevelMatrix, true, levels->numberOfForwardLevels, levels->forwardLevelStart, levels->forwardRows);
+    ComputeSweepLevels(*curLevelMatrix, false, levels->numberOfBackwardLevels, levels->backwardLevelStart, levels->backwardRows);
+    curLevelMatrix->optimizationData = levels;
+  }
+#endif
+
   return 0;
 }
 
 // Helper function (see OptimizeProblem.hpp for details)
 double OptimizeProblemMemoryUse(const SparseMatrix & A) {
 
-  return 0.0;
+  double fnbytes = 0.0;
+  for (const SparseMatrix * curLevelMatrix = &A; curLevelMatrix!=0; curLevelMatrix = curLevelMatrix->Ac) {
+    const SYMGSLevels * levels = (const SYMGSLevels *) curLevelMatrix->optimizationData;
+    if (levels==0) continue;
+    fnbytes += sizeof(SYMGSLevels);
+    fnbytes += ((double) sizeof(local_int_t))*(levels->numberOfForwardLevels+1 + levels->numberOfBackwardLevels+1);
+    fnbytes += ((double) sizeof(local_int_t))*2*curLevelMatrix->localNumberOfRows;
+  }
+  fnbytes += AgglomerationMemoryUse(A);
+  return fnbytes;
+
+}
 
+// Helper function (see OptimizeProblem.hpp for details)
+void DeleteOptimizationData(SparseMatrix & A) {
+
+  DeleteAgglomeration(A);
+
+  for (SparseMatrix * curLevelMatrix = &A; curLevelMatrix!=0; curLevelMatrix = curLevelMatrix->Ac) {
+    SYMGSLevels * levels = (SYMGSLevels *) curLevelMatrix->optimizationData;
+    if (levels==0) continue;
+    delete [] levels->forwardLevelStart;
+    delete [] levels->forwardRows;
+    delete [] levels->backwardLevelStart;
+    delete [] levels->backwardRows;
+    delete levels;
+    curLevelMatrix->optimizationData = 0;
+  }
+  return;
 }
@@ -19,6 +19,23 @@
 #include "Vector.hpp"
 #include "CGData.hpp"
 
+/*!
+  Level schedule of the Gauss-Seidel sweeps, stored in SparseMatrix::optimizationData.
+
+  Rows in the same level do not depend on each other within a sweep, so each level can be
+  processed in parallel.  Levels are processed in order, which keeps the result of the
+  sequential sweep.  Row k of level l is rows[levelStart[l]+k].
+ */
+struct SYMGSLevels_STRUCT {
+  int numberOfForwardLevels; //!< number of levels of the forward sweep
+  local_int_t * forwardLevelStart; //!< offsets of the forward levels in forwardRows (numberOfForwardLevels+1 entries)
+  local_int_t * forwardRows; //!< rows of the forward sweep, grouped by level
+  int numberOfBackwardLevels; //!< number of levels of the back sweep
+  local_int_t * backwardLevelStart; //!< offsets of the back sweep levels in backwardRows (numberOfBackwardLevels+1 entries)
+  local_int_t * backwardRows; //!< rows of the back sweep, grouped by level
+};
+typedef struct SYMGSLevels_STRUCT SYMGSLevels;
+
 int OptimizeProblem(SparseMatrix & A, CGData & data,  Vector & b, Vector & x, Vector & xexact);
 
 // This helper function should be implemented in a non-trivial way if OptimizeProblem is non-trivial
@@ -27,4 +44,8 @@ int OptimizeProblem(SparseMatrix & A, CGData & data,  Vector & b, Vector & x, Ve
 
 double OptimizeProblemMemoryUse(const SparseMatrix & A);
 
+// Frees what OptimizeProblem and AgglomerateCoarseProblem attached to A and its coarse grids.  Call before DeleteMatrix.
+
+void DeleteOptimizationData(SparseMatrix & A);
+
 #endif  // OPTIMIZEPROBLEM_HPP
@@ -0,0 +1,245 @@
+
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+
+/*!
+ @file ReadProblem.cpp
+
+ HPCG routine
+ */
+
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
+
+#include <cstdio>
+#include <climits>
+#include <vector>
+#include "ReadProblem.hpp"
+#include "WriteProblem.hpp"
+#ifndef HPCG_NO_MPI
+#include "ExchangeHalo.hpp"
+#endif
+
+#ifndef HPCG_NO_MPI
+typedef MPI_File ProblemFile;
+#else
+typedef FILE * ProblemFile;
+#endif
+
+// Opens the problem file for reading (collective with MPI).  Returns 0 upon success.
+static int OpenProblemFile(const char * filename, ProblemFile & f) {
+#ifndef HPCG_NO_MPI
+  return MPI_File_open(MPI_COMM_WORLD, (char *) filename, MPI_MODE_RDONLY, MPI_INFO_NULL, &f)==MPI_SUCCESS ? 0 : -1;
+#else
+  f = fopen(filename, "rb");
+  return f ? 0 : -1;
+#endif
+}
+
+// Reads count bytes at offset (collective with MPI).  Returns 0 upon success.
+static int ReadProblemFile(ProblemFile f, long long offset, void * buffer, long long count) {
+  if (count>INT_MAX) return -1; // One read call per process
+#ifndef HPCG_NO_MPI
+  MPI_Status status;
+  int nread = 0;
+  if (MPI_File_read_at_all(f, offset, buffer, (int) count, MPI_BYTE, &status)!=MPI_SUCCESS) return -1;
+  MPI_Get_count(&status, MPI_BYTE, &nread);
+  return nread==count ? 0 : -1;
+#else
+  if (fseek(f, offset, SEEK_SET)) return -1;
+  return fread(buffer, 1, count, f)==(size_t) count ? 0 : -1;
+#endif
+}
+
+static void CloseProblemFile(ProblemFile & f) {
+#ifndef HPCG_NO_MPI
+  MPI_File_close(&f);
+#else
+  fclose(f);
+#endif
+}
+
+// Reads and checks the file header.  Returns 0 upon success.
+static int ReadProblemFileHeader(ProblemFile f, int size, ProblemFileHeader & header) {
+  if (ReadProblemFile(f, 0, &header, sizeof(header))) return -1;
+  if (std::memcmp(header.magic, HPCG_PROBLEM_FILE_MAGIC, sizeof(header.magic))) return -1;
+  if (header.localIntSize!=sizeof(local_int_t) || header.globalIntSize!=sizeof(global_int_t)) return -1;
+  if (header.size!=size) return -1; // One block per process
+  return 0;
+}
+
+/*!
+  Reads the local grid dimensions from a problem file written by WriteProblemBinary.
+
+  Use them to generate the geometry before calling ReadProblem.
+
+  @param[in]  filename   The file to read
+  @param[in]  size       Number of MPI processes, which must match the number of blocks in the file
+  @param[out] nx, ny, nz Number of grid points for each local block in the x, y, and z dimensions
+
+  @return Returns 0 upon success and -1 if the file cannot be read or does not match this run.
+
+  @see ReadProblem
+*/
+int ReadProblemHeader(const char * filename, int size, int & nx, int & ny, int & nz) {
+
+  ProblemFile f;
+  if (OpenProblemFile(filename, f)) return -1;
+  ProblemFileHeader header;
+  int ierr = ReadProblemFileHeader(f, size, header);
+  CloseProblemFile(f);
+  if (ierr) return ierr;
+
+  nx = header.nx;
+  ny = header.ny;
+  nz = header.nz;
+  return 0;
+}
+
+/*!
+  Loads a problem written by WriteProblemBinary in place of GenerateProblem and SetupHalo.
+
+  Every process reads its own block, found through the offset table, with one collective
+  MPI-IO read.  The matrix must match the geometry in A.geom, since the coarse grids are
+  still generated from it.
+
+  @param[in]    filename The file to read
+  @param[inout] A        The known system matrix, initialized with the geometry of this run
+  @param[inout] b        The newly allocated right hand side vector (if b!=0 on entry)
+  @param[inout] x        The newly allocated initial guess (if x!=0 on entry)
+  @param[inout] xexact   The newly allocated exact solution (if xexact!=0 on entry)
+
+  @return Returns 0 upon success and -1 on any process if the file cannot be read or does not match this run.
+
+  @see ReadProblemHeader
+  @see WriteProblemBinary
+*/
+int ReadProblem(const char * filename, SparseMatrix & A, Vector * b, Vector * x, Vector * xexact) {
+
+  const Geometry & geom = *A.geom;
+
+  ProblemFile f;
+  if (OpenProblemFile(filename, f)) return -1;
+  ProblemFileHeader header;
+  long long offsets[2] = {0, 0};
+  int ierr = ReadProblemFileHeader(f, geom.size, header);
+  if (ierr==0 && (header.npx!=geom.npx || header.npy!=geom.npy || header.npz!=geom.npz ||
+      header.nx!=geom.nx || header.ny!=geom.ny || header.nz!=geom.nz)) ierr = -1;
+  // Keep the collective reads matched on all processes, even after an error
+  if (ReadProblemFile(f, sizeof(header) + sizeof(long long)*geom.rank, offsets, sizeof(offsets))) ierr = -1;
+  std::vector<char> block(ierr ? 1 : offsets[1]-offsets[0]);
+  if (ReadProblemFile(f, ierr ? 0 : offsets[0], &block[0], ierr ? 0 : block.size())) ierr = -1;
+  CloseProblemFile(f);
+
+  local_int_t counts[4] = {0, 0, 0, 0};
+  int gridAndNeighbors[4] = {0, 0, 0, 0};
+  local_int_t haloCounts[2] = {0, 0};
+  const char * pos = &block[0];
+  if (ierr==0) {
+    ExtractFromBlock(pos, counts, 4);
+    ExtractFromBlock(pos, gridAndNeighbors, 4);
+    ExtractFromBlock(pos, haloCounts, 2);
+#ifdef HPCG_NO_MPI
+    if (gridAndNeighbors[3]!=0) ierr = -1; // Halo data needs MPI
+#endif
+    if (counts[0]!=geom.nx*geom.ny*geom.nz || gridAndNeighbors[0]!=geom.ipx ||
+        gridAndNeighbors[1]!=geom.ipy || gridAndNeighbors[2]!=geom.ipz) ierr = -1;
+    // The block must hold exactly the arrays described by its counts (see WriteProblemBinary)
+    long long expectedSize = sizeof(counts) + sizeof(gridAndNeighbors) + sizeof(haloCounts);
+    expectedSize += ((long long) counts[0])*(sizeof(char) + 2*sizeof(local_int_t) + sizeof(global_int_t) + 3*sizeof(double));
+    expectedSize += ((long long) counts[2])*(sizeof(global_int_t) + sizeof(local_int_t) + sizeof(double));
+    expectedSize += ((long long) gridAndNeighbors[3])*(sizeof(int) + 2*sizeof(local_int_t));
+    expectedSize += ((long long) haloCounts[0])*sizeof(local_int_t);
+    if (expectedSize!=(long long) block.size()) ierr = -1;
+    long long numberOfNonzeros = 0;
+    for (local_int_t i=0; ierr==0 && i< counts[0]; ++i) numberOfNonzeros += pos[i]; // nonzerosInRow comes next
+    if (ierr==0 && numberOfNonzeros!=counts[2]) ierr = -1;
+  }
+#ifndef HPCG_NO_MPI
+  int localErr = ierr;
+  MPI_Allreduce(&localErr, &ierr, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+#endif
+  if (ierr) return ierr;
+
+  const local_int_t localNumberOfRows = counts[0];
+
+  A.totalNumberOfRows = header.totalNumberOfRows;
+  A.totalNumberOfNonzeros = header.totalNumberOfNonzeros;
+  A.localNumberOfRows = localNumberOfRows;
+  A.localNumberOfColumns = counts[1];
+  A.localNumberOfNonzeros = counts[2];
+
+  char * nonzerosInRow = new char[localNumberOfRows];
+  global_int_t ** mtxIndG = new global_int_t*[localNumberOfRows];
+  local_int_t  ** mtxIndL = new local_int_t*[localNumberOfRows];
+  double ** matrixValues = new double*[localNumberOfRows];
+  double ** matrixDiagonal = new double*[localNumberOfRows];
+  std::vector<local_int_t> diagonalIndex(localNumberOfRows);
+
+  ExtractFromBlock(pos, nonzerosInRow, localNumberOfRows);
+  ExtractFromBlock(pos, &diagonalIndex[0], localNumberOfRows);
+  A.localToGlobalMap.resize(localNumberOfRows);
+  ExtractFromBlock(pos, &A.localToGlobalMap[0], localNumberOfRows);
+  for (local_int_t i=0; i< localNumberOfRows; ++i) {
+    A.globalToLocalMap[A.localToGlobalMap[i]] = i;
+    mtxIndG[i] = new global_int_t[nonzerosInRow[i]];
+    mtxIndL[i] = new local_int_t[nonzerosInRow[i]];
+    matrixValues[i] = new double[nonzerosInRow[i]];
+  }
+  for (local_int_t i=0; i< localNumberOfRows; ++i) ExtractFromBlock(pos, mtxIndG[i], nonzerosInRow[i]);
+  for (local_int_t i=0; i< localNumberOfRows; ++i) ExtractFromBlock(pos, mtxIndL[i], nonzerosInRow[i]);
+  for (local_int_t i=0; i< localNumberOfRows; ++i) {
+    ExtractFromBlock(pos, matrixValues[i], nonzerosInRow[i]);
+    matrixDiagonal[i] = matrixValues[i] + diagonalIndex[i];
+  }
+
+  A.nonzerosInRow = nonzerosInRow;
+  A.mtxIndG = mtxIndG;
+  A.mtxIndL = mtxIndL;
+  A.matrixValues = matrixValues;
+  A.matrixDiagonal = matrixDiagonal;
+
+#ifndef HPCG_NO_MPI
+  // Halo data as SetupHalo_ref would have built it
+  int numberOfSendNeighbors = gridAndNeighbors[3];
+  A.numberOfExternalValues = counts[3];
+  A.numberOfSendNeighbors = numberOfSendNeighbors;
+  A.totalToBeSent = haloCounts[0];
+  A.numberOfInteriorRows = haloCounts[1];
+  A.neighbors = new int[numberOfSendNeighbors];
+  A.receiveLength = new local_int_t[numberOfSendNeighbors];
+  A.sendLength = new local_int_t[numberOfSendNeighbors];
+  A.elementsToSend = new local_int_t[A.totalToBeSent];
+  A.sendBuffer = new double[A.totalToBeSent];
+  A.overlapRowOrder = new local_int_t[localNumberOfRows];
+  ExtractFromBlock(pos, A.neighbors, numberOfSendNeighbors);
+  ExtractFromBlock(pos, A.receiveLength, numberOfSendNeighbors);
+  ExtractFromBlock(pos, A.sendLength, numberOfSendNeighbors);
+  ExtractFromBlock(pos, A.elementsToSend, A.totalToBeSent);
+  ExtractFromBlock(pos, A.overlapRowOrder, localNumberOfRows);
+  SetupExchangeHalo(A);
+#else
+  pos += sizeof(local_int_t)*localNumberOfRows; // overlapRowOrder is only used with MPI
+#endif
+
+  Vector * vectors[3] = {b, x, xexact};
+  for (int k=0; k<3; ++k) {
+    if (vectors[k]!=0) {
+      InitializeVector(*vectors[k], localNumberOfRows);
+      ExtractFromBlock(pos, vectors[k]->values, localNumberOfRows);
+    } else
+      pos += sizeof(double)*localNumberOfRows;
+  }
+
+  return 0;
+}
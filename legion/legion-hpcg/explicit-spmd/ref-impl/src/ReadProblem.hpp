@@ -0,0 +1,22 @@
+//@HEADER
+// ***************************************************
+//
+// HPCG: High Performance Conjugate Gradient Benchmark
+//
+// Contact:
+// Michael A. Heroux ( maherou@sandia.gov)
+// Jack Dongarra     (dongarra@eecs.utk.edu)
+// Piotr Luszczek    (luszczek@eecs.utk.edu)
+//
+// ***************************************************
+//@HEADER
+
+#ifndef READPROBLEM_HPP
+#define READPROBLEM_HPP
+#include "Geometry.hpp"
+#include "SparseMatrix.hpp"
+#include "Vector.hpp"
+
+int ReadProblemHeader(const char * filename, int size, int & nx, int & ny, int & nz);
+int ReadProblem(const char * filename, SparseMatrix & A, Vector * b, Vector * x, Vector * xexact);
+#endif // READPROBLEM_HPP
@@ -27,6 +27,7 @@
 #include "YAML_Element.hpp"
 #include "YAML_Doc.hpp"
 #include "OptimizeProblem.hpp"
+#include "ComputeMG.hpp"
 
 #ifdef HPCG_DEBUG
 #include <fstream>
@@ -49,11 +50,13 @@ using std::endl;
   @param[in] testsymmetry_data the data structure with the results of the CG symmetry test including pass/fail information
   @param[in] testnorms_data the data structure with the results of the CG norm test including pass/fail information
   @param[in] global_failure indicates whether a failure occured during the correctness tests of CG
+  @param[in] streamBandwidth STREAM triad bandwidth of all processes (bytes/s), 0 if not measured
 
   @see YAML_Doc
 */
 void ReportResults(const SparseMatrix & A, int numberOfMgLevels, int numberOfCgSets, int refMaxIters,int optMaxIters, double times[],
-		const TestCGData & testcg_data, const TestSymmetryData & testsymmetry_data, const TestNormsData & testnorms_data, int global_failure, bool quickPath) {
+		const TestCGData & testcg_data, const TestSymmetryData & testsymmetry_data, const TestNormsData & testnorms_data, int global_failure, bool quickPath,
+		double streamBandwidth) {
 
   double minOfficialTime = 1800; // Any official benchmark result much run at least this many seconds
 
@@ -364,6 +367,10 @@ void ReportResults(const SparseMatrix & A, int numberOfMgLevels, int numberOfCgS
     //doc.get("Sparse Operations Overheads")->add("Halo exchange time (sec)", (times[6]));
     //doc.get("Sparse Operations Overheads")->add("Halo exchange as percentage of SpMV time", (times[6])/totalSparseMVTime*100.0);
 #endif
+
+    std::vector<RooflineEntry> roofline;
+    ComputeRoofline(A, numberOfMgLevels, numberOfCgSets, optMaxIters, times, roofline);
+    AddRooflineSection(doc, streamBandwidth, roofline);
     doc.add("__________ Final Summary __________","");
     bool isValidRun = (testcg_data.count_fail==0) && (testsymmetry_data.count_fail==0) && (testnorms_data.pass) && (!global_failure);
     if (isValidRun) {
@@ -410,3 +417,35 @@ void ReportResults(const SparseMatrix & A, int numberOfMgLevels, int numberOfCgS
   }
   return;
 }
+
+/*!
+  Computes the roofline entries (flops, bytes and time of each kernel) of the timed CG sets.
+
+  @param[in]  A the known system matrix
+  @param[in]  numberOfMgLevels Number of levels in multigrid V cycle
+  @param[in]  numberOfCgSets Number of CG runs performed
+  @param[in]  optMaxIters Number of iterations of each CG run
+  @param[in]  times Vector of cumulative timings of the CG runs
+  @param[out] entries one entry per kernel, see RooflineModel
+
+  The per-level times are the ones ComputeMG accumulated since the last ResetMGLevelTimes.
+*/
+void ComputeRoofline(const SparseMatrix & A, int numberOfMgLevels, int numberOfCgSets, int optMaxIters, const double times[],
+    std::vector<RooflineEntry> & entries) {
+
+  std::vector<double> levelTimes(numberOfMgLevels), symgsTimes(numberOfMgLevels);
+  GetMGLevelTimes(numberOfMgLevels, &levelTimes[0], &symgsTimes[0]);
+
+  std::vector<RooflineLevel> levels(numberOfMgLevels);
+  const SparseMatrix * Af = &A;
+  for (int i=0; i<numberOfMgLevels; ++i) {
+    levels[i].rows = Af->totalNumberOfRows;
+    levels[i].nnz = Af->totalNumberOfNonzeros;
+    levels[i].hasCoarse = i<numberOfMgLevels-1;
+    levels[i].sweeps = levels[i].hasCoarse ? Af->mgData->numberOfPresmootherSteps+Af->mgData->numberOfPostsmootherSteps : 1;
+    levels[i].seconds = levelTimes[i];
+    levels[i].symgsSeconds = symgsTimes[i];
+    Af = Af->Ac; // Go to next coarse level
+  }
+  RooflineModel(((double) numberOfCgSets)*optMaxIters, numberOfCgSets, times, levels, entries);
+}
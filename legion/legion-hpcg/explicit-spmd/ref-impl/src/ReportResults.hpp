@@ -18,8 +18,13 @@
 #include "TestCG.hpp"
 #include "TestSymmetry.hpp"
 #include "TestNorms.hpp"
+#include "../../Roofline.hpp"
+#include <vector>
 
 void ReportResults(const SparseMatrix & A, int numberOfMgLevels, int numberOfCgSets, int refMaxIters, int optMaxIters, double times[],
-    const TestCGData & testcg_data, const TestSymmetryData & testsymmetry_data, const TestNormsData & testnorms_data, int global_failure, bool quickPath);
+    const TestCGData & testcg_data, const TestSymmetryData & testsymmetry_data, const TestNormsData & testnorms_data, int global_failure, bool quickPath,
+    double streamBandwidth);
+void ComputeRoofline(const SparseMatrix & A, int numberOfMgLevels, int numberOfCgSets, int optMaxIters, const double times[],
+    std::vector<RooflineEntry> & entries);
 
 #endif // REPORTRESULTS_HPP
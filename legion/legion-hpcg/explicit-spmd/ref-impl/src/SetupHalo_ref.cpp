@@ -37,6 +37,9 @@ using std::endl;
 
 #include "SetupHalo_ref.hpp"
 #include "mytimer.hpp"
+#ifndef HPCG_NO_MPI
+#include "ExchangeHalo.hpp"
+#endif
 
 /*!
   Reference version of SetupHalo that prepares system matrix data structure and creates data necessary
@@ -165,6 +168,24 @@ void SetupHalo_ref(SparseMatrix & A) {
   A.sendLength = sendLength;
   A.sendBuffer = sendBuffer;
 
+  // Split the rows into those that only reference local columns and those that also need
+  // external values, so that the kernels can work on the former while the halo is in flight.
+  local_int_t * overlapRowOrder = new local_int_t[localNumberOfRows];
+  std::vector<local_int_t> boundaryRows;
+  local_int_t numberOfInteriorRows = 0;
+  for (local_int_t i=0; i< localNumberOfRows; i++) {
+    bool isInterior = true;
+    for (int j=0; j<nonzerosInRow[i]; j++)
+      if (mtxIndL[i][j]>=localNumberOfRows) isInterior = false;
+    if (isInterior) overlapRowOrder[numberOfInteriorRows++] = i;
+    else boundaryRows.push_back(i);
+  }
+  for (size_t i=0; i<boundaryRows.size(); i++) overlapRowOrder[numberOfInteriorRows+i] = boundaryRows[i];
+  A.numberOfInteriorRows = numberOfInteriorRows;
+  A.overlapRowOrder = overlapRowOrder;
+
+  SetupExchangeHalo(A);
+
 #ifdef HPCG_DETAILED_DEBUG
   HPCG_fout << " For rank " << A.geom->rank << " of " << A.geom->size << ", number of neighbors = " << A.numberOfSendNeighbors << endl;
   for (int i = 0; i < A.numberOfSendNeighbors; i++) {
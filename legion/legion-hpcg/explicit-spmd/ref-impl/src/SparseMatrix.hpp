@@ -24,6 +24,9 @@
 #include <map>
 #include <vector>
 #include <cassert>
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
 #include "Geometry.hpp"
 #include "Vector.hpp"
 #include "MGData.hpp"
@@ -64,6 +67,10 @@ struct SparseMatrix_STRUCT {
   local_int_t * receiveLength; //!< lenghts of messages received from neighboring processes
   local_int_t * sendLength; //!< lenghts of messages sent to neighboring processes
   double * sendBuffer; //!< send buffer for non-blocking sends
+  double * receiveBuffer; //!< receive buffer bound to the persistent receives
+  MPI_Request * haloRequests; //!< persistent receives followed by persistent sends
+  local_int_t numberOfInteriorRows; //!< number of rows that reference no external values
+  local_int_t * overlapRowOrder; //!< interior rows followed by boundary rows, both in ascending order
 #endif
 };
 typedef struct SparseMatrix_STRUCT SparseMatrix;
@@ -86,6 +93,7 @@ inline void InitializeSparseMatrix(SparseMatrix & A, Geometry * geom) {
   A.mtxIndL = 0;
   A.matrixValues = 0;
   A.matrixDiagonal = 0;
+  A.optimizationData = 0;
 
   // Optimization is ON by default. The code that switches it OFF is in the
   // functions that are meant to be optimized.
@@ -103,6 +111,10 @@ inline void InitializeSparseMatrix(SparseMatrix & A, Geometry * geom) {
   A.receiveLength = 0;
   A.sendLength = 0;
   A.sendBuffer = 0;
+  A.receiveBuffer = 0;
+  A.haloRequests = 0;
+  A.numberOfInteriorRows = 0;
+  A.overlapRowOrder = 0;
 #endif
   A.mgData = 0; // Fine-to-coarse grid transfer initially not defined.
   A.Ac =0;
@@ -161,6 +173,12 @@ inline void DeleteMatrix(SparseMatrix & A) {
   if (A.receiveLength)            delete [] A.receiveLength;
   if (A.sendLength)            delete [] A.sendLength;
   if (A.sendBuffer)            delete [] A.sendBuffer;
+  if (A.receiveBuffer)            delete [] A.receiveBuffer;
+  if (A.haloRequests) {
+    for (int i = 0; i < 2*A.numberOfSendNeighbors; i++) MPI_Request_free(A.haloRequests+i);
+    delete [] A.haloRequests;
+  }
+  if (A.overlapRowOrder)            delete [] A.overlapRowOrder;
 #endif
 
   if (A.geom!=0) { delete A.geom; A.geom = 0;}
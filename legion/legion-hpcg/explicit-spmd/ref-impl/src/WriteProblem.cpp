@@ -18,7 +18,13 @@
  HPCG routine
  */
 
+#ifndef HPCG_NO_MPI
+#include <mpi.h>
+#endif
+
 #include <cstdio>
+#include <climits>
+#include <cassert>
 #include "WriteProblem.hpp"
 
 
@@ -90,3 +96,124 @@ int WriteProblem( const Geometry & geom, const SparseMatrix & A,
   fclose(fb);
   return 0;
 }
+
+/*!
+  Routine to dump the problem in the binary format read by ReadProblem.
+
+  Every process serializes its part of the problem into one block:
+   - local_int_t: localNumberOfRows, localNumberOfColumns, localNumberOfNonzeros, numberOfExternalValues
+   - int: ipx, ipy, ipz, numberOfSendNeighbors
+   - local_int_t: totalToBeSent, numberOfInteriorRows
+   - nonzerosInRow (char), the position of the diagonal in each row (local_int_t) and localToGlobalMap (global_int_t)
+   - mtxIndG, mtxIndL and matrixValues of all rows, one array after the other
+   - neighbors, receiveLength, sendLength, elementsToSend and overlapRowOrder
+   - b, x and xexact (localNumberOfRows values each)
+
+  Process 0 writes the header and the offset table, then all blocks are written with one
+  collective MPI-IO write.  Without MPI the same layout is written with stdio.
+
+  @param[in] filename The file to write
+  @param[in] A        The known system matrix, after SetupHalo
+  @param[in] b        The known right hand side vector
+  @param[in] x        The initial guess
+  @param[in] xexact   Generated exact solution
+
+  @return Returns 0 upon success and -1 if the file could not be written.
+
+  @see ReadProblem
+*/
+int WriteProblemBinary(const char * filename, const SparseMatrix & A, const Vector & b, const Vector & x, const Vector & xexact) {
+
+  const Geometry & geom = *A.geom;
+  const local_int_t nrow = A.localNumberOfRows;
+
+  std::vector<char> block;
+#ifndef HPCG_NO_MPI
+  local_int_t counts[4] = {nrow, A.localNumberOfColumns, A.localNumberOfNonzeros, A.numberOfExternalValues};
+  int gridAndNeighbors[4] = {geom.ipx, geom.ipy, geom.ipz, A.numberOfSendNeighbors};
+  local_int_t haloCounts[2] = {A.totalToBeSent, A.numberOfInteriorRows};
+#else
+  local_int_t counts[4] = {nrow, A.localNumberOfColumns, A.localNumberOfNonzeros, 0};
+  int gridAndNeighbors[4] = {geom.ipx, geom.ipy, geom.ipz, 0};
+  local_int_t haloCounts[2] = {0, nrow};
+#endif
+  AppendToBlock(block, counts, 4);
+  AppendToBlock(block, gridAndNeighbors, 4);
+  AppendToBlock(block, haloCounts, 2);
+
+  std::vector<local_int_t> diagonalIndex(nrow);
+  for (local_int_t i=0; i< nrow; i++) diagonalIndex[i] = A.matrixDiagonal[i] - A.matrixValues[i];
+  AppendToBlock(block, A.nonzerosInRow, nrow);
+  AppendToBlock(block, &diagonalIndex[0], nrow);
+  AppendToBlock(block, &A.localToGlobalMap[0], nrow);
+  for (local_int_t i=0; i< nrow; i++) AppendToBlock(block, A.mtxIndG[i], A.nonzerosInRow[i]);
+  for (local_int_t i=0; i< nrow; i++) AppendToBlock(block, A.mtxIndL[i], A.nonzerosInRow[i]);
+  for (local_int_t i=0; i< nrow; i++) AppendToBlock(block, A.matrixValues[i], A.nonzerosInRow[i]);
+
+#ifndef HPCG_NO_MPI
+  AppendToBlock(block, A.neighbors, A.numberOfSendNeighbors);
+  AppendToBlock(block, A.receiveLength, A.numberOfSendNeighbors);
+  AppendToBlock(block, A.sendLength, A.numberOfSendNeighbors);
+  AppendToBlock(block, A.elementsToSend, A.totalToBeSent);
+  AppendToBlock(block, A.overlapRowOrder, nrow);
+#else
+  std::vector<local_int_t> overlapRowOrder(nrow);
+  for (local_int_t i=0; i< nrow; i++) overlapRowOrder[i] = i; // No external values: all rows are interior
+  AppendToBlock(block, &overlapRowOrder[0], nrow);
+#endif
+
+  AppendToBlock(block, b.values, nrow);
+  AppendToBlock(block, x.values, nrow);
+  AppendToBlock(block, xexact.values, nrow);
+
+  // Offset table: every block follows the header, the table and the blocks of lower ranks
+  long long blockSize = block.size();
+  assert(blockSize<=INT_MAX); // One write call per process
+  std::vector<long long> blockSizes(geom.size, blockSize);
+#ifndef HPCG_NO_MPI
+  MPI_Allgather(&blockSize, 1, MPI_LONG_LONG, &blockSizes[0], 1, MPI_LONG_LONG, MPI_COMM_WORLD);
+#endif
+  std::vector<long long> offsets(geom.size+1);
+  offsets[0] = sizeof(ProblemFileHeader) + sizeof(long long)*(geom.size+1);
+  for (int i=0; i<geom.size; i++) offsets[i+1] = offsets[i] + blockSizes[i];
+
+  ProblemFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, HPCG_PROBLEM_FILE_MAGIC, sizeof(header.magic));
+  header.localIntSize = sizeof(local_int_t);
+  header.globalIntSize = sizeof(global_int_t);
+  header.size = geom.size;
+  header.npx = geom.npx;
+  header.npy = geom.npy;
+  header.npz = geom.npz;
+  header.nx = geom.nx;
+  header.ny = geom.ny;
+  header.nz = geom.nz;
+  header.totalNumberOfRows = A.totalNumberOfRows;
+  header.totalNumberOfNonzeros = A.totalNumberOfNonzeros;
+
+  int ierr = 0;
+#ifndef HPCG_NO_MPI
+  MPI_File fh;
+  if (MPI_File_open(MPI_COMM_WORLD, (char *) filename, MPI_MODE_CREATE | MPI_MODE_WRONLY, MPI_INFO_NULL, &fh)!=MPI_SUCCESS)
+    return -1;
+  MPI_File_set_size(fh, 0); // Truncate an older, longer file
+  if (geom.rank==0) {
+    if (MPI_File_write_at(fh, 0, &header, sizeof(header), MPI_BYTE, MPI_STATUS_IGNORE)!=MPI_SUCCESS) ierr = -1;
+    if (MPI_File_write_at(fh, sizeof(header), &offsets[0], geom.size+1, MPI_LONG_LONG, MPI_STATUS_IGNORE)!=MPI_SUCCESS) ierr = -1;
+  }
+  if (MPI_File_write_at_all(fh, offsets[geom.rank], &block[0], (int) blockSize, MPI_BYTE, MPI_STATUS_IGNORE)!=MPI_SUCCESS) ierr = -1;
+  MPI_File_close(&fh);
+  int localErr = ierr;
+  MPI_Allreduce(&localErr, &ierr, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+#else
+  FILE * f = fopen(filename, "wb");
+  if (! f) return -1;
+  if (fwrite(&header, sizeof(header), 1, f)!=1) ierr = -1;
+  if (fwrite(&offsets[0], sizeof(long long), geom.size+1, f)!=(size_t) geom.size+1) ierr = -1;
+  if (fwrite(&block[0], 1, blockSize, f)!=(size_t) blockSize) ierr = -1;
+  fclose(f);
+#endif
+
+  return ierr;
+}
@@ -14,8 +14,55 @@
 
 #ifndef WRITEPROBLEM_HPP
 #define WRITEPROBLEM_HPP
+#include <cstring>
+#include <vector>
 #include "Geometry.hpp"
 #include "SparseMatrix.hpp"
 
+/*!
+  Header of the binary problem file written by WriteProblemBinary and read by ReadProblem.
+
+  The header is followed by an offset table of size+1 long long entries, where entry i is the
+  byte offset of the block of rank i and entry size is the file size.  Each block holds the
+  local matrix, its halo data and b, x, xexact (see WriteProblemBinary).  All data is in the
+  native byte order of the writer.
+ */
+struct ProblemFileHeader_STRUCT {
+  char magic[8]; //!< "HPCGPRB" followed by the format version
+  int localIntSize; //!< sizeof(local_int_t) of the writer
+  int globalIntSize; //!< sizeof(global_int_t) of the writer
+  int size; //!< number of MPI processes (blocks) in the file
+  int npx; //!< Number of processors in x-direction
+  int npy; //!< Number of processors in y-direction
+  int npz; //!< Number of processors in z-direction
+  int nx; //!< Number of x-direction grid points for each local subdomain
+  int ny; //!< Number of y-direction grid points for each local subdomain
+  int nz; //!< Number of z-direction grid points for each local subdomain
+  global_int_t totalNumberOfRows; //!< total number of matrix rows across all processes
+  global_int_t totalNumberOfNonzeros; //!< total number of matrix nonzeros across all processes
+};
+typedef struct ProblemFileHeader_STRUCT ProblemFileHeader;
+
+#define HPCG_PROBLEM_FILE_MAGIC "HPCGPRB1"
+
+/*!
+  Appends n values to a problem file block.
+ */
+template<typename T>
+inline void AppendToBlock(std::vector<char> & block, const T * values, size_t n) {
+  const char * p = (const char *) values;
+  block.insert(block.end(), p, p + n*sizeof(T));
+}
+
+/*!
+  Copies n values out of a problem file block and advances pos past them.
+ */
+template<typename T>
+inline void ExtractFromBlock(const char * & pos, T * values, size_t n) {
+  std::memcpy(values, pos, n*sizeof(T));
+  pos += n*sizeof(T);
+}
+
 int WriteProblem( const Geometry & geom, const SparseMatrix & A, const Vector b, const Vector x, const Vector xexact);
+int WriteProblemBinary(const char * filename, const SparseMatrix & A, const Vector & b, const Vector & x, const Vector & xexact);
 #endif // WRITEPROBLEM_HPP
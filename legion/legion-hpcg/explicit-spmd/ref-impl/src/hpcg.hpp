@@ -33,6 +33,11 @@ struct HPCG_Params_STRUCT {
   int ny; //!< Number of y-direction grid points for each local subdomain
   int nz; //!< Number of z-direction grid points for each local subdomain
   int runningTime; //!< Number of seconds to run the timed portion of the benchmark
+  const char * readProblemFile; //!< Binary problem file to load instead of generating the problem (--read-problem=), or 0
+  const char * writeProblemFile; //!< Binary problem file to write after setup (--write-problem=), or 0
+  int kernelBenchCalls; //!< If positive, only run the kernel microbenchmark with this many calls per kernel (--kernel-bench=)
+  int streamLength; //!< Doubles per array of the startup STREAM triad probe (--stream=), 0 to skip it
+  long long agglomerateRows; //!< Gather the coarsest grid onto rank 0 if it has at most this many rows (--agglomerate=), 0 to never do it
 };
 /*!
   HPCG_Params is a shorthand for HPCG_Params_STRUCT
@@ -36,6 +36,7 @@ const char* NULLDEVICE="/dev/null";
 #include "hpcg.hpp"
 
 #include "ReadHpcgDat.hpp"
+#include "../../Roofline.hpp"
 
 std::ofstream HPCG_fout; //!< output file stream for logging activities during HPCG run
 
@@ -115,6 +116,31 @@ HPCG_Init(int * argc_p, char ** *argv_p, HPCG_Params & params) {
 
   params.runningTime = iparams[3];
 
+  // Binary problem files (see ReadProblem and WriteProblemBinary)
+  params.readProblemFile = 0;
+  params.writeProblemFile = 0;
+  params.kernelBenchCalls = 0;
+  params.streamLength = ROOFLINE_STREAM_LENGTH;
+  params.agglomerateRows = 0;
+  for (i = 1; i <= argc && argv[i]; ++i) {
+    if (startswith(argv[i], "--read-problem="))
+      params.readProblemFile = argv[i]+strlen("--read-problem=");
+    if (startswith(argv[i], "--write-problem="))
+      params.writeProblemFile = argv[i]+strlen("--write-problem=");
+    // Kernel microbenchmark mode (see KernelBench)
+    if (startswith(argv[i], "--kernel-bench="))
+      if (sscanf(argv[i]+strlen("--kernel-bench="), "%d", &params.kernelBenchCalls) != 1 || params.kernelBenchCalls < 0)
+        params.kernelBenchCalls = 0;
+    // STREAM triad probe for the roofline report (see Roofline.hpp)
+    if (startswith(argv[i], "--stream="))
+      if (sscanf(argv[i]+strlen("--stream="), "%d", &params.streamLength) != 1 || params.streamLength < 0)
+        params.streamLength = ROOFLINE_STREAM_LENGTH;
+    // Coarse grid agglomeration (see AgglomerateCoarseProblem)
+    if (startswith(argv[i], "--agglomerate="))
+      if (sscanf(argv[i]+strlen("--agglomerate="), "%lld", &params.agglomerateRows) != 1 || params.agglomerateRows < 0)
+        params.agglomerateRows = 0;
+  }
+
 #ifndef HPCG_NO_MPI
   MPI_Comm_rank( MPI_COMM_WORLD, &params.comm_rank );
   MPI_Comm_size( MPI_COMM_WORLD, &params.comm_size );
@@ -50,6 +50,7 @@ using std::endl;
 #include "mytimer.hpp"
 #include "ComputeSPMV_ref.hpp"
 #include "ComputeMG_ref.hpp"
+#include "ComputeMG.hpp"
 #include "ComputeResidual.hpp"
 #include "CG.hpp"
 #include "CG_ref.hpp"
@@ -125,6 +126,20 @@ int main(int argc, char * argv[]) {
   if (ierr)
     return ierr;
 
+  ////////////////////////////////////////////////////////////////////////////
+  // STREAM Triad Probe
+  ////////////////////////////////////////////////////////////////////////////
+  // All processes run the triad at once, so the sum is what the machine sustains
+#ifndef HPCG_NO_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+  double localStreamBandwidth = StreamTriadBandwidth(params.streamLength);
+  double streamBandwidth = localStreamBandwidth;
+#ifndef HPCG_NO_MPI
+  MPI_Allreduce(&localStreamBandwidth, &streamBandwidth, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+  if (rank==0 && params.streamLength>0) HPCG_fout << "--> STREAM triad (GB/s) = " << streamBandwidth/1.0E9 << endl;
+
   // Use this array for collecting timing information
   std::vector< double > times(10,0.0);
 
@@ -331,6 +346,7 @@ int main(int argc, char * argv[]) {
   testnorms_data.samples = numberOfCgSets;
   testnorms_data.values = new double[numberOfCgSets];
 
+  ResetMGLevelTimes(); // Only the timed sets go into the roofline report
   for (int i=0; i< numberOfCgSets; ++i) {
     ZeroVector(x); // Zero out x
     ierr = CG( A, data, b, x, optMaxIters, optTolerance, niters, normr, normr0, &times[0], true);
@@ -356,9 +372,10 @@ int main(int argc, char * argv[]) {
   ////////////////////
 
   // Report results to YAML file
-  ReportResults(A, numberOfMgLevels, numberOfCgSets, refMaxIters, optMaxIters, &times[0], testcg_data, testsymmetry_data, testnorms_data, global_failure, quickPath);
+  ReportResults(A, numberOfMgLevels, numberOfCgSets, refMaxIters, optMaxIters, &times[0], testcg_data, testsymmetry_data, testnorms_data, global_failure, quickPath, streamBandwidth);
 
   // Clean up
+  DeleteOptimizationData(A);
   DeleteMatrix(A); // This delete will recursively delete all coarse grid data
   DeleteCGData(data);
   DeleteVector(x);
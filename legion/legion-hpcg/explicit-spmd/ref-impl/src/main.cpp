@@ -45,11 +45,15 @@ using std::endl;
 #include "CheckProblem.hpp"
 #include "ExchangeHalo.hpp"
 #include "OptimizeProblem.hpp"
+#include "AgglomerateCoarseProblem.hpp"
 #include "WriteProblem.hpp"
+#include "ReadProblem.hpp"
+#include "KernelBench.hpp"
 #include "ReportResults.hpp"
 #include "mytimer.hpp"
 #include "ComputeSPMV_ref.hpp"
 #include "ComputeMG_ref.hpp"
+#include "ComputeMG.hpp"
 #include "ComputeResidual.hpp"
 #include "CG.hpp"
 #include "CG_ref.hpp"
@@ -107,6 +111,19 @@ int main(int argc, char * argv[]) {
   nz = (local_int_t)params.nz;
   int ierr = 0;  // Used to check return codes on function calls
 
+  // A loaded problem brings its own local grid
+  if (params.readProblemFile) {
+    int fnx, fny, fnz;
+    ierr = ReadProblemHeader(params.readProblemFile, size, fnx, fny, fnz);
+    if (ierr) {
+      if (rank==0) cerr << "Cannot read a problem for " << size << " processes from " << params.readProblemFile << endl;
+      return ierr;
+    }
+    nx = fnx;
+    ny = fny;
+    nz = fnz;
+  }
+
   ierr = CheckAspectRatio(0.125, nx, ny, nz, "local problem", rank==0);
   if (ierr)
     return ierr;
@@ -137,6 +154,20 @@ int main(int argc, char * argv[]) {
   if (ierr)
     return ierr;
 
+  ////////////////////////////////////////////////////////////////////////////
+  // STREAM Triad Probe
+  ////////////////////////////////////////////////////////////////////////////
+  // All processes run the triad at once, so the sum is what the machine sustains
+#ifndef HPCG_NO_MPI
+  MPI_Barrier(MPI_COMM_WORLD);
+#endif
+  double localStreamBandwidth = StreamTriadBandwidth(params.streamLength);
+  double streamBandwidth = localStreamBandwidth;
+#ifndef HPCG_NO_MPI
+  MPI_Allreduce(&localStreamBandwidth, &streamBandwidth, 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+#endif
+  if (rank==0 && params.streamLength>0) cout << "--> STREAM triad (GB/s) = " << streamBandwidth/1.0E9 << endl;
+
   // Use this array for collecting timing information
   std::vector< double > times(10,0.0);
 
@@ -146,8 +177,16 @@ int main(int argc, char * argv[]) {
   InitializeSparseMatrix(A, geom);
 
   Vector b, x, xexact;
-  GenerateProblem(A, &b, &x, &xexact);
-  SetupHalo(A);
+  if (params.readProblemFile) {
+    ierr = ReadProblem(params.readProblemFile, A, &b, &x, &xexact);
+    if (ierr) {
+      if (rank==0) cerr << "Error in call to ReadProblem: " << params.readProblemFile << endl;
+      return ierr;
+    }
+  } else {
+    GenerateProblem(A, &b, &x, &xexact);
+    SetupHalo(A);
+  }
   int numberOfMgLevels = 4; // Number of levels including first
   SparseMatrix * curLevelMatrix = &A;
   for (int level = 1; level< numberOfMgLevels; ++level) {
@@ -157,6 +196,11 @@ int main(int argc, char * argv[]) {
 
   setup_time = mytimer() - setup_time; // Capture total time of setup
   times[9] = setup_time; // Save it for reporting
+
+  if (params.writeProblemFile) {
+    ierr = WriteProblemBinary(params.writeProblemFile, A, b, x, xexact);
+    if (ierr && rank==0) cerr << "Error in call to WriteProblemBinary: " << params.writeProblemFile << endl;
+  }
   if (rank == 0) {
       cout << endl;
       cout << "*****************************************************" << endl;
@@ -177,7 +221,8 @@ int main(int argc, char * argv[]) {
   Vector * curx = &x;
   Vector * curxexact = &xexact;
   for (int level = 0; level< numberOfMgLevels; ++level) {
-     CheckProblem(*curLevelMatrix, curb, curx, curxexact);
+     // A loaded fine grid need not be the generated stencil
+     if (level>0 || ! params.readProblemFile) CheckProblem(*curLevelMatrix, curb, curx, curxexact);
      curLevelMatrix = curLevelMatrix->Ac; // Make the nextcoarse grid the next level
      curb = 0; // No vectors after the top level
      curx = 0;
@@ -188,6 +233,27 @@ int main(int argc, char * argv[]) {
   CGData data;
   InitializeSparseCGData(A, data);
 
+  ////////////////////////////////////////////////////////////////////////////
+  // Kernel Microbenchmark Mode                                             //
+  ////////////////////////////////////////////////////////////////////////////
+  if (params.kernelBenchCalls > 0) {
+    OptimizeProblem(A, data, b, x, xexact);
+    AgglomerateCoarseProblem(A, params.agglomerateRows);
+    ierr = KernelBench(A, data, b, xexact, params.kernelBenchCalls);
+    if (ierr && rank==0) cerr << "Error in call to KernelBench: " << ierr << ".\n" << endl;
+    DeleteOptimizationData(A);
+    DeleteMatrix(A);
+    DeleteCGData(data);
+    DeleteVector(x);
+    DeleteVector(b);
+    DeleteVector(xexact);
+    HPCG_Finalize();
+#ifndef HPCG_NO_MPI
+    MPI_Finalize();
+#endif
+    return ierr;
+  }
+
   ////////////////////////////////////////////////////////////////////////////
   // Reference CG Timing Phase                                              //
   ////////////////////////////////////////////////////////////////////////////
@@ -217,6 +283,13 @@ int main(int argc, char * argv[]) {
   if (rank == 0 && err_count) HPCG_fout << err_count << " error(s) in call(s) to reference CG." << endl;
   double refTolerance = normr / normr0;
 
+  // Call user-tunable set up function.
+  double t7 = mytimer();
+  OptimizeProblem(A, data, b, x, xexact);
+  AgglomerateCoarseProblem(A, params.agglomerateRows);
+  t7 = mytimer() - t7;
+  times[7] = t7;
+
 #ifdef HPCG_DETAILED_DEBUG
   if (geom->size == 1) WriteProblem(*geom, A, b, x, xexact);
 #endif
@@ -287,6 +360,7 @@ int main(int argc, char * argv[]) {
   testnorms_data.samples = numberOfCgSets;
   testnorms_data.values = new double[numberOfCgSets];
 
+  ResetMGLevelTimes(); // Only the timed sets go into the roofline report
   double optTimeStart = mytimer();
   for (int i=0; i< numberOfCgSets; ++i) {
     ZeroVector(x); // Zero out x
@@ -302,6 +376,10 @@ int main(int argc, char * argv[]) {
       std::cout << numberOfCgSets << " CG set complete in " << runTime << " s" << endl;
       cout << endl << "--> Average Run Time for CG="
            << aveRuntime << " s" << endl << endl;
+      std::vector<RooflineEntry> roofline;
+      ComputeRoofline(A, numberOfMgLevels, numberOfCgSets, optMaxIters, &times[0], roofline);
+      PrintRoofline(cout, streamBandwidth, roofline);
+      cout << endl;
   }
 
   // Compute difference between known exact solution and computed solution
@@ -316,6 +394,7 @@ int main(int argc, char * argv[]) {
       cout << "*****************************************************" << endl;
   }
   // Clean up
+  DeleteOptimizationData(A);
   DeleteMatrix(A); // This delete will recursively delete all coarse grid data
   DeleteCGData(data);
   DeleteVector(x);
@@ -15,8 +15,8 @@
 /////////////////////////////////////////////////////////////////////////
 
 // Function to return time in seconds.
-// If compiled with no flags, return CPU time (user and system).
-// If compiled with -DWALL, returns elapsed time.
+// MPI_Wtime with MPI, omp_get_wtime with OpenMP, or else the monotonic
+// clock the CODY mini-apps share.
 
 /////////////////////////////////////////////////////////////////////////
 
@@ -36,20 +36,14 @@ double mytimer(void) {
 }
 #else
 
-#include <cstdlib>
-#include <sys/time.h>
-#include <sys/resource.h>
+#include "../../../../../instrument/cody.h"
 double mytimer(void) {
-  struct timeval tp;
-  static long start=0, startu;
-  if (!start) {
-    gettimeofday(&tp, NULL);
-    start = tp.tv_sec;
-    startu = tp.tv_usec;
+  static double start = -1.0;
+  if (start < 0.0) {
+    start = cody_now();
     return 0.0;
   }
-  gettimeofday(&tp, NULL);
-  return ((double) (tp.tv_sec - start)) + (tp.tv_usec-startu)/1000000.0 ;
+  return cody_now() - start;
 }
 
 #endif
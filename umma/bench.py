@@ -0,0 +1,253 @@
+#!/usr/bin/python
+
+import argparse
+import csv
+import itertools
+import json
+import os
+import re
+import subprocess
+import sys
+
+# Benchmark harness for the UMMA versions. Every built micro-app-<layout>-
+# <backend> is run over the same graph types, sizes, thread counts, scatter
+# strategies, fused or not, gather prefetch distances and windows, and floats per point. The phase table each run prints (see
+# stack/bench.c) and its peak RSS are collected into one CSV and/or JSON
+# file, a row per phase and a 'loop' row for the whole loop. The points every
+# run prints are checked against the first run's on the same graph with as
+# many floats per point.
+
+LAYOUTS=['aos','soa','aosoa']
+BACKENDS=['serial','openmp','ispc','cuda','mpi','offload']
+
+# The scatter strategies each backend has; serial, mpi and the aosoa
+# versions have no --scatter
+SCATTERS={
+	'serial': ['atomic'],
+	'openmp': ['atomic','color','csr','private'],
+	'ispc':   ['atomic','color','csr'],
+	'cuda':   ['atomic','color','csr','warp','shared'],
+	'mpi':    ['atomic'],
+	'offload':['atomic','color'],
+}
+
+FIELDS=['layout','backend','type','npoints','nedges','nth','scatter','fused','prefetch','window','tasks','fields','rep',
+	'phase','loops','mean','min','max','sd','gbs','maxrss','maxdiff']
+
+# What runs when neither the config nor the command line says
+DEFAULTS={'layouts':LAYOUTS,'backends':['serial','openmp'],'types':['pure_random'],
+	'npoints':[10000],'nedges':[10000],'threads':[1],'scatters':['atomic'],
+	'fused':[False],'prefetch':[0],'window':[0],'tasks':[0],'fields':[3],'nloops':10,'warmup':1,'reps':1,'resident':True}
+
+def csvList(s):
+	return [v for v in s.split(',') if v]
+
+def intList(s):
+	return [int(v) for v in csvList(s)]
+
+def boolList(s):
+	return [v in ('1','true','yes') for v in csvList(s)]
+
+# The phase rows, the loop's time and the printed points of a run's output
+def parseRun(out):
+	rec={'phases':[],'points':[]}
+	cols=None
+	for line in out.splitlines():
+		f=line.split()
+		if not f:
+			continue
+		if f[0]=='Phase':
+			# the counters' names follow GB/s
+			cols=f[f.index('GB/s')+1:]
+			continue
+		if cols is not None and len(f)==7+len(cols):
+			ph={'phase':f[0],'loops':int(f[1]),'mean':float(f[2]),'min':float(f[3]),
+				'max':float(f[4]),'sd':float(f[5]),'gbs':float(f[6])}
+			ph.update(zip(cols,[int(v) for v in f[7:]]))
+			rec['phases'].append(ph)
+			continue
+		m=re.match(r'(\d+) :((?: \S+)+)\s*$',line)
+		if m:
+			rec['points'].append([float(v) for v in m.group(2).split()])
+		elif f[0]=='Time:':
+			rec['time']=float(f[1])
+	if 'time' not in rec or not rec['phases']:
+		return None
+	return rec
+
+# The largest difference between two runs' points, relative to the larger
+def maxDiff(a, b):
+	if len(a)!=len(b):
+		return None
+	diff=0.0
+	for pa,pb in zip(a,b):
+		for x,y in zip(pa,pb):
+			scale=max(abs(x),abs(y),1.0)
+			diff=max(diff,abs(x-y)/scale)
+	return diff
+
+# Run one version and return its record, its peak RSS from wait4 in kB
+def runOne(args, cfg, layout, backend, gtype, npoints, nedges, nth, scatter, fused, pf, win, ntasks, nfields):
+	exe=os.path.join(args.root,'micro-app-%s-%s'%(layout,backend))
+	cmd=[exe,'--type',gtype,'--npoints',str(npoints),'--nedges',str(nedges),
+		'--nloops',str(cfg['nloops']),'--warmup',str(cfg['warmup'])]
+	if backend not in ('serial','mpi') and layout!='aosoa':
+		cmd+=['--scatter',scatter]
+	if fused:
+		cmd.append('--fused')
+	if pf:
+		cmd+=['--prefetch',str(pf)]
+	if win:
+		cmd+=['--window',str(win)]
+	if ntasks:
+		cmd+=['--tasks',str(ntasks)]
+	if nfields!=3:
+		cmd+=['--fields',str(nfields)]
+	if backend=='cuda' and cfg['resident']:
+		cmd.append('--resident')
+	# mpi runs a rank per thread, each single threaded
+	if backend=='mpi':
+		cmd=args.mpirun.split()+['-np',str(nth)]+cmd
+		nth=1
+	env=dict(os.environ)
+	env['OMP_NUM_THREADS']=str(nth)
+	try:
+		p=subprocess.Popen(cmd,env=env,stdout=subprocess.PIPE,stderr=subprocess.STDOUT,universal_newlines=True)
+	except OSError as e:
+		sys.stderr.write('FAILED: %s: %s\n'%(' '.join(cmd),e))
+		return None
+	out=p.stdout.read()
+	p.stdout.close()
+	pid,status,ru=os.wait4(p.pid,0)
+	rec=parseRun(out)
+	if status!=0 or rec is None:
+		sys.stderr.write('FAILED: %s\n'%' '.join(cmd))
+		return None
+	rec['maxrss']=ru.ru_maxrss
+	return rec
+
+def main():
+	parser=argparse.ArgumentParser(description='Run the UMMA versions on the same graphs and check their results agree')
+	parser.add_argument('--config',help='JSON file with the lists layouts, backends, types, npoints, nedges, threads, scatters, fused, prefetch, window, tasks and fields, and nloops, warmup, reps and resident, e.g. bench.json')
+	parser.add_argument('-l','--layout',help='layouts: '+','.join(LAYOUTS))
+	parser.add_argument('-b','--backend',help='backends: '+','.join(BACKENDS))
+	parser.add_argument('-g','--type',help='graph types')
+	parser.add_argument('-p','--npoints',help='points of the graphs')
+	parser.add_argument('-e','--nedges',help='edges, or edges per point for regular_random')
+	parser.add_argument('-t','--threads',help='thread counts')
+	parser.add_argument('-s','--scatter',help='scatter strategies, each run by the backends that have it')
+	parser.add_argument('-f','--fused',help='fused or not, e.g. 0,1')
+	parser.add_argument('--prefetch',help='gather prefetch distances, 0 for none')
+	parser.add_argument('--window',help='gather windows, 0 for none')
+	parser.add_argument('--tasks',help='ISPC tasks per kernel, 0 for none')
+	parser.add_argument('--fields',help='floats per point, 3 by default')
+	parser.add_argument('--nloops',type=int,help='timed loops of each run')
+	parser.add_argument('--warmup',type=int,help='untimed loops before them')
+	parser.add_argument('--reps',type=int,help='repetitions of each run')
+	parser.add_argument('--tol',type=float,default=1e-5,help='largest relative difference from the first run\'s points')
+	parser.add_argument('--mpirun',default='mpirun',help='MPI launcher and its options, for mpi')
+	parser.add_argument('--root',default=os.path.dirname(os.path.abspath(__file__)),help='umma directory')
+	parser.add_argument('--csv',help='CSV file to write')
+	parser.add_argument('--json',help='JSON file to write')
+	args=parser.parse_args()
+
+	# The command line wins over the config, which wins over the defaults
+	cfg=dict(DEFAULTS)
+	if args.config:
+		with open(args.config) as f:
+			cfg.update(json.load(f))
+	if args.layout: cfg['layouts']=csvList(args.layout)
+	if args.backend: cfg['backends']=csvList(args.backend)
+	if args.type: cfg['types']=csvList(args.type)
+	if args.npoints: cfg['npoints']=intList(args.npoints)
+	if args.nedges: cfg['nedges']=intList(args.nedges)
+	if args.threads: cfg['threads']=intList(args.threads)
+	if args.scatter: cfg['scatters']=csvList(args.scatter)
+	if args.fused: cfg['fused']=boolList(args.fused)
+	if args.prefetch: cfg['prefetch']=intList(args.prefetch)
+	if args.window: cfg['window']=intList(args.window)
+	if args.tasks: cfg['tasks']=intList(args.tasks)
+	if args.fields: cfg['fields']=intList(args.fields)
+	if args.nloops is not None: cfg['nloops']=args.nloops
+	if args.warmup is not None: cfg['warmup']=args.warmup
+	if args.reps is not None: cfg['reps']=args.reps
+	for layout in cfg['layouts']:
+		if layout not in LAYOUTS:
+			parser.error('unknown layout '+layout)
+	for backend in cfg['backends']:
+		if backend not in BACKENDS:
+			parser.error('unknown backend '+backend)
+
+	# Versions not built are left out
+	impls=[]
+	for layout,backend in itertools.product(cfg['layouts'],cfg['backends']):
+		if os.access(os.path.join(args.root,'micro-app-%s-%s'%(layout,backend)),os.X_OK):
+			impls.append((layout,backend))
+		else:
+			sys.stderr.write('SKIPPED: micro-app-%s-%s is not built\n'%(layout,backend))
+
+	recs=[]
+	bad=0
+	print(','.join(FIELDS))
+	for gtype,npoints,nedges in itertools.product(cfg['types'],cfg['npoints'],cfg['nedges']):
+		refs={}
+		for nth,rep,(layout,backend),scatter,fused,pf,win,ntasks,nfields in itertools.product(cfg['threads'],
+				range(cfg['reps']),impls,cfg['scatters'],cfg['fused'],cfg['prefetch'],cfg['window'],
+				cfg['tasks'],cfg['fields']):
+			if scatter not in SCATTERS[backend]:
+				continue
+			# serial and mpi have one strategy, so run once whatever the list
+			if backend in ('serial','mpi') and scatter!=cfg['scatters'][0]:
+				continue
+			if layout=='aosoa' and scatter!='atomic':
+				continue
+			if backend=='cuda' and fused and scatter!='atomic':
+				continue
+			# only the aos and soa CPU gathers prefetch or window, and
+			# --fused has no gather
+			if (pf or win) and (fused or layout=='aosoa' or backend not in ('serial','openmp')):
+				continue
+			# only ispc launches tasks, and scatters with them by color or csr
+			if ntasks and (backend!='ispc' or scatter=='atomic'):
+				continue
+			if backend=='mpi' and fused:
+				continue
+			# only the soa CPU versions have other than 3 floats per point
+			if nfields!=3 and (layout!='soa' or backend not in ('serial','openmp')):
+				continue
+			run=runOne(args,cfg,layout,backend,gtype,npoints,nedges,nth,scatter,fused,pf,win,ntasks,nfields)
+			if run is None:
+				bad+=1
+				continue
+			if nfields not in refs:
+				refs[nfields]=run['points']
+				maxdiff=0.0
+			else:
+				maxdiff=maxDiff(refs[nfields],run['points'])
+				if maxdiff is None or maxdiff>args.tol:
+					sys.stderr.write('MISMATCH: %s-%s %s %s differs from the first run by %s\n'%(layout,backend,gtype,scatter,maxdiff))
+					bad+=1
+			common=dict(layout=layout,backend=backend,type=gtype,npoints=npoints,nedges=nedges,
+				nth=nth,scatter=scatter,fused=int(fused),prefetch=pf,window=win,tasks=ntasks,fields=nfields,rep=rep,maxrss=run['maxrss'],maxdiff=maxdiff)
+			rows=[dict(common,**ph) for ph in run['phases']]
+			rows.append(dict(common,phase='loop',loops=cfg['nloops'],mean=run['time']))
+			for rec in rows:
+				recs.append(rec)
+				print(','.join(str(rec.get(f,'')) for f in FIELDS))
+			sys.stdout.flush()
+
+	if args.csv:
+		# the counters, if any run read them, go after the fixed fields
+		extra=sorted(set(k for rec in recs for k in rec)-set(FIELDS))
+		with open(args.csv,'w') as f:
+			w=csv.DictWriter(f,fieldnames=FIELDS+extra,extrasaction='ignore')
+			w.writeheader()
+			for rec in recs:
+				w.writerow(rec)
+	if args.json:
+		with open(args.json,'w') as f:
+			json.dump({'config':cfg,'runs':recs},f,indent=1)
+	return 1 if bad else 0
+
+if __name__=='__main__':
+	sys.exit(main())
@@ -0,0 +1,24 @@
+#include "alloc.h"
+#include "cody.h"
+
+#define CACHE_LINE 64
+
+void* umma_alloc_untouched(size_t n, size_t size, int huge) {
+    if (size != 0 && n > (size_t) -1 / size) {
+        return NULL;
+    }
+    // whole lines or pages, so nothing else shares them
+    return cody_alloc(n * size, CACHE_LINE,
+                      (huge ? CODY_HUGE : 0) | CODY_FIRST_TOUCH);
+}
+
+void* umma_alloc(size_t n, size_t size, int huge) {
+    if (size != 0 && n > (size_t) -1 / size) {
+        return NULL;
+    }
+    return cody_alloc(n * size, CACHE_LINE, huge ? CODY_HUGE : 0);
+}
+
+void umma_free(void* p) {
+    cody_free(p);
+}
@@ -0,0 +1,32 @@
+#ifndef _alloc_h_
+#define _alloc_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Zeroed memory for n elements of size bytes, like calloc, aligned to a
+ * cache line or, with huge set, to a 2 MB page and advised to be backed by
+ * transparent huge pages. It comes from cody_alloc, so CODY_PAGES and
+ * CODY_NUMA apply and it counts towards the run's memory peak, and is
+ * released with umma_free(). Returns NULL if out of memory.
+ */
+void* umma_alloc(size_t n, size_t size, int huge);
+
+/*
+ * umma_alloc without the zeroing, so each page is placed on the NUMA node
+ * of the thread that first writes it.
+ */
+void* umma_alloc_untouched(size_t n, size_t size, int huge);
+
+/* Releases memory of umma_alloc or umma_alloc_untouched. */
+void umma_free(void* p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "bench.h"
+#include "cody.h"
+
+#ifdef USE_PAPI
+#include <papi.h>
+
+/* cache misses, those the CPU lacks are left out. PAPI counts the calling
+ * thread only, so OpenMP runs count the master's share */
+static const char* event_names[BENCH_MAX_EVENTS] = {
+    "PAPI_L1_DCM", "PAPI_L2_TCM", "PAPI_L3_TCM"
+};
+static int event_index[BENCH_MAX_EVENTS];
+#endif
+
+static const char* phase_names[NPHASES] = {
+    "gather", "compute", "scatter", "fused"
+};
+
+static void counters_init(struct bench* b) {
+#ifdef USE_PAPI
+    int k, code;
+
+    b->eventset = PAPI_NULL;
+    if (PAPI_library_init(PAPI_VER_CURRENT) != PAPI_VER_CURRENT ||
+            PAPI_create_eventset(&b->eventset) != PAPI_OK) {
+        fprintf(stderr, "PAPI unavailable, no counters\n");
+        return;
+    }
+    for (k = 0; k < BENCH_MAX_EVENTS; k++) {
+        if (PAPI_event_name_to_code((char*) event_names[k], &code) ==
+                PAPI_OK && PAPI_add_event(b->eventset, code) == PAPI_OK) {
+            event_index[b->nevents++] = k;
+        }
+    }
+    if (b->nevents > 0 && PAPI_start(b->eventset) != PAPI_OK) {
+        b->nevents = 0;
+    }
+#endif
+}
+
+static void counters_read(struct bench* b, long long* now) {
+#ifdef USE_PAPI
+    if (b->nevents > 0) {
+        PAPI_read(b->eventset, now);
+    }
+#endif
+}
+
+int bench_init(struct bench* b, int nloops) {
+    int p, k;
+
+    b->nloops = nloops;
+    b->nwarm = 0;
+    b->loop = -1;
+    b->mark = 0;
+    b->index_bytes = 8;
+    b->nfields = 3;
+    b->nevents = 0;
+    b->eventset = -1;
+    for (p = 0; p < NPHASES; p++) {
+        b->used[p] = 0;
+        for (k = 0; k < BENCH_MAX_EVENTS; k++) {
+            b->counts[p][k] = 0;
+        }
+    }
+    b->times = (double*) calloc((size_t) NPHASES * nloops, sizeof(double));
+    if (b->times == NULL) {
+        return -1;
+    }
+    counters_init(b);
+
+    return 0;
+}
+
+void bench_loop(struct bench* b, int loop) {
+    b->loop = loop;
+    if (-loop > b->nwarm) {
+        b->nwarm = -loop;
+    }
+    counters_read(b, b->last);
+    b->mark = cody_now();
+}
+
+void bench_phase(struct bench* b, int phase) {
+    long long now[BENCH_MAX_EVENTS] = {0};
+    double t = cody_now();
+    int k;
+
+    if (b->loop >= 0 && b->loop < b->nloops) {
+        b->times[phase * b->nloops + b->loop] = t - b->mark;
+        b->used[phase] = 1;
+        cody_record(phase_names[phase], t - b->mark, 1);
+        counters_read(b, now);
+        for (k = 0; k < b->nevents; k++) {
+            b->counts[phase][k] += now[k] - b->last[k];
+            b->last[k] = now[k];
+        }
+    }
+    b->mark = cody_now();
+}
+
+void bench_index_bytes(struct bench* b, double bytes) {
+    b->index_bytes = bytes;
+}
+
+void bench_fields(struct bench* b, int nfields) {
+    b->nfields = nfields;
+}
+
+double bench_bytes(const struct bench* b, int phase, int npoints,
+        int nedges) {
+    // 4 byte floats, nfields to a point
+    double pt = 4.0 * b->nfields;
+
+    switch (phase) {
+        case PHASE_GATHER:
+            // the indices, both points and the datum in, both staged
+            // points and the datum out
+            return (b->index_bytes + 4 * pt + 8) * nedges;
+        case PHASE_COMPUTE:
+            // both staged points and the datum in, both points out
+            return (4 * pt + 4) * nedges;
+        case PHASE_SCATTER:
+            // the indices and both staged points in, both points in and
+            // out
+            return (b->index_bytes + 6 * pt) * nedges;
+        case PHASE_FUSED:
+            // the indices, both points and the datum in, both points of
+            // the copy in and out, and the copy made
+            return (b->index_bytes + 6 * pt + 4) * nedges + 2 * pt * npoints;
+    }
+    return 0;
+}
+
+void bench_report(struct bench* b, int npoints, int nedges) {
+    char name[32];
+    double mean, min, max, var, t, bytes = 0;
+    int p, i, k;
+
+    printf("Phase    loops mean (s)     min (s)      max (s)      sd (s)       "
+            "GB/s");
+#ifdef USE_PAPI
+    for (k = 0; k < b->nevents; k++) {
+        printf(" %s", event_names[event_index[k]]);
+    }
+#endif
+    printf(" \n");
+    cody_param("npoints", "%d", npoints);
+    cody_param("nedges", "%d", nedges);
+    cody_param("loops", "%d", b->nloops);
+    cody_param("fields", "%d", b->nfields);
+
+    for (p = 0; p < NPHASES; p++) {
+        if (!b->used[p]) {
+            continue;
+        }
+        mean = 0;
+        min = b->times[p * b->nloops];
+        max = min;
+        for (i = 0; i < b->nloops; i++) {
+            t = b->times[p * b->nloops + i];
+            mean += t;
+            min = (t < min) ? t : min;
+            max = (t > max) ? t : max;
+        }
+        mean /= b->nloops;
+        var = 0;
+        for (i = 0; i < b->nloops; i++) {
+            t = b->times[p * b->nloops + i] - mean;
+            var += t * t;
+        }
+        var = (b->nloops > 1) ? var / (b->nloops - 1) : 0;
+
+        printf("%-8s %5d %e %e %e %e %.2f", phase_names[p], b->nloops, mean,
+                min, max, sqrt(var),
+                bench_bytes(b, p, npoints, nedges) / mean * 1e-9);
+        bytes += bench_bytes(b, p, npoints, nedges);
+        snprintf(name, sizeof(name), "%s bandwidth", phase_names[p]);
+        cody_metric(name, bench_bytes(b, p, npoints, nedges) / mean * 1e-9,
+                "GB/s");
+        for (k = 0; k < b->nevents; k++) {
+            printf(" %lld", b->counts[p][k] / b->nloops);
+#ifdef USE_PAPI
+            cody_count(phase_names[p], event_names[event_index[k]],
+                    (double) b->counts[p][k]);
+#endif
+        }
+        printf(" \n");
+    }
+    // the energy counted runs from cody_init, just before the warm-up
+    cody_work(NULL, bytes * (b->nloops + b->nwarm) * 1e-9, "GB");
+}
+
+void bench_free(struct bench* b) {
+#ifdef USE_PAPI
+    long long now[BENCH_MAX_EVENTS];
+
+    if (b->nevents > 0) {
+        PAPI_stop(b->eventset, now);
+    }
+#endif
+    free(b->times);
+    b->times = NULL;
+}
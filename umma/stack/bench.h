@@ -0,0 +1,79 @@
+#ifndef _bench_h_
+#define _bench_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* phases of a loop */
+#define PHASE_GATHER  0
+#define PHASE_COMPUTE 1
+#define PHASE_SCATTER 2
+#define PHASE_FUSED   3
+#define NPHASES       4
+
+/* hardware counters read with PAPI, see bench.c */
+#define BENCH_MAX_EVENTS 3
+
+/*
+ * Times of every phase of every timed loop, and with USE_PAPI the cache
+ * misses of every phase summed over the timed loops. Loops numbered below
+ * 0 are warm-up and not recorded, only counted in nwarm. index_bytes is the
+ * bytes of index read per edge, 8 unless compressed, and nfields the floats
+ * per point, 3 unless set.
+ */
+struct bench {
+    int nloops;
+    int nwarm;
+    int loop;
+    double mark;
+    double index_bytes;
+    int nfields;
+    double* times;
+    int used[NPHASES];
+    int nevents;
+    int eventset;
+    long long last[BENCH_MAX_EVENTS];
+    long long counts[NPHASES][BENCH_MAX_EVENTS];
+};
+
+/* Sets b up for nloops timed loops. Returns 0 or -1 if out of memory */
+int bench_init(struct bench* b, int nloops);
+
+/* Starts loop number loop, negative while warming up */
+void bench_loop(struct bench* b, int loop);
+
+/*
+ * Ends phase, which ran since bench_loop or the previous bench_phase, and
+ * starts the next.
+ */
+void bench_phase(struct bench* b, int phase);
+
+/* Sets the bytes of index read per edge, see cindex.h */
+void bench_index_bytes(struct bench* b, double bytes);
+
+/* Sets the floats per point and per staged endpoint */
+void bench_fields(struct bench* b, int nfields);
+
+/*
+ * Prints a line per phase run: its mean, min and max time and standard
+ * deviation over the timed loops, the bandwidth its nominal bytes (see
+ * bench_bytes) take at the mean, and the counters per loop. The nominal
+ * bytes of every loop, warm-up included, are the run's work for cody.
+ */
+void bench_report(struct bench* b, int npoints, int nedges);
+
+/*
+ * Bytes a phase reads and writes over a graph if nothing stays in cache,
+ * every access to a point counted, with b's index bytes and fields.
+ */
+double bench_bytes(const struct bench* b, int phase, int npoints,
+        int nedges);
+
+void bench_free(struct bench* b);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,87 @@
+#include <stdlib.h>
+#include "alloc.h"
+#include "cindex.h"
+
+/* largest span of endpoints a block can offset from its base */
+#define CINDEX_SPAN 65535
+
+void cindex_free(struct cindex* ci) {
+    umma_free(ci->base0);
+    umma_free(ci->base1);
+    umma_free(ci->d0);
+    umma_free(ci->d1);
+    ci->base0 = NULL;
+    ci->base1 = NULL;
+    ci->d0 = NULL;
+    ci->d1 = NULL;
+    ci->nedges = 0;
+    ci->nblocks = 0;
+    ci->nraw0 = 0;
+    ci->nraw1 = 0;
+}
+
+/*
+ * Offsets the n endpoints v of a block from their lowest into d and
+ * returns it, or returns -1 if they span too much to.
+ */
+static int compress_block(int n, const int* v, unsigned short* d) {
+    int i, lo, hi;
+
+    lo = v[0];
+    hi = v[0];
+    for (i = 1; i < n; i++) {
+        lo = (v[i] < lo) ? v[i] : lo;
+        hi = (v[i] > hi) ? v[i] : hi;
+    }
+    if ((long long) hi - lo > CINDEX_SPAN) {
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        d[i] = (unsigned short) (v[i] - lo);
+    }
+    return lo;
+}
+
+int cindex_build(struct cindex* ci, int nedges, const int* v0, const int* v1,
+        int huge) {
+    int b, start, n;
+
+    cindex_free(ci);
+    ci->nedges = nedges;
+    ci->nblocks = (nedges + CINDEX_BLOCK - 1) / CINDEX_BLOCK;
+    ci->base0 = (int*) umma_alloc(ci->nblocks, sizeof(int), huge);
+    ci->base1 = (int*) umma_alloc(ci->nblocks, sizeof(int), huge);
+    ci->d0 = (unsigned short*) umma_alloc(nedges, sizeof(unsigned short),
+            huge);
+    ci->d1 = (unsigned short*) umma_alloc(nedges, sizeof(unsigned short),
+            huge);
+    if (ci->base0 == NULL || ci->base1 == NULL || ci->d0 == NULL ||
+            ci->d1 == NULL) {
+        cindex_free(ci);
+        return -1;
+    }
+
+    for (b = 0; b < ci->nblocks; b++) {
+        start = b * CINDEX_BLOCK;
+        n = (nedges - start < CINDEX_BLOCK) ? nedges - start : CINDEX_BLOCK;
+        ci->base0[b] = compress_block(n, v0 + start, ci->d0 + start);
+        ci->base1[b] = compress_block(n, v1 + start, ci->d1 + start);
+        ci->nraw0 += (ci->base0[b] < 0);
+        ci->nraw1 += (ci->base1[b] < 0);
+    }
+
+    return 0;
+}
+
+double cindex_bytes(const struct cindex* ci) {
+    double raw;
+
+    if (ci->nedges == 0) {
+        return 0;
+    }
+    // the last block may be short, but is counted whole
+    raw = (double) (ci->nraw0 + ci->nraw1) * CINDEX_BLOCK;
+    raw = (raw < 2.0 * ci->nedges) ? raw : 2.0 * ci->nedges;
+    return (8.0 * ci->nblocks + 2.0 * (2.0 * ci->nedges - raw) + 4.0 * raw) /
+        ci->nedges;
+}
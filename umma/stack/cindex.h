@@ -0,0 +1,50 @@
+#ifndef _cindex_h_
+#define _cindex_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* edges per block of a compressed index stream */
+#define CINDEX_BLOCK 256
+
+/*
+ * The endpoints of a graph's edges, compressed: every block of CINDEX_BLOCK
+ * edges keeps a 32 bit base per endpoint, base0[b] the lowest first
+ * endpoint of its edges and base1[b] the lowest second one, and edge i's
+ * endpoints as their 16 bit offsets d0[i] and d1[i] from them, so its first
+ * endpoint is base0[b] + d0[i]. A block whose first or second endpoints
+ * span more than 65535 has a base of -1 for them, and they are read from
+ * the graph's own 32 bit indices instead. The generated graphs are grouped
+ * by their first endpoint, so its blocks fit, and both fit on a graph
+ * numbered for locality, such as a mesh.
+ */
+struct cindex {
+    int nedges;
+    int nblocks;
+    int nraw0;
+    int nraw1;
+    int* base0;
+    int* base1;
+    unsigned short* d0;
+    unsigned short* d1;
+};
+
+/*
+ * Compresses the endpoints of the nedges edges, edge i joining v0[i] and
+ * v1[i], into ci, freeing what ci held before. Pass a zeroed ci the first
+ * time. huge is umma_alloc's. Returns 0, or -1 if out of memory.
+ */
+int cindex_build(struct cindex* ci, int nedges, const int* v0, const int* v1,
+        int huge);
+
+/* Bytes of index a pass over every edge reads per edge */
+double cindex_bytes(const struct cindex* ci);
+
+void cindex_free(struct cindex* ci);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
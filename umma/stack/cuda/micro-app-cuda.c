@@ -1,116 +1,239 @@
-#include <lua.h>
-#include <lauxlib.h>
-#include <lualib.h>
+#include <stdlib.h>
+#include "alloc.h"
+#include "graph.h"
 #include "micro-app-cuda.h"
+#include "reorder.h"
 
-int graph_init_aos(char* graph_type, int npoints, int nedges,
-        struct edge* edges, char* fname) {
-    lua_State *L;
-    int i, j, k, v;
-
-    L = luaL_newstate();
-    luaL_openlibs(L);
-    luaL_loadfile(L, "graph.lua");
-    lua_pcall(L, 0, 0, 0);
-
-    lua_getglobal(L, "create_graph");
-    lua_pushstring(L, graph_type);
-    lua_pushinteger(L, NPOINTS);
-    lua_pushinteger(L, NEDGES);
-
-    if (fname != NULL) {
-        lua_pushstring(L, fname);
-        lua_call(L, 4, 1);
-    } else {
-        lua_call(L, 3, 1);
-    }
-
-    /* Table is now sitting at the top of the stack */
-    i = 0;
-    lua_pushnil(L);  /* Make sure lua_next starts at beginning */
-    while (lua_next(L, -2) != 0) {
-        // fetch first key
-        k = lua_tointeger(L, -2);
-        lua_pushnil(L);
-        while (lua_next(L, -2) != 0) { // loop over neighbors
-            lua_pop(L,1);
-            v = lua_tointeger(L, -1);
-
-            // build edges array here
-            edges[i].v0 = k - 1;
-            edges[i].v1 = v - 1;
-
-            for (j = 0; j < 3; j++) {
-                edges[i].v0_pt_data[j] = 0;
-                edges[i].v1_pt_data[j] = 0;
-            }
+int graph_init_aos(struct edge_list* el, struct edge** edges, int huge) {
+    int i;
 
-            i++;
-        }
-        lua_pop(L,1);
+    *edges = (struct edge*) umma_alloc(el->nedges, sizeof(struct edge), huge);
+    if (*edges == NULL) {
+        return -1;
+    }
+    for (i = 0; i < el->nedges; i++) {
+        (*edges)[i].v0 = el->v0[i];
+        (*edges)[i].v1 = el->v1[i];
     }
 
-    lua_close(L);
+    return 0;
+}
+
+int graph_init_soa(struct edge_list* el, struct graph* gr, int huge) {
+    int i, n = el->nedges;
 
-    if (i == 0) {
+    gr->v0 = (int*) umma_alloc(n, sizeof(int), huge);
+    gr->v1 = (int*) umma_alloc(n, sizeof(int), huge);
+    gr->v0_data = (float (*)[3]) umma_alloc(n, 3 * sizeof(float), huge);
+    gr->v1_data = (float (*)[3]) umma_alloc(n, 3 * sizeof(float), huge);
+    gr->data = (float*) umma_alloc(n, sizeof(float), huge);
+    if (gr->v0 == NULL || gr->v1 == NULL || gr->v0_data == NULL ||
+            gr->v1_data == NULL || gr->data == NULL) {
         return -1;
-    } else {
-        return 0;
     }
+    for (i = 0; i < n; i++) {
+        gr->v0[i] = el->v0[i];
+        gr->v1[i] = el->v1[i];
+    }
+
+    return 0;
 }
 
-int graph_init_soa(char* graph_type, int npoints, int nedges,
-        struct graph* gr, char* fname) {
-    lua_State *L;
-    int i, j, k, v;
-
-    L = luaL_newstate();
-    luaL_openlibs(L);
-    luaL_loadfile(L, "graph.lua");
-    lua_pcall(L, 0, 0, 0);
-
-    lua_getglobal(L, "create_graph");
-    lua_pushstring(L, graph_type);
-    lua_pushinteger(L, NPOINTS);
-    lua_pushinteger(L, NEDGES);
-
-    if (fname != NULL) {
-        lua_pushstring(L, fname);
-        lua_call(L, 4, 1);
-    } else {
-        lua_call(L, 3, 1);
-    }
-
-    /* Table is now sitting at the top of the stack */
-    i = 0;
-    lua_pushnil(L);  /* Make sure lua_next starts at beginning */
-    while (lua_next(L, -2) != 0) {
-        // fetch first key
-        k = lua_tointeger(L, -2);
-        lua_pushnil(L);
-        while (lua_next(L, -2) != 0) { // loop over neighbors
-            lua_pop(L,1);
-            v = lua_tointeger(L, -1);
-
-            // build the graph
-            gr->v0[i] = k - 1;
-            gr->v1[i] = v - 1;
-
-            for (j = 0; j < 3; j++) {
-                gr->v0_data[i][j] = 0;
-                gr->v1_data[i][j] = 0;
-            }
+int graph_color_aos(int npoints, int nedges, struct edge* edges,
+        int* color_edges, int* color_start) {
+    int* mark;
+    int c, k, next, e, v0, v1;
+
+    mark = (int*) malloc(npoints * sizeof(int));
+    if (mark == NULL) {
+        return -1;
+    }
 
-            i++;
+    for (k = 0; k < nedges; k++) {
+        color_edges[k] = k;
+    }
+    for (k = 0; k < npoints; k++) {
+        mark[k] = -1;
+    }
+
+    next = 0;
+    for (c = 0; next < nedges; c++) {
+        color_start[c] = next;
+        // move the edges this color can take to the front of the rest
+        for (k = next; k < nedges; k++) {
+            e = color_edges[k];
+            v0 = edges[e].v0;
+            v1 = edges[e].v1;
+            if (mark[v0] != c && mark[v1] != c) {
+                mark[v0] = c;
+                mark[v1] = c;
+                color_edges[k] = color_edges[next];
+                color_edges[next++] = e;
+            }
         }
-        lua_pop(L,1);
     }
+    color_start[c] = next;
 
-    lua_close(L);
+    free(mark);
 
-    if (i == 0) {
+    return c;
+}
+
+int graph_color_soa(int npoints, int nedges, struct graph* gr,
+        int* color_edges, int* color_start) {
+    int* mark;
+    int c, k, next, e, v0, v1;
+
+    mark = (int*) malloc(npoints * sizeof(int));
+    if (mark == NULL) {
         return -1;
-    } else {
-        return 0;
     }
+
+    for (k = 0; k < nedges; k++) {
+        color_edges[k] = k;
+    }
+    for (k = 0; k < npoints; k++) {
+        mark[k] = -1;
+    }
+
+    next = 0;
+    for (c = 0; next < nedges; c++) {
+        color_start[c] = next;
+        // move the edges this color can take to the front of the rest
+        for (k = next; k < nedges; k++) {
+            e = color_edges[k];
+            v0 = gr->v0[e];
+            v1 = gr->v1[e];
+            if (mark[v0] != c && mark[v1] != c) {
+                mark[v0] = c;
+                mark[v1] = c;
+                color_edges[k] = color_edges[next];
+                color_edges[next++] = e;
+            }
+        }
+    }
+    color_start[c] = next;
+
+    free(mark);
+
+    return c;
+}
+
+int graph_csr_aos(int npoints, int nedges, struct edge* edges,
+        int* csr_start, int* csr_edges) {
+    int i, v;
+
+    for (v = 0; v <= npoints; v++) {
+        csr_start[v] = 0;
+    }
+    for (i = 0; i < nedges; i++) {
+        csr_start[edges[i].v0 + 1]++;
+        csr_start[edges[i].v1 + 1]++;
+    }
+    for (v = 0; v < npoints; v++) {
+        csr_start[v+1] += csr_start[v];
+    }
+    // fill, using csr_start[v] as v's next free slot
+    for (i = 0; i < nedges; i++) {
+        csr_edges[csr_start[edges[i].v0]++] = 2 * i;
+        csr_edges[csr_start[edges[i].v1]++] = 2 * i + 1;
+    }
+    for (v = npoints; v > 0; v--) {
+        csr_start[v] = csr_start[v-1];
+    }
+    csr_start[0] = 0;
+
+    return 0;
+}
+
+int graph_csr_soa(int npoints, int nedges, struct graph* gr,
+        int* csr_start, int* csr_edges) {
+    int i, v;
+
+    for (v = 0; v <= npoints; v++) {
+        csr_start[v] = 0;
+    }
+    for (i = 0; i < nedges; i++) {
+        csr_start[gr->v0[i] + 1]++;
+        csr_start[gr->v1[i] + 1]++;
+    }
+    for (v = 0; v < npoints; v++) {
+        csr_start[v+1] += csr_start[v];
+    }
+    // fill, using csr_start[v] as v's next free slot
+    for (i = 0; i < nedges; i++) {
+        csr_edges[csr_start[gr->v0[i]]++] = 2 * i;
+        csr_edges[csr_start[gr->v1[i]]++] = 2 * i + 1;
+    }
+    for (v = npoints; v > 0; v--) {
+        csr_start[v] = csr_start[v-1];
+    }
+    csr_start[0] = 0;
+
+    return 0;
+}
+
+int graph_reorder_aos(int method, int npoints, int nedges,
+        struct edge* edges, int* vperm) {
+    int* eperm;
+    int* v0;
+    int* v1;
+    int i, rv;
+
+    eperm = (int*) malloc(nedges * sizeof(int) + 1);
+    v0 = (int*) malloc(nedges * sizeof(int) + 1);
+    v1 = (int*) malloc(nedges * sizeof(int) + 1);
+    rv = -1;
+    if (eperm != NULL && v0 != NULL && v1 != NULL) {
+        for (i = 0; i < nedges; i++) {
+            v0[i] = edges[i].v0;
+            v1[i] = edges[i].v1;
+        }
+        rv = reorder_graph(method, npoints, nedges, v0, v1, vperm, eperm);
+    }
+    if (rv == 0) {
+        for (i = 0; i < nedges; i++) {
+            edges[i].v0 = vperm[v0[eperm[i]]];
+            edges[i].v1 = vperm[v1[eperm[i]]];
+        }
+    }
+
+    free(eperm);
+    free(v0);
+    free(v1);
+
+    return rv;
+}
+
+int graph_reorder_soa(int method, int npoints, int nedges,
+        struct graph* gr, int* vperm) {
+    int* eperm;
+    int* v0;
+    int* v1;
+    int i, rv;
+
+    eperm = (int*) malloc(nedges * sizeof(int) + 1);
+    v0 = (int*) malloc(nedges * sizeof(int) + 1);
+    v1 = (int*) malloc(nedges * sizeof(int) + 1);
+    rv = -1;
+    if (eperm != NULL && v0 != NULL && v1 != NULL) {
+        rv = reorder_graph(method, npoints, nedges, gr->v0, gr->v1, vperm,
+                eperm);
+    }
+    if (rv == 0) {
+        for (i = 0; i < nedges; i++) {
+            v0[i] = vperm[gr->v0[eperm[i]]];
+            v1[i] = vperm[gr->v1[eperm[i]]];
+        }
+        for (i = 0; i < nedges; i++) {
+            gr->v0[i] = v0[i];
+            gr->v1[i] = v1[i];
+        }
+    }
+
+    free(eperm);
+    free(v0);
+    free(v1);
+
+    return rv;
 }
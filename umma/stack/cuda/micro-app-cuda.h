@@ -1,14 +1,28 @@
 #ifndef _micro_app_cuda_h_
 #define __micro_app_cuda_h_
 
+#include "graph.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif 
 
+/* defaults for --nedges and --npoints */
 #define NEDGES   10000
 #define NPOINTS  10000
+
 #define NTHREADS 128
 
+/* scatter strategies */
+#define SCATTER_ATOMIC 0
+#define SCATTER_COLOR  1
+#define SCATTER_CSR    2
+#define SCATTER_WARP   3
+#define SCATTER_SHARED 4
+
+/* points a block of the shared scatter keeps in shared memory */
+#define SHARED_POINTS  (2 * NTHREADS)
+
 struct edge {
     int v0;
     int v1;
@@ -18,18 +32,55 @@ struct edge {
 };
 
 struct graph {
-    int v0[NEDGES];
-    int v1[NEDGES];
-    float v0_data[NEDGES][3];
-    float v1_data[NEDGES][3];
-    float data[NEDGES];
+    int* v0;
+    int* v1;
+    float (*v0_data)[3];
+    float (*v1_data)[3];
+    float* data;
 };
 
-int graph_init_aos(char* graph_type, int npoints, int nedges,
-        struct edge* edges, char* fname);
+/*
+ * Copies the edges of el, from graph_create, into a graph allocated with
+ * umma_alloc. Returns 0, or -1 if out of memory.
+ */
+int graph_init_aos(struct edge_list* el, struct edge** edges, int huge);
+
+int graph_init_soa(struct edge_list* el, struct graph* gr, int huge);
+
+/*
+ * Greedy edge coloring: lists the edges color by color in color_edges,
+ * color c's being color_edges[color_start[c]] to
+ * color_edges[color_start[c+1]-1], and returns the number of colors. No
+ * two edges of a color share a vertex.
+ */
+int graph_color_aos(int npoints, int nedges, struct edge* edges,
+        int* color_edges, int* color_start);
+
+int graph_color_soa(int npoints, int nedges, struct graph* gr,
+        int* color_edges, int* color_start);
+
+/*
+ * Incident edges of every vertex, vertex v's being csr_edges[csr_start[v]]
+ * to csr_edges[csr_start[v+1]-1], each as 2 * edge + 0 if v is its v0 or
+ * + 1 if v is its v1. csr_start has npoints + 1 entries and csr_edges
+ * 2 * nedges.
+ */
+int graph_csr_aos(int npoints, int nedges, struct edge* edges,
+        int* csr_start, int* csr_edges);
+
+int graph_csr_soa(int npoints, int nedges, struct graph* gr,
+        int* csr_start, int* csr_edges);
+
+/*
+ * Renumbers the vertices and reorders the edges for locality with
+ * reorder_graph, leaving every vertex's new number in vperm. Returns 0, or
+ * -1 if out of memory.
+ */
+int graph_reorder_aos(int method, int npoints, int nedges,
+        struct edge* edges, int* vperm);
 
-int graph_init_soa(char* graph_type, int npoints, int nedges,
-        struct graph* gr, char* fname);
+int graph_reorder_soa(int method, int npoints, int nedges,
+        struct graph* gr, int* vperm);
 
 #ifdef __cplusplus
 }
@@ -1,13 +1,29 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <limits.h>
+#include <string.h>
 #include <getopt.h>
 
 #include <cuda_runtime.h>
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
 #include "micro-app-cuda.h"
-
-float pt_data[NPOINTS * 3];
-float edge_data[NEDGES];
+#include "reorder.h"
+
+/* sizes of the graph, see data_alloc */
+int npoints;
+int nedges;
+int huge_pages = 0;
+
+float* pt_data;
+float* edge_data;
+int* color_edges;
+int* color_start;
+int ncolors;
+int* csr_start;
+int* csr_edges;
+int* vperm;
 struct graph gr;
 
 void print_help() {
@@ -21,20 +37,70 @@ void print_help() {
     printf("\t --nloops Number of repetitions, must be \n");
     printf("\t          at least one. \n");
     printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the host arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --resident Upload once, keep the data on the device \n");
+    printf("\t            for all loops and download once \n");
+    printf("\t --fused One kernel per loop \n");
+    printf("\t --scatter Scatter strategy, one of:\n");
+    printf("\t\t\t atomic (default) \n");
+    printf("\t\t\t color (not with --fused) \n");
+    printf("\t\t\t csr (not with --fused) \n");
+    printf("\t\t\t warp (not with --fused) \n");
+    printf("\t\t\t shared (not with --fused) \n");
+    printf("\t --reorder Reordering for locality, one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
 }
 
 double timer() {
-    struct timeval tp;
-    struct timezone tzp;
+    return cody_now();
+}
+
+/*
+ * Allocates the point and edge data and the arrays the scatter strategies
+ * and the reordering fill, for the graph's npoints and nedges.
+ */
+int data_alloc() {
+    pt_data = (float*) umma_alloc(npoints, 3 * sizeof(float), huge_pages);
+    edge_data = (float*) umma_alloc(nedges, sizeof(float), huge_pages);
+    color_edges = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+    color_start = (int*) umma_alloc(nedges + 1, sizeof(int), huge_pages);
+    csr_start = (int*) umma_alloc(npoints + 1, sizeof(int), huge_pages);
+    csr_edges = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+    vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+    if (pt_data == NULL || edge_data == NULL || color_edges == NULL ||
+            color_start == NULL || csr_start == NULL || csr_edges == NULL ||
+            vperm == NULL) {
+        return -1;
+    }
 
-    gettimeofday(&tp, &tzp);
-    return ((double)tp.tv_sec) + ((double) tp.tv_usec) * 1e-6;
+    return 0;
+}
+
+/*
+ * Copies the arrays of graph src to those of graph dst, one of the two
+ * holding device pointers.
+ */
+void graph_copy(struct graph* dst, struct graph* src,
+        enum cudaMemcpyKind kind) {
+    cudaMemcpy(dst->v0, src->v0, nedges * sizeof(int), kind);
+    cudaMemcpy(dst->v1, src->v1, nedges * sizeof(int), kind);
+    cudaMemcpy(dst->v0_data, src->v0_data, nedges * 3 * sizeof(float), kind);
+    cudaMemcpy(dst->v1_data, src->v1_data, nedges * 3 * sizeof(float), kind);
+    cudaMemcpy(dst->data, src->data, nedges * sizeof(float), kind);
 }
 
 int data_init() {
     int i;
 
-    for (i = 0; i < NPOINTS; i++) {
+    for (i = 0; i < npoints; i++) {
         pt_data[3*i+0] = 1;
         pt_data[3*i+1] = 1;
         pt_data[3*i+2] = 1;
@@ -46,7 +112,7 @@ int data_init() {
 int edge_data_init() {
     int i;
 
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         edge_data[i] = 1;
     }
 
@@ -133,26 +199,321 @@ __global__ void edge_scatter(float* pt_data, struct graph* gr,
     }
 }
 
+/*
+ * sums x0, x1 and x2 over peers, the lanes of the warp that share a
+ * vertex, into the lowest of them, in log2 of their number of steps. all
+ * the warp's lanes must call it. from NVIDIA's "Voting and Shuffling to
+ * Optimize Atomic Operations"
+ */
+__device__ void reduce_peers(unsigned peers, float* x0, float* x1,
+        float* x2) {
+    int lane, next, rel_pos;
+    float t0, t1, t2;
+
+    lane = threadIdx.x & 31;
+    // position among the peers, and the peers after this lane
+    rel_pos = (lane == 0) ? 0 : __popc(peers << (32 - lane));
+    peers &= 0xfffffffe << lane;
+
+    while (__any_sync(0xffffffff, peers != 0)) {
+        next = __ffs(peers);
+        t0 = __shfl_sync(0xffffffff, *x0, next - 1);
+        t1 = __shfl_sync(0xffffffff, *x1, next - 1);
+        t2 = __shfl_sync(0xffffffff, *x2, next - 1);
+        if (next) {
+            *x0 += t0;
+            *x1 += t1;
+            *x2 += t2;
+        }
+        // the peers at odd positions are summed into the even ones
+        peers &= ~__ballot_sync(0xffffffff, rel_pos & 1);
+        rel_pos >>= 1;
+    }
+}
+
+/*
+ * edge_scatter with the lanes of a warp that share an endpoint summing
+ * their contributions first, so one atomic per component is issued for
+ * them. __match_any_sync needs sm_70; before that every lane is its own
+ * peer and this is edge_scatter.
+ */
+__global__ void edge_scatter_warp(float* pt_data, struct graph* gr,
+        int nedges) {
+    int i, lane;
+    int v0;
+    int v1;
+    unsigned peers;
+    float x0, x1, x2;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+    lane = threadIdx.x & 31;
+
+    // the lanes past the last edge take part with vertex -1 and nothing
+    // to add
+    v0 = (i < nedges) ? gr->v0[i] : -1;
+    v1 = (i < nedges) ? gr->v1[i] : -1;
+
+#if __CUDA_ARCH__ >= 700
+    peers = __match_any_sync(0xffffffff, v0);
+#else
+    peers = 1u << lane;
+#endif
+    x0 = (i < nedges) ? gr->v0_data[i][0] : 0;
+    x1 = (i < nedges) ? gr->v0_data[i][1] : 0;
+    x2 = (i < nedges) ? gr->v0_data[i][2] : 0;
+    reduce_peers(peers, &x0, &x1, &x2);
+    if (v0 >= 0 && lane == __ffs(peers) - 1) {
+        atomicAdd(&pt_data[3*v0+0], x0);
+        atomicAdd(&pt_data[3*v0+1], x1);
+        atomicAdd(&pt_data[3*v0+2], x2);
+    }
+
+#if __CUDA_ARCH__ >= 700
+    peers = __match_any_sync(0xffffffff, v1);
+#endif
+    x0 = (i < nedges) ? gr->v1_data[i][0] : 0;
+    x1 = (i < nedges) ? gr->v1_data[i][1] : 0;
+    x2 = (i < nedges) ? gr->v1_data[i][2] : 0;
+    reduce_peers(peers, &x0, &x1, &x2);
+    if (v1 >= 0 && lane == __ffs(peers) - 1) {
+        atomicAdd(&pt_data[3*v1+0], x0);
+        atomicAdd(&pt_data[3*v1+1], x1);
+        atomicAdd(&pt_data[3*v1+2], x2);
+    }
+}
+
+/*
+ * adds a contribution to point v in the block's shared copy if v is one of
+ * the SHARED_POINTS from base, or else to pt_data
+ */
+__device__ void add_point(float* pt_data, float* acc, int base, int v,
+        float* x) {
+    if (v >= base && v - base < SHARED_POINTS) {
+        atomicAdd(&acc[3*(v-base)+0], x[0]);
+        atomicAdd(&acc[3*(v-base)+1], x[1]);
+        atomicAdd(&acc[3*(v-base)+2], x[2]);
+    } else {
+        atomicAdd(&pt_data[3*v+0], x[0]);
+        atomicAdd(&pt_data[3*v+1], x[1]);
+        atomicAdd(&pt_data[3*v+2], x[2]);
+    }
+}
+
+/*
+ * edge_scatter into a shared memory copy of the SHARED_POINTS points from
+ * the lowest v0 of the block's edges, which are grouped by their lower
+ * point, the copy then added to pt_data once. endpoints outside it add to
+ * pt_data directly.
+ */
+__global__ void edge_scatter_shared(float* pt_data, struct graph* gr,
+        int nedges) {
+    __shared__ float acc[3 * SHARED_POINTS];
+    __shared__ int base;
+    int i, k;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (threadIdx.x == 0) {
+        base = INT_MAX;
+    }
+    for (k = threadIdx.x; k < 3 * SHARED_POINTS; k += NTHREADS) {
+        acc[k] = 0;
+    }
+    __syncthreads();
+    if (i < nedges) {
+        atomicMin(&base, gr->v0[i]);
+    }
+    __syncthreads();
+
+    if (i < nedges) {
+        add_point(pt_data, acc, base, gr->v0[i], gr->v0_data[i]);
+        add_point(pt_data, acc, base, gr->v1[i], gr->v1_data[i]);
+    }
+    __syncthreads();
+
+    // points the block added nothing to are skipped
+    for (k = threadIdx.x; k < 3 * SHARED_POINTS; k += NTHREADS) {
+        if (acc[k] != 0) {
+            atomicAdd(&pt_data[3*base+k], acc[k]);
+        }
+    }
+}
+
+/*
+ * scatter the nedges edges listed in color_edges, which share no vertex,
+ * without atomics
+ */
+__global__ void edge_scatter_color(float* pt_data, struct graph* gr,
+        int* color_edges, int nedges) {
+    int k;
+    int i;
+    int v0;
+    int v1;
+
+    k = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (k < nedges) {
+        i = color_edges[k];
+        v0 = gr->v0[i];
+        v1 = gr->v1[i];
+
+        pt_data[3*v0+0] += gr->v0_data[i][0];
+        pt_data[3*v0+1] += gr->v0_data[i][1];
+        pt_data[3*v0+2] += gr->v0_data[i][2];
+
+        pt_data[3*v1+0] += gr->v1_data[i][0];
+        pt_data[3*v1+1] += gr->v1_data[i][1];
+        pt_data[3*v1+2] += gr->v1_data[i][2];
+    }
+}
+
+/*
+ * owner computes scatter: every vertex sums the contributions of its
+ * incident edges into its own point, with no atomics
+ */
+__global__ void vertex_scatter(float* pt_data, struct graph* gr,
+        int* csr_start, int* csr_edges, int npoints) {
+    int v, k, e, i;
+    float s0, s1, s2;
+
+    v = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (v < npoints) {
+        s0 = 0;
+        s1 = 0;
+        s2 = 0;
+        for (k = csr_start[v]; k < csr_start[v+1]; k++) {
+            e = csr_edges[k];
+            i = e >> 1;
+            if (e & 1) {
+                s0 += gr->v1_data[i][0];
+                s1 += gr->v1_data[i][1];
+                s2 += gr->v1_data[i][2];
+            } else {
+                s0 += gr->v0_data[i][0];
+                s1 += gr->v0_data[i][1];
+                s2 += gr->v0_data[i][2];
+            }
+        }
+        pt_data[3*v+0] += s0;
+        pt_data[3*v+1] += s1;
+        pt_data[3*v+2] += s2;
+    }
+}
+
+/*
+ * gather, compute and scatter in one pass, without staging the endpoint
+ * data in the graph. the gathers read pt_data while the scatters add to
+ * pt_next, a copy of it, so every edge sees the values the three passes
+ * would have.
+ */
+__global__ void edge_fused(float* pt_data, float* pt_next, float* edge_data,
+        struct graph* gr, int nedges) {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+
+    i = blockIdx.x * NTHREADS + threadIdx.x;
+
+    if (i < nedges) {
+        v0 = gr->v0[i];
+        v1 = gr->v1[i];
+
+        x0 = (pt_data[3*v0+0] + pt_data[3*v1+0]) * edge_data[i];
+        x1 = (pt_data[3*v0+1] + pt_data[3*v1+1]) * edge_data[i];
+        x2 = (pt_data[3*v0+2] + pt_data[3*v1+2]) * edge_data[i];
+
+        atomicAdd(&pt_next[3*v0+0], x0);
+        atomicAdd(&pt_next[3*v0+1], x1);
+        atomicAdd(&pt_next[3*v0+2], x2);
+
+        atomicAdd(&pt_next[3*v1+0], x0);
+        atomicAdd(&pt_next[3*v1+1], x1);
+        atomicAdd(&pt_next[3*v1+2], x2);
+    }
+}
+
+/*
+ * launch the scatter of the chosen strategy, one kernel per color if
+ * coloring, one thread per vertex if csr, else one per edge
+ */
+void scatter_launch(int scatter, float* d_pt_data, struct graph* d_gr,
+        int* d_color_edges, int* d_csr_start, int* d_csr_edges) {
+    int c, n;
+
+    if (scatter == SCATTER_COLOR) {
+        for (c = 0; c < ncolors; c++) {
+            n = color_start[c+1] - color_start[c];
+            edge_scatter_color<<<(n / NTHREADS) + 1,NTHREADS>>>(d_pt_data,
+                    d_gr, d_color_edges + color_start[c], n);
+        }
+    } else if (scatter == SCATTER_CSR) {
+        vertex_scatter<<<(npoints / NTHREADS) + 1,NTHREADS>>>(d_pt_data,
+                d_gr, d_csr_start, d_csr_edges, npoints);
+    } else if (scatter == SCATTER_WARP) {
+        edge_scatter_warp<<<(nedges / NTHREADS) + 1,NTHREADS>>>(d_pt_data,
+                d_gr, nedges);
+    } else if (scatter == SCATTER_SHARED) {
+        edge_scatter_shared<<<(nedges / NTHREADS) + 1,NTHREADS>>>(d_pt_data,
+                d_gr, nedges);
+    } else {
+        edge_scatter<<<(nedges / NTHREADS) + 1,NTHREADS>>>(d_pt_data,
+                d_gr, nedges);
+    }
+}
+
 int main(int argc, char** argv) {
     int i;
     int rv;
     double time0, time1;
+    double up0, up1, down0, down1;
     int c, opt_i;
     int nloops = 0;
     char* gt = "";
     char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    struct edge_list el;
+    int resident = 0;
+    int fused = 0;
+    int warmup = 1;
+    struct bench stats;
+    int scatter = SCATTER_ATOMIC;
+    int reorder = REORDER_NONE;
+    int pass, npasses, v;
+    double before = 0;
 
     float* d_pt_data;
     struct graph* d_gr;
+    struct graph d_arrays;
     float* d_edge_data;
+    int* d_color_edges;
+    int* d_csr_start;
+    int* d_csr_edges;
+    float* d_pt_next;
+    float* tmp;
 
-    int nBlocks = (NEDGES / NTHREADS) + 1;
+    int nBlocks;
 
     static struct option long_opts[] = {
         {"help",   no_argument,       0, 0},
         {"type",   required_argument, 0, 0},
         {"nloops", required_argument, 0, 0},
-        {"file",   required_argument, 0, 0}
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"resident", no_argument,     0, 0},
+        {"fused",  no_argument,       0, 0},
+        {"scatter", required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"warmup", required_argument, 0, 0},
+        {0, 0, 0, 0}
     };
 
     /* Parse command-line arguments */
@@ -178,6 +539,53 @@ int main(int argc, char** argv) {
                 case 3:
                     fname = optarg;
                     break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    resident = 1;
+                    break;
+                case 10:
+                    fused = 1;
+                    break;
+                case 11:
+                    if (strcmp(optarg, "atomic") == 0) {
+                        scatter = SCATTER_ATOMIC;
+                    } else if (strcmp(optarg, "color") == 0) {
+                        scatter = SCATTER_COLOR;
+                    } else if (strcmp(optarg, "csr") == 0) {
+                        scatter = SCATTER_CSR;
+                    } else if (strcmp(optarg, "warp") == 0) {
+                        scatter = SCATTER_WARP;
+                    } else if (strcmp(optarg, "shared") == 0) {
+                        scatter = SCATTER_SHARED;
+                    } else {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 12:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 13:
+                    warmup = atoi(optarg);
+                    break;
             }
         } else {
             print_help();
@@ -186,93 +594,293 @@ int main(int argc, char** argv) {
     }
 
     /* check for errors */
-    if (gt == NULL || nloops < 1) {
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1 ||
+            (fused && scatter != SCATTER_ATOMIC)) {
         print_help();
         exit(0);
     }
 
     // initialize data structures
-    rv = graph_init_soa(gt, NPOINTS, NEDGES, &gr, fname);
+    time0 = timer();
+    rv = graph_create(gt, np, ne, seed, fname, &el);
+    if (rv == 0) {
+        if (save != NULL) {
+            rv = graph_save(save, &el);
+        }
+        if (rv == 0) {
+            rv = graph_init_soa(&el, &gr, huge_pages);
+        }
+        npoints = el.npoints;
+        nedges = el.nedges;
+        graph_release(&el);
+    }
+    time1 = timer();
     if (rv < 0) {
         printf("Error creating graph. \n");
         exit(0);
     }
+    printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+            time1 - time0);
 
-    data_init();
-    edge_data_init();
+    cody_init("umma", argv[0]);
+    if (bench_init(&stats, nloops) < 0) {
+        printf("Error allocating timers. \n");
+        exit(0);
+    }
 
-    // allocate memory on the GPU
-    cudaMalloc((void**) &d_pt_data, NPOINTS * 3 * sizeof(float));
-    cudaMalloc((void**) &d_gr, sizeof(struct graph));
-    cudaMalloc((void**) &d_edge_data, NEDGES * sizeof(float));
+    if (data_alloc() < 0) {
+        printf("Error allocating data. \n");
+        exit(0);
+    }
+    nBlocks = (nedges / NTHREADS) + 1;
 
-    // loop
-    time0 = timer();
-    for (i = 0; i < nloops; i++) {
+    data_init();
+    edge_data_init();
 
-        /* 
-         * Edge Gather
-         */
-        // copy over 
-        cudaMemcpy(d_pt_data, pt_data, NPOINTS * 3 * sizeof(float),
-                cudaMemcpyHostToDevice);
-        cudaMemcpy(d_gr, &gr, sizeof(struct graph),
-                cudaMemcpyHostToDevice);
-        cudaMemcpy(d_edge_data, edge_data, NEDGES * sizeof(float),
-                cudaMemcpyHostToDevice);
+    // one pass on the graph as generated and, when reordering, one more
+    // on the reordered graph
+    npasses = (reorder == REORDER_NONE) ? 1 : 2;
+    for (pass = 0; pass < npasses; pass++) {
+        if (pass == 1) {
+            before = (time1 - time0) / ((float) nloops);
+
+            time0 = timer();
+            rv = graph_reorder_soa(reorder, npoints, nedges, &gr, vperm);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error reordering graph. \n");
+                exit(0);
+            }
+            printf("Reorder: %f s \n", time1 - time0);
 
-        // invoke kernel
-        edge_gather<<<nBlocks,NTHREADS>>>(d_pt_data, d_edge_data, d_gr, NEDGES);
+            // the point and edge data start out uniform, so are just reset
+            data_init();
+            edge_data_init();
+        }
 
-        // copy back
-        cudaMemcpy(&gr, d_gr, sizeof(struct graph),
-                cudaMemcpyDeviceToHost);
+        if (scatter == SCATTER_COLOR) {
+            time0 = timer();
+            ncolors = graph_color_soa(npoints, nedges, &gr, color_edges,
+                    color_start);
+            time1 = timer();
+            if (ncolors < 0) {
+                printf("Error coloring graph. \n");
+                exit(0);
+            }
+            printf("Colors: %d in %f s \n", ncolors, time1 - time0);
+        } else if (scatter == SCATTER_CSR) {
+            time0 = timer();
+            graph_csr_soa(npoints, nedges, &gr, csr_start, csr_edges);
+            time1 = timer();
+            printf("CSR: %f s \n", time1 - time0);
+        }
 
-        /*
-         * Edge Compute
-         */
-        // copy over
-        cudaMemcpy(d_gr, &gr, sizeof(struct graph),
+        // allocate memory on the GPU
+        cudaMalloc((void**) &d_pt_data, npoints * 3 * sizeof(float));
+        cudaMalloc((void**) &d_arrays.v0, nedges * sizeof(int));
+        cudaMalloc((void**) &d_arrays.v1, nedges * sizeof(int));
+        cudaMalloc((void**) &d_arrays.v0_data, nedges * 3 * sizeof(float));
+        cudaMalloc((void**) &d_arrays.v1_data, nedges * 3 * sizeof(float));
+        cudaMalloc((void**) &d_arrays.data, nedges * sizeof(float));
+        cudaMalloc((void**) &d_gr, sizeof(struct graph));
+        cudaMemcpy(d_gr, &d_arrays, sizeof(struct graph),
                 cudaMemcpyHostToDevice);
+        cudaMalloc((void**) &d_edge_data, nedges * sizeof(float));
 
-        // call kernel
-        edge_compute<<<nBlocks,NTHREADS>>>(d_gr, NEDGES);
-        
-        // copy back
-        cudaMemcpy(&gr, d_gr, sizeof(struct graph),
-                cudaMemcpyDeviceToHost);
-
-        /* 
-         * Edge Scatter
-         */
-        // copy over 
-        cudaMemcpy(d_pt_data, pt_data, NPOINTS * 3 * sizeof(float),
+        // the coloring and the csr only change with the graph, so they go
+        // over once
+        cudaMalloc((void**) &d_color_edges, nedges * sizeof(int));
+        cudaMemcpy(d_color_edges, color_edges, nedges * sizeof(int),
+                cudaMemcpyHostToDevice);
+        cudaMalloc((void**) &d_csr_start, (npoints + 1) * sizeof(int));
+        cudaMemcpy(d_csr_start, csr_start, (npoints + 1) * sizeof(int),
                 cudaMemcpyHostToDevice);
-        cudaMemcpy(d_gr, &gr, sizeof(struct graph),
+        cudaMalloc((void**) &d_csr_edges, 2 * nedges * sizeof(int));
+        cudaMemcpy(d_csr_edges, csr_edges, 2 * nedges * sizeof(int),
                 cudaMemcpyHostToDevice);
 
-        // call kernel
-        edge_scatter<<<nBlocks,NTHREADS>>>(d_pt_data, d_gr, NEDGES);
+        if (fused) {
+            cudaMalloc((void**) &d_pt_next, npoints * 3 * sizeof(float));
+        }
+
+        if (resident) {
+            // upload once
+            up0 = timer();
+            cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                    cudaMemcpyHostToDevice);
+            graph_copy(&d_arrays, &gr, cudaMemcpyHostToDevice);
+            cudaMemcpy(d_edge_data, edge_data, nedges * sizeof(float),
+                    cudaMemcpyHostToDevice);
+            up1 = timer();
+
+            // loop, launches only, after the warm-up loops. the phases
+            // wait for their kernels to be timed
+            for (i = -warmup; i < nloops; i++) {
+                if (i == 0) {
+                    // the device's points are reset after the warm-up, as
+                    // the host's are still the initial ones
+                    if (warmup > 0) {
+                        cudaMemcpy(d_pt_data, pt_data,
+                                npoints * 3 * sizeof(float),
+                                cudaMemcpyHostToDevice);
+                    }
+                    cudaDeviceSynchronize();
+                    time0 = timer();
+                }
+                bench_loop(&stats, i);
+                if (fused) {
+                    cudaMemcpy(d_pt_next, d_pt_data, npoints * 3 * sizeof(float),
+                            cudaMemcpyDeviceToDevice);
+                    edge_fused<<<nBlocks,NTHREADS>>>(d_pt_data, d_pt_next,
+                            d_edge_data, d_gr, nedges);
+                    tmp = d_pt_data; d_pt_data = d_pt_next; d_pt_next = tmp;
+                    cudaDeviceSynchronize();
+                    bench_phase(&stats, PHASE_FUSED);
+                } else {
+                    edge_gather<<<nBlocks,NTHREADS>>>(d_pt_data, d_edge_data,
+                            d_gr, nedges);
+                    cudaDeviceSynchronize();
+                    bench_phase(&stats, PHASE_GATHER);
+                    edge_compute<<<nBlocks,NTHREADS>>>(d_gr, nedges);
+                    cudaDeviceSynchronize();
+                    bench_phase(&stats, PHASE_COMPUTE);
+                    scatter_launch(scatter, d_pt_data, d_gr, d_color_edges,
+                            d_csr_start, d_csr_edges);
+                    cudaDeviceSynchronize();
+                    bench_phase(&stats, PHASE_SCATTER);
+                }
+            }
+            cudaDeviceSynchronize();
+            time1 = timer();
+
+            // download once
+            down0 = timer();
+            cudaMemcpy(pt_data, d_pt_data, npoints * 3 * sizeof(float),
+                    cudaMemcpyDeviceToHost);
+            down1 = timer();
+        } else {
+            // loop, copying around every kernel, after the warm-up
+            // loops. the phases include their copies
+            for (i = -warmup; i < nloops; i++) {
+                if (i == 0) {
+                    // the data are reset after the warm-up, as they start
+                    // out uniform
+                    if (warmup > 0) {
+                        data_init();
+                        edge_data_init();
+                    }
+                    time0 = timer();
+                }
+                bench_loop(&stats, i);
+                if (fused) {
+                    // the one kernel needs only the points, the graph and
+                    // the edge data over and the points back
+                    cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                            cudaMemcpyHostToDevice);
+                    cudaMemcpy(d_pt_next, pt_data, npoints * 3 * sizeof(float),
+                            cudaMemcpyHostToDevice);
+                    cudaMemcpy(d_arrays.v0, gr.v0, nedges * sizeof(int),
+                            cudaMemcpyHostToDevice);
+                    cudaMemcpy(d_arrays.v1, gr.v1, nedges * sizeof(int),
+                            cudaMemcpyHostToDevice);
+                    cudaMemcpy(d_edge_data, edge_data, nedges * sizeof(float),
+                            cudaMemcpyHostToDevice);
+
+                    edge_fused<<<nBlocks,NTHREADS>>>(d_pt_data, d_pt_next,
+                            d_edge_data, d_gr, nedges);
+
+                    cudaMemcpy(pt_data, d_pt_next, npoints * 3 * sizeof(float),
+                            cudaMemcpyDeviceToHost);
+                    bench_phase(&stats, PHASE_FUSED);
+                    continue;
+                }
+
+                /* 
+                 * Edge Gather
+                 */
+                // copy over 
+                cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                        cudaMemcpyHostToDevice);
+                graph_copy(&d_arrays, &gr, cudaMemcpyHostToDevice);
+                cudaMemcpy(d_edge_data, edge_data, nedges * sizeof(float),
+                        cudaMemcpyHostToDevice);
+
+                // invoke kernel
+                edge_gather<<<nBlocks,NTHREADS>>>(d_pt_data, d_edge_data, d_gr, nedges);
+
+                // copy back
+                graph_copy(&gr, &d_arrays, cudaMemcpyDeviceToHost);
+                bench_phase(&stats, PHASE_GATHER);
+
+                /*
+                 * Edge Compute
+                 */
+                // copy over
+                graph_copy(&d_arrays, &gr, cudaMemcpyHostToDevice);
+
+                // call kernel
+                edge_compute<<<nBlocks,NTHREADS>>>(d_gr, nedges);
         
-        // copy back
-        cudaMemcpy(pt_data, d_pt_data, NPOINTS * 3 * sizeof(float),
-                cudaMemcpyDeviceToHost);
+                // copy back
+                graph_copy(&gr, &d_arrays, cudaMemcpyDeviceToHost);
+                bench_phase(&stats, PHASE_COMPUTE);
+
+                /* 
+                 * Edge Scatter
+                 */
+                // copy over 
+                cudaMemcpy(d_pt_data, pt_data, npoints * 3 * sizeof(float),
+                        cudaMemcpyHostToDevice);
+                graph_copy(&d_arrays, &gr, cudaMemcpyHostToDevice);
+
+                // call kernel
+                scatter_launch(scatter, d_pt_data, d_gr, d_color_edges,
+                        d_csr_start, d_csr_edges);
+        
+                // copy back
+                cudaMemcpy(pt_data, d_pt_data, npoints * 3 * sizeof(float),
+                        cudaMemcpyDeviceToHost);
+                bench_phase(&stats, PHASE_SCATTER);
+            }
+            time1 = timer();
+        }
 
+        // free memory
+        cudaFree(d_pt_data);
+        if (fused) {
+            cudaFree(d_pt_next);
+        }
+        cudaFree(d_arrays.v0);
+        cudaFree(d_arrays.v1);
+        cudaFree(d_arrays.v0_data);
+        cudaFree(d_arrays.v1_data);
+        cudaFree(d_arrays.data);
+        cudaFree(d_gr);
+        cudaFree(d_edge_data);
+        cudaFree(d_color_edges);
+        cudaFree(d_csr_start);
+        cudaFree(d_csr_edges);
     }
-    time1 = timer();
 
-    // free memory
-    cudaFree(d_pt_data);
-    cudaFree(d_gr);
-    cudaFree(d_edge_data);
+    // print results, by the numbers of the generated graph
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = (reorder == REORDER_NONE) ? i : vperm[i];
+        printf("%i : %f %f %f \n", i, pt_data[3*v+0], 
+                pt_data[3*v+1], pt_data[3*v+2]);
+    }
 
-    // print results
-    for (i = 0; i < 10; i++) {
-        printf("%i : %f %f %f \n", i, pt_data[3*i+0], 
-                pt_data[3*i+1], pt_data[3*i+2]);
+    if (reorder != REORDER_NONE) {
+        printf("Time before reordering: %f s \n", before);
     }
 
     printf("Time: %f s \n", (time1 - time0) / ((float) nloops));
+    if (resident) {
+        printf("Upload: %f s \n", up1 - up0);
+        printf("Download: %f s \n", down1 - down0);
+    }
+    bench_report(&stats, npoints, nedges);
+    bench_free(&stats);
+    cody_finish();
 
     return 0;
 }
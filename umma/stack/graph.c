@@ -0,0 +1,388 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "graph.h"
+
+#define GRAPH_MAGIC "UMMAGRF1"
+
+/* the binary file: this header, then v0[nedges] and v1[nedges] as 32 bit
+ * ints in the host's byte order */
+struct graph_header {
+    char magic[8];
+    int64_t npoints;
+    int64_t nedges;
+};
+
+/* open addressed set of edges, for the random types to skip repeats */
+struct edge_set {
+    uint64_t* keys;
+    uint64_t mask;
+};
+
+/* splitmix64 */
+static uint64_t next_random(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/* uniform in [0, n) */
+static int random_point(uint64_t* state, int n) {
+    return (int) (((next_random(state) >> 32) * (uint64_t) n) >> 32);
+}
+
+static int set_init(struct edge_set* s, size_t n) {
+    size_t cap = 16;
+
+    while (cap < 2 * n) {
+        cap *= 2;
+    }
+    s->keys = (uint64_t*) calloc(cap, sizeof(uint64_t));
+    s->mask = cap - 1;
+
+    return (s->keys == NULL) ? -1 : 0;
+}
+
+/* adds edge (a, b), a < b, and returns 1, or 0 if it was there */
+static int set_add(struct edge_set* s, int a, int b) {
+    uint64_t key = ((uint64_t) a << 32 | (uint64_t) b) + 1;
+    uint64_t h = key * 0x9e3779b97f4a7c15ULL;
+    uint64_t k;
+
+    for (k = h >> 20 & s->mask; s->keys[k] != 0; k = (k + 1) & s->mask) {
+        if (s->keys[k] == key) {
+            return 0;
+        }
+    }
+    s->keys[k] = key;
+
+    return 1;
+}
+
+static int alloc_edges(struct edge_list* el, size_t n) {
+    el->v0 = (int*) malloc(n * sizeof(int) + 1);
+    el->v1 = (int*) malloc(n * sizeof(int) + 1);
+    el->map = NULL;
+    el->map_size = 0;
+    if (el->v0 == NULL || el->v1 == NULL) {
+        free(el->v0);
+        free(el->v1);
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Groups the edges by their lower point, keeping their order within a
+ * group, as walking graph.lua's tables did.
+ */
+static int group_edges(struct edge_list* el) {
+    int* start;
+    int* v0;
+    int* v1;
+    int i, v, k;
+
+    start = (int*) calloc(el->npoints + 1, sizeof(int));
+    v0 = (int*) malloc(el->nedges * sizeof(int) + 1);
+    v1 = (int*) malloc(el->nedges * sizeof(int) + 1);
+    if (start == NULL || v0 == NULL || v1 == NULL) {
+        free(start);
+        free(v0);
+        free(v1);
+        return -1;
+    }
+
+    for (i = 0; i < el->nedges; i++) {
+        start[el->v0[i] + 1]++;
+    }
+    for (v = 0; v < el->npoints; v++) {
+        start[v+1] += start[v];
+    }
+    for (i = 0; i < el->nedges; i++) {
+        k = start[el->v0[i]]++;
+        v0[k] = el->v0[i];
+        v1[k] = el->v1[i];
+    }
+
+    free(start);
+    free(el->v0);
+    free(el->v1);
+    el->v0 = v0;
+    el->v1 = v1;
+
+    return 0;
+}
+
+static int pure_random(struct edge_list* el, int npoints, int nedges,
+        uint64_t state) {
+    struct edge_set s;
+    int a, b, t, n;
+
+    if (nedges > (int64_t) npoints * (npoints - 1) / 2) {
+        fprintf(stderr, "%d edges do not fit %d points\n", nedges, npoints);
+        return -1;
+    }
+    if (alloc_edges(el, nedges) < 0) {
+        return -1;
+    }
+    if (set_init(&s, nedges) < 0) {
+        graph_release(el);
+        return -1;
+    }
+
+    n = 0;
+    while (n < nedges) {
+        a = random_point(&state, npoints);
+        b = random_point(&state, npoints);
+        if (a == b) {
+            continue;
+        }
+        if (a > b) {
+            t = a; a = b; b = t;
+        }
+        if (set_add(&s, a, b)) {
+            el->v0[n] = a;
+            el->v1[n] = b;
+            n++;
+        }
+    }
+    free(s.keys);
+    el->npoints = npoints;
+    el->nedges = n;
+
+    return 0;
+}
+
+static int regular_random(struct edge_list* el, int npoints, int degree,
+        uint64_t state) {
+    struct edge_set s;
+    size_t max = (size_t) npoints * degree;
+    int i, j, b, n;
+
+    if (max > INT32_MAX) {
+        fprintf(stderr, "%d edges per point overflow %d points\n", degree,
+                npoints);
+        return -1;
+    }
+    if (alloc_edges(el, max) < 0) {
+        return -1;
+    }
+    if (set_init(&s, max) < 0) {
+        graph_release(el);
+        return -1;
+    }
+
+    n = 0;
+    for (i = 0; i < npoints; i++) {
+        for (j = 0; j < degree; j++) {
+            do {
+                b = random_point(&state, npoints);
+            } while (b == i);
+            if (set_add(&s, i < b ? i : b, i < b ? b : i)) {
+                el->v0[n] = i < b ? i : b;
+                el->v1[n] = i < b ? b : i;
+                n++;
+            }
+        }
+    }
+    free(s.keys);
+    el->npoints = npoints;
+    el->nedges = n;
+
+    return 0;
+}
+
+static int contiguous(struct edge_list* el, int npoints) {
+    int i;
+
+    if (alloc_edges(el, npoints) < 0) {
+        return -1;
+    }
+    for (i = 0; i < npoints - 1; i++) {
+        el->v0[i] = i;
+        el->v1[i] = i + 1;
+    }
+    el->v0[npoints-1] = 0;
+    el->v1[npoints-1] = npoints - 1;
+    el->npoints = npoints;
+    el->nedges = npoints;
+
+    return 0;
+}
+
+/* graph.lua's x,y lines, counting the points from 1 */
+static int read_text(struct edge_list* el, FILE* f) {
+    size_t cap = 1024;
+    int* t;
+    int a, b, n, max;
+
+    if (alloc_edges(el, cap) < 0) {
+        return -1;
+    }
+    n = 0;
+    max = 0;
+    while (fscanf(f, "%d,%d", &a, &b) == 2) {
+        if (a < 1 || b < 1) {
+            graph_release(el);
+            return -1;
+        }
+        if ((size_t) n == cap) {
+            cap *= 2;
+            t = (int*) realloc(el->v0, cap * sizeof(int));
+            if (t != NULL) {
+                el->v0 = t;
+                t = (int*) realloc(el->v1, cap * sizeof(int));
+            }
+            if (t == NULL) {
+                graph_release(el);
+                return -1;
+            }
+            el->v1 = t;
+        }
+        el->v0[n] = a - 1;
+        el->v1[n] = b - 1;
+        max = (a > max) ? a : max;
+        max = (b > max) ? b : max;
+        n++;
+    }
+    el->npoints = max;
+    el->nedges = n;
+
+    return 0;
+}
+
+static int read_file(struct edge_list* el, const char* fname) {
+    struct graph_header h;
+    struct stat st;
+    FILE* f;
+    void* map;
+    int fd, rv;
+
+    fd = open(fname, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(fname);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+
+    if (st.st_size >= (off_t) sizeof(h) &&
+            read(fd, &h, sizeof(h)) == (ssize_t) sizeof(h) &&
+            memcmp(h.magic, GRAPH_MAGIC, 8) == 0) {
+        if (h.npoints < 1 || h.nedges < 1 || h.npoints > INT32_MAX ||
+                h.nedges > INT32_MAX || st.st_size != (off_t) (sizeof(h) +
+                2 * h.nedges * sizeof(int))) {
+            fprintf(stderr, "%s: bad graph file\n", fname);
+            close(fd);
+            return -1;
+        }
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (map == MAP_FAILED) {
+            perror(fname);
+            return -1;
+        }
+        el->npoints = (int) h.npoints;
+        el->nedges = (int) h.nedges;
+        el->v0 = (int*) ((char*) map + sizeof(h));
+        el->v1 = el->v0 + h.nedges;
+        el->map = map;
+        el->map_size = st.st_size;
+        return 0;
+    }
+
+    f = fdopen(fd, "r");
+    if (f == NULL) {
+        close(fd);
+        return -1;
+    }
+    rewind(f);
+    rv = read_text(el, f);
+    fclose(f);
+    if (rv == 0 && el->nedges == 0) {
+        graph_release(el);
+        rv = -1;
+    }
+    if (rv < 0) {
+        fprintf(stderr, "%s: bad graph file\n", fname);
+        return -1;
+    }
+
+    return 0;
+}
+
+int graph_create(const char* type, int npoints, int nedges,
+        unsigned long seed, const char* fname, struct edge_list* el) {
+    int rv;
+
+    if (strcmp(type, "file") == 0) {
+        return read_file(el, fname);
+    }
+
+    if (npoints < 2 || nedges < 1) {
+        fprintf(stderr, "need 2 points and 1 edge\n");
+        return -1;
+    }
+    if (strcmp(type, "pure_random") == 0) {
+        rv = pure_random(el, npoints, nedges, seed);
+    } else if (strcmp(type, "regular_random") == 0) {
+        rv = regular_random(el, npoints, nedges, seed);
+    } else if (strcmp(type, "contiguous") == 0) {
+        rv = contiguous(el, npoints);
+    } else {
+        fprintf(stderr, "Unknown graph type specified.\n");
+        return -1;
+    }
+    if (rv == 0 && group_edges(el) < 0) {
+        graph_release(el);
+        return -1;
+    }
+
+    return rv;
+}
+
+int graph_save(const char* fname, const struct edge_list* el) {
+    struct graph_header h;
+    FILE* f;
+    int ok;
+
+    memcpy(h.magic, GRAPH_MAGIC, 8);
+    h.npoints = el->npoints;
+    h.nedges = el->nedges;
+
+    f = fopen(fname, "wb");
+    if (f == NULL) {
+        perror(fname);
+        return -1;
+    }
+    ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+        fwrite(el->v0, sizeof(int), el->nedges, f) == (size_t) el->nedges &&
+        fwrite(el->v1, sizeof(int), el->nedges, f) == (size_t) el->nedges;
+    if (fclose(f) != 0 || !ok) {
+        perror(fname);
+        return -1;
+    }
+
+    return 0;
+}
+
+void graph_release(struct edge_list* el) {
+    if (el->map != NULL) {
+        munmap(el->map, el->map_size);
+    } else {
+        free(el->v0);
+        free(el->v1);
+    }
+    el->v0 = NULL;
+    el->v1 = NULL;
+    el->map = NULL;
+}
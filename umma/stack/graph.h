@@ -0,0 +1,52 @@
+#ifndef _graph_h_
+#define _graph_h_
+
+#include <stddef.h>
+
+/* default seed of the random types */
+#define GRAPH_SEED 17
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Edges as generated or read, edge i joining v0[i] and v1[i], counting the
+ * points from 0. Generated edges have v0[i] < v1[i]. A graph read from a
+ * binary file points into its mapping.
+ */
+struct edge_list {
+    int npoints;
+    int nedges;
+    int* v0;
+    int* v1;
+    void* map;
+    size_t map_size;
+};
+
+/*
+ * Creates a graph of the given type, as graph.lua did:
+ *
+ *   pure_random     nedges distinct random edges
+ *   regular_random  about nedges random edges from every point
+ *   contiguous      the ring (0,1), (1,2) ... (npoints-1,0)
+ *   file            read from fname, in the binary format graph_save
+ *                   writes (mapped) or as graph.lua's x,y text lines
+ *
+ * The edges come grouped by their lower point. The random types are the
+ * same for the same seed. Returns 0, or -1 with a message on stderr.
+ */
+int graph_create(const char* type, int npoints, int nedges,
+        unsigned long seed, const char* fname, struct edge_list* el);
+
+/* Writes el to fname in the binary format. Returns 0 or -1 */
+int graph_save(const char* fname, const struct edge_list* el);
+
+/* Frees or unmaps the edges of el */
+void graph_release(struct edge_list* el);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
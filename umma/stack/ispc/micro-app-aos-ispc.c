@@ -1,18 +1,51 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
 #include <getopt.h>
-#include <lua.h>
-#include <lauxlib.h>
-#include <lualib.h>
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
+#include "graph.h"
+#include "reorder.h"
 #include "micro-app-aos.h"
 
+/* defaults for --npoints and --nedges */
 #define NPOINTS 10000
 #define NEDGES  10000
 
-struct edge edges[NEDGES];
-float pt_data[NPOINTS][3];
-float edge_data[NEDGES];
+/* scatter strategies */
+#define SCATTER_ATOMIC 0
+#define SCATTER_COLOR  1
+#define SCATTER_CSR    2
+
+/* sizes of the graph, see graph_alloc */
+int npoints;
+int nedges;
+int huge_pages = 0;
+
+struct edge* edges;
+float (*pt_data)[3];
+/* the points the fused passes add to, see edge_fused */
+float (*pt_next)[3];
+float* edge_data;
+
+/* edges by color, color c's being color_edges[color_start[c]] to
+ * color_edges[color_start[c+1]-1] */
+int* color_edges;
+int* color_start;
+int ncolors;
+int* color_mark;
+
+/* incident edges of every vertex, see csr_init */
+int* csr_start;
+int* csr_edges;
+
+/* new number of every vertex and old position of every edge, see
+ * graph_reorder */
+int* vperm;
+int* eperm;
+int* reorder_v0;
+int* reorder_v1;
 
 void print_help() {
     printf("Usage: \n");
@@ -25,76 +58,79 @@ void print_help() {
     printf("\t --nloops Number of repetitions, must be \n");
     printf("\t          at least one. \n");
     printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --scatter Scatter strategy, one of:\n");
+    printf("\t\t\t atomic (default) \n");
+    printf("\t\t\t color \n");
+    printf("\t\t\t csr \n");
+    printf("\t --fused Gather, compute and scatter in one pass \n");
+    printf("\t --reorder Reordering for locality, one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
+    printf("\t --tasks Launch this many tasks per kernel, with --scatter \n");
+    printf("\t         color or csr (0, one core) \n");
 }
 
 double timer() {
-    struct timeval tp;
-    struct timezone tzp;
-    long i;
-
-    i = gettimeofday(&tp, &tzp);
-    return ((double)tp.tv_sec) + ((double) tp.tv_usec) * 1e-6;
+    return cody_now();
 }
 
-int graph_init(char* graph_type, char* fname) {
-    lua_State *L;
-    int i, j, k, v;
-
-    L = luaL_newstate();
-    luaL_openlibs(L);
-    luaL_loadfile(L, "graph.lua");
-    lua_pcall(L, 0, 0, 0);
-
-    lua_getglobal(L, "create_graph");
-    lua_pushstring(L, graph_type);
-    lua_pushinteger(L, NPOINTS);
-    lua_pushinteger(L, NEDGES);
-
-    if (fname != NULL) {
-        lua_pushstring(L, fname);
-        lua_call(L, 4, 1);
-    } else {
-        lua_call(L, 3, 1);
-    }
-
-    /* Table is now sitting at the top of the stack */
-    i = 0;
-    lua_pushnil(L);  /* Make sure lua_next starts at beginning */
-    while (lua_next(L, -2) != 0) {
-        // fetch first key
-        k = lua_tointeger(L, -2);
-        lua_pushnil(L);
-        while (lua_next(L, -2) != 0) { // loop over neighbors
-            lua_pop(L,1);
-            v = lua_tointeger(L, -1);
-
-            // build edges array here
-            edges[i].v0 = k - 1;
-            edges[i].v1 = v - 1;
-
-            for (j = 0; j < 3; j++) {
-                edges[i].v0_pt_data[j] = 0;
-                edges[i].v1_pt_data[j] = 0;
-            }
-
-            i++;
-        }
-        lua_pop(L,1);
+/*
+ * Allocates the graph for np points and ne edges, zeroed, and the point
+ * and edge data.
+ */
+int graph_alloc(int np, int ne) {
+    npoints = np;
+    nedges = ne;
+
+    edges = (struct edge*) umma_alloc(ne, sizeof(struct edge), huge_pages);
+    pt_data = (float (*)[3]) umma_alloc(np, 3 * sizeof(float), huge_pages);
+    edge_data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    if (edges == NULL || pt_data == NULL || edge_data == NULL) {
+        return -1;
     }
 
-    lua_close(L);
+    return 0;
+}
+
+/*
+ * Creates the graph with graph_create, writes it to save unless that is
+ * NULL, and copies its edges into the graph's arrays.
+ */
+int graph_init(char* graph_type, int np, int ne, unsigned long seed,
+        char* fname, char* save) {
+    struct edge_list el;
+    int i;
 
-    if (i == 0) {
+    if (graph_create(graph_type, np, ne, seed, fname, &el) < 0) {
+        return -1;
+    }
+    if ((save != NULL && graph_save(save, &el) < 0) ||
+            graph_alloc(el.npoints, el.nedges) < 0) {
+        graph_release(&el);
         return -1;
-    } else {
-        return 0;
     }
+
+    for (i = 0; i < nedges; i++) {
+        edges[i].v0 = el.v0[i];
+        edges[i].v1 = el.v1[i];
+    }
+    graph_release(&el);
+
+    return 0;
 }
 
 int data_init() {
     int i;
 
-    for (i = 0; i < NPOINTS; i++) {
+    for (i = 0; i < npoints; i++) {
         pt_data[i][0] = 1;
         pt_data[i][1] = 1;
         pt_data[i][2] = 1;
@@ -106,13 +142,133 @@ int data_init() {
 int edge_data_init() {
     int i;
 
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         edge_data[i] = 1;
     }
 
     return 0;
 }
 
+/*
+ * Greedy edge coloring. Each color takes, in order, the uncolored edges
+ * that share no vertex with an edge it already has, so the edges of a
+ * color can scatter in parallel without atomics.
+ */
+int color_init() {
+    int c, k, next, e, v0, v1;
+
+    if (color_edges == NULL) {
+        color_edges = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        color_start = (int*) umma_alloc(nedges + 1, sizeof(int), huge_pages);
+        color_mark = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        if (color_edges == NULL || color_start == NULL ||
+                color_mark == NULL) {
+            return -1;
+        }
+    }
+
+    for (k = 0; k < nedges; k++) {
+        color_edges[k] = k;
+    }
+    for (k = 0; k < npoints; k++) {
+        color_mark[k] = -1;
+    }
+
+    next = 0;
+    for (c = 0; next < nedges; c++) {
+        color_start[c] = next;
+        // move the edges this color can take to the front of the rest
+        for (k = next; k < nedges; k++) {
+            e = color_edges[k];
+            v0 = edges[e].v0;
+            v1 = edges[e].v1;
+            if (color_mark[v0] != c && color_mark[v1] != c) {
+                color_mark[v0] = c;
+                color_mark[v1] = c;
+                color_edges[k] = color_edges[next];
+                color_edges[next++] = e;
+            }
+        }
+    }
+    color_start[c] = next;
+    ncolors = c;
+
+    return 0;
+}
+
+/*
+ * Incident edges of every vertex, vertex v's being csr_edges[csr_start[v]]
+ * to csr_edges[csr_start[v+1]-1], each as 2 * edge + 0 if v is its v0 or
+ * + 1 if v is its v1.
+ */
+int csr_init() {
+    int i, v;
+
+    if (csr_edges == NULL) {
+        csr_start = (int*) umma_alloc(npoints + 1, sizeof(int), huge_pages);
+        csr_edges = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+        if (csr_start == NULL || csr_edges == NULL) {
+            return -1;
+        }
+    }
+
+    for (v = 0; v <= npoints; v++) {
+        csr_start[v] = 0;
+    }
+    for (i = 0; i < nedges; i++) {
+        csr_start[edges[i].v0 + 1]++;
+        csr_start[edges[i].v1 + 1]++;
+    }
+    for (v = 0; v < npoints; v++) {
+        csr_start[v+1] += csr_start[v];
+    }
+    // fill, using csr_start[v] as v's next free slot
+    for (i = 0; i < nedges; i++) {
+        csr_edges[csr_start[edges[i].v0]++] = 2 * i;
+        csr_edges[csr_start[edges[i].v1]++] = 2 * i + 1;
+    }
+    for (v = npoints; v > 0; v--) {
+        csr_start[v] = csr_start[v-1];
+    }
+    csr_start[0] = 0;
+
+    return 0;
+}
+
+/*
+ * Renumbers the vertices and reorders the edges for locality, see
+ * reorder.h. vperm keeps every vertex's new number for the output.
+ */
+int graph_reorder(int method) {
+    int i;
+
+    if (vperm == NULL) {
+        vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        eperm = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v0 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v1 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        if (vperm == NULL || eperm == NULL || reorder_v0 == NULL ||
+                reorder_v1 == NULL) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nedges; i++) {
+        reorder_v0[i] = edges[i].v0;
+        reorder_v1[i] = edges[i].v1;
+    }
+    if (reorder_graph(method, npoints, nedges, reorder_v0, reorder_v1,
+                vperm, eperm) < 0) {
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        edges[i].v0 = vperm[reorder_v0[eperm[i]]];
+        edges[i].v1 = vperm[reorder_v1[eperm[i]]];
+    }
+
+    return 0;
+}
+
 int main(int argc, char** argv) {
     int i;
     int rv;
@@ -121,12 +277,36 @@ int main(int argc, char** argv) {
     int nloops = 0;
     char* gt = "";
     char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    int scatter = SCATTER_ATOMIC;
+    int reorder = REORDER_NONE;
+    int fused = 0;
+    int warmup = 1;
+    int ntasks = 0;
+    struct bench stats;
+    float (*tmp)[3];
+    int pass, npasses, v;
+    double before = 0;
 
     static struct option long_opts[] = {
         {"help",   no_argument,       0, 0},
         {"type",   required_argument, 0, 0},
         {"nloops", required_argument, 0, 0},
-        {"file",   required_argument, 0, 0}
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"scatter", required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"fused",  no_argument,       0, 0},
+        {"warmup", required_argument, 0, 0},
+        {"tasks",  required_argument, 0, 0},
+        {0, 0, 0, 0}
     };
 
     /* Parse command-line arguments */
@@ -152,6 +332,49 @@ int main(int argc, char** argv) {
                 case 3:
                     fname = optarg;
                     break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    if (strcmp(optarg, "atomic") == 0) {
+                        scatter = SCATTER_ATOMIC;
+                    } else if (strcmp(optarg, "color") == 0) {
+                        scatter = SCATTER_COLOR;
+                    } else if (strcmp(optarg, "csr") == 0) {
+                        scatter = SCATTER_CSR;
+                    } else {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 10:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 11:
+                    fused = 1;
+                    break;
+                case 12:
+                    warmup = atoi(optarg);
+                    break;
+                case 13:
+                    ntasks = atoi(optarg);
+                    break;
             }
         } else {
             print_help();
@@ -160,38 +383,169 @@ int main(int argc, char** argv) {
     }
 
     /* check for errors */
-    if (gt == NULL || nloops < 1) {
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1 ||
+            ntasks < 0 || (ntasks > 0 && scatter == SCATTER_ATOMIC)) {
         print_help();
         exit(0);
     }
 
     
     // initialize data structures
-    rv = graph_init(gt, fname);
+    time0 = timer();
+    rv = graph_init(gt, np, ne, seed, fname, save);
+    time1 = timer();
     if (rv < 0) {
         printf("Error creating graph. \n");
         exit(0);
     }
+    printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+            time1 - time0);
+
+    cody_init("umma", argv[0]);
+    if (bench_init(&stats, nloops) < 0) {
+        printf("Error allocating timers. \n");
+        exit(0);
+    }
+
+    if (fused) {
+        pt_next = (float (*)[3]) umma_alloc(npoints, 3 * sizeof(float),
+                huge_pages);
+        if (pt_next == NULL) {
+            printf("Error allocating points. \n");
+            exit(0);
+        }
+    }
 
     data_init();
     edge_data_init();
 
-    // loop
-    time0 = timer();
-    for (i = 0; i < nloops; i++) {
-        edge_gather(NEDGES, edges, pt_data, edge_data);
-        edge_compute(NEDGES, edges);
-        edge_scatter(NEDGES, edges, pt_data);
+    // one pass on the graph as generated and, when reordering, one more
+    // on the reordered graph
+    npasses = (reorder == REORDER_NONE) ? 1 : 2;
+    for (pass = 0; pass < npasses; pass++) {
+        if (pass == 1) {
+            before = (time1 - time0) / ((float) nloops);
+
+            time0 = timer();
+            rv = graph_reorder(reorder);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error reordering graph. \n");
+                exit(0);
+            }
+            printf("Reorder: %f s \n", time1 - time0);
+
+            // the point and edge data start out uniform, so are just reset
+            data_init();
+            edge_data_init();
+        }
+
+        if (scatter == SCATTER_COLOR) {
+            time0 = timer();
+            rv = color_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error coloring graph. \n");
+                exit(0);
+            }
+            printf("Colors: %d in %f s \n", ncolors, time1 - time0);
+        } else if (scatter == SCATTER_CSR) {
+            time0 = timer();
+            rv = csr_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error building CSR. \n");
+                exit(0);
+            }
+            printf("CSR: %f s \n", time1 - time0);
+        }
+
+        // loop, after the warm-up loops
+        for (i = -warmup; i < nloops; i++) {
+            if (i == 0) {
+                // the data are reset after the warm-up, as they start out
+                // uniform
+                if (warmup > 0) {
+                    data_init();
+                    edge_data_init();
+                }
+                time0 = timer();
+            }
+            bench_loop(&stats, i);
+            if (fused) {
+                // the passes read pt_data and write pt_next, then swap
+                if (scatter == SCATTER_CSR && ntasks > 0) {
+                    vertex_fused_tasks(ntasks, npoints, edges, pt_data,
+                            pt_next, edge_data, csr_start, csr_edges);
+                } else if (scatter == SCATTER_CSR) {
+                    vertex_fused(npoints, edges, pt_data, pt_next, edge_data,
+                            csr_start, csr_edges);
+                } else {
+                    memcpy(pt_next, pt_data, npoints * 3 * sizeof(float));
+                    if (scatter == SCATTER_COLOR && ntasks > 0) {
+                        edge_fused_color_tasks(ntasks, ncolors, edges,
+                                pt_data, pt_next, edge_data, color_edges,
+                                color_start);
+                    } else if (scatter == SCATTER_COLOR) {
+                        edge_fused_color(ncolors, edges, pt_data, pt_next,
+                                edge_data, color_edges, color_start);
+                    } else {
+                        edge_fused(nedges, edges, pt_data, pt_next, edge_data);
+                    }
+                }
+                tmp = pt_data;
+                pt_data = pt_next;
+                pt_next = tmp;
+                bench_phase(&stats, PHASE_FUSED);
+            } else {
+                if (ntasks > 0) {
+                    edge_gather_tasks(ntasks, nedges, edges, pt_data,
+                            edge_data);
+                } else {
+                    edge_gather(nedges, edges, pt_data, edge_data);
+                }
+                bench_phase(&stats, PHASE_GATHER);
+                if (ntasks > 0) {
+                    edge_compute_tasks(ntasks, nedges, edges);
+                } else {
+                    edge_compute(nedges, edges);
+                }
+                bench_phase(&stats, PHASE_COMPUTE);
+                if (scatter == SCATTER_COLOR && ntasks > 0) {
+                    edge_scatter_color_tasks(ntasks, ncolors, edges, pt_data,
+                            color_edges, color_start);
+                } else if (scatter == SCATTER_CSR && ntasks > 0) {
+                    vertex_scatter_tasks(ntasks, npoints, edges, pt_data,
+                            csr_start, csr_edges);
+                } else if (scatter == SCATTER_COLOR) {
+                    edge_scatter_color(ncolors, edges, pt_data, color_edges,
+                            color_start);
+                } else if (scatter == SCATTER_CSR) {
+                    vertex_scatter(npoints, edges, pt_data, csr_start,
+                            csr_edges);
+                } else {
+                    edge_scatter(nedges, edges, pt_data);
+                }
+                bench_phase(&stats, PHASE_SCATTER);
+            }
+        }
+        time1 = timer();
     }
-    time1 = timer();
 
 
-    // print results
-    for (i = 0; i < 10; i++) {
-        printf("%i : %f %f %f \n", i, pt_data[i][0], pt_data[i][1], pt_data[i][2]);
+    // print results, by the numbers of the generated graph
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = (reorder == REORDER_NONE) ? i : vperm[i];
+        printf("%i : %f %f %f \n", i, pt_data[v][0], pt_data[v][1], pt_data[v][2]);
     }
 
+    if (reorder != REORDER_NONE) {
+        printf("Time before reordering: %f s \n", before);
+    }
     printf("Time: %f s \n", (time1 - time0) / ((float) nloops));
+    bench_report(&stats, npoints, nedges);
+    bench_free(&stats);
+    cody_finish();
 
     return 0;
 }
@@ -30,8 +30,19 @@ struct edge {
 extern "C" {
 #endif // __cplusplus
     extern void edge_compute(int32_t nedges, struct edge * edges);
+    extern void edge_compute_tasks(int32_t ntasks, int32_t nedges, struct edge * edges);
+    extern void edge_fused(int32_t nedges, struct edge * edges, float pt_data[][3], float pt_next[][3], float * edge_data);
+    extern void edge_fused_color(int32_t ncolors, struct edge * edges, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * color_edges, int32_t * color_start);
+    extern void edge_fused_color_tasks(int32_t ntasks, int32_t ncolors, struct edge * edges, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * color_edges, int32_t * color_start);
     extern void edge_gather(int32_t nedges, struct edge * edges, float pt_data[][3], float * edge_data);
+    extern void edge_gather_tasks(int32_t ntasks, int32_t nedges, struct edge * edges, float pt_data[][3], float * edge_data);
     extern void edge_scatter(int32_t nedges, struct edge * edges, float pt_data[][3]);
+    extern void edge_scatter_color(int32_t ncolors, struct edge * edges, float pt_data[][3], int32_t * color_edges, int32_t * color_start);
+    extern void edge_scatter_color_tasks(int32_t ntasks, int32_t ncolors, struct edge * edges, float pt_data[][3], int32_t * color_edges, int32_t * color_start);
+    extern void vertex_scatter(int32_t npoints, struct edge * edges, float pt_data[][3], int32_t * csr_start, int32_t * csr_edges);
+    extern void vertex_scatter_tasks(int32_t ntasks, int32_t npoints, struct edge * edges, float pt_data[][3], int32_t * csr_start, int32_t * csr_edges);
+    extern void vertex_fused(int32_t npoints, struct edge * edges, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * csr_start, int32_t * csr_edges);
+    extern void vertex_fused_tasks(int32_t ntasks, int32_t npoints, struct edge * edges, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * csr_start, int32_t * csr_edges);
 #if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
 } /* end extern C */
 #endif // __cplusplus
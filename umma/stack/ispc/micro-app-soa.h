@@ -15,11 +15,11 @@
 namespace ispc { /* namespace */
 #endif // __cplusplus
 struct graph {
-    int32_t v0[10];
-    int32_t v1[10];
-    float v0_data[10][3];
-    float v1_data[10][3];
-    float data[10];
+    int32_t * v0;
+    int32_t * v1;
+    float * v0_data;
+    float * v1_data;
+    float * data;
 };
 
 
@@ -30,8 +30,19 @@ struct graph {
 extern "C" {
 #endif // __cplusplus
     extern void edge_compute(int32_t nedges, struct graph * g);
+    extern void edge_compute_tasks(int32_t ntasks, int32_t nedges, struct graph * g);
+    extern void edge_fused(int32_t nedges, struct graph * g, float pt_data[][3], float pt_next[][3], float * edge_data);
+    extern void edge_fused_color(int32_t ncolors, struct graph * g, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * color_edges, int32_t * color_start);
+    extern void edge_fused_color_tasks(int32_t ntasks, int32_t ncolors, struct graph * g, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * color_edges, int32_t * color_start);
     extern void edge_gather(int32_t nedges, struct graph * g, float pt_data[][3], float * edge_data);
+    extern void edge_gather_tasks(int32_t ntasks, int32_t nedges, struct graph * g, float pt_data[][3], float * edge_data);
     extern void edge_scatter(int32_t nedges, struct graph * g, float pt_data[][3]);
+    extern void edge_scatter_color(int32_t ncolors, struct graph * g, float pt_data[][3], int32_t * color_edges, int32_t * color_start);
+    extern void edge_scatter_color_tasks(int32_t ntasks, int32_t ncolors, struct graph * g, float pt_data[][3], int32_t * color_edges, int32_t * color_start);
+    extern void vertex_scatter(int32_t npoints, struct graph * g, float pt_data[][3], int32_t * csr_start, int32_t * csr_edges);
+    extern void vertex_scatter_tasks(int32_t ntasks, int32_t npoints, struct graph * g, float pt_data[][3], int32_t * csr_start, int32_t * csr_edges);
+    extern void vertex_fused(int32_t npoints, struct graph * g, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * csr_start, int32_t * csr_edges);
+    extern void vertex_fused_tasks(int32_t ntasks, int32_t npoints, struct graph * g, float pt_data[][3], float pt_next[][3], float * edge_data, int32_t * csr_start, int32_t * csr_edges);
 #if defined(__cplusplus) && !defined(__ISPC_NO_EXTERN_C)
 } /* end extern C */
 #endif // __cplusplus
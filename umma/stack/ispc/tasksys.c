@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <omp.h>
+
+/*
+ * The task system ispc's launch and sync call, on OpenMP. ISPCLaunch runs
+ * the tasks across the OpenMP threads and returns when they are done, so
+ * a sync has only the launches' arguments to free. The kernels launch no
+ * tasks from tasks.
+ */
+
+/* the task function ispc generates for a launch */
+typedef void (*task_func)(void* data, int thread_index, int thread_count,
+        int task_index, int task_count, int task_index0, int task_index1,
+        int task_index2, int task_count0, int task_count1, int task_count2);
+
+/* the argument blocks of a function's launches, up to its sync */
+struct task_group {
+    void** blocks;
+    int nblocks;
+    int cap;
+};
+
+static void* task_fail() {
+    fprintf(stderr, "Out of memory launching tasks\n");
+    exit(1);
+    return NULL;
+}
+
+void* ISPCAlloc(void** handle, int64_t size, int32_t alignment) {
+    struct task_group* g = (struct task_group*) *handle;
+    void** blocks;
+    void* p;
+
+    if (g == NULL) {
+        g = (struct task_group*) calloc(1, sizeof(struct task_group));
+        if (g == NULL) {
+            return task_fail();
+        }
+        *handle = g;
+    }
+    if (g->nblocks == g->cap) {
+        g->cap = (g->cap == 0) ? 16 : 2 * g->cap;
+        blocks = (void**) realloc(g->blocks, g->cap * sizeof(void*));
+        if (blocks == NULL) {
+            return task_fail();
+        }
+        g->blocks = blocks;
+    }
+    if (posix_memalign(&p, alignment < (int32_t) sizeof(void*) ?
+                sizeof(void*) : alignment, size) != 0) {
+        return task_fail();
+    }
+    g->blocks[g->nblocks++] = p;
+
+    return p;
+}
+
+void ISPCLaunch(void** handle, void* f, void* data, int count0, int count1,
+        int count2) {
+    int n = count0 * count1 * count2;
+    int k;
+
+#pragma omp parallel for schedule(dynamic)
+    for (k = 0; k < n; k++) {
+        ((task_func) f)(data, omp_get_thread_num(), omp_get_num_threads(),
+                k, n, k % count0, (k / count0) % count1,
+                k / (count0 * count1), count0, count1, count2);
+    }
+}
+
+void ISPCSync(void* handle) {
+    struct task_group* g = (struct task_group*) handle;
+    int k;
+
+    if (g == NULL) {
+        return;
+    }
+    for (k = 0; k < g->nblocks; k++) {
+        free(g->blocks[k]);
+    }
+    free(g->blocks);
+    free(g);
+}
@@ -0,0 +1,746 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
+#include "graph.h"
+#include "reorder.h"
+
+/* defaults for --npoints and --nedges */
+#define NPOINTS 10000
+#define NEDGES  10000
+
+/* see --scatter */
+#define SCATTER_ATOMIC 0
+#define SCATTER_COLOR  1
+
+struct edge {
+    int v0;
+    int v1;
+    float data;
+    float v0_pt_data[3];
+    float v1_pt_data[3];
+};
+
+/* sizes of the graph, see graph_alloc */
+int npoints;
+int nedges;
+int huge_pages = 0;
+
+struct edge* edges;
+float (*pt_data)[3];
+/* the points the fused pass adds to, see edge_fused */
+float (*pt_next)[3];
+float* edge_data;
+
+/* new number of every vertex and old position of every edge, see
+ * graph_reorder */
+int* vperm;
+int* eperm;
+int* reorder_v0;
+int* reorder_v1;
+
+/* edges by color, color c's being color_edges[color_start[c]] to
+ * color_edges[color_start[c+1]-1] */
+int* color_edges;
+int* color_start;
+int ncolors;
+int* color_mark;
+
+void print_help() {
+    printf("Usage: \n");
+    printf("\t --help print this message and exit \n");
+    printf("\t --type Type of graph, must be one of:\n");
+    printf("\t\t\t pure_random \n");
+    printf("\t\t\t regular_random \n");
+    printf("\t\t\t contiguous \n");
+    printf("\t\t\t file \n");
+    printf("\t --nloops Number of repetitions, must be \n");
+    printf("\t          at least one. \n");
+    printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --scatter Scatter strategy, one of:\n");
+    printf("\t\t\t atomic (default) \n");
+    printf("\t\t\t color \n");
+    printf("\t --fused Gather, compute and scatter in one pass \n");
+    printf("\t --reorder Reordering for locality, one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
+}
+
+double timer() {
+    return cody_now();
+}
+
+/*
+ * Allocates the graph for np points and ne edges, zeroed, and the point
+ * and edge data.
+ */
+int graph_alloc(int np, int ne) {
+    npoints = np;
+    nedges = ne;
+
+    edges = (struct edge*) umma_alloc(ne, sizeof(struct edge), huge_pages);
+    pt_data = (float (*)[3]) umma_alloc(np, 3 * sizeof(float), huge_pages);
+    pt_next = (float (*)[3]) umma_alloc(np, 3 * sizeof(float), huge_pages);
+    edge_data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    if (edges == NULL || pt_data == NULL || pt_next == NULL ||
+            edge_data == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Creates the graph with graph_create, writes it to save unless that is
+ * NULL, and copies its edges into the graph's arrays.
+ */
+int graph_init(char* graph_type, int np, int ne, unsigned long seed,
+        char* fname, char* save) {
+    struct edge_list el;
+    int i;
+
+    if (graph_create(graph_type, np, ne, seed, fname, &el) < 0) {
+        return -1;
+    }
+    if ((save != NULL && graph_save(save, &el) < 0) ||
+            graph_alloc(el.npoints, el.nedges) < 0) {
+        graph_release(&el);
+        return -1;
+    }
+
+    for (i = 0; i < nedges; i++) {
+        edges[i].v0 = el.v0[i];
+        edges[i].v1 = el.v1[i];
+    }
+    graph_release(&el);
+
+    return 0;
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/*
+ * The kernels run on the device on the arrays data_upload mapped. They
+ * take the arrays as local pointers, which a target region turns into
+ * their device addresses.
+ */
+int edge_gather() {
+    int i;
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    float* ed = edge_data;
+    int n = nedges;
+
+#pragma omp target teams distribute parallel for
+    for (i = 0; i < n; i++) {
+        int a = e[i].v0;
+        int b = e[i].v1;
+
+        e[i].v0_pt_data[0] = pt[a][0];
+        e[i].v0_pt_data[1] = pt[a][1];
+        e[i].v0_pt_data[2] = pt[a][2];
+
+        e[i].v1_pt_data[0] = pt[b][0];
+        e[i].v1_pt_data[1] = pt[b][1];
+        e[i].v1_pt_data[2] = pt[b][2];
+
+        e[i].data = ed[i];
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int i;
+    struct edge* e = edges;
+    int n = nedges;
+
+#pragma omp target teams distribute parallel for
+    for (i = 0; i < n; i++) {
+        float x0 = (e[i].v0_pt_data[0] + e[i].v1_pt_data[0]) * e[i].data;
+        float x1 = (e[i].v0_pt_data[1] + e[i].v1_pt_data[1]) * e[i].data;
+        float x2 = (e[i].v0_pt_data[2] + e[i].v1_pt_data[2]) * e[i].data;
+
+        e[i].v0_pt_data[0] = x0;
+        e[i].v0_pt_data[1] = x1;
+        e[i].v0_pt_data[2] = x2;
+
+        e[i].v1_pt_data[0] = x0;
+        e[i].v1_pt_data[1] = x1;
+        e[i].v1_pt_data[2] = x2;
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    int i;
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    int n = nedges;
+
+#pragma omp target teams distribute parallel for
+    for (i = 0; i < n; i++) {
+        int a = e[i].v0;
+        int b = e[i].v1;
+
+#pragma omp atomic
+        pt[a][0] += e[i].v0_pt_data[0];
+#pragma omp atomic
+        pt[a][1] += e[i].v0_pt_data[1];
+#pragma omp atomic
+        pt[a][2] += e[i].v0_pt_data[2];
+
+#pragma omp atomic
+        pt[b][0] += e[i].v1_pt_data[0];
+#pragma omp atomic
+        pt[b][1] += e[i].v1_pt_data[1];
+#pragma omp atomic
+        pt[b][2] += e[i].v1_pt_data[2];
+    }
+
+    return 0;
+}
+
+/*
+ * Greedy edge coloring. Each color takes, in order, the uncolored edges
+ * that share no vertex with an edge it already has, so the edges of a
+ * color can scatter in parallel without atomics.
+ */
+int color_init() {
+    int c, k, next, e, v0, v1;
+
+    if (color_edges == NULL) {
+        color_edges = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        color_start = (int*) umma_alloc(nedges + 1, sizeof(int), huge_pages);
+        color_mark = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        if (color_edges == NULL || color_start == NULL ||
+                color_mark == NULL) {
+            return -1;
+        }
+    }
+
+    for (k = 0; k < nedges; k++) {
+        color_edges[k] = k;
+    }
+    for (k = 0; k < npoints; k++) {
+        color_mark[k] = -1;
+    }
+
+    next = 0;
+    for (c = 0; next < nedges; c++) {
+        color_start[c] = next;
+        // move the edges this color can take to the front of the rest
+        for (k = next; k < nedges; k++) {
+            e = color_edges[k];
+            v0 = edges[e].v0;
+            v1 = edges[e].v1;
+            if (color_mark[v0] != c && color_mark[v1] != c) {
+                color_mark[v0] = c;
+                color_mark[v1] = c;
+                color_edges[k] = color_edges[next];
+                color_edges[next++] = e;
+            }
+        }
+    }
+    color_start[c] = next;
+    ncolors = c;
+
+    return 0;
+}
+
+/* edge_scatter color by color, a kernel per color, without atomics */
+int edge_scatter_color() {
+    int c, k, start, end;
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    int* ce = color_edges;
+
+    for (c = 0; c < ncolors; c++) {
+        start = color_start[c];
+        end = color_start[c+1];
+
+#pragma omp target teams distribute parallel for
+        for (k = start; k < end; k++) {
+            int i = ce[k];
+            int a = e[i].v0;
+            int b = e[i].v1;
+
+            pt[a][0] += e[i].v0_pt_data[0];
+            pt[a][1] += e[i].v0_pt_data[1];
+            pt[a][2] += e[i].v0_pt_data[2];
+
+            pt[b][0] += e[i].v1_pt_data[0];
+            pt[b][1] += e[i].v1_pt_data[1];
+            pt[b][2] += e[i].v1_pt_data[2];
+        }
+    }
+
+    return 0;
+}
+
+/* copies the points into pt_next on the device, for the fused pass */
+int points_copy() {
+    int i;
+    float (*pt)[3] = pt_data;
+    float (*next)[3] = pt_next;
+    int n = npoints;
+
+#pragma omp target teams distribute parallel for
+    for (i = 0; i < n; i++) {
+        next[i][0] = pt[i][0];
+        next[i][1] = pt[i][1];
+        next[i][2] = pt[i][2];
+    }
+
+    return 0;
+}
+
+/*
+ * Gathers, computes and scatters in one pass, without staging the endpoint
+ * data in the edges. The pass reads pt_data and adds to pt_next, a copy of
+ * it, so every edge sees the values the three passes would have. The two
+ * are then swapped; both stay mapped, so the device follows.
+ */
+int edge_fused() {
+    int i;
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    float (*next)[3] = pt_next;
+    float* ed = edge_data;
+    float (*tmp)[3];
+    int n = nedges;
+
+    points_copy();
+
+#pragma omp target teams distribute parallel for
+    for (i = 0; i < n; i++) {
+        int a = e[i].v0;
+        int b = e[i].v1;
+        float x0 = (pt[a][0] + pt[b][0]) * ed[i];
+        float x1 = (pt[a][1] + pt[b][1]) * ed[i];
+        float x2 = (pt[a][2] + pt[b][2]) * ed[i];
+
+#pragma omp atomic
+        next[a][0] += x0;
+#pragma omp atomic
+        next[a][1] += x1;
+#pragma omp atomic
+        next[a][2] += x2;
+
+#pragma omp atomic
+        next[b][0] += x0;
+#pragma omp atomic
+        next[b][1] += x1;
+#pragma omp atomic
+        next[b][2] += x2;
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/* edge_fused color by color, without atomics */
+int edge_fused_color() {
+    int c, k, start, end;
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    float (*next)[3] = pt_next;
+    float* ed = edge_data;
+    int* ce = color_edges;
+    float (*tmp)[3];
+
+    points_copy();
+
+    for (c = 0; c < ncolors; c++) {
+        start = color_start[c];
+        end = color_start[c+1];
+
+#pragma omp target teams distribute parallel for
+        for (k = start; k < end; k++) {
+            int i = ce[k];
+            int a = e[i].v0;
+            int b = e[i].v1;
+            float x0 = (pt[a][0] + pt[b][0]) * ed[i];
+            float x1 = (pt[a][1] + pt[b][1]) * ed[i];
+            float x2 = (pt[a][2] + pt[b][2]) * ed[i];
+
+            next[a][0] += x0;
+            next[a][1] += x1;
+            next[a][2] += x2;
+
+            next[b][0] += x0;
+            next[b][1] += x1;
+            next[b][2] += x2;
+        }
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/*
+ * Maps the edges, the points and the edge data to the device for the
+ * loops, and the fused pass's points without copying them.
+ */
+int data_upload(int scatter) {
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    float (*next)[3] = pt_next;
+    float* ed = edge_data;
+    int* ce = color_edges;
+    int np = npoints;
+    int ne = nedges;
+
+#pragma omp target enter data map(to: e[0:ne], pt[0:np], ed[0:ne]) \
+        map(alloc: next[0:np])
+    if (scatter == SCATTER_COLOR) {
+#pragma omp target enter data map(to: ce[0:ne])
+    }
+
+    return 0;
+}
+
+/* copies the points back from the device, which still has them mapped */
+int data_download() {
+    float (*pt)[3] = pt_data;
+    int np = npoints;
+
+#pragma omp target update from(pt[0:np])
+
+    return 0;
+}
+
+/* copies the points, reset on the host, to the device */
+int data_reset() {
+    float (*pt)[3] = pt_data;
+    int np = npoints;
+
+#pragma omp target update to(pt[0:np])
+
+    return 0;
+}
+
+/* unmaps what data_upload mapped */
+int data_release(int scatter) {
+    struct edge* e = edges;
+    float (*pt)[3] = pt_data;
+    float (*next)[3] = pt_next;
+    float* ed = edge_data;
+    int* ce = color_edges;
+    int np = npoints;
+    int ne = nedges;
+
+#pragma omp target exit data map(release: e[0:ne], pt[0:np], ed[0:ne], \
+        next[0:np])
+    if (scatter == SCATTER_COLOR) {
+#pragma omp target exit data map(release: ce[0:ne])
+    }
+
+    return 0;
+}
+
+/*
+ * Renumbers the vertices and reorders the edges for locality, see
+ * reorder.h. vperm keeps every vertex's new number for the output.
+ */
+int graph_reorder(int method) {
+    int i;
+
+    if (vperm == NULL) {
+        vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        eperm = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v0 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v1 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        if (vperm == NULL || eperm == NULL || reorder_v0 == NULL ||
+                reorder_v1 == NULL) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nedges; i++) {
+        reorder_v0[i] = edges[i].v0;
+        reorder_v1[i] = edges[i].v1;
+    }
+    if (reorder_graph(method, npoints, nedges, reorder_v0, reorder_v1,
+                vperm, eperm) < 0) {
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        edges[i].v0 = vperm[reorder_v0[eperm[i]]];
+        edges[i].v1 = vperm[reorder_v1[eperm[i]]];
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    int rv;
+    double time0, time1, up0, up1, down0, down1;
+
+    int c, opt_i;
+    int nloops = 0;
+    char* gt = "";
+    char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    int scatter = SCATTER_ATOMIC;
+    int reorder = REORDER_NONE;
+    int fused = 0;
+    int warmup = 1;
+    struct bench stats;
+    int pass, npasses, v;
+    double before = 0;
+
+    static struct option long_opts[] = {
+        {"help",   no_argument,       0, 0},
+        {"type",   required_argument, 0, 0},
+        {"nloops", required_argument, 0, 0},
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"scatter", required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"fused",  no_argument,       0, 0},
+        {"warmup", required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+
+    /* Parse command-line arguments */
+    while (1) {
+        c = getopt_long(argc, argv, "",
+                long_opts, &opt_i);
+
+        if (c == -1) {
+            break;
+        }
+
+        if (c == 0) {
+            switch (opt_i) {
+                case 0:
+                    print_help();
+                    exit(0);
+                case 1:
+                    gt = optarg;
+                    break;
+                case 2:
+                    nloops = atoi(optarg);
+                    break;
+                case 3:
+                    fname = optarg;
+                    break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    if (strcmp(optarg, "atomic") == 0) {
+                        scatter = SCATTER_ATOMIC;
+                    } else if (strcmp(optarg, "color") == 0) {
+                        scatter = SCATTER_COLOR;
+                    } else {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 10:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 11:
+                    fused = 1;
+                    break;
+                case 12:
+                    warmup = atoi(optarg);
+                    break;
+            }
+        } else {
+            print_help();
+            exit(0);
+        }
+    }
+
+    /* check for errors */
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1) {
+        print_help();
+        exit(0);
+    }
+
+
+    // initialize data structures
+    time0 = timer();
+    rv = graph_init(gt, np, ne, seed, fname, save);
+    time1 = timer();
+    if (rv < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+            time1 - time0);
+
+    cody_init("umma", argv[0]);
+    if (bench_init(&stats, nloops) < 0) {
+        printf("Error allocating timers. \n");
+        exit(0);
+    }
+
+    // initialize data structures
+    data_init();
+    edge_data_init();
+
+    // one pass on the graph as generated and, when reordering, one more
+    // on the reordered graph
+    npasses = (reorder == REORDER_NONE) ? 1 : 2;
+    for (pass = 0; pass < npasses; pass++) {
+        if (pass == 1) {
+            before = (time1 - time0) / ((float) nloops);
+
+            time0 = timer();
+            rv = graph_reorder(reorder);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error reordering graph. \n");
+                exit(0);
+            }
+            printf("Reorder: %f s \n", time1 - time0);
+
+            // the point and edge data start out uniform, so are just reset
+            data_init();
+            edge_data_init();
+        }
+
+        if (scatter == SCATTER_COLOR) {
+            time0 = timer();
+            rv = color_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error coloring graph. \n");
+                exit(0);
+            }
+            printf("Colors: %d in %f s \n", ncolors, time1 - time0);
+        }
+
+        // upload once, the data staying on the device for the loops
+        up0 = timer();
+        data_upload(scatter);
+        up1 = timer();
+
+        // loop, after the warm-up loops. the target regions wait for their
+        // kernels, so each phase is its kernels alone
+        for (i = -warmup; i < nloops; i++) {
+            if (i == 0) {
+                // the device's points are reset after the warm-up, as they
+                // start out uniform
+                if (warmup > 0) {
+                    data_init();
+                    data_reset();
+                }
+                time0 = timer();
+            }
+            bench_loop(&stats, i);
+            if (fused) {
+                if (scatter == SCATTER_COLOR) {
+                    edge_fused_color();
+                } else {
+                    edge_fused();
+                }
+                bench_phase(&stats, PHASE_FUSED);
+            } else {
+                edge_gather();
+                bench_phase(&stats, PHASE_GATHER);
+                edge_compute();
+                bench_phase(&stats, PHASE_COMPUTE);
+                if (scatter == SCATTER_COLOR) {
+                    edge_scatter_color();
+                } else {
+                    edge_scatter();
+                }
+                bench_phase(&stats, PHASE_SCATTER);
+            }
+        }
+        time1 = timer();
+
+        // download once
+        down0 = timer();
+        data_download();
+        down1 = timer();
+        data_release(scatter);
+    }
+
+
+    // print results, by the numbers of the generated graph
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = (reorder == REORDER_NONE) ? i : vperm[i];
+        printf("%i : %f %f %f \n", i, pt_data[v][0], pt_data[v][1],
+                pt_data[v][2]);
+    }
+
+    if (reorder != REORDER_NONE) {
+        printf("Time before reordering: %f s \n", before);
+    }
+    printf("Time: %f s \n", (time1 - time0) / ((float) nloops));
+    printf("Upload: %f s \n", up1 - up0);
+    printf("Download: %f s \n", down1 - down0);
+    bench_report(&stats, npoints, nedges);
+    bench_free(&stats);
+    cody_finish();
+
+    return 0;
+}
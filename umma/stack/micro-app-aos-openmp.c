@@ -1,14 +1,24 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
 #include <getopt.h>
-#include <lua.h>
-#include <lauxlib.h>
-#include <lualib.h>
+#include <omp.h>
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
+#include "graph.h"
+#include "reorder.h"
 
+/* defaults for --npoints and --nedges */
 #define NPOINTS 10000
 #define NEDGES  10000
 
+/* scatter strategies */
+#define SCATTER_ATOMIC 0
+#define SCATTER_COLOR  1
+#define SCATTER_CSR    2
+#define SCATTER_PRIVATE 3
+
 struct edge {
     int v0;
     int v1;
@@ -17,9 +27,49 @@ struct edge {
     float v1_pt_data[3];
 };
 
-struct edge edges[NEDGES];
-float pt_data[NPOINTS][3];
-float edge_data[NEDGES];
+/* sizes of the graph, see graph_alloc */
+int npoints;
+int nedges;
+int huge_pages = 0;
+
+struct edge* edges;
+float (*pt_data)[3];
+/* the points the fused passes add to, see edge_fused */
+float (*pt_next)[3];
+float* edge_data;
+
+/* edges by color, color c's being color_edges[color_start[c]] to
+ * color_edges[color_start[c+1]-1] */
+int* color_edges;
+int* color_start;
+int ncolors;
+int* color_mark;
+
+/* incident edges of every vertex, see csr_init */
+int* csr_start;
+int* csr_edges;
+
+/* a zeroed copy of the points for each of nprivate threads, see
+ * edge_scatter_private */
+float (*priv_data)[3];
+int nprivate;
+
+/* new number of every vertex and old position of every edge, see
+ * graph_reorder */
+int* vperm;
+int* eperm;
+int* reorder_v0;
+int* reorder_v1;
+
+/* see --prefetch and --window, 0 if off */
+int prefetch_dist = 0;
+int window_size = 0;
+
+/* endpoints of every window of window_size edges sorted by vertex, see
+ * window_init */
+int* win_refs;
+int* win_verts;
+long long* win_keys;
 
 void print_help() {
     printf("Usage: \n");
@@ -31,76 +81,82 @@ void print_help() {
     printf("\t --nloops Number of repetitions, must be \n");
     printf("\t          at least one. \n");
     printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --scatter Scatter strategy, one of:\n");
+    printf("\t\t\t atomic (default) \n");
+    printf("\t\t\t color \n");
+    printf("\t\t\t csr \n");
+    printf("\t\t\t private \n");
+    printf("\t --fused Gather, compute and scatter in one pass \n");
+    printf("\t --reorder Reordering for locality, one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
+    printf("\t --prefetch Prefetch the points of the edge this many \n");
+    printf("\t            ahead in the gather (0, off) \n");
+    printf("\t --window Gather the endpoints of this many edges at a \n");
+    printf("\t          time, in vertex order (0, off) \n");
 }
 
 double timer() {
-    struct timeval tp;
-    struct timezone tzp;
-    long i;
-
-    i = gettimeofday(&tp, &tzp);
-    return ((double)tp.tv_sec) + ((double) tp.tv_usec) * 1e-6;
+    return cody_now();
 }
 
-int graph_init(char* graph_type, char* fname) {
-    lua_State *L;
-    int i, j, k, v;
-
-    L = luaL_newstate();
-    luaL_openlibs(L);
-    luaL_loadfile(L, "graph.lua");
-    lua_pcall(L, 0, 0, 0);
-
-    lua_getglobal(L, "create_graph");
-    lua_pushstring(L, graph_type);
-    lua_pushinteger(L, NPOINTS);
-    lua_pushinteger(L, NEDGES);
-
-    if (fname != NULL) {
-        lua_pushstring(L, fname);
-        lua_call(L, 4, 1);
-    } else {
-        lua_call(L, 3, 1);
-    }
-
-    /* Table is now sitting at the top of the stack */
-    i = 0;
-    lua_pushnil(L);  /* Make sure lua_next starts at beginning */
-    while (lua_next(L, -2) != 0) {
-        // fetch first key
-        k = lua_tointeger(L, -2);
-        lua_pushnil(L);
-        while (lua_next(L, -2) != 0) { // loop over neighbors
-            lua_pop(L,1);
-            v = lua_tointeger(L, -1);
-
-            // build edges array here
-            edges[i].v0 = k - 1;
-            edges[i].v1 = v - 1;
-
-            for (j = 0; j < 3; j++) {
-                edges[i].v0_pt_data[j] = 0;
-                edges[i].v1_pt_data[j] = 0;
-            }
+/*
+ * Allocates the graph for np points and ne edges, zeroed, and the point
+ * and edge data.
+ */
+int graph_alloc(int np, int ne) {
+    npoints = np;
+    nedges = ne;
 
-            i++;
-        }
-        lua_pop(L,1);
+    edges = (struct edge*) umma_alloc(ne, sizeof(struct edge), huge_pages);
+    pt_data = (float (*)[3]) umma_alloc(np, 3 * sizeof(float), huge_pages);
+    edge_data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    if (edges == NULL || pt_data == NULL || edge_data == NULL) {
+        return -1;
     }
 
-    lua_close(L);
+    return 0;
+}
+
+/*
+ * Creates the graph with graph_create, writes it to save unless that is
+ * NULL, and copies its edges into the graph's arrays.
+ */
+int graph_init(char* graph_type, int np, int ne, unsigned long seed,
+        char* fname, char* save) {
+    struct edge_list el;
+    int i;
 
-    if (i == 0) {
+    if (graph_create(graph_type, np, ne, seed, fname, &el) < 0) {
+        return -1;
+    }
+    if ((save != NULL && graph_save(save, &el) < 0) ||
+            graph_alloc(el.npoints, el.nedges) < 0) {
+        graph_release(&el);
         return -1;
-    } else {
-        return 0;
     }
+
+    for (i = 0; i < nedges; i++) {
+        edges[i].v0 = el.v0[i];
+        edges[i].v1 = el.v1[i];
+    }
+    graph_release(&el);
+
+    return 0;
 }
 
 int data_init() {
     int i;
 
-    for (i = 0; i < NPOINTS; i++) {
+    for (i = 0; i < npoints; i++) {
         pt_data[i][0] = 1;
         pt_data[i][1] = 1;
         pt_data[i][2] = 1;
@@ -112,7 +168,7 @@ int data_init() {
 int edge_data_init() {
     int i;
 
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         edge_data[i] = 1;
     }
 
@@ -126,7 +182,40 @@ int edge_gather() {
 
 #pragma omp parallel for \
     private(i, j, v0, v1)
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+
+        edges[i].v0_pt_data[0] = pt_data[v0][0];
+        edges[i].v0_pt_data[1] = pt_data[v0][1];
+        edges[i].v0_pt_data[2] = pt_data[v0][2];
+
+        edges[i].v1_pt_data[0] = pt_data[v1][0];
+        edges[i].v1_pt_data[1] = pt_data[v1][1];
+        edges[i].v1_pt_data[2] = pt_data[v1][2];
+
+        edges[i].data = edge_data[i];
+    }
+
+    return 0;
+}
+
+/*
+ * edge_gather, prefetching the points of the edge prefetch_dist ahead so
+ * their random loads overlap those of the edges in between.
+ */
+int edge_gather_prefetch() {
+    int i;
+    int v0;
+    int v1;
+
+#pragma omp parallel for \
+    private(i, v0, v1)
+    for (i = 0; i < nedges; i++) {
+        if (i + prefetch_dist < nedges) {
+            __builtin_prefetch(pt_data[edges[i + prefetch_dist].v0]);
+            __builtin_prefetch(pt_data[edges[i + prefetch_dist].v1]);
+        }
         v0 = edges[i].v0;
         v1 = edges[i].v1;
 
@@ -137,7 +226,81 @@ int edge_gather() {
         edges[i].v1_pt_data[0] = pt_data[v1][0];
         edges[i].v1_pt_data[1] = pt_data[v1][1];
         edges[i].v1_pt_data[2] = pt_data[v1][2];
+        edges[i].data = edge_data[i];
+    }
+
+    return 0;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    long long x = *(const long long*) a;
+    long long y = *(const long long*) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sorts the 2 * window_size endpoints of every window of edges by vertex,
+ * each kept as 2 * edge + 0 if it is the edge's v0 or + 1 if its v1, as
+ * in win_refs[k], and its vertex as win_verts[k].
+ */
+int window_init() {
+    int i, k, n;
+
+    if (win_refs == NULL) {
+        win_refs = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+        win_verts = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+        win_keys = (long long*) umma_alloc(nedges, 2 * sizeof(long long),
+                huge_pages);
+        if (win_refs == NULL || win_verts == NULL || win_keys == NULL) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nedges; i++) {
+        win_keys[2*i] = (long long) edges[i].v0 << 32 | (2 * i);
+        win_keys[2*i+1] = (long long) edges[i].v1 << 32 | (2 * i + 1);
+    }
+    for (k = 0; k < 2 * nedges; k += 2 * window_size) {
+        n = 2 * nedges - k;
+        n = (n < 2 * window_size) ? n : 2 * window_size;
+        qsort(win_keys + k, n, sizeof(long long), compare_keys);
+    }
+    for (k = 0; k < 2 * nedges; k++) {
+        win_verts[k] = (int) (win_keys[k] >> 32);
+        win_refs[k] = (int) (win_keys[k] & 0xffffffff);
+    }
+
+    return 0;
+}
+
+/*
+ * edge_gather a window at a time, loading each window's points in vertex
+ * order, so a point shared by its edges is loaded once and the loads walk
+ * pt_data forwards. Prefetches win_verts[k + prefetch_dist] too.
+ */
+int edge_gather_window() {
+    int i, k, e, v;
+    float* p;
+
+#pragma omp parallel for \
+    private(k, e, v, p)
+    for (k = 0; k < 2 * nedges; k++) {
+        if (prefetch_dist > 0 && k + prefetch_dist < 2 * nedges) {
+            __builtin_prefetch(pt_data[win_verts[k + prefetch_dist]]);
+        }
+        e = win_refs[k];
+        v = win_verts[k];
+        p = (e & 1) ? edges[(e >> 1)].v1_pt_data : edges[(e >> 1)].v0_pt_data;
+
+        p[0] = pt_data[v][0];
+        p[1] = pt_data[v][1];
+        p[2] = pt_data[v][2];
+    }
 
+#pragma omp parallel for \
+    private(i)
+    for (i = 0; i < nedges; i++) {
         edges[i].data = edge_data[i];
     }
 
@@ -155,7 +318,7 @@ int edge_compute() {
     private(i, j, v0_p0, v0_p1, v0_p2) \
     private(v1_p0, v1_p1, v1_p2) \
     private(x0, x1, x2, e_data)
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         v0_p0 = edges[i].v0_pt_data[0];
         v0_p1 = edges[i].v0_pt_data[1];
         v0_p2 = edges[i].v0_pt_data[2];
@@ -189,7 +352,7 @@ int edge_scatter() {
 
 #pragma omp parallel for \
     private(i, v0, v1)
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         v0 = edges[i].v0;
         v1 = edges[i].v1;
 
@@ -211,6 +374,462 @@ int edge_scatter() {
     return 0;
 }
 
+/*
+ * Greedy edge coloring. Each color takes, in order, the uncolored edges
+ * that share no vertex with an edge it already has, so the edges of a
+ * color can scatter in parallel without atomics.
+ */
+int color_init() {
+    int c, k, next, e, v0, v1;
+
+    if (color_edges == NULL) {
+        color_edges = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        color_start = (int*) umma_alloc(nedges + 1, sizeof(int), huge_pages);
+        color_mark = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        if (color_edges == NULL || color_start == NULL ||
+                color_mark == NULL) {
+            return -1;
+        }
+    }
+
+    for (k = 0; k < nedges; k++) {
+        color_edges[k] = k;
+    }
+    for (k = 0; k < npoints; k++) {
+        color_mark[k] = -1;
+    }
+
+    next = 0;
+    for (c = 0; next < nedges; c++) {
+        color_start[c] = next;
+        // move the edges this color can take to the front of the rest
+        for (k = next; k < nedges; k++) {
+            e = color_edges[k];
+            v0 = edges[e].v0;
+            v1 = edges[e].v1;
+            if (color_mark[v0] != c && color_mark[v1] != c) {
+                color_mark[v0] = c;
+                color_mark[v1] = c;
+                color_edges[k] = color_edges[next];
+                color_edges[next++] = e;
+            }
+        }
+    }
+    color_start[c] = next;
+    ncolors = c;
+
+    return 0;
+}
+
+int edge_scatter_color() {
+    int c, k, i;
+    int v0;
+    int v1;
+
+    for (c = 0; c < ncolors; c++) {
+#pragma omp parallel for \
+    private(k, i, v0, v1)
+        for (k = color_start[c]; k < color_start[c+1]; k++) {
+            i = color_edges[k];
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            pt_data[v0][0] += edges[i].v0_pt_data[0];
+            pt_data[v0][1] += edges[i].v0_pt_data[1];
+            pt_data[v0][2] += edges[i].v0_pt_data[2];
+
+            pt_data[v1][0] += edges[i].v1_pt_data[0];
+            pt_data[v1][1] += edges[i].v1_pt_data[1];
+            pt_data[v1][2] += edges[i].v1_pt_data[2];
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Incident edges of every vertex, vertex v's being csr_edges[csr_start[v]]
+ * to csr_edges[csr_start[v+1]-1], each as 2 * edge + 0 if v is its v0 or
+ * + 1 if v is its v1.
+ */
+int csr_init() {
+    int i, v;
+
+    if (csr_edges == NULL) {
+        csr_start = (int*) umma_alloc(npoints + 1, sizeof(int), huge_pages);
+        csr_edges = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+        if (csr_start == NULL || csr_edges == NULL) {
+            return -1;
+        }
+    }
+
+    for (v = 0; v <= npoints; v++) {
+        csr_start[v] = 0;
+    }
+    for (i = 0; i < nedges; i++) {
+        csr_start[edges[i].v0 + 1]++;
+        csr_start[edges[i].v1 + 1]++;
+    }
+    for (v = 0; v < npoints; v++) {
+        csr_start[v+1] += csr_start[v];
+    }
+    // fill, using csr_start[v] as v's next free slot
+    for (i = 0; i < nedges; i++) {
+        csr_edges[csr_start[edges[i].v0]++] = 2 * i;
+        csr_edges[csr_start[edges[i].v1]++] = 2 * i + 1;
+    }
+    for (v = npoints; v > 0; v--) {
+        csr_start[v] = csr_start[v-1];
+    }
+    csr_start[0] = 0;
+
+    return 0;
+}
+
+/*
+ * Owner computes scatter: every vertex sums the contributions of its
+ * incident edges and adds them to its own point, with no atomics.
+ */
+int vertex_scatter() {
+    int v, k, e, i;
+    float s0, s1, s2;
+
+#pragma omp parallel for \
+    private(v, k, e, i, s0, s1, s2)
+    for (v = 0; v < npoints; v++) {
+        s0 = 0;
+        s1 = 0;
+        s2 = 0;
+        for (k = csr_start[v]; k < csr_start[v+1]; k++) {
+            e = csr_edges[k];
+            i = e >> 1;
+            if (e & 1) {
+                s0 += edges[i].v1_pt_data[0];
+                s1 += edges[i].v1_pt_data[1];
+                s2 += edges[i].v1_pt_data[2];
+            } else {
+                s0 += edges[i].v0_pt_data[0];
+                s1 += edges[i].v0_pt_data[1];
+                s2 += edges[i].v0_pt_data[2];
+            }
+        }
+        pt_data[v][0] += s0;
+        pt_data[v][1] += s1;
+        pt_data[v][2] += s2;
+    }
+
+    return 0;
+}
+
+/*
+ * Copies of the points for every thread edge_scatter_private may run, as
+ * many as an OpenMP region has at most. They are zeroed by the blocks of
+ * points private_reduce gives each thread, so those blocks of every copy
+ * are on the thread's NUMA node.
+ */
+int private_init() {
+    int k, v;
+    float (*a)[3];
+
+    if (priv_data == NULL) {
+        nprivate = omp_get_max_threads();
+        priv_data = (float (*)[3]) umma_alloc_untouched(
+                (size_t) nprivate * npoints, 3 * sizeof(float), huge_pages);
+        if (priv_data == NULL) {
+            return -1;
+        }
+
+#pragma omp parallel for schedule(static) \
+    private(k, a)
+        for (v = 0; v < npoints; v++) {
+            for (k = 0; k < nprivate; k++) {
+                a = priv_data + (size_t) k * npoints;
+                a[v][0] = 0;
+                a[v][1] = 0;
+                a[v][2] = 0;
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Sums the nt copies of the points pairwise in a tree into the first, adds
+ * that to pt_data and zeroes the copies again. Called by every thread of
+ * the region; each sums the same block of points at every level, the
+ * block private_init had it zero.
+ */
+void private_reduce(int nt) {
+    int stride, k, v;
+    float (*a)[3];
+    float (*b)[3];
+
+    for (stride = 1; stride < nt; stride *= 2) {
+#pragma omp for schedule(static) \
+    private(k, a, b)
+        for (v = 0; v < npoints; v++) {
+            for (k = 0; k + stride < nt; k += 2 * stride) {
+                a = priv_data + (size_t) k * npoints;
+                b = a + (size_t) stride * npoints;
+                a[v][0] += b[v][0];
+                a[v][1] += b[v][1];
+                a[v][2] += b[v][2];
+                b[v][0] = 0;
+                b[v][1] = 0;
+                b[v][2] = 0;
+            }
+        }
+    }
+
+#pragma omp for schedule(static)
+    for (v = 0; v < npoints; v++) {
+        pt_data[v][0] += priv_data[v][0];
+        pt_data[v][1] += priv_data[v][1];
+        pt_data[v][2] += priv_data[v][2];
+        priv_data[v][0] = 0;
+        priv_data[v][1] = 0;
+        priv_data[v][2] = 0;
+    }
+}
+
+/*
+ * Privatized scatter: every thread adds the contributions of its edges to
+ * its own copy of the points, without atomics, then the copies are
+ * reduced into pt_data. Costs a copy of the points per thread, so suits
+ * graphs with few points.
+ */
+int edge_scatter_private() {
+    int i;
+    int v0;
+    int v1;
+    float (*mine)[3];
+
+#pragma omp parallel \
+    private(i, v0, v1, mine)
+    {
+        mine = priv_data + (size_t) omp_get_thread_num() * npoints;
+
+#pragma omp for schedule(static)
+        for (i = 0; i < nedges; i++) {
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            mine[v0][0] += edges[i].v0_pt_data[0];
+            mine[v0][1] += edges[i].v0_pt_data[1];
+            mine[v0][2] += edges[i].v0_pt_data[2];
+
+            mine[v1][0] += edges[i].v1_pt_data[0];
+            mine[v1][1] += edges[i].v1_pt_data[1];
+            mine[v1][2] += edges[i].v1_pt_data[2];
+        }
+
+        private_reduce(omp_get_num_threads());
+    }
+
+    return 0;
+}
+
+/*
+ * Gathers, computes and scatters in one pass, without staging the endpoint
+ * data in the edges. The pass reads pt_data and adds to pt_next, a copy of
+ * it, so every edge sees the values the three passes would have. The two
+ * are then swapped.
+ */
+int edge_fused() {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float (*tmp)[3];
+
+    memcpy(pt_next, pt_data, npoints * 3 * sizeof(float));
+
+#pragma omp parallel for \
+    private(i, v0, v1, x0, x1, x2)
+    for (i = 0; i < nedges; i++) {
+        v0 = edges[i].v0;
+        v1 = edges[i].v1;
+
+        x0 = (pt_data[v0][0] + pt_data[v1][0]) * edge_data[i];
+        x1 = (pt_data[v0][1] + pt_data[v1][1]) * edge_data[i];
+        x2 = (pt_data[v0][2] + pt_data[v1][2]) * edge_data[i];
+
+#pragma omp atomic
+        pt_next[v0][0] += x0;
+#pragma omp atomic
+        pt_next[v0][1] += x1;
+#pragma omp atomic
+        pt_next[v0][2] += x2;
+
+#pragma omp atomic
+        pt_next[v1][0] += x0;
+#pragma omp atomic
+        pt_next[v1][1] += x1;
+#pragma omp atomic
+        pt_next[v1][2] += x2;
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/* edge_fused color by color, without atomics */
+int edge_fused_color() {
+    int c, k, i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float (*tmp)[3];
+
+    memcpy(pt_next, pt_data, npoints * 3 * sizeof(float));
+
+    for (c = 0; c < ncolors; c++) {
+#pragma omp parallel for \
+    private(k, i, v0, v1, x0, x1, x2)
+        for (k = color_start[c]; k < color_start[c+1]; k++) {
+            i = color_edges[k];
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            x0 = (pt_data[v0][0] + pt_data[v1][0]) * edge_data[i];
+            x1 = (pt_data[v0][1] + pt_data[v1][1]) * edge_data[i];
+            x2 = (pt_data[v0][2] + pt_data[v1][2]) * edge_data[i];
+
+            pt_next[v0][0] += x0;
+            pt_next[v0][1] += x1;
+            pt_next[v0][2] += x2;
+
+            pt_next[v1][0] += x0;
+            pt_next[v1][1] += x1;
+            pt_next[v1][2] += x2;
+        }
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/*
+ * edge_fused into copies of the points per thread. The copies are only
+ * reduced into pt_data after every edge has read it, so pt_data needs no
+ * copy of its own.
+ */
+int edge_fused_private() {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+    float (*mine)[3];
+
+#pragma omp parallel \
+    private(i, v0, v1, x0, x1, x2, mine)
+    {
+        mine = priv_data + (size_t) omp_get_thread_num() * npoints;
+
+#pragma omp for schedule(static)
+        for (i = 0; i < nedges; i++) {
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+
+            x0 = (pt_data[v0][0] + pt_data[v1][0]) * edge_data[i];
+            x1 = (pt_data[v0][1] + pt_data[v1][1]) * edge_data[i];
+            x2 = (pt_data[v0][2] + pt_data[v1][2]) * edge_data[i];
+
+            mine[v0][0] += x0;
+            mine[v0][1] += x1;
+            mine[v0][2] += x2;
+
+            mine[v1][0] += x0;
+            mine[v1][1] += x1;
+            mine[v1][2] += x2;
+        }
+
+        private_reduce(omp_get_num_threads());
+    }
+
+    return 0;
+}
+
+/*
+ * Owner computes in one pass: every vertex computes the contributions of
+ * its incident edges from pt_data and writes its sum to pt_next. Each
+ * edge is computed twice, once by each endpoint, but pt_next needs no
+ * copy.
+ */
+int vertex_fused() {
+    int v, k, i;
+    int v0;
+    int v1;
+    float s0, s1, s2;
+    float (*tmp)[3];
+
+#pragma omp parallel for \
+    private(v, k, i, v0, v1, s0, s1, s2)
+    for (v = 0; v < npoints; v++) {
+        s0 = 0;
+        s1 = 0;
+        s2 = 0;
+        for (k = csr_start[v]; k < csr_start[v+1]; k++) {
+            i = csr_edges[k] >> 1;
+            v0 = edges[i].v0;
+            v1 = edges[i].v1;
+            s0 += (pt_data[v0][0] + pt_data[v1][0]) * edge_data[i];
+            s1 += (pt_data[v0][1] + pt_data[v1][1]) * edge_data[i];
+            s2 += (pt_data[v0][2] + pt_data[v1][2]) * edge_data[i];
+        }
+        pt_next[v][0] = pt_data[v][0] + s0;
+        pt_next[v][1] = pt_data[v][1] + s1;
+        pt_next[v][2] = pt_data[v][2] + s2;
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/*
+ * Renumbers the vertices and reorders the edges for locality, see
+ * reorder.h. vperm keeps every vertex's new number for the output.
+ */
+int graph_reorder(int method) {
+    int i;
+
+    if (vperm == NULL) {
+        vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        eperm = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v0 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v1 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        if (vperm == NULL || eperm == NULL || reorder_v0 == NULL ||
+                reorder_v1 == NULL) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nedges; i++) {
+        reorder_v0[i] = edges[i].v0;
+        reorder_v1[i] = edges[i].v1;
+    }
+    if (reorder_graph(method, npoints, nedges, reorder_v0, reorder_v1,
+                vperm, eperm) < 0) {
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        edges[i].v0 = vperm[reorder_v0[eperm[i]]];
+        edges[i].v1 = vperm[reorder_v1[eperm[i]]];
+    }
+
+    return 0;
+}
+
 int main(int argc, char** argv) {
     int i;
     int rv;
@@ -219,12 +838,35 @@ int main(int argc, char** argv) {
     int nloops = 0;
     char* gt = "";
     char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    int scatter = SCATTER_ATOMIC;
+    int reorder = REORDER_NONE;
+    int fused = 0;
+    int warmup = 1;
+    struct bench stats;
+    int pass, npasses, v;
+    double before = 0;
 
     static struct option long_opts[] = {
         {"help",   no_argument,       0, 0},
         {"type",   required_argument, 0, 0},
         {"nloops", required_argument, 0, 0}, 
-        {"file",   required_argument, 0, 0}
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"scatter", required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"fused",  no_argument,       0, 0},
+        {"warmup", required_argument, 0, 0},
+        {"prefetch", required_argument, 0, 0},
+        {"window", required_argument, 0, 0},
+        {0, 0, 0, 0}
     };
 
     /* Parse command-line arguments */
@@ -250,6 +892,54 @@ int main(int argc, char** argv) {
                 case 3:
                     fname = optarg;
                     break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    if (strcmp(optarg, "atomic") == 0) {
+                        scatter = SCATTER_ATOMIC;
+                    } else if (strcmp(optarg, "color") == 0) {
+                        scatter = SCATTER_COLOR;
+                    } else if (strcmp(optarg, "csr") == 0) {
+                        scatter = SCATTER_CSR;
+                    } else if (strcmp(optarg, "private") == 0) {
+                        scatter = SCATTER_PRIVATE;
+                    } else {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 10:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 11:
+                    fused = 1;
+                    break;
+                case 12:
+                    warmup = atoi(optarg);
+                    break;
+                case 13:
+                    prefetch_dist = atoi(optarg);
+                    break;
+                case 14:
+                    window_size = atoi(optarg);
+                    break;
             }
         } else {
             print_help();
@@ -258,38 +948,170 @@ int main(int argc, char** argv) {
     }
 
     /* check for errors */
-    if (gt == NULL || nloops < 1) {
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1 ||
+            prefetch_dist < 0 || window_size < 0) {
         print_help();
         exit(0);
     }
 
     
+    // pin the threads before the arrays are first touched
+    cody_pin(0, 1);
+
     // initialize data structures
-    rv = graph_init(gt, fname);
+    time0 = timer();
+    rv = graph_init(gt, np, ne, seed, fname, save);
+    time1 = timer();
     if (rv < 0) {
         printf("Error creating graph. \n");
         exit(0);
     }
+    printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+            time1 - time0);
+
+    cody_init("umma", argv[0]);
+    if (bench_init(&stats, nloops) < 0) {
+        printf("Error allocating timers. \n");
+        exit(0);
+    }
+
+    if (fused) {
+        pt_next = (float (*)[3]) umma_alloc(npoints, 3 * sizeof(float),
+                huge_pages);
+        if (pt_next == NULL) {
+            printf("Error allocating points. \n");
+            exit(0);
+        }
+    }
 
     data_init();
     edge_data_init();
 
-    // loop
-    time0 = timer();
-    for (i = 0; i < nloops; i++) {
-        edge_gather();
-        edge_compute();
-        edge_scatter();
+    // one pass on the graph as generated and, when reordering, one more
+    // on the reordered graph
+    npasses = (reorder == REORDER_NONE) ? 1 : 2;
+    for (pass = 0; pass < npasses; pass++) {
+        if (pass == 1) {
+            before = (time1 - time0) / ((float) nloops);
+
+            time0 = timer();
+            rv = graph_reorder(reorder);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error reordering graph. \n");
+                exit(0);
+            }
+            printf("Reorder: %f s \n", time1 - time0);
+
+            // the point and edge data start out uniform, so are just reset
+            data_init();
+            edge_data_init();
+        }
+
+        if (scatter == SCATTER_COLOR) {
+            time0 = timer();
+            rv = color_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error coloring graph. \n");
+                exit(0);
+            }
+            printf("Colors: %d in %f s \n", ncolors, time1 - time0);
+        } else if (scatter == SCATTER_CSR) {
+            time0 = timer();
+            rv = csr_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error building CSR. \n");
+                exit(0);
+            }
+            printf("CSR: %f s \n", time1 - time0);
+        } else if (scatter == SCATTER_PRIVATE) {
+            time0 = timer();
+            rv = private_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error allocating private points. \n");
+                exit(0);
+            }
+            printf("Private: %d copies in %f s \n", nprivate, time1 - time0);
+        }
+
+        if (window_size > 0) {
+            time0 = timer();
+            rv = window_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error sorting windows. \n");
+                exit(0);
+            }
+            printf("Windows: %d edges in %f s \n", window_size,
+                    time1 - time0);
+        }
+
+        // loop, after the warm-up loops
+        for (i = -warmup; i < nloops; i++) {
+            if (i == 0) {
+                // the data are reset after the warm-up, as they start out
+                // uniform
+                if (warmup > 0) {
+                    data_init();
+                    edge_data_init();
+                }
+                time0 = timer();
+            }
+            bench_loop(&stats, i);
+            if (fused) {
+                if (scatter == SCATTER_COLOR) {
+                    edge_fused_color();
+                } else if (scatter == SCATTER_CSR) {
+                    vertex_fused();
+                } else if (scatter == SCATTER_PRIVATE) {
+                    edge_fused_private();
+                } else {
+                    edge_fused();
+                }
+                bench_phase(&stats, PHASE_FUSED);
+            } else {
+                if (window_size > 0) {
+                    edge_gather_window();
+                } else if (prefetch_dist > 0) {
+                    edge_gather_prefetch();
+                } else {
+                    edge_gather();
+                }
+                bench_phase(&stats, PHASE_GATHER);
+                edge_compute();
+                bench_phase(&stats, PHASE_COMPUTE);
+                if (scatter == SCATTER_COLOR) {
+                    edge_scatter_color();
+                } else if (scatter == SCATTER_CSR) {
+                    vertex_scatter();
+                } else if (scatter == SCATTER_PRIVATE) {
+                    edge_scatter_private();
+                } else {
+                    edge_scatter();
+                }
+                bench_phase(&stats, PHASE_SCATTER);
+            }
+        }
+        time1 = timer();
     }
-    time1 = timer();
 
 
-    // print results
-    for (i = 0; i < 10; i++) {
-        printf("%i : %f %f %f \n", i, pt_data[i][0], pt_data[i][1], pt_data[i][2]);
+    // print results, by the numbers of the generated graph
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = (reorder == REORDER_NONE) ? i : vperm[i];
+        printf("%i : %f %f %f \n", i, pt_data[v][0], pt_data[v][1], pt_data[v][2]);
     }
 
+    if (reorder != REORDER_NONE) {
+        printf("Time before reordering: %f s \n", before);
+    }
     printf("Time: %f s \n", (time1 - time0) / ((float) nloops));
+    bench_report(&stats, npoints, nedges);
+    bench_free(&stats);
+    cody_finish();
 
     return 0;
 }
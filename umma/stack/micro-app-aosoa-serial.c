@@ -0,0 +1,516 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
+#include "graph.h"
+#include "reorder.h"
+
+/* defaults for --npoints and --nedges */
+#define NPOINTS 10000
+#define NEDGES  10000
+
+/* points and edges per block, the SIMD width to match, e.g. 16 for
+ * AVX-512 floats. Set with -DAOSOA_WIDTH=4, 8 or 16 */
+#ifndef AOSOA_WIDTH
+#define AOSOA_WIDTH 8
+#endif
+#define WIDTH AOSOA_WIDTH
+
+/*
+ * Array of structs of arrays: WIDTH edges per block, each of their fields
+ * an array with one lane per edge, so a block's lanes load and store whole
+ * vectors. Edge i is lane i % WIDTH of block i / WIDTH.
+ */
+struct edge_block {
+    int v0[WIDTH];
+    int v1[WIDTH];
+    float data[WIDTH];
+    float v0_data[3][WIDTH];
+    float v1_data[3][WIDTH];
+};
+
+/* WIDTH points, component c of point v being p[c][v % WIDTH] of block
+ * v / WIDTH */
+struct point_block {
+    float p[3][WIDTH];
+};
+
+#define PT(pts, v, c) ((pts)[(v) / WIDTH].p[c][(v) % WIDTH])
+
+/* sizes of the graph, see graph_alloc. The last blocks may be partial */
+int npoints;
+int nedges;
+int npblocks;
+int neblocks;
+int huge_pages = 0;
+
+struct point_block* pt_data;
+/* the points the fused pass adds to, see edge_fused */
+struct point_block* pt_next;
+float* edge_data;
+struct edge_block* edges;
+
+/* new number of every vertex and old position of every edge, see
+ * graph_reorder */
+int* vperm;
+int* eperm;
+int* reorder_v0;
+int* reorder_v1;
+
+void print_help() {
+    printf("Usage: \n");
+    printf("\t --help print this message and exit \n");
+    printf("\t --type Type of graph, must be one of:\n");
+    printf("\t\t\t pure_random \n");
+    printf("\t\t\t regular_random \n");
+    printf("\t\t\t contiguous \n");
+    printf("\t --nloops Number of repetitions, must be \n");
+    printf("\t          at least one. \n");
+    printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --fused Gather, compute and scatter in one pass \n");
+    printf("\t --reorder Reordering for locality, one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
+}
+
+double timer() {
+    return cody_now();
+}
+
+/*
+ * Allocates the graph for np points and ne edges, zeroed, and the point
+ * and edge data.
+ */
+int graph_alloc(int np, int ne) {
+    npoints = np;
+    nedges = ne;
+    npblocks = (np + WIDTH - 1) / WIDTH;
+    neblocks = (ne + WIDTH - 1) / WIDTH;
+
+    edges = (struct edge_block*) umma_alloc(neblocks,
+            sizeof(struct edge_block), huge_pages);
+    pt_data = (struct point_block*) umma_alloc(npblocks,
+            sizeof(struct point_block), huge_pages);
+    edge_data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    if (edges == NULL || pt_data == NULL || edge_data == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Creates the graph with graph_create, writes it to save unless that is
+ * NULL, and copies its edges into the blocks. The lanes past the last edge
+ * stay edges from point 0 to itself, which the scatters skip.
+ */
+int graph_init(char* graph_type, int np, int ne, unsigned long seed,
+        char* fname, char* save) {
+    struct edge_list el;
+    int i;
+
+    if (graph_create(graph_type, np, ne, seed, fname, &el) < 0) {
+        return -1;
+    }
+    if ((save != NULL && graph_save(save, &el) < 0) ||
+            graph_alloc(el.npoints, el.nedges) < 0) {
+        graph_release(&el);
+        return -1;
+    }
+
+    for (i = 0; i < nedges; i++) {
+        edges[i / WIDTH].v0[i % WIDTH] = el.v0[i];
+        edges[i / WIDTH].v1[i % WIDTH] = el.v1[i];
+    }
+    graph_release(&el);
+
+    return 0;
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < npoints; i++) {
+        PT(pt_data, i, 0) = 1;
+        PT(pt_data, i, 1) = 1;
+        PT(pt_data, i, 2) = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nedges; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/* lanes of block b that hold edges */
+int block_lanes(int b) {
+    return (b == neblocks - 1) ? nedges - b * WIDTH : WIDTH;
+}
+
+/*
+ * The gathers are still indexed, but every lane of a block writes its own
+ * slot of each component's vector, with no shuffles. Padding lanes gather
+ * point 0.
+ */
+int edge_gather() {
+    int b, l, c;
+    int v0;
+    int v1;
+    struct edge_block* e;
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        for (c = 0; c < 3; c++) {
+            for (l = 0; l < WIDTH; l++) {
+                v0 = e->v0[l];
+                v1 = e->v1[l];
+                e->v0_data[c][l] = PT(pt_data, v0, c);
+                e->v1_data[c][l] = PT(pt_data, v1, c);
+            }
+        }
+        for (l = 0; l < WIDTH; l++) {
+            e->data[l] = (b * WIDTH + l < nedges) ? edge_data[b * WIDTH + l] : 0;
+        }
+    }
+
+    return 0;
+}
+
+/* whole vectors per component, the loops over lanes being unit stride */
+int edge_compute() {
+    int b, l, c;
+    float x;
+    struct edge_block* e;
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        for (c = 0; c < 3; c++) {
+            for (l = 0; l < WIDTH; l++) {
+                x = (e->v0_data[c][l] + e->v1_data[c][l]) * e->data[l];
+                e->v0_data[c][l] = x;
+                e->v1_data[c][l] = x;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int edge_scatter() {
+    int b, l, c, n;
+    int v0;
+    int v1;
+    struct edge_block* e;
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        n = block_lanes(b);
+        for (l = 0; l < n; l++) {
+            v0 = e->v0[l];
+            v1 = e->v1[l];
+            for (c = 0; c < 3; c++) {
+                PT(pt_data, v0, c) += e->v0_data[c][l];
+                PT(pt_data, v1, c) += e->v1_data[c][l];
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Gathers, computes and scatters in one pass, without staging the endpoint
+ * data in the blocks. The pass reads pt_data and adds to pt_next, a copy of
+ * it, so every edge sees the values the three passes would have. The two
+ * are then swapped.
+ */
+int edge_fused() {
+    int b, l, c, n;
+    int v0;
+    int v1;
+    float x[3][WIDTH];
+    struct edge_block* e;
+    struct point_block* tmp;
+
+    memcpy(pt_next, pt_data, npblocks * sizeof(struct point_block));
+
+    for (b = 0; b < neblocks; b++) {
+        e = &edges[b];
+        n = block_lanes(b);
+        for (c = 0; c < 3; c++) {
+            for (l = 0; l < n; l++) {
+                v0 = e->v0[l];
+                v1 = e->v1[l];
+                x[c][l] = (PT(pt_data, v0, c) + PT(pt_data, v1, c)) *
+                    edge_data[b * WIDTH + l];
+            }
+        }
+        for (l = 0; l < n; l++) {
+            v0 = e->v0[l];
+            v1 = e->v1[l];
+            for (c = 0; c < 3; c++) {
+                PT(pt_next, v0, c) += x[c][l];
+                PT(pt_next, v1, c) += x[c][l];
+            }
+        }
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/*
+ * Renumbers the vertices and reorders the edges for locality, see
+ * reorder.h. vperm keeps every vertex's new number for the output.
+ */
+int graph_reorder(int method) {
+    int i;
+
+    if (vperm == NULL) {
+        vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        eperm = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v0 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v1 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        if (vperm == NULL || eperm == NULL || reorder_v0 == NULL ||
+                reorder_v1 == NULL) {
+            return -1;
+        }
+    }
+
+    // the edges out of their blocks, for reorder_graph
+    for (i = 0; i < nedges; i++) {
+        reorder_v0[i] = edges[i / WIDTH].v0[i % WIDTH];
+        reorder_v1[i] = edges[i / WIDTH].v1[i % WIDTH];
+    }
+    if (reorder_graph(method, npoints, nedges, reorder_v0, reorder_v1,
+                vperm, eperm) < 0) {
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        edges[i / WIDTH].v0[i % WIDTH] = vperm[reorder_v0[eperm[i]]];
+        edges[i / WIDTH].v1[i % WIDTH] = vperm[reorder_v1[eperm[i]]];
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i;
+    int rv;
+    double time0, time1;
+
+    int c, opt_i;
+    int nloops = 0;
+    char* gt = "";
+    char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    int reorder = REORDER_NONE;
+    int fused = 0;
+    int warmup = 1;
+    struct bench stats;
+    int pass, npasses, v;
+    double before = 0;
+
+    static struct option long_opts[] = {
+        {"help",   no_argument,       0, 0},
+        {"type",   required_argument, 0, 0},
+        {"nloops", required_argument, 0, 0},
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"fused",  no_argument,       0, 0},
+        {"warmup", required_argument, 0, 0},
+        {0, 0, 0, 0}
+    };
+
+    /* Parse command-line arguments */
+    while (1) {
+        c = getopt_long(argc, argv, "", 
+                long_opts, &opt_i);
+
+        if (c == -1) {
+            break;
+        }
+
+        if (c == 0) {
+            switch (opt_i) {
+                case 0:
+                    print_help();
+                    exit(0);
+                case 1:
+                    gt = optarg;
+                    break;
+                case 2:
+                    nloops = atoi(optarg);
+                    break;
+                case 3:
+                    fname = optarg;
+                    break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 10:
+                    fused = 1;
+                    break;
+                case 11:
+                    warmup = atoi(optarg);
+                    break;
+            }
+        } else {
+            print_help();
+            exit(0);
+        }
+    }
+
+    /* check for errors */
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1) {
+        print_help();
+        exit(0);
+    }
+
+
+    // initialize data structures
+    time0 = timer();
+    rv = graph_init(gt, np, ne, seed, fname, save);
+    time1 = timer();
+    if (rv < 0) {
+        printf("Error creating graph. \n");
+        exit(0);
+    }
+    printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+            time1 - time0);
+    printf("Blocks: %d of points, %d of edges, %d wide \n", npblocks,
+            neblocks, WIDTH);
+
+    cody_init("umma", argv[0]);
+    if (bench_init(&stats, nloops) < 0) {
+        printf("Error allocating timers. \n");
+        exit(0);
+    }
+
+    if (fused) {
+        pt_next = (struct point_block*) umma_alloc(npblocks,
+                sizeof(struct point_block), huge_pages);
+        if (pt_next == NULL) {
+            printf("Error allocating points. \n");
+            exit(0);
+        }
+    }
+
+    // initialize data structures
+    data_init();
+    edge_data_init();
+
+    // one pass on the graph as generated and, when reordering, one more
+    // on the reordered graph
+    npasses = (reorder == REORDER_NONE) ? 1 : 2;
+    for (pass = 0; pass < npasses; pass++) {
+        if (pass == 1) {
+            before = (time1 - time0) / ((float) nloops);
+
+            time0 = timer();
+            rv = graph_reorder(reorder);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error reordering graph. \n");
+                exit(0);
+            }
+            printf("Reorder: %f s \n", time1 - time0);
+
+            // the point and edge data start out uniform, so are just reset
+            data_init();
+            edge_data_init();
+        }
+
+        // loop, after the warm-up loops
+        for (i = -warmup; i < nloops; i++) {
+            if (i == 0) {
+                // the data are reset after the warm-up, as they start out
+                // uniform
+                if (warmup > 0) {
+                    data_init();
+                    edge_data_init();
+                }
+                time0 = timer();
+            }
+            bench_loop(&stats, i);
+            if (fused) {
+                edge_fused();
+                bench_phase(&stats, PHASE_FUSED);
+            } else {
+                edge_gather();
+                bench_phase(&stats, PHASE_GATHER);
+                edge_compute();
+                bench_phase(&stats, PHASE_COMPUTE);
+                edge_scatter();
+                bench_phase(&stats, PHASE_SCATTER);
+            }
+        }
+        time1 = timer();
+    }
+
+
+    // print results, by the numbers of the generated graph
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = (reorder == REORDER_NONE) ? i : vperm[i];
+        printf("%i : %f %f %f \n", i, PT(pt_data, v, 0),
+                PT(pt_data, v, 1), PT(pt_data, v, 2));
+    }
+
+    if (reorder != REORDER_NONE) {
+        printf("Time before reordering: %f s \n", before);
+    }
+    printf("Time: %f s \n", (time1 - time0) / ((float) nloops));
+    bench_report(&stats, npoints, nedges);
+    bench_free(&stats);
+    cody_finish();
+
+    return 0;
+}
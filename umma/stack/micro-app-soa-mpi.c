@@ -0,0 +1,761 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <mpi.h>
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
+#include "graph.h"
+#include "reorder.h"
+
+/* defaults for --npoints and --nedges */
+#define NPOINTS 10000
+#define NEDGES  10000
+
+/* message tags of the two halo exchanges */
+#define TAG_GATHER  1
+#define TAG_SCATTER 2
+
+struct graph {
+    int* v0;
+    int* v1;
+    float (*v0_data)[3];
+    float (*v1_data)[3];
+    float* data;
+};
+
+/* sizes of the whole graph */
+int npoints;
+int nedges;
+int huge_pages = 0;
+
+int rank;
+int nranks;
+
+/*
+ * This rank's share: the block of nowned points from first_owned, then
+ * the nghosts other ranks own that its edges reach. Its nlocal edges are
+ * those whose v0 it owns, the ninterior with both points owned first, in
+ * local numbers.
+ */
+int first_owned;
+int nowned;
+int nghosts;
+int nlocal;
+int ninterior;
+
+float (*pt_data)[3];
+/* the points the fused pass adds to, see halo_fused */
+float (*pt_next)[3];
+float* edge_data;
+struct graph gr;
+
+/* global number of every ghost, ascending, so rank q's ghosts are
+ * recv_start[q] to recv_start[q+1]-1 */
+int* ghost_ids;
+int* recv_start;
+/* owned points rank q has as ghosts, send_list[send_start[q]] to
+ * send_list[send_start[q+1]-1], and their data in either exchange */
+int* send_start;
+int* send_list;
+float (*send_buf)[3];
+MPI_Request* reqs;
+int nreqs;
+
+/* new number of every vertex, see graph_partition */
+int* vperm;
+
+void print_help() {
+    printf("Usage: \n");
+    printf("\t --help print this message and exit \n");
+    printf("\t --type Type of graph, must be one of:\n");
+    printf("\t\t\t pure_random \n");
+    printf("\t\t\t regular_random \n");
+    printf("\t\t\t contiguous \n");
+    printf("\t --nloops Number of repetitions, must be \n");
+    printf("\t          at least one. \n");
+    printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --reorder Numbering the points are split in blocks by, \n");
+    printf("\t           one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
+    printf("\t --fused Gather, compute and scatter in one pass \n");
+}
+
+double timer() {
+    return cody_now();
+}
+
+/* first point rank r owns */
+int block_start(int r) {
+    return (int) ((long long) r * npoints / nranks);
+}
+
+int owner(int v) {
+    int r = (int) ((long long) v * nranks / npoints);
+
+    while (v < block_start(r)) {
+        r--;
+    }
+    while (v >= block_start(r + 1)) {
+        r++;
+    }
+    return r;
+}
+
+/*
+ * Allocates this rank's graph for ne edges and its points, zeroed, and
+ * the point and edge data.
+ */
+int graph_alloc(int ne) {
+    int np = nowned + nghosts;
+
+    gr.v0 = (int*) umma_alloc(ne, sizeof(int), huge_pages);
+    gr.v1 = (int*) umma_alloc(ne, sizeof(int), huge_pages);
+    gr.v0_data = (float (*)[3]) umma_alloc(ne, 3 * sizeof(float), huge_pages);
+    gr.v1_data = (float (*)[3]) umma_alloc(ne, 3 * sizeof(float), huge_pages);
+    gr.data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    pt_data = (float (*)[3]) umma_alloc(np, 3 * sizeof(float), huge_pages);
+    edge_data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    if (gr.v0 == NULL || gr.v1 == NULL || gr.v0_data == NULL ||
+            gr.v1_data == NULL || gr.data == NULL || pt_data == NULL ||
+            edge_data == NULL) {
+        return -1;
+    }
+
+    return 0;
+}
+
+/*
+ * Every rank creates the same graph, renumbers it with the reordering
+ * method, and keeps the block of points block_start(rank) on and the
+ * edges from them. A rank's edges to points of other ranks make those its
+ * ghosts.
+ */
+int graph_partition(char* graph_type, int np, int ne, unsigned long seed,
+        char* fname, char* save, int method) {
+    struct edge_list el;
+    int* v0;
+    int* v1;
+    int* eperm;
+    int* local;
+    int i, k, a, b, ni, nb;
+
+    if (graph_create(graph_type, np, ne, seed, fname, &el) < 0) {
+        return -1;
+    }
+    if (save != NULL && rank == 0 && graph_save(save, &el) < 0) {
+        graph_release(&el);
+        return -1;
+    }
+    npoints = el.npoints;
+    nedges = el.nedges;
+
+    // the graph renumbered, for the blocks to be local
+    vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+    eperm = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+    v0 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+    v1 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+    local = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+    if (vperm == NULL || eperm == NULL || v0 == NULL || v1 == NULL ||
+            local == NULL || reorder_graph(method, npoints, nedges, el.v0,
+                el.v1, vperm, eperm) < 0) {
+        graph_release(&el);
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        v0[i] = vperm[el.v0[eperm[i]]];
+        v1[i] = vperm[el.v1[eperm[i]]];
+    }
+    graph_release(&el);
+    umma_free(eperm);
+
+    // owned points, then ghosts in ascending order, numbered locally
+    first_owned = block_start(rank);
+    nowned = block_start(rank + 1) - first_owned;
+    for (i = 0; i < npoints; i++) {
+        local[i] = -1;
+    }
+    nlocal = 0;
+    ninterior = 0;
+    for (i = 0; i < nedges; i++) {
+        if (owner(v0[i]) == rank) {
+            nlocal++;
+            if (owner(v1[i]) == rank) {
+                ninterior++;
+            } else {
+                local[v1[i]] = 0;
+            }
+        }
+    }
+    for (i = first_owned; i < first_owned + nowned; i++) {
+        local[i] = i - first_owned;
+    }
+    nghosts = 0;
+    for (i = 0; i < npoints; i++) {
+        if (local[i] == 0 && owner(i) != rank) {
+            local[i] = nowned + nghosts++;
+        }
+    }
+
+    if (graph_alloc(nlocal) < 0) {
+        return -1;
+    }
+    ghost_ids = (int*) umma_alloc(nghosts + 1, sizeof(int), huge_pages);
+    if (ghost_ids == NULL) {
+        return -1;
+    }
+    for (i = 0; i < npoints; i++) {
+        if (local[i] >= nowned) {
+            ghost_ids[local[i] - nowned] = i;
+        }
+    }
+
+    // interior edges first, then those to ghosts
+    ni = 0;
+    nb = ninterior;
+    for (i = 0; i < nedges; i++) {
+        a = v0[i];
+        b = v1[i];
+        if (owner(a) != rank) {
+            continue;
+        }
+        k = (local[b] < nowned) ? ni++ : nb++;
+        gr.v0[k] = local[a];
+        gr.v1[k] = local[b];
+    }
+
+    umma_free(v0);
+    umma_free(v1);
+    umma_free(local);
+
+    return 0;
+}
+
+/*
+ * Lists the ghosts of each rank by their owner, and with the owners the
+ * points they have to send to each rank, from the ghost numbers every
+ * rank sends them.
+ */
+int halo_init() {
+    int* recv_count;
+    int* send_count;
+    int q, k;
+
+    recv_start = (int*) umma_alloc(nranks + 1, sizeof(int), huge_pages);
+    send_start = (int*) umma_alloc(nranks + 1, sizeof(int), huge_pages);
+    recv_count = (int*) umma_alloc(nranks, sizeof(int), huge_pages);
+    send_count = (int*) umma_alloc(nranks, sizeof(int), huge_pages);
+    reqs = (MPI_Request*) umma_alloc(2 * nranks, sizeof(MPI_Request),
+            huge_pages);
+    if (recv_start == NULL || send_start == NULL || recv_count == NULL ||
+            send_count == NULL || reqs == NULL) {
+        return -1;
+    }
+
+    for (k = 0; k < nghosts; k++) {
+        recv_count[owner(ghost_ids[k])]++;
+    }
+    MPI_Alltoall(recv_count, 1, MPI_INT, send_count, 1, MPI_INT,
+            MPI_COMM_WORLD);
+    for (q = 0; q < nranks; q++) {
+        recv_start[q+1] = recv_start[q] + recv_count[q];
+        send_start[q+1] = send_start[q] + send_count[q];
+    }
+
+    send_list = (int*) umma_alloc(send_start[nranks] + 1, sizeof(int),
+            huge_pages);
+    send_buf = (float (*)[3]) umma_alloc(send_start[nranks] + 1,
+            3 * sizeof(float), huge_pages);
+    if (send_list == NULL || send_buf == NULL) {
+        return -1;
+    }
+    // the global numbers of the points wanted, then their local ones
+    MPI_Alltoallv(ghost_ids, recv_count, recv_start, MPI_INT,
+            send_list, send_count, send_start, MPI_INT, MPI_COMM_WORLD);
+    for (k = 0; k < send_start[nranks]; k++) {
+        send_list[k] -= first_owned;
+    }
+
+    umma_free(recv_count);
+    umma_free(send_count);
+
+    return 0;
+}
+
+/* starts receiving the ghosts' points from their owners and sending
+ * theirs to the ranks that have them as ghosts */
+int halo_gather_start() {
+    int q, k, n;
+
+    nreqs = 0;
+    for (q = 0; q < nranks; q++) {
+        n = recv_start[q+1] - recv_start[q];
+        if (n > 0) {
+            MPI_Irecv(pt_data[nowned + recv_start[q]], 3 * n, MPI_FLOAT, q,
+                    TAG_GATHER, MPI_COMM_WORLD, &reqs[nreqs++]);
+        }
+    }
+    for (k = 0; k < send_start[nranks]; k++) {
+        send_buf[k][0] = pt_data[send_list[k]][0];
+        send_buf[k][1] = pt_data[send_list[k]][1];
+        send_buf[k][2] = pt_data[send_list[k]][2];
+    }
+    for (q = 0; q < nranks; q++) {
+        n = send_start[q+1] - send_start[q];
+        if (n > 0) {
+            MPI_Isend(send_buf[send_start[q]], 3 * n, MPI_FLOAT, q,
+                    TAG_GATHER, MPI_COMM_WORLD, &reqs[nreqs++]);
+        }
+    }
+
+    return 0;
+}
+
+/* the reverse: starts sending the ghosts' contributions to their owners
+ * and receiving those to the owned points */
+int halo_scatter_start() {
+    int q, n;
+
+    nreqs = 0;
+    for (q = 0; q < nranks; q++) {
+        n = send_start[q+1] - send_start[q];
+        if (n > 0) {
+            MPI_Irecv(send_buf[send_start[q]], 3 * n, MPI_FLOAT, q,
+                    TAG_SCATTER, MPI_COMM_WORLD, &reqs[nreqs++]);
+        }
+    }
+    for (q = 0; q < nranks; q++) {
+        n = recv_start[q+1] - recv_start[q];
+        if (n > 0) {
+            MPI_Isend(pt_data[nowned + recv_start[q]], 3 * n, MPI_FLOAT, q,
+                    TAG_SCATTER, MPI_COMM_WORLD, &reqs[nreqs++]);
+        }
+    }
+
+    return 0;
+}
+
+/* waits for the scatter exchange and adds the contributions received */
+int halo_scatter_finish() {
+    int k;
+
+    MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+    for (k = 0; k < send_start[nranks]; k++) {
+        pt_data[send_list[k]][0] += send_buf[k][0];
+        pt_data[send_list[k]][1] += send_buf[k][1];
+        pt_data[send_list[k]][2] += send_buf[k][2];
+    }
+
+    return 0;
+}
+
+int data_init() {
+    int i;
+
+    for (i = 0; i < nowned + nghosts; i++) {
+        pt_data[i][0] = 1;
+        pt_data[i][1] = 1;
+        pt_data[i][2] = 1;
+    }
+
+    return 0;
+}
+
+int edge_data_init() {
+    int i;
+
+    for (i = 0; i < nlocal; i++) {
+        edge_data[i] = 1;
+    }
+
+    return 0;
+}
+
+/* edges lo to hi-1 */
+int edge_gather(int lo, int hi) {
+    int i;
+    int v0;
+    int v1;
+
+    for (i = lo; i < hi; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        gr.v0_data[i][0] = pt_data[v0][0];
+        gr.v0_data[i][1] = pt_data[v0][1];
+        gr.v0_data[i][2] = pt_data[v0][2];
+
+        gr.v1_data[i][0] = pt_data[v1][0];
+        gr.v1_data[i][1] = pt_data[v1][1];
+        gr.v1_data[i][2] = pt_data[v1][2];
+
+        gr.data[i] = edge_data[i];
+    }
+
+    return 0;
+}
+
+int edge_compute() {
+    int i;
+    float x0, x1, x2;
+
+    for (i = 0; i < nlocal; i++) {
+        x0 = (gr.v0_data[i][0] + gr.v1_data[i][0]) * gr.data[i];
+        x1 = (gr.v0_data[i][1] + gr.v1_data[i][1]) * gr.data[i];
+        x2 = (gr.v0_data[i][2] + gr.v1_data[i][2]) * gr.data[i];
+
+        gr.v0_data[i][0] = x0;
+        gr.v0_data[i][1] = x1;
+        gr.v0_data[i][2] = x2;
+
+        gr.v1_data[i][0] = x0;
+        gr.v1_data[i][1] = x1;
+        gr.v1_data[i][2] = x2;
+    }
+
+    return 0;
+}
+
+/* edges lo to hi-1 */
+int edge_scatter(int lo, int hi) {
+    int i;
+    int v0;
+    int v1;
+
+    for (i = lo; i < hi; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        pt_data[v0][0] += gr.v0_data[i][0];
+        pt_data[v0][1] += gr.v0_data[i][1];
+        pt_data[v0][2] += gr.v0_data[i][2];
+
+        pt_data[v1][0] += gr.v1_data[i][0];
+        pt_data[v1][1] += gr.v1_data[i][1];
+        pt_data[v1][2] += gr.v1_data[i][2];
+    }
+
+    return 0;
+}
+
+/*
+ * Gather with the ghosts' points in flight while the interior edges
+ * gather, and the boundary edges after they arrive.
+ */
+int halo_gather() {
+    halo_gather_start();
+    edge_gather(0, ninterior);
+    MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+    edge_gather(ninterior, nlocal);
+
+    return 0;
+}
+
+/*
+ * Scatter: the boundary edges add to the ghosts, zeroed, which go to their
+ * owners while the interior edges scatter, and the owners add them.
+ */
+int halo_scatter() {
+    int k;
+
+    for (k = nowned; k < nowned + nghosts; k++) {
+        pt_data[k][0] = 0;
+        pt_data[k][1] = 0;
+        pt_data[k][2] = 0;
+    }
+    edge_scatter(ninterior, nlocal);
+    halo_scatter_start();
+    edge_scatter(0, ninterior);
+    halo_scatter_finish();
+
+    return 0;
+}
+
+/* edges lo to hi-1 gathered, computed and scattered in one pass, reading
+ * the points in src and adding to dst */
+int edge_fused(float (*src)[3], float (*dst)[3], int lo, int hi) {
+    int i;
+    int v0;
+    int v1;
+    float x0, x1, x2;
+
+    for (i = lo; i < hi; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
+
+        x0 = (src[v0][0] + src[v1][0]) * edge_data[i];
+        x1 = (src[v0][1] + src[v1][1]) * edge_data[i];
+        x2 = (src[v0][2] + src[v1][2]) * edge_data[i];
+
+        dst[v0][0] += x0;
+        dst[v0][1] += x1;
+        dst[v0][2] += x2;
+
+        dst[v1][0] += x0;
+        dst[v1][1] += x1;
+        dst[v1][2] += x2;
+    }
+
+    return 0;
+}
+
+/*
+ * The three passes fused: the edges read pt_data and add to pt_next, a
+ * copy of the owned points with the ghosts zeroed, and the two are then
+ * swapped. The points reach every edge in the order halo_scatter adds
+ * them, boundary edges first, so the results are the three passes'
+ * exactly; the ghosts' points are therefore awaited before any edge, and
+ * only the scatter exchange overlaps the interior edges.
+ */
+int halo_fused() {
+    float (*tmp)[3];
+
+    memcpy(pt_next, pt_data, (size_t) nowned * 3 * sizeof(float));
+    memset(pt_next[nowned], 0, (size_t) nghosts * 3 * sizeof(float));
+    halo_gather_start();
+    MPI_Waitall(nreqs, reqs, MPI_STATUSES_IGNORE);
+    edge_fused(pt_data, pt_next, ninterior, nlocal);
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    halo_scatter_start();
+    edge_fused(pt_next, pt_data, 0, ninterior);
+    halo_scatter_finish();
+
+    return 0;
+}
+
+/* print_help on rank 0 and exit, as every rank parses the same options */
+void usage() {
+    if (rank == 0) {
+        print_help();
+    }
+    MPI_Finalize();
+    exit(0);
+}
+
+/* an error on any rank stops them all */
+void fail(char* msg) {
+    printf("%s \n", msg);
+    MPI_Abort(MPI_COMM_WORLD, 1);
+}
+
+int main(int argc, char** argv) {
+    int i;
+    int rv;
+    double time0, time1, t;
+
+    int c, opt_i;
+    int nloops = 0;
+    char* gt = "";
+    char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    int reorder = REORDER_NONE;
+    int warmup = 1;
+    int fused = 0;
+    struct bench stats;
+    int v;
+    int counts[3], max_counts[3], sum_counts[3];
+    float res[10][3], sum_res[10][3];
+
+    static struct option long_opts[] = {
+        {"help",   no_argument,       0, 0},
+        {"type",   required_argument, 0, 0},
+        {"nloops", required_argument, 0, 0},
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"warmup", required_argument, 0, 0},
+        {"fused",  no_argument,       0, 0},
+        {0, 0, 0, 0}
+    };
+
+    MPI_Init(&argc, &argv);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+    /* Parse command-line arguments, the same on every rank */
+    while (1) {
+        c = getopt_long(argc, argv, "", 
+                long_opts, &opt_i);
+
+        if (c == -1) {
+            break;
+        }
+
+        if (c == 0) {
+            switch (opt_i) {
+                case 0:
+                    usage();
+                case 1:
+                    gt = optarg;
+                    break;
+                case 2:
+                    nloops = atoi(optarg);
+                    break;
+                case 3:
+                    fname = optarg;
+                    break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        usage();
+                    }
+                    break;
+                case 10:
+                    warmup = atoi(optarg);
+                    break;
+                case 11:
+                    fused = 1;
+                    break;
+            }
+        } else {
+            usage();
+        }
+    }
+
+    /* check for errors */
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1) {
+        usage();
+    }
+
+
+    // initialize data structures
+    time0 = timer();
+    rv = graph_partition(gt, np, ne, seed, fname, save, reorder);
+    if (rv == 0) {
+        rv = halo_init();
+    }
+    time1 = timer();
+    if (rv < 0) {
+        fail("Error creating graph.");
+    }
+    if (rank == 0) {
+        printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+                time1 - time0);
+    }
+    counts[0] = nghosts;
+    counts[1] = 0;
+    for (i = 0; i < nranks; i++) {
+        counts[1] += (recv_start[i+1] > recv_start[i]);
+    }
+    counts[2] = ninterior;
+    MPI_Reduce(counts, max_counts, 3, MPI_INT, MPI_MAX, 0, MPI_COMM_WORLD);
+    MPI_Reduce(counts, sum_counts, 3, MPI_INT, MPI_SUM, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+        printf("Ranks: %d, up to %d ghosts and %d neighbors each, %d "
+                "interior edges \n", nranks, max_counts[0], max_counts[1],
+                sum_counts[2]);
+    }
+
+    cody_init("umma", argv[0]);
+    cody_rank(rank, nranks);
+    if (bench_init(&stats, nloops) < 0) {
+        fail("Error allocating timers.");
+    }
+
+    if (fused) {
+        pt_next = (float (*)[3]) umma_alloc(nowned + nghosts,
+                3 * sizeof(float), huge_pages);
+        if (pt_next == NULL) {
+            fail("Error allocating points.");
+        }
+    }
+
+    // initialize data structures
+    data_init();
+    edge_data_init();
+
+    // loop, after the warm-up loops
+    for (i = -warmup; i < nloops; i++) {
+        if (i == 0) {
+            // the data are reset after the warm-up, as they start out
+            // uniform
+            if (warmup > 0) {
+                data_init();
+                edge_data_init();
+            }
+            MPI_Barrier(MPI_COMM_WORLD);
+            time0 = timer();
+        }
+        bench_loop(&stats, i);
+        if (fused) {
+            halo_fused();
+            bench_phase(&stats, PHASE_FUSED);
+        } else {
+            halo_gather();
+            bench_phase(&stats, PHASE_GATHER);
+            edge_compute();
+            bench_phase(&stats, PHASE_COMPUTE);
+            halo_scatter();
+            bench_phase(&stats, PHASE_SCATTER);
+        }
+    }
+    time1 = timer();
+    t = time1 - time0;
+    MPI_Reduce(&t, &time1, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+
+    // print results, by the numbers of the generated graph, from their
+    // owners
+    memset(res, 0, sizeof(res));
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = vperm[i];
+        if (owner(v) == rank) {
+            res[i][0] = pt_data[v - first_owned][0];
+            res[i][1] = pt_data[v - first_owned][1];
+            res[i][2] = pt_data[v - first_owned][2];
+        }
+    }
+    MPI_Reduce(res, sum_res, 30, MPI_FLOAT, MPI_SUM, 0, MPI_COMM_WORLD);
+
+    if (rank == 0) {
+        for (i = 0; i < 10 && i < npoints; i++) {
+            printf("%i : %f %f %f \n", i, sum_res[i][0], sum_res[i][1],
+                    sum_res[i][2]);
+        }
+        printf("Time: %f s \n", time1 / ((float) nloops));
+        // rank 0's phases, the halo exchanges being in gather and scatter
+        bench_report(&stats, nowned, nlocal);
+    }
+    bench_free(&stats);
+    cody_finish();
+
+    MPI_Finalize();
+
+    return 0;
+}
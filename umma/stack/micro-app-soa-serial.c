@@ -1,26 +1,67 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
 #include <getopt.h>
-#include <lua.h>
-#include <lauxlib.h>
-#include <lualib.h>
-
+#include "alloc.h"
+#include "bench.h"
+#include "cody.h"
+#include "cindex.h"
+#include "graph.h"
+#include "reorder.h"
+
+/* defaults for --npoints and --nedges */
 #define NPOINTS 10000
 #define NEDGES  10000
 
+/* most --fields */
+#define MAX_FIELDS 32
+
+/* the nfields floats of element k of a */
+#define FIELDS(a, k) ((a) + (size_t) (k) * nfields)
+
 struct graph {
-    int v0[NEDGES];
-    int v1[NEDGES];
-    float v0_data[NEDGES][3];
-    float v1_data[NEDGES][3];
-    float data[NEDGES];
+    int* v0;
+    int* v1;
+    float* v0_data;
+    float* v1_data;
+    float* data;
 };
 
-float pt_data[NPOINTS][3];
-float edge_data[NEDGES];
+/* sizes of the graph, see graph_alloc */
+int npoints;
+int nedges;
+int huge_pages = 0;
+
+/* floats per point and per staged endpoint, see --fields */
+int nfields = 3;
+
+float* pt_data;
+/* the points the fused pass adds to, see edge_fused */
+float* pt_next;
+float* edge_data;
 struct graph gr;
 
+/* new number of every vertex and old position of every edge, see
+ * graph_reorder */
+int* vperm;
+int* eperm;
+int* reorder_v0;
+int* reorder_v1;
+
+/* see --prefetch and --window, 0 if off */
+int prefetch_dist = 0;
+int window_size = 0;
+
+/* endpoints of every window of window_size edges sorted by vertex, see
+ * window_init */
+int* win_refs;
+int* win_verts;
+long long* win_keys;
+
+/* see --compress, and the compressed endpoints, see cindex.h */
+int compress = 0;
+struct cindex ci;
+
 void print_help() {
     printf("Usage: \n");
     printf("\t --help print this message and exit \n");
@@ -31,79 +72,89 @@ void print_help() {
     printf("\t --nloops Number of repetitions, must be \n");
     printf("\t          at least one. \n");
     printf("\t --file File from which to read graph \n");
+    printf("\t --npoints Points of the generated graph (%d) \n", NPOINTS);
+    printf("\t --nedges Edges, or edges per point for regular_random \n");
+    printf("\t          (%d) \n", NEDGES);
+    printf("\t --huge Back the arrays with huge pages \n");
+    printf("\t --seed Seed of the random graphs (%d) \n", GRAPH_SEED);
+    printf("\t --save File to write the graph to, for --type file \n");
+    printf("\t --fused Gather, compute and scatter in one pass \n");
+    printf("\t --reorder Reordering for locality, one of:\n");
+    printf("\t\t\t none (default) \n");
+    printf("\t\t\t edges \n");
+    printf("\t\t\t rcm \n");
+    printf("\t --warmup Untimed loops first, their results reset (1) \n");
+    printf("\t --prefetch Prefetch the points of the edge this many \n");
+    printf("\t            ahead in the gather (0, off) \n");
+    printf("\t --window Gather the endpoints of this many edges at a \n");
+    printf("\t          time, in vertex order (0, off) \n");
+    printf("\t --compress Read the endpoints as 16 bit offsets from a \n");
+    printf("\t            base per block of %d edges \n", CINDEX_BLOCK);
+    printf("\t --fields Floats per point, 1 to %d (3) \n", MAX_FIELDS);
 }
 
 double timer() {
-    struct timeval tp;
-    struct timezone tzp;
-    long i;
-
-    i = gettimeofday(&tp, &tzp);
-    return ((double)tp.tv_sec) + ((double) tp.tv_usec) * 1e-6;
+    return cody_now();
 }
 
-int graph_init(char* graph_type, char* fname) {
-    lua_State *L;
-    int i, j, k, v;
-
-    L = luaL_newstate();
-    luaL_openlibs(L);
-    luaL_loadfile(L, "graph.lua");
-    lua_pcall(L, 0, 0, 0);
-
-    lua_getglobal(L, "create_graph");
-    lua_pushstring(L, graph_type);
-    lua_pushinteger(L, NPOINTS);
-    lua_pushinteger(L, NEDGES);
-
-    if (fname != NULL) {
-        lua_pushstring(L, fname);
-        lua_call(L, 4, 1);
-    } else {
-        lua_call(L, 3, 1);
-    }
-
-    /* Table is now sitting at the top of the stack */
-    i = 0;
-    lua_pushnil(L);  /* Make sure lua_next starts at beginning */
-    while (lua_next(L, -2) != 0) {
-        // fetch first key
-        k = lua_tointeger(L, -2);
-        lua_pushnil(L);
-        while (lua_next(L, -2) != 0) { // loop over neighbors
-            lua_pop(L,1);
-            v = lua_tointeger(L, -1);
-
-            // build the graph
-            gr.v0[i] = k - 1;
-            gr.v1[i] = v - 1;
-
-            for (j = 0; j < 3; j++) {
-                gr.v0_data[i][j] = 0;
-                gr.v1_data[i][j] = 0;
-            }
-
-            i++;
-        }
-        lua_pop(L,1);
+/*
+ * Allocates the graph for np points and ne edges, zeroed, and the point
+ * and edge data.
+ */
+int graph_alloc(int np, int ne) {
+    npoints = np;
+    nedges = ne;
+
+    gr.v0 = (int*) umma_alloc(ne, sizeof(int), huge_pages);
+    gr.v1 = (int*) umma_alloc(ne, sizeof(int), huge_pages);
+    gr.v0_data = (float*) umma_alloc(ne, nfields * sizeof(float), huge_pages);
+    gr.v1_data = (float*) umma_alloc(ne, nfields * sizeof(float), huge_pages);
+    gr.data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    pt_data = (float*) umma_alloc(np, nfields * sizeof(float), huge_pages);
+    edge_data = (float*) umma_alloc(ne, sizeof(float), huge_pages);
+    if (gr.v0 == NULL || gr.v1 == NULL || gr.v0_data == NULL ||
+            gr.v1_data == NULL || gr.data == NULL || pt_data == NULL ||
+            edge_data == NULL) {
+        return -1;
     }
 
-    lua_close(L);
+    return 0;
+}
 
-    if (i == 0) {
+/*
+ * Creates the graph with graph_create, writes it to save unless that is
+ * NULL, and copies its edges into the graph's arrays.
+ */
+int graph_init(char* graph_type, int np, int ne, unsigned long seed,
+        char* fname, char* save) {
+    struct edge_list el;
+    int i;
+
+    if (graph_create(graph_type, np, ne, seed, fname, &el) < 0) {
+        return -1;
+    }
+    if ((save != NULL && graph_save(save, &el) < 0) ||
+            graph_alloc(el.npoints, el.nedges) < 0) {
+        graph_release(&el);
         return -1;
-    } else {
-        return 0;
     }
+
+    for (i = 0; i < nedges; i++) {
+        gr.v0[i] = el.v0[i];
+        gr.v1[i] = el.v1[i];
+    }
+    graph_release(&el);
+
+    return 0;
 }
 
 int data_init() {
-    int i;
+    int i, f;
 
-    for (i = 0; i < NPOINTS; i++) {
-        pt_data[i][0] = 1;
-        pt_data[i][1] = 1;
-        pt_data[i][2] = 1;
+    for (i = 0; i < npoints; i++) {
+        for (f = 0; f < nfields; f++) {
+            FIELDS(pt_data, i)[f] = 1;
+        }
     }
 
     return 0;
@@ -112,7 +163,7 @@ int data_init() {
 int edge_data_init() {
     int i;
 
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         edge_data[i] = 1;
     }
 
@@ -120,22 +171,149 @@ int edge_data_init() {
 }
 
 int edge_gather() {
-    int i,j;
+    int i, j, f;
     int v0;
     int v1;
 
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         v0 = gr.v0[i];
         v1 = gr.v1[i];
 
-        gr.v0_data[i][0] = pt_data[v0][0];
-        gr.v0_data[i][1] = pt_data[v0][1];
-        gr.v0_data[i][2] = pt_data[v0][2];
+        for (f = 0; f < nfields; f++) {
+            FIELDS(gr.v0_data, i)[f] = FIELDS(pt_data, v0)[f];
+            FIELDS(gr.v1_data, i)[f] = FIELDS(pt_data, v1)[f];
+        }
+
+        gr.data[i] = edge_data[i];
+    }
+
+    return 0;
+}
+
+/*
+ * edge_gather, prefetching the points of the edge prefetch_dist ahead so
+ * their random loads overlap those of the edges in between.
+ */
+int edge_gather_prefetch() {
+    int i, f;
+    int v0;
+    int v1;
 
-        gr.v1_data[i][0] = pt_data[v1][0];
-        gr.v1_data[i][1] = pt_data[v1][1];
-        gr.v1_data[i][2] = pt_data[v1][2];
+    for (i = 0; i < nedges; i++) {
+        if (i + prefetch_dist < nedges) {
+            __builtin_prefetch(FIELDS(pt_data, gr.v0[i + prefetch_dist]));
+            __builtin_prefetch(FIELDS(pt_data, gr.v1[i + prefetch_dist]));
+        }
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
 
+        for (f = 0; f < nfields; f++) {
+            FIELDS(gr.v0_data, i)[f] = FIELDS(pt_data, v0)[f];
+            FIELDS(gr.v1_data, i)[f] = FIELDS(pt_data, v1)[f];
+        }
+        gr.data[i] = edge_data[i];
+    }
+
+    return 0;
+}
+
+/*
+ * edge_gather on the compressed endpoints, each decoded from its block's
+ * base and its offset as the edge is gathered, or read from gr in a block
+ * that did not fit.
+ */
+int edge_gather_cindex() {
+    int b, i, start, end, base0, base1, f;
+    int v0;
+    int v1;
+
+    for (b = 0; b < ci.nblocks; b++) {
+        start = b * CINDEX_BLOCK;
+        end = (start + CINDEX_BLOCK < nedges) ? start + CINDEX_BLOCK : nedges;
+        base0 = ci.base0[b];
+        base1 = ci.base1[b];
+
+        for (i = start; i < end; i++) {
+            v0 = (base0 < 0) ? gr.v0[i] : base0 + ci.d0[i];
+            v1 = (base1 < 0) ? gr.v1[i] : base1 + ci.d1[i];
+
+            for (f = 0; f < nfields; f++) {
+                FIELDS(gr.v0_data, i)[f] = FIELDS(pt_data, v0)[f];
+                FIELDS(gr.v1_data, i)[f] = FIELDS(pt_data, v1)[f];
+            }
+
+            gr.data[i] = edge_data[i];
+        }
+    }
+
+    return 0;
+}
+
+static int compare_keys(const void* a, const void* b) {
+    long long x = *(const long long*) a;
+    long long y = *(const long long*) b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * Sorts the 2 * window_size endpoints of every window of edges by vertex,
+ * each kept as 2 * edge + 0 if it is the edge's v0 or + 1 if its v1, as
+ * in win_refs[k], and its vertex as win_verts[k].
+ */
+int window_init() {
+    int i, k, n;
+
+    if (win_refs == NULL) {
+        win_refs = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+        win_verts = (int*) umma_alloc(nedges, 2 * sizeof(int), huge_pages);
+        win_keys = (long long*) umma_alloc(nedges, 2 * sizeof(long long),
+                huge_pages);
+        if (win_refs == NULL || win_verts == NULL || win_keys == NULL) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < nedges; i++) {
+        win_keys[2*i] = (long long) gr.v0[i] << 32 | (2 * i);
+        win_keys[2*i+1] = (long long) gr.v1[i] << 32 | (2 * i + 1);
+    }
+    for (k = 0; k < 2 * nedges; k += 2 * window_size) {
+        n = 2 * nedges - k;
+        n = (n < 2 * window_size) ? n : 2 * window_size;
+        qsort(win_keys + k, n, sizeof(long long), compare_keys);
+    }
+    for (k = 0; k < 2 * nedges; k++) {
+        win_verts[k] = (int) (win_keys[k] >> 32);
+        win_refs[k] = (int) (win_keys[k] & 0xffffffff);
+    }
+
+    return 0;
+}
+
+/*
+ * edge_gather a window at a time, loading each window's points in vertex
+ * order, so a point shared by its edges is loaded once and the loads walk
+ * pt_data forwards. Prefetches win_verts[k + prefetch_dist] too.
+ */
+int edge_gather_window() {
+    int i, k, e, v, f;
+    float* p;
+
+    for (k = 0; k < 2 * nedges; k++) {
+        if (prefetch_dist > 0 && k + prefetch_dist < 2 * nedges) {
+            __builtin_prefetch(FIELDS(pt_data, win_verts[k + prefetch_dist]));
+        }
+        e = win_refs[k];
+        v = win_verts[k];
+        p = FIELDS((e & 1) ? gr.v1_data : gr.v0_data, e >> 1);
+
+        for (f = 0; f < nfields; f++) {
+            p[f] = FIELDS(pt_data, v)[f];
+        }
+    }
+
+    for (i = 0; i < nedges; i++) {
         gr.data[i] = edge_data[i];
     }
 
@@ -143,62 +321,179 @@ int edge_gather() {
 }
 
 int edge_compute() {
-    int i, j;
-    float v0_p0, v0_p1, v0_p2;
-    float v1_p0, v1_p1, v1_p2;
-    float x0, x1, x2;
+    int i, f;
+    float* p0;
+    float* p1;
+    float x;
     float e_data;
 
-    for (i = 0; i < NEDGES; i++) {
-        v0_p0 = gr.v0_data[i][0];
-        v0_p1 = gr.v0_data[i][1];
-        v0_p2 = gr.v0_data[i][2];
+    for (i = 0; i < nedges; i++) {
+        p0 = FIELDS(gr.v0_data, i);
+        p1 = FIELDS(gr.v1_data, i);
+        e_data = gr.data[i];
 
-        v1_p0 = gr.v1_data[i][0];
-        v1_p1 = gr.v1_data[i][1];
-        v1_p2 = gr.v1_data[i][2];
+        for (f = 0; f < nfields; f++) {
+            x = (p0[f] + p1[f]) * e_data;
+            p0[f] = x;
+            p1[f] = x;
+        }
+    }
 
-        e_data = gr.data[i];
+    return 0;
+}
 
-        x0 = (v0_p0 + v1_p0) * e_data;
-        x1 = (v0_p1 + v1_p1) * e_data;
-        x2 = (v0_p2 + v1_p2) * e_data;
+int edge_scatter() {
+    int i, f;
+    int v0;
+    int v1;
 
-        gr.v0_data[i][0] = x0;
-        gr.v0_data[i][1] = x1;
-        gr.v0_data[i][2] = x2;
+    for (i = 0; i < nedges; i++) {
+        v0 = gr.v0[i];
+        v1 = gr.v1[i];
 
-        gr.v1_data[i][0] = x0;
-        gr.v1_data[i][1] = x1;
-        gr.v1_data[i][2] = x2;
+        for (f = 0; f < nfields; f++) {
+            FIELDS(pt_data, v0)[f] += FIELDS(gr.v0_data, i)[f];
+            FIELDS(pt_data, v1)[f] += FIELDS(gr.v1_data, i)[f];
+        }
     }
 
     return 0;
 }
 
-int edge_scatter() {
-    int i;
+/* edge_scatter on the compressed endpoints, see edge_gather_cindex */
+int edge_scatter_cindex() {
+    int b, i, start, end, base0, base1, f;
+    int v0;
+    int v1;
+
+    for (b = 0; b < ci.nblocks; b++) {
+        start = b * CINDEX_BLOCK;
+        end = (start + CINDEX_BLOCK < nedges) ? start + CINDEX_BLOCK : nedges;
+        base0 = ci.base0[b];
+        base1 = ci.base1[b];
+
+        for (i = start; i < end; i++) {
+            v0 = (base0 < 0) ? gr.v0[i] : base0 + ci.d0[i];
+            v1 = (base1 < 0) ? gr.v1[i] : base1 + ci.d1[i];
+
+            for (f = 0; f < nfields; f++) {
+                FIELDS(pt_data, v0)[f] += FIELDS(gr.v0_data, i)[f];
+                FIELDS(pt_data, v1)[f] += FIELDS(gr.v1_data, i)[f];
+            }
+        }
+    }
+
+    return 0;
+}
+
+/*
+ * Gathers, computes and scatters in one pass, without staging the endpoint
+ * data in the graph. The pass reads pt_data and adds to pt_next, a copy of
+ * it, so every edge sees the values the three passes would have. The two
+ * are then swapped.
+ */
+int edge_fused() {
+    int i, f;
     int v0;
     int v1;
+    float x;
+    float* tmp;
+
+    memcpy(pt_next, pt_data, (size_t) npoints * nfields * sizeof(float));
 
-    for (i = 0; i < NEDGES; i++) {
+    for (i = 0; i < nedges; i++) {
         v0 = gr.v0[i];
         v1 = gr.v1[i];
 
-        pt_data[v0][0] += gr.v0_data[i][0];
-        pt_data[v0][1] += gr.v0_data[i][1];
-        pt_data[v0][2] += gr.v0_data[i][2];
+        for (f = 0; f < nfields; f++) {
+            x = (FIELDS(pt_data, v0)[f] + FIELDS(pt_data, v1)[f]) *
+                edge_data[i];
 
-        pt_data[v1][0] += gr.v1_data[i][0];
-        pt_data[v1][1] += gr.v1_data[i][1];
-        pt_data[v1][2] += gr.v1_data[i][2];
+            FIELDS(pt_next, v0)[f] += x;
+            FIELDS(pt_next, v1)[f] += x;
+        }
     }
 
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
     return 0;
 }
 
-int main(int argc, char** argv) {
+/* edge_fused on the compressed endpoints, see edge_gather_cindex */
+int edge_fused_cindex() {
+    int b, i, start, end, base0, base1, f;
+    int v0;
+    int v1;
+    float x;
+    float* tmp;
+
+    memcpy(pt_next, pt_data, (size_t) npoints * nfields * sizeof(float));
+
+    for (b = 0; b < ci.nblocks; b++) {
+        start = b * CINDEX_BLOCK;
+        end = (start + CINDEX_BLOCK < nedges) ? start + CINDEX_BLOCK : nedges;
+        base0 = ci.base0[b];
+        base1 = ci.base1[b];
+
+        for (i = start; i < end; i++) {
+            v0 = (base0 < 0) ? gr.v0[i] : base0 + ci.d0[i];
+            v1 = (base1 < 0) ? gr.v1[i] : base1 + ci.d1[i];
+
+            for (f = 0; f < nfields; f++) {
+                x = (FIELDS(pt_data, v0)[f] + FIELDS(pt_data, v1)[f]) *
+                    edge_data[i];
+
+                FIELDS(pt_next, v0)[f] += x;
+                FIELDS(pt_next, v1)[f] += x;
+            }
+        }
+    }
+
+    tmp = pt_data;
+    pt_data = pt_next;
+    pt_next = tmp;
+
+    return 0;
+}
+
+/*
+ * Renumbers the vertices and reorders the edges for locality, see
+ * reorder.h. vperm keeps every vertex's new number for the output.
+ */
+int graph_reorder(int method) {
     int i;
+
+    if (vperm == NULL) {
+        vperm = (int*) umma_alloc(npoints, sizeof(int), huge_pages);
+        eperm = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v0 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        reorder_v1 = (int*) umma_alloc(nedges, sizeof(int), huge_pages);
+        if (vperm == NULL || eperm == NULL || reorder_v0 == NULL ||
+                reorder_v1 == NULL) {
+            return -1;
+        }
+    }
+
+    if (reorder_graph(method, npoints, nedges, gr.v0, gr.v1, vperm,
+                eperm) < 0) {
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        reorder_v0[i] = vperm[gr.v0[eperm[i]]];
+        reorder_v1[i] = vperm[gr.v1[eperm[i]]];
+    }
+    for (i = 0; i < nedges; i++) {
+        gr.v0[i] = reorder_v0[i];
+        gr.v1[i] = reorder_v1[i];
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int i, f;
     int rv;
     double time0, time1;
 
@@ -206,12 +501,35 @@ int main(int argc, char** argv) {
     int nloops = 0;
     char* gt = "";
     char* fname = "";
+    int np = NPOINTS;
+    int ne = NEDGES;
+    unsigned long seed = GRAPH_SEED;
+    char* save = NULL;
+    int reorder = REORDER_NONE;
+    int fused = 0;
+    int warmup = 1;
+    struct bench stats;
+    int pass, npasses, v;
+    double before = 0;
 
     static struct option long_opts[] = {
         {"help",   no_argument,       0, 0},
         {"type",   required_argument, 0, 0},
         {"nloops", required_argument, 0, 0},
-        {"file",   required_argument, 0, 0}
+        {"file",   required_argument, 0, 0},
+        {"npoints", required_argument, 0, 0},
+        {"nedges", required_argument, 0, 0},
+        {"huge",   no_argument,       0, 0},
+        {"seed",   required_argument, 0, 0},
+        {"save",   required_argument, 0, 0},
+        {"reorder", required_argument, 0, 0},
+        {"fused",  no_argument,       0, 0},
+        {"warmup", required_argument, 0, 0},
+        {"prefetch", required_argument, 0, 0},
+        {"window", required_argument, 0, 0},
+        {"compress", no_argument,     0, 0},
+        {"fields", required_argument, 0, 0},
+        {0, 0, 0, 0}
     };
 
     /* Parse command-line arguments */
@@ -237,6 +555,46 @@ int main(int argc, char** argv) {
                 case 3:
                     fname = optarg;
                     break;
+                case 4:
+                    np = atoi(optarg);
+                    break;
+                case 5:
+                    ne = atoi(optarg);
+                    break;
+                case 6:
+                    huge_pages = 1;
+                    break;
+                case 7:
+                    seed = strtoul(optarg, NULL, 10);
+                    break;
+                case 8:
+                    save = optarg;
+                    break;
+                case 9:
+                    reorder = reorder_method(optarg);
+                    if (reorder < 0) {
+                        print_help();
+                        exit(0);
+                    }
+                    break;
+                case 10:
+                    fused = 1;
+                    break;
+                case 11:
+                    warmup = atoi(optarg);
+                    break;
+                case 12:
+                    prefetch_dist = atoi(optarg);
+                    break;
+                case 13:
+                    window_size = atoi(optarg);
+                    break;
+                case 14:
+                    compress = 1;
+                    break;
+                case 15:
+                    nfields = atoi(optarg);
+                    break;
             }
         } else {
             print_help();
@@ -245,39 +603,154 @@ int main(int argc, char** argv) {
     }
 
     /* check for errors */
-    if (gt == NULL || nloops < 1) {
+    if (gt == NULL || nloops < 1 || warmup < 0 || np < 2 || ne < 1 ||
+            prefetch_dist < 0 || window_size < 0 || nfields < 1 ||
+            nfields > MAX_FIELDS ||
+            (compress && (prefetch_dist > 0 || window_size > 0))) {
         print_help();
         exit(0);
     }
 
 
     // initialize data structures
-    rv = graph_init(gt, fname);
+    time0 = timer();
+    rv = graph_init(gt, np, ne, seed, fname, save);
+    time1 = timer();
     if (rv < 0) {
         printf("Error creating graph. \n");
         exit(0);
     }
+    printf("Graph: %d points, %d edges in %f s \n", npoints, nedges,
+            time1 - time0);
+
+    cody_init("umma", argv[0]);
+    if (bench_init(&stats, nloops) < 0) {
+        printf("Error allocating timers. \n");
+        exit(0);
+    }
+    bench_fields(&stats, nfields);
+
+    if (fused) {
+        pt_next = (float*) umma_alloc(npoints, nfields * sizeof(float),
+                huge_pages);
+        if (pt_next == NULL) {
+            printf("Error allocating points. \n");
+            exit(0);
+        }
+    }
 
     // initialize data structures
     data_init();
     edge_data_init();
 
-    // loop
-    time0 = timer();
-    for (i = 0; i < nloops; i++) {
-        edge_gather();
-        edge_compute();
-        edge_scatter();
+    // one pass on the graph as generated and, when reordering, one more
+    // on the reordered graph
+    npasses = (reorder == REORDER_NONE) ? 1 : 2;
+    for (pass = 0; pass < npasses; pass++) {
+        if (pass == 1) {
+            before = (time1 - time0) / ((float) nloops);
+
+            time0 = timer();
+            rv = graph_reorder(reorder);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error reordering graph. \n");
+                exit(0);
+            }
+            printf("Reorder: %f s \n", time1 - time0);
+
+            // the point and edge data start out uniform, so are just reset
+            data_init();
+            edge_data_init();
+        }
+
+        if (window_size > 0) {
+            time0 = timer();
+            rv = window_init();
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error sorting windows. \n");
+                exit(0);
+            }
+            printf("Windows: %d edges in %f s \n", window_size,
+                    time1 - time0);
+        }
+
+        if (compress) {
+            time0 = timer();
+            rv = cindex_build(&ci, nedges, gr.v0, gr.v1, huge_pages);
+            time1 = timer();
+            if (rv < 0) {
+                printf("Error compressing indices. \n");
+                exit(0);
+            }
+            bench_index_bytes(&stats, cindex_bytes(&ci));
+            printf("Compress: %d and %d of %d blocks raw, %.2f bytes per "
+                    "edge in %f s \n", ci.nraw0, ci.nraw1, ci.nblocks,
+                    cindex_bytes(&ci), time1 - time0);
+        }
+
+        // loop, after the warm-up loops
+        for (i = -warmup; i < nloops; i++) {
+            if (i == 0) {
+                // the data are reset after the warm-up, as they start out
+                // uniform
+                if (warmup > 0) {
+                    data_init();
+                    edge_data_init();
+                }
+                time0 = timer();
+            }
+            bench_loop(&stats, i);
+            if (fused) {
+                if (compress) {
+                    edge_fused_cindex();
+                } else {
+                    edge_fused();
+                }
+                bench_phase(&stats, PHASE_FUSED);
+            } else {
+                if (window_size > 0) {
+                    edge_gather_window();
+                } else if (prefetch_dist > 0) {
+                    edge_gather_prefetch();
+                } else if (compress) {
+                    edge_gather_cindex();
+                } else {
+                    edge_gather();
+                }
+                bench_phase(&stats, PHASE_GATHER);
+                edge_compute();
+                bench_phase(&stats, PHASE_COMPUTE);
+                if (compress) {
+                    edge_scatter_cindex();
+                } else {
+                    edge_scatter();
+                }
+                bench_phase(&stats, PHASE_SCATTER);
+            }
+        }
+        time1 = timer();
     }
-    time1 = timer();
 
 
-    // print results
-    for (i = 0; i < 10; i++) {
-        printf("%i : %f %f %f \n", i, pt_data[i][0], pt_data[i][1], pt_data[i][2]);
+    // print results, by the numbers of the generated graph
+    for (i = 0; i < 10 && i < npoints; i++) {
+        v = (reorder == REORDER_NONE) ? i : vperm[i];
+        printf("%i :", i);
+        for (f = 0; f < nfields; f++) {
+            printf(" %f", FIELDS(pt_data, v)[f]);
+        }
+        printf(" \n");
     }
 
+    if (reorder != REORDER_NONE) {
+        printf("Time before reordering: %f s \n", before);
+    }
     printf("Time: %f s \n", (time1 - time0) / ((float) nloops));
+    bench_report(&stats, npoints, nedges);
+    bench_free(&stats);
+    cody_finish();
 
     return 0;
 }
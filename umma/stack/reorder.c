@@ -0,0 +1,167 @@
+#include <stdlib.h>
+#include <string.h>
+#include "reorder.h"
+
+struct edge_key {
+    long long key;
+    int e;
+};
+
+int compare_keys(const void* a, const void* b) {
+    long long ka = ((const struct edge_key*) a)->key;
+    long long kb = ((const struct edge_key*) b)->key;
+
+    return (ka > kb) - (ka < kb);
+}
+
+int reorder_method(const char* name) {
+    if (strcmp(name, "none") == 0) {
+        return REORDER_NONE;
+    } else if (strcmp(name, "edges") == 0) {
+        return REORDER_EDGES;
+    } else if (strcmp(name, "rcm") == 0) {
+        return REORDER_RCM;
+    }
+    return -1;
+}
+
+/*
+ * Reverse Cuthill-McKee: a breadth first search from a vertex of lowest
+ * degree in each component, visiting the neighbors of a vertex by
+ * increasing degree, numbered in reverse. Neighbors end up with nearby
+ * numbers, which keeps the bandwidth of the adjacency matrix low.
+ */
+int rcm(int npoints, int nedges, const int* v0, const int* v1, int* vperm) {
+    int* start;
+    int* adj;
+    int* order;
+    int* deg;
+    int i, j, k, v, w, t, head, tail, nnum, best;
+
+    start = (int*) calloc(npoints + 1, sizeof(int));
+    adj = (int*) malloc(2 * nedges * sizeof(int) + 1);
+    order = (int*) malloc(npoints * sizeof(int) + 1);
+    deg = (int*) malloc(npoints * sizeof(int) + 1);
+    if (start == NULL || adj == NULL || order == NULL || deg == NULL) {
+        free(start);
+        free(adj);
+        free(order);
+        free(deg);
+        return -1;
+    }
+
+    // undirected adjacency lists
+    for (i = 0; i < nedges; i++) {
+        start[v0[i] + 1]++;
+        start[v1[i] + 1]++;
+    }
+    for (v = 0; v < npoints; v++) {
+        deg[v] = start[v+1];
+        start[v+1] += start[v];
+    }
+    for (i = 0; i < nedges; i++) {
+        adj[start[v0[i]]++] = v1[i];
+        adj[start[v1[i]]++] = v0[i];
+    }
+    for (v = npoints; v > 0; v--) {
+        start[v] = start[v-1];
+    }
+    start[0] = 0;
+
+    // sort every list by degree, insertion sort as lists are short
+    for (v = 0; v < npoints; v++) {
+        for (j = start[v] + 1; j < start[v+1]; j++) {
+            w = adj[j];
+            for (k = j; k > start[v] && deg[adj[k-1]] > deg[w]; k--) {
+                adj[k] = adj[k-1];
+            }
+            adj[k] = w;
+        }
+    }
+
+    // vperm marks the vertices already queued
+    for (v = 0; v < npoints; v++) {
+        vperm[v] = -1;
+    }
+    nnum = 0;
+    while (nnum < npoints) {
+        best = -1;
+        for (v = 0; v < npoints; v++) {
+            if (vperm[v] < 0 && (best < 0 || deg[v] < deg[best])) {
+                best = v;
+            }
+        }
+        head = nnum;
+        tail = nnum;
+        order[tail++] = best;
+        vperm[best] = 0;
+        while (head < tail) {
+            v = order[head++];
+            for (j = start[v]; j < start[v+1]; j++) {
+                w = adj[j];
+                if (vperm[w] < 0) {
+                    vperm[w] = 0;
+                    order[tail++] = w;
+                }
+            }
+        }
+        nnum = tail;
+    }
+
+    // reversed
+    for (t = 0; t < npoints; t++) {
+        vperm[order[t]] = npoints - 1 - t;
+    }
+
+    free(start);
+    free(adj);
+    free(order);
+    free(deg);
+
+    return 0;
+}
+
+int reorder_graph(int method, int npoints, int nedges,
+        const int* v0, const int* v1, int* vperm, int* eperm) {
+    struct edge_key* keys;
+    int i, v, a, b;
+
+    if (method == REORDER_RCM) {
+        if (rcm(npoints, nedges, v0, v1, vperm) < 0) {
+            return -1;
+        }
+    } else {
+        for (v = 0; v < npoints; v++) {
+            vperm[v] = v;
+        }
+    }
+
+    if (method == REORDER_NONE) {
+        for (i = 0; i < nedges; i++) {
+            eperm[i] = i;
+        }
+        return 0;
+    }
+
+    // edges by their lower and then their higher new vertex
+    keys = (struct edge_key*) malloc(nedges * sizeof(struct edge_key) + 1);
+    if (keys == NULL) {
+        return -1;
+    }
+    for (i = 0; i < nedges; i++) {
+        a = vperm[v0[i]];
+        b = vperm[v1[i]];
+        if (a > b) {
+            v = a; a = b; b = v;
+        }
+        keys[i].key = (long long) a * npoints + b;
+        keys[i].e = i;
+    }
+    qsort(keys, nedges, sizeof(struct edge_key), compare_keys);
+    for (i = 0; i < nedges; i++) {
+        eperm[i] = keys[i].e;
+    }
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+#ifndef _reorder_h_
+#define _reorder_h_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* reorderings */
+#define REORDER_NONE  0
+#define REORDER_EDGES 1
+#define REORDER_RCM   2
+
+/*
+ * Computes a locality reordering of the graph whose edge i joins v0[i] and
+ * v1[i]. vperm[v] is the new number of vertex v and eperm[k] the edge that
+ * goes to position k. REORDER_EDGES keeps the vertices and sorts the edges
+ * by their lower and then their higher vertex; REORDER_RCM first renumbers
+ * the vertices in reverse Cuthill-McKee order. Returns 0, or -1 if out of
+ * memory.
+ */
+int reorder_graph(int method, int npoints, int nedges,
+        const int* v0, const int* v1, int* vperm, int* eperm);
+
+/* REORDER_NONE, REORDER_EDGES or REORDER_RCM for none, edges or rcm, or -1 */
+int reorder_method(const char* name);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif